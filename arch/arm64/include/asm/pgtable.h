@@ -115,7 +115,7 @@ extern unsigned long empty_zero_page[PAGE_SIZE / sizeof(unsigned long)];
 #define pfn_pte(pfn,prot)	(__pte(((phys_addr_t)(pfn) << PAGE_SHIFT) | pgprot_val(prot)))
 
 #define pte_none(pte)		(!pte_val(pte))
-#define pte_clear(mm,addr,ptep)	set_pte(ptep, __pte(0))
+#define pte_clear(mm,addr,ptep)	__pte_clear(mm, addr, ptep)
 #define pte_page(pte)		(pfn_to_page(pte_pfn(pte)))
 
 /*
@@ -133,6 +133,21 @@ extern unsigned long empty_zero_page[PAGE_SIZE / sizeof(unsigned long)];
 #define pte_valid_not_user(pte) \
 	((pte_val(pte) & (PTE_VALID | PTE_USER)) == PTE_VALID)
 
+/*
+ * A naturally aligned block of CONT_PTES user ptes mapping physically
+ * contiguous pages with the same attributes may carry the contiguous
+ * hint, so that one TLB entry covers the block. Only set_contpte_at()
+ * creates such blocks. set_pte_at() and pte_clear() break a block up
+ * again before changing any of its ptes, so nothing else needs to know.
+ */
+#ifdef CONFIG_ARM64_CONT_PTE
+#define CONT_PTES		(1 << CONT_SHIFT)
+#define pte_cont(pte) \
+	((pte_val(pte) & (PTE_VALID | PTE_CONT)) == (PTE_VALID | PTE_CONT))
+#else
+#define pte_cont(pte)		(0)
+#endif
+
 static inline pte_t clear_pte_bit(pte_t pte, pgprot_t prot)
 {
 	pte_val(pte) &= ~pgprot_val(prot);
@@ -195,22 +210,45 @@ static inline void set_pte(pte_t *ptep, pte_t pte)
 }
 
 extern void __sync_icache_dcache(pte_t pteval, unsigned long addr);
+extern void contpte_unfold(struct mm_struct *mm, unsigned long addr,
+			   pte_t *ptep);
+extern void set_contpte_at(struct mm_struct *mm, unsigned long addr,
+			   pte_t *ptep, pte_t pte);
+
+static inline pte_t __prep_user_pte(unsigned long addr, pte_t pte)
+{
+	if (!pte_special(pte) && pte_exec(pte))
+		__sync_icache_dcache(pte, addr);
+	if (pte_dirty(pte) && pte_write(pte))
+		pte_val(pte) &= ~PTE_RDONLY;
+	else
+		pte_val(pte) |= PTE_RDONLY;
+	return pte;
+}
 
 static inline void set_pte_at(struct mm_struct *mm, unsigned long addr,
 			      pte_t *ptep, pte_t pte)
 {
+	if (pte_cont(*ptep))
+		contpte_unfold(mm, addr, ptep);
+
 	if (pte_valid_user(pte)) {
-		if (!pte_special(pte) && pte_exec(pte))
-			__sync_icache_dcache(pte, addr);
-		if (pte_dirty(pte) && pte_write(pte))
-			pte_val(pte) &= ~PTE_RDONLY;
-		else
-			pte_val(pte) |= PTE_RDONLY;
+		pte = __prep_user_pte(addr, pte);
+		pte_val(pte) &= ~PTE_CONT;
 	}
 
 	set_pte(ptep, pte);
 }
 
+static inline void __pte_clear(struct mm_struct *mm, unsigned long addr,
+			       pte_t *ptep)
+{
+	if (pte_cont(*ptep))
+		contpte_unfold(mm, addr, ptep);
+
+	set_pte(ptep, __pte(0));
+}
+
 /*
  * Huge pte definitions.
  */
@@ -21,6 +21,7 @@
 #include <linux/types.h>
 #include <asm/cpu.h>
 #include <asm/cpufeature.h>
+#include <asm/cputype.h>
 #include <asm/processor.h>
 
 static bool
@@ -49,6 +50,20 @@ has_id_aa64mmfr1_feature(const struct arm64_cpu_capabilities *entry)
 	return feature_matches(val, entry);
 }
 
+/*
+ * Cortex-A53 cores prefetch less aggressively and have a smaller L2 than
+ * the big cores they are paired with. Any one of them makes the copy
+ * routines issue software prefetches and go non-temporal earlier.
+ */
+static bool
+has_in_order_core(const struct arm64_cpu_capabilities *entry)
+{
+	u32 midr = read_cpuid_id();
+
+	return MIDR_IMPLEMENTOR(midr) == ARM_CPU_IMP_ARM &&
+	       MIDR_PARTNUM(midr) == ARM_CPU_PART_CORTEX_A53;
+}
+
 static const struct arm64_cpu_capabilities arm64_features[] = {
 	{
 		.desc = "GIC system register CPU interface",
@@ -67,6 +82,11 @@ static const struct arm64_cpu_capabilities arm64_features[] = {
 		.enable = cpu_enable_pan,
 	},
 #endif /* CONFIG_ARM64_PAN */
+	{
+		.desc = "In-order cores, copy routines tuned",
+		.capability = ARM64_HAS_IN_ORDER_CORES,
+		.matches = has_in_order_core,
+	},
 	{},
 };
 
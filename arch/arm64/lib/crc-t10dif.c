@@ -0,0 +1,57 @@
+/*
+ * arch/arm64/lib/crc-t10dif.c - T10 DIF CRC with ARMv8 PMULL folding
+ *
+ * Copyright (C) 2018 Hisilicon Technologies CO., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * crc_t10dif() branches here while crc_t10dif_use_pmull is set, which
+ * keeps block/t10-pi.c off the crypto API. The assembly folds the whole
+ * 16 byte blocks into one 128 bit remainder that has the same CRC as the
+ * data it replaces; that remainder and the unaligned tail go through the
+ * table code, which is cheap for so few bytes.
+ */
+
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/export.h>
+#include <linux/crc-t10dif.h>
+#include <asm/hwcap.h>
+#include <asm/neon.h>
+
+/* below this the NEON state save costs more than the table lookups */
+#define CRC_T10DIF_PMULL_MIN	256
+
+/* in crc-t10dif-core.S; len is a multiple of 16 and at least 64 */
+asmlinkage void crc_t10dif_pmull_fold(u16 crc, const u8 *buf, size_t len,
+				      u8 out[16]);
+
+bool crc_t10dif_use_pmull __read_mostly;
+EXPORT_SYMBOL(crc_t10dif_use_pmull);
+
+__u16 crc_t10dif_pmull(__u16 crc, const unsigned char *buffer, size_t len)
+{
+	size_t blocks = len & ~15UL;
+	u8 folded[16];
+
+	if (len < CRC_T10DIF_PMULL_MIN)
+		return crc_t10dif_generic(crc, buffer, len);
+
+	/* v0-v7 and v16-v23 */
+	kernel_neon_begin_partial(24);
+	crc_t10dif_pmull_fold(crc, buffer, blocks, folded);
+	kernel_neon_end();
+
+	crc = crc_t10dif_generic(0, folded, sizeof(folded));
+	return crc_t10dif_generic(crc, buffer + blocks, len - blocks);
+}
+EXPORT_SYMBOL(crc_t10dif_pmull);
+
+static int __init crc_t10dif_pmull_init(void)
+{
+	crc_t10dif_use_pmull = !!(elf_hwcap & HWCAP_PMULL);
+	return 0;
+}
+early_initcall(crc_t10dif_pmull_init);
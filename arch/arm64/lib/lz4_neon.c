@@ -0,0 +1,48 @@
+/*
+ * arch/arm64/lib/lz4_neon.c - NEON LZ4 decompression entry point
+ *
+ * Copyright (C) 2018 Hisilicon Technologies CO., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/export.h>
+#include <linux/lz4.h>
+#include <asm/hwcap.h>
+#include <asm/neon.h>
+
+/* in lz4_neon_core.c, built with NEON enabled */
+extern long lz4_decompress_neon_core(const unsigned char *src,
+				     unsigned long src_len,
+				     unsigned char *dst,
+				     unsigned long dst_len);
+
+bool lz4_use_neon __read_mostly;
+EXPORT_SYMBOL(lz4_use_neon);
+
+int lz4_decompress_neon(const unsigned char *src, size_t src_len,
+			unsigned char *dest, size_t *dest_len)
+{
+	long ret;
+
+	kernel_neon_begin();
+	ret = lz4_decompress_neon_core(src, src_len, dest, *dest_len);
+	kernel_neon_end();
+
+	if (ret < 0)
+		return -1;
+	*dest_len = ret;
+	return 0;
+}
+EXPORT_SYMBOL(lz4_decompress_neon);
+
+static int __init lz4_neon_init(void)
+{
+	lz4_use_neon = !!(elf_hwcap & HWCAP_ASIMD);
+	return 0;
+}
+early_initcall(lz4_neon_init);
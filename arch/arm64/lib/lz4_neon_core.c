@@ -0,0 +1,174 @@
+/*
+ * arch/arm64/lib/lz4_neon_core.c - LZ4 block decompression using NEON
+ *
+ * Copyright (C) 2018 Hisilicon Technologies CO., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Only built with NEON enabled and only called between kernel_neon_begin()
+ * and kernel_neon_end() by lz4_neon.c. Like the raid6 NEON code it keeps
+ * away from kernel headers, arm_neon.h does not mix with them.
+ *
+ * Literals and matches are copied 16 bytes at a time and may write up to
+ * 15 bytes past their end, which the next sequence overwrites. Sequences
+ * that end within 16 bytes of either buffer are copied byte by byte.
+ * Matches closer than 16 bytes to their source are expanded with a table
+ * lookup into one register holding whole periods of the pattern, which
+ * is then stored over and over.
+ */
+
+#include <arm_neon.h>
+
+#define ML_BITS		4
+#define ML_MASK		((1U << ML_BITS) - 1)
+#define RUN_MASK	((1U << (8 - ML_BITS)) - 1)
+#define MINMATCH	4
+#define WILD		16
+
+/* lz4_neon_perm[d][i] = i % d: 16 bytes of a pattern of period d */
+static const unsigned char lz4_neon_perm[WILD][WILD] = {
+	{ 0 },
+	{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+	{ 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1 },
+	{ 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0 },
+	{ 0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3 },
+	{ 0, 1, 2, 3, 4, 0, 1, 2, 3, 4, 0, 1, 2, 3, 4, 0 },
+	{ 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3 },
+	{ 0, 1, 2, 3, 4, 5, 6, 0, 1, 2, 3, 4, 5, 6, 0, 1 },
+	{ 0, 1, 2, 3, 4, 5, 6, 7, 0, 1, 2, 3, 4, 5, 6, 7 },
+	{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 0, 1, 2, 3, 4, 5, 6 },
+	{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 0, 1, 2, 3, 4, 5 },
+	{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 0, 1, 2, 3, 4 },
+	{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 0, 1, 2, 3 },
+	{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 0, 1, 2 },
+	{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 0, 1 },
+	{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 0 },
+};
+
+/* largest multiple of d not above 16: how far one stored pattern reaches */
+static const unsigned char lz4_neon_step[WILD] = {
+	0, 16, 16, 15, 16, 15, 12, 14, 16, 9, 10, 11, 12, 13, 14, 15,
+};
+
+static inline void lz4_neon_wildcopy(unsigned char *op,
+				     const unsigned char *ip,
+				     unsigned long len)
+{
+	unsigned char *end = op + len;
+
+	do {
+		vst1q_u8(op, vld1q_u8(ip));
+		op += WILD;
+		ip += WILD;
+	} while (op < end);
+}
+
+static inline void lz4_neon_copy_match(unsigned char *op,
+				       const unsigned char *match,
+				       unsigned long offset, unsigned long len)
+{
+	unsigned char *end = op + len;
+	uint8x16_t pattern;
+	unsigned long step;
+
+	if (offset >= WILD) {
+		/* every byte read is below op, so already final */
+		lz4_neon_wildcopy(op, match, len);
+		return;
+	}
+
+	/* bytes from match + offset on are not read by the lookup */
+	pattern = vqtbl1q_u8(vld1q_u8(match), vld1q_u8(lz4_neon_perm[offset]));
+	step = lz4_neon_step[offset];
+	do {
+		vst1q_u8(op, pattern);
+		op += step;
+	} while (op < end);
+}
+
+static inline int lz4_neon_length(const unsigned char **ipp,
+				  const unsigned char *iend,
+				  unsigned long *length)
+{
+	const unsigned char *ip = *ipp;
+	unsigned int s;
+
+	do {
+		if (ip >= iend)
+			return -1;
+		s = *ip++;
+		*length += s;
+	} while (s == 255);
+
+	*ipp = ip;
+	return 0;
+}
+
+/* returns the decompressed size, or -1 if the input is malformed */
+long lz4_decompress_neon_core(const unsigned char *src, unsigned long src_len,
+			      unsigned char *dst, unsigned long dst_len)
+{
+	const unsigned char *ip = src;
+	const unsigned char *const iend = src + src_len;
+	unsigned char *op = dst;
+	unsigned char *const oend = dst + dst_len;
+
+	while (ip < iend) {
+		unsigned int token = *ip++;
+		unsigned long length = token >> ML_BITS;
+		unsigned long offset;
+		const unsigned char *match;
+
+		/* literals */
+		if (length == RUN_MASK && lz4_neon_length(&ip, iend, &length))
+			return -1;
+		if (length > (unsigned long)(iend - ip) ||
+		    length > (unsigned long)(oend - op))
+			return -1;
+		if (length + WILD <= (unsigned long)(iend - ip) &&
+		    length + WILD <= (unsigned long)(oend - op)) {
+			lz4_neon_wildcopy(op, ip, length);
+		} else {
+			unsigned long i;
+
+			for (i = 0; i < length; i++)
+				op[i] = ip[i];
+		}
+		op += length;
+		ip += length;
+
+		/* the last sequence has literals only */
+		if (ip == iend)
+			break;
+
+		/* match */
+		if (iend - ip < 2)
+			return -1;
+		offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		if (!offset || offset > (unsigned long)(op - dst))
+			return -1;
+		match = op - offset;
+
+		length = token & ML_MASK;
+		if (length == ML_MASK && lz4_neon_length(&ip, iend, &length))
+			return -1;
+		length += MINMATCH;
+		if (length > (unsigned long)(oend - op))
+			return -1;
+
+		if (length + WILD <= (unsigned long)(oend - op)) {
+			lz4_neon_copy_match(op, match, offset, length);
+		} else {
+			unsigned long i;
+
+			for (i = 0; i < length; i++)
+				op[i] = match[i];
+		}
+		op += length;
+	}
+
+	return op - dst;
+}
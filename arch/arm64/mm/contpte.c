@@ -0,0 +1,77 @@
+/*
+ * arch/arm64/mm/contpte.c - contiguous hint for user ptes
+ *
+ * Copyright (C) 2018 Hisilicon Technologies CO., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * A block is written in one go by set_contpte_at() over ptes that were
+ * all none, so no TLB can hold a stale entry for any part of it. It is
+ * broken up with break-before-make: the whole block is cleared and its
+ * TLB entries invalidated before the ptes are written back without the
+ * hint, so that a contiguous and a non-contiguous TLB entry never exist
+ * for the same address. Both run under the pte lock.
+ */
+
+#include <linux/export.h>
+#include <linux/mm.h>
+#include <linux/vmstat.h>
+
+#include <asm/pgtable.h>
+#include <asm/tlbflush.h>
+
+static inline void contpte_flush_tlb(struct mm_struct *mm, unsigned long start)
+{
+	unsigned long asid = (unsigned long)ASID(mm) << 48;
+	unsigned long addr, end;
+
+	start = asid | (start >> 12);
+	end = start + (CONT_SIZE >> 12);
+
+	dsb(ishst);
+	for (addr = start; addr < end; addr += 1 << (PAGE_SHIFT - 12))
+		asm("tlbi vae1is, %0" : : "r"(addr));
+	dsb(ish);
+}
+
+void contpte_unfold(struct mm_struct *mm, unsigned long addr, pte_t *ptep)
+{
+	pte_t *start = ptep - ((addr & ~CONT_MASK) >> PAGE_SHIFT);
+	pte_t ptes[CONT_PTES];
+	int i;
+
+	for (i = 0; i < CONT_PTES; i++) {
+		ptes[i] = start[i];
+		set_pte(start + i, __pte(0));
+	}
+
+	contpte_flush_tlb(mm, addr & CONT_MASK);
+
+	for (i = 0; i < CONT_PTES; i++)
+		set_pte(start + i, __pte(pte_val(ptes[i]) & ~PTE_CONT));
+
+	count_vm_event(CONT_PTE_SPLIT);
+}
+EXPORT_SYMBOL(contpte_unfold);
+
+/*
+ * Map CONT_PTES pages, physically contiguous from the page of @pte on, at
+ * the CONT_SIZE aligned @addr. All ptes of the block must be none.
+ */
+void set_contpte_at(struct mm_struct *mm, unsigned long addr, pte_t *ptep,
+		    pte_t pte)
+{
+	int i;
+
+	VM_BUG_ON(addr & ~CONT_MASK);
+	VM_BUG_ON(!pte_valid_user(pte));
+
+	for (i = 0; i < CONT_PTES; i++, addr += PAGE_SIZE) {
+		VM_BUG_ON(!pte_none(ptep[i]));
+		set_pte(ptep + i,
+			__pte(pte_val(__prep_user_pte(addr, pte)) | PTE_CONT));
+		pte_val(pte) += PAGE_SIZE;
+	}
+}
@@ -268,6 +268,28 @@ static int __kprobes do_page_fault(unsigned long addr, unsigned int esr,
 	if (IS_ENABLED(CONFIG_ARM64_PAN) && (regs->pstate & PSR_PAN_BIT))
 		goto no_context;
 
+	/*
+	 * Try user faults without mmap_sem first, so that a thread holding
+	 * it for write doesn't stall the faults of the others.
+	 */
+	if (mm_flags & FAULT_FLAG_USER) {
+		fault = handle_speculative_fault(mm, addr & PAGE_MASK,
+						 mm_flags, vm_flags);
+		if (!(fault & VM_FAULT_RETRY)) {
+			perf_sw_event(PERF_COUNT_SW_PAGE_FAULTS, 1, regs, addr);
+			if (fault & VM_FAULT_MAJOR) {
+				tsk->maj_flt++;
+				perf_sw_event(PERF_COUNT_SW_PAGE_FAULTS_MAJ, 1,
+					      regs, addr);
+			} else {
+				tsk->min_flt++;
+				perf_sw_event(PERF_COUNT_SW_PAGE_FAULTS_MIN, 1,
+					      regs, addr);
+			}
+			return 0;
+		}
+	}
+
 	/*
 	 * As per x86, we may deadlock here. However, since the kernel only
 	 * validly references user space from well defined areas of the code,
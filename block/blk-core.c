@@ -46,6 +46,7 @@
 
 #ifdef CONFIG_HISI_BLOCK_FREQUENCE_CONTROL
 #include "hisi_freq_ctl.h"
+#include <huawei_platform/storage/io_latency.h>
 #endif
 
 EXPORT_TRACEPOINT_SYMBOL_GPL(block_bio_remap);
@@ -1408,10 +1409,13 @@ static void part_round_stats_single(int cpu, struct hd_struct *part,
 				inflight * (now - part->stamp));
 		__part_stat_add(cpu, part, io_ticks, (now - part->stamp));
 #ifdef CONFIG_HISI_BLOCK_FREQUENCE_CONTROL
-		hisi_blk_freq_request(FREQ_REQ_ADD,
-				inflight * (now - part->stamp));
+		if (!part->partno)
+			hisi_blk_freq_request(FREQ_REQ_ADD,
+					inflight * (now - part->stamp));
 	}else{
-		hisi_blk_freq_request(FREQ_REQ_REMOVE, (now - part->stamp));
+		if (!part->partno)
+			hisi_blk_freq_request(FREQ_REQ_REMOVE,
+					(now - part->stamp));
 #endif
 	}
 	part->stamp = now;
@@ -1669,6 +1673,7 @@ void init_request_from_bio(struct request *req, struct bio *bio)
 	req_latency_check(req,REQ_PROC_STAGE_INIT_FROM_BIO);
 
 	hisi_blk_mq_init_req_timestamp(req);
+	io_latency_rq_init(req);
 
 	req->cmd_flags |= bio->bi_rw & REQ_COMMON_MASK;
 	if (bio->bi_rw & REQ_RAHEAD)
@@ -2353,11 +2358,16 @@ void blk_account_io_completion(struct request *req, unsigned int bytes)
 		part = req->part;
 		part_stat_add(cpu, part, sectors[rw], bytes >> 9);
 		part_stat_unlock();
+#ifdef CONFIG_HISI_BLOCK_FREQUENCE_CONTROL
+		hisi_blk_freq_bytes(bytes);
+#endif
 	}
 }
 
 void blk_account_io_done(struct request *req)
 {
+	io_latency_rq_done(req);
+
 	/*
 	 * Account IO completion.  flush_rq isn't accounted as a
 	 * normal IO on queueing nor completion.  Accounting the
@@ -2379,6 +2389,9 @@ void blk_account_io_done(struct request *req)
 
 		hd_struct_put(part);
 		part_stat_unlock();
+#ifdef CONFIG_HISI_BLOCK_FREQUENCE_CONTROL
+		hisi_blk_freq_complete(req, duration);
+#endif
 	}
 }
 
@@ -2588,6 +2601,7 @@ void blk_start_request(struct request *req)
 	blk_dequeue_request(req);
 
 	req_latency_check(req,REQ_PROC_STAGE_START);
+	io_latency_rq_start(req);
 
 	wbt_issue(req->q->rq_wb, &req->wb_stat, (bool)(req->cmd_flags & REQ_FG));
 
@@ -2663,6 +2677,7 @@ bool blk_update_request(struct request *req, int error, unsigned int nr_bytes)
 #ifdef CONFIG_WBT
 	/*lint -save -e514*/
 	blk_stat_add(&req->q->rq_stats[rq_data_dir(req)], req);
+	blk_stat_hist_add(req->q->rq_hist, req);
 	if (req->cmd_flags & REQ_FG)
 		blk_stat_add(&req->q->rq_stats[2 + rq_data_dir(req)], req);
 	/*lint -restore*/
@@ -74,6 +74,7 @@
 #include "blk.h"
 #include "blk-mq.h"
 
+#include "hisi-blk-mq.h"
 #include "hisi-blk-mq-dispatch-strategy.h"
 #include "hisi-blk-mq-debug.h"
 
@@ -229,6 +230,8 @@ static void flush_end_io(struct request *flush_rq, int error)
 	unsigned long flags = 0;
 	struct blk_flush_queue *fq = blk_get_flush_queue(q, flush_rq->mq_ctx);
 
+	hisi_blk_mq_flush_done(q, flush_rq, error);
+
 	if (q->mq_ops) {
 		spin_lock_irqsave(&fq->mq_flush_lock, flags);
 		flush_rq->tag = -1;
@@ -384,6 +387,9 @@ void blk_insert_flush(struct request *rq)
 	unsigned int policy = blk_flush_policy(fflags, rq);
 	struct blk_flush_queue *fq = blk_get_flush_queue(q, rq->mq_ctx);
 
+	if ((policy & REQ_FSEQ_PREFLUSH) && hisi_blk_mq_flush_skip_preflush(q))
+		policy &= ~REQ_FSEQ_PREFLUSH;
+
 	/*
 	 * @policy now records what operations need to be done.  Adjust
 	 * REQ_FLUSH and FUA for the driver.
@@ -550,7 +550,7 @@ static int attempt_merge(struct request_queue *q, struct request *req,
 #ifdef CONFIG_HISI_BLK_INLINE_CRYPTO
 	/*
 	 * check current bio->key to last-merged request key,
-	 * which is submitted only by f2fs file system now.
+	 * which is submitted only by f2fs and ext4 now.
 	 */
 	if (!blk_bio_key_compare(req, next->bio))
 		return 0;
@@ -639,7 +639,7 @@ bool blk_rq_merge_ok(struct request *rq, struct bio *bio)
 #ifdef CONFIG_HISI_BLK_INLINE_CRYPTO
 	/*
 	 * check current bio->key to last-merged request key,
-	 * which is submitted only by f2fs file system now.
+	 * which is submitted only by f2fs and ext4 now.
 	 */
 	if (!blk_bio_key_compare(rq, bio))
 		return false;
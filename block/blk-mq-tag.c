@@ -219,7 +219,10 @@ static int __bt_get(struct blk_mq_hw_ctx *hctx, struct blk_mq_bitmap_tags *bt,
 		}
 	}
 
-	*tag_cache = 0;
+	/*
+	 * Leave the cache alone, the whole map was searched from it anyway.
+	 * Resetting it would move every ctx over to the first word.
+	 */
 	return -1;
 
 	/*
@@ -260,6 +263,7 @@ static int bt_get(struct blk_mq_alloc_data *data,
 {
 	struct bt_wait_state *bs;
 	DEFINE_WAIT(wait);
+	ktime_t start = ktime_set(0, 0);
 	int tag;
 
 	tag = __bt_get(hctx, bt, last_tag, tags);
@@ -296,6 +300,8 @@ static int bt_get(struct blk_mq_alloc_data *data,
 
 		blk_mq_put_ctx(data->ctx);
 
+		if (!start.tv64)
+			start = ktime_get();
 		io_schedule();
 
 		data->ctx = blk_mq_get_ctx(data->q);
@@ -313,6 +319,13 @@ static int bt_get(struct blk_mq_alloc_data *data,
 	} while (1);
 
 	finish_wait(&bs->wait, &wait);
+
+	/* shared with other hctxs, but only touched on the slow path */
+	if (start.tv64) {
+		atomic_long_inc(&tags->nr_waits);
+		atomic64_add(ktime_to_ns(ktime_sub(ktime_get(), start)),
+			     &tags->wait_ns);
+	}
 	return tag;
 }
 
@@ -601,11 +614,22 @@ void blk_mq_free_tags(struct blk_mq_tags *tags)
 	kfree(tags);
 }
 
-void blk_mq_tag_init_last_tag(struct blk_mq_tags *tags, unsigned int *tag)
+/*
+ * Start the @index'th software queue of a hardware queue in a bitmap word
+ * of its own, so that CPUs allocate from different cachelines until the
+ * map runs out. Round robin allocation keeps going from tag 0.
+ */
+void blk_mq_tag_init_last_tag(struct blk_mq_tags *tags, unsigned int *tag,
+			      unsigned int index)
 {
-	unsigned int depth = tags->nr_tags - tags->nr_reserved_tags;
+	struct blk_mq_bitmap_tags *bt = &tags->bitmap_tags;
+
+	if (BT_ALLOC_RR(tags) || !bt->map_nr) {
+		*tag = 0;
+		return;
+	}
 
-	*tag = prandom_u32() % depth;
+	*tag = (index % bt->map_nr) << bt->bits_per_word;
 }
 
 int blk_mq_tag_update_depth(struct blk_mq_tags *tags, unsigned int tdepth)
@@ -671,6 +695,9 @@ ssize_t blk_mq_tag_sysfs_show(struct blk_mq_tags *tags, char *page)
 
 	page += sprintf(page, "nr_free=%u, nr_reserved=%u\n", free, res);
 	page += sprintf(page, "active_queues=%u\n", atomic_read(&tags->active_queues));
+	page += sprintf(page, "nr_waits=%lu, wait_us=%llu\n",
+			atomic_long_read(&tags->nr_waits),
+			div_u64(atomic64_read(&tags->wait_ns), NSEC_PER_USEC));
 
 	return page - orig_page;
 }
@@ -469,6 +469,7 @@ static void blk_mq_stat_add(struct request *rq)
 	stat = &rq->mq_ctx->stat[rq_data_dir(rq)];
 
 	blk_stat_add(stat, rq);
+	blk_stat_hist_add(rq->mq_ctx->hist, rq);
 
 	if (rq->cmd_flags & REQ_FG) {
 		stat = &rq->mq_ctx->stat[2 + rq_data_dir(rq)];
@@ -485,6 +486,7 @@ void __blk_mq_complete_request(struct request *rq)
 #ifdef CONFIG_WBT
 	blk_mq_stat_add(rq);
 #endif
+	hisi_blk_mq_flush_write_done(q, rq);
 
 	if (!q->softirq_done_fn)
 		blk_mq_end_request(rq, rq->errors);
@@ -531,6 +533,7 @@ void blk_mq_start_request(struct request *rq)
 	wbt_issue(q->rq_wb, &rq->wb_stat, (bool)(rq->cmd_flags & REQ_FG));
 
 	req_latency_check(rq,REQ_PROC_STAGE_MQ_START);
+	io_latency_rq_start(rq);
 
 	blk_add_timer(rq);
 
@@ -924,6 +927,8 @@ static void __blk_mq_run_hw_queue(struct blk_mq_hw_ctx *hctx)
 		return;
 #endif
 
+	hisi_blk_mq_vip_reorder(q, &rq_list);
+
 	/*
 	 * Start off with dptr being NULL, so we start the first request
 	 * immediately, even if we have more pending.
@@ -950,7 +955,9 @@ static void __blk_mq_run_hw_queue(struct blk_mq_hw_ctx *hctx)
 		blk_mq_debug_rq_processing_state_update(rq,
 						MQ_PROCESS_RUN_HW_QUEUE);
 
-		if (blk_mq_dispatch_busy(q, rq)) {
+		/* foreground requests are not held back by the strategy */
+		if (!hisi_blk_mq_rq_is_vip(q, rq) &&
+		    blk_mq_dispatch_busy(q, rq)) {
 			ret = BLK_MQ_RQ_QUEUE_BUSY;
 			goto ret;
 		}
@@ -964,6 +971,13 @@ static void __blk_mq_run_hw_queue(struct blk_mq_hw_ctx *hctx)
 			continue;
 		}
 
+		if (hisi_blk_mq_flush_merge(q, rq)) {
+			blk_mq_debug_rq_processing_state_update(rq,
+						MQ_PROCESS_FLUSH_MERGED);
+			queued++;
+			continue;
+		}
+
 		blk_mq_debug_rq_processing_state_update(rq,
 				MQ_PROCESS_ASYNC_DISPATCH);
 		req_latency_check(rq,REQ_PROC_STAGE_MQ_RUN_QUEUE_DISPATCH);
@@ -1584,6 +1598,8 @@ static void blk_mq_make_request(struct request_queue *q, struct bio *bio)
 		return;
 	}
 
+	hisi_blk_mq_vip_tag(q, bio);
+
 #ifdef CONFIG_HISI_BLK_MQ
 	if((bio->bi_rw & REQ_FLUSH)&&(bio->bi_iter.bi_size == 0)&&(atomic_read(&q->wio_after_flush_fua) == 0)){/*lint !e529 !e438*/
 		bio_endio(bio, 0);
@@ -1724,6 +1740,8 @@ static void blk_sq_make_request(struct request_queue *q, struct bio *bio)
 		return;
 	}
 
+	hisi_blk_mq_vip_tag(q, bio);
+
 	if (use_plug && !blk_queue_nomerges(q) &&
 	    blk_attempt_plug_merge(q, bio, &request_count, NULL))
 		return;
@@ -2226,6 +2244,13 @@ static void blk_mq_map_swqueue(struct request_queue *q,
 			set->tags[i] = blk_mq_init_rq_map(set, i);
 		hctx->tags = set->tags[i];
 		WARN_ON(!hctx->tags);
+		if (hctx->tags) {
+			unsigned int j;
+
+			for (j = 0; j < hctx->nr_ctx; j++)
+				blk_mq_tag_init_last_tag(hctx->tags,
+						&hctx->ctxs[j]->last_tag, j);
+		}
 
 		/*
 		 * Set the map size to the number of mapped software queues.
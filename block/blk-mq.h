@@ -25,6 +25,7 @@ struct blk_mq_ctx {
 	unsigned long		____cacheline_aligned_in_smp rq_completed[2];
 #ifdef CONFIG_WBT
 	struct blk_rq_stat	stat[4];
+	struct blk_rq_hist	hist[BLK_STAT_HIST_NR];
 #endif
 
 	struct request_queue	*queue;
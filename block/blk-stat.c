@@ -4,6 +4,9 @@
  * Copyright (C) 2016 Jens Axboe
  */
 #include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/log2.h>
+#include <linux/sizes.h>
 #include <linux/blk-mq.h>
 
 #include "blk-stat.h"
@@ -103,6 +106,22 @@ void blk_queue_stat_get(struct request_queue *q, struct blk_rq_stat *dst)
 	}
 }
 
+/*
+ * Mean completion latency in nsecs of the foreground reads in the latest
+ * window, 0 without samples. Walks every sw queue, callers should cache it.
+ */
+u64 blk_queue_fg_read_lat(struct request_queue *q)
+{
+	struct blk_rq_stat stat[4];
+
+	blk_queue_stat_get(q, stat);
+	if (stat[2].nr_samples <= 0 || stat[2].mean <= 0)
+		return 0;
+
+	return stat[2].mean;
+}
+EXPORT_SYMBOL_GPL(blk_queue_fg_read_lat);
+
 void blk_hctx_stat_get(struct blk_mq_hw_ctx *hctx, struct blk_rq_stat *dst)
 {
 	struct blk_mq_ctx *ctx;
@@ -169,6 +188,7 @@ void blk_stat_init(struct blk_rq_stat *stat)
 {
 	__blk_stat_init(stat, ktime_to_ns(ktime_get()));
 }
+EXPORT_SYMBOL_GPL(blk_stat_init);
 
 void blk_stat_add(struct blk_rq_stat *stat, struct request *rq)
 {
@@ -196,6 +216,124 @@ void blk_stat_add(struct blk_rq_stat *stat, struct request *rq)
 
 	stat->nr_samples++;
 }
+EXPORT_SYMBOL_GPL(blk_stat_add);
+
+static int blk_stat_hist_idx(struct request *rq)
+{
+	unsigned int bytes = blk_rq_bytes(rq);
+	int size;
+
+	if (bytes <= SZ_4K)
+		size = BLK_STAT_SIZE_4K;
+	else if (bytes <= SZ_64K)
+		size = BLK_STAT_SIZE_64K;
+	else
+		size = BLK_STAT_SIZE_LARGE;
+
+	return BLK_STAT_HIST_IDX(rq_data_dir(rq), rq_is_sync(rq), size);
+}
+
+/*
+ * Account a completed request in the histogram of its class, @hist
+ * being an array of BLK_STAT_HIST_NR histograms.
+ */
+void blk_stat_hist_add(struct blk_rq_hist *hist, struct request *rq)
+{
+	u64 rq_time = wbt_issue_stat_get_time(&rq->wb_stat);
+	u64 now = ktime_to_ns(ktime_get());
+	u64 usec;
+	int bucket;
+
+	if (!rq_time || now < rq_time)
+		return;
+
+	usec = div_u64(now - rq_time, NSEC_PER_USEC);
+	bucket = usec ? min_t(int, ilog2(usec) + 1,
+			      BLK_STAT_HIST_BUCKETS - 1) : 0;
+	hist[blk_stat_hist_idx(rq)].buckets[bucket]++;
+}
+
+void blk_stat_hist_sum(struct blk_rq_hist *dst, struct blk_rq_hist *src)
+{
+	int i;
+
+	for (i = 0; i < BLK_STAT_HIST_BUCKETS; i++)
+		dst->buckets[i] += src->buckets[i];
+}
+EXPORT_SYMBOL_GPL(blk_stat_hist_sum);
+
+/*
+ * Snapshot the BLK_STAT_HIST_NR histograms of a queue into @dst. Unlike
+ * the mean/min/max stats these are not windowed, they accumulate until
+ * blk_stat_hist_clear().
+ */
+void blk_queue_hist_get(struct request_queue *q, struct blk_rq_hist *dst)
+{
+	memset(dst, 0, sizeof(*dst) * BLK_STAT_HIST_NR);
+
+	if (q->mq_ops) {
+		struct blk_mq_hw_ctx *hctx;
+		struct blk_mq_ctx *ctx;
+		int i, j, k;
+
+		/*lint -save -e574 -e737*/
+		queue_for_each_hw_ctx(q, hctx, i) {
+			hctx_for_each_ctx(hctx, ctx, j) {
+				for (k = 0; k < BLK_STAT_HIST_NR; k++)
+					blk_stat_hist_sum(&dst[k],
+							  &ctx->hist[k]);
+			}
+		}
+		/*lint -restore*/
+	} else {
+		memcpy(dst, q->rq_hist, sizeof(*dst) * BLK_STAT_HIST_NR);
+	}
+}
+EXPORT_SYMBOL_GPL(blk_queue_hist_get);
+
+/*
+ * Return the latency (usec) below which @permille of the requests in
+ * @hist completed, 0 if @hist is empty. The result is the upper bound of
+ * the bucket the percentile falls in, so it overestimates by up to 2x.
+ */
+u64 blk_stat_hist_percentile(struct blk_rq_hist *hist, unsigned int permille)
+{
+	u64 nr = 0, sum = 0, rank;
+	int i;
+
+	for (i = 0; i < BLK_STAT_HIST_BUCKETS; i++)
+		nr += hist->buckets[i];
+	if (!nr)
+		return 0;
+
+	rank = div_u64(nr * permille + 999, 1000);
+	for (i = 0; i < BLK_STAT_HIST_BUCKETS - 1; i++) {
+		sum += hist->buckets[i];
+		if (sum >= rank)
+			break;
+	}
+
+	return 1ULL << i;
+}
+EXPORT_SYMBOL_GPL(blk_stat_hist_percentile);
+
+void blk_stat_hist_clear(struct request_queue *q)
+{
+	if (q->mq_ops) {
+		struct blk_mq_hw_ctx *hctx;
+		struct blk_mq_ctx *ctx;
+		int i, j;
+
+		/*lint -save -e574 -e737*/
+		queue_for_each_hw_ctx(q, hctx, i) {
+			hctx_for_each_ctx(hctx, ctx, j)
+				memset(ctx->hist, 0, sizeof(ctx->hist));
+		}
+		/*lint -restore*/
+	} else {
+		memset(q->rq_hist, 0, sizeof(q->rq_hist));
+	}
+}
 
 void blk_stat_clear(struct request_queue *q)
 {
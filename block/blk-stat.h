@@ -9,6 +9,11 @@
 
 #ifdef CONFIG_WBT
 void blk_stat_add(struct blk_rq_stat *, struct request *);
+void blk_stat_hist_add(struct blk_rq_hist *, struct request *);
+void blk_queue_hist_get(struct request_queue *, struct blk_rq_hist *);
+void blk_stat_hist_clear(struct request_queue *q);
+u64 blk_stat_hist_percentile(struct blk_rq_hist *, unsigned int permille);
+void blk_stat_hist_sum(struct blk_rq_hist *, struct blk_rq_hist *);
 void blk_hctx_stat_get(struct blk_mq_hw_ctx *, struct blk_rq_stat *);
 void blk_queue_stat_get(struct request_queue *, struct blk_rq_stat *);
 void blk_stat_clear(struct request_queue *q);
@@ -18,6 +23,22 @@ void blk_stat_sum(struct blk_rq_stat *, struct blk_rq_stat *);
 static inline void blk_stat_add(struct blk_rq_stat *stat, struct request *rq)
 {
 }
+static inline void blk_stat_hist_add(struct blk_rq_hist *hist, struct request *rq)
+{
+}
+static inline void blk_queue_hist_get(struct request_queue *q, struct blk_rq_hist *dst)
+{
+}
+static inline void blk_stat_hist_clear(struct request_queue *q)
+{
+}
+static inline u64 blk_stat_hist_percentile(struct blk_rq_hist *hist, unsigned int permille)
+{
+	return 0;
+}
+static inline void blk_stat_hist_sum(struct blk_rq_hist *dst, struct blk_rq_hist *src)
+{
+}
 static inline void blk_hctx_stat_get(struct blk_mq_hw_ctx *hctx, struct blk_rq_stat *dst)
 {
 }
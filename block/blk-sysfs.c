@@ -411,6 +411,57 @@ static ssize_t queue_stats_show(struct request_queue *q, char *page)
 	return ret;
 }
 
+static ssize_t queue_stats_hist_show(struct request_queue *q, char *page)
+{
+	static const char * const size_name[BLK_STAT_SIZE_NR] = {
+		"4k", "64k", "large",
+	};
+	struct blk_rq_hist *hist;
+	ssize_t ret = 0;
+	int dir, sync, size;
+
+	hist = kmalloc_array(BLK_STAT_HIST_NR, sizeof(*hist), GFP_KERNEL);
+	if (!hist)
+		return -ENOMEM;
+
+	blk_queue_hist_get(q, hist);
+
+	for (dir = READ; dir <= WRITE; dir++) {
+		for (sync = 0; sync <= 1; sync++) {
+			for (size = 0; size < BLK_STAT_SIZE_NR; size++) {
+				int idx = BLK_STAT_HIST_IDX(dir, sync, size);
+				struct blk_rq_hist *h = &hist[idx];
+				u64 nr = 0;
+				int i;
+
+				for (i = 0; i < BLK_STAT_HIST_BUCKETS; i++)
+					nr += h->buckets[i];
+
+				ret += sprintf(page + ret,
+					"%s %s %s: samples=%llu, p50=%llu, p99=%llu, p999=%llu\n",
+					dir == READ ? "read" : "write",
+					sync ? "sync" : "async",
+					size_name[size], nr,
+					blk_stat_hist_percentile(h, 500),
+					blk_stat_hist_percentile(h, 990),
+					blk_stat_hist_percentile(h, 999));
+			}
+		}
+	}
+
+	kfree(hist);
+	return ret;
+}
+
+/*lint -save -e715*/
+static ssize_t queue_stats_hist_store(struct request_queue *q,
+				      const char *page, size_t count)
+{
+	blk_stat_hist_clear(q);
+	return count;
+}
+/*lint -restore*/
+
 static ssize_t queue_wb_ok_cnt_show(struct request_queue *q, char *page)
 {
 	if (!q->rq_wb)
@@ -580,6 +631,12 @@ static struct queue_sysfs_entry queue_stats_entry = {
 };
 /*lint -restore*/
 
+static struct queue_sysfs_entry queue_stats_hist_entry = {
+	.attr = {.name = "stats_hist", .mode = S_IRUGO | S_IWUSR },
+	.show = queue_stats_hist_show,
+	.store = queue_stats_hist_store,
+};
+
 static struct queue_sysfs_entry queue_wb_lat_entry = {
 	.attr = {.name = "wb_lat_usec", .mode = S_IRUGO | S_IWUSR },
 	.show = queue_wb_lat_show,
@@ -599,6 +656,25 @@ static struct queue_sysfs_entry queue_wb_ok_cnt_entry = {
 };
 #endif
 
+#ifdef CONFIG_HISI_BLK_MQ
+static ssize_t queue_flush_stats_show(struct request_queue *q, char *page)
+{
+	if (!q->mq_ops)
+		return -EINVAL;
+
+	return sprintf(page, "issued=%ld, bypassed=%ld, merged=%ld, preflush_skipped=%ld\n",
+		       atomic_long_read(&q->flush_issued),
+		       atomic_long_read(&q->flush_bypassed),
+		       atomic_long_read(&q->flush_merged),
+		       atomic_long_read(&q->flush_preflush_skipped));
+}
+
+static struct queue_sysfs_entry queue_flush_stats_entry = {
+	.attr = {.name = "flush_reducing_stats", .mode = S_IRUGO },
+	.show = queue_flush_stats_show,
+};
+#endif
+
 /*lint -save -e785*/
 static struct queue_sysfs_entry queue_avg_perf_entry = {
 	.attr = {.name = "average_perf", .mode = S_IRUGO },
@@ -632,9 +708,13 @@ static struct attribute *default_attrs[] = {
 #ifdef CONFIG_WBT
 	&queue_wc_entry.attr,
 	&queue_stats_entry.attr,
+	&queue_stats_hist_entry.attr,
 	&queue_wb_lat_entry.attr,
 	&queue_wb_win_entry.attr,
 	&queue_wb_ok_cnt_entry.attr,
+#endif
+#ifdef CONFIG_HISI_BLK_MQ
+	&queue_flush_stats_entry.attr,
 #endif
 	&queue_avg_perf_entry.attr,
 	NULL,
@@ -2,7 +2,9 @@
 #define _INTERNAL_HISI_BLK_MQ_H_
 
 #include <linux/blkdev.h>
+#include <linux/blk-mq.h>
 #include <linux/hisi-blk-mq.h>
+#include <linux/launch_prefetch.h>
 
 #ifdef CONFIG_HISI_BLK_MQ
 
@@ -62,9 +64,116 @@ flush_dispatch:
 	atomic_set(&q->wio_after_flush_fua, rq->__data_len ? 1 : 0);
 	return false;
 flush_bypass:
+	atomic_long_inc(&q->flush_bypassed);
 	return true;
 }
 
+/*
+ * Each hctx has its own flush queue, so concurrent fsyncs from different
+ * cpus each end up in a cache flush of their own. A flush reaching
+ * dispatch while another one is in flight is parked and completed along
+ * with it, provided no write completed since the in flight one was
+ * dispatched.
+ *
+ * Returns true if @rq was parked.
+ */
+static inline bool hisi_blk_mq_flush_merge(struct request_queue *q,
+					   struct request *rq)
+{
+	unsigned long flags;
+	bool merged = false;
+	int gen;
+
+	if (!(rq->cmd_flags & REQ_FLUSH) || rq->__data_len)
+		return false;
+
+	gen = atomic_read(&q->flush_write_gen);
+	spin_lock_irqsave(&q->flush_merge_lock, flags);
+	if (!q->flush_inflight || q->flush_inflight == rq) {
+		/* new flush, or ours requeued on busy */
+		q->flush_inflight = rq;
+		q->flush_inflight_gen = gen;
+	} else if (q->flush_inflight_gen == gen) {
+		list_add_tail(&rq->queuelist, &q->flush_merged_list);
+		merged = true;
+	}
+	spin_unlock_irqrestore(&q->flush_merge_lock, flags);
+
+	if (merged)
+		atomic_long_inc(&q->flush_merged);
+	return merged;
+}
+
+/*
+ * Called from flush_end_io() for every flush request, completes the
+ * flushes parked on @flush_rq.
+ */
+static inline void hisi_blk_mq_flush_done(struct request_queue *q,
+					  struct request *flush_rq, int error)
+{
+	struct request *rq, *next;
+	unsigned long flags;
+	LIST_HEAD(merged);
+
+	if (!q->mq_ops)
+		return;
+
+	spin_lock_irqsave(&q->flush_merge_lock, flags);
+	if (q->flush_inflight != flush_rq) {
+		spin_unlock_irqrestore(&q->flush_merge_lock, flags);
+		return;
+	}
+	q->flush_inflight = NULL;
+	list_splice_init(&q->flush_merged_list, &merged);
+	q->flush_stable = !error;
+	q->flush_stable_gen = q->flush_inflight_gen;
+	spin_unlock_irqrestore(&q->flush_merge_lock, flags);
+
+	list_for_each_entry_safe(rq, next, &merged, queuelist) {
+		list_del_init(&rq->queuelist);
+		blk_mq_end_request(rq, error);
+	}
+}
+
+/*
+ * Called by blk_insert_flush() for requests needing a preflush. A data
+ * write can go out with just its FUA bit (or postflush) if no write
+ * completed since the last successful flush was dispatched, jbd2 commit
+ * blocks of back to back fsyncs being the usual case. An empty flush is
+ * then completed right away.
+ */
+static inline bool hisi_blk_mq_flush_skip_preflush(struct request_queue *q)
+{
+	unsigned long flags;
+	bool skip;
+
+	if (!q->mq_ops)
+		return false;
+
+	spin_lock_irqsave(&q->flush_merge_lock, flags);
+	skip = q->flush_stable &&
+		q->flush_stable_gen == atomic_read(&q->flush_write_gen);
+	spin_unlock_irqrestore(&q->flush_merge_lock, flags);
+
+	if (skip)
+		atomic_long_inc(&q->flush_preflush_skipped);
+	return skip;
+}
+
+/*
+ * Data write completion, which dirties the device cache unless the
+ * write went out with a native FUA.
+ */
+static inline void hisi_blk_mq_flush_write_done(struct request_queue *q,
+						struct request *rq)
+{
+	if (rq->cmd_type != REQ_TYPE_FS || !(rq->cmd_flags & REQ_WRITE) ||
+	    !blk_rq_bytes(rq) || (rq->cmd_flags & REQ_FUA))
+		return;
+
+	atomic_inc(&q->flush_write_gen);
+}
+
 static inline void flush_work_trigger(struct request_queue *q)
 {
 	if (!hisi_blk_mq_test_queue_quirk(q, HISI_MQ_FLUSH_REDUCING))
@@ -86,6 +195,7 @@ static inline void flush_reducing_stats_update(struct request_queue *q,
 {
 	if (processing_rq->cmd_flags & REQ_FLUSH) {
 		atomic_set(&q->wio_after_flush_fua, rq->__data_len ? 1 : 0);
+		atomic_long_inc(&q->flush_issued);
 	} else if ((processing_rq->cmd_type == REQ_TYPE_FS)
 			   && (processing_rq->cmd_flags & REQ_WRITE)
 			   && (atomic_read(&q->wio_after_flush_fua) == 0)) {
@@ -101,8 +211,89 @@ static inline void hisi_blk_mq_init(struct request_queue *q)
 	atomic_set(&q->flush_work_trigger, 0);
 	atomic_set(&q->flush_from_flush_work, 0);
 	atomic_set(&q->wio_after_flush_fua,0);
+
+	spin_lock_init(&q->flush_merge_lock);
+	INIT_LIST_HEAD(&q->flush_merged_list);
+	q->flush_inflight = NULL;
+	q->flush_stable = false;
+	atomic_set(&q->flush_write_gen, 0);
+	atomic_long_set(&q->flush_issued, 0);
+	atomic_long_set(&q->flush_bypassed, 0);
+	atomic_long_set(&q->flush_merged, 0);
+	atomic_long_set(&q->flush_preflush_skipped, 0);
+}
+
+#ifdef CONFIG_HISI_MQ_VIP_IO
+/* foreground requests moved ahead of others in one hw queue run */
+#define HISI_MQ_VIP_BUDGET	8
+
+static inline bool hisi_blk_mq_rq_is_vip(struct request_queue *q,
+					 struct request *rq)
+{
+	return (rq->cmd_flags & REQ_FG) &&
+		hisi_blk_mq_test_queue_quirk(q, HISI_MQ_VIP_IO);
+}
+
+/*
+ * blk-throttle already tags bios of fg_flag blkcg groups with REQ_FG,
+ * add sync I/O of tasks the scheduler boosts as foreground.
+ */
+static inline void hisi_blk_mq_vip_tag(struct request_queue *q,
+				       struct bio *bio)
+{
+	if (!hisi_blk_mq_test_queue_quirk(q, HISI_MQ_VIP_IO))
+		return;
+	/* app launch prefetch runs ahead of the faults of a foreground app */
+	if (current_is_launch_prefetch()) {
+		bio->bi_rw |= REQ_FG;
+		return;
+	}
+	if ((bio->bi_rw & (REQ_FG | REQ_BG)) || !rw_is_sync(bio->bi_rw))
+		return;
+#ifdef CONFIG_CGROUP_SCHEDTUNE
+	if (schedtune_task_boost(current) > 0)
+		bio->bi_rw |= REQ_FG;
+#endif
 }
 
+/*
+ * Move up to HISI_MQ_VIP_BUDGET foreground requests to the front of
+ * @rq_list, keeping their order, so e.g. page fault reads from the top
+ * app do not wait behind a burst of background writes.
+ */
+static inline void hisi_blk_mq_vip_reorder(struct request_queue *q,
+					   struct list_head *rq_list)
+{
+	struct request *rq, *next;
+	LIST_HEAD(vip_list);
+	int budget = HISI_MQ_VIP_BUDGET;
+
+	if (!hisi_blk_mq_test_queue_quirk(q, HISI_MQ_VIP_IO))
+		return;
+
+	list_for_each_entry_safe(rq, next, rq_list, queuelist) {
+		if (!(rq->cmd_flags & REQ_FG))
+			continue;
+		list_move_tail(&rq->queuelist, &vip_list);
+		if (!--budget)
+			break;
+	}
+	list_splice(&vip_list, rq_list);
+}
+#else
+static inline bool hisi_blk_mq_rq_is_vip(struct request_queue *q,
+					 struct request *rq)
+{
+	return false;
+}
+
+static inline void hisi_blk_mq_vip_tag(struct request_queue *q,
+				       struct bio *bio) {}
+
+static inline void hisi_blk_mq_vip_reorder(struct request_queue *q,
+					   struct list_head *rq_list) {}
+#endif /* CONFIG_HISI_MQ_VIP_IO */
+
 #else /* CONFIG_HISI_BLK_MQ */
 
 static inline void blk_request_queue_disk_register(struct gendisk *disk,struct request_queue *q){}
@@ -119,6 +310,35 @@ static inline void flush_work_trigger(struct request_queue *q){}
 static inline void flush_reducing_stats_update(struct request_queue *q,
 		struct request *rq, struct request *processing_rq) {}
 
+static inline bool hisi_blk_mq_flush_merge(struct request_queue *q,
+					   struct request *rq)
+{
+	return false;
+}
+
+static inline void hisi_blk_mq_flush_done(struct request_queue *q,
+		struct request *flush_rq, int error) {}
+
+static inline bool hisi_blk_mq_flush_skip_preflush(struct request_queue *q)
+{
+	return false;
+}
+
+static inline void hisi_blk_mq_flush_write_done(struct request_queue *q,
+						struct request *rq) {}
+
+static inline bool hisi_blk_mq_rq_is_vip(struct request_queue *q,
+					 struct request *rq)
+{
+	return false;
+}
+
+static inline void hisi_blk_mq_vip_tag(struct request_queue *q,
+				       struct bio *bio) {}
+
+static inline void hisi_blk_mq_vip_reorder(struct request_queue *q,
+					   struct list_head *rq_list) {}
+
 #endif /* CONFIG_HISI_BLK_MQ */
 
 #endif /* _INTERNAL_HISI_BLK_MQ_H_ */
@@ -22,6 +22,10 @@
 #include <linux/idr.h>
 #include <linux/bsg.h>
 #include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/ktime.h>
 
 #include <scsi/scsi.h>
 #include <scsi/scsi_ioctl.h>
@@ -30,6 +34,8 @@
 #include <scsi/scsi_driver.h>
 #include <scsi/sg.h>
 
+#include "blk.h"
+
 struct blk_scsi_device {
 	struct request_queue *queue;
 	spinlock_t lock;
@@ -46,11 +52,88 @@ struct blk_scsi_device {
 	unsigned long flags;
 };
 
+/* latency of the commands issued through blk_scsi_kern_ioctl(), by opcode */
+struct hisi_blk_kern_lat {
+	unsigned long count;
+	u64 total_ns;
+	u64 max_ns;
+};
+
+static struct hisi_blk_kern_lat hisi_blk_kern_lat[256];
+static DEFINE_SPINLOCK(hisi_blk_kern_lat_lock);
+
+static void hisi_blk_kern_lat_add(u8 opcode, u64 ns)
+{
+	struct hisi_blk_kern_lat *lat = &hisi_blk_kern_lat[opcode];
+
+	spin_lock(&hisi_blk_kern_lat_lock);
+	lat->count++;
+	lat->total_ns += ns;
+	if (ns > lat->max_ns)
+		lat->max_ns = ns;
+	spin_unlock(&hisi_blk_kern_lat_lock);
+}
+
 static long hisi_blk_kern_copy_data(void *to, const void *from, unsigned long n)
 {
 	memcpy(to, from, n);
 	return 0;
 }
+
+static void hisi_blk_kern_vmap_endio(struct bio *bio, int err)
+{
+	bio_put(bio);
+}
+
+/*
+ * Map a kernel data buffer into @rq without copying it. blk_rq_map_kern()
+ * already does that for linear memory, it only bounces buffers that are
+ * on the stack or not aligned for DMA. vmalloc memory is not linear, so
+ * its pages are added one by one here instead (the D-cache of arm64 does
+ * not alias, so no vmap flushing is needed).
+ */
+static int hisi_blk_kern_map_data(struct request_queue *q, struct request *rq,
+				  void *buf, unsigned int len)
+{
+	unsigned int offset = offset_in_page(buf);
+	struct bio *bio;
+	int ret;
+
+	if (!is_vmalloc_addr(buf) || !blk_rq_aligned(q, (unsigned long)buf, len))
+		return blk_rq_map_kern(q, rq, buf, len, GFP_KERNEL);
+
+	if (len > (queue_max_hw_sectors(q) << 9))
+		return -EINVAL;
+
+	bio = bio_kmalloc(GFP_KERNEL, DIV_ROUND_UP(offset + len, PAGE_SIZE));
+	if (!bio)
+		return -ENOMEM;
+
+	while (len) {
+		unsigned int bytes = min_t(unsigned int, len,
+					   PAGE_SIZE - offset);
+
+		if (bio_add_pc_page(q, bio, vmalloc_to_page(buf), bytes,
+				    offset) < bytes) {
+			bio_put(bio);
+			return -EINVAL;
+		}
+		buf += bytes;
+		len -= bytes;
+		offset = 0;
+	}
+
+	bio->bi_end_io = hisi_blk_kern_vmap_endio;
+	if (rq_data_dir(rq) == WRITE)
+		bio->bi_rw |= REQ_WRITE;
+
+	ret = blk_rq_append_bio(q, rq, bio);
+	if (unlikely(ret)) {
+		bio_put(bio);
+		return ret;
+	}
+	return 0;
+}
 static int hisi_blk_kern_fill_sgv4_hdr_rq(struct request_queue *q,
 					  struct request *rq,
 					  struct sg_io_v4 *hdr)
@@ -163,9 +246,9 @@ static struct request *hisi_blk_kern_map_hdr(struct blk_scsi_device *bd,
 		rq->next_rq = next_rq;
 		next_rq->cmd_type = rq->cmd_type;
 
-		dxferp = (void __user *)(unsigned long)hdr->din_xferp;
-		ret = blk_rq_map_kern(q, next_rq, dxferp, hdr->din_xfer_len,
-				      GFP_KERNEL);
+		dxferp = (void *)(unsigned long)hdr->din_xferp;
+		ret = hisi_blk_kern_map_data(q, next_rq, dxferp,
+					     hdr->din_xfer_len);
 		if (ret)
 			goto out;
 	}
@@ -180,7 +263,7 @@ static struct request *hisi_blk_kern_map_hdr(struct blk_scsi_device *bd,
 		dxfer_len = 0;
 
 	if (dxfer_len) {
-		ret = blk_rq_map_kern(q, rq, dxferp, dxfer_len, GFP_KERNEL);
+		ret = hisi_blk_kern_map_data(q, rq, dxferp, dxfer_len);
 		if (ret)
 			goto out;
 	}
@@ -261,26 +344,36 @@ long blk_scsi_kern_ioctl(unsigned int fd, unsigned int cmd, unsigned long arg)
 	int at_head;
 	u8 sense[SCSI_SENSE_BUFFERSIZE];
 	struct blk_scsi_device *bd;
+	ktime_t start;
+	u8 opcode;
 	struct file *pfile = fget(fd);
 	if (pfile == NULL)
 		return -EFAULT;
 	bd = (struct blk_scsi_device *)pfile->private_data;
 	switch (cmd) {
 	case SG_IO:
-		if (hisi_blk_kern_copy_data(&hdr, uarg, sizeof(hdr)))
-			return -EFAULT;
+		if (hisi_blk_kern_copy_data(&hdr, uarg, sizeof(hdr))) {
+			ret = -EFAULT;
+			break;
+		}
 
 		rq = hisi_blk_kern_map_hdr(bd, &hdr, sense);
 
-		if (IS_ERR(rq))
-			return PTR_ERR(rq);
+		if (IS_ERR(rq)) {
+			ret = PTR_ERR(rq);
+			break;
+		}
 
+		opcode = rq->cmd[0];
 		at_head = (0 == (hdr.flags & BSG_FLAG_Q_AT_TAIL));
+		start = ktime_get();
 		blk_execute_rq(bd->queue, NULL, rq, at_head);
+		hisi_blk_kern_lat_add(opcode,
+				      ktime_to_ns(ktime_sub(ktime_get(), start)));
 		ret = hisi_blk_kern_complete_hdr_rq(rq, &hdr);
 
 		if (hisi_blk_kern_copy_data(uarg, &hdr, sizeof(hdr)))
-			return -EFAULT;
+			ret = -EFAULT;
 
 		break;
 	/*
@@ -293,3 +386,56 @@ long blk_scsi_kern_ioctl(unsigned int fd, unsigned int cmd, unsigned long arg)
 	fput(pfile);
 	return ret;
 }
+
+#ifdef CONFIG_DEBUG_FS
+static int hisi_blk_kern_lat_show(struct seq_file *s, void *unused)
+{
+	struct hisi_blk_kern_lat lat;
+	int i;
+
+	seq_puts(s, "opcode count avg_us max_us\n");
+	for (i = 0; i < ARRAY_SIZE(hisi_blk_kern_lat); i++) {
+		spin_lock(&hisi_blk_kern_lat_lock);
+		lat = hisi_blk_kern_lat[i];
+		spin_unlock(&hisi_blk_kern_lat_lock);
+		if (!lat.count)
+			continue;
+		seq_printf(s, "0x%02x %lu %llu %llu\n", i, lat.count,
+			   div_u64(lat.total_ns, lat.count * NSEC_PER_USEC),
+			   div_u64(lat.max_ns, NSEC_PER_USEC));
+	}
+	return 0;
+}
+
+static int hisi_blk_kern_lat_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, hisi_blk_kern_lat_show, NULL);
+}
+
+/* any write clears the statistics */
+static ssize_t hisi_blk_kern_lat_write(struct file *file,
+				       const char __user *buf,
+				       size_t count, loff_t *ppos)
+{
+	spin_lock(&hisi_blk_kern_lat_lock);
+	memset(hisi_blk_kern_lat, 0, sizeof(hisi_blk_kern_lat));
+	spin_unlock(&hisi_blk_kern_lat_lock);
+	return count;
+}
+
+static const struct file_operations hisi_blk_kern_lat_fops = {
+	.open		= hisi_blk_kern_lat_open,
+	.read		= seq_read,
+	.write		= hisi_blk_kern_lat_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init hisi_blk_kern_lat_init(void)
+{
+	debugfs_create_file("hisi_blk_scsi_kern_lat", S_IRUSR | S_IWUSR, NULL,
+			    NULL, &hisi_blk_kern_lat_fops);
+	return 0;
+}
+late_initcall(hisi_blk_kern_lat_init);
+#endif
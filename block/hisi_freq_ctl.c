@@ -4,16 +4,14 @@
 #include <linux/compiler.h>
 #include <linux/syscalls.h>
 #include <linux/bootdevice.h>
+#include <linux/blkdev.h>
+#include <linux/cpufreq.h>
+#include <linux/topology.h>
 
+#include "blk-mq.h"
 #include "hisi_freq_ctl.h"
 #define HISI_DDR_FREQ_REQ
 
-/*
-The threshold of total io_wait_time:
-If total io_wait_time is bigger than the threshold,
-add ddr frequence request immediately.
-*/
-#define IO_WAIT_TIME_THRESHOLD			100
 #ifdef HISI_DDR_FREQ_REQ
 /* The band of ddr request */
 #define DDR_REQUEST_VALUE_DOWN			3841
@@ -21,12 +19,55 @@ add ddr frequence request immediately.
 #define DDR_REQUEST_VALUE_UP			7682
 #endif
 /*
-The period of the delete_request timer:
-When there is not io_req waiting in flight, this timer should be started.
-Before time out, if one io_req wait in flight, this timer should be canceled.
+The boost level is only lowered after it was too high for this long,
+one level at a time.
 */
 #define REMOVE_REQ_TIME_MS				350
 
+/*
+The controller samples queue depth, throughput and completion latency
+every SAMPLE_PERIOD_MS while there is I/O, a higher boost level is only
+taken once it was asked for BOOST_UP_PERIODS periods in a row so that a
+short burst does not boost at all.
+*/
+#define SAMPLE_PERIOD_MS				20
+#define BOOST_UP_PERIODS				2
+#define BOOST_DOWN_PERIODS		(REMOVE_REQ_TIME_MS / SAMPLE_PERIOD_MS)
+/* Completions needed before the mean latency is trusted */
+#define BOOST_MIN_SAMPLES				4
+/* Clusters tracked for the cpu boost votes */
+#define BOOST_MAX_CLUSTERS				4
+
+/*
+ * BOOST_IO_BUSY:	the cpufreq governor accounts iowait as load
+ * BOOST_DDR:		plus a ddr floor, and the busiest cluster boosted
+ * BOOST_MAX:		plus twice the ddr floor, and every cluster with at
+ *			least a quarter of the completions/submissions
+ */
+enum boost_level {
+	BOOST_NONE = 0,
+	BOOST_IO_BUSY,
+	BOOST_DDR,
+	BOOST_MAX,
+	BOOST_LEVELS,
+};
+
+/*
+ * A level is asked for when any of its thresholds is reached, depth is
+ * the average number of requests in flight times 100.
+ */
+struct boost_threshold {
+	unsigned int depth;
+	unsigned int mb_per_s;
+	unsigned int lat_us;
+};
+
+static const struct boost_threshold boost_thresholds[BOOST_LEVELS] = {
+	[BOOST_IO_BUSY]	= { .depth = 100, .mb_per_s = 20, .lat_us = 2000 },
+	[BOOST_DDR]	= { .depth = 300, .mb_per_s = 100, .lat_us = 5000 },
+	[BOOST_MAX]	= { .depth = 800, .mb_per_s = 250, .lat_us = 10000 },
+};
+
 /*
 when io_is_busy is set to 1,will take iowait time into account when
 caculating cpu load the default value is 0
@@ -34,35 +75,32 @@ caculating cpu load the default value is 0
 #define PATH_IO_IS_BUSY \
 	"/sys/devices/system/cpu/cpu0/cpufreq/interactive/io_is_busy"
 #ifdef HISI_DDR_FREQ_REQ
-static s32 ddr_qos_update_request(s32 ddr_request_value,
+/*
+ * PM_QOS_MEMORY_THROUGHPUT sums up all requests, only ask for what the
+ * other requests miss to reach @target.
+ */
+static s32 ddr_qos_update_request(s32 target, s32 ddr_request_value,
 				  struct pm_qos_request *ddr_req)
 {
 	s32 new_value;
-	int cur_ddr_band;
+	int others;
 
 	if (BOOT_DEVICE_EMMC == get_bootdevice_type())
 		return 0;
 
-	new_value = ddr_request_value;
-
-	cur_ddr_band = pm_qos_request(PM_QOS_MEMORY_THROUGHPUT);
-
-	if (cur_ddr_band < DDR_REQUEST_VALUE_DOWN)
-		new_value += DDR_REQUEST_VALUE_DOWN - cur_ddr_band;
-	else if (cur_ddr_band > DDR_REQUEST_VALUE_UP)
-		new_value = 0;
+	others = pm_qos_request(PM_QOS_MEMORY_THROUGHPUT) - ddr_request_value;
+	new_value = (others < target) ? target - others : 0;
 
 	if (new_value != ddr_request_value) {
-		ddr_request_value = new_value;
-		pm_qos_update_request(ddr_req, ddr_request_value);
+		pm_qos_update_request(ddr_req, new_value);
 		pr_debug("%s: block ddr freq request update to %d,curent ddr band is %d\n",
-			__func__, ddr_request_value, cur_ddr_band);
+			__func__, new_value, others);
 	}
 
-	return ddr_request_value;
+	return new_value;
 }
 
-static s32 ddr_qos_add_request(struct pm_qos_request *ddr_req)
+static s32 ddr_qos_add_request(s32 target, struct pm_qos_request *ddr_req)
 {
 	int cur_ddr_band;
 	s32 ddr_request_value;
@@ -73,14 +111,14 @@ static s32 ddr_qos_add_request(struct pm_qos_request *ddr_req)
 	ddr_req->pm_qos_class = 0;
 
 	cur_ddr_band = pm_qos_request(PM_QOS_MEMORY_THROUGHPUT);
-	if (cur_ddr_band > DDR_REQUEST_VALUE_DOWN)
+	if (cur_ddr_band > target)
 		ddr_request_value = 0;
 	else
-		ddr_request_value = DDR_REQUEST_VALUE_DOWN - cur_ddr_band;
+		ddr_request_value = target - cur_ddr_band;
 	pm_qos_add_request(ddr_req,
 					PM_QOS_MEMORY_THROUGHPUT,
 					ddr_request_value);
-	pr_err("%s: block ddr freq request add.request_value = %d, curent ddr band is %d\n",
+	pr_debug("%s: block ddr freq request add.request_value = %d, curent ddr band is %d\n",
 		__func__, ddr_request_value, cur_ddr_band);
 
 	return ddr_request_value;
@@ -92,7 +130,7 @@ static void ddr_qos_remove_request(struct pm_qos_request *ddr_req)
 	if (BOOT_DEVICE_EMMC == get_bootdevice_type())
 		return;
 	pm_qos_remove_request(ddr_req);
-	pr_err("%s: block ddr freq request remove\n", __func__);
+	pr_debug("%s: block ddr freq request remove\n", __func__);
 }
 #endif
 static long set_io_is_busy(void)
@@ -186,30 +224,41 @@ static void cpu_freq_request_remove(void)
 		       __func__);
 }
 
+
 struct hisi_freq_req_ops {
-	s32 (*ddr_update_req)(s32 ddr_request_value,
+	s32 (*ddr_update_req)(s32 target, s32 ddr_request_value,
 			      struct pm_qos_request *ddr_req);
-	s32 (*ddr_add_req)(struct pm_qos_request *ddr_req);
+	s32 (*ddr_add_req)(s32 target, struct pm_qos_request *ddr_req);
 	void (*ddr_remove_request)(struct pm_qos_request *ddr_req);
 	void (*cpu_freq_req_add)(void);
 	void (*cpu_freq_req_remove)(void);
 };
 
+/* What the block layer reported since the last sample */
+struct freq_sample {
+	unsigned long depth_time;/* sum of in flight requests * jiffies */
+	unsigned long lat_us;/* sum of completion latencies */
+	unsigned int nr_completed;
+	/* completion irq and submitter cpus, per cluster */
+	unsigned int votes[BOOST_MAX_CLUSTERS];
+};
 
 struct freq_ctrl {
 	spinlock_t		lock;
 	struct mutex	m_lock;
-	int cur_type;/* The current stat of ddr frequence request */
+	int cur_level;/* The boost level currently applied */
+	int up_level;/* The lowest level asked for during up_periods */
+	int up_periods;/* Consecutive samples above cur_level */
+	int down_periods;/* Consecutive samples below cur_level */
 	struct pm_qos_request *ddr_req;
-	int delete_req_timer_start;/* The sign of the delete_request timer */
-	int total_io_wait_time;/* The counter of total io_wait_time */
 	s32 ddr_request_value;
 	struct workqueue_struct *workqueue;
-	struct work_struct work;
-	struct delayed_work del_work;
+	struct delayed_work sample_work;
 	struct hisi_freq_req_ops *req_ops;
-	int new_req_type;
-	int new_time_in_queue;
+	bool sampling;/* sample_work is queued, protected by lock */
+	unsigned long last_sample;
+	struct freq_sample sample;
+	atomic_long_t bytes;/* completed since the last sample */
 };
 
 static struct freq_ctrl *freq_ctrl_ptr = NULL;
@@ -222,131 +271,242 @@ static struct hisi_freq_req_ops freq_req_ops = {
 	.cpu_freq_req_remove = cpu_freq_request_remove,
 };
 
-static void delete_freq_req_work(struct work_struct *work)
+/* Called with freq_ctrl_ptr->lock held */
+static void hisi_blk_freq_start_sampling(void)
 {
-	if (unlikely((NULL == freq_ctrl_ptr) ||
-			(NULL == freq_ctrl_ptr->workqueue)))
+	if (freq_ctrl_ptr->sampling)
 		return;
 
-	if ((freq_ctrl_ptr->req_ops->ddr_add_req) &&
-			(NULL == freq_ctrl_ptr->ddr_req))
+	freq_ctrl_ptr->sampling = true;
+	freq_ctrl_ptr->last_sample = jiffies;
+	queue_delayed_work(freq_ctrl_ptr->workqueue,
+			   &freq_ctrl_ptr->sample_work,
+			   msecs_to_jiffies(SAMPLE_PERIOD_MS));
+}
+
+static int hisi_blk_freq_level(struct freq_sample *s, unsigned long bytes,
+			       unsigned long elapsed)
+{
+	unsigned int depth, mb_per_s, lat_us = 0;
+	int level;
+
+	depth = s->depth_time * 100 / elapsed;
+	/* bytes per msec, divided by 1024 is close enough to MB/s */
+	mb_per_s = (bytes / jiffies_to_msecs(elapsed)) >> 10;
+	if (s->nr_completed >= BOOST_MIN_SAMPLES)
+		lat_us = s->lat_us / s->nr_completed;
+
+	for (level = BOOST_MAX; level > BOOST_NONE; level--) {
+		const struct boost_threshold *t = &boost_thresholds[level];
+
+		if (depth >= t->depth || mb_per_s >= t->mb_per_s ||
+		    lat_us >= t->lat_us)
+			break;
+	}
+
+	return level;
+}
+
+static s32 hisi_blk_freq_ddr_target(int level)
+{
+	if (level >= BOOST_MAX)
+		return DDR_REQUEST_VALUE_UP;
+	if (level >= BOOST_DDR)
+		return DDR_REQUEST_VALUE_DOWN;
+	return 0;
+}
+
+/*
+ * Boost the clusters the completion irq and the submitters run on. The
+ * interactive governor keeps the floor for its own validation time, so
+ * this is redone every sample.
+ */
+static void hisi_blk_freq_cluster_boost(int level, struct freq_sample *s)
+{
+	unsigned int total = 0, best = 0;
+	unsigned long clusters;
+	int cluster, cpu;
+
+	for (cluster = 0; cluster < BOOST_MAX_CLUSTERS; cluster++) {
+		total += s->votes[cluster];
+		if (s->votes[cluster] > s->votes[best])
+			best = cluster;
+	}
+	if (!total)
 		return;
 
-	/* Delete the ddr frequence request */
+	clusters = BIT(best);
+	for (cluster = 0; cluster < BOOST_MAX_CLUSTERS; cluster++)
+		if (level >= BOOST_MAX && s->votes[cluster] * 4 >= total)
+			clusters |= BIT(cluster);
+
+	for_each_online_cpu(cpu) {
+		cluster = topology_physical_package_id(cpu);
+		if (cluster < 0 || cluster >= BOOST_MAX_CLUSTERS ||
+		    !(clusters & BIT(cluster)))
+			continue;
+		/* one cpu is enough for the whole cluster */
+		(void)hisi_cluster_boost(cpu);
+		clusters &= ~BIT(cluster);
+	}
+}
+
+/* Called with freq_ctrl_ptr->m_lock held */
+static void hisi_blk_freq_set_level(int level)
+{
+	struct hisi_freq_req_ops *ops = freq_ctrl_ptr->req_ops;
+	int cur = freq_ctrl_ptr->cur_level;
+	s32 target = hisi_blk_freq_ddr_target(level);
+
+	if (level >= BOOST_IO_BUSY && cur < BOOST_IO_BUSY &&
+	    ops->cpu_freq_req_add)
+		ops->cpu_freq_req_add();
+	else if (level < BOOST_IO_BUSY && cur >= BOOST_IO_BUSY &&
+		 ops->cpu_freq_req_remove)
+		ops->cpu_freq_req_remove();
+
+	if (target && hisi_blk_freq_ddr_target(cur) == 0) {
+		if (ops->ddr_add_req)
+			freq_ctrl_ptr->ddr_request_value =
+			    ops->ddr_add_req(target, freq_ctrl_ptr->ddr_req);
+	} else if (!target && hisi_blk_freq_ddr_target(cur)) {
+		if (ops->ddr_remove_request)
+			ops->ddr_remove_request(freq_ctrl_ptr->ddr_req);
+		freq_ctrl_ptr->ddr_request_value = 0;
+	} else if (target && ops->ddr_update_req) {
+		freq_ctrl_ptr->ddr_request_value =
+		    ops->ddr_update_req(target,
+					freq_ctrl_ptr->ddr_request_value,
+					freq_ctrl_ptr->ddr_req);
+	}
+
+	freq_ctrl_ptr->cur_level = level;
+}
+
+static void hisi_blk_freq_sample_work(struct work_struct *work)
+{
+	struct freq_sample s;
+	unsigned long flags, now, elapsed;
+	int level, cur;
+
+	spin_lock_irqsave(&freq_ctrl_ptr->lock, flags);
+	s = freq_ctrl_ptr->sample;
+	memset(&freq_ctrl_ptr->sample, 0, sizeof(freq_ctrl_ptr->sample));
+	spin_unlock_irqrestore(&freq_ctrl_ptr->lock, flags);
+
+	now = jiffies;
+	elapsed = max(now - freq_ctrl_ptr->last_sample, 1UL);
+	freq_ctrl_ptr->last_sample = now;
+	level = hisi_blk_freq_level(&s,
+			atomic_long_xchg(&freq_ctrl_ptr->bytes, 0), elapsed);
+
 	mutex_lock(&freq_ctrl_ptr->m_lock);
-	freq_ctrl_ptr->cur_type = FREQ_REQ_REMOVE;
-	if (freq_ctrl_ptr->req_ops->ddr_remove_request)
-		freq_ctrl_ptr->req_ops->ddr_remove_request(
-		    freq_ctrl_ptr->ddr_req);
-	if (freq_ctrl_ptr->req_ops->cpu_freq_req_remove)
-		freq_ctrl_ptr->req_ops->cpu_freq_req_remove();
-	freq_ctrl_ptr->delete_req_timer_start = 0;
+	cur = freq_ctrl_ptr->cur_level;
+
+	/*
+	 * Hysteresis: go up after BOOST_UP_PERIODS samples asking for more,
+	 * to the lowest level asked for meanwhile. Go down one level after
+	 * BOOST_DOWN_PERIODS samples asking for less.
+	 */
+	if (level > cur) {
+		freq_ctrl_ptr->down_periods = 0;
+		if (!freq_ctrl_ptr->up_periods++ ||
+		    level < freq_ctrl_ptr->up_level)
+			freq_ctrl_ptr->up_level = level;
+		if (freq_ctrl_ptr->up_periods >= BOOST_UP_PERIODS) {
+			hisi_blk_freq_set_level(freq_ctrl_ptr->up_level);
+			freq_ctrl_ptr->up_periods = 0;
+		}
+	} else if (level < cur) {
+		freq_ctrl_ptr->up_periods = 0;
+		if (++freq_ctrl_ptr->down_periods >= BOOST_DOWN_PERIODS) {
+			hisi_blk_freq_set_level(cur - 1);
+			freq_ctrl_ptr->down_periods = 0;
+		}
+	} else {
+		freq_ctrl_ptr->up_periods = 0;
+		freq_ctrl_ptr->down_periods = 0;
+	}
+
+	/* the other ddr requests may have changed meanwhile */
+	if (freq_ctrl_ptr->cur_level == cur && cur >= BOOST_DDR)
+		hisi_blk_freq_set_level(cur);
+
+	if (freq_ctrl_ptr->cur_level >= BOOST_DDR)
+		hisi_blk_freq_cluster_boost(freq_ctrl_ptr->cur_level, &s);
+	cur = freq_ctrl_ptr->cur_level;
 	mutex_unlock(&freq_ctrl_ptr->m_lock);
-	return;
+
+	/* Keep sampling until idle and unboosted */
+	spin_lock_irqsave(&freq_ctrl_ptr->lock, flags);
+	if (cur == BOOST_NONE && !s.depth_time && !s.nr_completed &&
+	    !freq_ctrl_ptr->sample.depth_time &&
+	    !freq_ctrl_ptr->sample.nr_completed &&
+	    !atomic_long_read(&freq_ctrl_ptr->bytes)) {
+		freq_ctrl_ptr->sampling = false;
+	} else {
+		queue_delayed_work(freq_ctrl_ptr->workqueue,
+				   &freq_ctrl_ptr->sample_work,
+				   msecs_to_jiffies(SAMPLE_PERIOD_MS));
+	}
+	spin_unlock_irqrestore(&freq_ctrl_ptr->lock, flags);
 }
 
-static void hisi_blk_freq_ctrl_work(struct work_struct *work)
+/*
+ * Called from part_round_stats() of whole disks. FREQ_REQ_ADD reports
+ * @time_in_queue as requests in flight times jiffies, FREQ_REQ_REMOVE an
+ * idle period.
+ */
+void hisi_blk_freq_request(int req_type, int time_in_queue)
 {
-	int req_type;
-	int time_in_queue;
 	unsigned long flags;
-
 	if (unlikely((NULL == freq_ctrl_ptr) ||
-			(NULL == freq_ctrl_ptr->workqueue)))
+		(NULL == freq_ctrl_ptr->workqueue)))
 		return;
+
 	if ((freq_ctrl_ptr->req_ops->ddr_add_req) &&
 		(NULL == freq_ctrl_ptr->ddr_req))
 		return;
 
+	if (FREQ_REQ_ADD != req_type)
+		return;
+
 	spin_lock_irqsave(&freq_ctrl_ptr->lock, flags);
-	req_type = freq_ctrl_ptr->new_req_type;
-	time_in_queue = freq_ctrl_ptr->new_time_in_queue;
+	freq_ctrl_ptr->sample.depth_time += time_in_queue;
+	hisi_blk_freq_start_sampling();
 	spin_unlock_irqrestore(&freq_ctrl_ptr->lock, flags);
+}
 
-	mutex_lock(&freq_ctrl_ptr->m_lock);
+static void hisi_blk_freq_vote(int cpu)
+{
+	int cluster;
 
-	if (FREQ_REQ_ADD == freq_ctrl_ptr->cur_type) {
-		if (freq_ctrl_ptr->req_ops->ddr_update_req)
-			freq_ctrl_ptr->ddr_request_value =
-			    freq_ctrl_ptr->req_ops->ddr_update_req(
-				freq_ctrl_ptr->ddr_request_value,
-				freq_ctrl_ptr->ddr_req);
-	}
+	if (cpu < 0 || cpu >= nr_cpu_ids)
+		return;
 
-	if (FREQ_REQ_ADD == req_type) {
-		if (FREQ_REQ_ADD == freq_ctrl_ptr->cur_type) {
-			/*
-			new request:	add_freq_req
-			current state:	add_freq_req
-			process:	Cancel the delete_request timer,
-			if the timer has already been started.
-			*/
-			if (freq_ctrl_ptr->delete_req_timer_start) {
-				mutex_unlock(&freq_ctrl_ptr->m_lock);
-				cancel_delayed_work_sync(
-				    &freq_ctrl_ptr->del_work);
-				mutex_lock(&freq_ctrl_ptr->m_lock);
-				freq_ctrl_ptr->delete_req_timer_start = 0;
-			}
-		} else {
-			/*
-			new request:	add_ddr_freq_req
-			current state:	remove_ddr_freq_req
-			process:	1) Add total_io_wait_time value.
-			2) If total_io_wait_time is bigger than
-			threshold,start ddr frequence request.
-			*/
-			freq_ctrl_ptr->total_io_wait_time += time_in_queue;
-
-			if (freq_ctrl_ptr->total_io_wait_time >=
-			    IO_WAIT_TIME_THRESHOLD) {
-				if (freq_ctrl_ptr->req_ops->ddr_add_req)
-					freq_ctrl_ptr->ddr_request_value =
-					    freq_ctrl_ptr->req_ops->ddr_add_req(
-						freq_ctrl_ptr->ddr_req);
-				if (freq_ctrl_ptr->req_ops->cpu_freq_req_add)
-					freq_ctrl_ptr->req_ops
-					    ->cpu_freq_req_add();
-
-				freq_ctrl_ptr->cur_type = FREQ_REQ_ADD;
-				freq_ctrl_ptr->total_io_wait_time = 0;
-			}
-		}
-	} else {
-		if (FREQ_REQ_REMOVE == freq_ctrl_ptr->cur_type) {
-			/*
-			new request:	remove_freq_req
-			current state:	remove_freq_req
-			process:	Reduce total_io_wait_time value.
-			*/
-			if (freq_ctrl_ptr->total_io_wait_time <= time_in_queue)
-				freq_ctrl_ptr->total_io_wait_time = 0;
-			else
-				freq_ctrl_ptr->total_io_wait_time -=
-				    time_in_queue;
-		} else {
-			/*
-			new request:	remove_freq_req
-			current state:	add_freq_req
-			process:	Start the delete_request timer.
-			*/
-			if (0 == freq_ctrl_ptr->delete_req_timer_start) {
-				freq_ctrl_ptr->delete_req_timer_start = 1;
-				queue_delayed_work(
-				    freq_ctrl_ptr->workqueue,
-				    &freq_ctrl_ptr->del_work,
-				    msecs_to_jiffies(REMOVE_REQ_TIME_MS));
-			}
-		}
-	}
+	cluster = topology_physical_package_id(cpu);
+	if (cluster >= 0 && cluster < BOOST_MAX_CLUSTERS)
+		freq_ctrl_ptr->sample.votes[cluster]++;
+}
 
-	mutex_unlock(&freq_ctrl_ptr->m_lock);
-	return;
+/* Called from blk_account_io_completion() */
+void hisi_blk_freq_bytes(unsigned int bytes)
+{
+	if (unlikely(NULL == freq_ctrl_ptr))
+		return;
+
+	atomic_long_add(bytes, &freq_ctrl_ptr->bytes);
 }
 
-void hisi_blk_freq_request(int req_type, int time_in_queue)
+/*
+ * Called from blk_account_io_done(), in the completion context, with
+ * the time @rq spent since it was started.
+ */
+void hisi_blk_freq_complete(struct request *rq, unsigned long duration)
 {
 	unsigned long flags;
+	int submitter = rq->cpu;
+
 	if (unlikely((NULL == freq_ctrl_ptr) ||
 		(NULL == freq_ctrl_ptr->workqueue)))
 		return;
@@ -355,13 +515,16 @@ void hisi_blk_freq_request(int req_type, int time_in_queue)
 		(NULL == freq_ctrl_ptr->ddr_req))
 		return;
 
+	if (rq->mq_ctx)
+		submitter = rq->mq_ctx->cpu;
+
 	spin_lock_irqsave(&freq_ctrl_ptr->lock, flags);
-	freq_ctrl_ptr->new_req_type = req_type;
-	freq_ctrl_ptr->new_time_in_queue = time_in_queue;
+	freq_ctrl_ptr->sample.lat_us += jiffies_to_usecs(duration);
+	freq_ctrl_ptr->sample.nr_completed++;
+	hisi_blk_freq_vote(smp_processor_id());
+	hisi_blk_freq_vote(submitter);
+	hisi_blk_freq_start_sampling();
 	spin_unlock_irqrestore(&freq_ctrl_ptr->lock, flags);
-
-	queue_work(freq_ctrl_ptr->workqueue, &freq_ctrl_ptr->work);
-	return;
 }
 
 void hisi_blk_freq_ctrl_init(void)
@@ -373,8 +536,8 @@ void hisi_blk_freq_ctrl_init(void)
 			pr_err("%s: kzalloc freq_ctrl_ptr error\n", __func__);
 			goto out;
 		}
-		pr_err("%s: hisi blk freq ctrl init: io_wait_time_threshold=%d, remove_req_time=%dms\n",
-				__func__, IO_WAIT_TIME_THRESHOLD,
+		pr_err("%s: hisi blk freq ctrl init: sample_period=%dms, remove_req_time=%dms\n",
+				__func__, SAMPLE_PERIOD_MS,
 				REMOVE_REQ_TIME_MS);
 #ifdef HISI_DDR_FREQ_REQ
 		pr_err("%s: hisi block ddr frequence ctrl: ddr_req_value_down=%d, ddr_req_value_up=%d\n",
@@ -389,7 +552,7 @@ void hisi_blk_freq_ctrl_init(void)
 
 	if (freq_ctrl_ptr->req_ops->ddr_add_req) {
 		if (NULL == freq_ctrl_ptr->ddr_req) {
-			freq_ctrl_ptr->ddr_req = kmalloc(
+			freq_ctrl_ptr->ddr_req = kzalloc(
 			sizeof(struct pm_qos_request), GFP_KERNEL);
 			if (freq_ctrl_ptr->ddr_req == NULL) {
 				pr_err("%s: malloc ddr req error\n", __func__);
@@ -399,15 +562,14 @@ void hisi_blk_freq_ctrl_init(void)
 	}
 
 	if (NULL == freq_ctrl_ptr->workqueue) {
+		INIT_DELAYED_WORK(&freq_ctrl_ptr->sample_work,
+			hisi_blk_freq_sample_work);
 		freq_ctrl_ptr->workqueue =
 			create_singlethread_workqueue("hisi_block_freq_ctrl");
 		if (NULL == freq_ctrl_ptr->workqueue) {
 			pr_err("%s: creat workqueue error\n", __func__);
 			goto free_ddr_req;
 		}
-		INIT_WORK(&freq_ctrl_ptr->work, hisi_blk_freq_ctrl_work);
-		INIT_DELAYED_WORK(&freq_ctrl_ptr->del_work,
-			delete_freq_req_work);
 	}
 	goto out;
 free_ddr_req:
@@ -4,7 +4,11 @@
 #define FREQ_REQ_ADD				1
 #define FREQ_REQ_REMOVE				0
 
+struct request;
+
 void hisi_blk_freq_request(int req_type, int time_in_queue);
+void hisi_blk_freq_bytes(unsigned int bytes);
+void hisi_blk_freq_complete(struct request *rq, unsigned long duration);
 void hisi_blk_freq_ctrl_init(void);
 
 #endif
@@ -26,6 +26,9 @@
 #include <linux/compiler.h>
 #include <linux/blktrace_api.h>
 #include <linux/hrtimer.h>
+#include <linux/wbt.h>
+
+#include "blk-stat.h"
 
 /*
  * enum row_queue_prio - Priorities of the ROW queues
@@ -171,6 +174,31 @@ struct starvation_data {
 	int				starvation_counter;
 };
 
+#ifdef CONFIG_IOSCHED_ROW_LATENCY
+/* Number of I/O priority classes served by ROW: RT, BE and IDLE */
+#define ROW_LAT_CLASSES			3
+/* Adaptive read quantum never goes beyond this multiple of the quantum */
+#define ROW_LAT_QUANTUM_MAX_MULT	8
+/* Async writes allowed in flight while reads miss their target */
+#define ROW_LAT_WRITE_DEPTH		1
+
+/**
+ * struct row_lat_data - read latency feedback of a priority class
+ * @stat:		read completion latencies of the current blk-stat
+ *			window
+ * @nr_over:		reads in @stat that completed after @target_us
+ * @target_us:		target read latency (usec), 0 disables the feedback
+ * @quantum_mult:	multiplier applied to the read queue quantum
+ *
+ */
+struct row_lat_data {
+	struct blk_rq_stat	stat;
+	unsigned int		nr_over;
+	int			target_us;
+	int			quantum_mult;
+};
+#endif
+
 /**
  * struct row_queue - Per block device rqueue structure
  * @dispatch_queue:	dispatch rqueue
@@ -187,6 +215,9 @@ struct starvation_data {
  * @reg_prio_starvation: starvation data for REGULAR priority queues
  * @low_prio_starvation: starvation data for LOW priority queues
  * @cycle_flags:	used for marking unserved queueus
+ * @lat_data:		read latency feedback, one per priority class
+ * @nr_async_in_flight: async writes dispatched and not yet completed
+ * @throttle_until:	async writes are throttled until this time (nsec)
  *
  */
 struct row_data {
@@ -206,6 +237,12 @@ struct row_data {
 	struct starvation_data		low_prio_starvation;
 
 	unsigned int			cycle_flags;
+
+#ifdef CONFIG_IOSCHED_ROW_LATENCY
+	struct row_lat_data		lat_data[ROW_LAT_CLASSES];
+	unsigned int			nr_async_in_flight;
+	u64				throttle_until;
+#endif
 };
 
 #define RQ_ROWQ(rq) ((struct row_queue *) ((rq)->elv.priv[0]))
@@ -246,6 +283,181 @@ static inline void __maybe_unused row_dump_queues_stat(struct row_data *rd)
 			rd->row_queues[i].nr_req);
 }
 
+#ifdef CONFIG_IOSCHED_ROW_LATENCY
+static inline struct row_lat_data *row_lat_data(struct row_data *rd,
+						enum row_queue_prio qnum)
+{
+	if (qnum < ROWQ_REG_PRIO_IDX)
+		return &rd->lat_data[0];
+	if (qnum < ROWQ_LOW_PRIO_IDX)
+		return &rd->lat_data[1];
+	return &rd->lat_data[2];
+}
+
+/*
+ * row_rowq_quantum() - Return the dispatch quantum of a queue
+ * @rd:		pointer to struct row_data
+ * @qnum:	queue index
+ *
+ * The read queue of a class with a latency target gets its quantum
+ * scaled by the feedback from the completed reads.
+ */
+static int row_rowq_quantum(struct row_data *rd, enum row_queue_prio qnum)
+{
+	struct row_lat_data *lat = row_lat_data(rd, qnum);
+	int quantum = rd->row_queues[qnum].disp_quantum;
+
+	if (lat->target_us && (qnum == ROWQ_PRIO_HIGH_READ ||
+	    qnum == ROWQ_PRIO_REG_READ || qnum == ROWQ_PRIO_LOW_READ))
+		quantum *= lat->quantum_mult;
+	return quantum;
+}
+
+/*
+ * row_rowq_throttled() - Check if async writes have to wait
+ * @rd:		pointer to struct row_data
+ * @qnum:	queue index
+ * @force:	flag indicating if forced dispatch
+ *
+ * While the reads of some class are over their target only
+ * ROW_LAT_WRITE_DEPTH async writes may be in flight. The completion
+ * of one of these runs the queue again.
+ */
+static bool row_rowq_throttled(struct row_data *rd, enum row_queue_prio qnum,
+			       int force)
+{
+	if (qnum != ROWQ_PRIO_REG_WRITE || force || !rd->throttle_until)
+		return false;
+	if (!rd->nr_reqs[READ] ||
+	    rd->nr_async_in_flight < ROW_LAT_WRITE_DEPTH)
+		return false;
+	if (ktime_to_ns(ktime_get()) >= rd->throttle_until) {
+		rd->throttle_until = 0;
+		return false;
+	}
+	return true;
+}
+
+/*
+ * row_lat_window_done() - Adapt to the reads of an expired blk-stat window
+ * @rd:		pointer to struct row_data
+ * @lat:	latency data of the class
+ * @now:	current time (nsec)
+ *
+ * The window p99 is over the target iff more than 1% of its reads
+ * completed late. Such a window doubles the read quantum of the class
+ * and throttles async writes for the next window, a window with no
+ * late read at all halves the quantum back.
+ */
+static void row_lat_window_done(struct row_data *rd, struct row_lat_data *lat,
+				u64 now)
+{
+	s64 nr_samples = lat->stat.nr_samples;
+
+	if (!nr_samples)
+		goto out;
+
+	if ((s64)lat->nr_over * 100 > nr_samples) {
+		lat->quantum_mult = min(lat->quantum_mult * 2,
+					ROW_LAT_QUANTUM_MAX_MULT);
+		rd->throttle_until = now + BLK_STAT_NSEC;
+	} else if (!lat->nr_over && lat->quantum_mult > 1) {
+		lat->quantum_mult /= 2;
+	}
+
+	row_log(rd->dispatch_queue,
+		"class %d: %lld reads, %u late, mean=%lldns, mult=%d",
+		(int)(lat - rd->lat_data), nr_samples, lat->nr_over,
+		lat->stat.mean, lat->quantum_mult);
+out:
+	lat->nr_over = 0;
+}
+
+/*
+ * row_lat_completed_req() - Feed a completed request to the latency loop
+ * @rd:		pointer to struct row_data
+ * @rq:		the completed request
+ *
+ */
+static void row_lat_completed_req(struct row_data *rd, struct request *rq)
+{
+	struct row_queue *rqueue = RQ_ROWQ(rq);
+	struct row_lat_data *lat;
+	u64 now, issued;
+
+	if (rqueue->prio == ROWQ_PRIO_REG_WRITE) {
+		if (rd->nr_async_in_flight)
+			rd->nr_async_in_flight--;
+		return;
+	}
+
+	lat = row_lat_data(rd, rqueue->prio);
+	if (rq_data_dir(rq) != READ || !lat->target_us)
+		return;
+
+	issued = wbt_issue_stat_get_time(&rq->wb_stat);
+	now = ktime_to_ns(ktime_get());
+	if (!issued || now < issued)
+		return;
+
+	/* blk_stat_add() is about to start a new window */
+	if ((now & BLK_STAT_MASK) != (lat->stat.time & BLK_STAT_MASK))
+		row_lat_window_done(rd, lat, now);
+
+	blk_stat_add(&lat->stat, rq);
+	if (now - issued > (u64)lat->target_us * NSEC_PER_USEC)
+		lat->nr_over++;
+}
+
+static void row_lat_dispatch_insert(struct row_data *rd, struct request *rq)
+{
+	if (RQ_ROWQ(rq)->prio == ROWQ_PRIO_REG_WRITE)
+		rd->nr_async_in_flight++;
+	/*
+	 * wbt sets the issue time again once the driver takes the request,
+	 * this covers queues that have wbt disabled.
+	 */
+	else if (rq_data_dir(rq) == READ)
+		wbt_issue_stat_set_time(&rq->wb_stat);
+}
+
+static void row_lat_init(struct row_data *rd)
+{
+	int i;
+
+	for (i = 0; i < ROW_LAT_CLASSES; i++) {
+		blk_stat_init(&rd->lat_data[i].stat);
+		rd->lat_data[i].quantum_mult = 1;
+	}
+}
+#else
+static inline int row_rowq_quantum(struct row_data *rd,
+				   enum row_queue_prio qnum)
+{
+	return rd->row_queues[qnum].disp_quantum;
+}
+
+static inline bool row_rowq_throttled(struct row_data *rd,
+				      enum row_queue_prio qnum, int force)
+{
+	return false;
+}
+
+static inline void row_lat_completed_req(struct row_data *rd,
+					 struct request *rq)
+{
+}
+
+static inline void row_lat_dispatch_insert(struct row_data *rd,
+					   struct request *rq)
+{
+}
+
+static inline void row_lat_init(struct row_data *rd)
+{
+}
+#endif
+
 /******************** Static helper functions ***********************/
 static void kick_queue(struct work_struct *work)
 {
@@ -418,6 +630,10 @@ static int row_reinsert_req(struct request_queue *q,
 	list_add(&rq->queuelist, &rqueue->fifo);
 	rd->nr_reqs[rq_data_dir(rq)]++;
 	rqueue->nr_req++;
+#ifdef CONFIG_IOSCHED_ROW_LATENCY
+	if (rqueue->prio == ROWQ_PRIO_REG_WRITE && rd->nr_async_in_flight)
+		rd->nr_async_in_flight--;
+#endif
 
 	row_log_rowq(rd, rqueue->prio,
 		"%s request reinserted (total on queue=%d)",
@@ -461,6 +677,7 @@ static void row_completed_req(struct request_queue *q, struct request *rq)
 		rd->urgent_in_flight = false;
 		rq->cmd_flags &= ~REQ_URGENT;
 	}
+	row_lat_completed_req(rd, rq);
 	row_log(q, "completed %s %s req.",
 		(rq->cmd_flags & REQ_URGENT ? "URGENT" : "regular"),
 		(rq_data_dir(rq) == READ ? "READ" : "WRITE"));
@@ -524,6 +741,7 @@ static void row_dispatch_insert(struct row_data *rd, struct request *rq)
 
 	row_remove_request(rd, rq);
 	elv_dispatch_sort(rd->dispatch_queue, rq);
+	row_lat_dispatch_insert(rd, rq);
 	if (rq->cmd_flags & REQ_URGENT) {
 		WARN_ON(rd->urgent_in_flight);
 		rd->urgent_in_flight = true;
@@ -661,7 +879,7 @@ static void row_restart_cycle(struct row_data *rd,
 	row_dump_queues_stat(rd);
 	for (i = start_idx; i < end_idx; i++) {
 		if (rd->row_queues[i].nr_dispatched <
-		    rd->row_queues[i].disp_quantum)
+		    row_rowq_quantum(rd, i))
 			row_mark_rowq_unserved(rd, i);
 		rd->row_queues[i].nr_dispatched = 0;
 	}
@@ -675,12 +893,13 @@ static void row_restart_cycle(struct row_data *rd,
  * @rd:		pointer to struct row_data
  * @start_idx/end_idx: indexes in the row_queues array to select a queue
  *                 from.
+ * @force:	flag indicating if forced dispatch
  *
  * Return index of the queues to dispatch from. Error code if fails.
  *
  */
 static int row_get_next_queue(struct request_queue *q, struct row_data *rd,
-				int start_idx, int end_idx)
+				int start_idx, int end_idx, int force)
 {
 	int i = start_idx;
 	bool restart = true;
@@ -689,7 +908,8 @@ static int row_get_next_queue(struct request_queue *q, struct row_data *rd,
 	do {
 		if (list_empty(&rd->row_queues[i].fifo) ||
 		    rd->row_queues[i].nr_dispatched >=
-		    rd->row_queues[i].disp_quantum) {
+		    row_rowq_quantum(rd, i) ||
+		    row_rowq_throttled(rd, i, force)) {
 			i++;
 			if (i == end_idx && restart) {
 				/* Restart cycle for this priority class */
@@ -761,7 +981,7 @@ static int row_dispatch_requests(struct request_queue *q, int force)
 		goto done;
 	}
 
-	currq = row_get_next_queue(q, rd, start_idx, end_idx);
+	currq = row_get_next_queue(q, rd, start_idx, end_idx, force);
 
 	/* Dispatch */
 	if (currq >= 0) {
@@ -815,6 +1035,7 @@ static int row_init_queue(struct request_queue *q, struct elevator_type *e)
 			ROW_REG_STARVATION_TOLLERANCE;
 	rdata->low_prio_starvation.starvation_limit =
 			ROW_LOW_STARVATION_TOLLERANCE;
+	row_lat_init(rdata);
 	/*
 	 * Currently idling is enabled only for READ queues. If we want to
 	 * enable it for write queues also, note that idling frequency will
@@ -996,6 +1217,11 @@ SHOW_FUNCTION(row_reg_starv_limit_show,
 	rowd->reg_prio_starvation.starvation_limit);
 SHOW_FUNCTION(row_low_starv_limit_show,
 	rowd->low_prio_starvation.starvation_limit);
+#ifdef CONFIG_IOSCHED_ROW_LATENCY
+SHOW_FUNCTION(row_hp_read_target_us_show, rowd->lat_data[0].target_us);
+SHOW_FUNCTION(row_rp_read_target_us_show, rowd->lat_data[1].target_us);
+SHOW_FUNCTION(row_lp_read_target_us_show, rowd->lat_data[2].target_us);
+#endif
 #undef SHOW_FUNCTION
 
 #define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX)			\
@@ -1042,6 +1268,14 @@ STORE_FUNCTION(row_reg_starv_limit_store,
 STORE_FUNCTION(row_low_starv_limit_store,
 			&rowd->low_prio_starvation.starvation_limit,
 			1, INT_MAX);
+#ifdef CONFIG_IOSCHED_ROW_LATENCY
+STORE_FUNCTION(row_hp_read_target_us_store, &rowd->lat_data[0].target_us,
+			0, INT_MAX);
+STORE_FUNCTION(row_rp_read_target_us_store, &rowd->lat_data[1].target_us,
+			0, INT_MAX);
+STORE_FUNCTION(row_lp_read_target_us_store, &rowd->lat_data[2].target_us,
+			0, INT_MAX);
+#endif
 
 #undef STORE_FUNCTION
 
@@ -1061,6 +1295,11 @@ static struct elv_fs_entry row_attrs[] = {
 	ROW_ATTR(rd_idle_data_freq),
 	ROW_ATTR(reg_starv_limit),
 	ROW_ATTR(low_starv_limit),
+#ifdef CONFIG_IOSCHED_ROW_LATENCY
+	ROW_ATTR(hp_read_target_us),
+	ROW_ATTR(rp_read_target_us),
+	ROW_ATTR(lp_read_target_us),
+#endif
 	__ATTR_NULL
 };
 
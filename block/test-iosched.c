@@ -223,6 +223,8 @@ int test_iosched_add_unique_test_req(struct test_iosched *tios,
 	test_rq->req_result = -EINVAL;
 	test_rq->rq = rq;
 	test_rq->is_err_expected = is_err_expcted;
+	if (tios->test_info.get_rq_disk_fn)
+		rq->rq_disk = tios->test_info.get_rq_disk_fn(tios);
 	rq->elv.priv[0] = (void *)test_rq;
 	test_rq->req_id = tios->unique_next_req_id++;
 
@@ -997,6 +999,7 @@ static int test_dispatch_from(struct request_queue *q,
 		spin_unlock_irqrestore(&tios->lock, flags);
 
 		print_req(rq);
+		test_rq->dispatch_time = ktime_get();
 		elv_dispatch_sort(q, rq);
 		tios->test_info.test_byte_count += test_rq->buf_size;
 		ret = 1;
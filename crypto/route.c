@@ -0,0 +1,439 @@
+/*
+ * route: size based dispatch between a crypto engine and the CPU
+ *
+ * route(hw,cpu) takes the driver names of two implementations of the same
+ * block cipher mode, typically an async hardware engine and the ARMv8 CE
+ * code. Requests of at least route_threshold bytes go to the engine as
+ * long as fewer than route_queue_depth of them are in flight there, all
+ * others are handled on the CPU, where a small request is cheaper than
+ * the round trip through the engine queue and its interrupt.
+ *
+ * The instance takes the cra_name of its children at a higher priority,
+ * so once it is instantiated, e.g. through the routes= parameter, plain
+ * "xts(aes)" users such as dm-crypt and ext4 encryption get it.
+ *
+ * Copyright (c) 2018 Hisilicon Technologies CO., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ */
+
+#include <crypto/algapi.h>
+#include <crypto/internal/skcipher.h>
+#include <linux/atomic.h>
+#include <linux/debugfs.h>
+#include <linux/err.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/list.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+
+#define ROUTE_PRIORITY_BOOST	100
+
+static unsigned int route_threshold = 4096;
+module_param(route_threshold, uint, 0644);
+MODULE_PARM_DESC(route_threshold,
+		 "Smallest request in bytes sent to the engine");
+
+static unsigned int route_queue_depth = 64;
+module_param(route_queue_depth, uint, 0644);
+MODULE_PARM_DESC(route_queue_depth,
+		 "Engine requests in flight before the CPU takes the rest");
+
+static char *routes = "";
+module_param(routes, charp, 0444);
+MODULE_PARM_DESC(routes,
+		 "hw,cpu driver name pairs separated by ';' to set up at boot");
+
+struct route_stats {
+	atomic64_t hw_reqs;
+	atomic64_t hw_bytes;
+	atomic64_t cpu_reqs;
+	atomic64_t cpu_bytes;
+	atomic64_t cpu_ns;
+	atomic_t hw_inflight;
+};
+
+struct route_instance_ctx {
+	struct crypto_skcipher_spawn hw;
+	struct crypto_skcipher_spawn cpu;
+	struct route_stats stats;
+	struct crypto_instance *inst;
+	struct list_head list;
+};
+
+struct route_ctx {
+	struct crypto_ablkcipher *hw;
+	struct crypto_ablkcipher *cpu;
+	struct route_stats *stats;
+};
+
+struct route_req_ctx {
+	struct ablkcipher_request subreq;
+};
+
+static LIST_HEAD(route_instances);
+static DEFINE_MUTEX(route_mutex);
+
+static int route_setkey(struct crypto_ablkcipher *parent, const u8 *key,
+			unsigned int keylen)
+{
+	struct route_ctx *ctx = crypto_ablkcipher_ctx(parent);
+	struct crypto_ablkcipher *children[] = { ctx->hw, ctx->cpu };
+	int i, err = 0;
+
+	for (i = 0; i < ARRAY_SIZE(children) && !err; i++) {
+		struct crypto_ablkcipher *child = children[i];
+
+		crypto_ablkcipher_clear_flags(child, CRYPTO_TFM_REQ_MASK);
+		crypto_ablkcipher_set_flags(child,
+					    crypto_ablkcipher_get_flags(parent) &
+					    CRYPTO_TFM_REQ_MASK);
+		err = crypto_ablkcipher_setkey(child, key, keylen);
+		crypto_ablkcipher_set_flags(parent,
+					    crypto_ablkcipher_get_flags(child) &
+					    CRYPTO_TFM_RES_MASK);
+	}
+	return err;
+}
+
+static void route_hw_done(struct crypto_async_request *areq, int err)
+{
+	struct ablkcipher_request *req = areq->data;
+	struct route_ctx *ctx =
+		crypto_ablkcipher_ctx(crypto_ablkcipher_reqtfm(req));
+
+	/* a backlogged request moved to the queue, still in flight */
+	if (err != -EINPROGRESS)
+		atomic_dec(&ctx->stats->hw_inflight);
+	ablkcipher_request_complete(req, err);
+}
+
+static int route_crypt(struct ablkcipher_request *req, bool encrypt)
+{
+	struct route_ctx *ctx =
+		crypto_ablkcipher_ctx(crypto_ablkcipher_reqtfm(req));
+	struct route_req_ctx *rctx = ablkcipher_request_ctx(req);
+	struct ablkcipher_request *subreq = &rctx->subreq;
+	struct route_stats *stats = ctx->stats;
+	bool big = req->nbytes >= ACCESS_ONCE(route_threshold);
+	u64 start;
+	int err;
+
+	ablkcipher_request_set_crypt(subreq, req->src, req->dst, req->nbytes,
+				     req->info);
+
+	if (big && atomic_inc_return(&stats->hw_inflight) <=
+			ACCESS_ONCE(route_queue_depth)) {
+		ablkcipher_request_set_tfm(subreq, ctx->hw);
+		ablkcipher_request_set_callback(subreq, req->base.flags,
+						route_hw_done, req);
+		atomic64_inc(&stats->hw_reqs);
+		atomic64_add(req->nbytes, &stats->hw_bytes);
+		err = encrypt ? crypto_ablkcipher_encrypt(subreq) :
+				crypto_ablkcipher_decrypt(subreq);
+		/* route_hw_done() follows for queued requests only */
+		if (err != -EINPROGRESS &&
+		    !(err == -EBUSY &&
+		      (req->base.flags & CRYPTO_TFM_REQ_MAY_BACKLOG)))
+			atomic_dec(&stats->hw_inflight);
+		return err;
+	}
+	if (big)
+		atomic_dec(&stats->hw_inflight);
+
+	ablkcipher_request_set_tfm(subreq, ctx->cpu);
+	ablkcipher_request_set_callback(subreq, req->base.flags,
+					req->base.complete, req->base.data);
+	atomic64_inc(&stats->cpu_reqs);
+	atomic64_add(req->nbytes, &stats->cpu_bytes);
+	start = local_clock();
+	err = encrypt ? crypto_ablkcipher_encrypt(subreq) :
+			crypto_ablkcipher_decrypt(subreq);
+	atomic64_add(local_clock() - start, &stats->cpu_ns);
+	return err;
+}
+
+static int route_encrypt(struct ablkcipher_request *req)
+{
+	return route_crypt(req, true);
+}
+
+static int route_decrypt(struct ablkcipher_request *req)
+{
+	return route_crypt(req, false);
+}
+
+static int route_init_tfm(struct crypto_tfm *tfm)
+{
+	struct crypto_instance *inst = (void *)tfm->__crt_alg;
+	struct route_instance_ctx *ictx = crypto_instance_ctx(inst);
+	struct route_ctx *ctx = crypto_tfm_ctx(tfm);
+	struct crypto_ablkcipher *hw, *cpu;
+
+	hw = crypto_spawn_skcipher(&ictx->hw);
+	if (IS_ERR(hw))
+		return PTR_ERR(hw);
+
+	cpu = crypto_spawn_skcipher(&ictx->cpu);
+	if (IS_ERR(cpu)) {
+		crypto_free_ablkcipher(hw);
+		return PTR_ERR(cpu);
+	}
+
+	ctx->hw = hw;
+	ctx->cpu = cpu;
+	ctx->stats = &ictx->stats;
+	tfm->crt_ablkcipher.reqsize = sizeof(struct route_req_ctx) +
+		max(crypto_ablkcipher_reqsize(hw),
+		    crypto_ablkcipher_reqsize(cpu));
+	return 0;
+}
+
+static void route_exit_tfm(struct crypto_tfm *tfm)
+{
+	struct route_ctx *ctx = crypto_tfm_ctx(tfm);
+
+	crypto_free_ablkcipher(ctx->cpu);
+	crypto_free_ablkcipher(ctx->hw);
+}
+
+static struct crypto_instance *route_alloc(struct rtattr **tb)
+{
+	struct crypto_attr_type *algt;
+	struct crypto_instance *inst;
+	struct route_instance_ctx *ictx;
+	struct crypto_alg *hw, *cpu;
+	const char *hw_name, *cpu_name;
+	int err;
+
+	algt = crypto_get_attr_type(tb);
+	if (IS_ERR(algt))
+		return ERR_CAST(algt);
+
+	if ((algt->type ^ CRYPTO_ALG_TYPE_BLKCIPHER) & algt->mask)
+		return ERR_PTR(-EINVAL);
+
+	hw_name = crypto_attr_alg_name(tb[1]);
+	if (IS_ERR(hw_name))
+		return ERR_CAST(hw_name);
+	cpu_name = crypto_attr_alg_name(tb[2]);
+	if (IS_ERR(cpu_name))
+		return ERR_CAST(cpu_name);
+
+	inst = kzalloc(sizeof(*inst) + sizeof(*ictx), GFP_KERNEL);
+	if (!inst)
+		return ERR_PTR(-ENOMEM);
+
+	ictx = crypto_instance_ctx(inst);
+	ictx->inst = inst;
+
+	crypto_set_skcipher_spawn(&ictx->hw, inst);
+	err = crypto_grab_skcipher(&ictx->hw, hw_name, 0, 0);
+	if (err)
+		goto err_free_inst;
+
+	crypto_set_skcipher_spawn(&ictx->cpu, inst);
+	err = crypto_grab_skcipher(&ictx->cpu, cpu_name, 0, 0);
+	if (err)
+		goto err_drop_hw;
+
+	hw = crypto_skcipher_spawn_alg(&ictx->hw);
+	cpu = crypto_skcipher_spawn_alg(&ictx->cpu);
+
+	/* both must do the same thing on the same keys and IVs */
+	err = -EINVAL;
+	if (strcmp(hw->cra_name, cpu->cra_name) ||
+	    hw->cra_blocksize != cpu->cra_blocksize ||
+	    hw->cra_ablkcipher.ivsize != cpu->cra_ablkcipher.ivsize)
+		goto err_drop_cpu;
+
+	memcpy(inst->alg.cra_name, hw->cra_name, CRYPTO_MAX_ALG_NAME);
+	err = -ENAMETOOLONG;
+	if (snprintf(inst->alg.cra_driver_name, CRYPTO_MAX_ALG_NAME,
+		     "route(%s,%s)", hw->cra_driver_name,
+		     cpu->cra_driver_name) >= CRYPTO_MAX_ALG_NAME)
+		goto err_drop_cpu;
+
+	inst->alg.cra_priority = max(hw->cra_priority, cpu->cra_priority) +
+				 ROUTE_PRIORITY_BOOST;
+	inst->alg.cra_blocksize = hw->cra_blocksize;
+	inst->alg.cra_alignmask = hw->cra_alignmask | cpu->cra_alignmask;
+
+	inst->alg.cra_flags = CRYPTO_ALG_TYPE_ABLKCIPHER | CRYPTO_ALG_ASYNC;
+	inst->alg.cra_type = &crypto_ablkcipher_type;
+
+	inst->alg.cra_ablkcipher.ivsize = hw->cra_ablkcipher.ivsize;
+	inst->alg.cra_ablkcipher.min_keysize =
+		max(hw->cra_ablkcipher.min_keysize,
+		    cpu->cra_ablkcipher.min_keysize);
+	inst->alg.cra_ablkcipher.max_keysize =
+		min(hw->cra_ablkcipher.max_keysize,
+		    cpu->cra_ablkcipher.max_keysize);
+	inst->alg.cra_ablkcipher.geniv = hw->cra_ablkcipher.geniv;
+
+	inst->alg.cra_ablkcipher.setkey = route_setkey;
+	inst->alg.cra_ablkcipher.encrypt = route_encrypt;
+	inst->alg.cra_ablkcipher.decrypt = route_decrypt;
+
+	inst->alg.cra_ctxsize = sizeof(struct route_ctx);
+
+	inst->alg.cra_init = route_init_tfm;
+	inst->alg.cra_exit = route_exit_tfm;
+
+	mutex_lock(&route_mutex);
+	list_add_tail(&ictx->list, &route_instances);
+	mutex_unlock(&route_mutex);
+
+	return inst;
+
+err_drop_cpu:
+	crypto_drop_skcipher(&ictx->cpu);
+err_drop_hw:
+	crypto_drop_skcipher(&ictx->hw);
+err_free_inst:
+	kfree(inst);
+	return ERR_PTR(err);
+}
+
+static void route_free(struct crypto_instance *inst)
+{
+	struct route_instance_ctx *ictx = crypto_instance_ctx(inst);
+
+	mutex_lock(&route_mutex);
+	list_del(&ictx->list);
+	mutex_unlock(&route_mutex);
+
+	crypto_drop_skcipher(&ictx->cpu);
+	crypto_drop_skcipher(&ictx->hw);
+	kfree(inst);
+}
+
+static struct crypto_template route_tmpl = {
+	.name = "route",
+	.alloc = route_alloc,
+	.free = route_free,
+	.module = THIS_MODULE,
+};
+
+/*
+ * The CPU time the engine saved is estimated from what the CPU path
+ * costs per byte on this device.
+ */
+static int route_stats_show(struct seq_file *m, void *v)
+{
+	struct route_instance_ctx *ictx;
+
+	seq_printf(m, "threshold %u queue_depth %u\n",
+		   route_threshold, route_queue_depth);
+
+	mutex_lock(&route_mutex);
+	list_for_each_entry(ictx, &route_instances, list) {
+		struct route_stats *s = &ictx->stats;
+		u64 hw_bytes = atomic64_read(&s->hw_bytes);
+		u64 cpu_bytes = atomic64_read(&s->cpu_bytes);
+		u64 cpu_ns = atomic64_read(&s->cpu_ns);
+		u64 saved_us = 0;
+
+		if (cpu_bytes)
+			saved_us = div64_u64(hw_bytes, cpu_bytes) * cpu_ns +
+				   div64_u64((hw_bytes % cpu_bytes) * cpu_ns,
+					     cpu_bytes);
+		do_div(saved_us, NSEC_PER_USEC);
+
+		seq_printf(m, "%s\n", ictx->inst->alg.cra_driver_name);
+		seq_printf(m, "  hw:  %llu reqs %llu bytes %d inflight\n",
+			   (u64)atomic64_read(&s->hw_reqs), hw_bytes,
+			   atomic_read(&s->hw_inflight));
+		seq_printf(m, "  cpu: %llu reqs %llu bytes %llu us\n",
+			   (u64)atomic64_read(&s->cpu_reqs), cpu_bytes,
+			   cpu_ns / NSEC_PER_USEC);
+		seq_printf(m, "  cpu saved: ~%llu us\n", saved_us);
+	}
+	mutex_unlock(&route_mutex);
+	return 0;
+}
+
+static int route_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, route_stats_show, NULL);
+}
+
+static const struct file_operations route_stats_fops = {
+	.open		= route_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static struct dentry *route_debugfs;
+
+/* instantiate "hw,cpu;hw,cpu" from the routes= parameter */
+static void __init route_setup(void)
+{
+	char *buf, *cur, *pair;
+	char name[CRYPTO_MAX_ALG_NAME];
+	struct crypto_ablkcipher *tfm;
+
+	buf = kstrdup(routes, GFP_KERNEL);
+	if (!buf)
+		return;
+
+	cur = buf;
+	while ((pair = strsep(&cur, ";")) != NULL) {
+		pair = strim(pair);
+		if (!*pair)
+			continue;
+		if (snprintf(name, sizeof(name), "route(%s)", pair) >=
+		    sizeof(name))
+			continue;
+		/* the instance stays registered once the tfm is gone */
+		tfm = crypto_alloc_ablkcipher(name, 0, 0);
+		if (IS_ERR(tfm)) {
+			pr_warn("route: %s unavailable: %ld\n", name,
+				PTR_ERR(tfm));
+			continue;
+		}
+		pr_info("route: %s serves %s\n",
+			crypto_tfm_alg_driver_name(crypto_ablkcipher_tfm(tfm)),
+			crypto_tfm_alg_name(crypto_ablkcipher_tfm(tfm)));
+		crypto_free_ablkcipher(tfm);
+	}
+	kfree(buf);
+}
+
+static int __init route_module_init(void)
+{
+	int err;
+
+	err = crypto_register_template(&route_tmpl);
+	if (err)
+		return err;
+
+	route_debugfs = debugfs_create_file("crypto_route", S_IRUGO, NULL,
+					    NULL, &route_stats_fops);
+	route_setup();
+	return 0;
+}
+
+static void __exit route_module_exit(void)
+{
+	debugfs_remove(route_debugfs);
+	crypto_unregister_template(&route_tmpl);
+}
+
+/* after the engine and CE drivers have registered */
+late_initcall(route_module_init);
+module_exit(route_module_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Size based dispatch between a crypto engine and the CPU");
+MODULE_ALIAS_CRYPTO("route");
@@ -33,6 +33,9 @@
 #include <linux/cpuidle.h>
 #include <linux/timer.h>
 #include <linux/wakeup_reason.h>
+#include <linux/slab.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #if defined CONFIG_LOG_JANK
 #include <huawei_platform/log/log_jank.h>
@@ -75,6 +78,27 @@ struct dpm_drv_wd_data {
 
 static int async_error;
 
+/*
+ * Ordering between devices that are not parent and child, declared with
+ * device_pm_add_dependency(): a supplier suspends after its consumers and
+ * resumes before them. This is what lets drivers that drive each other
+ * through function calls rather than the device tree go async.
+ */
+struct dpm_dependency {
+	struct list_head	node;
+	struct device		*consumer;
+	struct device		*supplier;
+};
+
+#define DPM_MAX_DEPS	8	/* per device and direction */
+
+static LIST_HEAD(dpm_dependencies);
+static DEFINE_MUTEX(dpm_deps_mtx);
+
+/* resume-type transitions, for charging callback time to the right side */
+#define PM_EVENT_RESUME_MASK	(PM_EVENT_RESUME | PM_EVENT_THAW | \
+				 PM_EVENT_RESTORE | PM_EVENT_RECOVER)
+
 static char *pm_verb(int event)
 {
 	switch (event) {
@@ -147,6 +171,20 @@ void device_pm_add(struct device *dev)
 	mutex_unlock(&dpm_list_mtx);
 }
 
+static void dpm_remove_dependencies(struct device *dev)
+{
+	struct dpm_dependency *dep, *tmp;
+
+	mutex_lock(&dpm_deps_mtx);
+	list_for_each_entry_safe(dep, tmp, &dpm_dependencies, node) {
+		if (dep->consumer == dev || dep->supplier == dev) {
+			list_del(&dep->node);
+			kfree(dep);
+		}
+	}
+	mutex_unlock(&dpm_deps_mtx);
+}
+
 /**
  * device_pm_remove - Remove a device from the PM core's list of active devices.
  * @dev: Device to be removed from the list.
@@ -159,6 +197,7 @@ void device_pm_remove(struct device *dev)
 	mutex_lock(&dpm_list_mtx);
 	list_del_init(&dev->power.entry);
 	mutex_unlock(&dpm_list_mtx);
+	dpm_remove_dependencies(dev);
 	device_wakeup_disable(dev);
 	pm_runtime_remove(dev);
 }
@@ -256,6 +295,47 @@ static void dpm_wait_for_children(struct device *dev, bool async)
        device_for_each_child(dev, &async, dpm_wait_fn);
 }
 
+/*
+ * Wait for the suppliers (resume) or consumers (suspend) of @dev. They are
+ * collected first, as waiting under dpm_deps_mtx would stall the other
+ * async threads looking up their own.
+ */
+static void dpm_wait_for_deps(struct device *dev, bool async, bool suppliers)
+{
+	struct device *wait_for[DPM_MAX_DEPS];
+	struct dpm_dependency *dep;
+	int i, n = 0;
+
+	if (list_empty(&dpm_dependencies))
+		return;
+
+	mutex_lock(&dpm_deps_mtx);
+	list_for_each_entry(dep, &dpm_dependencies, node) {
+		if (suppliers && dep->consumer == dev)
+			wait_for[n++] = get_device(dep->supplier);
+		else if (!suppliers && dep->supplier == dev)
+			wait_for[n++] = get_device(dep->consumer);
+		if (n == DPM_MAX_DEPS)
+			break;
+	}
+	mutex_unlock(&dpm_deps_mtx);
+
+	for (i = 0; i < n; i++) {
+		dpm_wait(wait_for[i], async);
+		put_device(wait_for[i]);
+	}
+}
+
+static void dpm_wait_for_suppliers(struct device *dev, bool async)
+{
+	dpm_wait_for_deps(dev, async, true);
+}
+
+static void dpm_wait_for_consumers(struct device *dev, bool async)
+{
+	dpm_wait_for_deps(dev, async, false);
+}
+
 /**
  * pm_op - Return the PM operation appropriate for given PM event.
  * @ops: PM operations to choose from.
@@ -401,7 +481,8 @@ static void dpm_show_time(ktime_t starttime, pm_message_t state, char *info)
 static int dpm_run_callback(pm_callback_t cb, struct device *dev,
 			    pm_message_t state, char *info)
 {
-	ktime_t calltime;
+	ktime_t calltime, start;
+	u32 usecs;
 	int error;
 
 	if (!cb)
@@ -411,10 +492,17 @@ static int dpm_run_callback(pm_callback_t cb, struct device *dev,
 
 	pm_dev_dbg(dev, state, info);
 	trace_device_pm_callback_start(dev, info, state.event);
+	start = ktime_get();
 	error = cb(dev);
+	usecs = ktime_us_delta(ktime_get(), start);
 	trace_device_pm_callback_end(dev, error);
 	suspend_report_result(cb, error);
 
+	if (state.event & PM_EVENT_RESUME_MASK)
+		dev->power.resume_time_us += usecs;
+	else
+		dev->power.suspend_time_us += usecs;
+
 	initcall_debug_report(dev, calltime, error, state, info);
 
 	return error;
@@ -520,6 +608,7 @@ static int device_resume_noirq(struct device *dev, pm_message_t state, bool asyn
 		goto Out;
 
 	dpm_wait(dev->parent, async);
+	dpm_wait_for_suppliers(dev, async);
 
 	if (dev->pm_domain) {
 		info = "noirq power domain ";
@@ -649,6 +738,7 @@ static int device_resume_early(struct device *dev, pm_message_t state, bool asyn
 		goto Out;
 
 	dpm_wait(dev->parent, async);
+	dpm_wait_for_suppliers(dev, async);
 
 	if (dev->pm_domain) {
 		info = "early power domain ";
@@ -781,6 +871,7 @@ static int device_resume(struct device *dev, pm_message_t state, bool async)
 	}
 
 	dpm_wait(dev->parent, async);
+	dpm_wait_for_suppliers(dev, async);
 	dpm_watchdog_set(&wd, dev);
 	device_lock(dev);
 
@@ -1097,6 +1188,7 @@ static int __device_suspend_noirq(struct device *dev, pm_message_t state, bool a
 		goto Complete;
 
 	dpm_wait_for_children(dev, async);
+	dpm_wait_for_consumers(dev, async);
 
 	if (dev->pm_domain) {
 		info = "noirq power domain ";
@@ -1243,6 +1335,7 @@ static int __device_suspend_late(struct device *dev, pm_message_t state, bool as
 		goto Complete;
 
 	dpm_wait_for_children(dev, async);
+	dpm_wait_for_consumers(dev, async);
 
 	if (dev->pm_domain) {
 		info = "late power domain ";
@@ -1419,6 +1512,7 @@ static int __device_suspend(struct device *dev, pm_message_t state, bool async)
 	TRACE_SUSPEND(0);
 
 	dpm_wait_for_children(dev, async);
+	dpm_wait_for_consumers(dev, async);
 
 	if (async_error)
 		goto Complete;
@@ -1638,6 +1732,9 @@ static int device_prepare(struct device *dev, pm_message_t state)
 	if (dev->power.syscore)
 		return 0;
 
+	dev->power.suspend_time_us = 0;
+	dev->power.resume_time_us = 0;
+
 	/*
 	 * If a device's parent goes into runtime suspend at the wrong time,
 	 * it won't be possible to resume the device.  To prevent this we
@@ -1801,3 +1898,112 @@ void dpm_for_each_dev(void *data, void (*fn)(struct device *, void *))
 	device_pm_unlock();
 }
 EXPORT_SYMBOL_GPL(dpm_for_each_dev);
+
+static int dpm_count_deps(struct device *dev, bool as_consumer)
+{
+	struct dpm_dependency *dep;
+	int n = 0;
+
+	list_for_each_entry(dep, &dpm_dependencies, node)
+		if ((as_consumer ? dep->consumer : dep->supplier) == dev)
+			n++;
+	return n;
+}
+
+/**
+ * device_pm_add_dependency - Order system suspend/resume of two devices.
+ * @consumer: Device that uses @supplier.
+ * @supplier: Device that must stay active while @consumer suspends and
+ *	      resume before it.
+ *
+ * For devices that are not parent and child but where one calls into the
+ * other from its callbacks, so that both can be marked async. @supplier
+ * must come before @consumer in dpm_list, i.e. have been registered first,
+ * as is the case when @consumer is created by @supplier's probe. The
+ * dependency goes away when either device is unregistered.
+ */
+int device_pm_add_dependency(struct device *consumer, struct device *supplier)
+{
+	struct dpm_dependency *dep;
+	struct list_head *pos;
+	bool ordered = false;
+	int error = 0;
+
+	if (consumer == supplier)
+		return -EINVAL;
+
+	mutex_lock(&dpm_list_mtx);
+	if (!list_empty(&supplier->power.entry))
+		for (pos = supplier->power.entry.next; pos != &dpm_list;
+		     pos = pos->next)
+			if (pos == &consumer->power.entry) {
+				ordered = true;
+				break;
+			}
+	mutex_unlock(&dpm_list_mtx);
+	if (!ordered) {
+		dev_warn(consumer, "PM: supplier %s is not before it\n",
+			 dev_name(supplier));
+		return -EINVAL;
+	}
+
+	dep = kmalloc(sizeof(*dep), GFP_KERNEL);
+	if (!dep)
+		return -ENOMEM;
+	dep->consumer = consumer;
+	dep->supplier = supplier;
+
+	mutex_lock(&dpm_deps_mtx);
+	if (dpm_count_deps(consumer, true) >= DPM_MAX_DEPS ||
+	    dpm_count_deps(supplier, false) >= DPM_MAX_DEPS) {
+		error = -ENOSPC;
+		kfree(dep);
+	} else {
+		list_add_tail(&dep->node, &dpm_dependencies);
+	}
+	mutex_unlock(&dpm_deps_mtx);
+
+	return error;
+}
+EXPORT_SYMBOL_GPL(device_pm_add_dependency);
+
+#ifdef CONFIG_DEBUG_FS
+/* callback time of each device in the last suspend and resume */
+static int dpm_times_show(struct seq_file *s, void *unused)
+{
+	struct device *dev;
+
+	seq_puts(s, "device                           suspend_us  resume_us async\n");
+	device_pm_lock();
+	list_for_each_entry(dev, &dpm_list, power.entry) {
+		if (!dev->power.suspend_time_us && !dev->power.resume_time_us)
+			continue;
+		seq_printf(s, "%-32s %10u %10u %5u\n", dev_name(dev),
+			   dev->power.suspend_time_us,
+			   dev->power.resume_time_us,
+			   dev->power.async_suspend);
+	}
+	device_pm_unlock();
+	return 0;
+}
+
+static int dpm_times_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, dpm_times_show, NULL);
+}
+
+static const struct file_operations dpm_times_fops = {
+	.open		= dpm_times_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init dpm_debugfs_init(void)
+{
+	debugfs_create_file("pm_device_times", S_IRUGO, NULL, NULL,
+			    &dpm_times_fops);
+	return 0;
+}
+late_initcall(dpm_debugfs_init);
+#endif
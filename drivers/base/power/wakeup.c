@@ -14,6 +14,7 @@
 #include <linux/suspend.h>
 #include <linux/seq_file.h>
 #include <linux/debugfs.h>
+#include <linux/percpu.h>
 #include <linux/types.h>
 #include <trace/events/power.h>
 
@@ -44,26 +45,60 @@ static bool pm_abort_suspend __read_mostly;
  * Combined counters of registered wakeup events and wakeup events in progress.
  * They need to be modified together atomically, so it's better to use one
  * atomic variable to hold them both.
+ *
+ * The variable is per-CPU, so that wakeup sources activated and relaxed all
+ * over the system don't bounce one cache line between the CPUs.  Both updates
+ * are additions, so the sum over all CPUs is what the single counter would
+ * hold; a source may be activated on one CPU and relaxed on another, which
+ * makes the in-progress part of one CPU's value wrap below zero.
  */
-static atomic_t combined_event_count = ATOMIC_INIT(0);
+static DEFINE_PER_CPU(atomic_t, combined_event_count);
 
 #define IN_PROGRESS_BITS	(sizeof(int) * 4)
 #define MAX_IN_PROGRESS		((1 << IN_PROGRESS_BITS) - 1)
 
 static void split_counters(unsigned int *cnt, unsigned int *inpr)
 {
-	unsigned int comb = atomic_read(&combined_event_count);
+	unsigned int comb;
+	int cpu;
+
+	/*
+	 * The sum is not a snapshot: it may see a source relaxed on one CPU
+	 * but not activated on another, which shows up as a negative number
+	 * of events in progress.  Sum again until the result makes sense.
+	 */
+	for (;;) {
+		comb = 0;
+		for_each_possible_cpu(cpu)
+			comb += atomic_read(per_cpu_ptr(&combined_event_count, cpu));
+
+		if ((comb & MAX_IN_PROGRESS) <= MAX_IN_PROGRESS / 2)
+			break;
+		cpu_relax();
+	}
 
 	*cnt = (comb >> IN_PROGRESS_BITS);
 	*inpr = comb & MAX_IN_PROGRESS;
 }
 
+/* Must be called under the wakeup source's lock, with interrupts off. */
+static unsigned int combined_event_add(unsigned int val)
+{
+	return atomic_add_return(val, this_cpu_ptr(&combined_event_count));
+}
+
+static inline bool wakeup_source_prevents_sleep(struct wakeup_source *ws)
+{
+	return ws->autosleep_enabled || ws->suspend_wait;
+}
+
 /* A preserved old value of the events counter. */
 static unsigned int saved_count;
 
 static DEFINE_SPINLOCK(events_lock);
 
 static void pm_wakeup_timer_fn(unsigned long data);
+static void pm_wakeup_suspend_wait(bool set);
 
 static LIST_HEAD(wakeup_sources);
 
@@ -413,11 +448,11 @@ static void wakeup_source_activate(struct wakeup_source *ws)
 	ws->active = true;
 	ws->active_count++;
 	ws->last_time = ktime_get();
-	if (ws->autosleep_enabled)
+	if (wakeup_source_prevents_sleep(ws))
 		ws->start_prevent_time = ws->last_time;
 
 	/* Increment the counter of events in progress. */
-	cec = atomic_inc_return(&combined_event_count);
+	cec = combined_event_add(1);
 
 	trace_wakeup_source_activate(ws->name, cec);
 #ifdef CONFIG_HUAWEI_BDAT
@@ -487,16 +522,11 @@ void pm_stay_awake(struct device *dev)
 }
 EXPORT_SYMBOL_GPL(pm_stay_awake);
 
-#ifdef CONFIG_PM_AUTOSLEEP
 static void update_prevent_sleep_time(struct wakeup_source *ws, ktime_t now)
 {
 	ktime_t delta = ktime_sub(now, ws->start_prevent_time);
 	ws->prevent_sleep_time = ktime_add(ws->prevent_sleep_time, delta);
 }
-#else
-static inline void update_prevent_sleep_time(struct wakeup_source *ws,
-					     ktime_t now) {}
-#endif
 
 /**
  * wakup_source_deactivate - Mark given wakeup source as inactive.
@@ -539,19 +569,21 @@ static void wakeup_source_deactivate(struct wakeup_source *ws)
 	del_timer(&ws->timer);
 	ws->timer_expires = 0;
 
-	if (ws->autosleep_enabled)
+	if (wakeup_source_prevents_sleep(ws))
 		update_prevent_sleep_time(ws, now);
 
 	/*
 	 * Increment the counter of registered wakeup events and decrement the
 	 * couter of wakeup events in progress simultaneously.
 	 */
-	cec = atomic_add_return(MAX_IN_PROGRESS, &combined_event_count);
+	cec = combined_event_add(MAX_IN_PROGRESS);
 	trace_wakeup_source_deactivate(ws->name, cec);
 
-	split_counters(&cnt, &inpr);
-	if (!inpr && waitqueue_active(&wakeup_count_wait_queue))
-		wake_up(&wakeup_count_wait_queue);
+	if (waitqueue_active(&wakeup_count_wait_queue)) {
+		split_counters(&cnt, &inpr);
+		if (!inpr)
+			wake_up(&wakeup_count_wait_queue);
+	}
 #ifdef CONFIG_HUAWEI_BDAT
 	bdat_update_wakelock(ws->name, ws->active);
 #endif
@@ -810,6 +842,7 @@ bool pm_get_wakeup_count(unsigned int *count, bool block)
 
 	if (block) {
 		DEFINE_WAIT(wait);
+		bool waited = false;
 
 		for (;;) {
 			prepare_to_wait(&wakeup_count_wait_queue, &wait,
@@ -820,10 +853,16 @@ bool pm_get_wakeup_count(unsigned int *count, bool block)
 #ifdef CONFIG_HW_PTM
 			pm_print_active_wakeup_sources();
 #endif
+			if (!waited) {
+				pm_wakeup_suspend_wait(true);
+				waited = true;
+			}
 
 			schedule();
 		}
 		finish_wait(&wakeup_count_wait_queue, &wait);
+		if (waited)
+			pm_wakeup_suspend_wait(false);
 	}
 
 	split_counters(&cnt, &inpr);
@@ -857,32 +896,67 @@ bool pm_save_wakeup_count(unsigned int count)
 	return events_check_enabled;
 }
 
-#ifdef CONFIG_PM_AUTOSLEEP
 /**
- * pm_wakep_autosleep_enabled - Modify autosleep_enabled for all wakeup sources.
- * @enabled: Whether to set or to clear the autosleep_enabled flags.
+ * wakeup_sources_set_prevent - Modify a sleep preventing flag of all sources.
+ * @autosleep: Whether to modify autosleep_enabled or suspend_wait.
+ * @set: Whether to set or to clear the flags.
+ *
+ * Start or stop accounting the time active wakeup sources prevent the system
+ * from sleeping, as their state changes.
  */
-void pm_wakep_autosleep_enabled(bool set)
+static void wakeup_sources_set_prevent(bool autosleep, bool set)
 {
 	struct wakeup_source *ws;
 	ktime_t now = ktime_get();
+	bool was;
 
 	rcu_read_lock();
 	list_for_each_entry_rcu(ws, &wakeup_sources, entry) {
 		spin_lock_irq(&ws->lock);
-		if (ws->autosleep_enabled != set) {
+		was = wakeup_source_prevents_sleep(ws);
+		if (autosleep)
 			ws->autosleep_enabled = set;
-			if (ws->active) {
-				if (set)
-					ws->start_prevent_time = now;
-				else
-					update_prevent_sleep_time(ws, now);
-			}
+		else
+			ws->suspend_wait = set;
+		if (ws->active && was != wakeup_source_prevents_sleep(ws)) {
+			if (set)
+				ws->start_prevent_time = now;
+			else
+				update_prevent_sleep_time(ws, now);
 		}
 		spin_unlock_irq(&ws->lock);
 	}
 	rcu_read_unlock();
 }
+
+static DEFINE_MUTEX(suspend_wait_lock);
+static unsigned int suspend_waiters;
+
+/**
+ * pm_wakeup_suspend_wait - Account a suspend blocked on wakeup sources.
+ * @set: Whether a suspend starts or stops waiting for events in progress.
+ *
+ * While a suspend waits in pm_get_wakeup_count(), the active wakeup sources
+ * are what keeps the system up, so count that time as preventing sleep even
+ * without autosleep.
+ */
+static void pm_wakeup_suspend_wait(bool set)
+{
+	mutex_lock(&suspend_wait_lock);
+	if (set ? !suspend_waiters++ : !--suspend_waiters)
+		wakeup_sources_set_prevent(false, set);
+	mutex_unlock(&suspend_wait_lock);
+}
+
+#ifdef CONFIG_PM_AUTOSLEEP
+/**
+ * pm_wakep_autosleep_enabled - Modify autosleep_enabled for all wakeup sources.
+ * @enabled: Whether to set or to clear the autosleep_enabled flags.
+ */
+void pm_wakep_autosleep_enabled(bool set)
+{
+	wakeup_sources_set_prevent(true, set);
+}
 #endif /* CONFIG_PM_AUTOSLEEP */
 
 static struct dentry *wakeup_sources_stats_dentry;
@@ -916,7 +990,7 @@ static int print_wakeup_source_stats(struct seq_file *m,
 		if (active_time.tv64 > max_time.tv64)
 			max_time = active_time;
 
-		if (ws->autosleep_enabled)
+		if (wakeup_source_prevents_sleep(ws))
 			prevent_sleep_time = ktime_add(prevent_sleep_time,
 				ktime_sub(now, ws->start_prevent_time));
 	} else {
@@ -965,7 +1039,7 @@ static int print_active_wakeup_source(struct seq_file *m,
 		if (active_time.tv64 > max_time.tv64)
 			max_time = active_time;
 
-		if (ws->autosleep_enabled)
+		if (wakeup_source_prevents_sleep(ws))
 			prevent_sleep_time = ktime_add(prevent_sleep_time,
 				ktime_sub(now, ws->start_prevent_time));
 
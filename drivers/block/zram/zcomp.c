@@ -13,12 +13,17 @@
 #include <linux/slab.h>
 #include <linux/wait.h>
 #include <linux/sched.h>
+#include <linux/percpu.h>
+#include <linux/gfp.h>
 
 #include "zcomp.h"
 #include "zcomp_lzo.h"
 #ifdef CONFIG_ZRAM_LZ4_COMPRESS
 #include "zcomp_lz4.h"
 #endif
+#ifdef CONFIG_ZRAM_LZ4HC_COMPRESS
+#include "zcomp_lz4hc.h"
+#endif
 
 /*
  * single zcomp_strm backend
@@ -47,6 +52,9 @@ static struct zcomp_backend *backends[] = {
 	&zcomp_lzo,
 #ifdef CONFIG_ZRAM_LZ4_COMPRESS
 	&zcomp_lz4,
+#endif
+#ifdef CONFIG_ZRAM_LZ4HC_COMPRESS
+	&zcomp_lz4hc,
 #endif
 	NULL
 };
@@ -275,6 +283,45 @@ static int zcomp_strm_single_create(struct zcomp *comp)
 	return 0;
 }
 
+static void zcomp_dstrm_destroy(struct zcomp *comp)
+{
+	int cpu;
+
+	if (!comp->dstrm)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		struct zcomp_dstrm *dstrm = per_cpu_ptr(comp->dstrm, cpu);
+
+		if (dstrm->buffer)
+			free_page((unsigned long)dstrm->buffer);
+	}
+	free_percpu(comp->dstrm);
+	comp->dstrm = NULL;
+}
+
+static int zcomp_dstrm_create(struct zcomp *comp)
+{
+	int cpu;
+
+	comp->dstrm = alloc_percpu(struct zcomp_dstrm);
+	if (!comp->dstrm)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		struct zcomp_dstrm *dstrm = per_cpu_ptr(comp->dstrm, cpu);
+		struct page *page;
+
+		page = alloc_pages_node(cpu_to_node(cpu), GFP_KERNEL, 0);
+		if (!page) {
+			zcomp_dstrm_destroy(comp);
+			return -ENOMEM;
+		}
+		dstrm->buffer = page_address(page);
+	}
+	return 0;
+}
+
 /* show available compressors */
 ssize_t zcomp_available_show(const char *comp, char *buf)
 {
@@ -314,6 +361,20 @@ void zcomp_strm_release(struct zcomp *comp, struct zcomp_strm *zstrm)
 	comp->strm_release(comp, zstrm);
 }
 
+/*
+ * get this cpu's decompression buffer. Preemption stays disabled until
+ * the matching zcomp_dstrm_put(), so the caller must not sleep.
+ */
+void *zcomp_dstrm_get(struct zcomp *comp)
+{
+	return get_cpu_ptr(comp->dstrm)->buffer;
+}
+
+void zcomp_dstrm_put(struct zcomp *comp)
+{
+	put_cpu_ptr(comp->dstrm);
+}
+
 int zcomp_compress(struct zcomp *comp, struct zcomp_strm *zstrm,
 		const unsigned char *src, size_t *dst_len)
 {
@@ -329,6 +390,7 @@ int zcomp_decompress(struct zcomp *comp, const unsigned char *src,
 
 void zcomp_destroy(struct zcomp *comp)
 {
+	zcomp_dstrm_destroy(comp);
 	comp->destroy(comp);
 	kfree(comp);
 }
@@ -356,11 +418,18 @@ struct zcomp *zcomp_create(const char *compress, int max_strm)
 		return ERR_PTR(-ENOMEM);
 
 	comp->backend = backend;
+	error = zcomp_dstrm_create(comp);
+	if (error) {
+		kfree(comp);
+		return ERR_PTR(error);
+	}
+
 	if (max_strm > 1)
 		error = zcomp_strm_multi_create(comp, max_strm);
 	else
 		error = zcomp_strm_single_create(comp);
 	if (error) {
+		zcomp_dstrm_destroy(comp);
 		kfree(comp);
 		return ERR_PTR(error);
 	}
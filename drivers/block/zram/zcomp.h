@@ -25,6 +25,15 @@ struct zcomp_strm {
 	struct list_head list;
 };
 
+/*
+ * per-cpu decompression buffer. Decompression needs no backend working
+ * memory, so the read side only needs a scratch page and can avoid the
+ * compression stream pool (and its locks) entirely.
+ */
+struct zcomp_dstrm {
+	void *buffer;
+};
+
 /* static compression backend */
 struct zcomp_backend {
 	int (*compress)(const unsigned char *src, unsigned char *dst,
@@ -42,6 +51,7 @@ struct zcomp_backend {
 /* dynamic per-device compression frontend */
 struct zcomp {
 	void *stream;
+	struct zcomp_dstrm __percpu *dstrm;
 	struct zcomp_backend *backend;
 
 	struct zcomp_strm *(*strm_find)(struct zcomp *comp);
@@ -66,4 +76,7 @@ int zcomp_decompress(struct zcomp *comp, const unsigned char *src,
 		size_t src_len, unsigned char *dst);
 
 bool zcomp_set_max_streams(struct zcomp *comp, int num_strm);
+
+void *zcomp_dstrm_get(struct zcomp *comp);
+void zcomp_dstrm_put(struct zcomp *comp);
 #endif /* _ZCOMP_H_ */
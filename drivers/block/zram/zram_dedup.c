@@ -0,0 +1,218 @@
+/*
+ * Copyright (C) 2017 Huawei Technologies Co., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version
+ * 2 of the License, or (at your option) any later version.
+ */
+
+#define KMSG_COMPONENT "zram"
+#define pr_fmt(fmt) KMSG_COMPONENT ": " fmt
+
+#include <linux/crc32.h>
+#include <linux/ktime.h>
+#include <linux/log2.h>
+#include <linux/rbtree.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+
+#include "zram_drv.h"
+
+/* one hash bucket per this many pages of disksize */
+#define ZRAM_HASH_SHIFT		6
+#define ZRAM_HASH_SIZE_MIN	(1 << 10)
+#define ZRAM_HASH_SIZE_MAX	(1 << 20)
+
+u32 zram_dedup_checksum(unsigned char *mem)
+{
+	return crc32_le(0, mem, PAGE_SIZE);
+}
+
+static struct zram_hash *zram_dedup_hash(struct zram_meta *meta,
+					u32 checksum)
+{
+	return &meta->hash[checksum & (meta->hash_size - 1)];
+}
+
+/* called with the bucket lock held, so it must not sleep */
+static bool zram_dedup_match(struct zram *zram, struct zram_entry *entry,
+				unsigned char *mem)
+{
+	struct zs_pool *pool = zram->meta->mem_pool;
+	unsigned char *cmem, *buf;
+	bool match;
+
+	cmem = zs_map_object(pool, entry->handle, ZS_MM_RO);
+	if (entry->len == PAGE_SIZE) {
+		match = !memcmp(mem, cmem, PAGE_SIZE);
+	} else {
+		buf = zcomp_dstrm_get(zram->comp);
+		match = !zcomp_decompress(zram->comp, cmem, entry->len, buf) &&
+			!memcmp(mem, buf, PAGE_SIZE);
+		zcomp_dstrm_put(zram->comp);
+	}
+	zs_unmap_object(pool, entry->handle);
+
+	return match;
+}
+
+/*
+ * Look for a stored object with the same contents as @mem and take a
+ * reference on it. Different pages can share a checksum, so every
+ * entry with a matching checksum is compared in full.
+ */
+struct zram_entry *zram_dedup_find(struct zram *zram, unsigned char *mem,
+				u32 checksum)
+{
+	struct zram_hash *hash = zram_dedup_hash(zram->meta, checksum);
+	struct zram_entry *entry = NULL, *cur;
+	struct rb_node *node, *prev;
+	ktime_t start = ktime_get();
+
+	spin_lock(&hash->lock);
+	node = hash->rb_root.rb_node;
+	while (node) {
+		cur = rb_entry(node, struct zram_entry, rb_node);
+		if (checksum == cur->checksum)
+			break;
+		node = checksum < cur->checksum ? node->rb_left :
+						node->rb_right;
+	}
+
+	if (node) {
+		/* rewind to the first entry with this checksum */
+		while ((prev = rb_prev(node)) &&
+			rb_entry(prev, struct zram_entry, rb_node)->checksum ==
+				checksum)
+			node = prev;
+
+		for (; node; node = rb_next(node)) {
+			cur = rb_entry(node, struct zram_entry, rb_node);
+			if (cur->checksum != checksum)
+				break;
+			if (zram_dedup_match(zram, cur, mem)) {
+				cur->refcount++;
+				entry = cur;
+				break;
+			}
+		}
+	}
+	spin_unlock(&hash->lock);
+
+	atomic64_inc(&zram->stats.dedup_lookups);
+	atomic64_add(ktime_to_ns(ktime_sub(ktime_get(), start)),
+			&zram->stats.dedup_ns);
+	if (entry) {
+		atomic64_inc(&zram->stats.dedup_hits);
+		atomic64_add(entry->len, &zram->stats.dup_data_size);
+	}
+
+	return entry;
+}
+
+/*
+ * Make a freshly stored object findable. Returns NULL if no entry could
+ * be allocated, in which case the object is simply not shared.
+ */
+struct zram_entry *zram_dedup_insert(struct zram *zram, unsigned long handle,
+				unsigned int len, u32 checksum)
+{
+	struct zram_hash *hash = zram_dedup_hash(zram->meta, checksum);
+	struct zram_entry *entry, *cur;
+	struct rb_node **rb_node, *parent = NULL;
+
+	entry = kmalloc(sizeof(*entry), GFP_NOIO | __GFP_NORETRY |
+			__GFP_NOWARN);
+	if (!entry)
+		return NULL;
+
+	entry->checksum = checksum;
+	entry->refcount = 1;
+	entry->handle = handle;
+	entry->len = len;
+
+	spin_lock(&hash->lock);
+	rb_node = &hash->rb_root.rb_node;
+	while (*rb_node) {
+		parent = *rb_node;
+		cur = rb_entry(parent, struct zram_entry, rb_node);
+		if (checksum < cur->checksum)
+			rb_node = &parent->rb_left;
+		else
+			rb_node = &parent->rb_right;
+	}
+	rb_link_node(&entry->rb_node, parent, rb_node);
+	rb_insert_color(&entry->rb_node, &hash->rb_root);
+	spin_unlock(&hash->lock);
+
+	return entry;
+}
+
+/*
+ * Drop a slot's reference on @entry. Returns true if that was the last
+ * one and the object has been freed.
+ */
+bool zram_dedup_put(struct zram *zram, struct zram_entry *entry)
+{
+	struct zram_meta *meta = zram->meta;
+	struct zram_hash *hash = zram_dedup_hash(meta, entry->checksum);
+
+	spin_lock(&hash->lock);
+	if (--entry->refcount) {
+		spin_unlock(&hash->lock);
+		atomic64_sub(entry->len, &zram->stats.dup_data_size);
+		return false;
+	}
+	rb_erase(&entry->rb_node, &hash->rb_root);
+	spin_unlock(&hash->lock);
+
+	zs_free(meta->mem_pool, entry->handle);
+	kfree(entry);
+
+	return true;
+}
+
+int zram_dedup_init(struct zram_meta *meta, size_t num_pages)
+{
+	size_t i;
+
+	meta->hash_size = clamp_t(size_t, num_pages >> ZRAM_HASH_SHIFT,
+				ZRAM_HASH_SIZE_MIN, ZRAM_HASH_SIZE_MAX);
+	meta->hash_size = roundup_pow_of_two(meta->hash_size);
+	meta->hash = vzalloc(meta->hash_size * sizeof(struct zram_hash));
+	if (!meta->hash) {
+		pr_err("Error allocating zram entry hash\n");
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < meta->hash_size; i++) {
+		spin_lock_init(&meta->hash[i].lock);
+		meta->hash[i].rb_root = RB_ROOT;
+	}
+
+	return 0;
+}
+
+/* free every shared object, the slots referring to them are gone */
+void zram_dedup_fini(struct zram_meta *meta)
+{
+	struct zram_entry *entry;
+	struct rb_node *node;
+	size_t i;
+
+	if (!meta->hash)
+		return;
+
+	for (i = 0; i < meta->hash_size; i++) {
+		while ((node = rb_first(&meta->hash[i].rb_root))) {
+			entry = rb_entry(node, struct zram_entry, rb_node);
+			rb_erase(node, &meta->hash[i].rb_root);
+			zs_free(meta->mem_pool, entry->handle);
+			kfree(entry);
+		}
+	}
+
+	vfree(meta->hash);
+	meta->hash = NULL;
+}
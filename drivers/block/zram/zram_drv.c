@@ -30,6 +30,11 @@
 #include <linux/err.h>
 #include <linux/idr.h>
 #include <linux/sysfs.h>
+#include <linux/workqueue.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
+#include <linux/ktime.h>
+#include <linux/rcc.h>
 
 #include "zram_drv.h"
 
@@ -38,6 +43,8 @@ static DEFINE_IDR(zram_index_idr);
 static DEFINE_MUTEX(zram_index_mutex);
 
 static int zram_major;
+static struct workqueue_struct *zram_read_wq;
+static struct workqueue_struct *zram_write_wq;
 static const char *default_compressor = "lzo";
 
 /* Module params (documentation at end) */
@@ -157,33 +164,68 @@ static inline void update_used_max(struct zram *zram,
 	} while (old_max != cur_max);
 }
 
-static bool page_zero_filled(void *ptr)
+static void zram_fill_element(void *ptr, unsigned long len,
+			unsigned long value)
 {
+	unsigned long *page = ptr;
 	unsigned int pos;
-	unsigned long *page;
 
-	page = (unsigned long *)ptr;
+	if (!value) {
+		memset(ptr, 0, len);
+		return;
+	}
+
+	for (pos = 0; pos < len / sizeof(*page); pos++)
+		page[pos] = value;
+}
+
+/*
+ * A word-at-a-time scan is already bound by memory bandwidth for one
+ * page, and kernel_neon_begin() would cost more than it saves here.
+ */
+static bool page_same_filled(void *ptr, unsigned long *element)
+{
+	unsigned long *page = ptr;
+	unsigned int pos, last = PAGE_SIZE / sizeof(*page) - 1;
+	unsigned long val = page[0];
 
-	for (pos = 0; pos != PAGE_SIZE / sizeof(*page); pos++) {
-		if (page[pos])
+	/* pages that are not uniform usually differ at the end already */
+	if (val != page[last])
+		return false;
+
+	for (pos = 1; pos < last; pos++) {
+		if (page[pos] != val)
 			return false;
 	}
 
+	*element = val;
 	return true;
 }
 
-static void handle_zero_page(struct bio_vec *bvec)
+static void handle_same_page(struct zram *zram, struct bio_vec *bvec,
+			int offset, unsigned long element)
 {
 	struct page *page = bvec->bv_page;
-	void *user_mem;
+	void *user_mem, *buf = NULL;
+
+	/* the pattern has to line up with the zram page, not the bvec */
+	if (is_partial_io(bvec) && element) {
+		buf = zcomp_dstrm_get(zram->comp);
+		zram_fill_element(buf, PAGE_SIZE, element);
+	}
 
 	user_mem = kmap_atomic(page);
-	if (is_partial_io(bvec))
+	if (buf)
+		memcpy(user_mem + bvec->bv_offset, buf + offset, bvec->bv_len);
+	else if (is_partial_io(bvec))
 		memset(user_mem + bvec->bv_offset, 0, bvec->bv_len);
 	else
-		clear_page(user_mem);
+		zram_fill_element(user_mem, PAGE_SIZE, element);
 	kunmap_atomic(user_mem);
 
+	if (buf)
+		zcomp_dstrm_put(zram->comp);
+
 	flush_dcache_page(page);
 }
 
@@ -346,6 +388,83 @@ out:
 	return ret;
 }
 
+static ssize_t parallel_read_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+
+	return scnprintf(buf, PAGE_SIZE, "%d\n", READ_ONCE(zram->parallel_read));
+}
+
+static ssize_t parallel_read_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	bool val;
+	int ret;
+
+	ret = strtobool(buf, &val);
+	if (ret)
+		return ret;
+
+	WRITE_ONCE(zram->parallel_read, val);
+	return len;
+}
+
+#ifdef CONFIG_ZRAM_DEDUP
+static ssize_t use_dedup_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	bool val;
+	struct zram *zram = dev_to_zram(dev);
+
+	down_read(&zram->init_lock);
+	val = zram->use_dedup;
+	up_read(&zram->init_lock);
+
+	return scnprintf(buf, PAGE_SIZE, "%d\n", (int)val);
+}
+
+static ssize_t use_dedup_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	bool val;
+	struct zram *zram = dev_to_zram(dev);
+
+	if (strtobool(buf, &val))
+		return -EINVAL;
+
+	down_write(&zram->init_lock);
+	if (init_done(zram)) {
+		up_write(&zram->init_lock);
+		pr_info("Can't change dedup usage for initialized device\n");
+		return -EBUSY;
+	}
+	zram->use_dedup = val;
+	up_write(&zram->init_lock);
+
+	return len;
+}
+
+static ssize_t dedup_stat_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+	ssize_t ret;
+
+	down_read(&zram->init_lock);
+	ret = scnprintf(buf, PAGE_SIZE,
+			"%8llu %8llu %8llu %8llu\n",
+			(u64)atomic64_read(&zram->stats.dup_data_size),
+			(u64)atomic64_read(&zram->stats.dedup_hits),
+			(u64)atomic64_read(&zram->stats.dedup_lookups),
+			(u64)atomic64_read(&zram->stats.dedup_ns));
+	up_read(&zram->init_lock);
+
+	return ret;
+}
+#endif
+
 static ssize_t comp_algorithm_show(struct device *dev,
 		struct device_attribute *attr, char *buf)
 {
@@ -385,217 +504,775 @@ static ssize_t comp_algorithm_store(struct device *dev,
 	return len;
 }
 
-static ssize_t compact_store(struct device *dev,
-		struct device_attribute *attr, const char *buf, size_t len)
+static ssize_t async_write_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
 {
 	struct zram *zram = dev_to_zram(dev);
-	struct zram_meta *meta;
 
-	down_read(&zram->init_lock);
-	if (!init_done(zram)) {
-		up_read(&zram->init_lock);
-		return -EINVAL;
-	}
+	return scnprintf(buf, PAGE_SIZE, "%d\n", READ_ONCE(zram->async_write));
+}
 
-	meta = zram->meta;
-	zs_compact(meta->mem_pool);
-	up_read(&zram->init_lock);
+static ssize_t async_write_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	bool val;
+	int ret;
+
+	ret = strtobool(buf, &val);
+	if (ret)
+		return ret;
 
+	WRITE_ONCE(zram->async_write, val);
 	return len;
 }
 
-static ssize_t io_stat_show(struct device *dev,
+static ssize_t recomp_algorithm_show(struct device *dev,
 		struct device_attribute *attr, char *buf)
 {
+	size_t sz;
 	struct zram *zram = dev_to_zram(dev);
-	ssize_t ret;
 
 	down_read(&zram->init_lock);
-	ret = scnprintf(buf, PAGE_SIZE,
-			"%8llu %8llu %8llu %8llu\n",
-			(u64)atomic64_read(&zram->stats.failed_reads),
-			(u64)atomic64_read(&zram->stats.failed_writes),
-			(u64)atomic64_read(&zram->stats.invalid_io),
-			(u64)atomic64_read(&zram->stats.notify_free));
+	sz = zcomp_available_show(zram->recomp_algorithm, buf);
 	up_read(&zram->init_lock);
 
-	return ret;
+	return sz;
 }
 
-static ssize_t mm_stat_show(struct device *dev,
-		struct device_attribute *attr, char *buf)
+static ssize_t recomp_algorithm_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
 {
 	struct zram *zram = dev_to_zram(dev);
-	struct zs_pool_stats pool_stats;
-	u64 orig_size, mem_used = 0;
-	long max_used;
-	ssize_t ret;
+	size_t sz;
 
-	memset(&pool_stats, 0x00, sizeof(struct zs_pool_stats));
+	if (!sysfs_streq(buf, "none") && !zcomp_available_algorithm(buf))
+		return -EINVAL;
 
-	down_read(&zram->init_lock);
+	down_write(&zram->init_lock);
 	if (init_done(zram)) {
-		mem_used = zs_get_total_pages(zram->meta->mem_pool);
-		zs_pool_stats(zram->meta->mem_pool, &pool_stats);
+		up_write(&zram->init_lock);
+		pr_info("Can't change algorithm for initialized device\n");
+		return -EBUSY;
 	}
 
-	orig_size = atomic64_read(&zram->stats.pages_stored);
-	max_used = atomic_long_read(&zram->stats.max_used_pages);
-
-	ret = scnprintf(buf, PAGE_SIZE,
-			"%8llu %8llu %8llu %8lu %8ld %8llu %8lu\n",
-			orig_size << PAGE_SHIFT,
-			(u64)atomic64_read(&zram->stats.compr_data_size),
-			mem_used << PAGE_SHIFT,
-			zram->limit_pages << PAGE_SHIFT,
-			max_used << PAGE_SHIFT,
-			(u64)atomic64_read(&zram->stats.zero_pages),
-			pool_stats.pages_compacted);
-	up_read(&zram->init_lock);
+	if (sysfs_streq(buf, "none")) {
+		zram->recomp_algorithm[0] = 0x00;
+		up_write(&zram->init_lock);
+		return len;
+	}
 
-	return ret;
-}
+	strlcpy(zram->recomp_algorithm, buf, sizeof(zram->recomp_algorithm));
 
-static DEVICE_ATTR_RO(io_stat);
-static DEVICE_ATTR_RO(mm_stat);
-ZRAM_ATTR_RO(num_reads);
-ZRAM_ATTR_RO(num_writes);
-ZRAM_ATTR_RO(failed_reads);
-ZRAM_ATTR_RO(failed_writes);
-ZRAM_ATTR_RO(invalid_io);
-ZRAM_ATTR_RO(notify_free);
-ZRAM_ATTR_RO(zero_pages);
-ZRAM_ATTR_RO(compr_data_size);
+	/* ignore trailing newline */
+	sz = strlen(zram->recomp_algorithm);
+	if (sz > 0 && zram->recomp_algorithm[sz - 1] == '\n')
+		zram->recomp_algorithm[sz - 1] = 0x00;
 
-static inline bool zram_meta_get(struct zram *zram)
-{
-	if (atomic_inc_not_zero(&zram->refcount))
-		return true;
-	return false;
+	up_write(&zram->init_lock);
+	return len;
 }
 
-static inline void zram_meta_put(struct zram *zram)
+static ssize_t recomp_interval_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
 {
-	atomic_dec(&zram->refcount);
+	struct zram *zram = dev_to_zram(dev);
+
+	return scnprintf(buf, PAGE_SIZE, "%u\n",
+			READ_ONCE(zram->recomp_interval));
 }
 
-static void zram_meta_free(struct zram_meta *meta, u64 disksize)
+static ssize_t recomp_interval_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
 {
-	size_t num_pages = disksize >> PAGE_SHIFT;
-	size_t index;
-
-	/* Free all pages that are still in this zram device */
-	for (index = 0; index < num_pages; index++) {
-		unsigned long handle = meta->table[index].handle;
+	struct zram *zram = dev_to_zram(dev);
+	unsigned int val;
+	int ret;
 
-		if (!handle)
-			continue;
+	ret = kstrtouint(buf, 10, &val);
+	if (ret)
+		return ret;
 
-		zs_free(meta->mem_pool, handle);
-	}
+	down_read(&zram->init_lock);
+	WRITE_ONCE(zram->recomp_interval, val);
+	/* let the thread pick up the new period */
+	if (zram->recomp_thread)
+		wake_up_process(zram->recomp_thread);
+	up_read(&zram->init_lock);
 
-	zs_destroy_pool(meta->mem_pool);
-	vfree(meta->table);
-	kfree(meta);
+	return len;
 }
 
-static struct zram_meta *zram_meta_alloc(char *pool_name, u64 disksize)
+static ssize_t compact_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
 {
-	size_t num_pages;
-	struct zram_meta *meta = kmalloc(sizeof(*meta), GFP_KERNEL);
-
-	if (!meta)
-		return NULL;
-
-	num_pages = disksize >> PAGE_SHIFT;
-	meta->table = vzalloc(num_pages * sizeof(*meta->table));
-	if (!meta->table) {
-		pr_err("Error allocating zram address table\n");
-		goto out_error;
-	}
+	struct zram *zram = dev_to_zram(dev);
+	struct zram_meta *meta;
 
-	meta->mem_pool = zs_create_pool(pool_name, GFP_NOIO | __GFP_HIGHMEM);
-	if (!meta->mem_pool) {
-		pr_err("Error creating memory pool\n");
-		goto out_error;
+	down_read(&zram->init_lock);
+	if (!init_done(zram)) {
+		up_read(&zram->init_lock);
+		return -EINVAL;
 	}
 
-	return meta;
+	meta = zram->meta;
+	zs_compact(meta->mem_pool);
+	up_read(&zram->init_lock);
 
-out_error:
-	vfree(meta->table);
-	kfree(meta);
-	return NULL;
+	return len;
 }
 
-/*
- * To protect concurrent access to the same index entry,
- * caller should hold this table index entry's bit_spinlock to
- * indicate this index entry is accessing.
- */
-static void zram_free_page(struct zram *zram, size_t index)
+/* Must be called with init_lock held and the device initialised */
+static void zram_auto_compact(struct zram *zram, unsigned int threshold)
 {
-	struct zram_meta *meta = zram->meta;
-	unsigned long handle = meta->table[index].handle;
+	struct zs_pool *pool = zram->meta->mem_pool;
+	unsigned long total, compactable;
 
-	if (unlikely(!handle)) {
-		/*
-		 * No memory is allocated for zero filled pages.
-		 * Simply clear zero page flag.
-		 */
-		if (zram_test_flag(meta, index, ZRAM_ZERO)) {
-			zram_clear_flag(meta, index, ZRAM_ZERO);
-			atomic64_dec(&zram->stats.zero_pages);
-		}
+	if (time_before(jiffies, zram->compact_last + ZRAM_COMPACT_INTERVAL))
 		return;
-	}
-
-	zs_free(meta->mem_pool, handle);
 
-	atomic64_sub(zram_get_obj_size(meta, index),
-			&zram->stats.compr_data_size);
-	atomic64_dec(&zram->stats.pages_stored);
+	total = zs_get_total_pages(pool);
+	compactable = zs_compactable_pages(pool);
+	if (!total || compactable * 100 < total * threshold)
+		return;
 
-	meta->table[index].handle = 0;
-	zram_set_obj_size(meta, index, 0);
+	zs_compact(pool);
+	zram->compact_last = jiffies;
+	atomic64_inc(&zram->stats.auto_compactions);
 }
 
-static int zram_decompress_page(struct zram *zram, char *mem, u32 index)
+static void zram_compact_workfn(struct work_struct *work)
 {
-	int ret = 0;
-	unsigned char *cmem;
-	struct zram_meta *meta = zram->meta;
-	unsigned long handle;
-	size_t size;
+	struct zram *zram = container_of(to_delayed_work(work), struct zram,
+					compact_work);
+	unsigned int threshold = READ_ONCE(zram->compact_threshold);
 
-	bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
-	handle = meta->table[index].handle;
-	size = zram_get_obj_size(meta, index);
+	if (!threshold || !READ_ONCE(zram->display_off))
+		return;
 
-	if (!handle || zram_test_flag(meta, index, ZRAM_ZERO)) {
-		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
-		memset(mem, 0, PAGE_SIZE);
-		return 0;
+	/* a reset in progress will be done by the next period */
+	if (down_read_trylock(&zram->init_lock)) {
+		if (!init_done(zram)) {
+			up_read(&zram->init_lock);
+			return;
+		}
+		zram_auto_compact(zram, threshold);
+		up_read(&zram->init_lock);
 	}
 
-	cmem = zs_map_object(meta->mem_pool, handle, ZS_MM_RO);
-	if (size == PAGE_SIZE)
-		memcpy(mem, cmem, PAGE_SIZE);
-	else
-		ret = zcomp_decompress(zram->comp, cmem, size, mem);
-	zs_unmap_object(meta->mem_pool, handle);
-	bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+	queue_delayed_work(system_freezable_power_efficient_wq,
+			&zram->compact_work, ZRAM_COMPACT_INTERVAL);
+}
 
-	/* Should NEVER happen. Return bio error if it does. */
-	if (unlikely(ret)) {
-		pr_err("Decompression failed! err=%d, page=%u\n", ret, index);
-		return ret;
-	}
+static int zram_display_notify(struct notifier_block *nb,
+		unsigned long event, void *data)
+{
+	struct zram *zram = container_of(nb, struct zram, display_nb);
 
-	return 0;
+	WRITE_ONCE(zram->display_off, event == RCC_DISPLAY_OFF);
+	if (event == RCC_DISPLAY_OFF)
+		queue_delayed_work(system_freezable_power_efficient_wq,
+				&zram->compact_work, 0);
+	else
+		cancel_delayed_work(&zram->compact_work);
+
+	return NOTIFY_OK;
 }
 
-static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
+static ssize_t compact_threshold_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+
+	return scnprintf(buf, PAGE_SIZE, "%u\n",
+			READ_ONCE(zram->compact_threshold));
+}
+
+static ssize_t compact_threshold_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	unsigned int val;
+	int ret;
+
+	ret = kstrtouint(buf, 10, &val);
+	if (ret)
+		return ret;
+	if (val > 100)
+		return -EINVAL;
+
+	WRITE_ONCE(zram->compact_threshold, val);
+	if (val && READ_ONCE(zram->display_off))
+		queue_delayed_work(system_freezable_power_efficient_wq,
+				&zram->compact_work, 0);
+
+	return len;
+}
+
+#ifdef CONFIG_ZRAM_WRITEBACK
+static void reset_bdev(struct zram *zram)
+{
+	if (!zram->backing_dev)
+		return;
+
+	blkdev_put(zram->bdev, FMODE_READ | FMODE_WRITE | FMODE_EXCL);
+	filp_close(zram->backing_dev, NULL);
+	zram->backing_dev = NULL;
+	zram->bdev = NULL;
+	zram->nr_blocks = 0;
+	vfree(zram->bitmap);
+	zram->bitmap = NULL;
+}
+
+static ssize_t backing_dev_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+	struct file *file;
+	ssize_t ret;
+	char *p;
+
+	down_read(&zram->init_lock);
+	file = zram->backing_dev;
+	if (!file) {
+		ret = scnprintf(buf, PAGE_SIZE, "none\n");
+		goto out;
+	}
+
+	p = d_path(&file->f_path, buf, PAGE_SIZE - 1);
+	if (IS_ERR(p)) {
+		ret = PTR_ERR(p);
+		goto out;
+	}
+
+	ret = strlen(p);
+	memmove(buf, p, ret);
+	buf[ret++] = '\n';
+out:
+	up_read(&zram->init_lock);
+	return ret;
+}
+
+static ssize_t backing_dev_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	struct file *backing_dev = NULL;
+	struct block_device *bdev = NULL;
+	unsigned long nr_blocks, *bitmap;
+	struct inode *inode;
+	char *file_name;
+	size_t sz;
+	int err;
+
+	file_name = kmalloc(PATH_MAX, GFP_KERNEL);
+	if (!file_name)
+		return -ENOMEM;
+
+	down_write(&zram->init_lock);
+	if (init_done(zram)) {
+		pr_info("Can't setup backing device for initialized device\n");
+		err = -EBUSY;
+		goto out;
+	}
+
+	strlcpy(file_name, buf, PATH_MAX);
+	/* ignore trailing newline */
+	sz = strlen(file_name);
+	if (sz > 0 && file_name[sz - 1] == '\n')
+		file_name[sz - 1] = 0x00;
+
+	backing_dev = filp_open(file_name, O_RDWR | O_LARGEFILE, 0);
+	if (IS_ERR(backing_dev)) {
+		err = PTR_ERR(backing_dev);
+		backing_dev = NULL;
+		goto out;
+	}
+
+	inode = backing_dev->f_mapping->host;
+	/* Only block devices can be used as backing store */
+	if (!S_ISBLK(inode->i_mode)) {
+		err = -ENOTBLK;
+		goto out;
+	}
+
+	bdev = bdgrab(I_BDEV(inode));
+	err = blkdev_get(bdev, FMODE_READ | FMODE_WRITE | FMODE_EXCL, zram);
+	if (err < 0) {
+		/* blkdev_get() has dropped the bdgrab() reference */
+		bdev = NULL;
+		goto out;
+	}
+
+	nr_blocks = i_size_read(inode) >> PAGE_SHIFT;
+	bitmap = vzalloc(BITS_TO_LONGS(nr_blocks) * sizeof(long));
+	if (!bitmap) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	reset_bdev(zram);
+	zram->bdev = bdev;
+	zram->backing_dev = backing_dev;
+	zram->bitmap = bitmap;
+	zram->nr_blocks = nr_blocks;
+	up_write(&zram->init_lock);
+
+	pr_info("setup backing device %s\n", file_name);
+	kfree(file_name);
+	return len;
+
+out:
+	if (bdev)
+		blkdev_put(bdev, FMODE_READ | FMODE_WRITE | FMODE_EXCL);
+	if (backing_dev)
+		filp_close(backing_dev, NULL);
+	up_write(&zram->init_lock);
+	kfree(file_name);
+	return err;
+}
+
+/*
+ * Reserve @nr contiguous blocks on the backing device so a writeback
+ * batch goes out as one sequential bio. Returns 0 if there is no room.
+ */
+static unsigned long alloc_block_bdev(struct zram *zram, unsigned int nr)
+{
+	unsigned long blk_idx;
+
+	spin_lock(&zram->bitmap_lock);
+	/* block 0 is skipped so a stored block never reads as "no handle" */
+	blk_idx = bitmap_find_next_zero_area(zram->bitmap, zram->nr_blocks,
+					1, nr, 0);
+	if (blk_idx >= zram->nr_blocks) {
+		spin_unlock(&zram->bitmap_lock);
+		return 0;
+	}
+	bitmap_set(zram->bitmap, blk_idx, nr);
+	spin_unlock(&zram->bitmap_lock);
+
+	return blk_idx;
+}
+
+static void free_block_bdev(struct zram *zram, unsigned long blk_idx,
+			unsigned int nr)
+{
+	spin_lock(&zram->bitmap_lock);
+	bitmap_clear(zram->bitmap, blk_idx, nr);
+	spin_unlock(&zram->bitmap_lock);
+}
+
+static int read_from_bdev(struct zram *zram, struct page *page,
+			unsigned long blk_idx)
+{
+	struct bio *bio;
+	int ret;
+
+	bio = bio_alloc(GFP_NOIO, 1);
+	if (!bio)
+		return -ENOMEM;
+
+	bio->bi_iter.bi_sector = blk_idx * (PAGE_SIZE >> SECTOR_SHIFT);
+	bio->bi_bdev = zram->bdev;
+	if (!bio_add_page(bio, page, PAGE_SIZE, 0)) {
+		bio_put(bio);
+		return -EIO;
+	}
+
+	ret = submit_bio_wait(READ_SYNC, bio);
+	bio_put(bio);
+	atomic64_inc(&zram->stats.bd_reads);
+
+	return ret;
+}
+
+static ssize_t bd_stat_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+	ssize_t ret;
+
+	down_read(&zram->init_lock);
+	ret = scnprintf(buf, PAGE_SIZE,
+			"%8llu %8llu %8llu\n",
+			(u64)atomic64_read(&zram->stats.bd_count),
+			(u64)atomic64_read(&zram->stats.bd_reads),
+			(u64)atomic64_read(&zram->stats.bd_writes));
+	up_read(&zram->init_lock);
+
+	return ret;
+}
+#else
+static inline void reset_bdev(struct zram *zram) {}
+static inline void free_block_bdev(struct zram *zram, unsigned long blk_idx,
+			unsigned int nr) {}
+static inline int read_from_bdev(struct zram *zram, struct page *page,
+			unsigned long blk_idx)
+{
+	return -EIO;
+}
+#endif
+
+static ssize_t io_stat_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+	ssize_t ret;
+
+	down_read(&zram->init_lock);
+	ret = scnprintf(buf, PAGE_SIZE,
+			"%8llu %8llu %8llu %8llu\n",
+			(u64)atomic64_read(&zram->stats.failed_reads),
+			(u64)atomic64_read(&zram->stats.failed_writes),
+			(u64)atomic64_read(&zram->stats.invalid_io),
+			(u64)atomic64_read(&zram->stats.notify_free));
+	up_read(&zram->init_lock);
+
+	return ret;
+}
+
+static ssize_t mm_stat_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+	struct zs_pool_stats pool_stats;
+	u64 orig_size, mem_used = 0;
+	long max_used;
+	ssize_t ret;
+
+	memset(&pool_stats, 0x00, sizeof(struct zs_pool_stats));
+
+	down_read(&zram->init_lock);
+	if (init_done(zram)) {
+		mem_used = zs_get_total_pages(zram->meta->mem_pool);
+		zs_pool_stats(zram->meta->mem_pool, &pool_stats);
+	}
+
+	orig_size = atomic64_read(&zram->stats.pages_stored);
+	max_used = atomic_long_read(&zram->stats.max_used_pages);
+
+	ret = scnprintf(buf, PAGE_SIZE,
+			"%8llu %8llu %8llu %8lu %8ld %8llu %8lu %8llu %8llu %8llu %8llu\n",
+			orig_size << PAGE_SHIFT,
+			(u64)atomic64_read(&zram->stats.compr_data_size),
+			mem_used << PAGE_SHIFT,
+			zram->limit_pages << PAGE_SHIFT,
+			max_used << PAGE_SHIFT,
+			(u64)atomic64_read(&zram->stats.same_pages),
+			pool_stats.pages_compacted,
+			(u64)atomic64_read(&zram->stats.recomp_pages),
+			(u64)atomic64_read(&zram->stats.recomp_saved),
+			(u64)atomic64_read(&zram->stats.recomp_ns),
+			(u64)atomic64_read(&zram->stats.auto_compactions));
+	up_read(&zram->init_lock);
+
+	return ret;
+}
+
+/*
+ * One line per non-empty zsmalloc size class:
+ * object size, objects allocated, objects used, pages used and pages
+ * compaction could free.
+ */
+static ssize_t class_stat_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+	struct zs_class_stats stats;
+	ssize_t ret = 0;
+	int i, err;
+
+	down_read(&zram->init_lock);
+	if (!init_done(zram))
+		goto out;
+
+	for (i = 0; ; i++) {
+		err = zs_class_stats(zram->meta->mem_pool, i, &stats);
+		if (err == -EINVAL)
+			break;
+		if (err || !stats.objs_allocated)
+			continue;
+
+		ret += scnprintf(buf + ret, PAGE_SIZE - ret,
+				"%5u %8lu %8lu %8lu %8lu\n",
+				stats.size, stats.objs_allocated,
+				stats.objs_used, stats.pages_used,
+				stats.pages_compactable);
+	}
+out:
+	up_read(&zram->init_lock);
+
+	return ret;
+}
+
+static DEVICE_ATTR_RO(io_stat);
+static DEVICE_ATTR_RO(mm_stat);
+static DEVICE_ATTR_RO(class_stat);
+ZRAM_ATTR_RO(num_reads);
+ZRAM_ATTR_RO(num_writes);
+ZRAM_ATTR_RO(failed_reads);
+ZRAM_ATTR_RO(failed_writes);
+ZRAM_ATTR_RO(invalid_io);
+ZRAM_ATTR_RO(notify_free);
+ZRAM_ATTR_RO(same_pages);
+ZRAM_ATTR_RO(compr_data_size);
+
+static inline bool zram_meta_get(struct zram *zram)
+{
+	if (atomic_inc_not_zero(&zram->refcount))
+		return true;
+	return false;
+}
+
+static inline void zram_meta_put(struct zram *zram)
+{
+	if (atomic_dec_and_test(&zram->refcount))
+		wake_up(&zram->io_done);
+}
+
+static void zram_meta_free(struct zram_meta *meta, u64 disksize)
+{
+	size_t num_pages = disksize >> PAGE_SHIFT;
+	size_t index;
+
+	/* Free all pages that are still in this zram device */
+	for (index = 0; index < num_pages; index++) {
+		unsigned long handle = meta->table[index].handle;
+
+		/* shared objects are freed by zram_dedup_fini() */
+		if (!handle || zram_test_flag(meta, index, ZRAM_WB) ||
+				zram_test_flag(meta, index, ZRAM_SAME) ||
+				zram_test_flag(meta, index, ZRAM_DEDUP))
+			continue;
+
+		zs_free(meta->mem_pool, handle);
+	}
+
+	zram_dedup_fini(meta);
+	zs_destroy_pool(meta->mem_pool);
+	vfree(meta->table);
+	kfree(meta);
+}
+
+static struct zram_meta *zram_meta_alloc(char *pool_name, u64 disksize,
+					bool use_dedup)
+{
+	size_t num_pages;
+	struct zram_meta *meta = kzalloc(sizeof(*meta), GFP_KERNEL);
+
+	if (!meta)
+		return NULL;
+
+	num_pages = disksize >> PAGE_SHIFT;
+	meta->table = vzalloc(num_pages * sizeof(*meta->table));
+	if (!meta->table) {
+		pr_err("Error allocating zram address table\n");
+		goto out_error;
+	}
+
+	meta->mem_pool = zs_create_pool(pool_name, GFP_NOIO | __GFP_HIGHMEM);
+	if (!meta->mem_pool) {
+		pr_err("Error creating memory pool\n");
+		goto out_error;
+	}
+
+	if (use_dedup && zram_dedup_init(meta, num_pages)) {
+		zs_destroy_pool(meta->mem_pool);
+		goto out_error;
+	}
+
+	return meta;
+
+out_error:
+	vfree(meta->table);
+	kfree(meta);
+	return NULL;
+}
+
+/*
+ * To protect concurrent access to the same index entry,
+ * caller should hold this table index entry's bit_spinlock to
+ * indicate this index entry is accessing.
+ */
+static void zram_free_page(struct zram *zram, size_t index)
+{
+	struct zram_meta *meta = zram->meta;
+	unsigned long handle = meta->table[index].handle;
+
+	zram_clear_flag(meta, index, ZRAM_IDLE);
+	zram_clear_flag(meta, index, ZRAM_HUGE);
+	/* a queued free of the old contents has nothing left to do */
+	zram_clear_flag(meta, index, ZRAM_FREE_PENDING);
+	/* tells a writeback in flight that this slot has changed */
+	zram_clear_flag(meta, index, ZRAM_UNDER_WB);
+	zram_clear_flag(meta, index, ZRAM_NORECOMP);
+	if (zram_test_flag(meta, index, ZRAM_RECOMP)) {
+		zram_clear_flag(meta, index, ZRAM_RECOMP);
+		atomic64_dec(&zram->stats.recomp_pages);
+	}
+
+	if (zram_test_flag(meta, index, ZRAM_WB)) {
+		zram_clear_flag(meta, index, ZRAM_WB);
+		free_block_bdev(zram, handle, 1);
+		atomic64_dec(&zram->stats.bd_count);
+		meta->table[index].handle = 0;
+		return;
+	}
+
+	/*
+	 * No memory is allocated for same element filled pages.
+	 * Simply clear same page flag.
+	 */
+	if (zram_test_flag(meta, index, ZRAM_SAME)) {
+		zram_clear_flag(meta, index, ZRAM_SAME);
+		meta->table[index].element = 0;
+		atomic64_dec(&zram->stats.same_pages);
+		return;
+	}
+
+	if (unlikely(!handle))
+		return;
+
+	if (zram_test_flag(meta, index, ZRAM_DEDUP)) {
+		zram_clear_flag(meta, index, ZRAM_DEDUP);
+		/* other slots still use it, nothing to account */
+		if (!zram_dedup_put(zram, (struct zram_entry *)handle))
+			goto out;
+	} else {
+		zs_free(meta->mem_pool, handle);
+	}
+
+	atomic64_sub(zram_get_obj_size(meta, index),
+			&zram->stats.compr_data_size);
+out:
+	atomic64_dec(&zram->stats.pages_stored);
+
+	meta->table[index].handle = 0;
+	zram_set_obj_size(meta, index, 0);
+}
+
+static int zram_decompress_page(struct zram *zram, char *mem, u32 index)
+{
+	int ret = 0;
+	unsigned char *cmem;
+	struct zram_meta *meta = zram->meta;
+	struct zcomp *comp = zram->comp;
+	unsigned long handle;
+	size_t size;
+
+	bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+	handle = meta->table[index].handle;
+	size = zram_get_obj_size(meta, index);
+	if (zram_test_flag(meta, index, ZRAM_RECOMP))
+		comp = zram->recomp;
+
+	/* written back since the caller looked, it has to read the bdev */
+	if (zram_test_flag(meta, index, ZRAM_WB)) {
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+		return -EAGAIN;
+	}
+
+	if (!handle || zram_test_flag(meta, index, ZRAM_SAME)) {
+		unsigned long element = meta->table[index].element;
+
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+		zram_fill_element(mem, PAGE_SIZE, element);
+		return 0;
+	}
+
+	if (zram_test_flag(meta, index, ZRAM_DEDUP))
+		handle = ((struct zram_entry *)handle)->handle;
+
+	cmem = zs_map_object(meta->mem_pool, handle, ZS_MM_RO);
+	if (size == PAGE_SIZE)
+		memcpy(mem, cmem, PAGE_SIZE);
+	else
+		ret = zcomp_decompress(comp, cmem, size, mem);
+	zs_unmap_object(meta->mem_pool, handle);
+	bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+
+	/* Should NEVER happen. Return bio error if it does. */
+	if (unlikely(ret)) {
+		pr_err("Decompression failed! err=%d, page=%u\n", ret, index);
+		return ret;
+	}
+
+	return 0;
+}
+
+static int zram_bvec_read_bdev(struct zram *zram, struct bio_vec *bvec,
+			unsigned long blk_idx, int offset)
+{
+	struct page *page = bvec->bv_page;
+	unsigned char *user_mem, *src;
+	struct page *tmp;
+	int ret;
+
+	if (!is_partial_io(bvec)) {
+		ret = read_from_bdev(zram, page, blk_idx);
+		if (!ret)
+			flush_dcache_page(page);
+		return ret;
+	}
+
+	tmp = alloc_page(GFP_NOIO);
+	if (!tmp)
+		return -ENOMEM;
+
+	ret = read_from_bdev(zram, tmp, blk_idx);
+	if (!ret) {
+		src = kmap_atomic(tmp);
+		user_mem = kmap_atomic(page);
+		memcpy(user_mem + bvec->bv_offset, src + offset, bvec->bv_len);
+		kunmap_atomic(user_mem);
+		kunmap_atomic(src);
+		flush_dcache_page(page);
+	}
+	__free_page(tmp);
+
+	return ret;
+}
+
+/*
+ * Like zram_decompress_page(), but also fetches slots that have been
+ * written back to the backing device, so it may sleep.
+ */
+static int zram_fill_page(struct zram *zram, char *mem, u32 index)
+{
+	struct zram_meta *meta = zram->meta;
+	unsigned long blk_idx;
+	struct page *tmp;
+	char *src;
+	int ret;
+
+	do {
+		bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+		if (!zram_test_flag(meta, index, ZRAM_WB)) {
+			bit_spin_unlock(ZRAM_ACCESS,
+					&meta->table[index].value);
+			ret = zram_decompress_page(zram, mem, index);
+			continue;
+		}
+		blk_idx = meta->table[index].handle;
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+
+		tmp = alloc_page(GFP_NOIO);
+		if (!tmp)
+			return -ENOMEM;
+
+		ret = read_from_bdev(zram, tmp, blk_idx);
+		if (!ret) {
+			src = kmap_atomic(tmp);
+			memcpy(mem, src, PAGE_SIZE);
+			kunmap_atomic(src);
+		}
+		__free_page(tmp);
+	} while (ret == -EAGAIN);
+
+	return ret;
+}
+
+static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 			  u32 index, int offset)
 {
 	int ret;
@@ -604,30 +1281,42 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 	struct zram_meta *meta = zram->meta;
 	page = bvec->bv_page;
 
+retry:
 	bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
 	if (unlikely(!meta->table[index].handle) ||
-			zram_test_flag(meta, index, ZRAM_ZERO)) {
+			zram_test_flag(meta, index, ZRAM_SAME)) {
+		/* an empty slot has a zero element */
+		unsigned long element = meta->table[index].element;
+
 		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
-		handle_zero_page(bvec);
+		handle_same_page(zram, bvec, offset, element);
 		return 0;
 	}
+	/* the page is being used again, keep it out of idle writeback */
+	zram_clear_flag(meta, index, ZRAM_IDLE);
+	if (zram_test_flag(meta, index, ZRAM_WB)) {
+		unsigned long blk_idx = meta->table[index].handle;
+
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+		return zram_bvec_read_bdev(zram, bvec, blk_idx, offset);
+	}
 	bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
 
 	if (is_partial_io(bvec))
-		/* Use  a temporary buffer to decompress the page */
-		uncmem = kmalloc(PAGE_SIZE, GFP_NOIO);
+		/* Use this cpu's decompression buffer for the page */
+		uncmem = zcomp_dstrm_get(zram->comp);
 
 	user_mem = kmap_atomic(page);
 	if (!is_partial_io(bvec))
 		uncmem = user_mem;
 
-	if (!uncmem) {
-		pr_err("Unable to allocate temp memory\n");
-		ret = -ENOMEM;
-		goto out_cleanup;
-	}
-
 	ret = zram_decompress_page(zram, uncmem, index);
+	if (ret == -EAGAIN) {
+		kunmap_atomic(user_mem);
+		if (is_partial_io(bvec))
+			zcomp_dstrm_put(zram->comp);
+		goto retry;
+	}
 	/* Should NEVER happen. Return bio error if it does. */
 	if (unlikely(ret))
 		goto out_cleanup;
@@ -636,139 +1325,523 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 		memcpy(user_mem + bvec->bv_offset, uncmem + offset,
 				bvec->bv_len);
 
-	flush_dcache_page(page);
-	ret = 0;
-out_cleanup:
-	kunmap_atomic(user_mem);
-	if (is_partial_io(bvec))
-		kfree(uncmem);
-	return ret;
+	flush_dcache_page(page);
+	ret = 0;
+out_cleanup:
+	kunmap_atomic(user_mem);
+	if (is_partial_io(bvec))
+		zcomp_dstrm_put(zram->comp);
+	return ret;
+}
+
+static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
+			   int offset)
+{
+	int ret = 0;
+	size_t clen;
+	unsigned long handle;
+	struct page *page;
+	unsigned char *user_mem, *cmem, *src, *uncmem = NULL;
+	struct zram_meta *meta = zram->meta;
+	struct zcomp_strm *zstrm = NULL;
+	struct zram_entry *entry = NULL;
+	unsigned long alloced_pages;
+	unsigned long element;
+	u32 checksum = 0;
+
+	page = bvec->bv_page;
+	if (is_partial_io(bvec)) {
+		/*
+		 * This is a partial IO. We need to read the full page
+		 * before to write the changes.
+		 */
+		uncmem = kmalloc(PAGE_SIZE, GFP_NOIO);
+		if (!uncmem) {
+			ret = -ENOMEM;
+			goto out;
+		}
+		ret = zram_fill_page(zram, uncmem, index);
+		if (ret)
+			goto out;
+	}
+
+	zstrm = zcomp_strm_find(zram->comp);
+	user_mem = kmap_atomic(page);
+
+	if (is_partial_io(bvec)) {
+		memcpy(uncmem + offset, user_mem + bvec->bv_offset,
+		       bvec->bv_len);
+		kunmap_atomic(user_mem);
+		user_mem = NULL;
+	} else {
+		uncmem = user_mem;
+	}
+
+	if (page_same_filled(uncmem, &element)) {
+		if (user_mem)
+			kunmap_atomic(user_mem);
+		/* Free memory associated with this sector now. */
+		bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+		zram_free_page(zram, index);
+		zram_set_flag(meta, index, ZRAM_SAME);
+		meta->table[index].element = element;
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+
+		atomic64_inc(&zram->stats.same_pages);
+		ret = 0;
+		goto out;
+	}
+
+	if (zram_dedup_enabled(meta)) {
+		checksum = zram_dedup_checksum(uncmem);
+		entry = zram_dedup_find(zram, uncmem, checksum);
+		if (entry) {
+			if (user_mem)
+				kunmap_atomic(user_mem);
+			bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+			zram_free_page(zram, index);
+			meta->table[index].handle = (unsigned long)entry;
+			zram_set_obj_size(meta, index, entry->len);
+			zram_set_flag(meta, index, ZRAM_DEDUP);
+			bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+
+			atomic64_inc(&zram->stats.pages_stored);
+			ret = 0;
+			goto out;
+		}
+	}
+
+	ret = zcomp_compress(zram->comp, zstrm, uncmem, &clen);
+	if (!is_partial_io(bvec)) {
+		kunmap_atomic(user_mem);
+		user_mem = NULL;
+		uncmem = NULL;
+	}
+
+	if (unlikely(ret)) {
+		pr_err("Compression failed! err=%d\n", ret);
+		goto out;
+	}
+	src = zstrm->buffer;
+	if (unlikely(clen > max_zpage_size)) {
+		clen = PAGE_SIZE;
+		if (is_partial_io(bvec))
+			src = uncmem;
+	}
+
+	handle = zs_malloc(meta->mem_pool, clen);
+	if (!handle) {
+		pr_err("Error allocating memory for compressed page: %u, size=%zu\n",
+			index, clen);
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	alloced_pages = zs_get_total_pages(meta->mem_pool);
+	update_used_max(zram, alloced_pages);
+
+	if (zram->limit_pages && alloced_pages > zram->limit_pages) {
+		zs_free(meta->mem_pool, handle);
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	cmem = zs_map_object(meta->mem_pool, handle, ZS_MM_WO);
+
+	if ((clen == PAGE_SIZE) && !is_partial_io(bvec)) {
+		src = kmap_atomic(page);
+		memcpy(cmem, src, PAGE_SIZE);
+		kunmap_atomic(src);
+	} else {
+		memcpy(cmem, src, clen);
+	}
+
+	zcomp_strm_release(zram->comp, zstrm);
+	zstrm = NULL;
+	zs_unmap_object(meta->mem_pool, handle);
+
+	if (zram_dedup_enabled(meta))
+		entry = zram_dedup_insert(zram, handle, clen, checksum);
+
+	/*
+	 * Free memory associated with this sector
+	 * before overwriting unused sectors.
+	 */
+	bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+	zram_free_page(zram, index);
+
+	if (entry) {
+		meta->table[index].handle = (unsigned long)entry;
+		zram_set_flag(meta, index, ZRAM_DEDUP);
+	} else {
+		meta->table[index].handle = handle;
+	}
+	zram_set_obj_size(meta, index, clen);
+	if (clen == PAGE_SIZE)
+		zram_set_flag(meta, index, ZRAM_HUGE);
+	bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+
+	/* Update stats */
+	atomic64_add(clen, &zram->stats.compr_data_size);
+	atomic64_inc(&zram->stats.pages_stored);
+out:
+	if (zstrm)
+		zcomp_strm_release(zram->comp, zstrm);
+	if (is_partial_io(bvec))
+		kfree(uncmem);
+	return ret;
+}
+
+/*
+ * Recompress one idle slot with the secondary algorithm, or mark it
+ * idle for the next pass if it has been accessed since the last one.
+ * @buf is a lowmem page owned by the caller.
+ */
+static void zram_recompress_slot(struct zram *zram, u32 index, void *buf)
+{
+	struct zram_meta *meta = zram->meta;
+	struct zcomp_strm *zstrm;
+	size_t old_len = 0, new_len;
+	unsigned long handle;
+	ktime_t start;
+	void *cmem;
+	bool pick;
+	int ret;
+
+	bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+	handle = meta->table[index].handle;
+	pick = handle && zram_test_flag(meta, index, ZRAM_IDLE) &&
+		!zram_test_flag(meta, index, ZRAM_SAME) &&
+		!zram_test_flag(meta, index, ZRAM_DEDUP) &&
+		!zram_test_flag(meta, index, ZRAM_WB) &&
+		!zram_test_flag(meta, index, ZRAM_UNDER_WB) &&
+		!zram_test_flag(meta, index, ZRAM_RECOMP) &&
+		!zram_test_flag(meta, index, ZRAM_NORECOMP);
+	if (pick) {
+		zram_set_flag(meta, index, ZRAM_UNDER_WB);
+		old_len = zram_get_obj_size(meta, index);
+	} else if (handle && !zram_test_flag(meta, index, ZRAM_WB)) {
+		zram_set_flag(meta, index, ZRAM_IDLE);
+	}
+	bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+
+	if (!pick)
+		return;
+
+	ret = zram_decompress_page(zram, buf, index);
+	if (ret)
+		goto out_abort;
+
+	start = ktime_get();
+	zstrm = zcomp_strm_find(zram->recomp);
+	ret = zcomp_compress(zram->recomp, zstrm, buf, &new_len);
+	if (ret || new_len >= old_len || new_len > max_zpage_size) {
+		zcomp_strm_release(zram->recomp, zstrm);
+		atomic64_add(ktime_to_ns(ktime_sub(ktime_get(), start)),
+				&zram->stats.recomp_ns);
+
+		/* no gain, do not try this page again until it changes */
+		bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+		if (zram_test_flag(meta, index, ZRAM_UNDER_WB))
+			zram_set_flag(meta, index, ZRAM_NORECOMP);
+		zram_clear_flag(meta, index, ZRAM_UNDER_WB);
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+		return;
+	}
+
+	handle = zs_malloc(meta->mem_pool, new_len);
+	if (!handle) {
+		zcomp_strm_release(zram->recomp, zstrm);
+		goto out_abort;
+	}
+
+	cmem = zs_map_object(meta->mem_pool, handle, ZS_MM_WO);
+	memcpy(cmem, zstrm->buffer, new_len);
+	zs_unmap_object(meta->mem_pool, handle);
+	zcomp_strm_release(zram->recomp, zstrm);
+	atomic64_add(ktime_to_ns(ktime_sub(ktime_get(), start)),
+			&zram->stats.recomp_ns);
+
+	bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+	/* freed or rewritten while we were working on it */
+	if (!zram_test_flag(meta, index, ZRAM_UNDER_WB)) {
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+		zs_free(meta->mem_pool, handle);
+		return;
+	}
+
+	zram_free_page(zram, index);
+	meta->table[index].handle = handle;
+	zram_set_obj_size(meta, index, new_len);
+	zram_set_flag(meta, index, ZRAM_RECOMP);
+	bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+
+	atomic64_add(new_len, &zram->stats.compr_data_size);
+	atomic64_inc(&zram->stats.pages_stored);
+	atomic64_inc(&zram->stats.recomp_pages);
+	atomic64_add(old_len - new_len, &zram->stats.recomp_saved);
+	return;
+
+out_abort:
+	bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+	zram_clear_flag(meta, index, ZRAM_UNDER_WB);
+	bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+}
+
+/*
+ * Every recomp_interval seconds, recompress the slots that were not
+ * accessed since the previous pass and mark the others idle, so a page
+ * is recompressed once it has been idle for at least one interval.
+ */
+static int zram_recompress_thread(void *data)
+{
+	struct zram *zram = data;
+	unsigned long nr_pages, index;
+	unsigned int interval;
+	struct page *page;
+	long timeout;
+
+	page = alloc_page(GFP_KERNEL);
+	if (!page)
+		return -ENOMEM;
+
+	set_freezable();
+	nr_pages = zram->disksize >> PAGE_SHIFT;
+	while (!kthread_should_stop()) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (kthread_should_stop()) {
+			__set_current_state(TASK_RUNNING);
+			break;
+		}
+
+		interval = READ_ONCE(zram->recomp_interval);
+		timeout = interval ? interval * HZ : MAX_SCHEDULE_TIMEOUT;
+		/* woken early when the interval changes, start over */
+		if (schedule_timeout(timeout))
+			continue;
+
+		try_to_freeze();
+		for (index = 0; index < nr_pages; index++) {
+			if (kthread_should_stop())
+				break;
+			zram_recompress_slot(zram, index, page_address(page));
+			cond_resched();
+		}
+	}
+
+	__free_page(page);
+	return 0;
+}
+
+#ifdef CONFIG_ZRAM_WRITEBACK
+/* pages per writeback bio */
+#define ZRAM_WB_BATCH	32
+
+static ssize_t idle_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	struct zram_meta *meta;
+	unsigned long nr_pages, index;
+
+	if (!sysfs_streq(buf, "all"))
+		return -EINVAL;
+
+	down_read(&zram->init_lock);
+	if (!init_done(zram)) {
+		up_read(&zram->init_lock);
+		return -EINVAL;
+	}
+
+	meta = zram->meta;
+	nr_pages = zram->disksize >> PAGE_SHIFT;
+	for (index = 0; index < nr_pages; index++) {
+		bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+		if (meta->table[index].handle &&
+				!zram_test_flag(meta, index, ZRAM_WB) &&
+				!zram_test_flag(meta, index, ZRAM_SAME))
+			zram_set_flag(meta, index, ZRAM_IDLE);
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+		cond_resched();
+	}
+	up_read(&zram->init_lock);
+
+	return len;
+}
+
+static void zram_writeback_abort(struct zram *zram, u32 *slots, int nr)
+{
+	struct zram_meta *meta = zram->meta;
+	int i;
+
+	for (i = 0; i < nr; i++) {
+		bit_spin_lock(ZRAM_ACCESS, &meta->table[slots[i]].value);
+		zram_clear_flag(meta, slots[i], ZRAM_UNDER_WB);
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[slots[i]].value);
+	}
 }
 
-static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
-			   int offset)
+/*
+ * Write @nr uncompressed pages out as one sequential bio, then swap the
+ * in-memory objects of the slots that were not touched meanwhile for
+ * their new block on the backing device.
+ */
+static int zram_writeback_batch(struct zram *zram, struct page **pages,
+				u32 *slots, int nr, unsigned long mode)
 {
-	int ret = 0;
-	size_t clen;
-	unsigned long handle;
-	struct page *page;
-	unsigned char *user_mem, *cmem, *src, *uncmem = NULL;
 	struct zram_meta *meta = zram->meta;
-	struct zcomp_strm *zstrm = NULL;
-	unsigned long alloced_pages;
+	unsigned long blk_idx;
+	struct bio *bio;
+	int i, added, err;
+
+	blk_idx = alloc_block_bdev(zram, nr);
+	if (!blk_idx) {
+		err = -ENOSPC;
+		goto out_abort;
+	}
 
-	page = bvec->bv_page;
-	if (is_partial_io(bvec)) {
-		/*
-		 * This is a partial IO. We need to read the full page
-		 * before to write the changes.
-		 */
-		uncmem = kmalloc(PAGE_SIZE, GFP_NOIO);
-		if (!uncmem) {
-			ret = -ENOMEM;
-			goto out;
-		}
-		ret = zram_decompress_page(zram, uncmem, index);
-		if (ret)
-			goto out;
+	bio = bio_alloc(GFP_KERNEL, nr);
+	if (!bio) {
+		free_block_bdev(zram, blk_idx, nr);
+		err = -ENOMEM;
+		goto out_abort;
 	}
 
-	zstrm = zcomp_strm_find(zram->comp);
-	user_mem = kmap_atomic(page);
+	bio->bi_iter.bi_sector = blk_idx * (PAGE_SIZE >> SECTOR_SHIFT);
+	bio->bi_bdev = zram->bdev;
+	for (added = 0; added < nr; added++)
+		if (!bio_add_page(bio, pages[added], PAGE_SIZE, 0))
+			break;
+
+	/* whatever the queue limits did not let in stays in memory */
+	if (added < nr) {
+		zram_writeback_abort(zram, slots + added, nr - added);
+		free_block_bdev(zram, blk_idx + added, nr - added);
+		nr = added;
+	}
 
-	if (is_partial_io(bvec)) {
-		memcpy(uncmem + offset, user_mem + bvec->bv_offset,
-		       bvec->bv_len);
-		kunmap_atomic(user_mem);
-		user_mem = NULL;
-	} else {
-		uncmem = user_mem;
+	err = submit_bio_wait(WRITE, bio);
+	bio_put(bio);
+	if (err) {
+		free_block_bdev(zram, blk_idx, nr);
+		goto out_abort;
 	}
 
-	if (page_zero_filled(uncmem)) {
-		if (user_mem)
-			kunmap_atomic(user_mem);
-		/* Free memory associated with this sector now. */
+	for (i = 0; i < nr; i++) {
+		u32 index = slots[i];
+
 		bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+		if (!zram_test_flag(meta, index, ZRAM_UNDER_WB) ||
+				!(meta->table[index].value & mode)) {
+			zram_clear_flag(meta, index, ZRAM_UNDER_WB);
+			bit_spin_unlock(ZRAM_ACCESS,
+					&meta->table[index].value);
+			free_block_bdev(zram, blk_idx + i, 1);
+			continue;
+		}
+
 		zram_free_page(zram, index);
-		zram_set_flag(meta, index, ZRAM_ZERO);
+		zram_set_flag(meta, index, ZRAM_WB);
+		meta->table[index].handle = blk_idx + i;
 		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
 
-		atomic64_inc(&zram->stats.zero_pages);
-		ret = 0;
-		goto out;
-	}
-
-	ret = zcomp_compress(zram->comp, zstrm, uncmem, &clen);
-	if (!is_partial_io(bvec)) {
-		kunmap_atomic(user_mem);
-		user_mem = NULL;
-		uncmem = NULL;
+		atomic64_inc(&zram->stats.bd_count);
+		atomic64_inc(&zram->stats.bd_writes);
 	}
 
-	if (unlikely(ret)) {
-		pr_err("Compression failed! err=%d\n", ret);
-		goto out;
-	}
-	src = zstrm->buffer;
-	if (unlikely(clen > max_zpage_size)) {
-		clen = PAGE_SIZE;
-		if (is_partial_io(bvec))
-			src = uncmem;
-	}
+	return 0;
 
-	handle = zs_malloc(meta->mem_pool, clen);
-	if (!handle) {
-		pr_err("Error allocating memory for compressed page: %u, size=%zu\n",
-			index, clen);
-		ret = -ENOMEM;
-		goto out;
-	}
+out_abort:
+	zram_writeback_abort(zram, slots, nr);
+	return err;
+}
 
-	alloced_pages = zs_get_total_pages(meta->mem_pool);
-	update_used_max(zram, alloced_pages);
+static ssize_t writeback_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	struct page *pages[ZRAM_WB_BATCH] = { NULL };
+	u32 slots[ZRAM_WB_BATCH];
+	unsigned long nr_pages, index, mode;
+	struct zram_meta *meta;
+	ssize_t ret = len;
+	int nr = 0, i, err;
+	bool pick;
+	char *mem;
+
+	if (sysfs_streq(buf, "idle"))
+		mode = BIT(ZRAM_IDLE);
+	else if (sysfs_streq(buf, "huge"))
+		mode = BIT(ZRAM_HUGE);
+	else
+		return -EINVAL;
 
-	if (zram->limit_pages && alloced_pages > zram->limit_pages) {
-		zs_free(meta->mem_pool, handle);
-		ret = -ENOMEM;
+	down_read(&zram->init_lock);
+	if (!init_done(zram) || !zram->backing_dev) {
+		ret = -EINVAL;
 		goto out;
 	}
 
-	cmem = zs_map_object(meta->mem_pool, handle, ZS_MM_WO);
-
-	if ((clen == PAGE_SIZE) && !is_partial_io(bvec)) {
-		src = kmap_atomic(page);
-		memcpy(cmem, src, PAGE_SIZE);
-		kunmap_atomic(src);
-	} else {
-		memcpy(cmem, src, clen);
+	for (i = 0; i < ZRAM_WB_BATCH; i++) {
+		pages[i] = alloc_page(GFP_KERNEL);
+		if (!pages[i]) {
+			ret = -ENOMEM;
+			goto out;
+		}
 	}
 
-	zcomp_strm_release(zram->comp, zstrm);
-	zstrm = NULL;
-	zs_unmap_object(meta->mem_pool, handle);
+	meta = zram->meta;
+	nr_pages = zram->disksize >> PAGE_SHIFT;
+	for (index = 0; index < nr_pages; index++) {
+		bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+		pick = meta->table[index].handle &&
+			!zram_test_flag(meta, index, ZRAM_SAME) &&
+			!zram_test_flag(meta, index, ZRAM_DEDUP) &&
+			!zram_test_flag(meta, index, ZRAM_WB) &&
+			!zram_test_flag(meta, index, ZRAM_UNDER_WB) &&
+			(meta->table[index].value & mode);
+		if (pick)
+			zram_set_flag(meta, index, ZRAM_UNDER_WB);
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+		if (!pick)
+			continue;
 
-	/*
-	 * Free memory associated with this sector
-	 * before overwriting unused sectors.
-	 */
-	bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
-	zram_free_page(zram, index);
+		mem = kmap_atomic(pages[nr]);
+		err = zram_decompress_page(zram, mem, index);
+		kunmap_atomic(mem);
+		if (err) {
+			bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+			zram_clear_flag(meta, index, ZRAM_UNDER_WB);
+			bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+			continue;
+		}
 
-	meta->table[index].handle = handle;
-	zram_set_obj_size(meta, index, clen);
-	bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+		slots[nr++] = index;
+		if (nr < ZRAM_WB_BATCH)
+			continue;
 
-	/* Update stats */
-	atomic64_add(clen, &zram->stats.compr_data_size);
-	atomic64_inc(&zram->stats.pages_stored);
+		err = zram_writeback_batch(zram, pages, slots, nr, mode);
+		nr = 0;
+		if (err) {
+			ret = err;
+			break;
+		}
+		cond_resched();
+	}
+
+	if (nr) {
+		err = zram_writeback_batch(zram, pages, slots, nr, mode);
+		if (err)
+			ret = err;
+	}
 out:
-	if (zstrm)
-		zcomp_strm_release(zram->comp, zstrm);
-	if (is_partial_io(bvec))
-		kfree(uncmem);
+	for (i = 0; i < ZRAM_WB_BATCH && pages[i]; i++)
+		__free_page(pages[i]);
+	up_read(&zram->init_lock);
+
 	return ret;
 }
+#endif
 
 /*
  * zram_bio_discard - handler on discard request
@@ -917,6 +1990,56 @@ error:
 	bio_io_error(bio);
 }
 
+/*
+ * A queued slot is marked ZRAM_FREE_PENDING. If it is written again
+ * before free_work gets to it, zram_free_page() on the write clears the
+ * mark and free_work leaves the new contents alone.
+ */
+static bool zram_queue_free(struct zram *zram, u32 index)
+{
+	struct zram_meta *meta = zram->meta;
+	unsigned int queued;
+
+	spin_lock(&zram->free_lock);
+	queued = zram->free_tail - zram->free_head;
+	if (queued >= ZRAM_FREE_RING) {
+		spin_unlock(&zram->free_lock);
+		return false;
+	}
+	bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+	zram_set_flag(meta, index, ZRAM_FREE_PENDING);
+	bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+	zram->free_ring[zram->free_tail++ % ZRAM_FREE_RING] = index;
+	spin_unlock(&zram->free_lock);
+
+	if (!queued)
+		queue_work(system_unbound_wq, &zram->free_work);
+	return true;
+}
+
+static void zram_free_workfn(struct work_struct *work)
+{
+	struct zram *zram = container_of(work, struct zram, free_work);
+	struct zram_meta *meta = zram->meta;
+	u32 index;
+
+	spin_lock(&zram->free_lock);
+	while (zram->free_head != zram->free_tail) {
+		index = zram->free_ring[zram->free_head++ % ZRAM_FREE_RING];
+		spin_unlock(&zram->free_lock);
+
+		bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+		if (zram_test_flag(meta, index, ZRAM_FREE_PENDING))
+			zram_free_page(zram, index);
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+		atomic64_inc(&zram->stats.notify_free);
+
+		cond_resched();
+		spin_lock(&zram->free_lock);
+	}
+	spin_unlock(&zram->free_lock);
+}
+
 static void zram_slot_free_notify(struct block_device *bdev,
 				unsigned long index)
 {
@@ -926,12 +2049,177 @@ static void zram_slot_free_notify(struct block_device *bdev,
 	zram = bdev->bd_disk->private_data;
 	meta = zram->meta;
 
+	/*
+	 * Tearing down a killed app's address space frees thousands of
+	 * slots under the swap_info lock. Leave the zsmalloc work to
+	 * free_work so that the rest of its memory comes back sooner.
+	 */
+	if ((current->flags & (PF_EXITING | PF_KTHREAD)) &&
+	    zram_queue_free(zram, index))
+		return;
+
 	bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
 	zram_free_page(zram, index);
 	bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
 	atomic64_inc(&zram->stats.notify_free);
 }
 
+struct zram_read_work {
+	struct work_struct work;
+	struct zram *zram;
+	struct page *page;
+	u32 index;
+};
+
+static void zram_read_workfn(struct work_struct *work)
+{
+	struct zram_read_work *rw = container_of(work, struct zram_read_work,
+						work);
+	struct zram *zram = rw->zram;
+	struct bio_vec bv;
+	int err;
+
+	bv.bv_page = rw->page;
+	bv.bv_len = PAGE_SIZE;
+	bv.bv_offset = 0;
+
+	err = zram_bvec_rw(zram, &bv, rw->index, 0, READ);
+	page_endio(rw->page, READ, err);
+	zram_meta_put(zram);
+	kfree(rw);
+}
+
+/*
+ * Swap readahead issues one ->rw_page() per slot of the window back to
+ * back. Handing each of them to the unbound read workqueue lets the
+ * whole window be decompressed on several CPUs at once instead of one
+ * page after another on the faulting task. Returns false if the read
+ * has to be done synchronously by the caller.
+ */
+static bool zram_read_page_async(struct zram *zram, struct page *page,
+				u32 index)
+{
+	struct zram_read_work *rw;
+
+	rw = kmalloc(sizeof(*rw), GFP_NOIO | __GFP_NORETRY | __GFP_NOWARN);
+	if (!rw)
+		return false;
+
+	/* the worker owns this reference and drops it on completion */
+	if (unlikely(!zram_meta_get(zram))) {
+		kfree(rw);
+		return false;
+	}
+
+	INIT_WORK(&rw->work, zram_read_workfn);
+	rw->zram = zram;
+	rw->page = page;
+	rw->index = index;
+	queue_work(zram_read_wq, &rw->work);
+	return true;
+}
+
+struct zram_write_req {
+	struct list_head list;
+	struct page *page;
+	u32 index;
+};
+
+/*
+ * Complete a swap-out the way end_swap_bio_write() would, so a failed
+ * page is redirtied instead of being reclaimed with its data lost.
+ */
+static void zram_write_endio(struct page *page, int err)
+{
+	if (!err) {
+		page_endio(page, WRITE, 0);
+		return;
+	}
+
+	SetPageError(page);
+	set_page_dirty(page);
+	ClearPageReclaim(page);
+	end_page_writeback(page);
+}
+
+static void zram_write_workfn(struct work_struct *work)
+{
+	struct zram_write_worker *worker = container_of(work,
+					struct zram_write_worker, work);
+	struct zram *zram = worker->zram;
+	struct zram_write_req *req, *tmp;
+	struct bio_vec bv;
+	LIST_HEAD(batch);
+	int nr, err;
+
+	for (;;) {
+		spin_lock(&zram->write_lock);
+		for (nr = 0; nr < ZRAM_WRITE_BATCH &&
+				!list_empty(&zram->write_queue); nr++)
+			list_move_tail(zram->write_queue.next, &batch);
+		zram->write_pending -= nr;
+		spin_unlock(&zram->write_lock);
+
+		if (!nr)
+			break;
+
+		list_for_each_entry_safe(req, tmp, &batch, list) {
+			list_del(&req->list);
+			bv.bv_page = req->page;
+			bv.bv_len = PAGE_SIZE;
+			bv.bv_offset = 0;
+
+			err = zram_bvec_rw(zram, &bv, req->index, 0, WRITE);
+			zram_write_endio(req->page, err);
+			zram_meta_put(zram);
+			kfree(req);
+		}
+		cond_resched();
+	}
+}
+
+/*
+ * Queue a swap-out page for the compression workers so reclaim does
+ * not pay for compression inline. The page stays under writeback until
+ * a worker has stored it. Returns false if the caller has to write the
+ * page itself.
+ */
+static bool zram_write_page_async(struct zram *zram, struct page *page,
+				u32 index)
+{
+	struct zram_write_req *req;
+	int i;
+
+	req = kmalloc(sizeof(*req), GFP_NOIO | __GFP_NORETRY | __GFP_NOWARN);
+	if (!req)
+		return false;
+
+	/* the worker owns this reference and drops it on completion */
+	if (unlikely(!zram_meta_get(zram))) {
+		kfree(req);
+		return false;
+	}
+
+	req->page = page;
+	req->index = index;
+
+	spin_lock(&zram->write_lock);
+	if (zram->write_pending >= ZRAM_WRITE_MAX_PENDING) {
+		spin_unlock(&zram->write_lock);
+		zram_meta_put(zram);
+		kfree(req);
+		return false;
+	}
+	list_add_tail(&req->list, &zram->write_queue);
+	zram->write_pending++;
+	spin_unlock(&zram->write_lock);
+
+	i = (unsigned int)atomic_inc_return(&zram->write_next) %
+		ZRAM_WRITE_WORKERS;
+	queue_work(zram_write_wq, &zram->write_workers[i].work);
+	return true;
+}
+
 static int zram_rw_page(struct block_device *bdev, sector_t sector,
 		       struct page *page, int rw)
 {
@@ -953,6 +2241,19 @@ static int zram_rw_page(struct block_device *bdev, sector_t sector,
 	index = sector >> SECTORS_PER_PAGE_SHIFT;
 	offset = (sector & (SECTORS_PER_PAGE - 1)) << SECTOR_SHIFT;
 
+	if (rw == READ && !offset && READ_ONCE(zram->parallel_read) &&
+			zram_read_page_async(zram, page, index)) {
+		zram_meta_put(zram);
+		return 0;
+	}
+
+	/* WB_SYNC_ALL writeback (WRITE_SYNC) is left synchronous */
+	if (rw == WRITE && !offset && READ_ONCE(zram->async_write) &&
+			zram_write_page_async(zram, page, index)) {
+		zram_meta_put(zram);
+		return 0;
+	}
+
 	bv.bv_page = page;
 	bv.bv_len = PAGE_SIZE;
 	bv.bv_offset = 0;
@@ -977,8 +2278,9 @@ out:
 static void zram_reset_device(struct zram *zram)
 {
 	struct zram_meta *meta;
-	struct zcomp *comp;
+	struct zcomp *comp, *recomp;
 	u64 disksize;
+	int i;
 
 	down_write(&zram->init_lock);
 
@@ -989,8 +2291,14 @@ static void zram_reset_device(struct zram *zram)
 		return;
 	}
 
+	if (zram->recomp_thread) {
+		kthread_stop(zram->recomp_thread);
+		zram->recomp_thread = NULL;
+	}
+
 	meta = zram->meta;
 	comp = zram->comp;
+	recomp = zram->recomp;
 	disksize = zram->disksize;
 	/*
 	 * Refcount will go down to 0 eventually and r/w handler
@@ -1003,11 +2311,18 @@ static void zram_reset_device(struct zram *zram)
 	 * deadlock between reclaim path and any other locks.
 	 */
 	wait_event(zram->io_done, atomic_read(&zram->refcount) == 0);
+	/* workers may still be looking at an empty queue */
+	for (i = 0; i < ZRAM_WRITE_WORKERS; i++)
+		flush_work(&zram->write_workers[i].work);
+	flush_work(&zram->free_work);
+
+	reset_bdev(zram);
 
 	/* Reset stats */
 	memset(&zram->stats, 0, sizeof(zram->stats));
 	zram->disksize = 0;
 	zram->max_comp_streams = 1;
+	zram->recomp = NULL;
 
 	set_capacity(zram->disk, 0);
 	part_stat_set_all(&zram->disk->part0, 0);
@@ -1016,15 +2331,18 @@ static void zram_reset_device(struct zram *zram)
 	/* I/O operation under all of CPU are done so let's free */
 	zram_meta_free(meta, disksize);
 	zcomp_destroy(comp);
+	if (recomp)
+		zcomp_destroy(recomp);
 }
 
 static ssize_t disksize_store(struct device *dev,
 		struct device_attribute *attr, const char *buf, size_t len)
 {
 	u64 disksize;
-	struct zcomp *comp;
+	struct zcomp *comp, *recomp = NULL;
 	struct zram_meta *meta;
 	struct zram *zram = dev_to_zram(dev);
+	struct task_struct *thread;
 	int err;
 
 	disksize = memparse(buf, NULL);
@@ -1032,7 +2350,8 @@ static ssize_t disksize_store(struct device *dev,
 		return -EINVAL;
 
 	disksize = PAGE_ALIGN(disksize);
-	meta = zram_meta_alloc(zram->disk->disk_name, disksize);
+	meta = zram_meta_alloc(zram->disk->disk_name, disksize,
+				zram->use_dedup);
 	if (!meta)
 		return -ENOMEM;
 
@@ -1044,6 +2363,17 @@ static ssize_t disksize_store(struct device *dev,
 		goto out_free_meta;
 	}
 
+	if (zram->recomp_algorithm[0]) {
+		/* only the recompression thread compresses with it */
+		recomp = zcomp_create(zram->recomp_algorithm, 1);
+		if (IS_ERR(recomp)) {
+			pr_err("Cannot initialise %s recompressing backend\n",
+					zram->recomp_algorithm);
+			err = PTR_ERR(recomp);
+			goto out_destroy_comp_unlocked;
+		}
+	}
+
 	down_write(&zram->init_lock);
 	if (init_done(zram)) {
 		pr_info("Cannot change disksize for initialized device\n");
@@ -1055,10 +2385,23 @@ static ssize_t disksize_store(struct device *dev,
 	atomic_set(&zram->refcount, 1);
 	zram->meta = meta;
 	zram->comp = comp;
+	zram->recomp = recomp;
 	zram->disksize = disksize;
 	set_capacity(zram->disk, zram->disksize >> SECTOR_SHIFT);
+	if (recomp) {
+		thread = kthread_run(zram_recompress_thread, zram, "%s_recomp",
+				zram->disk->disk_name);
+		if (IS_ERR(thread))
+			pr_warn("Cannot start recompression thread\n");
+		else
+			zram->recomp_thread = thread;
+	}
 	up_write(&zram->init_lock);
 
+	if (READ_ONCE(zram->compact_threshold) && READ_ONCE(zram->display_off))
+		queue_delayed_work(system_freezable_power_efficient_wq,
+				&zram->compact_work, ZRAM_COMPACT_INTERVAL);
+
 	/*
 	 * Revalidate disk out of the init_lock to avoid lockdep splat.
 	 * It's okay because disk's capacity is protected by init_lock
@@ -1070,6 +2413,9 @@ static ssize_t disksize_store(struct device *dev,
 
 out_destroy_comp:
 	up_write(&zram->init_lock);
+	if (recomp)
+		zcomp_destroy(recomp);
+out_destroy_comp_unlocked:
 	zcomp_destroy(comp);
 out_free_meta:
 	zram_meta_free(meta, disksize);
@@ -1144,6 +2490,7 @@ static const struct block_device_operations zram_devops = {
 };
 
 static DEVICE_ATTR_WO(compact);
+static DEVICE_ATTR_RW(compact_threshold);
 static DEVICE_ATTR_RW(disksize);
 static DEVICE_ATTR_RO(initstate);
 static DEVICE_ATTR_WO(reset);
@@ -1153,6 +2500,20 @@ static DEVICE_ATTR_RW(mem_limit);
 static DEVICE_ATTR_RW(mem_used_max);
 static DEVICE_ATTR_RW(max_comp_streams);
 static DEVICE_ATTR_RW(comp_algorithm);
+static DEVICE_ATTR_RW(parallel_read);
+static DEVICE_ATTR_RW(async_write);
+static DEVICE_ATTR_RW(recomp_algorithm);
+static DEVICE_ATTR_RW(recomp_interval);
+#ifdef CONFIG_ZRAM_DEDUP
+static DEVICE_ATTR_RW(use_dedup);
+static DEVICE_ATTR_RO(dedup_stat);
+#endif
+#ifdef CONFIG_ZRAM_WRITEBACK
+static DEVICE_ATTR_RW(backing_dev);
+static DEVICE_ATTR_WO(idle);
+static DEVICE_ATTR_WO(writeback);
+static DEVICE_ATTR_RO(bd_stat);
+#endif
 
 static struct attribute *zram_disk_attrs[] = {
 	&dev_attr_disksize.attr,
@@ -1163,9 +2524,10 @@ static struct attribute *zram_disk_attrs[] = {
 	&dev_attr_failed_reads.attr,
 	&dev_attr_failed_writes.attr,
 	&dev_attr_compact.attr,
+	&dev_attr_compact_threshold.attr,
 	&dev_attr_invalid_io.attr,
 	&dev_attr_notify_free.attr,
-	&dev_attr_zero_pages.attr,
+	&dev_attr_same_pages.attr,
 	&dev_attr_orig_data_size.attr,
 	&dev_attr_compr_data_size.attr,
 	&dev_attr_mem_used_total.attr,
@@ -1173,8 +2535,23 @@ static struct attribute *zram_disk_attrs[] = {
 	&dev_attr_mem_used_max.attr,
 	&dev_attr_max_comp_streams.attr,
 	&dev_attr_comp_algorithm.attr,
+	&dev_attr_parallel_read.attr,
+	&dev_attr_async_write.attr,
+	&dev_attr_recomp_algorithm.attr,
+	&dev_attr_recomp_interval.attr,
+#ifdef CONFIG_ZRAM_DEDUP
+	&dev_attr_use_dedup.attr,
+	&dev_attr_dedup_stat.attr,
+#endif
+#ifdef CONFIG_ZRAM_WRITEBACK
+	&dev_attr_backing_dev.attr,
+	&dev_attr_idle.attr,
+	&dev_attr_writeback.attr,
+	&dev_attr_bd_stat.attr,
+#endif
 	&dev_attr_io_stat.attr,
 	&dev_attr_mm_stat.attr,
+	&dev_attr_class_stat.attr,
 	NULL,
 };
 
@@ -1190,7 +2567,7 @@ static int zram_add(void)
 {
 	struct zram *zram;
 	struct request_queue *queue;
-	int ret, device_id;
+	int ret, device_id, i;
 
 	zram = kzalloc(sizeof(struct zram), GFP_KERNEL);
 	if (!zram)
@@ -1202,6 +2579,22 @@ static int zram_add(void)
 	device_id = ret;
 
 	init_rwsem(&zram->init_lock);
+	spin_lock_init(&zram->write_lock);
+	INIT_LIST_HEAD(&zram->write_queue);
+	for (i = 0; i < ZRAM_WRITE_WORKERS; i++) {
+		INIT_WORK(&zram->write_workers[i].work, zram_write_workfn);
+		zram->write_workers[i].zram = zram;
+	}
+	spin_lock_init(&zram->free_lock);
+	INIT_WORK(&zram->free_work, zram_free_workfn);
+#ifdef CONFIG_ZRAM_WRITEBACK
+	spin_lock_init(&zram->bitmap_lock);
+#endif
+	INIT_DEFERRABLE_WORK(&zram->compact_work, zram_compact_workfn);
+	zram->display_nb.notifier_call = zram_display_notify;
+	/* without display events compaction is only gated by fragmentation */
+	if (rcc_register_display_notifier(&zram->display_nb))
+		zram->display_off = true;
 
 	queue = blk_alloc_queue(GFP_KERNEL);
 	if (!queue) {
@@ -1235,6 +2628,9 @@ static int zram_add(void)
 	/* zram devices sort of resembles non-rotational disks */
 	queue_flag_set_unlocked(QUEUE_FLAG_NONROT, zram->disk->queue);
 	queue_flag_clear_unlocked(QUEUE_FLAG_ADD_RANDOM, zram->disk->queue);
+	/* reads complete in the submitter, swap readahead only adds latency */
+	zram->disk->queue->backing_dev_info.capabilities |=
+					BDI_CAP_SYNCHRONOUS_IO;
 	/*
 	 * To ensure that we always get PAGE_SIZE aligned
 	 * and n*PAGE_SIZED sized I/O requests.
@@ -1282,6 +2678,8 @@ out_free_disk:
 out_free_queue:
 	blk_cleanup_queue(queue);
 out_free_idr:
+	rcc_unregister_display_notifier(&zram->display_nb);
+	cancel_delayed_work_sync(&zram->compact_work);
 	idr_remove(&zram_index_idr, device_id);
 out_free_dev:
 	kfree(zram);
@@ -1316,6 +2714,9 @@ static int zram_remove(struct zram *zram)
 	sysfs_remove_group(&disk_to_dev(zram->disk)->kobj,
 			&zram_disk_attr_group);
 
+	rcc_unregister_display_notifier(&zram->display_nb);
+	cancel_delayed_work_sync(&zram->compact_work);
+
 	/* Make sure all the pending I/O are finished */
 	fsync_bdev(bdev);
 	zram_reset_device(zram);
@@ -1399,21 +2800,49 @@ static void destroy_devices(void)
 	idr_for_each(&zram_index_idr, &zram_remove_cb, NULL);
 	idr_destroy(&zram_index_idr);
 	unregister_blkdev(zram_major, "zram");
+	destroy_workqueue(zram_write_wq);
+	destroy_workqueue(zram_read_wq);
 }
 
 static int __init zram_init(void)
 {
 	int ret;
 
+	BUILD_BUG_ON(__NR_ZRAM_PAGEFLAGS > BITS_PER_LONG);
+
 	ret = class_register(&zram_control_class);
 	if (ret) {
 		pr_err("Unable to register zram-control class\n");
 		return ret;
 	}
 
+	/* reads are on the swap-in path, so keep a rescuer around */
+	zram_read_wq = alloc_workqueue("zram_read",
+			WQ_UNBOUND | WQ_HIGHPRI | WQ_MEM_RECLAIM, 0);
+	if (!zram_read_wq) {
+		pr_err("Unable to allocate read workqueue\n");
+		class_unregister(&zram_control_class);
+		return -ENOMEM;
+	}
+
+	/*
+	 * Swap-out compression. WQ_SYSFS exposes the cpumask so the
+	 * workers can be confined to one cluster from userspace.
+	 */
+	zram_write_wq = alloc_workqueue("zram_write",
+			WQ_UNBOUND | WQ_MEM_RECLAIM | WQ_SYSFS, 0);
+	if (!zram_write_wq) {
+		pr_err("Unable to allocate write workqueue\n");
+		destroy_workqueue(zram_read_wq);
+		class_unregister(&zram_control_class);
+		return -ENOMEM;
+	}
+
 	zram_major = register_blkdev(0, "zram");
 	if (zram_major <= 0) {
 		pr_err("Unable to get major number\n");
+		destroy_workqueue(zram_write_wq);
+		destroy_workqueue(zram_read_wq);
 		class_unregister(&zram_control_class);
 		return -EBUSY;
 	}
@@ -15,7 +15,10 @@
 #ifndef _ZRAM_DRV_H_
 #define _ZRAM_DRV_H_
 
+#include <linux/notifier.h>
+#include <linux/rbtree.h>
 #include <linux/spinlock.h>
+#include <linux/workqueue.h>
 #include <linux/zsmalloc.h>
 
 #include "zcomp.h"
@@ -34,6 +37,18 @@ static const size_t max_zpage_size = PAGE_SIZE / 4 * 3;
  * always return failure.
  */
 
+/* compression workers per device for async writes */
+#define ZRAM_WRITE_WORKERS	4
+/* slot frees from process teardown that can wait for the free worker */
+#define ZRAM_FREE_RING		512
+/* pages a worker takes off the queue at once */
+#define ZRAM_WRITE_BATCH	16
+/* beyond this many queued pages writes are done synchronously */
+#define ZRAM_WRITE_MAX_PENDING	256
+
+/* minimum gap between two automatic compactions */
+#define ZRAM_COMPACT_INTERVAL	(60 * HZ)
+
 /*-- End of configurable params */
 
 #define SECTOR_SHIFT		9
@@ -59,18 +74,43 @@ static const size_t max_zpage_size = PAGE_SIZE / 4 * 3;
 
 /* Flags for zram pages (table[page_no].value) */
 enum zram_pageflags {
-	/* Page consists entirely of zeros */
-	ZRAM_ZERO = ZRAM_FLAG_SHIFT,
+	/* Page consists of one repeated word, kept in table[].element */
+	ZRAM_SAME = ZRAM_FLAG_SHIFT,
 	ZRAM_ACCESS,	/* page is now accessed */
+	ZRAM_WB,	/* page is stored on backing device */
+	ZRAM_UNDER_WB,	/* page is being moved (writeback, recompression) */
+	ZRAM_IDLE,	/* page has not been accessed since marked idle */
+	ZRAM_HUGE,	/* page is stored uncompressed */
+	ZRAM_RECOMP,	/* page is compressed with recomp_algorithm */
+	ZRAM_NORECOMP,	/* recompression did not make the page smaller */
+	ZRAM_DEDUP,	/* handle points to a shared struct zram_entry */
+	ZRAM_FREE_PENDING,	/* swap freed the slot, free_work will free it */
 
 	__NR_ZRAM_PAGEFLAGS,
 };
 
 /*-- Data structures */
 
+/* A compressed object that may be shared by several slots */
+struct zram_entry {
+	struct rb_node rb_node;
+	u32 checksum;
+	unsigned int len;
+	unsigned long refcount;	/* protected by zram_hash lock */
+	unsigned long handle;
+};
+
+struct zram_hash {
+	spinlock_t lock;
+	struct rb_root rb_root;
+};
+
 /* Allocated for each disk page */
 struct zram_table_entry {
-	unsigned long handle;
+	union {
+		unsigned long handle;
+		unsigned long element;
+	};
 	unsigned long value;
 };
 
@@ -82,19 +122,49 @@ struct zram_stats {
 	atomic64_t failed_writes;	/* can happen when memory is too low */
 	atomic64_t invalid_io;	/* non-page-aligned I/O requests */
 	atomic64_t notify_free;	/* no. of swap slot free notifications */
-	atomic64_t zero_pages;		/* no. of zero filled pages */
+	atomic64_t same_pages;		/* no. of same element filled pages */
 	atomic64_t pages_stored;	/* no. of pages currently stored */
 	atomic_long_t max_used_pages;	/* no. of maximum pages stored */
+	atomic64_t recomp_pages;	/* no. of recompressed pages stored */
+	atomic64_t recomp_saved;	/* bytes saved by recompression */
+	atomic64_t recomp_ns;	/* time spent recompressing */
+	atomic64_t auto_compactions;	/* no. of background compactions */
+#ifdef CONFIG_ZRAM_DEDUP
+	atomic64_t dedup_hits;	/* no. of writes that found a duplicate */
+	atomic64_t dedup_lookups;	/* no. of duplicate lookups */
+	atomic64_t dedup_ns;	/* time spent in checksum and lookup */
+	atomic64_t dup_data_size;	/* compressed bytes not stored twice */
+#endif
+#ifdef CONFIG_ZRAM_WRITEBACK
+	atomic64_t bd_count;	/* no. of pages in backing device */
+	atomic64_t bd_reads;	/* no. of reads from backing device */
+	atomic64_t bd_writes;	/* no. of writes to backing device */
+#endif
+};
+
+struct zram;
+
+struct zram_write_worker {
+	struct work_struct work;
+	struct zram *zram;
 };
 
 struct zram_meta {
 	struct zram_table_entry *table;
 	struct zs_pool *mem_pool;
+#ifdef CONFIG_ZRAM_DEDUP
+	/* NULL unless the device was initialised with use_dedup */
+	struct zram_hash *hash;
+	size_t hash_size;
+#endif
 };
 
 struct zram {
 	struct zram_meta *meta;
 	struct zcomp *comp;
+	/* secondary algorithm for idle pages, NULL if not configured */
+	struct zcomp *recomp;
+	struct task_struct *recomp_thread;
 	struct gendisk *disk;
 	/* Prevent concurrent execution of device init */
 	struct rw_semaphore init_lock;
@@ -103,6 +173,30 @@ struct zram {
 	 */
 	unsigned long limit_pages;
 	int max_comp_streams;
+	/* hand full-page ->rw_page() reads to the read workqueue */
+	bool parallel_read;
+	/* queue ->rw_page() swap-out to the compression workers */
+	bool async_write;
+	spinlock_t write_lock;
+	struct list_head write_queue;	/* protected by write_lock */
+	int write_pending;		/* protected by write_lock */
+	atomic_t write_next;
+	struct zram_write_worker write_workers[ZRAM_WRITE_WORKERS];
+	/* slot frees queued by exiting tasks, protected by free_lock */
+	spinlock_t free_lock;
+	unsigned int free_head, free_tail;
+	u32 free_ring[ZRAM_FREE_RING];
+	struct work_struct free_work;
+	bool use_dedup;
+	/*
+	 * compact in the background while the display is off and this
+	 * percentage of the pool could be freed, 0 is off
+	 */
+	unsigned int compact_threshold;
+	unsigned long compact_last;	/* jiffies of last auto compaction */
+	struct delayed_work compact_work;
+	struct notifier_block display_nb;
+	bool display_off;
 
 	struct zram_stats stats;
 	atomic_t refcount; /* refcount for zram_meta */
@@ -114,9 +208,23 @@ struct zram {
 	 */
 	u64 disksize;	/* bytes */
 	char compressor[10];
+	char recomp_algorithm[10];
+	/* seconds a page has to stay idle to be recompressed, 0 is off */
+	unsigned int recomp_interval;
 	/*
 	 * zram is claimed so open request will be failed
 	 */
 	bool claim; /* Protected by bdev->bd_mutex */
+#ifdef CONFIG_ZRAM_WRITEBACK
+	struct file *backing_dev;
+	struct block_device *bdev;
+	/* block 0 is never handed out so a stored block is never 0 */
+	unsigned long nr_blocks;
+	unsigned long *bitmap;
+	spinlock_t bitmap_lock;
+#endif
 };
+
+#include "zram_dedup.h"
+
 #endif
@@ -1,6 +1,8 @@
 #ifndef __LINUX_CONTEXTHUB_COMMON_H__
 #define __LINUX_CONTEXTHUB_COMMON_H__
 
+#include <linux/types.h>
+
 #define HM_EN(n)		(0x10001 << (n))
 #define HM_DIS(n)		(0x10000 << (n))
 #define writel_mask(mask, data, addr)	/*lint -save -e717 */do {writel((((u32)readl(addr)) & (~((u32)(mask)))) | ((data) & (mask)), (addr));} while (0)/*lint -restore */
@@ -25,5 +27,21 @@ static inline void clr_bits(unsigned int mask, unsigned long int addr)
     (*(volatile unsigned int *) (addr)) &= ~(mask);
 }
 
+/* per message latency, shown in debugfs contexthub/latency */
+enum contexthub_latency_type {
+	CH_LAT_SHMEM_SEND,	/* send request to sensorhub ack */
+	CH_LAT_SHMEM_RECV,	/* receive request to ack sent back */
+	CH_LAT_SHELL,		/* shell command to response */
+	CH_LAT_MAX,
+};
+
+#ifdef CONFIG_CONTEXTHUB_SHELL
+extern void contexthub_latency_record(unsigned int type, u64 ns);
+#else
+static inline void contexthub_latency_record(unsigned int type, u64 ns)
+{
+}
+#endif
+
 #endif
 
@@ -10,9 +10,15 @@
 #include <linux/debugfs.h>
 #include <linux/delay.h>
 #include <linux/io.h>
+#include <linux/log2.h>
+#include <linux/math64.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
+#include <linux/spinlock.h>
 #include <global_ddr_map.h>
 #include "protocol.h"
 #include "inputhub_route.h"
+#include "common.h"
 
 #define MODULE_NAME "shell_dbg"
 #define CHAR_LR 0xA
@@ -44,6 +50,94 @@ static uint32_t log_address, log_length;
 static char* str_ipc_tmout = "wait:";
 static uint32_t ipc_tmout = 6000;
 
+/* bucket n counts latencies below 2^n us, the last one everything above */
+#define CH_LAT_BUCKETS	16
+
+struct ch_latency {
+	u64 count;
+	u64 total_ns;
+	u64 max_ns;
+	u64 bucket[CH_LAT_BUCKETS];
+};
+
+static struct ch_latency ch_latency[CH_LAT_MAX];
+static DEFINE_SPINLOCK(ch_latency_lock);
+static const char *const ch_latency_name[CH_LAT_MAX] = {
+	[CH_LAT_SHMEM_SEND] = "shmem_send",
+	[CH_LAT_SHMEM_RECV] = "shmem_recv",
+	[CH_LAT_SHELL] = "shell",
+};
+
+void contexthub_latency_record(unsigned int type, u64 ns)
+{
+	struct ch_latency *lat;
+	unsigned long flags;
+	u64 us = ns / NSEC_PER_USEC;
+	unsigned int b = us ? ilog2(us) + 1 : 0;
+
+	if (type >= CH_LAT_MAX)
+		return;
+	lat = &ch_latency[type];
+
+	spin_lock_irqsave(&ch_latency_lock, flags);
+	lat->count++;
+	lat->total_ns += ns;
+	if (ns > lat->max_ns)
+		lat->max_ns = ns;
+	lat->bucket[min_t(unsigned int, b, CH_LAT_BUCKETS - 1)]++;
+	spin_unlock_irqrestore(&ch_latency_lock, flags);
+}
+
+static int ch_latency_show(struct seq_file *s, void *data)
+{
+	struct ch_latency lat;
+	unsigned long flags;
+	int i, b;
+
+	seq_printf(s, "%-12s %10s %10s %10s  buckets(<1,2,4..us)\n",
+		   "type", "count", "avg_us", "max_us");
+	for (i = 0; i < CH_LAT_MAX; i++) {
+		spin_lock_irqsave(&ch_latency_lock, flags);
+		lat = ch_latency[i];
+		spin_unlock_irqrestore(&ch_latency_lock, flags);
+
+		seq_printf(s, "%-12s %10llu %10llu %10llu ", ch_latency_name[i],
+			   lat.count,
+			   lat.count ? div64_u64(lat.total_ns, lat.count) /
+				       NSEC_PER_USEC : 0,
+			   lat.max_ns / NSEC_PER_USEC);
+		for (b = 0; b < CH_LAT_BUCKETS; b++)
+			seq_printf(s, " %llu", lat.bucket[b]);
+		seq_putc(s, '\n');
+	}
+	return 0;
+}
+
+static int ch_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ch_latency_show, NULL);
+}
+
+/* any write clears the statistics */
+static ssize_t ch_latency_write(struct file *file, const char __user *buf,
+				size_t count, loff_t *ppos)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&ch_latency_lock, flags);
+	memset(ch_latency, 0, sizeof(ch_latency));
+	spin_unlock_irqrestore(&ch_latency_lock, flags);
+	return count;
+}
+
+static const struct file_operations ch_latency_fops = {
+	.open = ch_latency_open,
+	.read = seq_read,
+	.write = ch_latency_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static int shell_dbg_resp_ope(const pkt_header_t *head)
 {
 	struct SHELL_DBG_RESP *p = (struct SHELL_DBG_RESP*)head;
@@ -98,6 +192,7 @@ static ssize_t shell_dbg_wr(struct file *file, const char __user *userbuf,
 	ssize_t byte_writen = 0;
 	int i;
 	long val = 0;
+	u64 start;
 
 	get_resp = pro_resp_none;	/* clear resp flag first */
 
@@ -147,6 +242,7 @@ STRING_END:
 	pr_info("shell dgb send str:%s;\n", kn_buf);
 
 	/* process string */
+	start = local_clock();
 	shell_dbg_send(kn_buf, strlen(kn_buf) + 1);
 
 #if (LINUX_VERSION_CODE < KERNEL_VERSION(3, 13, 0))
@@ -159,6 +255,7 @@ STRING_END:
 	if (!!wait_for_completion_timeout
 	    (&wait_resp, msecs_to_jiffies(ipc_tmout))) {
 		get_resp = pro_resp_ipc;
+		contexthub_latency_record(CH_LAT_SHELL, local_clock() - start);
 	}
 
 END:
@@ -198,6 +295,8 @@ static int __init shell_dbg_init(void)
 			} else {
 				pr_info("contexthub shell dbg creat successfully!\n");
 			}
+			debugfs_create_file("latency", 0660, ch_root, NULL,
+					    &ch_latency_fops);
 		}
 	}
 #endif
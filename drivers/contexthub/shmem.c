@@ -11,10 +11,13 @@
 #include <linux/delay.h>
 #include <linux/io.h>
 #include <linux/workqueue.h>
+#include <linux/sched.h>
 
 #include <global_ddr_map.h>
 #include "protocol.h"
 #include "inputhub_route.h"
+#include "common.h"
+#include "shmem.h"
 
 #define SHMEM_AP_RECV_PHY_ADDR (HISI_RESERVED_CH_BLOCK_SHMEM_PHYMEM_BASE)
 #define SHMEM_AP_RECV_PHY_SIZE (HISI_RESERVED_CH_BLOCK_SHMEM_PHYMEM_SIZE/2)
@@ -54,6 +57,7 @@ struct shmem {
 	void __iomem *recv_addr;
 	void __iomem *send_addr;
 	struct semaphore send_sem;
+	u64 send_start;		/* local_clock() of the pending send */
 #ifdef CONFIG_HISI_DEBUG_FS
 	struct dentry *debugfs_root;
 #endif
@@ -79,6 +83,8 @@ static int shmem_recv(const pkt_header_t * head)
 	struct shmem_client *pos, *next;
 	struct shmem_ipc *msg = (struct shmem_ipc *)head;
 	int result = 0;
+	u64 start = local_clock();
+
 	if (NULL == head)
 		return -EINVAL;
 
@@ -99,6 +105,7 @@ static int shmem_recv(const pkt_header_t * head)
 	    shmem_ipc_send(CMD_SHMEM_AP_RECV_RESP, pos->module_id,
 			   msg->data.buf_size);
 	mutex_unlock(&shmem_recv_lock);
+	contexthub_latency_record(CH_LAT_SHMEM_RECV, local_clock() - start);
 	return result;
 }
 
@@ -231,23 +238,62 @@ static int shmem_recv_init(void)
 	return 0;
 }
 
-int shmem_send(obj_tag_t module_id, const void *usr_buf,
-	       unsigned int usr_buf_size)
+unsigned int shmem_send_capacity(void)
+{
+	return SHMEM_AP_SEND_PHY_SIZE;
+}
+
+/*
+ * Gather @nr buffers back to back into the send window and ring the
+ * sensorhub once for all of them, rather than once per piece. The
+ * receiving module sees a single message of the summed size.
+ */
+int shmem_send_vec(obj_tag_t module_id, const struct kvec *vec,
+		   unsigned int nr)
 {
+	unsigned int i, total = 0;
 	int ret;
-	if ((NULL == usr_buf) || (usr_buf_size > SHMEM_AP_SEND_PHY_SIZE))
+
+	if (NULL == vec || !nr)
 		return -EINVAL;
+	for (i = 0; i < nr; i++) {
+		if (NULL == vec[i].iov_base ||
+		    vec[i].iov_len > SHMEM_AP_SEND_PHY_SIZE - total)
+			return -EINVAL;
+		total += vec[i].iov_len;
+	}
 	if (SHMEM_INIT_OK != shmem_gov.init_flag)
 		return -EPERM;
 	ret = down_timeout(&shmem_gov.send_sem, msecs_to_jiffies(500));
 	if (ret)
 		pr_warning("[%s]down_timeout 500\n", __func__);
-	memcpy((void *)shmem_gov.send_addr, usr_buf, usr_buf_size);
-	return shmem_ipc_send(CMD_SHMEM_AP_SEND_REQ, module_id, usr_buf_size);
+
+	total = 0;
+	for (i = 0; i < nr; i++) {
+		memcpy_toio(shmem_gov.send_addr + total, vec[i].iov_base,
+			    vec[i].iov_len);
+		total += vec[i].iov_len;
+	}
+	shmem_gov.send_start = local_clock();
+	return shmem_ipc_send(CMD_SHMEM_AP_SEND_REQ, module_id, total);
+}
+EXPORT_SYMBOL(shmem_send_vec);
+
+int shmem_send(obj_tag_t module_id, const void *usr_buf,
+	       unsigned int usr_buf_size)
+{
+	struct kvec vec = {
+		.iov_base = (void *)usr_buf,
+		.iov_len = usr_buf_size,
+	};
+
+	return shmem_send_vec(module_id, &vec, 1);
 }
 
 static int shmem_send_resp(const pkt_header_t * head)
 {
+	contexthub_latency_record(CH_LAT_SHMEM_SEND,
+				  local_clock() - shmem_gov.send_start);
 	up(&shmem_gov.send_sem);
 	return 0;
 }
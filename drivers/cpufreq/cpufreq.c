@@ -122,6 +122,44 @@ bool cpufreq_driver_is_slow(void)
 }
 EXPORT_SYMBOL_GPL(cpufreq_driver_is_slow);
 
+bool cpufreq_driver_has_fast_switch(void)
+{
+	return !!cpufreq_driver->fast_switch;
+}
+EXPORT_SYMBOL_GPL(cpufreq_driver_has_fast_switch);
+
+/**
+ * cpufreq_driver_fast_switch - switch the frequency without sleeping
+ * @policy: policy to switch, the caller keeps it from going away
+ * @target_freq: new frequency, clamped to the policy limits
+ *
+ * For governors running in scheduler context. The transition notifiers
+ * are not called, policy->cur and the cpu_frequency trace are updated.
+ *
+ * Returns the frequency set, or 0 if the driver could not switch now.
+ */
+unsigned int cpufreq_driver_fast_switch(struct cpufreq_policy *policy,
+					unsigned int target_freq)
+{
+	unsigned int freq;
+	int cpu;
+
+	if (cpufreq_disabled())
+		return 0;
+
+	target_freq = clamp_val(target_freq, policy->min, policy->max);
+	freq = cpufreq_driver->fast_switch(policy, target_freq);
+	if (!freq)
+		return 0;
+
+	policy->cur = freq;
+	for_each_cpu(cpu, policy->cpus)
+		trace_cpu_frequency(freq, cpu);
+
+	return freq;
+}
+EXPORT_SYMBOL_GPL(cpufreq_driver_fast_switch);
+
 struct kobject *get_governor_parent_kobj(struct cpufreq_policy *policy)
 {
 	if (have_governor_per_policy())
@@ -19,6 +19,7 @@
 #include <linux/cpu.h>
 #include <linux/cpumask.h>
 #include <linux/cpufreq.h>
+#include <linux/input.h>
 #include <linux/module.h>
 #include <linux/moduleparam.h>
 #include <linux/rwsem.h>
@@ -151,6 +152,16 @@ struct cpufreq_interactive_tunables {
 	/* boost hmp downthreshold, default 448 */
 	int boost_hmp_downthreshold;
 #endif
+
+#ifdef CONFIG_INPUT
+	/* Floor to hold the policy at after a touch-down, 0 disables */
+	unsigned int input_boost_freq;
+	/* Duration of an input boost in usecs */
+#define DEFAULT_INPUT_BOOST_DURATION (100 * USEC_PER_MSEC)
+	int input_boost_duration;
+	/* End time of input boost in ktime converted to usecs */
+	u64 input_boost_endtime;
+#endif
 };
 
 /* For cases where we have single governor instance for system */
@@ -401,6 +412,8 @@ static void cpufreq_interactive_timer(unsigned long data)
 	unsigned int index;
 	unsigned long flags;
 	u64 max_fvtime;
+	bool input_boosted = false;
+	unsigned int dl_freq;
 
 	if (!down_read_trylock(&pcpu->enable_sem))
 		return;
@@ -421,9 +434,12 @@ static void cpufreq_interactive_timer(unsigned long data)
 	loadadjfreq = (unsigned int)cputime_speedadj * 100;
 	cpu_load = loadadjfreq / pcpu->policy->cur;
 	tunables->boosted = tunables->boost_val || now < tunables->boostpulse_endtime;
+#ifdef CONFIG_INPUT
+	input_boosted = now < tunables->input_boost_endtime;
+#endif
 
 #ifdef CONFIG_HISI_HMPTH_INTERACTIVE
-	if (tunables->hmp_boosted && !tunables->boosted) {
+	if (tunables->hmp_boosted && !tunables->boosted && !input_boosted) {
 		set_hmp_policy(HMP_NAME, HMP_PRIO, HMP_OFF, tunables->boost_hmp_upthreshold,
 				tunables->boost_hmp_downthreshold);
 		tunables->hmp_boosted = false;
@@ -459,6 +475,17 @@ static void cpufreq_interactive_timer(unsigned long data)
 
 	pcpu->loc_hispeed_val_time = now;
 
+#ifdef CONFIG_INPUT
+	if (input_boosted && new_freq < tunables->input_boost_freq)
+		new_freq = tunables->input_boost_freq;
+#endif
+
+	/* Enough speed for the SCHED_DEADLINE reservations on this cpu */
+	dl_freq = (u64)sched_dl_cpu_util(data) *
+		pcpu->policy->cpuinfo.max_freq >> SCHED_CAPACITY_SHIFT;
+	if (new_freq < dl_freq)
+		new_freq = dl_freq;
+
 	if (cpufreq_frequency_table_target(pcpu->policy, pcpu->freq_table,
 					   new_freq, CPUFREQ_RELATION_L,
 					   &index)) {
@@ -695,10 +722,173 @@ static void cpufreq_interactive_boost(struct cpufreq_interactive_tunables *tunab
 		wake_up_process(speedchange_task);
 }
 
+#ifdef CONFIG_INPUT
+/*
+ * Raise every policy with an input_boost_freq to that floor for its
+ * input_boost_duration, on touch-down, without going through userspace.
+ */
+static void cpufreq_interactive_input_boost(struct work_struct *work)
+{
+	int i;
+	int anyboost = 0;
+	unsigned long flags[2];
+	u64 now = ktime_to_us(ktime_get());
+	struct cpufreq_interactive_cpuinfo *pcpu;
+	struct cpufreq_interactive_tunables *tunables;
+#ifdef CONFIG_HISI_HMPTH_INTERACTIVE
+	struct cpufreq_interactive_tunables *hmp_tunables = NULL;
+#endif
+
+	spin_lock_irqsave(&speedchange_cpumask_lock, flags[0]);
+
+	for_each_online_cpu(i) {
+		pcpu = &per_cpu(cpuinfo, i);
+
+		if (!down_read_trylock(&pcpu->enable_sem))
+			continue;
+
+		if (!pcpu->governor_enabled) {
+			up_read(&pcpu->enable_sem);
+			continue;
+		}
+
+		tunables = pcpu->policy->governor_data;
+		if (!tunables->input_boost_freq) {
+			up_read(&pcpu->enable_sem);
+			continue;
+		}
+
+		tunables->input_boost_endtime = now +
+			tunables->input_boost_duration;
+
+		spin_lock_irqsave(&pcpu->target_freq_lock, flags[1]);
+		if (pcpu->target_freq < tunables->input_boost_freq) {
+			pcpu->target_freq = tunables->input_boost_freq;
+			cpumask_set_cpu(i, &speedchange_cpumask);
+			anyboost = 1;
+		}
+		pcpu->floor_freq = tunables->input_boost_freq;
+		pcpu->loc_floor_val_time = now;
+		spin_unlock_irqrestore(&pcpu->target_freq_lock, flags[1]);
+
+#ifdef CONFIG_HISI_HMPTH_INTERACTIVE
+		if (tunables->boost_hmp_val && !tunables->hmp_boosted) {
+			tunables->hmp_boosted = true;
+			hmp_tunables = tunables;
+		}
+#endif
+		up_read(&pcpu->enable_sem);
+	}
+
+	spin_unlock_irqrestore(&speedchange_cpumask_lock, flags[0]);
+
+#ifdef CONFIG_HISI_HMPTH_INTERACTIVE
+	if (hmp_tunables)
+		set_hmp_policy(HMP_NAME, HMP_PRIO, HMP_ON,
+			       hmp_tunables->boost_hmp_upthreshold,
+			       hmp_tunables->boost_hmp_downthreshold);
+#endif
+
+	if (anyboost) {
+		trace_cpufreq_interactive_boost("input");
+		wake_up_process(speedchange_task);
+	}
+}
+
+static DECLARE_WORK(input_boost_work, cpufreq_interactive_input_boost);
+
+/*
+ * For touch drivers that see a contact coming before the report is read
+ * and synced, e.g. in their irq thread, to start the input boost early.
+ */
+void cpufreq_interactive_touch_boost(void)
+{
+	queue_work(system_highpri_wq, &input_boost_work);
+}
+EXPORT_SYMBOL(cpufreq_interactive_touch_boost);
+
+static void cpufreq_interactive_input_event(struct input_handle *handle,
+					    unsigned int type,
+					    unsigned int code, int value)
+{
+	/* only a new contact, moves are covered by the load */
+	if ((type == EV_KEY && code == BTN_TOUCH && value == 1) ||
+	    (type == EV_ABS && code == ABS_MT_TRACKING_ID && value != -1))
+		queue_work(system_highpri_wq, &input_boost_work);
+}
+
+static int cpufreq_interactive_input_connect(struct input_handler *handler,
+					     struct input_dev *dev,
+					     const struct input_device_id *id)
+{
+	struct input_handle *handle;
+	int error;
+
+	handle = kzalloc(sizeof(*handle), GFP_KERNEL);
+	if (!handle)
+		return -ENOMEM;
+
+	handle->dev = dev;
+	handle->handler = handler;
+	handle->name = "cpufreq_interactive";
+
+	error = input_register_handle(handle);
+	if (error)
+		goto err_free;
+
+	error = input_open_device(handle);
+	if (error)
+		goto err_unregister;
+
+	return 0;
+
+err_unregister:
+	input_unregister_handle(handle);
+err_free:
+	kfree(handle);
+	return error;
+}
+
+static void cpufreq_interactive_input_disconnect(struct input_handle *handle)
+{
+	input_close_device(handle);
+	input_unregister_handle(handle);
+	kfree(handle);
+}
+
+/* touchscreens, multi-touch or single-touch */
+static const struct input_device_id cpufreq_interactive_input_ids[] = {
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT |
+			 INPUT_DEVICE_ID_MATCH_ABSBIT,
+		.evbit = { BIT_MASK(EV_ABS) },
+		.absbit = { [BIT_WORD(ABS_MT_POSITION_X)] =
+			    BIT_MASK(ABS_MT_POSITION_X) |
+			    BIT_MASK(ABS_MT_POSITION_Y) },
+	},
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_KEYBIT |
+			 INPUT_DEVICE_ID_MATCH_ABSBIT,
+		.keybit = { [BIT_WORD(BTN_TOUCH)] = BIT_MASK(BTN_TOUCH) },
+		.absbit = { [BIT_WORD(ABS_X)] =
+			    BIT_MASK(ABS_X) | BIT_MASK(ABS_Y) },
+	},
+	{ },
+};
+
+static struct input_handler cpufreq_interactive_input_handler = {
+	.event		= cpufreq_interactive_input_event,
+	.connect	= cpufreq_interactive_input_connect,
+	.disconnect	= cpufreq_interactive_input_disconnect,
+	.name		= "cpufreq_interactive",
+	.id_table	= cpufreq_interactive_input_ids,
+};
+#endif
+
 #ifdef CONFIG_ARCH_HISI
 #define MAX_LITTLE_CPU_NR	4
 
-int hisi_little_cluster_boost(void)
+static int hisi_cpus_boost(const struct cpumask *cpus)
 {
 	int i;
 	int anyboost = 0;
@@ -711,10 +901,7 @@ int hisi_little_cluster_boost(void)
 
 	spin_lock_irqsave(&speedchange_cpumask_lock, flags);
 
-	for_each_online_cpu(i) {
-		if (i == MAX_LITTLE_CPU_NR)
-			break;
-
+	for_each_cpu_and(i, cpus, cpu_online_mask) {
 		pcpu = &per_cpu(cpuinfo, i);
 		if (!pcpu->governor_enabled)
 			continue;
@@ -745,7 +932,32 @@ int hisi_little_cluster_boost(void)
 
 	return 0;
 }
+
+int hisi_little_cluster_boost(void)
+{
+	struct cpumask little;
+	int i;
+
+	cpumask_clear(&little);
+	for (i = 0; i < MAX_LITTLE_CPU_NR && i < nr_cpu_ids; i++)
+		cpumask_set_cpu(i, &little);
+
+	return hisi_cpus_boost(&little);
+}
 EXPORT_SYMBOL(hisi_little_cluster_boost);
+
+/*
+ * Boost the cluster of @cpu to hispeed_freq, for drivers that know where
+ * the work they are waiting for runs.
+ */
+int hisi_cluster_boost(int cpu)
+{
+	if (cpu < 0 || cpu >= nr_cpu_ids)
+		return -EINVAL;
+
+	return hisi_cpus_boost(topology_core_cpumask(cpu));
+}
+EXPORT_SYMBOL(hisi_cluster_boost);
 #endif
 
 static int cpufreq_interactive_notifier(
@@ -1135,6 +1347,48 @@ static ssize_t store_io_is_busy(struct cpufreq_interactive_tunables *tunables,
 	return count;
 }
 
+#ifdef CONFIG_INPUT
+static ssize_t show_input_boost_freq(struct cpufreq_interactive_tunables
+		*tunables, char *buf)
+{
+	return sprintf(buf, "%u\n", tunables->input_boost_freq);
+}
+
+static ssize_t store_input_boost_freq(struct cpufreq_interactive_tunables
+		*tunables, const char *buf, size_t count)
+{
+	int ret;
+	unsigned long val;
+
+	ret = kstrtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+
+	tunables->input_boost_freq = val;
+	return count;
+}
+
+static ssize_t show_input_boost_duration(struct cpufreq_interactive_tunables
+		*tunables, char *buf)
+{
+	return sprintf(buf, "%d\n", tunables->input_boost_duration);
+}
+
+static ssize_t store_input_boost_duration(struct cpufreq_interactive_tunables
+		*tunables, const char *buf, size_t count)
+{
+	int ret;
+	unsigned long val;
+
+	ret = kstrtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+
+	tunables->input_boost_duration = val;
+	return count;
+}
+#endif
+
 #ifdef CONFIG_HISI_HMPTH_INTERACTIVE
 static ssize_t show_boost_hmp(struct cpufreq_interactive_tunables *tunables,
 		char *buf)
@@ -1244,6 +1498,10 @@ show_store_gov_pol_sys(boostpulse_duration);
 show_store_gov_pol_sys(boostpulse_min_interval);
 #endif
 show_store_gov_pol_sys(io_is_busy);
+#ifdef CONFIG_INPUT
+show_store_gov_pol_sys(input_boost_freq);
+show_store_gov_pol_sys(input_boost_duration);
+#endif
 #ifdef CONFIG_HISI_HMPTH_INTERACTIVE
 show_store_gov_pol_sys(boost_hmp);
 show_store_gov_pol_sys(boost_hmp_upthreshold);
@@ -1276,6 +1534,10 @@ gov_sys_pol_attr_rw(boostpulse_duration);
 gov_sys_pol_attr_rw(boostpulse_min_interval);
 #endif
 gov_sys_pol_attr_rw(io_is_busy);
+#ifdef CONFIG_INPUT
+gov_sys_pol_attr_rw(input_boost_freq);
+gov_sys_pol_attr_rw(input_boost_duration);
+#endif
 #ifdef CONFIG_HISI_HMPTH_INTERACTIVE
 gov_sys_pol_attr_rw(boost_hmp);
 gov_sys_pol_attr_rw(boost_hmp_upthreshold);
@@ -1305,6 +1567,10 @@ static struct attribute *interactive_attributes_gov_sys[] = {
 	&boostpulse_min_interval_gov_sys.attr,
 #endif
 	&io_is_busy_gov_sys.attr,
+#ifdef CONFIG_INPUT
+	&input_boost_freq_gov_sys.attr,
+	&input_boost_duration_gov_sys.attr,
+#endif
 #ifdef CONFIG_HISI_HMPTH_INTERACTIVE
 	&boost_hmp_gov_sys.attr,
 	&boost_hmp_upthreshold_gov_sys.attr,
@@ -1334,6 +1600,10 @@ static struct attribute *interactive_attributes_gov_pol[] = {
 	&boostpulse_min_interval_gov_pol.attr,
 #endif
 	&io_is_busy_gov_pol.attr,
+#ifdef CONFIG_INPUT
+	&input_boost_freq_gov_pol.attr,
+	&input_boost_duration_gov_pol.attr,
+#endif
 #ifdef CONFIG_HISI_HMPTH_INTERACTIVE
 	&boost_hmp_gov_pol.attr,
 	&boost_hmp_upthreshold_gov_pol.attr,
@@ -1420,6 +1690,9 @@ static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 #ifdef CONFIG_ARCH_HISI
 		tunables->boostpulse_min_interval = DEFAULT_MIN_BOOSTPULSE_INTERVAL;
 #endif
+#ifdef CONFIG_INPUT
+		tunables->input_boost_duration = DEFAULT_INPUT_BOOST_DURATION;
+#endif
 
 #ifdef CONFIG_HISI_HMPTH_INTERACTIVE
 		tunables->boost_hmp_upthreshold = DEFAULT_HMP_UP_THRESHOLD;
@@ -1614,6 +1887,11 @@ static int __init cpufreq_interactive_init(void)
 	/* NB: wake up so the thread does not look hung to the freezer */
 	wake_up_process(speedchange_task);
 
+#ifdef CONFIG_INPUT
+	if (input_register_handler(&cpufreq_interactive_input_handler))
+		pr_warn("%s: failed to register input handler\n", __func__);
+#endif
+
 	return cpufreq_register_governor(&cpufreq_gov_interactive);
 }
 
@@ -1626,6 +1904,10 @@ module_init(cpufreq_interactive_init);
 static void __exit cpufreq_interactive_exit(void)
 {
 	cpufreq_unregister_governor(&cpufreq_gov_interactive);
+#ifdef CONFIG_INPUT
+	input_unregister_handler(&cpufreq_interactive_input_handler);
+	cancel_work_sync(&input_boost_work);
+#endif
 	kthread_stop(speedchange_task);
 	put_task_struct(speedchange_task);
 }
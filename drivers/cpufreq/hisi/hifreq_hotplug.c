@@ -47,9 +47,20 @@ struct driver_data {
 	/* request hotplug up when sum of rq->nr_running over this value */
 #define DEFAULT_UP_NR_THRESHOLD	3
 	unsigned int up_nr_threshold;
-	/* request hotplug down when sum of rq->nr_running below this value */
+	/* request hotplug down when average of the sum below this value */
 #define DEFAULT_DOWN_NR_THRESHOLD	3
 	unsigned int down_nr_threshold;
+	/* average of the sum of rq->nr_running, in 1/16 */
+#define NR_AVG_SHIFT	4
+	unsigned int nr_avg;
+	/*
+	 * request hotplug up when the cpus left with the hotplug cpus down
+	 * are busier than this, in percent, and down below the other one
+	 */
+#define DEFAULT_UP_DEMAND_PCT	90
+	unsigned int up_demand_pct;
+#define DEFAULT_DOWN_DEMAND_PCT	60
+	unsigned int down_demand_pct;
 	/* req_up_cnt reach this value, hotplug up */
 #define DEFAULT_UP_CNT_THRESHOLD	1
 	unsigned int up_cnt_threshold;
@@ -71,6 +82,10 @@ struct driver_data {
 	bool need_down;
 	bool hotplugged_down;
 	bool hotplug_in_progress;
+	/* park the hotplug cpus by isolating them instead of cpu_down() */
+	bool park_isolate;
+	/* the hotplug cpus are down, isolated rather than offline */
+	bool parked_isolated;
 };
 
 static struct driver_data bL_cpufreq_data;
@@ -91,7 +106,8 @@ EXPORT_SYMBOL_GPL(set_bL_hifreq_hotplug_switch);
 bool cpufreq_hotplugged(int cpu)
 {
 	if (cpumask_test_cpu(cpu, &hotplug_cpumask))
-		return bL_cpufreq_data.hotplugged_down;
+		return bL_cpufreq_data.hotplugged_down &&
+			!bL_cpufreq_data.parked_isolated;
 	else
 		return false;
 }
@@ -142,6 +158,24 @@ static ssize_t show_stay_down_delay(struct kobject *kobj,
 	return sprintf(buf, "%u\n", bL_cpufreq_data.stay_down_delay);
 }
 
+static ssize_t show_up_demand_pct(struct kobject *kobj,
+				 struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", bL_cpufreq_data.up_demand_pct);
+}
+
+static ssize_t show_down_demand_pct(struct kobject *kobj,
+				 struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", bL_cpufreq_data.down_demand_pct);
+}
+
+static ssize_t show_park_isolate(struct kobject *kobj,
+				 struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", bL_cpufreq_data.park_isolate);
+}
+
 static ssize_t store_down_nr_threshold(struct kobject *kobj, struct attribute *attr,
 				  const char *buf, size_t count)
 {
@@ -232,12 +266,64 @@ static ssize_t store_stay_down_delay(struct kobject *kobj, struct attribute *att
 	return count;
 }
 
+static ssize_t store_up_demand_pct(struct kobject *kobj, struct attribute *attr,
+				  const char *buf, size_t count)
+{
+	int ret;
+	unsigned int val;
+
+	ret = kstrtouint(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+
+	if (val < bL_cpufreq_data.down_demand_pct)
+		return count;
+
+	bL_cpufreq_data.up_demand_pct = val;
+	return count;
+}
+
+static ssize_t store_down_demand_pct(struct kobject *kobj, struct attribute *attr,
+				  const char *buf, size_t count)
+{
+	int ret;
+	unsigned int val;
+
+	ret = kstrtouint(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+
+	if (val > bL_cpufreq_data.up_demand_pct)
+		return count;
+
+	bL_cpufreq_data.down_demand_pct = val;
+	return count;
+}
+
+static ssize_t store_park_isolate(struct kobject *kobj, struct attribute *attr,
+				  const char *buf, size_t count)
+{
+	int ret;
+	unsigned int val;
+
+	ret = kstrtouint(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+
+	/* takes effect with the next hotplug down */
+	bL_cpufreq_data.park_isolate = !!val;
+	return count;
+}
+
 define_one_global_rw(up_nr_threshold);
 define_one_global_rw(down_nr_threshold);
 define_one_global_rw(up_cnt_threshold);
 define_one_global_rw(down_cnt_threshold);
 define_one_global_rw(stay_up_delay);
 define_one_global_rw(stay_down_delay);
+define_one_global_rw(up_demand_pct);
+define_one_global_rw(down_demand_pct);
+define_one_global_rw(park_isolate);
 
 static void bL_hotplug_sysfs_create(void)
 {
@@ -267,6 +353,18 @@ static void bL_hotplug_sysfs_create(void)
 	if (ret)
 		goto err_create_sysfs;
 
+	ret = cpufreq_sysfs_create_file(&up_demand_pct.attr);
+	if (ret)
+		goto err_create_sysfs;
+
+	ret = cpufreq_sysfs_create_file(&down_demand_pct.attr);
+	if (ret)
+		goto err_create_sysfs;
+
+	ret = cpufreq_sysfs_create_file(&park_isolate.attr);
+	if (ret)
+		goto err_create_sysfs;
+
 	return;
 
 err_create_sysfs:
@@ -297,19 +395,54 @@ static unsigned int bL_cpufreq_get_real_rate(unsigned int cpu)
 	return freq;
 }
 
+/*
+ * Isolate the hotplug cpus from the scheduler, all of them or none.
+ * They stay online, so unparking is a matter of microseconds.
+ */
+static bool hifreq_isolate_cpus(void)
+{
+	unsigned int cpu;
+
+	for_each_cpu(cpu, &hotplug_cpumask) {
+		if (sched_isolate_cpu(cpu)) {
+			for_each_cpu(cpu, &hotplug_cpumask)
+				sched_unisolate_cpu(cpu);
+			return false;
+		}
+	}
+
+	return true;
+}
+
 /*lint -e550*/
 static void hifreq_hotplug_cpu(bool offline)
 {
 	unsigned int cpu;
 	struct device *cpu_dev;
 	unsigned long flags;
+	bool isolate;
 
 	spin_lock_irqsave(&(bL_cpufreq_data.hotplug_lock), flags);
 	bL_cpufreq_data.hotplug_in_progress = true;
+	isolate = offline ? bL_cpufreq_data.park_isolate :
+			    bL_cpufreq_data.parked_isolated;
 	spin_unlock_irqrestore(&(bL_cpufreq_data.hotplug_lock), flags);
 
+	if (isolate) {
+		if (!offline) {
+			for_each_cpu(cpu, &hotplug_cpumask)
+				sched_unisolate_cpu(cpu);
+			goto done;
+		}
+		/* fall back to a real hotplug if that fails */
+		isolate = hifreq_isolate_cpus();
+		if (isolate)
+			goto done;
+	}
+
 	/*lint -e570 -e713 -e574 -e737 -e730*/
 	for_each_cpu(cpu, &hotplug_cpumask) {
+
 		cpu_dev = get_cpu_device(cpu);
 		device_lock(cpu_dev);
 
@@ -327,9 +460,11 @@ static void hifreq_hotplug_cpu(bool offline)
 	}
 	/*lint +e570 +e713 +e574 +e737 +e730*/
 
+done:
 	spin_lock_irqsave(&(bL_cpufreq_data.hotplug_lock), flags);
 	bL_cpufreq_data.hotplug_in_progress = false;
 	bL_cpufreq_data.hotplugged_down = offline;
+	bL_cpufreq_data.parked_isolated = offline && isolate;
 	bL_cpufreq_data.last_down_time = ktime_to_us(ktime_get());
 	spin_unlock_irqrestore(&(bL_cpufreq_data.hotplug_lock), flags);
 }
@@ -407,6 +542,27 @@ retry:
 }
 /*lint +e715*/
 
+/*
+ * Busy percentage of the cpus of @policy that stay up, with the load of
+ * the hotplug cpus moved onto them, from the scheduler's demand.
+ */
+static unsigned int hifreq_hotplug_demand(struct cpufreq_policy *policy)
+{
+#ifdef CONFIG_SCHED_CORE_CTL
+	unsigned int cpu, nr = 0, sum = 0;
+
+	for_each_cpu(cpu, policy->cpus) {
+		sum += sched_cpu_demand(cpu);
+		if (!cpumask_test_cpu(cpu, &hotplug_cpumask))
+			nr++;
+	}
+
+	return nr ? sum * 100 / (nr * SCHED_CAPACITY_SCALE) : 0;
+#else
+	return 0;
+#endif
+}
+
 static void bL_hifreq_hotplug_clear_req(void)
 {
 	bL_cpufreq_data.req_up_cnt = 0;
@@ -419,6 +575,7 @@ int bL_hifreq_hotplug_set_target(struct cpufreq_policy *policy,
 	unsigned int cpu = policy->cpu;
 	int ret, boost = 0;
 	unsigned int nr_runnings = 0;
+	unsigned int demand;
 	struct cpufreq_freqs freqs = {.old = policy->cur, .flags = 0};
 	unsigned long flags;
 	s64 now;
@@ -451,10 +608,15 @@ int bL_hifreq_hotplug_set_target(struct cpufreq_policy *policy,
 #endif
 	now = ktime_to_us(ktime_get());
 	nr_runnings = cpu_nr_runnings(policy->cpus);
+	demand = hifreq_hotplug_demand(policy);
 
 	spin_lock_irqsave(&(bL_cpufreq_data.hotplug_lock), flags);
 	offline = bL_cpufreq_data.hotplugged_down;
-	if (nr_runnings > bL_cpufreq_data.up_nr_threshold || boost) {
+	/* up on the current count, but down only once the average dropped */
+	bL_cpufreq_data.nr_avg = (bL_cpufreq_data.nr_avg * 3 +
+				  (nr_runnings << NR_AVG_SHIFT)) >> 2;
+	if (nr_runnings > bL_cpufreq_data.up_nr_threshold ||
+	    demand > bL_cpufreq_data.up_demand_pct || boost) {
 		/* if already online, freq up to at most THRESHOLD_FREQ */
 		if (!offline) {
 			bL_hifreq_hotplug_clear_req();
@@ -484,7 +646,9 @@ int bL_hifreq_hotplug_set_target(struct cpufreq_policy *policy,
 		bL_cpufreq_data.freqs.new = THRESHOLD_FREQ;
 		bL_cpufreq_data.freqs.old = policy->cur;
 		bL_cpufreq_data.need_up = true;
-	} else if (nr_runnings < bL_cpufreq_data.down_nr_threshold) {
+	} else if (bL_cpufreq_data.nr_avg <
+		   (bL_cpufreq_data.down_nr_threshold << NR_AVG_SHIFT) &&
+		   demand < bL_cpufreq_data.down_demand_pct) {
 		/* if already offline, freq no limit */
 		if (offline) {
 			bL_hifreq_hotplug_clear_req();
@@ -584,6 +748,11 @@ void bL_hifreq_hotplug_init(void)
 	data->down_cnt_threshold = DEFAULT_DOWN_CNT_THRESHOLD;
 	data->stay_up_delay = DEFAULT_STAY_UP_DELAY;
 	data->stay_down_delay = DEFAULT_STAY_DOWN_DELAY;
+	data->nr_avg = 0;
+	data->up_demand_pct = DEFAULT_UP_DEMAND_PCT;
+	data->down_demand_pct = DEFAULT_DOWN_DEMAND_PCT;
+	data->park_isolate = IS_ENABLED(CONFIG_SCHED_CORE_CTL);
+	data->parked_isolated = false;
 	data->req_up_cnt = 0;
 	data->req_down_cnt = 0;
 	data->need_up = false;
@@ -170,6 +170,8 @@ int cpuidle_enter_state(struct cpuidle_device *dev, struct cpuidle_driver *drv,
 	bool broadcast = !!(target_state->flags & CPUIDLE_FLAG_TIMER_STOP);
 	ktime_t time_start, time_end;
 	s64 diff;
+	struct cpuidle_state_usage *usage;
+	int i;
 
 	/*
 	 * Tell the time framework to switch to a broadcast timer because our
@@ -225,6 +227,31 @@ int cpuidle_enter_state(struct cpuidle_device *dev, struct cpuidle_driver *drv,
 		 */
 		dev->states_usage[entered_state].time += dev->last_residency;
 		dev->states_usage[entered_state].usage++;
+
+		/*
+		 * Count the wrong picks: idle shorter than the target
+		 * residency while a shallower state was enabled, or long
+		 * enough for the next enabled deeper one.
+		 */
+		usage = &dev->states_usage[entered_state];
+		if (diff < drv->states[entered_state].target_residency) {
+			for (i = entered_state - 1; i >= 0; i--) {
+				if (drv->states[i].disabled ||
+				    dev->states_usage[i].disable)
+					continue;
+				usage->above++;
+				break;
+			}
+		} else {
+			for (i = entered_state + 1; i < drv->state_count; i++) {
+				if (drv->states[i].disabled ||
+				    dev->states_usage[i].disable)
+					continue;
+				if (diff >= drv->states[i].target_residency)
+					usage->below++;
+				break;
+			}
+		}
 	} else {
 		dev->last_residency = 0;
 	}
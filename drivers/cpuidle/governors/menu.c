@@ -20,6 +20,7 @@
 #include <linux/sched.h>
 #include <linux/math64.h>
 #include <linux/module.h>
+#include <linux/topology.h>
 
 #define PREDICT_THRESHOLD   5000000 //in us
 /*
@@ -37,6 +38,8 @@
 #define RESOLUTION 1024
 #define DECAY 8
 #define MAX_INTERESTING 50000
+/* a periodic event source that missed this many periods went quiet */
+#define EVENT_STALE_PERIODS 2
 
 
 /*
@@ -117,6 +120,14 @@
  * The iowait factor may look low, but realize that this is also already
  * represented in the system load average.
  *
+ * Cluster states
+ * --------------
+ * A state flagged CPUIDLE_FLAG_CLUSTER powers the whole cluster down, and
+ * the first cpu of the cluster to wake up pays its exit latency. So before
+ * picking one, menu looks at the time until the earliest expected wakeup
+ * of the idle cpus of the cluster and of the known periodic events, such
+ * as the display vsync, and falls back to a cpu state if that is shorter
+ * than the target residency (cluster_predict parameter).
  */
 
 struct menu_device {
@@ -129,8 +140,21 @@ struct menu_device {
 	unsigned int	correction_factor[BUCKETS];
 	unsigned int	intervals[INTERVALS];
 	int		interval_ptr;
+
+	u64		idle_until_ns;	/* expected wakeup, 0 when running */
+};
+
+struct menu_event {
+	u64		last_ns;
+	u32		period_ns;
+	u32		interval_ns;
 };
 
+static struct menu_event menu_events[CPUIDLE_NR_EVENTS];
+
+static bool cluster_predict = true;
+module_param(cluster_predict, bool, 0644);
+
 
 #define LOAD_INT(x) ((x) >> FSHIFT)
 #define LOAD_FRAC(x) LOAD_INT(((x) & (FIXED_1-1)) * 100)
@@ -282,6 +306,101 @@ again:
 	goto again;
 }
 
+/**
+ * cpuidle_periodic_event - records an occurrence of a periodic wakeup source
+ * @event: the source
+ * @when_ns: ktime_get_ns() of the occurrence
+ * @period_ns: period of the source, 0 to learn it from the occurrences
+ */
+void cpuidle_periodic_event(enum cpuidle_event event, u64 when_ns,
+			    u32 period_ns)
+{
+	struct menu_event *ev = &menu_events[event];
+	u64 last = ev->last_ns;
+
+	if (!period_ns && last && when_ns > last) {
+		u32 interval = (u32)min_t(u64, when_ns - last, U32_MAX);
+		s64 diff = (s64)interval - ev->interval_ns;
+
+		/* the interval is the period once it repeats within 1/8 */
+		if (abs64(diff) < ev->interval_ns / 8)
+			period_ns = interval;
+		ev->interval_ns = interval;
+	}
+
+	WRITE_ONCE(ev->period_ns, period_ns);
+	WRITE_ONCE(ev->last_ns, when_ns);
+}
+EXPORT_SYMBOL_GPL(cpuidle_periodic_event);
+
+/* Time until the next expected periodic event, in us */
+static unsigned int menu_next_event_us(u64 now)
+{
+	unsigned int next_us = UINT_MAX;
+	int i;
+
+	for (i = 0; i < CPUIDLE_NR_EVENTS; i++) {
+		u64 last = READ_ONCE(menu_events[i].last_ns);
+		u32 period = READ_ONCE(menu_events[i].period_ns);
+		u32 rem;
+
+		if (!period || !last || now < last)
+			continue;
+		if (now - last > (u64)period * EVENT_STALE_PERIODS)
+			continue;
+
+		div_u64_rem(now - last, period, &rem);
+		next_us = min_t(unsigned int, next_us,
+				(period - rem) / NSEC_PER_USEC);
+	}
+
+	return next_us;
+}
+
+/*
+ * Only power the cluster down if it is expected to stay down for the
+ * target residency of the state; otherwise pick the deepest cpu state.
+ */
+static int menu_cluster_select(struct cpuidle_driver *drv,
+			       struct cpuidle_device *dev,
+			       struct menu_device *data, int idx, u64 now)
+{
+	unsigned int sleep_us = data->predicted_us;
+	int cpu;
+
+	sleep_us = min(sleep_us, menu_next_event_us(now));
+
+	for_each_cpu(cpu, topology_core_cpumask(dev->cpu)) {
+		u64 until;
+
+		if (cpu == dev->cpu)
+			continue;
+
+		/* a running cpu decides for the cluster when it goes idle */
+		until = READ_ONCE(per_cpu(menu_devices, cpu).idle_until_ns);
+		if (!until)
+			continue;
+
+		if (until <= now)
+			sleep_us = 0;
+		else
+			sleep_us = min_t(u64, sleep_us,
+					 div_u64(until - now, NSEC_PER_USEC));
+	}
+
+	while (idx > CPUIDLE_DRIVER_STATE_START &&
+	       (drv->states[idx].flags & CPUIDLE_FLAG_CLUSTER) &&
+	       drv->states[idx].target_residency > sleep_us) {
+		do {
+			idx--;
+		} while (idx > CPUIDLE_DRIVER_STATE_START &&
+			 (drv->states[idx].disabled ||
+			  dev->states_usage[idx].disable));
+	}
+
+	return idx;
+}
+
 /**
  * menu_select - selects the next idle state to enter
  * @drv: cpuidle driver containing state data
@@ -301,6 +420,7 @@ static int menu_select(struct cpuidle_driver *drv, struct cpuidle_device *dev)
 	}
 
 	data->last_state_idx = CPUIDLE_DRIVER_STATE_START - 1;
+	data->idle_until_ns = 0;
 
 	/* Special case when user has set very strict latency requirement */
 	if (unlikely(latency_req == 0))
@@ -368,6 +488,18 @@ static int menu_select(struct cpuidle_driver *drv, struct cpuidle_device *dev)
 		data->last_state_idx = i;
 	}
 
+	if (cluster_predict) {
+		u64 now = ktime_get_ns();
+		int idx = data->last_state_idx;
+
+		if (idx >= 0 && (drv->states[idx].flags & CPUIDLE_FLAG_CLUSTER))
+			data->last_state_idx = menu_cluster_select(drv, dev,
+							data, idx, now);
+
+		WRITE_ONCE(data->idle_until_ns,
+			   now + (u64)data->predicted_us * NSEC_PER_USEC);
+	}
+
 	return data->last_state_idx;
 }
 
@@ -385,6 +517,7 @@ static void menu_reflect(struct cpuidle_device *dev, int index)
 
 	data->last_state_idx = index;
 	data->needs_update = 1;
+	WRITE_ONCE(data->idle_until_ns, 0);
 }
 
 /**
@@ -186,6 +186,13 @@ static int __init hisi_idle_drv_init(struct cpuidle_driver *drv)
 		return ret ? : -ENODEV;
 	}
 
+	/*
+	 * Below wfi and cpu off, the deepest state also powers the
+	 * cluster down.
+	 */
+	if (drv->state_count > 2)
+		drv->states[drv->state_count - 1].flags |= CPUIDLE_FLAG_CLUSTER;
+
 	/*
 	 * Call arch CPU operations in order to initialize
 	 * idle states suspend back-end specific data
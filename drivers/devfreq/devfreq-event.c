@@ -212,6 +212,61 @@ int devfreq_event_reset_event(struct devfreq_event_dev *edev)
 }
 EXPORT_SYMBOL_GPL(devfreq_event_reset_event);
 
+/**
+ * devfreq_event_register_notifier() - Register a notifier for the events
+ *				       of devfreq-event dev.
+ * @edev	: the devfreq-event device
+ * @nb		: the notifier block, called in atomic context
+ *
+ * Note that this function let a devfreq device react to the thresholds or
+ * other conditions of the devfreq-event device as they happen, instead of
+ * waiting for the next polling period.
+ */
+int devfreq_event_register_notifier(struct devfreq_event_dev *edev,
+				    struct notifier_block *nb)
+{
+	if (!edev || !nb)
+		return -EINVAL;
+
+	return atomic_notifier_chain_register(&edev->nh, nb);
+}
+EXPORT_SYMBOL_GPL(devfreq_event_register_notifier);
+
+/**
+ * devfreq_event_unregister_notifier() - Unregister a notifier of
+ *					 devfreq-event dev.
+ * @edev	: the devfreq-event device
+ * @nb		: the notifier block
+ *
+ * Note that the notifier is not running on any cpu when this returns.
+ */
+int devfreq_event_unregister_notifier(struct devfreq_event_dev *edev,
+				      struct notifier_block *nb)
+{
+	if (!edev || !nb)
+		return -EINVAL;
+
+	return atomic_notifier_chain_unregister(&edev->nh, nb);
+}
+EXPORT_SYMBOL_GPL(devfreq_event_unregister_notifier);
+
+/**
+ * devfreq_event_notify() - Notify an event of devfreq-event dev.
+ * @edev	: the devfreq-event device
+ * @event	: DEVFREQ_EVENT_* event
+ *
+ * Note that this function is called by devfreq-event device drivers, also
+ * from their interrupt handlers.
+ */
+void devfreq_event_notify(struct devfreq_event_dev *edev, unsigned long event)
+{
+	if (!edev)
+		return;
+
+	atomic_notifier_call_chain(&edev->nh, event, edev);
+}
+EXPORT_SYMBOL_GPL(devfreq_event_notify);
+
 /**
  * devfreq_event_get_edev_by_phandle() - Get the devfreq-event dev from
  *					 devicetree.
@@ -325,6 +380,7 @@ struct devfreq_event_dev *devfreq_event_add_edev(struct device *dev,
 		return ERR_PTR(-ENOMEM);
 
 	mutex_init(&edev->lock);
+	ATOMIC_INIT_NOTIFIER_HEAD(&edev->nh);
 	edev->desc = desc;
 	edev->enable_count = 0;
 	edev->dev.parent = dev;
@@ -25,6 +25,7 @@
 #include <linux/list.h>
 #include <linux/printk.h>
 #include <linux/hrtimer.h>
+#include <linux/of.h>
 #include "governor.h"
 
 static struct class *devfreq_class;
@@ -42,6 +43,18 @@ static LIST_HEAD(devfreq_governor_list);
 static LIST_HEAD(devfreq_list);
 static DEFINE_MUTEX(devfreq_list_lock);
 
+/* polls at the lowest frequency before the monitor defers polling */
+#define DEVFREQ_IDLE_POLLS	4
+
+struct devfreq_event_sub {
+	struct list_head node;
+	struct notifier_block nb;
+	struct devfreq *devfreq;
+	struct devfreq_event_dev *edev;
+};
+
+static void devfreq_monitor_unsubscribe_all(struct devfreq *devfreq);
+
 /**
  * find_device_devfreq() - find devfreq struct using device pointer
  * @dev:	device pointer used to lookup device devfreq.
@@ -150,6 +163,21 @@ static struct devfreq_governor *find_devfreq_governor(const char *name)
 
 /* Load monitoring helper functions for governors use */
 
+/* the lowest frequency the device can be set to, 0 if not known */
+static unsigned long devfreq_floor_freq(struct devfreq *devfreq)
+{
+	struct devfreq_dev_profile *profile = devfreq->profile;
+	unsigned long floor = ULONG_MAX;
+	int i;
+
+	for (i = 0; i < profile->max_state; i++)
+		floor = min_t(unsigned long, floor, profile->freq_table[i]);
+	if (floor == ULONG_MAX)
+		floor = 0;
+
+	return max(floor, devfreq->min_freq);
+}
+
 /**
  * update_devfreq() - Reevaluate the device and configure frequency.
  * @devfreq:	the devfreq instance.
@@ -203,10 +231,55 @@ int update_devfreq(struct devfreq *devfreq)
 				"Couldn't update frequency transition information.\n");
 
 	devfreq->previous_freq = freq;
+
+	/* raised from outside the monitor: resume regular polling */
+	if (devfreq->monitor_idle && !devfreq->stop_polling &&
+			freq > devfreq_floor_freq(devfreq)) {
+		devfreq->monitor_idle = false;
+		devfreq->idle_polls = 0;
+		mod_delayed_work(devfreq_wq, &devfreq->work,
+			msecs_to_jiffies(devfreq->profile->polling_ms));
+	}
+
 	return err;
 }
 EXPORT_SYMBOL(update_devfreq);
 
+/*
+ * Delay in ms until the next poll, 0 to wait for an event. Once the device
+ * has stayed at its lowest frequency for DEVFREQ_IDLE_POLLS polls, there is
+ * nothing to lower any more and the monitor backs off to idle_polling_ms,
+ * or stops until an event if idle_polling_ms is 0 and the governor has
+ * subscribed to devfreq-event devices.
+ */
+static unsigned int devfreq_monitor_delay(struct devfreq *devfreq)
+{
+	struct devfreq_dev_profile *profile = devfreq->profile;
+
+	if (devfreq->previous_freq > devfreq_floor_freq(devfreq)) {
+		devfreq->idle_polls = 0;
+		devfreq->monitor_idle = false;
+		return profile->polling_ms;
+	}
+
+	if (devfreq->idle_polls < DEVFREQ_IDLE_POLLS) {
+		devfreq->idle_polls++;
+		return profile->polling_ms;
+	}
+
+	if (profile->idle_polling_ms) {
+		devfreq->monitor_idle = true;
+		return max(profile->idle_polling_ms, profile->polling_ms);
+	}
+
+	if (!list_empty(&devfreq->event_subs)) {
+		devfreq->monitor_idle = true;
+		return 0;
+	}
+
+	return profile->polling_ms;
+}
+
 /**
  * devfreq_monitor() - Periodically poll devfreq objects.
  * @work:	the work struct used to run devfreq_monitor periodically.
@@ -218,13 +291,22 @@ static void devfreq_monitor(struct work_struct *work)
 	struct devfreq *devfreq = container_of(work,
 					struct devfreq, work.work);
 
+	unsigned int delay;
+
 	mutex_lock(&devfreq->lock);
+	if (devfreq->stop_polling)
+		goto out;
+
+	devfreq->total_polls++;
 	err = update_devfreq(devfreq);
 	if (err)
 		dev_err(&devfreq->dev, "dvfs failed with (%d) error\n", err);
 
-	queue_delayed_work(devfreq_wq, &devfreq->work,
-				msecs_to_jiffies(devfreq->profile->polling_ms));
+	delay = devfreq_monitor_delay(devfreq);
+	if (delay)
+		queue_delayed_work(devfreq_wq, &devfreq->work,
+					msecs_to_jiffies(delay));
+out:
 	mutex_unlock(&devfreq->lock);
 }
 
@@ -240,6 +322,8 @@ static void devfreq_monitor(struct work_struct *work)
 void devfreq_monitor_start(struct devfreq *devfreq)
 {
 	INIT_DEFERRABLE_WORK(&devfreq->work, devfreq_monitor);
+	devfreq->monitor_idle = false;
+	devfreq->idle_polls = 0;
 	if (devfreq->profile->polling_ms)
 		queue_delayed_work(devfreq_wq, &devfreq->work,
 			msecs_to_jiffies(devfreq->profile->polling_ms));
@@ -252,10 +336,12 @@ EXPORT_SYMBOL(devfreq_monitor_start);
  *
  * Helper function to stop devfreq device load monitoing. Function
  * to be called from governor in response to DEVFREQ_GOV_STOP
- * event when device is removed from devfreq framework.
+ * event when device is removed from devfreq framework. Event
+ * subscriptions of the devfreq instance are dropped first.
  */
 void devfreq_monitor_stop(struct devfreq *devfreq)
 {
+	devfreq_monitor_unsubscribe_all(devfreq);
 	cancel_delayed_work_sync(&devfreq->work);
 }
 EXPORT_SYMBOL(devfreq_monitor_stop);
@@ -303,6 +389,8 @@ void devfreq_monitor_resume(struct devfreq *devfreq)
 	if (!devfreq->stop_polling)
 		goto out;
 
+	devfreq->monitor_idle = false;
+	devfreq->idle_polls = 0;
 	if (!delayed_work_pending(&devfreq->work) &&
 			devfreq->profile->polling_ms)
 		queue_delayed_work(devfreq_wq, &devfreq->work,
@@ -339,6 +427,12 @@ void devfreq_interval_update(struct devfreq *devfreq, unsigned int *delay)
 	if (devfreq->stop_polling)
 		goto out;
 
+	if (devfreq->monitor_idle) {
+		devfreq->monitor_idle = false;
+		devfreq->idle_polls = 0;
+		cur_delay = UINT_MAX;
+	}
+
 	/* if new delay is zero, stop polling */
 	if (!new_delay) {
 		mutex_unlock(&devfreq->lock);
@@ -353,7 +447,10 @@ void devfreq_interval_update(struct devfreq *devfreq, unsigned int *delay)
 		goto out;
 	}
 
-	/* if current delay is greater than new delay, restart polling */
+	/*
+	 * if current delay is greater than new delay, or polling was
+	 * deferred while idle, restart polling
+	 */
 	if (cur_delay > new_delay) {
 		mutex_unlock(&devfreq->lock);
 		cancel_delayed_work_sync(&devfreq->work);
@@ -367,6 +464,134 @@ out:
 }
 EXPORT_SYMBOL(devfreq_interval_update);
 
+/**
+ * devfreq_monitor_kick() - Reevaluate a devfreq instance at once
+ * @devfreq:	the devfreq instance.
+ *
+ * Runs the load monitor now instead of at the next polling period and
+ * ends an idle deferral if the frequency goes up. May be called from
+ * atomic context, between devfreq_monitor_start() and
+ * devfreq_monitor_stop().
+ */
+void devfreq_monitor_kick(struct devfreq *devfreq)
+{
+	if (READ_ONCE(devfreq->stop_polling))
+		return;
+
+	devfreq->total_kicks++;
+	mod_delayed_work(devfreq_wq, &devfreq->work, 0);
+}
+EXPORT_SYMBOL(devfreq_monitor_kick);
+
+static int devfreq_event_sub_call(struct notifier_block *nb,
+				  unsigned long event, void *data)
+{
+	struct devfreq_event_sub *sub = container_of(nb,
+					struct devfreq_event_sub, nb);
+
+	devfreq_monitor_kick(sub->devfreq);
+
+	return NOTIFY_OK;
+}
+
+/**
+ * devfreq_monitor_subscribe() - Kick the load monitor on device events
+ * @devfreq:	the devfreq instance.
+ * @edev:	the devfreq-event device to subscribe to.
+ *
+ * Enables @edev and calls devfreq_monitor_kick() for each of its events.
+ * A devfreq instance with subscriptions stops polling while it idles at
+ * its lowest frequency, unless idle_polling_ms is set. To be called
+ * after devfreq_monitor_start(); devfreq_monitor_stop() drops all
+ * subscriptions.
+ */
+int devfreq_monitor_subscribe(struct devfreq *devfreq,
+			      struct devfreq_event_dev *edev)
+{
+	struct devfreq_event_sub *sub;
+	int err;
+
+	sub = kzalloc(sizeof(*sub), GFP_KERNEL);
+	if (!sub)
+		return -ENOMEM;
+
+	sub->devfreq = devfreq;
+	sub->edev = edev;
+	sub->nb.notifier_call = devfreq_event_sub_call;
+
+	err = devfreq_event_enable_edev(edev);
+	if (err)
+		goto err_free;
+
+	err = devfreq_event_register_notifier(edev, &sub->nb);
+	if (err)
+		goto err_disable;
+
+	mutex_lock(&devfreq->lock);
+	list_add_tail(&sub->node, &devfreq->event_subs);
+	mutex_unlock(&devfreq->lock);
+
+	return 0;
+
+err_disable:
+	devfreq_event_disable_edev(edev);
+err_free:
+	kfree(sub);
+	return err;
+}
+EXPORT_SYMBOL(devfreq_monitor_subscribe);
+
+/**
+ * devfreq_monitor_subscribe_all() - Subscribe to the devfreq-event devices
+ *				     of the parent device
+ * @devfreq:	the devfreq instance.
+ *
+ * Subscribes to each device in the "devfreq-events" property of the
+ * parent device node. Returns the number of subscriptions, 0 if the
+ * property is not there.
+ */
+int devfreq_monitor_subscribe_all(struct devfreq *devfreq)
+{
+	struct device *dev = devfreq->dev.parent;
+	struct devfreq_event_dev *edev;
+	int count, i, err;
+
+	if (!dev->of_node ||
+	    !of_find_property(dev->of_node, "devfreq-events", NULL))
+		return 0;
+
+	count = devfreq_event_get_edev_count(dev);
+	for (i = 0; i < count; i++) {
+		edev = devfreq_event_get_edev_by_phandle(dev, i);
+		if (IS_ERR(edev))
+			return PTR_ERR(edev);
+
+		err = devfreq_monitor_subscribe(devfreq, edev);
+		if (err)
+			return err;
+	}
+
+	return count;
+}
+EXPORT_SYMBOL(devfreq_monitor_subscribe_all);
+
+static void devfreq_monitor_unsubscribe_all(struct devfreq *devfreq)
+{
+	struct devfreq_event_sub *sub, *tmp;
+	LIST_HEAD(subs);
+
+	mutex_lock(&devfreq->lock);
+	list_splice_init(&devfreq->event_subs, &subs);
+	devfreq->monitor_idle = false;
+	mutex_unlock(&devfreq->lock);
+
+	list_for_each_entry_safe(sub, tmp, &subs, node) {
+		devfreq_event_unregister_notifier(sub->edev, &sub->nb);
+		devfreq_event_disable_edev(sub->edev);
+		kfree(sub);
+	}
+}
+
 /**
  * devfreq_notifier_call() - Notify that the device frequency requirements
  *			   has been changed out of devfreq framework.
@@ -477,6 +702,7 @@ struct devfreq *devfreq_add_device(struct device *dev,
 	devfreq->previous_freq = profile->initial_freq;
 	devfreq->data = data;
 	devfreq->nb.notifier_call = devfreq_notifier_call;
+	INIT_LIST_HEAD(&devfreq->event_subs);
 
 	devfreq->trans_table =	devm_kzalloc(dev, sizeof(unsigned int) *
 						devfreq->profile->max_state *
@@ -907,6 +1133,48 @@ static ssize_t polling_interval_store(struct device *dev,
 }
 static DEVICE_ATTR_RW(polling_interval);
 
+static ssize_t idle_polling_interval_show(struct device *dev,
+					  struct device_attribute *attr,
+					  char *buf)
+{
+	return sprintf(buf, "%u\n", to_devfreq(dev)->profile->idle_polling_ms);
+}
+
+static ssize_t idle_polling_interval_store(struct device *dev,
+					   struct device_attribute *attr,
+					   const char *buf, size_t count)
+{
+	struct devfreq *df = to_devfreq(dev);
+	unsigned int value;
+	bool idle;
+
+	if (sscanf(buf, "%u", &value) != 1)
+		return -EINVAL;
+
+	mutex_lock(&df->lock);
+	df->profile->idle_polling_ms = value;
+	idle = df->monitor_idle;
+	mutex_unlock(&df->lock);
+
+	/* rearm a deferred monitor with the new interval */
+	if (idle)
+		devfreq_monitor_kick(df);
+
+	return count;
+}
+static DEVICE_ATTR_RW(idle_polling_interval);
+
+static ssize_t monitor_stat_show(struct device *dev,
+				 struct device_attribute *attr, char *buf)
+{
+	struct devfreq *df = to_devfreq(dev);
+
+	return sprintf(buf, "polls: %u\nkicks: %u\nidle: %d\nevents: %d\n",
+		       df->total_polls, df->total_kicks, df->monitor_idle,
+		       !list_empty(&df->event_subs));
+}
+static DEVICE_ATTR_RO(monitor_stat);
+
 static ssize_t min_freq_store(struct device *dev, struct device_attribute *attr,
 			      const char *buf, size_t count)
 {
@@ -1056,6 +1324,8 @@ static struct attribute *devfreq_attrs[] = {
 	&dev_attr_available_frequencies.attr,
 	&dev_attr_target_freq.attr,
 	&dev_attr_polling_interval.attr,
+	&dev_attr_idle_polling_interval.attr,
+	&dev_attr_monitor_stat.attr,
 	&dev_attr_min_freq.attr,
 	&dev_attr_max_freq.attr,
 	&dev_attr_trans_stat.attr,
@@ -15,6 +15,7 @@
 #define _GOVERNOR_H
 
 #include <linux/devfreq.h>
+#include <linux/devfreq-event.h>
 
 #define to_devfreq(DEV)	container_of((DEV), struct devfreq, dev)
 
@@ -34,6 +35,10 @@ extern void devfreq_monitor_suspend(struct devfreq *devfreq);
 extern void devfreq_monitor_resume(struct devfreq *devfreq);
 extern void devfreq_interval_update(struct devfreq *devfreq,
 					unsigned int *delay);
+extern void devfreq_monitor_kick(struct devfreq *devfreq);
+extern int devfreq_monitor_subscribe(struct devfreq *devfreq,
+					struct devfreq_event_dev *edev);
+extern int devfreq_monitor_subscribe_all(struct devfreq *devfreq);
 
 extern int devfreq_add_governor(struct devfreq_governor *governor);
 extern int devfreq_remove_governor(struct devfreq_governor *governor);
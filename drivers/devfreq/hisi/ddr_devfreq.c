@@ -341,6 +341,7 @@ static int ddr_devfreq_probe(struct platform_device *pdev)
     struct device_node *np = pdev->dev.of_node;
     struct devfreq_pm_qos_data *ddata = NULL;
     const char *type = NULL;
+    const char *governor = "pm_qos";
     int ret = 0;
 
 #ifdef CONFIG_INPUT_PULSE_SUPPORT
@@ -422,6 +423,8 @@ static int ddr_devfreq_probe(struct platform_device *pdev)
 			MODULE_NAME, __func__, __LINE__,ddr_devfreq_pm_qos_data.bytes_per_sec_per_hz,ddr_devfreq_pm_qos_data.bd_utilization);
 		ddata = &ddr_devfreq_pm_qos_data;
 		dev_set_name(&pdev->dev, "ddrfreq");
+		/* e.g. "ddr_bandwidth" to follow the measured traffic */
+		(void)of_property_read_string(np, "governor", &governor);
 	} else if (!strcmp("memory_tput_up_threshold", type)) {
 		ret = of_property_read_u32_array(np, "pm_qos_data_reg", (u32 *) &ddr_devfreq_up_th_pm_qos_data, 0x2);
 		if (ret) {
@@ -489,7 +492,7 @@ static int ddr_devfreq_probe(struct platform_device *pdev)
 		ddev->devfreq = devfreq_add_device(&pdev->dev,
 #endif
 					&ddr_devfreq_dev_profile,
-					"pm_qos",
+					governor,
 					ddata);
 	}
 
@@ -0,0 +1,477 @@
+/*
+ *  linux/drivers/devfreq/hisi/governor_ddr_bandwidth.c
+ *  Copyright (C) 2018 Hisilicon
+ *
+ * base on:
+ *  linux/drivers/devfreq/hisi/governor_pm_qos.c
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/errno.h>
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/devfreq.h>
+#include <linux/jiffies.h>
+#include <linux/list.h>
+#include <linux/math64.h>
+#include <linux/mutex.h>
+#include <linux/pm_qos.h>
+#include <linux/slab.h>
+#include <linux/hisi/hisi_devfreq.h>
+#include "governor_pm_qos.h"
+#include <governor.h>
+
+/*
+ * Default constants for DevFreq-DDR-Bandwidth (DFBW).
+ *
+ * Every polling period the governor reads the DDRC flux counters of each
+ * master port and picks the lowest frequency at which the measured traffic
+ * stays under target_load percent of the DDR bandwidth. While one of the
+ * masters in latency_masters moves more than latency_min_mbps, the lower
+ * latency_target_load is used so that master keeps headroom.
+ *
+ * pm_qos throughput votes still apply, but only for qos_hold_ms after they
+ * change; after that the measured traffic decides. qos_hold_ms of 0 makes
+ * the votes permanent floors, as with the pm_qos governor.
+ */
+#define DFBW_POLLING_MS			(8)
+#define DFBW_TARGET_LOAD		(70)
+#define DFBW_LATENCY_TARGET_LOAD	(50)
+#define DFBW_MIN_TARGET_LOAD		(10)
+#define DFBW_MAX_TARGET_LOAD		(100)
+#define DFBW_LATENCY_MIN_MBPS		(200)
+#define DFBW_DOWN_DELAY_MS		(40)
+#define DFBW_QOS_HOLD_MS		(200)
+
+struct devfreq_ddr_bandwidth_data {
+	struct list_head node;
+	struct devfreq *df;
+	struct notifier_block nb;
+	unsigned int saved_polling_ms;
+
+	/* tunables */
+	unsigned int target_load;
+	unsigned int latency_target_load;
+	unsigned int latency_masters;
+	unsigned int latency_min_mbps;
+	unsigned int down_delay_ms;
+	unsigned int qos_hold_ms;
+
+	/* state */
+	struct hisi_ddr_flux_stat last;
+	bool last_valid;
+	unsigned long qos_jiffies;
+	unsigned long high_freq;
+	unsigned long high_jiffies;
+
+	/* last sample, for sysfs */
+	unsigned long master_mbps[HISI_DDR_FLUX_MAX_MASTERS];
+	unsigned long total_mbps;
+	unsigned long bw_freq;
+	unsigned long qos_freq;
+};
+
+static LIST_HEAD(ddr_bandwidth_list);
+static DEFINE_MUTEX(ddr_bandwidth_mutex);
+
+static struct devfreq_ddr_bandwidth_data *ddr_bandwidth_find(struct devfreq *df)
+{
+	struct devfreq_ddr_bandwidth_data *bw;
+
+	mutex_lock(&ddr_bandwidth_mutex);
+	list_for_each_entry(bw, &ddr_bandwidth_list, node) {
+		if (bw->df == df) {
+			mutex_unlock(&ddr_bandwidth_mutex);
+			return bw;
+		}
+	}
+	mutex_unlock(&ddr_bandwidth_mutex);
+
+	return NULL;
+}
+
+/* MB/s to Hz, the same conversion the pm_qos governor uses */
+static unsigned long ddr_bandwidth_mbps_to_freq(struct devfreq_pm_qos_data *data,
+						unsigned long mbps,
+						unsigned int load)
+{
+	unsigned long mhz;
+
+	if (!mbps)
+		return 0;
+
+	if (mbps > ULONG_MAX / 1000 / 1000 / 100 * data->bytes_per_sec_per_hz * load)
+		return ULONG_MAX;
+
+	mhz = DIV_ROUND_UP(DIV_ROUND_UP(mbps * 100, load),
+			   data->bytes_per_sec_per_hz);
+
+	return mhz * 1000 * 1000;
+}
+
+/* Traffic since the previous poll; returns the frequency it needs */
+static unsigned long ddr_bandwidth_measure(struct devfreq_ddr_bandwidth_data *bw,
+					   struct devfreq_pm_qos_data *data)
+{
+	struct hisi_ddr_flux_stat cur;
+	unsigned int load = bw->target_load;
+	u64 delta_ns, bytes, total = 0;
+	unsigned int i;
+
+	if (hisi_devfreq_get_ddr_flux_stat(&cur))
+		return 0;
+
+	if (!bw->last_valid || cur.time_ns <= bw->last.time_ns) {
+		bw->last = cur;
+		bw->last_valid = true;
+		return 0;
+	}
+
+	delta_ns = cur.time_ns - bw->last.time_ns;
+	for (i = 0; i < cur.nr_masters && i < HISI_DDR_FLUX_MAX_MASTERS; i++) {
+		bytes = (cur.rd_bytes[i] - bw->last.rd_bytes[i]) +
+			(cur.wr_bytes[i] - bw->last.wr_bytes[i]);
+		total += bytes;
+
+		/* bytes per ns is GB/s, times 1000 is MB/s */
+		bw->master_mbps[i] = (unsigned long)div64_u64(bytes * 1000,
+							      delta_ns);
+		if ((bw->latency_masters & BIT(i)) &&
+		    bw->master_mbps[i] >= bw->latency_min_mbps)
+			load = bw->latency_target_load;
+	}
+	bw->last = cur;
+
+	bw->total_mbps = (unsigned long)div64_u64(total * 1000, delta_ns);
+
+	return ddr_bandwidth_mbps_to_freq(data, bw->total_mbps, load);
+}
+
+static int devfreq_ddr_bandwidth_func(struct devfreq *df, unsigned long *freq)
+{
+	struct devfreq_pm_qos_data *data = df->data;
+	struct devfreq_ddr_bandwidth_data *bw;
+	unsigned long qos_freq = 0;
+
+	if (!data)
+		return -EINVAL;
+
+	bw = ddr_bandwidth_find(df);
+	if (!bw)
+		return -EINVAL;
+
+	bw->bw_freq = ddr_bandwidth_measure(bw, data);
+
+	if (!bw->qos_hold_ms || time_before(jiffies, bw->qos_jiffies +
+				msecs_to_jiffies(bw->qos_hold_ms)))
+		qos_freq = ddr_bandwidth_mbps_to_freq(data,
+				pm_qos_request(data->pm_qos_class),
+				data->bd_utilization);
+	bw->qos_freq = qos_freq;
+
+	*freq = max(bw->bw_freq, qos_freq);
+
+	/* go up at once, come down only after down_delay_ms */
+	if (*freq >= bw->high_freq) {
+		bw->high_freq = *freq;
+		bw->high_jiffies = jiffies;
+	} else if (time_before(jiffies, bw->high_jiffies +
+			       msecs_to_jiffies(bw->down_delay_ms))) {
+		*freq = bw->high_freq;
+	} else {
+		bw->high_freq = *freq;
+		bw->high_jiffies = jiffies;
+	}
+
+	if (df->min_freq && *freq < df->min_freq)
+		*freq = df->min_freq;
+	if (df->max_freq && *freq > df->max_freq)
+		*freq = df->max_freq;
+
+	return 0;
+}
+
+static int
+devfreq_ddr_bandwidth_notifier(struct notifier_block *nb, unsigned long val,
+			       void *v)
+{
+	struct devfreq_ddr_bandwidth_data *bw;
+
+	bw = container_of(nb, struct devfreq_ddr_bandwidth_data, nb);
+	mutex_lock(&bw->df->lock);
+	bw->qos_jiffies = jiffies;
+	(void)update_devfreq(bw->df);
+	mutex_unlock(&bw->df->lock);
+
+	return NOTIFY_OK;
+}
+
+#define store_one(object, min, max)						\
+static ssize_t store_##object						\
+(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)	\
+{										\
+	struct devfreq *devfreq = to_devfreq(dev);				\
+	struct devfreq_ddr_bandwidth_data *bw;					\
+	unsigned int input;							\
+	int ret = 0;								\
+	ret = sscanf(buf, "%u", &input);					\
+	if (ret != 1 || input > max || input < min)				\
+		return -EINVAL;							\
+	bw = ddr_bandwidth_find(devfreq);					\
+	if (!bw)								\
+		return -ENODEV;							\
+	mutex_lock(&devfreq->lock);						\
+	bw->object = input;							\
+	ret = update_devfreq(devfreq);						\
+	if (ret == 0)								\
+		ret = count;							\
+	mutex_unlock(&devfreq->lock);						\
+	return ret;								\
+}
+
+store_one(target_load, DFBW_MIN_TARGET_LOAD, DFBW_MAX_TARGET_LOAD)
+store_one(latency_target_load, DFBW_MIN_TARGET_LOAD, DFBW_MAX_TARGET_LOAD)
+store_one(latency_masters, 0, (BIT(HISI_DDR_FLUX_MAX_MASTERS) - 1))
+store_one(latency_min_mbps, 0, UINT_MAX)
+store_one(down_delay_ms, 0, 1000)
+store_one(qos_hold_ms, 0, 10000)
+
+#define show_one(object)					\
+static ssize_t show_##object					\
+(struct device *dev, struct device_attribute *attr, char *buf)	\
+{								\
+	struct devfreq *devfreq = to_devfreq(dev);		\
+	struct devfreq_ddr_bandwidth_data *bw;			\
+	int ret = 0;						\
+	bw = ddr_bandwidth_find(devfreq);			\
+	if (!bw)						\
+		return -ENODEV;					\
+	mutex_lock(&devfreq->lock);				\
+	ret = snprintf(buf, PAGE_SIZE,				\
+			"%lu\n", (unsigned long)bw->object);	\
+	mutex_unlock(&devfreq->lock);				\
+	return ret;						\
+}
+
+show_one(target_load)
+show_one(latency_target_load)
+show_one(latency_masters)
+show_one(latency_min_mbps)
+show_one(down_delay_ms)
+show_one(qos_hold_ms)
+show_one(total_mbps)
+show_one(bw_freq)
+show_one(qos_freq)
+
+/* MB/s moved by each master port during the last polling period */
+static ssize_t show_master_mbps(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct devfreq *devfreq = to_devfreq(dev);
+	struct devfreq_ddr_bandwidth_data *bw;
+	ssize_t count = 0;
+	unsigned int i;
+	int ret;
+
+	bw = ddr_bandwidth_find(devfreq);
+	if (!bw)
+		return -ENODEV;
+
+	mutex_lock(&devfreq->lock);
+	for (i = 0; i < bw->last.nr_masters && i < HISI_DDR_FLUX_MAX_MASTERS; i++) {
+		ret = snprintf(buf + count, (PAGE_SIZE - count), "%s%u %lu\n",
+			(bw->latency_masters & BIT(i)) ? "* " : "  ", i,
+			bw->master_mbps[i]);
+		if (ret >= (PAGE_SIZE - count) || ret < 0)/*lint !e574 */
+			break;
+		count += ret;
+	}
+	mutex_unlock(&devfreq->lock);
+
+	return count;
+}
+
+#define DDR_BANDWIDTH_ATTR_RW(_name) \
+	static DEVICE_ATTR(_name, 0644, show_##_name, store_##_name)
+
+DDR_BANDWIDTH_ATTR_RW(target_load);
+DDR_BANDWIDTH_ATTR_RW(latency_target_load);
+DDR_BANDWIDTH_ATTR_RW(latency_masters);
+DDR_BANDWIDTH_ATTR_RW(latency_min_mbps);
+DDR_BANDWIDTH_ATTR_RW(down_delay_ms);
+DDR_BANDWIDTH_ATTR_RW(qos_hold_ms);
+
+#define DDR_BANDWIDTH_ATTR_RO(_name) \
+	static DEVICE_ATTR(_name, 0444, show_##_name, NULL)
+
+DDR_BANDWIDTH_ATTR_RO(total_mbps);
+DDR_BANDWIDTH_ATTR_RO(bw_freq);
+DDR_BANDWIDTH_ATTR_RO(qos_freq);
+DDR_BANDWIDTH_ATTR_RO(master_mbps);
+
+static struct attribute *dev_entries[] = {
+	&dev_attr_target_load.attr,
+	&dev_attr_latency_target_load.attr,
+	&dev_attr_latency_masters.attr,
+	&dev_attr_latency_min_mbps.attr,
+	&dev_attr_down_delay_ms.attr,
+	&dev_attr_qos_hold_ms.attr,
+	&dev_attr_total_mbps.attr,
+	&dev_attr_bw_freq.attr,
+	&dev_attr_qos_freq.attr,
+	&dev_attr_master_mbps.attr,
+	NULL,
+};
+
+static struct attribute_group dev_attr_group = {
+	.name	= "ddr_bandwidth",
+	.attrs	= dev_entries,
+};
+
+static int ddr_bandwidth_init(struct devfreq *df)
+{
+	struct devfreq_pm_qos_data *data = df->data;
+	struct devfreq_ddr_bandwidth_data *bw;
+	int ret;
+
+	if (!data || !data->bytes_per_sec_per_hz) {
+		pr_err("%s %d, invalid parameter\n", __func__, __LINE__);
+		return -EINVAL;
+	}
+
+	bw = kzalloc(sizeof(*bw), GFP_KERNEL);
+	if (!bw) {
+		pr_err("%s: alloc data err\n", __func__);
+		return -ENOMEM;
+	}
+
+	bw->df = df;
+	bw->target_load = DFBW_TARGET_LOAD;
+	bw->latency_target_load = DFBW_LATENCY_TARGET_LOAD;
+	bw->latency_min_mbps = DFBW_LATENCY_MIN_MBPS;
+	bw->down_delay_ms = DFBW_DOWN_DELAY_MS;
+	bw->qos_hold_ms = DFBW_QOS_HOLD_MS;
+	bw->qos_jiffies = jiffies;
+	bw->high_jiffies = jiffies;
+	if (!data->bd_utilization)
+		data->bd_utilization = DFBW_TARGET_LOAD;
+	INIT_LIST_HEAD(&bw->node);
+
+	bw->nb.notifier_call = devfreq_ddr_bandwidth_notifier;
+	ret = pm_qos_add_notifier(data->pm_qos_class, &bw->nb);
+	if (ret < 0) {
+		pr_err("%s %d, Failed to add pm qos notifier\n",
+						__func__, __LINE__);
+		goto err_data;
+	}
+
+	ret = sysfs_create_group(&df->dev.kobj, &dev_attr_group);
+	if (ret) {
+		pr_err("%s: sysfs create err %d\n", __func__, ret);
+		goto err_notifier;
+	}
+
+	mutex_lock(&ddr_bandwidth_mutex);
+	list_add_tail(&bw->node, &ddr_bandwidth_list);
+	mutex_unlock(&ddr_bandwidth_mutex);
+
+	/* the DDR profile polls at 0 ms, which only suits pm_qos */
+	bw->saved_polling_ms = df->profile->polling_ms;
+	if (!df->profile->polling_ms)
+		df->profile->polling_ms = DFBW_POLLING_MS;
+
+	return 0;
+
+err_notifier:
+	pm_qos_remove_notifier(data->pm_qos_class, &bw->nb);
+err_data:
+	kfree(bw);
+	return ret;
+}
+
+static void ddr_bandwidth_exit(struct devfreq *df)
+{
+	struct devfreq_pm_qos_data *data = df->data;
+	struct devfreq_ddr_bandwidth_data *bw;
+
+	bw = ddr_bandwidth_find(df);
+	if (!bw)
+		return;
+
+	mutex_lock(&ddr_bandwidth_mutex);
+	list_del(&bw->node);
+	mutex_unlock(&ddr_bandwidth_mutex);
+
+	sysfs_remove_group(&df->dev.kobj, &dev_attr_group);
+	pm_qos_remove_notifier(data->pm_qos_class, &bw->nb);
+	df->profile->polling_ms = bw->saved_polling_ms;
+
+	kfree(bw);
+}
+
+static int devfreq_ddr_bandwidth_handler(struct devfreq *devfreq,
+				unsigned int event, void *data)
+{
+	int ret = 0;
+
+	switch (event) {
+	case DEVFREQ_GOV_START:
+		ret = ddr_bandwidth_init(devfreq);
+		if (!ret) {
+			devfreq_monitor_start(devfreq);
+			/* DDRC flux threshold events, if the DT provides them */
+			if (devfreq_monitor_subscribe_all(devfreq) < 0)
+				pr_warn("%s: devfreq-events not subscribed\n",
+					__func__);
+		}
+		break;
+
+	case DEVFREQ_GOV_STOP:
+		devfreq_monitor_stop(devfreq);
+		ddr_bandwidth_exit(devfreq);
+		break;
+
+	case DEVFREQ_GOV_INTERVAL:
+		devfreq_interval_update(devfreq, (unsigned int *)data);
+		break;
+
+	case DEVFREQ_GOV_SUSPEND:
+		devfreq_monitor_suspend(devfreq);
+		break;
+
+	case DEVFREQ_GOV_RESUME:
+		devfreq_monitor_resume(devfreq);
+		break;
+
+	default:
+		break;
+	}
+
+	return ret;
+}
+
+static struct devfreq_governor devfreq_ddr_bandwidth = {
+	.name = "ddr_bandwidth",
+	.get_target_freq = devfreq_ddr_bandwidth_func,
+	.event_handler = devfreq_ddr_bandwidth_handler,
+};
+
+static int __init devfreq_ddr_bandwidth_init(void)
+{
+	return devfreq_add_governor(&devfreq_ddr_bandwidth);
+}
+subsys_initcall(devfreq_ddr_bandwidth_init);
+
+static void __exit devfreq_ddr_bandwidth_exit(void)
+{
+	int ret;
+
+	ret = devfreq_remove_governor(&devfreq_ddr_bandwidth);
+	if (ret)
+		pr_err("%s: failed remove governor %d\n", __func__, ret);
+}
+module_exit(devfreq_ddr_bandwidth_exit);
+MODULE_LICENSE("GPL");
@@ -0,0 +1,383 @@
+/*
+ *  linux/drivers/devfreq/governor_gpu_frame_aware.c
+ *  Copyright (C) 2018 Hisilicon
+ *
+ * base on:
+ *  linux/drivers/devfreq/governor_gpu_scene_aware.c
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/errno.h>
+#include <linux/module.h>
+#include <linux/devfreq.h>
+#include <linux/math64.h>
+#include <linux/slab.h>
+#include <linux/device.h>
+#include <linux/pm.h>
+#include <linux/mutex.h>
+#include <linux/hisi/hisi_devfreq.h>
+#include <governor.h>
+
+#ifdef CONFIG_HUAWEI_BDAT
+#include <huawei_platform/power/bdat/bdat.h>
+#endif
+
+/*
+ * Default constants for DevFreq-GPU-Frame-Aware (DFFA).
+ *
+ * With frames on screen the governor picks the lowest frequency at which
+ * the heaviest frame of the last window still fits into frame_target_load
+ * percent of a vsync period. Without frames (offscreen, compute) it falls
+ * back to plain utilization and aims at util_target_load percent busy.
+ * Scene hints never raise the frequency above what the load needs other
+ * than through their floor.
+ */
+#define DFFA_FRAME_TARGET_LOAD		(85)
+#define DFFA_UTIL_TARGET_LOAD		(80)
+#define DFFA_MIN_TARGET_LOAD		(10)
+#define DFFA_MAX_TARGET_LOAD		(100)
+#define DFFA_SCENE_NUM			(16)
+
+struct devfreq_gpu_frame_aware_data {
+	unsigned int frame_target_load;
+	unsigned int util_target_load;
+	unsigned int scene;
+	unsigned long scene_floor[DFFA_SCENE_NUM];
+	/* last sample, for sysfs */
+	unsigned long frame_busy;
+	unsigned long frame_period;
+	unsigned int frames;
+	unsigned int utilisation;
+	int vsync;
+};
+
+static unsigned long frame_aware_util_freq(struct devfreq_dev_status *stat,
+					   unsigned int target_load)
+{
+	u64 a;
+
+	a = (u64)stat->busy_time * stat->current_frequency * 100;
+
+	return (unsigned long)div64_u64(a, (u64)stat->total_time * target_load);
+}
+
+static unsigned long frame_aware_frame_freq(unsigned long cur_freq,
+					    struct hisi_gpu_frame_stat *fs,
+					    unsigned int target_load)
+{
+	u64 a;
+
+	/*
+	 * GPU cycles the heaviest frame needed, spread over its budget. Work
+	 * in kHz so a frame that was busy for seconds cannot overflow.
+	 */
+	a = (u64)fs->busy_ns * (cur_freq / 1000) * 100;
+	a = div64_u64(a, (u64)fs->period_ns * target_load);
+
+	return (unsigned long)(a * 1000);
+}
+
+static int devfreq_gpu_frame_aware_func(struct devfreq *df,
+					unsigned long *freq)
+{
+	struct devfreq_dev_status stat;
+	int err = df->profile->get_dev_status(df->dev.parent, &stat);
+	struct devfreq_gpu_frame_aware_data *data = df->data;
+	struct hisi_gpu_frame_stat fs;
+	unsigned long floor;
+
+#ifdef CONFIG_HUAWEI_BDAT
+	bdat_update_gpu_info(stat.current_frequency, stat.busy_time,
+		stat.total_time, df->profile->polling_ms);
+#endif
+
+	if (err)
+		return err;
+
+	if (data == NULL)
+		return -EINVAL;
+
+	/* Set MAX if we do not know the initial frequency */
+	if (unlikely(stat.total_time == 0 || stat.current_frequency == 0)) {
+		*freq = df->max_freq ? df->max_freq : UINT_MAX;
+		return 0;
+	}
+
+	data->vsync = stat.private_data ? 1 : 0;
+	data->utilisation = stat.busy_time * 100 / stat.total_time;
+
+	if (hisi_devfreq_get_gpu_frame_stat(df->dev.parent, &fs) ||
+	    !fs.frames || !fs.period_ns) {
+		fs.busy_ns = 0;
+		fs.period_ns = 0;
+		fs.frames = 0;
+	}
+	data->frame_busy = fs.busy_ns;
+	data->frame_period = fs.period_ns;
+	data->frames = fs.frames;
+
+	if (fs.frames)
+		*freq = frame_aware_frame_freq(stat.current_frequency, &fs,
+					       data->frame_target_load);
+	else
+		*freq = frame_aware_util_freq(&stat, data->util_target_load);
+
+	floor = max(data->scene_floor[data->scene],
+		    hisi_devfreq_get_gpu_floor());
+	if (*freq < floor)
+		*freq = floor;
+
+	if (df->min_freq && *freq < df->min_freq)
+		*freq = df->min_freq;
+	if (df->max_freq && *freq > df->max_freq)
+		*freq = df->max_freq;
+
+	return 0;
+}
+
+
+#define store_one(object, min, max)						\
+static ssize_t store_##object						\
+(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)	\
+{										\
+	struct devfreq *devfreq = to_devfreq(dev);				\
+	struct devfreq_gpu_frame_aware_data *data;				\
+	unsigned int input;							\
+	int ret = 0;								\
+	ret = sscanf(buf, "%u", &input);					\
+	if (ret != 1 || input > max || input < min)				\
+		return -EINVAL;							\
+	mutex_lock(&devfreq->lock);						\
+	data = devfreq->data;							\
+	data->object = input;							\
+	ret = update_devfreq(devfreq);						\
+	if (ret == 0)								\
+		ret = count;							\
+	mutex_unlock(&devfreq->lock);						\
+	return ret;								\
+}
+
+store_one(frame_target_load, DFFA_MIN_TARGET_LOAD, DFFA_MAX_TARGET_LOAD)
+store_one(util_target_load, DFFA_MIN_TARGET_LOAD, DFFA_MAX_TARGET_LOAD)
+store_one(scene, 0, DFFA_SCENE_NUM - 1)
+
+#define show_one(object)					\
+static ssize_t show_##object					\
+(struct device *dev, struct device_attribute *attr, char *buf)	\
+{								\
+	struct devfreq *devfreq = to_devfreq(dev);		\
+	struct devfreq_gpu_frame_aware_data *data;		\
+	int ret = 0;						\
+	mutex_lock(&devfreq->lock);				\
+	data = devfreq->data;					\
+	ret = snprintf(buf, PAGE_SIZE,				\
+			"%lu\n", (unsigned long)data->object);	\
+	mutex_unlock(&devfreq->lock);				\
+	return ret;						\
+}
+
+show_one(frame_target_load)
+show_one(util_target_load)
+show_one(scene)
+show_one(frame_busy)
+show_one(frame_period)
+show_one(frames)
+show_one(utilisation)
+show_one(vsync)
+
+/* "<scene> <freq>": the lowest frequency allowed while <scene> is active */
+static ssize_t store_scene_floor(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct devfreq *devfreq = to_devfreq(dev);
+	struct devfreq_gpu_frame_aware_data *data;
+	unsigned int scene;
+	unsigned long floor;
+	int ret;
+
+	ret = sscanf(buf, "%u %lu", &scene, &floor);
+	if (ret != 2 || scene >= DFFA_SCENE_NUM)
+		return -EINVAL;
+
+	mutex_lock(&devfreq->lock);
+	data = devfreq->data;
+	data->scene_floor[scene] = floor;
+	ret = update_devfreq(devfreq);
+	if (ret == 0)
+		ret = count;
+	mutex_unlock(&devfreq->lock);
+
+	return ret;
+}
+
+static ssize_t show_scene_floor(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct devfreq *devfreq = to_devfreq(dev);
+	struct devfreq_gpu_frame_aware_data *data;
+	ssize_t count = 0;
+	unsigned int i;
+	int ret;
+
+	mutex_lock(&devfreq->lock);
+	data = devfreq->data;
+	for (i = 0; i < DFFA_SCENE_NUM; i++) {
+		ret = snprintf(buf + count, (PAGE_SIZE - count), "%s%u %lu\n",
+			(i == data->scene) ? "->" : "  ", i,
+			data->scene_floor[i]);
+		if (ret >= (PAGE_SIZE - count) || ret < 0)/*lint !e574 */
+			break;
+		count += ret;
+	}
+	mutex_unlock(&devfreq->lock);
+
+	return count;
+}
+
+#define GPU_FRAME_AWARE_ATTR_RW(_name) \
+	static DEVICE_ATTR(_name, 0644, show_##_name, store_##_name)
+
+GPU_FRAME_AWARE_ATTR_RW(frame_target_load);
+GPU_FRAME_AWARE_ATTR_RW(util_target_load);
+GPU_FRAME_AWARE_ATTR_RW(scene);
+GPU_FRAME_AWARE_ATTR_RW(scene_floor);
+
+#define GPU_FRAME_AWARE_ATTR_RO(_name) \
+	static DEVICE_ATTR(_name, 0444, show_##_name, NULL)
+
+GPU_FRAME_AWARE_ATTR_RO(frame_busy);
+GPU_FRAME_AWARE_ATTR_RO(frame_period);
+GPU_FRAME_AWARE_ATTR_RO(frames);
+GPU_FRAME_AWARE_ATTR_RO(utilisation);
+GPU_FRAME_AWARE_ATTR_RO(vsync);
+
+static struct attribute *dev_entries[] = {
+	&dev_attr_frame_target_load.attr,
+	&dev_attr_util_target_load.attr,
+	&dev_attr_scene.attr,
+	&dev_attr_scene_floor.attr,
+	&dev_attr_frame_busy.attr,
+	&dev_attr_frame_period.attr,
+	&dev_attr_frames.attr,
+	&dev_attr_utilisation.attr,
+	&dev_attr_vsync.attr,
+	NULL,
+};
+
+
+static struct attribute_group dev_attr_group = {
+	.name	= "gpu_frame_aware",
+	.attrs	= dev_entries,
+};
+
+static int gpu_frame_aware_init(struct devfreq *devfreq)
+{
+	int err = -ENOMEM;
+	struct devfreq_gpu_frame_aware_data *data;
+
+	if (devfreq->data)
+		goto err_out;
+
+	data = kzalloc(sizeof(struct devfreq_gpu_frame_aware_data), GFP_KERNEL);
+	if (!data) {
+		pr_err("%s: alloc data err\n", __func__);
+		goto err_out;
+	}
+
+	data->frame_target_load = DFFA_FRAME_TARGET_LOAD;
+	data->util_target_load = DFFA_UTIL_TARGET_LOAD;
+	devfreq->data = data;
+
+	err = sysfs_create_group(&devfreq->dev.kobj, &dev_attr_group);
+	if (err) {
+		pr_err("%s: sysfs create err %d\n", __func__, err);
+		goto err_data;
+	}
+
+	return 0;
+
+err_data:
+	kfree(data);
+	devfreq->data = NULL;
+err_out:
+	return err;
+}
+
+static void gpu_frame_aware_exit(struct devfreq *devfreq)
+{
+	if (IS_ERR_OR_NULL(devfreq->data))
+		return;
+
+	sysfs_remove_group(&devfreq->dev.kobj, &dev_attr_group);
+
+	kfree(devfreq->data);
+	devfreq->data = NULL;
+}
+
+
+static int devfreq_gpu_frame_aware_handler(struct devfreq *devfreq,
+				unsigned int event, void *data)
+{
+	int ret = 0;
+
+	switch (event) {
+	case DEVFREQ_GOV_START:
+		ret = gpu_frame_aware_init(devfreq);
+		if (!ret) {
+			devfreq_monitor_start(devfreq);
+			/* GPU busy threshold events, if the DT provides them */
+			if (devfreq_monitor_subscribe_all(devfreq) < 0)
+				pr_warn("%s: devfreq-events not subscribed\n",
+					__func__);
+		}
+		break;
+
+	case DEVFREQ_GOV_STOP:
+		devfreq_monitor_stop(devfreq);
+		gpu_frame_aware_exit(devfreq);
+		break;
+
+	case DEVFREQ_GOV_INTERVAL:
+		devfreq_interval_update(devfreq, (unsigned int *)data);
+		break;
+
+	case DEVFREQ_GOV_SUSPEND:
+		devfreq_monitor_suspend(devfreq);
+		break;
+
+	case DEVFREQ_GOV_RESUME:
+		devfreq_monitor_resume(devfreq);
+		break;
+
+	default:
+		break;
+	}
+
+	return ret;
+}
+
+static struct devfreq_governor devfreq_gpu_frame_aware = {
+	.name = "gpu_frame_aware",
+	.get_target_freq = devfreq_gpu_frame_aware_func,
+	.event_handler = devfreq_gpu_frame_aware_handler,
+};
+
+static int __init devfreq_gpu_frame_aware_init(void)
+{
+	return devfreq_add_governor(&devfreq_gpu_frame_aware);
+}
+subsys_initcall(devfreq_gpu_frame_aware_init);
+
+static void __exit devfreq_gpu_frame_aware_exit(void)
+{
+	int ret;
+
+	ret = devfreq_remove_governor(&devfreq_gpu_frame_aware);
+	if (ret)
+		pr_err("%s: failed remove governor %d\n", __func__, ret);
+}
+module_exit(devfreq_gpu_frame_aware_exit);
+MODULE_LICENSE("GPL");
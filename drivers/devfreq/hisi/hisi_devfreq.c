@@ -57,4 +57,60 @@ int hisi_devfreq_free_freq_table(struct device *dev,
 	return 0;
 }
 EXPORT_SYMBOL(hisi_devfreq_free_freq_table);
+
+static hisi_gpu_frame_stat_fn gpu_frame_stat;
+
+/* Set once by the GPU driver at probe and cleared at remove */
+void hisi_devfreq_set_gpu_frame_stat(hisi_gpu_frame_stat_fn fn)
+{
+	ACCESS_ONCE(gpu_frame_stat) = fn;
+}
+EXPORT_SYMBOL(hisi_devfreq_set_gpu_frame_stat);
+
+int hisi_devfreq_get_gpu_frame_stat(struct device *dev,
+				struct hisi_gpu_frame_stat *stat)
+{
+	hisi_gpu_frame_stat_fn fn = ACCESS_ONCE(gpu_frame_stat);
+
+	if (!fn)
+		return -ENODEV;
+
+	return fn(dev, stat);
+}
+EXPORT_SYMBOL(hisi_devfreq_get_gpu_frame_stat);
+
+static unsigned long gpu_floor;
+
+/* Applied by the GPU governor on its next evaluation */
+void hisi_devfreq_set_gpu_floor(unsigned long freq)
+{
+	ACCESS_ONCE(gpu_floor) = freq;
+}
+EXPORT_SYMBOL(hisi_devfreq_set_gpu_floor);
+
+unsigned long hisi_devfreq_get_gpu_floor(void)
+{
+	return ACCESS_ONCE(gpu_floor);
+}
+EXPORT_SYMBOL(hisi_devfreq_get_gpu_floor);
+
+static hisi_ddr_flux_stat_fn ddr_flux_stat;
+
+/* Set once by the DDRC flux driver at probe and cleared at remove */
+void hisi_devfreq_set_ddr_flux_stat(hisi_ddr_flux_stat_fn fn)
+{
+	ACCESS_ONCE(ddr_flux_stat) = fn;
+}
+EXPORT_SYMBOL(hisi_devfreq_set_ddr_flux_stat);
+
+int hisi_devfreq_get_ddr_flux_stat(struct hisi_ddr_flux_stat *stat)
+{
+	hisi_ddr_flux_stat_fn fn = ACCESS_ONCE(ddr_flux_stat);
+
+	if (!fn)
+		return -ENODEV;
+
+	return fn(stat);
+}
+EXPORT_SYMBOL(hisi_devfreq_get_ddr_flux_stat);
 #endif
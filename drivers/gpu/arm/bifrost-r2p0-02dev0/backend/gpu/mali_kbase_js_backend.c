@@ -87,6 +87,23 @@ static inline bool timer_callback_should_run(struct kbase_device *kbdev)
 	}
 }
 
+#if !CINSTR_DUMPING_ENABLED
+/*
+ * Don't let other contexts take the slot from the foreground frame as soon
+ * as usual, but still soft-stop before the hard-stop timeout kicks in.
+ */
+static u32 frame_critical_soft_stop_ticks(u32 soft_stop_ticks,
+		u32 hard_stop_ticks)
+{
+	u32 ticks = soft_stop_ticks * KBASE_JS_FRAME_CRITICAL_SOFT_STOP_SCALE;
+
+	if (hard_stop_ticks <= soft_stop_ticks)
+		return soft_stop_ticks;
+
+	return min(ticks, hard_stop_ticks - 1);
+}
+#endif
+
 static enum hrtimer_restart timer_callback(struct hrtimer *timer)
 {
 	unsigned long flags;
@@ -138,6 +155,13 @@ static enum hrtimer_restart timer_callback(struct hrtimer *timer)
 						js_devdata->gpu_reset_ticks_ss;
 				}
 
+				if (kbase_ctx_flag(atom->kctx,
+						KCTX_FRAME_CRITICAL))
+					soft_stop_ticks =
+						frame_critical_soft_stop_ticks(
+							soft_stop_ticks,
+							hard_stop_ticks);
+
 				/* If timeouts have been changed then ensure
 				 * that atom tick count is not greater than the
 				 * new soft_stop timeout. This ensures that
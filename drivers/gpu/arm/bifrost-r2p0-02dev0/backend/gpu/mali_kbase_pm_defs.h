@@ -87,6 +87,14 @@ enum kbase_pm_core_type {
  *  @active_cl_ctx: number of CL jobs active on the GPU. Array is per-device.
  *  @active_gl_ctx: number of GL jobs active on the GPU. Array is per-slot. As
  *           GL jobs never run on slot 2 this slot is not recorded.
+ *  @frame_busy: busy time of the GPU since the last displayed frame, in the
+ *           same units as @time_busy.
+ *  @frame_busy_max: largest @frame_busy of the frames displayed since the
+ *           frame statistics were last read.
+ *  @frames: number of frames displayed since the statistics were last read.
+ *  @frame_period: estimated display vsync period, in the same units as
+ *           @time_busy. 0 until two vsyncs have been reported.
+ *  @last_vsync: time of the last reported vsync.
  *  @lock: spinlock protecting the kbasep_pm_metrics_data structure
  *  @timer: timer to regularly make DVFS decisions based on the power
  *           management metrics.
@@ -108,6 +116,11 @@ struct kbasep_pm_metrics_data {
 	u32 busy_gl;
 	u32 active_cl_ctx[2];
 	u32 active_gl_ctx[2]; /* GL jobs can only run on 2 of the 3 job slots */
+	u32 frame_busy;
+	u32 frame_busy_max;
+	u32 frames;
+	u32 frame_period;
+	ktime_t last_vsync;
 	spinlock_t lock;
 
 #ifdef CONFIG_MALI_MIDGARD_DVFS
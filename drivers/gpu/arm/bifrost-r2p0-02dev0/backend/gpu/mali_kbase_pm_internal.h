@@ -326,8 +326,9 @@ void kbasep_pm_metrics_term(struct kbase_device *kbdev);
  * This function should be called by the frame buffer driver to update whether
  * the system is hitting the vsync target or not. buffer_updated should be true
  * if the vsync corresponded with a new frame being displayed, otherwise it
- * should be false. This function does not need to be called every vsync, but
- * only when the value of @buffer_updated differs from a previous call.
+ * should be false. The per-frame statistics returned by
+ * kbase_pm_get_frame_stat() are only meaningful if this is called on every
+ * vsync.
  *
  * @kbdev:          The kbase device structure for the device (must be a
  *                  valid pointer)
@@ -336,6 +337,20 @@ void kbasep_pm_metrics_term(struct kbase_device *kbdev);
  */
 void kbase_pm_report_vsync(struct kbase_device *kbdev, int buffer_updated);
 
+/**
+ * kbase_pm_get_frame_stat - Read and restart the per-frame GPU statistics
+ *
+ * @kbdev:     The kbase device structure for the device (must be a valid
+ *             pointer)
+ * @busy_ns:   Returns the largest GPU busy time of a displayed frame since
+ *             the last call, in ns
+ * @period_ns: Returns the estimated vsync period in ns, 0 if unknown
+ * @frames:    Returns the number of frames displayed since the last call
+ */
+void kbase_pm_get_frame_stat(struct kbase_device *kbdev,
+		unsigned long *busy_ns, unsigned long *period_ns,
+		unsigned int *frames);
+
 /**
  * kbase_pm_get_dvfs_action - Determine whether the DVFS system should change
  *                            the clock speed of the GPU.
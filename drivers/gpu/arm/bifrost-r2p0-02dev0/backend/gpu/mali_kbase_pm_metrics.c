@@ -90,6 +90,11 @@ int kbasep_pm_metrics_init(struct kbase_device *kbdev)
 	kbdev->pm.backend.metrics.busy_cl[0] = 0;
 	kbdev->pm.backend.metrics.busy_cl[1] = 0;
 	kbdev->pm.backend.metrics.busy_gl = 0;
+	kbdev->pm.backend.metrics.frame_busy = 0;
+	kbdev->pm.backend.metrics.frame_busy_max = 0;
+	kbdev->pm.backend.metrics.frames = 0;
+	kbdev->pm.backend.metrics.frame_period = 0;
+	kbdev->pm.backend.metrics.last_vsync = ktime_set(0, 0);
 
 	spin_lock_init(&kbdev->pm.backend.metrics.lock);
 
@@ -150,6 +155,7 @@ static void kbase_pm_get_dvfs_utilisation_calc(struct kbase_device *kbdev,
 		u32 ns_time = (u32) (ktime_to_ns(diff) >> KBASE_PM_TIME_SHIFT);
 
 		kbdev->pm.backend.metrics.time_busy += ns_time;
+		kbdev->pm.backend.metrics.frame_busy += ns_time;
 		if (kbdev->pm.backend.metrics.active_cl_ctx[0])
 			kbdev->pm.backend.metrics.busy_cl[0] += ns_time;
 		if (kbdev->pm.backend.metrics.active_cl_ctx[1])
@@ -390,6 +396,63 @@ static void kbase_pm_metrics_active_calc(struct kbase_device *kbdev)
 	}
 }
 
+void kbase_pm_report_vsync(struct kbase_device *kbdev, int buffer_updated)
+{
+	struct kbasep_pm_metrics_data *metrics = &kbdev->pm.backend.metrics;
+	unsigned long flags;
+	ktime_t now = ktime_get();
+	u32 delta;
+
+	spin_lock_irqsave(&metrics->lock, flags);
+
+	metrics->vsync_hit = buffer_updated;
+
+	/* Fold the busy time of the job running right now into this frame */
+	kbase_pm_get_dvfs_utilisation_calc(kbdev, now);
+
+	if (ktime_to_ns(metrics->last_vsync)) {
+		delta = (u32)(ktime_to_ns(ktime_sub(now, metrics->last_vsync))
+				>> KBASE_PM_TIME_SHIFT);
+
+		/* A gap of more than two periods means vsync reporting was off
+		 * for a while rather than a change of refresh rate */
+		if (!metrics->frame_period)
+			metrics->frame_period = delta;
+		else if (delta < 2 * metrics->frame_period)
+			metrics->frame_period =
+				(3 * metrics->frame_period + delta) / 4;
+	}
+	metrics->last_vsync = now;
+
+	if (buffer_updated) {
+		if (metrics->frame_busy > metrics->frame_busy_max)
+			metrics->frame_busy_max = metrics->frame_busy;
+		metrics->frame_busy = 0;
+		metrics->frames++;
+	}
+
+	spin_unlock_irqrestore(&metrics->lock, flags);
+}
+
+void kbase_pm_get_frame_stat(struct kbase_device *kbdev,
+		unsigned long *busy_ns, unsigned long *period_ns,
+		unsigned int *frames)
+{
+	struct kbasep_pm_metrics_data *metrics = &kbdev->pm.backend.metrics;
+	unsigned long flags;
+
+	spin_lock_irqsave(&metrics->lock, flags);
+
+	*busy_ns = (unsigned long)metrics->frame_busy_max << KBASE_PM_TIME_SHIFT;
+	*period_ns = (unsigned long)metrics->frame_period << KBASE_PM_TIME_SHIFT;
+	*frames = metrics->frames;
+
+	metrics->frame_busy_max = 0;
+	metrics->frames = 0;
+
+	spin_unlock_irqrestore(&metrics->lock, flags);
+}
+
 /* called when job is submitted to or removed from a GPU slot */
 void kbase_pm_metrics_update(struct kbase_device *kbdev, ktime_t *timestamp)
 {
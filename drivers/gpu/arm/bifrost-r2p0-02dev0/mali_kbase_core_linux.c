@@ -1018,6 +1018,20 @@ copy_failed:
 			break;
 		}
 
+	case KBASE_FUNC_SET_FRAME_CRITICAL:
+		{
+			struct kbase_uk_frame_critical *fc = args;
+
+			if (sizeof(*fc) != args_size)
+				goto bad_size;
+
+			if (fc->padding != 0)
+				goto out_bad;
+
+			kbase_js_set_ctx_frame_critical(kctx, fc->enable != 0);
+			break;
+		}
+
 	case KBASE_FUNC_SET_RENDER_THREAD_PRIO:
 	{
 		struct kbase_uk_render_prio_values *info = args;
@@ -401,6 +401,7 @@ struct kbase_ext_res {
 
 struct kbase_jd_atom {
 	struct work_struct work;
+	ktime_t submit_timestamp; /**< When userspace submitted the atom */
 	ktime_t start_timestamp;
 	u64 time_spent_us; /**< Total time spent on the GPU in microseconds */
 
@@ -584,6 +585,20 @@ static inline bool kbase_jd_katom_is_protected(const struct kbase_jd_atom *katom
 
 #define KBASE_JD_DEP_QUEUE_SIZE 256
 
+/*
+ * Atom latency histograms: submit to start of the last run on the GPU,
+ * start to completion, and submit to completion. Bucket n counts latencies
+ * below 2^n microseconds, the last bucket everything above.
+ */
+enum kbase_jd_latency_type {
+	KBASE_JD_LATENCY_QUEUE,
+	KBASE_JD_LATENCY_RUN,
+	KBASE_JD_LATENCY_TOTAL,
+	KBASE_JD_LATENCY_NR_TYPES
+};
+
+#define KBASE_JD_LATENCY_NR_BUCKETS 22
+
 struct kbase_jd_context {
 	struct mutex lock;
 	struct kbasep_js_kctx_info sched_info;
@@ -629,6 +644,10 @@ struct kbase_jd_context {
 #ifdef CONFIG_GPU_TRACEPOINTS
 	atomic_t work_id;
 #endif
+
+	/** Latency histograms of the atoms that ran on the GPU, see
+	 * kbase_jd_latency_record() */
+	atomic_t latency[KBASE_JD_LATENCY_NR_TYPES][KBASE_JD_LATENCY_NR_BUCKETS];
 };
 
 struct kbase_device_info {
@@ -1299,6 +1318,10 @@ struct jsctx_queue {
  *
  * @KCTX_DYING: Set when the context process is in the process of being evicted.
  *
+ * @KCTX_FRAME_CRITICAL: Set by userspace on a context rendering the
+ * foreground frame. Such contexts are picked first when a slot needs a new
+ * context, and their atoms get a longer timeslice before being soft-stopped.
+ *
  * All members need to be separate bits. This enum is intended for use in a
  * bitmask where multiple values get OR-ed together.
  */
@@ -1313,6 +1336,7 @@ enum kbase_context_flags {
 	KCTX_PRIVILEGED = 1U << 7,
 	KCTX_SCHEDULED = 1U << 8,
 	KCTX_DYING = 1U << 9,
+	KCTX_FRAME_CRITICAL = 1U << 10,
 };
 
 struct kbase_context {
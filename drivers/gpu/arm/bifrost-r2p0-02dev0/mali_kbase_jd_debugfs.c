@@ -110,6 +110,71 @@ static const struct file_operations kbasep_jd_debugfs_atoms_fops = {
 	.release = single_release,
 };
 
+static const char * const kbasep_jd_debugfs_latency_names[] = {
+	[KBASE_JD_LATENCY_QUEUE] = "queue",
+	[KBASE_JD_LATENCY_RUN] = "run",
+	[KBASE_JD_LATENCY_TOTAL] = "total",
+};
+
+/**
+ * kbasep_jd_debugfs_latency_show - Show callback for the atom latency file
+ * @sfile: The debugfs entry
+ * @data:  Data associated with the entry
+ *
+ * Prints one line per histogram: its name, then the count of each bucket.
+ * Bucket n holds atoms that took less than 2^n microseconds, the last one
+ * everything slower.
+ *
+ * Return: 0
+ */
+static int kbasep_jd_debugfs_latency_show(struct seq_file *sfile, void *data)
+{
+	struct kbase_context *kctx = sfile->private;
+	int type, i;
+
+	KBASE_DEBUG_ASSERT(kctx != NULL);
+
+	seq_printf(sfile, "v%u\n", MALI_JD_DEBUGFS_VERSION);
+
+	for (type = 0; type < KBASE_JD_LATENCY_NR_TYPES; type++) {
+		seq_printf(sfile, "%s", kbasep_jd_debugfs_latency_names[type]);
+		for (i = 0; i < KBASE_JD_LATENCY_NR_BUCKETS; i++)
+			seq_printf(sfile, ",%d",
+				atomic_read(&kctx->jctx.latency[type][i]));
+		seq_puts(sfile, "\n");
+	}
+
+	return 0;
+}
+
+static int kbasep_jd_debugfs_latency_open(struct inode *in, struct file *file)
+{
+	return single_open(file, kbasep_jd_debugfs_latency_show, in->i_private);
+}
+
+/* Any write resets the histograms */
+static ssize_t kbasep_jd_debugfs_latency_write(struct file *file,
+		const char __user *ubuf, size_t count, loff_t *ppos)
+{
+	struct seq_file *sfile = file->private_data;
+	struct kbase_context *kctx = sfile->private;
+	int type, i;
+
+	for (type = 0; type < KBASE_JD_LATENCY_NR_TYPES; type++)
+		for (i = 0; i < KBASE_JD_LATENCY_NR_BUCKETS; i++)
+			atomic_set(&kctx->jctx.latency[type][i], 0);
+
+	return count;
+}
+
+static const struct file_operations kbasep_jd_debugfs_latency_fops = {
+	.open = kbasep_jd_debugfs_latency_open,
+	.read = seq_read,
+	.write = kbasep_jd_debugfs_latency_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 void kbasep_jd_debugfs_ctx_init(struct kbase_context *kctx)
 {
 	KBASE_DEBUG_ASSERT(kctx != NULL);
@@ -118,6 +183,11 @@ void kbasep_jd_debugfs_ctx_init(struct kbase_context *kctx)
 	debugfs_create_file("atoms", S_IRUGO, kctx->kctx_dentry, kctx,
 			&kbasep_jd_debugfs_atoms_fops);
 
+	/* Submit->start->complete latency of the atoms run so far */
+	debugfs_create_file("atom_latency", S_IRUGO | S_IWUSR,
+			kctx->kctx_dentry, kctx,
+			&kbasep_jd_debugfs_latency_fops);
+
 }
 
 #endif /* CONFIG_HISI_DEBUG_FS */
@@ -1001,10 +1001,18 @@ static struct kbase_context *kbase_js_ctx_list_pop_head_nolock(
 	if (list_empty(&kbdev->js_data.ctx_list_pullable[js]))
 		return NULL;
 
+	/* A context rendering the foreground frame jumps the queue */
+	list_for_each_entry(kctx, &kbdev->js_data.ctx_list_pullable[js],
+			jctx.sched_info.ctx.ctx_list_entry[js]) {
+		if (kbase_ctx_flag(kctx, KCTX_FRAME_CRITICAL))
+			goto found;
+	}
+
 	kctx = list_entry(kbdev->js_data.ctx_list_pullable[js].next,/* [false alarm]: no problem - fortify check */
 					struct kbase_context,
 					jctx.sched_info.ctx.ctx_list_entry[js]);
 
+found:
 	list_del_init(&kctx->jctx.sched_info.ctx.ctx_list_entry[js]);
 
 	return kctx;
@@ -2533,6 +2541,51 @@ bool kbase_js_complete_atom_wq(struct kbase_context *kctx,
 	return context_idle;
 }
 
+static void kbase_js_latency_add(struct kbase_context *kctx,
+		enum kbase_jd_latency_type type, ktime_t from, ktime_t to)
+{
+	s64 us = ktime_to_us(ktime_sub(to, from));
+	int bucket = 0;
+
+	if (us > 0)
+		bucket = min_t(int, fls64(us), KBASE_JD_LATENCY_NR_BUCKETS - 1);
+
+	atomic_inc(&kctx->jctx.latency[type][bucket]);
+}
+
+/**
+ * kbase_js_latency_record - Account a completed atom in the latency histograms
+ * @kctx:          Context the atom belongs to
+ * @katom:         Atom that has run on the GPU
+ * @end_timestamp: Time the atom completed
+ */
+static void kbase_js_latency_record(struct kbase_context *kctx,
+		struct kbase_jd_atom *katom, ktime_t end_timestamp)
+{
+	kbase_js_latency_add(kctx, KBASE_JD_LATENCY_QUEUE,
+			katom->submit_timestamp, katom->start_timestamp);
+	kbase_js_latency_add(kctx, KBASE_JD_LATENCY_RUN,
+			katom->start_timestamp, end_timestamp);
+	kbase_js_latency_add(kctx, KBASE_JD_LATENCY_TOTAL,
+			katom->submit_timestamp, end_timestamp);
+}
+
+void kbase_js_set_ctx_frame_critical(struct kbase_context *kctx, bool enable)
+{
+	struct kbase_device *kbdev = kctx->kbdev;
+	unsigned long flags;
+
+	spin_lock_irqsave(&kbdev->hwaccess_lock, flags);
+	if (enable)
+		kbase_ctx_flag_set(kctx, KCTX_FRAME_CRITICAL);
+	else
+		kbase_ctx_flag_clear(kctx, KCTX_FRAME_CRITICAL);
+	spin_unlock_irqrestore(&kbdev->hwaccess_lock, flags);
+
+	/* Let the new preference take effect on the next free slot */
+	kbase_js_sched_all(kbdev);
+}
+
 struct kbase_jd_atom *kbase_js_complete_atom(struct kbase_jd_atom *katom,
 		ktime_t *end_timestamp)
 {
@@ -2578,6 +2631,8 @@ struct kbase_jd_atom *kbase_js_complete_atom(struct kbase_jd_atom *katom,
 		/* Round up time spent to the minimum timer resolution */
 		if (microseconds_spent < KBASEP_JS_TICK_RESOLUTION_US)
 			microseconds_spent = KBASEP_JS_TICK_RESOLUTION_US;
+
+		kbase_js_latency_record(kctx, katom, *end_timestamp);
 	}
 
 	/* Log the result of the job (completion status, and time spent). */
@@ -616,6 +616,19 @@ bool kbase_js_is_atom_valid(struct kbase_device *kbdev,
  */
 void kbase_js_set_timeouts(struct kbase_device *kbdev);
 
+/**
+ * kbase_js_set_ctx_frame_critical - Mark a context as rendering the
+ *                                   foreground frame
+ * @kctx:   Context pointer
+ * @enable: true to set KCTX_FRAME_CRITICAL, false to clear it
+ *
+ * A frame-critical context is preferred over other pullable contexts when a
+ * job slot needs a new context, and its atoms run for
+ * KBASE_JS_FRAME_CRITICAL_SOFT_STOP_SCALE times the usual number of ticks
+ * before the scheduling timer soft-stops them.
+ */
+void kbase_js_set_ctx_frame_critical(struct kbase_context *kctx, bool enable);
+
 /*
  * Helpers follow
  */
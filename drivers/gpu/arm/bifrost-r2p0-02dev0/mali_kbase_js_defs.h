@@ -459,6 +459,10 @@ enum {
  * about invalid priorities from userspace */
 #define KBASE_JS_ATOM_SCHED_PRIO_DEFAULT KBASE_JS_ATOM_SCHED_PRIO_MED
 
+/* Atoms of a KCTX_FRAME_CRITICAL context run this many times the soft-stop
+ * timeout before being soft-stopped (but still within the hard-stop one) */
+#define KBASE_JS_FRAME_CRITICAL_SOFT_STOP_SCALE 4
+
 	  /** @} *//* end group kbase_js */
 	  /** @} *//* end group base_kbase_api */
 	  /** @} *//* end group base_api */
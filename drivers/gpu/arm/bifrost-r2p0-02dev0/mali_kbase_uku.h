@@ -457,6 +457,22 @@ struct kbase_uk_soft_event_update {
 	u32 flags;
 };
 
+/**
+ * struct kbase_uk_frame_critical - User/Kernel space data exchange structure
+ * @header:  UK structure header
+ * @enable:  non-zero if the context renders the foreground frame
+ * @padding: padding to make the structure size 64-bit aligned
+ *
+ * Used by the compositor and UI renderer to get slot preference and a longer
+ * soft-stop timeout for their context, see KCTX_FRAME_CRITICAL.
+ */
+struct kbase_uk_frame_critical {
+	union uk_header header;
+	/* IN */
+	u32 enable;
+	u32 padding;
+};
+
 #define MAX_TASK_INFO 8
 
 struct task_info {
@@ -562,6 +578,8 @@ enum kbase_uk_function_id {
 
 	KBASE_FUNC_SET_RENDER_THREAD_PRIO = (UK_FUNC_ID + 41),
 
+	KBASE_FUNC_SET_FRAME_CRITICAL = (UK_FUNC_ID + 42),
+
 	KBASE_FUNC_MAX
 };
 
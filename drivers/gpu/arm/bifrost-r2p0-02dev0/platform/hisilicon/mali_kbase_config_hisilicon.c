@@ -246,6 +246,22 @@ static int mali_kbase_get_dev_status(struct device *dev,
 	return 0;
 }
 
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(3, 13, 0))
+static int mali_kbase_get_frame_stat(struct device *dev,
+				     struct hisi_gpu_frame_stat *stat)
+{
+	struct kbase_device *kbdev = (struct kbase_device *)dev->platform_data;
+
+	if (kbdev->pm.backend.metrics.kbdev != kbdev)
+		return -ENODEV;
+
+	kbase_pm_get_frame_stat(kbdev, &stat->busy_ns, &stat->period_ns,
+				&stat->frames);
+
+	return 0;
+}
+#endif
+
 static struct devfreq_dev_profile mali_kbase_devfreq_profile = {
 	/* it would be abnormal to enable devfreq monitor during initialization. */
 	.polling_ms	= DEFAULT_POLLING_MS, //STOP_POLLING,
@@ -257,13 +273,8 @@ static struct devfreq_dev_profile mali_kbase_devfreq_profile = {
 #ifdef CONFIG_REPORT_VSYNC
 void mali_kbase_pm_report_vsync(int buffer_updated)
 {
-	unsigned long flags;
-
-	if (kbase_dev){
-		spin_lock_irqsave(&kbase_dev->pm.backend.metrics.lock, flags);
-		kbase_dev->pm.backend.metrics.vsync_hit = buffer_updated;
-		spin_unlock_irqrestore(&kbase_dev->pm.backend.metrics.lock, flags);
-	}
+	if (kbase_dev)
+		kbase_pm_report_vsync(kbase_dev, buffer_updated);
 }
 EXPORT_SYMBOL(mali_kbase_pm_report_vsync);
 #endif
@@ -459,6 +470,9 @@ static int kbase_platform_init(struct kbase_device *kbdev)
 #endif
 		rcu_read_unlock();
 		dev_set_name(dev, "gpufreq");
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(3, 13, 0))
+		hisi_devfreq_set_gpu_frame_stat(mali_kbase_get_frame_stat);
+#endif
 		kbdev->devfreq = devfreq_add_device(dev,
 						&mali_kbase_devfreq_profile,
 						"mali_ondemand",
@@ -501,6 +515,9 @@ static void kbase_platform_term(struct kbase_device *kbdev)
 {
 #ifdef CONFIG_PM_DEVFREQ
 	devfreq_remove_device(kbdev->devfreq);
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(3, 13, 0))
+	hisi_devfreq_set_gpu_frame_stat(NULL);
+#endif
 #endif
 }
 
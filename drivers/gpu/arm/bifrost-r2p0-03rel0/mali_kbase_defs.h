@@ -921,10 +921,15 @@ struct kbase_protected_ops {
  * @pool_lock: Lock protecting the pool - must be held when modifying @cur_size
  *             and @page_list
  * @page_list: List of free pages in the pool
- * @reclaim:   Shrinker for kernel reclaim of free pages
+ * @reclaim:   Shrinker for kernel reclaim of free pages. Only registered for
+ *             a pool without a @next_pool; it also reclaims from @children.
+ * @last_used: Jiffies of the last allocation from, or page added to, the pool
  * @next_pool: Pointer to next pool where pages can be allocated when this pool
  *             is empty. Pages will spill over to the next pool when this pool
  *             is full. Can be NULL if there is no next pool.
+ * @children:  Pools that have this pool as their @next_pool
+ * @child_lock: Lock protecting @children
+ * @child_node: Entry on the @children list of @next_pool
  */
 struct kbase_mem_pool {
 	struct kbase_device *kbdev;
@@ -933,8 +938,13 @@ struct kbase_mem_pool {
 	spinlock_t          pool_lock;
 	struct list_head    page_list;
 	struct shrinker     reclaim;
+	unsigned long       last_used;
 
 	struct kbase_mem_pool *next_pool;
+
+	struct list_head    children;
+	spinlock_t          child_lock;
+	struct list_head    child_node;
 };
 
 
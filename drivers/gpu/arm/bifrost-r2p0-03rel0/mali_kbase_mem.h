@@ -446,6 +446,19 @@ static inline int kbase_atomic_sub_pages(int num_pages, atomic_t *used_pages)
 //#define KBASE_MEM_POOL_MAX_SIZE_KCTX  (SZ_64M >> PAGE_SHIFT)
 #define KBASE_MEM_POOL_MAX_SIZE_KCTX  (SZ_4M >> PAGE_SHIFT)
 
+/*
+ * Order of the blocks requested from the kernel when a pool needs many new
+ * pages at once; 2MB with 4kB pages.
+ */
+#define KBASE_MEM_POOL_LARGE_ORDER    (21 - PAGE_SHIFT)
+#define KBASE_MEM_POOL_LARGE_PAGES    (1u << KBASE_MEM_POOL_LARGE_ORDER)
+
+/*
+ * A kctx pool unused for this long counts as cold, and is reclaimed before
+ * the kbdev pool and any warm kctx pool.
+ */
+#define KBASE_MEM_POOL_COLD_TIME_MS   2000
+
 /**
  * kbase_mem_pool_init - Create a memory pool for a kbase device
  * @pool:      Memory pool to initialize
@@ -464,8 +477,9 @@ static inline int kbase_atomic_sub_pages(int num_pages, atomic_t *used_pages)
  * @pool is full. Pages are zeroed before they spill over to another pool, to
  * prevent leaking information between applications.
  *
- * A shrinker is registered so that Linux mm can reclaim pages from the pool as
- * needed.
+ * A shrinker is registered for a pool without @next_pool so that Linux mm can
+ * reclaim pages from it and from every pool spilling into it as needed. Cold
+ * pools are drained first, then the pool itself, then warm pools.
  *
  * Return: 0 on success, negative -errno on error
  */
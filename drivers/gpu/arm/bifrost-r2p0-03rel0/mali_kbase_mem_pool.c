@@ -22,6 +22,7 @@
 #include <linux/spinlock.h>
 #include <linux/shrinker.h>
 #include <linux/atomic.h>
+#include <linux/jiffies.h>
 #include <linux/version.h>//lint !e451
 
 /* This function is only provided for backwards compatibility with kernels
@@ -81,6 +82,7 @@ static void kbase_mem_pool_add_locked(struct kbase_mem_pool *pool,
 
 	list_add(&p->lru, &pool->page_list);
 	pool->cur_size++;
+	pool->last_used = jiffies;
 
 	zone_page_state_add(1, page_zone(p), NR_MALI_PAGES);
 
@@ -107,6 +109,7 @@ static void kbase_mem_pool_add_list_locked(struct kbase_mem_pool *pool,
 
 	list_splice(page_list, &pool->page_list);
 	pool->cur_size += nr_pages;
+	pool->last_used = jiffies;
 
 	pool_dbg(pool, "added %zu pages\n", nr_pages);
 }
@@ -175,19 +178,16 @@ static void kbase_mem_pool_spill(struct kbase_mem_pool *next_pool,
 	kbase_mem_pool_add(next_pool, p);
 }
 
-struct page *kbase_mem_alloc_page(struct kbase_device *kbdev)
+static gfp_t kbase_mem_alloc_gfp(void)
 {
-	struct page *p;
 	gfp_t gfp;
-	struct device *dev = kbdev->dev;
-	dma_addr_t dma_addr;
 
 #if defined(CONFIG_ARM) && !defined(CONFIG_HAVE_DMA_ATTRS) && \
 	LINUX_VERSION_CODE < KERNEL_VERSION(3, 5, 0)
 	/* DMA cache sync fails for HIGHMEM before 3.5 on ARM */
-	gfp = GFP_USER | __GFP_ZERO;
+	gfp = GFP_USER;
 #else
-	gfp = GFP_HIGHUSER | __GFP_ZERO;
+	gfp = GFP_HIGHUSER;
 #endif
 
 	if (current->flags & PF_KTHREAD) {
@@ -196,6 +196,18 @@ struct page *kbase_mem_alloc_page(struct kbase_device *kbdev)
 		gfp |= __GFP_NORETRY;
 	}
 
+	return gfp;
+}
+
+struct page *kbase_mem_alloc_page(struct kbase_device *kbdev)
+{
+	struct page *p;
+	gfp_t gfp;
+	struct device *dev = kbdev->dev;
+	dma_addr_t dma_addr;
+
+	gfp = kbase_mem_alloc_gfp() | __GFP_ZERO;
+
 	p = alloc_page(gfp);
 	if (!p)
 		return NULL;
@@ -213,6 +225,58 @@ struct page *kbase_mem_alloc_page(struct kbase_device *kbdev)
 	return p;
 }
 
+/*
+ * Allocate KBASE_MEM_POOL_LARGE_PAGES physically contiguous pages in one go
+ * and zero them in a single pass, instead of going to the page allocator
+ * and zeroing once per 4kB page. The block is split, so each page is then
+ * mapped, pooled and freed on its own like any other. Returns the first
+ * page, or NULL if no free block of that order is readily available.
+ */
+static struct page *kbase_mem_alloc_large(struct kbase_device *kbdev)
+{
+	struct device *dev = kbdev->dev;
+	struct page *p;
+	dma_addr_t dma_addr;
+	gfp_t gfp;
+	size_t i;
+
+	/* Don't reclaim or compact hard for this, 4kB pages are the fallback */
+	gfp = kbase_mem_alloc_gfp() | __GFP_NORETRY | __GFP_NOWARN;
+
+	p = alloc_pages(gfp, KBASE_MEM_POOL_LARGE_ORDER);
+	if (!p)
+		return NULL;
+
+	split_page(p, KBASE_MEM_POOL_LARGE_ORDER);
+
+	for (i = 0; i < KBASE_MEM_POOL_LARGE_PAGES; i++)
+		clear_highpage(p + i);
+
+	for (i = 0; i < KBASE_MEM_POOL_LARGE_PAGES; i++) {
+		dma_addr = dma_map_page(dev, p + i, 0, PAGE_SIZE,
+				DMA_BIDIRECTIONAL);
+		if (dma_mapping_error(dev, dma_addr))
+			goto err_unmap;
+
+		WARN_ON(dma_addr != page_to_phys(p + i));
+
+		kbase_set_dma_addr(p + i, dma_addr);
+	}
+
+	return p;
+
+err_unmap:
+	while (i--) {
+		dma_unmap_page(dev, kbase_dma_addr(p + i), PAGE_SIZE,
+				DMA_BIDIRECTIONAL);
+		kbase_clear_dma_addr(p + i);
+	}
+	for (i = 0; i < KBASE_MEM_POOL_LARGE_PAGES; i++)
+		__free_page(p + i);
+
+	return NULL;
+}
+
 static void kbase_mem_pool_free_page(struct kbase_mem_pool *pool,
 		struct page *p)
 {
@@ -258,9 +322,24 @@ int kbase_mem_pool_grow(struct kbase_mem_pool *pool,
 		size_t nr_to_grow)
 {
 	struct page *p;
-	size_t i;
+	size_t i = 0;
+	size_t j;
 
-	for (i = 0; i < nr_to_grow; i++) {
+	while (nr_to_grow - i >= KBASE_MEM_POOL_LARGE_PAGES) {
+		LIST_HEAD(page_list);
+
+		p = kbase_mem_alloc_large(pool->kbdev);
+		if (!p)
+			break;
+
+		for (j = 0; j < KBASE_MEM_POOL_LARGE_PAGES; j++)
+			list_add_tail(&p[j].lru, &page_list);
+		kbase_mem_pool_add_list(pool, &page_list,
+				KBASE_MEM_POOL_LARGE_PAGES);
+		i += KBASE_MEM_POOL_LARGE_PAGES;
+	}
+
+	for (; i < nr_to_grow; i++) {
 		p = kbase_mem_alloc_page(pool->kbdev);
 		if (!p)
 			return -ENOMEM;
@@ -304,27 +383,66 @@ void kbase_mem_pool_set_max_size(struct kbase_mem_pool *pool, size_t max_size)
 }
 
 
+static bool kbase_mem_pool_is_cold(struct kbase_mem_pool *pool)
+{
+	return time_after(jiffies, pool->last_used +
+			msecs_to_jiffies(KBASE_MEM_POOL_COLD_TIME_MS));
+}
+
 static unsigned long kbase_mem_pool_reclaim_count_objects(struct shrinker *s,
 		struct shrink_control *sc)
 {
 	struct kbase_mem_pool *pool;
+	struct kbase_mem_pool *child;
+	size_t count;
 
 	pool = container_of(s, struct kbase_mem_pool, reclaim);
-	pool_dbg(pool, "reclaim count: %zu\n", kbase_mem_pool_size(pool));
-	return kbase_mem_pool_size(pool);
+
+	count = kbase_mem_pool_size(pool);
+	spin_lock(&pool->child_lock);
+	list_for_each_entry(child, &pool->children, child_node)
+		count += kbase_mem_pool_size(child);
+	spin_unlock(&pool->child_lock);
+
+	pool_dbg(pool, "reclaim count: %zu\n", count);
+	return count;
 }
 
 static unsigned long kbase_mem_pool_reclaim_scan_objects(struct shrinker *s,
 		struct shrink_control *sc)
 {
 	struct kbase_mem_pool *pool;
-	unsigned long freed;
+	struct kbase_mem_pool *child;
+	unsigned long nr_to_scan = sc->nr_to_scan;
+	unsigned long freed = 0;
 
 	pool = container_of(s, struct kbase_mem_pool, reclaim);
 
 	pool_dbg(pool, "reclaim scan %ld:\n", sc->nr_to_scan);
 
-	freed = kbase_mem_pool_shrink(pool, sc->nr_to_scan);
+	spin_lock(&pool->child_lock);
+
+	/* Contexts that have not touched their pool for a while go first */
+	list_for_each_entry(child, &pool->children, child_node) {
+		if (freed >= nr_to_scan)
+			break;
+		if (kbase_mem_pool_is_cold(child))
+			freed += kbase_mem_pool_shrink(child,
+					nr_to_scan - freed);
+	}
+
+	/* Then the device-wide spill tier */
+	if (freed < nr_to_scan)
+		freed += kbase_mem_pool_shrink(pool, nr_to_scan - freed);
+
+	/* And only then the warm pages of active contexts */
+	list_for_each_entry(child, &pool->children, child_node) {
+		if (freed >= nr_to_scan)
+			break;
+		freed += kbase_mem_pool_shrink(child, nr_to_scan - freed);
+	}
+
+	spin_unlock(&pool->child_lock);
 
 	pool_dbg(pool, "reclaim freed %ld pages\n", freed);
 
@@ -351,9 +469,24 @@ int kbase_mem_pool_init(struct kbase_mem_pool *pool,
 	pool->max_size = max_size;
 	pool->kbdev = kbdev;
 	pool->next_pool = next_pool;
+	pool->last_used = jiffies;
 
 	spin_lock_init(&pool->pool_lock);
 	INIT_LIST_HEAD(&pool->page_list);
+	spin_lock_init(&pool->child_lock);
+	INIT_LIST_HEAD(&pool->children);
+	INIT_LIST_HEAD(&pool->child_node);
+
+	if (next_pool) {
+		/* Reclaimed through the shrinker of the pool we spill into */
+		spin_lock(&next_pool->child_lock);
+		list_add_tail(&pool->child_node, &next_pool->children);
+		spin_unlock(&next_pool->child_lock);
+
+		pool_dbg(pool, "initialized\n");
+
+		return 0;
+	}
 
 	/* Register shrinker */
 #if LINUX_VERSION_CODE < KERNEL_VERSION(3, 12, 0)
@@ -385,7 +518,14 @@ void kbase_mem_pool_term(struct kbase_mem_pool *pool)
 
 	pool_dbg(pool, "terminate()\n");
 
-	unregister_shrinker(&pool->reclaim);
+	if (next_pool) {
+		spin_lock(&next_pool->child_lock);
+		list_del_init(&pool->child_node);
+		spin_unlock(&next_pool->child_lock);
+	} else {
+		WARN_ON(!list_empty(&pool->children));
+		unregister_shrinker(&pool->reclaim);
+	}
 
 	kbase_mem_pool_lock(pool);
 	pool->max_size = 0;
@@ -425,6 +565,8 @@ struct page *kbase_mem_pool_alloc(struct kbase_mem_pool *pool)
 {
 	struct page *p;
 
+	pool->last_used = jiffies;
+
 	do {
 		pool_dbg(pool, "alloc()\n");
 		p = kbase_mem_pool_remove(pool);
@@ -466,12 +608,14 @@ int kbase_mem_pool_alloc_pages(struct kbase_mem_pool *pool, size_t nr_pages,
 	struct page *p;
 	size_t nr_from_pool;
 	size_t i;
+	size_t j;
 	int err = -ENOMEM;
 
 	pool_dbg(pool, "alloc_pages(%zu):\n", nr_pages);
 
 	/* Get pages from this pool */
 	kbase_mem_pool_lock(pool);
+	pool->last_used = jiffies;
 	nr_from_pool = min(nr_pages, kbase_mem_pool_size(pool));//lint !e666
 	for (i = 0; i < nr_from_pool; i++) {
 		p = kbase_mem_pool_remove_locked(pool);
@@ -490,7 +634,16 @@ int kbase_mem_pool_alloc_pages(struct kbase_mem_pool *pool, size_t nr_pages,
 		i += nr_pages - i;
 	}
 
-	/* Get any remaining pages from kernel */
+	/* Get any remaining pages from kernel, 2MB at a time while we can */
+	while (nr_pages - i >= KBASE_MEM_POOL_LARGE_PAGES) {
+		p = kbase_mem_alloc_large(pool->kbdev);
+		if (!p)
+			break;
+
+		for (j = 0; j < KBASE_MEM_POOL_LARGE_PAGES; j++)
+			pages[i++] = page_to_phys(p + j);
+	}
+
 	for (; i < nr_pages; i++) {
 		p = kbase_mem_alloc_page(pool->kbdev);
 		if (!p)
@@ -25,6 +25,13 @@
 #include <global_ddr_map.h>
 #include "hisi_ddr_ddrcflux.h"
 #include <linux/hisi/hisi_drmdriver.h>
+#ifdef CONFIG_HISI_DDRC_FLUX_MONITOR
+#include <linux/hrtimer.h>
+#include <linux/miscdevice.h>
+#include <linux/mm.h>
+#include <linux/hisi/hisi_ddr_flux.h>
+#include <linux/hisi/hisi_devfreq.h>
+#endif
 
 /*lint -e438 -e514 -e550 -e715 -e774 -e818 -e835 -e838 -e845 -e712 -e730 -e732 -e747*/
 
@@ -142,6 +149,7 @@ struct ddrflux_data {
 };
 struct ddrflux_data	*ddrc_datas = NULL;
 static void dmss_flux_enable_ctrl(int en);
+static bool ddrflux_monitor_running(void);
 static void qosbuf_flux_enable_ctrl(int en);
 static void dmc_flux_enable_ctrl(int en);
 struct dentry *ddrc_flux_dir;
@@ -853,6 +861,9 @@ static void dmss_flux_enable_ctrl(int en)
 		writel(val, SOC_DMSS_GLB_STAT_CTRL_ADDR
 				(VIRT(SOC_ACPU_DMSS_BASE_ADDR, 8)));
 	} else {
+		/* the DDR governor still samples the ASI counters */
+		if (ddrflux_monitor_running())
+			return;
 		val = readl(SOC_DMSS_GLB_STAT_CTRL_ADDR
 				(VIRT(SOC_ACPU_DMSS_BASE_ADDR, 8)));
 		val &= ~(0x7F);
@@ -1055,6 +1066,296 @@ static int ddrc_flux_dir_init(void)
 	return 0;
 }
 
+#ifdef CONFIG_HISI_DDRC_FLUX_MONITOR
+/*
+ * Continuous per-ASI traffic counters for the DDR bandwidth governor and
+ * for /dev/ddr_flux.
+ *
+ * The DMSS ASI flux registers are free running 32 bit counters. They are
+ * widened to 64 bit here on every read, so somebody has to read more
+ * often than the busiest port wraps (a few hundred ms at full bandwidth).
+ * Only boards whose DT node has "hisilicon,flux-monitor" register the
+ * monitor, since the kernel must be allowed to read DMSS directly.
+ */
+#define FLUX_MON_MASTERS	(MAX_DMSS_ASI_BASE + 1)
+#define FLUX_RING_RECORDS	2048
+#define FLUX_RING_MIN_US	1000
+#define FLUX_RING_MAX_US	1000000
+
+struct ddrflux_monitor {
+	spinlock_t	lock;
+	void __iomem	*dmss_base;
+	u32		bytes_per_count;
+	bool		running;
+	u32		last_rd[FLUX_MON_MASTERS];
+	u32		last_wr[FLUX_MON_MASTERS];
+	u64		rd_bytes[FLUX_MON_MASTERS];
+	u64		wr_bytes[FLUX_MON_MASTERS];
+};
+
+/* /dev/ddr_flux: records sampled from an hrtimer into a mmap'able ring */
+struct ddrflux_ring {
+	struct mutex	lock;
+	atomic_t	open;
+	struct hisi_ddr_flux_ring_hdr	*hdr;
+	struct hisi_ddr_flux_record	*records;
+	size_t		size;
+	struct hrtimer	timer;
+	ktime_t		period;
+	bool		sampling;
+};
+
+static struct ddrflux_monitor flux_mon;
+static struct ddrflux_ring flux_ring;
+
+static bool ddrflux_monitor_running(void)
+{
+	return flux_mon.running;
+}
+
+static void ddrflux_monitor_start(void)
+{
+	int asi;
+	u32 val;
+
+	val = readl(SOC_DMSS_GLB_STAT_CTRL_ADDR(flux_mon.dmss_base));
+	val |= 0x7F;
+	writel(val, SOC_DMSS_GLB_STAT_CTRL_ADDR(flux_mon.dmss_base));
+
+	for (asi = 0; asi < FLUX_MON_MASTERS; asi++) {
+		flux_mon.last_rd[asi] = readl(SOC_DMSS_ASI_STAT_FLUX_RD_ADDR
+				(flux_mon.dmss_base, asi));
+		flux_mon.last_wr[asi] = readl(SOC_DMSS_ASI_STAT_FLUX_WR_ADDR
+				(flux_mon.dmss_base, asi));
+	}
+	flux_mon.running = true;
+}
+
+static void ddrflux_monitor_read(u64 *rd_bytes, u64 *wr_bytes, u64 *time_ns)
+{
+	unsigned long flags;
+	int asi;
+	u32 rd, wr;
+
+	spin_lock_irqsave(&flux_mon.lock, flags);
+	if (!flux_mon.running)
+		ddrflux_monitor_start();
+
+	for (asi = 0; asi < FLUX_MON_MASTERS; asi++) {
+		rd = readl(SOC_DMSS_ASI_STAT_FLUX_RD_ADDR(flux_mon.dmss_base, asi));
+		wr = readl(SOC_DMSS_ASI_STAT_FLUX_WR_ADDR(flux_mon.dmss_base, asi));
+		flux_mon.rd_bytes[asi] += (u64)(u32)(rd - flux_mon.last_rd[asi]) *
+					  flux_mon.bytes_per_count;
+		flux_mon.wr_bytes[asi] += (u64)(u32)(wr - flux_mon.last_wr[asi]) *
+					  flux_mon.bytes_per_count;
+		flux_mon.last_rd[asi] = rd;
+		flux_mon.last_wr[asi] = wr;
+		rd_bytes[asi] = flux_mon.rd_bytes[asi];
+		wr_bytes[asi] = flux_mon.wr_bytes[asi];
+	}
+	*time_ns = sched_clock();
+	spin_unlock_irqrestore(&flux_mon.lock, flags);
+}
+
+#ifdef CONFIG_DEVFREQ_GOV_DDR_BANDWIDTH
+static int ddrflux_monitor_stat(struct hisi_ddr_flux_stat *stat)
+{
+	ddrflux_monitor_read(stat->rd_bytes, stat->wr_bytes, &stat->time_ns);
+	stat->nr_masters = FLUX_MON_MASTERS;
+
+	return 0;
+}
+#endif
+
+static enum hrtimer_restart ddrflux_ring_timer(struct hrtimer *timer)
+{
+	struct hisi_ddr_flux_ring_hdr *hdr = flux_ring.hdr;
+	struct hisi_ddr_flux_record *rec;
+	u64 head = hdr->head;
+
+	rec = &flux_ring.records[do_div(head, hdr->nr_records)];
+	ddrflux_monitor_read(rec->rd_bytes, rec->wr_bytes, &rec->time_ns);
+	rec->nr_masters = FLUX_MON_MASTERS;
+	rec->ddr_freq_index = (readl(dfdev->sctrl + SCBAKDATA4) & MASK_DDR) >> 8;
+
+	/* the record must be visible before the reader sees the new head */
+	smp_wmb();
+	ACCESS_ONCE(hdr->head) = hdr->head + 1;
+
+	hrtimer_forward_now(timer, flux_ring.period);
+	return HRTIMER_RESTART;
+}
+
+static void ddrflux_ring_stop(void)
+{
+	if (!flux_ring.sampling)
+		return;
+
+	hrtimer_cancel(&flux_ring.timer);
+	flux_ring.sampling = false;
+}
+
+static int ddrflux_ring_start(u32 interval_us)
+{
+	if (interval_us < FLUX_RING_MIN_US || interval_us > FLUX_RING_MAX_US)
+		return -EINVAL;
+
+	ddrflux_ring_stop();
+	flux_ring.hdr->interval_us = interval_us;
+	flux_ring.period = ns_to_ktime((u64)interval_us * NSEC_PER_USEC);
+	flux_ring.sampling = true;
+	hrtimer_start(&flux_ring.timer, flux_ring.period, HRTIMER_MODE_REL);
+
+	return 0;
+}
+
+static int ddrflux_ring_open(struct inode *inode, struct file *filp)
+{
+	struct hisi_ddr_flux_ring_hdr *hdr;
+	size_t size;
+
+	if (atomic_cmpxchg(&flux_ring.open, 0, 1))
+		return -EBUSY;
+
+	size = PAGE_SIZE + PAGE_ALIGN(FLUX_RING_RECORDS *
+				      sizeof(struct hisi_ddr_flux_record));
+	hdr = vmalloc_user(size);
+	if (!hdr) {
+		atomic_set(&flux_ring.open, 0);
+		return -ENOMEM;
+	}
+
+	hdr->version = HISI_DDR_FLUX_RING_VERSION;
+	hdr->record_size = sizeof(struct hisi_ddr_flux_record);
+	hdr->nr_records = FLUX_RING_RECORDS;
+	hdr->data_offset = PAGE_SIZE;
+
+	mutex_lock(&flux_ring.lock);
+	flux_ring.hdr = hdr;
+	flux_ring.records = (void *)hdr + PAGE_SIZE;
+	flux_ring.size = size;
+	mutex_unlock(&flux_ring.lock);
+
+	return 0;
+}
+
+static int ddrflux_ring_release(struct inode *inode, struct file *filp)
+{
+	mutex_lock(&flux_ring.lock);
+	ddrflux_ring_stop();
+	vfree(flux_ring.hdr);
+	flux_ring.hdr = NULL;
+	flux_ring.records = NULL;
+	mutex_unlock(&flux_ring.lock);
+
+	atomic_set(&flux_ring.open, 0);
+	return 0;
+}
+
+static long ddrflux_ring_ioctl(struct file *filp, unsigned int cmd,
+			       unsigned long arg)
+{
+	u32 interval_us;
+	long ret;
+
+	switch (cmd) {
+	case HISI_DDR_FLUX_IOC_START:
+		if (copy_from_user(&interval_us, (void __user *)arg,
+				   sizeof(interval_us)))
+			return -EFAULT;
+		mutex_lock(&flux_ring.lock);
+		ret = ddrflux_ring_start(interval_us);
+		mutex_unlock(&flux_ring.lock);
+		return ret;
+	case HISI_DDR_FLUX_IOC_STOP:
+		mutex_lock(&flux_ring.lock);
+		ddrflux_ring_stop();
+		mutex_unlock(&flux_ring.lock);
+		return 0;
+	default:
+		return -ENOTTY;
+	}
+}
+
+static int ddrflux_ring_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+	vma->vm_flags &= ~VM_MAYWRITE;
+
+	return remap_vmalloc_range(vma, flux_ring.hdr, vma->vm_pgoff);
+}
+
+static const struct file_operations ddrflux_ring_fops = {
+	.owner		= THIS_MODULE,
+	.open		= ddrflux_ring_open,
+	.release	= ddrflux_ring_release,
+	.unlocked_ioctl	= ddrflux_ring_ioctl,
+	.compat_ioctl	= ddrflux_ring_ioctl,
+	.mmap		= ddrflux_ring_mmap,
+};
+
+static struct miscdevice ddrflux_ring_miscdev = {
+	.minor	= MISC_DYNAMIC_MINOR,
+	.name	= "ddr_flux",
+	.fops	= &ddrflux_ring_fops,
+};
+
+static void ddrflux_monitor_init(struct device_node *np)
+{
+	if (!of_property_read_bool(np, "hisilicon,flux-monitor"))
+		return;
+
+	if (of_property_read_u32(np, "hisilicon,flux-bytes-per-count",
+				 &flux_mon.bytes_per_count))
+		flux_mon.bytes_per_count = 1;
+
+	flux_mon.dmss_base = VIRT(SOC_ACPU_DMSS_BASE_ADDR, 8);
+	if (!flux_mon.dmss_base) {
+		pr_err("%s: ioremap failed,%d\n", __func__, __LINE__);
+		return;
+	}
+	spin_lock_init(&flux_mon.lock);
+
+	mutex_init(&flux_ring.lock);
+	hrtimer_init(&flux_ring.timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	flux_ring.timer.function = ddrflux_ring_timer;
+	if (misc_register(&ddrflux_ring_miscdev))
+		pr_err("%s: misc register failed,%d\n", __func__, __LINE__);
+
+#ifdef CONFIG_DEVFREQ_GOV_DDR_BANDWIDTH
+	hisi_devfreq_set_ddr_flux_stat(ddrflux_monitor_stat);
+#endif
+}
+
+static void ddrflux_monitor_exit(void)
+{
+	if (!flux_mon.dmss_base)
+		return;
+
+#ifdef CONFIG_DEVFREQ_GOV_DDR_BANDWIDTH
+	hisi_devfreq_set_ddr_flux_stat(NULL);
+#endif
+	misc_deregister(&ddrflux_ring_miscdev);
+	iounmap(flux_mon.dmss_base);
+	flux_mon.dmss_base = NULL;
+	flux_mon.running = false;
+}
+#else
+static bool ddrflux_monitor_running(void)
+{
+	return false;
+}
+
+static void ddrflux_monitor_init(struct device_node *np)
+{
+}
+
+static void ddrflux_monitor_exit(void)
+{
+}
+#endif
+
 static int ddrc_flux_probe(struct platform_device *pdev)
 {
 	struct device_node *np = pdev->dev.of_node;
@@ -1154,6 +1455,7 @@ static int ddrc_flux_probe(struct platform_device *pdev)
 	spin_lock_init(&dfdev->lock);
 	platform_set_drvdata(pdev, dfdev);
 	ddrc_flux_dir_init();
+	ddrflux_monitor_init(np);
 	pr_info("[%s] probe sucess!\n", dev_name(&pdev->dev));
 	return ret;
 err1:
@@ -1184,6 +1486,7 @@ out:
 
 static int ddrc_flux_remove(struct platform_device *pdev)
 {
+	ddrflux_monitor_exit();
 	platform_set_drvdata(pdev, NULL);
 	clk_put(dfdev->ddrc_freq_clk);
 	clk_put(dfdev->ddrc_flux_timer->clk);
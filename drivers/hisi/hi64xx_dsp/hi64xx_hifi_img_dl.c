@@ -27,11 +27,14 @@
 #include <linux/delay.h>
 #include <linux/suspend.h>
 #include <linux/reboot.h>
+#include <linux/crc32.h>
+#include <linux/lz4.h>
 
 #include <linux/firmware.h>
 #include <linux/errno.h>
 #include <linux/proc_fs.h>
 #include <asm/uaccess.h>
+#include <asm/unaligned.h>
 #include <linux/hisi/etb.h>
 #include <dsm/dsm_pub.h>
 #include <linux/hisi/rdr_pub.h>
@@ -48,9 +51,15 @@
 
 #define HI6402_DMA_CH_COUNT 16
 #define HI6402_DMA_TIMEOUT 1000
-#define HI6402_DMA_PAGESIZE (25*1024)
+/* lz4 sections are chunked by dma page */
+#define HI6402_DMA_PAGESIZE DRV_HIFI_IMAGE_SEC_CHUNK
 #define HI6402_DMA_WIDTH 16
 #define DMA_IMG_DL_CH 10
+/* two widened pages, one on the bus while the next is prepared */
+#define HI6402_DMA_RING_SIZE (HI6402_DMA_PAGESIZE*2*2)
+
+#define HI64XX_IMG_SEC_MAX 32
+#define HI64XX_IMG_PROBE_NUM 4
 
 #define SLIMBUS_PORT4_ADDR                 0xe8051100
 #define HI6402_DSP_IF2                	   0x20012000
@@ -59,15 +68,35 @@
 
 uint64_t soc_dma_vir = 0x0;
 
+/* a code section as written by the last download */
+struct hi64xx_img_sec_state {
+	uint32_t des_addr;
+	uint32_t size;
+	uint32_t crc;
+	uint32_t probe[HI64XX_IMG_PROBE_NUM];
+};
+
+struct hi64xx_img_sec_src {
+	uint8_t *pos;
+	bool lz4;
+};
+
 struct hi64xx_hifi_img_dl_priv {
 	struct hi64xx_irq *p_irq;
 	uint32_t	*src_addr_v;
 	dma_addr_t	 src_dma_addr;
+	uint32_t	*page_buf;
+	bool		 sec_valid;
+	struct hi64xx_img_sec_state sec_state[HI64XX_IMG_SEC_MAX];
 	struct hi64xx_hifi_img_dl_config dl_config;
 };
 
 struct hi64xx_hifi_img_dl_priv *dl_data = NULL;
 
+/* leave code sections the codec still holds in place */
+static bool img_dl_reuse = true;
+module_param(img_dl_reuse, bool, S_IRUGO | S_IWUSR);
+
 extern int slimbus_bus_configure(slimbus_bus_config_type_t type);
 
 static int hi64xx_soc_dma_stop(int ch)
@@ -152,9 +181,8 @@ static void hi64xx_img_bss_page_dl(uint32_t des_addr, uint32_t src_addr, uint32_
 
 }
 
-static void hi64xx_img_page_dl(uint32_t des_addr, uint32_t src_addr, uint32_t size)
+static void hi64xx_img_page_dl_start(uint32_t des_addr, uint32_t src_addr, uint32_t size)
 {
-	int count = 0;
 	int ret = 0;
 
 	/* codec dma */
@@ -181,6 +209,13 @@ static void hi64xx_img_page_dl(uint32_t des_addr, uint32_t src_addr, uint32_t si
 	ret = slimbus_track_activate(SLIMBUS_DEVICE_HI6403, SLIMBUS_TRACK_IMAGE_LOAD, NULL);
 	if (ret)
 		HI64XX_DSP_WARNING("image load activate ret %d\n", ret);
+}
+
+static int hi64xx_img_page_dl_wait(uint32_t des_addr)
+{
+	int count = 0;
+	int ret = 0;
+	int err = 0;
 
 	do {
 		usleep_range(100, 150);
@@ -195,23 +230,96 @@ static void hi64xx_img_page_dl(uint32_t des_addr, uint32_t src_addr, uint32_t si
 			/* transfer timeout stop dma */
 			if (0 != hi64xx_codec_dma_stop(DMA_IMG_DL_CH)) {
 				HI64XX_DSP_ERROR("section download error des_addr 0x%x\n", des_addr);
-				return;
+				return -EBUSY;
 			}
 			if(0 != hi64xx_soc_dma_stop(DMA_IMG_DL_CH)) {
 				HI64XX_DSP_ERROR("section download error des_addr 0x%x\n", des_addr);
-				return;
+				return -EBUSY;
 			}
+			err = -ETIMEDOUT;
 			break;
 		}
 	} while ((readl(ASP_DMAC_CX_CONFIG(DMA_IMG_DL_CH)) & 0x1)
 			||(hi64xx_hifi_read_reg(HI64xx_CX_CONFIG(DMA_IMG_DL_CH)) & 0x1));
 
-	ret += slimbus_track_deactivate(SLIMBUS_DEVICE_HI6403, SLIMBUS_TRACK_IMAGE_LOAD, NULL);
+	ret = slimbus_track_deactivate(SLIMBUS_DEVICE_HI6403, SLIMBUS_TRACK_IMAGE_LOAD, NULL);
 	hi64xx_hifi_reg_clr_bit(dl_data->dl_config.dspif_clk_en_addr,2);
 
 	if (ret)
 		HI64XX_DSP_WARNING("page dl return ret %d\n", ret);
 
+	return err;
+}
+
+/* bytes the section takes in the image, negative if it does not fit */
+static ssize_t hi64xx_img_sec_src_len(struct drv_hifi_image_head *head,
+					struct drv_hifi_image_sec *sec)
+{
+	uint8_t *start = (uint8_t *)head + sec->src_offset;
+	uint8_t *end = (uint8_t *)head + head->image_size;
+	uint8_t *pos = start;
+	uint32_t left = sec->size;
+	uint32_t clen;
+
+	if (sec->src_offset > head->image_size)
+		return -EINVAL;
+
+	if (!(sec->type & DRV_HIFI_IMAGE_SEC_LZ4)) {
+		if (sec->size > end - start)
+			return -EINVAL;
+		return sec->size;
+	}
+
+	while (left) {
+		if (end - pos < sizeof(clen))
+			return -EINVAL;
+		clen = get_unaligned_le32(pos);
+		pos += sizeof(clen);
+		if (clen > end - pos)
+			return -EINVAL;
+		pos += clen;
+		left -= min_t(uint32_t, left, HI6402_DMA_PAGESIZE);
+	}
+
+	return pos - start;
+}
+
+static void hi64xx_img_sec_src_init(struct hi64xx_img_sec_src *src,
+					struct drv_hifi_image_head *head,
+					struct drv_hifi_image_sec *sec)
+{
+	src->pos = (uint8_t *)head + sec->src_offset;
+	src->lz4 = !!(sec->type & DRV_HIFI_IMAGE_SEC_LZ4);
+}
+
+/*
+ * next @len bytes of section data, at most one page; lz4 chunks are
+ * unpacked into page_buf, which the following call overwrites
+ */
+static uint32_t *hi64xx_img_sec_src_next(struct hi64xx_img_sec_src *src, uint32_t len)
+{
+	uint32_t *data = (uint32_t *)src->pos;
+	size_t out_len = len;
+	uint32_t clen;
+
+	if (!src->lz4) {
+		src->pos += len;
+		return data;
+	}
+
+	if (!dl_data->page_buf)
+		return NULL;
+
+	clen = get_unaligned_le32(src->pos);
+	src->pos += sizeof(clen);
+	if (lz4_decompress_unknownoutputsize(src->pos, clen,
+			(unsigned char *)dl_data->page_buf, &out_len) || out_len != len) {
+		HI64XX_DSP_ERROR("lz4 chunk unpack error, len:0x%x\n", len);
+		return NULL;
+	}
+	src->pos += clen;
+
+	return dl_data->page_buf;
 }
 
 /*
@@ -220,6 +328,8 @@ static void hi64xx_img_page_dl(uint32_t des_addr, uint32_t src_addr, uint32_t si
 static int hi64xx_hifi_fw_section_head_check(struct drv_hifi_image_head *img_head,
 						 struct drv_hifi_image_sec *img_sec)
 {
+	unsigned char type = img_sec->type & DRV_HIFI_IMAGE_SEC_TYPE_MASK;
+
 	/* BSS section do not need check offset and size,
 	 * beacuse BSS section only record address and length, the content is 0 */
 	if (img_sec->type == DRV_HIFI_IMAGE_SEC_TYPE_BSS
@@ -229,8 +339,9 @@ static int hi64xx_hifi_fw_section_head_check(struct drv_hifi_image_head *img_hea
 
 	/* check section number and section size  */
 	if ((img_sec->sn >= img_head->sections_num)
-		|| (img_sec->src_offset + img_sec->size > img_head->image_size)
-		|| (img_sec->type >= (unsigned char)DRV_HIFI_IMAGE_SEC_TYPE_BUTT)
+		|| (hi64xx_img_sec_src_len(img_head, img_sec) < 0)
+		|| (type >= (unsigned char)DRV_HIFI_IMAGE_SEC_TYPE_BUTT)
+		|| (type == (unsigned char)DRV_HIFI_IMAGE_SEC_TYPE_BSS)
 		|| (img_sec->load_attib >= (unsigned char)DRV_HIFI_IMAGE_SEC_LOAD_BUTT))
 	{
 		HI64XX_DSP_ERROR("hifi: drv_hifi_check_sections ERROR.\n");
@@ -246,6 +357,11 @@ static int hi64xx_hifi_fw_head_check(struct drv_hifi_image_head *head)
 	int i = 0;
 	int ret = 0;
 
+	if (head->sections_num > HI64XX_IMG_SEC_MAX) {
+		HI64XX_DSP_ERROR("hifi: too many sections %u\n", head->sections_num);
+		return -1;
+	}
+
 	for (i = 0; i < head->sections_num; i++) {
 		/* check the sections */
 		ret = hi64xx_hifi_fw_section_head_check(head, &(head->sections[i]));
@@ -283,15 +399,70 @@ static void hi64xx_img_sec_dl_reg(uint32_t *src, uint32_t des, int size, int typ
 	}
 }
 
-static void hi64xx_img_sec_dl_dma(uint32_t *src_addr, uint32_t des_addr, int type,
-									int size)
+static int hi64xx_img_sec_dl_reg_src(struct drv_hifi_image_head *head,
+					struct drv_hifi_image_sec *sec)
+{
+	struct hi64xx_img_sec_src src;
+	int type = sec->type & DRV_HIFI_IMAGE_SEC_TYPE_MASK;
+	uint32_t des_addr = sec->des_addr;
+	uint32_t left = sec->size;
+	uint32_t len = 0;
+	uint32_t *data = NULL;
+
+	if (type == DRV_HIFI_IMAGE_SEC_TYPE_BSS) {
+		hi64xx_img_sec_dl_reg(NULL, des_addr, left, type);
+		return 0;
+	}
+
+	hi64xx_img_sec_src_init(&src, head, sec);
+	while (left) {
+		len = min_t(uint32_t, left, HI6402_DMA_PAGESIZE);
+		data = hi64xx_img_sec_src_next(&src, len);
+		if (!data)
+			return -EINVAL;
+		hi64xx_img_sec_dl_reg(data, des_addr, len, type);
+		des_addr += len;
+		left -= len;
+	}
+
+	return 0;
+}
+
+/* fetch page @i of a section and widen it into its half of the dma ring */
+static uint32_t *hi64xx_img_page_prepare(struct hi64xx_img_sec_src *src, int i, uint32_t len)
 {
+	uint32_t *src_addr_v = dl_data->src_addr_v + (i & 1) * (HI6402_DMA_PAGESIZE / 2);
+	uint32_t *data = hi64xx_img_sec_src_next(src, len);
+	uint32_t n = 0;
+
+	if (!data)
+		return NULL;
+
+	for (n = 0; n < len/4; n++) {
+		src_addr_v[2*n] = (data[n]&0x0000ffff)<<16;
+		src_addr_v[2*n+1] = data[n]&0xffff0000;
+	}
+
+	return data;
+}
+
+static int hi64xx_img_sec_dl_dma(struct drv_hifi_image_head *head,
+					struct drv_hifi_image_sec *sec)
+{
+	struct hi64xx_img_sec_src src;
+	uint32_t des_addr = sec->des_addr;
+	int type = sec->type & DRV_HIFI_IMAGE_SEC_TYPE_MASK;
+	int size = sec->size;
 	int i = 0;
+	int ret = 0;
 	uint32_t dma_size = 0;
+	uint32_t len = 0;
 	int pagenum = size/HI6402_DMA_PAGESIZE;
 	int pageextra = size%HI6402_DMA_PAGESIZE;
 	int bytesleft = pageextra%HI6402_DMA_WIDTH;
-	uint32_t *src_addr_v = dl_data->src_addr_v;
+	int pages = DIV_ROUND_UP(size, HI6402_DMA_PAGESIZE);
+	uint32_t *page = NULL;
+	uint32_t *next = NULL;
 
 	switch (type) {
 	case DRV_HIFI_IMAGE_SEC_TYPE_BSS:
@@ -309,10 +480,8 @@ static void hi64xx_img_sec_dl_dma(uint32_t *src_addr, uint32_t des_addr, int typ
 		break;
 	case DRV_HIFI_IMAGE_SEC_TYPE_CODE:
 	case DRV_HIFI_IMAGE_SEC_TYPE_DATA:
-		for (i = 0; i < size/4; i++) {
-			src_addr_v[2*i] = (src_addr[i]&0x0000ffff)<<16;
-			src_addr_v[2*i+1] = src_addr[i]&0xffff0000;
-		}
+		if (!dl_data->src_addr_v)
+			return hi64xx_img_sec_dl_reg_src(head, sec);
 
 		HI64XX_DSP_INFO("codec dma des phy addr:0x%x, size:0x%x\n", des_addr, size);
 
@@ -321,34 +490,126 @@ static void hi64xx_img_sec_dl_dma(uint32_t *src_addr, uint32_t des_addr, int typ
 		writel(0x83322046, ASP_DMAC_CX_CONFIG(DMA_IMG_DL_CH));
 		writel(SLIMBUS_PORT4_ADDR, ASP_DMAC_CX_DES_ADDR(DMA_IMG_DL_CH));
 
-		for (i = 0; i <= pagenum; i++) {
-			if(i == pagenum) {
-				dma_size = pageextra - bytesleft;
-			} else {
-				dma_size = HI6402_DMA_PAGESIZE;
+		/*
+		 * page i is on the bus from one half of the ring while page
+		 * i + 1 is fetched, unpacked and widened into the other half
+		 */
+		hi64xx_img_sec_src_init(&src, head, sec);
+		page = hi64xx_img_page_prepare(&src, 0, min(size, HI6402_DMA_PAGESIZE));
+		for (i = 0; i < pages && page; i++) {
+			len = min(size - HI6402_DMA_PAGESIZE*i, HI6402_DMA_PAGESIZE);
+			dma_size = len - len%HI6402_DMA_WIDTH;
+
+			if (dma_size)
+				hi64xx_img_page_dl_start(des_addr + HI6402_DMA_PAGESIZE*i,
+						(dl_data->src_dma_addr + HI6402_DMA_PAGESIZE*(i & 1)*2),
+						dma_size);
+
+			next = NULL;
+			if (i + 1 < pages)
+				next = hi64xx_img_page_prepare(&src, i + 1,
+						min(size - HI6402_DMA_PAGESIZE*(i + 1), HI6402_DMA_PAGESIZE));
+
+			if (dma_size && hi64xx_img_page_dl_wait(des_addr + HI6402_DMA_PAGESIZE*i))
+				ret = -ETIMEDOUT;
+
+			/* only the last page has a tail, nothing was fetched after it */
+			if (len > dma_size) {
+				HI64XX_DSP_INFO("reg write size:%d\n", len - dma_size);
+				hi64xx_img_sec_dl_reg(page + dma_size/4,
+						des_addr + HI6402_DMA_PAGESIZE*i + dma_size,
+						len - dma_size, DRV_HIFI_IMAGE_SEC_TYPE_CODE);
 			}
-			hi64xx_img_page_dl(des_addr + HI6402_DMA_PAGESIZE*i,
-							   (dl_data->src_dma_addr + HI6402_DMA_PAGESIZE*i*2),
-							   dma_size);
-		}
-		if(bytesleft > 0) {
-			HI64XX_DSP_INFO("reg write size:%d\n", bytesleft);
-			des_addr = des_addr + size - bytesleft;
-			hi64xx_img_sec_dl_reg(src_addr + (size - bytesleft)/4, des_addr, bytesleft,
-									DRV_HIFI_IMAGE_SEC_TYPE_CODE);
+			page = next;
 		}
+		if (i < pages)
+			ret = -EINVAL;
 		break;
 	default:
 		HI64XX_DSP_ERROR("section type invalid\n");
 		break;
 	}
+
+	return ret;
+}
+
+static uint32_t hi64xx_img_probe_addr(struct hi64xx_img_sec_state *state, int k)
+{
+	return state->des_addr + state->size/4/HI64XX_IMG_PROBE_NUM*k*4;
+}
+
+/*
+ * A code section is left in place if the codec still holds the copy of
+ * the last download: same address, same image bytes, and the sampled
+ * words still read back as they did right after it was written. Data
+ * and bss are changed by the running dsp and are always reloaded.
+ */
+static bool hi64xx_img_sec_reusable(int i, struct drv_hifi_image_sec *sec, uint32_t crc)
+{
+	struct hi64xx_img_sec_state *state = &dl_data->sec_state[i];
+	int k = 0;
+
+	if (!dl_data->sec_valid
+		|| (sec->size < HI64XX_IMG_PROBE_NUM*4)
+		|| (state->size != sec->size)
+		|| (state->des_addr != sec->des_addr)
+		|| (state->crc != crc))
+		return false;
+
+	for (k = 0; k < HI64XX_IMG_PROBE_NUM; k++) {
+		if (hi64xx_hifi_read_reg(hi64xx_img_probe_addr(state, k)) != state->probe[k])
+			return false;
+	}
+
+	return true;
+}
+
+static void hi64xx_img_sec_record(int i, struct drv_hifi_image_sec *sec, uint32_t crc)
+{
+	struct hi64xx_img_sec_state *state = &dl_data->sec_state[i];
+	int k = 0;
+
+	state->des_addr = sec->des_addr;
+	state->crc = crc;
+	state->size = sec->size;
+	for (k = 0; k < HI64XX_IMG_PROBE_NUM; k++)
+		state->probe[k] = hi64xx_hifi_read_reg(hi64xx_img_probe_addr(state, k));
+}
+
+static void hi64xx_img_sec_dl(struct drv_hifi_image_head *head, int i, bool use_dma)
+{
+	struct drv_hifi_image_sec *sec = &head->sections[i];
+	bool reuse = img_dl_reuse
+		&& ((sec->type & DRV_HIFI_IMAGE_SEC_TYPE_MASK) == DRV_HIFI_IMAGE_SEC_TYPE_CODE);
+	uint32_t crc = 0;
+	int ret = 0;
+
+	if (reuse) {
+		crc = crc32_le(~0, (uint8_t *)head + sec->src_offset,
+				hi64xx_img_sec_src_len(head, sec));
+		if (hi64xx_img_sec_reusable(i, sec, crc)) {
+			HI64XX_DSP_INFO("section %d still loaded, skip\n", i);
+			return;
+		}
+	}
+
+	/* forget the old copy until the new one is complete */
+	dl_data->sec_state[i].size = 0;
+
+	if (use_dma && (sec->size > IMAGEDOWN_SIZE_THRESH))
+		ret = hi64xx_img_sec_dl_dma(head, sec);
+	else
+		ret = hi64xx_img_sec_dl_reg_src(head, sec);
+
+	if (ret)
+		HI64XX_DSP_ERROR("section %d download error %d\n", i, ret);
+	else if (reuse)
+		hi64xx_img_sec_record(i, sec, crc);
 }
 
 void hi64xx_hifi_download_slimbus(const struct firmware *fw)
 {
 	struct drv_hifi_image_head *head = NULL;
-	uint32_t *src_addr;
-	uint32_t des_addr;
 	int i = 0;
 
 	hi64xx_hifi_reg_write_bits(HI64xx_AUDIO_CLK_EN, 0x3, 0x3);
@@ -382,18 +643,10 @@ void hi64xx_hifi_download_slimbus(const struct firmware *fw)
 
 	HI64XX_DSP_INFO("img down begin, size:[%zu] !\n", fw->size);
 
-	for (i = 0; i < head->sections_num; i++) {
-		src_addr = (unsigned int *)((char *)head + head->sections[i].src_offset);
-		des_addr = head->sections[i].des_addr;
-
-		if (head->sections[i].size > IMAGEDOWN_SIZE_THRESH) {
-			hi64xx_img_sec_dl_dma(src_addr, des_addr, head->sections[i].type,
-								  head->sections[i].size);
-		} else {
-			hi64xx_img_sec_dl_reg(src_addr, des_addr, head->sections[i].size,
-								  head->sections[i].type);
-		}
-	}
+	for (i = 0; i < head->sections_num; i++)
+		hi64xx_img_sec_dl(head, i, true);
+
+	dl_data->sec_valid = true;
 
 err:
 	if (soc_dma_vir) {
@@ -408,8 +661,6 @@ err:
 void hi64xx_hifi_download(const struct firmware *fw, enum bustype_select bus_sel)
 {
 	struct drv_hifi_image_head *head = NULL;
-	unsigned int des_addr;
-	unsigned int *src_addr;
 	int i = 0;
 	int ret = 0;
 
@@ -430,8 +681,6 @@ void hi64xx_hifi_download(const struct firmware *fw, enum bustype_select bus_sel
 		slimbus_bus_configure(SLIMBUS_BUS_CONFIG_REGIMGDOWN);
 
 	for (i = 0; i < head->sections_num; i++) {
-		src_addr = (unsigned int *)((char *)head + head->sections[i].src_offset);
-		des_addr = head->sections[i].des_addr;
 		HI64XX_DSP_DEBUG("hifi: sections_num = %d,des_addr = 0x%x, load_attib = %d, size = 0x%x,"
 				 " sn = %d, src_offset = 0x%x, type = %d\n", \
 				 head->sections_num,\
@@ -441,21 +690,31 @@ void hi64xx_hifi_download(const struct firmware *fw, enum bustype_select bus_sel
 				 head->sections[i].sn,\
 				 head->sections[i].src_offset,\
 				 head->sections[i].type);
-		HI64XX_DSP_INFO("[0x%pK]->[0x%x]\n", src_addr, des_addr);
-		hi64xx_img_sec_dl_reg(src_addr, des_addr,
-							  head->sections[i].size, head->sections[i].type);
+		HI64XX_DSP_INFO("[0x%pK]->[0x%x]\n", (char *)head + head->sections[i].src_offset,
+				head->sections[i].des_addr);
+		hi64xx_img_sec_dl(head, i, false);
 	}
 
+	dl_data->sec_valid = true;
+
 	if (BUSTYPE_SELECT_SLIMBUS == bus_sel)
 		slimbus_bus_configure(SLIMBUS_BUS_CONFIG_NORMAL);
 
 	HI64XX_DSP_INFO("img dl--\n");
 }
 
+/* the codec lost or may have lost its ram, download everything next time */
+void hi64xx_hifi_img_dl_invalidate(void)
+{
+	if (dl_data)
+		dl_data->sec_valid = false;
+}
+EXPORT_SYMBOL(hi64xx_hifi_img_dl_invalidate);
+
 int hi64xx_hifi_img_dl_init(struct hi64xx_irq *irqmgr,
 			struct hi64xx_hifi_img_dl_config *dl_config)
 {
-	int image_down_size = IMAGE_DOWN_MEM_SIZE;
+	int image_down_size = HI6402_DMA_RING_SIZE;
 
 	dl_data = kzalloc(sizeof(*dl_data), GFP_KERNEL);
 	if(!dl_data){
@@ -472,19 +731,25 @@ int hi64xx_hifi_img_dl_init(struct hi64xx_irq *irqmgr,
 	if (!dl_data->src_addr_v)
 		HI64XX_DSP_WARNING("dma alloc failed\n");
 
+	dl_data->page_buf = kmalloc(HI6402_DMA_PAGESIZE, GFP_KERNEL);
+	if (!dl_data->page_buf)
+		HI64XX_DSP_WARNING("page buf alloc failed, lz4 sections can not be loaded\n");
+
 	return 0;
 }
 EXPORT_SYMBOL(hi64xx_hifi_img_dl_init);
 
 void hi64xx_hifi_img_dl_deinit(void)
 {
-	int image_down_size = IMAGE_DOWN_MEM_SIZE;
+	int image_down_size = HI6402_DMA_RING_SIZE;
 
 	if (!dl_data)
 		return;
 
-	dma_free_coherent(dl_data->p_irq->dev, image_down_size,
-			dl_data->src_addr_v, dl_data->src_dma_addr);
+	if (dl_data->src_addr_v)
+		dma_free_coherent(dl_data->p_irq->dev, image_down_size,
+				dl_data->src_addr_v, dl_data->src_dma_addr);
+	kfree(dl_data->page_buf);
 
 	kfree(dl_data);
 
@@ -20,6 +20,7 @@ struct hi64xx_hifi_img_dl_config {
 int hi64xx_release_all_dma(void);
 void hi64xx_hifi_download(const struct firmware *fw, enum bustype_select bus_sel);
 void hi64xx_hifi_download_slimbus(const struct firmware *fw);
+void hi64xx_hifi_img_dl_invalidate(void);
 int hi64xx_hifi_img_dl_init(struct hi64xx_irq *irqmgr,
 			struct hi64xx_hifi_img_dl_config *dl_config);
 void hi64xx_hifi_img_dl_deinit(void);
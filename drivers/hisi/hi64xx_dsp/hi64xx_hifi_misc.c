@@ -33,6 +33,7 @@
 #include <linux/reboot.h>
 #include <linux/rtc.h>
 #include <linux/time.h>
+#include <linux/ktime.h>
 #include <linux/syscalls.h>
 #include <linux/firmware.h>
 #include <linux/errno.h>
@@ -105,6 +106,12 @@ void hi64xx_watchdog_send_event(void);
 /*XXX: change to 4 to enbale debug print*/
 unsigned long hi64xx_dsp_debug_level = 3;
 
+/* last firmware download and full bring-up up to dsp power on, in us */
+static unsigned int dsp_dl_time_us;
+module_param(dsp_dl_time_us, uint, S_IRUGO);
+static unsigned int dsp_bringup_time_us;
+module_param(dsp_bringup_time_us, uint, S_IRUGO);
+
 
 struct reg_rw_struct {
 	unsigned int	reg;
@@ -743,6 +750,8 @@ static void hi64xx_watchdog_process(void)
 	hi64xx_soundtrigger_dma_close();
 
 	rdr_codec_hifi_watchdog_process();
+
+	hi64xx_hifi_img_dl_invalidate();
 }
 
 static int hi64xx_sync_write(const void *arg, const unsigned int len)
@@ -1850,6 +1859,7 @@ static int hi64xx_func_fw_download(struct krn_param_io_buf *param)
 	long ret_l = 0;
 	int i = 0;
 	static int reload_retry_count = 0;
+	ktime_t begin, dl_begin;
 
 	IN_FUNCTION;
 	BUG_ON(param == NULL);
@@ -1869,6 +1879,7 @@ static int hi64xx_func_fw_download(struct krn_param_io_buf *param)
 		return -EINVAL;
 	}
 
+	begin = ktime_get();
 	ret = request_firmware(&fw, fw_name, dsp_priv->p_irq->dev);
 	if (ret != 0) {
 		dev_err(dsp_priv->p_irq->dev, "Failed to request dsp image(%s): %d\n", fw_name, ret);
@@ -1908,6 +1919,7 @@ static int hi64xx_func_fw_download(struct krn_param_io_buf *param)
 	if (dsp_priv->dsp_config.dsp_ops.ram2axi)
 		dsp_priv->dsp_config.dsp_ops.ram2axi(true);
 
+	dl_begin = ktime_get();
 	/* fixme: can't use dma mode on NEXT, but it work good on UDP */
 	if (dsp_priv->dsp_config.slimbus_load) {
 		HI64XX_DSP_INFO("slimbus down load\n");
@@ -1918,6 +1930,7 @@ static int hi64xx_func_fw_download(struct krn_param_io_buf *param)
 		hi64xx_hifi_write_reg(dsp_priv->dsp_config.cmd2_addr, dsp_priv->uart_mode);
 		hi64xx_hifi_download(fw, dsp_priv->dsp_config.bus_sel);
 	}
+	dsp_dl_time_us = (unsigned int)ktime_us_delta(ktime_get(), dl_begin);
 
 	release_firmware(fw);
 
@@ -1946,6 +1959,7 @@ static int hi64xx_func_fw_download(struct krn_param_io_buf *param)
 		unsigned int read_res[6];
 
 		HI64XX_DSP_ERROR("wait for dsp pwron error, ret:%ld\n", ret_l);
+		hi64xx_hifi_img_dl_invalidate();
 
 		read_res[0] = hi64xx_hifi_read_reg(0x20007014);
 		read_res[1] = hi64xx_hifi_read_reg(0x20007015);
@@ -1979,6 +1993,9 @@ static int hi64xx_func_fw_download(struct krn_param_io_buf *param)
 		}
 	} else {
 		reload_retry_count = 0;
+		dsp_bringup_time_us = (unsigned int)ktime_us_delta(ktime_get(), begin);
+		HI64XX_DSP_INFO("dsp up in %uus, download %uus\n",
+			dsp_bringup_time_us, dsp_dl_time_us);
 	}
 
 	msleep(1);
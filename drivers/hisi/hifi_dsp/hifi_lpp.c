@@ -73,10 +73,25 @@ struct misc_msg_info {
 	const char * const info;
 };
 
+/*
+ * PCM period notifications from hifi. head counts periods announced, tail
+ * the ones the reader has picked up; a reader that falls more than one
+ * period behind has lost data, since hifi reuses the single upload buffer.
+ */
+#define HIFI_PCM_PERIOD_RING_SIZE	(16)
+struct hifi_pcm_period_ring {
+	unsigned int	head;
+	unsigned int	tail;
+	unsigned int	overrun;
+	u64	max_latency_ns;
+	u64	notify_ns[HIFI_PCM_PERIOD_RING_SIZE];
+};
+
 struct hifi_misc_priv {
 	spinlock_t	recv_sync_lock;
 	spinlock_t	recv_proc_lock;
 	spinlock_t	pcm_read_lock;
+	spinlock_t	mail_buff_lock;
 
 	struct completion	completion;
 	wait_queue_head_t	proc_waitq;
@@ -86,6 +101,9 @@ struct hifi_misc_priv {
 	int	pcm_read_wait_flag;
 	unsigned int	sn;
 
+	struct hifi_pcm_period_ring	pcm_period;
+	unsigned char	mail_buff[MAIL_LEN_MAX];
+
 	struct wake_lock	hifi_misc_wakelock;
 	struct wake_lock	update_buff_wakelock;
 
@@ -402,9 +420,34 @@ static void hifi_misc_mesg_process(void *cmd)
 	޸   : ɺ
 
 *****************************************************************************/
+static void hifi_pcm_period_notify(void)
+{
+	struct hifi_pcm_period_ring *ring = &s_misc_data.pcm_period;
+
+	spin_lock_bh(&s_misc_data.pcm_read_lock);
+	ring->notify_ns[ring->head % HIFI_PCM_PERIOD_RING_SIZE] = ktime_get_ns();
+	ring->head++;
+	if (ring->head - ring->tail > HIFI_PCM_PERIOD_RING_SIZE) {
+		ring->overrun += ring->head - ring->tail - HIFI_PCM_PERIOD_RING_SIZE;
+		ring->tail = ring->head - HIFI_PCM_PERIOD_RING_SIZE;
+	}
+	s_misc_data.pcm_read_wait_flag = true;
+	spin_unlock_bh(&s_misc_data.pcm_read_lock);
+
+	wake_up(&s_misc_data.pcm_read_waitq);
+}
+
+static bool hifi_misc_is_pcm_period(const HIFI_CHN_CMD *cmd_para, const unsigned char *msg)
+{
+	return (HIFI_CHN_READNOTICE_CMD == cmd_para->cmd_type)
+		&& (ACPU_TO_HIFI_ASYNC_CMD == cmd_para->sn)
+		&& (ID_AUDIO_AP_UPDATE_PCM_BUFF_CMD == *((unsigned short *)msg));
+}
+
 static void hifi_misc_handle_mail(void *usr_para, void *mail_handle, unsigned int mail_len)
 {
 	unsigned int ret_mail			= 0;
+	unsigned int mail_buff_len		= mail_len;
 	struct recv_request *recv = NULL;
 	HIFI_CHN_CMD *cmd_para = NULL;
 	void *recmsg = NULL;
@@ -421,32 +464,47 @@ static void hifi_misc_handle_mail(void *usr_para, void *mail_handle, unsigned in
 		goto END;
 	}
 
+	/*
+	 * Read into the preallocated buffer first: PCM period notifications
+	 * are the latency critical traffic on this channel and are handled
+	 * right here, without allocating or queuing anything.
+	 */
+	spin_lock_bh(&s_misc_data.mail_buff_lock);
+	memset(s_misc_data.mail_buff, 0, mail_len);
+	ret_mail = mailbox_read_msg_data(mail_handle, (char *)s_misc_data.mail_buff, &mail_buff_len);
+	if ((ret_mail != MAILBOX_OK) || (mail_buff_len <= 0)) {
+		spin_unlock_bh(&s_misc_data.mail_buff_lock);
+		loge("Empty point or data length error! ret=0x%x, mail_size: %d.\n", (unsigned int)ret_mail, mail_buff_len);
+		goto END;
+	}
+
+	cmd_para = (HIFI_CHN_CMD *)(s_misc_data.mail_buff + mail_len - SIZE_CMD_ID);
+	if (hifi_misc_is_pcm_period(cmd_para, s_misc_data.mail_buff)) {
+		spin_unlock_bh(&s_misc_data.mail_buff_lock);
+		hifi_pcm_period_notify();
+		goto END;
+	}
+
 	recv = (struct recv_request *)kmalloc(sizeof(struct recv_request), GFP_ATOMIC);
 	if (NULL == recv)
 	{
+		spin_unlock_bh(&s_misc_data.mail_buff_lock);
 		loge("recv kmalloc failed.\n");
 		goto ERR;
 	}
 	memset(recv, 0, sizeof(struct recv_request));
 
-	/* 趨SIZE */
-	recv->rev_msg.mail_buff_len = mail_len;
 	/* ܵĿռ */
 	recv->rev_msg.mail_buff = (unsigned char *)kmalloc(mail_len, GFP_ATOMIC);
 	if (NULL == recv->rev_msg.mail_buff)
 	{
+		spin_unlock_bh(&s_misc_data.mail_buff_lock);
 		loge("recv->rev_msg.mail_buff kmalloc failed.\n");
 		goto ERR;
 	}
-	memset(recv->rev_msg.mail_buff, 0, mail_len);
-
-	/* ʣcopy͸buff */
-	ret_mail = mailbox_read_msg_data(mail_handle, (char*)(recv->rev_msg.mail_buff), (unsigned int *)(&(recv->rev_msg.mail_buff_len)));
-
-	if ((ret_mail != MAILBOX_OK) || (recv->rev_msg.mail_buff_len <= 0)) {
-		loge("Empty point or data length error! ret=0x%x, mail_size: %d.\n", (unsigned int)ret_mail, recv->rev_msg.mail_buff_len);
-		goto ERR;
-	}
+	memcpy(recv->rev_msg.mail_buff, s_misc_data.mail_buff, mail_len);
+	recv->rev_msg.mail_buff_len = mail_buff_len;
+	spin_unlock_bh(&s_misc_data.mail_buff_lock);
 
 	logd("ret_mail=%d, mail_buff_len=%d, msgID=0x%x.\n", ret_mail, recv->rev_msg.mail_buff_len,
 		 *((unsigned int *)(recv->rev_msg.mail_buff + mail_len - SIZE_CMD_ID)));
@@ -479,13 +537,6 @@ static void hifi_misc_handle_mail(void *usr_para, void *mail_handle, unsigned in
 			goto END;
 		}
 
-		if (ID_AUDIO_AP_UPDATE_PCM_BUFF_CMD == *((unsigned short *)recmsg)) {
-			spin_lock_bh(&s_misc_data.pcm_read_lock);
-			s_misc_data.pcm_read_wait_flag = true;
-			spin_unlock_bh(&s_misc_data.pcm_read_lock);
-			wake_up(&s_misc_data.pcm_read_waitq);
-		}
-
 		if(hifi_misc_local_process(*(unsigned short*)recmsg)){
 			hifi_misc_mesg_process(recmsg);
 		}
@@ -1397,6 +1448,8 @@ static ssize_t hifi_misc_pcm_read(struct file *file, char __user *buf,
 								   size_t count, loff_t *ppos)
 {
 	int ret = 0;
+	struct hifi_pcm_period_ring *ring = &s_misc_data.pcm_period;
+	u64 latency_ns;
 
 	(void)file;
 	(void)ppos;
@@ -1430,6 +1483,16 @@ static ssize_t hifi_misc_pcm_read(struct file *file, char __user *buf,
 
 	s_misc_data.pcm_read_wait_flag = false;
 
+	/* only the newest period is still in the upload buffer */
+	if (ring->head != ring->tail) {
+		ring->overrun += ring->head - ring->tail - 1;
+		ring->tail = ring->head;
+		latency_ns = ktime_get_ns() -
+			ring->notify_ns[(ring->head - 1) % HIFI_PCM_PERIOD_RING_SIZE];
+		if (latency_ns > ring->max_latency_ns)
+			ring->max_latency_ns = latency_ns;
+	}
+
 	spin_unlock_bh(&s_misc_data.pcm_read_lock);
 
 	if (copy_to_user(buf, s_misc_data.hifi_priv_base_virt + (HIFI_PCM_UPLOAD_BUFFER_ADDR - HIFI_UNSEC_BASE_ADDR), count)) {
@@ -1465,6 +1528,36 @@ static const struct file_operations hifi_pcm_read_fops = {
 	.read = hifi_misc_pcm_read,
 }; /*lint !e785*/
 
+/* period count, lost periods and worst notify-to-read latency, max resets on read */
+static ssize_t hifi_pcm_period_proc_read(struct file *file, char __user *buf,
+										 size_t count, loff_t *ppos)
+{
+	char stat[96];
+	int len;
+	unsigned int periods, overrun;
+	u64 max_latency_ns;
+
+	if (*ppos)
+		return 0;
+
+	spin_lock_bh(&s_misc_data.pcm_read_lock);
+	periods = s_misc_data.pcm_period.head;
+	overrun = s_misc_data.pcm_period.overrun;
+	max_latency_ns = s_misc_data.pcm_period.max_latency_ns;
+	s_misc_data.pcm_period.max_latency_ns = 0;
+	spin_unlock_bh(&s_misc_data.pcm_read_lock);
+
+	len = snprintf(stat, sizeof(stat), "periods:%u overrun:%u max_latency_us:%llu\n",
+				   periods, overrun, max_latency_ns / NSEC_PER_USEC);
+
+	return simple_read_from_buffer(buf, count, ppos, stat, len);
+}
+
+static const struct file_operations hifi_pcm_period_fops = {
+	.owner = THIS_MODULE, /*lint !e64*/
+	.read = hifi_pcm_period_proc_read,
+}; /*lint !e785*/
+
 static void hifi_misc_proc_init( void )
 {
 	struct proc_dir_entry * hifi_misc_dir;
@@ -1488,6 +1581,10 @@ static void hifi_misc_proc_init( void )
 		loge("Unable to create /proc/hifidsp/hifi_pcm_read entry.\n");
 	}
 
+	if (!proc_create("hifi_pcm_period", S_IRUSR|S_IRGRP, hifi_misc_dir, &hifi_pcm_period_fops)) {
+		loge("Unable to create /proc/hifidsp/hifi_pcm_period entry.\n");
+	}
+
 	if (!entry_hifi && !entry_hifi_pcm_read) {
 		/* void remove_proc_entry(const char *name, struct proc_dir_entry *parent);
 		 * remove a /proc entry and free it if it's not currently in use.
@@ -1720,6 +1817,7 @@ static int hifi_misc_probe (struct platform_device *pdev)
 	spin_lock_init(&s_misc_data.recv_sync_lock);
 	spin_lock_init(&s_misc_data.recv_proc_lock);
 	spin_lock_init(&s_misc_data.pcm_read_lock);
+	spin_lock_init(&s_misc_data.mail_buff_lock);
 
 	/*ʼͬź*/
 	init_completion(&s_misc_data.completion);
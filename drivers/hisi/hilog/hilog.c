@@ -35,6 +35,7 @@
 #include <linux/ioctl.h>
 #include <asm/ioctls.h>
 #include <linux/hardirq.h>
+#include <linux/compat.h>
 
 #include <linux/hisi/hilog.h>
 
@@ -55,6 +56,8 @@
 #define HILOG_FLUSH_REPORT                _IO(__HILOGIO, 4) /* flush hilog */
 #define HILOG_SWITCH_ON                   _IO(__HILOGIO, 5) /* turn on hilog */
 #define HILOG_SWITCH_OFF                  _IO(__HILOGIO, 6) /* turn off hilog */
+#define HILOG_WRITE_BATCH                 _IOW(__HILOGIO, 7, struct hilog_batch) /* write many entries */
+#define HILOG_SET_FILTER                  _IOW(__HILOGIO, 8, struct hilog_filter) /* filter reader */
 
 #define HILOG_IOVEC_COUNT                 4
 
@@ -86,13 +89,50 @@ struct hilog_entry {
 #define HILOG_ENTRY_MAX_LEN               (4 * 1024)
 #define HILOG_ENTRY_MAX_PAYLOAD           (HILOG_ENTRY_MAX_LEN - sizeof(struct hilog_entry))
 
+/* define max size of one HILOG_WRITE_BATCH */
+#define HILOG_BATCH_MAX_SIZE              (16 * 1024)
+
+/**
+ * struct hilog_batch - the argument of HILOG_WRITE_BATCH.
+ *
+ * @buf:             User address of the records, each a struct hilog_entry
+ *                   followed by @len bytes of payload, back to back. pid is
+ *                   filled in by the kernel; tid, sec and nsec are kept when
+ *                   sec is set, otherwise stamped at write time
+ * @size:            Total size of the records at @buf
+ * @__pad:           Keeps the layout the same for 32 and 64 bit callers
+ */
+struct hilog_batch {
+    __u64                           buf;
+    __u32                           size;
+    __u32                           __pad;
+};
+
+#define HILOG_FILTER_MODULES              4
+#define HILOG_FILTER_MODULE_LEN           16
+
+/**
+ * struct hilog_filter - the argument of HILOG_SET_FILTER.
+ *
+ * @min_prio:        Lowest priority the reader wants, 0 for all
+ * @nr_modules:      Number of valid names in @modules, 0 for all modules
+ * @modules:         Module names the reader wants
+ *
+ * A filtered reader is neither woken for nor handed the entries that
+ * do not match.
+ */
+struct hilog_filter {
+    __u32                           min_prio;
+    __u32                           nr_modules;
+    char                            modules[HILOG_FILTER_MODULES][HILOG_FILTER_MODULE_LEN];
+};
+
 /**
  * struct hilog_device - represents a hilog device
  *
  * @buffer:     The actual ring buffer
  * @misc:       The "misc" device representing the hilog device
- * @wq:         The wait queue for @readers
- * @readers:    This hilog's readers
+ * @readers:    This hilog's readers, each with its own wait queue
  * @mutex:      The mutex that protects the @buffer
  * @w_off:      The current write head offset
  * @r_head:     The head, or location that readers start reading at
@@ -101,7 +141,6 @@ struct hilog_entry {
 struct hilog_device {
     unsigned char                   *buffer;
     struct miscdevice               misc;
-    wait_queue_head_t               wq;
     struct list_head                readers;
     struct mutex                    mutex;
     __u32                           w_off;
@@ -120,11 +159,19 @@ static bool is_hilog_turn_on = false;
  * @dev:       The associated device
  * @list:      The associated entry in @hilog_device's list
  * @r_off:     The current read head offset.
+ * @wq:        The wait queue for this reader
+ * @filter:    Which entries this reader wants
+ * @filtered:  Whether @filter drops anything
+ * @wake:      An entry for this reader arrived in the current write
  */
 struct hilog_reader {
     struct hilog_device*       dev;
     struct list_head           list;
     size_t                     r_off;
+    wait_queue_head_t          wq;
+    struct hilog_filter        filter;
+    bool                       filtered;
+    bool                       wake;
 };
 
 /* hilog_offset - returns index 'n' into the ring buffer of hilog device
@@ -201,6 +248,125 @@ static __u32 get_entry_msg_len(struct hilog_device *dev, size_t off)
     return entry->len;
 }
 
+/*
+ * copy_from_ring - copy 'count' bytes at offset 'off' of the ring buffer,
+ * wrapping at its end.
+ *
+ * Caller needs to hold dev->mutex.
+ */
+static void copy_from_ring(struct hilog_device *dev, size_t off,
+    void *dst, size_t count)
+{
+    size_t len = min(count, (size_t)(dev->size - off));
+
+    memcpy(dst, dev->buffer + off, len);
+    if (count != len) {
+        memcpy(dst + len, dev->buffer, count - len);
+    }
+}
+
+/*
+ * entry_matches_filter - whether the entry at 'off' passes the reader's
+ * filter. The payload starts with the priority byte and the module name.
+ * Entries too short to carry them are let through.
+ *
+ * Caller needs to hold dev->mutex.
+ */
+static bool entry_matches_filter(struct hilog_device *dev,
+    struct hilog_reader *reader, size_t off)
+{
+    struct hilog_filter *filter = &reader->filter;
+    char payload[1 + HILOG_FILTER_MODULE_LEN + 1] = {0};
+    __u32 len;
+    __u32 i;
+
+    if (!reader->filtered) {
+        return true;
+    }
+
+    len = get_entry_msg_len(dev, off);
+    if (len < 2) {
+        return true;
+    }
+
+    copy_from_ring(dev, hilog_offset(dev, off + sizeof(struct hilog_entry)),
+        payload, min_t(size_t, len, sizeof(payload) - 1));
+
+    if ((unsigned char)payload[0] < filter->min_prio) {
+        return false;
+    }
+
+    if (!filter->nr_modules) {
+        return true;
+    }
+
+    for (i = 0; i < filter->nr_modules; i++) {
+        if (!strncmp(payload + 1, filter->modules[i], HILOG_FILTER_MODULE_LEN)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+ * get_next_entry_by_filter - Starting at 'off', returns the offset of the
+ * first entry the reader's filter passes, or dev->w_off if there is none.
+ *
+ * Caller needs to hold dev->mutex.
+ */
+static size_t get_next_entry_by_filter(struct hilog_device *dev,
+    struct hilog_reader *reader, size_t off)
+{
+    if (!reader->filtered) {
+        return off;
+    }
+
+    while (off != dev->w_off) {
+        if (entry_matches_filter(dev, reader, off)) {
+            return off;
+        }
+        off = hilog_offset(dev, off + sizeof(struct hilog_entry) +
+            get_entry_msg_len(dev, off));
+    }
+
+    return off;
+}
+
+/*
+ * mark_readers - note which readers want the entry just written at 'off'.
+ *
+ * Caller needs to hold dev->mutex.
+ */
+static void mark_readers(struct hilog_device *dev, size_t off)
+{
+    struct hilog_reader *reader;
+
+    list_for_each_entry(reader, &dev->readers, list) {
+        if (!reader->wake && entry_matches_filter(dev, reader, off)) {
+            reader->wake = true;
+        }
+    }
+}
+
+/*
+ * wake_readers - wake each reader that got an entry it wants, once per
+ * write or batch of writes.
+ *
+ * Caller needs to hold dev->mutex.
+ */
+static void wake_readers(struct hilog_device *dev)
+{
+    struct hilog_reader *reader;
+
+    list_for_each_entry(reader, &dev->readers, list) {
+        if (reader->wake) {
+            reader->wake = false;
+            wake_up_interruptible(&reader->wq);
+        }
+    }
+}
+
 /*
  * the header length is the size of struct hilog_entry.
  */
@@ -297,8 +463,9 @@ start:
     while (1) {
         mutex_lock(&dev->mutex);
 
-        prepare_to_wait(&dev->wq, &wait, TASK_INTERRUPTIBLE);
+        prepare_to_wait(&reader->wq, &wait, TASK_INTERRUPTIBLE);
 
+        reader->r_off = get_next_entry_by_filter(dev, reader, reader->r_off);
         ret = (dev->w_off == reader->r_off);
         mutex_unlock(&dev->mutex);
         if (!ret) {
@@ -318,13 +485,15 @@ start:
         schedule();
     }
 
-    finish_wait(&dev->wq, &wait);
+    finish_wait(&reader->wq, &wait);
     if (ret) {
         return ret;
     }
 
     mutex_lock(&dev->mutex);
 
+    reader->r_off = get_next_entry_by_filter(dev, reader, reader->r_off);
+
     /* is there still something to read or did we race? */
     if (unlikely(dev->w_off == reader->r_off)) {
         mutex_unlock(&dev->mutex);
@@ -493,6 +662,7 @@ static ssize_t do_write(struct hilog_entry* header, const struct iovec *iov,
                         unsigned long nr_segs, bool from_user)
 {
     ssize_t ret = 0;
+    size_t off;
 
     /*
      * Fix up any readers, pulling them forward to the first readable
@@ -502,6 +672,7 @@ static ssize_t do_write(struct hilog_entry* header, const struct iovec *iov,
      */
     fix_up_readers(dev, sizeof(struct hilog_entry) + header->len);
 
+    off = dev->w_off;
     do_write_hilog(dev, header, sizeof(struct hilog_entry));
 
     while (nr_segs-- > 0) {
@@ -526,6 +697,8 @@ static ssize_t do_write(struct hilog_entry* header, const struct iovec *iov,
         ret += nr;
     }
 
+    mark_readers(dev, off);
+
     return ret;
 }
 
@@ -582,10 +755,10 @@ static ssize_t hilog_write_iter(struct kiocb *kiocb, struct iov_iter *from)
         return ret;
     }
 
-    mutex_unlock(&dev->mutex);
+    /* wake up the blocked readers that want it */
+    wake_readers(dev);
 
-    /* wake up any blocked readers */
-    wake_up_interruptible(&dev->wq);
+    mutex_unlock(&dev->mutex);
 
     return ret;
 }
@@ -628,10 +801,10 @@ static ssize_t hilog_aio_write(struct kiocb *iocb, const struct iovec *iov,
         return ret;
     }
 
-    mutex_unlock(&dev->mutex);
+    /* wake up the blocked readers that want it */
+    wake_readers(dev);
 
-    /* wake up any blocked readers */
-    wake_up_interruptible(&dev->wq);
+    mutex_unlock(&dev->mutex);
 
     return ret;
 }
@@ -659,7 +832,9 @@ static int hilog_open(struct inode *inode, struct file *file)
             return -ENOMEM;
         }
 
+        memset(reader, 0, sizeof(struct hilog_reader));
         reader->dev = dev;
+        init_waitqueue_head(&reader->wq);
 
         INIT_LIST_HEAD(&reader->list);
 
@@ -717,9 +892,10 @@ static unsigned int hilog_poll(struct file *file, poll_table *wait)
 
     reader = file->private_data;
 
-    poll_wait(file, &dev->wq, wait);
+    poll_wait(file, &reader->wq, wait);
 
     mutex_lock(&dev->mutex);
+    reader->r_off = get_next_entry_by_filter(dev, reader, reader->r_off);
     if (dev->w_off != reader->r_off) {
         ret |= POLLIN | POLLRDNORM;
     }
@@ -728,6 +904,131 @@ static unsigned int hilog_poll(struct file *file, poll_table *wait)
     return ret;
 }
 
+/*
+ * hilog_write_batch - write all records of a struct hilog_batch under one
+ * lock, waking each interested reader once. Returns the number of entries
+ * written.
+ */
+static long hilog_write_batch(struct file *file, void __user *arg)
+{
+    struct hilog_batch batch;
+    struct hilog_entry header;
+    struct timespec now;
+    struct iovec iov;
+    unsigned char *records = NULL;
+    size_t off = 0;
+    long count = 0;
+    long ret = 0;
+
+    if (!(file->f_mode & FMODE_WRITE)) {
+        return -EBADF;
+    }
+
+    if (copy_from_user(&batch, arg, sizeof(batch))) {
+        return -EFAULT;
+    }
+
+    if (batch.size == 0 || batch.size > HILOG_BATCH_MAX_SIZE) {
+        return -EINVAL;
+    }
+
+    records = kmalloc(batch.size, GFP_KERNEL);
+    if (!records) {
+        return -ENOMEM;
+    }
+
+    if (copy_from_user(records, (void __user *)(uintptr_t)batch.buf, batch.size)) {
+        ret = -EFAULT;
+        goto out;
+    }
+
+    /* check every record before touching the ring buffer */
+    while (off < batch.size) {
+        if (batch.size - off < sizeof(struct hilog_entry)) {
+            ret = -EINVAL;
+            goto out;
+        }
+        memcpy(&header, records + off, sizeof(struct hilog_entry));
+        off += sizeof(struct hilog_entry);
+        if (header.len == 0 || header.len > batch.size - off) {
+            ret = -EINVAL;
+            goto out;
+        }
+        off += header.len;
+    }
+
+    now = current_kernel_time();
+
+    mutex_lock(&dev->mutex);
+
+    for (off = 0; off < batch.size; count++) {
+        memcpy(&header, records + off, sizeof(struct hilog_entry));
+        off += sizeof(struct hilog_entry);
+
+        iov.iov_base = records + off;
+        iov.iov_len = header.len;
+        off += header.len;
+
+        header.len = min_t(size_t, header.len, HILOG_ENTRY_MAX_PAYLOAD);
+        header.__pad = 0;
+        header.pid = current->tgid;
+        if (!header.sec) {
+            header.tid = current->pid;
+            header.sec = now.tv_sec;
+            header.nsec = now.tv_nsec;
+        }
+
+        do_write(&header, &iov, 1, false);
+    }
+
+    /* wake up the blocked readers that want any of it */
+    wake_readers(dev);
+
+    mutex_unlock(&dev->mutex);
+
+    ret = count;
+
+out:
+    kfree(records);
+    return ret;
+}
+
+/*
+ * hilog_set_filter - make the reader skip entries below a priority or from
+ * other modules. The filter applies from the reader's current position on.
+ */
+static long hilog_set_filter(struct file *file, void __user *arg)
+{
+    struct hilog_reader *reader;
+    struct hilog_filter filter;
+    __u32 i;
+
+    if (!(file->f_mode & FMODE_READ)) {
+        return -EBADF;
+    }
+
+    if (copy_from_user(&filter, arg, sizeof(filter))) {
+        return -EFAULT;
+    }
+
+    if (filter.min_prio > HI_LOG_SILENT || filter.nr_modules > HILOG_FILTER_MODULES) {
+        return -EINVAL;
+    }
+
+    for (i = 0; i < HILOG_FILTER_MODULES; i++) {
+        filter.modules[i][HILOG_FILTER_MODULE_LEN - 1] = '\0';
+    }
+
+    reader = file->private_data;
+
+    mutex_lock(&dev->mutex);
+    reader->filter = filter;
+    reader->filtered = filter.min_prio || filter.nr_modules;
+    mutex_unlock(&dev->mutex);
+
+    return 0;
+}
+
 /*
  * hilog_ioctl - control the hilog device by send commands.
  */
@@ -736,6 +1037,15 @@ static long hilog_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
     struct hilog_reader *reader;
     long ret = -EINVAL;
 
+    switch (cmd) {
+    case HILOG_WRITE_BATCH:
+        return hilog_write_batch(file, (void __user *)arg);
+    case HILOG_SET_FILTER:
+        return hilog_set_filter(file, (void __user *)arg);
+    default:
+        break;
+    }
+
     mutex_lock(&dev->mutex);
 
     switch (cmd) {
@@ -769,6 +1079,7 @@ static long hilog_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
             break;
         }
         reader = file->private_data;
+        reader->r_off = get_next_entry_by_filter(dev, reader, reader->r_off);
 
         if (dev->w_off != reader->r_off) {
             ret = get_user_hdr_len() +
@@ -809,6 +1120,13 @@ static long hilog_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
     return ret;
 }
 
+#ifdef CONFIG_COMPAT
+static long hilog_compat_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
+{
+    return hilog_ioctl(file, cmd, (unsigned long)compat_ptr(arg));
+}
+#endif
+
 /**
  * struct file_operations - a hilog device file operation func pointers.
  */
@@ -822,7 +1140,9 @@ static const struct file_operations hilog_fops = {
 #endif
     .poll = hilog_poll,
     .unlocked_ioctl = hilog_ioctl,
-    .compat_ioctl = hilog_ioctl,
+#ifdef CONFIG_COMPAT
+    .compat_ioctl = hilog_compat_ioctl,
+#endif
     .open = hilog_open,
     .release = hilog_release,
 };
@@ -865,7 +1185,6 @@ static ssize_t create_hilog_dev(void)
     dev->misc.fops = &hilog_fops;
     dev->misc.parent = NULL;
 
-    init_waitqueue_head(&dev->wq);
     INIT_LIST_HEAD(&dev->readers);
 
     mutex_init(&dev->mutex);
@@ -1022,10 +1341,10 @@ extern int __hi_log_print(const size_t pri, const char* module, const char* sub_
         return ret;
     }
 
-    mutex_unlock(&dev->mutex);
+    /* wake up the blocked readers that want it */
+    wake_readers(dev);
 
-    /* wake up any blocked readers */
-    wake_up_interruptible(&dev->wq);
+    mutex_unlock(&dev->mutex);
 
     return ret;
 }
@@ -48,6 +48,10 @@
 #include <linux/of.h>
 #include <linux/of_fdt.h>
 #include <linux/kernel.h>
+#include <linux/moduleparam.h>
+#include <linux/string.h>
+#include <linux/workqueue.h>
+#include <linux/hisi/hisi_cma.h>
 
 #define HISI_CMA_AREA_NR 8
 
@@ -58,11 +62,27 @@ struct hisi_cma {
 	long align;
 	bool fixed;
 	bool sec_prot;
+	struct work_struct evacuate_work;
 };
 
 static struct hisi_cma hisi_cma[HISI_CMA_AREA_NR];
 static int hisi_cma_area_nr;
 
+/* how long user pages stay out of CMA after an evacuate hint */
+static unsigned int hisi_cma_hold_ms = 2000;
+module_param_named(evacuate_hold_ms, hisi_cma_hold_ms, uint, 0644);
+
+static void hisi_cma_evacuate_work(struct work_struct *work)
+{
+	struct hisi_cma *hc = container_of(work, struct hisi_cma,
+						evacuate_work);
+	unsigned long nr;
+
+	nr = cma_evacuate(hc->cma_area);
+	pr_info("%s: %lu KB evacuated\n", hc->cma_name,
+					nr << (PAGE_SHIFT - 10));
+}
+
 static int __init hisi_cma_reserve_mem_fdt_scan(unsigned long node,
 		const char *uname, int depth, void *data)
 {
@@ -153,6 +173,8 @@ static int __init hisi_cma_reserve_mem_fdt_scan(unsigned long node,
 
 	cma_dev = &hisi_cma[hisi_cma_area_nr].cma_dev;
 	dev_set_cma_area(cma_dev, *cma_area);
+	INIT_WORK(&hisi_cma[hisi_cma_area_nr].evacuate_work,
+					hisi_cma_evacuate_work);
 
 	BUG_ON(++hisi_cma_area_nr == HISI_CMA_AREA_NR + 1);
 
@@ -175,21 +197,60 @@ int __init of_hisi_cma_contiguous_reserve_area(phys_addr_t limit)
 	return of_scan_flat_dt(hisi_cma_reserve_mem_fdt_scan, &limit);
 }
 
-/*
- * some module will get the hisi cma device;
- * and then will call cma_alloc.
- */
-struct device *hisi_get_cma_area_device(char *name)
+static struct hisi_cma *hisi_cma_find(const char *name)
 {
 	int i;
 
 	for (i = 0; i < hisi_cma_area_nr; i++) {
-		if (!hisi_cma[i].cma_area)
+		if (!hisi_cma[i].cma_area || !hisi_cma[i].cma_name)
 			continue;
 		if (!strcmp(hisi_cma[i].cma_name, name))
-			break;
+			return &hisi_cma[i];
 	}
-	if (hisi_cma_area_nr == i)
+	return NULL;
+}
+
+/*
+ * some module will get the hisi cma device;
+ * and then will call cma_alloc.
+ */
+struct device *hisi_get_cma_area_device(char *name)
+{
+	struct hisi_cma *hc = hisi_cma_find(name);
+
+	if (!hc)
 		return NULL;
-	return &(hisi_cma[i].cma_dev);
+	return &hc->cma_dev;
+}
+
+/*
+ * A large allocation from this area is coming (camera start, secure UI):
+ * move the pages out now, in the background, and keep new user pages
+ * away until it has happened.
+ */
+int hisi_cma_evacuate(const char *name)
+{
+	struct hisi_cma *hc = hisi_cma_find(name);
+
+	if (!hc)
+		return -ENODEV;
+
+	cma_hold_placement(hisi_cma_hold_ms);
+	queue_work(system_unbound_wq, &hc->evacuate_work);
+	return 0;
+}
+
+/* echo <cma-name> > /sys/module/hisi_cma/parameters/evacuate */
+static int hisi_cma_evacuate_set(const char *val,
+				const struct kernel_param *kp)
+{
+	char name[32];
+
+	strlcpy(name, val, sizeof(name));
+	return hisi_cma_evacuate(strim(name));
 }
+
+static const struct kernel_param_ops hisi_cma_evacuate_ops = {
+	.set = hisi_cma_evacuate_set,
+};
+module_param_cb(evacuate, &hisi_cma_evacuate_ops, NULL, 0200);
@@ -12,6 +12,14 @@ static inline int hisi_lowmem_tune(int *other_free, int *other_file,
 }
 #endif
 
+#ifdef CONFIG_HISI_LMK_REAPER
+void hisi_lowmem_reap(struct task_struct *tsk);
+#else
+static inline void hisi_lowmem_reap(struct task_struct *tsk)
+{
+}
+#endif
+
 #ifdef CONFIG_HISI_LOWMEM_DBG
 
 void hisi_lowmem_dbg(short oom_score_adj);
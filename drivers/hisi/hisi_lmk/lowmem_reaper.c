@@ -0,0 +1,146 @@
+#define pr_fmt(fmt) "hisi_lowmem: " fmt
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/mm.h>
+#include <linux/oom.h>
+#include <linux/sched.h>
+#include <linux/kthread.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
+#include <linux/delay.h>
+#include <linux/ktime.h>
+#include <linux/boost_sigkill_free.h>
+
+#include "lowmem_killer.h"
+#include "lowmem_trace.h"
+
+/* victims waiting for the reaper, must be a power of 2 */
+#define LMK_REAP_QUEUE 16
+/* mmap_sem of the victim may be held for a while, e.g. by a fault */
+#define LMK_REAP_RETRIES 10
+#define LMK_REAP_RETRY_MS 20
+
+struct lowmem_victim {
+	struct task_struct *tsk;
+	ktime_t killed;
+};
+
+static struct lowmem_victim reap_queue[LMK_REAP_QUEUE];
+/* free running, protected by reap_lock */
+static unsigned int reap_head, reap_tail;
+static DEFINE_SPINLOCK(reap_lock);
+static DECLARE_WAIT_QUEUE_HEAD(reap_wait);
+static struct task_struct *reap_thread;
+
+static bool lowmem_reap_enable = true;
+module_param_named(reap, lowmem_reap_enable, bool, S_IRUGO | S_IWUSR);
+
+/*
+ * Called by lmk right after SIGKILL was sent. The victim is only queued,
+ * a full queue means the reaper is already behind and the victim frees
+ * its memory on its own as before.
+ */
+void hisi_lowmem_reap(struct task_struct *tsk)
+{
+	struct lowmem_victim *victim;
+	bool queued = false;
+
+	if (!reap_thread || !READ_ONCE(lowmem_reap_enable))
+		return;
+
+	spin_lock(&reap_lock);
+	if (reap_tail - reap_head < LMK_REAP_QUEUE) {
+		get_task_struct(tsk);
+		victim = &reap_queue[reap_tail++ & (LMK_REAP_QUEUE - 1)];
+		victim->tsk = tsk;
+		victim->killed = ktime_get();
+		queued = true;
+	}
+	spin_unlock(&reap_lock);
+
+	if (queued)
+		wake_up(&reap_wait);
+}
+
+/* Returns false if the victim's mmap_sem was contended */
+static bool lowmem_reap_mm(struct task_struct *tsk, unsigned long *nr_freed)
+{
+	struct task_struct *p;
+	struct mm_struct *mm;
+	unsigned long rss;
+	bool done;
+
+	p = find_lock_task_mm(tsk);
+	if (!p)
+		return true;	/* exit_mm() already did it */
+	mm = p->mm;
+	atomic_inc(&mm->mm_users);
+	task_unlock(p);
+
+	rss = get_mm_counter(mm, MM_ANONPAGES);
+	done = fast_free_mm(mm, true);
+	if (done)
+		*nr_freed = rss - min(rss, get_mm_counter(mm, MM_ANONPAGES));
+	mmput(mm);
+
+	return done;
+}
+
+static void lowmem_reap_victim(struct lowmem_victim *victim)
+{
+	unsigned long nr_freed = 0;
+	int attempts = 0;
+	bool done;
+
+	do {
+		if (attempts)
+			msleep(LMK_REAP_RETRY_MS);
+		done = lowmem_reap_mm(victim->tsk, &nr_freed);
+	} while (!done && ++attempts < LMK_REAP_RETRIES);
+
+	trace_lowmem_reap(victim->tsk, nr_freed, attempts + 1, done,
+			  ktime_us_delta(ktime_get(), victim->killed));
+	put_task_struct(victim->tsk);
+}
+
+static bool lowmem_reap_pending(void)
+{
+	return READ_ONCE(reap_head) != READ_ONCE(reap_tail);
+}
+
+static int lowmem_reaper(void *unused)
+{
+	struct lowmem_victim victim;
+
+	while (true) {
+		wait_event(reap_wait, lowmem_reap_pending());
+
+		spin_lock(&reap_lock);
+		victim = reap_queue[reap_head++ & (LMK_REAP_QUEUE - 1)];
+		spin_unlock(&reap_lock);
+
+		lowmem_reap_victim(&victim);
+	}
+
+	return 0;
+}
+
+static int __init hisi_lowmem_reaper_init(void)
+{
+	struct sched_param param = { .sched_priority = MAX_USER_RT_PRIO / 2 };
+	struct task_struct *tsk;
+
+	tsk = kthread_run(lowmem_reaper, NULL, "lmk_reaper");
+	if (IS_ERR(tsk)) {
+		pr_err("failed to start reaper thread\n");
+		return PTR_ERR(tsk);
+	}
+
+	/* the victim may be stuck on a slow cpu, the reaper must not be */
+	sched_setscheduler_nocheck(tsk, SCHED_FIFO, &param);
+	reap_thread = tsk;
+
+	return 0;
+}
+device_initcall(hisi_lowmem_reaper_init);
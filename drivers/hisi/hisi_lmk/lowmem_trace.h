@@ -6,6 +6,7 @@
 #if !defined(_TRACE_HISI_LOWMEM_H) || defined(TRACE_HEADER_MULTI_READ)
 #define _TRACE_HISI_LOWMEM_H
 
+#include <linux/sched.h>
 #include <linux/tracepoint.h>
 
 TRACE_EVENT(lowmem_tune,/* [false alarm] */
@@ -38,6 +39,35 @@ TRACE_EVENT(lowmem_tune,/* [false alarm] */
 		__entry->other_file, __entry->tune_free, __entry->tune_file)
 );
 
+TRACE_EVENT(lowmem_reap,
+	TP_PROTO(struct task_struct *tsk, unsigned long nr_freed,
+		 int attempts, bool done, s64 kill_to_free_us),
+
+	TP_ARGS(tsk, nr_freed, attempts, done, kill_to_free_us),
+
+	TP_STRUCT__entry(
+			__array(char, comm, TASK_COMM_LEN)
+			__field(pid_t, pid)
+			__field(unsigned long, nr_freed)
+			__field(int, attempts)
+			__field(bool, done)
+			__field(s64, kill_to_free_us)
+	),
+
+	TP_fast_assign(
+			memcpy(__entry->comm, tsk->comm, TASK_COMM_LEN);
+			__entry->pid = tsk->pid;
+			__entry->nr_freed = nr_freed;
+			__entry->attempts = attempts;
+			__entry->done = done;
+			__entry->kill_to_free_us = kill_to_free_us;
+	),
+
+	TP_printk("%s %d freed %lu attempts %d done %d kill_to_free %lldus",
+		__entry->comm, __entry->pid, __entry->nr_freed,
+		__entry->attempts, __entry->done, __entry->kill_to_free_us)
+);
+
 #endif
 
 /* This part must be outside protection */
@@ -0,0 +1,375 @@
+/*
+ *  drivers/hisi/hisi_page_tracker/page_sampler.c
+ *
+ *  Sampled page tracker. Instead of keeping owner info in page_ext for
+ *  every page, about one allocation in page_tracker_sample has its stack
+ *  captured into a fixed size per-cpu ring of samples, identical stacks
+ *  being stored only once. Freeing a sampled page retires its sample, so
+ *  what stays live per stack points at the leaking allocator. Reports are
+ *  in debugfs page_tracker/. Enabled with page_tracker_sample=<N>.
+ */
+#include <linux/module.h>
+#include <linux/debugfs.h>
+#include <linux/hash.h>
+#include <linux/jhash.h>
+#include <linux/mm.h>
+#include <linux/percpu.h>
+#include <linux/random.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/spinlock.h>
+#include <linux/stacktrace.h>
+#include <linux/vmalloc.h>
+#include <linux/hisi/page_tracker.h>
+
+#define PGT_RING_SIZE		1024	/* samples per cpu, power of 2 */
+#define PGT_RING_PROBE		4	/* live slots skipped before dropping */
+#define PGT_STACK_DEPTH		12
+#define PGT_STACK_SKIP		3	/* save_stack_trace*, this hook */
+#define PGT_STACK_POOL		1024
+#define PGT_STACK_BUCKETS	512
+#define PGT_LIVE_BITS		12
+#define PGT_NONE		UINT_MAX
+#define PGT_IDLE_INTERVAL	1024	/* recheck period while rate is 0 */
+#define PGT_TOP_MAX		32
+
+struct pgt_stack {
+	u32 hash;
+	u32 next;
+	u32 nr_entries;
+	u32 allocs;		/* sampled allocations */
+	u64 pages;		/* sampled pages allocated */
+	u64 live_pages;		/* sampled pages not freed yet */
+	unsigned long entries[PGT_STACK_DEPTH];
+};
+
+struct pgt_sample {
+	unsigned long pfn;
+	u64 ts;
+	u32 stack;
+	u32 next;		/* live hash chain */
+	pid_t pid;
+	u8 order;
+	u8 live;
+};
+
+static unsigned int page_tracker_sample;
+static bool pgt_ready;
+static DEFINE_SPINLOCK(pgt_lock);
+static DEFINE_PER_CPU(int, pgt_countdown);
+static DEFINE_PER_CPU(u32, pgt_ring_head);
+
+/* cpu N owns pgt_samples[N * PGT_RING_SIZE, (N + 1) * PGT_RING_SIZE) */
+static struct pgt_sample *pgt_samples;
+static struct pgt_stack *pgt_stacks;
+static u32 pgt_stacks_used;
+static u32 pgt_stack_head[PGT_STACK_BUCKETS];
+static u32 pgt_live_head[1 << PGT_LIVE_BITS];
+static unsigned long pgt_nr_live;
+static unsigned long pgt_dropped;
+
+static int __init early_page_tracker_sample_param(char *buf)
+{
+	if (!buf)
+		return -EINVAL;
+
+	return kstrtouint(buf, 0, &page_tracker_sample);
+}
+early_param("page_tracker_sample", early_page_tracker_sample_param);
+
+/* randomised around the rate so periodic allocators are not aliased */
+static int pgt_next_interval(unsigned int rate)
+{
+	if (!rate)
+		return PGT_IDLE_INTERVAL;
+
+	return (int)(rate / 2 + prandom_u32_max(rate) + 1);
+}
+
+/* Caller holds pgt_lock. Stack 0 is shared once the pool is full. */
+static u32 pgt_stack_get(const unsigned long *entries, u32 nr, u32 hash)
+{
+	u32 b = hash & (PGT_STACK_BUCKETS - 1);
+	struct pgt_stack *st;
+	u32 i;
+
+	for (i = pgt_stack_head[b]; i != PGT_NONE; i = pgt_stacks[i].next) {
+		st = &pgt_stacks[i];
+		if (st->hash == hash && st->nr_entries == nr &&
+		    !memcmp(st->entries, entries, nr * sizeof(unsigned long)))
+			return i;
+	}
+
+	if (pgt_stacks_used >= PGT_STACK_POOL)
+		return 0;
+
+	i = pgt_stacks_used++;
+	st = &pgt_stacks[i];
+	st->hash = hash;
+	st->nr_entries = nr;
+	memcpy(st->entries, entries, nr * sizeof(unsigned long));
+	st->next = pgt_stack_head[b];
+	pgt_stack_head[b] = i;
+
+	return i;
+}
+
+/* Caller holds pgt_lock. Live samples are never overwritten. */
+static u32 pgt_ring_claim(int cpu)
+{
+	u32 *head = per_cpu_ptr(&pgt_ring_head, cpu);
+	u32 base = (u32)cpu * PGT_RING_SIZE;
+	u32 i, idx;
+
+	for (i = 0; i < PGT_RING_PROBE; i++) {
+		idx = base + *head;
+		*head = (*head + 1) & (PGT_RING_SIZE - 1);
+		if (!pgt_samples[idx].live)
+			return idx;
+	}
+
+	return PGT_NONE;
+}
+
+void page_tracker_sample_alloc(struct page *page, int order)
+{
+	unsigned long entries[PGT_STACK_DEPTH];
+	struct stack_trace trace;
+	struct pgt_sample *s;
+	struct pgt_stack *st;
+	unsigned long flags;
+	unsigned int rate;
+	u32 hash, idx, b;
+
+	if (!READ_ONCE(pgt_ready))
+		return;
+
+	if (this_cpu_dec_return(pgt_countdown) > 0)
+		return;
+
+	rate = READ_ONCE(page_tracker_sample);
+	this_cpu_write(pgt_countdown, pgt_next_interval(rate));
+	if (!rate)
+		return;
+
+	trace.nr_entries = 0;
+	trace.max_entries = PGT_STACK_DEPTH;
+	trace.entries = entries;
+	trace.skip = PGT_STACK_SKIP;
+	save_stack_trace(&trace);
+	if (trace.nr_entries && entries[trace.nr_entries - 1] == ULONG_MAX)
+		trace.nr_entries--;
+	hash = jhash(entries, trace.nr_entries * sizeof(unsigned long), 0);
+
+	spin_lock_irqsave(&pgt_lock, flags);
+	idx = pgt_ring_claim(smp_processor_id());
+	if (idx == PGT_NONE) {
+		pgt_dropped++;
+		spin_unlock_irqrestore(&pgt_lock, flags);
+		return;
+	}
+
+	s = &pgt_samples[idx];
+	s->pfn = page_to_pfn(page);
+	s->ts = local_clock();
+	s->stack = pgt_stack_get(entries, trace.nr_entries, hash);
+	s->pid = in_interrupt() ? 0 : current->pid;
+	s->order = (u8)order;
+	s->live = 1;
+
+	b = hash_long(s->pfn, PGT_LIVE_BITS);
+	s->next = pgt_live_head[b];
+	WRITE_ONCE(pgt_live_head[b], idx);
+
+	st = &pgt_stacks[s->stack];
+	st->allocs++;
+	st->pages += 1UL << order;
+	st->live_pages += 1UL << order;
+	pgt_nr_live++;
+	spin_unlock_irqrestore(&pgt_lock, flags);
+}
+
+void page_tracker_sample_free(struct page *page, int order)
+{
+	struct pgt_sample *s;
+	unsigned long pfn, flags;
+	u32 *pp, b;
+
+	if (!READ_ONCE(pgt_ready))
+		return;
+
+	pfn = page_to_pfn(page);
+	b = hash_long(pfn, PGT_LIVE_BITS);
+	/* the common case: nothing sampled hashes here */
+	if (READ_ONCE(pgt_live_head[b]) == PGT_NONE)
+		return;
+
+	spin_lock_irqsave(&pgt_lock, flags);
+	for (pp = &pgt_live_head[b]; *pp != PGT_NONE; pp = &s->next) {
+		s = &pgt_samples[*pp];
+		if (s->pfn != pfn)
+			continue;
+
+		WRITE_ONCE(*pp, s->next);
+		pgt_stacks[s->stack].live_pages -= 1UL << s->order;
+		s->live = 0;
+		pgt_nr_live--;
+		break;
+	}
+	spin_unlock_irqrestore(&pgt_lock, flags);
+}
+
+static int pgt_stack_cmp(const void *a, const void *b)
+{
+	const struct pgt_stack *sa = a, *sb = b;
+
+	if (sa->live_pages != sb->live_pages)
+		return sa->live_pages < sb->live_pages ? 1 : -1;
+	if (sa->pages != sb->pages)
+		return sa->pages < sb->pages ? 1 : -1;
+	return 0;
+}
+
+static int pgt_top_show(struct seq_file *s, void *unused)
+{
+	unsigned int rate = READ_ONCE(page_tracker_sample);
+	unsigned long flags, nr_live, dropped;
+	struct pgt_stack *snap, *st;
+	u64 scale = (u64)(rate ? rate : 1) * PAGE_SIZE / 1024;
+	u32 used, i, j;
+
+	snap = vmalloc(PGT_STACK_POOL * sizeof(*snap));
+	if (!snap)
+		return -ENOMEM;
+
+	spin_lock_irqsave(&pgt_lock, flags);
+	used = pgt_stacks_used;
+	memcpy(snap, pgt_stacks, used * sizeof(*snap));
+	nr_live = pgt_nr_live;
+	dropped = pgt_dropped;
+	spin_unlock_irqrestore(&pgt_lock, flags);
+
+	/* keep the stack number of each record for the samples file */
+	for (i = 0; i < used; i++)
+		snap[i].hash = i;
+	sort(snap, used, sizeof(*snap), pgt_stack_cmp, NULL);
+
+	seq_printf(s, "sample rate 1/%u, live samples %lu, dropped %lu, stacks %u/%u\n",
+		   rate, nr_live, dropped, used, PGT_STACK_POOL);
+
+	for (i = 0; i < used && i < PGT_TOP_MAX; i++) {
+		st = &snap[i];
+		if (!st->pages)
+			break;
+
+		seq_printf(s, "\nstack %u: live ~%llu KB, allocated ~%llu KB, %u samples\n",
+			   st->hash, st->live_pages * scale, st->pages * scale,
+			   st->allocs);
+		if (!st->hash)
+			seq_puts(s, "  <stack pool full>\n");
+		for (j = 0; j < st->nr_entries; j++)
+			seq_printf(s, "  %pS\n", (void *)st->entries[j]);
+	}
+
+	vfree(snap);
+	return 0;
+}
+
+static int pgt_samples_show(struct seq_file *s, void *unused)
+{
+	u32 nr = nr_cpu_ids * PGT_RING_SIZE;
+	struct pgt_sample *snap;
+	unsigned long flags;
+	u64 now = local_clock();
+	u32 i, n = 0;
+
+	snap = vmalloc(nr * sizeof(*snap));
+	if (!snap)
+		return -ENOMEM;
+
+	spin_lock_irqsave(&pgt_lock, flags);
+	for (i = 0; i < nr; i++) {
+		if (pgt_samples[i].live)
+			snap[n++] = pgt_samples[i];
+	}
+	spin_unlock_irqrestore(&pgt_lock, flags);
+
+	seq_puts(s, "     pfn order   pid   age(ms) stack\n");
+	for (i = 0; i < n; i++)
+		seq_printf(s, "%8lx %5u %5d %9llu %5u\n", snap[i].pfn,
+			   snap[i].order, snap[i].pid,
+			   div_u64(now - snap[i].ts, NSEC_PER_MSEC),
+			   snap[i].stack);
+
+	vfree(snap);
+	return 0;
+}
+
+static int pgt_top_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, pgt_top_show, NULL);
+}
+
+static int pgt_samples_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, pgt_samples_show, NULL);
+}
+
+static const struct file_operations pgt_top_fops = {
+	.open = pgt_top_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static const struct file_operations pgt_samples_fops = {
+	.open = pgt_samples_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int __init page_sampler_init(void)
+{
+	struct dentry *dir;
+	int cpu;
+
+	if (!page_tracker_sample)
+		return 0;
+
+	pgt_samples = vzalloc(nr_cpu_ids * PGT_RING_SIZE * sizeof(*pgt_samples));
+	pgt_stacks = vzalloc(PGT_STACK_POOL * sizeof(*pgt_stacks));
+	if (!pgt_samples || !pgt_stacks) {
+		pr_err("page sampler: no memory for %u cpus\n", nr_cpu_ids);
+		goto err;
+	}
+
+	dir = debugfs_create_dir("page_tracker", NULL);
+	if (!dir)
+		goto err;
+	debugfs_create_file("top", 0400, dir, NULL, &pgt_top_fops);
+	debugfs_create_file("samples", 0400, dir, NULL, &pgt_samples_fops);
+	debugfs_create_u32("rate", 0600, dir, &page_tracker_sample);
+
+	memset(pgt_stack_head, 0xff, sizeof(pgt_stack_head));
+	memset(pgt_live_head, 0xff, sizeof(pgt_live_head));
+	pgt_stacks_used = 1;
+	for_each_possible_cpu(cpu)
+		per_cpu(pgt_countdown, cpu) = pgt_next_interval(page_tracker_sample);
+
+	smp_wmb();
+	WRITE_ONCE(pgt_ready, true);
+	pr_info("page sampler: tracking 1/%u page allocations\n",
+		page_tracker_sample);
+
+	return 0;
+err:
+	vfree(pgt_stacks);
+	vfree(pgt_samples);
+	pgt_stacks = NULL;
+	pgt_samples = NULL;
+	return -ENOMEM;
+}
+late_initcall(page_sampler_init);
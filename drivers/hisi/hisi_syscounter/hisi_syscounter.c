@@ -9,7 +9,9 @@
 #include <linux/device.h>
 #include <linux/io.h>
 #include <linux/module.h>
+#include <linux/clocksource.h>
 #include <asm/arch_timer.h>
+#include <clocksource/arm_arch_timer.h>
 #include <linux/hisi/hisi_syscounter.h>
 #include <linux/syscore_ops.h>
 #include <linux/workqueue.h>
@@ -18,6 +20,11 @@
 
 static struct syscnt_device *syscnt_dev;
 
+struct hisi_ts_param hisi_ts_param;
+EXPORT_SYMBOL(hisi_ts_param);
+
+#define HISI_TS_PAIR_TRIES	4
+
 int syscounter_to_timespec64(u64 syscnt, struct timespec64 *ts)
 {
 	struct syscnt_device *dev = syscnt_dev;
@@ -99,6 +106,82 @@ int hisi_get_timecounter(unsigned long *lastcycle, struct timespec *ts)
 EXPORT_SYMBOL(hisi_get_timecounter);
 
 
+static u64 hisi_ts_scale(u64 cnt)
+{
+	struct hisi_ts_param *p = &hisi_ts_param;
+
+	if (p->syscnt_rate == p->cnt_rate || !p->cnt_rate)
+		return cnt;
+	return mult_frac(cnt, p->syscnt_rate, p->cnt_rate);
+}
+
+u64 hisi_ts_to_syscount(u64 cnt)
+{
+	return hisi_ts_scale(cnt) + ACCESS_ONCE(hisi_ts_param.syscnt_offset);
+}
+EXPORT_SYMBOL(hisi_ts_to_syscount);
+
+/*
+ * Pair an arch counter value with a syscounter read. The MMIO read sits
+ * between two counter reads and the tightest of a few tries is kept, its
+ * midpoint being the arch counter value the syscounter was latched at.
+ */
+static void hisi_ts_pair(void)
+{
+	u64 before, after, syscnt, best = U64_MAX;
+	s64 offset = 0;
+	unsigned long flags;
+	int i;
+
+	for (i = 0; i < HISI_TS_PAIR_TRIES; i++) {
+		local_irq_save(flags);
+		before = arch_counter_get_cntvct();
+		syscnt = hisi_get_syscount();
+		after = arch_counter_get_cntvct();
+		local_irq_restore(flags);
+
+		if (after - before < best) {
+			best = after - before;
+			offset = (s64)(syscnt -
+				       hisi_ts_scale(before + (after - before) / 2));
+		}
+	}
+	ACCESS_ONCE(hisi_ts_param.syscnt_offset) = offset;
+}
+
+static ssize_t cnt_rate_show(struct device *dev,
+			     struct device_attribute *attr, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%llu\n", hisi_ts_param.cnt_rate);
+}
+static DEVICE_ATTR_RO(cnt_rate);
+
+static ssize_t syscnt_rate_show(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%llu\n", hisi_ts_param.syscnt_rate);
+}
+static DEVICE_ATTR_RO(syscnt_rate);
+
+static ssize_t syscnt_offset_show(struct device *dev,
+				  struct device_attribute *attr, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%lld\n",
+			ACCESS_ONCE(hisi_ts_param.syscnt_offset));
+}
+static DEVICE_ATTR_RO(syscnt_offset);
+
+static struct attribute *hisi_ts_attrs[] = {
+	&dev_attr_cnt_rate.attr,
+	&dev_attr_syscnt_rate.attr,
+	&dev_attr_syscnt_offset.attr,
+	NULL,
+};
+
+static const struct attribute_group hisi_ts_group = {
+	.attrs = hisi_ts_attrs,
+};
+
 #if RECORD_NEED_SYNC_PERIOD
 static void hisi_syscounter_sync_work(struct work_struct *work)
 {
@@ -157,6 +240,8 @@ static void hisi_syscounter_resume(void)
 	d->record.syscnt = hisi_get_syscount();
 	spin_unlock_irqrestore(&d->sync_lock, flags);
 
+	hisi_ts_pair();
+
 #if RECORD_NEED_SYNC_PERIOD
 	schedule_delayed_work(&d->sync_record_work, round_jiffies_relative(msecs_to_jiffies(d->sync_interval)));
 #endif
@@ -223,6 +308,11 @@ static int hisi_syscounter_probe(struct platform_device *pdev)
 	d->record.syscnt = hisi_get_syscount();
 	spin_unlock_irqrestore(&d->sync_lock, flags);
 
+	hisi_ts_param.syscnt_rate = d->clock_rate;
+	hisi_ts_pair();
+	if (sysfs_create_group(&dev->kobj, &hisi_ts_group))
+		dev_warn(dev, "timestamp parameters not exported\n");
+
 	platform_set_drvdata(pdev, d);
 	register_syscore_ops(&hisi_syscounter_syscore_ops);
 
@@ -244,6 +334,7 @@ err_probe:
 
 static int hisi_syscounter_remove(struct platform_device *pdev)
 {
+	sysfs_remove_group(&pdev->dev.kobj, &hisi_ts_group);
 	unregister_syscore_ops(&hisi_syscounter_syscore_ops);
 	if (syscnt_dev) {
 		iounmap(syscnt_dev->base);
@@ -270,6 +361,15 @@ static struct platform_driver hisi_syscounter_driver = {
 
 static int __init hisi_syscounter_init(void)
 {
+	u32 rate = arch_timer_get_rate();
+
+	/* hisi_ts_delta_ns() works without the syscounter device */
+	if (rate) {
+		hisi_ts_param.cnt_rate = rate;
+		clocks_calc_mult_shift(&hisi_ts_param.mult, &hisi_ts_param.shift,
+				       rate, NSEC_PER_SEC, HISI_TS_MAX_DELTA_SEC);
+	}
+
 	return platform_driver_register(&hisi_syscounter_driver);
 }
 
@@ -21,6 +21,8 @@
 #include <linux/sysfs.h>
 #include <linux/spinlock.h>
 #include <linux/mutex.h>
+#include <linux/workqueue.h>
+#include <linux/hisi/hisi_hmpth.h>
 #include <trace/events/sched.h>
 #include "hmpth_main.h"
 
@@ -31,6 +33,8 @@ static unsigned int hmpset_enable = 0;
 
 static spinlock_t hmpset_lock;
 
+static struct hmpth_frame_ctrl frame_ctrl;
+
 #define debug_hmp_policy_struct(n, t) {}
 
 
@@ -50,6 +54,22 @@ static void set_hmp_thresholds(unsigned int tsh_up, unsigned int tsh_down)
 	return;
 }
 
+/*
+ * lower the thresholds by the offset the frame feedback asks for,
+ * the up threshold stays above FRAME_CTRL_MIN_UP.
+ */
+static void frame_ctrl_apply(unsigned int *up_value, unsigned int *down_value)
+{
+	unsigned int offset = READ_ONCE(frame_ctrl.offset);
+
+	if (!offset || (*up_value <= FRAME_CTRL_MIN_UP))
+		return;
+
+	offset = min(offset, *up_value - FRAME_CTRL_MIN_UP);
+	*up_value -= offset;
+	*down_value -= min(offset, *down_value);
+}
+
 static void calc_thresholds(void)
 {
 	int cntpc = 0;
@@ -105,6 +125,13 @@ static void calc_thresholds(void)
 		down_value = up_value - 100;
 	}
 
+	/*
+	 * default and performance policies follow the frame feedback,
+	 * a security policy (thermal, eg.) is kept as it is.
+	 */
+	if (priority < PRIOR_4)
+		frame_ctrl_apply(&up_value, &down_value);
+
 	set_hmp_thresholds(up_value, down_value);
 	return;
 }
@@ -297,6 +324,70 @@ err_input:
 
 }
 
+static void frame_ctrl_work(struct work_struct *work)
+{
+	spin_lock_bh(&hmpset_lock);
+	if (hmpset_enable && (strlen(pri_hmp_policy[0].name) > 0))
+		calc_thresholds();
+	spin_unlock_bh(&hmpset_lock);
+}
+
+/*
+ * this func is called by the display driver for every frame
+ * committed to the primary panel.
+ */
+void hmpth_frame_done(u64 vsync_ns, u64 done_ns, u32 period_ns)
+{
+	unsigned long flags;
+	bool changed = false;
+	u64 gap;
+
+	if (!READ_ONCE(frame_ctrl.enable) || !period_ns)
+		return;
+
+	spin_lock_irqsave(&frame_ctrl.lock, flags);
+	gap = done_ns - frame_ctrl.last_done_ns;
+	/* the first frame after idle content has nothing to compare with */
+	if (!frame_ctrl.last_done_ns
+		|| (gap > (u64)period_ns * FRAME_CTRL_IDLE_PERIODS))
+		goto out;
+
+	frame_ctrl.frames++;
+	if (gap > (u64)period_ns * 3 / 2)
+		frame_ctrl.misses++;
+	else if ((done_ns > vsync_ns)
+		&& ((done_ns - vsync_ns) > (u64)period_ns * 3 / 4))
+		frame_ctrl.tight++;
+
+	if (frame_ctrl.frames < FRAME_CTRL_WINDOW)
+		goto out;
+
+	if (frame_ctrl.misses * 100 > FRAME_CTRL_MISS_PCT * frame_ctrl.frames) {
+		if (frame_ctrl.offset + FRAME_CTRL_STEP
+			<= MAX_THRESHOLDS - FRAME_CTRL_MIN_UP) {
+			frame_ctrl.offset += FRAME_CTRL_STEP;
+			changed = true;
+		}
+	} else if (!frame_ctrl.misses && !frame_ctrl.tight
+		&& frame_ctrl.offset) {
+		frame_ctrl.offset -= min_t(unsigned int,
+			frame_ctrl.offset, FRAME_CTRL_STEP);
+		changed = true;
+	}
+
+	frame_ctrl.total_frames += frame_ctrl.frames;
+	frame_ctrl.total_misses += frame_ctrl.misses;
+	frame_ctrl.frames = 0;
+	frame_ctrl.misses = 0;
+	frame_ctrl.tight = 0;
+out:
+	frame_ctrl.last_done_ns = done_ns;
+	spin_unlock_irqrestore(&frame_ctrl.lock, flags);
+
+	if (changed)
+		schedule_work(&frame_ctrl.work);
+}
+
 /*lint -e715 -esym(715,*)*/
 static ssize_t policy_show(struct kobject *kobj,
 		struct kobj_attribute *attr, char *buf)
@@ -450,11 +541,71 @@ static struct kobj_attribute enable_attr = {
 	.show   = enable_show,
 	.store  = enable_store,
 };
+
+static ssize_t frame_ctrl_show(struct kobject *kobj,
+		struct kobj_attribute *attr, char *buf)
+{
+	return snprintf(buf, (unsigned long)16, "%u\n", frame_ctrl.enable);
+}
+
+static ssize_t frame_ctrl_store(struct kobject *kobj,
+	struct kobj_attribute *attr, const char *buf, size_t n)
+{
+	unsigned long flags;
+	unsigned int input;
+
+	if (sscanf(buf, "%u", &input) != 1 || input > 1)
+		return -EINVAL;
+
+	spin_lock_irqsave(&frame_ctrl.lock, flags);
+	if (frame_ctrl.enable != input) {
+		frame_ctrl.enable = input;
+		frame_ctrl.offset = 0;
+		frame_ctrl.last_done_ns = 0;
+		frame_ctrl.frames = 0;
+		frame_ctrl.misses = 0;
+		frame_ctrl.tight = 0;
+		frame_ctrl.total_frames = 0;
+		frame_ctrl.total_misses = 0;
+	}
+	spin_unlock_irqrestore(&frame_ctrl.lock, flags);
+	/* drop an offset left from before */
+	schedule_work(&frame_ctrl.work);
+
+	return (int)n;
+}
+
+static struct kobj_attribute frame_ctrl_attr = {
+	.attr   = {
+		.name = "frame_ctrl",
+		.mode = 0644,
+	},
+	.show   = frame_ctrl_show,
+	.store  = frame_ctrl_store,
+};
+
+static ssize_t frame_ctrl_stat_show(struct kobject *kobj,
+		struct kobj_attribute *attr, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "offset %u frames %lu misses %lu\n",
+		READ_ONCE(frame_ctrl.offset), frame_ctrl.total_frames,
+		frame_ctrl.total_misses);
+}
+
+static struct kobj_attribute frame_ctrl_stat_attr = {
+	.attr   = {
+		.name = "frame_ctrl_stat",
+		.mode = 0444,
+	},
+	.show   = frame_ctrl_stat_show,
+};
 /*lint -e715 +esym(715,*)*/
 
 static struct attribute *attrs[] = {
 	&enable_attr.attr,
 	&policy_attr.attr,
+	&frame_ctrl_attr.attr,
+	&frame_ctrl_stat_attr.attr,
 	NULL
 };
 
@@ -491,6 +642,10 @@ static int create_sysfs_node(void)
 static int __init hmpth_init(void)
 {
 	int ret;
+
+	spin_lock_init(&frame_ctrl.lock);
+	INIT_WORK(&frame_ctrl.work, frame_ctrl_work);
+
 	/*
 	 * init sysfs_node
 	 */
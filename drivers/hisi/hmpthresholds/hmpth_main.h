@@ -11,6 +11,8 @@
 #define __HMPTH_MAIN_H_
 
 #include <linux/types.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
 
 
 #define MAX_MUM_POLICY 16
@@ -45,6 +47,19 @@ enum policy_state_num {
 #define DEFAULT_POLICY_NAME "default"
 
 #define UP_MUST_BIG_THAN_DOWN 100
+
+/*
+ * frame controller: every FRAME_CTRL_WINDOW frames the thresholds are
+ * lowered by FRAME_CTRL_STEP if more than FRAME_CTRL_MISS_PCT percent of
+ * the frames missed their vsync, and raised back by FRAME_CTRL_STEP if no
+ * frame missed or was committed in the last quarter of its period.
+ * a gap above FRAME_CTRL_IDLE_PERIODS periods is idle content, not a miss.
+ */
+#define FRAME_CTRL_WINDOW 32
+#define FRAME_CTRL_STEP 32
+#define FRAME_CTRL_MISS_PCT 3
+#define FRAME_CTRL_IDLE_PERIODS 4
+#define FRAME_CTRL_MIN_UP 256
 /*
  * name: the client's name which want to set policy.
  *       (applica, tempera, cpuidle, cpufreq,eg.)
@@ -67,6 +82,26 @@ struct hmp_policy_struct {
 	int prior_direct;
 };
 
+/*
+ * enable: 1 when frame feedback adjusts the thresholds.
+ * offset: how much the policy thresholds are lowered now.
+ * last_done_ns: commit time of the previous frame.
+ * frames, misses, tight: counts in the current window.
+ * total_frames, total_misses: counts since enabled.
+ */
+struct hmpth_frame_ctrl {
+	spinlock_t lock;
+	struct work_struct work;
+	unsigned int enable;
+	unsigned int offset;
+	u64 last_done_ns;
+	unsigned int frames;
+	unsigned int misses;
+	unsigned int tight;
+	unsigned long total_frames;
+	unsigned long total_misses;
+};
+
 /* is lowercase character*/
 static inline int islowchac(int ch)
 {
@@ -19,6 +19,7 @@
 #include <linux/interrupt.h>
 #include <linux/cpu.h>
 #include <linux/slab.h>
+#include <linux/hisi/hisi_irq_affinity.h>
 #include <asm/irq.h>
 
 #define MODULE_NAME "[HISI IRQ AFFINITY]"
@@ -91,6 +92,12 @@ static struct irq_affinity_info *is_registered_irq(unsigned int irq)
 	return gotten ? p : NULL;
 }
 
+/* pinned irqs are not touched by the balancer */
+bool hisi_irqaffinity_is_pinned(unsigned int irq)
+{
+	return is_registered_irq(irq) != NULL;
+}
+
 int hisi_irqaffinity_register(unsigned int irq, int cpu)
 {
 	struct irq_affinity_info *p = NULL;
@@ -12,6 +12,7 @@
 #include <linux/init.h>
 #include <linux/debugfs.h>
 #include <linux/uaccess.h>
+#include <linux/cpumask.h>
 #include <linux/hisi/hisi_irq_affinity.h>
 
 #define MODULE_NAME "IRQAFF DEBUGFS"
@@ -23,6 +24,7 @@ static struct dentry *irqaff_debug_fn;
 static int irqaff_debugfs_show(struct seq_file *s, void *data)
 {
 	hisi_irqaffinity_status();
+	hisi_irqbalance_show(s);
 	return 0;
 }
 
@@ -95,6 +97,34 @@ irqaff_debugfs_write(struct file *filp, const char __user *ubuf,
 		}
 
 		hisi_irqaffinity_unregister(irq);
+	} else if (!strncmp("hint ", _cmd, strlen("hint "))) {
+		char hint[16];
+		enum hisi_irq_hint h;
+
+		if (sscanf(_cmd + strlen("hint "), "%u %15s", &irq, hint) != 2) {
+			cnt = -EINVAL;
+			goto out;
+		}
+
+		if (!strcmp(hint, "latency"))
+			h = HISI_IRQ_HINT_LATENCY;
+		else if (!strcmp(hint, "throughput"))
+			h = HISI_IRQ_HINT_THROUGHPUT;
+		else if (!strcmp(hint, "none"))
+			h = HISI_IRQ_HINT_NONE;
+		else {
+			cnt = -EINVAL;
+			goto out;
+		}
+
+		if (hisi_irqaffinity_set_hint(irq, h))
+			cnt = -EINVAL;
+	} else if (!strncmp("latency_cpus ", _cmd, strlen("latency_cpus "))) {
+		struct cpumask mask;
+
+		if (cpulist_parse(_cmd + strlen("latency_cpus "), &mask) ||
+		    hisi_irqbalance_set_latency_cpus(&mask))
+			cnt = -EINVAL;
 	} else {
 		cnt = -EINVAL;
 		goto out;
@@ -117,7 +147,7 @@ static int __init irqaff_debugfs_init(void)
 	irqaff_debug_dir = debugfs_create_dir("hisi_irqaff_debug", NULL);
 	if (irqaff_debug_dir)
 		irqaff_debug_fn = debugfs_create_file("debug",
-						      S_IRUGO, irqaff_debug_dir,
+						      S_IRUGO | S_IWUSR, irqaff_debug_dir,
 						      NULL,
 						      &irqaff_debugfs_fops);
 
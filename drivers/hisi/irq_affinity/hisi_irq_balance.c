@@ -0,0 +1,342 @@
+/*
+ * Dynamic irq balancing for hisi platforms.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Drivers hint their irqs through hisi_irqaffinity_set_hint() instead of
+ * pinning them to a fixed cpu. Once a period the balancer reads the hard
+ * irq handler time of every hinted irq (irq_handler_entry/exit probes)
+ * and the busy and irq/softirq time of every cpu, then places:
+ *  - latency irqs (vsync, touch) on the least loaded of the latency cpus,
+ *  - throughput irqs (storage, wifi) on the least loaded other cpus,
+ * moving an irq only when that frees a noticeable share of a cpu. Irqs
+ * pinned with hisi_irqaffinity_register() are left alone.
+ */
+
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/cpu.h>
+#include <linux/cpumask.h>
+#include <linux/interrupt.h>
+#include <linux/irq.h>
+#include <linux/kernel_stat.h>
+#include <linux/mutex.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/tick.h>
+#include <linux/topology.h>
+#include <linux/workqueue.h>
+#include <linux/hisi/hisi_irq_affinity.h>
+#include <trace/events/irq.h>
+
+#define MODULE_NAME "[HISI IRQ BALANCE]"
+
+#define IRQBAL_PERIOD_MS	1000
+#define IRQBAL_MIN_GAIN_PCT	10	/* share of a cpu a move must free */
+#define IRQBAL_MAX_MOVES	2	/* per period */
+
+struct irqbal_irq {
+	struct list_head node;
+	unsigned int irq;
+	enum hisi_irq_hint hint;
+	int cpu;
+	u64 last_ns;
+	u64 load_ns;		/* handler time in the last period */
+};
+
+struct irqbal_cpu {
+	u64 last_idle_us;
+	u64 last_irq_ns;
+	u64 busy_ns;		/* last period */
+	u64 irq_ns;		/* last period, hard and soft irq */
+};
+
+static LIST_HEAD(irqbal_list);
+static DEFINE_MUTEX(irqbal_mutex);
+static unsigned long *irqbal_tracked;	/* by irq, tested by the probes */
+static atomic64_t *irqbal_time;		/* handler ns by irq */
+static DEFINE_PER_CPU(u64, irqbal_entry);
+static DEFINE_PER_CPU(struct irqbal_cpu, irqbal_cpu);
+static struct cpumask irqbal_latency_cpus;
+static struct delayed_work irqbal_work;
+static u64 irqbal_last_run;
+static unsigned long irqbal_moves;
+
+static void irqbal_entry_probe(void *data, int irq, struct irqaction *action)
+{
+	if ((unsigned int)irq < nr_irqs && test_bit(irq, irqbal_tracked))
+		__this_cpu_write(irqbal_entry, local_clock());
+}
+
+static void irqbal_exit_probe(void *data, int irq, struct irqaction *action,
+			      int ret)
+{
+	if ((unsigned int)irq < nr_irqs && test_bit(irq, irqbal_tracked))
+		atomic64_add(local_clock() - __this_cpu_read(irqbal_entry),
+			     &irqbal_time[irq]);
+}
+
+static int irqbal_current_cpu(unsigned int irq)
+{
+	struct irq_data *d = irq_get_irq_data(irq);
+	int cpu;
+
+	if (!d)
+		return 0;
+
+	cpu = cpumask_first_and(d->affinity, cpu_online_mask);
+	return (cpu < nr_cpu_ids) ? cpu : 0;
+}
+
+static void irqbal_sample_cpus(u64 period_ns)
+{
+	struct irqbal_cpu *c;
+	u64 idle_us, irq_ns, idle_ns;
+	int cpu;
+
+	for_each_online_cpu(cpu) {
+		c = &per_cpu(irqbal_cpu, cpu);
+
+		idle_us = get_cpu_idle_time_us(cpu, NULL);
+		if (idle_us == (u64)-1)
+			idle_us = div_u64(cputime_to_nsecs(
+					kcpustat_cpu(cpu).cpustat[CPUTIME_IDLE]),
+					NSEC_PER_USEC);
+		irq_ns = cputime_to_nsecs(kcpustat_cpu(cpu).cpustat[CPUTIME_IRQ] +
+				kcpustat_cpu(cpu).cpustat[CPUTIME_SOFTIRQ]);
+
+		idle_ns = (idle_us - c->last_idle_us) * NSEC_PER_USEC;
+		c->busy_ns = (idle_ns < period_ns) ? period_ns - idle_ns : 0;
+		c->irq_ns = irq_ns - c->last_irq_ns;
+		c->last_idle_us = idle_us;
+		c->last_irq_ns = irq_ns;
+	}
+}
+
+static void irqbal_candidates(enum hisi_irq_hint hint, struct cpumask *mask)
+{
+	if (hint == HISI_IRQ_HINT_LATENCY)
+		cpumask_and(mask, &irqbal_latency_cpus, cpu_online_mask);
+	else
+		cpumask_andnot(mask, cpu_online_mask, &irqbal_latency_cpus);
+
+	if (cpumask_empty(mask))
+		cpumask_copy(mask, cpu_online_mask);
+}
+
+static void irqbal_balance(struct work_struct *work)
+{
+	u64 score[NR_CPUS];
+	struct cpumask mask;
+	struct irqbal_irq *p, *pick;
+	u64 now = local_clock();
+	u64 period_ns = now - irqbal_last_run;
+	u64 min_gain = div_u64(period_ns * IRQBAL_MIN_GAIN_PCT, 100);
+	u64 time;
+	int cpu, best, moves = 0;
+	LIST_HEAD(done);
+
+	mutex_lock(&irqbal_mutex);
+	get_online_cpus();
+
+	irqbal_last_run = now;
+	irqbal_sample_cpus(period_ns);
+
+	/* cpu load without the hinted irqs, they are placed below */
+	for_each_online_cpu(cpu) {
+		struct irqbal_cpu *c = &per_cpu(irqbal_cpu, cpu);
+
+		score[cpu] = c->busy_ns + c->irq_ns;
+	}
+	list_for_each_entry(p, &irqbal_list, node) {
+		time = atomic64_read(&irqbal_time[p->irq]);
+		p->load_ns = time - p->last_ns;
+		p->last_ns = time;
+		p->cpu = irqbal_current_cpu(p->irq);
+		score[p->cpu] -= min(score[p->cpu], p->load_ns);
+	}
+
+	/* heaviest irq first, each onto the least loaded candidate */
+	while (!list_empty(&irqbal_list)) {
+		pick = list_first_entry(&irqbal_list, struct irqbal_irq, node);
+		list_for_each_entry(p, &irqbal_list, node) {
+			if (p->load_ns > pick->load_ns)
+				pick = p;
+		}
+		list_move_tail(&pick->node, &done);
+
+		if (hisi_irqaffinity_is_pinned(pick->irq))
+			continue;
+
+		irqbal_candidates(pick->hint, &mask);
+		best = cpumask_first(&mask);
+		for_each_cpu(cpu, &mask) {
+			if (score[cpu] < score[best])
+				best = cpu;
+		}
+
+		/* stay unless the move is worth it, or we left the candidates */
+		if (cpumask_test_cpu(pick->cpu, &mask) &&
+		    (best == pick->cpu || moves >= IRQBAL_MAX_MOVES ||
+		     score[pick->cpu] < score[best] + min_gain))
+			best = pick->cpu;
+
+		if (best != pick->cpu &&
+		    !irq_set_affinity(pick->irq, cpumask_of(best))) {
+			pick->cpu = best;
+			moves++;
+			irqbal_moves++;
+		}
+		score[pick->cpu] += pick->load_ns;
+	}
+	list_splice(&done, &irqbal_list);
+
+	put_online_cpus();
+
+	if (!list_empty(&irqbal_list))
+		schedule_delayed_work(&irqbal_work,
+				      msecs_to_jiffies(IRQBAL_PERIOD_MS));
+	mutex_unlock(&irqbal_mutex);
+}
+
+/*
+ * hisi_irqaffinity_set_hint - let the balancer place an irq
+ * @irq: the irq
+ * @hint: HISI_IRQ_HINT_LATENCY or HISI_IRQ_HINT_THROUGHPUT, or
+ *        HISI_IRQ_HINT_NONE to hand the irq back
+ */
+int hisi_irqaffinity_set_hint(unsigned int irq, enum hisi_irq_hint hint)
+{
+	struct irqbal_irq *p, *found = NULL;
+	int ret = 0;
+
+	if (!irqbal_time)
+		return -EAGAIN;
+	if (irq >= nr_irqs || hint > HISI_IRQ_HINT_THROUGHPUT)
+		return -EINVAL;
+
+	mutex_lock(&irqbal_mutex);
+	list_for_each_entry(p, &irqbal_list, node) {
+		if (p->irq == irq) {
+			found = p;
+			break;
+		}
+	}
+
+	if (hint == HISI_IRQ_HINT_NONE) {
+		if (found) {
+			clear_bit(irq, irqbal_tracked);
+			list_del(&found->node);
+			kfree(found);
+		}
+		goto out;
+	}
+
+	if (!found) {
+		found = kzalloc(sizeof(*found), GFP_KERNEL);
+		if (!found) {
+			ret = -ENOMEM;
+			goto out;
+		}
+		found->irq = irq;
+		found->last_ns = atomic64_read(&irqbal_time[irq]);
+		found->cpu = irqbal_current_cpu(irq);
+		if (list_empty(&irqbal_list)) {
+			irqbal_last_run = local_clock();
+			irqbal_sample_cpus(0);
+			schedule_delayed_work(&irqbal_work,
+					      msecs_to_jiffies(IRQBAL_PERIOD_MS));
+		}
+		list_add_tail(&found->node, &irqbal_list);
+		set_bit(irq, irqbal_tracked);
+	}
+	found->hint = hint;
+	pr_info(MODULE_NAME " irq-%u hinted %s\n", irq,
+		(hint == HISI_IRQ_HINT_LATENCY) ? "latency" : "throughput");
+out:
+	mutex_unlock(&irqbal_mutex);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(hisi_irqaffinity_set_hint);
+
+int hisi_irqbalance_set_latency_cpus(const struct cpumask *mask)
+{
+	if (cpumask_empty(mask))
+		return -EINVAL;
+
+	mutex_lock(&irqbal_mutex);
+	cpumask_copy(&irqbal_latency_cpus, mask);
+	mutex_unlock(&irqbal_mutex);
+
+	return 0;
+}
+
+void hisi_irqbalance_show(struct seq_file *s)
+{
+	struct irqbal_irq *p;
+	int cpu;
+
+	mutex_lock(&irqbal_mutex);
+	seq_printf(s, "latency cpus: %*pbl, moves: %lu\n",
+		   cpumask_pr_args(&irqbal_latency_cpus), irqbal_moves);
+	for_each_online_cpu(cpu) {
+		struct irqbal_cpu *c = &per_cpu(irqbal_cpu, cpu);
+
+		seq_printf(s, "cpu-%d busy %llu us irq %llu us\n", cpu,
+			   div_u64(c->busy_ns, NSEC_PER_USEC),
+			   div_u64(c->irq_ns, NSEC_PER_USEC));
+	}
+	list_for_each_entry(p, &irqbal_list, node)
+		seq_printf(s, "irq-%03u %-10s cpu-%d %llu us%s\n", p->irq,
+			   (p->hint == HISI_IRQ_HINT_LATENCY) ?
+			   "latency" : "throughput", p->cpu,
+			   div_u64(p->load_ns, NSEC_PER_USEC),
+			   hisi_irqaffinity_is_pinned(p->irq) ? " (pinned)" : "");
+	mutex_unlock(&irqbal_mutex);
+}
+
+static int __init hisi_irqbalance_init(void)
+{
+	int ret;
+
+	irqbal_tracked = kcalloc(BITS_TO_LONGS(nr_irqs), sizeof(long),
+				 GFP_KERNEL);
+	irqbal_time = kcalloc(nr_irqs, sizeof(atomic64_t), GFP_KERNEL);
+	if (!irqbal_tracked || !irqbal_time) {
+		ret = -ENOMEM;
+		goto err;
+	}
+
+	/* default: the first cluster minus cpu-0, which takes everything else */
+	cpumask_copy(&irqbal_latency_cpus, topology_core_cpumask(0));
+	cpumask_clear_cpu(0, &irqbal_latency_cpus);
+	if (cpumask_empty(&irqbal_latency_cpus))
+		cpumask_set_cpu(0, &irqbal_latency_cpus);
+
+	INIT_DEFERRABLE_WORK(&irqbal_work, irqbal_balance);
+
+	ret = register_trace_irq_handler_entry(irqbal_entry_probe, NULL);
+	if (ret)
+		goto err;
+	ret = register_trace_irq_handler_exit(irqbal_exit_probe, NULL);
+	if (ret) {
+		unregister_trace_irq_handler_entry(irqbal_entry_probe, NULL);
+		goto err;
+	}
+
+	return 0;
+err:
+	pr_err(MODULE_NAME " init failed %d\n", ret);
+	kfree(irqbal_time);
+	kfree(irqbal_tracked);
+	irqbal_time = NULL;
+	irqbal_tracked = NULL;
+	return ret;
+}
+
+arch_initcall(hisi_irqbalance_init);
+
+MODULE_DESCRIPTION("Dynamic irq balancing for hisi platforms.");
+MODULE_LICENSE("GPL V2");
@@ -10,6 +10,11 @@
 #include <linux/syscalls.h>
 #include <linux/unistd.h>
 #include <linux/mutex.h>
+#include <linux/workqueue.h>
+#include <linux/completion.h>
+#include <linux/ktime.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include <linux/hisi/hisi_rproc.h>
 #include <linux/hisi/hifidrvinterface.h>
 #include "device_tree.h"
@@ -29,6 +34,41 @@ typedef enum SVC_SECBOOT_CMD_ID SECBOOT_CMD_TYPE;
 static struct mutex load_image_lock;
 #define DEVICE_PATH  "/dev/block/bootdevice/by-name/"
 
+/*
+ * An image is streamed from its partition through two 1M buffers: the
+ * next chunk is read by a worker while the secure OS copies the current
+ * one. The buffers belong to the load, so images of different cores load
+ * in parallel. When they cannot be allocated the load falls back to the
+ * static SECBOOT_BUFFER, one chunk at a time under load_image_lock.
+ */
+struct load_stream {
+	struct file *fp;
+	u8 *buf[2];
+	struct work_struct read_work;
+	struct completion read_done;
+	bool read_pending;
+	void *read_buf;
+	loff_t read_pos;
+	u32 read_len;
+	s32 read_ret;
+	u64 read_wait_us;
+	u64 tee_us;
+};
+
+struct load_image_stat {
+	char name[PART_NAMELEN];
+	u32 loads;
+	u32 failed;
+	u32 bytes;
+	u32 total_ms;
+	u32 read_wait_ms;
+	u32 tee_ms;
+	bool pipelined;
+};
+
+static struct load_image_stat load_image_stats[SOC_MAX];
+static DEFINE_SPINLOCK(load_image_stat_lock);
+
 /*
  * Function name:TEEK_init.
  * Discription:Init the TEEC and get the context
@@ -353,6 +393,109 @@ error:
 
 }
 
+static struct file *load_stream_open(const char *partion_name)
+{
+	char *pathname;
+	unsigned long pathlen;
+	struct file *fp;
+
+	pathlen = sizeof(DEVICE_PATH) + strnlen(partion_name, (unsigned long)PART_NAMELEN);
+	pathname = kmalloc(pathlen, GFP_KERNEL);
+	if (!pathname)
+		return ERR_PTR(-ENOMEM);
+
+	if (flash_find_ptn(partion_name, pathname) < 0) {
+		sec_print_err("partion_name(%s) is not in partion table!\n", partion_name);
+		kfree(pathname);
+		return ERR_PTR(-ENOENT);
+	}
+
+	fp = filp_open(pathname, O_RDONLY, 0600);
+	if (IS_ERR(fp))
+		sec_print_err("filp_open(%s) failed", pathname);
+	else
+		/* let one vfs_read() issue the whole chunk at once */
+		fp->f_ra.ra_pages = max_t(unsigned int, fp->f_ra.ra_pages,
+					  SECBOOT_BUFLEN >> PAGE_SHIFT);
+	kfree(pathname);
+	return fp;
+}
+
+static s32 load_stream_read(struct file *fp, void *buf, loff_t pos, u32 len)
+{
+	mm_segment_t fs;
+	ssize_t ret;
+
+	fs = get_fs();
+	set_fs(KERNEL_DS);
+	ret = vfs_read(fp, (char __user *)buf, len, &pos);
+	set_fs(fs);
+	if (ret != len) {
+		sec_print_err("read ops failed, ret=%zd(len=%u)", ret, len);
+		return SEC_ERROR;
+	}
+	return SEC_OK;
+}
+
+static void load_stream_read_work(struct work_struct *work)
+{
+	struct load_stream *ls = container_of(work, struct load_stream, read_work);
+
+	ls->read_ret = load_stream_read(ls->fp, ls->read_buf, ls->read_pos, ls->read_len);
+	complete(&ls->read_done);
+}
+
+static void load_stream_start_read(struct load_stream *ls, void *buf,
+				   loff_t pos, u32 len)
+{
+	ls->read_buf = buf;
+	ls->read_pos = pos;
+	ls->read_len = len;
+	ls->read_pending = true;
+	reinit_completion(&ls->read_done);
+	queue_work(system_unbound_wq, &ls->read_work);
+}
+
+static s32 load_stream_wait_read(struct load_stream *ls)
+{
+	ktime_t start;
+
+	if (!ls->read_pending)
+		return SEC_OK;
+	start = ktime_get();
+	wait_for_completion(&ls->read_done);
+	ls->read_wait_us += ktime_us_delta(ktime_get(), start);
+	ls->read_pending = false;
+	return ls->read_ret;
+}
+
+static void load_stream_account(SECBOOT_IMG_TYPE image, char *part_name,
+				struct load_stream *ls, u32 bytes,
+				ktime_t start, s32 ret)
+{
+	struct load_image_stat *st;
+	u32 total_ms = (u32)ktime_ms_delta(ktime_get(), start);
+
+	sec_print_info("%s: %u bytes in %u ms (read wait %llu ms, secure os %llu ms)%s\n",
+		       part_name, bytes, total_ms, ls->read_wait_us / 1000,
+		       ls->tee_us / 1000, ret == SEC_OK ? "" : " failed");
+
+	if ((u32)image >= SOC_MAX)
+		return;
+	st = &load_image_stats[image];
+	spin_lock(&load_image_stat_lock);
+	strlcpy(st->name, part_name, sizeof(st->name));
+	st->loads++;
+	if (ret != SEC_OK)
+		st->failed++;
+	st->bytes = bytes;
+	st->total_ms = total_ms;
+	st->read_wait_ms = ls->read_wait_us / 1000;
+	st->tee_ms = ls->tee_us / 1000;
+	st->pipelined = ls->buf[0] != ls->buf[1];
+	spin_unlock(&load_image_stat_lock);
+}
+
 /*
  * Function name:load_data_to_os.
  * Discription:cut the  image data to 1M per block, and trans them to  sec_OS.
@@ -373,12 +516,14 @@ static s32 load_data_to_os(TEEC_Session *session,
                         u32 offset,
                         u32 sizeToRead)
 {
+	struct load_stream ls;
 	u32 read_bytes;
 	u32 end_bytes;
-	u32 copy_bytes;
 	u32 timers;
 	u32 i;
-	s32 ret = SEC_ERROR;
+	bool pipelined;
+	ktime_t start, tee_start;
+	s32 ret = SEC_OK;
 
 	/*make size aligned with 64 bytes*/
 	sizeToRead = ALIGNED_64BYTE_VALUE(sizeToRead);
@@ -389,56 +534,87 @@ static s32 load_data_to_os(TEEC_Session *session,
 	timers = timers + 1;
 
 	end_bytes = sizeToRead;
+	start = ktime_get();
+
+	memset(&ls, 0, sizeof(ls));
+	INIT_WORK(&ls.read_work, load_stream_read_work);
+	init_completion(&ls.read_done);
+	ls.fp = load_stream_open(part_name);
+	if (IS_ERR(ls.fp)) {
+		sec_print_err("%s: err: open %s\n", __func__, part_name);
+		return SEC_ERROR;
+	}
 
-	mutex_lock(&load_image_lock);
-	/*call flash_read each time to read to memDst.*/
-	for (i = 0; i < timers; i++)
-	{
-		if (end_bytes >= SECBOOT_BUFLEN)
-			read_bytes = SECBOOT_BUFLEN;
-		else
-			read_bytes = end_bytes;
+	ls.buf[0] = (u8 *)__get_free_pages(GFP_KERNEL | __GFP_NOWARN | __GFP_NORETRY,
+					   get_order(SECBOOT_BUFLEN));
+	ls.buf[1] = (u8 *)__get_free_pages(GFP_KERNEL | __GFP_NOWARN | __GFP_NORETRY,
+					   get_order(SECBOOT_BUFLEN));
+	pipelined = ls.buf[0] && ls.buf[1];
+	if (!pipelined) {
+		free_pages((unsigned long)ls.buf[0], get_order(SECBOOT_BUFLEN));
+		free_pages((unsigned long)ls.buf[1], get_order(SECBOOT_BUFLEN));
+		ls.buf[0] = ls.buf[1] = SECBOOT_BUFFER;
+		mutex_lock(&load_image_lock);
+	}
+
+	read_bytes = min_t(u32, end_bytes, SECBOOT_BUFLEN);
+	load_stream_start_read(&ls, ls.buf[0], offset, read_bytes);
 
-		if (bsp_read_bin(part_name, offset + i * SECBOOT_BUFLEN, read_bytes, (void *)SECBOOT_BUFFER)) {
+	for (i = 0; i < timers; i++) {
+		u8 *buf = ls.buf[i & 1];
+		u32 copy_bytes = read_bytes;
+
+		ret = load_stream_wait_read(&ls);
+		if (SEC_OK != ret) {
 			sec_print_err("%s: err: flash_read\n", __func__);
-			mutex_unlock(&load_image_lock);
-			return SEC_ERROR;
+			break;
 		}
+		end_bytes -= copy_bytes;
 
-		if (end_bytes >= SECBOOT_BUFLEN) {
-			if (SECBOOT_BUFLEN != read_bytes) {
-				sec_print_err("%s: err: SECBOOT_BUFLEN:%d != read_bytes:%d\r\n", __func__, SECBOOT_BUFLEN, read_bytes);
-				mutex_unlock(&load_image_lock);
-				return SEC_ERROR;
-			}
-			copy_bytes = SECBOOT_BUFLEN;
-		} else {
-			if (end_bytes > read_bytes) {
-				sec_print_err("%s: err: end_bytes:%d!= read_bytes:%d\r\n", __func__, end_bytes, read_bytes);
-				mutex_unlock(&load_image_lock);
-				return SEC_ERROR;
-			}
-			copy_bytes = end_bytes;
-		}
+		/* the read of chunk i + 1 overlaps the copy of chunk i */
+		read_bytes = min_t(u32, end_bytes, SECBOOT_BUFLEN);
+		if (pipelined && read_bytes)
+			load_stream_start_read(&ls, ls.buf[(i + 1) & 1],
+					       offset + (loff_t)(i + 1) * SECBOOT_BUFLEN,
+					       read_bytes);
 
-		ret = trans_data_to_os(session, image, run_addr, (void *)(SECBOOT_BUFFER), (i * SECBOOT_BUFLEN), copy_bytes);
-		if (SEC_ERROR == ret)
-		{
+		tee_start = ktime_get();
+		ret = trans_data_to_os(session, image, run_addr, (void *)buf, (i * SECBOOT_BUFLEN), copy_bytes);
+		ls.tee_us += ktime_us_delta(ktime_get(), tee_start);
+		if (SEC_ERROR == ret) {
 			sec_print_err("image trans to os is failed, error code 0x%x\r\n", ret);
-			mutex_unlock(&load_image_lock);
-			return SEC_ERROR;
+			break;
 		}
 
-		end_bytes -= copy_bytes;
+		if (!pipelined && read_bytes)
+			load_stream_start_read(&ls, buf,
+					       offset + (loff_t)(i + 1) * SECBOOT_BUFLEN,
+					       read_bytes);
 	}
-	mutex_unlock(&load_image_lock);
+	/* never leave a read running into a buffer that is going away */
+	load_stream_wait_read(&ls);
 
-	if (0 != end_bytes) {
+	if (SEC_OK == ret && 0 != end_bytes) {
 		sec_print_err("%s: end_bytes = 0x%x\n", __func__, end_bytes);
-		return SEC_ERROR;
+		ret = SEC_ERROR;
 	}
 
-	return SEC_OK;
+	if (pipelined) {
+		free_pages((unsigned long)ls.buf[0], get_order(SECBOOT_BUFLEN));
+		free_pages((unsigned long)ls.buf[1], get_order(SECBOOT_BUFLEN));
+	} else {
+		mutex_unlock(&load_image_lock);
+	}
+
+	/* the image now lives in the secure OS, do not keep a cached copy */
+	if (sizeToRead)
+		invalidate_mapping_pages(ls.fp->f_mapping, offset >> PAGE_SHIFT,
+					 (offset + sizeToRead - 1) >> PAGE_SHIFT);
+	filp_close(ls.fp, NULL);
+
+	load_stream_account(image, part_name, &ls, sizeToRead, start, ret);
+
+	return ret;
 }
 
 
@@ -903,9 +1079,47 @@ err_out:
 	return ret;
 }
 
+#if defined(CONFIG_HISI_DEBUG_FS)
+static int load_image_times_show(struct seq_file *s, void *unused)
+{
+	struct load_image_stat st;
+	int i;
+
+	seq_printf(s, "%-4s %-16s %6s %6s %10s %8s %8s %8s %s\n", "type", "partition",
+		   "loads", "failed", "bytes", "total_ms", "read_ms", "tee_ms", "pipelined");
+	for (i = 0; i < SOC_MAX; i++) {
+		spin_lock(&load_image_stat_lock);
+		st = load_image_stats[i];
+		spin_unlock(&load_image_stat_lock);
+		if (!st.loads)
+			continue;
+		seq_printf(s, "%-4d %-16s %6u %6u %10u %8u %8u %8u %d\n", i, st.name,
+			   st.loads, st.failed, st.bytes, st.total_ms,
+			   st.read_wait_ms, st.tee_ms, st.pipelined);
+	}
+	return 0;
+}
+
+static int load_image_times_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, load_image_times_show, NULL);
+}
+
+static const struct file_operations load_image_times_fops = {
+	.open		= load_image_times_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+#endif
+
 static int __init load_image_init(void)
 {
 	mutex_init(&load_image_lock);
+#if defined(CONFIG_HISI_DEBUG_FS)
+	debugfs_create_file("load_image_times", S_IRUSR, NULL, NULL,
+			    &load_image_times_fops);
+#endif
 	return SEC_OK;
 }
 
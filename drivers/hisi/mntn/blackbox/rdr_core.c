@@ -262,22 +262,29 @@ void rdr_syserr_process(struct rdr_syserr_param_s *p)
 
 	if (0 != mask) {
 		if (check_himntn(HIMNTN_GOBAL_RESETLOG)) {
-			rdr_save_cur_baseinfo(path);
-
-			/* 쳣Ҫλȫϵͳʾlog滹δ */
-			if ((p_exce_info->e_reset_core_mask & RDR_AP) &&
-				need_save_mntndump_log(p_exce_info->e_exce_type)) {
-				/* λһlogҪ */
-				bbox_save_done(path, BBOX_SAVE_STEP1);
+			if (!(p_exce_info->e_reset_core_mask & RDR_AP) &&
+			    !rdr_archive_cur_baseinfo(path, p_exce_info->e_exce_type)) {
+				/* bbox_archive saves it and marks the directory done */
+				BB_PRINT_DBG("bbox region queued for archiving.\n");
 			} else {
-				/* 쳣Ŀ¼µlog */
-				bbox_save_done(path, BBOX_SAVE_STEP_DONE);
-			}
+				rdr_archive_flush();
+				rdr_save_cur_baseinfo(path);
+
+				/* 쳣Ҫλȫϵͳʾlog滹δ */
+				if ((p_exce_info->e_reset_core_mask & RDR_AP) &&
+					need_save_mntndump_log(p_exce_info->e_exce_type)) {
+					/* λһlogҪ */
+					bbox_save_done(path, BBOX_SAVE_STEP1);
+				} else {
+					/* 쳣Ŀ¼µlog */
+					bbox_save_done(path, BBOX_SAVE_STEP_DONE);
+				}
 
-			if (!in_atomic() && !irqs_disabled()
-				&& !in_irq()) {
-				/* ȷ֮ǰļϵͳز */
-				sys_sync();
+				if (!in_atomic() && !irqs_disabled()
+					&& !in_irq()) {
+					/* ȷ֮ǰļϵͳز */
+					sys_sync();
+				}
 			}
 		}
 	} else {
@@ -503,6 +510,10 @@ static s32 __init rdr_init(void)
 		return -1;
 	}
 
+	/* without the archive thread every dump is saved synchronously */
+	if (rdr_archive_init())
+		BB_PRINT_ERR("rdr_archive_init faild.\n");
+
 	BB_PRINT_END();
 	return 0;
 }
@@ -23,6 +23,12 @@
 #include <linux/vmalloc.h>
 #include <linux/of.h>
 #include <linux/ctype.h>
+#include <linux/kthread.h>
+#include <linux/wait.h>
+#include <linux/wakelock.h>
+#include <linux/ioprio.h>
+#include <linux/bitmap.h>
+#include <linux/lz4.h>
 
 #include <linux/hisi/hisi_bootup_keypoint.h>
 #include <linux/hisi/rdr_pub.h>
@@ -302,6 +308,370 @@ void rdr_save_last_baseinfo(char *logpath)
 	return;
 }
 
+#ifdef CONFIG_HISI_BB_ARCHIVE
+/*
+ * Background archiving of the bbox region.
+ *
+ * When the AP is not reset by the exception (modem, hifi, ...), the region
+ * is copied into a snapshot and handed to "bbox_archive" instead of being
+ * written raw from bbox_main, so the subsystem reset no longer waits for
+ * the flash. The thread runs at the lowest best-effort I/O priority and
+ * writes RDR_ARCHIVE_BIN:
+ *
+ *   struct rdr_archive_head
+ *   { struct rdr_archive_block, payload } for every saved block
+ *
+ * Payloads are LZ4 compressed unless RDR_ARCHIVE_RAW is set in clen.
+ * Incremental dumps only hold the blocks changed since the dump named in
+ * head.base, and every dump stops adding blocks once it reaches the size
+ * cap of its exception type (RDR_ARCHIVE_F_TRUNCATED).
+ */
+#define RDR_ARCHIVE_BIN			"bbox.bin.lz4"
+#define RDR_ARCHIVE_MAGIC		0x5a524452	/* "RDRZ" */
+#define RDR_ARCHIVE_VERSION		1
+#define RDR_ARCHIVE_BLOCK		(64 * 1024)
+#define RDR_ARCHIVE_RAW			0x80000000
+#define RDR_ARCHIVE_MAX_INCREMENTAL	3
+#define RDR_ARCHIVE_MAX_PENDING		2
+#define RDR_ARCHIVE_CAP_DEFAULT		(2 * 1024 * 1024)
+#define RDR_ARCHIVE_CAPS_MAX		16
+
+#define RDR_ARCHIVE_F_INCREMENTAL	0x1
+#define RDR_ARCHIVE_F_TRUNCATED		0x2
+
+struct rdr_archive_head {
+	u32 magic;
+	u32 version;
+	u32 block_size;
+	u32 nr_blocks;
+	u64 image_size;
+	u32 flags;
+	u32 nr_saved;
+	u32 exce_type;
+	u32 reserved;
+	char base[PATH_MAXLEN];
+};
+
+struct rdr_archive_block {
+	u32 index;
+	u32 clen;
+};
+
+struct rdr_archive_job {
+	struct list_head list;
+	char path[PATH_MAXLEN];
+	u32 exce_type;
+	void *image;
+};
+
+struct rdr_archive_cap {
+	u32 exce_type;
+	u32 bytes;
+};
+
+static struct task_struct *rdr_archive_task;
+static LIST_HEAD(rdr_archive_list);
+static DEFINE_SPINLOCK(rdr_archive_lock);
+static DECLARE_WAIT_QUEUE_HEAD(rdr_archive_wq);
+static DECLARE_WAIT_QUEUE_HEAD(rdr_archive_idle_wq);
+static u32 rdr_archive_pending;
+static struct wake_lock rdr_archive_wl;
+static struct rdr_archive_cap rdr_archive_caps[RDR_ARCHIVE_CAPS_MAX];
+static u32 rdr_archive_nr_caps;
+
+/* only touched by the archive thread */
+static void *rdr_archive_last;
+static unsigned long *rdr_archive_valid;
+static char rdr_archive_base[PATH_MAXLEN];
+static u32 rdr_archive_incremental;
+static void *rdr_archive_wrkmem;
+static void *rdr_archive_cbuf;
+
+static u32 rdr_archive_cap_bytes(u32 exce_type)
+{
+	u32 i;
+
+	for (i = 0; i < rdr_archive_nr_caps; i++) {
+		if (rdr_archive_caps[i].exce_type == exce_type)
+			return rdr_archive_caps[i].bytes;
+	}
+	return RDR_ARCHIVE_CAP_DEFAULT;
+}
+
+/* "rdr_archive_caps" = <exce_type bytes>, ... in the hisilicon,rdr node */
+static void rdr_archive_parse_caps(void)
+{
+	struct device_node *np;
+	int cnt, i;
+
+	np = of_find_compatible_node(NULL, NULL, "hisilicon,rdr");
+	if (!np)
+		return;
+
+	cnt = of_property_count_u32_elems(np, "rdr_archive_caps") / 2;
+	for (i = 0; i < cnt && i < RDR_ARCHIVE_CAPS_MAX; i++) {
+		if (of_property_read_u32_index(np, "rdr_archive_caps", 2 * i,
+					       &rdr_archive_caps[i].exce_type) ||
+		    of_property_read_u32_index(np, "rdr_archive_caps", 2 * i + 1,
+					       &rdr_archive_caps[i].bytes))
+			break;
+	}
+	rdr_archive_nr_caps = (u32)i;
+	of_node_put(np);
+}
+
+static int rdr_archive_write(struct file *fp, loff_t *pos,
+			     const void *buf, size_t len)
+{
+	ssize_t ret;
+
+	ret = vfs_write(fp, (const char __user *)buf, len, pos);
+	return (ret == (ssize_t)len) ? 0 : -EIO;
+}
+
+static int rdr_archive_one(struct rdr_archive_job *job)
+{
+	struct rdr_archive_head head;
+	struct rdr_archive_block blk;
+	char path[PATH_MAXLEN];
+	struct file *fp;
+	const u8 *src, *payload;
+	u64 size = rdr_get_pbb_size();
+	u32 nr_blocks = (u32)DIV_ROUND_UP(size, RDR_ARCHIVE_BLOCK);
+	u32 cap = rdr_archive_cap_bytes(job->exce_type);
+	u32 used = 0, i;
+	size_t len, clen, plen;
+	loff_t pos, hpos = 0;
+	int ret = 0;
+
+	if (!rdr_archive_valid) {
+		rdr_archive_valid = kcalloc(BITS_TO_LONGS(nr_blocks),
+					    sizeof(unsigned long), GFP_KERNEL);
+		if (!rdr_archive_valid)
+			return -ENOMEM;
+	}
+
+	memset(&head, 0, sizeof(head));
+	head.magic = RDR_ARCHIVE_MAGIC;
+	head.version = RDR_ARCHIVE_VERSION;
+	head.block_size = RDR_ARCHIVE_BLOCK;
+	head.nr_blocks = nr_blocks;
+	head.image_size = size;
+	head.exce_type = job->exce_type;
+	if (rdr_archive_last && rdr_archive_base[0] &&
+	    rdr_archive_incremental < RDR_ARCHIVE_MAX_INCREMENTAL) {
+		head.flags |= RDR_ARCHIVE_F_INCREMENTAL;
+		strlcpy(head.base, rdr_archive_base, sizeof(head.base));
+	} else {
+		bitmap_zero(rdr_archive_valid, nr_blocks);
+	}
+
+	snprintf(path, PATH_MAXLEN, "%s/%s", job->path, RDR_ARCHIVE_BIN);
+	fp = filp_open(path, O_CREAT | O_WRONLY | O_TRUNC, FILE_LIMIT);
+	if (IS_ERR(fp)) {
+		BB_PRINT_ERR("%s():create file %s err.\n", __func__, path);
+		return PTR_ERR(fp);
+	}
+
+	pos = sizeof(head);
+	for (i = 0; i < nr_blocks; i++) {
+		src = (const u8 *)job->image + (size_t)i * RDR_ARCHIVE_BLOCK;
+		len = (size_t)min_t(u64, RDR_ARCHIVE_BLOCK,
+				    size - (u64)i * RDR_ARCHIVE_BLOCK);
+
+		if (test_bit(i, rdr_archive_valid) &&
+		    !memcmp(src, (const u8 *)rdr_archive_last +
+			    (size_t)i * RDR_ARCHIVE_BLOCK, len))
+			continue;
+
+		clen = lz4_compressbound(RDR_ARCHIVE_BLOCK);
+		if (lz4_compress(src, len, rdr_archive_cbuf, &clen,
+				 rdr_archive_wrkmem) || clen >= len) {
+			payload = src;
+			plen = len;
+			blk.clen = (u32)len | RDR_ARCHIVE_RAW;
+		} else {
+			payload = rdr_archive_cbuf;
+			plen = clen;
+			blk.clen = (u32)clen;
+		}
+
+		/* over the cap: this block stays unsaved, later dumps retry it */
+		if (used + sizeof(blk) + plen > cap) {
+			head.flags |= RDR_ARCHIVE_F_TRUNCATED;
+			clear_bit(i, rdr_archive_valid);
+			continue;
+		}
+
+		blk.index = i;
+		ret = rdr_archive_write(fp, &pos, &blk, sizeof(blk));
+		if (!ret)
+			ret = rdr_archive_write(fp, &pos, payload, plen);
+		if (ret)
+			goto out;
+
+		used += sizeof(blk) + plen;
+		set_bit(i, rdr_archive_valid);
+		head.nr_saved++;
+	}
+
+	ret = rdr_archive_write(fp, &hpos, &head, sizeof(head));
+	if (!ret)
+		ret = vfs_fsync(fp, 0);
+out:
+	filp_close(fp, NULL);
+
+	if (bbox_chown((const char __user *)path, ROOT_UID, SYSTEM_GID, false))
+		BB_PRINT_ERR("[%s], chown %s failed!\n", __func__, path);
+
+	if (ret) {
+		BB_PRINT_ERR("%s():write file %s err %d.\n", __func__, path, ret);
+		return ret;
+	}
+
+	BB_PRINT_PN("%s():%s: %u/%u blocks, %u bytes%s\n", __func__, path,
+		    head.nr_saved, nr_blocks, used,
+		    (head.flags & RDR_ARCHIVE_F_TRUNCATED) ? ", truncated" : "");
+
+	/* the snapshot becomes the reference for the next incremental dump */
+	vfree(rdr_archive_last);
+	rdr_archive_last = job->image;
+	job->image = NULL;
+	strlcpy(rdr_archive_base, job->path, sizeof(rdr_archive_base));
+	if (head.flags & RDR_ARCHIVE_F_INCREMENTAL)
+		rdr_archive_incremental++;
+	else
+		rdr_archive_incremental = 0;
+
+	return 0;
+}
+
+static int rdr_archive_thread(void *arg)
+{
+	struct rdr_archive_job *job;
+
+	set_user_nice(current, MAX_NICE);
+	set_task_ioprio(current, IOPRIO_PRIO_VALUE(IOPRIO_CLASS_BE, 7));
+
+	while (!kthread_should_stop()) {
+		wait_event_interruptible(rdr_archive_wq,
+					 !list_empty(&rdr_archive_list) ||
+					 kthread_should_stop());
+
+		spin_lock(&rdr_archive_lock);
+		job = list_first_entry_or_null(&rdr_archive_list,
+					       struct rdr_archive_job, list);
+		if (job)
+			list_del(&job->list);
+		spin_unlock(&rdr_archive_lock);
+		if (!job)
+			continue;
+
+		if (rdr_archive_one(job)) {
+			/* next dump must not depend on this one */
+			rdr_archive_base[0] = '\0';
+		}
+		bbox_save_done(job->path, BBOX_SAVE_STEP_DONE);
+		sys_sync();
+
+		vfree(job->image);
+		kfree(job);
+
+		spin_lock(&rdr_archive_lock);
+		if (!--rdr_archive_pending)
+			wake_unlock(&rdr_archive_wl);
+		spin_unlock(&rdr_archive_lock);
+		wake_up_all(&rdr_archive_idle_wq);
+	}
+
+	return 0;
+}
+
+/*
+ * rdr_archive_cur_baseinfo - snapshot the bbox region for bbox_archive.
+ *
+ * On success the archive thread also marks logpath done. On error the
+ * caller should fall back to rdr_save_cur_baseinfo().
+ */
+int rdr_archive_cur_baseinfo(char *logpath, u32 exce_type)
+{
+	struct rdr_archive_job *job;
+	u64 size = rdr_get_pbb_size();
+
+	if (!rdr_archive_task || !logpath)
+		return -ENODEV;
+
+	job = kzalloc(sizeof(*job), GFP_KERNEL);
+	if (!job)
+		return -ENOMEM;
+
+	job->image = vmalloc(size);
+	if (!job->image) {
+		kfree(job);
+		return -ENOMEM;
+	}
+	memcpy(job->image, rdr_get_pbb(), size);
+	strlcpy(job->path, logpath, sizeof(job->path));
+	job->exce_type = exce_type;
+
+	spin_lock(&rdr_archive_lock);
+	if (rdr_archive_pending >= RDR_ARCHIVE_MAX_PENDING) {
+		spin_unlock(&rdr_archive_lock);
+		vfree(job->image);
+		kfree(job);
+		return -EBUSY;
+	}
+	if (!rdr_archive_pending++)
+		wake_lock(&rdr_archive_wl);
+	list_add_tail(&job->list, &rdr_archive_list);
+	spin_unlock(&rdr_archive_lock);
+
+	wake_up(&rdr_archive_wq);
+	return 0;
+}
+
+/* let queued archives land before the AP is reset */
+void rdr_archive_flush(void)
+{
+	if (!rdr_archive_task)
+		return;
+
+	wait_event_timeout(rdr_archive_idle_wq, !READ_ONCE(rdr_archive_pending),
+			   msecs_to_jiffies(rdr_get_dumplog_timeout()));
+}
+
+int rdr_archive_init(void)
+{
+	struct task_struct *task;
+
+	rdr_archive_wrkmem = kmalloc(LZ4_MEM_COMPRESS, GFP_KERNEL);
+	rdr_archive_cbuf = vmalloc(lz4_compressbound(RDR_ARCHIVE_BLOCK));
+	if (!rdr_archive_wrkmem || !rdr_archive_cbuf) {
+		BB_PRINT_ERR("%s():alloc lz4 buffers fail\n", __func__);
+		goto err;
+	}
+
+	rdr_archive_parse_caps();
+	wake_lock_init(&rdr_archive_wl, WAKE_LOCK_SUSPEND, "bbox_archive");
+
+	task = kthread_run(rdr_archive_thread, NULL, "bbox_archive");
+	if (IS_ERR(task)) {
+		BB_PRINT_ERR("%s():create thread bbox_archive fail\n", __func__);
+		wake_lock_destroy(&rdr_archive_wl);
+		goto err;
+	}
+	rdr_archive_task = task;
+	return 0;
+
+err:
+	vfree(rdr_archive_cbuf);
+	kfree(rdr_archive_wrkmem);
+	rdr_archive_cbuf = NULL;
+	rdr_archive_wrkmem = NULL;
+	return -ENOMEM;
+}
+#endif /* CONFIG_HISI_BB_ARCHIVE */
+
 /*******************************************************************************
 Function:       get_system_time
 Description:    get_system_time
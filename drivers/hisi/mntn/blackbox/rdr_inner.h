@@ -176,6 +176,26 @@ RDR_NVE rdr_get_nve(void);
 void rdr_save_last_baseinfo(char *logpath);
 void rdr_save_cur_baseinfo(char *logpath);
 
+#ifdef CONFIG_HISI_BB_ARCHIVE
+int rdr_archive_init(void);
+int rdr_archive_cur_baseinfo(char *logpath, u32 exce_type);
+void rdr_archive_flush(void);
+#else
+static inline int rdr_archive_init(void)
+{
+	return 0;
+}
+
+static inline int rdr_archive_cur_baseinfo(char *logpath, u32 exce_type)
+{
+	return -ENODEV;
+}
+
+static inline void rdr_archive_flush(void)
+{
+}
+#endif
+
 void rdr_field_dumplog_done(void);
 void rdr_field_reboot_done(void);
 void rdr_field_procexec_done(void);
@@ -30,6 +30,80 @@
 #include <linux/hisi/util.h>
 #include <linux/uaccess.h>
 #include <linux/hisi/hisi_bootup_keypoint.h>
+#include <linux/hisi/hisi_boot_initcall.h>
+#include <linux/seq_file.h>
+#include <linux/spinlock.h>
+
+/* the slowest initcalls of the boot, longest first */
+#define BOOT_INITCALL_SLOTS	64
+
+struct boot_initcall_rec {
+	char name[48];
+	u32 duration_us;
+	bool async;
+};
+
+static struct boot_initcall_rec boot_initcalls[BOOT_INITCALL_SLOTS];
+static unsigned int boot_initcall_count;
+static u64 boot_initcall_serial_us;
+static DEFINE_SPINLOCK(boot_initcall_lock);
+
+void hisi_boottime_initcall(initcall_t fn, u64 duration_us, bool async)
+{
+	struct boot_initcall_rec *rec;
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&boot_initcall_lock, flags);
+	boot_initcall_count++;
+	if (!async)
+		boot_initcall_serial_us += duration_us;
+
+	for (i = 0; i < BOOT_INITCALL_SLOTS; i++)
+		if (duration_us > boot_initcalls[i].duration_us)
+			break;
+	if (i < BOOT_INITCALL_SLOTS) {
+		memmove(&boot_initcalls[i + 1], &boot_initcalls[i],
+			(BOOT_INITCALL_SLOTS - i - 1) * sizeof(*rec));
+		rec = &boot_initcalls[i];
+		/* name it now, the function goes away with the init sections */
+		snprintf(rec->name, sizeof(rec->name), "%pf", fn);
+		rec->duration_us = min_t(u64, duration_us, U32_MAX);
+		rec->async = async;
+	}
+	spin_unlock_irqrestore(&boot_initcall_lock, flags);
+}
+
+static int boot_initcalls_show(struct seq_file *s, void *unused)
+{
+	struct boot_initcall_rec rec;
+	int i;
+
+	seq_printf(s, "initcalls %u serial_us %llu\n", boot_initcall_count,
+		   boot_initcall_serial_us);
+	for (i = 0; i < BOOT_INITCALL_SLOTS; i++) {
+		spin_lock_irq(&boot_initcall_lock);
+		rec = boot_initcalls[i];
+		spin_unlock_irq(&boot_initcall_lock);
+		if (!rec.duration_us)
+			break;
+		seq_printf(s, "%10u %s %s\n", rec.duration_us,
+			   rec.async ? "async" : "sync ", rec.name);
+	}
+	return 0;
+}
+
+static int boot_initcalls_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, boot_initcalls_show, NULL);
+}
+
+static const struct file_operations boot_initcalls_fops = {
+	.open = boot_initcalls_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
 
 static ssize_t boot_time_proc_read(struct file *file, char __user *userbuf,
 				   size_t bytes, loff_t *off)
@@ -57,6 +131,8 @@ static int __init boot_time_proc_init(void)
 {
 	balong_create_stats_proc_entry("boot_time", (S_IWUSR),
 				       &boot_time_proc_fops, NULL);
+	balong_create_stats_proc_entry("boot_initcalls", S_IRUSR,
+				       &boot_initcalls_fops, NULL);
 
 	return 0;
 }
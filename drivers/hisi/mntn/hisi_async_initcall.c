@@ -0,0 +1,46 @@
+/*
+ * hisi_async_initcall.c
+ *
+ * Runs the initcalls declared with hisi_async_initcall() on the async
+ * threads, so independent drivers initialize and probe on all cores while
+ * the boot thread goes on with the serial ones. kernel_init() waits for
+ * all of them with async_synchronize_full() before freeing init memory.
+ *
+ * Copyright (c) 2018 Hisilicon Technologies CO., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/async.h>
+#include <linux/ktime.h>
+#include <linux/completion.h>
+#include <linux/hisi/hisi_boot_initcall.h>
+
+static void __init hisi_async_initcall_run(void *data, async_cookie_t cookie)
+{
+	struct hisi_async_initcall *call = data;
+	ktime_t calltime;
+	int ret;
+
+	if (call->dep)
+		wait_for_completion(&call->dep->done);
+
+	calltime = ktime_get();
+	ret = call->fn();
+	hisi_boottime_initcall(call->fn,
+			       ktime_us_delta(ktime_get(), calltime), true);
+	if (ret)
+		pr_warn("async initcall %pF returned %d\n", call->fn, ret);
+
+	/* dependents go on whatever the result, as they would serially */
+	complete_all(&call->done);
+}
+
+void __init hisi_async_initcall_start(struct hisi_async_initcall *call)
+{
+	async_schedule(hisi_async_initcall_run, call);
+}
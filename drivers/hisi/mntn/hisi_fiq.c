@@ -30,6 +30,7 @@ asmlinkage void fiq_dump(struct pt_regs *regs, unsigned int esr)
 {
 	fiq_dump_flag = 0xdeaddead;
 	bust_spinlocks(1);
+	printk_console_force_sync();
 	flush_ftrace_buffer_cache();
 
 	printk_level_setup(LOGLEVEL_DEBUG);
@@ -0,0 +1,319 @@
+/*
+ * hisi_flight_recorder.c
+ *
+ * Always-on scheduler event recorder for jank analysis in the field.
+ *
+ * Context switches, wakeups, migrations, cpu frequency changes, irq
+ * entry/exit and block request issue/completion are written as 16 byte
+ * records into per-cpu rings by tracepoint probes, with no ftrace buffer
+ * or string formatting involved. The rings live in one vmalloc area that
+ * /dev/flight_recorder maps read-only. When a frame drop is reported, the
+ * rings are frozen (optionally after a delay, to also catch what follows)
+ * so the reader can collect the seconds that led up to it.
+ *
+ * Copyright (c) 2018 Hisilicon Technologies CO., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <linux/miscdevice.h>
+#include <linux/uaccess.h>
+#include <linux/timer.h>
+#include <linux/jiffies.h>
+#include <linux/sched.h>
+#include <linux/blkdev.h>
+#include <linux/interrupt.h>
+#include <linux/log2.h>
+#include <trace/events/sched.h>
+#include <trace/events/power.h>
+#include <trace/events/irq.h>
+#include <trace/events/block.h>
+#include <linux/hisi/hisi_flight_recorder.h>
+
+#define FLIGHT_DEFAULT_RECORDS	4096	/* 64KB per cpu */
+
+static unsigned int nr_records = FLIGHT_DEFAULT_RECORDS;
+module_param(nr_records, uint, 0444);
+MODULE_PARM_DESC(nr_records, "records per cpu ring, rounded to a power of two");
+
+static struct hisi_flight_hdr *flight_hdr;
+static struct hisi_flight_record *flight_data;
+static unsigned int flight_mask;
+static bool flight_stopped;
+static struct timer_list flight_freeze_timer;
+static u32 flight_freeze_reason;
+static DEFINE_SPINLOCK(flight_lock);
+
+static void flight_write(unsigned int type, u32 arg0, u32 arg1)
+{
+	struct hisi_flight_record *rec;
+	unsigned long flags;
+	unsigned int cpu;
+	u64 head;
+
+	if (unlikely(ACCESS_ONCE(flight_stopped)))
+		return;
+
+	/* irqs off: a nested probe on this cpu must not take the same slot */
+	local_irq_save(flags);
+	cpu = smp_processor_id();
+	if (likely(cpu < flight_hdr->nr_cpus)) {
+		head = flight_hdr->head[cpu];
+		rec = flight_data + (size_t)cpu * (flight_mask + 1) +
+			(head & flight_mask);
+		rec->ts_type = (sched_clock() << 8) | type;
+		rec->arg0 = arg0;
+		rec->arg1 = arg1;
+		/* the record before the head that covers it */
+		smp_wmb();
+		ACCESS_ONCE(flight_hdr->head[cpu]) = head + 1;
+	}
+	local_irq_restore(flags);
+}
+
+static void flight_sched_switch(void *ignore, struct task_struct *prev,
+				struct task_struct *next)
+{
+	u32 prev_pid = prev->pid;
+
+	if (prev->state == TASK_RUNNING)
+		prev_pid |= 1U << 31;
+	flight_write(HISI_FLIGHT_SWITCH, prev_pid, next->pid);
+}
+
+static void flight_sched_wakeup(void *ignore, struct task_struct *p,
+				int success)
+{
+	flight_write(HISI_FLIGHT_WAKEUP, p->pid, task_cpu(p));
+}
+
+static void flight_sched_migrate(void *ignore, struct task_struct *p,
+				 int dest_cpu)
+{
+	flight_write(HISI_FLIGHT_MIGRATE, p->pid,
+		     (task_cpu(p) << 16) | (dest_cpu & 0xffff));
+}
+
+static void flight_cpu_frequency(void *ignore, unsigned int frequency,
+				 unsigned int cpu_id)
+{
+	flight_write(HISI_FLIGHT_FREQ, cpu_id, frequency);
+}
+
+static void flight_irq_entry(void *ignore, int irq,
+			     struct irqaction *action)
+{
+	flight_write(HISI_FLIGHT_IRQ_ENTRY, irq, 0);
+}
+
+static void flight_irq_exit(void *ignore, int irq,
+			    struct irqaction *action, int ret)
+{
+	flight_write(HISI_FLIGHT_IRQ_EXIT, irq, ret);
+}
+
+static u32 flight_rq_arg1(struct request *rq)
+{
+	u32 arg1 = blk_rq_sectors(rq) & ~(1U << 31);
+
+	if (rq_data_dir(rq) == WRITE)
+		arg1 |= 1U << 31;
+	return arg1;
+}
+
+static void flight_block_issue(void *ignore, struct request_queue *q,
+			       struct request *rq)
+{
+	if (rq->cmd_type != REQ_TYPE_FS)
+		return;
+	flight_write(HISI_FLIGHT_BLK_ISSUE, (u32)blk_rq_pos(rq),
+		     flight_rq_arg1(rq));
+}
+
+static void flight_block_complete(void *ignore, struct request_queue *q,
+				  struct request *rq, unsigned int nr_bytes)
+{
+	if (rq->cmd_type != REQ_TYPE_FS)
+		return;
+	flight_write(HISI_FLIGHT_BLK_DONE, (u32)blk_rq_pos(rq),
+		     flight_rq_arg1(rq));
+}
+
+static void flight_do_freeze(u32 reason)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&flight_lock, flags);
+	if (!flight_stopped) {
+		flight_write(HISI_FLIGHT_FREEZE, reason, 0);
+		ACCESS_ONCE(flight_stopped) = true;
+		flight_hdr->freeze_ns = sched_clock();
+		smp_wmb();
+		flight_hdr->frozen = 1;
+	}
+	spin_unlock_irqrestore(&flight_lock, flags);
+}
+
+static void flight_freeze_timer_fn(unsigned long data)
+{
+	flight_do_freeze(ACCESS_ONCE(flight_freeze_reason));
+}
+
+void hisi_flight_freeze(u32 reason, unsigned int delay_ms)
+{
+	if (!flight_hdr)
+		return;
+
+	if (!delay_ms) {
+		flight_do_freeze(reason);
+		return;
+	}
+	/* a pending freeze is not pushed back by later reports */
+	if (timer_pending(&flight_freeze_timer))
+		return;
+	ACCESS_ONCE(flight_freeze_reason) = reason;
+	mod_timer(&flight_freeze_timer, jiffies + msecs_to_jiffies(delay_ms));
+}
+EXPORT_SYMBOL(hisi_flight_freeze);
+
+static void flight_resume(void)
+{
+	unsigned long flags;
+
+	del_timer_sync(&flight_freeze_timer);
+	spin_lock_irqsave(&flight_lock, flags);
+	flight_hdr->frozen = 0;
+	flight_hdr->freeze_ns = 0;
+	smp_wmb();
+	ACCESS_ONCE(flight_stopped) = false;
+	spin_unlock_irqrestore(&flight_lock, flags);
+}
+
+static long flight_ioctl(struct file *filp, unsigned int cmd,
+			 unsigned long arg)
+{
+	u32 delay_ms;
+
+	switch (cmd) {
+	case HISI_FLIGHT_IOC_FREEZE:
+		if (copy_from_user(&delay_ms, (void __user *)arg,
+				   sizeof(delay_ms)))
+			return -EFAULT;
+		hisi_flight_freeze(task_tgid_nr(current), delay_ms);
+		return 0;
+	case HISI_FLIGHT_IOC_RESUME:
+		flight_resume();
+		return 0;
+	default:
+		return -ENOTTY;
+	}
+}
+
+static int flight_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+	vma->vm_flags &= ~VM_MAYWRITE;
+
+	return remap_vmalloc_range(vma, flight_hdr, vma->vm_pgoff);
+}
+
+static const struct file_operations flight_fops = {
+	.owner		= THIS_MODULE,
+	.unlocked_ioctl	= flight_ioctl,
+	.compat_ioctl	= flight_ioctl,
+	.mmap		= flight_mmap,
+};
+
+static struct miscdevice flight_miscdev = {
+	.minor	= MISC_DYNAMIC_MINOR,
+	.name	= "flight_recorder",
+	.fops	= &flight_fops,
+};
+
+static void flight_unregister_probes(void)
+{
+	unregister_trace_block_rq_complete(flight_block_complete, NULL);
+	unregister_trace_block_rq_issue(flight_block_issue, NULL);
+	unregister_trace_irq_handler_exit(flight_irq_exit, NULL);
+	unregister_trace_irq_handler_entry(flight_irq_entry, NULL);
+	unregister_trace_cpu_frequency(flight_cpu_frequency, NULL);
+	unregister_trace_sched_migrate_task(flight_sched_migrate, NULL);
+	unregister_trace_sched_wakeup(flight_sched_wakeup, NULL);
+	unregister_trace_sched_switch(flight_sched_switch, NULL);
+	tracepoint_synchronize_unregister();
+}
+
+static int flight_register_probes(void)
+{
+	int ret;
+
+	ret = register_trace_sched_switch(flight_sched_switch, NULL);
+	ret |= register_trace_sched_wakeup(flight_sched_wakeup, NULL);
+	ret |= register_trace_sched_migrate_task(flight_sched_migrate, NULL);
+	ret |= register_trace_cpu_frequency(flight_cpu_frequency, NULL);
+	ret |= register_trace_irq_handler_entry(flight_irq_entry, NULL);
+	ret |= register_trace_irq_handler_exit(flight_irq_exit, NULL);
+	ret |= register_trace_block_rq_issue(flight_block_issue, NULL);
+	ret |= register_trace_block_rq_complete(flight_block_complete, NULL);
+	if (ret) {
+		/* unregistering a probe that never got in is harmless */
+		flight_unregister_probes();
+		return -EINVAL;
+	}
+	return 0;
+}
+
+static int __init hisi_flight_init(void)
+{
+	unsigned int cpus = min_t(unsigned int, nr_cpu_ids,
+				  HISI_FLIGHT_MAX_CPUS);
+	size_t ring, size;
+	int ret;
+
+	if (!nr_records)
+		return 0;
+	nr_records = roundup_pow_of_two(clamp(nr_records, 256U, 1U << 20));
+	ring = (size_t)nr_records * sizeof(struct hisi_flight_record);
+	size = PAGE_SIZE + PAGE_ALIGN(ring * cpus);
+
+	flight_hdr = vmalloc_user(size);
+	if (!flight_hdr)
+		return -ENOMEM;
+
+	flight_hdr->version = HISI_FLIGHT_VERSION;
+	flight_hdr->record_size = sizeof(struct hisi_flight_record);
+	flight_hdr->nr_cpus = cpus;
+	flight_hdr->nr_records = nr_records;
+	flight_hdr->data_offset = PAGE_SIZE;
+	flight_data = (void *)flight_hdr + PAGE_SIZE;
+	flight_mask = nr_records - 1;
+	setup_timer(&flight_freeze_timer, flight_freeze_timer_fn, 0);
+
+	ret = misc_register(&flight_miscdev);
+	if (ret)
+		goto err_free;
+
+	ret = flight_register_probes();
+	if (ret)
+		goto err_misc;
+
+	pr_info("flight recorder: %u cpus x %u records\n", cpus, nr_records);
+	return 0;
+
+err_misc:
+	misc_deregister(&flight_miscdev);
+err_free:
+	vfree(flight_hdr);
+	flight_hdr = NULL;
+	return ret;
+}
+late_initcall(hisi_flight_init);
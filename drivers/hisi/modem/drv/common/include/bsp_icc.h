@@ -346,6 +346,34 @@ s32 bsp_icc_send_sync(u32 cpuid,u32 channel_id,u8 * data,u32 data_len,long timeo
 *****************************************************************************/
 s32 bsp_icc_read(u32 channel_id,u8 * buf,u32 buf_len);
 
+/*
+ * Zero copy receive: bsp_icc_read_get() describes the next message where it
+ * lies in the shared fifo, in one piece or, when it wraps, two. The data
+ * stays valid until bsp_icc_read_put() hands the space back to the sender.
+ * Only one message per channel may be held, from the channel's read
+ * callback like bsp_icc_read(). Returns the payload length or an error.
+ */
+struct icc_read_vec
+{
+	u8  *addr[2];
+	u32 len[2];
+};
+s32 bsp_icc_read_get(u32 channel_id, struct icc_read_vec *vec);
+s32 bsp_icc_read_put(u32 channel_id);
+
+/*
+ * Batched send: every entry goes into the fifo as its own message and the
+ * other core gets one IPC interrupt for all of them. Stops at the first
+ * entry that does not fit and returns the number of entries sent, or an
+ * error if none was.
+ */
+struct icc_send_vec
+{
+	u8  *data;
+	u32 len;
+};
+s32 bsp_icc_send_batch(u32 cpuid, u32 channel_id, struct icc_send_vec *msgs, u32 nr);
+
 /*****************************************************************************
 *     : bsp_icc_event_register
 *   : ʹiccͨעصӿ
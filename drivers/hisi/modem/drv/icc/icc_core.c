@@ -196,6 +196,67 @@ static u32 fifo_skip(struct icc_channel_fifo* fifo,  u32 len)
 	return data_len;
 }
 
+/* describe the next message in place; *next_read is the read pointer past it */
+static s32 fifo_peek_with_header(struct icc_channel_fifo *fifo, struct icc_read_vec *vec, u32 *next_read)
+{
+	struct icc_channel_packet packet = {0};
+	char *base_addr = (char*)fifo + sizeof(struct icc_channel_fifo);
+	u32 read = fifo->read;
+	u32 tail = 0;
+
+	if(fifo_get(fifo, (u8 *)&packet, sizeof(packet), &read) != sizeof(packet))
+	{
+		icc_print_error("get packet err\n");
+		(void)icc_channel_packet_dump(&packet);
+		return ICC_ERR;
+	}
+	if(fifo_read_space_get(fifo) - sizeof(packet) < packet.len)
+	{
+		icc_print_error("invalid packet.len: 0x%x\n", packet.len);
+		return ICC_ERR;
+	}
+
+	tail = fifo->size - read;
+	vec->addr[0] = (u8 *)(base_addr + read);
+	if(packet.len <= tail)
+	{
+		vec->len[0]  = packet.len;
+		vec->addr[1] = NULL;
+		vec->len[1]  = 0;
+		read += packet.len;
+	}
+	else
+	{
+		vec->len[0]  = tail;
+		vec->addr[1] = (u8 *)base_addr;
+		vec->len[1]  = packet.len - tail;
+		read = vec->len[1];
+	}
+	*next_read = (read >= fifo->size) ? (read - fifo->size) : read;
+
+	return (s32)packet.len;
+}
+
+/* caller holds channel->write_lock */
+static s32 packet_put(struct icc_channel *channel, struct icc_channel_packet *packet, u8 *data, u32 data_len)
+{
+	u32 len = 0;
+
+	if((data_len + sizeof(struct icc_channel_packet)) >= fifo_write_space_get(channel->fifo_send))/*lint !e574 */
+	{
+		return ICC_INVALID_NO_FIFO_SPACE;
+	}
+
+	len = fifo_put_with_header(channel->fifo_send, (u8*)packet, sizeof(struct icc_channel_packet), data, data_len);
+	len -=  sizeof(struct icc_channel_packet);
+	if(data_len != len)
+	{
+		return ICC_SEND_ERR;
+	}
+
+	return (s32)len;
+}
+
 static s32 data_send(u32 cpuid, u32 channel_id, u8* data, u32 data_len)
 {
 	s32 ret = ICC_OK;
@@ -218,20 +279,12 @@ static s32 data_send(u32 cpuid, u32 channel_id, u8* data, u32 data_len)
 
 	icc_debug_before_send(&packet);  /* ¼debugϢIDʱͷ */
 	
-	if((data_len + sizeof(struct icc_channel_packet)) >= fifo_write_space_get(channel->fifo_send))/*lint !e574 */
+	ret = packet_put(channel, &packet, data, data_len);
+	if(ret < 0)
 	{
-		ret = ICC_INVALID_NO_FIFO_SPACE;
-		goto err_fifo_full; /*lint !e801 */
-	}
-
-    /* ͷطfifo */
-	len = fifo_put_with_header(channel->fifo_send, (u8*)&packet, sizeof(struct icc_channel_packet), data, data_len);
-	len -=  sizeof(struct icc_channel_packet);
-	if(data_len != len)
-	{
-		ret = ICC_SEND_ERR;
 		goto err_send; /*lint !e801 */
 	}
+	len = (u32)ret;
 
 	ret = bsp_ipc_int_send((IPC_INT_CORE_E)cpuid, (IPC_INT_LEV_E)channel->ipc_send_irq_id);
 	if(ret != 0)
@@ -249,10 +302,6 @@ static s32 data_send(u32 cpuid, u32 channel_id, u8* data, u32 data_len)
 err_send:	
 	spin_unlock_irqrestore(&channel->write_lock, flags); /*lint !e123 */
 	return ret;
-	
-err_fifo_full:
-	spin_unlock_irqrestore(&channel->write_lock, flags); /*lint !e123 */
-	return ret;
 }
 
 void handle_channel_recv_data(struct icc_channel *channel)
@@ -492,6 +541,7 @@ struct icc_channel *icc_channel_init(struct icc_init_info *info, s32 *ret)
 
 	spin_lock_init(&channel->write_lock); /*lint !e123 */
 	spin_lock_init(&channel->read_lock);  /*lint !e123 */
+	channel->held = 0;
 
 	if((!channel->mode.union_stru.task_shared) && (!channel->mode.union_stru.no_task))
 	{
@@ -959,7 +1009,150 @@ out:
 	return ret;
 }
 
+s32 bsp_icc_send_batch(u32 cpuid, u32 channel_id, struct icc_send_vec *msgs, u32 nr)
+{
+	s32 ret = ICC_OK;
+	unsigned long flags = 0;
+	u32 i = 0;
+	struct icc_channel *channel = NULL;
+	struct icc_channel_packet packet = {0};
+
+	UNUSED(flags);
+	if((!msgs) || (!nr) || (cpuid >= ICC_CPU_MAX) || (cpuid == ICC_THIS_CPU) || (GET_CHN_ID(channel_id) >= ICC_CHN_ID_MAX)
+	   || (!g_icc_ctrl.channels[GET_CHN_ID(channel_id)]) || (GET_FUNC_ID(channel_id) >= g_icc_ctrl.channels[GET_CHN_ID(channel_id)]->func_size))
+	{
+		icc_print_error("para err,cpuid=0x%x, chan_id=0x%x, msgs=%p, nr=%d\n", cpuid, channel_id, msgs, nr);
+		return ICC_INVALID_PARA;
+	}
+
+	if (1 == (icc_ccore_is_reseting(cpuid)))
+	{
+	    return BSP_ERR_ICC_CCORE_RESETTING;
+	}
+
+	channel = g_icc_ctrl.channels[GET_CHN_ID(channel_id)];
+
+	spin_lock_irqsave(&channel->write_lock, flags); /*lint !e123 */
+	for(i = 0; i < nr; i++)
+	{
+		if((!msgs[i].data) && msgs[i].len)
+		{
+			ret = ICC_INVALID_PARA;
+			break;
+		}
+
+		(void)memset_s(&packet, sizeof(packet), 0, sizeof(packet));
+		packet.channel_id = channel_id;
+		packet.src_cpu_id = ICC_THIS_CPU;
+		packet.len = msgs[i].len;
+		icc_debug_before_send(&packet);
+
+		ret = packet_put(channel, &packet, msgs[i].data, msgs[i].len);
+		if(ret < 0)
+		{
+			break;
+		}
+		icc_debug_after_send(channel, &packet, msgs[i].data);
+	}
+
+	/* one interrupt for everything that went in, the receiver drains the fifo */
+	if(i)
+	{
+		ret = bsp_ipc_int_send((IPC_INT_CORE_E)cpuid, (IPC_INT_LEV_E)channel->ipc_send_irq_id);
+		if(ret != 0)
+		{
+			icc_print_error("ipc send fail,ret:0x%x \n", ret);
+		}
+		else
+		{
+			ret = (s32)i;
+		}
+	}
+	spin_unlock_irqrestore(&channel->write_lock, flags); /*lint !e123 */
+
+	return ret;
+}
+
+s32 bsp_icc_read_get(u32 channel_id, struct icc_read_vec *vec)
+{
+	s32 ret = 0;
+	unsigned long flags = 0;
+	u32 real_channel_id = GET_CHN_ID(channel_id);
+	struct icc_channel *channel = NULL;
+
+	UNUSED(flags);
+	if((!vec) || (real_channel_id >= ICC_CHN_ID_MAX) || (!g_icc_ctrl.channels[real_channel_id]) ||
+	   (GET_FUNC_ID(channel_id) >= g_icc_ctrl.channels[real_channel_id]->func_size))
+	{
+		icc_print_error("para err, chan_id=0x%x, vec=%p\n", channel_id, vec);
+		return ICC_INVALID_PARA;
+	}
+
+	channel = g_icc_ctrl.channels[real_channel_id];
+	if(!channel->ready_recv)
+	{
+		return 0;
+	}
+
+	spin_lock_irqsave(&channel->read_lock, flags);
+	if(channel->held)
+	{
+		/* the previous message has not been put back */
+		ret = ICC_INVALID_PARA;
+	}
+	else if(fifo_read_space_get(channel->fifo_recv) >= sizeof(struct icc_channel_packet))
+	{
+		ret = fifo_peek_with_header(channel->fifo_recv, vec, &channel->held_read);
+		if(ret >= 0)
+		{
+			channel->held = 1;
+			icc_debug_in_read_cb(channel_id, vec->addr[0], vec->len[0], channel->fifo_recv->read, channel->fifo_recv->write);
+		}
+		else
+		{
+			ret = ICC_INVALID_PARA;
+		}
+	}
+	spin_unlock_irqrestore(&channel->read_lock, flags);
+
+	return ret;
+}
+
+s32 bsp_icc_read_put(u32 channel_id)
+{
+	s32 ret = ICC_OK;
+	unsigned long flags = 0;
+	u32 real_channel_id = GET_CHN_ID(channel_id);
+	struct icc_channel *channel = NULL;
+
+	UNUSED(flags);
+	if((real_channel_id >= ICC_CHN_ID_MAX) || (!g_icc_ctrl.channels[real_channel_id]))
+	{
+		return ICC_INVALID_PARA;
+	}
+
+	channel = g_icc_ctrl.channels[real_channel_id];
+	spin_lock_irqsave(&channel->read_lock, flags);
+	if(channel->held)
+	{
+		/* the reader is done with the data before the sender may reuse it */
+		mb();
+		channel->fifo_recv->read = channel->held_read;
+		channel->held = 0;
+	}
+	else
+	{
+		ret = ICC_INVALID_PARA;
+	}
+	spin_unlock_irqrestore(&channel->read_lock, flags);
+
+	return ret;
+}
+
 EXPORT_SYMBOL(bsp_icc_read);            /*lint !e19 */
+EXPORT_SYMBOL(bsp_icc_read_get);        /*lint !e19 */
+EXPORT_SYMBOL(bsp_icc_read_put);        /*lint !e19 */
+EXPORT_SYMBOL(bsp_icc_send_batch);      /*lint !e19 */
 EXPORT_SYMBOL(bsp_icc_send);            /*lint !e19 */
 EXPORT_SYMBOL(bsp_icc_event_register);  /*lint !e19 */
 EXPORT_SYMBOL(bsp_icc_event_unregister);/*lint !e19 */
@@ -185,6 +185,8 @@ struct icc_channel
 	spinlock_t                read_lock;        /* ͨspin */
 	struct icc_channel_vector *vector;          /* (ͨ)ָ */
 	u32                       func_size;        /* (ͨ)С */
+	u32                       held_read;        /* read pointer past the message held by bsp_icc_read_get */
+	u32                       held;             /* a message is held by bsp_icc_read_get */
 };
 
 struct channel_cfg{
@@ -280,6 +282,11 @@ struct icc_channel_stat_info
 	u32 sum_num;
 	u32 sum_num_prev;
 	u32 task_id;
+	u32 sum_len_prev;   /* sum_len at the previous show, for throughput */
+	u32 show_slice;     /* slice of the previous show */
+	u32 lat_cnt;        /* send: time spent sending; recv: sender timestamp to read callback done */
+	u32 lat_sum;        /* slices */
+	u32 lat_max;
 };
 
 struct icc_uni_channel_info
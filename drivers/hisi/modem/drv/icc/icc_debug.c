@@ -48,6 +48,7 @@
 
 
 /*lint --e{537} */
+#include <linux/math64.h>
 #include <bsp_pm_om.h>
 #include "icc_core.h"
 #include "icc_platform.h"
@@ -361,6 +362,22 @@ void icc_msg_dump(struct icc_msg_fifo *queue, u32 start, u32 end)
 }
 
 
+/* throughput since the previous show, and latency in us */
+static void icc_channel_perf_show(struct icc_channel_stat_info *stat)
+{
+	u32 now   = bsp_get_slice_value();
+	u32 delta = get_timer_slice_delta(stat->show_slice, now);
+	u64 freq  = bsp_get_slice_freq();
+	u64 bytes = (u32)(stat->sum_len - stat->sum_len_prev);
+
+	icc_print_info("throughput  : %llu B/s\n", delta ? div_u64(bytes * freq, delta) : 0);
+	icc_print_info("latency avg : %llu us\n", stat->lat_cnt ?
+		div_u64((u64)(stat->lat_sum / stat->lat_cnt) * 1000000, (u32)freq) : 0);
+	icc_print_info("latency max : %llu us\n", div_u64((u64)stat->lat_max * 1000000, (u32)freq));
+	stat->sum_len_prev = stat->sum_len;
+	stat->show_slice   = now;
+}
+
 /* msg_type: 0, recv; 1, send */
 void icc_channel_info_show(u32 msg_type, u32 real_channel_id)
 {
@@ -372,6 +389,7 @@ void icc_channel_info_show(u32 msg_type, u32 real_channel_id)
 	icc_print_info("msg_num     : 0x%x\n", channel->total.sum_num);
 	icc_print_info("msg_num_prev: 0x%x\n", channel->total.sum_num_prev);
 	icc_print_info("func_size   : 0x%x\n", channel->func_size);
+	icc_channel_perf_show(&channel->total);
 	channel->total.sum_num_prev = channel->total.sum_num;
 }
 
@@ -385,6 +403,7 @@ void icc_sub_channel_info_show(u32 msg_type, u32 real_channel_id, u32 func_id)
 	icc_print_info("msg_len     : 0x%x\n", channel->sub_chn[func_id].sum_len);
 	icc_print_info("msg_num     : 0x%x\n", channel->sub_chn[func_id].sum_num);
 	icc_print_info("sum_num_prev: 0x%x\n", channel->sub_chn[func_id].sum_num_prev);
+	icc_channel_perf_show(&channel->sub_chn[func_id]);
 	channel->sub_chn[func_id].sum_num_prev = channel->sub_chn[func_id].sum_num;
 }
 
@@ -576,6 +595,27 @@ static void icc_channel_msg_stat(struct icc_channel_stat_info *channel, u32 msg_
 	channel->sum_num++;
 }
 
+#define ICC_PERF_COUNT_MAX (10000)
+static void icc_channel_lat_stat(struct icc_channel_stat_info *channel, u32 delta_slice)
+{
+	if(!channel)
+	{
+		return;
+	}
+	if (channel->lat_cnt >= ICC_PERF_COUNT_MAX)
+	{
+		channel->lat_cnt = 0;
+		channel->lat_sum = 0;
+		channel->lat_max = 0;
+	}
+	channel->lat_cnt++;
+	channel->lat_sum += delta_slice;
+	if (delta_slice > channel->lat_max)
+	{
+		channel->lat_max = delta_slice;
+	}
+}
+
 void icc_debug_in_isr(void)
 {
 	g_icc_dbg.ipc_int_cnt++;
@@ -607,6 +647,8 @@ void icc_debug_after_send(struct icc_channel *channel, struct icc_channel_packet
 	icc_send_msg_queue_in(&(g_icc_dbg.msg_stat.send), &msg_tx);
 	icc_channel_msg_stat(&(g_icc_dbg.channel_stat[GET_CHN_ID(msg_tx.channel_id)]->send.total), msg_tx.len, msg_tx.send_task_id);
 	icc_channel_msg_stat(&(g_icc_dbg.channel_stat[GET_CHN_ID(msg_tx.channel_id)]->send.sub_chn[GET_FUNC_ID(msg_tx.channel_id)]), msg_tx.len, msg_tx.send_task_id);
+	icc_channel_lat_stat(&(g_icc_dbg.channel_stat[GET_CHN_ID(msg_tx.channel_id)]->send.total),
+		get_timer_slice_delta(msg_tx.duration_prev, msg_tx.duration_post));
 
 	icc_dbg_info_print("fifo_send", msg_tx.channel_id, data, packet->len);
 }
@@ -632,7 +674,6 @@ void icc_debug_in_read_cb(u32 channel_id, u8 *buf, u32 buf_len, u32 read_ptr, u3
 	icc_dbg_info_print("fifo_recv", channel_id, buf, buf_len);
 }
 
-#define ICC_PERF_COUNT_MAX (10000)
 void icc_debug_after_recv(struct icc_channel_packet *pkg_header)
 {
     u32 delta_slice = 0;
@@ -661,6 +702,8 @@ void icc_debug_after_recv(struct icc_channel_packet *pkg_header)
 	icc_channel_msg_stat(&(g_icc_dbg.channel_stat[GET_CHN_ID(channel_id)]->recv.total), msg_rx.len, msg_rx.recv_task_id);
 	icc_channel_msg_stat(&(g_icc_dbg.channel_stat[GET_CHN_ID(channel_id)]->recv.sub_chn[GET_FUNC_ID(channel_id)]), \
 		msg_rx.len, msg_rx.recv_task_id);
+	icc_channel_lat_stat(&(g_icc_dbg.channel_stat[GET_CHN_ID(channel_id)]->recv.total), delta_slice);
+	icc_channel_lat_stat(&(g_icc_dbg.channel_stat[GET_CHN_ID(channel_id)]->recv.sub_chn[GET_FUNC_ID(channel_id)]), delta_slice);
 }
 
 
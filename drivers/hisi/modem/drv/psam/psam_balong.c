@@ -289,6 +289,7 @@ int psam_reinit_regs(void)
 
 	for (i = 0; i < PSAM_ADQ_NUM; i++) {
 		writel(g_psam_device->dma[i], g_psam_device->regs + HI_PSAM_ADQ_BASE_OFFSET(i));
+		g_psam_device->adq_wptr[i] = readl(g_psam_device->regs + HI_PSAM_ADQ_WPTR_OFFSET(i));
 	}
 	writel(PSAM_INT_MASK, g_psam_device->regs + HI_PSAM_INT0_MASK_OFFSET);
 	writel(0xffffffff, g_psam_device->regs + HI_PSAM_INT0_STAT_OFFSET);
@@ -328,7 +329,7 @@ int psam_get_dlad_num(unsigned int* ad0_num, unsigned int* ad1_num)
 	ad[0] = ad0_num;
 	ad[1] = ad1_num;
 	for (i = 0; i < PSAM_ADQ_NUM; i++) {
-		wptr = readl(g_psam_device->regs + HI_PSAM_ADQ_WPTR_OFFSET(i));
+		wptr = g_psam_device->adq_wptr[i];
 		rptr = readl(g_psam_device->regs + HI_PSAM_ADQ_RPTR_OFFSET(i));
 
 		*ad[i] = (g_psam_device->desc_num[i] + rptr -(wptr + PSAM_ADQ_RESERVE_NUM)) % g_psam_device->desc_num[i];
@@ -364,7 +365,7 @@ int psam_config_dlad(unsigned int type, unsigned int num, psam_ad_desc_s *desc)
 		return -EINVAL;
 	}
 
-	wptr = readl(g_psam_device->regs + HI_PSAM_ADQ_WPTR_OFFSET(type));
+	wptr = g_psam_device->adq_wptr[type];
 
 	for (i=0; i < num; i++) {
 		/*usr feild should not be zero*/
@@ -378,6 +379,7 @@ int psam_config_dlad(unsigned int type, unsigned int num, psam_ad_desc_s *desc)
 		cur++;
 	}
 	g_psam_device->debug.cfg_dl_ad_succ[type] += i;
+	g_psam_device->adq_wptr[type] = wptr;
 	writel(wptr, g_psam_device->regs + HI_PSAM_ADQ_WPTR_OFFSET(type));
 	/*g_psam_device->debug.*/
 	return 0;
@@ -473,6 +475,7 @@ static int psam_probe(struct platform_device *pdev)
 		if (psam->desc[i] == NULL)
 			return -ENOMEM;
 		writel(psam->dma[i], psam->regs + HI_PSAM_ADQ_BASE_OFFSET(i));
+		psam->adq_wptr[i] = readl(psam->regs + HI_PSAM_ADQ_WPTR_OFFSET(i));
 	}
 
 	psam->adq0_info.vir_addr = (unsigned int)(unsigned long)(psam->desc[0]);
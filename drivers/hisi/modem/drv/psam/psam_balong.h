@@ -143,6 +143,7 @@ struct psam_device {
 	dma_addr_t		dma[PSAM_ADQ_NUM];
 	psam_ad_desc_s	*desc[PSAM_ADQ_NUM];
 	unsigned int 	desc_num[PSAM_ADQ_NUM];
+	unsigned int 	adq_wptr[PSAM_ADQ_NUM];	/* shadow of the AD write pointers, only software moves them */
 	unsigned int 	mem[PSAM_ADQ_NUM];
 	int			irq;
 	unsigned int irq_flags;
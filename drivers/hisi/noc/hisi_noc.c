@@ -29,6 +29,7 @@
 #include <linux/string.h>
 #include <linux/clk.h>
 #include <linux/hisi/util.h>
+#include <linux/hisi/hisi_boot_initcall.h>
 
 #include <linux/hisi/rdr_hisi_platform.h>
 #include "hisi_noc.h"
@@ -1521,5 +1522,6 @@ static void __exit hisi_noc_exit(void)
 	platform_driver_unregister(&hisi_noc_driver);
 }
 
-late_initcall(hisi_noc_init);
+/* only reports bus errors, nothing waits for it */
+hisi_async_late_initcall(hisi_noc_init);
 module_exit(hisi_noc_exit);
@@ -0,0 +1,434 @@
+/*
+* NoC. (NoC QoS Module.)
+*
+* Copyright (c) 2018 Huawei Technologies CO., Ltd.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License version 2 as
+* published by the Free Software Foundation.
+*/
+
+#include <linux/module.h>
+#include <linux/io.h>
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/err.h>
+#include <linux/device.h>
+#include <linux/mutex.h>
+#include <linux/of_address.h>
+#include <linux/of_platform.h>
+#include <linux/string.h>
+#include <linux/hisi/hisi_noc_qos.h>
+
+#include "hisi_noc.h"
+#include "hisi_noc_transcation.h"
+
+/*
+ * Each initiator of the NoC has a QoS generator. It sets the arbitration
+ * priority of the initiator's packets and, in limiter or regulator mode,
+ * caps its bandwidth.
+ *
+ * Every child of the "hisilicon,noc-qos" node describes one generator:
+ *
+ *	gpu {
+ *		reg = <...>;
+ *		hisilicon,noc-node = "gpu_bus";		(optional power check)
+ *		hisilicon,trans-probe = "gpu_trans";	(optional latency bins)
+ *		hisilicon,qos-frame = <mode priority bandwidth saturation>;
+ *		hisilicon,qos-capture = <...>;
+ *	};
+ *
+ * The default profile is whatever the generator held at probe. A master
+ * without settings for a profile keeps its default there, which is how
+ * background masters get limited: give them a limiter entry in the frame
+ * and capture profiles.
+ */
+#define NOC_QOS_PRIORITY	(0x0008)
+#define NOC_QOS_MODE		(0x000c)
+#define NOC_QOS_BANDWIDTH	(0x0010)
+#define NOC_QOS_SATURATION	(0x0014)
+
+#define NOC_QOS_TRANS_BINS	4
+
+struct noc_qos_setting {
+	bool valid;
+	unsigned int mode;
+	unsigned int priority;
+	unsigned int bandwidth;
+	unsigned int saturation;
+};
+
+struct noc_qos_master {
+	const char *name;
+	void __iomem *base;
+	const char *noc_node;
+	const char *trans_probe;
+	bool pending;
+	struct noc_qos_setting setting[NOC_QOS_PROFILE_NR];
+};
+
+struct noc_qos_device {
+	struct device *dev;
+	struct mutex lock;
+	unsigned int votes[NOC_QOS_PROFILE_NR];
+	enum noc_qos_profile profile;
+	bool user_vote;
+	enum noc_qos_profile user_profile;
+	unsigned int nr_masters;
+	struct noc_qos_master *masters;
+};
+
+static struct noc_qos_device *g_noc_qos;
+
+static const char *const noc_qos_profile_names[NOC_QOS_PROFILE_NR] = {
+	[NOC_QOS_DEFAULT]	= "default",
+	[NOC_QOS_FRAME]		= "frame",
+	[NOC_QOS_CAPTURE]	= "capture",
+};
+
+static const char *const noc_qos_profile_props[NOC_QOS_PROFILE_NR] = {
+	[NOC_QOS_FRAME]		= "hisilicon,qos-frame",
+	[NOC_QOS_CAPTURE]	= "hisilicon,qos-capture",
+};
+
+static bool noc_qos_master_powered(struct noc_qos_master *m)
+{
+	struct noc_node *node;
+
+	if (!m->noc_node)
+		return true;
+
+	node = get_probe_node(m->noc_node);
+	if (!node)
+		return true;
+
+	return is_noc_node_available(node) ? true : false;
+}
+
+static void noc_qos_master_apply(struct noc_qos_master *m,
+				 enum noc_qos_profile profile)
+{
+	struct noc_qos_setting *s = &m->setting[profile];
+
+	if (!s->valid)
+		s = &m->setting[NOC_QOS_DEFAULT];
+
+	if (!noc_qos_master_powered(m)) {
+		m->pending = true;
+		return;
+	}
+
+	/* bandwidth and saturation first, the mode switch latches them */
+	writel_relaxed(s->bandwidth, (char *)m->base + NOC_QOS_BANDWIDTH);
+	writel_relaxed(s->saturation, (char *)m->base + NOC_QOS_SATURATION);
+	writel_relaxed(s->priority, (char *)m->base + NOC_QOS_PRIORITY);
+	writel_relaxed(s->mode, (char *)m->base + NOC_QOS_MODE);
+	wmb();
+	m->pending = false;
+
+	/* restart the latency bins so they cover the new setting only */
+	if (m->trans_probe)
+		enable_transcation_probe_by_name(m->trans_probe);
+}
+
+/* caller holds qos->lock */
+static void noc_qos_update(struct noc_qos_device *qos)
+{
+	enum noc_qos_profile profile = NOC_QOS_DEFAULT;
+	unsigned int i;
+	int p;
+
+	for (p = NOC_QOS_PROFILE_NR - 1; p > NOC_QOS_DEFAULT; p--) {
+		if (qos->votes[p]) {
+			profile = p;
+			break;
+		}
+	}
+
+	if (profile == qos->profile)
+		return;
+
+	for (i = 0; i < qos->nr_masters; i++)
+		noc_qos_master_apply(&qos->masters[i], profile);
+	qos->profile = profile;
+}
+
+/**
+ * hisi_noc_qos_get - hold a QoS profile until hisi_noc_qos_put()
+ * @profile: NOC_QOS_FRAME for frame-critical display/GPU work,
+ *           NOC_QOS_CAPTURE for camera capture
+ */
+int hisi_noc_qos_get(enum noc_qos_profile profile)
+{
+	struct noc_qos_device *qos = g_noc_qos;
+
+	if (profile <= NOC_QOS_DEFAULT || profile >= NOC_QOS_PROFILE_NR)
+		return -EINVAL;
+	if (!qos)
+		return -ENODEV;
+
+	mutex_lock(&qos->lock);
+	qos->votes[profile]++;
+	noc_qos_update(qos);
+	mutex_unlock(&qos->lock);
+
+	return 0;
+}
+EXPORT_SYMBOL(hisi_noc_qos_get);
+
+void hisi_noc_qos_put(enum noc_qos_profile profile)
+{
+	struct noc_qos_device *qos = g_noc_qos;
+
+	if (profile <= NOC_QOS_DEFAULT || profile >= NOC_QOS_PROFILE_NR || !qos)
+		return;
+
+	mutex_lock(&qos->lock);
+	if (!WARN_ON(!qos->votes[profile]))
+		qos->votes[profile]--;
+	noc_qos_update(qos);
+	mutex_unlock(&qos->lock);
+}
+EXPORT_SYMBOL(hisi_noc_qos_put);
+
+/*
+ * QoS generators in a power domain that was off during a profile switch
+ * lose the setting. The domain's power-up path calls this to catch up.
+ */
+void hisi_noc_qos_restore(void)
+{
+	struct noc_qos_device *qos = g_noc_qos;
+	unsigned int i;
+
+	if (!qos)
+		return;
+
+	mutex_lock(&qos->lock);
+	for (i = 0; i < qos->nr_masters; i++) {
+		if (qos->masters[i].noc_node || qos->masters[i].pending)
+			noc_qos_master_apply(&qos->masters[i], qos->profile);
+	}
+	mutex_unlock(&qos->lock);
+}
+EXPORT_SYMBOL(hisi_noc_qos_restore);
+
+static ssize_t profile_show(struct device *dev,
+			    struct device_attribute *attr, char *buf)
+{
+	struct noc_qos_device *qos = dev_get_drvdata(dev);
+	ssize_t count = 0;
+	int p;
+
+	mutex_lock(&qos->lock);
+	for (p = 0; p < NOC_QOS_PROFILE_NR; p++)
+		count += scnprintf(buf + count, PAGE_SIZE - count, "%s%s %u\n",
+				   (p == qos->profile) ? "->" : "  ",
+				   noc_qos_profile_names[p], qos->votes[p]);
+	mutex_unlock(&qos->lock);
+
+	return count;
+}
+
+/* userspace holds at most one vote; "default" drops it */
+static ssize_t profile_store(struct device *dev,
+			     struct device_attribute *attr,
+			     const char *buf, size_t count)
+{
+	struct noc_qos_device *qos = dev_get_drvdata(dev);
+	int p;
+
+	for (p = 0; p < NOC_QOS_PROFILE_NR; p++) {
+		if (sysfs_streq(buf, noc_qos_profile_names[p]))
+			break;
+	}
+	if (p == NOC_QOS_PROFILE_NR)
+		return -EINVAL;
+
+	mutex_lock(&qos->lock);
+	if (qos->user_vote)
+		qos->votes[qos->user_profile]--;
+	qos->user_vote = (p != NOC_QOS_DEFAULT);
+	qos->user_profile = p;
+	if (qos->user_vote)
+		qos->votes[p]++;
+	noc_qos_update(qos);
+	mutex_unlock(&qos->lock);
+
+	return count;
+}
+
+/* per master: settings in use and the latency bins since they applied */
+static ssize_t masters_show(struct device *dev,
+			    struct device_attribute *attr, char *buf)
+{
+	struct noc_qos_device *qos = dev_get_drvdata(dev);
+	unsigned int bins[NOC_QOS_TRANS_BINS];
+	struct noc_qos_setting *s;
+	struct noc_qos_master *m;
+	ssize_t count = 0;
+	unsigned int i;
+
+	mutex_lock(&qos->lock);
+	for (i = 0; i < qos->nr_masters; i++) {
+		m = &qos->masters[i];
+		s = &m->setting[qos->profile];
+		if (!s->valid)
+			s = &m->setting[NOC_QOS_DEFAULT];
+
+		count += scnprintf(buf + count, PAGE_SIZE - count,
+				   "%s mode=%u prio=0x%x bw=0x%x sat=0x%x%s",
+				   m->name, s->mode, s->priority, s->bandwidth,
+				   s->saturation, m->pending ? " pending" : "");
+		if (m->trans_probe &&
+		    !read_transcation_probe_by_name(m->trans_probe, bins))
+			count += scnprintf(buf + count, PAGE_SIZE - count,
+					   " lat=%u/%u/%u/%u", bins[0], bins[1],
+					   bins[2], bins[3]);
+		count += scnprintf(buf + count, PAGE_SIZE - count, "\n");
+	}
+	mutex_unlock(&qos->lock);
+
+	return count;
+}
+
+static DEVICE_ATTR(profile, 0644, profile_show, profile_store);
+static DEVICE_ATTR(masters, 0444, masters_show, NULL);
+
+static struct attribute *noc_qos_attrs[] = {
+	&dev_attr_profile.attr,
+	&dev_attr_masters.attr,
+	NULL,
+};
+
+static const struct attribute_group noc_qos_attr_group = {
+	.attrs = noc_qos_attrs,
+};
+
+static int noc_qos_parse_master(struct noc_qos_master *m,
+				struct device_node *np)
+{
+	struct noc_qos_setting *def = &m->setting[NOC_QOS_DEFAULT];
+	u32 val[4];
+	int p;
+
+	m->name = np->name;
+	m->base = of_iomap(np, 0);
+	if (!m->base) {
+		pr_err("[%s]: %s iomap failed\n", __func__, np->name);
+		return -ENOMEM;
+	}
+	(void)of_property_read_string(np, "hisilicon,noc-node", &m->noc_node);
+	(void)of_property_read_string(np, "hisilicon,trans-probe",
+				      &m->trans_probe);
+
+	def->valid = true;
+	def->mode = readl_relaxed((char *)m->base + NOC_QOS_MODE);
+	def->priority = readl_relaxed((char *)m->base + NOC_QOS_PRIORITY);
+	def->bandwidth = readl_relaxed((char *)m->base + NOC_QOS_BANDWIDTH);
+	def->saturation = readl_relaxed((char *)m->base + NOC_QOS_SATURATION);
+
+	for (p = NOC_QOS_DEFAULT + 1; p < NOC_QOS_PROFILE_NR; p++) {
+		if (of_property_read_u32_array(np, noc_qos_profile_props[p],
+					       val, ARRAY_SIZE(val)))
+			continue;
+		m->setting[p].valid = true;
+		m->setting[p].mode = val[0];
+		m->setting[p].priority = val[1];
+		m->setting[p].bandwidth = val[2];
+		m->setting[p].saturation = val[3];
+	}
+
+	return 0;
+}
+
+static int hisi_noc_qos_probe(struct platform_device *pdev)
+{
+	struct device_node *np = pdev->dev.of_node;
+	struct noc_qos_device *qos;
+	struct device_node *child;
+	unsigned int i = 0;
+	int ret;
+
+	qos = devm_kzalloc(&pdev->dev, sizeof(*qos), GFP_KERNEL);
+	if (!qos)
+		return -ENOMEM;
+
+	qos->dev = &pdev->dev;
+	mutex_init(&qos->lock);
+	qos->nr_masters = of_get_child_count(np);
+	qos->masters = devm_kzalloc(&pdev->dev,
+			qos->nr_masters * sizeof(*qos->masters), GFP_KERNEL);
+	if (!qos->masters)
+		return -ENOMEM;
+
+	for_each_child_of_node(np, child) {
+		ret = noc_qos_parse_master(&qos->masters[i], child);
+		if (ret) {
+			of_node_put(child);
+			goto err_unmap;
+		}
+		i++;
+	}
+
+	platform_set_drvdata(pdev, qos);
+	ret = sysfs_create_group(&pdev->dev.kobj, &noc_qos_attr_group);
+	if (ret)
+		goto err_unmap;
+
+	g_noc_qos = qos;
+	pr_info("[%s]: %u masters\n", __func__, qos->nr_masters);
+	return 0;
+
+err_unmap:
+	while (i--)
+		iounmap(qos->masters[i].base);
+	return ret;
+}
+
+static int hisi_noc_qos_remove(struct platform_device *pdev)
+{
+	struct noc_qos_device *qos = platform_get_drvdata(pdev);
+	unsigned int i;
+
+	g_noc_qos = NULL;
+	sysfs_remove_group(&pdev->dev.kobj, &noc_qos_attr_group);
+
+	mutex_lock(&qos->lock);
+	for (i = 0; i < qos->nr_masters; i++) {
+		noc_qos_master_apply(&qos->masters[i], NOC_QOS_DEFAULT);
+		iounmap(qos->masters[i].base);
+	}
+	mutex_unlock(&qos->lock);
+
+	return 0;
+}
+
+static const struct of_device_id hisi_noc_qos_match[] = {
+	{.compatible = "hisilicon,noc-qos"},
+	{},
+};
+MODULE_DEVICE_TABLE(of, hisi_noc_qos_match);
+
+static struct platform_driver hisi_noc_qos_driver = {
+	.probe = hisi_noc_qos_probe,
+	.remove = hisi_noc_qos_remove,
+	.driver = {
+		   .name = "hisi-noc-qos",
+		   .owner = THIS_MODULE,
+		   .of_match_table = of_match_ptr(hisi_noc_qos_match),
+		   },
+};
+
+static int __init hisi_noc_qos_init(void)
+{
+	return platform_driver_register(&hisi_noc_qos_driver);
+}
+
+static void __exit hisi_noc_qos_exit(void)
+{
+	platform_driver_unregister(&hisi_noc_qos_driver);
+}
+
+late_initcall(hisi_noc_qos_init);
+module_exit(hisi_noc_qos_exit);
+MODULE_LICENSE("GPL v2");
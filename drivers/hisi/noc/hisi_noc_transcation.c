@@ -199,6 +199,30 @@ void disable_transcation_probe_by_name(const char *name)
 }
 EXPORT_SYMBOL(disable_transcation_probe_by_name);
 
+/*
+ * Read the four latency bins of a transaction probe. With the default
+ * thresholds they count transactions per latency range since the probe
+ * was last (re)enabled.
+ */
+int read_transcation_probe_by_name(const char *name, unsigned int *bins)
+{
+	struct noc_node *node;
+	void __iomem *base;
+
+	node = get_probe_node(name);
+	if (node == NULL || !is_noc_node_available(node))
+		return -ENODEV;
+
+	base = node->base + node->eprobe_offset;
+	bins[0] = (u32) readl_relaxed((char *)base + TRANS_M_COUNTERS_0_VAL);
+	bins[1] = (u32) readl_relaxed((char *)base + TRANS_M_COUNTERS_1_VAL);
+	bins[2] = (u32) readl_relaxed((char *)base + TRANS_M_COUNTERS_2_VAL);
+	bins[3] = (u32) readl_relaxed((char *)base + TRANS_M_COUNTERS_3_VAL);
+
+	return 0;
+}
+EXPORT_SYMBOL(read_transcation_probe_by_name);
+
 void config_transcation_probe(const char *name,
 			      const struct transcation_configration *tran_cfg)
 {
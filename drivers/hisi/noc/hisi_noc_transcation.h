@@ -57,4 +57,5 @@ void init_transcation_info(struct noc_node *node);
 void enable_transcation_probe_by_name(const char *name);
 void disable_transcation_probe_by_name(const char *name);
 void config_transcation_probe(const char *name, const struct transcation_configration *tran_cfg);
+int read_transcation_probe_by_name(const char *name, unsigned int *bins);
 #endif
@@ -9,11 +9,28 @@
 #include <linux/cpu.h>
 #include <linux/security.h>
 #include <linux/cpuset.h>
+#include <linux/cpufreq.h>
+#include <linux/topology.h>
+#include <linux/ioprio.h>
+#include <linux/pm_qos.h>
+#include <linux/miscdevice.h>
+#include <linux/fs.h>
+#include <linux/uaccess.h>
+#include <linux/compat.h>
+#include <linux/mutex.h>
+#include <linux/hisi/hisi_perfhub.h>
+#include <linux/hisi/hisi_hmpth.h>
+#ifdef CONFIG_HISI_DEVFREQ
+#include <linux/hisi/hisi_devfreq.h>
+#endif
 
 #define LITTLE_CPU_START 0
 #define BIG_CPU_START    4
 #define CPU_TOTAL        8
 
+#define PERFHUB_HMP_NAME	"perfhub"
+#define PERFHUB_HMP_PRIO	2	/* the performance priority of hmpth */
+
 static char g_last_tag;
 static int g_last_pid;
 
@@ -23,23 +40,13 @@ enum cpu_cluster {
 	CPU_CLUSTER_ALL,
 };
 
-static int bind_cpu_cluster(enum cpu_cluster e_cpu_cluster, pid_t pid)
+static int bind_cpu_mask(const struct cpumask *mask, pid_t pid)
 {
 	cpumask_var_t cpus_allowed, new_mask;
 	struct task_struct *p = NULL;
 	int retval;
-	struct cpumask mask;
-	int cpu_no;
 	const struct cred *pcred = NULL;
 
-	cpumask_clear(&mask);
-
-	switch (e_cpu_cluster) {
-		case CPU_CLUSTER_LITTLE: for (cpu_no = LITTLE_CPU_START; cpu_no < BIG_CPU_START; cpu_no++) cpumask_set_cpu(cpu_no, &mask); break;
-		case CPU_CLUSTER_BIG:    for (cpu_no = BIG_CPU_START; cpu_no < CPU_TOTAL; cpu_no++) cpumask_set_cpu(cpu_no, &mask); break;
-		default:                 for (cpu_no = LITTLE_CPU_START; cpu_no < CPU_TOTAL; cpu_no++) cpumask_set_cpu(cpu_no, &mask); break;
-	}
-
 	get_online_cpus();
 	rcu_read_lock();
 
@@ -73,7 +80,7 @@ static int bind_cpu_cluster(enum cpu_cluster e_cpu_cluster, pid_t pid)
 		goto out_unlock;
 
 	cpuset_cpus_allowed(p, cpus_allowed);
-	cpumask_and(new_mask, &mask, cpus_allowed);
+	cpumask_and(new_mask, mask, cpus_allowed);
 again:
 	retval = set_cpus_allowed_ptr(p, new_mask);
 
@@ -100,6 +107,324 @@ out_put_task:
 	return retval;
 }
 
+static int bind_cpu_cluster(enum cpu_cluster e_cpu_cluster, pid_t pid)
+{
+	struct cpumask mask;
+	int cpu_no;
+
+	cpumask_clear(&mask);
+
+	switch (e_cpu_cluster) {
+		case CPU_CLUSTER_LITTLE: for (cpu_no = LITTLE_CPU_START; cpu_no < BIG_CPU_START; cpu_no++) cpumask_set_cpu(cpu_no, &mask); break;
+		case CPU_CLUSTER_BIG:    for (cpu_no = BIG_CPU_START; cpu_no < CPU_TOTAL; cpu_no++) cpumask_set_cpu(cpu_no, &mask); break;
+		default:                 for (cpu_no = LITTLE_CPU_START; cpu_no < CPU_TOTAL; cpu_no++) cpumask_set_cpu(cpu_no, &mask); break;
+	}
+
+	return bind_cpu_mask(&mask, pid);
+}
+
+/*
+ * Scenes: userspace loads a table of named bundles (cpu/DDR/GPU floors,
+ * HMP thresholds, affinity and ioprio of the foreground tasks) once, and
+ * then switches between them with a single PERFHUB_IOC_SWITCH instead of
+ * a dozen sysfs writes. Everything below is serialized by perfhub_lock.
+ */
+static DEFINE_MUTEX(perfhub_lock);
+static struct perfhub_scene_table perfhub_table;
+static int perfhub_cur_scene = PERFHUB_SCENE_NONE;
+static pid_t perfhub_pids[PERFHUB_MAX_PIDS];
+static unsigned int perfhub_nr_pids;
+static unsigned int perfhub_cpu_floor[PERFHUB_MAX_CLUSTERS];
+static struct pm_qos_request perfhub_ddr_req;
+static bool perfhub_hmp_on;
+static unsigned int perfhub_hmp_up, perfhub_hmp_down;
+
+static int perfhub_cpufreq_notifier(struct notifier_block *nb,
+				    unsigned long val, void *data)
+{
+	struct cpufreq_policy *policy = data;
+	unsigned int floor;
+	int cluster;
+
+	if (val != CPUFREQ_ADJUST)
+		return NOTIFY_OK;
+
+	cluster = topology_physical_package_id(policy->cpu);
+	if (cluster < 0 || cluster >= PERFHUB_MAX_CLUSTERS)
+		return NOTIFY_OK;
+
+	floor = ACCESS_ONCE(perfhub_cpu_floor[cluster]);
+	if (floor && policy->min < floor)
+		policy->min = min(floor, policy->max);
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block perfhub_cpufreq_nb = {
+	.notifier_call = perfhub_cpufreq_notifier,
+};
+
+static void perfhub_set_cpu_floors(const unsigned int *floor)
+{
+	unsigned long done = 0;
+	int cpu, cluster;
+
+	if (!memcmp(perfhub_cpu_floor, floor, sizeof(perfhub_cpu_floor)))
+		return;
+	memcpy(perfhub_cpu_floor, floor, sizeof(perfhub_cpu_floor));
+
+	/* re-evaluate one policy per cluster, the notifier applies the floor */
+	get_online_cpus();
+	for_each_online_cpu(cpu) {
+		cluster = topology_physical_package_id(cpu);
+		if (cluster < 0 || cluster >= PERFHUB_MAX_CLUSTERS ||
+		    test_and_set_bit(cluster, &done))
+			continue;
+		cpufreq_update_policy(cpu);
+	}
+	put_online_cpus();
+}
+
+static void perfhub_set_hmp(unsigned int up, unsigned int down)
+{
+	if (up) {
+		if (!set_hmp_policy(PERFHUB_HMP_NAME, PERFHUB_HMP_PRIO, 1,
+				    up, down)) {
+			perfhub_hmp_on = true;
+			perfhub_hmp_up = up;
+			perfhub_hmp_down = down;
+		}
+	} else if (perfhub_hmp_on) {
+		set_hmp_policy(PERFHUB_HMP_NAME, PERFHUB_HMP_PRIO, 0,
+			       perfhub_hmp_up, perfhub_hmp_down);
+		perfhub_hmp_on = false;
+	}
+}
+
+static int perfhub_set_ioprio(pid_t pid, int ioprio)
+{
+	struct task_struct *p;
+	int ret;
+
+	rcu_read_lock();
+	p = find_task_by_vpid(pid);
+	if (!p) {
+		rcu_read_unlock();
+		return -ESRCH;
+	}
+	get_task_struct(p);
+	rcu_read_unlock();
+
+	ret = set_task_ioprio(p, ioprio);
+	put_task_struct(p);
+
+	return ret;
+}
+
+static void perfhub_scene_cpumask(const struct perfhub_scene *sc,
+				  struct cpumask *mask)
+{
+	int cpu;
+
+	if (!sc || !sc->cpus) {
+		cpumask_copy(mask, cpu_possible_mask);
+		return;
+	}
+
+	cpumask_clear(mask);
+	for_each_possible_cpu(cpu)
+		if (cpu < 64 && (sc->cpus & (1ULL << cpu)))
+			cpumask_set_cpu(cpu, mask);
+}
+
+/* the previous scene's tasks get all cpus and the default ioprio back */
+static void perfhub_release_tasks(const struct perfhub_scene *old)
+{
+	unsigned int i;
+
+	for (i = 0; i < perfhub_nr_pids; i++) {
+		if (old->cpus)
+			bind_cpu_mask(cpu_possible_mask, perfhub_pids[i]);
+		if (old->ioprio)
+			perfhub_set_ioprio(perfhub_pids[i], 0);
+	}
+	perfhub_nr_pids = 0;
+}
+
+static void perfhub_claim_tasks(const struct perfhub_scene *sc,
+				const pid_t *pids, unsigned int nr)
+{
+	struct cpumask mask;
+	unsigned int i;
+
+	perfhub_scene_cpumask(sc, &mask);
+	for (i = 0; i < nr; i++) {
+		if (sc->cpus && bind_cpu_mask(&mask, pids[i]))
+			pr_debug("perfhub: affinity of %d not set\n", pids[i]);
+		if (sc->ioprio && perfhub_set_ioprio(pids[i], sc->ioprio))
+			pr_debug("perfhub: ioprio of %d not set\n", pids[i]);
+		perfhub_pids[i] = pids[i];
+	}
+	perfhub_nr_pids = nr;
+}
+
+static void perfhub_switch_locked(int scene, const pid_t *pids,
+				  unsigned int nr)
+{
+	static const unsigned int no_floor[PERFHUB_MAX_CLUSTERS];
+	const struct perfhub_scene *sc = NULL;
+
+	if (scene != PERFHUB_SCENE_NONE)
+		sc = &perfhub_table.scenes[scene];
+
+	if (perfhub_cur_scene != PERFHUB_SCENE_NONE)
+		perfhub_release_tasks(&perfhub_table.scenes[perfhub_cur_scene]);
+
+	perfhub_set_cpu_floors(sc ? sc->cpu_min_freq : no_floor);
+	pm_qos_update_request(&perfhub_ddr_req,
+			      sc && sc->ddr_throughput > 0 ?
+			      sc->ddr_throughput : PM_QOS_DEFAULT_VALUE);
+#ifdef CONFIG_HISI_DEVFREQ
+	hisi_devfreq_set_gpu_floor(sc ? sc->gpu_min_freq : 0);
+#endif
+	perfhub_set_hmp(sc ? sc->hmp_up : 0, sc ? sc->hmp_down : 0);
+
+	if (sc)
+		perfhub_claim_tasks(sc, pids, nr);
+	perfhub_cur_scene = scene;
+}
+
+static int perfhub_check_scene(const struct perfhub_scene *sc)
+{
+	if (!memchr(sc->name, '\0', sizeof(sc->name)))
+		return -EINVAL;
+	if (sc->ddr_throughput < 0)
+		return -EINVAL;
+	/* same limits as hmpth, checked here so a switch cannot fail */
+	if (sc->hmp_up && (sc->hmp_up > 1024 || sc->hmp_down + 100 > sc->hmp_up))
+		return -EINVAL;
+	if (sc->ioprio && (IOPRIO_PRIO_CLASS(sc->ioprio) > IOPRIO_CLASS_IDLE ||
+			   IOPRIO_PRIO_DATA(sc->ioprio) >= IOPRIO_BE_NR))
+		return -EINVAL;
+	return 0;
+}
+
+static long perfhub_set_scenes(void __user *arg)
+{
+	struct perfhub_scene_table *table;
+	pid_t pids[PERFHUB_MAX_PIDS];
+	unsigned int nr_pids, i;
+	int scene, ret = 0;
+
+	table = kmalloc(sizeof(*table), GFP_KERNEL);
+	if (!table)
+		return -ENOMEM;
+	if (copy_from_user(table, arg, sizeof(*table))) {
+		ret = -EFAULT;
+		goto out;
+	}
+	if (table->nr > PERFHUB_MAX_SCENES) {
+		ret = -EINVAL;
+		goto out;
+	}
+	for (i = 0; i < table->nr; i++) {
+		ret = perfhub_check_scene(&table->scenes[i]);
+		if (ret)
+			goto out;
+	}
+
+	mutex_lock(&perfhub_lock);
+	/* drop the old definition, then enter the new one of the same index */
+	scene = perfhub_cur_scene;
+	nr_pids = perfhub_nr_pids;
+	memcpy(pids, perfhub_pids, sizeof(pids));
+	perfhub_switch_locked(PERFHUB_SCENE_NONE, NULL, 0);
+	perfhub_table = *table;
+	if (scene != PERFHUB_SCENE_NONE && scene < perfhub_table.nr)
+		perfhub_switch_locked(scene, pids, nr_pids);
+	mutex_unlock(&perfhub_lock);
+out:
+	kfree(table);
+	return ret;
+}
+
+static long perfhub_switch(void __user *arg)
+{
+	struct perfhub_switch sw;
+	int ret = 0;
+
+	if (copy_from_user(&sw, arg, sizeof(sw)))
+		return -EFAULT;
+	if (sw.nr_pids > PERFHUB_MAX_PIDS)
+		return -EINVAL;
+
+	mutex_lock(&perfhub_lock);
+	if (sw.scene < PERFHUB_SCENE_NONE || sw.scene >= (int)perfhub_table.nr)
+		ret = -EINVAL;
+	else
+		perfhub_switch_locked(sw.scene, sw.pids, sw.nr_pids);
+	mutex_unlock(&perfhub_lock);
+
+	return ret;
+}
+
+static long perfhub_ioctl(struct file *file, unsigned int cmd,
+			  unsigned long arg)
+{
+	void __user *uarg = (void __user *)arg;
+	int scene;
+
+	switch (cmd) {
+	case PERFHUB_IOC_SET_SCENES:
+		return perfhub_set_scenes(uarg);
+	case PERFHUB_IOC_SWITCH:
+		return perfhub_switch(uarg);
+	case PERFHUB_IOC_GET_SCENE:
+		scene = ACCESS_ONCE(perfhub_cur_scene);
+		return put_user(scene, (__s32 __user *)uarg);
+	default:
+		return -ENOTTY;
+	}
+}
+
+#ifdef CONFIG_COMPAT
+static long perfhub_compat_ioctl(struct file *file, unsigned int cmd,
+				 unsigned long arg)
+{
+	/* the structures have the same layout for 32-bit callers */
+	return perfhub_ioctl(file, cmd, (unsigned long)compat_ptr(arg));
+}
+#endif
+
+static const struct file_operations perfhub_fops = {
+	.owner = THIS_MODULE,
+	.unlocked_ioctl = perfhub_ioctl,
+#ifdef CONFIG_COMPAT
+	.compat_ioctl = perfhub_compat_ioctl,
+#endif
+};
+
+static struct miscdevice perfhub_miscdev = {
+	.minor = MISC_DYNAMIC_MINOR,
+	.name = "perfhub",
+	.fops = &perfhub_fops,
+};
+
+static ssize_t perfhub_scene_show(struct kobject *kobj, struct kobj_attribute *attr, char *buf)
+{
+	ssize_t ret;
+
+	mutex_lock(&perfhub_lock);
+	if (perfhub_cur_scene == PERFHUB_SCENE_NONE)
+		ret = snprintf(buf, PAGE_SIZE, "none\n");
+	else
+		ret = snprintf(buf, PAGE_SIZE, "%s\n",
+			       perfhub_table.scenes[perfhub_cur_scene].name);
+	mutex_unlock(&perfhub_lock);
+
+	return ret;
+}
+
 static ssize_t perfhub_show(struct kobject *kobj, struct kobj_attribute *attr, char *buf)
 {
 	return snprintf(buf, PAGE_SIZE, "%c|%d\n", g_last_tag, g_last_pid);
@@ -144,6 +469,7 @@ static ssize_t perfhub_store(struct kobject *kobj, struct kobj_attribute *attr,
 }
 
 struct kobj_attribute perfhub_attribute = __ATTR(cpuaffinity, 0660, perfhub_show, perfhub_store);
+struct kobj_attribute perfhub_scene_attribute = __ATTR(scene, 0444, perfhub_scene_show, NULL);
 
 struct kobject *perfhub_kobj = NULL;
 
@@ -156,10 +482,37 @@ static int __init perfhub_init(void)
 		return -ENOMEM;
 
 	retval = sysfs_create_file(perfhub_kobj, &perfhub_attribute.attr);
-	if (retval) {
-		kobject_put(perfhub_kobj);
-		perfhub_kobj = NULL;
-	}
+	if (retval)
+		goto err_kobj;
+
+	retval = sysfs_create_file(perfhub_kobj, &perfhub_scene_attribute.attr);
+	if (retval)
+		goto err_affinity;
+
+	pm_qos_add_request(&perfhub_ddr_req, PM_QOS_MEMORY_THROUGHPUT,
+			   PM_QOS_MEMORY_THROUGHPUT_DEFAULT_VALUE);
+
+	retval = cpufreq_register_notifier(&perfhub_cpufreq_nb,
+					   CPUFREQ_POLICY_NOTIFIER);
+	if (retval)
+		goto err_qos;
+
+	retval = misc_register(&perfhub_miscdev);
+	if (retval)
+		goto err_notifier;
+
+	return 0;
+
+err_notifier:
+	cpufreq_unregister_notifier(&perfhub_cpufreq_nb, CPUFREQ_POLICY_NOTIFIER);
+err_qos:
+	pm_qos_remove_request(&perfhub_ddr_req);
+	sysfs_remove_file(perfhub_kobj, &perfhub_scene_attribute.attr);
+err_affinity:
+	sysfs_remove_file(perfhub_kobj, &perfhub_attribute.attr);
+err_kobj:
+	kobject_put(perfhub_kobj);
+	perfhub_kobj = NULL;
 
 	return retval;
 }
@@ -167,6 +520,14 @@ static int __init perfhub_init(void)
 static void __exit perfhub_exit(void)
 {
 	if (perfhub_kobj) {
+		misc_deregister(&perfhub_miscdev);
+		mutex_lock(&perfhub_lock);
+		perfhub_switch_locked(PERFHUB_SCENE_NONE, NULL, 0);
+		mutex_unlock(&perfhub_lock);
+		cpufreq_unregister_notifier(&perfhub_cpufreq_nb,
+					    CPUFREQ_POLICY_NOTIFIER);
+		pm_qos_remove_request(&perfhub_ddr_req);
+		sysfs_remove_file(perfhub_kobj, &perfhub_scene_attribute.attr);
 		sysfs_remove_file(perfhub_kobj, &perfhub_attribute.attr);
 		kobject_put(perfhub_kobj);
 		perfhub_kobj = NULL;
@@ -34,8 +34,6 @@
 	(((paramTypes) >> (4*(index))) & 0x0F)
 #define ROUND_UP(N, S) ((((N) + (S) - 1) / (S)) * (S))
 
-struct ion_handle *drm_ion_handle;
-
 int tc_user_param_valid(TC_NS_ClientContext *client_context, int n)
 {
 	TC_NS_ClientParam *client_param;
@@ -186,7 +184,7 @@ static TC_NS_Operation *alloc_operation(TC_NS_DEV_File *dev_file,
 	TC_NS_Operation *operation;
 	TC_NS_ClientParam *client_param;
 	TC_NS_Shared_MEM *shared_mem = NULL;
-	ion_phys_addr_t drm_ion_phys = 0x0;
+	phys_addr_t drm_ion_phys = 0x0;
 	size_t drm_ion_size = 0;
 	int ret = 0;
 	unsigned int param_type;
@@ -255,6 +253,23 @@ static TC_NS_Operation *alloc_operation(TC_NS_DEV_File *dev_file,
 				ret = -EFAULT;
 				break;
 			}
+			/* Large user buffers go to the TEE in place */
+			if (tc_mem_use_pagelist(kernel_params, buffer_size)) {
+				ret = tc_mem_pin_user(&local_temp_buffer[i],
+						(unsigned long)client_param->memref.buffer,
+						buffer_size,
+						TEEC_MEMREF_TEMP_INPUT != param_type);
+				if (ret)
+					break;
+				temp_buf = local_temp_buffer[i].page_list;
+				operation->params[i].memref.buffer = virt_to_phys(temp_buf);
+				operation->buffer_h_addr[i] = virt_to_phys(temp_buf) >> 32;
+				operation->params[i].memref.size = buffer_size;
+				trans_paramtype_to_tee[i] = param_type +
+					(TEE_PARAM_TYPE_PAGELIST_INPUT -
+					 TEE_PARAM_TYPE_MEMREF_INPUT);
+				continue;
+			}
 			/* Don't allow unbounded malloc requests */
 			if (buffer_size > MAX_SHARED_SIZE) {
 				tloge("buffer_size %u from user is too large\n",
@@ -410,25 +425,14 @@ static TC_NS_Operation *alloc_operation(TC_NS_DEV_File *dev_file,
 			if ((int)operation->params[i].value.a >= 0) {
 				unsigned int ion_shared_fd =
 					operation->params[i].value.a;
-				drm_ion_handle =
-					ion_import_dma_buf(drm_ion_client,
-							   ion_shared_fd);
-				if (IS_ERR(drm_ion_handle)) {
-					tloge("in %s err: client=%p handle=%p fd=%d\n",
-					      __func__, drm_ion_client,
-					      drm_ion_handle, ion_shared_fd);
-					ret = -EFAULT;
-					break;
-				}
-
-
-				ret = ion_phys(drm_ion_client, drm_ion_handle,
-					       &drm_ion_phys, &drm_ion_size);
 
+				/* imports are cached per client */
+				ret = tc_ion_reg_get(dev_file, ion_shared_fd,
+						     &drm_ion_phys, &drm_ion_size);
 				if (ret) {
-					tloge("in %s err:ret=%d client=%p handle=%p fd=%d\n",
+					tloge("in %s err:ret=%d client=%p fd=%d\n",
 					      __func__, ret, drm_ion_client,
-					      drm_ion_handle, ion_shared_fd);
+					      ion_shared_fd);
 					ret = -EFAULT;
 					break;
 				}
@@ -441,8 +445,6 @@ static TC_NS_Operation *alloc_operation(TC_NS_DEV_File *dev_file,
 				operation->params[i].memref.size =
 					(unsigned int)drm_ion_size;
 				trans_paramtype_to_tee[i] = param_type;
-				ion_free(drm_ion_client, drm_ion_handle);
-				drm_ion_handle = NULL;
 			} else {
 				tloge("in %s err: drm ion handle invaild!\n", __func__);
 				ret = -EFAULT;
@@ -514,6 +516,10 @@ static int update_client_operation(TC_NS_DEV_File *dev_file,
 				break;
 			}
 
+			/* the TEE wrote straight into the client pages */
+			if (local_temp_buffer[i].pinned)
+				continue;
+
 			/* Only update the buffer is the buffer size is valid in
 			 * incomplete case, otherwise see next param */
 			if (buffer_size > local_temp_buffer[i].size) {
@@ -598,6 +604,11 @@ static int free_operation(TC_NS_ClientContext *client_context,
 		if ((TEEC_MEMREF_TEMP_INPUT == param_type) ||
 		    (TEEC_MEMREF_TEMP_OUTPUT == param_type) ||
 		    (TEEC_MEMREF_TEMP_INOUT == param_type)) {
+			if (local_temp_buffer[i].pinned) {
+				tc_mem_unpin_user(&local_temp_buffer[i],
+					TEEC_MEMREF_TEMP_INPUT != param_type);
+				continue;
+			}
 			/* free temp buffer */
 			/* TODO: this is all sorts of bad */
 			temp_buf = local_temp_buffer[i].temp_buffer;
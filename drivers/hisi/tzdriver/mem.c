@@ -17,6 +17,10 @@
 #include <linux/freezer.h>
 #include <linux/module.h>
 #include <linux/mempool.h>
+#include <linux/mm.h>
+#include <linux/dma-buf.h>
+#include <linux/ion.h>
+#include <linux/hisi/hisi_ion.h>
 
 #include "mem.h"
 #include "smc.h"
@@ -25,6 +29,7 @@
 #include "agent.h"
 #include "securec.h"
 #include "tc_ns_log.h"
+#include "gp_ops.h"
 
 #define ROUND_UP(N, S) ((((N) + (S) - 1) / (S)) * (S))
 
@@ -32,6 +37,19 @@ static DEFINE_MUTEX(prealloc_lock);
 /************global reference end*************/
 static void *g_mem_pre_allocated;
 static mempool_t *tc_sharemem_page_pool = NULL;
+/* secure OS understands TEE_PARAM_TYPE_PAGELIST_* memrefs */
+static bool tc_pagelist_supported;
+
+struct tc_ion_reg {
+	struct list_head head;
+	struct dma_buf *dmabuf;
+	struct ion_handle *handle;
+	ion_phys_addr_t phys;
+	size_t size;
+};
+
+#define PAGELIST_ORDER(nr) \
+	get_order(sizeof(struct tc_pagelist) + (nr) * sizeof(uint64_t))
 
 void tc_mem_free(TC_NS_Shared_MEM *shared_mem)
 {
@@ -106,9 +124,190 @@ TC_NS_Shared_MEM *tc_mem_allocate(TC_NS_DEV_File *dev, size_t len)
 	return shared_mem;
 }
 
+bool tc_mem_use_pagelist(uint8_t kernel_api, uint32_t size)
+{
+	/* kernel clients may hand in vmalloc or stack buffers, keep copying */
+	return tc_pagelist_supported && !kernel_api &&
+		size >= PAGELIST_MIN_SIZE && size <= PAGELIST_MAX_SIZE;
+}
+
+/*
+ * Pin the client buffer and describe it to the TEE as a list of page
+ * addresses, instead of copying it into a physically contiguous kernel
+ * buffer for every invocation.
+ */
+int tc_mem_pin_user(TC_NS_Temp_Buf *buf, unsigned long uaddr,
+		    uint32_t size, bool write)
+{
+	unsigned long first = uaddr >> PAGE_SHIFT;
+	unsigned long last = (uaddr + size - 1) >> PAGE_SHIFT;
+	unsigned int nr = last - first + 1;
+	struct tc_pagelist *list;
+	struct page **pages;
+	int pinned, i;
+
+	if (!buf || !size)
+		return -EINVAL;
+
+	pages = kcalloc(nr, sizeof(*pages), GFP_KERNEL);
+	if (!pages)
+		return -ENOMEM;
+
+	list = (struct tc_pagelist *)__get_free_pages(GFP_KERNEL,
+						      PAGELIST_ORDER(nr));
+	if (!list) {
+		kfree(pages);
+		return -ENOMEM;
+	}
+
+	pinned = get_user_pages_fast(uaddr, nr, write, pages);
+	if (pinned != nr) {
+		tloge("pinned %d of %u client pages\n", pinned, nr);
+		for (i = 0; i < pinned; i++)
+			put_page(pages[i]);
+		free_pages((unsigned long)list, PAGELIST_ORDER(nr));
+		kfree(pages);
+		return -EFAULT;
+	}
+
+	list->nr_pages = nr;
+	list->offset = uaddr & ~PAGE_MASK;
+	for (i = 0; i < nr; i++)
+		list->phys[i] = page_to_phys(pages[i]);
+
+	buf->pinned = true;
+	buf->pages = pages;
+	buf->nr_pages = nr;
+	buf->page_list = list;
+	buf->size = size;
+	return 0;
+}
+
+void tc_mem_unpin_user(TC_NS_Temp_Buf *buf, bool dirty)
+{
+	unsigned int i;
+
+	if (!buf || !buf->pinned)
+		return;
+
+	for (i = 0; i < buf->nr_pages; i++) {
+		if (dirty)
+			set_page_dirty_lock(buf->pages[i]);
+		put_page(buf->pages[i]);
+	}
+	free_pages((unsigned long)buf->page_list, PAGELIST_ORDER(buf->nr_pages));
+	kfree(buf->pages);
+
+	buf->pinned = false;
+	buf->pages = NULL;
+	buf->page_list = NULL;
+	buf->nr_pages = 0;
+}
+
+static void tc_ion_reg_free(struct tc_ion_reg *reg)
+{
+	ion_free(drm_ion_client, reg->handle);
+	dma_buf_put(reg->dmabuf);
+	kfree(reg);
+}
+
+/*
+ * DRM clients cycle through a small set of ION buffers. Keep the import
+ * of each one around, keyed by its dma_buf, so that later invocations
+ * skip the import and the physical address lookup. The cached handle
+ * also keeps the buffer alive while the TEE may still use it.
+ */
+int tc_ion_reg_get(TC_NS_DEV_File *dev, int fd,
+		   phys_addr_t *phys, size_t *size)
+{
+	struct tc_ion_reg *reg, *victim;
+	struct dma_buf *dmabuf;
+	int ret;
+
+	if (!dev || !phys || !size)
+		return -EINVAL;
+
+	dmabuf = dma_buf_get(fd);
+	if (IS_ERR(dmabuf))
+		return PTR_ERR(dmabuf);
+
+	mutex_lock(&dev->ion_reg_lock);
+	list_for_each_entry(reg, &dev->ion_reg_list, head) {
+		if (reg->dmabuf == dmabuf) {
+			list_move(&reg->head, &dev->ion_reg_list);
+			*phys = reg->phys;
+			*size = reg->size;
+			mutex_unlock(&dev->ion_reg_lock);
+			dma_buf_put(dmabuf);
+			return 0;
+		}
+	}
+	mutex_unlock(&dev->ion_reg_lock);
+
+	reg = kzalloc(sizeof(*reg), GFP_KERNEL);
+	if (!reg) {
+		dma_buf_put(dmabuf);
+		return -ENOMEM;
+	}
+
+	reg->handle = ion_import_dma_buf(drm_ion_client, fd);
+	if (IS_ERR(reg->handle)) {
+		tloge("ion import failed: client=%p fd=%d\n", drm_ion_client, fd);
+		ret = PTR_ERR(reg->handle);
+		goto free_reg;
+	}
+
+	ret = ion_phys(drm_ion_client, reg->handle, &reg->phys, &reg->size);
+	if (ret) {
+		tloge("ion_phys failed: ret=%d fd=%d\n", ret, fd);
+		ion_free(drm_ion_client, reg->handle);
+		goto free_reg;
+	}
+	reg->dmabuf = dmabuf;
+	*phys = reg->phys;
+	*size = reg->size;
+
+	victim = NULL;
+	mutex_lock(&dev->ion_reg_lock);
+	list_add(&reg->head, &dev->ion_reg_list);
+	if (++dev->ion_reg_cnt > ION_REG_CACHE_NR) {
+		victim = list_last_entry(&dev->ion_reg_list,
+					 struct tc_ion_reg, head);
+		list_del(&victim->head);
+		dev->ion_reg_cnt--;
+	}
+	mutex_unlock(&dev->ion_reg_lock);
+
+	if (victim)
+		tc_ion_reg_free(victim);
+	return 0;
+
+free_reg:
+	kfree(reg);
+	dma_buf_put(dmabuf);
+	return ret;
+}
+
+void tc_ion_reg_release(TC_NS_DEV_File *dev)
+{
+	struct tc_ion_reg *reg, *tmp;
+
+	if (!dev)
+		return;
+
+	mutex_lock(&dev->ion_reg_lock);
+	list_for_each_entry_safe(reg, tmp, &dev->ion_reg_list, head) {
+		list_del(&reg->head);
+		tc_ion_reg_free(reg);
+	}
+	dev->ion_reg_cnt = 0;
+	mutex_unlock(&dev->ion_reg_lock);
+}
+
 int tc_mem_init(void)
 {
 	tlogi("tc_mem_init\n");
+	tc_pagelist_supported = of_property_read_bool(np, "hisi,tee-shm-pagelist");
 	/* pre-allocated memory for large use */
 	g_mem_pre_allocated = (void *)__get_free_pages(GFP_KERNEL | __GFP_ZERO,
 			      get_order(ROUND_UP
@@ -10,12 +10,33 @@
 #define MEM_POOL_ELEMENT_NR (8)
 #define MEM_POOL_ELEMENT_ORDER (4)
 
+/* temp memrefs in this range are pinned in place instead of copied */
+#define PAGELIST_MIN_SIZE (64*1024)
+#define PAGELIST_MAX_SIZE (4*1024*1024)
+#define ION_REG_CACHE_NR (16)
+
+/* what the TEE gets for a TEE_PARAM_TYPE_PAGELIST_* memref */
+struct tc_pagelist {
+	uint32_t nr_pages;
+	uint32_t offset;	/* of the data in the first page */
+	uint64_t phys[0];
+} __attribute__((__packed__));
+
 int tc_mem_init(void);
 void tc_mem_destroy(void);
 
 TC_NS_Shared_MEM *tc_mem_allocate(TC_NS_DEV_File *dev, size_t len);
 void tc_mem_free(TC_NS_Shared_MEM *shared_mem);
 
+bool tc_mem_use_pagelist(uint8_t kernel_api, uint32_t size);
+int tc_mem_pin_user(TC_NS_Temp_Buf *buf, unsigned long uaddr,
+		    uint32_t size, bool write);
+void tc_mem_unpin_user(TC_NS_Temp_Buf *buf, bool dirty);
+
+int tc_ion_reg_get(TC_NS_DEV_File *dev, int fd,
+		   phys_addr_t *phys, size_t *size);
+void tc_ion_reg_release(TC_NS_DEV_File *dev);
+
 static inline void get_sharemem_struct(struct tag_TC_NS_Shared_MEM *sharemem)
 {
 	if (sharemem)
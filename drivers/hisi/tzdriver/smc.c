@@ -59,16 +59,25 @@ struct wait_entry {
 };
 
 struct smc_work {
-	struct kthread_work kthwork;
 	struct work_struct work;
-	TC_NS_SMC_CMD *cmd;
-	struct wait_entry *we;
 	uint32_t cmd_type;
-	unsigned int cmd_ret;
 };
 
-static struct task_struct *cmd_work_thread;
-static DEFINE_KTHREAD_WORKER(cmd_worker);
+/* a command waiting for a free slot in cmd_data->in */
+struct smc_pending {
+	struct list_head list;
+	int prio;
+	TC_NS_SMC_CMD cmd;
+};
+
+enum smc_prio {
+	SMC_PRIO_NORMAL = 0,
+	SMC_PRIO_TA,		/* TA listed in hisi,tee-prio-ta-uuid */
+	SMC_PRIO_AGENT,		/* answer to an agent request, unblocks a TA */
+};
+
+#define TA_UUID_LEN		16
+#define MAX_PRIO_TA		8
 
 static struct task_struct *smc_thread;
 static struct task_struct *siq_thread;
@@ -85,6 +94,19 @@ typedef struct __attribute__ ((__packed__)) TC_NS_SMC_QUEUE {
 /* tzdriver's own queue pointer */
 static uint32_t last_in, last_out;
 
+/*
+ * Commands go straight from the caller into cmd_data->in. Slots are
+ * only reused once the TEE has answered the command in them, so at most
+ * MAX_SMC_CMD - 1 are in flight; the rest wait in pending_cmds, highest
+ * priority first, until smc_thread_fn frees a slot.
+ */
+static DEFINE_SPINLOCK(smc_queue_lock);
+static LIST_HEAD(pending_cmds);
+static uint32_t in_flight;
+
+static uint8_t prio_ta[MAX_PRIO_TA][TA_UUID_LEN];
+static int prio_ta_nr;
+
 TC_NS_SMC_QUEUE *cmd_data;
 phys_addr_t cmd_phys;
 
@@ -143,12 +165,111 @@ static int siq_thread_fn(void *arg)
 
 		atomic_set(&siq_th_run, 0);
 		smc_send(TSP_REE_SIQ, (phys_addr_t)1, 0, false);
+
+		/* answers delivered during the SIQ are picked up right away */
+		if (last_out != cmd_data->last_out)
+			tc_smc_wakeup();
+	}
+}
+
+/* called with smc_queue_lock held */
+static void smc_queue_fill(void)
+{
+	struct smc_pending *p;
+	bool queued = false;
+
+	while (in_flight < MAX_SMC_CMD - 1 && !list_empty(&pending_cmds)) {
+		p = list_first_entry(&pending_cmds, struct smc_pending, list);
+		list_del(&p->list);
+
+		if (EOK != memcpy_s(&cmd_data->in[last_in],
+					sizeof(TC_NS_SMC_CMD),
+					&p->cmd,
+					sizeof(TC_NS_SMC_CMD)))
+			tloge("memcpy_s failed,%s line:%d", __func__, __LINE__);
+		kfree(p);
+
+		if (++last_in >= MAX_SMC_CMD)
+			last_in = 0;
+		in_flight++;
+		queued = true;
+	}
+
+	if (!queued)
+		return;
+
+	isb();
+	wmb();
+	cmd_data->last_in = last_in;
+	isb();
+	wmb();
+	tlogd("***smc_queue_fill in %d %d ***\n", last_in, cmd_data->last_in);
+}
+
+static int smc_queue_cmd(TC_NS_SMC_CMD *cmd, int prio)
+{
+	struct smc_pending *p, *pos;
+
+	p = kmalloc(sizeof(*p), GFP_KERNEL);
+	if (!p)
+		return -ENOMEM;
+
+	p->prio = prio;
+	if (EOK != memcpy_s(&p->cmd, sizeof(TC_NS_SMC_CMD),
+				cmd, sizeof(TC_NS_SMC_CMD))) {
+		kfree(p);
+		return -EFAULT;
+	}
+
+	spin_lock(&smc_queue_lock);
+	/* behind everything of the same or higher priority */
+	list_for_each_entry(pos, &pending_cmds, list) {
+		if (pos->prio < prio)
+			break;
+	}
+	list_add_tail(&p->list, &pos->list);
+	smc_queue_fill();
+	spin_unlock(&smc_queue_lock);
+
+	tc_smc_wakeup();
+	return 0;
+}
+
+/* the TEE answered @nr commands, their slots can take new ones */
+static void smc_queue_release(uint32_t nr)
+{
+	spin_lock(&smc_queue_lock);
+	in_flight = in_flight > nr ? in_flight - nr : 0;
+	smc_queue_fill();
+	spin_unlock(&smc_queue_lock);
+}
+
+static int smc_cmd_prio(TC_NS_SMC_CMD *cmd)
+{
+	phys_addr_t uuid_phys;
+	uint8_t *uuid;
+	int i;
+
+	if (!prio_ta_nr)
+		return SMC_PRIO_NORMAL;
+
+	uuid_phys = ((phys_addr_t)cmd->uuid_h_phys << 32) | cmd->uuid_phys;
+	if (!uuid_phys)
+		return SMC_PRIO_NORMAL;
+
+	/* the first byte is the global flag, the TA uuid follows */
+	uuid = (uint8_t *)phys_to_virt(uuid_phys) + 1;
+	for (i = 0; i < prio_ta_nr; i++) {
+		if (!memcmp(uuid, prio_ta[i], TA_UUID_LEN))
+			return SMC_PRIO_TA;
 	}
+
+	return SMC_PRIO_NORMAL;
 }
 
 static int smc_thread_fn(void *arg)
 {
-	uint32_t ret, i = 0;
+	uint32_t ret, i = 0, answered;
 	uint8_t cmd_processed = 0, cmd_count = 0;
 	struct wait_entry *we = NULL;
 	struct wait_entry *tmp = NULL;
@@ -176,6 +297,7 @@ static int smc_thread_fn(void *arg)
 			break;
 		}
 
+		answered = 0;
 		while (last_out != cmd_data->last_out) {
 			TC_NS_SMC_CMD cmd;
 			uint8_t found = 0;
@@ -266,10 +388,13 @@ static int smc_thread_fn(void *arg)
 next_cmd:
 			if (++last_out >= MAX_SMC_CMD)
 				last_out = 0;
+			answered++;
 
 			/* Give the other processes time to run */
 			cond_resched();
 		}
+		if (answered)
+			smc_queue_release(answered);
 
 		/* Every time we have an empty run, TrustedCore return from reet
 		 * and no command was processed
@@ -351,41 +476,10 @@ static void smc_work_no_wait(struct work_struct *work)
 	smc_send(TSP_REQUEST, cmd_phys, s_work->cmd_type, true);
 }
 
-static void smc_work_func(struct kthread_work *work)
-{
-	struct smc_work *s_work = container_of(work, struct smc_work, kthwork);
-
-	if (EOK != memcpy_s(&cmd_data->in[last_in],
-				sizeof(TC_NS_SMC_CMD),
-				s_work->cmd,
-				sizeof(TC_NS_SMC_CMD)))
-		tloge("memcpy_s failed,%s line:%d", __func__, __LINE__);
-	isb();
-	wmb();
-	if (++last_in >= MAX_SMC_CMD)
-		last_in = 0;
-	cmd_data->last_in = last_in;
-	isb();
-	wmb();
-
-	tlogd("***smc_work_func in %d %d ***\n", last_in, cmd_data->last_in);
-	tc_smc_wakeup();
-
-	tlogd("***smc_work_func out %d %d ***\n", last_out,
-		cmd_data->last_out);
-}
-
 static unsigned int smc_send_func(TC_NS_SMC_CMD *cmd, uint32_t cmd_type,
 				  uint8_t flags)
 {
-
 	struct wait_entry *we = kmalloc(sizeof(struct wait_entry), GFP_KERNEL);
-	struct smc_work work = {
-		KTHREAD_WORK_INIT(work.kthwork, smc_work_func),
-		.cmd = cmd,
-		.cmd_type = cmd_type,
-		.we = we,
-	};
 
 	if (we == NULL) {
 		tloge("failed to malloc memory!\n");
@@ -407,17 +501,17 @@ static unsigned int smc_send_func(TC_NS_SMC_CMD *cmd, uint32_t cmd_type,
 	atomic_inc(&outstading_cmds);
 	mutex_unlock(&wait_th_lock);
 
-	if (!queue_kthread_work(&cmd_worker, &work.kthwork)) {
+	if (smc_queue_cmd(cmd, smc_cmd_prio(cmd))) {
+		mutex_lock(&wait_th_lock);
+		list_del(&we->list);
+		atomic_dec(&outstading_cmds);
+		mutex_unlock(&wait_th_lock);
 		kfree(we);
 		return (unsigned int)TEEC_ERROR_GENERIC;
-
 	}
 
 	tlogd("***wait_thr_add waiting for completion %u ***\n",
 		cmd->event_nr);
-	/* We need to make sure the flush the work so
-	 * it has made it all the way to the smc thread! */
-	flush_kthread_work(&work.kthwork);
 	/* In sync mode we don't return till we get an answer */
 	wait_for_completion(&we->done);
 	tlogd("***smc_send_func wait for complete done %d***\n",
@@ -631,12 +725,6 @@ unlock:
 
 unsigned int TC_NS_POST_SMC(TC_NS_SMC_CMD *cmd)
 {
-	struct smc_work work = {
-		KTHREAD_WORK_INIT(work.kthwork, smc_work_func),
-		.cmd = cmd,
-		.cmd_type = TC_NS_CMD_TYPE_NS_TO_SECURE,
-		.we = NULL
-	};
 	if (sys_crash)
 		return TEEC_ERROR_GENERIC;
 
@@ -646,12 +734,11 @@ unsigned int TC_NS_POST_SMC(TC_NS_SMC_CMD *cmd)
 	}
 
 	atomic_inc(&outstading_cmds);
-	if (!queue_kthread_work(&cmd_worker, &work.kthwork))
+	/* the answer is copied, @cmd may go away once this returns */
+	if (smc_queue_cmd(cmd, SMC_PRIO_AGENT)) {
+		atomic_dec(&outstading_cmds);
 		return TEEC_ERROR_GENERIC;
-
-	/* We need to make sure the flush the work
-	 * so it has made it all the way to the smc thread! */
-	flush_kthread_work(&work.kthwork);
+	}
 	tlogd("Command posted %u\n", cmd->event_nr);
 
 	return TEEC_SUCCESS;
@@ -660,7 +747,6 @@ unsigned int TC_NS_POST_SMC(TC_NS_SMC_CMD *cmd)
 static int smc_set_cmd_buffer(void)
 {
 	struct smc_work work = {
-		.cmd = NULL,
 		.cmd_type = TC_NS_CMD_TYPE_SECURE_CONFIG
 	};
 	INIT_WORK_ONSTACK(&work.work, smc_work_no_wait);
@@ -670,6 +756,22 @@ static int smc_set_cmd_buffer(void)
 	return 0;
 }
 
+static void smc_init_prio_ta(void)
+{
+	const uint8_t *prop;
+	int len;
+
+	prop = of_get_property(np, "hisi,tee-prio-ta-uuid", &len);
+	if (!prop || len <= 0)
+		return;
+
+	prio_ta_nr = min_t(int, len / TA_UUID_LEN, MAX_PRIO_TA);
+	if (EOK != memcpy_s(prio_ta, sizeof(prio_ta), prop,
+				prio_ta_nr * TA_UUID_LEN))
+		prio_ta_nr = 0;
+	pr_info("%d prioritized TAs\n", prio_ta_nr);
+}
+
 int smc_init_data(struct device *class_dev)
 {
 	int ret = 0;
@@ -685,6 +787,7 @@ int smc_init_data(struct device *class_dev)
 		return -ENOMEM;
 
 	cmd_phys = virt_to_phys(cmd_data);
+	smc_init_prio_ta();
 
 	/* Send the allocated buffer to TrustedCore for init */
 	if (smc_set_cmd_buffer()) {
@@ -740,25 +843,11 @@ int smc_init_data(struct device *class_dev)
 
 	kthread_bind(siq_thread, 0);
 
-	cmd_work_thread =
-	    kthread_create(kthread_worker_fn, &cmd_worker, "tcwork");
-	if (IS_ERR(cmd_work_thread)) {
-		dev_err(class_dev, "couldn't create cmd_work_threads %ld\n",
-			PTR_ERR(cmd_work_thread));
-		ret = (int)PTR_ERR(cmd_work_thread);
-		goto free_siq_worker;
-	}
-
-	wake_up_process(cmd_work_thread);
 	wake_up_process(smc_thread);
 	wake_up_process(siq_thread);
 
 	return 0;
 
-free_siq_worker:
-	kthread_stop(siq_thread);
-	siq_thread = NULL;
-
 free_smc_worker:
 	kthread_stop(smc_thread);
 	smc_thread = NULL;
@@ -802,10 +891,6 @@ void smc_free_data(void)
 {
 	free_page((unsigned long)cmd_data);
 
-	if (!IS_ERR_OR_NULL(cmd_work_thread)) {
-		kthread_stop(cmd_work_thread);
-		cmd_work_thread = NULL;
-	}
 	if (!IS_ERR_OR_NULL(smc_thread)) {
 		kthread_stop(smc_thread);
 		smc_thread = NULL;
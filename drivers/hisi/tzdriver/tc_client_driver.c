@@ -1906,6 +1906,9 @@ int TC_NS_ClientOpen(TC_NS_DEV_File **dev_file, uint8_t kernel_api)
 	dev->load_app_flag = 0;
 	mutex_init(&dev->service_lock);
 	mutex_init(&dev->shared_mem_lock);
+	mutex_init(&dev->ion_reg_lock);
+	INIT_LIST_HEAD(&dev->ion_reg_list);
+	dev->ion_reg_cnt = 0;
 	*dev_file = dev;
 
 	ret = TEEC_SUCCESS;
@@ -1968,6 +1971,7 @@ int TC_NS_ClientClose(TC_NS_DEV_File *dev, int flag)
 	}
 
 	mutex_unlock(&dev->shared_mem_lock);
+	tc_ion_reg_release(dev);
 	if (!flag)
 		TC_NS_unregister_agent_client(dev);
 
@@ -111,6 +111,10 @@ enum TEE_ParamType {
 	TEE_PARAM_TYPE_MEMREF_OUTPUT = 0x6,
 	TEE_PARAM_TYPE_MEMREF_INOUT = 0x7,
 	TEE_PARAM_TYPE_ION_INPUT = 0x8,
+	/* memref passed as a tc_pagelist of pinned client pages */
+	TEE_PARAM_TYPE_PAGELIST_INPUT = 0x9,
+	TEE_PARAM_TYPE_PAGELIST_OUTPUT = 0xa,
+	TEE_PARAM_TYPE_PAGELIST_INOUT = 0xb,
 };
 
 /****************************************************
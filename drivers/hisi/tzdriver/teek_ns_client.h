@@ -91,6 +91,10 @@ typedef struct tag_TC_NS_DEV_File {
 	uint32_t pub_key_len;
 	uint8_t pub_key[MAX_PUBKEY_LEN];
 	int load_app_flag;
+	/* ION buffers already imported for this client, most recent first */
+	struct mutex ion_reg_lock;
+	struct list_head ion_reg_list;
+	unsigned int ion_reg_cnt;
 } TC_NS_DEV_File;
 
 typedef union {
@@ -119,6 +123,11 @@ typedef struct tag_TC_NS_Operation {
 typedef struct tag_TC_NS_Temp_Buf {
 	void *temp_buffer;
 	unsigned int size;
+	/* set when the client pages are passed to the TEE in place */
+	bool pinned;
+	struct page **pages;
+	unsigned int nr_pages;
+	void *page_list;
 } TC_NS_Temp_Buf;
 
 typedef struct  tag_TC_NS_SMC_CMD {
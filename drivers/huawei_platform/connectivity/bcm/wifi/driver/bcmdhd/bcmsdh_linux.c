@@ -43,6 +43,7 @@
 #include <bcmdefs.h>
 #include <bcmdevs.h>
 #include <linux/irq.h>
+#include <linux/hisi/hisi_irq_affinity.h>
 extern void dhdsdio_isr(void * args);
 #include <bcmutils.h>
 #include <dngl_stats.h>
@@ -407,6 +408,8 @@ int bcmsdh_oob_intr_register(bcmsdh_info_t *bcmsdh, bcmsdh_cb_fn_t oob_irq_handl
 #endif
 		return err;
 	}
+	/* rx bursts: let the balancer keep it off the busy cpus */
+	hisi_irqaffinity_set_hint(bcmsdh_osinfo->oob_irq_num, HISI_IRQ_HINT_THROUGHPUT);
 
 		err = enable_irq_wake(bcmsdh_osinfo->oob_irq_num);
 		if (!err)
@@ -437,6 +440,7 @@ void bcmsdh_oob_intr_unregister(bcmsdh_info_t *bcmsdh)
 		disable_irq(bcmsdh_osinfo->oob_irq_num);
 		bcmsdh_osinfo->oob_irq_enabled = FALSE;
 	}
+	hisi_irqaffinity_set_hint(bcmsdh_osinfo->oob_irq_num, HISI_IRQ_HINT_NONE);
 	free_irq(bcmsdh_osinfo->oob_irq_num, bcmsdh);
 	bcmsdh_osinfo->oob_irq_registered = FALSE;
 }
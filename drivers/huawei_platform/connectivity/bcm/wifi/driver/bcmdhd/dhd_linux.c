@@ -26,10 +26,14 @@
 #include <linux/ip.h>
 #include <linux/reboot.h>
 #include <linux/notifier.h>
+#include <linux/hisi/hisi_boot_initcall.h>
 #include <net/addrconf.h>
 #ifdef ENABLE_ADAPTIVE_SCHED
 #include <linux/cpufreq.h>
 #endif /* ENABLE_ADAPTIVE_SCHED */
+#ifdef DHD_RPS_STEERING
+#include <linux/topology.h>
+#endif /* DHD_RPS_STEERING */
 
 #include <asm/uaccess.h>
 #include <asm/unaligned.h>
@@ -399,6 +403,21 @@ typedef struct dhd_info {
 	spinlock_t	rxf_lock;
 	bool		rxthread_enabled;
 
+#ifdef DHD_GRO_RX
+	/* NAPI context feeding received data frames to GRO */
+	struct napi_struct	rx_napi;
+	struct sk_buff_head	rx_napi_queue;		/* filled by dhd_rx_frame */
+	struct sk_buff_head	rx_napi_process;	/* owned by the poll routine */
+	bool		rx_napi_enabled;
+#endif /* DHD_GRO_RX */
+#ifdef DHD_RPS_STEERING
+	/* Periodic rx throughput sampling driving the RPS map of wlan0 */
+	struct delayed_work	rps_steer_work;
+	unsigned long	rps_last_rx_bytes;
+	bool		rps_spread;
+	bool		rps_configured;
+#endif /* DHD_RPS_STEERING */
+
 	/* Wakelocks */
 #if defined(CONFIG_HAS_WAKELOCK) && (LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 27))
 	struct wake_lock wl_wifi;   /* Wifi wakelock */
@@ -576,6 +595,30 @@ module_param(dhd_dpc_prio, int, 0);
 int dhd_rxf_prio = CUSTOM_RXF_PRIO_SETTING;
 module_param(dhd_rxf_prio, int, 0);
 
+#ifdef DHD_GRO_RX
+/* Pass received data frames through GRO, applied on the next dhd_open */
+uint dhd_rx_gro = TRUE;
+module_param(dhd_rx_gro, uint, 0644);
+#endif /* DHD_GRO_RX */
+
+#ifdef DHD_RPS_STEERING
+/* Retune the RPS map of the primary interface from the rx throughput */
+uint dhd_rps_steering = TRUE;
+module_param(dhd_rps_steering, uint, 0644);
+
+/* Rx throughput (Mbit/s) above which flows are spread over the big
+ * cluster; they fold back onto one little core below half of it.
+ */
+uint dhd_rps_spread_mbps = 100;
+module_param(dhd_rps_spread_mbps, uint, 0644);
+
+/* Little core taking the rx protocol work at low load, -1 picks the
+ * last online core outside the big cluster.
+ */
+int dhd_rps_little_cpu = -1;
+module_param(dhd_rps_little_cpu, int, 0644);
+#endif /* DHD_RPS_STEERING */
+
 #ifdef  BRCM_RSDB
 int passive_channel_skip = 0;
 module_param(passive_channel_skip, int, (S_IRUSR|S_IWUSR));
@@ -2877,6 +2920,172 @@ dhd_is_rxthread_enabled(dhd_pub_t *dhdp)
 }
 #endif /* DHD_WMF */
 
+#ifdef DHD_GRO_RX
+#define DHD_RX_NAPI_WEIGHT	64
+
+static int
+dhd_rx_napi_poll(struct napi_struct *napi, int budget)
+{
+	dhd_info_t *dhd = container_of(napi, dhd_info_t, rx_napi);
+	struct sk_buff *skb;
+	unsigned long flags;
+	int work = 0;
+
+	while (work < budget) {
+		/* Refill the private list in one go to keep the shared
+		 * queue lock off the per-packet path.
+		 */
+		if (skb_queue_empty(&dhd->rx_napi_process)) {
+			spin_lock_irqsave(&dhd->rx_napi_queue.lock, flags);
+			skb_queue_splice_tail_init(&dhd->rx_napi_queue,
+				&dhd->rx_napi_process);
+			spin_unlock_irqrestore(&dhd->rx_napi_queue.lock, flags);
+			if (skb_queue_empty(&dhd->rx_napi_process))
+				break;
+		}
+		skb = __skb_dequeue(&dhd->rx_napi_process);
+		napi_gro_receive(napi, skb);
+		work++;
+	}
+
+	if (work < budget) {
+		napi_complete(napi);
+		/* Frames queued after the last splice saw NAPI still scheduled */
+		if (!skb_queue_empty(&dhd->rx_napi_queue))
+			napi_schedule(napi);
+	}
+
+	return work;
+}
+
+static void
+dhd_rx_napi_enqueue(dhd_info_t *dhd, struct sk_buff_head *list)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&dhd->rx_napi_queue.lock, flags);
+	skb_queue_splice_tail_init(list, &dhd->rx_napi_queue);
+	spin_unlock_irqrestore(&dhd->rx_napi_queue.lock, flags);
+
+	/* As with netif_rx_ni(), run the softirq right away when not
+	 * called from interrupt context.
+	 */
+	if (in_interrupt()) {
+		napi_schedule(&dhd->rx_napi);
+	} else {
+		local_bh_disable();
+		napi_schedule(&dhd->rx_napi);
+		local_bh_enable();
+	}
+}
+
+static void
+dhd_rx_napi_start(dhd_info_t *dhd)
+{
+	if (!dhd_rx_gro || dhd->rx_napi_enabled)
+		return;
+
+	napi_enable(&dhd->rx_napi);
+	dhd->rx_napi_enabled = TRUE;
+}
+
+static void
+dhd_rx_napi_stop(dhd_info_t *dhd)
+{
+	if (!dhd->rx_napi_enabled)
+		return;
+
+	dhd->rx_napi_enabled = FALSE;
+	napi_disable(&dhd->rx_napi);
+	skb_queue_purge(&dhd->rx_napi_queue);
+	__skb_queue_purge(&dhd->rx_napi_process);
+}
+#endif /* DHD_GRO_RX */
+
+#ifdef DHD_RPS_STEERING
+#define DHD_RPS_STEER_MS	1000
+
+/* The cluster with the highest id is the big one on hisi big.LITTLE parts */
+static void
+dhd_rps_steer_mask(bool spread, struct cpumask *mask)
+{
+	int cpu, big = -1, little = dhd_rps_little_cpu;
+
+	cpumask_clear(mask);
+	for_each_online_cpu(cpu)
+		big = max(big, topology_physical_package_id(cpu));
+
+	if (spread) {
+		for_each_online_cpu(cpu) {
+			if (topology_physical_package_id(cpu) == big)
+				cpumask_set_cpu(cpu, mask);
+		}
+		return;
+	}
+
+	if (little < 0 || little >= nr_cpu_ids || !cpu_online(little)) {
+		little = -1;
+		for_each_online_cpu(cpu) {
+			if (topology_physical_package_id(cpu) != big)
+				little = cpu;
+		}
+	}
+	/* Single cluster: leave RPS off and keep frames on the rx core */
+	if (little >= 0)
+		cpumask_set_cpu(little, mask);
+}
+
+static void
+dhd_rps_steer_work(struct work_struct *work)
+{
+	dhd_info_t *dhd = container_of(to_delayed_work(work), dhd_info_t,
+		rps_steer_work);
+	unsigned long rx_bytes = dhd->pub.dstats.rx_bytes;
+	unsigned long mbps;
+	bool spread = dhd->rps_spread;
+	cpumask_t mask;
+
+	mbps = (rx_bytes - dhd->rps_last_rx_bytes) * 8 / (DHD_RPS_STEER_MS * 1000);
+	dhd->rps_last_rx_bytes = rx_bytes;
+
+	if (!spread && mbps >= dhd_rps_spread_mbps)
+		spread = TRUE;
+	else if (spread && mbps < dhd_rps_spread_mbps / 2)
+		spread = FALSE;
+
+	if (!dhd->rps_configured || spread != dhd->rps_spread) {
+		dhd_rps_steer_mask(spread, &mask);
+		if (netif_set_rps_cpus(dhd->iflist[0]->net, &mask, 0) == 0) {
+			DHD_INFO(("%s: rx %lu Mbps, rps_cpus %*pb\n", __FUNCTION__,
+				mbps, cpumask_pr_args(&mask)));
+			dhd->rps_spread = spread;
+			dhd->rps_configured = TRUE;
+		}
+	}
+
+	schedule_delayed_work(&dhd->rps_steer_work,
+		msecs_to_jiffies(DHD_RPS_STEER_MS));
+}
+
+static void
+dhd_rps_steer_start(dhd_info_t *dhd)
+{
+	if (!dhd_rps_steering)
+		return;
+
+	dhd->rps_last_rx_bytes = dhd->pub.dstats.rx_bytes;
+	dhd->rps_spread = FALSE;
+	dhd->rps_configured = FALSE;
+	schedule_delayed_work(&dhd->rps_steer_work, 0);
+}
+
+static void
+dhd_rps_steer_stop(dhd_info_t *dhd)
+{
+	cancel_delayed_work_sync(&dhd->rps_steer_work);
+}
+#endif /* DHD_RPS_STEERING */
+
 void
 dhd_rx_frame(dhd_pub_t *dhdp, int ifidx, void *pktbuf, int numpkt, uint8 chan,
 	     int pkt_wake, wake_counts_t *wcp)
@@ -2897,6 +3106,11 @@ dhd_rx_frame(dhd_pub_t *dhdp, int ifidx, void *pktbuf, int numpkt, uint8 chan,
 #if defined(DHD_RX_DUMP) || defined(DHD_8021X_DUMP) || defined(DHD_WAKE_STATUS)
 	char *dump_data;
 #endif /* DHD_RX_DUMP || DHD_8021X_DUMP || DHD_WAKE_STATUS */
+#ifdef DHD_GRO_RX
+	struct sk_buff_head gro_list;
+
+	__skb_queue_head_init(&gro_list);
+#endif /* DHD_GRO_RX */
 
 	DHD_TRACE(("%s: Enter\n", __FUNCTION__));
 
@@ -3265,6 +3479,13 @@ dhd_rx_frame(dhd_pub_t *dhdp, int ifidx, void *pktbuf, int numpkt, uint8 chan,
 			hw_parse_special_ipv4_packet(skb->data - ETH_HLEN, skb->len + ETH_HLEN);
 		}
 #endif
+#ifdef DHD_GRO_RX
+		/* Data frames go to GRO; events keep the netif_rx path */
+		if (dhd->rx_napi_enabled && ntoh16(skb->protocol) != ETHER_TYPE_BRCM) {
+			__skb_queue_tail(&gro_list, skb);
+			continue;
+		}
+#endif /* DHD_GRO_RX */
 		if (in_interrupt()) {
 			netif_rx(skb);
 		} else {
@@ -3297,6 +3518,10 @@ dhd_rx_frame(dhd_pub_t *dhdp, int ifidx, void *pktbuf, int numpkt, uint8 chan,
 
 	if (dhd->rxthread_enabled && skbhead)
 		dhd_sched_rxf(dhdp, skbhead);
+#ifdef DHD_GRO_RX
+	if (!skb_queue_empty(&gro_list))
+		dhd_rx_napi_enqueue(dhd, &gro_list);
+#endif /* DHD_GRO_RX */
 
 	DHD_OS_WAKE_LOCK_RX_TIMEOUT_ENABLE(dhdp, tout_rx);
 	DHD_OS_WAKE_LOCK_CTRL_TIMEOUT_ENABLE(dhdp, tout_ctrl);
@@ -4338,6 +4563,14 @@ exit:
 	if (ifidx == 0 && !dhd_download_fw_on_driverload)
 		wl_android_wifi_off(net, TRUE);
 #endif
+#ifdef DHD_RPS_STEERING
+	if (ifidx == 0)
+		dhd_rps_steer_stop(dhd);
+#endif /* DHD_RPS_STEERING */
+#ifdef DHD_GRO_RX
+	if (ifidx == 0)
+		dhd_rx_napi_stop(dhd);
+#endif /* DHD_GRO_RX */
 	dhd->pub.rxcnt_timeout = 0;
 	dhd->pub.txcnt_timeout = 0;
 
@@ -4433,6 +4666,14 @@ exit:
 	if (ifidx == 0 && !dhd_download_fw_on_driverload)
 		wl_android_wifi_off(net, TRUE);
 #endif
+#ifdef DHD_RPS_STEERING
+	if (ifidx == 0)
+		dhd_rps_steer_stop(dhd);
+#endif /* DHD_RPS_STEERING */
+#ifdef DHD_GRO_RX
+	if (ifidx == 0)
+		dhd_rx_napi_stop(dhd);
+#endif /* DHD_GRO_RX */
 	dhd->pub.rxcnt_timeout = 0;
 	dhd->pub.txcnt_timeout = 0;
 
@@ -4573,6 +4814,13 @@ dhd_open(struct net_device *net)
 		/* dhd_sync_with_dongle has been called in dhd_bus_start or wl_android_wifi_on */
 		memcpy(net->dev_addr, dhd->pub.mac.octet, ETHER_ADDR_LEN);
 
+#ifdef DHD_GRO_RX
+		dhd_rx_napi_start(dhd);
+#endif /* DHD_GRO_RX */
+#ifdef DHD_RPS_STEERING
+		dhd_rps_steer_start(dhd);
+#endif /* DHD_RPS_STEERING */
+
 #ifdef TOE
 		/* Get current TOE mode from dongle */
 		if (dhd_toe_get(dhd, ifidx, &toe_ol) >= 0 && (toe_ol & TOE_TX_CSUM_OL) != 0)
@@ -5234,6 +5482,15 @@ dhd_attach(osl_t *osh, struct dhd_bus *bus, uint bus_hdrlen)
 		goto fail;
 	dhd_state |= DHD_ATTACH_STATE_ADD_IF;
 
+#ifdef DHD_GRO_RX
+	skb_queue_head_init(&dhd->rx_napi_queue);
+	__skb_queue_head_init(&dhd->rx_napi_process);
+	netif_napi_add(net, &dhd->rx_napi, dhd_rx_napi_poll, DHD_RX_NAPI_WEIGHT);
+#endif /* DHD_GRO_RX */
+#ifdef DHD_RPS_STEERING
+	INIT_DELAYED_WORK(&dhd->rps_steer_work, dhd_rps_steer_work);
+#endif /* DHD_RPS_STEERING */
+
 #if (LINUX_VERSION_CODE < KERNEL_VERSION(2, 6, 31))
 	net->open = NULL;
 #else
@@ -7569,8 +7826,12 @@ void dhd_detach(dhd_pub_t *dhdp)
 		ASSERT(ifp);
 		ASSERT(ifp->net);
 		if (ifp && ifp->net) {
-
-
+#ifdef DHD_RPS_STEERING
+			dhd_rps_steer_stop(dhd);
+#endif /* DHD_RPS_STEERING */
+#ifdef DHD_GRO_RX
+			dhd_rx_napi_stop(dhd);
+#endif /* DHD_GRO_RX */
 
 			/* in unregister_netdev case, the interface gets freed by net->destructor
 			 * (which is set to free_netdev)
@@ -7862,7 +8123,8 @@ deferred_module_init(dhd_module_init);
 #elif defined(USE_LATE_INITCALL_SYNC)
 late_initcall_sync(dhd_module_init);
 #else
-late_initcall(dhd_module_init);
+/* firmware download and power-up retries need not hold up the boot */
+hisi_async_late_initcall(dhd_module_init);
 #endif /* USE_LATE_INITCALL_SYNC */
 #else
 module_init(dhd_module_init);
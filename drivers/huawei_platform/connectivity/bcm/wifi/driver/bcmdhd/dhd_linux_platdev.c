@@ -344,6 +344,8 @@ static int wifi_plat_dev_drv_probe(struct platform_device *pdev)
 #endif
 	}
 
+	/* the sdio bus is the parent of the real work, it is ordered already */
+	device_enable_async_suspend(&pdev->dev);
 
 	wifi_plat_dev_probe_ret = dhd_wifi_platform_load();
 	return wifi_plat_dev_probe_ret;
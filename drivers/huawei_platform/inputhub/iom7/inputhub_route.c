@@ -20,6 +20,7 @@
 #include <linux/i2c.h>
 #include <linux/reboot.h>
 #include <linux/kernel.h>
+#include <linux/cpuidle.h>
 #include "protocol.h"
 #include "inputhub_route.h"
 #include "inputhub_bridge.h"
@@ -41,6 +42,10 @@
 #include <linux/wakelock.h>
 #include <linux/hisi/hisi_syscounter.h>
 #include <linux/time64.h>
+#include <linux/vmalloc.h>
+#include <linux/hrtimer.h>
+#include <linux/poll.h>
+#include <linux/mm.h>
 
 #ifdef CONFIG_HUAWEI_DSM
 #include <dsm/dsm_pub.h>
@@ -65,7 +70,12 @@
 #ifdef CONFIG_HUAWEI_DSM
 #define SENSOR_DSM_CONFIG
 #endif
-#define ROUTE_BUFFER_MAX_SIZE (1024 * 128)
+#define ROUTE_BUFFER_MAX_SIZE (1024 * 128)	/*must be a power of two*/
+#define ROUTE_RING_CTRL_SIZE PAGE_SIZE
+/*wake readers at once when the ring is half full, whatever the latency*/
+#define ROUTE_WAKE_WATERMARK (ROUTE_BUFFER_MAX_SIZE / 2)
+/*deadlines closer than this are not worth a timer*/
+#define ROUTE_WAKE_SLACK_NS (2 * NSEC_PER_MSEC)
 #ifdef TIMESTAMP_SIZE
 #undef TIMESTAMP_SIZE
 #define TIMESTAMP_SIZE (8)
@@ -176,35 +186,37 @@ struct iom7_log_work {
 	struct delayed_work log_work;
 };
 
-struct inputhub_buffer_pos {
-	char *pos;
-	unsigned int buffer_size;
-};
-
 /*
  *Every route item can be used by one reader and one writer.
+ *The ring (control page + record area) is shared with the reader through
+ *mmap(), so the HAL can consume records in place instead of one read()
+ *per record. read() still works on the same ring for older readers.
  */
 struct inputhub_route_table {
 	unsigned short port;
-	struct inputhub_buffer_pos phead;	/*point to the head of buffer*/
-	struct inputhub_buffer_pos pRead;	/*point to the read position of buffer*/
-	struct inputhub_buffer_pos pWrite;	/*point to the write position of buffer*/
+	struct inputhub_route_ring *ring;	/*control page, start of mapping*/
+	char *buffer;		/*record area, ROUTE_BUFFER_MAX_SIZE bytes*/
 	wait_queue_head_t read_wait;	/*to block read when no data in buffer*/
-	atomic_t data_ready;
+	bool readable;		/*readers were woken for queued records*/
+	int64_t wake_deadline;	/*pending batched wakeup, 0 if none*/
+	struct hrtimer wake_timer;
 	spinlock_t buffer_spin_lock;	/*for read write buffer*/
 };
 
 static struct inputhub_route_table package_route_tbl[] = {
-	{ROUTE_SHB_PORT, {NULL, 0}, {NULL, 0}, {NULL, 0},
+	{ROUTE_SHB_PORT, NULL, NULL,
 	 __WAIT_QUEUE_HEAD_INITIALIZER(package_route_tbl[0].read_wait)},
-	{ROUTE_MOTION_PORT, {NULL, 0}, {NULL, 0}, {NULL, 0},
+	{ROUTE_MOTION_PORT, NULL, NULL,
 	 __WAIT_QUEUE_HEAD_INITIALIZER(package_route_tbl[1].read_wait)},
-	{ROUTE_CA_PORT, {NULL,0}, {NULL,0}, {NULL,0},
+	{ROUTE_CA_PORT, NULL, NULL,
 	 __WAIT_QUEUE_HEAD_INITIALIZER(package_route_tbl[2].read_wait)},
-	{ROUTE_FHB_PORT, {NULL,0}, {NULL,0}, {NULL,0},
+	{ROUTE_FHB_PORT, NULL, NULL,
 	 __WAIT_QUEUE_HEAD_INITIALIZER(package_route_tbl[3].read_wait)},
 };
 
+/*max report latency requested by the HAL for each sensor, 0 = none*/
+static unsigned int report_latency_ms[TAG_SENSOR_END];
+
 struct sensors_cmd_map {
 	int hal_sensor_type;
 	int tag;
@@ -320,10 +332,26 @@ static int inputhub_route_item(unsigned short port,
 
 }
 
+static enum hrtimer_restart route_wake_timer_fn(struct hrtimer *timer)
+{
+	struct inputhub_route_table *route_item =
+	    container_of(timer, struct inputhub_route_table, wake_timer);
+	unsigned long flags = 0;
+
+	spin_lock_irqsave(&route_item->buffer_spin_lock, flags);
+	route_item->wake_deadline = 0;
+	route_item->readable = true;
+	spin_unlock_irqrestore(&route_item->buffer_spin_lock, flags);
+	wake_up_interruptible(&route_item->read_wait);
+
+	return HRTIMER_NORESTART;
+}
+
 int inputhub_route_open(unsigned short port)
 {
 	int ret;
 	char *pos;
+	unsigned long flags = 0;
 	struct inputhub_route_table *route_item;
 
 	hwlog_info("%s\n", __func__);
@@ -331,22 +359,26 @@ int inputhub_route_open(unsigned short port)
 	if (ret < 0)
 		return -EINVAL;
 
-	if (route_item->phead.pos) {
+	if (route_item->ring) {
 		hwlog_err("port:%d was already opened in %s.\n", port,
 			  __func__);
 		return -EINVAL;
 	}
 
-	pos = kzalloc(ROUTE_BUFFER_MAX_SIZE, GFP_KERNEL);
+	pos = vmalloc_user(ROUTE_RING_CTRL_SIZE + ROUTE_BUFFER_MAX_SIZE);
 	if (!pos)
 		return -ENOMEM;
 
-	route_item->phead.pos = pos;
-	route_item->pWrite.pos = pos;
-	route_item->pRead.pos = pos;
-	route_item->phead.buffer_size = ROUTE_BUFFER_MAX_SIZE;
-	route_item->pWrite.buffer_size = ROUTE_BUFFER_MAX_SIZE;
-	route_item->pRead.buffer_size = 0;
+	hrtimer_init(&route_item->wake_timer, CLOCK_BOOTTIME, HRTIMER_MODE_ABS);
+	route_item->wake_timer.function = route_wake_timer_fn;
+
+	spin_lock_irqsave(&route_item->buffer_spin_lock, flags);
+	route_item->ring = (struct inputhub_route_ring *)pos;
+	route_item->ring->size = ROUTE_BUFFER_MAX_SIZE;
+	route_item->buffer = pos + ROUTE_RING_CTRL_SIZE;
+	route_item->readable = false;
+	route_item->wake_deadline = 0;
+	spin_unlock_irqrestore(&route_item->buffer_spin_lock, flags);
 
 	return 0;
 }
@@ -356,6 +388,8 @@ EXPORT_SYMBOL_GPL(inputhub_route_open);
 void inputhub_route_close(unsigned short port)
 {
 	int ret;
+	unsigned long flags = 0;
+	struct inputhub_route_ring *ring;
 	struct inputhub_route_table *route_item;
 
 	hwlog_info("%s\n", __func__);
@@ -363,34 +397,104 @@ void inputhub_route_close(unsigned short port)
 	if (ret < 0)
 		return;
 
-	if (route_item->phead.pos)
-		kfree(route_item->phead.pos);
+	spin_lock_irqsave(&route_item->buffer_spin_lock, flags);
+	ring = route_item->ring;
+	route_item->ring = NULL;
+	route_item->buffer = NULL;
+	spin_unlock_irqrestore(&route_item->buffer_spin_lock, flags);
 
-	route_item->phead.pos = NULL;
-	route_item->pWrite.pos = NULL;
-	route_item->pRead.pos = NULL;
+	if (ring) {
+		hrtimer_cancel(&route_item->wake_timer);
+		vfree(ring);
+	}
 }
 
 EXPORT_SYMBOL_GPL(inputhub_route_close);
 
-static inline bool data_ready(struct inputhub_route_table *route_item,
-			      struct inputhub_buffer_pos *reader)
+/*
+ *Records are kept as [length][timestamp][payload] at free running offsets,
+ *ROUTE_BUFFER_MAX_SIZE is a power of two so offsets wrap with a mask.
+ */
+static inline void ring_copy_in(struct inputhub_route_table *route_item,
+				uint32_t off, const char *src, uint32_t len)
+{
+	uint32_t pos = off & (ROUTE_BUFFER_MAX_SIZE - 1);
+	uint32_t first = min_t(uint32_t, len, ROUTE_BUFFER_MAX_SIZE - pos);
+
+	memcpy(route_item->buffer + pos, src, first);
+	memcpy(route_item->buffer, src + first, len - first);
+}
+
+static inline void ring_copy_out(struct inputhub_route_table *route_item,
+				 uint32_t off, char *dst, uint32_t len)
+{
+	uint32_t pos = off & (ROUTE_BUFFER_MAX_SIZE - 1);
+	uint32_t first = min_t(uint32_t, len, ROUTE_BUFFER_MAX_SIZE - pos);
+
+	memcpy(dst, route_item->buffer + pos, first);
+	memcpy(dst + first, route_item->buffer, len - first);
+}
+
+static inline int ring_copy_to_user(struct inputhub_route_table *route_item,
+				    uint32_t off, char __user *dst,
+				    uint32_t len)
+{
+	uint32_t pos = off & (ROUTE_BUFFER_MAX_SIZE - 1);
+	uint32_t first = min_t(uint32_t, len, ROUTE_BUFFER_MAX_SIZE - pos);
+
+	if (copy_to_user(dst, route_item->buffer + pos, first))
+		return -EFAULT;
+	if (copy_to_user(dst + first, route_item->buffer, len - first))
+		return -EFAULT;
+	return 0;
+}
+
+/*
+ *tail is also written by the HAL through the mapping, so never trust it
+ *further than the bytes the kernel has actually queued.
+ *Called with buffer_spin_lock held.
+ */
+static uint32_t ring_used(struct inputhub_route_table *route_item)
+{
+	struct inputhub_route_ring *ring = route_item->ring;
+	uint32_t head = ring->head;
+	uint32_t used = head - ACCESS_ONCE(ring->tail);
+
+	if (used > ROUTE_BUFFER_MAX_SIZE) {
+		hwlog_err("bad ring tail in port %d, drop queued data!\n",
+			  (int)route_item->port);
+		ring->tail = head;
+		used = 0;
+	}
+	return used;
+}
+
+/*
+ *Data is ready once a wakeup was issued for it; records whose batched
+ *wakeup is still pending do not make poll()/read() return early.
+ */
+static bool data_ready(struct inputhub_route_table *route_item)
 {
 	unsigned long flags = 0;
+	bool ready = false;
+
 	spin_lock_irqsave(&route_item->buffer_spin_lock, flags);
-	*reader = route_item->pRead;
+	if (route_item->ring) {
+		if (!ring_used(route_item))
+			route_item->readable = false;
+		ready = route_item->readable;
+	}
 	spin_unlock_irqrestore(&route_item->buffer_spin_lock, flags);
-	return reader->buffer_size > 0;
+	return ready;
 }
 
 ssize_t inputhub_route_read(unsigned short port, char __user *buf,
 			    size_t count)
 {
 	struct inputhub_route_table *route_item;
-	struct inputhub_buffer_pos reader;
-	char *buffer_end;
 	unsigned int full_pkg_length;
-	unsigned int tail_half_len;
+	uint32_t tail;
+	uint32_t used;
 	unsigned long flags = 0;
 
 	if (inputhub_route_item(port, &route_item) != 0) {
@@ -398,35 +502,25 @@ ssize_t inputhub_route_read(unsigned short port, char __user *buf,
 		return 0;
 	}
 
-	buffer_end = route_item->phead.pos + route_item->phead.buffer_size;
-
 	/*woke up by signal*/
-	if (wait_event_interruptible(route_item->read_wait, data_ready(route_item, &reader)) != 0)
+	if (wait_event_interruptible(route_item->read_wait, data_ready(route_item)) != 0)
 		return 0;
 
-	if (reader.buffer_size > ROUTE_BUFFER_MAX_SIZE) {
-		hwlog_err("error reader.buffer_size = %d in port %d!\n",
-			  (int)reader.buffer_size, (int)port);
-		__dmd_log_report(DSM_SHB_ERR_IOM7_READ, __func__,
-			       "error reader.buffer_size in port\n");
-		goto clean_buffer;
+	spin_lock_irqsave(&route_item->buffer_spin_lock, flags);
+	if (!route_item->ring) {
+		spin_unlock_irqrestore(&route_item->buffer_spin_lock, flags);
+		return 0;
 	}
-
-	if (buffer_end - reader.pos >= LENGTH_SIZE) {
-		full_pkg_length = *((unsigned int *)reader.pos);
-		reader.pos += LENGTH_SIZE;
-		if (reader.pos == buffer_end)
-			reader.pos = route_item->phead.pos;
-	} else {
-		tail_half_len = buffer_end - reader.pos;
-		memcpy(&full_pkg_length, reader.pos, tail_half_len);
-		memcpy((char *)&full_pkg_length + tail_half_len,
-		       route_item->phead.pos, LENGTH_SIZE - tail_half_len);
-		reader.pos =
-		    route_item->phead.pos + (LENGTH_SIZE - tail_half_len);
+	used = ring_used(route_item);
+	tail = route_item->ring->tail;
+	if (used < HEAD_SIZE) {
+		spin_unlock_irqrestore(&route_item->buffer_spin_lock, flags);
+		return 0;
 	}
+	ring_copy_out(route_item, tail, (char *)&full_pkg_length, LENGTH_SIZE);
+	spin_unlock_irqrestore(&route_item->buffer_spin_lock, flags);
 
-	if (full_pkg_length + LENGTH_SIZE > reader.buffer_size
+	if (full_pkg_length + LENGTH_SIZE > used
 	    || full_pkg_length > count) {
 		hwlog_err("full_pkg_length = %u is too large in port %d!\n",
 			  full_pkg_length, (int)port);
@@ -435,48 +529,19 @@ ssize_t inputhub_route_read(unsigned short port, char __user *buf,
 		goto clean_buffer;
 	}
 
-	if (buffer_end - reader.pos >= full_pkg_length) {
-		if (0 == copy_to_user(buf, reader.pos, full_pkg_length)) {
-			reader.pos += full_pkg_length;
-			if (reader.pos == buffer_end)
-				reader.pos = route_item->phead.pos;
-		} else {
-			hwlog_err("copy to user failed\n");
-			__dmd_log_report(DSM_SHB_ERR_IOM7_READ, __func__,
-				       "copy to user failed\n");
-			return 0;
-		}
-	} else {
-		tail_half_len = buffer_end - reader.pos;
-		if ((0 == copy_to_user(buf, reader.pos, tail_half_len)) &&
-		    (0 ==
-		     copy_to_user(buf + tail_half_len, route_item->phead.pos,
-				  (full_pkg_length - tail_half_len)))) {
-			reader.pos =
-			    route_item->phead.pos + (full_pkg_length -
-						     tail_half_len);
-		} else {
-			hwlog_err("copy to user failed\n");
-			__dmd_log_report(DSM_SHB_ERR_IOM7_READ, __func__,
-				       "copy to user failed\n");
-			return 0;
-		}
+	/*the writer never overwrites past tail, so copy without the lock*/
+	if (ring_copy_to_user(route_item, tail + LENGTH_SIZE, buf,
+			      full_pkg_length)) {
+		hwlog_err("copy to user failed\n");
+		__dmd_log_report(DSM_SHB_ERR_IOM7_READ, __func__,
+			       "copy to user failed\n");
+		return 0;
 	}
+
 	spin_lock_irqsave(&route_item->buffer_spin_lock, flags);
-	route_item->pRead.pos = reader.pos;
-	route_item->pRead.buffer_size -= (full_pkg_length + LENGTH_SIZE);
-	if ((route_item->pWrite.buffer_size > ROUTE_BUFFER_MAX_SIZE)
-	    || (route_item->pWrite.buffer_size +
-		(full_pkg_length + LENGTH_SIZE) > ROUTE_BUFFER_MAX_SIZE)) {
-		hwlog_err("%s:%d write buffer error buffer_size=%u pkg_len=%u\n",
-			  __func__, __LINE__, route_item->pWrite.buffer_size,
-			  full_pkg_length);
-		spin_unlock_irqrestore(&route_item->buffer_spin_lock, flags);
-		goto clean_buffer;
-	} else {
-		route_item->pWrite.buffer_size +=
-		    (full_pkg_length + LENGTH_SIZE);
-	}
+	if (route_item->ring)
+		smp_store_release(&route_item->ring->tail,
+				  tail + LENGTH_SIZE + full_pkg_length);
 	spin_unlock_irqrestore(&route_item->buffer_spin_lock, flags);
 
 	return full_pkg_length;
@@ -485,15 +550,53 @@ clean_buffer:
 	hwlog_err("now we will clear the receive buffer in port %d!\n",
 		  (int)port);
 	spin_lock_irqsave(&route_item->buffer_spin_lock, flags);
-	route_item->pRead.pos = route_item->pWrite.pos;
-	route_item->pWrite.buffer_size = ROUTE_BUFFER_MAX_SIZE;
-	route_item->pRead.buffer_size = 0;
+	if (route_item->ring)
+		route_item->ring->tail = route_item->ring->head;
+	route_item->readable = false;
 	spin_unlock_irqrestore(&route_item->buffer_spin_lock, flags);
 	return 0;
 }
 
 EXPORT_SYMBOL_GPL(inputhub_route_read);
 
+unsigned int inputhub_route_poll(unsigned short port, struct file *file,
+				 poll_table *wait)
+{
+	struct inputhub_route_table *route_item;
+
+	if (inputhub_route_item(port, &route_item) != 0)
+		return POLLERR;
+
+	poll_wait(file, &route_item->read_wait, wait);
+	return data_ready(route_item) ? (POLLIN | POLLRDNORM) : 0;
+}
+
+EXPORT_SYMBOL_GPL(inputhub_route_poll);
+
+/*
+ *Map the control page and the record area read-write; the HAL consumes
+ *records in place and publishes its progress by advancing ring->tail.
+ */
+int inputhub_route_mmap(unsigned short port, struct vm_area_struct *vma)
+{
+	struct inputhub_route_table *route_item;
+
+	if (inputhub_route_item(port, &route_item) != 0)
+		return -EINVAL;
+
+	if (!route_item->ring)
+		return -ENODEV;
+
+	if (vma->vm_pgoff != 0
+	    || vma->vm_end - vma->vm_start !=
+	    ROUTE_RING_CTRL_SIZE + ROUTE_BUFFER_MAX_SIZE)
+		return -EINVAL;
+
+	return remap_vmalloc_range(vma, route_item->ring, 0);
+}
+
+EXPORT_SYMBOL_GPL(inputhub_route_mmap);
+
 static int64_t getTimestamp(void)
 {
 	struct timespec ts;
@@ -502,24 +605,127 @@ static int64_t getTimestamp(void)
 	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
 }
 
-static inline void write_to_fifo(struct inputhub_buffer_pos *pwriter,
-				 char *const buffer_begin,
-				 char *const buffer_end, char *buf, int count)
+/*
+ *Latest time the record may sit in the ring before readers have to be
+ *woken: its sample time plus the sensor's max report latency. Only the
+ *sensorhub port carries batched sensors; everything else is immediate.
+ */
+static int64_t route_wake_deadline(unsigned short port, const char *buf,
+				   size_t count, int64_t timestamp,
+				   int64_t now)
 {
-	int cur_to_tail_len = buffer_end - pwriter->pos;
+	const struct sensor_data *event = (const struct sensor_data *)buf;
+	unsigned int latency_ms;
+	int tag;
+
+	if (ROUTE_SHB_PORT != port
+	    || count < OFFSET_OF_END_MEM(struct sensor_data, type)
+	    || event->type >= SENSORHUB_TYPE_END)
+		return now;
+
+	tag = hal_sensor_type_to_tag[event->type];
+	if (tag_to_hal_sensor_type[tag] != event->type)
+		return now;
 
-	if (cur_to_tail_len >= count) {
-		memcpy(pwriter->pos, buf, count);
-		pwriter->pos += count;
-		if (buffer_end == pwriter->pos) {
-			pwriter->pos = buffer_begin;
+	latency_ms = ACCESS_ONCE(report_latency_ms[tag]);
+	if (!latency_ms)
+		return now;
+
+	if (timestamp <= 0 || timestamp > now)
+		timestamp = now;
+	return timestamp + (int64_t)latency_ms * NSEC_PER_MSEC;
+}
+
+/*
+ *Decide whether readers must be woken for the record just queued, or
+ *whether an already armed (or newly armed) batched wakeup covers it.
+ *Called with buffer_spin_lock held.
+ */
+static bool route_wake_now(struct inputhub_route_table *route_item,
+			   int64_t deadline, int64_t now, uint32_t used)
+{
+	if (used >= ROUTE_WAKE_WATERMARK || deadline - now < ROUTE_WAKE_SLACK_NS) {
+		if (route_item->wake_deadline) {
+			hrtimer_try_to_cancel(&route_item->wake_timer);
+			route_item->wake_deadline = 0;
 		}
-	} else {
-		memcpy(pwriter->pos, buf, cur_to_tail_len);
-		memcpy(buffer_begin, buf + cur_to_tail_len,
-		       count - cur_to_tail_len);
-		pwriter->pos = buffer_begin + (count - cur_to_tail_len);
+		route_item->readable = true;
+		return true;
+	}
+
+	if (route_item->wake_deadline && route_item->wake_deadline <= deadline)
+		return false;
+
+	route_item->wake_deadline = deadline;
+	hrtimer_start(&route_item->wake_timer, ns_to_ktime(deadline),
+		      HRTIMER_MODE_ABS);
+	return false;
+}
+
+static ssize_t route_write_record(unsigned short port, char *buf,
+				  size_t count, int64_t timestamp)
+{
+	struct inputhub_route_table *route_item;
+	struct inputhub_route_ring *ring;
+	t_head header;
+	uint32_t head;
+	uint32_t used;
+	uint32_t dropped;
+	int64_t now;
+	int64_t deadline;
+	bool wake = false;
+	unsigned long flags = 0;
+
+	if (inputhub_route_item(port, &route_item) != 0) {
+		hwlog_err("inputhub_route_item failed in %s port = %d!\n",
+			  __func__, (int)port);
+		return 0;
+	}
+
+	if (count > ROUTE_BUFFER_MAX_SIZE - HEAD_SIZE) {
+		hwlog_err("%s :count is too large :%zd!\n", __func__, count);
+		return 0;
+	}
+	header.timestamp = timestamp;
+	header.pkg_length = count + sizeof(int64_t);
+	now = getTimestamp();
+	deadline = route_wake_deadline(port, buf, count, timestamp, now);
+
+	spin_lock_irqsave(&route_item->buffer_spin_lock, flags);
+	ring = route_item->ring;
+	if (!ring) {
+		spin_unlock_irqrestore(&route_item->buffer_spin_lock, flags);
+		return 0;
 	}
+
+	used = ring_used(route_item);
+	if (ROUTE_BUFFER_MAX_SIZE - used < count + HEAD_SIZE) {
+		dropped = ++ring->dropped_events;
+		ring->dropped_bytes += count + HEAD_SIZE;
+		/*reader is behind, make sure it is at least running*/
+		wake = route_wake_now(route_item, now, now, used);
+		spin_unlock_irqrestore(&route_item->buffer_spin_lock, flags);
+		if (wake)
+			wake_up_interruptible(&route_item->read_wait);
+		if (printk_ratelimit())
+			hwlog_err("port %d full, %u events dropped\n",
+				  (int)port, dropped);
+		return 0;
+	}
+
+	head = ring->head;
+	ring_copy_in(route_item, head, header.effect_addr, HEAD_SIZE);
+	ring_copy_in(route_item, head + HEAD_SIZE, buf, count);
+	/*publish the record only after its bytes are in place*/
+	smp_store_release(&ring->head, head + count + HEAD_SIZE);
+
+	wake = route_wake_now(route_item, deadline, now,
+			      used + count + HEAD_SIZE);
+	spin_unlock_irqrestore(&route_item->buffer_spin_lock, flags);
+	if (wake)
+		wake_up_interruptible(&route_item->read_wait);
+
+	return (count + HEAD_SIZE);
 }
 
 t_ap_sensor_ops_record all_ap_sensor_operations[TAG_SENSOR_END] = {
@@ -623,97 +829,12 @@ bool ap_sensor_setdelay(int tag, int ms)
 ssize_t inputhub_route_write_batch(unsigned short port, char *buf, size_t count,
 				   int64_t timestamp)
 {
-	struct inputhub_route_table *route_item;
-	struct inputhub_buffer_pos writer;
-	char *buffer_begin, *buffer_end;
-	t_head header;
-	unsigned long flags = 0;
-
-	if (inputhub_route_item(port, &route_item) != 0) {
-		hwlog_err("inputhub_route_item failed in %s port = %d!\n",
-			  __func__, (int)port);
-		return 0;
-	}
-	header.timestamp = timestamp;
-
-	spin_lock_irqsave(&route_item->buffer_spin_lock, flags);
-	writer = route_item->pWrite;
-
-	if (writer.buffer_size < count + HEAD_SIZE) {
-		spin_unlock_irqrestore(&route_item->buffer_spin_lock, flags);
-		/*hwlog_err("inputhub_route_write_batch failed buffer not enough!\n");*/
-		return 0;
-	}
-
-	buffer_begin = route_item->phead.pos;
-	buffer_end = route_item->phead.pos + route_item->phead.buffer_size;
-	if (UINT_MAX - count < sizeof(int64_t)) {
-		hwlog_err("inputhub_route_write_batch :count is too large :%zd!\n",
-		     count);
-		spin_unlock_irqrestore(&route_item->buffer_spin_lock, flags);
-		return 0;
-	} else {
-		header.pkg_length = count + sizeof(int64_t);
-	}
-	write_to_fifo(&writer, buffer_begin, buffer_end, header.effect_addr,
-		      HEAD_SIZE);
-	write_to_fifo(&writer, buffer_begin, buffer_end, buf, count);
-
-	route_item->pWrite.pos = writer.pos;
-	route_item->pWrite.buffer_size -= (count + HEAD_SIZE);
-	if ((UINT_MAX - route_item->pRead.buffer_size) < (count + HEAD_SIZE)) {
-		hwlog_err("inputhub_route_write_batch:pRead :count is too large :%zd!\n",
-		     count);
-		spin_unlock_irqrestore(&route_item->buffer_spin_lock, flags);
-		return 0;
-	} else {
-		route_item->pRead.buffer_size += (count + HEAD_SIZE);
-	}
-	spin_unlock_irqrestore(&route_item->buffer_spin_lock, flags);
-	atomic_set(&route_item->data_ready, 1);
-	wake_up_interruptible(&route_item->read_wait);
-
-	return (count + HEAD_SIZE);
+	return route_write_record(port, buf, count, timestamp);
 }
 
 ssize_t inputhub_route_write(unsigned short port, char *buf, size_t count)
 {
-	struct inputhub_route_table *route_item;
-	struct inputhub_buffer_pos writer;
-	char *buffer_begin, *buffer_end;
-	t_head header;
-	unsigned long flags = 0;
-
-	if (inputhub_route_item(port, &route_item) != 0) {
-		hwlog_err("inputhub_route_item failed in %s port = %d!\n",
-			  __func__, (int)port);
-		return 0;
-	}
-	header.timestamp = getTimestamp();
-
-	spin_lock_irqsave(&route_item->buffer_spin_lock, flags);
-	writer = route_item->pWrite;
-
-	if (writer.buffer_size < count + HEAD_SIZE) {
-		spin_unlock_irqrestore(&route_item->buffer_spin_lock, flags);
-		return 0;
-	}
-
-	buffer_begin = route_item->phead.pos;
-	buffer_end = route_item->phead.pos + route_item->phead.buffer_size;
-	header.pkg_length = count + sizeof(int64_t);
-	write_to_fifo(&writer, buffer_begin, buffer_end, header.effect_addr,
-		      HEAD_SIZE);
-	write_to_fifo(&writer, buffer_begin, buffer_end, buf, count);
-
-	route_item->pWrite.pos = writer.pos;
-	route_item->pWrite.buffer_size -= (count + HEAD_SIZE);
-	route_item->pRead.buffer_size += (count + HEAD_SIZE);
-	spin_unlock_irqrestore(&route_item->buffer_spin_lock, flags);
-	atomic_set(&route_item->data_ready, 1);
-	wake_up_interruptible(&route_item->read_wait);
-
-	return (count + HEAD_SIZE);
+	return route_write_record(port, buf, count, getTimestamp());
 }
 EXPORT_SYMBOL_GPL(inputhub_route_write);
 
@@ -1575,6 +1696,159 @@ static int inputhub_sensor_enable_internal(int tag, bool enable,
 	}
 }
 
+/*
+ *Screen-off FIFO batching: while the screen is off, non-wakeup sensors with
+ *a flush period configured let the sensorhub hold their samples in its FIFO
+ *and hand them to the AP in one IPC per flush period, instead of one IPC
+ *per sample period. The HAL's own period and batch count are remembered so
+ *they are restored unchanged when the screen comes back on.
+ */
+static unsigned int fifo_flush_ms[TAG_SENSOR_END];
+static open_param_t fifo_hal_param[TAG_SENSOR_END];
+static bool fifo_batch_screen_off;
+static DEFINE_MUTEX(fifo_batch_mutex);
+
+struct sensorhub_wake_stats sensorhub_wake_stats;
+static bool ap_wake_attributed = true;
+
+static bool is_fifo_batchable(int tag)
+{
+	switch (tag) {
+	case TAG_ACCEL:
+	case TAG_GYRO:
+	case TAG_MAG:
+	case TAG_LINEAR_ACCEL:
+	case TAG_GRAVITY:
+	case TAG_ORIENTATION:
+	case TAG_ROTATION_VECTORS:
+	case TAG_MAG_UNCALIBRATED:
+	case TAG_GAME_RV:
+	case TAG_GYRO_UNCALIBRATED:
+	case TAG_GEOMAGNETIC_RV:
+	case TAG_PRESSURE:
+	case TAG_STEP_COUNTER:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/*
+ *Record the HAL's request and, while the screen is off, stretch its batch
+ *count so the sensorhub flushes at most once per configured flush period.
+ *Only the standard client is touched, extend step counter keeps its own.
+ */
+static void fifo_batch_adjust(int tag, open_param_t *param)
+{
+	uint32_t count;
+
+	if (!is_fifo_batchable(tag) || param->reserved[0] != TYPE_STANDARD)
+		return;
+
+	mutex_lock(&fifo_batch_mutex);
+	fifo_hal_param[tag] = *param;
+	if (fifo_batch_screen_off && fifo_flush_ms[tag] && param->period) {
+		count = fifo_flush_ms[tag] / param->period;
+		if (count > param->batch_count) {
+			hwlog_info("screen off batch %s (tag:%d) count %u->%u\n",
+				   obj_tag_str[tag] ? obj_tag_str[tag] :
+				   "TAG_UNKNOWN", tag, param->batch_count, count);
+			param->batch_count = count;
+		}
+	}
+	mutex_unlock(&fifo_batch_mutex);
+}
+
+static int inputhub_sensor_setdelay_internal(int tag, open_param_t *param);
+
+static void fifo_batch_work_handler(struct work_struct *work)
+{
+	open_param_t param;
+	int tag;
+
+	for (tag = TAG_SENSOR_BEGIN; tag < TAG_SENSOR_END; ++tag) {
+		if (!is_fifo_batchable(tag) || !fifo_flush_ms[tag])
+			continue;
+
+		mutex_lock(&fifo_batch_mutex);
+		param = fifo_hal_param[tag];
+		mutex_unlock(&fifo_batch_mutex);
+
+		if (!sensor_status.status[tag] || !param.period)
+			continue;
+
+		inputhub_sensor_setdelay_internal(tag, &param);
+	}
+}
+
+static DECLARE_WORK(fifo_batch_work, fifo_batch_work_handler);
+
+static void fifo_batch_screen_changed(bool screen_off)
+{
+	mutex_lock(&fifo_batch_mutex);
+	fifo_batch_screen_off = screen_off;
+	mutex_unlock(&fifo_batch_mutex);
+	schedule_work(&fifo_batch_work);
+}
+
+/**
+ *inputhub_sensor_set_fifo_batch - set a sensor's screen-off flush period
+ *@tag: non-wakeup sensor tag
+ *@flush_ms: longest time the sensorhub may hold samples while the screen
+ *is off, 0 to deliver at the HAL's own batch count
+ *
+ *Takes effect immediately if the screen is already off.
+ */
+int inputhub_sensor_set_fifo_batch(int tag, unsigned int flush_ms)
+{
+	if (!(TAG_SENSOR_BEGIN <= tag && tag < TAG_SENSOR_END)
+	    || !is_fifo_batchable(tag)) {
+		hwlog_err("tag %d can not be fifo batched in %s\n", tag,
+			  __func__);
+		return -EINVAL;
+	}
+
+	mutex_lock(&fifo_batch_mutex);
+	fifo_flush_ms[tag] = flush_ms;
+	mutex_unlock(&fifo_batch_mutex);
+
+	if (fifo_batch_screen_off)
+		schedule_work(&fifo_batch_work);
+	return 0;
+}
+EXPORT_SYMBOL_GPL(inputhub_sensor_set_fifo_batch);
+
+unsigned int inputhub_sensor_get_fifo_batch(int tag)
+{
+	if (TAG_SENSOR_BEGIN <= tag && tag < TAG_SENSOR_END)
+		return fifo_flush_ms[tag];
+	return 0;
+}
+
+/*
+ *Attribute AP wakeups to the sensorhub: the first non-system IPC after the
+ *AP told the sensorhub it is going to sleep is what pulled it back out, and
+ *every IPC while the screen is off costs the AP an exit from idle.
+ */
+static void account_sensorhub_wakeup(const pkt_header_t *head)
+{
+	if (TAG_SYS == head->tag)
+		return;
+
+	if (ST_SLEEP == iom3_power_state && !ap_wake_attributed) {
+		ap_wake_attributed = true;
+		++sensorhub_wake_stats.ap_wake_cnt[head->tag];
+	}
+
+	if (fifo_batch_screen_off)
+		++sensorhub_wake_stats.screen_off_ipc_cnt[head->tag];
+}
+
+void clean_sensorhub_wake_stats(void)
+{
+	memset(&sensorhub_wake_stats, 0, sizeof(sensorhub_wake_stats));
+}
+
 static int inputhub_sensor_setdelay_internal(int tag, open_param_t *param)
 {
 	pkt_cmn_interval_req_t pkt;
@@ -1604,6 +1878,7 @@ static int inputhub_sensor_setdelay_internal(int tag, open_param_t *param)
 		pkt.hd.resp = NO_RESP;
 		pkt.hd.length = sizeof(open_param_t);
 		memcpy(&pkt.param, param, sizeof(pkt.param));
+		fifo_batch_adjust(tag, &pkt.param);
 		hwlog_info("set sensor %s (tag:%d) delay %d ms!\n",
 			   obj_tag_str[tag] ? obj_tag_str[tag] : "TAG_UNKNOWN",
 			   tag, param->period);
@@ -1921,6 +2196,16 @@ bool ap_sensor_flush(int tag)
 	return work_on_ap;
 }
 
+/*
+ *Remember the max report latency the HAL asked for, so reader wakeups for
+ *this sensor's events can be batched up to it.
+ */
+static void set_report_latency(int tag, unsigned int latency_ms)
+{
+	if (TAG_SENSOR_BEGIN <= tag && tag < TAG_SENSOR_END)
+		ACCESS_ONCE(report_latency_ms[tag]) = latency_ms;
+}
+
 int send_sensor_batch_flush_cmd(unsigned int cmd, struct ioctl_para *para,
 				int tag)
 {
@@ -1935,6 +2220,8 @@ int send_sensor_batch_flush_cmd(unsigned int cmd, struct ioctl_para *para,
 		};
 		hwlog_info("batch in %s period=%d, count=%d\n", __func__,
 			   para->period_ms, batch_param.batch_count);
+		set_report_latency(tag, (batch_param.batch_count > 1) ?
+				   para->timeout_ms : 0);
 		return inputhub_sensor_setdelay_internal(tag, &batch_param);
 	} else if (SHB_IOCTL_APP_SENSOR_FLUSH == cmd) {
 		hwlog_info("flush in %s \n", __func__);
@@ -1976,12 +2263,14 @@ static int send_sensor_cmd(unsigned int cmd, unsigned long arg)
 	switch (cmd) {
 	case SHB_IOCTL_APP_ENABLE_SENSOR:
 	case SHB_IOCTL_APP_DISABLE_SENSOR:
+		set_report_latency(tag, 0);
 		return inputhub_sensor_enable(tag,
 					      SHB_IOCTL_APP_ENABLE_SENSOR ==
 					      cmd);
 		break;
 
 	case SHB_IOCTL_APP_DELAY_SENSOR:
+		set_report_latency(tag, 0);
 		if (tag == TAG_STEP_COUNTER) {
 			inputhub_sensor_setdelay(tag, para.delay_ms);
 			app_config[0] = 1;
@@ -2810,6 +3099,13 @@ int inputhub_route_recv_mcu_data(const char *buf, unsigned int length)
     }
 
     ++ipc_debug_info.event_cnt[head->tag];
+    account_sensorhub_wakeup(head);
+
+    /*sensor samples arrive periodically, let cpuidle learn the period*/
+    if (CMD_DATA_REQ == head->cmd)
+    {
+        cpuidle_periodic_event(CPUIDLE_EVENT_SENSORHUB, ktime_get_ns(), 0);
+    }
 
     wake_up_mcu_event_waiter(head);
 
@@ -3099,11 +3395,13 @@ static int sensorhub_fb_notifier(struct notifier_block *nb,
 			switch (*blank) {
 			case FB_BLANK_UNBLANK:	/*screen on */
 				tell_ap_status_to_mcu(ST_SCREENON);
+				fifo_batch_screen_changed(false);
 				key_fb_notifier_action(1);
 				break;
 
 			case FB_BLANK_POWERDOWN:	/* screen off */
 				tell_ap_status_to_mcu(ST_SCREENOFF);
+				fifo_batch_screen_changed(true);
 				sensor_redetect_enter();
 				key_fb_notifier_action(0);
 				break;
@@ -3135,6 +3433,7 @@ int sensorhub_pm_suspend(struct device *dev)
 	if (iom3_sr_status != ST_SLEEP) {
 		ret = tell_ap_status_to_mcu(ST_SLEEP);
 		iom3_power_state = ST_SLEEP;
+		ap_wake_attributed = false;
 		check_current_app();
 		clean_ipc_debug_info();
 	}
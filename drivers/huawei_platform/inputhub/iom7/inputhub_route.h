@@ -10,6 +10,8 @@
 #define __LINUX_INPUTHUB_ROUTE_H__
 #include "protocol.h"
 #include <linux/version.h>
+#include <linux/poll.h>
+#include <linux/mm_types.h>
 #include <huawei_platform/log/hw_log.h>
 
 #define IOM3_ST_NORMAL			(0)
@@ -62,6 +64,23 @@ struct sensor_data {
 	};
 };
 
+/*
+ *Control page at offset 0 of a port's mmap(); the record area follows at
+ *ROUTE_RING_CTRL_SIZE. head and tail are free running byte offsets into
+ *the record area (wrap at size). The kernel only moves head, the reader
+ *moves tail once it has consumed a record. Records are laid out as
+ *[u32 length][s64 timestamp][payload], length covering timestamp and
+ *payload, and may wrap. Shared with the sensor HAL, keep the layout.
+ */
+struct inputhub_route_ring {
+	uint32_t size;
+	uint32_t head;
+	uint32_t tail;
+	uint32_t dropped_events;	/*records lost because the ring was full*/
+	uint32_t dropped_bytes;
+	uint32_t reserved[3];
+};
+
 typedef struct write_info {
 	int tag;
 	int cmd;
@@ -147,6 +166,10 @@ extern ssize_t inputhub_route_read(unsigned short port, char __user *buf,
 				   size_t count);
 extern int inputhub_route_cmd(unsigned short port, unsigned int cmd,
 			      unsigned long arg);
+extern unsigned int inputhub_route_poll(unsigned short port,
+					struct file *file, poll_table *wait);
+extern int inputhub_route_mmap(unsigned short port,
+			       struct vm_area_struct *vma);
 
 /*called by inputhub_mcu module or test module.*/
 extern int inputhub_route_init(void);
@@ -170,6 +193,16 @@ extern int inputhub_sensor_setdelay(int tag, int delay_ms);
 extern int inputhub_sensor_enable_nolock(int tag, bool enable);
 extern int inputhub_sensor_setdelay_nolock(int tag, int delay_ms,
 					   int batch_count);
+extern int inputhub_sensor_set_fifo_batch(int tag, unsigned int flush_ms);
+extern unsigned int inputhub_sensor_get_fifo_batch(int tag);
+
+/*AP wakeups and screen-off IPCs caused by each sensorhub tag*/
+struct sensorhub_wake_stats {
+	unsigned int ap_wake_cnt[TAG_END];
+	unsigned int screen_off_ipc_cnt[TAG_END];
+};
+extern struct sensorhub_wake_stats sensorhub_wake_stats;
+extern void clean_sensorhub_wake_stats(void);
 extern int inputhub_mcu_write_cmd(const void *buf, unsigned int length);
 extern int inputhub_mcu_write_cmd_nolock(const void *buf, unsigned int length);
 extern int register_ap_sensor_operations(int tag, sensor_operation_t *ops);
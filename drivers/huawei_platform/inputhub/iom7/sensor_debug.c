@@ -405,6 +405,15 @@ static int aod_test(int tag, int argv[], int argc)
 	return 0;
 }
 
+static int set_fifo_batch(int tag, int argv[], int argc)
+{
+	if (-1 == tag || 1 != argc || argv[0] < 0)
+		return -1;
+
+	hwlog_info("set sensor %d screen off flush %d ms\n", tag, argv[0]);
+	return inputhub_sensor_set_fifo_batch(tag, argv[0]);
+}
+
 static int thermal_test(int tag, int argv[], int argc)
 {
 	write_info_t pkg_ap;
@@ -624,6 +633,7 @@ static void register_my_debug_operations(void)
 	REGISTER_SENSORHUB_DEBUG_OPERATION(ar_test);
 	REGISTER_SENSORHUB_DEBUG_OPERATION(aod_test);
 	REGISTER_SENSORHUB_DEBUG_OPERATION(thermal_test);
+	REGISTER_SENSORHUB_DEBUG_OPERATION(set_fifo_batch);
 }
 
 static inline bool is_space_ch(char ch)
@@ -862,6 +872,43 @@ static ssize_t cls_attr_kernel_support_lib_ver_show_func(struct class *cls,
 static CLASS_ATTR(libsensor_ver, 0660,
 		  cls_attr_kernel_support_lib_ver_show_func, NULL);
 
+/*AP wakeups caused by the sensorhub, write anything to clear*/
+static ssize_t cls_attr_wake_stats_show_func(struct class *cls,
+					     struct class_attribute *attr,
+					     char *buf)
+{
+	int tag;
+	unsigned int wake, ipc, flush;
+	ssize_t offset = 0;
+
+	offset += scnprintf(buf + offset, PAGE_SIZE - offset,
+			    "tag name ap_wake screen_off_ipc flush_ms\n");
+	for (tag = TAG_BEGIN; tag < TAG_END; ++tag) {
+		wake = sensorhub_wake_stats.ap_wake_cnt[tag];
+		ipc = sensorhub_wake_stats.screen_off_ipc_cnt[tag];
+		flush = inputhub_sensor_get_fifo_batch(tag);
+		if (!wake && !ipc && !flush)
+			continue;
+		offset += scnprintf(buf + offset, PAGE_SIZE - offset,
+				    "%d %s %u %u %u\n", tag,
+				    obj_tag_str[tag] ? obj_tag_str[tag] :
+				    "TAG_UNKNOWN", wake, ipc, flush);
+	}
+
+	return offset;
+}
+
+static ssize_t cls_attr_wake_stats_store_func(struct class *cls,
+					      struct class_attribute *attr,
+					      const char *buf, size_t size)
+{
+	clean_sensorhub_wake_stats();
+	return size;
+}
+
+static CLASS_ATTR(sensorhub_wake_stats, 0660, cls_attr_wake_stats_show_func,
+		  cls_attr_wake_stats_store_func);
+
 static void sensorhub_debug_init(void)
 {
 	if (class_create_file(sensors_class, &class_attr_sensorhub_dbg))
@@ -873,6 +920,10 @@ static void sensorhub_debug_init(void)
 	if (class_create_file(sensors_class, &class_attr_libsensor_ver))
 		hwlog_err("create files libsensor_ver in %s\n", __func__);
 
+	if (class_create_file(sensors_class, &class_attr_sensorhub_wake_stats))
+		hwlog_err("create files sensorhub_wake_stats in %s\n",
+			  __func__);
+
 	register_my_debug_operations();
 }
 
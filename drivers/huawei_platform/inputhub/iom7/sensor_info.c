@@ -6520,6 +6520,8 @@ static int sensorhub_io_driver_probe(struct platform_device *pdev)
 		pr_err("[%s] platform_get_irq err\n", __func__);
 		return -ENXIO;
 	}
+	/* suspend/resume only message the mcu, nothing waits on them */
+	device_enable_async_suspend(&pdev->dev);
 	hwlog_err("%s: sensorhub_io_driver_probe success!\n", __func__);
 	return 0;
 }
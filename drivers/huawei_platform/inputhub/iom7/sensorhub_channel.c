@@ -53,6 +53,17 @@ static ssize_t shb_read(struct file *file, char __user *buf, size_t count,
     return inputhub_route_read(ROUTE_SHB_PORT,buf, count);
 }
 
+static unsigned int shb_poll(struct file *file, poll_table *wait)
+{
+    return inputhub_route_poll(ROUTE_SHB_PORT, file, wait);
+}
+
+/* the HAL maps the report ring and consumes records in place */
+static int shb_mmap(struct file *file, struct vm_area_struct *vma)
+{
+    return inputhub_route_mmap(ROUTE_SHB_PORT, vma);
+}
+
 static ssize_t shb_write(struct file *file, const char __user *data,
                         size_t len, loff_t *ppos)
 {
@@ -285,6 +296,8 @@ static const struct file_operations shb_fops = {
     .owner      =   THIS_MODULE,
     .llseek     =   no_llseek,
     .read = shb_read,
+    .poll       =   shb_poll,
+    .mmap       =   shb_mmap,
     .write      =   shb_write,
     .unlocked_ioctl =   shb_ioctl,
 #ifdef CONFIG_COMPAT
@@ -210,6 +210,9 @@ int __init comm_stat_init(void)
 		goto no_stats_entry;
 	}
 
+	/* Latency telemetry is optional, plain byte counts still work */
+	comm_lat_init(comm_stats_procdir);
+
 	return 0;
 no_stats_entry:
 	remove_proc_entry("comm", init_net.proc_net);
@@ -1,7 +1,86 @@
 #ifndef _COMMSTAT_H
 #define _COMMSTAT_H
 
+#include <linux/types.h>
+#include <linux/skbuff.h>
+#include <linux/tcp.h>
+#include <linux/udp.h>
+
 void inet_save_comm_stat(struct socket *sock, int tx, int len);
 int comm_stat_init(void);
 
+/*
+ * Per-UID latency telemetry, exported read-only through mmap() of
+ * /proc/net/comm/latency: a struct comm_lat_hdr followed by nr_rings
+ * struct comm_lat_ring. A ring belongs to one UID for the lifetime of
+ * the system.
+ *
+ * Samples are written without locks. A sample is valid only if its seq
+ * equals its ring position + 1, read both before and after the other
+ * fields. head is the newest position seen by a writer and is only a
+ * hint for where to start scanning.
+ */
+#define COMM_LAT_VERSION	1
+#define COMM_LAT_RING_BITS	8
+#define COMM_LAT_NR_RINGS	(1 << COMM_LAT_RING_BITS)
+#define COMM_LAT_RING_SIZE	32	/* samples per UID, power of two */
+#define COMM_LAT_UID_FREE	0xffffffffU
+
+#define COMM_LAT_DNS_PORT	53
+
+enum comm_lat_type {
+	COMM_LAT_TCP_HANDSHAKE = 1,	/* SYN to SYN-ACK */
+	COMM_LAT_TCP_FIRST_BYTE,	/* handshake done to first payload */
+	COMM_LAT_DNS,			/* query sent to reply received */
+};
+
+struct comm_lat_sample {
+	__u32 seq;
+	__u16 type;		/* enum comm_lat_type */
+	__u16 family;		/* AF_INET or AF_INET6 */
+	__u32 latency_us;
+	__u32 time_ms;		/* boot time when the sample was taken */
+};
+
+struct comm_lat_ring {
+	__u32 uid;		/* COMM_LAT_UID_FREE while unused */
+	__u32 head;
+	__u32 reserved[2];
+	struct comm_lat_sample samples[COMM_LAT_RING_SIZE];
+};
+
+struct comm_lat_hdr {
+	__u32 version;
+	__u32 nr_rings;
+	__u32 ring_size;
+	__u32 dropped;		/* samples lost because every ring was taken */
+};
+
+struct proc_dir_entry;
+
+int comm_lat_init(struct proc_dir_entry *dir);
+void comm_lat_tcp_connect(struct sock *sk);
+void comm_lat_tcp_first_byte(struct sock *sk);
+void comm_lat_dns_done(struct sock *sk);
+
+/* Called on every in-order data segment, keep the common case cheap */
+static inline void comm_lat_tcp_data(struct sock *sk)
+{
+	if (unlikely(tcp_sk(sk)->comm_lat_stamp.v64))
+		comm_lat_tcp_first_byte(sk);
+}
+
+static inline void comm_lat_dns_query(struct sock *sk, __be16 dport)
+{
+	if (dport == htons(COMM_LAT_DNS_PORT))
+		skb_mstamp_get(&udp_sk(sk)->comm_lat_stamp);
+}
+
+static inline void comm_lat_dns_reply(struct sock *sk, struct sk_buff *skb)
+{
+	if (unlikely(udp_sk(sk)->comm_lat_stamp.v64) &&
+	    udp_hdr(skb)->source == htons(COMM_LAT_DNS_PORT))
+		comm_lat_dns_done(sk);
+}
+
 #endif	/* _COMMSTAT_H */
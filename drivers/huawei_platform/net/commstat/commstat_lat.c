@@ -0,0 +1,158 @@
+#include <linux/types.h>
+#include <linux/atomic.h>
+#include <linux/hash.h>
+#include <linux/mm.h>
+#include <linux/proc_fs.h>
+#include <linux/vmalloc.h>
+
+#include <net/sock.h>
+#include <net/tcp.h>
+
+#include "commstat.h"
+
+/* Open addressing probes before a UID is counted as dropped */
+#define COMM_LAT_PROBES		8
+
+static struct comm_lat_hdr *comm_lat_buf;
+static unsigned long comm_lat_buf_size;
+
+/* Kernel side write positions, the mapped head is only a copy */
+static atomic_t comm_lat_head[COMM_LAT_NR_RINGS];
+static atomic_t comm_lat_dropped;
+
+static inline struct comm_lat_ring *comm_lat_ring(unsigned int idx)
+{
+	return (struct comm_lat_ring *)(comm_lat_buf + 1) + idx;
+}
+
+static struct comm_lat_ring *comm_lat_ring_get(u32 uid, unsigned int *idx)
+{
+	unsigned int i, n = hash_32(uid, COMM_LAT_RING_BITS);
+	struct comm_lat_ring *ring;
+	u32 owner;
+
+	for (i = 0; i < COMM_LAT_PROBES; i++) {
+		ring = comm_lat_ring(n);
+		owner = READ_ONCE(ring->uid);
+		if (owner == COMM_LAT_UID_FREE)
+			owner = cmpxchg(&ring->uid, COMM_LAT_UID_FREE, uid);
+		if (owner == COMM_LAT_UID_FREE || owner == uid) {
+			*idx = n;
+			return ring;
+		}
+		n = (n + 1) & (COMM_LAT_NR_RINGS - 1);
+	}
+
+	return NULL;
+}
+
+static void comm_lat_record(struct sock *sk, u16 type, u32 latency_us)
+{
+	u32 uid = from_kuid_munged(&init_user_ns, sock_i_uid(sk));
+	struct comm_lat_sample *s;
+	struct comm_lat_ring *ring;
+	unsigned int idx;
+	u32 pos;
+
+	if (!comm_lat_buf)
+		return;
+
+	ring = comm_lat_ring_get(uid, &idx);
+	if (!ring) {
+		WRITE_ONCE(comm_lat_buf->dropped,
+			   atomic_inc_return(&comm_lat_dropped));
+		return;
+	}
+
+	pos = atomic_inc_return(&comm_lat_head[idx]);
+	s = &ring->samples[(pos - 1) & (COMM_LAT_RING_SIZE - 1)];
+
+	WRITE_ONCE(s->seq, 0);
+	smp_wmb();
+	s->type = type;
+	s->family = sk->sk_family;
+	s->latency_us = latency_us;
+	s->time_ms = div_u64(ktime_get_boot_ns(), NSEC_PER_MSEC);
+	smp_wmb();
+	WRITE_ONCE(s->seq, pos);
+	WRITE_ONCE(ring->head, pos);
+}
+
+/*
+ * Called from tcp_rcv_synsent_state_process() once the SYN-ACK has been
+ * acked, before tcp_finish_connect() may seed srtt from cached metrics.
+ * A retransmitted SYN gives no RTT sample and is not reported.
+ */
+void comm_lat_tcp_connect(struct sock *sk)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+
+	if (tp->srtt_us)
+		comm_lat_record(sk, COMM_LAT_TCP_HANDSHAKE, tp->srtt_us >> 3);
+
+	skb_mstamp_get(&tp->comm_lat_stamp);
+}
+
+void comm_lat_tcp_first_byte(struct sock *sk)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct skb_mstamp now;
+
+	skb_mstamp_get(&now);
+	comm_lat_record(sk, COMM_LAT_TCP_FIRST_BYTE,
+			skb_mstamp_us_delta(&now, &tp->comm_lat_stamp));
+	tp->comm_lat_stamp.v64 = 0;
+}
+
+void comm_lat_dns_done(struct sock *sk)
+{
+	struct udp_sock *up = udp_sk(sk);
+	struct skb_mstamp now;
+
+	skb_mstamp_get(&now);
+	comm_lat_record(sk, COMM_LAT_DNS,
+			skb_mstamp_us_delta(&now, &up->comm_lat_stamp));
+	up->comm_lat_stamp.v64 = 0;
+}
+
+static int comm_lat_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+	vma->vm_flags &= ~VM_MAYWRITE;
+
+	return remap_vmalloc_range(vma, comm_lat_buf, vma->vm_pgoff);
+}
+
+static const struct file_operations comm_lat_fops = {
+	.mmap		= comm_lat_mmap,
+	.llseek		= noop_llseek,
+};
+
+int __init comm_lat_init(struct proc_dir_entry *dir)
+{
+	unsigned int i;
+
+	comm_lat_buf_size = PAGE_ALIGN(sizeof(struct comm_lat_hdr) +
+			COMM_LAT_NR_RINGS * sizeof(struct comm_lat_ring));
+	comm_lat_buf = vmalloc_user(comm_lat_buf_size);
+	if (!comm_lat_buf) {
+		pr_err("comm_stat: failed to allocate latency rings\n");
+		return -ENOMEM;
+	}
+
+	comm_lat_buf->version = COMM_LAT_VERSION;
+	comm_lat_buf->nr_rings = COMM_LAT_NR_RINGS;
+	comm_lat_buf->ring_size = COMM_LAT_RING_SIZE;
+	for (i = 0; i < COMM_LAT_NR_RINGS; i++)
+		comm_lat_ring(i)->uid = COMM_LAT_UID_FREE;
+
+	if (!proc_create("latency", S_IRUGO, dir, &comm_lat_fops)) {
+		pr_err("comm_stat: failed to create /proc/net/comm/latency\n");
+		vfree(comm_lat_buf);
+		comm_lat_buf = NULL;
+		return -ENOMEM;
+	}
+
+	return 0;
+}
@@ -10,6 +10,7 @@
 #include <net/sock.h>
 #include <net/netlink.h>
 #include <net/tcp.h>
+#include <linux/in6.h>
 
 #ifdef CONFIG_HW_CROSSLAYER_OPT
 
@@ -120,18 +121,49 @@ struct aspen_cdn_info {
 	unsigned short		type;
 };
 
+/* Connection identity, addresses and ports in network byte order */
+struct aspen_cdn_flow {
+	unsigned short		family;		/* AF_INET or AF_INET6 */
+	__be16			sport;
+	__be16			dport;
+	union {
+		__be32		v4;
+		struct in6_addr	v6;
+	} saddr, daddr;
+};
+
+/* Dropped notification carrying the full 4-tuple, works for IPv6 too */
+struct aspen_cdn_flow_info {
+	struct aspen_cdn_flow	flow;
+	unsigned int		seq;
+	unsigned short		type;
+};
+
 struct aspen_cdn_hashtable {
 	struct hlist_head	head;
-	spinlock_t		lock;
 };
 
+/* One per connected socket, looked up under RCU */
 struct aspen_cdn_hashbucket {
-	struct hlist_node	node;
+	struct hlist_node	node;		/* in the 4-tuple table */
+	struct hlist_node	port_node;	/* in the local port table */
+	struct rcu_head		rcu;
 	struct sock		*sk;
-	int			refs;
+	struct aspen_cdn_flow	flow;
 	unsigned short		port;
 };
 
+/* Outcome of dropped notifications, see aspen_recovery_stats sysctl */
+struct aspen_recovery_stats {
+	atomic_t		notified;	/* seqs reported by the modem */
+	atomic_t		unmatched;	/* no socket for the seq */
+	atomic_t		rexmit_saved;	/* resent ahead of TCP loss detection */
+	atomic_t		rexmit_spurious; /* already acked, sacked or queued */
+	atomic_t		undo;		/* cwnd reductions undone */
+};
+
+#define ASPEN_RECOVERY_STATS_BUF_MAX 128
+
 #ifdef CONFIG_HW_CROSSLAYER_OPT_DBG_MODULE
 struct tcp_sender_monitor {
 	u32			version;
@@ -189,6 +221,11 @@ extern int aspen_init_hashtable(void);
 extern void aspen_mark_hashtable(struct sock *sk, unsigned short int port);
 extern void aspen_unmark_hashtable(struct sock *sk);
 extern void aspen_crosslayer_recovery(void *ptr, int length);
+extern void aspen_crosslayer_recovery_flow(struct aspen_cdn_flow_info *info,
+					   int length);
+extern int proc_aspen_recovery_stats(struct ctl_table *ctl, int write,
+				     void __user *buffer, size_t *lenp,
+				     loff_t *ppos);
 extern void aspen_tcp_crosslayer_retransmit(struct sock *sk);
 extern bool aspen_tcp_try_undo_modem_drop(struct sock *sk,
 					  enum tcp_undo_from_state state);
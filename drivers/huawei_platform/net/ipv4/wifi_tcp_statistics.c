@@ -12,6 +12,10 @@
 #include <uapi/linux/netlink.h>
 #include <linux/kthread.h>
 #include <linux/string.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
 #include <net/tcp.h>
 
 #include "wifi_tcp_statistics.h"
@@ -89,16 +93,52 @@ static char *s_arrTitle[MAX_ARR_TITLE_COUNT] = {
 
 #define WIFI_INVALID_VALUE 0xFFFFFFFF
 
+/*
+ * A socket caches its UID slot in sk->wifi_stat_cookie as
+ * (generation << WIFI_STAT_SLOT_BITS) | slot. Each reset of the UID
+ * table bumps the generation, so stale cookies are simply re-resolved.
+ * Cookie 0 means "not resolved yet".
+ */
+#define WIFI_STAT_SLOT_BITS	4
+#define WIFI_STAT_SLOT_MASK	((1U << WIFI_STAT_SLOT_BITS) - 1)
+#define WIFI_STAT_SLOT_NONE	WIFI_STAT_SLOT_MASK
+#define WIFI_STAT_GEN_MASK	(WIFI_INVALID_VALUE >> WIFI_STAT_SLOT_BITS)
+
+/* RTT histogram upper bounds in ms, the last bucket is open ended */
+#define WIFI_RTT_HIST_CNT  8
+static const unsigned int s_rttHistBound[WIFI_RTT_HIST_CNT - 1] = {
+	10, 20, 50, 100, 200, 500, 1000
+};
+
+enum {
+	WIFI_CLASS_LAN = 0,
+	WIFI_CLASS_WEB,
+	WIFI_CLASS_CNT
+};
+
+/*
+ * Counters are per-cpu so the TCP fast path is a single local add.
+ * They only ever grow; the proc reader reports the delta against the
+ * snapshot it took last time.
+ */
 typedef struct {
-	kuid_t uid;
 	unsigned int counter[MAX_ARR_TITLE_COUNT];
-} UIDTCPStat;
+	unsigned int uidCounter[WIFI_MAX_UID_CNT][MAX_ARR_TITLE_COUNT];
+	unsigned int rttHist[WIFI_CLASS_CNT][WIFI_RTT_HIST_CNT];
+} WifiTcpStat;
+
+static DEFINE_PER_CPU(WifiTcpStat, s_pcpuTcpStat);
+static WifiTcpStat s_baseTcpStat;
+/* Serializes readers/resets of s_baseTcpStat */
+static DEFINE_MUTEX(s_statMutex);
 
-static unsigned int s_WifiStatics[MAX_ARR_TITLE_COUNT] = {0};
 static unsigned int s_ON = WIFI_STAT_OFF;
 static struct sock *g_wifi_tcp_nlfd;
-static UIDTCPStat s_uidTcpStat[WIFI_MAX_UID_CNT] = { {0} };
+static kuid_t s_uidTcpStat[WIFI_MAX_UID_CNT];
 static int s_tcpstat_index;
+static unsigned int s_statGen = 1;
+/* Protects s_uidTcpStat, s_tcpstat_index and s_statGen updates */
+static DEFINE_SPINLOCK(s_uidLock);
 static unsigned char s_cVALIDATESTATE[] = { TCP_ESTABLISHED,  TCP_SYN_SENT, TCP_SYN_RECV, TCP_LISTEN};
 
 
@@ -149,6 +189,7 @@ static  kuid_t get_socket_uid(struct sock *sk)
 	return   uid ;
 }
 
+/* Caller must hold s_uidLock */
 static int wifi_getTcpStatIndex(kuid_t uid)
 {
 	int index =  WIFI_INVALID_VALUE;
@@ -160,7 +201,7 @@ static int wifi_getTcpStatIndex(kuid_t uid)
 		return WIFI_INVALID_VALUE;
 
 	for (i = 0; i < s_tcpstat_index && i < WIFI_MAX_UID_CNT ; i++) {
-		if (__kuid_val(s_uidTcpStat[i].uid) == __kuid_val(uid)) {
+		if (__kuid_val(s_uidTcpStat[i]) == __kuid_val(uid)) {
 			index = i;
 			goto out;
 		}
@@ -169,80 +210,181 @@ static int wifi_getTcpStatIndex(kuid_t uid)
 	if (s_tcpstat_index  < WIFI_MAX_UID_CNT) {
 		index = s_tcpstat_index;
 		s_tcpstat_index++;
-		s_uidTcpStat[index].uid = uid;
+		s_uidTcpStat[index] = uid;
 	}
 
 out:
 	return index;
 }
 
-static void updateTcpStatByUID (kuid_t uid, int index, int count)
+/*
+ * Resolve the UID slot of a socket and cache it in the socket.
+ * Called at connect time and, for sockets that were not bound then
+ * (accepted or created while statistics were off), on their first
+ * counted segment. Accepted sockets start with the listener's cookie.
+ * Sockets without a struct socket yet report uid 0 and are not cached,
+ * so they get another chance once they are accepted.
+ */
+static unsigned int wifi_resolve_slot(struct sock *sk)
 {
-	int result = 0;
-
-	if (s_ON == WIFI_STAT_OFF) {
-		return;
-	}
+	kuid_t uid = get_socket_uid(sk);
+	unsigned int slot = WIFI_STAT_SLOT_NONE;
+	unsigned int gen;
+	int index;
+
+	spin_lock_bh(&s_uidLock);
+	index = wifi_getTcpStatIndex(uid);
+	if (WIFI_INVALID_VALUE != index)
+		slot = index;
+	gen = s_statGen;
+	spin_unlock_bh(&s_uidLock);
+
+	if (sk->sk_socket)
+		WRITE_ONCE(sk->wifi_stat_cookie,
+			   (gen << WIFI_STAT_SLOT_BITS) | slot);
+	return slot;
+}
 
-	result = wifi_getTcpStatIndex(uid);
+static inline unsigned int wifi_sock_slot(struct sock *sk)
+{
+	u32 cookie = READ_ONCE(sk->wifi_stat_cookie);
 
-	if (WIFI_INVALID_VALUE == result)
-		return ;
+	if (likely(cookie &&
+		   (cookie >> WIFI_STAT_SLOT_BITS) == READ_ONCE(s_statGen)))
+		return cookie & WIFI_STAT_SLOT_MASK;
+	return wifi_resolve_slot(sk);
+}
 
-	if (__kuid_val(uid) != __kuid_val(s_uidTcpStat[result].uid))
+void wifi_tcp_stat_bind(struct sock *sk)
+{
+	if (s_ON == WIFI_STAT_OFF || NULL == sk)
 		return;
 
-	s_uidTcpStat[result].counter[index] += count;
+	wifi_resolve_slot(sk);
 }
 
-static void wifi_updateCounter(struct sock *sk, int count, int lan, int web)
+/* Returns WIFI_CLASS_LAN/WEB, or -1 if the socket is not counted */
+static int wifi_sock_class(struct sock *sk)
 {
 	struct inet_sock *inet = NULL;
 	unsigned int dest_addr = 0;
-	int index = 0;
 
 	if (s_ON == WIFI_STAT_OFF)
-		return ;
+		return -1;
 
 	if (NULL == sk)
-		return ;
+		return -1;
 
 	inet = inet_sk(sk);
 	if (NULL == inet)
-		return;
+		return -1;
 
 	dest_addr = htonl(inet->inet_daddr);
 
 	if (wifi_is_local_sock(dest_addr) == true)
-		return;
+		return -1;
 
-	if (wifi_is_lan_sock(dest_addr) == true) {
-		index = lan;
-	} else {
-		index = web;
-	}
+	if (wifi_is_lan_sock(dest_addr) == true)
+		return WIFI_CLASS_LAN;
+
+	return WIFI_CLASS_WEB;
+}
 
-	s_WifiStatics[index] += count;
+static void wifi_addCounter(struct sock *sk, int index, int count)
+{
+	unsigned int slot;
+
+	this_cpu_add(s_pcpuTcpStat.counter[index], count);
 
 	if (wifi_is_validate_state(sk)) {
-		updateTcpStatByUID(get_socket_uid(sk), index, count);
+		slot = wifi_sock_slot(sk);
+		if (slot != WIFI_STAT_SLOT_NONE)
+			this_cpu_add(s_pcpuTcpStat.uidCounter[slot][index],
+				     count);
+	}
+}
+
+static void wifi_updateCounter(struct sock *sk, int count, int lan, int web)
+{
+	int cls = wifi_sock_class(sk);
+
+	if (cls < 0)
+		return;
+
+	wifi_addCounter(sk, cls == WIFI_CLASS_LAN ? lan : web, count);
+}
+
+static void wifi_stat_sum(WifiTcpStat *sum)
+{
+	unsigned int *dst = (unsigned int *)sum;
+	int cpu, i;
+
+	memset(sum, 0, sizeof(*sum));
+	for_each_possible_cpu(cpu) {
+		unsigned int *src = (unsigned int *)per_cpu_ptr(&s_pcpuTcpStat,
+							       cpu);
+
+		for (i = 0; i < sizeof(*sum) / sizeof(unsigned int); i++)
+			dst[i] += src[i];
 	}
 }
 
+/*
+ * Start a new accounting period: forget the UID slots (sockets re-resolve
+ * on their next segment) and rebase the counters on @now.
+ * Caller must hold s_statMutex.
+ */
+static void wifi_stat_reset(const WifiTcpStat *now)
+{
+	unsigned int gen;
+
+	spin_lock_bh(&s_uidLock);
+	memset(s_uidTcpStat, 0, sizeof(s_uidTcpStat));
+	s_tcpstat_index = 0;
+	gen = (s_statGen + 1) & WIFI_STAT_GEN_MASK;
+	WRITE_ONCE(s_statGen, gen ? gen : 1);
+	spin_unlock_bh(&s_uidLock);
+
+	memcpy(&s_baseTcpStat, now, sizeof(s_baseTcpStat));
+}
+
 static int wifi_network_stat_show(struct seq_file *seq, void *v)
 {
-	int i = 0, j = 0;
+	int i = 0, j = 0, k = 0;
 	int bIndex = INDEX_SENDSEGS, eIndex = INDEX_WEBSNDDUPACKS;
-	int index = s_tcpstat_index;
+	int index;
+	WifiTcpStat *now;
+	unsigned int value;
+
 	if (s_ON == WIFI_STAT_OFF)
 		return 0;
 
+	now = kmalloc(sizeof(*now), GFP_KERNEL);
+	if (!now)
+		return -ENOMEM;
+
+	mutex_lock(&s_statMutex);
+	wifi_stat_sum(now);
+	spin_lock_bh(&s_uidLock);
+	index = s_tcpstat_index;
+	spin_unlock_bh(&s_uidLock);
+
+	for (i = 0; i < MAX_ARR_TITLE_COUNT; i++) {
+		value = now->counter[i] - s_baseTcpStat.counter[i];
 #ifdef CONFIG_HW_WIFIPRO
-	s_WifiStatics[INDEX_WEB_SRTT] = wifipro_get_srtt();
+		if (i == INDEX_WEB_SRTT)
+			value = wifipro_get_srtt();
 #endif
+		seq_printf(seq, "%s=%u\n",   s_arrTitle[i],  value);
+	}
 
-	for (i = 0; i < MAX_ARR_TITLE_COUNT; i++) {
-		seq_printf(seq, "%s=%u\n",   s_arrTitle[i],  s_WifiStatics[i]);
+	for (k = 0; k < WIFI_CLASS_CNT; k++) {
+		seq_puts(seq, k == WIFI_CLASS_LAN ? "RTTHIST=" : "WEBRTTHIST=");
+		for (i = 0; i < WIFI_RTT_HIST_CNT; i++)
+			seq_printf(seq, "%u%c",
+				   now->rttHist[k][i] -
+				   s_baseTcpStat.rttHist[k][i],
+				   i == WIFI_RTT_HIST_CNT - 1 ? '\n' : ',');
 	}
 
 	seq_puts(seq, "\nUID\t");
@@ -252,20 +394,35 @@ static int wifi_network_stat_show(struct seq_file *seq, void *v)
 	seq_puts(seq, "\n");
 
 	for (i = 0; i <  index && i < WIFI_MAX_UID_CNT ; i++) {
-		seq_printf(seq, "%u\t", __kuid_val(s_uidTcpStat[i].uid));
+		seq_printf(seq, "%u\t", __kuid_val(s_uidTcpStat[i]));
 		for (j = bIndex; j <= eIndex; j++) {
-			seq_printf(seq, "%u\t", s_uidTcpStat[i].counter[j]);
+			seq_printf(seq, "%u\t", now->uidCounter[i][j] -
+				   s_baseTcpStat.uidCounter[i][j]);
 		}
 
 		seq_puts(seq, "\n");
 	}
 
-	memset(s_uidTcpStat, 0, sizeof(s_uidTcpStat));
-	s_tcpstat_index = 0;
-	memset(s_WifiStatics, 0, sizeof(s_WifiStatics));
+	wifi_stat_reset(now);
+	mutex_unlock(&s_statMutex);
+	kfree(now);
 	return 0;
 }
 
+static void wifi_tcp_stat_clear(void)
+{
+	WifiTcpStat *now = kmalloc(sizeof(*now), GFP_KERNEL);
+
+	if (!now)
+		return;
+
+	mutex_lock(&s_statMutex);
+	wifi_stat_sum(now);
+	wifi_stat_reset(now);
+	mutex_unlock(&s_statMutex);
+	kfree(now);
+}
+
 static void wifi_tcp_nl_receive(struct sk_buff *__skb)
 {
 	struct nlmsghdr *nlh;
@@ -282,9 +439,7 @@ static void wifi_tcp_nl_receive(struct sk_buff *__skb)
 				s_ON = WIFI_STAT_ON;
 			} else if (NETLINK_MSG_WIFI_TCP_STOP == nlh->nlmsg_type) {
 				s_ON = WIFI_STAT_OFF;
-				memset(s_WifiStatics, 0, sizeof(s_WifiStatics));
-				memset(s_uidTcpStat, 0, sizeof(s_uidTcpStat));
-				s_tcpstat_index = 0;
+				wifi_tcp_stat_clear();
 			} else {
 				printk(KERN_ERR "#### %s:  wrong msg_type(%d)####\n",  __func__, nlh->nlmsg_type);
 			}
@@ -336,9 +491,27 @@ static const struct file_operations wifi_networktest = {
 
 void wifi_update_rtt(unsigned int rtt, struct sock *sk)
 {
+	int cls;
+	int i;
+
 	rtt = rtt/1000;   //us to ms
-	wifi_updateCounter(sk, rtt, INDEX_RTTDURATION, INDEX_WEBRTTDURATION);
-	wifi_updateCounter(sk, 1,   INDEX_RTTSEGS,   INDEX_WEBRTTSEGS);
+	cls = wifi_sock_class(sk);
+	if (cls < 0)
+		return;
+
+	if (cls == WIFI_CLASS_LAN) {
+		wifi_addCounter(sk, INDEX_RTTDURATION, rtt);
+		wifi_addCounter(sk, INDEX_RTTSEGS, 1);
+	} else {
+		wifi_addCounter(sk, INDEX_WEBRTTDURATION, rtt);
+		wifi_addCounter(sk, INDEX_WEBRTTSEGS, 1);
+	}
+
+	for (i = 0; i < WIFI_RTT_HIST_CNT - 1; i++) {
+		if (rtt < s_rttHistBound[i])
+			break;
+	}
+	this_cpu_inc(s_pcpuTcpStat.rttHist[cls][i]);
 	/*print_socket_info(sk);*/
 }
 
@@ -11,5 +11,6 @@ void wifi_IncrRstSegs(struct sock *sk, int count);
 void wifi_IncrEstabliseRstSegs(struct sock *sk, int count) ;
 void wifi_IncrRcvDupAcksSegs(struct sock *sk, int count);
 int wifi_is_on(void);
+void wifi_tcp_stat_bind(struct sock *sk);
 #endif
 
@@ -25,6 +25,9 @@
 #include <linux/string.h>
 #include <net/tcp.h>
 #include "wifipro_tcp_monitor.h"
+#ifdef CONFIG_HW_WIFI
+#include "wifi_tcp_statistics.h"
+#endif
 
 #ifndef CONFIG_HW_WIFIPRO
 #undef CONFIG_HW_WIFIPRO_PROC
@@ -45,6 +48,7 @@ DEFINE_MUTEX(wifipro_google_sock_sem);
 DEFINE_MUTEX(wifipro_congestion_sem);
 DEFINE_MUTEX(wifipro_trigger_sock_sem);
 DEFINE_MUTEX(wifipro_tcp_trigger_inf_sem);
+DEFINE_MUTEX(wifipro_sample_sem);
 
 #define LINK_UNKNOWN                0
 #define LINK_POOR                   1
@@ -104,6 +108,7 @@ static const struct snmp_mib wifipro_snmp_tcp_list[] = {
 
 static void wifipro_rtt_monitor_deinit(void);
 static void wifipro_cancel_task(void);
+static void wifipro_tcp_sample(void);
 
 bool is_wifipro_on = false;
 bool is_mcc_china = true;
@@ -121,11 +126,13 @@ static unsigned int mobile_rtt_average;
 static unsigned int mobile_rtt_calc_pkg;
 static unsigned long mobile_when_recorded_rtt;
 static int unknown_dev_count;
-static int unknown_segs_count;
+static unsigned long wifipro_sample_last;
+static unsigned long wifipro_sample_interval = WIFIPRO_SAMPLE_IDLE_INTERVAL;
 static struct sock *g_wifipro_nlfd;
 static struct wifipro_tcp_monitor_inf *wifipro_tcp_trigger_inf;
 static struct delayed_work wifipro_tcp_monitor_work;
 static struct work_struct wifipro_tcp_retrans_work;
+static struct delayed_work wifipro_tcp_sample_work;
 wifipro_rtt_stat_t wlan_bqe_rtt_stat;
 wifipro_rtt_stat_t mobile_bqe_rtt_stat;
 wifipro_rtt_stat_t wlan_sample_rtt_stat;
@@ -149,131 +156,46 @@ char *wifipro_ntoa(int addr)
 	return buf;
 }
 
-void wifipro_update_tcp_statistics(int mib_type, const struct sk_buff *skb, struct sock *from_sk)
+static unsigned char wifipro_dev_name_type(const char *name)
 {
-	struct inet_sock *inet = NULL;
-	unsigned int dest_addr = 0;
-	unsigned int dest_port = 0;
-	unsigned int src_addr = 0;
-	unsigned int wifipro_dev_max_len = 0;
-	struct sock *sk = NULL;
-	if (from_sk != NULL) {
-		sk = from_sk;
-	} else {
-		sk = skb->sk;
-	}
-
-	if (!is_wifipro_on || sk == NULL) {
-		return;
-	}
+	if (!name[0])
+		return WIFIPRO_DEV_UNKNOWN;
+	if (!strncmp(name, "wlan", 4))
+		return WIFIPRO_DEV_WLAN;
+	if (!strncmp(name, "rmnet", 5))
+		return WIFIPRO_DEV_MOBILE;
+	return WIFIPRO_DEV_OTHER;
+}
 
-	inet = inet_sk(sk);
-	if (NULL == inet) {
-		return;
-	}
-	dest_addr = htonl(inet->inet_daddr);
-	dest_port = htons(inet->inet_dport);
-	src_addr = htonl(inet->inet_saddr);
+/*
+ * Classify the socket by its egress device once and cache the result,
+ * so neither the sampler nor the retransmit hook compares names again.
+ */
+static unsigned char wifipro_sock_dev_type(struct sock *sk)
+{
+	struct dst_entry *dst = NULL;
+	unsigned char type = sk->wifipro_dev_type;
 
-	if (!wifipro_is_not_local_or_lan_sock(dest_addr)) {
-		return;
-	}
+	if (type != WIFIPRO_DEV_UNKNOWN)
+		return type;
 
-	if ((1 << sk->sk_state) & TCPF_SYN_SENT) {
-		if (skb->dev) {
-			wifipro_dev_max_len =
-			    strnlen(skb->dev->name, IFNAMSIZ - 1);
-			strncpy(sk->wifipro_dev_name, skb->dev->name,
-				wifipro_dev_max_len);
-			sk->wifipro_dev_name[wifipro_dev_max_len] = '\0';
-			WIFIPRO_DEBUG("wifipro_dev_name is %s", skb->dev->name);
-		}
-	}
+	type = wifipro_dev_name_type(sk->wifipro_dev_name);
+	if (type == WIFIPRO_DEV_UNKNOWN) {
+		rcu_read_lock();
+		dst = rcu_dereference(sk->sk_dst_cache);
+		if (dst && dst->dev)
+			type = wifipro_dev_name_type(dst->dev->name);
+		rcu_read_unlock();
 
-	if (WIFIPRO_TCP_MIB_OUTSEGS == mib_type) {
-		if (!strncmp(sk->wifipro_dev_name, "wlan", 4)) {
-			WIFIPRO_TCP_INC_STATS_BH(&init_net,
-						 WIFIPRO_TCP_MIB_WLAN_OUTSEGS);
-		} else if (!strncmp(sk->wifipro_dev_name, "rmnet", 5)) {
-			WIFIPRO_TCP_INC_STATS_BH(&init_net,
-						 WIFIPRO_TCP_MIB_MOBILE_OUTSEGS);
-		} else {
-			/*for some reason, some socket state, ex TIME_WAIT, we can't get sk->wifipro_dev_name */
-			if (skb->dev) {
-				if (!strncmp(skb->dev->name, "wlan", 4)) {
-					WIFIPRO_TCP_INC_STATS_BH(&init_net,
-								 WIFIPRO_TCP_MIB_WLAN_OUTSEGS);
-				} else if (!strncmp(skb->dev->name, "rmnet", 5)) {
-					WIFIPRO_TCP_INC_STATS_BH(&init_net,
-								 WIFIPRO_TCP_MIB_MOBILE_OUTSEGS);
-				} else {
-					unknown_dev_count++;
-					WIFIPRO_DEBUG
-					    ("unknown out device, %s -> %s state is %d",
-					     wifipro_ntoa(src_addr),
-					     wifipro_ntoa(dest_addr),
-					     sk->sk_state);
-					return;
-				}
-			} else {
-				unknown_dev_count++;
-				WIFIPRO_DEBUG
-				    ("unknown out device, %s -> %s state is %d",
-				     wifipro_ntoa(src_addr),
-				     wifipro_ntoa(dest_addr), sk->sk_state);
-				return;
-			}
-		}
-		WIFIPRO_VERBOSE("Outsegs to %s increase",
-				wifipro_ntoa(dest_addr));
-		if (wifipro_is_trigger_sock(dest_addr, dest_port)) {
-			wifipro_trigger_sock->OutSegs++;
-			WIFIPRO_VERBOSE("%s:%d  trigger socket OutSegs = %lu",
-					wifipro_ntoa(dest_addr), dest_port,
-					wifipro_trigger_sock->OutSegs);
-		}
-	} else if (WIFIPRO_TCP_MIB_INSEGS == mib_type) {
-		if (!strncmp(sk->wifipro_dev_name, "wlan", 4)) {
-			WIFIPRO_TCP_INC_STATS_BH(&init_net,
-						 WIFIPRO_TCP_MIB_WLAN_INSEGS);
-		} else if (!strncmp(sk->wifipro_dev_name, "rmnet", 5)) {
-			WIFIPRO_TCP_INC_STATS_BH(&init_net,
-						 WIFIPRO_TCP_MIB_MOBILE_INSEGS);
-		} else {
-			/*for some reason, some socket state, ex TIME_WAIT, we can't get sk->wifipro_dev_name */
-			if (skb->dev) {
-				if (!strncmp(skb->dev->name, "wlan", 4)) {
-					WIFIPRO_TCP_INC_STATS_BH(&init_net,
-								 WIFIPRO_TCP_MIB_WLAN_INSEGS);
-				} else if (!strncmp(skb->dev->name, "rmnet", 5)) {
-					WIFIPRO_TCP_INC_STATS_BH(&init_net,
-								 WIFIPRO_TCP_MIB_MOBILE_INSEGS);
-				} else {
-					unknown_dev_count++;
-					WIFIPRO_DEBUG
-					    ("unknown in device, %s -> %s state is %d",
-					     wifipro_ntoa(src_addr),
-					     wifipro_ntoa(dest_addr),
-					     sk->sk_state);
-					return;
-				}
-			} else {
-				unknown_dev_count++;
-				WIFIPRO_DEBUG
-				    ("unknown in device, %s -> %s state is %d",
-				     wifipro_ntoa(src_addr),
-				     wifipro_ntoa(dest_addr), sk->sk_state);
-				return;
-			}
-		}
-		WIFIPRO_VERBOSE("Insegs from %s increase",
-				wifipro_ntoa(dest_addr));
-	} else {
-		unknown_segs_count++;
-		WIFIPRO_DEBUG("mib_type is %d", mib_type);
+		/*not routed yet, try again on the next sample */
+		if (type == WIFIPRO_DEV_UNKNOWN)
+			return type;
 	}
 
-	return;
+	if (type == WIFIPRO_DEV_OTHER)
+		unknown_dev_count++;
+	sk->wifipro_dev_type = type;
+	return type;
 }
 
 static int wifipro_get_proc_name(struct task_struct *task, char *buffer)
@@ -446,6 +368,8 @@ static void wifipro_tcp_retrans_work_handler(struct work_struct *work)
 	/*int ret = 0; */
 	if (is_wifipro_running && !is_delayed_work_handling
 	    && wifipro_retrans_sock->icsk_rto >= WIFIPRO_RTO_THRESHOLD) {
+		/*flush pending socket deltas so they land before the trigger */
+		wifipro_tcp_sample();
 		is_delayed_work_handling = true;
 		mutex_lock(&wifipro_tcp_trigger_inf_sem);
 		if (wifipro_tcp_trigger_inf) {
@@ -573,6 +497,7 @@ int wifipro_handle_retrans(struct sock *sk, struct inet_connection_sock *icsk)
 	unsigned int dest_port = 0;
 	unsigned int src_addr = 0;
 	unsigned int src_port = 0;
+	unsigned char dev_type;
 
 	inet = inet_sk(sk);
 	if (NULL == inet) {
@@ -590,12 +515,13 @@ int wifipro_handle_retrans(struct sock *sk, struct inet_connection_sock *icsk)
 	}
 
 	/*if it's not local, LAN or google socket, record it. */
-	if (!strncmp(sk->wifipro_dev_name, "wlan", 4)) {
+	dev_type = wifipro_sock_dev_type(sk);
+	if (WIFIPRO_DEV_WLAN == dev_type) {
 		if ((1 << sk->sk_state) & (TCPF_SYN_SENT | TCPF_ESTABLISHED)) {
 			WIFIPRO_TCP_INC_STATS_BH(sock_net(sk),
 						 WIFIPRO_TCP_MIB_WLAN_RETRANSSEGS);
 		}
-	} else if (!strncmp(sk->wifipro_dev_name, "rmnet", 5)) {
+	} else if (WIFIPRO_DEV_MOBILE == dev_type) {
 		WIFIPRO_TCP_INC_STATS_BH(sock_net(sk),
 					 WIFIPRO_TCP_MIB_MOBILE_RETRANSSEGS);
 		return 0;
@@ -853,6 +779,8 @@ static void wifipro_tcp_monitor_nl_receive(struct sk_buff *__skb)
 				if (BETA_USER == nlh->nlmsg_flags) {
 					wifipro_log_level = WIFIPRO_DEBUG;
 				}
+				mod_delayed_work(system_power_efficient_wq,
+						 &wifipro_tcp_sample_work, 0);
 				break;
 
 			case NETLINK_WIFIPRO_STOP_MONITOR:
@@ -862,6 +790,7 @@ static void wifipro_tcp_monitor_nl_receive(struct sk_buff *__skb)
 				break;
 
 			case NETLINK_WIFIPRO_GET_MSG:
+				wifipro_tcp_sample();
 				wifipro_tcp_monitor_send_msg(nlh->nlmsg_pid,
 							     WIFIPRO_APP_QUERY,
 							     LINK_UNKNOWN);
@@ -940,6 +869,8 @@ static void wifipro_tcp_monitor_work_handler(struct work_struct *work)
 	unsigned int Interval_InSegs = 0;
 	unsigned int tcp_quality = LINK_UNKNOWN;
 
+	wifipro_tcp_sample();
+
 	/*current tcp mib information */
 	wifipro_tcp_curr_inf.InSegs =
 	    snmp_fold_field((void __percpu **)init_net.mib.
@@ -1388,7 +1319,7 @@ static void wifipro_update_mobile_rtt(unsigned int rtt, struct sock *sk,
 		      mobile_rtt_calc_pkg, mobile_rtt_average);
 }
 
-void wifipro_update_rtt(unsigned int rtt, struct sock *sk)
+static void wifipro_update_rtt(unsigned int rtt, struct sock *sk)
 {
 	unsigned int dest_addr = 0;
 	struct inet_sock *inet = NULL;
@@ -1403,16 +1334,155 @@ void wifipro_update_rtt(unsigned int rtt, struct sock *sk)
 		return;
 	}
 
-	if (!strncmp(sk->wifipro_dev_name, "wlan", 4)) {
+	switch (sk->wifipro_dev_type) {
+	case WIFIPRO_DEV_WLAN:
 		wifipro_update_wlan_rtt(rtt, sk, dest_addr);
-	} else if (!strncmp(sk->wifipro_dev_name, "rmnet", 5)) {
+		break;
+
+	case WIFIPRO_DEV_MOBILE:
 		wifipro_update_mobile_rtt(rtt, sk, dest_addr);
-	} else {
+		break;
+
+	default:
 		WIFIPRO_DEBUG("unknown device, ignore");
-		unknown_dev_count++;
+		break;
 	}
 }
 
+/*
+ * Fold the segment and RTT state one socket gathered since the last
+ * pass into the wifipro counters. Called with the ehash bucket locked,
+ * so only plain reads of tcp_sock are done here.
+ */
+static unsigned int wifipro_sample_sock(struct sock *sk, bool count_segs,
+					bool count_rtt)
+{
+	struct inet_sock *inet = inet_sk(sk);
+	struct tcp_sock *tp = tcp_sk(sk);
+	unsigned int dest_addr = htonl(inet->inet_daddr);
+	unsigned int dest_port = htons(inet->inet_dport);
+	unsigned char dev_type;
+	u32 segs_in, segs_out;
+	u32 in, out;
+
+	if (!wifipro_is_not_local_or_lan_sock(dest_addr))
+		return 0;
+
+	dev_type = wifipro_sock_dev_type(sk);
+	if (WIFIPRO_DEV_WLAN != dev_type && WIFIPRO_DEV_MOBILE != dev_type)
+		return 0;
+
+	segs_in = ACCESS_ONCE(tp->segs_in);
+	segs_out = ACCESS_ONCE(tp->segs_out);
+	in = segs_in - sk->wifipro_seen_segs_in;
+	out = segs_out - sk->wifipro_seen_segs_out;
+	sk->wifipro_seen_segs_in = segs_in;
+	sk->wifipro_seen_segs_out = segs_out;
+
+	if (count_segs && (in || out)) {
+		if (WIFIPRO_DEV_WLAN == dev_type) {
+			WIFIPRO_TCP_ADD_STATS(&init_net,
+					      WIFIPRO_TCP_MIB_WLAN_INSEGS, in);
+			WIFIPRO_TCP_ADD_STATS(&init_net,
+					      WIFIPRO_TCP_MIB_WLAN_OUTSEGS,
+					      out);
+		} else {
+			WIFIPRO_TCP_ADD_STATS(&init_net,
+					      WIFIPRO_TCP_MIB_MOBILE_INSEGS, in);
+			WIFIPRO_TCP_ADD_STATS(&init_net,
+					      WIFIPRO_TCP_MIB_MOBILE_OUTSEGS,
+					      out);
+		}
+
+		if (out && wifipro_is_trigger_sock(dest_addr, dest_port)) {
+			wifipro_trigger_sock->OutSegs += out;
+			WIFIPRO_VERBOSE("%s:%d  trigger socket OutSegs = %lu",
+					wifipro_ntoa(dest_addr), dest_port,
+					wifipro_trigger_sock->OutSegs);
+		}
+	}
+
+	/*srtt only moves when acks come in, so skip idle sockets */
+	if (count_rtt && in && tp->srtt_us)
+		wifipro_update_rtt(usecs_to_jiffies(tp->srtt_us >> 3) << 3, sk);
+
+	return in + out;
+}
+
+/*
+ * Walk the established table and sample every full IPv4 socket. Empty
+ * buckets are skipped without taking their lock, as inet_diag does.
+ */
+static void wifipro_tcp_sample(void)
+{
+	struct inet_hashinfo *hashinfo = &tcp_hashinfo;
+	bool count_segs = is_wifipro_on;
+	bool count_rtt = is_wifipro_on;
+	unsigned long now = jiffies;
+	unsigned long elapsed;
+	unsigned int segs = 0;
+	unsigned int i;
+
+#ifdef CONFIG_HW_WIFI
+	count_rtt = count_rtt || wifi_is_on();
+#endif
+
+	mutex_lock(&wifipro_sample_sem);
+	elapsed = max_t(unsigned long, now - wifipro_sample_last, 1);
+	wifipro_sample_last = now;
+
+	if (!count_segs && !count_rtt) {
+		wifipro_sample_interval = WIFIPRO_SAMPLE_IDLE_INTERVAL;
+		goto out;
+	}
+
+	for (i = 0; i <= hashinfo->ehash_mask; i++) {
+		struct inet_ehash_bucket *head = &hashinfo->ehash[i];
+		spinlock_t *lock = inet_ehash_lockp(hashinfo, i);
+		struct hlist_nulls_node *node;
+		struct sock *sk;
+
+		if (hlist_nulls_empty(&head->chain))
+			continue;
+
+		spin_lock_bh(lock);
+		sk_nulls_for_each(sk, node, &head->chain) {
+			if (sk->sk_family != AF_INET || !sk_fullsock(sk))
+				continue;
+			segs += wifipro_sample_sock(sk, count_segs, count_rtt);
+		}
+		spin_unlock_bh(lock);
+	}
+
+	/*
+	 * Sample in proportion to throughput: busy links are looked at
+	 * about every WIFIPRO_SAMPLE_SEGS segments, idle ones rarely. While
+	 * a retransmit trigger is being evaluated, sample at the fastest
+	 * rate so the RTT window has as many points as the per-ack hook
+	 * used to provide.
+	 */
+	if (is_delayed_work_handling)
+		wifipro_sample_interval = WIFIPRO_SAMPLE_MIN_INTERVAL;
+	else if (segs)
+		wifipro_sample_interval =
+		    clamp_t(unsigned long,
+			    elapsed * WIFIPRO_SAMPLE_SEGS / segs,
+			    WIFIPRO_SAMPLE_MIN_INTERVAL,
+			    WIFIPRO_SAMPLE_MAX_INTERVAL);
+	else
+		wifipro_sample_interval = WIFIPRO_SAMPLE_IDLE_INTERVAL;
+
+out:
+	mutex_unlock(&wifipro_sample_sem);
+}
+
+static void wifipro_tcp_sample_work_handler(struct work_struct *work)
+{
+	wifipro_tcp_sample();
+	queue_delayed_work(system_power_efficient_wq, &wifipro_tcp_sample_work,
+			   wifipro_sample_interval);
+}
+
 static void wifipro_cong_stat_init(wifipro_cong_sock_t *src,
 				   unsigned char offset, const char *name)
 {
@@ -1497,6 +1567,8 @@ static int __init wifipro_tcp_monitor_module_init(void)
 	INIT_WORK(&wifipro_tcp_retrans_work, wifipro_tcp_retrans_work_handler);
 	INIT_DELAYED_WORK(&wifipro_tcp_monitor_work,
 			  wifipro_tcp_monitor_work_handler);
+	INIT_DEFERRABLE_WORK(&wifipro_tcp_sample_work,
+			     wifipro_tcp_sample_work_handler);
 
 	wifipro_tcp_trigger_inf =
 	    kzalloc(sizeof(struct wifipro_tcp_monitor_inf), GFP_KERNEL);
@@ -1546,11 +1618,16 @@ static int __init wifipro_tcp_monitor_module_init(void)
 		return -1;
 	}
 
+	wifipro_sample_last = jiffies;
+	queue_delayed_work(system_power_efficient_wq, &wifipro_tcp_sample_work,
+			   WIFIPRO_SAMPLE_IDLE_INTERVAL);
+
 	return 0;
 }
 
 static void __exit wifipro_tcp_monitor_module_exit(void)
 {
+	cancel_delayed_work_sync(&wifipro_tcp_sample_work);
 	wifipro_cancel_task();
 	wifipro_rtt_monitor_deinit();
 
@@ -1715,7 +1792,6 @@ static int wifipro_snmp_seq_show(struct seq_file *seq, void *v)
 	}
 
 	seq_printf(seq, "unknown_dev_count is %d\n", unknown_dev_count);
-	seq_printf(seq, "unknown_segs_count is %d\n", unknown_segs_count);
 	seq_puts(seq, "\n");
 	return 0;
 }
@@ -26,6 +26,19 @@
 #define WIFIPRO_MOBILE_BQE_RTT                  2
 #define WIFIPRO_WLAN_SAMPLE_RTT                  3
 
+/* Socket sampler: aim for one pass per WIFIPRO_SAMPLE_SEGS segments */
+#define WIFIPRO_SAMPLE_SEGS                 64
+#define WIFIPRO_SAMPLE_MIN_INTERVAL         (HZ/4)
+#define WIFIPRO_SAMPLE_MAX_INTERVAL         (1*HZ)
+#define WIFIPRO_SAMPLE_IDLE_INTERVAL        (2*HZ)
+
+enum {
+	WIFIPRO_DEV_UNKNOWN = 0,
+	WIFIPRO_DEV_WLAN,
+	WIFIPRO_DEV_MOBILE,
+	WIFIPRO_DEV_OTHER
+};
+
 enum {
 	WIFIPRO_ERR = 0,
 	WIFIPRO_WARNING,
@@ -139,8 +152,6 @@ void wifipro_handle_congestion(struct sock *sk, u8 ca_state);
 bool wifipro_is_google_sock(struct task_struct *task, unsigned int dest_addr);
 bool wifipro_is_trigger_sock(unsigned int dest_addr, unsigned int dest_port);
 int wifipro_init_proc(struct net *net);
-void wifipro_update_rtt(unsigned int rtt, struct sock *sk);
-void wifipro_update_tcp_statistics(int mib_type, const struct sk_buff *skb, struct sock *from_sk);
 
 static inline bool wifipro_is_not_local_or_lan_sock(unsigned int ip_addr)
 {
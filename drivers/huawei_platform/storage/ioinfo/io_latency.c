@@ -0,0 +1,243 @@
+/*
+ * Per-request I/O latency records for jank triage.
+ *
+ * Each request is stamped when it is queued, handed to the driver, issued
+ * to the device and completed. On completion one record with the three
+ * phases and the uid that queued it goes to a ring that the perf daemon
+ * maps read-only from /proc/io_latency.
+ */
+
+/*----------------------------------------------------------------------
+    INCLUDE FILES
+----------------------------------------------------------------------*/
+#include <linux/atomic.h>
+#include <linux/blkdev.h>
+#include <linux/cred.h>
+#include <linux/fs.h>
+#include <linux/hash.h>
+#include <linux/init.h>
+#include <linux/ktime.h>
+#include <linux/mm.h>
+#include <linux/proc_fs.h>
+#include <linux/vmalloc.h>
+#include <huawei_platform/storage/io_latency.h>
+
+/*----------------------------------------------------------------------
+    MACROS
+----------------------------------------------------------------------*/
+#define IO_LATENCY_NR_RECORDS 4096 //records in the ring, power of 2
+#define IO_LATENCY_UID_BITS 6 //uid buckets for the interference estimate
+
+/*----------------------------------------------------------------------
+    GLOBAL VARIABLES
+----------------------------------------------------------------------*/
+static void *iolat_ring; //header page followed by the records
+static struct io_latency_record *iolat_records;
+static atomic64_t iolat_head = ATOMIC64_INIT(0);
+
+//requests handed to the drivers, in total and per uid bucket
+static atomic_t iolat_dispatched = ATOMIC_INIT(0);
+static atomic_t iolat_uid_dispatched[1 << IO_LATENCY_UID_BITS];
+
+/*----------------------------------------------------------------------
+    FUNCTION DEFINITIONS
+----------------------------------------------------------------------*/
+
+static atomic_t *io_latency_uid_bucket(uid_t uid)
+{
+    return &iolat_uid_dispatched[hash_32(uid, IO_LATENCY_UID_BITS)];
+}
+
+static u32 io_latency_us(u64 from_ns, u64 to_ns)
+{
+    if (!from_ns || to_ns <= from_ns)
+    {
+        return 0;
+    }
+
+    return (u32)min_t(u64, div_u64(to_ns - from_ns, NSEC_PER_USEC), U32_MAX);
+}
+
+/**
+*   @brief:    Stamp a request built from a bio, in the context of the
+*              task that submitted it.
+*   @param: req: the request.
+*   @return: void.
+*/
+void io_latency_rq_init(struct request *req)
+{
+    req->iolat_uid = from_kuid_munged(&init_user_ns, current_uid());
+    req->iolat_queue_ns = ktime_get_ns();
+    req->iolat_start_ns = 0;
+    req->iolat_issue_ns = 0;
+    req->iolat_seq = atomic_read(&iolat_dispatched);
+    req->iolat_useq = atomic_read(io_latency_uid_bucket(req->iolat_uid));
+}
+
+/**
+*   @brief:    The request leaves the queue for the driver. From here on
+*              iolat_seq/iolat_useq hold how many requests in total and of
+*              its own uid were handed out while it waited.
+*   @param: req: the request.
+*   @return: void.
+*/
+void io_latency_rq_start(struct request *req)
+{
+    atomic_t *bucket;
+
+    if (!req->iolat_queue_ns || req->iolat_start_ns)
+    {
+        return; //not from a bio, or requeued
+    }
+
+    bucket = io_latency_uid_bucket(req->iolat_uid);
+    req->iolat_start_ns = ktime_get_ns();
+    req->iolat_seq = atomic_inc_return(&iolat_dispatched) - 1 - req->iolat_seq;
+    req->iolat_useq = atomic_inc_return(bucket) - 1 - req->iolat_useq;
+}
+
+/**
+*   @brief:    The driver issues the request to the device, only drivers
+*              that call this get the driver and device time split.
+*   @param: req: the request.
+*   @return: void.
+*/
+void io_latency_rq_issue(struct request *req)
+{
+    if (req->iolat_start_ns)
+    {
+        req->iolat_issue_ns = ktime_get_ns();
+    }
+}
+
+/**
+*   @brief:    Account a completed request into the ring, lock free: the
+*              slot is claimed with an atomic increment and its seq is
+*              written last, after the rest of the record. The stamps are
+*              cleared for the next user of the request in any case.
+*   @param: req: the request.
+*   @return: void.
+*/
+void io_latency_rq_done(struct request *req)
+{
+    struct io_latency_ring_hdr *hdr = READ_ONCE(iolat_ring);
+    struct io_latency_record *rec;
+    u64 now = ktime_get_ns();
+    u64 seq;
+    u32 flags = 0;
+    u32 others;
+
+    if (!hdr || !req->iolat_start_ns || (req->cmd_flags & REQ_FLUSH_SEQ))
+    {
+        goto out;
+    }
+
+    seq = atomic64_inc_return(&iolat_head);
+    rec = &iolat_records[(seq - 1) & (IO_LATENCY_NR_RECORDS - 1)];
+
+    if (rq_data_dir(req) == WRITE)
+    {
+        flags |= IO_LATENCY_WRITE;
+    }
+    if (rq_is_sync(req))
+    {
+        flags |= IO_LATENCY_SYNC;
+    }
+    if (req->cmd_flags & REQ_FG)
+    {
+        flags |= IO_LATENCY_FG;
+    }
+    if (req->cmd_flags & REQ_META)
+    {
+        flags |= IO_LATENCY_META;
+    }
+
+    WRITE_ONCE(rec->seq, 0);
+    smp_wmb(); //the daemon must not take a half written record as complete
+    rec->uid = req->iolat_uid;
+    rec->flags = flags;
+    rec->bytes = blk_rq_bytes(req);
+    rec->done_ns = now;
+    rec->queue_us = io_latency_us(req->iolat_queue_ns, req->iolat_start_ns);
+    if (req->iolat_issue_ns)
+    {
+        rec->driver_us = io_latency_us(req->iolat_start_ns, req->iolat_issue_ns);
+        rec->device_us = io_latency_us(req->iolat_issue_ns, now);
+    }
+    else
+    {
+        rec->driver_us = 0;
+        rec->device_us = io_latency_us(req->iolat_start_ns, now);
+    }
+
+    //the waiting time is split by the share of other uids' dispatches
+    others = req->iolat_seq - min(req->iolat_seq, req->iolat_useq);
+    rec->others_us = req->iolat_seq ?
+        (u32)div_u64((u64)rec->queue_us * others, req->iolat_seq) : 0;
+
+    smp_wmb(); //pairs with the daemon reading seq before the record
+    WRITE_ONCE(rec->seq, (u32)seq);
+    WRITE_ONCE(hdr->head, seq);
+out:
+    req->iolat_queue_ns = 0;
+    req->iolat_start_ns = 0;
+}
+
+static int io_latency_mmap(struct file *file, struct vm_area_struct *vma)
+{
+    if (vma->vm_flags & VM_WRITE)
+    {
+        return -EPERM;
+    }
+    vma->vm_flags &= ~VM_MAYWRITE;
+
+    return remap_vmalloc_range(vma, iolat_ring, vma->vm_pgoff);
+}
+
+static const struct file_operations io_latency_fops =
+{
+    .mmap = io_latency_mmap,
+};
+
+/**
+*   @brief:    Allocate the ring and create /proc/io_latency.
+*   @param: void.
+*   @return:  0, or -ENOMEM.
+*/
+static int __init io_latency_init(void)
+{
+    struct io_latency_ring_hdr *hdr;
+    void *ring;
+
+    BUILD_BUG_ON(!is_power_of_2(IO_LATENCY_NR_RECORDS));
+
+    ring = vmalloc_user(PAGE_SIZE +
+            IO_LATENCY_NR_RECORDS * sizeof(struct io_latency_record));
+    if (!ring)
+    {
+        pr_err("io_latency: failed to alloc the ring\n");
+        return -ENOMEM;
+    }
+
+    hdr = ring;
+    hdr->magic = IO_LATENCY_RING_MAGIC;
+    hdr->version = IO_LATENCY_RING_VERSION;
+    hdr->nr_records = IO_LATENCY_NR_RECORDS;
+    hdr->record_size = sizeof(struct io_latency_record);
+    iolat_records = ring + PAGE_SIZE;
+
+    if (!proc_create("io_latency", S_IRUSR | S_IRGRP, NULL, &io_latency_fops))
+    {
+        pr_err("io_latency: failed to create proc entry\n");
+        vfree(ring);
+        return -ENOMEM;
+    }
+
+    //publish the ring to the completion path last
+    smp_wmb();
+    WRITE_ONCE(iolat_ring, ring);
+
+    return 0;
+}
+
+device_initcall(io_latency_init);
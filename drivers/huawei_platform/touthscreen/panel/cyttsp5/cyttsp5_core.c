@@ -26,6 +26,7 @@
 #include "cyttsp5_hw.h"
 #include "cyttsp5_platform.h"
 #include <linux/kthread.h>
+#include <linux/cpufreq.h>
 #if defined (CONFIG_HUAWEI_DSM)
 #include <dsm/dsm_pub.h>
 #endif
@@ -4336,17 +4337,82 @@ static  bool cyttsp5_check_irq_asserted(struct cyttsp5_core_data *cd)
 	return true;
 }
 
+static irqreturn_t cyttsp5_hard_irq(int irq, void *handle)
+{
+	struct cyttsp5_core_data *cd = handle;
+
+	cd->irq_lat.irq_time = ktime_get();
+	return IRQ_WAKE_THREAD;
+}
+
+/*
+ * Irq threads all run at the same SCHED_FIFO priority, so a touch report
+ * can wait behind the storage or wifi irq threads, and on a little core.
+ * Run ours above them and on the big cluster (the last one here).
+ */
+static void cyttsp5_tune_irq_thread(struct cyttsp5_core_data *cd)
+{
+	struct sched_param param = { .sched_priority = CY_IRQ_THREAD_PRIO };
+	const struct cpumask *big = topology_core_cpumask(nr_cpu_ids - 1);
+
+	if (sched_setscheduler_nocheck(current, SCHED_FIFO, &param))
+		TS_LOG_ERR("%s: set irq thread priority failed\n", __func__);
+
+	/* retried on the next irq while the big cluster is offline */
+	if (!cpumask_intersects(big, cpu_online_mask))
+		return;
+	if (set_cpus_allowed_ptr(current, big))
+		TS_LOG_ERR("%s: set irq thread affinity failed\n", __func__);
+	cd->irq_thread_tuned = true;
+}
+
+static void cyttsp5_irq_latency_record(struct cyttsp5_core_data *cd)
+{
+	struct cyttsp5_irq_latency *lat = &cd->irq_lat;
+	u32 us = (u32)ktime_us_delta(ktime_get(), lat->irq_time);
+	int i = 0;
+
+	while (i < CY_IRQ_LAT_BUCKETS - 1 && us >= (CY_IRQ_LAT_BASE_US << i))
+		i++;
+
+	spin_lock(&cd->spinlock);
+	lat->count++;
+	lat->last_us = us;
+	lat->sum_us += us;
+	if (us > lat->max_us)
+		lat->max_us = us;
+	lat->hist[i]++;
+	spin_unlock(&cd->spinlock);
+
+	TS_LOG_DEBUG("%s: irq to input_sync %uus\n", __func__, us);
+}
+
 static irqreturn_t cyttsp5_irq(int irq, void *handle)
 {
 	struct cyttsp5_core_data *cd = handle;
+	int prv_tch = cd->md.num_prv_rec;
 	int rc;
 
+	if (unlikely(!cd->irq_thread_tuned))
+		cyttsp5_tune_irq_thread(cd);
+
 	g_interrupt_num++;
 	if (!cyttsp5_check_irq_asserted(cd))
 		return IRQ_HANDLED;
+
+	/*
+	 * Nothing was down, so this is most likely a new contact: boost now
+	 * rather than after the bus read and the input_sync() of the report.
+	 */
+	if (!prv_tch)
+		cpufreq_interactive_touch_boost();
+
 	rc = cyttsp5_read_input(cd);
-	if (!rc)
+	if (!rc) {
 		cyttsp5_parse_input(cd);
+		if (prv_tch || cd->md.num_prv_rec)
+			cyttsp5_irq_latency_record(cd);
+	}
 	g_interrupt_num++;
 
 	return IRQ_HANDLED;
@@ -5336,6 +5402,57 @@ static ssize_t cyttsp5_drv_irq_show(struct device *dev,
 	return ret;
 }
 
+/*
+ * Show the irq to input_sync latency of touch reports, write to reset
+ */
+static ssize_t cyttsp5_irq_latency_show(struct device *dev,
+					struct device_attribute *attr, char *buf)
+{
+	struct cyttsp5_core_data *cd = dev_get_drvdata(dev);
+	struct cyttsp5_irq_latency lat;
+	ssize_t ret;
+	int i;
+
+	spin_lock(&cd->spinlock);
+	lat = cd->irq_lat;
+	spin_unlock(&cd->spinlock);
+
+	ret = snprintf(buf, PAGE_SIZE, "count %u last %u avg %llu max %u us\n",
+		       lat.count, lat.last_us,
+		       lat.count ? div_u64(lat.sum_us, lat.count) : 0,
+		       lat.max_us);
+	for (i = 0; i < CY_IRQ_LAT_BUCKETS; i++) {
+		if (i < CY_IRQ_LAT_BUCKETS - 1)
+			ret += snprintf(buf + ret, PAGE_SIZE - ret,
+					"<%u: %u\n",
+					CY_IRQ_LAT_BASE_US << i, lat.hist[i]);
+		else
+			ret += snprintf(buf + ret, PAGE_SIZE - ret,
+					">=%u: %u\n",
+					CY_IRQ_LAT_BASE_US << (i - 1),
+					lat.hist[i]);
+	}
+
+	return ret;
+}
+
+static ssize_t cyttsp5_irq_latency_store(struct device *dev,
+					 struct device_attribute *attr,
+					 const char *buf, size_t size)
+{
+	struct cyttsp5_core_data *cd = dev_get_drvdata(dev);
+
+	spin_lock(&cd->spinlock);
+	cd->irq_lat.count = 0;
+	cd->irq_lat.last_us = 0;
+	cd->irq_lat.max_us = 0;
+	cd->irq_lat.sum_us = 0;
+	memset(cd->irq_lat.hist, 0, sizeof(cd->irq_lat.hist));
+	spin_unlock(&cd->spinlock);
+
+	return size;
+}
+
 /*
  * Enable/disable IRQ via sysfs
  */
@@ -6375,6 +6492,8 @@ static struct device_attribute attributes[] = {
 	__ATTR(drv_ver, 0444, cyttsp5_drv_ver_show, NULL),
 	__ATTR(hw_reset, 0220, NULL, cyttsp5_hw_reset_store),
 	__ATTR(hw_irq_stat, 0444, cyttsp5_hw_irq_stat_show, NULL),
+	__ATTR(irq_latency, 0664, cyttsp5_irq_latency_show,
+	       cyttsp5_irq_latency_store),
 	__ATTR(drv_irq, 0664, cyttsp5_drv_irq_show,
 	       cyttsp5_drv_irq_store),
 	__ATTR(drv_debug, 0220, NULL, cyttsp5_drv_debug_store),
@@ -6726,8 +6845,8 @@ static int cyttsp5_setup_irq_gpio(struct cyttsp5_core_data *cd)
 		irq_flags |= IRQF_NO_SUSPEND;
 	}
 
-	rc = request_threaded_irq(cd->irq, NULL, cyttsp5_irq, irq_flags,
-				  dev_name(dev), cd);
+	rc = request_threaded_irq(cd->irq, cyttsp5_hard_irq, cyttsp5_irq,
+				  irq_flags, dev_name(dev), cd);
 	if (rc < 0) {
 		TS_LOG_ERR("%s: Error, could not request irq, rc = %d\n",
 			   __func__, rc);
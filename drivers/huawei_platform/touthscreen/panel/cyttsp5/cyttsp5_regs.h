@@ -979,6 +979,21 @@ struct cyttsp5_init_data {
 	int init_status;
 };
 
+/* priority of the irq thread, above the default irq threads (50) */
+#define CY_IRQ_THREAD_PRIO	(MAX_USER_RT_PRIO / 2 + 10)
+
+/* irq to input_sync latency of touch reports, buckets double from 250us */
+#define CY_IRQ_LAT_BUCKETS	8
+#define CY_IRQ_LAT_BASE_US	250
+struct cyttsp5_irq_latency {
+	ktime_t irq_time;
+	u32 count;
+	u32 last_us;
+	u32 max_us;
+	u64 sum_us;
+	u32 hist[CY_IRQ_LAT_BUCKETS];
+};
+
 struct cyttsp5_core_data {
 	struct list_head node;
 	char core_id[20];
@@ -1007,6 +1022,8 @@ struct cyttsp5_core_data {
 	bool irq_enabled;
 	bool irq_wake;
 	bool irq_disabled;
+	bool irq_thread_tuned;
+	struct cyttsp5_irq_latency irq_lat;
 	int gesture_id;
 	int dtz_x0;
 	int dtz_y0;
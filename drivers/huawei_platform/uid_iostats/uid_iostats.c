@@ -20,7 +20,9 @@
 #include <linux/kernel.h>
 #include <linux/list.h>
 #include <linux/proc_fs.h>
+#include <linux/percpu.h>
 #include <linux/profile.h>
+#include <linux/rcupdate.h>
 #include <linux/sched.h>
 #include <linux/seq_file.h>
 #include <linux/slab.h>
@@ -58,17 +60,20 @@ struct action_handler g_handlers[] = {
 	{ACTION_UNKNOWN,	NULL},
 };
 
-struct pid_node {
-	pid_t pid;
-	struct list_head list;
+/* bytes of the exited tasks of a uid, summed only when read */
+struct uid_io {
+	u64 read_bytes;
+	u64 write_bytes;
 };
 
 struct uid_entry {
 	uid_t uid;
-	u64 read_bytes;
-	u64 write_bytes;
-	struct list_head pid_list;
+	struct uid_io __percpu *io;
+	/* live tasks, only used under uid_lock by ioflowmeter_show_stats() */
+	u64 live_read_bytes;
+	u64 live_write_bytes;
 	struct hlist_node hash;
+	struct rcu_head rcu;
 };
 
 static int ioflowmeter_io_accounting(
@@ -92,80 +97,14 @@ out_unlock:
 	return result;
 }
 
-static void ioflowmeter_del_pid(struct uid_entry *uid_entry, pid_t pid)
-{
-	struct pid_node *cur, *saved_cur;
-
-	if (NULL == uid_entry) {
-		pr_err("%s: the uid_entry invalid\n", __func__);
-		return;
-	}
-
-	list_for_each_entry_safe(cur, saved_cur, &uid_entry->pid_list, list) {
-		if (cur && pid == cur->pid) {
-			pr_debug("%s: the pid is %u\n", __func__, cur->pid);
-			list_del(&cur->list);
-			kfree(cur);
-			break;
-		}
-	}
-
-}
-
-static void ioflowmeter_del_pid_list(struct uid_entry *uid_entry)
-{
-	struct pid_node *cur, *saved_cur;
-
-	if (NULL == uid_entry) {
-		pr_err("%s: the uid_entry invalid\n", __func__);
-		return;
-	}
-
-	list_for_each_entry_safe(cur, saved_cur, &uid_entry->pid_list, list) {
-		if (cur) {
-			pr_debug("%s: the pid is %u\n", __func__, cur->pid);
-			list_del(&cur->list);
-			kfree(cur);
-		}
-	}
-
-}
-
-/* different pids in the list */
-static void ioflowmeter_add_pid(struct uid_entry *uid_entry, pid_t the_pid)
-{
-	struct list_head *pre;
-	struct pid_node *cur, *saved_cur;
-	struct pid_node *the_node = NULL;
-
-	pre = &uid_entry->pid_list;
-	list_for_each_entry_safe(cur, saved_cur, &uid_entry->pid_list, list) {
-		pr_debug("%s: the pid is %u\n", __func__, cur->pid);
-		if (the_pid > cur->pid)
-			break;
-		else if (the_pid == cur->pid)
-			return;
-
-		pre = &cur->list;
-	}
-
-	the_node = kzalloc(sizeof(struct pid_node), GFP_KERNEL);
-	if (NULL == the_node) {
-		pr_err("%s: cannot alloc the node\n", __func__);
-		return;
-	}
-
-	the_node->pid = the_pid;
-
-	list_add(&the_node->list, pre);
-
-}
-
+/* either under uid_lock or rcu_read_lock() */
 static struct uid_entry *ioflowmeter_find_uid(uid_t uid)
 {
 	struct uid_entry *uid_entry;
-	hash_for_each_possible(ioflowmeter_hash_table, uid_entry, hash, uid) {
-		if (uid_entry && uid_entry->uid == uid) {
+
+	hash_for_each_possible_rcu(ioflowmeter_hash_table, uid_entry,
+					hash, uid) {
+		if (uid_entry->uid == uid) {
 			pr_debug("%s: find the uid_entry for %u\n",
 					__func__, uid);
 			return uid_entry;
@@ -185,57 +124,90 @@ static struct uid_entry *ioflowmeter_register_uid(uid_t uid)
 		return uid_entry;
 	}
 
-	uid_entry = kzalloc(sizeof(struct uid_entry), GFP_ATOMIC);
+	uid_entry = kzalloc(sizeof(struct uid_entry), GFP_KERNEL);
 	if (!uid_entry) {
 		pr_err("%s: cannot alloc the uid_entry\n", __func__);
 		return NULL;
 	}
 
+	uid_entry->io = alloc_percpu(struct uid_io);
+	if (!uid_entry->io) {
+		pr_err("%s: cannot alloc the uid_io\n", __func__);
+		kfree(uid_entry);
+		return NULL;
+	}
+
 	uid_entry->uid = uid;
-	INIT_LIST_HEAD(&uid_entry->pid_list);
 
-	hash_add(ioflowmeter_hash_table, &uid_entry->hash, uid);
+	hash_add_rcu(ioflowmeter_hash_table, &uid_entry->hash, uid);
 
 	return uid_entry;
 }
 
-static int ioflowmeter_show_stats(struct seq_file *m, void *v)
+static void ioflowmeter_free_uid(struct rcu_head *head)
+{
+	struct uid_entry *uid_entry = container_of(head, struct uid_entry, rcu);
+
+	free_percpu(uid_entry->io);
+	kfree(uid_entry);
+}
+
+/* Sum up the live tasks of the monitored uids, under uid_lock */
+static void ioflowmeter_account_live_tasks(void)
 {
 	struct uid_entry *uid_entry;
 	unsigned long bkt;
-	struct pid_node *cur, *saved_cur;
-	struct task_struct *t = NULL;
-	u64 pids_read_bytes = 0;
-	u64 pids_write_bytes = 0;
+	struct task_struct *t;
 	struct task_io_accounting acct;
+	uid_t uid;
+
+	hash_for_each(ioflowmeter_hash_table, bkt, uid_entry, hash) {
+		uid_entry->live_read_bytes = 0;
+		uid_entry->live_write_bytes = 0;
+	}
+
+	rcu_read_lock();
+	for_each_process(t) {
+		uid = from_kuid_munged(current_user_ns(), task_uid(t));
+		uid_entry = ioflowmeter_find_uid(uid);
+		if (!uid_entry)
+			continue;
+
+		acct = t->ioac;
+		ioflowmeter_io_accounting(t, &acct, 1);
+		uid_entry->live_read_bytes += acct.read_bytes;
+		uid_entry->live_write_bytes += acct.write_bytes;
+		pr_debug("%s: %d-%d: %llu %llu\n", __func__, uid, t->pid,
+			acct.read_bytes, acct.write_bytes);
+	}
+	rcu_read_unlock();
+}
+
+static int ioflowmeter_show_stats(struct seq_file *m, void *v)
+{
+	struct uid_entry *uid_entry;
+	unsigned long bkt;
+	u64 read_bytes;
+	u64 write_bytes;
+	int cpu;
 
 	mutex_lock(&uid_lock);
 
+	ioflowmeter_account_live_tasks();
+
 	hash_for_each(ioflowmeter_hash_table, bkt, uid_entry, hash) {
-		pids_read_bytes = 0;
-		pids_write_bytes = 0;
-		list_for_each_entry_safe(cur, saved_cur,
-						&uid_entry->pid_list, list) {
-			t = find_task_by_pid_ns(cur->pid, &init_pid_ns);
-			if (t) {
-				memset((void *)&acct, 0, sizeof(acct));
-				acct = t->ioac;
-				ioflowmeter_io_accounting(t, &acct, 1);
-				pids_read_bytes += acct.read_bytes;
-				pids_write_bytes += acct.write_bytes;
-				pr_debug("%s: %d-%d: %llu %llu %llu %llu\n",
-					__func__,
-					uid_entry->uid, cur->pid,
-					acct.read_bytes, acct.write_bytes,
-					pids_read_bytes, pids_write_bytes);
-			}
+		read_bytes = uid_entry->live_read_bytes;
+		write_bytes = uid_entry->live_write_bytes;
+		for_each_possible_cpu(cpu) {
+			struct uid_io *io = per_cpu_ptr(uid_entry->io, cpu);
+
+			read_bytes += io->read_bytes;
+			write_bytes += io->write_bytes;
 		}
 		pr_debug("%s: %d: %llu %llu\n", __func__,
-			uid_entry->uid, uid_entry->read_bytes,
-			uid_entry->write_bytes);
+			uid_entry->uid, read_bytes, write_bytes);
 		seq_printf(m, "%d: %llu %llu\n", uid_entry->uid,
-			uid_entry->read_bytes + pids_read_bytes,
-			uid_entry->write_bytes + pids_write_bytes);
+			read_bytes, write_bytes);
 	}
 
 	mutex_unlock(&uid_lock);
@@ -281,9 +253,9 @@ static void ioflowmeter_rm_uid_action(uid_t uid)
 
 	uid_entry = ioflowmeter_find_uid(uid);
 	if (uid_entry) {
-		hash_del(&uid_entry->hash);
-		ioflowmeter_del_pid_list(uid_entry);
-		kfree(uid_entry);
+		hash_del_rcu(&uid_entry->hash);
+		/* the exit notifier may still be adding to it */
+		call_rcu(&uid_entry->rcu, ioflowmeter_free_uid);
 		uid_entry = NULL;
 	}
 
@@ -413,6 +385,12 @@ static const struct file_operations ioflowmeter_add_uid_fops = {
 	.write		= ioflowmeter_add_uid_write,
 };
 
+/*
+ * Runs for every exiting process, so it takes no lock: the uid is looked
+ * up under RCU and the bytes go to this cpu's counters of the uid.
+ * The live tasks are summed up by ioflowmeter_show_stats() instead of
+ * being tracked on fork and setresuid.
+ */
 static int process_exit_notifier(struct notifier_block *self,
 			unsigned long cmd, void *v)
 {
@@ -424,13 +402,12 @@ static int process_exit_notifier(struct notifier_block *self,
 	if (!task || !thread_group_leader(task))
 		return NOTIFY_OK;
 
-	mutex_lock(&uid_lock);
+	rcu_read_lock();
 	uid = from_kuid_munged(current_user_ns(), task_uid(task));
 	uid_entry = ioflowmeter_find_uid(uid);
 	if (!uid_entry)
 		goto exit;
 
-	memset((void *)&acct, 0, sizeof(struct task_io_accounting));
 	acct = task->ioac;
 	ioflowmeter_io_accounting(task, &acct, 1);
 	pr_debug("%s: the task %s's pid is %d, tgid is %d, the uid is %d, group leader is %d\n",
@@ -443,13 +420,11 @@ static int process_exit_notifier(struct notifier_block *self,
 					__func__,
 					acct.write_bytes);
 
-	uid_entry->read_bytes += acct.read_bytes;
-	uid_entry->write_bytes += acct.write_bytes;
-
-	ioflowmeter_del_pid(uid_entry, task->pid);
+	this_cpu_add(uid_entry->io->read_bytes, acct.read_bytes);
+	this_cpu_add(uid_entry->io->write_bytes, acct.write_bytes);
 
 exit:
-	mutex_unlock(&uid_lock);
+	rcu_read_unlock();
 	return NOTIFY_OK;
 }
 
@@ -457,39 +432,6 @@ static struct notifier_block process_exit_notifier_block = {
 	.notifier_call	= process_exit_notifier,
 };
 
-static int process_entry_notifier(struct notifier_block *self,
-			unsigned long cmd, void *v)
-{
-	struct task_struct *task = v;
-	struct uid_entry *uid_entry = NULL;
-	uid_t uid;
-
-	if (!task || !thread_group_leader(task))
-		return NOTIFY_OK;
-
-	mutex_lock(&uid_lock);
-	uid = from_kuid_munged(current_user_ns(), task_uid(task));
-	uid_entry = ioflowmeter_find_uid(uid);
-	if (!uid_entry)
-		goto exit;
-
-	ioflowmeter_add_pid(uid_entry, task->pid);
-	pr_debug("%s: the task %s's pid is %d, tgid is %d, the uid is %d, group leader is %d\n",
-				__func__,
-				task->comm,
-				task->pid, task->tgid, uid,
-				thread_group_leader(task));
-
-
-exit:
-	mutex_unlock(&uid_lock);
-	return NOTIFY_OK;
-}
-
-static struct notifier_block process_entry_notifier_block = {
-	.notifier_call	= process_entry_notifier,
-};
-
 static int __init proc_ioflowmeter_init(void)
 {
 	hash_init(ioflowmeter_hash_table);
@@ -516,10 +458,6 @@ static int __init proc_ioflowmeter_init(void)
 
 	profile_event_register(PROFILE_TASK_EXIT,
 			&process_exit_notifier_block);
-	profile_event_register(PROFILE_TASK_END_FORK,
-			&process_entry_notifier_block);
-	profile_event_register(PROFILE_END_SETRESUID,
-			&process_entry_notifier_block);
 
 	return 0;
 }
@@ -29,8 +29,14 @@
 #define SMMU_PMDIR_MASK       (~(SMMU_PMDIR_SIZE-1))
 #define SMMU_PGD_TYPE         (BIT(0) | BIT(1))
 #define SMMU_PMD_TYPE         (BIT(0) | BIT(1))
+#define SMMU_PMD_BLOCK        BIT(0)                /* 2M block, no pte table */
 #define SMMU_PTE_TYPE         (BIT(0) | BIT(1))
 
+/* 16 ptes mapping 64K of contiguous memory may share one TLB entry */
+#define SMMU_PTE_CONT         BIT(52)
+#define SMMU_CONT_PTES        (16)
+#define SMMU_CONT_SIZE        (SMMU_CONT_PTES * SMMU_PAGE_SIZE)
+
 #define SMMU_PGD_NS           BIT(63)
 #define SMMU_PMD_NS           BIT(63)
 #define SMMU_PTE_NS           BIT(5)
@@ -114,6 +120,20 @@ static inline unsigned int pte_is_valid_lpae(smmu_pte_t *ptep) {
 	return (unsigned int)((*(ptep)&SMMU_PTE_TYPE) ? 1 : 0);
 }
 
+static inline unsigned int smmu_pmd_block_lpae(smmu_pmd_t pmd) {
+	return (pmd & SMMU_PMD_TYPE) == SMMU_PMD_BLOCK;
+}
+
+/*
+ * Page table entries written but not yet cleaned to memory, where the
+ * SMMU walks them. Map and unmap of whole buffers collect them here and
+ * clean each run once, instead of once per entry range they touch.
+ */
+struct hisi_smmu_flush_batch {
+	u64 *start;
+	u64 *end;
+};
+
 /* Find an entry in the second-level page table.. */
 static inline void *smmu_pmd_page_vaddr_lpae(smmu_pmd_t *pgd)
 {
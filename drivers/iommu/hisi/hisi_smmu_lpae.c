@@ -27,11 +27,28 @@
 #include <linux/hisi/hisi-iommu.h>
 #include <linux/uaccess.h>
 #include <linux/bitops.h>
+#include <linux/ktime.h>
+#include <linux/seq_file.h>
 #include <linux/hisi/rdr_hisi_ap_hook.h>
 #include "hisi_smmu.h"
 
 struct hisi_smmu_device_lpae *hisi_smmu_dev;
 
+static bool block_mappings = true;
+module_param(block_mappings, bool, 0644);
+MODULE_PARM_DESC(block_mappings,
+		 "map with 2M blocks and 64K contiguous ptes where memory allows");
+
+struct hisi_smmu_op_stats {
+	atomic64_t count;
+	atomic64_t bytes;
+	atomic64_t ns;
+	u64 max_ns;
+};
+
+static struct hisi_smmu_op_stats smmu_map_stats, smmu_unmap_stats;
+static atomic64_t smmu_stat_blocks, smmu_stat_cont, smmu_stat_flushes;
+
 /*transfer 64bit pte table pointer to struct page*/
 static pgtable_t smmu_pgd_to_pte_lpae(unsigned int ppte_table)
 {
@@ -123,6 +140,80 @@ static void hisi_smmu_flush_pgtable_lpae(void *addr, size_t size)
 	__flush_dcache_area(addr, size);
 }
 
+static void hisi_smmu_batch_flush_lpae(struct hisi_smmu_flush_batch *batch)
+{
+	if (batch->start == batch->end)
+		return;
+	hisi_smmu_flush_pgtable_lpae(batch->start,
+			(batch->end - batch->start) * sizeof(u64));
+	atomic64_inc(&smmu_stat_flushes);
+	batch->start = batch->end = NULL;
+}
+
+/* entries [start, end) were written; without a batch clean them now */
+static void hisi_smmu_batch_add_lpae(struct hisi_smmu_flush_batch *batch,
+		u64 *start, u64 *end)
+{
+	if (!batch) {
+		hisi_smmu_flush_pgtable_lpae(start, (end - start) * sizeof(u64));
+		return;
+	}
+	if (start != batch->end) {
+		hisi_smmu_batch_flush_lpae(batch);
+		batch->start = start;
+	}
+	batch->end = end;
+}
+
+static void hisi_smmu_account_lpae(struct hisi_smmu_op_stats *stats,
+		size_t bytes, ktime_t start)
+{
+	u64 ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	atomic64_inc(&stats->count);
+	atomic64_add(bytes, &stats->bytes);
+	atomic64_add(ns, &stats->ns);
+	/* racy, it is only for the debugfs report */
+	if (ns > stats->max_ns)
+		stats->max_ns = ns;
+}
+
+static u64 hisi_smmu_pte_prot_lpae(int prot)
+{
+	u64 pteval = SMMU_PTE_TYPE;
+
+	if (!prot) {
+		pteval |= SMMU_PROT_NORMAL;
+		pteval |= SMMU_PTE_NS;
+	} else {
+		if (prot & IOMMU_DEVICE) {
+			pteval |= SMMU_PROT_DEVICE_nGnRE;
+		} else {
+			if (prot & IOMMU_CACHE)
+				pteval |= SMMU_PROT_NORMAL_CACHE;
+			else
+				pteval |= SMMU_PROT_NORMAL_NC;
+
+			if ((prot & IOMMU_READ) && (prot & IOMMU_WRITE))
+				pteval |= SMMU_PAGE_READWRITE;
+			else if ((prot & IOMMU_READ) && !(prot & IOMMU_WRITE))
+				pteval |= SMMU_PAGE_READONLY;
+			else
+				WARN_ON("you do not set read attribute!");
+
+			if (prot & IOMMU_EXEC) {
+				pteval |= SMMU_PAGE_READONLY_EXEC;
+				pteval &= ~(SMMU_PTE_PXN | SMMU_PTE_UXN);
+			}
+		}
+		if (prot & IOMMU_SEC)
+			pteval &= (~SMMU_PTE_NS);
+		else
+			pteval |= SMMU_PTE_NS;
+	}
+	return pteval;
+}
+
 static void hisi_smmu_free_ptes_lpae(smmu_pgd_t pmd)
 {
 	pgtable_t table = smmu_pgd_to_pte_lpae(pmd);
@@ -185,12 +276,17 @@ static void hisi_smmu_domain_free_lpae(struct iommu_domain *domain)
 
 static int hisi_smmu_alloc_init_pte_lpae(smmu_pmd_t *ppmd,
 		unsigned long addr, unsigned long end,
-		unsigned long pfn, u64 prot, unsigned long *flags)
+		unsigned long pfn, u64 prot, unsigned long *flags,
+		struct hisi_smmu_flush_batch *batch)
 {
 	smmu_pte_t *pte, *start;
 	pgtable_t table;
-	u64 pteval = SMMU_PTE_TYPE;
+	u64 pteval, cont = 0;
 
+	if (smmu_pmd_block_lpae(*ppmd)) {
+		WARN_ONCE(1, "map to same VA more times!\n");
+		return -EBUSY;
+	}
 	if (!smmu_pmd_none_lpae(*ppmd))
 		goto pte_ready;
 
@@ -218,39 +314,18 @@ pte_ready:
 	start = (smmu_pte_t *)smmu_pte_page_vaddr_lpae(ppmd)
 		+ smmu_pte_index(addr);
 	pte = start;
-	if (!prot) {
-		pteval |= SMMU_PROT_NORMAL;
-		pteval |= SMMU_PTE_NS;
-	} else {
-		if (prot & IOMMU_DEVICE) {
-			pteval |= SMMU_PROT_DEVICE_nGnRE;
-		} else {
-			if (prot & IOMMU_CACHE)
-				pteval |= SMMU_PROT_NORMAL_CACHE;
-			else
-				pteval |= SMMU_PROT_NORMAL_NC;
-
-			if ((prot & IOMMU_READ) && (prot & IOMMU_WRITE))
-				pteval |= SMMU_PAGE_READWRITE;
-			else if ((prot & IOMMU_READ) && !(prot & IOMMU_WRITE))
-				pteval |= SMMU_PAGE_READONLY;
-			else
-				WARN_ON("you do not set read attribute!");
-
-			if (prot & IOMMU_EXEC) {
-				pteval |= SMMU_PAGE_READONLY_EXEC;
-				pteval &= ~(SMMU_PTE_PXN | SMMU_PTE_UXN);
-			}
-		}
-		if (prot & IOMMU_SEC)
-			pteval &= (~SMMU_PTE_NS);
-		else
-			pteval |= SMMU_PTE_NS;
-	}
+	pteval = hisi_smmu_pte_prot_lpae(prot);
 
 	do {
+		/* the hint only goes on 64K runs written whole by this call */
+		if (block_mappings && !(addr & (SMMU_CONT_SIZE - 1))) {
+			cont = (!(__pfn_to_phys(pfn) & (SMMU_CONT_SIZE - 1)) &&
+				end - addr >= SMMU_CONT_SIZE) ? SMMU_PTE_CONT : 0;
+			if (cont)
+				atomic64_inc(&smmu_stat_cont);
+		}
 		if (!pte_is_valid_lpae(pte))
-			*pte = (u64)(__pfn_to_phys(pfn)|pteval);
+			*pte = (u64)(__pfn_to_phys(pfn)|pteval|cont);
 		else
 			WARN_ONCE(1, "map to same VA more times!\n");
 		pte++;
@@ -258,13 +333,14 @@ pte_ready:
 		addr += SMMU_PAGE_SIZE;
 	} while (addr < end);
 
-	hisi_smmu_flush_pgtable_lpae(start, sizeof(*pte) * (pte - start));
+	hisi_smmu_batch_add_lpae(batch, start, pte);
 	return 0;
 }
 
 static int hisi_smmu_alloc_init_pmd_lpae(smmu_pgd_t *ppgd,
 		unsigned long addr, unsigned long end,
-		unsigned long paddr, int prot, unsigned long *flags)
+		unsigned long paddr, int prot, unsigned long *flags,
+		struct hisi_smmu_flush_batch *batch)
 {
 	int ret = 0;
 	smmu_pmd_t *ppmd, *start;
@@ -299,10 +375,19 @@ pmd_ready:
 
 	do {
 		next = smmu_pmd_addr_end_lpae(addr, end);
-		ret = hisi_smmu_alloc_init_pte_lpae(ppmd,
-				addr, next, __phys_to_pfn(paddr), prot, flags);
-		if (ret)
-			goto error;
+		if (block_mappings && smmu_pmd_none_lpae(*ppmd) &&
+		    next - addr == SMMU_PMDIR_SIZE &&
+		    !(paddr & ~SMMU_PMDIR_MASK)) {
+			*ppmd = (u64)paddr | SMMU_PMD_BLOCK |
+				(hisi_smmu_pte_prot_lpae(prot) & ~SMMU_PTE_TYPE);
+			hisi_smmu_batch_add_lpae(batch, ppmd, ppmd + 1);
+			atomic64_inc(&smmu_stat_blocks);
+		} else {
+			ret = hisi_smmu_alloc_init_pte_lpae(ppmd, addr, next,
+					__phys_to_pfn(paddr), prot, flags, batch);
+			if (ret)
+				goto error;
+		}
 		paddr += (next - addr);
 		addr = next;
 	} while (ppmd++, addr < end);
@@ -310,9 +395,9 @@ error:
 	return ret;
 }
 
-int hisi_smmu_handle_mapping_lpae(struct iommu_domain *domain,
+static int __hisi_smmu_handle_mapping_lpae(struct iommu_domain *domain,
 		unsigned long iova, phys_addr_t paddr,
-		size_t size, int prot)
+		size_t size, int prot, struct hisi_smmu_flush_batch *batch)
 {
 	int ret;
 	unsigned long end;
@@ -331,7 +416,7 @@ int hisi_smmu_handle_mapping_lpae(struct iommu_domain *domain,
 	do {
 		next = smmu_pgd_addr_end_lpae(iova, end);
 		ret = hisi_smmu_alloc_init_pmd_lpae(pgd,
-				iova, next, paddr, prot, &flags);
+				iova, next, paddr, prot, &flags, batch);
 		if (ret)
 			goto out_unlock;
 		paddr += next - iova;
@@ -342,10 +427,17 @@ out_unlock:
 	return ret;
 }
 
-static int hisi_smmu_map_lpae(struct iommu_domain *domain,
-			      unsigned long iova,
-			      phys_addr_t paddr, size_t size,
-			      int prot)
+int hisi_smmu_handle_mapping_lpae(struct iommu_domain *domain,
+		unsigned long iova, phys_addr_t paddr,
+		size_t size, int prot)
+{
+	return __hisi_smmu_handle_mapping_lpae(domain, iova, paddr, size,
+			prot, NULL);
+}
+
+static int hisi_smmu_map_range_lpae(struct iommu_domain *domain,
+		unsigned long iova, phys_addr_t paddr, size_t size,
+		int prot, struct hisi_smmu_flush_batch *batch)
 {
 	unsigned long max_iova;
 	struct iommu_domain_data *data;
@@ -366,14 +458,24 @@ static int hisi_smmu_map_lpae(struct iommu_domain *domain,
 				iova+size, max_iova);
 		goto error;
 	}
-	return hisi_smmu_handle_mapping_lpae(domain, iova, paddr, size, prot);
+	return __hisi_smmu_handle_mapping_lpae(domain, iova, paddr, size,
+			prot, batch);
 error:
 	dbg("iova is not in this range\n");
 	return -EINVAL;
 }
 
+static int hisi_smmu_map_lpae(struct iommu_domain *domain,
+			      unsigned long iova,
+			      phys_addr_t paddr, size_t size,
+			      int prot)
+{
+	return hisi_smmu_map_range_lpae(domain, iova, paddr, size, prot, NULL);
+}
+
 static unsigned int hisi_smmu_clear_pte_lpae(smmu_pgd_t *pmdp,
-		unsigned int iova, unsigned int end)
+		unsigned int iova, unsigned int end,
+		struct hisi_smmu_flush_batch *batch)
 {
 	smmu_pte_t *ptep = NULL;
 	smmu_pte_t *ppte = NULL;
@@ -382,14 +484,18 @@ static unsigned int hisi_smmu_clear_pte_lpae(smmu_pgd_t *pmdp,
 	ptep = smmu_pte_page_vaddr_lpae(pmdp);
 	ppte = ptep + smmu_pte_index(iova);
 
-	if (!!size)
+	if (!!size) {
 		memset(ppte, 0x0, (size / SMMU_PAGE_SIZE) * sizeof(*ppte));
+		hisi_smmu_batch_add_lpae(batch, ppte,
+				ppte + size / SMMU_PAGE_SIZE);
+	}
 
 	return size;
 }
 
 static unsigned int hisi_smmu_clear_pmd_lpae(smmu_pgd_t *pgdp,
-		unsigned int iova, unsigned int end)
+		unsigned int iova, unsigned int end,
+		struct hisi_smmu_flush_batch *batch)
 {
 	smmu_pmd_t *pmdp = NULL;
 	smmu_pmd_t *ppmd = NULL;
@@ -400,7 +506,14 @@ static unsigned int hisi_smmu_clear_pmd_lpae(smmu_pgd_t *pgdp,
 	ppmd = pmdp + smmu_pmd_index(iova);
 	do {
 		next = smmu_pmd_addr_end_lpae(iova, end);
-		hisi_smmu_clear_pte_lpae(ppmd, iova, next);
+		if (smmu_pmd_block_lpae(*ppmd)) {
+			/* blocks are only made for ranges covering them */
+			WARN_ON(next - iova != SMMU_PMDIR_SIZE);
+			*ppmd = 0;
+			hisi_smmu_batch_add_lpae(batch, ppmd, ppmd + 1);
+		} else if (!smmu_pmd_none_lpae(*ppmd)) {
+			hisi_smmu_clear_pte_lpae(ppmd, iova, next, batch);
+		}
 		iova = next;
 		dbg("%s: iova=0x%lx, end=0x%lx\n", __func__, iova, end);
 	} while (ppmd++, iova < end);
@@ -411,6 +524,7 @@ static unsigned int hisi_smmu_clear_pmd_lpae(smmu_pgd_t *pgdp,
 unsigned int hisi_smmu_handle_unmapping_lpae(struct iommu_domain *domain,
 		unsigned long iova, size_t size)
 {
+	struct hisi_smmu_flush_batch batch = { NULL, NULL };
 	smmu_pgd_t *pgdp = NULL;
 	unsigned int end = 0;
 	unsigned int next = 0;
@@ -424,10 +538,12 @@ unsigned int hisi_smmu_handle_unmapping_lpae(struct iommu_domain *domain,
 	pgdp += smmu_pgd_index(iova);
 	do {
 		next = smmu_pgd_addr_end_lpae(iova, end);
-		unmap_size += hisi_smmu_clear_pmd_lpae(pgdp, iova, next);
+		unmap_size += hisi_smmu_clear_pmd_lpae(pgdp, iova, next,
+				&batch);
 		iova = next;
 		dbg("%s: pgdp=%pK, iova=0x%lx\n", __func__, pgdp, iova);
 	} while (pgdp++, iova < end);
+	hisi_smmu_batch_flush_lpae(&batch);
 
 	smmu_trace_hook(MEM_FREE, iova, (unsigned long long)0, unmap_size);
 	return unmap_size;
@@ -439,6 +555,7 @@ static size_t hisi_smmu_unmap_lpae(struct iommu_domain *domain,
 	unsigned long max_iova;
 	unsigned int ret;
 	struct iommu_domain_data *data;
+	ktime_t start;
 
 	if (!domain) {
 		dbg("domain is null\n");
@@ -456,7 +573,9 @@ static size_t hisi_smmu_unmap_lpae(struct iommu_domain *domain,
 		goto error;
 	}
 	/*unmapping the range of iova*/
+	start = ktime_get();
 	ret = hisi_smmu_handle_unmapping_lpae(domain, iova, size);
+	hisi_smmu_account_lpae(&smmu_unmap_stats, ret, start);
 	if (ret == size) {
 		dbg("%s:unmap size:0x%x\n", __func__, (unsigned int)size);
 		return size;
@@ -487,6 +606,9 @@ static phys_addr_t hisi_smmu_iova_to_phys_lpae(
 			smmu_pmd_index(iova));
 	if (smmu_pmd_none_lpae(pmd))
 		return 0;
+	if (smmu_pmd_block_lpae(pmd))
+		return (pmd & PAGE_TABLE_ADDR_MASK & SMMU_PMDIR_MASK) |
+			(iova & ~SMMU_PMDIR_MASK);
 
 	pte = *((u64 *)smmu_pte_page_vaddr_lpae(&pmd) + smmu_pte_index(iova));
 	if (smmu_pte_none_lpae(pte))
@@ -722,16 +844,26 @@ static size_t hisi_smmu_unmap_tile_lpae(struct iommu_domain *domain,
 size_t hisi_iommu_map_sg_lpae(struct iommu_domain *domain, unsigned long iova,
 			 struct scatterlist *sg, unsigned int nents, int prot)
 {
+	struct hisi_smmu_flush_batch batch = { NULL, NULL };
 	struct scatterlist *s;
+	phys_addr_t run_phys = 0;
+	size_t run_len = 0;
 	size_t mapped = 0;
 	unsigned int i, min_pagesz;
+	ktime_t start;
 	int ret;
 
 	if (domain->ops->pgsize_bitmap == 0UL)
 		return 0;
 
 	min_pagesz = (unsigned int)1 << __ffs(domain->ops->pgsize_bitmap);
+	start = ktime_get();
 
+	/*
+	 * Physically adjacent entries are mapped as one run, so that blocks
+	 * and contiguous ptes can span them, and the page table writes of
+	 * the whole list are cleaned to memory once at the end.
+	 */
 	for_each_sg(sg, s, nents, i) {
 		phys_addr_t phys = page_to_phys(sg_page(s)) + s->offset;
 
@@ -744,23 +876,98 @@ size_t hisi_iommu_map_sg_lpae(struct iommu_domain *domain, unsigned long iova,
 		if (!IS_ALIGNED(s->offset, min_pagesz))
 			goto out_err;
 
-		ret = hisi_smmu_map_lpae(domain, iova + mapped, phys,
-					(size_t)s->length, prot);
+		if (run_len && run_phys + run_len != phys) {
+			ret = hisi_smmu_map_range_lpae(domain, iova + mapped,
+					run_phys, run_len, prot, &batch);
+			if (ret)
+				goto out_err;
+			mapped += run_len;
+			run_len = 0;
+		}
+		if (!run_len)
+			run_phys = phys;
+		run_len += s->length;
+	}
+	if (run_len) {
+		ret = hisi_smmu_map_range_lpae(domain, iova + mapped,
+				run_phys, run_len, prot, &batch);
 		if (ret)
 			goto out_err;
-
-		mapped += s->length;
+		mapped += run_len;
 	}
+	hisi_smmu_batch_flush_lpae(&batch);
+	hisi_smmu_account_lpae(&smmu_map_stats, mapped, start);
 
 	return mapped;
 
 out_err:
+	hisi_smmu_batch_flush_lpae(&batch);
 	/* undo mappings already done */
 	hisi_smmu_unmap_lpae(domain, iova, mapped);
 
 	return 0;
 }
 
+#if defined(CONFIG_HISI_DEBUG_FS)
+static void smmu_stats_show_op(struct seq_file *s, const char *name,
+		struct hisi_smmu_op_stats *stats)
+{
+	u64 count = atomic64_read(&stats->count);
+	u64 ns = atomic64_read(&stats->ns);
+
+	seq_printf(s, "%-6s %10llu %14llu %10llu %10llu\n", name, count,
+		   (u64)atomic64_read(&stats->bytes),
+		   count ? div64_u64(ns, count * NSEC_PER_USEC) : 0,
+		   div64_u64(stats->max_ns, NSEC_PER_USEC));
+}
+
+static int smmu_stats_show(struct seq_file *s, void *unused)
+{
+	seq_printf(s, "%-6s %10s %14s %10s %10s\n",
+		   "op", "calls", "bytes", "avg_us", "max_us");
+	smmu_stats_show_op(s, "map_sg", &smmu_map_stats);
+	smmu_stats_show_op(s, "unmap", &smmu_unmap_stats);
+	seq_printf(s, "blocks_2m %llu cont_64k %llu flushes %llu\n",
+		   (u64)atomic64_read(&smmu_stat_blocks),
+		   (u64)atomic64_read(&smmu_stat_cont),
+		   (u64)atomic64_read(&smmu_stat_flushes));
+	return 0;
+}
+
+static int smmu_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, smmu_stats_show, NULL);
+}
+
+static void smmu_stats_reset_op(struct hisi_smmu_op_stats *stats)
+{
+	atomic64_set(&stats->count, 0);
+	atomic64_set(&stats->bytes, 0);
+	atomic64_set(&stats->ns, 0);
+	stats->max_ns = 0;
+}
+
+/* any write starts a new measurement */
+static ssize_t smmu_stats_write(struct file *file, const char __user *buf,
+		size_t count, loff_t *ppos)
+{
+	smmu_stats_reset_op(&smmu_map_stats);
+	smmu_stats_reset_op(&smmu_unmap_stats);
+	atomic64_set(&smmu_stat_blocks, 0);
+	atomic64_set(&smmu_stat_cont, 0);
+	atomic64_set(&smmu_stat_flushes, 0);
+	return count;
+}
+
+static const struct file_operations smmu_stats_fops = {
+	.open		= smmu_stats_open,
+	.read		= seq_read,
+	.write		= smmu_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+#endif
+
 static struct iommu_ops hisi_smmu_ops = {
 	.domain_alloc	= hisi_smmu_domain_alloc_lpae,
 	.domain_free	= hisi_smmu_domain_free_lpae,
@@ -778,6 +985,9 @@ static struct iommu_ops hisi_smmu_ops = {
 static int hisi_smmu_probe_lpae(struct platform_device *pdev)
 {
 	struct device *dev = &pdev->dev;
+#if defined(CONFIG_HISI_DEBUG_FS)
+	struct dentry *debugfs_root;
+#endif
 
 	dbg("enter %s\n", __func__);
 	hisi_smmu_dev = devm_kzalloc(dev,
@@ -798,6 +1008,12 @@ static int hisi_smmu_probe_lpae(struct platform_device *pdev)
 
 	hisi_smmu_dev->va_pgtable_addr = (unsigned long)(hisi_smmu_dev->smmu_pgd);
 	bus_set_iommu(&platform_bus_type, &hisi_smmu_ops);
+#if defined(CONFIG_HISI_DEBUG_FS)
+	debugfs_root = debugfs_create_dir("hisi_smmu", NULL);
+	if (debugfs_root)
+		debugfs_create_file("stats", S_IRUSR | S_IWUSR, debugfs_root,
+				    NULL, &smmu_stats_fops);
+#endif
 	return 0;
 
 smmu_device_error:
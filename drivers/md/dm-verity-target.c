@@ -60,6 +60,8 @@ static unsigned long err_count;
 
 #define DM_VERITY_MAX_CORRUPTED_ERRS	100
 
+#define DM_VERITY_MAX_PINNED_BLOCKS	256
+
 #define DM_VERITY_OPT_LOGGING		"ignore_corruption"
 #define DM_VERITY_OPT_RESTART		"restart_on_corruption"
 #define DM_VERITY_OPT_IGN_ZEROES	"ignore_zero_blocks"
@@ -93,6 +95,16 @@ struct buffer_aux {
 	int hash_verified;
 };
 
+/*
+ * Level 0 hash block held across the data blocks of one io, most of
+ * which are covered by the same hash block.
+ */
+struct verity_hash_cursor {
+	struct dm_buffer *buf;
+	sector_t hash_block;
+	u8 *data;
+};
+
 /*
  * Initialize struct buffer_aux for a freshly created buffer.
  */
@@ -590,6 +602,62 @@ out:
 	return r;
 }
 
+static void verity_hash_cursor_release(struct verity_hash_cursor *hc)
+{
+	if (hc->buf)
+		dm_bufio_release(hc->buf);
+	hc->buf = NULL;
+}
+
+/*
+ * Like verity_hash_for_block(), but once the level 0 hash block of an io
+ * has been verified, the digests of the following data blocks are copied
+ * straight out of it instead of going through dm-bufio for each one.
+ */
+static int verity_hash_for_block_cached(struct dm_verity *v,
+					struct dm_verity_io *io,
+					struct verity_hash_cursor *hc,
+					sector_t block, u8 *digest,
+					bool *is_zero)
+{
+	struct dm_buffer *buf;
+	struct buffer_aux *aux;
+	sector_t hash_block;
+	unsigned offset;
+	u8 *data;
+	int r;
+
+	if (unlikely(!v->levels))
+		return verity_hash_for_block(v, io, block, digest, is_zero);
+
+	verity_hash_at_level(v, block, 0, &hash_block, &offset);
+	if (hc->buf && hc->hash_block == hash_block) {
+		memcpy(digest, hc->data + offset, v->digest_size);
+		*is_zero = v->zero_digest &&
+			   !memcmp(v->zero_digest, digest, v->digest_size);
+		return 0;
+	}
+
+	/* dm_bufio_read() callers must not hold other buffers */
+	verity_hash_cursor_release(hc);
+	r = verity_hash_for_block(v, io, block, digest, is_zero);
+	if (unlikely(r))
+		return r;
+
+	data = dm_bufio_get(v->bufio, hash_block, &buf);
+	if (IS_ERR_OR_NULL(data))
+		return 0;
+	aux = dm_bufio_get_aux_data(buf);
+	if (!aux->hash_verified) {
+		dm_bufio_release(buf);
+		return 0;
+	}
+	hc->buf = buf;
+	hc->hash_block = hash_block;
+	hc->data = data;
+	return 0;
+}
+
 /*
  * Calls function process for 1 << v->data_dev_block_bits bytes in the bio_vec
  * starting from iter.
@@ -644,7 +712,8 @@ static int verity_bv_zero(struct dm_verity *v, struct dm_verity_io *io,
 /*
  * Verify one "dm_verity_io" structure.
  */
-static int verity_verify_io(struct dm_verity_io *io)
+static int __verity_verify_io(struct dm_verity_io *io,
+			      struct verity_hash_cursor *hc)
 {
 	bool is_zero;
 	struct dm_verity *v = io->v;
@@ -663,9 +732,9 @@ static int verity_verify_io(struct dm_verity_io *io)
 		retry_count = 0;
 
 LABEL:
-		r = verity_hash_for_block(v, io, io->block + b,
-					  verity_io_want_digest(v, io),
-					  &is_zero);
+		r = verity_hash_for_block_cached(v, io, hc, io->block + b,
+						 verity_io_want_digest(v, io),
+						 &is_zero);
 		if (unlikely(r < 0))
 			return r;
 
@@ -717,6 +786,7 @@ LABEL:
 				/* else ce hash success */
 		} else {
 				/* hash fail */
+				verity_hash_cursor_release(hc);
 				retry_count ++;
 				if (retry_count == 1)
 					goto LABEL;
@@ -757,6 +827,16 @@ LABEL:
 	return 0;
 }
 
+static int verity_verify_io(struct dm_verity_io *io)
+{
+	struct verity_hash_cursor hc = { .buf = NULL };
+	int r;
+
+	r = __verity_verify_io(io, &hc);
+	verity_hash_cursor_release(&hc);
+	return r;
+}
+
 /*
  * End one "io" structure with a given error.
  */
@@ -789,6 +869,7 @@ static void verity_end_io(struct bio *bio, int error)
 		return;
 	}
 
+	/* verify on the cpu that completed the I/O, its caches are warm */
 	INIT_WORK(&io->work, verity_work);
 	queue_work(io->v->verify_wq, &io->work);
 }
@@ -833,6 +914,51 @@ no_prefetch_cluster:
 	kfree(pw);
 }
 
+/*
+ * Every data block lookup walks the upper tree levels until it meets a
+ * verified block, so keep them out of reach of dm-bufio's reclaim: read
+ * them once and hold them until the target goes away. They come first on
+ * the hash device, topmost level first, and only the first
+ * DM_VERITY_MAX_PINNED_BLOCKS are held on very large devices.
+ */
+static void verity_pin_upper_levels(struct work_struct *work)
+{
+	struct dm_verity *v = container_of(work, struct dm_verity, pin_work);
+	sector_t start = v->hash_start;
+	unsigned i, n;
+
+	if (v->levels < 2)
+		return;
+	n = min_t(sector_t, v->hash_level_block[0] - start,
+		  DM_VERITY_MAX_PINNED_BLOCKS);
+
+	v->pinned = kcalloc(n, sizeof(*v->pinned), GFP_KERNEL);
+	if (!v->pinned)
+		return;
+
+	/*
+	 * Only dm_bufio_get() may hold any number of buffers, so read them in
+	 * with a prefetch and take what made it into the cache.
+	 */
+	dm_bufio_prefetch(v->bufio, start, n);
+	for (i = 0; i < n; i++) {
+		struct dm_buffer *buf;
+		u8 *data = dm_bufio_get(v->bufio, start + i, &buf);
+
+		if (IS_ERR_OR_NULL(data))
+			continue;
+		v->pinned[v->n_pinned++] = buf;
+	}
+}
+
+static void verity_unpin_upper_levels(struct dm_verity *v)
+{
+	while (v->n_pinned)
+		dm_bufio_release(v->pinned[--v->n_pinned]);
+	kfree(v->pinned);
+	v->pinned = NULL;
+}
+
 static void verity_submit_prefetch(struct dm_verity *v, struct dm_verity_io *io)
 {
 	struct dm_verity_prefetch_work *pw;
@@ -1023,6 +1149,8 @@ void verity_dtr(struct dm_target *ti)
 	if (v->verify_wq)
 		destroy_workqueue(v->verify_wq);
 
+	verity_unpin_upper_levels(v);
+
 	if (v->vec_mempool)
 		mempool_destroy(v->vec_mempool);
 
@@ -1391,14 +1519,20 @@ int verity_ctr(struct dm_target *ti, unsigned argc, char **argv)
 		goto bad;
 	}
 
-	/* WQ_UNBOUND greatly improves performance when running on ramdisk */
-	v->verify_wq = alloc_workqueue("kverityd", WQ_CPU_INTENSIVE | WQ_MEM_RECLAIM | WQ_UNBOUND, num_online_cpus());
+	/*
+	 * Bound, so that verification runs on the cpu that completed the
+	 * I/O, where the data and the hash blocks it just touched are cached.
+	 */
+	v->verify_wq = alloc_workqueue("kverityd", WQ_CPU_INTENSIVE | WQ_MEM_RECLAIM | WQ_HIGHPRI, num_online_cpus());
 	if (!v->verify_wq) {
 		ti->error = "Cannot allocate workqueue";
 		r = -ENOMEM;
 		goto bad;
 	}
 
+	INIT_WORK(&v->pin_work, verity_pin_upper_levels);
+	queue_work(v->verify_wq, &v->pin_work);
+
 	ti->per_bio_data_size = sizeof(struct dm_verity_io) +
 				v->shash_descsize + v->digest_size * 2;
 
@@ -63,6 +63,11 @@ struct dm_verity {
 
 	struct workqueue_struct *verify_wq;
 
+	/* upper tree levels held in dm-bufio for the life of the target */
+	struct work_struct pin_work;
+	struct dm_buffer **pinned;
+	unsigned n_pinned;
+
 	/* starting blocks for each tree level. 0 is the lowest level. */
 	sector_t hash_level_block[DM_VERITY_MAX_LEVELS];
 
@@ -299,6 +299,7 @@ static int mmc_blk_cmdq_issue_rw_rq(struct mmc_queue *mq, struct request *req)
 
 void mmc_blk_cmdq_dcmd_done(struct mmc_request *mrq)
 {
+	mmc_cmdq_account(mrq->host, mrq->cmdq_req);
 	complete(&mrq->cmdq_completion);
 }
 
@@ -541,7 +542,6 @@ static int mmc_blk_cmdq_issue_discard_rq(struct mmc_queue *mq, struct request *r
 	err = mmc_cmdq_erase(card, mq, req, from, nr, arg);
 
 out:
-	blk_complete_request(req);
 	return err;
 }
 
@@ -626,18 +626,11 @@ static int mmc_blk_cmdq_issue_secdiscard_rq(struct mmc_queue *mq,
 	}
 
 out:
-	blk_complete_request(req);
-
-	return err ? 0 : 1;
+	return err;
 }
 
-/*
- * Issues a dcmd request
- * FIXME:
- *	Try to pull another request from queue and prepare it in the
- *	meantime. If its not a dcmd it can be issued as well.
- */
-int mmc_blk_cmdq_issue_flush_rq(struct mmc_queue *mq, struct request *req)
+static int __mmc_blk_cmdq_issue_flush_rq(struct mmc_queue *mq,
+					 struct request *req, bool wait)
 {
 	int err;
 	struct mmc_queue_req *active_mqrq;
@@ -691,11 +684,98 @@ int mmc_blk_cmdq_issue_flush_rq(struct mmc_queue *mq, struct request *req)
 	if (err)
 		return err;
 
+	if (wait)
+		return mmc_blk_cmdq_wait_for_dcmd(card->host, cmdq_req);
+
 	err = mmc_blk_cmdq_start_req(card->host, cmdq_req);
 	return err;
 }
+
+/*
+ * Issues a dcmd request
+ * FIXME:
+ *	Try to pull another request from queue and prepare it in the
+ *	meantime. If its not a dcmd it can be issued as well.
+ */
+int mmc_blk_cmdq_issue_flush_rq(struct mmc_queue *mq, struct request *req)
+{
+	return __mmc_blk_cmdq_issue_flush_rq(mq, req, false);
+}
 EXPORT_SYMBOL(mmc_blk_cmdq_issue_flush_rq);
 
+/* discards and flushes issued back to back under one queue barrier */
+#define MMC_CMDQ_DCMD_BATCH	8
+
+/*
+ * Takes the request at the head of the queue if it can join the DCMD
+ * batch. Nothing else is pulled meanwhile since active_dcmd is set.
+ */
+static struct request *mmc_blk_cmdq_next_dcmd(struct mmc_queue *mq)
+{
+	struct mmc_cmdq_context_info *ctx_info = &mq->card->host->cmdq_ctx;
+	struct request_queue *q = mq->queue;
+	struct request *req;
+	bool rpmb_in_wait;
+
+	spin_lock_bh(&ctx_info->cmdq_ctx_lock);
+	rpmb_in_wait = ctx_info->rpmb_in_wait;
+	spin_unlock_bh(&ctx_info->cmdq_ctx_lock);
+	if (rpmb_in_wait)
+		return NULL;
+
+	spin_lock_irq(q->queue_lock);
+	req = blk_peek_request(q);
+	if (req && (!(req->cmd_flags & MMC_REQ_SPECIAL_MASK) ||
+		    blk_queue_start_tag(q, req)))
+		req = NULL;
+	spin_unlock_irq(q->queue_lock);
+
+	return req;
+}
+
+static int mmc_blk_cmdq_issue_dcmd_rq(struct mmc_queue *mq,
+				      struct request *req)
+{
+	struct mmc_card *card = mq->card;
+
+	if (!(req->cmd_flags & REQ_DISCARD))
+		return __mmc_blk_cmdq_issue_flush_rq(mq, req, true);
+
+	if (req->cmd_flags & REQ_SECURE &&
+	    !(card->quirks & MMC_QUIRK_SEC_ERASE_TRIM_BROKEN))
+		return mmc_blk_cmdq_issue_secdiscard_rq(mq, req);
+
+	return mmc_blk_cmdq_issue_discard_rq(mq, req);
+}
+
+/*
+ * Every DCMD drains the queue first, issuing the discards and flushes
+ * already queued behind a discard right away pays for the drain once.
+ * The requests complete together when the batch is done.
+ */
+static int mmc_blk_cmdq_issue_dcmd_batch(struct mmc_queue *mq,
+					 struct request *req)
+{
+	struct request *batch[MMC_CMDQ_DCMD_BATCH];
+	ktime_t start = ktime_get();
+	int nr = 0;
+	int err;
+	int i;
+
+	do {
+		err = mmc_blk_cmdq_issue_dcmd_rq(mq, req);
+		batch[nr++] = req;
+	} while (!err && nr < MMC_CMDQ_DCMD_BATCH &&
+		 (req = mmc_blk_cmdq_next_dcmd(mq)));
+
+	for (i = 0; i < nr; i++)
+		blk_complete_request(batch[i]);
+	mmc_cmdq_account_batch(mq->card->host, nr, start);
+
+	/* only the first request may be requeued by the caller */
+	return nr == 1 ? err : 0;
+}
+
 /* invoked by block layer in softirq context */
 void mmc_blk_cmdq_complete_rq(struct request *rq)
 {
@@ -761,6 +841,7 @@ void mmc_blk_cmdq_req_done(struct mmc_request *mrq)
 {
 	struct request *req = mrq->req;
 
+	mmc_cmdq_account(mrq->host, mrq->cmdq_req);
 	blk_complete_request(req);
 }
 EXPORT_SYMBOL(mmc_blk_cmdq_req_done);
@@ -817,11 +898,7 @@ int mmc_blk_cmdq_issue_rq(struct mmc_queue *mq, struct request *req)
 	}
 
 	if (cmd_flags & REQ_DISCARD) {
-		 if (req->cmd_flags & REQ_SECURE &&
-			!(card->quirks & MMC_QUIRK_SEC_ERASE_TRIM_BROKEN))
-			ret = mmc_blk_cmdq_issue_secdiscard_rq(mq, req);
-		 else
-			ret = mmc_blk_cmdq_issue_discard_rq(mq, req);
+		ret = mmc_blk_cmdq_issue_dcmd_batch(mq, req);
 	} else if (cmd_flags & REQ_FLUSH) {
 		ret = mmc_blk_cmdq_issue_flush_rq(mq, req);
 	} else {
@@ -435,6 +435,82 @@ static const struct file_operations mmc_dbg_test_st_fops = {
 };
 #endif
 
+#ifdef CONFIG_MMC_CQ_HCI
+static void mmc_cmdq_lat_show(struct seq_file *s, const char *name,
+			      struct mmc_cmdq_lat *lat)
+{
+	seq_printf(s, "%-8s %10llu %10llu %10llu\n", name, lat->cnt,
+		   lat->cnt ? div64_u64(lat->sum_us, lat->cnt) : 0,
+		   lat->max_us);
+}
+
+static int mmc_cmdq_stats_show(struct seq_file *s, void *data)
+{
+	static const char * const names[MMC_CMDQ_LAT_NR] = {
+		[MMC_CMDQ_LAT_READ] = "read",
+		[MMC_CMDQ_LAT_WRITE] = "write",
+		[MMC_CMDQ_LAT_DCMD] = "dcmd",
+	};
+	struct mmc_card *card = s->private;
+	struct mmc_cmdq_stats *stats, *snap;
+	unsigned long flags;
+	char name[8];
+	int i;
+
+	snap = kmalloc(sizeof(*snap), GFP_KERNEL);
+	if (!snap)
+		return -ENOMEM;
+
+	stats = &card->host->cmdq_ctx.stats;
+	spin_lock_irqsave(&stats->lock, flags);
+	memcpy(snap->lat, stats->lat, sizeof(snap->lat));
+	memcpy(snap->tag_lat, stats->tag_lat, sizeof(snap->tag_lat));
+	snap->batch = stats->batch;
+	snap->batched = stats->batched;
+	spin_unlock_irqrestore(&stats->lock, flags);
+
+	seq_printf(s, "%-8s %10s %10s %10s\n", "", "count", "mean(us)",
+		   "max(us)");
+	for (i = 0; i < MMC_CMDQ_LAT_NR; i++)
+		mmc_cmdq_lat_show(s, names[i], &snap->lat[i]);
+	for (i = 0; i < MMC_CMDQ_MAX_TAGS; i++) {
+		if (!snap->tag_lat[i].cnt)
+			continue;
+		snprintf(name, sizeof(name), "tag%d", i);
+		mmc_cmdq_lat_show(s, name, &snap->tag_lat[i]);
+	}
+	mmc_cmdq_lat_show(s, "batch", &snap->batch);
+	seq_printf(s, "batched requests: %llu\n", snap->batched);
+
+	kfree(snap);
+	return 0;
+}
+
+static int mmc_cmdq_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mmc_cmdq_stats_show, inode->i_private);
+}
+
+/* any write resets the statistics */
+static ssize_t mmc_cmdq_stats_write(struct file *filp,
+				    const char __user *ubuf, size_t cnt,
+				    loff_t *ppos)
+{
+	struct mmc_card *card = file_inode(filp)->i_private;
+
+	mmc_cmdq_stats_reset(card->host);
+	return cnt;
+}
+
+static const struct file_operations mmc_dbg_cmdq_stats_fops = {
+	.open		= mmc_cmdq_stats_open,
+	.read		= seq_read,
+	.write		= mmc_cmdq_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+#endif
+
 void mmc_add_card_debugfs(struct mmc_card *card)
 {
 	struct mmc_host	*host = card->host;
@@ -480,6 +556,13 @@ void mmc_add_card_debugfs(struct mmc_card *card)
 					&mmc_sdxc_fops))
 			goto err;
 
+#ifdef CONFIG_MMC_CQ_HCI
+	if (mmc_card_mmc(card) && card->ext_csd.cmdq_support)
+		if (!debugfs_create_file("cmdq_stats", S_IRUSR | S_IWUSR, root,
+					 card, &mmc_dbg_cmdq_stats_fops))
+			goto err;
+#endif
+
 #ifdef CONFIG_HW_MMC_TEST
     if (mmc_card_mmc(card))
         if (!debugfs_create_file("card_addr", S_IRUSR, root, card,
@@ -81,11 +81,84 @@ int mmc_start_cmdq_request(struct mmc_host *host,
 	mmc_host_clk_hold(host);
 	led_trigger_event(host->led, LED_FULL);
 
+	if (mrq->cmdq_req)
+		mrq->cmdq_req->issue_time = ktime_get();
 	ret = host->cmdq_ops->request(host, mrq);
 	return ret;
 }
 EXPORT_SYMBOL(mmc_start_cmdq_request);
 
+static void mmc_cmdq_lat_add(struct mmc_cmdq_lat *lat, u64 us)
+{
+	lat->cnt++;
+	lat->sum_us += us;
+	if (us > lat->max_us)
+		lat->max_us = us;
+}
+
+/**
+ *	mmc_cmdq_account - account a completed cmdq request
+ *	@host: host instance
+ *	@cmdq_req: the request, from its completion irq
+ */
+void mmc_cmdq_account(struct mmc_host *host, struct mmc_cmdq_req *cmdq_req)
+{
+	struct mmc_cmdq_stats *stats = &host->cmdq_ctx.stats;
+	enum mmc_cmdq_lat_type type;
+	unsigned long flags;
+	u64 us;
+
+	if (!ktime_to_ns(cmdq_req->issue_time))
+		return;
+
+	us = ktime_us_delta(ktime_get(), cmdq_req->issue_time);
+	if (cmdq_req->cmdq_req_flags & DCMD)
+		type = MMC_CMDQ_LAT_DCMD;
+	else if (cmdq_req->cmdq_req_flags & DIR)
+		type = MMC_CMDQ_LAT_READ;
+	else
+		type = MMC_CMDQ_LAT_WRITE;
+
+	spin_lock_irqsave(&stats->lock, flags);
+	mmc_cmdq_lat_add(&stats->lat[type], us);
+	if (cmdq_req->tag >= 0 && cmdq_req->tag < MMC_CMDQ_MAX_TAGS)
+		mmc_cmdq_lat_add(&stats->tag_lat[cmdq_req->tag], us);
+	spin_unlock_irqrestore(&stats->lock, flags);
+}
+EXPORT_SYMBOL(mmc_cmdq_account);
+
+/**
+ *	mmc_cmdq_account_batch - account a batch of DCMD requests
+ *	@host: host instance
+ *	@nr: requests in the batch
+ *	@start: when pulling new requests was stopped for the batch
+ */
+void mmc_cmdq_account_batch(struct mmc_host *host, int nr, ktime_t start)
+{
+	struct mmc_cmdq_stats *stats = &host->cmdq_ctx.stats;
+	unsigned long flags;
+
+	spin_lock_irqsave(&stats->lock, flags);
+	mmc_cmdq_lat_add(&stats->batch, ktime_us_delta(ktime_get(), start));
+	stats->batched += nr;
+	spin_unlock_irqrestore(&stats->lock, flags);
+}
+EXPORT_SYMBOL(mmc_cmdq_account_batch);
+
+void mmc_cmdq_stats_reset(struct mmc_host *host)
+{
+	struct mmc_cmdq_stats *stats = &host->cmdq_ctx.stats;
+	unsigned long flags;
+
+	spin_lock_irqsave(&stats->lock, flags);
+	memset(stats->lat, 0, sizeof(stats->lat));
+	memset(stats->tag_lat, 0, sizeof(stats->tag_lat));
+	memset(&stats->batch, 0, sizeof(stats->batch));
+	stats->batched = 0;
+	spin_unlock_irqrestore(&stats->lock, flags);
+}
+EXPORT_SYMBOL(mmc_cmdq_stats_reset);
+
 /**
  *	mmc_cmdq_post_req - post process of a completed request
  *	@host: host instance
@@ -44,6 +44,8 @@
 
 #define ISP_BASEADDR    (HISI_RESERVED_ISP_BOOT_PHYMEM_BASE)
 #define DTS_COMP_NAME   "hisilicon,isp"
+/* ISP memory and mappings are held this long after camera close */
+#define ISP_MEM_KEEP_MS (5000)
 
 extern void hisi_secisp_dump(void);
 typedef	unsigned int mbox_msg_t;
@@ -488,6 +490,7 @@ int vaddr_to_sgl(struct rproc *rproc, void **vaddr,
 
 	r_page->va = (void *)pages;
 	r_page->num = npages;
+	r_page->vaddr = *vaddr;
 	list_add_tail(&r_page->node, &rproc->pages);
 	pr_info("%s:len = 0x%x, length = 0x%x \n", __func__, len, length);
 	return 0;
@@ -532,7 +535,7 @@ int rproc_handle_dynamic_memory(struct rproc *rproc,
 										struct fw_rsc_dynamic_memory *rsc,
 										int offset, int avail)
 {
-	struct rproc_mem_entry *dynamic_mem, *mapping;
+	struct rproc_mem_entry *dynamic_mem, *mapping, *kept;
 	struct rproc_cache_entry *cache_entry;
 	struct device *dev = &rproc->dev;
 	struct sg_table *table;
@@ -559,6 +562,15 @@ int rproc_handle_dynamic_memory(struct rproc *rproc,
 		return -ENOMEM;
 	}
 
+	/* pages and mapping still there from the last camera session */
+	kept = rproc_reuse_dynamic_memory(rproc, rsc->da, rsc->len);
+	if (kept) {
+		cache_entry->va = kept->va;
+		cache_entry->len = rsc->len;
+		list_add_tail(&cache_entry->node, &rproc->caches);
+		return 0;
+	}
+
 	dynamic_mem = kzalloc(sizeof(*dynamic_mem), GFP_KERNEL);
 	if (!dynamic_mem) {
 		dev_err(dev, "kzalloc dynamic_mem failed\n");
@@ -2211,6 +2223,8 @@ static int hisi_rproc_probe(struct platform_device *pdev)
 
     hisi_rproc->ipc_addr = data->ipc_addr;
 	hisi_rproc->has_iommu = true;
+	if (of_property_read_u32(np, "hisilicon,mem-keep-ms", &hisi_rproc->mem_keep_ms) < 0)
+		hisi_rproc->mem_keep_ms = ISP_MEM_KEEP_MS;
 	RPROC_INFO("hisi_rproc.%p, priv.%p, ipc_addr = 0x%x\n",
                         hisi_rproc, hisi_rproc->priv, hisi_rproc->ipc_addr);
 
@@ -134,10 +134,59 @@ static void rproc_disable_iommu(struct rproc *rproc)
 
 	iommu_detach_device(domain, dev);
 	iommu_domain_free(domain);
+	rproc->domain = NULL;
 
 	return;
 }
 
+/*
+ * Look for memory kept from the previous session at the same device
+ * address and size. On a hit the entry, its pages and its iommu mapping
+ * go back onto the live lists, so neither the allocation nor the mapping
+ * has to be redone. Kept memory is only cleared here, when it is reused.
+ */
+static struct rproc_mem_entry *rproc_reuse_kept(struct rproc *rproc,
+				struct list_head *kept, struct list_head *live,
+				u32 da, u32 len)
+{
+	struct rproc_mem_entry *entry, *mapping;
+	struct rproc_page *page;
+
+	list_for_each_entry(entry, kept, node) {
+		if (entry->da != da || entry->len != len)
+			continue;
+
+		list_move_tail(&entry->node, live);
+
+		list_for_each_entry(mapping, &rproc->kept_mappings, node) {
+			if (mapping->da == da && mapping->len == len) {
+				list_move_tail(&mapping->node, &rproc->mappings);
+				break;
+			}
+		}
+
+		list_for_each_entry(page, &rproc->kept_pages, node) {
+			if (page->vaddr == entry->va) {
+				list_move_tail(&page->node, &rproc->pages);
+				break;
+			}
+		}
+
+		memset(entry->va, 0, len);
+		return entry;
+	}
+
+	return NULL;
+}
+
+struct rproc_mem_entry *rproc_reuse_dynamic_memory(struct rproc *rproc,
+							u32 da, u32 len)
+{
+	return rproc_reuse_kept(rproc, &rproc->kept_dynamic_mems,
+				&rproc->dynamic_mems, da, len);
+}
+EXPORT_SYMBOL(rproc_reuse_dynamic_memory);
+
 /*
  * Some remote processors will ask us to allocate them physically contiguous
  * memory regions (which we call "carveouts"), and map them to specific
@@ -575,6 +624,15 @@ static int rproc_handle_carveout(struct rproc *rproc,
 	dev_dbg(dev, "carveout rsc: da %x, pa %x, len %x, flags %x\n",
 			rsc->da, rsc->pa, rsc->len, rsc->flags);
 
+	carveout = rproc_reuse_kept(rproc, &rproc->kept_carveouts,
+				&rproc->carveouts, rsc->da, rsc->len);
+	if (carveout) {
+		dev_dbg(dev, "carveout da %x reused from last session\n",
+								rsc->da);
+		rsc->pa = carveout->dma;
+		return 0;
+	}
+
 	carveout = kzalloc(sizeof(*carveout), GFP_KERNEL);
 	if (!carveout) {
 		dev_err(dev, "kzalloc carveout failed\n");
@@ -748,64 +806,36 @@ static int rproc_handle_resources(struct rproc *rproc, int len,
 	return ret;
 }
 
-/**
- * rproc_resource_cleanup() - clean up and free all acquired resources
- * @rproc: rproc handle
- *
- * This function will free all resources acquired for @rproc, and it
- * is called whenever @rproc either shuts down or fails to boot.
+/*
+ * free carveouts, dynamic memory and its pages, and drop their iommu
+ * mappings; used both for the live lists and for the kept ones
  */
-void rproc_resource_cleanup(struct rproc *rproc)
+static void rproc_free_memory(struct rproc *rproc, struct list_head *carveouts,
+			struct list_head *dynamic_mems, struct list_head *pages,
+			struct list_head *mappings)
 {
 	struct rproc_mem_entry *entry, *tmp;
 	struct rproc_page *page_entry, *page_tmp;
-	struct rproc_cache_entry *cache_entry, *cache_tmp;
 	struct device *dev = &rproc->dev;
 	struct page **tmp_page;
 	int i;
 
-	/* clean up debugfs trace entries */
-	list_for_each_entry_safe(entry, tmp, &rproc->traces, node) {
-		rproc_remove_trace_file(entry->priv);
-		rproc->num_traces--;
-		list_del(&entry->node);
-		kfree(entry);
-	}
-
-	/* clean up debugfs cda entries */
-	list_for_each_entry_safe(entry, tmp, &rproc->cdas, node) {
-		rproc_remove_trace_file(entry->priv);
-		rproc->num_cdas--;
-		list_del(&entry->node);
-		kfree(entry);
-	}
-
 	/* clean up carveout allocations */
-	list_for_each_entry_safe(entry, tmp, &rproc->carveouts, node) {
+	list_for_each_entry_safe(entry, tmp, carveouts, node) {
 		dma_free_coherent(dev->parent, entry->len, entry->va, entry->dma);
 		list_del(&entry->node);
 		kfree(entry);
 	}
 
-	/* clean up reserved allocations */
-	list_for_each_entry_safe(entry, tmp, &rproc->reserved_mems, node) {
-        if (use_nonsec_isp())
-            ;
-        else
-            iounmap(entry->va);
-		list_del(&entry->node);
-		kfree(entry);
-	}
-
 	/* clean up dynamic allocations */
-	list_for_each_entry_safe(entry, tmp, &rproc->dynamic_mems, node) {
+	list_for_each_entry_safe(entry, tmp, dynamic_mems, node) {
 		vunmap(entry->va);
 		list_del(&entry->node);
 		kfree(entry);
 	}
 
 	/* free page */
-	list_for_each_entry_safe(page_entry, page_tmp, &rproc->pages, node) {
+	list_for_each_entry_safe(page_entry, page_tmp, pages, node) {
 		i = 0;
 		tmp_page = (struct page **)page_entry->va;
 		while (NULL != tmp_page && i < page_entry->num) {
@@ -821,18 +851,8 @@ void rproc_resource_cleanup(struct rproc *rproc)
 		kfree(page_entry);
 	}
 
-	/* clean up cache entry */
-	list_for_each_entry_safe(cache_entry, cache_tmp, &rproc->caches, node) {
-		list_del(&cache_entry->node);
-		kfree(cache_entry);
-	}
-
-	/* reset the share parameter pointer */
-	if (!use_sec_isp())
-		isp_share_para = NULL;
-
 	/* clean up iommu mapping entries */
-	list_for_each_entry_safe(entry, tmp, &rproc->mappings, node) {
+	list_for_each_entry_safe(entry, tmp, mappings, node) {
 		size_t unmapped;
 
 		unmapped = iommu_unmap(rproc->domain, entry->da, entry->len);
@@ -846,6 +866,121 @@ void rproc_resource_cleanup(struct rproc *rproc)
 	}
 }
 
+static bool rproc_mem_is_kept(struct rproc *rproc, u32 da, u32 len)
+{
+	struct rproc_mem_entry *entry;
+
+	list_for_each_entry(entry, &rproc->kept_carveouts, node)
+		if (entry->da == da && entry->len == len)
+			return true;
+
+	list_for_each_entry(entry, &rproc->kept_dynamic_mems, node)
+		if (entry->da == da && entry->len == len)
+			return true;
+
+	return false;
+}
+
+/*
+ * Set the carveouts and dynamic memory of a stopped rproc aside together
+ * with their mappings, so that the next boot finds them ready instead of
+ * going back to CMA and the page allocator. The domain stays attached
+ * until mem_release_work gives everything back.
+ */
+static void rproc_keep_memory(struct rproc *rproc)
+{
+	struct rproc_mem_entry *entry, *tmp;
+
+	list_splice_tail_init(&rproc->carveouts, &rproc->kept_carveouts);
+	list_splice_tail_init(&rproc->dynamic_mems, &rproc->kept_dynamic_mems);
+	list_splice_tail_init(&rproc->pages, &rproc->kept_pages);
+
+	/* the other mappings (reserved memory) are redone on every boot */
+	list_for_each_entry_safe(entry, tmp, &rproc->mappings, node) {
+		if (rproc_mem_is_kept(rproc, entry->da, entry->len))
+			list_move_tail(&entry->node, &rproc->kept_mappings);
+	}
+
+	rproc->domain_kept = true;
+	schedule_delayed_work(&rproc->mem_release_work,
+				msecs_to_jiffies(rproc->mem_keep_ms));
+}
+
+static void rproc_release_kept_memory(struct rproc *rproc)
+{
+	rproc_free_memory(rproc, &rproc->kept_carveouts,
+			&rproc->kept_dynamic_mems, &rproc->kept_pages,
+			&rproc->kept_mappings);
+}
+
+static void rproc_mem_release_work(struct work_struct *work)
+{
+	struct rproc *rproc = container_of(to_delayed_work(work),
+					struct rproc, mem_release_work);
+
+	mutex_lock(&rproc->lock);
+	/* a boot in the meantime has taken the domain back */
+	if (rproc->domain_kept) {
+		rproc_release_kept_memory(rproc);
+		rproc_disable_iommu(rproc);
+		rproc->domain_kept = false;
+	}
+	mutex_unlock(&rproc->lock);
+}
+
+/**
+ * rproc_resource_cleanup() - clean up and free all acquired resources
+ * @rproc: rproc handle
+ *
+ * This function will free all resources acquired for @rproc, and it
+ * is called whenever @rproc either shuts down or fails to boot.
+ */
+void rproc_resource_cleanup(struct rproc *rproc)
+{
+	struct rproc_mem_entry *entry, *tmp;
+	struct rproc_cache_entry *cache_entry, *cache_tmp;
+
+	/* clean up debugfs trace entries */
+	list_for_each_entry_safe(entry, tmp, &rproc->traces, node) {
+		rproc_remove_trace_file(entry->priv);
+		rproc->num_traces--;
+		list_del(&entry->node);
+		kfree(entry);
+	}
+
+	/* clean up debugfs cda entries */
+	list_for_each_entry_safe(entry, tmp, &rproc->cdas, node) {
+		rproc_remove_trace_file(entry->priv);
+		rproc->num_cdas--;
+		list_del(&entry->node);
+		kfree(entry);
+	}
+
+	/* clean up reserved allocations */
+	list_for_each_entry_safe(entry, tmp, &rproc->reserved_mems, node) {
+        if (use_nonsec_isp())
+            ;
+        else
+            iounmap(entry->va);
+		list_del(&entry->node);
+		kfree(entry);
+	}
+
+	/* clean up cache entry */
+	list_for_each_entry_safe(cache_entry, cache_tmp, &rproc->caches, node) {
+		list_del(&cache_entry->node);
+		kfree(cache_entry);
+	}
+
+	/* reset the share parameter pointer */
+	if (!use_sec_isp())
+		isp_share_para = NULL;
+
+	/* clean up carveouts, dynamic memory and iommu mapping entries */
+	rproc_free_memory(rproc, &rproc->carveouts, &rproc->dynamic_mems,
+				&rproc->pages, &rproc->mappings);
+}
+
 /*
  * take a firmware and boot a remote processor with it.
  */
@@ -867,12 +1002,17 @@ static int rproc_fw_boot(struct rproc *rproc, const struct firmware *fw)
 
 	/*
 	 * if enabling an IOMMU isn't relevant for this rproc, this is
-	 * just a nop
+	 * just a nop; a domain kept from the last session is reused as is
 	 */
-	ret = rproc_enable_iommu(rproc);
-	if (ret) {
-		dev_err(dev, "can't enable iommu: %d\n", ret);
-		return ret;
+	if (rproc->domain_kept) {
+		cancel_delayed_work(&rproc->mem_release_work);
+		rproc->domain_kept = false;
+	} else {
+		ret = rproc_enable_iommu(rproc);
+		if (ret) {
+			dev_err(dev, "can't enable iommu: %d\n", ret);
+			return ret;
+		}
 	}
 
 	rproc->bootaddr = rproc_get_boot_addr(rproc, fw);
@@ -892,6 +1032,8 @@ static int rproc_fw_boot(struct rproc *rproc, const struct firmware *fw)
 
 	/* handle fw resources which are required to boot rproc */
 	ret = rproc_handle_resources(rproc, tablesz, rproc_loading_handlers);
+	/* kept memory the firmware did not ask for again is of no more use */
+	rproc_release_kept_memory(rproc);
 	if (ret) {
 		dev_err(dev, "Failed to process resources: %d\n", ret);
 		goto clean_up;
@@ -947,6 +1089,7 @@ static int rproc_fw_boot(struct rproc *rproc, const struct firmware *fw)
 	return 0;
 
 clean_up:
+	rproc_release_kept_memory(rproc);
 	rproc_resource_cleanup(rproc);
 	rproc_disable_iommu(rproc);
 	return ret;
@@ -1290,10 +1433,15 @@ void rproc_shutdown(struct rproc *rproc)
 		goto out;
 	}
 
+	/* hold on to the memory and its mappings for the next boot */
+	if (rproc->mem_keep_ms && rproc->domain)
+		rproc_keep_memory(rproc);
+
 	/* clean up all acquired resources */
 	rproc_resource_cleanup(rproc);
 
-	rproc_disable_iommu(rproc);
+	if (!rproc->domain_kept)
+		rproc_disable_iommu(rproc);
 
 	/* Give the next start a clean resource table */
 	rproc->table_ptr = rproc->cached_table;
@@ -1495,8 +1643,13 @@ struct rproc *rproc_alloc(struct device *dev, const char *name,
 	INIT_LIST_HEAD(&rproc->cdas);
 	INIT_LIST_HEAD(&rproc->pages);
 	INIT_LIST_HEAD(&rproc->rvdevs);
+	INIT_LIST_HEAD(&rproc->kept_carveouts);
+	INIT_LIST_HEAD(&rproc->kept_dynamic_mems);
+	INIT_LIST_HEAD(&rproc->kept_pages);
+	INIT_LIST_HEAD(&rproc->kept_mappings);
 
 	INIT_WORK(&rproc->crash_handler, rproc_crash_handler_work);
+	INIT_DELAYED_WORK(&rproc->mem_release_work, rproc_mem_release_work);
 	init_completion(&rproc->crash_comp);
 
 	rproc->state = RPROC_OFFLINE;
@@ -1545,6 +1698,10 @@ int rproc_del(struct rproc *rproc)
 	/* if rproc is just being registered, wait */
 	wait_for_completion(&rproc->firmware_loading_complete);
 
+	/* give back memory kept from the last session right away */
+	cancel_delayed_work_sync(&rproc->mem_release_work);
+	rproc_mem_release_work(&rproc->mem_release_work.work);
+
 	/* clean up remote vdev entries */
 	list_for_each_entry_safe(rvdev, tmp, &rproc->rvdevs, node)
 		rproc_remove_virtio_dev(rvdev);
@@ -274,6 +274,8 @@ void rproc_create_debug_dir(struct rproc *rproc)
 					rproc, &rproc_state_ops);
 	debugfs_create_file("recovery", 0400, rproc->dbg_dir,
 					rproc, &rproc_recovery_ops);
+	debugfs_create_u32("mem_keep_ms", 0600, rproc->dbg_dir,
+					&rproc->mem_keep_ms);
 }
 
 void __init rproc_init_debugfs(void)
@@ -36,6 +36,7 @@
 #include <scsi/scsi_host.h>
 
 #include <trace/events/scsi.h>
+#include <huawei_platform/storage/io_latency.h>
 
 #include "scsi_priv.h"
 #include "scsi_logging.h"
@@ -1726,6 +1727,7 @@ static int scsi_dispatch_cmd(struct scsi_cmnd *cmd)
 	}
 
 	trace_scsi_dispatch_cmd_start(cmd);
+	io_latency_rq_issue(cmd->request);
 	rtn = host->hostt->queuecommand(host, cmd);
 	if (rtn) {
 		trace_scsi_dispatch_cmd_error(cmd, rtn);
@@ -2160,6 +2162,9 @@ static void __scsi_init_queue(struct Scsi_Host *shost, struct request_queue *q)
 	if(shost->mq_quirk_flag & SHOST_MQ_QUIRK(SHOST_MQ_QUIRK_DISPATCH_DICISION)){
 		hisi_blk_mq_set_queue_quirk(q, HISI_MQ_DISPATCH_DICISION);
 	}
+	if(shost->mq_quirk_flag & SHOST_MQ_QUIRK(SHOST_MQ_QUIRK_VIP_IO)){
+		hisi_blk_mq_set_queue_quirk(q, HISI_MQ_VIP_IO);
+	}
 #endif
 }
 
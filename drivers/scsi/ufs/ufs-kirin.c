@@ -217,32 +217,27 @@ static int ufs_kirin_uie_config_init(struct ufs_hba *hba)
 	return err;
 }
 
-/* the func to config key */
-static void ufs_kirin_uie_key_prepare(struct ufs_hba *hba, int key_len,
-					 int key_index, void *key)
+/* program @key into x-CRYPTOCFG @key_cfg, the slot of task tag @key_index */
+static void ufs_kirin_uie_key_write(struct ufs_hba *hba, int key_cfg,
+				    int key_index, void *key)
 {
 	struct ufs_kirin_host *host = hba->priv;
 	int reg_value = 0;
-	int key_cfg = 0;
 	u32 key_reg_offset = 0;
 
-#ifndef CONFIG_SCSI_UFS_KIRIN_V21
-	/*
-	 * when writing key reg of the number 22 ~ 31,
-	 * we must set reg apb_addr of ufs_sys_ctrl
-	 */
-	if (key_index > 21) {
-		ufs_sys_ctrl_writel(host, 0x10001, UFS_APB_ADDR_MASK);
-		key_cfg = key_index - 22;
-	} else
-		key_cfg = key_index;
-#else
-	key_cfg = key_index;
-#endif
-
 	/* key operation start */
 	reg_value = ufshcd_readl(hba, UFS_REG_CRYPTOCFG_0_16 + (key_cfg * 0x80));
 	if ((reg_value >> 31) & 0x1) {
+		/*
+		 * The slot belongs to this task tag only, so while CFGE is
+		 * still set (a host reset clears it) it holds the key we
+		 * wrote last. Sequential I/O of one file keeps hitting the
+		 * same key, don't rewrite it.
+		 */
+		if (!memcmp(host->uie_key[key_index], key,
+			    UFS_KIRIN_UIE_KEY_SIZE))
+			return;
+
 		/* TODO step 1st
 		 * Verify that no pending transactions reference x-CRYPTOCFG
 		 * in their CCI field, i.e. UTRD.CCI != x for all pending transactions
@@ -262,10 +257,35 @@ static void ufs_kirin_uie_key_prepare(struct ufs_hba *hba, int key_len,
 	key_reg_offset = key_cfg * 0x80;
 	memcpy(hba->key_reg_base + key_reg_offset, key, 64);
 	mb();
+	memcpy(host->uie_key[key_index], key, UFS_KIRIN_UIE_KEY_SIZE);
 
 	/* step 4th set x-CRYPTOCFG with CAPIDX, DUSIZE, and CFGE=1 */
 	ufshcd_writel(hba, 0x80000108, UFS_REG_CRYPTOCFG_0_16 + (key_cfg * 0x80));
 	/* key operation end */
+}
+
+/* the func to config key */
+static void ufs_kirin_uie_key_prepare(struct ufs_hba *hba, int key_len,
+					 int key_index, void *key)
+{
+	struct ufs_kirin_host *host = hba->priv;
+	int key_cfg = 0;
+
+#ifndef CONFIG_SCSI_UFS_KIRIN_V21
+	/*
+	 * when writing key reg of the number 22 ~ 31,
+	 * we must set reg apb_addr of ufs_sys_ctrl
+	 */
+	if (key_index > 21) {
+		ufs_sys_ctrl_writel(host, 0x10001, UFS_APB_ADDR_MASK);
+		key_cfg = key_index - 22;
+	} else
+		key_cfg = key_index;
+#else
+	key_cfg = key_index;
+#endif
+
+	ufs_kirin_uie_key_write(hba, key_cfg, key_index, key);
 
 #ifndef CONFIG_SCSI_UFS_KIRIN_V21
 	/* clear reg apb_addr of ufs_sys_ctrl */
@@ -1609,6 +1629,9 @@ static void ufs_kirin_populate_dt(struct device *dev,
 	if (of_find_property(np, "ufs-kirin-ssu-by-self", NULL))
 		host->hba->caps |= UFSHCD_CAP_SSU_BY_SELF;
 
+	if (of_find_property(np, "ufs-kirin-use-intr-aggr", NULL))
+		host->hba->caps |= UFSHCD_CAP_INTR_AGGR;
+
 	ret = of_property_match_string(np, "ufs-0db-equalizer-product-names", ufs_product_name);
 	if ( ret >= 0) {
 		dev_info(dev, "find %s in dts\n", ufs_product_name);
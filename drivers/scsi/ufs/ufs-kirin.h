@@ -183,6 +183,9 @@ enum {
 #define UFS_KIRIN_LIMIT_HS_RATE		PA_HS_MODE_A
 #define UFS_KIRIN_LIMIT_DESIRED_MODE	FAST
 
+#define UFS_KIRIN_UIE_KEYS	32
+#define UFS_KIRIN_UIE_KEY_SIZE	64
+
 struct ufs_kirin_host {
 	struct ufs_hba *hba;
 
@@ -218,6 +221,11 @@ struct ufs_kirin_host {
 	struct ufs_pa_layer_attr dev_req_params;
 
 	struct ufs_rdr_ctrl rdr_ctrl;
+
+#ifdef CONFIG_SCSI_UFS_INLINE_CRYPTO
+	/* key last programmed into each x-CRYPTOKEY, indexed by task tag */
+	u8 uie_key[UFS_KIRIN_UIE_KEYS][UFS_KIRIN_UIE_KEY_SIZE];
+#endif
 };
 
 #define ufs_kirin_is_link_off(hba) ufshcd_is_link_off(hba)
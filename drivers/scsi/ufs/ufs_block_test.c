@@ -18,6 +18,7 @@
 #include <linux/debugfs.h>
 #include <linux/delay.h>
 #include <linux/module.h>
+#include <linux/sort.h>
 #include <linux/test-iosched.h>
 #include <scsi/scsi.h>
 #include <scsi/scsi_device.h>
@@ -63,6 +64,10 @@ extern struct gendisk *scsi_gendisk_get_from_dev(struct device *dev);
 		(LONG_TEST_SIZE_INTEGER(x) * 10))
 /* translation mask from sectors to block */
 #define SECTOR_TO_BLOCK_MASK 0x7
+/* idle time before each request of the hibern8 exit benchmark */
+#define UFS_BENCH_DEFAULT_IDLE_MS	300
+#define UFS_BENCH_DISCARD_SECTORS	2048	/* 1MB */
+#define UFS_BENCH_TIMEOUT		msecs_to_jiffies(10000)
 
 #define TEST_OPS(test_name, upper_case_name)				\
 static int ufs_test_ ## test_name ## _show(struct seq_file *file,	\
@@ -102,9 +107,95 @@ enum ufs_test_testcases {
 	UFS_TEST_LUN_DEPTH,
 
 	UFS_TEST_READ,
+
+	UFS_TEST_BENCH_RAND_READ_UNDER_WRITE,
+	UFS_TEST_BENCH_FSYNC_STORM,
+	UFS_TEST_BENCH_DISCARD_OVERLAP,
+	UFS_TEST_BENCH_HIBERN8_EXIT,
+	UFS_TEST_BENCH_MIXED_QD,
 	NUM_TESTS,
 };
 
+#define UFS_TEST_BENCH_FIRST	UFS_TEST_BENCH_RAND_READ_UNDER_WRITE
+
+enum ufs_bench_bg {
+	UFS_BENCH_BG_NONE,
+	UFS_BENCH_BG_SEQ_WRITE,
+	UFS_BENCH_BG_DISCARD,
+};
+
+/**
+ * struct ufs_bench_phase - one measured workload of a benchmark
+ * @testcase: the benchmark test case this phase belongs to
+ * @name: name of the phase in bench_results
+ * @reqs: number of foreground requests
+ * @qd: maximum foreground requests in flight
+ * @read_pct: share of 4K reads among the foreground requests, the rest
+ *	are 4K writes
+ * @flush_every: issue a flush after this many writes once they are
+ *	completed, like fsync() does; 0 for never
+ * @sample_flush: record the latency of the flushes only
+ * @idle: let the device idle for bench_idle_ms before each request
+ * @bg: background load kept running while the foreground requests run
+ * @bg_qd: maximum background requests in flight
+ *
+ * Foreground requests go to the first half of the test range, random and
+ * 4K aligned. Background writes go sequentially to the second half and
+ * background discards walk the first half, overlapping the foreground.
+ */
+struct ufs_bench_phase {
+	int testcase;
+	const char *name;
+	unsigned int reqs;
+	unsigned int qd;
+	unsigned int read_pct;
+	unsigned int flush_every;
+	bool sample_flush;
+	bool idle;
+	enum ufs_bench_bg bg;
+	unsigned int bg_qd;
+};
+
+static const struct ufs_bench_phase ufs_bench_phases[] = {
+	{ UFS_TEST_BENCH_RAND_READ_UNDER_WRITE, "rr4k_alone",
+	  4096, 1, 100, 0, false, false, UFS_BENCH_BG_NONE, 0 },
+	{ UFS_TEST_BENCH_RAND_READ_UNDER_WRITE, "rr4k_seq_write",
+	  4096, 1, 100, 0, false, false, UFS_BENCH_BG_SEQ_WRITE, 4 },
+	{ UFS_TEST_BENCH_FSYNC_STORM, "fsync_storm",
+	  2048, 8, 0, 8, true, false, UFS_BENCH_BG_NONE, 0 },
+	{ UFS_TEST_BENCH_DISCARD_OVERLAP, "rw4k_alone",
+	  4096, 8, 50, 0, false, false, UFS_BENCH_BG_NONE, 0 },
+	{ UFS_TEST_BENCH_DISCARD_OVERLAP, "rw4k_discard",
+	  4096, 8, 50, 0, false, false, UFS_BENCH_BG_DISCARD, 2 },
+	{ UFS_TEST_BENCH_HIBERN8_EXIT, "h8_busy",
+	  256, 1, 100, 0, false, false, UFS_BENCH_BG_NONE, 0 },
+	{ UFS_TEST_BENCH_HIBERN8_EXIT, "h8_idle",
+	  64, 1, 100, 0, false, true, UFS_BENCH_BG_NONE, 0 },
+	{ UFS_TEST_BENCH_MIXED_QD, "mixed_qd1",
+	  2048, 1, 70, 0, false, false, UFS_BENCH_BG_NONE, 0 },
+	{ UFS_TEST_BENCH_MIXED_QD, "mixed_qd4",
+	  4096, 4, 70, 0, false, false, UFS_BENCH_BG_NONE, 0 },
+	{ UFS_TEST_BENCH_MIXED_QD, "mixed_qd16",
+	  8192, 16, 70, 0, false, false, UFS_BENCH_BG_NONE, 0 },
+	{ UFS_TEST_BENCH_MIXED_QD, "mixed_qd32",
+	  8192, 32, 70, 0, false, false, UFS_BENCH_BG_NONE, 0 },
+};
+
+#define UFS_BENCH_NR_PHASES	ARRAY_SIZE(ufs_bench_phases)
+
+/* latencies in usec */
+struct ufs_bench_result {
+	bool valid;
+	int err;
+	unsigned int reqs;
+	unsigned int iops;
+	u32 p50;
+	u32 p90;
+	u32 p99;
+	u32 p999;
+	u32 max;
+};
+
 enum ufs_test_stage {
 	DEFAULT,
 	UFS_TEST_ERROR,
@@ -154,6 +245,21 @@ struct ufs_test_data {
 	/* total number of requests to be submitted in long test */
 	u32 long_test_num_reqs;
 
+	/* benchmark state of the running phase, see ufs_bench_run() */
+	const struct ufs_bench_phase *bench_phase;
+	struct gendisk *bench_disk;
+	u32 *bench_lat;
+	unsigned int bench_nr_lat;
+	unsigned int bench_fg_done;
+	atomic_t bench_fg_inflight;
+	atomic_t bench_bg_inflight;
+	int bench_err;
+	bool bench_done;
+	u32 bench_idle_ms;
+	struct dentry *bench_idle_ms_dentry;
+	struct dentry *bench_results_dentry;
+	struct ufs_bench_result bench_res[UFS_BENCH_NR_PHASES];
+
 	struct test_iosched *test_iosched;
 };
 
@@ -259,6 +365,16 @@ static char *ufs_test_get_test_case_str(int testcase)
 		return "UFS LUN depth test";
 	case UFS_TEST_READ:
 		return "UFS test READ";
+	case UFS_TEST_BENCH_RAND_READ_UNDER_WRITE:
+		return "UFS bench random read under sequential write";
+	case UFS_TEST_BENCH_FSYNC_STORM:
+		return "UFS bench fsync storm";
+	case UFS_TEST_BENCH_DISCARD_OVERLAP:
+		return "UFS bench discard overlap";
+	case UFS_TEST_BENCH_HIBERN8_EXIT:
+		return "UFS bench hibern8 exit latency";
+	case UFS_TEST_BENCH_MIXED_QD:
+		return "UFS bench mixed queue depth";
 	}
 	return "Unknown test";
 }
@@ -453,6 +569,45 @@ static int ufs_test_show(struct seq_file *file, int test_case)
 	case UFS_TEST_READ:
 		test_description = "\nufs_test_read\n";
 		break;
+	case UFS_TEST_BENCH_RAND_READ_UNDER_WRITE:
+		test_description = "\nufs_test_bench_rand_read_under_write\n"
+		    "=========\n"
+		    "Description:\n"
+		    "Latency of 4K random reads at queue depth 1, once alone "
+		    "and once while a sequential write burst of 512K requests "
+		    "keeps running.\n";
+		break;
+	case UFS_TEST_BENCH_FSYNC_STORM:
+		test_description = "\nufs_test_bench_fsync_storm\n"
+		    "=========\n"
+		    "Description:\n"
+		    "Groups of eight 4K random writes, each group followed by "
+		    "a cache flush once its writes completed. The latency of "
+		    "the flushes is reported.\n";
+		break;
+	case UFS_TEST_BENCH_DISCARD_OVERLAP:
+		test_description = "\nufs_test_bench_discard_overlap\n"
+		    "=========\n"
+		    "Description:\n"
+		    "4K random reads and writes at queue depth 8, once alone "
+		    "and once while 1MB discards walk the same range.\n";
+		break;
+	case UFS_TEST_BENCH_HIBERN8_EXIT:
+		test_description = "\nufs_test_bench_hibern8_exit\n"
+		    "=========\n"
+		    "Description:\n"
+		    "4K reads back to back, then 4K reads each issued after "
+		    "the device idled for utils/bench_idle_ms, so that the "
+		    "link entered hibern8. The difference is the hibern8 "
+		    "exit cost.\n";
+		break;
+	case UFS_TEST_BENCH_MIXED_QD:
+		test_description = "\nufs_test_bench_mixed_qd\n"
+		    "=========\n"
+		    "Description:\n"
+		    "70/30 4K random reads and writes at queue depth 1, 4, 16 "
+		    "and 32.\n";
+		break;
 	default:
 		test_description = "Unknown test";
 	}
@@ -1305,6 +1460,367 @@ static int ufs_test_run_data_integrity_test(struct test_iosched *test_iosched)
 	return ret;
 }
 
+static struct gendisk *ufs_bench_get_rq_disk(struct test_iosched *tios)
+{
+	struct ufs_test_data *utd = tios->blk_dev_test_data;
+
+	return utd->bench_disk;
+}
+
+/* Take a single disk reference for the whole phase, put by ufs_bench_post */
+static int ufs_bench_prepare(struct test_iosched *tios)
+{
+	struct ufs_test_data *utd = tios->blk_dev_test_data;
+	int ret;
+
+	ret = ufs_test_prepare(tios);
+	utd->bench_disk = ufs_test_get_rq_disk(tios);
+	if (!utd->bench_disk)
+		return -ENODEV;
+
+	return ret;
+}
+
+static bool ufs_bench_is_bg(struct test_request *test_rq)
+{
+	return (test_rq->rq->cmd_flags & REQ_DISCARD) ||
+	       test_rq->buf_size > TEST_BIO_SIZE;
+}
+
+static void ufs_bench_end_io_fn(struct request *rq, int err)
+{
+	struct test_iosched *tios = rq->q->elevator->elevator_data;
+	struct ufs_test_data *utd = tios->blk_dev_test_data;
+	const struct ufs_bench_phase *ph = utd->bench_phase;
+	struct test_request *test_rq = rq->elv.priv[0];
+	unsigned long flags;
+	bool bg, sample;
+	s64 us;
+
+	BUG_ON(!test_rq);
+
+	us = ktime_us_delta(ktime_get(), test_rq->dispatch_time);
+	bg = ufs_bench_is_bg(test_rq);
+	sample = !bg && (!ph->sample_flush || (rq->cmd_flags & REQ_FLUSH));
+
+	spin_lock_irqsave(&tios->lock, flags);
+	tios->dispatched_count--;
+	list_del_init(&test_rq->queuelist);
+	if (sample && utd->bench_nr_lat < ph->reqs)
+		utd->bench_lat[utd->bench_nr_lat++] = us;
+	if (!bg)
+		utd->bench_fg_done++;
+	__blk_put_request(tios->req_q, rq);
+	spin_unlock_irqrestore(&tios->lock, flags);
+
+	if (err) {
+		pr_err("%s: request %d completed, err=%d", __func__,
+		       test_rq->req_id, err);
+		utd->bench_err = err;
+	}
+
+	test_iosched_free_test_req_data_buffer(test_rq);
+	kfree(test_rq);
+
+	atomic_dec(bg ? &utd->bench_bg_inflight : &utd->bench_fg_inflight);
+	wake_up(&utd->wait_q);
+	check_test_completion(tios);
+}
+
+static bool ufs_bench_check_completion(struct test_iosched *tios)
+{
+	struct ufs_test_data *utd = tios->blk_dev_test_data;
+
+	return utd->bench_done;
+}
+
+static bool ufs_bench_can_issue(struct ufs_test_data *utd)
+{
+	const struct ufs_bench_phase *ph = utd->bench_phase;
+
+	return utd->bench_err ||
+	       atomic_read(&utd->bench_fg_inflight) < ph->qd ||
+	       (ph->bg != UFS_BENCH_BG_NONE &&
+		atomic_read(&utd->bench_bg_inflight) < ph->bg_qd);
+}
+
+static int ufs_bench_wait_fg_idle(struct ufs_test_data *utd)
+{
+	if (!wait_event_timeout(utd->wait_q,
+				!atomic_read(&utd->bench_fg_inflight),
+				UFS_BENCH_TIMEOUT))
+		return -ETIMEDOUT;
+	return 0;
+}
+
+/**
+ * ufs_bench_run_phase() - run the foreground requests of utd->bench_phase
+ * with at most ph->qd of them in flight, keeping the background load at
+ * ph->bg_qd requests until the foreground is done. Requests are created
+ * here as room frees up, so the queue depth seen by the device is the
+ * one of the phase rather than the size of the request pool.
+ */
+static int ufs_bench_run_phase(struct test_iosched *tios)
+{
+	struct ufs_test_data *utd = tios->blk_dev_test_data;
+	const struct ufs_bench_phase *ph = utd->bench_phase;
+	u32 half = utd->sector_range / 2;
+	u32 fg_start = tios->start_sector;
+	u32 bg_start = fg_start + half;
+	u32 blocks = half >> 3;
+	u32 bg_pos = 0, sector;
+	unsigned int seed, issued = 0, writes = 0;
+	int direction, ret = 0;
+
+	if (!utd->bench_disk) {
+		utd->bench_done = true;
+		return -ENODEV;
+	}
+
+	seed = utd->random_test_seed ? utd->random_test_seed : MAGIC_SEED;
+
+	while (issued < ph->reqs) {
+		if (!wait_event_timeout(utd->wait_q, ufs_bench_can_issue(utd),
+					UFS_BENCH_TIMEOUT)) {
+			ret = -ETIMEDOUT;
+			break;
+		}
+		if (utd->bench_err)
+			break;
+
+		if (ph->bg != UFS_BENCH_BG_NONE &&
+		    atomic_read(&utd->bench_bg_inflight) < ph->bg_qd) {
+			atomic_inc(&utd->bench_bg_inflight);
+			if (ph->bg == UFS_BENCH_BG_DISCARD) {
+				ret = test_iosched_add_unique_test_req(tios, 0,
+					REQ_UNIQUE_DISCARD, fg_start + bg_pos,
+					UFS_BENCH_DISCARD_SECTORS,
+					ufs_bench_end_io_fn);
+				bg_pos += UFS_BENCH_DISCARD_SECTORS;
+			} else {
+				ret = test_iosched_add_wr_rd_test_req(tios, 0,
+					WRITE, bg_start + bg_pos,
+					TEST_MAX_BIOS_PER_REQ, TEST_PATTERN_5A,
+					ufs_bench_end_io_fn);
+				bg_pos += TEST_MAX_BIOS_PER_REQ *
+					  (TEST_BIO_SIZE / SECTOR_SIZE);
+			}
+			if (bg_pos >= half)
+				bg_pos = 0;
+			if (ret) {
+				atomic_dec(&utd->bench_bg_inflight);
+				break;
+			}
+			blk_run_queue(tios->req_q);
+			continue;
+		}
+
+		if (atomic_read(&utd->bench_fg_inflight) >= ph->qd)
+			continue;
+
+		if (ph->flush_every && writes == ph->flush_every) {
+			ret = ufs_bench_wait_fg_idle(utd);
+			if (ret)
+				break;
+			atomic_inc(&utd->bench_fg_inflight);
+			ret = test_iosched_add_unique_test_req(tios, 0,
+					REQ_UNIQUE_FLUSH, 0, 0,
+					ufs_bench_end_io_fn);
+			writes = 0;
+		} else {
+			if (ph->idle) {
+				ret = ufs_bench_wait_fg_idle(utd);
+				if (ret)
+					break;
+				msleep(utd->bench_idle_ms);
+			}
+			direction = ufs_test_pseudo_random_seed(&seed, 0, 100) <
+				    ph->read_pct ? READ : WRITE;
+			sector = fg_start +
+				 (ufs_test_pseudo_random_seed(&seed, 0,
+							      blocks) << 3);
+			atomic_inc(&utd->bench_fg_inflight);
+			ret = test_iosched_add_wr_rd_test_req(tios, 0,
+					direction, sector, 1, TEST_NO_PATTERN,
+					ufs_bench_end_io_fn);
+			if (direction == WRITE)
+				writes++;
+		}
+		if (ret) {
+			atomic_dec(&utd->bench_fg_inflight);
+			break;
+		}
+		issued++;
+		blk_run_queue(tios->req_q);
+	}
+
+	/* let everything in flight complete, also on errors */
+	if (!wait_event_timeout(utd->wait_q,
+				!atomic_read(&utd->bench_fg_inflight) &&
+				!atomic_read(&utd->bench_bg_inflight),
+				UFS_BENCH_TIMEOUT) && !ret)
+		ret = -ETIMEDOUT;
+
+	if (ret)
+		pr_err("%s: %s stopped after %u requests, err=%d", __func__,
+		       ph->name, issued, ret);
+
+	utd->bench_done = true;
+	check_test_completion(tios);
+	return ret;
+}
+
+static int ufs_bench_check_result(struct test_iosched *tios)
+{
+	struct ufs_test_data *utd = tios->blk_dev_test_data;
+
+	return utd->bench_err ? TEST_FAILED : 0;
+}
+
+static int ufs_bench_cmp_u32(const void *a, const void *b)
+{
+	u32 x = *(const u32 *)a, y = *(const u32 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static u32 ufs_bench_percentile(u32 *lat, unsigned int n, unsigned int pm)
+{
+	unsigned int i = (n * pm) / 1000;
+
+	return lat[min(i, n - 1)];
+}
+
+static int ufs_bench_post(struct test_iosched *tios)
+{
+	struct ufs_test_data *utd = tios->blk_dev_test_data;
+	const struct ufs_bench_phase *ph = utd->bench_phase;
+	struct ufs_bench_result *res = &utd->bench_res[ph - ufs_bench_phases];
+	unsigned int n = utd->bench_nr_lat;
+	s64 us = ktime_to_us(tios->test_info.test_duration);
+
+	memset(res, 0, sizeof(*res));
+	res->valid = true;
+	res->err = utd->bench_err;
+	res->reqs = utd->bench_fg_done;
+	if (us > 0)
+		res->iops = div64_s64((s64)utd->bench_fg_done * USEC_PER_SEC,
+				      us);
+	if (n) {
+		sort(utd->bench_lat, n, sizeof(u32), ufs_bench_cmp_u32, NULL);
+		res->p50 = ufs_bench_percentile(utd->bench_lat, n, 500);
+		res->p90 = ufs_bench_percentile(utd->bench_lat, n, 900);
+		res->p99 = ufs_bench_percentile(utd->bench_lat, n, 990);
+		res->p999 = ufs_bench_percentile(utd->bench_lat, n, 999);
+		res->max = utd->bench_lat[n - 1];
+	}
+
+	pr_info("%s: %s: %u reqs, %u IOPS, p50 %u p99 %u max %u usec",
+		__func__, ph->name, res->reqs, res->iops, res->p50, res->p99,
+		res->max);
+
+	if (!utd->bench_disk)
+		return ufs_test_pm_runtime_cfg_sync(tios, false);
+	utd->bench_disk = NULL;
+	return ufs_test_post(tios);
+}
+
+/* Run all phases of a benchmark test case, one test-iosched test each */
+static int ufs_bench_run(struct ufs_test_data *utd, int test_case)
+{
+	struct test_iosched *tios = utd->test_iosched;
+	const struct ufs_bench_phase *ph;
+	int ret = 0;
+
+	if (tios->sector_range)
+		utd->sector_range = tios->sector_range;
+	else
+		utd->sector_range = TEST_DEFAULT_SECTOR_RANGE;
+
+	for (ph = ufs_bench_phases;
+	     ph < ufs_bench_phases + UFS_BENCH_NR_PHASES; ph++) {
+		if (ph->testcase != test_case)
+			continue;
+
+		utd->bench_lat = kcalloc(ph->reqs, sizeof(u32), GFP_KERNEL);
+		if (!utd->bench_lat)
+			return -ENOMEM;
+
+		memset(&utd->test_info, 0, sizeof(struct test_info));
+		utd->test_info.data = utd;
+		utd->test_info.testcase = test_case;
+		utd->test_info.get_test_case_str_fn =
+		    ufs_test_get_test_case_str;
+		utd->test_info.get_rq_disk_fn = ufs_bench_get_rq_disk;
+		utd->test_info.prepare_test_fn = ufs_bench_prepare;
+		utd->test_info.run_test_fn = ufs_bench_run_phase;
+		utd->test_info.check_test_completion_fn =
+		    ufs_bench_check_completion;
+		utd->test_info.check_test_result_fn = ufs_bench_check_result;
+		utd->test_info.post_test_fn = ufs_bench_post;
+
+		utd->bench_phase = ph;
+		utd->bench_disk = NULL;
+		utd->bench_nr_lat = 0;
+		utd->bench_fg_done = 0;
+		utd->bench_err = 0;
+		utd->bench_done = false;
+		atomic_set(&utd->bench_fg_inflight, 0);
+		atomic_set(&utd->bench_bg_inflight, 0);
+
+		pr_info("%s: phase %s", __func__, ph->name);
+		ret = test_iosched_start_test(tios, &utd->test_info);
+
+		kfree(utd->bench_lat);
+		utd->bench_lat = NULL;
+		if (ret) {
+			pr_err("%s: %s failed, err=%d.", __func__, ph->name,
+			       ret);
+			break;
+		}
+
+		/* Allow FS requests to be dispatched */
+		msleep(1000);
+	}
+
+	return ret;
+}
+
+static int ufs_bench_results_show(struct seq_file *file, void *data)
+{
+	struct ufs_test_data *utd = file->private;
+	const struct ufs_bench_result *res;
+	int i;
+
+	seq_printf(file, "%-16s %6s %7s %7s %7s %7s %7s %7s %4s\n",
+		   "phase", "reqs", "iops", "p50", "p90", "p99", "p99.9",
+		   "max", "err");
+	for (i = 0; i < UFS_BENCH_NR_PHASES; i++) {
+		res = &utd->bench_res[i];
+		if (!res->valid)
+			continue;
+		seq_printf(file, "%-16s %6u %7u %7u %7u %7u %7u %7u %4d\n",
+			   ufs_bench_phases[i].name, res->reqs, res->iops,
+			   res->p50, res->p90, res->p99, res->p999, res->max,
+			   res->err);
+	}
+	seq_puts(file, "latencies in usec, from dispatch to completion\n");
+
+	return 0;
+}
+
+static int ufs_bench_results_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ufs_bench_results_show, inode->i_private);
+}
+
+static const struct file_operations ufs_bench_results_ops = {
+	.open = ufs_bench_results_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static ssize_t ufs_test_write(struct file *file, const char __user *buf,
 			      size_t count, loff_t *ppos, int test_case)
 {
@@ -1325,6 +1841,16 @@ static ssize_t ufs_test_write(struct file *file, const char __user *buf,
 		number = 1;
 
 	pr_info("%s:the test will run for %d iterations.", __func__, number);
+
+	if (test_case >= UFS_TEST_BENCH_FIRST) {
+		for (i = 0; i < number; ++i) {
+			ret = ufs_bench_run(utd, test_case);
+			if (ret)
+				return ret;
+		}
+		return count;
+	}
+
 	memset(&utd->test_info, 0, sizeof(struct test_info));
 
 	/* Initializing test */
@@ -1425,6 +1951,11 @@ TEST_OPS(long_sequential_mixed, LONG_SEQUENTIAL_MIXED);
 TEST_OPS(parallel_read_and_write, PARALLEL_READ_AND_WRITE);
 TEST_OPS(lun_depth, LUN_DEPTH);
 TEST_OPS(read, READ);
+TEST_OPS(bench_rand_read_under_write, BENCH_RAND_READ_UNDER_WRITE);
+TEST_OPS(bench_fsync_storm, BENCH_FSYNC_STORM);
+TEST_OPS(bench_discard_overlap, BENCH_DISCARD_OVERLAP);
+TEST_OPS(bench_hibern8_exit, BENCH_HIBERN8_EXIT);
+TEST_OPS(bench_mixed_qd, BENCH_MIXED_QD);
 
 static void ufs_test_debugfs_cleanup(struct test_iosched *test_iosched)
 {
@@ -1502,6 +2033,36 @@ static int ufs_test_debugfs_init(struct ufs_test_data *utd)
 	if (ret)
 		goto exit_err;
 
+	utd->bench_idle_ms_dentry = debugfs_create_u32("bench_idle_ms",
+						       S_IRUGO | S_IWUGO,
+						       utils_root,
+						       &utd->bench_idle_ms);
+	utd->bench_results_dentry = debugfs_create_file("bench_results",
+							S_IRUGO, utils_root,
+							utd,
+							&ufs_bench_results_ops);
+	if (!utd->bench_idle_ms_dentry || !utd->bench_results_dentry) {
+		pr_err("%s: Could not create debugfs bench files.", __func__);
+		ret = -ENOMEM;
+		goto exit_err;
+	}
+	ret = add_test(utd, bench_rand_read_under_write,
+		       BENCH_RAND_READ_UNDER_WRITE);
+	if (ret)
+		goto exit_err;
+	ret = add_test(utd, bench_fsync_storm, BENCH_FSYNC_STORM);
+	if (ret)
+		goto exit_err;
+	ret = add_test(utd, bench_discard_overlap, BENCH_DISCARD_OVERLAP);
+	if (ret)
+		goto exit_err;
+	ret = add_test(utd, bench_hibern8_exit, BENCH_HIBERN8_EXIT);
+	if (ret)
+		goto exit_err;
+	ret = add_test(utd, bench_mixed_qd, BENCH_MIXED_QD);
+	if (ret)
+		goto exit_err;
+
 	goto exit;
 
 exit_err:
@@ -1522,6 +2083,7 @@ static int ufs_test_probe(struct test_iosched *test_iosched)
 	}
 
 	init_waitqueue_head(&utd->wait_q);
+	utd->bench_idle_ms = UFS_BENCH_DEFAULT_IDLE_MS;
 	utd->test_iosched = test_iosched;
 	test_iosched->blk_dev_test_data = utd;
 
@@ -21,6 +21,7 @@
 #include "ufs_debugfs.h"
 #include "unipro.h"
 #include "ufshci.h"
+#include "ufs_kirin_norm_stat.h"
 
 enum field_width {
 	BYTE = 1,
@@ -907,6 +908,215 @@ static const struct file_operations ufsdbg_req_stats_desc = {
 	.write = ufsdbg_req_stats_write,
 };
 
+static int ufsdbg_intr_aggr_show(struct seq_file *file, void *data)
+{
+	struct ufs_hba *hba = (struct ufs_hba *)file->private;
+
+	seq_printf(file, "enabled: %d\n", ufshcd_is_intr_aggr_allowed(hba));
+	seq_printf(file, "counter: %u\n", hba->intr_aggr_cnt);
+	seq_printf(file, "timeout: %u (x40us)\n", hba->intr_aggr_tmout);
+
+	return 0;
+}
+
+static int ufsdbg_intr_aggr_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ufsdbg_intr_aggr_show, inode->i_private);
+}
+
+/* "<counter> <timeout>" */
+static ssize_t ufsdbg_intr_aggr_write(struct file *filp,
+				      const char __user *ubuf, size_t cnt,
+				      loff_t *ppos)
+{
+	struct ufs_hba *hba = filp->f_mapping->host->i_private;
+	char buf[BUFF_LINE_SIZE] = { 0 };
+	loff_t buff_pos = 0;
+	unsigned int thld, tmout;
+	int ret;
+
+	ret = simple_write_to_buffer(buf, sizeof(buf) - 1, &buff_pos, ubuf,
+				     cnt);
+	if (ret < 0)
+		return ret;
+
+	if (sscanf(buf, "%u %u", &thld, &tmout) != 2 ||
+	    thld > U8_MAX || tmout > U8_MAX)
+		return -EINVAL;
+
+	ret = ufshcd_set_intr_aggr(hba, thld, tmout);
+	if (ret)
+		return ret;
+
+	return cnt;
+}
+
+static const struct file_operations ufsdbg_intr_aggr_fops = {
+	.open = ufsdbg_intr_aggr_open,
+	.read = seq_read,
+	.write = ufsdbg_intr_aggr_write,
+};
+
+static int ufsdbg_intr_stats_show(struct seq_file *file, void *data)
+{
+	struct ufs_hba *hba = (struct ufs_hba *)file->private;
+	struct ufs_stats *stats = &hba->ufs_stats;
+	u64 intrs, compls, polled, hits;
+	unsigned long flags;
+	s64 ms;
+
+	spin_lock_irqsave(hba->host->host_lock, flags);
+	intrs = stats->utr_intr_cnt;
+	compls = stats->utr_compl_cnt;
+	polled = stats->hpoll_cnt;
+	hits = stats->hpoll_hit_cnt;
+	ms = ktime_ms_delta(ktime_get(), stats->intr_tstamp);
+	spin_unlock_irqrestore(hba->host->host_lock, flags);
+
+	if (ms <= 0)
+		ms = 1;
+
+	seq_printf(file, "time: %lld ms\n", ms);
+	seq_printf(file, "transfer irqs: %llu (%llu/s)\n", intrs,
+		   div64_u64(intrs * MSEC_PER_SEC, ms));
+	seq_printf(file, "completions: %llu (%llu per 100 irqs)\n", compls,
+		   intrs ? div64_u64(compls * 100, intrs) : 0);
+	seq_printf(file, "polled: %llu\n", polled);
+	seq_printf(file, "poll hits: %llu (%llu%%)\n", hits,
+		   polled ? div64_u64(hits * 100, polled) : 0);
+
+	return 0;
+}
+
+static int ufsdbg_intr_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ufsdbg_intr_stats_show, inode->i_private);
+}
+
+static ssize_t ufsdbg_intr_stats_write(struct file *filp,
+				       const char __user *ubuf, size_t cnt,
+				       loff_t *ppos)
+{
+	struct ufs_hba *hba = filp->f_mapping->host->i_private;
+	struct ufs_stats *stats = &hba->ufs_stats;
+	unsigned long flags;
+
+	spin_lock_irqsave(hba->host->host_lock, flags);
+	stats->utr_intr_cnt = 0;
+	stats->utr_compl_cnt = 0;
+	stats->hpoll_cnt = 0;
+	stats->hpoll_hit_cnt = 0;
+	stats->intr_tstamp = ktime_get();
+	spin_unlock_irqrestore(hba->host->host_lock, flags);
+
+	return cnt;
+}
+
+static const struct file_operations ufsdbg_intr_stats_fops = {
+	.open = ufsdbg_intr_stats_open,
+	.read = seq_read,
+	.write = ufsdbg_intr_stats_write,
+};
+
+static int ufsdbg_perf_stats_show(struct seq_file *file, void *data)
+{
+	ufs_perf_stats_show(file, (struct ufs_hba *)file->private);
+	return 0;
+}
+
+static int ufsdbg_perf_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ufsdbg_perf_stats_show, inode->i_private);
+}
+
+static ssize_t ufsdbg_perf_stats_write(struct file *filp,
+				       const char __user *ubuf, size_t cnt,
+				       loff_t *ppos)
+{
+	struct ufs_hba *hba = filp->f_mapping->host->i_private;
+
+	ufs_perf_stats_reset(hba);
+	return cnt;
+}
+
+static const struct file_operations ufsdbg_perf_stats_fops = {
+	.open = ufsdbg_perf_stats_open,
+	.read = seq_read,
+	.write = ufsdbg_perf_stats_write,
+};
+
+#ifdef CONFIG_SCSI_UFS_IDLE_PRED
+static int ufsdbg_idle_pred_show(struct seq_file *file, void *data)
+{
+	struct ufs_hba *hba = (struct ufs_hba *)file->private;
+	struct ufs_idle_pred *pred = &hba->idle_pred;
+	u64 gap, enter, exit, be, hits, total, err;
+	u64 deep_hit, deep_miss, shallow_hit, shallow_miss;
+	unsigned long flags;
+	bool enable;
+
+	spin_lock_irqsave(&pred->lock, flags);
+	enable = pred->enable;
+	gap = pred->gap_ns;
+	enter = pred->h8_enter_ns;
+	exit = pred->h8_exit_ns;
+	be = ufshcd_idle_pred_be_ns(pred);
+	deep_hit = pred->deep_hit;
+	deep_miss = pred->deep_miss;
+	shallow_hit = pred->shallow_hit;
+	shallow_miss = pred->shallow_miss;
+	err = pred->err_us;
+	spin_unlock_irqrestore(&pred->lock, flags);
+
+	hits = deep_hit + shallow_hit;
+	total = hits + deep_miss + shallow_miss;
+
+	seq_printf(file, "enabled: %d\n", enable);
+	seq_printf(file, "predicted idle: %llu us\n",
+		   div_u64(gap, NSEC_PER_USEC));
+	seq_printf(file, "hibern8 enter/exit: %llu/%llu us\n",
+		   div_u64(enter, NSEC_PER_USEC), div_u64(exit, NSEC_PER_USEC));
+	seq_printf(file, "break-even: %llu us\n", div_u64(be, NSEC_PER_USEC));
+	seq_printf(file, "deep: %llu hit, %llu miss\n", deep_hit, deep_miss);
+	seq_printf(file, "shallow: %llu hit, %llu miss\n", shallow_hit,
+		   shallow_miss);
+	seq_printf(file, "accuracy: %llu%%\n",
+		   total ? div64_u64(hits * 100, total) : 0);
+	seq_printf(file, "mean error: %llu us\n",
+		   total ? div64_u64(err, total) : 0);
+
+	return 0;
+}
+
+static int ufsdbg_idle_pred_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ufsdbg_idle_pred_show, inode->i_private);
+}
+
+/* "0" or "1", also resets the statistics */
+static ssize_t ufsdbg_idle_pred_write(struct file *filp,
+				      const char __user *ubuf, size_t cnt,
+				      loff_t *ppos)
+{
+	struct ufs_hba *hba = filp->f_mapping->host->i_private;
+	unsigned int enable;
+	int ret;
+
+	ret = kstrtouint_from_user(ubuf, cnt, 0, &enable);
+	if (ret)
+		return ret;
+
+	ufshcd_idle_pred_enable(hba, !!enable);
+	return cnt;
+}
+
+static const struct file_operations ufsdbg_idle_pred_fops = {
+	.open = ufsdbg_idle_pred_open,
+	.read = seq_read,
+	.write = ufsdbg_idle_pred_write,
+};
+#endif
+
 struct ufs_hba *hba_addr;
 EXPORT_SYMBOL(hba_addr);
 void ufsdbg_add_debugfs(struct ufs_hba *hba)
@@ -1028,6 +1238,65 @@ void ufsdbg_add_debugfs(struct ufs_hba *hba)
 		goto err;
 	}
 
+	hba->debugfs_files.intr_aggr =
+	    debugfs_create_file("intr_aggr", S_IRUSR | S_IWUSR,
+				hba->debugfs_files.debugfs_root, hba,
+				&ufsdbg_intr_aggr_fops);
+	if (!hba->debugfs_files.intr_aggr) {
+		dev_err(hba->dev,
+			"%s:  failed create intr_aggr debugfs entry\n",
+			__func__);
+		goto err;
+	}
+
+	hba->debugfs_files.intr_stats =
+	    debugfs_create_file("intr_stats", S_IRUSR | S_IWUSR,
+				hba->debugfs_files.debugfs_root, hba,
+				&ufsdbg_intr_stats_fops);
+	if (!hba->debugfs_files.intr_stats) {
+		dev_err(hba->dev,
+			"%s:  failed create intr_stats debugfs entry\n",
+			__func__);
+		goto err;
+	}
+
+	hba->debugfs_files.perf_stats =
+	    debugfs_create_file("perf_stats", S_IRUSR | S_IWUSR,
+				hba->debugfs_files.debugfs_root, hba,
+				&ufsdbg_perf_stats_fops);
+	if (!hba->debugfs_files.perf_stats) {
+		dev_err(hba->dev,
+			"%s:  failed create perf_stats debugfs entry\n",
+			__func__);
+		goto err;
+	}
+
+#ifdef CONFIG_SCSI_UFS_HYBRID_POLL
+	hba->debugfs_files.hybrid_poll =
+	    debugfs_create_bool("hybrid_poll", S_IRUSR | S_IWUSR,
+				hba->debugfs_files.debugfs_root,
+				&hba->hpoll_enable);
+	if (!hba->debugfs_files.hybrid_poll) {
+		dev_err(hba->dev,
+			"%s:  failed create hybrid_poll debugfs entry\n",
+			__func__);
+		goto err;
+	}
+#endif
+
+#ifdef CONFIG_SCSI_UFS_IDLE_PRED
+	hba->debugfs_files.idle_pred =
+	    debugfs_create_file("idle_pred", S_IRUSR | S_IWUSR,
+				hba->debugfs_files.debugfs_root, hba,
+				&ufsdbg_idle_pred_fops);
+	if (!hba->debugfs_files.idle_pred) {
+		dev_err(hba->dev,
+			"%s:  failed create idle_pred debugfs entry\n",
+			__func__);
+		goto err;
+	}
+#endif
+
 	if (hba->vops && hba->vops->add_debugfs)
 		hba->vops->add_debugfs(hba, hba->debugfs_files.debugfs_root);
 
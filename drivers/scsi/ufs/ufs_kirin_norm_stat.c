@@ -108,3 +108,367 @@ void ufs_init_hist_all(struct ufshcd_hist *hist_all)
 
 	ufs_init_utp_cmd_hist(&hist_all->utp_cmd_hist);
 }
+
+/*
+ * Host side performance statistics. Unlike the history above they are
+ * cheap enough to stay always on: per cpu latency histograms per UPIU
+ * type and the queue depth seen at issue, plus what hibern8, clock
+ * ungating and power mode changes cost. Commands issued right after the
+ * host woke up are accounted apart, to tell a slow device from a host
+ * that was in hibern8 when the request arrived.
+ */
+static inline int ufs_perf_lat_idx(u64 us)
+{
+	if (!us)
+		return 0;
+
+	return min_t(int, fls64(us), UFS_PERF_LAT_BUCKETS - 1);
+}
+
+static void ufs_perf_lat_add(struct ufs_perf_lat *lat, s64 us)
+{
+	if (us < 0)
+		us = 0;
+
+	lat->buckets[ufs_perf_lat_idx((u64)us)]++;
+	lat->sum_us += (u64)us;
+	if ((u64)us > lat->max_us)
+		lat->max_us = (u32)min_t(u64, (u64)us, U32_MAX);
+}
+
+static void ufs_perf_lat_sum(struct ufs_perf_lat *dst,
+			     const struct ufs_perf_lat *src)
+{
+	int i;
+
+	for (i = 0; i < UFS_PERF_LAT_BUCKETS; i++)
+		dst->buckets[i] += src->buckets[i];
+	dst->sum_us += src->sum_us;
+	dst->max_us = max(dst->max_us, src->max_us);
+}
+
+static enum ufs_perf_op ufs_perf_op(struct ufs_hba *hba,
+				    struct ufshcd_lrb *lrbp)
+{
+	if (NULL == lrbp->cmd)
+		return hba->dev_cmd.type == DEV_CMD_TYPE_NOP ?
+			UFS_PERF_OP_NOP : UFS_PERF_OP_QUERY;
+
+	switch (lrbp->cmd->cmnd[0]) {
+	case READ_6:
+	case READ_10:
+	case READ_16:
+		return UFS_PERF_OP_READ;
+	case WRITE_6:
+	case WRITE_10:
+	case WRITE_16:
+		return UFS_PERF_OP_WRITE;
+	case UNMAP:
+		return UFS_PERF_OP_UNMAP;
+	case SYNCHRONIZE_CACHE:
+		return UFS_PERF_OP_SYNC;
+	default:
+		return UFS_PERF_OP_SCSI;
+	}
+}
+
+/* Called with host_lock held for each completed transfer request */
+void ufs_perf_complete(struct ufs_perf_stats *perf, struct ufs_hba *hba,
+		       struct ufshcd_lrb *lrbp)
+{
+	struct ufs_perf_cpu *pc = this_cpu_ptr(perf->cpu);
+	s64 us = ktime_us_delta(lrbp->complete_time_stamp,
+				lrbp->issue_time_stamp);
+
+	ufs_perf_lat_add(&pc->op_lat[ufs_perf_op(hba, lrbp)], us);
+	if (lrbp->perf_woken)
+		ufs_perf_lat_add(&pc->woken_lat, us);
+}
+
+static inline struct ufs_perf_occ *ufs_perf_occ_slot(struct ufs_perf_occ *occ,
+						     s64 sec)
+{
+	return &occ[(u32)sec % UFS_PERF_OCC_SLOTS];
+}
+
+void ufs_perf_compl_batch(struct ufs_perf_stats *perf, u32 depth, u32 nr)
+{
+	struct ufs_perf_occ *occ;
+	s64 sec = ktime_divns(ktime_get(), NSEC_PER_SEC);
+
+	spin_lock(&perf->lock);
+	occ = ufs_perf_occ_slot(perf->occ, sec);
+	if (occ->sec != sec) {
+		memset(occ, 0, sizeof(*occ));
+		occ->sec = sec;
+	}
+	occ->nr_compl += nr;
+	occ->nr_samples++;
+	occ->depth_sum += depth;
+	occ->depth_max = max(occ->depth_max, depth);
+	/* what was issued from now on didn't wait for the wake up */
+	perf->woken = false;
+	spin_unlock(&perf->lock);
+}
+
+void ufs_perf_h8(struct ufs_hba *hba, bool enter, ktime_t start, int ret)
+{
+	struct ufs_perf_stats *perf = hba->ufs_stats.perf;
+	unsigned long flags;
+
+	if (NULL == perf)
+		return;
+
+	spin_lock_irqsave(&perf->lock, flags);
+	if (ret)
+		enter ? perf->h8_enter_err++ : perf->h8_exit_err++;
+	else
+		ufs_perf_lat_add(enter ? &perf->h8_enter : &perf->h8_exit,
+				 ktime_us_delta(ktime_get(), start));
+	spin_unlock_irqrestore(&perf->lock, flags);
+}
+
+/* A request found the clocks gated, ufshcd_hold() is ungating them */
+void ufs_perf_wake_start(struct ufs_hba *hba)
+{
+	struct ufs_perf_stats *perf = hba->ufs_stats.perf;
+	unsigned long flags;
+
+	if (NULL == perf)
+		return;
+
+	spin_lock_irqsave(&perf->lock, flags);
+	if (!ktime_to_ns(perf->wake_start))
+		perf->wake_start = ktime_get();
+	spin_unlock_irqrestore(&perf->lock, flags);
+}
+
+void ufs_perf_wake_end(struct ufs_hba *hba)
+{
+	struct ufs_perf_stats *perf = hba->ufs_stats.perf;
+	unsigned long flags;
+
+	if (NULL == perf)
+		return;
+
+	spin_lock_irqsave(&perf->lock, flags);
+	if (ktime_to_ns(perf->wake_start)) {
+		ufs_perf_lat_add(&perf->wake,
+				 ktime_us_delta(ktime_get(), perf->wake_start));
+		perf->wake_start = ktime_set(0, 0);
+		perf->woken = true;
+	}
+	spin_unlock_irqrestore(&perf->lock, flags);
+}
+
+void ufs_perf_pwr_change(struct ufs_hba *hba,
+			 const struct ufs_pa_layer_attr *from,
+			 const struct ufs_pa_layer_attr *to,
+			 ktime_t start, int ret)
+{
+	struct ufs_perf_stats *perf = hba->ufs_stats.perf;
+	unsigned long flags;
+
+	if (NULL == perf)
+		return;
+
+	spin_lock_irqsave(&perf->lock, flags);
+	if (ret) {
+		perf->pwr_err++;
+	} else {
+		ufs_perf_lat_add(&perf->pwr,
+				 ktime_us_delta(ktime_get(), start));
+		perf->pwr_from = *from;
+		perf->pwr_to = *to;
+	}
+	spin_unlock_irqrestore(&perf->lock, flags);
+}
+
+void ufs_perf_stats_init(struct ufs_hba *hba)
+{
+	struct ufs_perf_stats *perf;
+
+	perf = kzalloc(sizeof(*perf), GFP_KERNEL);
+	if (NULL == perf)
+		goto fail;
+
+	perf->cpu = alloc_percpu(struct ufs_perf_cpu);
+	if (NULL == perf->cpu) {
+		kfree(perf);
+		goto fail;
+	}
+
+	spin_lock_init(&perf->lock);
+	perf->tstamp = ktime_get();
+	hba->ufs_stats.perf = perf;
+	return;
+
+fail:
+	dev_err(hba->dev, "%s: no memory, perf stats disabled\n", __func__);
+}
+
+void ufs_perf_stats_exit(struct ufs_hba *hba)
+{
+	struct ufs_perf_stats *perf = hba->ufs_stats.perf;
+
+	if (NULL == perf)
+		return;
+
+	hba->ufs_stats.perf = NULL;
+	free_percpu(perf->cpu);
+	kfree(perf);
+}
+
+void ufs_perf_stats_reset(struct ufs_hba *hba)
+{
+	struct ufs_perf_stats *perf = hba->ufs_stats.perf;
+	unsigned long flags;
+	int cpu;
+
+	if (NULL == perf)
+		return;
+
+	/* host_lock keeps completions out, issues may still trickle in */
+	spin_lock_irqsave(hba->host->host_lock, flags);
+	for_each_possible_cpu(cpu)
+		memset(per_cpu_ptr(perf->cpu, cpu), 0,
+		       sizeof(struct ufs_perf_cpu));
+	spin_lock(&perf->lock);
+	memset(&perf->wake, 0, sizeof(perf->wake));
+	memset(&perf->h8_enter, 0, sizeof(perf->h8_enter));
+	memset(&perf->h8_exit, 0, sizeof(perf->h8_exit));
+	memset(&perf->pwr, 0, sizeof(perf->pwr));
+	memset(perf->occ, 0, sizeof(perf->occ));
+	perf->h8_enter_err = 0;
+	perf->h8_exit_err = 0;
+	perf->pwr_err = 0;
+	perf->tstamp = ktime_get();
+	spin_unlock(&perf->lock);
+	spin_unlock_irqrestore(hba->host->host_lock, flags);
+}
+
+/* Upper bound in us of the bucket holding the @permille-th sample */
+static u64 ufs_perf_lat_pct(const struct ufs_perf_lat *lat, u64 nr,
+			    unsigned int permille)
+{
+	u64 target = div_u64(nr * permille + 999, 1000);
+	u64 seen = 0;
+	int i;
+
+	for (i = 0; i < UFS_PERF_LAT_BUCKETS - 1; i++) {
+		seen += lat->buckets[i];
+		if (seen >= target)
+			return 1ULL << i;
+	}
+
+	return lat->max_us;
+}
+
+static void ufs_perf_lat_show(struct seq_file *m, const char *name,
+			      const struct ufs_perf_lat *lat)
+{
+	u64 nr = 0;
+	int i;
+
+	for (i = 0; i < UFS_PERF_LAT_BUCKETS; i++)
+		nr += lat->buckets[i];
+
+	if (!nr)
+		return;
+
+	seq_printf(m, "%-8s %10llu %8llu %8llu %8llu %8llu %8u\n", name, nr,
+		   div64_u64(lat->sum_us, nr), ufs_perf_lat_pct(lat, nr, 500),
+		   ufs_perf_lat_pct(lat, nr, 990),
+		   ufs_perf_lat_pct(lat, nr, 999), lat->max_us);
+}
+
+void ufs_perf_stats_show(struct seq_file *m, struct ufs_hba *hba)
+{
+	static const char * const op_name[UFS_PERF_OP_NR] = {
+		"read", "write", "unmap", "sync", "scsi", "query", "nop",
+	};
+	struct ufs_perf_stats *perf = hba->ufs_stats.perf;
+	struct ufs_perf_lat wake, h8_enter, h8_exit, pwr;
+	struct ufs_pa_layer_attr from, to;
+	struct ufs_perf_cpu *sum, *pc;
+	struct ufs_perf_occ *occ, *o;
+	u32 h8_enter_err, h8_exit_err, pwr_err;
+	unsigned long flags;
+	s64 now, sec;
+	ktime_t tstamp;
+	int cpu, i;
+
+	if (NULL == perf) {
+		seq_puts(m, "perf stats disabled\n");
+		return;
+	}
+
+	sum = kzalloc(sizeof(*sum), GFP_KERNEL);
+	occ = kmalloc(sizeof(perf->occ), GFP_KERNEL);
+	if (NULL == sum || NULL == occ)
+		goto out;
+
+	for_each_possible_cpu(cpu) {
+		pc = per_cpu_ptr(perf->cpu, cpu);
+		for (i = 0; i < UFS_PERF_OP_NR; i++)
+			ufs_perf_lat_sum(&sum->op_lat[i], &pc->op_lat[i]);
+		ufs_perf_lat_sum(&sum->woken_lat, &pc->woken_lat);
+		for (i = 0; i <= UFS_PERF_MAX_DEPTH; i++)
+			sum->depth[i] += pc->depth[i];
+	}
+
+	spin_lock_irqsave(&perf->lock, flags);
+	wake = perf->wake;
+	h8_enter = perf->h8_enter;
+	h8_exit = perf->h8_exit;
+	pwr = perf->pwr;
+	h8_enter_err = perf->h8_enter_err;
+	h8_exit_err = perf->h8_exit_err;
+	pwr_err = perf->pwr_err;
+	from = perf->pwr_from;
+	to = perf->pwr_to;
+	tstamp = perf->tstamp;
+	memcpy(occ, perf->occ, sizeof(perf->occ));
+	spin_unlock_irqrestore(&perf->lock, flags);
+
+	now = ktime_divns(ktime_get(), NSEC_PER_SEC);
+	seq_printf(m, "time: %lld s\n\n", now - ktime_divns(tstamp,
+							    NSEC_PER_SEC));
+
+	seq_printf(m, "%-8s %10s %8s %8s %8s %8s %8s\n", "us", "count",
+		   "mean", "p50", "p99", "p99.9", "max");
+	for (i = 0; i < UFS_PERF_OP_NR; i++)
+		ufs_perf_lat_show(m, op_name[i], &sum->op_lat[i]);
+	/* device latency of what the host had to wake up for */
+	ufs_perf_lat_show(m, "woken", &sum->woken_lat);
+	/* time requests were blocked on clock ungating and hibern8 exit */
+	ufs_perf_lat_show(m, "wake", &wake);
+	ufs_perf_lat_show(m, "h8_enter", &h8_enter);
+	ufs_perf_lat_show(m, "h8_exit", &h8_exit);
+	ufs_perf_lat_show(m, "pwr_chg", &pwr);
+	seq_printf(m, "errors: h8_enter %u h8_exit %u pwr_chg %u\n",
+		   h8_enter_err, h8_exit_err, pwr_err);
+	if (to.gear_rx)
+		seq_printf(m, "last pwr_chg: gear %u/%u mode %u/%u -> gear %u/%u mode %u/%u\n",
+			   from.gear_rx, from.gear_tx, from.pwr_rx, from.pwr_tx,
+			   to.gear_rx, to.gear_tx, to.pwr_rx, to.pwr_tx);
+
+	seq_puts(m, "\ndepth at issue:");
+	for (i = 1; i <= UFS_PERF_MAX_DEPTH; i++)
+		if (sum->depth[i])
+			seq_printf(m, " %d:%u", i, sum->depth[i]);
+	seq_puts(m, "\n\noccupancy (age s, completions, mean depth, max depth):\n");
+	for (i = 0; i < UFS_PERF_OCC_SLOTS; i++) {
+		sec = now - i;
+		o = ufs_perf_occ_slot(occ, sec);
+		if (o->sec != sec || !o->nr_samples)
+			continue;
+		seq_printf(m, "%3d %8u %5u.%02u %3u\n", i, o->nr_compl,
+			   o->depth_sum / o->nr_samples,
+			   o->depth_sum * 100 / o->nr_samples % 100,
+			   o->depth_max);
+	}
+out:
+	kfree(occ);
+	kfree(sum);
+}
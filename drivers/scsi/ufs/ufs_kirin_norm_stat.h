@@ -1,6 +1,9 @@
 #ifndef _UFS_STAT_H_
 #define _UFS_STAT_H_
 
+#include <linux/percpu.h>
+#include <linux/seq_file.h>
+
 
 struct ring_fifo_hist
 {
@@ -206,4 +209,124 @@ static inline void ufs_add_cmd_hist( struct ufs_hba *hba, struct ufshcd_lrb *lrb
 	}
 }
 
+/*
+ * Host side performance statistics, always on. See ufs_kirin_norm_stat.c.
+ */
+enum ufs_perf_op {
+	UFS_PERF_OP_READ,
+	UFS_PERF_OP_WRITE,
+	UFS_PERF_OP_UNMAP,
+	UFS_PERF_OP_SYNC,
+	UFS_PERF_OP_SCSI,	/* any other SCSI command UPIU */
+	UFS_PERF_OP_QUERY,
+	UFS_PERF_OP_NOP,
+	UFS_PERF_OP_NR,
+};
+
+/* bucket 0 is < 1us, bucket n is [2^(n-1), 2^n) us, the last is open */
+#define UFS_PERF_LAT_BUCKETS	20
+#define UFS_PERF_MAX_DEPTH	32
+/* one slot per second */
+#define UFS_PERF_OCC_SLOTS	64
+
+struct ufs_perf_lat {
+	u32 buckets[UFS_PERF_LAT_BUCKETS];
+	u32 max_us;
+	u64 sum_us;
+};
+
+struct ufs_perf_cpu {
+	struct ufs_perf_lat op_lat[UFS_PERF_OP_NR];
+	/* commands issued before the first completion after a wake up */
+	struct ufs_perf_lat woken_lat;
+	/* outstanding requests at issue, the new one included */
+	u32 depth[UFS_PERF_MAX_DEPTH + 1];
+};
+
+/* queue occupancy, sampled at each transfer completion */
+struct ufs_perf_occ {
+	s64 sec;
+	u32 nr_compl;
+	u32 nr_samples;
+	u32 depth_sum;
+	u32 depth_max;
+};
+
+struct ufs_perf_stats {
+	struct ufs_perf_cpu __percpu *cpu;
+
+	/* protects everything below, off the issue path */
+	spinlock_t lock;
+	ktime_t tstamp;
+
+	/* clock ungating and hibern8 exit that requests had to wait for */
+	bool woken;
+	ktime_t wake_start;
+	struct ufs_perf_lat wake;
+
+	struct ufs_perf_lat h8_enter;
+	struct ufs_perf_lat h8_exit;
+	u32 h8_enter_err;
+	u32 h8_exit_err;
+
+	struct ufs_perf_lat pwr;
+	u32 pwr_err;
+	struct ufs_pa_layer_attr pwr_from;
+	struct ufs_pa_layer_attr pwr_to;
+
+	struct ufs_perf_occ occ[UFS_PERF_OCC_SLOTS];
+};
+
+void ufs_perf_stats_init(struct ufs_hba *hba);
+void ufs_perf_stats_exit(struct ufs_hba *hba);
+void ufs_perf_stats_reset(struct ufs_hba *hba);
+void ufs_perf_stats_show(struct seq_file *m, struct ufs_hba *hba);
+
+void ufs_perf_complete(struct ufs_perf_stats *perf, struct ufs_hba *hba,
+		       struct ufshcd_lrb *lrbp);
+void ufs_perf_compl_batch(struct ufs_perf_stats *perf, u32 depth, u32 nr);
+void ufs_perf_h8(struct ufs_hba *hba, bool enter, ktime_t start, int ret);
+void ufs_perf_wake_start(struct ufs_hba *hba);
+void ufs_perf_wake_end(struct ufs_hba *hba);
+void ufs_perf_pwr_change(struct ufs_hba *hba,
+			 const struct ufs_pa_layer_attr *from,
+			 const struct ufs_pa_layer_attr *to,
+			 ktime_t start, int ret);
+
+/* Called right after the doorbell was rung, with irqs off */
+static inline void ufs_perf_issue(struct ufs_hba *hba, struct ufshcd_lrb *lrbp)
+{
+	struct ufs_perf_stats *perf = hba->ufs_stats.perf;
+	u32 depth;
+
+	if (NULL == perf)
+		return;
+
+	lrbp->perf_woken = ACCESS_ONCE(perf->woken);
+	depth = hweight_long(hba->outstanding_reqs);
+	__this_cpu_inc(perf->cpu->depth[min_t(u32, depth, UFS_PERF_MAX_DEPTH)]);
+}
+
+/* Called with host_lock held, before the completed commands are handled */
+static inline void ufs_perf_compl(struct ufs_hba *hba, unsigned long completed)
+{
+	struct ufs_perf_stats *perf = hba->ufs_stats.perf;
+
+	/* the blk-mq partitions clear outstanding_reqs before we get here */
+	if (NULL != perf && completed)
+		ufs_perf_compl_batch(perf,
+				     hweight_long(hba->outstanding_reqs |
+						  completed),
+				     hweight_long(completed));
+}
+
+static inline void ufs_perf_cmd_done(struct ufs_hba *hba,
+				     struct ufshcd_lrb *lrbp)
+{
+	struct ufs_perf_stats *perf = hba->ufs_stats.perf;
+
+	if (NULL != perf)
+		ufs_perf_complete(perf, hba, lrbp);
+}
+
 #endif
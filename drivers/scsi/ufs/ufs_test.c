@@ -417,6 +417,7 @@ static int ufs_test_do_scsi_cmd(struct ufs_hba *hba, struct scsi_cmnd *cmd,
 	lrbp->task_tag = tag;
 	lrbp->lun = lun;
 	lrbp->intr_cmd = !ufshcd_is_intr_aggr_allowed(hba) ? true : false;
+	lrbp->hpoll = false;
 	lrbp->command_type = UTP_CMD_TYPE_SCSI;
 
 	hba->dev_cmd.complete = &wait;
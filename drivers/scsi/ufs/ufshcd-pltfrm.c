@@ -389,6 +389,8 @@ static int ufshcd_pltfrm_probe(struct platform_device *pdev)
 	if (of_find_property(np, "ufs-kirin-disable-pm-runtime", NULL))
 		pm_runtime_forbid(hba->dev);
 	pm_runtime_enable(&pdev->dev);
+	/* link hibern8 and power-down run next to the other slow resumes */
+	device_enable_async_suspend(&pdev->dev);
 
 	err = ufshcd_init(hba, mmio_base, irq);
 	if (err) {
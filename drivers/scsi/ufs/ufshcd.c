@@ -46,6 +46,8 @@
 #include <linux/nls.h>
 #include <linux/kthread.h>
 #include <linux/cpu.h>
+#include <linux/topology.h>
+#include <linux/hisi/hisi_irq_affinity.h>
 #include <linux/hisi-blk-mq.h>
 
 
@@ -248,6 +250,7 @@ static int ufshcd_uic_hibern8_enter(struct ufs_hba *hba);
 static inline void ufshcd_add_delay_before_dme_cmd(struct ufs_hba *hba);
 static int ufshcd_host_reset_and_restore(struct ufs_hba *hba);
 static irqreturn_t ufshcd_intr(int irq, void *__hba);
+static void ufshcd_transfer_req_compl(struct ufs_hba *hba);
 static int ufshcd_config_pwr_mode(struct ufs_hba *hba,
 		struct ufs_pa_layer_attr *desired_pwr_mode);
 int ufshcd_change_power_mode(struct ufs_hba *hba,
@@ -492,7 +495,10 @@ static inline void ufshcd_utrl_clear(struct ufs_hba *hba, u32 pos)
  */
 static inline void ufshcd_outstanding_req_clear(struct ufs_hba *hba, int tag)
 {
-	__clear_bit(tag, &hba->outstanding_reqs);
+	clear_bit(tag, &hba->outstanding_reqs);
+#ifdef CONFIG_SCSI_UFS_HYBRID_POLL
+	clear_bit(tag, &hba->hpoll_reqs);
+#endif
 }
 
 /**
@@ -619,6 +625,39 @@ ufshcd_config_intr_aggr(struct ufs_hba *hba, u8 cnt, u8 tmout)
 		      REG_UTP_TRANSFER_REQ_INT_AGG_CONTROL);
 }
 
+/**
+ * ufshcd_set_intr_aggr - Change the interrupt aggregation values.
+ * @hba: per adapter instance
+ * @cnt: Interrupt aggregation counter threshold, 1 to nutrs - 1
+ * @tmout: Interrupt aggregation timeout value, in 40us units
+ *
+ * The values are kept across host resets.
+ * Returns 0 on success, -EOPNOTSUPP or -EINVAL otherwise.
+ */
+int ufshcd_set_intr_aggr(struct ufs_hba *hba, u8 cnt, u8 tmout)
+{
+	unsigned long flags;
+
+	if (!ufshcd_is_intr_aggr_allowed(hba))
+		return -EOPNOTSUPP;
+
+	if (!cnt || cnt >= hba->nutrs || !tmout)
+		return -EINVAL;
+
+	pm_runtime_get_sync(hba->dev);
+	ufshcd_hold(hba, false);
+	spin_lock_irqsave(hba->host->host_lock, flags);
+	hba->intr_aggr_cnt = cnt;
+	hba->intr_aggr_tmout = tmout;
+	ufshcd_config_intr_aggr(hba, cnt, tmout);
+	spin_unlock_irqrestore(hba->host->host_lock, flags);
+	ufshcd_release(hba);
+	pm_runtime_put_sync(hba->dev);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(ufshcd_set_intr_aggr);
+
 /**
  * ufshcd_disable_intr_aggr - Disables interrupt aggregation.
  * @hba: per adapter instance
@@ -648,6 +687,217 @@ static void ufshcd_disable_auto_hibern8(struct ufs_hba *hba)
 	hba->auto_hibern8_enabled = false;
 }
 
+#ifdef CONFIG_SCSI_UFS_IDLE_PRED
+/* longer gaps are just long, don't let a night off swamp the average */
+#define UFSHCD_IDLE_PRED_GAP_MAX_NS	(1000 * NSEC_PER_MSEC)
+/* hibern8 enter or exit cost until one is measured */
+#define UFSHCD_IDLE_PRED_H8_DEF_NS	(500 * NSEC_PER_USEC)
+/* the idle must pay the transitions back twice to save anything */
+#define UFSHCD_IDLE_PRED_BE_MULT	2
+#define UFSHCD_IDLE_PRED_GATE_MS	1
+/* auto-hibern8 timer scale values */
+#define UFSHCD_AHIT_SCALE_1MS		3
+#define UFSHCD_AHIT_SCALE_100MS		5
+
+/* EWMA with weight 1/8 */
+static inline u64 ufshcd_idle_pred_ewma(u64 avg, u64 sample)
+{
+	return avg ? avg - (avg >> 3) + (sample >> 3) : sample;
+}
+
+u64 ufshcd_idle_pred_be_ns(struct ufs_idle_pred *pred)
+{
+	return UFSHCD_IDLE_PRED_BE_MULT *
+	       (pred->h8_enter_ns + pred->h8_exit_ns);
+}
+EXPORT_SYMBOL_GPL(ufshcd_idle_pred_be_ns);
+
+static inline bool ufshcd_idle_pred_deep(struct ufs_idle_pred *pred)
+{
+	return pred->gap_ns > ufshcd_idle_pred_be_ns(pred);
+}
+
+/* Clocks must be on. Leaves auto-hibern8 alone if someone turned it off */
+static void ufshcd_idle_pred_write_ahit(struct ufs_hba *hba, u32 ts, u32 itv)
+{
+	u32 ahit = AUTO_HIBERN8_TIMER_SCALE_VAL(ts) |
+		   AUTO_HIBERN8_IDLE_TIMER_VAL(itv);
+	u32 cur;
+
+	if (!hba->auto_hibern8_enabled)
+		return;
+
+	cur = ufshcd_readl(hba, REG_CONTROLLER_AHIT);
+	if (AUTO_HIBERN8_IDLE_TIMER_VAL(cur) && cur != ahit)
+		ufshcd_writel(hba, ahit, REG_CONTROLLER_AHIT);
+}
+
+/*
+ * A deep idle enters hibern8 after 1ms instead of the configured timer,
+ * a shallow one holds it off ten times longer so that the next burst
+ * finds the link active.
+ */
+static void ufshcd_idle_pred_set_ahit(struct ufs_hba *hba, bool deep)
+{
+	u32 ts = hba->ahit_ts;
+	u32 itv = hba->ahit_ah8itv;
+
+	if (deep && ts >= UFSHCD_AHIT_SCALE_1MS) {
+		ts = UFSHCD_AHIT_SCALE_1MS;
+		itv = 1;
+	} else if (!deep && ts < UFSHCD_AHIT_SCALE_100MS) {
+		ts++;
+	}
+	ufshcd_idle_pred_write_ahit(hba, ts, itv);
+}
+
+/* Completion path, host_lock held */
+static void ufshcd_idle_pred_idle(struct ufs_hba *hba)
+{
+	struct ufs_idle_pred *pred = &hba->idle_pred;
+	bool deep;
+
+	if (!pred->enable || hba->outstanding_reqs)
+		return;
+
+	spin_lock(&pred->lock);
+	if (pred->idle)
+		goto unlock;
+	pred->idle = true;
+	/* pairs with the barrier in ufshcd_idle_pred_busy() */
+	smp_mb();
+	if (hba->outstanding_reqs) {
+		pred->idle = false;
+		goto unlock;
+	}
+	pred->idle_start = ktime_get();
+	pred->deep = deep = ufshcd_idle_pred_deep(pred);
+	spin_unlock(&pred->lock);
+
+	ufshcd_idle_pred_set_ahit(hba, deep);
+	return;
+unlock:
+	spin_unlock(&pred->lock);
+}
+
+/* Issue path, after the tag was set in outstanding_reqs */
+static void ufshcd_idle_pred_busy(struct ufs_hba *hba)
+{
+	struct ufs_idle_pred *pred = &hba->idle_pred;
+	unsigned long flags;
+	u64 gap, err;
+	bool deep;
+
+	/* pairs with the barrier in ufshcd_idle_pred_idle() */
+	smp_mb__after_atomic();
+	if (!READ_ONCE(pred->idle))
+		return;
+
+	spin_lock_irqsave(&pred->lock, flags);
+	if (!pred->idle)
+		goto unlock;
+	pred->idle = false;
+
+	gap = min_t(u64, ktime_to_ns(ktime_sub(ktime_get(), pred->idle_start)),
+		    UFSHCD_IDLE_PRED_GAP_MAX_NS);
+	deep = gap > ufshcd_idle_pred_be_ns(pred);
+	if (pred->deep && deep)
+		pred->deep_hit++;
+	else if (pred->deep)
+		pred->deep_miss++;
+	else if (deep)
+		pred->shallow_miss++;
+	else
+		pred->shallow_hit++;
+
+	err = gap > pred->gap_ns ? gap - pred->gap_ns : pred->gap_ns - gap;
+	pred->err_us += div_u64(err, NSEC_PER_USEC);
+	pred->gap_ns = ufshcd_idle_pred_ewma(pred->gap_ns, gap);
+unlock:
+	spin_unlock_irqrestore(&pred->lock, flags);
+}
+
+static void ufshcd_idle_pred_h8(struct ufs_hba *hba, bool enter,
+				ktime_t start, int ret)
+{
+	struct ufs_idle_pred *pred = &hba->idle_pred;
+	u64 *cost = enter ? &pred->h8_enter_ns : &pred->h8_exit_ns;
+	unsigned long flags;
+	u64 ns;
+
+	if (ret)
+		return;
+
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	spin_lock_irqsave(&pred->lock, flags);
+	*cost = ufshcd_idle_pred_ewma(*cost, ns);
+	spin_unlock_irqrestore(&pred->lock, flags);
+}
+
+/* host_lock held */
+static unsigned long ufshcd_idle_pred_gate_delay(struct ufs_hba *hba)
+{
+	struct ufs_idle_pred *pred = &hba->idle_pred;
+
+	if (pred->enable && ufshcd_idle_pred_deep(pred))
+		return min_t(unsigned long, hba->clk_gating.delay_ms,
+			     UFSHCD_IDLE_PRED_GATE_MS);
+	return hba->clk_gating.delay_ms;
+}
+
+/**
+ * ufshcd_idle_pred_enable - Turn the idle time predictor on or off.
+ * @hba: per adapter instance
+ * @enable: adapt the idle power policy to the prediction
+ *
+ * The prediction statistics are reset, the configured auto-hibern8 timer
+ * is restored when turning the predictor off.
+ */
+void ufshcd_idle_pred_enable(struct ufs_hba *hba, bool enable)
+{
+	struct ufs_idle_pred *pred = &hba->idle_pred;
+	unsigned long flags;
+
+	pm_runtime_get_sync(hba->dev);
+	ufshcd_hold(hba, false);
+	spin_lock_irqsave(hba->host->host_lock, flags);
+	spin_lock(&pred->lock);
+	pred->enable = enable;
+	pred->idle = false;
+	pred->deep_hit = pred->deep_miss = 0;
+	pred->shallow_hit = pred->shallow_miss = 0;
+	pred->err_us = 0;
+	spin_unlock(&pred->lock);
+	if (!enable)
+		ufshcd_idle_pred_write_ahit(hba, hba->ahit_ts,
+					    hba->ahit_ah8itv);
+	spin_unlock_irqrestore(hba->host->host_lock, flags);
+	ufshcd_release(hba);
+	pm_runtime_put_sync(hba->dev);
+}
+EXPORT_SYMBOL_GPL(ufshcd_idle_pred_enable);
+
+static void ufshcd_idle_pred_init(struct ufs_hba *hba)
+{
+	struct ufs_idle_pred *pred = &hba->idle_pred;
+
+	spin_lock_init(&pred->lock);
+	pred->h8_enter_ns = UFSHCD_IDLE_PRED_H8_DEF_NS;
+	pred->h8_exit_ns = UFSHCD_IDLE_PRED_H8_DEF_NS;
+	pred->enable = true;
+}
+#else
+static inline void ufshcd_idle_pred_idle(struct ufs_hba *hba) {}
+static inline void ufshcd_idle_pred_busy(struct ufs_hba *hba) {}
+static inline void ufshcd_idle_pred_h8(struct ufs_hba *hba, bool enter,
+				       ktime_t start, int ret) {}
+static inline unsigned long ufshcd_idle_pred_gate_delay(struct ufs_hba *hba)
+{
+	return hba->clk_gating.delay_ms;
+}
+static inline void ufshcd_idle_pred_init(struct ufs_hba *hba) {}
+#endif
+
 /**
  * ufshcd_enable_run_stop_reg - Enable run-stop registers,
  *			When run-stop registers are set to 1, it indicates the
@@ -705,12 +955,403 @@ static int ufshcd_hba_uie_init(struct ufs_hba *hba)
 #endif
 
 #ifdef CONFIG_SCSI_HISI_MQ
+/* Called with the lock protecting @nr_read and @nr_write held */
+static void ufshcd_mq_account_issue(struct ufs_hba *hba, struct request *rq,
+				    int *nr_read, int *nr_write)
+{
+	if (rq->cmd_type == REQ_TYPE_FS) {
+		if (rq->cmd_flags & REQ_WRITE) {
+			hba->continue_read = 0;
+			(*nr_write)++;
+			if (rq->cmd_flags & REQ_SYNC) {
+				hba->continue_sync_write++;
+				hba->continue_sync_io++;
+				hba->continue_async_write = 0;
+			} else {
+				hba->continue_async_write++;
+				hba->continue_sync_io = 0;
+				hba->continue_sync_write = 0;
+			}
+		} else {
+			(*nr_read)++;
+			hba->continue_read++;
+			hba->continue_sync_io++;
+			hba->continue_sync_write = 0;
+			hba->continue_async_write = 0;
+		}
+	}
+	if (hba->outstanding_reqs == 0)
+		del_timer(&hba->continue_idle_check);
+	hba->continue_idle = 0;
+}
+
+/* Called with the lock protecting @nr_read and @nr_write held */
+static void ufshcd_mq_account_done(struct ufs_hba *hba, struct request *rq,
+				   int *nr_read, int *nr_write)
+{
+	if (rq->cmd_type != REQ_TYPE_FS)
+		return;
+
+	if (rq->cmd_flags & REQ_WRITE) {
+		if (*nr_write) {
+			(*nr_write)--;
+		} else {
+			dev_err(hba->dev, "UFS MQ: <%s>  hba->processing_write has been zero! \r\n",
+				__func__);
+#ifdef CONFIG_HISI_MQ_DEBUG
+			BUG();
+#endif
+		}
+	} else {
+		if (*nr_read) {
+			(*nr_read)--;
+		} else {
+			dev_err(hba->dev, "UFS MQ: <%s>  &hba->processing_read has been zero! \r\n",
+				__func__);
+#ifdef CONFIG_HISI_MQ_DEBUG
+			BUG();
+#endif
+		}
+	}
+}
+#endif
+
+#ifdef CONFIG_SCSI_UFS_MQ_PARTITION
+/* irq steering samples the issuing clusters this often */
+#define UFSHCD_MQ_IRQ_STEER_MS		100
+/* with fewer commands per sample the irq stays where it is */
+#define UFSHCD_MQ_IRQ_STEER_MIN		64
+
+static inline bool ufshcd_mq_part_enabled(struct ufs_hba *hba)
+{
+	return hba->nr_mq_parts > 0;
+}
+
+static inline int ufshcd_mq_cpu_part(struct ufs_hba *hba, int cpu)
+{
+	return max(topology_physical_package_id(cpu), 0) % hba->nr_mq_parts;
+}
+
+static inline struct ufshcd_mq_part *ufshcd_mq_tag_part(struct ufs_hba *hba,
+							int tag)
+{
+	return &hba->mq_part[min(tag / hba->mq_part_size,
+				 hba->nr_mq_parts - 1)];
+}
+
+/*
+ * Grab a free slot, from the partition of the submitting cluster first so
+ * that each partition lock is mostly taken by the cpus of one cluster.
+ * Dev commands take their tags with test_and_set_bit_lock() on lrb_in_use
+ * as well, so no lock is needed here.
+ */
+static int ufshcd_mq_get_tag(struct ufs_hba *hba)
+{
+	int first = ufshcd_mq_cpu_part(hba, raw_smp_processor_id());
+	struct ufshcd_mq_part *part;
+	int i, tag;
+
+	for (i = 0; i < hba->nr_mq_parts; i++) {
+		part = &hba->mq_part[(first + i) % hba->nr_mq_parts];
+		tag = part->start;
+		while ((tag = find_next_zero_bit(&hba->lrb_in_use, part->end,
+						 tag)) < part->end) {
+			if (!test_and_set_bit_lock(tag, &hba->lrb_in_use))
+				return tag;
+			tag++;
+		}
+	}
+
+	return -1;
+}
+
+/*
+ * ufshcd_queuecommand() without host_lock: returns the acquired tag,
+ * -EBUSY to requeue the command or -EIO if it was completed with an error.
+ * The state is only sampled here, ufshcd_mq_part_issue() checks it again
+ * under the partition lock.
+ */
+static int ufshcd_mq_part_get_tag(struct ufs_hba *hba, struct scsi_cmnd *cmd)
+{
+	int tag;
+
+	switch (ACCESS_ONCE(hba->ufshcd_state)) {
+	case UFSHCD_STATE_OPERATIONAL:
+		break;
+	case UFSHCD_STATE_RESET:
+		return -EBUSY;
+	case UFSHCD_STATE_ERROR:
+		set_host_byte(cmd, DID_ERROR);
+		cmd->scsi_done(cmd);
+		return -EIO;
+	default:
+		dev_WARN_ONCE(hba->dev, 1, "%s: invalid state %d\n",
+				__func__, hba->ufshcd_state);
+		set_host_byte(cmd, DID_BAD_TARGET);
+		cmd->scsi_done(cmd);
+		return -EIO;
+	}
+
+	if (ufshcd_eh_in_progress(hba)) {
+		set_host_byte(cmd, DID_ERROR);
+		cmd->scsi_done(cmd);
+		return -EIO;
+	}
+
+	tag = ufshcd_mq_get_tag(hba);
+	if (tag < 0)
+		return -EBUSY;
+
+	cmd->tag = (unsigned char)tag;
+	return tag;
+}
+
+static void ufshcd_mq_irq_kick(struct ufs_hba *hba)
+{
+	if (!test_bit(0, &hba->mq_irq_steering) &&
+	    !test_and_set_bit(0, &hba->mq_irq_steering))
+		schedule_delayed_work(&hba->mq_irq_work,
+				msecs_to_jiffies(UFSHCD_MQ_IRQ_STEER_MS));
+}
+
+/* Ring the doorbell for @tag, under its partition lock instead of host_lock */
+static int ufshcd_mq_part_issue(struct ufs_hba *hba, struct scsi_cmnd *cmd,
+				int tag)
+{
+	struct ufshcd_mq_part *part = ufshcd_mq_tag_part(hba, tag);
+	struct ufshcd_lrb *lrbp = &hba->lrb[tag];
+	unsigned long flags;
+	int err;
+
+	spin_lock_irqsave(&part->lock, flags);
+	while (hba->is_hibernate) {
+		spin_unlock_irqrestore(&part->lock, flags);
+		dev_info(hba->dev, "warring send cmd in H8, %s\n", __func__);
+		WARN_ON(1);
+		err = ufshcd_uic_hibern8_exit(hba);
+		if (err) {
+			lrbp->cmd = NULL;
+			clear_bit_unlock(tag, &hba->lrb_in_use);
+			return err;
+		}
+		spin_lock_irqsave(&part->lock, flags);
+	}
+
+	/* the reset path syncs with us through ufshcd_mq_part_sync() */
+	if (hba->ufshcd_state != UFSHCD_STATE_OPERATIONAL ||
+	    ufshcd_eh_in_progress(hba)) {
+		spin_unlock_irqrestore(&part->lock, flags);
+		lrbp->cmd = NULL;
+		clear_bit_unlock(tag, &hba->lrb_in_use);
+		pm_runtime_put_autosuspend(hba->dev);
+		ufshcd_release(hba);
+		return SCSI_MLQUEUE_HOST_BUSY;
+	}
+
+	ufshcd_mq_account_issue(hba, cmd->request, &part->nr_read,
+				&part->nr_write);
+	part->nr_issued++;
+	ufshcd_send_command(hba, tag);
+	spin_unlock_irqrestore(&part->lock, flags);
+
+	ufshcd_mq_irq_kick(hba);
+	return 0;
+}
+
+/*
+ * Called with host_lock held. All partition locks are taken so that no
+ * issuer is between setting its outstanding_reqs bit and ringing the
+ * doorbell. The bits are cleared here, before the completed slots are
+ * released, since a released slot may be reissued right away.
+ */
+static unsigned long ufshcd_mq_part_completed(struct ufs_hba *hba)
+{
+	struct ufshcd_mq_part *part;
+	struct scsi_cmnd *cmd;
+	unsigned long completed;
+	int i, tag;
+
+	for (i = 0; i < hba->nr_mq_parts; i++)
+		spin_lock_nested(&hba->mq_part[i].lock, i);
+
+	completed = ufshcd_readl(hba, REG_UTP_TRANSFER_REQ_DOOR_BELL) ^
+		    hba->outstanding_reqs;
+	for_each_set_bit(tag, &completed, hba->nutrs) {
+		clear_bit(tag, &hba->outstanding_reqs);
+
+		cmd = hba->lrb[tag].cmd;
+		if (!cmd || !cmd->request ||
+		    hba->lrb[tag].command_type == UTP_CMD_TYPE_DEV_MANAGE)
+			continue;
+		part = ufshcd_mq_tag_part(hba, tag);
+		ufshcd_mq_account_done(hba, cmd->request, &part->nr_read,
+				       &part->nr_write);
+	}
+
+	for (i = hba->nr_mq_parts - 1; i >= 0; i--)
+		spin_unlock(&hba->mq_part[i].lock);
+
+	return completed;
+}
+
+/*
+ * Called after the state left OPERATIONAL: waits for the issuers that
+ * sampled the old state, so that their commands are in outstanding_reqs
+ * before the reset looks at it.
+ */
+static void ufshcd_mq_part_sync(struct ufs_hba *hba)
+{
+	unsigned long flags;
+	int i;
+
+	for (i = 0; i < hba->nr_mq_parts; i++) {
+		spin_lock_irqsave(&hba->mq_part[i].lock, flags);
+		spin_unlock_irqrestore(&hba->mq_part[i].lock, flags);
+	}
+}
+
+static int ufshcd_mq_part_cpu(struct ufs_hba *hba, int idx)
+{
+	int cpu;
+
+	for_each_online_cpu(cpu)
+		if (ufshcd_mq_cpu_part(hba, cpu) == idx)
+			return cpu;
+
+	return nr_cpu_ids;
+}
+
+/*
+ * There is one completion irq. Keep it on the cluster that issues most of
+ * the commands, blk-mq then completes most requests without an IPI.
+ */
+static void ufshcd_mq_irq_work(struct work_struct *work)
+{
+	struct ufs_hba *hba = container_of(to_delayed_work(work),
+					   struct ufs_hba, mq_irq_work);
+	struct ufshcd_mq_part *part;
+	unsigned long issued, best = 0, total = 0;
+	int i, busiest = 0, cpu;
+
+	for (i = 0; i < hba->nr_mq_parts; i++) {
+		part = &hba->mq_part[i];
+		spin_lock_irq(&part->lock);
+		issued = part->nr_issued;
+		part->nr_issued = 0;
+		spin_unlock_irq(&part->lock);
+
+		total += issued;
+		if (issued > best) {
+			best = issued;
+			busiest = i;
+		}
+	}
+
+	if (total < UFSHCD_MQ_IRQ_STEER_MIN) {
+		/* idle, the next command restarts sampling */
+		clear_bit(0, &hba->mq_irq_steering);
+		return;
+	}
+
+	if (busiest != hba->mq_irq_part && best * 2 > total) {
+		cpu = ufshcd_mq_part_cpu(hba, busiest);
+		if (cpu < nr_cpu_ids &&
+		    !hisi_irqaffinity_register(hba->irq, cpu))
+			hba->mq_irq_part = busiest;
+	}
+
+	schedule_delayed_work(&hba->mq_irq_work,
+			      msecs_to_jiffies(UFSHCD_MQ_IRQ_STEER_MS));
+}
+
+/* One partition of the UTRD slots per cpu cluster, for blk-mq only */
+static void ufshcd_mq_part_init(struct ufs_hba *hba)
+{
+	struct ufshcd_mq_part *part;
+	int cpu, i, nr = 1;
+
+	/* clock scaling busy time accounting relies on host_lock */
+	if (!hba->host->use_blk_mq || ufshcd_is_clkscaling_enabled(hba))
+		return;
+
+	for_each_possible_cpu(cpu)
+		nr = max(nr, topology_physical_package_id(cpu) + 1);
+	nr = min(nr, UFSHCD_MAX_MQ_PARTS);
+
+	hba->mq_part_size = hba->nutrs / nr;
+	for (i = 0; i < nr; i++) {
+		part = &hba->mq_part[i];
+		spin_lock_init(&part->lock);
+		part->start = i * hba->mq_part_size;
+		part->end = (i == nr - 1) ? hba->nutrs :
+					    part->start + hba->mq_part_size;
+	}
+
+	hba->mq_irq_part = -1;
+	INIT_DELAYED_WORK(&hba->mq_irq_work, ufshcd_mq_irq_work);
+	hba->nr_mq_parts = nr;
+
+	dev_info(hba->dev, "%d transfer request slot partitions\n", nr);
+}
+
+static void ufshcd_mq_part_exit(struct ufs_hba *hba)
+{
+	if (ufshcd_mq_part_enabled(hba))
+		cancel_delayed_work_sync(&hba->mq_irq_work);
+}
+#else
+static inline bool ufshcd_mq_part_enabled(struct ufs_hba *hba)
+{
+	return false;
+}
+static inline int ufshcd_mq_part_get_tag(struct ufs_hba *hba,
+					 struct scsi_cmnd *cmd)
+{
+	return -EBUSY;
+}
+static inline int ufshcd_mq_part_issue(struct ufs_hba *hba,
+				       struct scsi_cmnd *cmd, int tag)
+{
+	return SCSI_MLQUEUE_HOST_BUSY;
+}
+static inline unsigned long ufshcd_mq_part_completed(struct ufs_hba *hba)
+{
+	return 0;
+}
+static inline void ufshcd_mq_part_sync(struct ufs_hba *hba) {}
+static inline void ufshcd_mq_part_init(struct ufs_hba *hba) {}
+static inline void ufshcd_mq_part_exit(struct ufs_hba *hba) {}
+#endif
+
+#ifdef CONFIG_SCSI_HISI_MQ
+static void ufshcd_mq_processing(struct ufs_hba *hba, int *nr_read,
+				 int *nr_write)
+{
+#ifdef CONFIG_SCSI_UFS_MQ_PARTITION
+	int i;
+
+	if (ufshcd_mq_part_enabled(hba)) {
+		*nr_read = 0;
+		*nr_write = 0;
+		for (i = 0; i < hba->nr_mq_parts; i++) {
+			*nr_read += ACCESS_ONCE(hba->mq_part[i].nr_read);
+			*nr_write += ACCESS_ONCE(hba->mq_part[i].nr_write);
+		}
+		return;
+	}
+#endif
+	*nr_read = hba->processing_read;
+	*nr_write = hba->processing_write;
+}
+
 static void ufshcd_continue_idle_confirm(unsigned long data)
 {
 	struct ufs_hba *hba = (struct ufs_hba *)data;
 	unsigned long flags = 0;
+	int nr_read, nr_write;
 	spin_lock_irqsave(hba->host->host_lock, flags);/*lint !e550*/
-	if(hba->processing_read !=0 ||hba->processing_write!=0){
+	ufshcd_mq_processing(hba, &nr_read, &nr_write);
+	if (nr_read != 0 || nr_write != 0) {
 		spin_unlock_irqrestore(hba->host->host_lock, flags);/*lint !e550*/
 		return;
 	}
@@ -757,6 +1398,7 @@ static void ufshcd_ungate_work(struct work_struct *work)
 unblock_reqs:
 	if (ufshcd_is_clkscaling_enabled(hba))
 		devfreq_resume_device(hba->devfreq);
+	ufs_perf_wake_end(hba);
 	scsi_unblock_requests(hba->host);
 }
 
@@ -791,6 +1433,7 @@ start:
 		 * work and to enable clocks.
 		 */
 	case CLKS_OFF:
+		ufs_perf_wake_start(hba);
 		scsi_block_requests(hba->host);
 		hba->clk_gating.state = REQ_CLKS_ON;
 		schedule_work(&hba->clk_gating.ungate_work);
@@ -897,7 +1540,7 @@ static void __ufshcd_release(struct ufs_hba *hba)
 
 	hba->clk_gating.state = REQ_CLKS_OFF;
 	schedule_delayed_work(&hba->clk_gating.gate_work,
-			msecs_to_jiffies(hba->clk_gating.delay_ms));
+			msecs_to_jiffies(ufshcd_idle_pred_gate_delay(hba)));
 }
 
 void ufshcd_release(struct ufs_hba *hba)
@@ -994,17 +1637,141 @@ static void ufshcd_clk_scaling_update_busy(struct ufs_hba *hba)
  * @task_tag: Task tag of the command
  */
 inline
+/* Foreground reads are latency bound, don't hold them back for aggregation */
+static inline bool ufshcd_is_fg_read(struct scsi_cmnd *cmd)
+{
+	struct request *rq = cmd->request;
+
+	return rq && rq->cmd_type == REQ_TYPE_FS && rq_data_dir(rq) == READ &&
+	       (rq->cmd_flags & REQ_FG);
+}
+
+#ifdef CONFIG_SCSI_UFS_HYBRID_POLL
+/* about one blk-stat window */
+#define UFSHCD_HPOLL_LAT_REFRESH_MS	128
+/* polls after the first one, a slice of the expected latency apart */
+#define UFSHCD_HPOLL_MAX_CHECKS		8
+#define UFSHCD_HPOLL_SLICES		8
+#define UFSHCD_HPOLL_MIN_INTERVAL_NS	2000
+
+/*
+ * A polled command stays in interrupt aggregation. The first poll comes
+ * after half the mean foreground read latency, then a few more follow at
+ * short intervals; whatever is still pending after that is completed by
+ * the aggregation timeout.
+ */
+static bool ufshcd_hpoll_want(struct ufs_hba *hba, struct scsi_cmnd *cmd)
+{
+	ktime_t now;
+
+	if (!hba->hpoll_enable)
+		return false;
+
+	/* racy, a stale value only mistimes a poll */
+	now = ktime_get();
+	if (ktime_ms_delta(now, hba->hpoll_lat_tstamp) >=
+	    UFSHCD_HPOLL_LAT_REFRESH_MS) {
+		hba->hpoll_lat_ns = blk_queue_fg_read_lat(cmd->request->q);
+		hba->hpoll_lat_tstamp = now;
+	}
+
+	return hba->hpoll_lat_ns != 0;
+}
+
+/* Called right after the doorbell was rung for @tag */
+static void ufshcd_hpoll_arm(struct ufs_hba *hba, unsigned int tag)
+{
+	set_bit(tag, &hba->hpoll_reqs);
+
+	/* a running timer re-arms itself while there is something to poll */
+	if (!hrtimer_active(&hba->hpoll_timer)) {
+		hba->hpoll_checks = 0;
+		hrtimer_start(&hba->hpoll_timer,
+			      ns_to_ktime(hba->hpoll_lat_ns / 2),
+			      HRTIMER_MODE_REL);
+	}
+}
+
+/* Called with host_lock held for every completed tag */
+static inline void ufshcd_hpoll_done(struct ufs_hba *hba, int tag)
+{
+	if (test_and_clear_bit(tag, &hba->hpoll_reqs))
+		hba->ufs_stats.hpoll_cnt++;
+}
+
+static enum hrtimer_restart ufshcd_hpoll_fn(struct hrtimer *timer)
+{
+	struct ufs_hba *hba = container_of(timer, struct ufs_hba, hpoll_timer);
+	unsigned long flags, done;
+	u64 interval;
+
+	spin_lock_irqsave(hba->host->host_lock, flags);
+	/* the irq takes over while the error handler owns the host */
+	if (!hba->hpoll_reqs ||
+	    hba->ufshcd_state != UFSHCD_STATE_OPERATIONAL ||
+	    ufshcd_eh_in_progress(hba))
+		goto out;
+
+	done = hba->hpoll_reqs &
+	       ~ufshcd_readl(hba, REG_UTP_TRANSFER_REQ_DOOR_BELL);
+	if (done) {
+		hba->ufs_stats.hpoll_hit_cnt += hweight_long(done);
+		ufshcd_transfer_req_compl(hba);
+	}
+
+	/*
+	 * Restarted by hand rather than with HRTIMER_RESTART, the issue
+	 * path may start the timer while this callback runs.
+	 */
+	if (hba->hpoll_reqs && ++hba->hpoll_checks < UFSHCD_HPOLL_MAX_CHECKS) {
+		interval = max_t(u64, hba->hpoll_lat_ns / UFSHCD_HPOLL_SLICES,
+				 UFSHCD_HPOLL_MIN_INTERVAL_NS);
+		hrtimer_start(timer, ns_to_ktime(interval), HRTIMER_MODE_REL);
+	}
+out:
+	spin_unlock_irqrestore(hba->host->host_lock, flags);
+	return HRTIMER_NORESTART;
+}
+
+static void ufshcd_hpoll_init(struct ufs_hba *hba)
+{
+	hrtimer_init(&hba->hpoll_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	hba->hpoll_timer.function = ufshcd_hpoll_fn;
+	hba->hpoll_enable = true;
+}
+
+static void ufshcd_hpoll_exit(struct ufs_hba *hba)
+{
+	hrtimer_cancel(&hba->hpoll_timer);
+}
+#else
+static inline bool ufshcd_hpoll_want(struct ufs_hba *hba,
+				     struct scsi_cmnd *cmd)
+{
+	return false;
+}
+static inline void ufshcd_hpoll_arm(struct ufs_hba *hba, unsigned int tag) {}
+static inline void ufshcd_hpoll_done(struct ufs_hba *hba, int tag) {}
+static inline void ufshcd_hpoll_init(struct ufs_hba *hba) {}
+static inline void ufshcd_hpoll_exit(struct ufs_hba *hba) {}
+#endif
+
 void ufshcd_send_command(struct ufs_hba *hba, unsigned int task_tag)
 {
 	hba->lrb[task_tag].issue_time_stamp = ktime_get();
 	hba->lrb[task_tag].complete_time_stamp = ktime_set(0, 0);
 
 	ufshcd_clk_scaling_start_busy(hba);
-	__set_bit(task_tag, &hba->outstanding_reqs);
+	/* atomic, blk-mq partitions issue without host_lock */
+	set_bit(task_tag, &hba->outstanding_reqs);
+	ufshcd_idle_pred_busy(hba);
 	ufshcd_writel(hba, 1 << task_tag, REG_UTP_TRANSFER_REQ_DOOR_BELL);
 	/* Make sure that doorbell is committed immediately */
 	wmb();
 	UFSHCD_UPDATE_TAG_STATS(hba, task_tag);
+	ufs_perf_issue(hba, &hba->lrb[task_tag]);
+	if (hba->lrb[task_tag].hpoll)
+		ufshcd_hpoll_arm(hba, task_tag);
 
 }
 EXPORT_SYMBOL(ufshcd_send_command);
@@ -1783,6 +2550,13 @@ static int ufshcd_queuecommand(struct Scsi_Host *host, struct scsi_cmnd *cmd)
 
 	hba = shost_priv(host);
 
+	if (ufshcd_mq_part_enabled(hba)) {
+		tag = ufshcd_mq_part_get_tag(hba, cmd);
+		if (tag < 0)
+			return tag == -EBUSY ? SCSI_MLQUEUE_HOST_BUSY : 0;
+		goto hold;
+	}
+
 	if(!host->use_blk_mq){
 		tag = cmd->request->tag;
 		if (!ufshcd_valid_tag(hba, tag)) {
@@ -1860,6 +2634,7 @@ static int ufshcd_queuecommand(struct Scsi_Host *host, struct scsi_cmnd *cmd)
 		spin_unlock_irqrestore(hba->host->host_lock, flags);
 	}
 
+hold:
 	err = ufshcd_hold(hba, true);
 	if (err) {
 		err = SCSI_MLQUEUE_HOST_BUSY;
@@ -1870,6 +2645,9 @@ static int ufshcd_queuecommand(struct Scsi_Host *host, struct scsi_cmnd *cmd)
 
 	/*lint -save -e550 -e774 -e730*/
 	do {
+		/* checked again in ufshcd_mq_part_issue() */
+		if (ufshcd_mq_part_enabled(hba))
+			break;
 		spin_lock_irqsave(hba->host->host_lock, flags);
 		if (work_pending(&hba->eh_work) ||
 		    hba->ufshcd_state == UFSHCD_STATE_RESET ||
@@ -1903,6 +2681,11 @@ static int ufshcd_queuecommand(struct Scsi_Host *host, struct scsi_cmnd *cmd)
 	lrbp->task_tag = tag;
 	lrbp->lun = ufshcd_scsi_to_upiu_lun(cmd->device->lun);
 	lrbp->intr_cmd = !ufshcd_is_intr_aggr_allowed(hba) ? true : false;
+	lrbp->hpoll = false;
+	if (!lrbp->intr_cmd && ufshcd_is_fg_read(cmd)) {
+		lrbp->hpoll = ufshcd_hpoll_want(hba, cmd);
+		lrbp->intr_cmd = !lrbp->hpoll;
+	}
 	lrbp->command_type = UTP_CMD_TYPE_SCSI;
 
 	/*rpmb request issue, and pm_runtime delay time reset longer, after 1 second pm_runtime delay time recover*/
@@ -1924,6 +2707,9 @@ static int ufshcd_queuecommand(struct Scsi_Host *host, struct scsi_cmnd *cmd)
 
 	/* issue command to the controller */
 
+	if (ufshcd_mq_part_enabled(hba))
+		return ufshcd_mq_part_issue(hba, cmd, tag);
+
 	spin_lock_irqsave(hba->host->host_lock, flags);
 	/*lint -save -e40 -e1055 -e550 -e801 -e717*/
 	while (hba->is_hibernate) {
@@ -1941,34 +2727,10 @@ static int ufshcd_queuecommand(struct Scsi_Host *host, struct scsi_cmnd *cmd)
 
 	/*lint -restore*/
 #ifdef CONFIG_SCSI_HISI_MQ
-	if(host->use_blk_mq){
-		if(cmd->request->cmd_type == REQ_TYPE_FS ){
-			if(cmd->request->cmd_flags & REQ_WRITE){
-				hba->continue_read = 0;
-				hba->processing_write++;
-				if(cmd->request->cmd_flags & REQ_SYNC) {
-					hba->continue_sync_write++;
-					hba->continue_sync_io++;
-					hba->continue_async_write = 0;
-				}
-				else {
-					hba->continue_async_write++;
-					hba->continue_sync_io = 0;
-					hba->continue_sync_write = 0;
-				}
-			}else{
-				hba->processing_read++;
-				hba->continue_read++;
-				hba->continue_sync_io++;
-				hba->continue_sync_write = 0;
-				hba->continue_async_write = 0;
-			}
-		}
-		if(hba->outstanding_reqs == 0){
-			del_timer(&hba->continue_idle_check);
-		}
-		hba->continue_idle = 0;
-	}
+	if (host->use_blk_mq)
+		ufshcd_mq_account_issue(hba, cmd->request,
+					&hba->processing_read,
+					&hba->processing_write);
 #ifdef CONFIG_HISI_MQ_DEBUG
 #if 0
 	{
@@ -1998,6 +2760,7 @@ static int ufshcd_compose_dev_cmd(struct ufs_hba *hba,
 	lrbp->lun = 0; /* device management cmd is not specific to any LUN */
 	lrbp->command_type = UTP_CMD_TYPE_DEV_MANAGE;
 	lrbp->intr_cmd = true; /* No interrupt aggregation */
+	lrbp->hpoll = false;
 	hba->dev_cmd.type = cmd_type;
 
 	return ufshcd_compose_upiu(hba, lrbp);
@@ -3359,6 +4122,7 @@ static int __ufshcd_uic_hibern8_enter(struct ufs_hba *hba)
 static int ufshcd_uic_hibern8_enter(struct ufs_hba *hba)
 {
 	int ret = 0, retries;
+	ktime_t start = ktime_get();
 
 	for (retries = UIC_HIBERN8_ENTER_RETRIES; retries > 0; retries--) {
 		ret = __ufshcd_uic_hibern8_enter(hba);
@@ -3367,16 +4131,21 @@ static int ufshcd_uic_hibern8_enter(struct ufs_hba *hba)
 	}
 
 out:
+	ufs_perf_h8(hba, true, start, ret);
+	ufshcd_idle_pred_h8(hba, true, start, ret);
 	return ret;
 }
 
 int ufshcd_uic_hibern8_exit(struct ufs_hba *hba)
 {
 	struct uic_command uic_cmd = {0};
+	ktime_t start = ktime_get();
 	int ret;
 
 	uic_cmd.command = UIC_CMD_DME_HIBER_EXIT;
 	ret = ufshcd_uic_pwr_ctrl(hba, &uic_cmd);
+	ufs_perf_h8(hba, false, start, ret);
+	ufshcd_idle_pred_h8(hba, false, start, ret);
 
 	if (ret) {
 		UFSHCD_UPDATE_ERROR_STATS(hba, UFS_ERR_HIBERN8_EXIT);
@@ -3503,6 +4272,7 @@ static int ufshcd_uic_hibern8_enter(struct ufs_hba *hba)
 {
 	int ret;
 	unsigned long flags;
+	ktime_t start;
 	spin_lock_irqsave(hba->host->host_lock, flags);
 	if (hba->is_hibernate) {
 		dev_err(hba->dev, "warring!!!! enter H8 twice\n");
@@ -3514,7 +4284,10 @@ static int ufshcd_uic_hibern8_enter(struct ufs_hba *hba)
 		dev_err(hba->dev, "wait doorbell clear timeout before enter H8\n");
 		goto out;
 	}
+	start = ktime_get();
 	ret = __ufshcd_uic_hibern8_op_irq_safe(hba, UFS_KIRIN_H8_OP_ENTER);/*lint !e747*/
+	ufs_perf_h8(hba, true, start, ret);
+	ufshcd_idle_pred_h8(hba, true, start, ret);
 	if (!ret)
 		hba->is_hibernate = true;
 	else
@@ -3542,13 +4315,17 @@ static int ufshcd_uic_hibern8_exit(struct ufs_hba *hba)
 {
 	int ret;
 	unsigned long flags;
+	ktime_t start;
 	spin_lock_irqsave(hba->host->host_lock, flags);
 	if (!hba->is_hibernate) {
 		dev_err(hba->dev, "warring!!!! exit H8 twice\n");
 		ret = 0;
 		goto out;
 	}
+	start = ktime_get();
 	ret = __ufshcd_uic_hibern8_op_irq_safe(hba, UFS_KIRIN_H8_OP_EXIT);/*lint !e747*/
+	ufs_perf_h8(hba, false, start, ret);
+	ufshcd_idle_pred_h8(hba, false, start, ret);
 	if (!ret)
 		hba->is_hibernate = false;
 	else
@@ -3658,6 +4435,7 @@ static int ufshcd_get_max_pwr_mode(struct ufs_hba *hba)
 int ufshcd_change_power_mode(struct ufs_hba *hba,
 			     struct ufs_pa_layer_attr *pwr_mode)
 {
+	ktime_t start = ktime_get();
 	int ret;
 
 	/* if already configured to the requested pwr_mode */
@@ -3711,6 +4489,7 @@ int ufshcd_change_power_mode(struct ufs_hba *hba,
 
 	ret = ufshcd_uic_change_pwr_mode(hba, pwr_mode->pwr_rx << 4
 			| pwr_mode->pwr_tx);
+	ufs_perf_pwr_change(hba, &hba->pwr_info, pwr_mode, start, ret);
 
 	if (ret) {
 		UFSHCD_UPDATE_ERROR_STATS(hba, UFS_ERR_POWER_MODE_CHANGE);
@@ -3834,7 +4613,8 @@ static int ufshcd_make_hba_operational(struct ufs_hba *hba)
 
 	/* Configure interrupt aggregation */
 	if (ufshcd_is_intr_aggr_allowed(hba))
-		ufshcd_config_intr_aggr(hba, hba->nutrs - 1, INT_AGGR_DEF_TO);
+		ufshcd_config_intr_aggr(hba, hba->intr_aggr_cnt,
+					hba->intr_aggr_tmout);
 	else
 		ufshcd_disable_intr_aggr(hba);
 
@@ -4605,13 +5385,21 @@ static void ufshcd_transfer_req_compl(struct ufs_hba *hba)
 	if (ufshcd_is_intr_aggr_allowed(hba))
 		ufshcd_reset_intr_aggr(hba);
 
-	tr_doorbell = ufshcd_readl(hba, REG_UTP_TRANSFER_REQ_DOOR_BELL);
-	completed_reqs = tr_doorbell ^ hba->outstanding_reqs;
+	if (ufshcd_mq_part_enabled(hba)) {
+		completed_reqs = ufshcd_mq_part_completed(hba);
+	} else {
+		tr_doorbell = ufshcd_readl(hba, REG_UTP_TRANSFER_REQ_DOOR_BELL);
+		completed_reqs = tr_doorbell ^ hba->outstanding_reqs;
+	}
 
 check:
+	hba->ufs_stats.utr_compl_cnt += hweight_long(completed_reqs);
+	ufs_perf_compl(hba, completed_reqs);
 	for_each_set_bit(index, &completed_reqs, hba->nutrs) {
 		lrbp = &hba->lrb[index];
 		lrbp->complete_time_stamp = ktime_get();
+		ufshcd_hpoll_done(hba, index);
+		ufs_perf_cmd_done(hba, lrbp);
 
 		cmd = lrbp->cmd;
 		if (cmd && lrbp->command_type != UTP_CMD_TYPE_DEV_MANAGE) {
@@ -4620,28 +5408,12 @@ check:
 			#ifdef CONFIG_SCSI_HISI_MQ
 			if(hba->host->use_blk_mq){
 				if(cmd->request && cmd->request->cmd_type == REQ_TYPE_FS){
-					if(cmd->request->cmd_flags & REQ_WRITE){
-						if(hba->processing_write){
-							hba->processing_write--;
-						}
-						else{
-							dev_err(hba->dev, "UFS MQ: <%s>  hba->processing_write has been zero! \r\n",__func__);
-						#ifdef CONFIG_HISI_MQ_DEBUG
-							BUG();
-						#endif
-						}
-					}
-					else{
-						if(hba->processing_read){
-							hba->processing_read--;
-						}
-						else{
-							dev_err(hba->dev, "UFS MQ: <%s>  &hba->processing_read has been zero! \r\n",__func__);
-						#ifdef CONFIG_HISI_MQ_DEBUG
-							BUG();
-						#endif
-						}
-					}
+					/* done in ufshcd_mq_part_completed() */
+					if (!ufshcd_mq_part_enabled(hba))
+						ufshcd_mq_account_done(hba,
+							cmd->request,
+							&hba->processing_read,
+							&hba->processing_write);
 					wake_up(&hba->write_wait_queue);
 				}
 			}
@@ -4688,7 +5460,8 @@ check:
 	}
 
 	/* clear corresponding bits of completed commands */
-	hba->outstanding_reqs ^= completed_reqs;
+	if (!ufshcd_mq_part_enabled(hba))
+		hba->outstanding_reqs ^= completed_reqs;
 #ifdef CONFIG_SCSI_HISI_MQ
 	if(hba->host->use_blk_mq){
 		if(hba->outstanding_reqs == 0){
@@ -4701,8 +5474,14 @@ check:
 			mod_timer(&hba->continue_idle_check,jiffies + msecs_to_jiffies(20));
 		}
 		else{
-			tr_doorbell = ufshcd_readl(hba, REG_UTP_TRANSFER_REQ_DOOR_BELL);
-			completed_reqs = tr_doorbell ^ hba->outstanding_reqs;
+			if (ufshcd_mq_part_enabled(hba)) {
+				completed_reqs = ufshcd_mq_part_completed(hba);
+			} else {
+				tr_doorbell = ufshcd_readl(hba,
+						REG_UTP_TRANSFER_REQ_DOOR_BELL);
+				completed_reqs = tr_doorbell ^
+						 hba->outstanding_reqs;
+			}
 			if(completed_reqs)
 				goto check;
 		}
@@ -4710,6 +5489,7 @@ check:
 #endif
 
 	ufshcd_clk_scaling_update_busy(hba);
+	ufshcd_idle_pred_idle(hba);
 
 	/* we might have free'd some tags above */
 	wake_up(&hba->dev_cmd.tag_wq);
@@ -5037,6 +5817,7 @@ static void ufshcd_err_handler(struct work_struct *work)
 
 	hba->ufshcd_state = UFSHCD_STATE_RESET;
 	spin_unlock_irqrestore(hba->host->host_lock, flags);
+	ufshcd_mq_part_sync(hba);
 
 	err_type = (hba->saved_err & INT_FATAL_ERRORS) | (hba->saved_uic_err);
 	ufs_log_all_info_limit_rate(hba, (err_type<<8) | UFSHCD_ERR_INTR_FATAL);
@@ -5276,8 +6057,10 @@ static void ufshcd_sl_intr(struct ufs_hba *hba, u32 intr_status)
 	if (intr_status & UTP_TASK_REQ_COMPL)
 		ufshcd_tmc_handler(hba);
 
-	if (intr_status & UTP_TRANSFER_REQ_COMPL)
+	if (intr_status & UTP_TRANSFER_REQ_COMPL) {
+		hba->ufs_stats.utr_intr_cnt++;
 		ufshcd_transfer_req_compl(hba);
+	}
 }
 /*lint +e835*/
 /**
@@ -5798,6 +6581,7 @@ static int ufshcd_eh_host_reset_handler(struct scsi_cmnd *cmd)
 	hba->ufshcd_state = UFSHCD_STATE_RESET;
 	ufshcd_set_eh_in_progress(hba);
 	spin_unlock_irqrestore(hba->host->host_lock, flags);
+	ufshcd_mq_part_sync(hba);
 
 	err = pm_runtime_get_sync(hba->dev);
 	if (err < 0) {
@@ -6102,6 +6886,7 @@ static int ufshcd_probe_hba(struct ufs_hba *hba)
 	hba->host->mq_quirk_flag |= SHOST_MQ_QUIRK(SHOST_MQ_QUIRK_FORCE_DISPATCH_CTX);
 	hba->host->mq_quirk_flag |= SHOST_MQ_QUIRK(SHOST_MQ_QUIRK_FORCE_SOFT_IRQ);
 	hba->host->mq_quirk_flag |= SHOST_MQ_QUIRK(SHOST_MQ_QUIRK_DISPATCH_DICISION);
+	hba->host->mq_quirk_flag |= SHOST_MQ_QUIRK(SHOST_MQ_QUIRK_VIP_IO);
 #endif
 
 	hba->wlun_dev_clr_ua = true;
@@ -6638,8 +7423,8 @@ static void ufshcd_statistics_report(struct Scsi_Host *host,struct blkdev_statis
 	struct ufs_hba *hba = shost_priv(host);
 	unsigned long flags;
 	spin_lock_irqsave(hba->host->host_lock, flags);
-	info->blkdev_processing_read = hba->processing_read;
-	info->blkdev_processing_write = hba->processing_write;
+	ufshcd_mq_processing(hba, &info->blkdev_processing_read,
+			     &info->blkdev_processing_write);
 	info->blkdev_continue_read = hba->continue_read;
 	info->blkdev_continue_sync_write = hba->continue_sync_write;
 	info->blkdev_continue_async_write = hba->continue_async_write;
@@ -7238,6 +8023,7 @@ static int __ufshcd_queuecommand_directly(struct ufs_hba *hba,
 	lrbp->task_tag = tag;
 	lrbp->lun = ufshcd_scsi_to_upiu_lun((unsigned int)cmd->device->lun);
 	lrbp->intr_cmd = !ufshcd_is_intr_aggr_allowed(hba) ? true : false;
+	lrbp->hpoll = false;
 	lrbp->command_type = UTP_CMD_TYPE_SCSI;
 
 	/* form UPIU before issuing the command */
@@ -8134,9 +8920,12 @@ EXPORT_SYMBOL(ufshcd_shutdown);
 void ufshcd_remove(struct ufs_hba *hba)
 {
 	scsi_remove_host(hba->host);
+	ufshcd_mq_part_exit(hba);
+	ufshcd_hpoll_exit(hba);
 	/* disable interrupts */
 	ufshcd_disable_intr(hba, hba->intr_mask);
 	ufshcd_hba_stop(hba);
+	ufs_perf_stats_exit(hba);
 
 	scsi_host_put(hba->host);
 
@@ -8334,6 +9123,7 @@ int ufshcd_init(struct ufs_hba *hba, void __iomem *mmio_base, unsigned int irq)
 	ufs_log_init( &(hba->log_attr), 1, 3 );
 	/* init stats before all */
 	ufshcd_init_stats( &(hba->ufs_stats) );
+	hba->ufs_stats.intr_tstamp = ktime_get();
 
 #ifdef CONFIG_SCSI_HISI_MQ
 	hba->processing_read = 0;
@@ -8381,6 +9171,12 @@ int ufshcd_init(struct ufs_hba *hba, void __iomem *mmio_base, unsigned int irq)
 	/* Configure LRB */
 	ufshcd_host_memory_configure(hba);
 
+	hba->intr_aggr_cnt = hba->nutrs - 1;
+	hba->intr_aggr_tmout = INT_AGGR_DEF_TO;
+	ufshcd_hpoll_init(hba);
+	ufs_perf_stats_init(hba);
+	ufshcd_idle_pred_init(hba);
+
 	host->can_queue = hba->nutrs;
 	host->cmd_per_lun = hba->nutrs;
 	host->max_id = UFSHCD_MAX_ID;
@@ -8397,6 +9193,7 @@ int ufshcd_init(struct ufs_hba *hba, void __iomem *mmio_base, unsigned int irq)
 		host->can_queue = host->mq_queue_depth * (int)host->nr_hw_queues;
 	}
 #endif
+	ufshcd_mq_part_init(hba);
 
 	hba->max_pwr_info.is_valid = false;
 
@@ -8481,6 +9278,7 @@ exit_gating:
 out_disable:
 	hba->is_irq_enabled = false;
 	UFSDBG_REMOVE_DEBUGFS(hba)
+	ufs_perf_stats_exit(hba);
 	scsi_host_put(host);
 	ufshcd_hba_exit(hba);
 out_error:
@@ -46,6 +46,7 @@
 #include <linux/slab.h>
 #include <linux/spinlock.h>
 #include <linux/workqueue.h>
+#include <linux/hrtimer.h>
 #include <linux/errno.h>
 #include <linux/types.h>
 #include <linux/wait.h>
@@ -227,6 +228,8 @@ struct ufs_pm_lvl_states {
  * @task_tag: Task tag of the command
  * @lun: LUN of the command
  * @intr_cmd: Interrupt command (doesn't participate in interrupt aggregation)
+ * @hpoll: aggregated command whose completion is polled for
+ * @perf_woken: issued right after the host woke up from hibern8
  * @issue_time_stamp: time stamp for debug purposes
  * @complete_time_stamp: time stamp for statistics
  */
@@ -246,6 +249,8 @@ struct ufshcd_lrb {
 	int task_tag;
 	u8 lun; /* UPIU LUN id field is only 8-bit wide */
 	bool intr_cmd;
+	bool hpoll;
+	bool perf_woken;
 	ktime_t issue_time_stamp;
 	ktime_t complete_time_stamp;
 };
@@ -302,6 +307,11 @@ struct debugfs_files {
 	struct dentry *dme_local_read;
 	struct dentry *dme_peer_read;
 	struct dentry *req_stats;
+	struct dentry *intr_aggr;
+	struct dentry *intr_stats;
+	struct dentry *hybrid_poll;
+	struct dentry *perf_stats;
+	struct dentry *idle_pred;
 	u32 dme_local_attr_id;
 	u32 dme_peer_attr_id;
 };
@@ -347,8 +357,10 @@ struct ufshcd_req_stat {
  * @nl_err: tracks nl-uic errors
  * @tl_err: tracks tl-uic errors
  * @dme_err: tracks dme errors
+ * @perf: always-on host side performance statistics, NULL if unavailable
  */
 struct ufshcd_hist;
+struct ufs_perf_stats;
 
 struct ufs_stats {
 #ifdef CONFIG_DEBUG_FS
@@ -361,7 +373,15 @@ struct ufs_stats {
 	u32 hibern8_exit_cnt;
 	ktime_t last_hibern8_exit_tstamp;
 
+	/* interrupt aggregation and hybrid polling, since intr_tstamp */
+	u64 utr_intr_cnt;
+	u64 utr_compl_cnt;
+	u64 hpoll_cnt;
+	u64 hpoll_hit_cnt;
+	ktime_t intr_tstamp;
+
 	struct ufshcd_hist *hist_rec;
+	struct ufs_perf_stats *perf;
 };
 
 /**
@@ -525,6 +545,40 @@ struct ufs_clk_scaling {
 	unsigned long window_start_t;
 };
 
+#ifdef CONFIG_SCSI_UFS_IDLE_PRED
+/**
+ * struct ufs_idle_pred - predicts link idle time to pick the idle power policy
+ * @lock: protects the fields below, blk-mq partitions issue without host_lock
+ * @enable: adapt the auto-hibern8 timer and the gating delay to the prediction
+ * @idle: no request outstanding since @idle_start
+ * @deep: prediction made at @idle_start, idle longer than break-even
+ * @idle_start: completion time of the last outstanding request
+ * @gap_ns: idle time between bursts, EWMA
+ * @h8_enter_ns: hibern8 enter cost, EWMA
+ * @h8_exit_ns: hibern8 exit cost, EWMA
+ * @deep_hit: predicted and was longer than break-even
+ * @deep_miss: predicted longer than break-even but was shorter
+ * @shallow_hit: predicted and was shorter than break-even
+ * @shallow_miss: predicted shorter than break-even but was longer
+ * @err_us: sum of the absolute prediction errors
+ */
+struct ufs_idle_pred {
+	spinlock_t lock;
+	bool enable;
+	bool idle;
+	bool deep;
+	ktime_t idle_start;
+	u64 gap_ns;
+	u64 h8_enter_ns;
+	u64 h8_exit_ns;
+	u64 deep_hit;
+	u64 deep_miss;
+	u64 shallow_hit;
+	u64 shallow_miss;
+	u64 err_us;
+};
+#endif
+
 /**
  * struct ufs_init_prefetch - contains data that is pre-fetched once during
  * initialization
@@ -554,6 +608,29 @@ struct ufs_hm_thread {
 	struct task_struct *task;
 };
 #endif
+#ifdef CONFIG_SCSI_UFS_MQ_PARTITION
+#define UFSHCD_MAX_MQ_PARTS	4
+
+/**
+ * struct ufshcd_mq_part - UTRD slots owned by the cpus of one cluster
+ * @lock: orders the outstanding_reqs bits of these slots against the
+ *	doorbell, taken instead of host_lock on the blk-mq issue path
+ * @start: first slot
+ * @end: one past the last slot
+ * @nr_read: fs reads in flight in these slots, share of processing_read
+ * @nr_write: fs writes in flight in these slots, share of processing_write
+ * @nr_issued: commands issued by the cluster, sampled for irq steering
+ */
+struct ufshcd_mq_part {
+	spinlock_t lock;
+	int start;
+	int end;
+	int nr_read;
+	int nr_write;
+	unsigned long nr_issued;
+} ____cacheline_aligned_in_smp;
+#endif
+
 /**
  * struct ufs_hba - per adapter private structure
  * @mmio_base: UFSHCI base register address
@@ -603,6 +680,15 @@ struct ufs_hm_thread {
  * @clk_list_head: UFS host controller clocks list node head
  * @pwr_info: holds current power mode
  * @max_pwr_info: keeps the device max valid pwm
+ * @intr_aggr_cnt: interrupt aggregation counter threshold
+ * @intr_aggr_tmout: interrupt aggregation timeout, in 40us units
+ * @hpoll_enable: poll for foreground reads instead of interrupting on them
+ * @hpoll_reqs: bits of the issued commands being polled for
+ * @hpoll_timer: fires the polls
+ * @hpoll_checks: polls done since the timer was started
+ * @hpoll_lat_ns: expected foreground read latency, from blk-stat
+ * @hpoll_lat_tstamp: when hpoll_lat_ns was refreshed
+ * @idle_pred: idle time predictor for auto-hibern8 and clock gating
  */
 struct ufs_hba {
 	void __iomem *mmio_base;
@@ -620,6 +706,26 @@ struct ufs_hba {
 	wait_queue_head_t write_wait_queue;
 
 	struct timer_list continue_idle_check;
+#endif
+#ifdef CONFIG_SCSI_UFS_MQ_PARTITION
+	int nr_mq_parts;
+	int mq_part_size;
+	struct ufshcd_mq_part mq_part[UFSHCD_MAX_MQ_PARTS];
+	/* partition the irq is currently steered to, -1 if none */
+	int mq_irq_part;
+	unsigned long mq_irq_steering;
+	struct delayed_work mq_irq_work;
+#endif
+#ifdef CONFIG_SCSI_UFS_HYBRID_POLL
+	bool hpoll_enable;
+	unsigned long hpoll_reqs;
+	struct hrtimer hpoll_timer;
+	int hpoll_checks;
+	u64 hpoll_lat_ns;
+	ktime_t hpoll_lat_tstamp;
+#endif
+#ifdef CONFIG_SCSI_UFS_IDLE_PRED
+	struct ufs_idle_pred idle_pred;
 #endif
 	/* Virtual memory reference */
 	struct utp_transfer_cmd_desc *ucdl_base_addr;
@@ -661,6 +767,8 @@ struct ufs_hba {
 	void *priv;
 	unsigned int irq;
 	bool is_irq_enabled;
+	u8 intr_aggr_cnt;
+	u8 intr_aggr_tmout;
 
 	/* Interrupt aggregation support is broken */
 	#define UFSHCD_QUIRK_BROKEN_INTR_AGGR			UFS_BIT(0)
@@ -1035,6 +1143,11 @@ int ufshcd_change_power_mode(struct ufs_hba *hba,
 			     struct ufs_pa_layer_attr *pwr_mode);
 int ufshcd_wait_for_doorbell_clr(struct ufs_hba *hba, u64 wait_timeout_us);
 void ufshcd_enable_intr(struct ufs_hba *hba, u32 intrs);
+int ufshcd_set_intr_aggr(struct ufs_hba *hba, u8 cnt, u8 tmout);
+#ifdef CONFIG_SCSI_UFS_IDLE_PRED
+void ufshcd_idle_pred_enable(struct ufs_hba *hba, bool enable);
+u64 ufshcd_idle_pred_be_ns(struct ufs_idle_pred *pred);
+#endif
 #ifdef CONFIG_SCSI_UFS_INLINE_CRYPTO
 int ufshcd_keyregs_remap_wc(struct ufs_hba *hba, resource_size_t hci_reg_base);
 #endif
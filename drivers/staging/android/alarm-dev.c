@@ -71,12 +71,13 @@ static int is_wakeup(enum android_alarm_type type)
 }
 
 
-static void devalarm_start(struct devalarm *alrm, ktime_t exp)
+static void devalarm_start(struct devalarm *alrm, ktime_t exp, u64 slack)
 {
 	if (is_wakeup(alrm->type))
-		alarm_start(&alrm->u.alrm, exp);
+		alarm_start_range(&alrm->u.alrm, exp, slack);
 	else
-		hrtimer_start(&alrm->u.hrt, exp, HRTIMER_MODE_ABS);
+		hrtimer_start_range_ns(&alrm->u.hrt, exp, slack,
+				       HRTIMER_MODE_ABS);
 }
 
 
@@ -114,16 +115,16 @@ static void alarm_clear(enum android_alarm_type alarm_type)
 }
 
 static void alarm_set(enum android_alarm_type alarm_type,
-							struct timespec *ts)
+					struct timespec *ts, u64 slack)
 {
 	uint32_t alarm_type_mask = 1U << alarm_type;
 	unsigned long flags;
 
 	spin_lock_irqsave(&alarm_slock, flags);
-	alarm_dbg(IO, "alarm %d set %ld.%09ld\n",
-			alarm_type, ts->tv_sec, ts->tv_nsec);
+	alarm_dbg(IO, "alarm %d set %ld.%09ld window %llu\n",
+			alarm_type, ts->tv_sec, ts->tv_nsec, slack);
 	alarm_enabled |= alarm_type_mask;
-	devalarm_start(&alarms[alarm_type], timespec_to_ktime(*ts));
+	devalarm_start(&alarms[alarm_type], timespec_to_ktime(*ts), slack);
 	spin_unlock_irqrestore(&alarm_slock, flags);
 }
 
@@ -248,7 +249,7 @@ static int alarm_set_rtc_alarm(long time_sec, bool enable_irq)
 }
 
 static long alarm_do_ioctl(struct file *file, unsigned int cmd,
-							struct timespec *ts)
+					struct timespec *ts, u64 slack)
 {
 	int rv = 0;
 	unsigned long flags;
@@ -281,10 +282,13 @@ static long alarm_do_ioctl(struct file *file, unsigned int cmd,
 		alarm_clear(alarm_type);
 		break;
 	case ANDROID_ALARM_SET(0):
-		alarm_set(alarm_type, ts);
+		alarm_set(alarm_type, ts, 0);
+		break;
+	case ANDROID_ALARM_SET_WINDOW(0):
+		alarm_set(alarm_type, ts, slack);
 		break;
 	case ANDROID_ALARM_SET_AND_WAIT(0):
-		alarm_set(alarm_type, ts);
+		alarm_set(alarm_type, ts, 0);
 		/* fall though */
 	case ANDROID_ALARM_WAIT:
 		rv = alarm_wait();
@@ -302,13 +306,37 @@ static long alarm_do_ioctl(struct file *file, unsigned int cmd,
 	return rv;
 }
 
+/* Turn a window into its start and the slack after it */
+static int alarm_window_to_slack(struct timespec *start, struct timespec *end,
+				 u64 *slack)
+{
+	s64 start_ns = timespec_to_ns(start);
+	s64 end_ns = timespec_to_ns(end);
+
+	if (!timespec_valid(start) || !timespec_valid(end) || end_ns < start_ns)
+		return -EINVAL;
+
+	*slack = end_ns - start_ns;
+	return 0;
+}
+
 static long alarm_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 {
 
 	struct timespec ts;
+	struct android_alarm_window win;
+	u64 slack = 0;
 	int rv;
 
 	switch (ANDROID_ALARM_BASE_CMD(cmd)) {
+	case ANDROID_ALARM_SET_WINDOW(0):
+		if (copy_from_user(&win, (void __user *)arg, sizeof(win)))
+			return -EFAULT;
+		rv = alarm_window_to_slack(&win.start, &win.end, &slack);
+		if (rv)
+			return rv;
+		ts = win.start;
+		break;
 	case ANDROID_ALARM_SET_AND_WAIT(0):
 	case ANDROID_ALARM_SET(0):
 	case ANDROID_ALARM_SET_RTC:
@@ -321,7 +349,7 @@ static long alarm_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 		break;
 	}
 
-	rv = alarm_do_ioctl(file, cmd, &ts);
+	rv = alarm_do_ioctl(file, cmd, &ts, slack);
 	if (rv)
 		return rv;
 
@@ -340,9 +368,22 @@ static long alarm_compat_ioctl(struct file *file, unsigned int cmd,
 {
 
 	struct timespec ts;
+	struct compat_android_alarm_window __user *uwin;
+	struct timespec end;
+	u64 slack = 0;
 	int rv;
 
 	switch (ANDROID_ALARM_BASE_CMD(cmd)) {
+	case ANDROID_ALARM_SET_WINDOW_COMPAT(0):
+		uwin = (struct compat_android_alarm_window __user *)arg;
+		if (compat_get_timespec(&ts, &uwin->start) ||
+		    compat_get_timespec(&end, &uwin->end))
+			return -EFAULT;
+		rv = alarm_window_to_slack(&ts, &end, &slack);
+		if (rv)
+			return rv;
+		cmd = ANDROID_ALARM_SET_WINDOW(ANDROID_ALARM_IOCTL_TO_TYPE(cmd));
+		break;
 	case ANDROID_RTC_ALARM_SET_COMPAT:
 	case ANDROID_ALARM_SET_AND_WAIT_COMPAT(0):
 	case ANDROID_ALARM_SET_COMPAT(0):
@@ -355,7 +396,7 @@ static long alarm_compat_ioctl(struct file *file, unsigned int cmd,
 		break;
 	}
 
-	rv = alarm_do_ioctl(file, cmd, &ts);
+	rv = alarm_do_ioctl(file, cmd, &ts, slack);
 	if (rv)
 		return rv;
 
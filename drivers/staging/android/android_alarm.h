@@ -35,6 +35,12 @@ extern void hisi_pmu_rtc_readtime(struct rtc_time *tm);
 							struct compat_timespec)
 #define ANDROID_RTC_ALARM_SET_COMPAT		_IOW('a', 7, \
 							struct compat_timespec)
+struct compat_android_alarm_window {
+	struct compat_timespec start;
+	struct compat_timespec end;
+};
+#define ANDROID_ALARM_SET_WINDOW_COMPAT(type)	ALARM_IOW(6, type, \
+					struct compat_android_alarm_window)
 #define ANDROID_ALARM_IOCTL_NR(cmd)		(_IOC_NR(cmd) & ((1<<4)-1))
 #define ANDROID_ALARM_COMPAT_TO_NORM(cmd)  \
 					ALARM_IOW(ANDROID_ALARM_IOCTL_NR(cmd), \
@@ -30,6 +30,8 @@
 #include <linux/personality.h>
 #include <linux/bitops.h>
 #include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/sched.h>
 #include <linux/shmem_fs.h>
 #include "ashmem.h"
 
@@ -44,9 +46,13 @@
  * @file:		The shmem-based backing file
  * @size:		The size of the mapping, in bytes
  * @prot_masks:		The allowed protection bits, as vm_flags
+ * @lock:		Protects all of the above and the area's ranges
+ * @owner:		The process that created the area
+ * @refcount:		Held by the open file and by the shrinker while it
+ *			purges one of the area's ranges
  *
  * The lifecycle of this structure is from our parent file's open() until
- * its release(). It is also protected by 'ashmem_mutex'
+ * its release(), or until the shrinker is done with it if that is later.
  *
  * Warning: Mappings do NOT pin this structure; It dies on close()
  */
@@ -56,6 +62,9 @@ struct ashmem_area {
 	struct file *file;
 	size_t size;
 	unsigned long prot_mask;
+	struct mutex lock;
+	struct pid *owner;
+	atomic_t refcount;
 };
 
 /**
@@ -66,9 +75,10 @@ struct ashmem_area {
  * @pgstart:	         The starting page (inclusive)
  * @pgend:	         The ending page (inclusive)
  * @purged:	         The purge status (ASHMEM_NOT or ASHMEM_WAS_PURGED)
+ * @cached:	         Which LRU list it is on, see ashmem_owner_cached()
  *
  * The lifecycle of this structure is from unpin to pin.
- * It is protected by 'ashmem_mutex'
+ * It is protected by its area's lock, @lru and @cached by ashmem_lru_lock
  */
 struct ashmem_range {
 	struct list_head lru;
@@ -77,24 +87,40 @@ struct ashmem_range {
 	size_t pgstart;
 	size_t pgend;
 	unsigned int purged;
+	bool cached;
 };
 
-/* LRU list of unpinned pages, protected by ashmem_mutex */
-static LIST_HEAD(ashmem_lru_list);
+/*
+ * LRU lists of unpinned pages, protected by ashmem_lru_lock. Ranges of
+ * areas whose owner is a cached app (or gone) are on the second list
+ * and purged first.
+ */
+static struct list_head ashmem_lru_list[2] = {
+	LIST_HEAD_INIT(ashmem_lru_list[0]),
+	LIST_HEAD_INIT(ashmem_lru_list[1]),
+};
 
 /**
- * long lru_count - The count of pages on our LRU list.
+ * long lru_count - The count of pages on our LRU lists.
  *
- * This is protected by ashmem_mutex.
+ * This is protected by ashmem_lru_lock.
  */
 static unsigned long lru_count;
 
 /**
- * ashmem_mutex - protects the list of and each individual ashmem_area
+ * ashmem_lru_lock - protects the LRU lists and lru_count
+ *
+ * Lock Ordering: asma->lock -> i_mutex -> i_alloc_sem
+ *                asma->lock -> ashmem_lru_lock
  *
- * Lock Ordering: ashmex_mutex -> i_mutex -> i_alloc_sem
+ * The shrinker only ever trylocks an area under ashmem_lru_lock, so a
+ * pin or unpin that allocates memory never waits behind a purge.
  */
-static DEFINE_MUTEX(ashmem_mutex);
+static DEFINE_SPINLOCK(ashmem_lru_lock);
+
+/* oom_score_adj from which an owner counts as a cached app */
+static short ashmem_cached_adj = 900;
+module_param_named(cached_adj, ashmem_cached_adj, short, S_IRUGO | S_IWUSR);
 
 static struct kmem_cache *ashmem_area_cachep __read_mostly;
 static struct kmem_cache *ashmem_range_cachep __read_mostly;
@@ -123,32 +149,66 @@ static struct kmem_cache *ashmem_range_cachep __read_mostly;
 
 #define PROT_MASK		(PROT_EXEC | PROT_READ | PROT_WRITE)
 
+/**
+ * ashmem_owner_cached() - Tells whether an area's pages are cheap to purge
+ * @asma:		   The area in question
+ *
+ * Return: true if the process that created @asma is a cached app by its
+ * oom_score_adj, or has exited.
+ */
+static bool ashmem_owner_cached(struct ashmem_area *asma)
+{
+	struct task_struct *task;
+	bool cached = true;
+
+	rcu_read_lock();
+	task = pid_task(asma->owner, PIDTYPE_PID);
+	if (task)
+		cached = task->signal->oom_score_adj >= ashmem_cached_adj;
+	rcu_read_unlock();
+
+	return cached;
+}
+
 /**
  * lru_add() - Adds a range of memory to the LRU list
  * @range:     The memory range being added.
  *
- * The range is first added to the end (tail) of the LRU list.
+ * The range is first added to the end (tail) of the LRU list matching
+ * the state of its owner.
  * After this, the size of the range is added to @lru_count
  */
 static inline void lru_add(struct ashmem_range *range)
 {
-	list_add_tail(&range->lru, &ashmem_lru_list);
+	spin_lock(&ashmem_lru_lock);
+	range->cached = ashmem_owner_cached(range->asma);
+	list_add_tail(&range->lru, &ashmem_lru_list[range->cached]);
 	lru_count += range_size(range);
+	spin_unlock(&ashmem_lru_lock);
 }
 
 /**
- * lru_del() - Removes a range of memory from the LRU list
+ * __lru_del() - Removes a range of memory from the LRU list
  * @range:     The memory range being removed
  *
  * The range is first deleted from the LRU list.
  * After this, the size of the range is removed from @lru_count
+ *
+ * Caller must hold ashmem_lru_lock.
  */
-static inline void lru_del(struct ashmem_range *range)
+static inline void __lru_del(struct ashmem_range *range)
 {
 	list_del(&range->lru);
 	lru_count -= range_size(range);
 }
 
+static inline void lru_del(struct ashmem_range *range)
+{
+	spin_lock(&ashmem_lru_lock);
+	__lru_del(range);
+	spin_unlock(&ashmem_lru_lock);
+}
+
 /**
  * range_alloc() - Allocates and initializes a new ashmem_range structure
  * @asma:	   The associated ashmem_area
@@ -157,7 +217,7 @@ static inline void lru_del(struct ashmem_range *range)
  * @start:	   The starting page (inclusive)
  * @end:	   The ending page (inclusive)
  *
- * This function is protected by ashmem_mutex.
+ * This function is protected by asma->lock.
  *
  * Return: 0 if successful, or -ENOMEM if there is an error
  */
@@ -216,8 +276,27 @@ static inline void range_shrink(struct ashmem_range *range,
 	range->pgstart = start;
 	range->pgend = end;
 
-	if (range_on_lru(range))
+	if (range_on_lru(range)) {
+		spin_lock(&ashmem_lru_lock);
 		lru_count -= pre - range_size(range);
+		spin_unlock(&ashmem_lru_lock);
+	}
+}
+
+/**
+ * ashmem_area_put() - Drops a reference to an ashmem_area
+ * @asma:	       The area, freed along with its backing file on the
+ *		       last reference
+ */
+static void ashmem_area_put(struct ashmem_area *asma)
+{
+	if (!atomic_dec_and_test(&asma->refcount))
+		return;
+
+	if (asma->file)
+		fput(asma->file);
+	put_pid(asma->owner);
+	kmem_cache_free(ashmem_area_cachep, asma);
 }
 
 /**
@@ -246,6 +325,9 @@ static int ashmem_open(struct inode *inode, struct file *file)
 	INIT_LIST_HEAD(&asma->unpinned_list);
 	memcpy(asma->name, ASHMEM_NAME_PREFIX, ASHMEM_NAME_PREFIX_LEN);
 	asma->prot_mask = PROT_MASK;
+	mutex_init(&asma->lock);
+	asma->owner = get_pid(task_tgid(current));
+	atomic_set(&asma->refcount, 1);
 	file->private_data = asma;
 
 	return 0;
@@ -264,14 +346,12 @@ static int ashmem_release(struct inode *ignored, struct file *file)
 	struct ashmem_area *asma = file->private_data;
 	struct ashmem_range *range, *next;
 
-	mutex_lock(&ashmem_mutex);
+	mutex_lock(&asma->lock);
 	list_for_each_entry_safe(range, next, &asma->unpinned_list, unpinned)
 		range_del(range);
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->lock);
 
-	if (asma->file)
-		fput(asma->file);
-	kmem_cache_free(ashmem_area_cachep, asma);
+	ashmem_area_put(asma);
 
 	return 0;
 }
@@ -291,7 +371,7 @@ static ssize_t ashmem_read(struct file *file, char __user *buf,
 	struct ashmem_area *asma = file->private_data;
 	int ret = 0;
 
-	mutex_lock(&ashmem_mutex);
+	mutex_lock(&asma->lock);
 
 	/* If size is not set, or set to 0, always return EOF. */
 	if (asma->size == 0)
@@ -302,7 +382,7 @@ static ssize_t ashmem_read(struct file *file, char __user *buf,
 		goto out_unlock;
 	}
 
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->lock);
 
 	/*
 	 * asma and asma->file are used outside the lock here.  We assume
@@ -318,7 +398,7 @@ static ssize_t ashmem_read(struct file *file, char __user *buf,
 	return ret;
 
 out_unlock:
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->lock);
 	return ret;
 }
 
@@ -327,7 +407,7 @@ static loff_t ashmem_llseek(struct file *file, loff_t offset, int origin)
 	struct ashmem_area *asma = file->private_data;
 	int ret;
 
-	mutex_lock(&ashmem_mutex);
+	mutex_lock(&asma->lock);
 
 	if (asma->size == 0) {
 		ret = -EINVAL;
@@ -347,7 +427,7 @@ static loff_t ashmem_llseek(struct file *file, loff_t offset, int origin)
 	file->f_pos = asma->file->f_pos;
 
 out:
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->lock);
 	return ret;
 }
 
@@ -363,7 +443,7 @@ static int ashmem_mmap(struct file *file, struct vm_area_struct *vma)
 	struct ashmem_area *asma = file->private_data;
 	int ret = 0;
 
-	mutex_lock(&ashmem_mutex);
+	mutex_lock(&asma->lock);
 
 	/* user needs to SET_SIZE before mapping */
 	if (unlikely(!asma->size)) {
@@ -406,10 +486,34 @@ static int ashmem_mmap(struct file *file, struct vm_area_struct *vma)
 	}
 
 out:
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->lock);
 	return ret;
 }
 
+/*
+ * ashmem_lru_refresh - move ranges between the LRU lists whose owner
+ * became, or stopped being, a cached app since they were unpinned.
+ *
+ * Caller must hold ashmem_lru_lock.
+ */
+static void ashmem_lru_refresh(void)
+{
+	struct ashmem_range *range, *next;
+	LIST_HEAD(moved);
+	int cached;
+
+	for (cached = 0; cached < 2; cached++) {
+		list_for_each_entry_safe(range, next, &ashmem_lru_list[cached],
+					 lru) {
+			if (ashmem_owner_cached(range->asma) == cached)
+				continue;
+			range->cached = !cached;
+			list_move_tail(&range->lru, &moved);
+		}
+		list_splice_tail_init(&moved, &ashmem_lru_list[!cached]);
+	}
+}
+
 /*
  * ashmem_shrink - our cache shrinker, called from mm/vmscan.c
  *
@@ -417,41 +521,71 @@ out:
  *
  * 'gfp_mask' is the mask of the allocation that got us into this mess.
  *
- * Return value is the number of objects freed or -1 if we cannot
+ * Return value is the number of objects freed or SHRINK_STOP if we cannot
  * proceed without risk of deadlock (due to gfp_mask).
  *
  * We approximate LRU via least-recently-unpinned, jettisoning unpinned partial
  * chunks of ashmem regions LRU-wise one-at-a-time until we hit 'nr_to_scan'
- * pages freed.
+ * pages freed. Ranges of cached apps go first. Areas whose lock is held,
+ * e.g. by a pin or unpin that got us here, are skipped rather than
+ * waited for.
  */
 static unsigned long
 ashmem_shrink_scan(struct shrinker *shrink, struct shrink_control *sc)
 {
-	struct ashmem_range *range, *next;
+	struct ashmem_range *range;
+	struct ashmem_area *asma;
+	struct list_head busy[2];
 	unsigned long freed = 0;
+	int cached;
 
 	/* We might recurse into filesystem code, so bail out if necessary */
 	if (!(sc->gfp_mask & __GFP_FS))
 		return SHRINK_STOP;
 
-	if (!mutex_trylock(&ashmem_mutex))
-		return -1;
+	INIT_LIST_HEAD(&busy[0]);
+	INIT_LIST_HEAD(&busy[1]);
+
+	spin_lock(&ashmem_lru_lock);
+	ashmem_lru_refresh();
+	while (sc->nr_to_scan > 0) {
+		if (!list_empty(&ashmem_lru_list[1]))
+			cached = 1;
+		else if (!list_empty(&ashmem_lru_list[0]))
+			cached = 0;
+		else
+			break;
 
-	list_for_each_entry_safe(range, next, &ashmem_lru_list, lru) {
-		loff_t start = range->pgstart * PAGE_SIZE;
-		loff_t end = (range->pgend + 1) * PAGE_SIZE;
+		range = list_first_entry(&ashmem_lru_list[cached],
+					 struct ashmem_range, lru);
+		asma = range->asma;
+		if (!mutex_trylock(&asma->lock)) {
+			list_move_tail(&range->lru, &busy[cached]);
+			continue;
+		}
 
-		range->asma->file->f_op->fallocate(range->asma->file,
-				FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
-				start, end - start);
+		/* the area lock keeps the range, the reference the area */
+		atomic_inc(&asma->refcount);
+		__lru_del(range);
 		range->purged = ASHMEM_WAS_PURGED;
-		lru_del(range);
+		spin_unlock(&ashmem_lru_lock);
 
+		asma->file->f_op->fallocate(asma->file,
+				FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+				range->pgstart * PAGE_SIZE,
+				range_size(range) * PAGE_SIZE);
 		freed += range_size(range);
-		if (--sc->nr_to_scan <= 0)
-			break;
+		sc->nr_to_scan--;
+
+		mutex_unlock(&asma->lock);
+		ashmem_area_put(asma);
+		cond_resched();
+		spin_lock(&ashmem_lru_lock);
 	}
-	mutex_unlock(&ashmem_mutex);
+	list_splice(&busy[0], &ashmem_lru_list[0]);
+	list_splice(&busy[1], &ashmem_lru_list[1]);
+	spin_unlock(&ashmem_lru_lock);
+
 	return freed;
 }
 
@@ -480,7 +614,7 @@ static int set_prot_mask(struct ashmem_area *asma, unsigned long prot)
 {
 	int ret = 0;
 
-	mutex_lock(&ashmem_mutex);
+	mutex_lock(&asma->lock);
 
 	/* the user can only remove, not add, protection bits */
 	if (unlikely((asma->prot_mask & prot) != prot)) {
@@ -495,7 +629,7 @@ static int set_prot_mask(struct ashmem_area *asma, unsigned long prot)
 	asma->prot_mask = prot;
 
 out:
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->lock);
 	return ret;
 }
 
@@ -506,10 +640,10 @@ static int set_name(struct ashmem_area *asma, void __user *name)
 	char local_name[ASHMEM_NAME_LEN];
 
 	/*
-	 * Holding the ashmem_mutex while doing a copy_from_user might cause
+	 * Holding the asma->lock while doing a copy_from_user might cause
 	 * an data abort which would try to access mmap_sem. If another
 	 * thread has invoked ashmem_mmap then it will be holding the
-	 * semaphore and will be waiting for ashmem_mutex, there by leading to
+	 * semaphore and will be waiting for asma->lock, there by leading to
 	 * deadlock. We'll release the mutex  and take the name to a local
 	 * variable that does not need protection and later copy the local
 	 * variable to the structure member with lock held.
@@ -519,14 +653,14 @@ static int set_name(struct ashmem_area *asma, void __user *name)
 		return len;
 	if (len == ASHMEM_NAME_LEN)
 		local_name[ASHMEM_NAME_LEN - 1] = '\0';
-	mutex_lock(&ashmem_mutex);
+	mutex_lock(&asma->lock);
 	/* cannot change an existing mapping's name */
 	if (unlikely(asma->file))
 		ret = -EINVAL;
 	else
 		strcpy(asma->name + ASHMEM_NAME_PREFIX_LEN, local_name);
 
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->lock);
 	return ret;
 }
 
@@ -542,7 +676,7 @@ static int get_name(struct ashmem_area *asma, void __user *name)
 	 */
 	char local_name[ASHMEM_NAME_LEN];
 
-	mutex_lock(&ashmem_mutex);
+	mutex_lock(&asma->lock);
 	if (asma->name[ASHMEM_NAME_PREFIX_LEN] != '\0') {
 		/*
 		 * Copying only `len', instead of ASHMEM_NAME_LEN, bytes
@@ -554,7 +688,7 @@ static int get_name(struct ashmem_area *asma, void __user *name)
 		len = sizeof(ASHMEM_NAME_DEF);
 		memcpy(local_name, ASHMEM_NAME_DEF, len);
 	}
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->lock);
 
 	/*
 	 * Now we are just copying from the stack variable to userland
@@ -569,7 +703,7 @@ static int get_name(struct ashmem_area *asma, void __user *name)
  * ashmem_pin - pin the given ashmem region, returning whether it was
  * previously purged (ASHMEM_WAS_PURGED) or not (ASHMEM_NOT_PURGED).
  *
- * Caller must hold ashmem_mutex.
+ * Caller must hold asma->lock.
  */
 static int ashmem_pin(struct ashmem_area *asma, size_t pgstart, size_t pgend)
 {
@@ -635,7 +769,7 @@ static int ashmem_pin(struct ashmem_area *asma, size_t pgstart, size_t pgend)
 /*
  * ashmem_unpin - unpin the given range of pages. Returns zero on success.
  *
- * Caller must hold ashmem_mutex.
+ * Caller must hold asma->lock.
  */
 static int ashmem_unpin(struct ashmem_area *asma, size_t pgstart, size_t pgend)
 {
@@ -670,7 +804,7 @@ restart:
  * ashmem_get_pin_status - Returns ASHMEM_IS_UNPINNED if _any_ pages in the
  * given interval are unpinned and ASHMEM_IS_PINNED otherwise.
  *
- * Caller must hold ashmem_mutex.
+ * Caller must hold asma->lock.
  */
 static int ashmem_get_pin_status(struct ashmem_area *asma, size_t pgstart,
 				 size_t pgend)
@@ -719,7 +853,7 @@ static int ashmem_pin_unpin(struct ashmem_area *asma, unsigned long cmd,
 	pgstart = pin.offset / PAGE_SIZE;
 	pgend = pgstart + (pin.len / PAGE_SIZE) - 1;
 
-	mutex_lock(&ashmem_mutex);
+	mutex_lock(&asma->lock);
 
 	switch (cmd) {
 	case ASHMEM_PIN:
@@ -733,7 +867,7 @@ static int ashmem_pin_unpin(struct ashmem_area *asma, unsigned long cmd,
 		break;
 	}
 
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->lock);
 
 	return ret;
 }
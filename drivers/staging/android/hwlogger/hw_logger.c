@@ -30,6 +30,9 @@
 #include <linux/time.h>
 #include <linux/vmalloc.h>
 #include <linux/aio.h>
+#include <linux/mm.h>
+#include <linux/percpu.h>
+#include <linux/seqlock.h>
 #if (LINUX_VERSION_CODE >= KERNEL_VERSION(4,1,0))
 #include <linux/uio.h>
 #endif
@@ -76,6 +79,33 @@ typedef enum android_LogPriority {
 	ANDROID_LOG_SILENT,	/* only for SetMinPriority(); must be last */
 } android_LogPriority;
 
+/*
+ * Writers never take log->mutex. Each entry is appended to a staging ring
+ * owned by the CPU the writer runs on, with preemption and page faults
+ * disabled so that CPU is the ring's only producer. Whoever holds
+ * log->mutex next (a reader, or a writer finding its staging ring half
+ * full) drains all staging rings into the main ring, oldest entry first.
+ */
+#define LOGGER_PCPU_MIN_SIZE	(8 * 1024)
+
+/**
+ * struct logger_pcpu - a log's staging ring on one CPU
+ * @buffer:	The ring, log->pcpu_size bytes
+ * @seq:	Bumped around every append, lets the drain detect overwrites
+ * @w_pos:	Bytes ever appended, only written by the owning CPU
+ * @tail_pos:	Position of the oldest entry still in the ring
+ * @r_pos:	Position drained up to, protected by log->mutex
+ * @dropped:	Entries overwritten before they were drained
+ */
+struct logger_pcpu {
+	unsigned char *buffer;
+	seqcount_t seq;
+	u64 w_pos;
+	u64 tail_pos;
+	u64 r_pos;
+	unsigned int dropped;
+};
+
 /**
  * struct logger_log - represents a specific log, such as 'main' or 'radio'
  * @buffer:	The actual ring buffer
@@ -87,6 +117,10 @@ typedef enum android_LogPriority {
  * @head:	The head, or location that readers start reading at.
  * @size:	The size of the log
  * @logs:	The list of log channels
+ * @ctrl:	Control page mapped to mmap readers, @buffer follows it
+ * @pcpu:	Per-CPU staging rings writers append to
+ * @pcpu_size:	Size of each staging ring
+ * @drain_buf:	Room for one entry while it moves to @buffer
  *
  * This structure lives from module insertion until module removal, so it does
  * not need additional reference counting. The structure is protected by the
@@ -102,6 +136,10 @@ struct logger_log {
 	size_t head;
 	size_t size;
 	struct list_head logs;
+	struct logger_mmap_ctrl *ctrl;
+	struct logger_pcpu __percpu *pcpu;
+	size_t pcpu_size;
+	unsigned char *drain_buf;
 };
 
 static LIST_HEAD(log_list);
@@ -113,6 +151,8 @@ static LIST_HEAD(log_list);
  * @r_off:	The current read head offset.
  * @r_all:	Reader can read all entries
  * @r_ver:	Reader ABI version
+ * @r_mapped:	Reader has mmap()ed the log
+ * @r_seen:	ctrl->written when poll() last reported POLLIN to a mapped reader
  *
  * This object lives from open to release, so we don't need additional
  * reference counting. The structure is protected by log->mutex.
@@ -123,8 +163,12 @@ struct logger_reader {
 	size_t r_off;
 	bool r_all;
 	int r_ver;
+	bool r_mapped;
+	u64 r_seen;
 };
 
+static void logger_drain(struct logger_log *log);
+
 /* logger_offset - returns index 'n' into the log via (optimized) modulus */
 static size_t logger_offset(struct logger_log *log, size_t n)
 {
@@ -329,6 +373,7 @@ start:
 
 		prepare_to_wait(&log->wq, &wait, TASK_INTERRUPTIBLE);
 
+		logger_drain(log);
 		ret = (log->w_off == reader->r_off);
 		mutex_unlock(&log->mutex);
 		if (!ret)
@@ -442,8 +487,12 @@ static void fix_up_readers(struct logger_log *log, size_t len)
 	size_t new = logger_offset(log, old + len);
 	struct logger_reader *reader;
 
-	if (is_between(old, new, log->head))
-		log->head = get_next_entry(log, log->head, len);
+	if (is_between(old, new, log->head)) {
+		size_t head = get_next_entry(log, log->head, len);
+
+		log->ctrl->head_pos += logger_offset(log, head - log->head);
+		log->head = head;
+	}
 
 	list_for_each_entry(reader, &log->readers, list)
 	    if (is_between(old, new, reader->r_off))
@@ -466,49 +515,319 @@ static void do_write_log(struct logger_log *log, const void *buf, size_t count)
 		memcpy(log->buffer, buf + len, count - len);
 
 	log->w_off = logger_offset(log, log->w_off + count);
+	log->ctrl->written += count;
+}
 
+static size_t pcpu_offset(struct logger_log *log, u64 pos)
+{
+	return (size_t)pos & (log->pcpu_size - 1);
+}
+
+static void pcpu_copy_in(struct logger_log *log, struct logger_pcpu *pcpu,
+			 u64 pos, const void *src, size_t count)
+{
+	size_t off = pcpu_offset(log, pos);
+	size_t len = min(count, log->pcpu_size - off);
+
+	memcpy(pcpu->buffer + off, src, len);
+	if (count != len)
+		memcpy(pcpu->buffer, src + len, count - len);
+}
+
+/* page faults are disabled, a non-resident user page fails the copy */
+static int pcpu_copy_in_user(struct logger_log *log, struct logger_pcpu *pcpu,
+			     u64 pos, const void __user *src, size_t count)
+{
+	size_t off = pcpu_offset(log, pos);
+	size_t len = min(count, log->pcpu_size - off);
+
+	if (__copy_from_user_inatomic(pcpu->buffer + off, src, len))
+		return -EFAULT;
+	if (count != len &&
+	    __copy_from_user_inatomic(pcpu->buffer, src + len, count - len))
+		return -EFAULT;
+	return 0;
+}
+
+static void pcpu_copy_out(struct logger_log *log, struct logger_pcpu *pcpu,
+			  u64 pos, void *dst, size_t count)
+{
+	size_t off = pcpu_offset(log, pos);
+	size_t len = min(count, log->pcpu_size - off);
+
+	memcpy(dst, pcpu->buffer + off, len);
+	if (count != len)
+		memcpy(dst + len, pcpu->buffer, count - len);
 }
 
 /*
- * do_write_log_user - writes 'len' bytes from the user-space buffer 'buf' to
- * the log 'log'
+ * logger_stage - append one entry to this CPU's staging ring
  *
- * The caller needs to hold log->mutex.
+ * The payload is taken from 'iov', in user or kernel memory as 'user' says.
+ * Returns -EFAULT if a user page was not resident, the caller then retries
+ * from a kernel copy of the payload.
+ */
+static int logger_stage(struct logger_log *log, struct logger_entry *header,
+			const struct iovec *iov, unsigned long nr_segs,
+			bool user)
+{
+	struct logger_pcpu *pcpu;
+	size_t total = sizeof(struct logger_entry) + header->len;
+	size_t left = header->len;
+	u64 pos;
+	int ret = 0;
+
+	pcpu = get_cpu_ptr(log->pcpu);
+	pagefault_disable();
+	write_seqcount_begin(&pcpu->seq);
+
+	/* make room by dropping the oldest entries, drained or not */
+	while (pcpu->w_pos + total - pcpu->tail_pos > log->pcpu_size) {
+		struct logger_entry old;
+
+		pcpu_copy_out(log, pcpu, pcpu->tail_pos, &old, sizeof(old));
+		if (pcpu->tail_pos >= pcpu->r_pos)
+			pcpu->dropped++;
+		pcpu->tail_pos += sizeof(struct logger_entry) + old.len;
+	}
+
+	pos = pcpu->w_pos;
+	pcpu_copy_in(log, pcpu, pos, header, sizeof(struct logger_entry));
+	pos += sizeof(struct logger_entry);
+
+	for (; nr_segs > 0 && left; nr_segs--, iov++) {
+		size_t len = min_t(size_t, iov->iov_len, left);
+
+		if (user)
+			ret = pcpu_copy_in_user(log, pcpu, pos,
+						iov->iov_base, len);
+		else
+			pcpu_copy_in(log, pcpu, pos,
+				     (const void __force *)iov->iov_base, len);
+		if (ret)
+			break;
+
+		pos += len;
+		left -= len;
+	}
+
+	/* a partly copied entry is abandoned, it never becomes visible */
+	if (!ret)
+		pcpu->w_pos = pos;
+
+	write_seqcount_end(&pcpu->seq);
+	pagefault_enable();
+	put_cpu_ptr(log->pcpu);
+
+	return ret;
+}
+
+/* fault the payload in through a bounce buffer and stage it from there */
+static int logger_stage_slow(struct logger_log *log,
+			     struct logger_entry *header,
+			     const struct iovec *iov, unsigned long nr_segs)
+{
+	struct iovec kvec;
+	unsigned char *buf;
+	size_t off = 0;
+	int ret = 0;
+
+	buf = kmalloc(header->len, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	for (; nr_segs > 0 && off < header->len; nr_segs--, iov++) {
+		size_t len = min_t(size_t, iov->iov_len, header->len - off);
+
+		if (copy_from_user(buf + off, iov->iov_base, len)) {
+			ret = -EFAULT;
+			goto out;
+		}
+		off += len;
+	}
+
+	kvec.iov_base = (void __user __force *)buf;
+	kvec.iov_len = header->len;
+	ret = logger_stage(log, header, &kvec, 1, false);
+out:
+	kfree(buf);
+	return ret;
+}
+
+/*
+ * logger_pcpu_next - peek at the header of the next undrained entry
+ *
+ * Returns false if the staging ring has nothing left to drain. Entries the
+ * writer overwrote in the meantime are skipped.
+ *
+ * Caller must hold log->mutex.
+ */
+static bool logger_pcpu_next(struct logger_log *log, struct logger_pcpu *pcpu,
+			     struct logger_entry *header)
+{
+	unsigned int seq;
+	u64 r_pos, w_pos;
+
+	do {
+		seq = read_seqcount_begin(&pcpu->seq);
+		r_pos = max(pcpu->r_pos, pcpu->tail_pos);
+		w_pos = pcpu->w_pos;
+		if (r_pos != w_pos)
+			pcpu_copy_out(log, pcpu, r_pos, header,
+				      sizeof(struct logger_entry));
+	} while (read_seqcount_retry(&pcpu->seq, seq));
+
+	pcpu->r_pos = r_pos;
+	return r_pos != w_pos;
+}
+
+/*
+ * logger_pcpu_pop - copy the entry logger_pcpu_next() found into
+ * log->drain_buf. Returns false if the writer overwrote it first.
  *
- * Returns 'count' on success, negative error code on failure.
+ * Caller must hold log->mutex.
  */
-static ssize_t do_write_log_from_user(struct logger_log *log,
-				      const void __user *buf, size_t count)
+static bool logger_pcpu_pop(struct logger_log *log, struct logger_pcpu *pcpu)
 {
+	struct logger_entry *entry = (struct logger_entry *)log->drain_buf;
+	unsigned int seq;
+	bool valid;
 	size_t len;
 
-	len = min(count, log->size - log->w_off);
-	if (len && copy_from_user(log->buffer + log->w_off, buf, len))
-		return -EFAULT;
+	do {
+		seq = read_seqcount_begin(&pcpu->seq);
+		valid = pcpu->r_pos >= pcpu->tail_pos;
+		if (valid) {
+			pcpu_copy_out(log, pcpu, pcpu->r_pos, entry,
+				      sizeof(struct logger_entry));
+			len = min_t(size_t, entry->len,
+				    LOGGER_ENTRY_MAX_PAYLOAD);
+			pcpu_copy_out(log, pcpu,
+				      pcpu->r_pos + sizeof(struct logger_entry),
+				      entry->msg, len);
+		}
+	} while (read_seqcount_retry(&pcpu->seq, seq));
 
-	if (count != len)
-		if (copy_from_user(log->buffer, buf + len, count - len))
-			/*
-			 * Note that by not updating w_off, this abandons the
-			 * portion of the new entry that *was* successfully
-			 * copied, just above.  This is intentional to avoid
-			 * message corruption from missing fragments.
-			 */
-			return -EFAULT;
+	if (valid)
+		pcpu->r_pos += sizeof(struct logger_entry) + entry->len;
+	return valid;
+}
 
-	log->w_off = logger_offset(log, log->w_off + count);
+static bool logger_entry_before(const struct logger_entry *a,
+				const struct logger_entry *b)
+{
+	if (a->sec != b->sec)
+		return a->sec < b->sec;
+	return a->nsec < b->nsec;
+}
 
-	return count;
+/*
+ * logger_drain - move staged entries into the main ring, merging the CPUs'
+ * staging rings by timestamp. Stops after a ring's worth, so writers that
+ * keep up with the drain cannot hold log->mutex here forever.
+ *
+ * Caller must hold log->mutex.
+ */
+static void logger_drain(struct logger_log *log)
+{
+	struct logger_entry *entry = (struct logger_entry *)log->drain_buf;
+	struct logger_entry header, oldest;
+	struct logger_pcpu *src;
+	unsigned int dropped = 0;
+	size_t budget = log->size;
+	bool appending = false;
+	int cpu;
+
+	while (budget) {
+		src = NULL;
+		for_each_possible_cpu(cpu) {
+			struct logger_pcpu *pcpu = per_cpu_ptr(log->pcpu, cpu);
+
+			if (!logger_pcpu_next(log, pcpu, &header))
+				continue;
+			if (!src || logger_entry_before(&header, &oldest)) {
+				src = pcpu;
+				oldest = header;
+			}
+		}
+		if (!src)
+			break;
+
+		if (!logger_pcpu_pop(log, src))
+			continue;
+
+		if (!appending) {
+			log->ctrl->seq++;
+			smp_wmb();
+			appending = true;
+		}
+
+		/*
+		 * Fix up any readers, pulling them forward to the first
+		 * readable entry after (what will be) the new write offset.
+		 */
+		fix_up_readers(log, sizeof(struct logger_entry) + entry->len);
+		do_write_log(log, entry, sizeof(struct logger_entry) + entry->len);
+		budget -= min(budget, sizeof(struct logger_entry) + entry->len);
+	}
+
+	for_each_possible_cpu(cpu)
+		dropped += ACCESS_ONCE(per_cpu_ptr(log->pcpu, cpu)->dropped);
+
+	if (appending) {
+		log->ctrl->dropped = dropped;
+		smp_wmb();
+		log->ctrl->seq++;
+	}
+}
+
+/*
+ * logger_write_entry - stage one entry and wake the readers
+ *
+ * Returns the payload length on success, negative error code on failure.
+ */
+static ssize_t logger_write_entry(struct logger_log *log,
+				  struct logger_entry *header,
+				  const struct iovec *iov,
+				  unsigned long nr_segs, bool user)
+{
+	struct logger_pcpu *pcpu;
+	int ret;
+
+	/* null writes succeed, return zero */
+	if (unlikely(!header->len))
+		return 0;
+
+	ret = logger_stage(log, header, iov, nr_segs, user);
+	if (unlikely(ret == -EFAULT && user))
+		ret = logger_stage_slow(log, header, iov, nr_segs);
+	if (unlikely(ret))
+		return ret;
+
+	/*
+	 * With nobody reading, keep the staging ring from lapping itself by
+	 * draining it once half full; if someone else holds the mutex they
+	 * are about to drain anyway.
+	 */
+	pcpu = raw_cpu_ptr(log->pcpu);
+	if (ACCESS_ONCE(pcpu->w_pos) - ACCESS_ONCE(pcpu->r_pos) >
+	    log->pcpu_size / 2 && mutex_trylock(&log->mutex)) {
+		logger_drain(log);
+		mutex_unlock(&log->mutex);
+	}
+
+	/* wake up any blocked readers */
+	wake_up_interruptible(&log->wq);
+
+	return header->len;
 }
 
 #if (LINUX_VERSION_CODE >= KERNEL_VERSION(4,1,0))
 static ssize_t hw_logger_write_iter(struct kiocb *iocb, struct iov_iter *from)
 {
 	struct logger_log *log = file_get_log(iocb->ki_filp);
-	size_t orig = log->w_off;
 	struct logger_entry header;
 	struct timespec now;
-	ssize_t ret = 0;
 	unsigned long nr_segs = from->nr_segs;
 	struct iovec *iov  = from->iov;
 
@@ -524,47 +843,7 @@ static ssize_t hw_logger_write_iter(struct kiocb *iocb, struct iov_iter *from)
 		  LOGGER_ENTRY_MAX_PAYLOAD);
 	header.hdr_size = sizeof(struct logger_entry);
 
-	/* null writes succeed, return zero */
-	if (unlikely(!header.len))
-		return 0;
-
-	mutex_lock(&log->mutex);
-
-	/*
-	 * Fix up any readers, pulling them forward to the first readable
-	 * entry after (what will be) the new write offset. We do this now
-	 * because if we partially fail, we can end up with clobbered log
-	 * entries that encroach on readable buffer.
-	 */
-	fix_up_readers(log, sizeof(struct logger_entry) + header.len);
-
-	do_write_log(log, &header, sizeof(struct logger_entry));
-
-	while (nr_segs-- > 0) {
-		size_t len;
-		ssize_t nr;
-
-		/* figure out how much of this vector we can keep */
-		len = min_t(size_t, iov->iov_len, header.len - ret);
-
-		/* write out this segment's payload */
-		nr = do_write_log_from_user(log, iov->iov_base, len);
-		if (unlikely(nr < 0)) {
-			log->w_off = orig;
-			mutex_unlock(&log->mutex);
-			return nr;
-		}
-
-		iov++;
-		ret += nr;
-	}
-
-	mutex_unlock(&log->mutex);
-
-	/* wake up any blocked readers */
-	wake_up_interruptible(&log->wq);
-
-	return ret;
+	return logger_write_entry(log, &header, iov, nr_segs, true);
 }
 #else
 /*
@@ -576,10 +855,8 @@ static ssize_t hw_logger_aio_write(struct kiocb *iocb, const struct iovec *iov,
 			unsigned long nr_segs, loff_t ppos)
 {
 	struct logger_log *log = file_get_log(iocb->ki_filp);
-	size_t orig = log->w_off;
 	struct logger_entry header;
 	struct timespec now;
-	ssize_t ret = 0;
 
 	now = current_kernel_time();
 
@@ -593,47 +870,7 @@ static ssize_t hw_logger_aio_write(struct kiocb *iocb, const struct iovec *iov,
 		  LOGGER_ENTRY_MAX_PAYLOAD);
 	header.hdr_size = sizeof(struct logger_entry);
 
-	/* null writes succeed, return zero */
-	if (unlikely(!header.len))
-		return 0;
-
-	mutex_lock(&log->mutex);
-
-	/*
-	 * Fix up any readers, pulling them forward to the first readable
-	 * entry after (what will be) the new write offset. We do this now
-	 * because if we partially fail, we can end up with clobbered log
-	 * entries that encroach on readable buffer.
-	 */
-	fix_up_readers(log, sizeof(struct logger_entry) + header.len);
-
-	do_write_log(log, &header, sizeof(struct logger_entry));
-
-	while (nr_segs-- > 0) {
-		size_t len;
-		ssize_t nr;
-
-		/* figure out how much of this vector we can keep */
-		len = min_t(size_t, iov->iov_len, header.len - ret);
-
-		/* write out this segment's payload */
-		nr = do_write_log_from_user(log, iov->iov_base, len);
-		if (unlikely(nr < 0)) {
-			log->w_off = orig;
-			mutex_unlock(&log->mutex);
-			return nr;
-		}
-
-		iov++;
-		ret += nr;
-	}
-
-	mutex_unlock(&log->mutex);
-
-	/* wake up any blocked readers */
-	wake_up_interruptible(&log->wq);
-
-	return ret;
+	return logger_write_entry(log, &header, iov, nr_segs, true);
 }
 #endif
 
@@ -674,6 +911,8 @@ static int logger_open(struct inode *inode, struct file *file)
 
 		reader->log = log;
 		reader->r_ver = 1;
+		reader->r_mapped = false;
+		reader->r_seen = 0;
 		reader->r_all = in_egroup_p(inode->i_gid) ||
 		    capable(CAP_SYSLOG);
 
@@ -736,6 +975,18 @@ static unsigned int logger_poll(struct file *file, poll_table *wait)
 	poll_wait(file, &log->wq, wait);
 
 	mutex_lock(&log->mutex);
+	logger_drain(log);
+
+	if (reader->r_mapped) {
+		/* mapped readers drain the ring themselves, tell them once */
+		if (log->ctrl->written != reader->r_seen) {
+			reader->r_seen = log->ctrl->written;
+			ret |= POLLIN | POLLRDNORM;
+		}
+		mutex_unlock(&log->mutex);
+		return ret;
+	}
+
 	if (!reader->r_all)
 		reader->r_off = get_next_entry_by_uid(log, reader->r_off, current_euid());	/*lint !e666 */
 
@@ -753,6 +1004,7 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 	long ret = -EINVAL;
 
 	mutex_lock(&log->mutex);
+	logger_drain(log);
 
 	switch (cmd) {
 	case LOGGER_GET_LOG_BUF_SIZE:
@@ -797,7 +1049,12 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 		}
 		list_for_each_entry(reader, &log->readers, list)
 		    reader->r_off = log->w_off;
+		log->ctrl->seq++;
+		smp_wmb();
 		log->head = log->w_off;
+		log->ctrl->head_pos = log->ctrl->written;
+		smp_wmb();
+		log->ctrl->seq++;
 		ret = 0;
 		break;
 	case FIONREAD:
@@ -814,6 +1071,43 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 	return ret;
 }
 
+/*
+ * logger_mmap - map the control page and the main ring read-only
+ *
+ * The mapping shows every uid's entries, so only readers that may read
+ * them all can have it. See struct logger_mmap_ctrl for the protocol.
+ */
+static int logger_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct logger_reader *reader;
+	struct logger_log *log;
+	int ret;
+
+	if (!(file->f_mode & FMODE_READ))
+		return -EBADF;
+
+	reader = file->private_data;
+	log = reader->log;
+
+	if (!reader->r_all || (vma->vm_flags & VM_WRITE))
+		return -EPERM;
+
+	if (vma->vm_pgoff ||
+	    vma->vm_end - vma->vm_start != PAGE_SIZE + log->size)
+		return -EINVAL;
+
+	vma->vm_flags &= ~VM_MAYWRITE;
+	ret = remap_vmalloc_range(vma, log->ctrl, 0);
+	if (ret)
+		return ret;
+
+	mutex_lock(&log->mutex);
+	reader->r_mapped = true;
+	mutex_unlock(&log->mutex);
+
+	return 0;
+}
+
 static const struct file_operations logger_fops = {
 	.owner = THIS_MODULE,
 	.read = logger_read,
@@ -823,6 +1117,7 @@ static const struct file_operations logger_fops = {
 	.aio_write = hw_logger_aio_write,
 #endif
 	.poll = logger_poll,
+	.mmap = logger_mmap,
 	.unlocked_ioctl = logger_ioctl,
 	.compat_ioctl = logger_ioctl,
 	.open = logger_open,
@@ -999,6 +1294,44 @@ static struct miscdevice log_tag_misc_dev = {
 	.parent = NULL,
 };
 
+static void free_log_pcpu(struct logger_log *log)
+{
+	int cpu;
+
+	if (!log->pcpu)
+		return;
+
+	for_each_possible_cpu(cpu)
+		vfree(per_cpu_ptr(log->pcpu, cpu)->buffer);
+	free_percpu(log->pcpu);
+	log->pcpu = NULL;
+}
+
+/* staging rings get a quarter of the log each, enough for a full entry */
+static int __init create_log_pcpu(struct logger_log *log)
+{
+	struct logger_pcpu *pcpu;
+	int cpu;
+
+	log->pcpu_size = max_t(size_t, log->size / 4, LOGGER_PCPU_MIN_SIZE);
+
+	log->pcpu = alloc_percpu(struct logger_pcpu);
+	if (!log->pcpu)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		pcpu = per_cpu_ptr(log->pcpu, cpu);
+		pcpu->buffer = vmalloc_node(log->pcpu_size, cpu_to_node(cpu));
+		if (!pcpu->buffer) {
+			free_log_pcpu(log);
+			return -ENOMEM;
+		}
+		seqcount_init(&pcpu->seq);
+	}
+
+	return 0;
+}
+
 /*
  * Log size must must be a power of two, and greater than
  * (LOGGER_ENTRY_MAX_PAYLOAD + sizeof(struct logger_entry)).
@@ -1009,7 +1342,8 @@ static int __init create_log(char *log_name, int size)
 	struct logger_log *log;
 	unsigned char *buffer;
 
-	buffer = vmalloc(size);
+	/* the control page and the ring are mapped to readers together */
+	buffer = vmalloc_user(PAGE_SIZE + size);
 	if (buffer == NULL)
 		return -ENOMEM;
 
@@ -1018,7 +1352,21 @@ static int __init create_log(char *log_name, int size)
 		ret = -ENOMEM;
 		goto out_free_buffer;
 	}
-	log->buffer = buffer;
+	log->ctrl = (struct logger_mmap_ctrl *)buffer;
+	log->ctrl->size = size;
+	log->buffer = buffer + PAGE_SIZE;
+	log->size = size;
+
+	log->drain_buf = kmalloc(sizeof(struct logger_entry) +
+				 LOGGER_ENTRY_MAX_PAYLOAD, GFP_KERNEL);
+	if (log->drain_buf == NULL) {
+		ret = -ENOMEM;
+		goto out_free_log;
+	}
+
+	ret = create_log_pcpu(log);
+	if (ret)
+		goto out_free_log;
 
 	log->misc.minor = MISC_DYNAMIC_MINOR;
 	log->misc.name = kstrdup(log_name, GFP_KERNEL);
@@ -1035,7 +1383,6 @@ static int __init create_log(char *log_name, int size)
 	mutex_init(&log->mutex);
 	log->w_off = 0;
 	log->head = 0;
-	log->size = size;
 
 	INIT_LIST_HEAD(&log->logs);
 	list_add_tail(&log->logs, &log_list);
@@ -1045,6 +1392,7 @@ static int __init create_log(char *log_name, int size)
 	if (unlikely(ret)) {
 		pr_err("failed to register misc device for log '%s'!\n",
 		       log->misc.name);
+		list_del(&log->logs);
 		goto out_free_log;
 	}
 
@@ -1053,6 +1401,9 @@ static int __init create_log(char *log_name, int size)
 	return 0;
 
 out_free_log:
+	free_log_pcpu(log);
+	kfree(log->drain_buf);
+	kfree(log->misc.name);
 	kfree(log);
 
 out_free_buffer:
@@ -1114,7 +1465,9 @@ static void __exit logger_exit(void)
 	list_for_each_entry_safe(current_log, next_log, &log_list, logs) {
 		/* we have to delete all the entry inside log_list */
 		misc_deregister(&current_log->misc);
-		vfree(current_log->buffer);
+		free_log_pcpu(current_log);
+		kfree(current_log->drain_buf);
+		vfree(current_log->ctrl);
 		kfree(current_log->misc.name);
 		list_del(&current_log->logs);
 		kfree(current_log);
@@ -1160,9 +1513,7 @@ ssize_t write_log_to_exception(const char *category, char level,
 
 	struct logger_entry header;
 	struct timespec now;
-	ssize_t ret = 0;
 	struct iovec vec[4];
-	struct iovec *iov = vec;
 	int nr_segs = sizeof(vec) / sizeof(vec[0]);
 	int iovc_ki_left_len = 0;
 	kuid_t euid = { 0 };
@@ -1199,38 +1550,7 @@ ssize_t write_log_to_exception(const char *category, char level,
 	if (unlikely(!log))
 		return 0;
 
-	mutex_lock(&log->mutex);
-
-	/*
-	 * Fix up any readers, pulling them forward to the first readable
-	 * entry after (what will be) the new write offset. We do this now
-	 * because if we partially fail, we can end up with clobbered log
-	 * entries that encroach on readable buffer.
-	 */
-	fix_up_readers(log, sizeof(struct logger_entry) + header.len);
-
-	do_write_log(log, &header, sizeof(struct logger_entry));
-
-	while (nr_segs-- > 0) {
-		size_t len;
-		ssize_t nr = 0;
-
-		/* figure out how much of this vector we can keep */
-		len = min_t(size_t, iov->iov_len, header.len - ret);
-
-		/* write out this segment's payload */
-		do_write_log(log, iov->iov_base, len);
-
-		iov++;
-		ret += nr;
-	}
-
-	mutex_unlock(&log->mutex);
-
-	/* wake up any blocked readers */
-	wake_up_interruptible(&log->wq);
-
-	return ret;
+	return logger_write_entry(log, &header, vec, nr_segs, false);
 }
 
 EXPORT_SYMBOL(write_log_to_exception);
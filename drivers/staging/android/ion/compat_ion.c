@@ -318,6 +318,7 @@ long compat_ion_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 	case ION_IOC_IMPORT:
 	case ION_IOC_SYNC:
 	case ION_IOC_INV:
+	case ION_IOC_SYNC_RANGE:
 		return filp->f_op->unlocked_ioctl(filp, cmd,
 						(unsigned long)compat_ptr(arg));
 	default:
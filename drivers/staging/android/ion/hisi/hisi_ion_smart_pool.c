@@ -25,10 +25,15 @@
 #include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <linux/vmalloc.h>
+#include <linux/hisi/hisi_ion.h>
 #include <linux/hisi/ion-iommu.h>
 #include <linux/sizes.h>
 #include <linux/module.h>
 #include <linux/kthread.h>
+#include <linux/compaction.h>
+#include <linux/delay.h>
+#include <linux/jiffies.h>
+#include <linux/mmzone.h>
 
 #include "ion.h"
 #include "hisi_ion_smart_pool.h"
@@ -51,6 +56,31 @@ static unsigned int smart_pool_orders[] = {8, 4, 0};
 
 static const int smart_pool_num_orders = ARRAY_SIZE(smart_pool_orders);
 
+/*
+ * Per use case prefill targets in pages, armed from userspace ahead of
+ * a known burst (camera start-up allocates ~200MB of high-order buffers
+ * at once).  Index 0 is unused: the default scene follows
+ * smart_pool_water_mark.
+ */
+static int smart_pool_scene_water_mark[ION_SMART_POOL_SCENE_MAX] = {
+	[ION_SMART_POOL_SCENE_CAMERA] = 200 * 64 * 4,
+	[ION_SMART_POOL_SCENE_VIDEO] = 64 * 64 * 4,
+	[ION_SMART_POOL_SCENE_GAME] = 96 * 64 * 4,
+};
+static int smart_pool_scene_num = ION_SMART_POOL_SCENE_MAX;
+static unsigned int smart_pool_scene_timeout_ms = 10000;
+
+static int smart_pool_scene;
+static int smart_pool_scene_armed_mark;
+static unsigned long smart_pool_scene_expires;
+
+/* high-order fills retried after kicking kcompactd, and the wait between */
+#define SMART_POOL_COMPACT_RETRIES	3
+#define SMART_POOL_COMPACT_WAIT_MS	20
+
+static atomic_long_t smart_pool_hits[ARRAY_SIZE(smart_pool_orders)];
+static atomic_long_t smart_pool_fallbacks[ARRAY_SIZE(smart_pool_orders)];
+
 #define SMART_POOL_MIN(x, y) (((x) < (y)) ? (x) : (y))
 
 bool ion_smart_is_graphic_buffer(struct ion_buffer *buffer)
@@ -67,6 +97,45 @@ void ion_smart_set_water_mark(int water_mark)
 	smart_pool_water_mark = water_mark;
 }
 
+static int sp_water_mark(void)
+{
+	int scene = ACCESS_ONCE(smart_pool_scene);
+	int mark = ACCESS_ONCE(smart_pool_scene_armed_mark);
+
+	if (scene == ION_SMART_POOL_SCENE_DEFAULT ||
+	    time_after_eq(jiffies, ACCESS_ONCE(smart_pool_scene_expires)))
+		return smart_pool_water_mark;
+
+	return max(mark, smart_pool_water_mark);
+}
+
+int ion_smart_set_scene(int scene, int water_mark, unsigned int timeout_ms)
+{
+	if (scene < 0 || scene >= ION_SMART_POOL_SCENE_MAX) {
+		pr_err("%s: invalid scene %d!\n", __func__, scene);
+		return -EINVAL;
+	}
+
+	if (!water_mark)
+		water_mark = smart_pool_scene_water_mark[scene];
+	if (water_mark < 0 || water_mark > totalram_pages / 4) {
+		pr_err("%s: invalid water mark %d!\n", __func__, water_mark);
+		return -EINVAL;
+	}
+
+	if (!timeout_ms)
+		timeout_ms = smart_pool_scene_timeout_ms;
+
+	smart_pool_scene_armed_mark = water_mark;
+	smart_pool_scene_expires = jiffies + msecs_to_jiffies(timeout_ms);
+	/* publish the mark and deadline before the scene that selects them */
+	smp_wmb();
+	smart_pool_scene = scene;
+
+	ion_smart_pool_wakeup_process();
+	return 0;
+}
+
 static int sp_order_to_index(unsigned int order)
 {
 	int i;
@@ -145,6 +214,33 @@ static int sp_fill_pool_once(struct ion_page_pool *pool)
 	return 0;
 }
 
+/*
+ * High-order fills use NORETRY allocations that fail as soon as memory
+ * is fragmented.  When that happens, let kcompactd build free blocks of
+ * that order in the background and retry a few times before the fill
+ * falls back to the next order.
+ */
+static int sp_fill_pool_compact(struct ion_page_pool *pool)
+{
+	pg_data_t *pgdat;
+	int retries;
+
+	if (!sp_fill_pool_once(pool))
+		return 0;
+	if (!pool->order)
+		return -ENOMEM;
+
+	for (retries = 0; retries < SMART_POOL_COMPACT_RETRIES; retries++) {
+		for_each_online_pgdat(pgdat)
+			wakeup_kcompactd(pgdat, pool->order, ZONE_NORMAL);
+		msleep_interruptible(SMART_POOL_COMPACT_WAIT_MS);
+		if (!sp_fill_pool_once(pool))
+			return 0;
+	}
+
+	return -ENOMEM;
+}
+
 static int ion_smart_pool_kworkthread(void *p)
 {
 	int i;
@@ -165,9 +261,8 @@ static int ion_smart_pool_kworkthread(void *p)
 
 		smart_pool_wait_flag = 0;
 		for (i = 0; i < smart_pool_num_orders; i++) {
-			while (sp_pool_total_pages(pool) <
-			       smart_pool_water_mark) {
-				if (sp_fill_pool_once(pool->pools[i]) < 0)
+			while (sp_pool_total_pages(pool) < sp_water_mark()) {
+				if (sp_fill_pool_compact(pool->pools[i]) < 0)
 					break;
 			}
 		}
@@ -204,6 +299,7 @@ struct page *ion_smart_pool_allocate(struct ion_smart_pool *pool,
 		page = ion_page_pool_alloc(pool->pools[i]);
 		if (!page)
 			continue;
+		atomic_long_inc(&smart_pool_hits[i]);
 		if (smart_pool_alloc_size) {
 			smart_pool_alloc_size +=
 				PAGE_SIZE << compound_order(page);
@@ -214,6 +310,24 @@ struct page *ion_smart_pool_allocate(struct ion_smart_pool *pool,
 	return NULL;
 }
 
+/*
+ * Called by the system heap for each chunk of a graphic buffer that the
+ * smart pool could not supply and that had to come from the heap pools
+ * or the page allocator instead.
+ */
+void ion_smart_pool_count_fallback(struct page *page)
+{
+	unsigned int order = compound_order(page);
+	int i;
+
+	for (i = 0; i < smart_pool_num_orders; i++) {
+		if (order == smart_pool_orders[i]) {
+			atomic_long_inc(&smart_pool_fallbacks[i]);
+			return;
+		}
+	}
+}
+
 void ion_smart_pool_wakeup_process(void)
 {
 	if (!smart_pool_enable)
@@ -251,7 +365,7 @@ int ion_smart_pool_free(struct ion_smart_pool *pool, struct page *page)
 
 	order = compound_order(page);
 
-	if (sp_pool_total_pages(pool) < MAX_POOL_SIZE) {
+	if (sp_pool_total_pages(pool) < max(MAX_POOL_SIZE, sp_water_mark())) {
 		ion_smart_sp_init_page(page);
 		ion_page_pool_free(pool->pools[sp_order_to_index(order)], page);
 		return 0;
@@ -277,7 +391,7 @@ int ion_smart_pool_shrink(struct ion_smart_pool *smart_pool,
 		return ion_page_pool_shrink(pool, gfp_mask, 0);
 
 	nr_max_free = sp_pool_total_pages(smart_pool) -
-	    (smart_pool_water_mark + LOWORDER_WATER_MASK);
+	    (sp_water_mark() + LOWORDER_WATER_MASK);
 	nr_to_free = SMART_POOL_MIN(nr_max_free, nr_to_scan);
 
 	if (nr_to_free <= 0)
@@ -290,6 +404,8 @@ int ion_smart_pool_shrink(struct ion_smart_pool *smart_pool,
 void ion_smart_pool_debug_show_total(struct seq_file *s,
 				     struct ion_smart_pool *smart_pool)
 {
+	int i;
+
 	if ((NULL == s) || (NULL == smart_pool)) {
 		pr_err("%s: s/smart_pool is NULL!\n", __func__);
 		return;
@@ -297,6 +413,13 @@ void ion_smart_pool_debug_show_total(struct seq_file *s,
 	seq_puts(s, "----------------------------------------------------\n");
 	seq_printf(s, "in smart pool =  %d total\n",
 		   sp_pool_total_pages(smart_pool) * 4 / 1024);
+	seq_printf(s, "smart pool water mark = %d pages, scene %d\n",
+		   sp_water_mark(), smart_pool_scene);
+	for (i = 0; i < smart_pool_num_orders; i++)
+		seq_printf(s, "order %u smart pool hits = %ld fallbacks = %ld\n",
+			   smart_pool_orders[i],
+			   atomic_long_read(&smart_pool_hits[i]),
+			   atomic_long_read(&smart_pool_fallbacks[i]));
 }
 
 struct ion_smart_pool *ion_smart_pool_create(void)
@@ -343,4 +466,14 @@ MODULE_PARM_DESC(debug_smart_pool_enable, "enable smart pool");
 module_param_named(debug_smart_pool_alloc_size, smart_pool_alloc_size, int,
 		0644);
 MODULE_PARM_DESC(debug_smart_pool_alloc_size, "alloc size from smartpool");
+
+module_param_array_named(debug_smart_pool_scene_water_mark,
+		smart_pool_scene_water_mark, int, &smart_pool_scene_num, 0644);
+MODULE_PARM_DESC(debug_smart_pool_scene_water_mark,
+		"per scene prefill water mark in pages");
+
+module_param_named(debug_smart_pool_scene_timeout_ms,
+		smart_pool_scene_timeout_ms, uint, 0644);
+MODULE_PARM_DESC(debug_smart_pool_scene_timeout_ms,
+		"default lifetime of an armed scene");
 /*lint -restore*/
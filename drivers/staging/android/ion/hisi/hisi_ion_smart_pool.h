@@ -39,4 +39,6 @@ int ion_smart_pool_shrink(struct ion_smart_pool *smart_pool,
 struct ion_smart_pool *ion_smart_pool_create(void);
 void ion_smart_pool_wakeup_process(void);
 void ion_smart_set_water_mark(int water_mark);
+int ion_smart_set_scene(int scene, int water_mark, unsigned int timeout_ms);
+void ion_smart_pool_count_fallback(struct page *page);
 #endif /* _ION_SMART_POOL_H */
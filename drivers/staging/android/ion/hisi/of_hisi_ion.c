@@ -307,6 +307,19 @@ static long hisi_ion_custom_ioctl(struct ion_client *client,
 			ion_smart_set_water_mark(smart_pool_info.water_mark);
 		break;
 	}
+	case ION_HISI_CUSTOM_SET_SMART_POOL_SCENE:
+	{
+		struct ion_smart_pool_scene_data scene_data;
+
+		if (copy_from_user(&scene_data, (void __user *)arg,
+				sizeof(scene_data))) {
+			return -EFAULT;
+		}
+		ret = ion_smart_set_scene(scene_data.scene,
+					  scene_data.water_mark,
+					  scene_data.timeout_ms);
+		break;
+	}
 #endif
 
 	case ION_HISI_CLEAN_CACHES:
@@ -318,7 +331,8 @@ static long hisi_ion_custom_ioctl(struct ion_client *client,
 				sizeof(data))) {
 			return -EFAULT;
 		}
-		ret = ion_sync_for_device(client, data.fd);
+		ret = ion_sync_range(client, data.fd, data.offset, data.length,
+				     ION_SYNC_RANGE_FOR_DEVICE);
 		break;
 	}
 	case ION_HISI_INV_CACHES:
@@ -329,7 +343,8 @@ static long hisi_ion_custom_ioctl(struct ion_client *client,
 				sizeof(data))) {
 			return -EFAULT;
 		}
-		ret = ion_sync_for_cpu(client, data.fd);
+		ret = ion_sync_range(client, data.fd, data.offset, data.length,
+				     ION_SYNC_RANGE_FOR_CPU);
 		break;
 	}
 	default:
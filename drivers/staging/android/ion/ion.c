@@ -320,11 +320,136 @@ err2:
 	return ERR_PTR(ret);
 }
 
+/*
+ * The same buffers are mapped to DSS, GPU and the codec over and over.
+ * When the last user of an iommu mapping lets go it is kept, still mapped,
+ * on this list so that the next ion_map_iommu() of the buffer finds it
+ * ready. Idle mappings are torn down when their buffer is freed, when the
+ * iova space runs out and by the shrinker, oldest first. The lock nests
+ * inside buffer->lock; a mapping only changes between idle and in use
+ * with both held.
+ */
+static LIST_HEAD(ion_iommu_idle);
+static DEFINE_MUTEX(ion_iommu_idle_lock);
+static unsigned long ion_iommu_idle_count;
+static atomic_long_t ion_iommu_hits, ion_iommu_misses, ion_iommu_evicted;
+
+static bool iommu_map_cache = true;
+module_param(iommu_map_cache, bool, 0644);
+MODULE_PARM_DESC(iommu_map_cache, "keep iommu mappings of buffers after the last unmap");
+
+static bool ion_iommu_map_idle(struct ion_iommu_map *map)
+{
+	return !atomic_read(&map->ref.refcount);
+}
+
+static void ion_iommu_unlink_idle(struct ion_iommu_map *map)
+{
+	list_del_init(&map->idle);
+	ion_iommu_idle_count--;
+}
+
+/* buffer->lock held, or the buffer is being destroyed */
+static void ion_iommu_destroy_map(struct ion_iommu_map *map)
+{
+	struct ion_buffer *buffer = map->buffer;
+
+	buffer->heap->ops->unmap_iommu(map);
+	buffer->iommu_map = NULL;
+	kfree(map);
+}
+
+/* ion_iommu_idle_lock held */
+static unsigned long __ion_iommu_evict(unsigned long nr)
+{
+	struct ion_iommu_map *map, *tmp;
+	unsigned long freed = 0;
+
+	list_for_each_entry_safe(map, tmp, &ion_iommu_idle, idle) {
+		struct ion_buffer *buffer = map->buffer;
+
+		if (freed >= nr)
+			break;
+		/* buffer->lock comes first, so busy buffers are skipped */
+		if (!mutex_trylock(&buffer->lock))
+			continue;
+		ion_iommu_unlink_idle(map);
+		ion_iommu_destroy_map(map);
+		mutex_unlock(&buffer->lock);
+		freed++;
+	}
+	atomic_long_add(freed, &ion_iommu_evicted);
+	return freed;
+}
+
+static unsigned long ion_iommu_evict(unsigned long nr)
+{
+	unsigned long freed;
+
+	mutex_lock(&ion_iommu_idle_lock);
+	freed = __ion_iommu_evict(nr);
+	mutex_unlock(&ion_iommu_idle_lock);
+	return freed;
+}
+
+static unsigned long ion_iommu_cache_count(struct shrinker *shrinker,
+					   struct shrink_control *sc)
+{
+	return ACCESS_ONCE(ion_iommu_idle_count);
+}
+
+static unsigned long ion_iommu_cache_scan(struct shrinker *shrinker,
+					  struct shrink_control *sc)
+{
+	unsigned long freed;
+
+	if (!mutex_trylock(&ion_iommu_idle_lock))
+		return SHRINK_STOP;
+	freed = __ion_iommu_evict(sc->nr_to_scan);
+	mutex_unlock(&ion_iommu_idle_lock);
+	return freed;
+}
+
+static struct shrinker ion_iommu_cache_shrinker = {
+	.count_objects	= ion_iommu_cache_count,
+	.scan_objects	= ion_iommu_cache_scan,
+	.seeks		= DEFAULT_SEEKS,
+};
+
+static int ion_iommu_cache_show(struct seq_file *s, void *unused)
+{
+	seq_printf(s, "idle: %lu\nhits: %ld\nmisses: %ld\nevicted: %ld\n",
+		   ACCESS_ONCE(ion_iommu_idle_count),
+		   atomic_long_read(&ion_iommu_hits),
+		   atomic_long_read(&ion_iommu_misses),
+		   atomic_long_read(&ion_iommu_evicted));
+	return 0;
+}
+
+static int ion_iommu_cache_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ion_iommu_cache_show, NULL);
+}
+
+static const struct file_operations ion_iommu_cache_fops = {
+	.open = ion_iommu_cache_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 void ion_buffer_destroy(struct ion_buffer *buffer)
 {
 	if (buffer->heap->type != ION_HEAP_TYPE_CARVEOUT)
 		atomic_long_sub(buffer->size, &ion_total_size);
 
+	mutex_lock(&ion_iommu_idle_lock);
+	if (buffer->iommu_map && ion_iommu_map_idle(buffer->iommu_map)) {
+		ion_iommu_unlink_idle(buffer->iommu_map);
+		ion_iommu_destroy_map(buffer->iommu_map);
+	}
+	mutex_unlock(&ion_iommu_idle_lock);
+
 	if (buffer->iommu_map) {
 		pr_info("%s: iommu map not released, do unmap now!\n",
 				__func__);
@@ -918,6 +1043,9 @@ static int do_iommu_map(struct ion_buffer *buffer,
 
 	/* do iommu map */
 	ret = buffer->heap->ops->map_iommu(buffer, map);
+	/* out of iova space: give back what idle mappings hold, try again */
+	if (ret && ion_iommu_evict(ULONG_MAX))
+		ret = buffer->heap->ops->map_iommu(buffer, map);
 	if (ret) {
 		kfree(map);
 		return ret;
@@ -925,14 +1053,55 @@ static int do_iommu_map(struct ion_buffer *buffer,
 
 	/* init the map count as 1 */
 	kref_init(&map->ref);
+	INIT_LIST_HEAD(&map->idle);
 
 	/* bind iommu_map to buffer */
 	map->buffer = buffer;
 	buffer->iommu_map = map;
+	atomic_long_inc(&ion_iommu_misses);
 
 	return 0;
 }
 
+static bool ion_iommu_format_match(struct iommu_map_format *mapped,
+		struct iommu_map_format *format)
+{
+	if (mapped->prot != format->prot || mapped->is_tile != format->is_tile)
+		return false;
+	return !format->is_tile ||
+		(mapped->phys_page_line == format->phys_page_line &&
+		 mapped->virt_page_line == format->virt_page_line &&
+		 mapped->header_size == format->header_size);
+}
+
+/*
+ * buffer->lock held. Take an idle mapping of the buffer back into use if
+ * it was made with the same format, otherwise drop it. Returns true if
+ * the buffer now has a mapping with one reference.
+ */
+static bool ion_iommu_revive(struct ion_buffer *buffer,
+		struct iommu_map_format *format)
+{
+	struct ion_iommu_map *map = buffer->iommu_map;
+	bool revived = false;
+
+	if (!map || !ion_iommu_map_idle(map))
+		return false;
+
+	mutex_lock(&ion_iommu_idle_lock);
+	ion_iommu_unlink_idle(map);
+	if (ion_iommu_format_match(&map->format, format)) {
+		kref_init(&map->ref);
+		atomic_long_inc(&ion_iommu_hits);
+		revived = true;
+	} else {
+		ion_iommu_destroy_map(map);
+	}
+	mutex_unlock(&ion_iommu_idle_lock);
+
+	return revived;
+}
+
 int ion_map_iommu(struct ion_client *client, struct ion_handle *handle,
 		struct iommu_map_format *format)
 {
@@ -971,7 +1140,9 @@ int ion_map_iommu(struct ion_client *client, struct ion_handle *handle,
 
 
 	/* buffer->iommu_map != NULL means buffer has mapped */
-	if (buffer->iommu_map) {
+	if (ion_iommu_revive(buffer, format)) {
+		pr_debug("This buffer has an idle iommu map, reuse it!\n");
+	} else if (buffer->iommu_map) {
 		struct iommu_map_format *mapped_fmt
 				= &buffer->iommu_map->format;
 
@@ -1009,17 +1180,27 @@ out:
 }
 EXPORT_SYMBOL(ion_map_iommu);
 
+/* buffer->lock held */
 static void do_iommu_unmap(struct kref *kref)
 {
 	struct ion_iommu_map *map
 		= container_of(kref, struct ion_iommu_map, ref);
-	struct ion_buffer *buffer = map->buffer;
 
-	buffer->heap->ops->unmap_iommu(map);
+	if (iommu_map_cache) {
+		mutex_lock(&ion_iommu_idle_lock);
+		list_add_tail(&map->idle, &ion_iommu_idle);
+		ion_iommu_idle_count++;
+		mutex_unlock(&ion_iommu_idle_lock);
+		return;
+	}
 
-	buffer->iommu_map = NULL;
+	ion_iommu_destroy_map(map);
+}
 
-	kfree(map);
+/* buffer->lock held */
+static bool ion_iommu_map_live(struct ion_buffer *buffer)
+{
+	return buffer->iommu_map && !ion_iommu_map_idle(buffer->iommu_map);
 }
 
 void ion_unmap_iommu(struct ion_client *client, struct ion_handle *handle)
@@ -1041,7 +1222,7 @@ void ion_unmap_iommu(struct ion_client *client, struct ion_handle *handle)
 	mutex_lock(&buffer->lock);
 
 	iommu_map = buffer->iommu_map;
-	if (!iommu_map) {
+	if (!ion_iommu_map_live(buffer)) {
 		WARN(1, "This buffer have not been map iommu\n");
 		goto out;
 	}
@@ -1461,8 +1642,10 @@ static void ion_dma_buf_release(struct dma_buf *dmabuf)
 {
 	struct ion_buffer *buffer = dmabuf->priv;
 
-	if (buffer->iommu_map)
+	mutex_lock(&buffer->lock);
+	if (ion_iommu_map_live(buffer))
 		kref_put(&buffer->iommu_map->ref, do_iommu_unmap);
+	mutex_unlock(&buffer->lock);
 
 	ion_buffer_put(buffer);
 }
@@ -1479,6 +1662,69 @@ static void ion_dma_buf_kunmap(struct dma_buf *dmabuf, unsigned long offset,
 {
 }
 
+/*
+ * Cache maintenance on [offset, offset + len) of the buffer's cpu view.
+ * Past HISI_ION_FLUSH_ALL_CPUS_CACHES walking the range by VA costs more
+ * than flushing every cpu cache by set/way, so large ranges do that
+ * instead.
+ */
+static void ion_buffer_sync_range(struct ion_buffer *buffer,
+				  unsigned long offset, unsigned long len,
+				  bool for_cpu)
+{
+	struct sg_table *table;
+	struct scatterlist *sg;
+	unsigned long end = offset + len;
+	unsigned long pos = 0;
+	int i;
+
+	if (len >= HISI_ION_FLUSH_ALL_CPUS_CACHES) {
+		ion_flush_all_cpus_caches();
+		return;
+	}
+
+	table = buffer->cpudraw_sg_table ? buffer->cpudraw_sg_table :
+					   buffer->sg_table;
+
+	if (!offset && len >= buffer->size) {
+		if (for_cpu)
+			dma_sync_sg_for_cpu(NULL, table->sgl, table->nents,
+					    DMA_FROM_DEVICE);
+		else
+			dma_sync_sg_for_device(NULL, table->sgl, table->nents,
+					       DMA_BIDIRECTIONAL);
+		return;
+	}
+
+	for_each_sg(table->sgl, sg, table->nents, i) {
+		unsigned long sg_start = max(offset, pos);
+		unsigned long sg_end = min(end, pos + sg->length);
+		struct scatterlist range;
+		unsigned long skip;
+
+		if (sg_start < sg_end) {
+			/* sg->offset is zero for every heap's tables */
+			skip = sg_start - pos;
+			sg_init_table(&range, 1);
+			sg_set_page(&range, nth_page(sg_page(sg),
+						     skip >> PAGE_SHIFT),
+				    sg_end - sg_start, skip & ~PAGE_MASK);
+			/* see the comment in ion_pages_sync_for_device() */
+			sg_dma_address(&range) = sg_phys(&range);
+			if (for_cpu)
+				dma_sync_sg_for_cpu(NULL, &range, 1,
+						    DMA_FROM_DEVICE);
+			else
+				dma_sync_sg_for_device(NULL, &range, 1,
+						       DMA_BIDIRECTIONAL);
+		}
+
+		pos += sg->length;
+		if (pos >= end)
+			break;
+	}
+}
+
 static int ion_dma_buf_begin_cpu_access(struct dma_buf *dmabuf, size_t start,
 					size_t len,
 					enum dma_data_direction direction)
@@ -1495,7 +1741,12 @@ static int ion_dma_buf_begin_cpu_access(struct dma_buf *dmabuf, size_t start,
 	mutex_lock(&buffer->lock);
 	vaddr = ion_buffer_kmap_get(buffer);
 	mutex_unlock(&buffer->lock);
-	return PTR_ERR_OR_ZERO(vaddr);
+	if (IS_ERR(vaddr))
+		return PTR_ERR(vaddr);
+
+	if (ion_buffer_cached(buffer) && direction != DMA_TO_DEVICE)
+		ion_buffer_sync_range(buffer, start, len, true);
+	return 0;
 }
 
 static void ion_dma_buf_end_cpu_access(struct dma_buf *dmabuf, size_t start,
@@ -1504,6 +1755,9 @@ static void ion_dma_buf_end_cpu_access(struct dma_buf *dmabuf, size_t start,
 {
 	struct ion_buffer *buffer = dmabuf->priv;
 
+	if (ion_buffer_cached(buffer) && direction != DMA_FROM_DEVICE)
+		ion_buffer_sync_range(buffer, start, len, false);
+
 	mutex_lock(&buffer->lock);
 	ion_buffer_kmap_put(buffer);
 	mutex_unlock(&buffer->lock);
@@ -1539,8 +1793,10 @@ struct dma_buf *ion_share_dma_buf(struct ion_client *client,
 	}
 	buffer = handle->buffer;
 	ion_buffer_get(buffer);
-	if (buffer->iommu_map)
+	mutex_lock(&buffer->lock);
+	if (ion_iommu_map_live(buffer))
 		kref_get(&buffer->iommu_map->ref);
+	mutex_unlock(&buffer->lock);
 	mutex_unlock(&client->lock);
 
 	exp_info.ops = &dma_buf_ops;
@@ -1632,13 +1888,18 @@ end:
 }
 EXPORT_SYMBOL(ion_import_dma_buf);
 
-int ion_sync_for_device(struct ion_client *client, int fd)
+int ion_sync_range(struct ion_client *client, int fd, unsigned long offset,
+		   unsigned long len, unsigned int flags)
 {
 	struct dma_buf *dmabuf;
 	struct ion_buffer *buffer;
 
+	if (!(flags & (ION_SYNC_RANGE_FOR_CPU | ION_SYNC_RANGE_FOR_DEVICE)) ||
+	    (flags & ~(ION_SYNC_RANGE_FOR_CPU | ION_SYNC_RANGE_FOR_DEVICE)))
+		return -EINVAL;
+
 	dmabuf = dma_buf_get(fd);
-	if (IS_ERR(dmabuf)) {
+	if (IS_ERR_OR_NULL(dmabuf)) {
 		pr_err("%s: can't get dmabuf!\n", __func__);
 		return PTR_ERR(dmabuf);
 	}
@@ -1652,24 +1913,34 @@ int ion_sync_for_device(struct ion_client *client, int fd)
 	}
 	buffer = dmabuf->priv;
 
-	if (buffer->size >= HISI_ION_FLUSH_ALL_CPUS_CACHES) {
-		ion_flush_all_cpus_caches();
-	} else {
-		if (buffer->cpudraw_sg_table)
-			dma_sync_sg_for_device(NULL,
-					buffer->cpudraw_sg_table->sgl,
-					buffer->cpudraw_sg_table->nents,
-					DMA_BIDIRECTIONAL);
-		else
-			dma_sync_sg_for_device(NULL, buffer->sg_table->sgl,
-						buffer->sg_table->nents,
-						DMA_BIDIRECTIONAL);
+	if (!len)
+		len = buffer->size;
+	if (offset >= buffer->size || len > buffer->size - offset) {
+		pr_err("%s: range %lx+%lx outside buffer of %zx\n", __func__,
+		       offset, len, buffer->size);
+		dma_buf_put(dmabuf);
+		return -EINVAL;
 	}
 
+	if (flags & ION_SYNC_RANGE_FOR_DEVICE)
+		ion_buffer_sync_range(buffer, offset, len, false);
+	if (flags & ION_SYNC_RANGE_FOR_CPU)
+		ion_buffer_sync_range(buffer, offset, len, true);
+
 	dma_buf_put(dmabuf);
 	return 0;
 }
 
+int ion_sync_for_device(struct ion_client *client, int fd)
+{
+	return ion_sync_range(client, fd, 0, 0, ION_SYNC_RANGE_FOR_DEVICE);
+}
+
+int ion_sync_for_cpu(struct ion_client *client, int fd)
+{
+	return ion_sync_range(client, fd, 0, 0, ION_SYNC_RANGE_FOR_CPU);
+}
+
 /* fix up the cases where the ioctl direction bits are incorrect */
 static unsigned int ion_ioctl_dir(unsigned int cmd)
 {
@@ -1683,45 +1954,6 @@ static unsigned int ion_ioctl_dir(unsigned int cmd)
 	}
 }
 
-int ion_sync_for_cpu(struct ion_client *client, int fd)
-{
-	struct dma_buf *dmabuf;
-	struct ion_buffer *buffer;
-
-	dmabuf = dma_buf_get(fd);
-	if (IS_ERR_OR_NULL(dmabuf)) {
-		pr_err("%s: can't get dmabuf!\n", __func__);
-		return PTR_ERR(dmabuf);
-	}
-
-	/* if this memory came from ion */
-	if (dmabuf->ops != &dma_buf_ops) {
-		pr_err("%s: can not sync dmabuf from another exporter\n",
-		       __func__);
-		dma_buf_put(dmabuf);
-		return -EINVAL;
-	}
-	buffer = dmabuf->priv;
-
-	if (buffer->size >= HISI_ION_FLUSH_ALL_CPUS_CACHES) {
-		ion_flush_all_cpus_caches();
-	} else {
-		if (buffer->cpudraw_sg_table) {
-			dma_sync_sg_for_cpu(NULL,
-					buffer->cpudraw_sg_table->sgl,
-					buffer->cpudraw_sg_table->nents,
-					DMA_FROM_DEVICE);
-		} else {
-			dma_sync_sg_for_cpu(NULL, buffer->sg_table->sgl,
-					buffer->sg_table->nents,
-					DMA_FROM_DEVICE);
-		}
-	}
-
-	dma_buf_put(dmabuf);
-	return 0;
-}
-
 static long ion_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 {
 	struct ion_client *client = filp->private_data;
@@ -1736,6 +1968,7 @@ static long ion_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 		struct ion_handle_data handle;
 		struct ion_custom_data custom;
 		struct ion_map_iommu_data map_iommu;
+		struct ion_sync_range_data sync_range;
 	} data;
 
 	dir = ion_ioctl_dir(cmd);
@@ -1847,6 +2080,14 @@ static long ion_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 		ion_sync_for_cpu(client, data.fd.fd);
 		break;
 	}
+	case ION_IOC_SYNC_RANGE:
+	{
+		ret = ion_sync_range(client, data.sync_range.fd,
+				     data.sync_range.offset,
+				     data.sync_range.length,
+				     data.sync_range.flags);
+		break;
+	}
 
 	case ION_IOC_MAP_IOMMU:
 	{
@@ -2244,7 +2485,11 @@ struct ion_device *ion_device_create(long (*custom_ioctl)
 	if (!entry)
 		pr_err("Failed to create heap debug memtrack\n");
 
+	debugfs_create_file("iommu_cache", 0440, idev->debug_root, NULL,
+			    &ion_iommu_cache_fops);
+
 debugfs_done:
+	register_shrinker(&ion_iommu_cache_shrinker);
 
 	idev->custom_ioctl = custom_ioctl;
 	idev->buffers = RB_ROOT;
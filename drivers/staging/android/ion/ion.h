@@ -227,6 +227,17 @@ struct ion_handle *ion_import_dma_buf(struct ion_client *client, int fd);
 
 int ion_sync_for_cpu(struct ion_client *client, int fd);
 int ion_sync_for_device(struct ion_client *client, int fd);
+
+/**
+ * ion_sync_range() - cache maintenance on part of a buffer
+ * @client:	the client
+ * @fd:		the dma-buf fd
+ * @offset:	start of the range in bytes
+ * @len:	length of the range in bytes, 0 for the rest of the buffer
+ * @flags:	ION_SYNC_RANGE_FOR_DEVICE and/or ION_SYNC_RANGE_FOR_CPU
+ */
+int ion_sync_range(struct ion_client *client, int fd, unsigned long offset,
+		   unsigned long len, unsigned int flags);
 size_t ion_get_used_memory(struct ion_heap *heap);
 
 
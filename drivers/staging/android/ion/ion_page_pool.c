@@ -18,14 +18,28 @@
 #include <linux/dma-mapping.h>
 #include <linux/err.h>
 #include <linux/fs.h>
+#include <linux/highmem.h>
+#include <linux/kthread.h>
 #include <linux/list.h>
 #include <linux/module.h>
+#include <linux/sched.h>
 #include <linux/slab.h>
 #include <linux/swap.h>
+#include <linux/topology.h>
 #include <linux/vmstat.h>
+#include <linux/wait.h>
 
 #include "ion_priv.h"
 
+/* pages zeroed per pool->mutex round trip by the zeroing thread */
+#define ION_PAGE_POOL_ZERO_BATCH	8
+
+static LIST_HEAD(ion_page_pool_zero_pools);
+static DEFINE_MUTEX(ion_page_pool_zero_lock);
+static DECLARE_WAIT_QUEUE_HEAD(ion_page_pool_zero_wait);
+static int ion_page_pool_zero_flag;
+static struct task_struct *ion_page_pool_zero_thread;
+
 void *ion_page_pool_alloc_pages(struct ion_page_pool *pool)
 {
 /* zero buffer by caller, that zero buffer faster */
@@ -51,14 +65,12 @@ static void ion_page_pool_free_pages(struct ion_page_pool *pool,
 				     struct page *page)
 {
 	ion_page_pool_free_set_cache_policy(pool, page);
+	ion_page_pool_page_clear_clean(page);
 	__free_pages(page, pool->order);
 }
 
-static int ion_page_pool_add(struct ion_page_pool *pool, struct page *page)
+static void __ion_page_pool_add(struct ion_page_pool *pool, struct page *page)
 {
-	mutex_lock(&pool->mutex);
-	zone_page_state_add(1 << pool->order, page_zone(page),
-			    NR_IONCACHE_PAGES);
 	if (PageHighMem(page)) {
 		list_add_tail(&page->lru, &pool->high_items);
 		pool->high_count++;
@@ -66,10 +78,57 @@ static int ion_page_pool_add(struct ion_page_pool *pool, struct page *page)
 		list_add_tail(&page->lru, &pool->low_items);
 		pool->low_count++;
 	}
+}
+
+static int ion_page_pool_add(struct ion_page_pool *pool, struct page *page)
+{
+	ion_page_pool_page_clear_clean(page);
+	mutex_lock(&pool->mutex);
+	zone_page_state_add(1 << pool->order, page_zone(page),
+			    NR_IONCACHE_PAGES);
+	__ion_page_pool_add(pool, page);
 	mutex_unlock(&pool->mutex);
 	return 0;
 }
 
+static void ion_page_pool_zero_wakeup(void)
+{
+	if (!ion_page_pool_zero_thread)
+		return;
+
+	ion_page_pool_zero_flag = 1;
+	wake_up_interruptible(&ion_page_pool_zero_wait);
+}
+
+static int ion_page_pool_add_dirty(struct ion_page_pool *pool,
+				   struct page *page)
+{
+	ion_page_pool_page_clear_clean(page);
+	mutex_lock(&pool->mutex);
+	zone_page_state_add(1 << pool->order, page_zone(page),
+			    NR_IONCACHE_PAGES);
+	list_add_tail(&page->lru, &pool->dirty_items);
+	pool->dirty_count++;
+	mutex_unlock(&pool->mutex);
+
+	ion_page_pool_zero_wakeup();
+	return 0;
+}
+
+static struct page *ion_page_pool_remove_dirty(struct ion_page_pool *pool)
+{
+	struct page *page;
+
+	BUG_ON(!pool->dirty_count);
+	page = list_first_entry(&pool->dirty_items, struct page, lru);
+	pool->dirty_count--;
+	zone_page_state_add(-(1 << pool->order), page_zone(page),
+			    NR_IONCACHE_PAGES);
+
+	list_del(&page->lru);
+	return page;
+}
+
 static struct page *ion_page_pool_remove(struct ion_page_pool *pool, bool high)
 {
 	struct page *page;
@@ -101,6 +160,8 @@ struct page *ion_page_pool_alloc(struct ion_page_pool *pool)
 		page = ion_page_pool_remove(pool, true);
 	else if (pool->low_count)
 		page = ion_page_pool_remove(pool, false);
+	else if (pool->dirty_count)
+		page = ion_page_pool_remove_dirty(pool);
 	mutex_unlock(&pool->mutex);
 
 	if (!page && !(pool->graphic_buffer_flag))
@@ -115,7 +176,10 @@ void ion_page_pool_free(struct ion_page_pool *pool, struct page *page)
 
 	BUG_ON(pool->order != compound_order(page));
 
-	ret = ion_page_pool_add(pool, page);
+	if (pool->graphic_buffer_flag)
+		ret = ion_page_pool_add(pool, page);
+	else
+		ret = ion_page_pool_add_dirty(pool, page);
 	if (ret)
 		ion_page_pool_free_pages(pool, page);
 }
@@ -127,7 +191,7 @@ void ion_page_pool_free_immediate(struct ion_page_pool *pool, struct page *page)
 
 static int ion_page_pool_total(struct ion_page_pool *pool, bool high)
 {
-	int count = pool->low_count;
+	int count = pool->low_count + pool->dirty_count;
 
 	if (high)
 		count += pool->high_count;
@@ -153,7 +217,9 @@ int ion_page_pool_shrink(struct ion_page_pool *pool, gfp_t gfp_mask,
 		struct page *page;
 
 		mutex_lock(&pool->mutex);
-		if (pool->low_count) {
+		if (pool->dirty_count) {
+			page = ion_page_pool_remove_dirty(pool);
+		} else if (pool->low_count) {
 			page = ion_page_pool_remove(pool, false);
 		} else if (high && pool->high_count) {
 			page = ion_page_pool_remove(pool, true);
@@ -180,27 +246,125 @@ struct ion_page_pool *ion_page_pool_create(gfp_t gfp_mask, unsigned int order,
 	pool->low_count = 0;
 	INIT_LIST_HEAD(&pool->low_items);
 	INIT_LIST_HEAD(&pool->high_items);
+	pool->dirty_count = 0;
+	INIT_LIST_HEAD(&pool->dirty_items);
 	pool->gfp_mask = gfp_mask | __GFP_COMP;
 	pool->order = order;
 	pool->graphic_buffer_flag = graphic_buffer_flag;
 	mutex_init(&pool->mutex);
 	plist_node_init(&pool->list, order);
 
+	INIT_LIST_HEAD(&pool->zero_node);
+	if (!graphic_buffer_flag) {
+		mutex_lock(&ion_page_pool_zero_lock);
+		list_add_tail(&pool->zero_node, &ion_page_pool_zero_pools);
+		mutex_unlock(&ion_page_pool_zero_lock);
+	}
+
 	return pool;
 }
 
 void ion_page_pool_destroy(struct ion_page_pool *pool)
 {
+	mutex_lock(&ion_page_pool_zero_lock);
+	list_del(&pool->zero_node);
+	mutex_unlock(&ion_page_pool_zero_lock);
 	kfree(pool);
 }
 
+/*
+ * Move up to ION_PAGE_POOL_ZERO_BATCH dirty items at a time off the pool,
+ * zero them without holding pool->mutex and put them back on the clean
+ * lists.  The items stay accounted in NR_IONCACHE_PAGES while in flight.
+ */
+static void ion_page_pool_zero_dirty(struct ion_page_pool *pool)
+{
+	struct page *page, *tmp;
+	LIST_HEAD(batch);
+	int nr, i;
+
+	while (!kthread_should_stop()) {
+		mutex_lock(&pool->mutex);
+		for (nr = 0; nr < ION_PAGE_POOL_ZERO_BATCH && pool->dirty_count;
+		     nr++) {
+			page = list_first_entry(&pool->dirty_items,
+						struct page, lru);
+			list_move_tail(&page->lru, &batch);
+			pool->dirty_count--;
+		}
+		mutex_unlock(&pool->mutex);
+
+		if (!nr)
+			break;
+
+		list_for_each_entry(page, &batch, lru) {
+			for (i = 0; i < (1 << pool->order); i++)
+				clear_highpage(page + i);
+			cond_resched();
+		}
+
+		mutex_lock(&pool->mutex);
+		list_for_each_entry_safe(page, tmp, &batch, lru) {
+			list_del(&page->lru);
+			set_page_private(page, ION_PAGE_POOL_PAGE_CLEAN);
+			__ion_page_pool_add(pool, page);
+		}
+		mutex_unlock(&pool->mutex);
+	}
+}
+
+static int ion_page_pool_zero_kworkthread(void *p)
+{
+	struct ion_page_pool *pool;
+	int ret;
+
+	while (!kthread_should_stop()) {
+		ret = wait_event_interruptible(ion_page_pool_zero_wait,
+			ion_page_pool_zero_flag == 1 || kthread_should_stop());
+		if (ret < 0)
+			continue;
+
+		ion_page_pool_zero_flag = 0;
+		mutex_lock(&ion_page_pool_zero_lock);
+		list_for_each_entry(pool, &ion_page_pool_zero_pools, zero_node)
+			ion_page_pool_zero_dirty(pool);
+		mutex_unlock(&ion_page_pool_zero_lock);
+	}
+
+	return 0;
+}
+
 static int __init ion_page_pool_init(void)
 {
+	struct sched_param param = { .sched_priority = 0 };
+	struct task_struct *thread;
+
+	thread = kthread_create(ion_page_pool_zero_kworkthread, NULL,
+				"%s", "ion_pool_zero");
+	if (IS_ERR(thread)) {
+		pr_err("%s: kthread_create failed!\n", __func__);
+		return 0;
+	}
+
+	/*
+	 * Zeroing is pure background work: keep it off the big cores
+	 * (cpu0's cluster is the little one on these SoCs) and only run
+	 * it when nothing else wants the cpu.
+	 */
+	sched_setscheduler_nocheck(thread, SCHED_IDLE, &param);
+	set_cpus_allowed_ptr(thread, topology_core_cpumask(0));
+
+	ion_page_pool_zero_thread = thread;
+	wake_up_process(thread);
+	ion_page_pool_zero_wakeup();
+
 	return 0;
 }
 
 static void __exit ion_page_pool_exit(void)
 {
+	if (ion_page_pool_zero_thread)
+		kthread_stop(ion_page_pool_zero_thread);
 }
 
 module_init(ion_page_pool_init);
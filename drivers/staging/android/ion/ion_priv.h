@@ -38,6 +38,8 @@ struct ion_iommu_map {
 	struct ion_buffer *buffer;
 	struct kref ref;
 	struct iommu_map_format format;
+	/* on the idle list while no one holds a reference */
+	struct list_head idle;
 };
 
 /**
@@ -414,6 +416,9 @@ void ion_carveout_free(struct ion_heap *heap, ion_phys_addr_t addr,
  * @low_count:		number of lowmem items in the pool
  * @high_items:		list of highmem items
  * @low_items:		list of lowmem items
+ * @dirty_count:	number of items still waiting to be zeroed
+ * @dirty_items:	list of items still waiting to be zeroed
+ * @zero_node:		entry on the list of pools served by the zeroing thread
  * @mutex:		lock protecting this struct and especially the count
  *			item list
  * @gfp_mask:		gfp_mask to use from alloc
@@ -430,6 +435,9 @@ struct ion_page_pool {
 	int low_count;
 	struct list_head high_items;
 	struct list_head low_items;
+	int dirty_count;
+	struct list_head dirty_items;
+	struct list_head zero_node;
 	struct mutex mutex;
 	gfp_t gfp_mask;
 	unsigned int order;
@@ -444,6 +452,23 @@ struct page *ion_page_pool_alloc(struct ion_page_pool *);
 void ion_page_pool_free(struct ion_page_pool *, struct page *);
 void ion_page_pool_free_immediate(struct ion_page_pool *, struct page *);
 
+/*
+ * Pages freed to a non-graphic pool are zeroed in the background before
+ * they move to the clean lists, and are tagged so the heap can skip
+ * zeroing them again at allocation time.
+ */
+#define ION_PAGE_POOL_PAGE_CLEAN	1UL
+
+static inline bool ion_page_pool_page_clean(struct page *page)
+{
+	return page_private(page) == ION_PAGE_POOL_PAGE_CLEAN;
+}
+
+static inline void ion_page_pool_page_clear_clean(struct page *page)
+{
+	set_page_private(page, 0);
+}
+
 void *ion_page_pool_alloc_pages(struct ion_page_pool *pool);
 int ion_system_heap_create_pools(struct ion_page_pool **pools,
 			bool graphic_buffer_flag);
@@ -212,8 +212,11 @@ static int ion_system_heap_allocate(struct ion_heap *heap,
 		}
 
 #ifdef CONFIG_HISI_SMARTPOOL_OPT
-		if (ion_smart_is_graphic_buffer(buffer))
+		if (ion_smart_is_graphic_buffer(buffer)) {
 			ion_smart_sp_init_page(page);
+			if (sys_heap->smart_pool)
+				ion_smart_pool_count_fallback(page);
+		}
 #endif
 		list_add_tail(&page->lru, &pages);
 		size_remaining -= PAGE_SIZE << compound_order(page);
@@ -357,9 +360,32 @@ static int ion_system_heap_shrink(struct ion_heap *heap, gfp_t gfp_mask,
 	return nr_total;
 }
 
+/*
+ * Pages that came off a pool's clean lists were already zeroed by the
+ * pool's background thread; only zero what came from the dirty list or
+ * straight from the page allocator.
+ */
 static void ion_system_heap_buffer_zero(struct ion_buffer *buffer)
 {
-	ion_heap_buffer_zero(buffer);
+	struct sg_table *table = buffer->sg_table;
+	struct scatterlist *sg;
+	pgprot_t pgprot;
+	int i;
+
+	if (buffer->flags & ION_FLAG_CACHED)
+		pgprot = PAGE_KERNEL;
+	else
+		pgprot = pgprot_writecombine(PAGE_KERNEL);
+
+	for_each_sg(table->sgl, sg, table->nents, i) {
+		struct page *page = sg_page(sg);
+
+		if (ion_page_pool_page_clean(page)) {
+			ion_page_pool_page_clear_clean(page);
+			continue;
+		}
+		ion_heap_pages_zero(page, sg->length, pgprot);
+	}
 }
 
 static struct ion_heap_ops system_heap_ops = {
@@ -394,6 +420,9 @@ static int ion_system_heap_debug_show(struct ion_heap *heap, struct seq_file *s,
 		seq_printf(s, "%d order %u lowmem pages in uncached pool = %lu total\n",
 			   pool->low_count, pool->order,
 			   (PAGE_SIZE << pool->order) * pool->low_count);
+		seq_printf(s, "%d order %u dirty pages in uncached pool = %lu total\n",
+			   pool->dirty_count, pool->order,
+			   (PAGE_SIZE << pool->order) * pool->dirty_count);
 	}
 
 	for (i = 0; i < NUM_ORDERS; i++) {
@@ -405,6 +434,9 @@ static int ion_system_heap_debug_show(struct ion_heap *heap, struct seq_file *s,
 		seq_printf(s, "%d order %u lowmem pages in cached pool = %lu total\n",
 			   pool->low_count, pool->order,
 			   (PAGE_SIZE << pool->order) * pool->low_count);
+		seq_printf(s, "%d order %u dirty pages in cached pool = %lu total\n",
+			   pool->dirty_count, pool->order,
+			   (PAGE_SIZE << pool->order) * pool->dirty_count);
 	}
 
 #ifdef CONFIG_HISI_SMARTPOOL_OPT
@@ -41,6 +41,10 @@
 #include <linux/rcupdate.h>
 #include <linux/notifier.h>
 #include <linux/atomic.h>
+#include <linux/spinlock.h>
+#include <linux/rculist.h>
+#include <linux/bitmap.h>
+#include <linux/err.h>
 #include <hisi/hisi_lmk/lowmem_killer.h>
 
 #define CREATE_TRACE_POINTS
@@ -106,17 +110,182 @@ static unsigned long lowmem_count(struct shrinker *s,
 		global_page_state(NR_INACTIVE_FILE);
 }
 
-static unsigned long lowmem_scan(struct shrinker *s, struct shrink_control *sc)
+/*
+ * Thread groups are indexed by oom_score_adj, so that a scan only looks
+ * at the highest buckets at or above the threshold instead of at every
+ * task. The buckets are written under lowmem_lock and walked under RCU;
+ * a group that moves to another bucket meanwhile is at worst skipped
+ * until the next scan. Killed groups move to lowmem_dying until they
+ * exit, so they are not selected again while their memory is freed.
+ */
+#define LOWMEM_BUCKETS	(OOM_SCORE_ADJ_MAX - OOM_SCORE_ADJ_MIN + 1)
+#define LOWMEM_DYING	-1
+
+static DEFINE_SPINLOCK(lowmem_lock);
+static struct hlist_head lowmem_buckets[LOWMEM_BUCKETS];
+static DECLARE_BITMAP(lowmem_bucket_map, LOWMEM_BUCKETS);
+static HLIST_HEAD(lowmem_dying);
+
+static void __lowmem_bucket_add(struct signal_struct *sig)
+{
+	int b = sig->oom_score_adj - OOM_SCORE_ADJ_MIN;
+
+	sig->lowmem_bucket = b;
+	hlist_add_head_rcu(&sig->lowmem_node, &lowmem_buckets[b]);
+	__set_bit(b, lowmem_bucket_map);
+}
+
+static void __lowmem_bucket_del(struct signal_struct *sig)
+{
+	int b = sig->lowmem_bucket;
+
+	hlist_del_init_rcu(&sig->lowmem_node);
+	if (b != LOWMEM_DYING && hlist_empty(&lowmem_buckets[b]))
+		__clear_bit(b, lowmem_bucket_map);
+}
+
+/*
+ * Called with tasklist_lock held for writing. Kernel threads are indexed
+ * too, they have no mm and are passed over, but a usermode helper may
+ * later exec from one.
+ */
+void lowmem_signal_add(struct task_struct *p)
+{
+	spin_lock(&lowmem_lock);
+	__lowmem_bucket_add(p->signal);
+	spin_unlock(&lowmem_lock);
+}
+
+/* called with tasklist_lock held for writing */
+void lowmem_signal_del(struct signal_struct *sig)
+{
+	spin_lock(&lowmem_lock);
+	if (!hlist_unhashed(&sig->lowmem_node))
+		__lowmem_bucket_del(sig);
+	spin_unlock(&lowmem_lock);
+}
+
+void lowmem_signal_adj_changed(struct signal_struct *sig)
+{
+	spin_lock(&lowmem_lock);
+	if (!hlist_unhashed(&sig->lowmem_node) &&
+	    sig->lowmem_bucket != LOWMEM_DYING) {
+		__lowmem_bucket_del(sig);
+		__lowmem_bucket_add(sig);
+	}
+	spin_unlock(&lowmem_lock);
+}
+
+static void lowmem_mark_dying(struct signal_struct *sig)
+{
+	spin_lock(&lowmem_lock);
+	if (!hlist_unhashed(&sig->lowmem_node)) {
+		__lowmem_bucket_del(sig);
+		sig->lowmem_bucket = LOWMEM_DYING;
+		hlist_add_head_rcu(&sig->lowmem_node, &lowmem_dying);
+	}
+	spin_unlock(&lowmem_lock);
+}
+
+/* find_lock_task_mm() for a thread group, under RCU */
+static struct task_struct *lowmem_lock_task_mm(struct signal_struct *sig)
+{
+	struct task_struct *t;
+
+	__for_each_thread(sig, t) {
+		task_lock(t);
+		if (likely(t->mm))
+			return t;
+		task_unlock(t);
+	}
+	return NULL;
+}
+
+/* a previous victim still holds its memory and hasn't timed out */
+static bool lowmem_victim_pending(void)
+{
+	struct signal_struct *sig;
+	struct task_struct *p;
+
+	hlist_for_each_entry_rcu(sig, &lowmem_dying, lowmem_node) {
+		p = lowmem_lock_task_mm(sig);
+		if (!p)
+			continue;
+		task_unlock(p);
+		if (time_before_eq(jiffies, lowmem_deathpending_timeout))
+			return true;
+		hisi_lowmem_dbg_timeout(p, p);
+	}
+	return false;
+}
+
+/*
+ * Highest oom_score_adj first, then the largest RSS, like a walk over
+ * every task would pick. Returns ERR_PTR(-EBUSY) if a task killed by
+ * the OOM killer is still exiting. Called under RCU.
+ */
+static struct task_struct *lowmem_select(short min_score_adj,
+					 int *selected_tasksize,
+					 short *selected_oom_score_adj)
 {
-	struct task_struct *tsk;
 	struct task_struct *selected = NULL;
+	unsigned long size = LOWMEM_BUCKETS;
+	unsigned long b;
+
+	*selected_tasksize = 0;
+	while ((b = find_last_bit(lowmem_bucket_map, size)) < size) {
+		short oom_score_adj = b + OOM_SCORE_ADJ_MIN;
+		struct signal_struct *sig;
+
+		if (oom_score_adj < min_score_adj)
+			break;
+
+		hlist_for_each_entry_rcu(sig, &lowmem_buckets[b], lowmem_node) {
+			struct task_struct *p;
+			int tasksize;
+
+			/* moved to another bucket under us */
+			if (sig->lowmem_bucket != b)
+				continue;
+
+			p = lowmem_lock_task_mm(sig);
+			if (!p)
+				continue;
+
+			if (test_tsk_thread_flag(p, TIF_MEMDIE)) {
+				task_unlock(p);
+				if (time_before_eq(jiffies,
+						lowmem_deathpending_timeout))
+					return ERR_PTR(-EBUSY);
+				hisi_lowmem_dbg_timeout(p, p);
+				continue;
+			}
+			tasksize = get_mm_rss(p->mm);
+			task_unlock(p);
+			if (tasksize <= *selected_tasksize)
+				continue;
+			selected = p;
+			*selected_tasksize = tasksize;
+			*selected_oom_score_adj = oom_score_adj;
+			lowmem_print(2, "select '%s' (%d), adj %hd, size %d, to kill\n",
+				     p->comm, p->pid, oom_score_adj, tasksize);
+		}
+		if (selected)
+			break;
+		size = b;
+	}
+	return selected;
+}
+
+static unsigned long lowmem_scan(struct shrinker *s, struct shrink_control *sc)
+{
+	struct task_struct *selected;
 	unsigned long rem = 0;
-	int tasksize;
 	int i;
 	short min_score_adj = OOM_SCORE_ADJ_MAX + 1;
 	int minfree = 0;
 	int selected_tasksize = 0;
-	short selected_oom_score_adj;
+	short selected_oom_score_adj = 0;
 	int array_size = ARRAY_SIZE(lowmem_adj);
 	int other_free = global_page_state(NR_FREE_PAGES) - totalreserve_pages;
 	int other_file = global_page_state(NR_FILE_PAGES) -
@@ -153,67 +322,24 @@ static unsigned long lowmem_scan(struct shrinker *s, struct shrink_control *sc)
 		return 0;
 	}
 
-	selected_oom_score_adj = min_score_adj;
-
 	if (atomic_inc_return(&atomic_lmk) > 1) {
 		atomic_dec(&atomic_lmk);
 		return 0;
 	}
 
 	rcu_read_lock();
+	if (lowmem_victim_pending()) {
+		rcu_read_unlock();
+		atomic_dec(&atomic_lmk);
+		return 0;
+	}
 #ifdef CONFIG_HISI_MULTI_KILL
 kill_selected:
 #endif
-	for_each_process(tsk) {
-		struct task_struct *p;
-		short oom_score_adj;
-
-		if (tsk->flags & PF_KTHREAD)
-			continue;
-
-		p = find_lock_task_mm(tsk);
-		if (!p)
-			continue;
-
-		if (test_tsk_thread_flag(p, TIF_MEMDIE)) {
-			if (time_before_eq(jiffies,
-					lowmem_deathpending_timeout)) {
-				task_unlock(p);
-				rcu_read_unlock();
-				atomic_dec(&atomic_lmk);
-				return 0;
-			} else {
-				hisi_lowmem_dbg_timeout(tsk, p);
-#ifdef CONFIG_HISI_MULTI_KILL
-				if (lmk_multi_kill) {
-					task_unlock(p);
-					continue;
-				}
-#endif
-			}
-		}
-		oom_score_adj = p->signal->oom_score_adj;
-		if (oom_score_adj < min_score_adj) {
-			task_unlock(p);
-			continue;
-		}
-		tasksize = get_mm_rss(p->mm);
-		task_unlock(p);
-		if (tasksize <= 0)
-			continue;
-		if (selected) {
-			if (oom_score_adj < selected_oom_score_adj)
-				continue;
-			if (oom_score_adj == selected_oom_score_adj &&
-			    tasksize <= selected_tasksize)
-				continue;
-		}
-		selected = p;
-		selected_tasksize = tasksize;
-		selected_oom_score_adj = oom_score_adj;
-		lowmem_print(2, "select '%s' (%d), adj %hd, size %d, to kill\n",
-			     p->comm, p->pid, oom_score_adj, tasksize);
-	}
+	selected = lowmem_select(min_score_adj, &selected_tasksize,
+				 &selected_oom_score_adj);
+	if (IS_ERR(selected))
+		selected = NULL;
 	if (selected) {
 		long cache_size = other_file * (long)(PAGE_SIZE / 1024);
 		long cache_limit = minfree * (long)(PAGE_SIZE / 1024);
@@ -259,6 +385,8 @@ kill_selected:
 		if (selected->mm)
 			mark_tsk_oom_victim(selected);
 		task_unlock(selected);
+		lowmem_mark_dying(selected->signal);
+		hisi_lowmem_reap(selected);
 		rem += selected_tasksize;
 	}
 
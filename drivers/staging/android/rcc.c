@@ -15,13 +15,23 @@
 #include <linux/vmstat.h>
 #include <linux/kernel_stat.h>
 #include <linux/tick.h>
+#include <linux/ktime.h>
+#include <linux/notifier.h>
+#include <linux/rcc.h>
+#include <linux/launch_prefetch.h>
 
 #include "rcc.h"
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/rcc.h>
+
 /* Globals */
 
 static struct rcc_module rcc_module;
 
+/* other drivers deferring background work to display off listen here */
+static BLOCKING_NOTIFIER_HEAD(rcc_display_notifier);
+
 static inline unsigned long elapsed_jiffies(unsigned long start)
 {
 	unsigned long end = jiffies;
@@ -44,7 +54,7 @@ static bool is_swap_full(int max_percent)
 	return false;
 }
 
-static bool is_memory_free_enough(int free_pages_min)
+static bool is_memory_free_enough(unsigned long free_pages_min)
 {
 	unsigned long nr_free_pages;
 	nr_free_pages = global_page_state(NR_FREE_PAGES);
@@ -78,6 +88,168 @@ static void rcc_update_display_stat(struct rcc_module *rcc, bool display_on)
 {
 	rcc->display_off = !display_on;
 	pr_info("rcc: display_off = %d\n", rcc->display_off);
+	blocking_notifier_call_chain(&rcc_display_notifier,
+		display_on ? RCC_DISPLAY_ON : RCC_DISPLAY_OFF, NULL);
+}
+
+/**
+ * purpose: get notified of DISPLAY_ON/DISPLAY_OFF events
+ * arguments:
+ *    nb: notifier block, called with RCC_DISPLAY_ON or RCC_DISPLAY_OFF.
+ * return:
+ *    0 on success.
+ */
+int rcc_register_display_notifier(struct notifier_block *nb)
+{
+	return blocking_notifier_chain_register(&rcc_display_notifier, nb);
+}
+EXPORT_SYMBOL_GPL(rcc_register_display_notifier);
+
+int rcc_unregister_display_notifier(struct notifier_block *nb)
+{
+	return blocking_notifier_chain_unregister(&rcc_display_notifier, nb);
+}
+EXPORT_SYMBOL_GPL(rcc_unregister_display_notifier);
+
+static inline unsigned long rcc_ewma(unsigned long avg, unsigned long sample)
+{
+	return (avg * ((1 << RCC_EWMA_SHIFT) - 1) + sample) >> RCC_EWMA_SHIFT;
+}
+
+/**
+ * purpose: update allocation rate, finish a pending launch measurement.
+ * arguments:
+ *    rcc: struct rcc_module.
+ * return:
+ *    none.
+ */
+static void rcc_sample_memory(struct rcc_module *rcc)
+{
+	unsigned long nr_free = global_page_state(NR_FREE_PAGES);
+	unsigned long elapsed = elapsed_jiffies(rcc->last_sample);
+	unsigned long used, rate = 0;
+	struct rcc_launch *launch;
+
+	down_write(&rcc->lock);
+	if (elapsed) {
+		/* only consumption counts, freeing gives a zero sample. */
+		if (rcc->last_free_pages > nr_free)
+			rate = (rcc->last_free_pages - nr_free) * HZ / elapsed;
+		rcc->alloc_rate = rcc_ewma(rcc->alloc_rate, rate);
+		rcc->last_free_pages = nr_free;
+		rcc->last_sample = jiffies;
+	}
+
+	launch = rcc->pending_launch;
+	if (launch && elapsed_jiffies(rcc->launch_start) >=
+			msecs_to_jiffies(RCC_LAUNCH_WINDOW)) {
+		used = 0;
+		if (rcc->launch_free_pages > nr_free)
+			used = rcc->launch_free_pages - nr_free;
+		launch->pages = launch->pages ?
+			rcc_ewma(launch->pages, used) : used;
+		rcc->pending_launch = NULL;
+	}
+	up_write(&rcc->lock);
+}
+
+/**
+ * purpose: restart allocation rate sampling after we freed memory
+ *    ourselves, so our own reclaim does not hide consumption.
+ * arguments:
+ *    rcc: struct rcc_module.
+ * return:
+ *    none.
+ */
+static void rcc_reset_sample(struct rcc_module *rcc)
+{
+	down_write(&rcc->lock);
+	rcc->last_free_pages = global_page_state(NR_FREE_PAGES);
+	rcc->last_sample = jiffies;
+	up_write(&rcc->lock);
+}
+
+/**
+ * purpose: record an app launch and start measuring its footprint.
+ * arguments:
+ *    rcc: struct rcc_module.
+ *    uid: uid of the launched app.
+ * return:
+ *    none.
+ */
+static void rcc_record_launch(struct rcc_module *rcc, unsigned int uid)
+{
+	struct rcc_launch *launch, *slot = NULL;
+	int i;
+
+	down_write(&rcc->lock);
+	for (i = 0; i < RCC_LAUNCH_HISTORY; i++) {
+		launch = &rcc->launches[i];
+		if (launch->uid == uid) {
+			slot = launch;
+			break;
+		}
+		/* take an unused slot, else the least recently launched. */
+		if (!slot || (slot->uid && (!launch->uid ||
+				time_before(launch->last, slot->last))))
+			slot = launch;
+	}
+
+	if (slot->uid != uid) {
+		slot->uid = uid;
+		slot->pages = 0;
+	}
+	slot->last = jiffies;
+
+	rcc->pending_launch = slot;
+	rcc->launch_free_pages = global_page_state(NR_FREE_PAGES);
+	rcc->launch_start = jiffies;
+	up_write(&rcc->lock);
+}
+
+/**
+ * purpose: free memory watermark to reclaim up to.
+ *    free_pages_min plus the expected demand: recent allocation rate
+ *    over RCC_PREDICT_SECONDS and the largest remembered launch. the
+ *    prediction is capped at free_pages_min so a burst cannot make us
+ *    push out the whole anon LRU.
+ * arguments:
+ *    rcc: struct rcc_module.
+ * return:
+ *    target free page count.
+ */
+static unsigned long rcc_free_target(struct rcc_module *rcc)
+{
+	unsigned long predict, launch_max = 0;
+	unsigned long free_pages_min = rcc->free_pages_min;
+	int i;
+
+	down_read(&rcc->lock);
+	for (i = 0; i < RCC_LAUNCH_HISTORY; i++)
+		launch_max = max(launch_max, rcc->launches[i].pages);
+	predict = rcc->alloc_rate * RCC_PREDICT_SECONDS + launch_max;
+	up_read(&rcc->lock);
+
+	return free_pages_min + min(predict, free_pages_min);
+}
+
+/**
+ * purpose: pages to reclaim in one step of a normal clean.
+ * arguments:
+ *    rcc: struct rcc_module.
+ * return:
+ *    distance to the free target, bounded to one swap unit.
+ */
+static int rcc_reclaim_goal(struct rcc_module *rcc)
+{
+	unsigned long target = rcc_free_target(rcc) + RCC_FREE_PAGE_MIN_EX;
+	unsigned long nr_free = global_page_state(NR_FREE_PAGES);
+
+	if (nr_free >= target)
+		return SWAP_CLUSTER_MAX;
+
+	return clamp_t(unsigned long, target - nr_free, SWAP_CLUSTER_MAX,
+		       RCC_NR_SWAP_UNIT_SIZE);
 }
 
 /**
@@ -192,13 +364,15 @@ static int get_cpu_load(struct rcc_module *rcc, bool need_delay)
  * purpose: swap out memory.
  * return count of reclaimed pages.
  */
-static int rcc_swap_out(int nr_pages, int scan_mode)
+static int rcc_swap_out(int nr_pages, int scan_mode,
+			unsigned long *nr_scanned)
 {
 	int unit_pages, total, real = 0;
 	for (total = 0; total < nr_pages; total += 32) {
 		unit_pages =
 		    ((total + 32) > nr_pages) ? (nr_pages - total) : 32;
-		real += try_to_free_pages_ex(unit_pages, scan_mode);
+		real += try_to_free_pages_ex(unit_pages, scan_mode,
+					     nr_scanned);
 		cond_resched();
 	}
 
@@ -231,8 +405,8 @@ static int get_system_stat(struct rcc_module *rcc, bool end)
 	if (!is_cpu_idle(rcc))
 		ret |= WF_CPU_BUSY;
 
-	value = rcc->free_pages_min + (end ? RCC_FREE_PAGE_MIN_EX : 0);
-	if (is_memory_free_enough(value))
+	if (is_memory_free_enough(rcc_free_target(rcc) +
+				  (end ? RCC_FREE_PAGE_MIN_EX : 0)))
 		ret |= WF_MEM_FREE_ENOUGH;
 
 	value = end ? rcc->anon_pages_min : rcc->anon_pages_max;
@@ -272,13 +446,13 @@ static int rcc_thread_wait(struct rcc_module *rcc, long timeout)
 	return 0;
 }
 
-#define DO_SWAP_OUT(mode) do { \
+#define DO_SWAP_OUT(mode, nr) do { \
 		time_jiffies = jiffies; \
 		if (ret & WF_CPU_BUSY) { \
 			nr_pages = 0; \
 			busy_count++; \
 		} else { \
-			nr_pages = rcc_swap_out(RCC_NR_SWAP_UNIT_SIZE, mode); \
+			nr_pages = rcc_swap_out(nr, mode, &nr_scanned); \
 			time_jiffies = elapsed_jiffies(time_jiffies); \
 		} \
 	} while (0)
@@ -302,10 +476,13 @@ static int rcc_thread_wait(struct rcc_module *rcc, long timeout)
 static int rcc_thread(void *unused)
 {
 	int ret, nr_pages, nr_total_pages, busy_count;
-	unsigned long time_jiffies;
+	unsigned long time_jiffies, nr_scanned;
 	struct task_struct *tsk = current;
 	struct rcc_module *rcc = &rcc_module;
 	long timeout;
+	bool full;
+	ktime_t start;
+	u64 cpu_start;
 
 	/* need swap out, PF_FREEZER_SKIP is protection from hung_task. */
 	tsk->flags |= PF_MEMALLOC | PF_SWAPWRITE | PF_KSWAPD | PF_FREEZER_SKIP;
@@ -320,22 +497,29 @@ static int rcc_thread(void *unused)
 			goto out;
 		/* force update cpu load stat. */
 		get_cpu_load(rcc, true);
+		rcc_sample_memory(rcc);
 
 		nr_total_pages = 0;
+		nr_scanned = 0;
+		start = ktime_get();
+		cpu_start = tsk->se.sum_exec_runtime;
 		ret = get_system_stat(rcc, false);
-		if (rcc->full_clean_flag) {
+		full = rcc->full_clean_flag;
+		if (full) {
 			rcc->wakeup_count++;
 			pr_info("rcc wakeup: full.\n");
 
 			/* clean some file cache first */
 			while (nr_total_pages < rcc->full_clean_file_pages) {
-				DO_SWAP_OUT(RCC_MODE_FILE);
+				DO_SWAP_OUT(RCC_MODE_FILE,
+					    RCC_NR_SWAP_UNIT_SIZE);
 				_UPDATE_STATE();
 			};
 
 			/* full fill swap area. */
 			do {
-				DO_SWAP_OUT(RCC_MODE_ANON);
+				DO_SWAP_OUT(RCC_MODE_ANON,
+					    RCC_NR_SWAP_UNIT_SIZE);
 				_UPDATE_STATE();
 			} while (!(ret & WF_SWAP_FULL)
 				 && !(ret & WF_NO_ANON_PAGE)
@@ -355,7 +539,8 @@ static int rcc_thread(void *unused)
 			/* swap out pages. */
 			busy_count = 0;
 			do {
-				DO_SWAP_OUT(RCC_MODE_ANON);
+				DO_SWAP_OUT(RCC_MODE_ANON,
+					    rcc_reclaim_goal(rcc));
 				_UPDATE_STATE();
 				if (rcc->full_clean_flag || busy_count > 1000 )
 					break;
@@ -368,7 +553,15 @@ static int rcc_thread(void *unused)
 			    ("normal cc: pages=%d, time=%d ms, out_stat=%d, busy=%d\n",
 			     nr_total_pages, jiffies_to_msecs(time_jiffies),
 			     ret, busy_count);
+		} else {
+			continue;
 		}
+
+		rcc_reset_sample(rcc);
+		trace_rcc_reclaim_cycle(full, nr_scanned, nr_total_pages,
+			rcc_free_target(rcc),
+			tsk->se.sum_exec_runtime - cpu_start,
+			ktime_to_ns(ktime_sub(ktime_get(), start)), ret);
 	}
 out:
 	tsk->flags &=
@@ -399,6 +592,9 @@ static void rcc_setup(struct rcc_module *rcc)
 	rcc->anon_pages_max = RCC_ANON_PAGE_MAX;
 
 	rcc->cpu_load[0] = 100;	/* init cpu load as 100% */
+
+	rcc->last_free_pages = global_page_state(NR_FREE_PAGES);
+	rcc->last_sample = jiffies;
 }
 
 /* purpose: start backgroud thread */
@@ -481,6 +677,14 @@ static ssize_t event_store(struct kobject *kobj, struct kobj_attribute *attr,
 		rcc_thread_wakeup(rcc);
 	} else if (!strncmp(buf, "PASSIVE_MODE", strlen("PASSIVE_MODE"))) {
 		rcc->passive_mode = 1;
+	} else if (!strncmp(buf, "APP_LAUNCH", strlen("APP_LAUNCH"))) {
+		/* "APP_LAUNCH <uid>" */
+		unsigned int uid;
+
+		if (sscanf(buf + strlen("APP_LAUNCH"), "%u", &uid) != 1 || !uid)
+			return -EINVAL;
+		rcc_record_launch(rcc, uid);
+		launch_prefetch_app_launch(uid);
 	} else {
 		pr_err("rcc: unknown event: [%s] size=%zu\n",
 			   buf, strlen(buf));
@@ -607,11 +811,13 @@ static ssize_t rcc_stat_show(struct kobject *kobj,
 		"clean pages: full=%d, normal=%d\n"
 		" anon pages: min=%d, max=%d\n"
 		" wake count: %d, time=%d\n"
-		"    passive: %d",
+		"    passive: %d\n"
+		"    predict: rate=%lu pages/s, target=%lu MB\n",
 		rcc->nr_full_clean_pages, rcc->nr_normal_clean_pages,
 		rcc->anon_pages_min, rcc->anon_pages_max,
 		rcc->wakeup_count,jiffies_to_msecs(rcc->total_spent_times),
-		rcc->passive_mode );
+		rcc->passive_mode, rcc->alloc_rate,
+		M(rcc_free_target(rcc)));
 }
 
 static RCC_ATTR(enable, RCC_MODE_RW, enable_show, enable_store);
@@ -5,6 +5,9 @@
 
 #include <linux/mutex.h>
 
+/* number of apps whose launch footprint is remembered. */
+#define RCC_LAUNCH_HISTORY		16
+
 enum {
 	IDX_CPU_USER = 0,
 	IDX_CPU_SYSTEM,
@@ -13,6 +16,16 @@ enum {
 	IDX_CPU_MAX
 };
 
+/* memory footprint history of one app launch. */
+struct rcc_launch {
+	/* uid of the app, 0 for an unused slot. */
+	unsigned int		uid;
+	/* running average of free pages consumed by a launch. */
+	unsigned long		pages;
+	/* jiffies of last launch, oldest slot is replaced first. */
+	unsigned long		last;
+};
+
 struct rcc_module {
 	/* protect configs from other threads,notifications. */
 	struct rw_semaphore	lock;
@@ -54,6 +67,18 @@ struct rcc_module {
 	unsigned int		nr_normal_clean_pages;
 	/* jiffies counter for all swap time. */
 	unsigned int		total_spent_times;
+	/* free pages and jiffies at last sample, for allocation rate. */
+	unsigned long		last_free_pages;
+	unsigned long		last_sample;
+	/* running average of free pages consumed per second. */
+	unsigned long		alloc_rate;
+	/* launch being measured, NULL if none. protected by lock. */
+	struct rcc_launch	*pending_launch;
+	/* free pages and jiffies when pending_launch started. */
+	unsigned long		launch_free_pages;
+	unsigned long		launch_start;
+	/* per-app launch history, protected by lock. */
+	struct rcc_launch	launches[RCC_LAUNCH_HISTORY];
 };
 
 /* common fail, no special reason. */
@@ -104,4 +129,11 @@ struct rcc_module {
 
 #define RCC_WAIT_INFINITE		-1
 
+/* time after a launch event its memory use is measured. in ms. */
+#define RCC_LAUNCH_WINDOW		3000
+/* seconds of allocation to keep free memory for. */
+#define RCC_PREDICT_SECONDS		5
+/* newest sample weighs 1/2^RCC_EWMA_SHIFT in running averages. */
+#define RCC_EWMA_SHIFT			3
+
 #endif
@@ -31,8 +31,15 @@
 #define CREATE_TRACE_POINTS
 #include "trace/sync.h"
 
+/*
+ * Fences of up to this many sync_pts, i.e. those of sync_fence_create()
+ * and most merges, come from a slab cache of their own.
+ */
+#define SYNC_FENCE_CACHE_PTS	2
+
 static const struct fence_ops android_fence_ops;
 static const struct file_operations sync_fence_fops;
+static struct kmem_cache *sync_fence_cachep __read_mostly;
 
 struct sync_timeline *sync_timeline_create(const struct sync_timeline_ops *ops,
 					   int size, const char *name)
@@ -101,6 +108,17 @@ void sync_timeline_destroy(struct sync_timeline *obj)
 }
 EXPORT_SYMBOL(sync_timeline_destroy);
 
+static void sync_timeline_account(struct sync_timeline *obj,
+				  struct sync_pt *pt)
+{
+	u64 latency = ktime_to_ns(ktime_sub(pt->base.timestamp, pt->created));
+
+	obj->signal_count++;
+	obj->signal_latency_ns += latency;
+	if (latency > obj->signal_latency_max_ns)
+		obj->signal_latency_max_ns = latency;
+}
+
 void sync_timeline_signal(struct sync_timeline *obj)
 {
 	unsigned long flags;
@@ -109,12 +127,24 @@ void sync_timeline_signal(struct sync_timeline *obj)
 
 	trace_sync_timeline(obj);
 
+	/*
+	 * Nobody enabled signaling on any pt: nothing to do and no need to
+	 * take the lock. Pairs with the barrier in
+	 * android_fence_enable_signaling(), which makes either us see the
+	 * pt on the list or the enabler see the new timeline value.
+	 */
+	smp_mb();
+	if (list_empty(&obj->active_list_head))
+		return;
+
 	spin_lock_irqsave(&obj->child_list_lock, flags);
 
 	list_for_each_entry_safe(pt, next, &obj->active_list_head,
 				 active_list) {
-		if (fence_is_signaled_locked(&pt->base))
+		if (fence_is_signaled_locked(&pt->base)) {
 			list_del_init(&pt->active_list);
+			sync_timeline_account(obj, pt);
+		}
 	}
 
 	spin_unlock_irqrestore(&obj->child_list_lock, flags);
@@ -140,6 +170,7 @@ struct sync_pt *sync_pt_create(struct sync_timeline *obj, int size)
 	list_add_tail(&pt->child_list, &obj->child_list_head);
 	INIT_LIST_HEAD(&pt->active_list);
 	spin_unlock_irqrestore(&obj->child_list_lock, flags);
+	pt->created = ktime_get();
 	return pt;
 }
 EXPORT_SYMBOL(sync_pt_create);
@@ -150,13 +181,29 @@ void sync_pt_free(struct sync_pt *pt)
 }
 EXPORT_SYMBOL(sync_pt_free);
 
-static struct sync_fence *sync_fence_alloc(int size, const char *name)
+static void sync_fence_kfree(struct sync_fence *fence)
+{
+	if (fence->cached)
+		kmem_cache_free(sync_fence_cachep, fence);
+	else
+		kfree(fence);
+}
+
+static struct sync_fence *sync_fence_alloc(int num_fences, const char *name)
 {
 	struct sync_fence *fence;
 
-	fence = kzalloc(size, GFP_KERNEL);
-	if (fence == NULL)
-		return NULL;
+	if (num_fences <= SYNC_FENCE_CACHE_PTS && sync_fence_cachep) {
+		fence = kmem_cache_zalloc(sync_fence_cachep, GFP_KERNEL);
+		if (fence == NULL)
+			return NULL;
+		fence->cached = true;
+	} else {
+		fence = kzalloc(offsetof(struct sync_fence, cbs[num_fences]),
+				GFP_KERNEL);
+		if (fence == NULL)
+			return NULL;
+	}
 
 	fence->file = anon_inode_getfile("sync_fence", &sync_fence_fops,
 					 fence, 0);
@@ -171,7 +218,7 @@ static struct sync_fence *sync_fence_alloc(int size, const char *name)
 	return fence;
 
 err:
-	kfree(fence);
+	sync_fence_kfree(fence);
 	return NULL;
 }
 
@@ -192,7 +239,7 @@ struct sync_fence *sync_fence_create(const char *name, struct sync_pt *pt)
 {
 	struct sync_fence *fence;
 
-	fence = sync_fence_alloc(offsetof(struct sync_fence, cbs[1]), name);
+	fence = sync_fence_alloc(1, name);
 	if (fence == NULL)
 		return NULL;
 
@@ -259,9 +306,8 @@ struct sync_fence *sync_fence_merge(const char *name,
 	int num_fences = a->num_fences + b->num_fences;
 	struct sync_fence *fence;
 	int i, i_a, i_b;
-	unsigned long size = offsetof(struct sync_fence, cbs[num_fences]);
 
-	fence = sync_fence_alloc(size, name);
+	fence = sync_fence_alloc(num_fences, name);
 	if (fence == NULL)
 		return NULL;
 
@@ -458,10 +504,17 @@ static bool android_fence_enable_signaling(struct fence *fence)
 	struct sync_pt *pt = container_of(fence, struct sync_pt, base);
 	struct sync_timeline *parent = sync_pt_parent(pt);
 
-	if (android_fence_signaled(fence))
-		return false;
-
+	/*
+	 * Publish the pt before checking the timeline value, so that a
+	 * concurrent sync_timeline_signal() either finds it or we see the
+	 * value it signaled.
+	 */
 	list_add_tail(&pt->active_list, &parent->active_list_head);
+	smp_mb();
+	if (android_fence_signaled(fence)) {
+		list_del_init(&pt->active_list);
+		return false;
+	}
 	return true;
 }
 
@@ -534,7 +587,7 @@ static void sync_fence_free(struct kref *kref)
 		fence_put(fence->cbs[i].sync_pt);
 	}
 
-	kfree(fence);
+	sync_fence_kfree(fence);
 }
 
 static int sync_fence_release(struct inode *inode, struct file *file)
@@ -733,3 +786,13 @@ static const struct file_operations sync_fence_fops = {
 	.compat_ioctl = sync_fence_ioctl,
 };
 
+static int __init sync_init(void)
+{
+	/* without the cache every fence just comes from kmalloc */
+	sync_fence_cachep = kmem_cache_create("sync_fence",
+			offsetof(struct sync_fence, cbs[SYNC_FENCE_CACHE_PTS]),
+			0, SLAB_HWCACHE_ALIGN, NULL);
+	return 0;
+}
+core_initcall(sync_init);
+
@@ -87,6 +87,9 @@ struct sync_timeline_ops {
  * @child_list_lock:	lock protecting @child_list_head, destroyed, and
  *			  sync_pt.status
  * @active_list_head:	list of active (unsignaled/errored) sync_pts
+ * @signal_count:	number of waited for sync_pts signaled so far
+ * @signal_latency_ns:	total time from creation to signal of those
+ * @signal_latency_max_ns: longest such time
  * @sync_timeline_list:	membership in global sync_timeline_list
  */
 struct sync_timeline {
@@ -103,6 +106,11 @@ struct sync_timeline {
 
 	struct list_head	active_list_head;
 
+	/* protected by child_list_lock */
+	u64			signal_count;
+	u64			signal_latency_ns;
+	u64			signal_latency_max_ns;
+
 #ifdef CONFIG_DEBUG_FS
 	struct list_head	sync_timeline_list;
 #endif
@@ -119,12 +127,15 @@ struct sync_timeline {
  * @status:		1: signaled, 0:active, <0: error
  * @timestamp:		time which sync_pt status transitioned from active to
  *			  signaled or error.
+ * @created:		time the sync_pt was created, for the signal latency
+ *			  stats of its timeline
  */
 struct sync_pt {
 	struct fence base;
 
 	struct list_head	child_list;
 	struct list_head	active_list;
+	ktime_t			created;
 };
 
 static inline struct sync_timeline *sync_pt_parent(struct sync_pt *pt)
@@ -149,7 +160,9 @@ struct sync_fence_cb {
  * @status:		0: signaled, >0:active, <0: error
  *
  * @wq:			wait queue for fence signaling
- * @sync_fence_list:	membership in global fence list
+ * @sync_fence_list:	membership in the fence list of @debug_cpu
+ * @debug_cpu:		cpu whose fence list the fence is on
+ * @cached:		allocated from the sync_fence slab cache
  */
 struct sync_fence {
 	struct file		*file;
@@ -157,8 +170,10 @@ struct sync_fence {
 	char			name[32];
 #ifdef CONFIG_DEBUG_FS
 	struct list_head	sync_fence_list;
+	int			debug_cpu;
 #endif
 	int num_fences;
+	bool cached;
 
 	wait_queue_head_t	wq;
 	atomic_t		status;
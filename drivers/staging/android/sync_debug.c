@@ -26,14 +26,24 @@
 #include <linux/uaccess.h>
 #include <linux/anon_inodes.h>
 #include <linux/time64.h>
+#include <linux/percpu.h>
 #include "sync.h"
 
 #ifdef CONFIG_DEBUG_FS
 
 static LIST_HEAD(sync_timeline_list_head);
 static DEFINE_SPINLOCK(sync_timeline_list_lock);
-static LIST_HEAD(sync_fence_list_head);
-static DEFINE_SPINLOCK(sync_fence_list_lock);
+
+/*
+ * Fences are created and released thousands of times a second, so they
+ * go on a list of the cpu they were created on rather than on one
+ * global list.
+ */
+struct sync_fence_list {
+	spinlock_t		lock;
+	struct list_head	head;
+};
+static DEFINE_PER_CPU(struct sync_fence_list, sync_fence_lists);
 
 void sync_timeline_debug_add(struct sync_timeline *obj)
 {
@@ -55,22 +65,43 @@ void sync_timeline_debug_remove(struct sync_timeline *obj)
 
 void sync_fence_debug_add(struct sync_fence *fence)
 {
+	struct sync_fence_list *list;
 	unsigned long flags;
 
-	spin_lock_irqsave(&sync_fence_list_lock, flags);
-	list_add_tail(&fence->sync_fence_list, &sync_fence_list_head);
-	spin_unlock_irqrestore(&sync_fence_list_lock, flags);
+	fence->debug_cpu = raw_smp_processor_id();
+	list = per_cpu_ptr(&sync_fence_lists, fence->debug_cpu);
+
+	spin_lock_irqsave(&list->lock, flags);
+	list_add_tail(&fence->sync_fence_list, &list->head);
+	spin_unlock_irqrestore(&list->lock, flags);
 }
 
 void sync_fence_debug_remove(struct sync_fence *fence)
 {
+	struct sync_fence_list *list =
+		per_cpu_ptr(&sync_fence_lists, fence->debug_cpu);
 	unsigned long flags;
 
-	spin_lock_irqsave(&sync_fence_list_lock, flags);
+	spin_lock_irqsave(&list->lock, flags);
 	list_del(&fence->sync_fence_list);
-	spin_unlock_irqrestore(&sync_fence_list_lock, flags);
+	spin_unlock_irqrestore(&list->lock, flags);
 }
 
+static int __init sync_fence_lists_init(void)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct sync_fence_list *list =
+			per_cpu_ptr(&sync_fence_lists, cpu);
+
+		spin_lock_init(&list->lock);
+		INIT_LIST_HEAD(&list->head);
+	}
+	return 0;
+}
+core_initcall(sync_fence_lists_init);
+
 static const char *sync_status_str(int status)
 {
 	if (status == 0)
@@ -135,6 +166,12 @@ static void sync_print_obj(struct seq_file *s, struct sync_timeline *obj)
 	seq_puts(s, "\n");
 
 	spin_lock_irqsave(&obj->child_list_lock, flags);
+	if (obj->signal_count)
+		seq_printf(s, "  signaled %llu, latency avg %lluus max %lluus\n",
+			   obj->signal_count,
+			   div64_u64(obj->signal_latency_ns,
+				     obj->signal_count) / NSEC_PER_USEC,
+			   div_u64(obj->signal_latency_max_ns, NSEC_PER_USEC));
 	list_for_each(pos, &obj->child_list_head) {
 		struct sync_pt *pt =
 			container_of(pos, struct sync_pt, child_list);
@@ -178,6 +215,7 @@ static int sync_debugfs_show(struct seq_file *s, void *unused)
 {
 	unsigned long flags;
 	struct list_head *pos;
+	int cpu;
 
 	seq_puts(s, "objs:\n--------------\n");
 
@@ -194,15 +232,21 @@ static int sync_debugfs_show(struct seq_file *s, void *unused)
 
 	seq_puts(s, "fences:\n--------------\n");
 
-	spin_lock_irqsave(&sync_fence_list_lock, flags);
-	list_for_each(pos, &sync_fence_list_head) {
-		struct sync_fence *fence =
-			container_of(pos, struct sync_fence, sync_fence_list);
+	for_each_possible_cpu(cpu) {
+		struct sync_fence_list *list =
+			per_cpu_ptr(&sync_fence_lists, cpu);
 
-		sync_print_fence(s, fence);
-		seq_puts(s, "\n");
+		spin_lock_irqsave(&list->lock, flags);
+		list_for_each(pos, &list->head) {
+			struct sync_fence *fence =
+				container_of(pos, struct sync_fence,
+					     sync_fence_list);
+
+			sync_print_fence(s, fence);
+			seq_puts(s, "\n");
+		}
+		spin_unlock_irqrestore(&list->lock, flags);
 	}
-	spin_unlock_irqrestore(&sync_fence_list_lock, flags);
 	return 0;
 }
 
@@ -56,6 +56,13 @@ enum android_alarm_return_flags {
 #define ANDROID_ALARM_SET_AND_WAIT(type)    ALARM_IOW(3, type, struct timespec)
 #define ANDROID_ALARM_GET_TIME(type)        ALARM_IOW(4, type, struct timespec)
 #define ANDROID_ALARM_SET_RTC               _IOW('a', 5, struct timespec)
+/* Set alarm to fire anywhere in [start, end], sharing wakeups where possible */
+struct android_alarm_window {
+	struct timespec start;
+	struct timespec end;
+};
+#define ANDROID_ALARM_SET_WINDOW(type)      ALARM_IOW(6, type, \
+						struct android_alarm_window)
 #define ANDROID_ALARM_BASE_CMD(cmd)         (cmd & ~(_IOC(0, 0, 0xf0, 0)))
 #define ANDROID_ALARM_IOCTL_TO_TYPE(cmd)    (_IOC_NR(cmd) >> 4)
 #define ANDROID_RTC_ALARM_SET               _IOW('a', 7, struct timespec)
@@ -240,4 +240,31 @@ struct ion_map_iommu_data {
  */
 #define ION_IOC_INV	_IOWR(ION_IOC_MAGIC, 10, struct ion_fd_data)
 
+/* clean the range after cpu writes / invalidate it before cpu reads */
+#define ION_SYNC_RANGE_FOR_DEVICE	(1 << 0)
+#define ION_SYNC_RANGE_FOR_CPU		(1 << 1)
+
+/**
+ * struct ion_sync_range_data - metadata passed to ION_IOC_SYNC_RANGE
+ * @fd:		a dma-buf fd from ION_IOC_SHARE or ION_IOC_MAP
+ * @flags:	ION_SYNC_RANGE_FOR_DEVICE and/or ION_SYNC_RANGE_FOR_CPU
+ * @offset:	start of the range in bytes
+ * @length:	length of the range in bytes, 0 for the rest of the buffer
+ */
+struct ion_sync_range_data {
+	int fd;
+	unsigned int flags;
+	__u64 offset;
+	__u64 length;
+};
+
+/**
+ * DOC: ION_IOC_SYNC_RANGE - cache maintenance on part of a buffer
+ *
+ * Like ION_IOC_SYNC and ION_IOC_INV, but limited to the given byte range
+ * so a cpu update of a few rows does not clean the whole buffer.
+ */
+#define ION_IOC_SYNC_RANGE	_IOWR(ION_IOC_MAGIC, 11, \
+					struct ion_sync_range_data)
+
 #endif /* _UAPI_LINUX_ION_H */
@@ -628,7 +628,7 @@ static int cpufreq_get_requested_power(struct thermal_cooling_device *cdev,
 {
 	unsigned long freq;
 	int i = 0, cpu, ret;
-	u32 static_power, dynamic_power, total_load = 0;
+	u32 static_power, dynamic_power, total_load = 0, max_load = 0;
 	struct cpufreq_cooling_device *cpufreq_device = cdev->devdata;
 	u32 *load_cpu = NULL;
 
@@ -673,6 +673,7 @@ static int cpufreq_get_requested_power(struct thermal_cooling_device *cdev,
 			load = 0;
 
 		total_load += load;
+		max_load = max(max_load, load);
 
 #ifdef CONFIG_HISI_IPA_THERMAL
 		if (load_cpu)
@@ -685,6 +686,8 @@ static int cpufreq_get_requested_power(struct thermal_cooling_device *cdev,
 	}
 
 	cpufreq_device->last_load = total_load;
+	/* the cluster runs at the pace of its busiest cpu */
+	cdev->perf_sensitivity = max(1U, max_load * 1024 / 100);
 
 	dynamic_power = get_dynamic_power(cpufreq_device, freq);
 	ret = get_static_power(cpufreq_device, tz, freq, &static_power);
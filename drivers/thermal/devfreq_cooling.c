@@ -334,8 +334,12 @@ static int devfreq_cooling_get_requested_power(struct thermal_cooling_device *cd
 	dyn_power = dfc->power_table[state];
 
 	/* Scale dynamic power for utilization */
-	if (status->total_time)
+	if (status->total_time) {
 		dyn_power = (dyn_power * status->busy_time) / status->total_time;
+		cdev->perf_sensitivity = clamp_t(unsigned long,
+				(status->busy_time << 10) / status->total_time,
+				1, 1024);
+	}
 
 	/* Get static power */
 	static_power = get_static_power(dfc, freq);
@@ -40,6 +40,8 @@ int cpufreq_update_policies(void);
 #define NUM_TEMP_SCALE_CAPS 5
 #define NUM_TZD 2
 #define NUM_BOARD_CDEV 3
+/* skin temperature moves slowly, look this far ahead by default (ms) */
+#define IPA_BOARD_PREDICTION_MS	10000
 
 typedef int (*ipa_get_sensor_id_t)(const char *);
 
@@ -972,6 +974,15 @@ static int ipa_thermal_probe(struct platform_device *pdev)
 		goto cdevs_unregister;
 	}
 
+	if (thermal_data->tzd->tzp) {
+		u32 prediction_ms = 0;
+
+		if (thermal_data == &thermal_info.ipa_thermal[BOARD])
+			prediction_ms = IPA_BOARD_PREDICTION_MS;
+		of_property_read_u32(dev_node, "prediction-ms", &prediction_ms);
+		thermal_data->tzd->tzp->prediction_ms = (s32)prediction_ms;
+	}
+
 	update_debugfs(&thermal_data->ipa_sensor);
 	thermal_zone_device_update(thermal_data->tzd);
 
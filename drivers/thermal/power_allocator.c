@@ -15,6 +15,7 @@
 
 #define pr_fmt(fmt) "Power allocator: " fmt
 
+#include <linux/ktime.h>
 #include <linux/rculist.h>
 #include <linux/slab.h>
 #include <linux/thermal.h>
@@ -26,6 +27,11 @@
 
 #define INVALID_TRIP -1
 
+/* weight of a new sample in the temperature trend, 1/N */
+#define TREND_SMOOTHING 4
+/* never project further than this from the measured temperature (mC) */
+#define MAX_PREDICTION 10000
+
 #define FRAC_BITS 10
 #define int_to_frac(x) ((x) << FRAC_BITS)
 #define frac_to_int(x) ((x) >> FRAC_BITS)
@@ -75,6 +81,12 @@ static inline s64 div_frac(s64 x, s64 y)
  * @trip_max_desired_temperature:	last passive trip point of the thermal
  *					zone.  The temperature we are
  *					controlling for.
+ * @prev_temp:	temperature at the previous invocation, for the trend
+ * @prev_time:	time of the previous invocation
+ * @temp_trend:	smoothed rate of temperature change in mC/s
+ * @control_temp:	the temperature the governor acts on: the measured
+ *			one, or with tzp->prediction_ms set, where the trend
+ *			takes it that far ahead
  */
 struct power_allocator_params {
 	bool allocated_tzp;
@@ -82,6 +94,10 @@ struct power_allocator_params {
 	s32 prev_err;
 	int trip_switch_on;
 	int trip_max_desired_temperature;
+	int prev_temp;
+	ktime_t prev_time;
+	s32 temp_trend;
+	int control_temp;
 };
 
 /**
@@ -214,7 +230,7 @@ static u32 pid_controller(struct thermal_zone_device *tz,
 				       true);
 	}
 
-	err = control_temp - tz->temperature;
+	err = control_temp - params->control_temp;
 	err = int_to_frac(err);
 
 	/* Calculate the proportional term */
@@ -343,6 +359,27 @@ static void divvy_up_power(u32 *req_power, u32 *max_power, int num_actors,
 	/*lint +e666*/
 }
 
+/**
+ * actor_sensitivity_weight() - scale an actor's share by its need for power
+ * @cdev:	the actor
+ *
+ * In predictive mode an actor that is running flat out competes for the
+ * budget with its full weight, one that is mostly idle with half of it, so
+ * that the power goes where it buys frame rate. Actors that don't report
+ * their sensitivity keep their full weight.
+ *
+ * Return: a fixed-point factor between 0.5 and 1.
+ */
+static u32 actor_sensitivity_weight(struct thermal_cooling_device *cdev)
+{
+	u32 sensitivity = min_t(u32, cdev->perf_sensitivity, int_to_frac(1));
+
+	if (!sensitivity)
+		return int_to_frac(1);
+
+	return int_to_frac(1) / 2 + sensitivity / 2;
+}
+
 #ifdef CONFIG_HISI_IPA_THERMAL
 static void allocate_power_update_pid(struct thermal_zone_device *soc_tz,
 			u32 soc_sustainable_power)
@@ -485,6 +522,9 @@ static int allocate_power(struct thermal_zone_device *tz,
 			weight = instance->weight;
 
 		weighted_req_power[i] = frac_to_int(weight * req_power[i]);
+		if (tz->tzp->prediction_ms > 0)
+			weighted_req_power[i] = frac_to_int((u64)weighted_req_power[i] *
+					actor_sensitivity_weight(cdev));
 
 		if (power_actor_get_max_power(cdev, tz, &max_power[i]))
 			continue;
@@ -606,6 +646,44 @@ static void get_governor_trips(struct thermal_zone_device *tz,
 	}
 }
 
+/**
+ * update_temperature_trend() - track the temperature and project it ahead
+ * @tz:	thermal zone we are operating in
+ * @params:	governor data of @tz
+ *
+ * Reacting only once the temperature is over the trip point makes the
+ * budget collapse and recover in turns. Driving the controller with where
+ * the temperature is heading instead starts the throttling earlier and
+ * more gently, and lets it go earlier when the zone cools down.
+ *
+ * Return: the temperature the governor should act on.
+ */
+static int update_temperature_trend(struct thermal_zone_device *tz,
+				    struct power_allocator_params *params)
+{
+	ktime_t now = ktime_get();
+	s64 dt_ms = ktime_ms_delta(now, params->prev_time);
+	s64 delta;
+
+	if (params->prev_time.tv64 && dt_ms > 0) {
+		s32 rate = div_s64((s64)(tz->temperature - params->prev_temp) *
+				   MSEC_PER_SEC, dt_ms);
+
+		params->temp_trend += (rate - params->temp_trend) /
+				      TREND_SMOOTHING;
+	}
+	params->prev_temp = tz->temperature;
+	params->prev_time = now;
+
+	if (tz->tzp->prediction_ms <= 0)
+		return tz->temperature;
+
+	delta = div_s64((s64)params->temp_trend * tz->tzp->prediction_ms,
+			MSEC_PER_SEC);
+	delta = clamp_t(s64, delta, -MAX_PREDICTION, MAX_PREDICTION);
+	return tz->temperature + (int)delta;
+}
+
 static void reset_pid_controller(struct power_allocator_params *params)
 {
 	params->err_integral = 0;
@@ -729,13 +807,16 @@ static int power_allocator_throttle(struct thermal_zone_device *tz, int trip)
 	if (trip != params->trip_max_desired_temperature)
 		return 0;
 
+	params->control_temp = update_temperature_trend(tz, params);
+
 	ret = tz->ops->get_trip_temp(tz, params->trip_switch_on,
 				     &switch_on_temp);
 
 #ifdef CONFIG_HISI_IPA_THERMAL
-	if (!ret && ((int)tz->temperature < 0 || tz->temperature < switch_on_temp)) {
+	if (!ret && ((int)tz->temperature < 0 ||
+		     params->control_temp < switch_on_temp)) {
 #else
-	if (!ret && (tz->temperature < switch_on_temp)) {
+	if (!ret && (params->control_temp < switch_on_temp)) {
 #endif
 		tz->passive = 0;
 #ifdef CONFIG_HISI_IPA_THERMAL
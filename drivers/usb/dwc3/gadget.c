@@ -862,6 +862,31 @@ static void dwc3_prepare_one_trb(struct dwc3_ep *dep,
 	trace_dwc3_prepare_trb(dep, trb);
 }
 
+static unsigned dwc3_request_trbs(struct dwc3_request *req)
+{
+	return req->request.num_mapped_sgs ? : 1;
+}
+
+/*
+ * Whether @req is the last request set up by this call. A non-isoc transfer
+ * ends at the TRB with LST set and a chained request must not be split
+ * across two transfers, so the batch also ends before a request whose TRBs
+ * would not all fit.
+ */
+static bool dwc3_request_ends_batch(struct dwc3_ep *dep,
+		struct dwc3_request *req, u32 trbs_left)
+{
+	struct dwc3_request *next;
+
+	if (list_is_last(&req->list, &dep->request_list))
+		return true;
+	if (usb_endpoint_xfer_isoc(dep->endpoint.desc))
+		return false;
+
+	next = list_next_entry(req, list);
+	return dwc3_request_trbs(req) + dwc3_request_trbs(next) > trbs_left;
+}
+
 /*
  * dwc3_prepare_trbs - setup TRBs from requests
  * @dep: endpoint for which requests are being prepared
@@ -926,8 +951,11 @@ static void dwc3_prepare_trbs(struct dwc3_ep *dep, bool starting)
 	list_for_each_entry_safe(req, n, &dep->request_list, list) {
 		unsigned	length;
 		dma_addr_t	dma;
+		bool		ends_batch;
 		last_one = false;
 
+		ends_batch = dwc3_request_ends_batch(dep, req, trbs_left);
+
 		if (req->request.num_mapped_sgs > 0) {
 			struct usb_request *request = &req->request;
 			struct scatterlist *sg = request->sg;
@@ -942,7 +970,7 @@ static void dwc3_prepare_trbs(struct dwc3_ep *dep, bool starting)
 
 				if (i == (request->num_mapped_sgs - 1) ||
 						sg_is_last(s)) {
-					if (list_empty(&dep->request_list))
+					if (ends_batch)
 						last_one = true;
 					chain = false;
 				}
@@ -972,7 +1000,7 @@ static void dwc3_prepare_trbs(struct dwc3_ep *dep, bool starting)
 				last_one = 1;
 
 			/* Is this the last request? */
-			if (list_is_last(&req->list, &dep->request_list))
+			if (ends_batch)
 				last_one = 1;
 
 			dwc3_prepare_one_trb(dep, req, dma, length,
@@ -30,6 +30,8 @@
 #include <linux/file.h>
 #include <linux/device.h>
 #include <linux/miscdevice.h>
+#include <linux/vmalloc.h>
+#include <linux/scatterlist.h>
 
 #include <linux/usb.h>
 #include <linux/usb_usual.h>
@@ -60,6 +62,22 @@
 #define RX_REQ_MAX 8
 #define INTR_REQ_MAX 5
 
+/*
+ * Throughput mode: file transfers go through a ring of 1M requests, each
+ * made of 64K chunks mapped with vmap for vfs_read/vfs_write and handed to
+ * the controller as a scatterlist. File I/O on one buffer overlaps the USB
+ * transfer of the others.
+ */
+#define MTP_STREAM_CHUNK_ORDER	4
+#define MTP_STREAM_CHUNK_SIZE	(PAGE_SIZE << MTP_STREAM_CHUNK_ORDER)
+#define MTP_STREAM_CHUNKS	16
+#define MTP_STREAM_BUF_SIZE	(MTP_STREAM_CHUNKS * MTP_STREAM_CHUNK_SIZE)
+#define MTP_STREAM_MAX		8
+
+static unsigned int stream_bufs = 4;
+module_param(stream_bufs, uint, 0644);
+MODULE_PARM_DESC(stream_bufs, "1M buffers for file transfers, 0 to use the small requests");
+
 /* ID for Microsoft MTP OS String */
 #define MTP_OS_STRING_ID   0xEE
 
@@ -76,6 +94,16 @@
 
 static const char mtp_shortname[] = DRIVER_NAME "_usb";
 
+struct mtp_stream_buf {
+	struct mtp_dev *dev;
+	struct usb_request *req_in;
+	struct usb_request *req_out;
+	struct page *chunk[MTP_STREAM_CHUNKS];
+	struct scatterlist sg[MTP_STREAM_CHUNKS];
+	void *vaddr;
+	int busy;
+};
+
 struct mtp_dev {
 	struct usb_function function;
 	struct usb_composite_dev *cdev;
@@ -115,6 +143,9 @@ struct mtp_dev {
 	uint32_t xfer_transaction_id;
 	int xfer_result;
 	uint32_t bulk_buffer_size;
+
+	struct mtp_stream_buf stream[MTP_STREAM_MAX];
+	unsigned int stream_count;
 };
 
 static struct usb_interface_descriptor mtp_interface_desc = {
@@ -384,6 +415,121 @@ static void mtp_request_free(struct usb_request *req, struct usb_ep *ep)
 	}
 }
 
+static void mtp_stream_complete(struct usb_ep *ep, struct usb_request *req)
+{
+	struct mtp_stream_buf *sb = req->context;
+	struct mtp_dev *dev = sb->dev;
+
+	if (req->status != 0 && dev->state != STATE_CANCELED)
+		dev->state = STATE_ERROR;
+
+	sb->busy = 0;
+	wake_up(req == sb->req_in ? &dev->write_wq : &dev->read_wq);
+}
+
+static void mtp_stream_buf_free(struct mtp_dev *dev, struct mtp_stream_buf *sb)
+{
+	int i;
+
+	if (sb->req_in)
+		usb_ep_free_request(dev->ep_in, sb->req_in);
+	if (sb->req_out)
+		usb_ep_free_request(dev->ep_out, sb->req_out);
+	if (sb->vaddr)
+		vunmap(sb->vaddr);
+	for (i = 0; i < MTP_STREAM_CHUNKS; i++)
+		if (sb->chunk[i])
+			__free_pages(sb->chunk[i], MTP_STREAM_CHUNK_ORDER);
+	memset(sb, 0, sizeof(*sb));
+}
+
+static int mtp_stream_buf_alloc(struct mtp_dev *dev, struct mtp_stream_buf *sb,
+		struct page **pages)
+{
+	int i, j;
+
+	sb->dev = dev;
+	for (i = 0; i < MTP_STREAM_CHUNKS; i++) {
+		sb->chunk[i] = alloc_pages(GFP_KERNEL | __GFP_NOWARN | __GFP_NORETRY,
+					   MTP_STREAM_CHUNK_ORDER);
+		if (!sb->chunk[i])
+			return -ENOMEM;
+		for (j = 0; j < (1 << MTP_STREAM_CHUNK_ORDER); j++)
+			pages[(i << MTP_STREAM_CHUNK_ORDER) + j] = sb->chunk[i] + j;
+	}
+
+	sb->vaddr = vmap(pages, MTP_STREAM_BUF_SIZE >> PAGE_SHIFT, VM_MAP,
+			 PAGE_KERNEL);
+	sb->req_in = usb_ep_alloc_request(dev->ep_in, GFP_KERNEL);
+	sb->req_out = usb_ep_alloc_request(dev->ep_out, GFP_KERNEL);
+	if (!sb->vaddr || !sb->req_in || !sb->req_out)
+		return -ENOMEM;
+
+	sb->req_in->complete = mtp_stream_complete;
+	sb->req_in->context = sb;
+	sb->req_out->complete = mtp_stream_complete;
+	sb->req_out->context = sb;
+	return 0;
+}
+
+/* all or nothing: file transfers fall back to the small requests */
+static void mtp_stream_alloc(struct mtp_dev *dev, struct usb_gadget *gadget)
+{
+	unsigned int count = min_t(unsigned int, stream_bufs, MTP_STREAM_MAX);
+	struct page **pages;
+	unsigned int i;
+
+	dev->stream_count = 0;
+	if (count < 2 || !gadget->sg_supported)
+		return;
+
+	pages = kmalloc_array(MTP_STREAM_BUF_SIZE >> PAGE_SHIFT,
+			      sizeof(*pages), GFP_KERNEL);
+	if (!pages)
+		return;
+
+	for (i = 0; i < count; i++) {
+		if (mtp_stream_buf_alloc(dev, &dev->stream[i], pages)) {
+			do {
+				mtp_stream_buf_free(dev, &dev->stream[i]);
+			} while (i--);
+			kfree(pages);
+			pr_info("mtp: no memory for stream buffers, using %u byte requests\n",
+				dev->bulk_buffer_size);
+			return;
+		}
+	}
+	kfree(pages);
+	dev->stream_count = count;
+}
+
+static void mtp_stream_free(struct mtp_dev *dev)
+{
+	unsigned int i;
+
+	for (i = 0; i < dev->stream_count; i++)
+		mtp_stream_buf_free(dev, &dev->stream[i]);
+	dev->stream_count = 0;
+}
+
+/* describe the first @length bytes of the buffer to the controller */
+static void mtp_stream_prepare(struct mtp_stream_buf *sb,
+		struct usb_request *req, unsigned int length)
+{
+	unsigned int n = DIV_ROUND_UP(length, MTP_STREAM_CHUNK_SIZE);
+	unsigned int i;
+
+	sg_init_table(sb->sg, n);
+	for (i = 0; i < n; i++)
+		sg_set_page(&sb->sg[i], sb->chunk[i],
+			    min_t(unsigned int, length - i * MTP_STREAM_CHUNK_SIZE,
+				  MTP_STREAM_CHUNK_SIZE), 0);
+	req->sg = sb->sg;
+	req->num_sgs = n;
+	req->buf = NULL;
+	req->length = length;
+}
+
 static inline int mtp_lock(atomic_t *excl)
 {
 	if (atomic_inc_return(excl) == 1) {
@@ -537,6 +683,8 @@ static int mtp_create_bulk_endpoints(struct mtp_dev *dev,
 		mtp_req_put(dev, &dev->intr_idle, req);
 	}
 
+	mtp_stream_alloc(dev, cdev->gadget);
+
 	return 0;
 
 fail:
@@ -714,6 +862,65 @@ static ssize_t mtp_write(struct file *fp, const char __user *buf,
 	return r;
 }
 
+/* send_file_work() through the stream buffers, ZLP excluded */
+static int mtp_send_file_stream(struct mtp_dev *dev, struct file *filp,
+		loff_t offset, int64_t count, unsigned hdr_size)
+{
+	struct usb_composite_dev *cdev = dev->cdev;
+	struct mtp_stream_buf *sb;
+	struct mtp_data_header *header;
+	unsigned int next = 0;
+	unsigned xfer;
+	int ret;
+
+	while (count > 0) {
+		/* completions come in order, so the ring's next is the oldest */
+		sb = &dev->stream[next];
+		next = (next + 1) % dev->stream_count;
+		ret = wait_event_interruptible(dev->write_wq,
+			!sb->busy || dev->state != STATE_BUSY);
+		if (dev->state == STATE_CANCELED)
+			return -ECANCELED;
+		if (dev->state != STATE_BUSY)
+			return -EIO;
+		if (ret < 0)
+			return ret;
+
+		xfer = min_t(int64_t, count, MTP_STREAM_BUF_SIZE);
+		if (hdr_size) {
+			header = sb->vaddr;
+			header->length = __cpu_to_le32(count);
+			header->type = __cpu_to_le16(2); /* data packet */
+			header->command = __cpu_to_le16(dev->xfer_command);
+			header->transaction_id =
+					__cpu_to_le32(dev->xfer_transaction_id);
+		}
+
+		ret = vfs_read(filp, sb->vaddr + hdr_size, xfer - hdr_size,
+								&offset);
+		if (ret < 0)
+			return ret;
+		xfer = ret + hdr_size;
+		hdr_size = 0;
+		if (!xfer)
+			/* the file is shorter than announced */
+			return -EIO;
+
+		mtp_stream_prepare(sb, sb->req_in, xfer);
+		sb->busy = 1;
+		ret = usb_ep_queue(dev->ep_in, sb->req_in, GFP_KERNEL);
+		if (ret < 0) {
+			sb->busy = 0;
+			DBG(cdev, "send_file_work: xfer error %d\n", ret);
+			dev->state = STATE_ERROR;
+			return -EIO;
+		}
+		count -= xfer;
+	}
+
+	return 0;
+}
+
 /* read from a local file and write to USB */
 static void send_file_work(struct work_struct *data)
 {
@@ -751,6 +958,14 @@ static void send_file_work(struct work_struct *data)
 	if ((count & (dev->ep_in->maxpacket - 1)) == 0)
 		sendZLP = 1;
 
+	if (dev->stream_count) {
+		r = mtp_send_file_stream(dev, filp, offset, count, hdr_size);
+		if (r)
+			sendZLP = 0;
+		/* only the ZLP is left for the loop below */
+		count = 0;
+	}
+
 	while (count > 0 || sendZLP) {
 		/* so we exit after sending ZLP */
 		if (count == 0)
@@ -818,6 +1033,95 @@ static void send_file_work(struct work_struct *data)
 	smp_wmb();
 }
 
+/*
+ * receive_file_work() through the stream buffers. Reads are only queued
+ * for what the host still has to send, so none can take the packets of
+ * the next command; with an unknown length (0xFFFFFFFF, ended by a short
+ * packet) only one is outstanding at a time.
+ */
+static int mtp_receive_file_stream(struct mtp_dev *dev, struct file *filp,
+		loff_t offset, int64_t count)
+{
+	struct usb_composite_dev *cdev = dev->cdev;
+	struct usb_request *req;
+	struct mtp_stream_buf *sb;
+	bool unknown = (count == 0xFFFFFFFF);
+	int64_t to_queue = count;
+	unsigned int head = 0, tail = 0, inflight = 0;
+	int ret, r = 0;
+
+	while (count > 0 || inflight) {
+		/* keep the ring full while the oldest buffer is written out */
+		while (to_queue > 0 && inflight < dev->stream_count &&
+		       (!unknown || !inflight)) {
+			sb = &dev->stream[tail];
+			mtp_stream_prepare(sb, sb->req_out,
+					   min_t(int64_t, to_queue, MTP_STREAM_BUF_SIZE));
+			sb->busy = 1;
+			ret = usb_ep_queue(dev->ep_out, sb->req_out, GFP_KERNEL);
+			if (ret < 0) {
+				sb->busy = 0;
+				dev->state = STATE_ERROR;
+				r = -EIO;
+				goto out;
+			}
+			if (!unknown)
+				to_queue -= sb->req_out->length;
+			tail = (tail + 1) % dev->stream_count;
+			inflight++;
+		}
+		if (!inflight)
+			break;
+
+		sb = &dev->stream[head];
+		req = sb->req_out;
+		ret = wait_event_interruptible(dev->read_wq,
+			!sb->busy || dev->state != STATE_BUSY);
+		if (dev->state == STATE_CANCELED) {
+			r = -ECANCELED;
+			goto out;
+		}
+		if (dev->state != STATE_BUSY) {
+			r = -EIO;
+			goto out;
+		}
+		if (ret < 0) {
+			r = ret;
+			goto out;
+		}
+		head = (head + 1) % dev->stream_count;
+		inflight--;
+
+		DBG(cdev, "rx %p %d\n", req, req->actual);
+		ret = vfs_write(filp, sb->vaddr, req->actual, &offset);
+		if (ret != req->actual) {
+			r = -EIO;
+			dev->state = STATE_ERROR;
+			goto out;
+		}
+
+		if (!unknown)
+			count -= req->actual;
+		if (req->actual < req->length) {
+			/* short packet: the host is done */
+			DBG(cdev, "got short packet\n");
+			count = 0;
+			to_queue = 0;
+			if (inflight)
+				goto out;
+		}
+	}
+
+out:
+	/* take back what is still queued before the buffers are reused */
+	while (inflight--) {
+		sb = &dev->stream[head];
+		usb_ep_dequeue(dev->ep_out, sb->req_out);
+		head = (head + 1) % dev->stream_count;
+	}
+	return r;
+}
+
 /* read from USB and write to a local file */
 static void receive_file_work(struct work_struct *data)
 {
@@ -839,6 +1143,11 @@ static void receive_file_work(struct work_struct *data)
 
 	DBG(cdev, "receive_file_work(%lld)\n", count);
 
+	if (dev->stream_count) {
+		r = mtp_receive_file_stream(dev, filp, offset, count);
+		count = 0;
+	}
+
 	while (count > 0 || write_req) {
 		if (count > 0) {
 			/* queue a request */
@@ -1255,6 +1564,7 @@ mtp_function_unbind(struct usb_configuration *c, struct usb_function *f)
 		mtp_request_free(dev->rx_req[i], dev->ep_out);
 	while ((req = mtp_req_get(dev, &dev->intr_idle)))
 		mtp_request_free(req, dev->ep_intr);
+	mtp_stream_free(dev);
 	dev->state = STATE_OFFLINE;
 	kfree(f->os_desc_table);
 	f->os_desc_n = 0;
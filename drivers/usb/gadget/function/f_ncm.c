@@ -76,6 +76,7 @@ struct f_ncm {
 	struct sk_buff			*skb_tx_ndp;
 	u16				ndp_dgram_count;
 	bool				timer_force_tx;
+	unsigned			tx_ntb_size;	/* current NTB target */
 	struct tasklet_struct		tx_tasklet;
 	struct hrtimer			task_timer;
 
@@ -102,31 +103,41 @@ static inline unsigned ncm_bitrate(struct usb_gadget *g)
  * We cannot group frames so use just the minimal size which ok to put
  * one max-size ethernet frame.
  * If the host can group frames, allow it to do that, 16K is selected,
- * because it's used by default by the current linux host driver
+ * because it's used by default by the current linux host driver.
+ * Hosts that set the NTB input size may pick up to NTB_MAX_IN_SIZE.
  */
 #define NTB_DEFAULT_IN_SIZE	16384
+#define NTB_MAX_IN_SIZE		32768
+/*
+ * The NTBs we send start at NTB_MIN_TX_SIZE and double each time one
+ * fills up, up to the size the host accepts; one sent by the timer
+ * halves it again. Light traffic keeps small NTBs and allocations, bulk
+ * traffic gets the largest the host takes.
+ */
+#define NTB_MIN_TX_SIZE		4096
 /*
  * Allow the host to group frames, but do not make the NTB out size a multiple
  * of wMaxPacketSize. This is a workaround for USB drivers (e.g. dwc3) which
- * only report a transfer as complete when they receive a short packet. We
- * choose the NTB to be similar to the default in the current Linux host driver
- * (which is 16K) subject to this constraint.
+ * only report a transfer as complete when they receive a short packet. 32K
+ * lets a host that aggregates (Windows, newer Linux) send twice the frames
+ * per transfer; the rx buffers are recycled, so the size costs no extra
+ * allocations.
  *
  * We use a USB fixed buffer size just larger than the NTB out size, because it
  * must be a multiple of wMaxPacketSize.
  */
-#define NTB_OUT_SIZE		16368
-#define USB_OUT_BUFFER_SIZE	16384
+#define NTB_OUT_SIZE		32752
+#define USB_OUT_BUFFER_SIZE	32768
 
 
-/* Allocation for storing the NDP, 32 should suffice for a
- * 16k packet. This allows a maximum of 32 * 507 Byte packets to
- * be transmitted in a single 16kB skb, though when sending full size
+/* Allocation for storing the NDP, 64 should suffice for a
+ * 32k packet. This allows a maximum of 64 * 507 Byte packets to
+ * be transmitted in a single 32kB skb, though when sending full size
  * packets this limit will be plenty.
  * Smaller packets are not likely to be trying to maximize the
  * throughput and will be mstly sending smaller infrequent frames.
  */
-#define TX_MAX_NUM_DPE		32
+#define TX_MAX_NUM_DPE		64
 
 /* Delay for the transmit to wait before sending an unfilled NTB frame. */
 #define TX_TIMEOUT_NSECS	300000
@@ -137,7 +148,7 @@ static inline unsigned ncm_bitrate(struct usb_gadget *g)
 static struct usb_cdc_ncm_ntb_parameters ntb_parameters = {
 	.wLength = cpu_to_le16(sizeof(ntb_parameters)),
 	.bmNtbFormatsSupported = cpu_to_le16(FORMATS_SUPPORTED),
-	.dwNtbInMaxSize = cpu_to_le32(NTB_DEFAULT_IN_SIZE),
+	.dwNtbInMaxSize = cpu_to_le32(NTB_MAX_IN_SIZE),
 	.wNdpInDivisor = cpu_to_le16(4),
 	.wNdpInPayloadRemainder = cpu_to_le16(0),
 	.wNdpInAlignment = cpu_to_le16(4),
@@ -481,6 +492,7 @@ static inline void ncm_reset_values(struct f_ncm *ncm)
 
 	ncm->port.fixed_out_len = USB_OUT_BUFFER_SIZE;
 	ncm->port.fixed_in_len = NTB_DEFAULT_IN_SIZE;
+	ncm->tx_ntb_size = NTB_MIN_TX_SIZE;
 }
 
 /*
@@ -974,7 +986,8 @@ static struct sk_buff *ncm_wrap_ntb(struct gether *port,
 	__le16		*ntb_ndp;
 	int		dgram_pad;
 
-	unsigned	max_size = ncm->port.fixed_in_len;
+	/* only changed below while no NTB is open */
+	unsigned	max_size = min(ncm->tx_ntb_size, ncm->port.fixed_in_len);
 	const struct ndp_parser_opts *opts = ncm->parser_opts;
 	const int ndp_align = le16_to_cpu(ntb_parameters.wNdpInAlignment);
 	const int div = le16_to_cpu(ntb_parameters.wNdpInDivisor);
@@ -1008,9 +1021,17 @@ static struct sk_buff *ncm_wrap_ntb(struct gether *port,
 		    div + rem + skb->len +
 		    ncm->skb_tx_ndp->len + ndp_align + (2 * dgram_idx_len))
 		    > max_size)) {
+			bool full = ncm->ndp_dgram_count < TX_MAX_NUM_DPE;
+
 			skb2 = package_for_tx(ncm);
 			if (!skb2)
 				goto err;
+			/* out of room before the timer: go bigger */
+			if (full) {
+				ncm->tx_ntb_size = min(ncm->tx_ntb_size * 2,
+						       ncm->port.fixed_in_len);
+				max_size = ncm->tx_ntb_size;
+			}
 		}
 
 		if (!ncm->skb_tx_data) {
@@ -1086,6 +1107,8 @@ static struct sk_buff *ncm_wrap_ntb(struct gether *port,
 		skb2 = package_for_tx(ncm);
 		if (!skb2)
 			goto err;
+		ncm->tx_ntb_size = max_t(unsigned, ncm->tx_ntb_size / 2,
+					 NTB_MIN_TX_SIZE);
 	}
 
 	return skb2;
@@ -1274,7 +1297,8 @@ static int ncm_unwrap_ntb(struct gether *port,
 		} while (ndp_len > 2 * (opts->dgram_item_len * 2));
 	} while (ndp_index);
 
-	dev_kfree_skb_any(skb);
+	/* every frame was copied out, the buffer can take the next NTB */
+	gether_recycle_rx_skb(port, skb);
 
 	VDBG(port->func.config->cdev,
 	     "Parsed NTB with %d frames\n", dgram_counter);
@@ -21,6 +21,8 @@
 #include <linux/etherdevice.h>
 #include <linux/ethtool.h>
 #include <linux/if_vlan.h>
+#include <linux/netdevice.h>
+#include <linux/cpumask.h>
 
 #include "u_ether.h"
 
@@ -50,6 +52,16 @@
 
 static struct workqueue_struct	*uether_wq;
 
+/*
+ * Received transfers are unwrapped on uether_wq rather than in the
+ * controller's completion irq, and RPS spreads the protocol processing
+ * of the frames over the online cpus. Clear to leave rps_cpus to
+ * userspace.
+ */
+static bool rx_rps = true;
+module_param(rx_rps, bool, 0644);
+MODULE_PARM_DESC(rx_rps, "spread received frames over all online cpus on open");
+
 struct eth_dev {
 	/* lock is held while accessing port_usb
 	 */
@@ -69,6 +81,8 @@ struct eth_dev {
 	u32			tx_req_bufsize;
 
 	struct sk_buff_head	rx_frames;
+	struct sk_buff_head	rx_raw;		/* completed, not unwrapped */
+	struct sk_buff_head	rx_recycle;	/* rx buffers given back */
 
 	unsigned		qmult;
 
@@ -309,7 +323,14 @@ rx_submit(struct eth_dev *dev, struct usb_request *req, gfp_t gfp_flags)
 		size = max_t(size_t, size, dev->port_usb->fixed_out_len);
 
 	DBG(dev, "%s: size: %d\n", __func__, size);
-	skb = alloc_skb(size + NET_IP_ALIGN, gfp_flags);
+	skb = skb_dequeue(&dev->rx_recycle);
+	if (skb && skb_end_offset(skb) < size + NET_IP_ALIGN) {
+		/* the mtu or the transfer size grew since */
+		dev_kfree_skb_any(skb);
+		skb = NULL;
+	}
+	if (!skb)
+		skb = alloc_skb(size + NET_IP_ALIGN, gfp_flags);
 	if (skb == NULL) {
 		DBG(dev, "no rx skb\n");
 		goto enomem;
@@ -362,29 +383,13 @@ static void rx_complete(struct usb_ep *ep, struct usb_request *req)
 
 		skb_put(skb, req->actual);
 
-		if (dev->unwrap) {
-			unsigned long	flags;
-
-			spin_lock_irqsave(&dev->lock, flags);
-			if (dev->port_usb) {
-				status = dev->unwrap(dev->port_usb,
-							skb,
-							&dev->rx_frames);
-				if (status == -EINVAL)
-					dev->net->stats.rx_errors++;
-				else if (status == -EOVERFLOW)
-					dev->net->stats.rx_over_errors++;
-			} else {
-				dev_kfree_skb_any(skb);
-				status = -ENOTCONN;
-			}
-			spin_unlock_irqrestore(&dev->lock, flags);
-		} else {
+		/* unwrapped by process_rx_w(), off the irq cpu */
+		if (dev->unwrap)
+			skb_queue_tail(&dev->rx_raw, skb);
+		else
 			skb_queue_tail(&dev->rx_frames, skb);
-		}
 
-		if (!status)
-			queue = 1;
+		queue = 1;
 		break;
 
 	/* software-driven interface shutdown */
@@ -524,6 +529,24 @@ static void process_rx_w(struct work_struct *work)
 	if (!dev->port_usb)
 		return;
 
+	while ((skb = skb_dequeue(&dev->rx_raw))) {
+		unsigned long	flags;
+
+		spin_lock_irqsave(&dev->lock, flags);
+		if (dev->port_usb && dev->unwrap) {
+			status = dev->unwrap(dev->port_usb, skb,
+					     &dev->rx_frames);
+			if (status == -EINVAL)
+				dev->net->stats.rx_errors++;
+			else if (status == -EOVERFLOW)
+				dev->net->stats.rx_over_errors++;
+		} else {
+			dev_kfree_skb_any(skb);
+		}
+		spin_unlock_irqrestore(&dev->lock, flags);
+	}
+	status = 0;
+
 	while ((skb = skb_dequeue(&dev->rx_frames))) {
 		if (status < 0
 				|| ETH_HLEN > skb->len
@@ -935,6 +958,8 @@ static int eth_open(struct net_device *net)
 	struct gether	*link;
 
 	DBG(dev, "%s\n", __func__);
+	if (rx_rps)
+		netif_set_rps_cpus(net, cpu_online_mask, 0);
 #if 0
 	if (netif_carrier_ok(dev->net))
 		eth_start(dev, GFP_KERNEL);
@@ -1097,6 +1122,8 @@ struct eth_dev *gether_setup_name(struct usb_gadget *g,
 	INIT_LIST_HEAD(&dev->rx_reqs);
 
 	skb_queue_head_init(&dev->rx_frames);
+	skb_queue_head_init(&dev->rx_raw);
+	skb_queue_head_init(&dev->rx_recycle);
 
 	/* network device setup */
 	dev->net = net;
@@ -1166,6 +1193,8 @@ struct net_device *gether_setup_name_default(const char *netname)
 	INIT_LIST_HEAD(&dev->rx_reqs);
 
 	skb_queue_head_init(&dev->rx_frames);
+	skb_queue_head_init(&dev->rx_raw);
+	skb_queue_head_init(&dev->rx_recycle);
 
 	/* network device setup */
 	dev->net = net;
@@ -1498,6 +1527,10 @@ void gether_disconnect(struct gether *link)
 	while ((skb = __skb_dequeue(&dev->rx_frames)))
 		dev_kfree_skb_any(skb);
 	spin_unlock(&dev->rx_frames.lock);
+	while ((skb = skb_dequeue(&dev->rx_raw)))
+		dev_kfree_skb_any(skb);
+	while ((skb = skb_dequeue(&dev->rx_recycle)))
+		dev_kfree_skb_any(skb);
 
 	link->out_ep->driver_data = NULL;
 	link->out_ep->desc = NULL;
@@ -1513,6 +1546,25 @@ void gether_disconnect(struct gether *link)
 }
 EXPORT_SYMBOL_GPL(gether_disconnect);
 
+void gether_recycle_rx_skb(struct gether *link, struct sk_buff *skb)
+{
+	struct eth_dev	*dev = link->ioport;
+
+	if (!dev || skb_cloned(skb) || skb_shared(skb) ||
+	    skb_is_nonlinear(skb) ||
+	    skb_queue_len(&dev->rx_recycle) >= qlen(dev->gadget, dev->qmult)) {
+		dev_kfree_skb_any(skb);
+		return;
+	}
+
+	/* never went up the stack: only data and tail moved */
+	skb->data = skb->head;
+	skb_reset_tail_pointer(skb);
+	skb->len = 0;
+	skb_queue_tail(&dev->rx_recycle, skb);
+}
+EXPORT_SYMBOL_GPL(gether_recycle_rx_skb);
+
 static int __init gether_init(void)
 {
 	uether_wq  = create_singlethread_workqueue("uether");
@@ -267,6 +267,12 @@ void gether_cleanup(struct eth_dev *dev);
 struct net_device *gether_connect(struct gether *);
 void gether_disconnect(struct gether *);
 
+/*
+ * For unwrap() implementations that copy the frames out: hands the
+ * transfer buffer back for the next rx request instead of freeing it.
+ */
+void gether_recycle_rx_skb(struct gether *link, struct sk_buff *skb);
+
 /* Some controllers can't support CDC Ethernet (ECM) ... */
 static inline bool can_support_ecm(struct usb_gadget *gadget)
 {
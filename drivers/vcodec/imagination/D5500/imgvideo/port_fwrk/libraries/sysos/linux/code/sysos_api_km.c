@@ -151,9 +151,36 @@ typedef struct
 
     SYSOSKM_pfnDevKmHisr       pfnDevKmHisr;  //!< Pointer to HISR callback
     IMG_VOID *                 pvParam;       //!< Callback parameter
+    IMG_UINT64                 ui64QueuedNs;  //!< local_clock() of the first pending activation (0 if none)
 
 } SYSOSKM_sHisr;
 
+/*!
+******************************************************************************
+ HISR latency statistics: activation to callback (the per frame completion
+ delay the decoder sees) and time spent in the callback.
+******************************************************************************/
+typedef struct
+{
+    IMG_UINT64  ui64Count;
+    IMG_UINT64  ui64DelayTotalNs;
+    IMG_UINT64  ui64DelayMaxNs;
+    IMG_UINT64  ui64RunTotalNs;
+    IMG_UINT64  ui64RunMaxNs;
+
+} SYSOSKM_sHisrStats;
+
+static SYSOSKM_sHisrStats  gsHisrStats;
+static DEFINE_SPINLOCK(gsHisrStatsLock);
+
+/*
+ * Low latency mode: run HISRs from a high priority ordered workqueue, so
+ * decode completions are not queued behind normal kworker load. Applies to
+ * HISRs created after it is set.
+ */
+static int hisr_highpri = 0;
+module_param(hisr_highpri, int, S_IRUGO | S_IWUSR);
+
 /*!
 ******************************************************************************
 
@@ -403,6 +430,11 @@ IMG_RESULT SYSOSKM_Initialise(IMG_VOID)
             pr_err("Cannot create folder '%s' in debugfs (0x%pK)", IMGSYS_DRV_NAME, gpsDebugfsRoot);
             gpsDebugfsRoot = NULL;
         }
+        else
+        {
+            debugfs_create_file("hisr_latency", 0664, gpsDebugfsRoot, IMG_NULL,
+                                &sysoskm_HisrStatsFops);
+        }
 
         /* Now we are initialised..*/
         gInitialised = IMG_TRUE;
@@ -1116,15 +1148,93 @@ static IMG_VOID sysoskm_fnHisrCb(
 )
 {
     SYSOSKM_sHisrMsg *  psHisrMsg = (SYSOSKM_sHisrMsg *) psWork;
+    SYSOSKM_sHisr *     psHisr;
+    IMG_UINT64          ui64Start, ui64Delay, ui64Run;
+    unsigned long       flags;
 
     IMG_ASSERT(psHisrMsg != IMG_NULL);
     if (psHisrMsg != IMG_NULL)
     {
+        psHisr = container_of(psHisrMsg, SYSOSKM_sHisr, psMsg);
+        ui64Start = local_clock();
+        /* activations from here on are served by the next run */
+        ui64Delay = xchg(&psHisr->ui64QueuedNs, 0);
+        ui64Delay = ui64Delay ? ui64Start - ui64Delay : 0;
+
         /* Call the HISR callback...*/
         psHisrMsg->pfnDevKmHisr(psHisrMsg->pvParam);
+
+        ui64Run = local_clock() - ui64Start;
+        spin_lock_irqsave(&gsHisrStatsLock, flags);
+        gsHisrStats.ui64Count++;
+        gsHisrStats.ui64DelayTotalNs += ui64Delay;
+        gsHisrStats.ui64DelayMaxNs = max(gsHisrStats.ui64DelayMaxNs, ui64Delay);
+        gsHisrStats.ui64RunTotalNs += ui64Run;
+        gsHisrStats.ui64RunMaxNs = max(gsHisrStats.ui64RunMaxNs, ui64Run);
+        spin_unlock_irqrestore(&gsHisrStatsLock, flags);
     }
 }
 
+/*!
+******************************************************************************
+
+ @Function    sysoskm_HisrStatsShow
+
+******************************************************************************/
+static int sysoskm_HisrStatsShow(
+    struct seq_file *  s,
+    void *             unused
+)
+{
+    SYSOSKM_sHisrStats  sStats;
+    unsigned long       flags;
+    IMG_UINT64          ui64Count;
+
+    spin_lock_irqsave(&gsHisrStatsLock, flags);
+    sStats = gsHisrStats;
+    spin_unlock_irqrestore(&gsHisrStatsLock, flags);
+
+    ui64Count = sStats.ui64Count ? sStats.ui64Count : 1;
+    seq_printf(s, "count      %llu\n", sStats.ui64Count);
+    seq_printf(s, "delay_avg  %llu us\n", div64_u64(sStats.ui64DelayTotalNs, ui64Count) / NSEC_PER_USEC);
+    seq_printf(s, "delay_max  %llu us\n", sStats.ui64DelayMaxNs / NSEC_PER_USEC);
+    seq_printf(s, "run_avg    %llu us\n", div64_u64(sStats.ui64RunTotalNs, ui64Count) / NSEC_PER_USEC);
+    seq_printf(s, "run_max    %llu us\n", sStats.ui64RunMaxNs / NSEC_PER_USEC);
+    return 0;
+}
+
+static int sysoskm_HisrStatsOpen(
+    struct inode *  inode,
+    struct file *   file
+)
+{
+    return single_open(file, sysoskm_HisrStatsShow, NULL);
+}
+
+/* any write clears the statistics */
+static ssize_t sysoskm_HisrStatsWrite(
+    struct file *        file,
+    const char __user *  buf,
+    size_t               count,
+    loff_t *             ppos
+)
+{
+    unsigned long  flags;
+
+    spin_lock_irqsave(&gsHisrStatsLock, flags);
+    IMG_MEMSET(&gsHisrStats, 0, sizeof(gsHisrStats));
+    spin_unlock_irqrestore(&gsHisrStatsLock, flags);
+    return count;
+}
+
+static const struct file_operations sysoskm_HisrStatsFops = {
+    .open    = sysoskm_HisrStatsOpen,
+    .read    = seq_read,
+    .write   = sysoskm_HisrStatsWrite,
+    .llseek  = seq_lseek,
+    .release = single_release,
+};
+
 
 
 /*!
@@ -1157,7 +1267,11 @@ IMG_RESULT SYSOSKM_CreateKmHisr(
     psHisr->pvParam      = pvParam;
 
     /* Create the work queue...*/
-    psHisr->psWorkQueue = create_singlethread_workqueue(IMGSYS_DRV_NAME"_wq");
+    if (hisr_highpri)
+        psHisr->psWorkQueue = alloc_ordered_workqueue(IMGSYS_DRV_NAME"_wq",
+                                                      WQ_HIGHPRI | WQ_MEM_RECLAIM);
+    else
+        psHisr->psWorkQueue = create_singlethread_workqueue(IMGSYS_DRV_NAME"_wq");
     IMG_ASSERT(psHisr->psWorkQueue != IMG_NULL);
     if (psHisr->psWorkQueue == IMG_NULL)
     {
@@ -1243,6 +1357,9 @@ IMG_VOID SYSOSKM_ActivateKmHisr(
     psHisrMsg->pfnDevKmHisr = psHisr->pfnDevKmHisr;
     psHisrMsg->pvParam        = psHisr->pvParam;
 
+    /* the delay is counted from the first activation not yet served */
+    cmpxchg(&psHisr->ui64QueuedNs, 0, local_clock());
+
     /* Schedule this work...
      * If the hisr workqueue is already running, this will fail,
      * but that does not matter: we just need to wake it up if it was asleep.
@@ -317,6 +317,7 @@ void hisi_display_effect_init(struct hisi_fb_data_type *hisifd)
 		hisifd->display_effect_ioctl_handler = NULL;
 		memset(&hisifd->effect_updated_flag, 0, sizeof(struct dss_module_update));
 		spin_lock_init(&hisifd->effect_lock);
+		INIT_LIST_HEAD(&hisifd->effect_lut_cache);
 
 		hisi_effect_module_support(hisifd);
 	} else if (AUXILIARY_PANEL_IDX == hisifd->index) {
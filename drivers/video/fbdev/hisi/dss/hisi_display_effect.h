@@ -216,6 +216,17 @@ int do_contrast(dss_ce_info_t *info);
 
 void hisi_display_effect_init(struct hisi_fb_data_type *hisifd);
 
+/*
+ * A gamma or degamma LUT, three channels of two 12 bit entries per
+ * register word, as programmed by the effect set_reg handlers.
+ */
+struct dss_effect_lut {
+	struct list_head list;
+	uint32_t hash;
+	uint32_t len;		/* entries per channel */
+	uint32_t words[0];	/* R, G then B words */
+};
+
 int hisi_effect_arsr2p_info_get(struct hisi_fb_data_type *hisifd, struct arsr2p_info *arsr2p);
 int hisi_effect_arsr1p_info_get(struct hisi_fb_data_type *hisifd, struct arsr1p_info *arsr1p);
 int hisi_effect_acm_info_get(struct hisi_fb_data_type *hisifd, struct acm_info *acm);
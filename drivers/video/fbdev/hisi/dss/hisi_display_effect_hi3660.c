@@ -15,6 +15,7 @@
 #include "hisi_fb.h"
 #include <linux/fb.h>
 #include "global_ddr_map.h"
+#include <linux/jhash.h>
 
 //lint -e747, -e838
 
@@ -2048,6 +2049,95 @@ static void free_gamma_table(struct gamma_info *gamma)
 	hisi_effect_kfree(&gamma->gamma_b_table);
 }
 
+/*
+ * Gamma and degamma LUTs used to be programmed at the next frame with one
+ * read-modify-write per 12 bit entry, 3 x 257 of them, and packed again on
+ * every update although brightness and eye comfort transitions keep coming
+ * back to the same tables. The info set handlers now pack them once into
+ * register words, kept in a small MRU list keyed by a hash of the words,
+ * and set_reg writes those words as they are, or nothing when the LUT ram
+ * already holds them. Everything below runs under effect_lock.
+ */
+#define EFFECT_LUT_CACHE_MAX	8
+#define EFFECT_LUT_WORDS(len)	(((len) + 1) / 2)
+
+static bool hisi_effect_lut_busy(struct hisi_fb_data_type *hisifd, struct dss_effect_lut *lut)
+{
+	return (lut == hisifd->gamma_lut) || (lut == hisifd->gamma_lut_hw)
+		|| (lut == hisifd->igm_lut) || (lut == hisifd->igm_lut_hw);
+}
+
+static struct dss_effect_lut *hisi_effect_lut_get(struct hisi_fb_data_type *hisifd,
+	uint32_t *table_r, uint32_t *table_g, uint32_t *table_b, uint32_t lut_len)
+{
+	uint32_t *tables[3] = {table_r, table_g, table_b};
+	uint32_t words = EFFECT_LUT_WORDS(lut_len);
+	struct dss_effect_lut *lut = NULL;
+	struct dss_effect_lut *pos = NULL;
+	struct dss_effect_lut *tmp = NULL;
+	uint32_t *word = NULL;
+	uint32_t ch, i;
+
+	lut = kmalloc(sizeof(*lut) + 3 * words * sizeof(uint32_t), GFP_ATOMIC);
+	if (NULL == lut) {
+		HISI_FB_ERR("failed to kmalloc lut!\n");
+		return NULL;
+	}
+
+	lut->len = lut_len;
+	word = lut->words;
+	for (ch = 0; ch < 3; ch++) {
+		for (i = 0; i < lut_len; i += 2) {
+			*word = tables[ch][i] & 0xfff;
+			if (i + 1 < lut_len)
+				*word |= (tables[ch][i + 1] & 0xfff) << 16;
+			word++;
+		}
+	}
+	lut->hash = jhash2(lut->words, 3 * words, lut_len);
+
+	list_for_each_entry(pos, &hisifd->effect_lut_cache, list) {
+		if ((pos->hash == lut->hash) && (pos->len == lut_len)
+			&& !memcmp(pos->words, lut->words, 3 * words * sizeof(uint32_t))) {
+			kfree(lut);
+			list_move(&pos->list, &hisifd->effect_lut_cache);
+			return pos;
+		}
+	}
+
+	list_add(&lut->list, &hisifd->effect_lut_cache);
+	hisifd->effect_lut_count++;
+
+	list_for_each_entry_safe_reverse(pos, tmp, &hisifd->effect_lut_cache, list) {
+		if (hisifd->effect_lut_count <= EFFECT_LUT_CACHE_MAX)
+			break;
+		if ((pos == lut) || hisi_effect_lut_busy(hisifd, pos))
+			continue;
+		list_del(&pos->list);
+		kfree(pos);
+		hisifd->effect_lut_count--;
+	}
+
+	return lut;
+}
+
+static void hisi_effect_lut_set_reg(char __iomem *lut_base, uint32_t *coef, struct dss_effect_lut *lut)
+{
+	uint32_t words = EFFECT_LUT_WORDS(lut->len);
+	uint32_t *word = lut->words;
+	uint32_t ch, i;
+
+	for (ch = 0; ch < 3; ch++) {
+		for (i = 0; i < words; i++, word++) {
+			/* the last word of an odd LUT has no high entry */
+			if ((lut->len & 1) && (i == words - 1))
+				set_reg(lut_base + coef[ch] + i * 4, *word, 12, 0);
+			else
+				outp32(lut_base + coef[ch] + i * 4, *word);
+		}
+	}
+}
+
 int hisi_effect_arsr2p_info_get(struct hisi_fb_data_type *hisifd, struct arsr2p_info *arsr2p)
 {
 	if (NULL == hisifd) {
@@ -2686,6 +2776,16 @@ int hisi_effect_lcp_info_set(struct hisi_fb_data_type *hisifd, struct lcp_info *
 			HISI_FB_ERR("fb%d, failed to set igm_b_table!\n", hisifd->index);
 			goto err_ret;
 		}
+
+		hisifd->igm_lut = hisi_effect_lut_get(hisifd, lcp_dst->igm_r_table,
+			lcp_dst->igm_g_table, lcp_dst->igm_b_table, IGM_LUT_LEN);
+		if (NULL == hisifd->igm_lut) {
+			HISI_FB_ERR("fb%d, failed to pack igm tables!\n", hisifd->index);
+			goto err_ret;
+		}
+		hisi_effect_kfree(&lcp_dst->igm_r_table);
+		hisi_effect_kfree(&lcp_dst->igm_g_table);
+		hisi_effect_kfree(&lcp_dst->igm_b_table);
 	}
 
 	//GMP
@@ -2808,6 +2908,14 @@ int hisi_effect_gamma_info_set(struct hisi_fb_data_type *hisifd, struct gamma_in
 		return -EINVAL;
 	}
 
+	hisifd->gamma_lut = hisi_effect_lut_get(hisifd, gamma_dst->gamma_r_table,
+		gamma_dst->gamma_g_table, gamma_dst->gamma_b_table, GAMMA_LUT_LEN);
+	if (NULL == hisifd->gamma_lut) {
+		HISI_FB_ERR("fb%d, failed to pack gamma tables!\n", hisifd->index);
+		goto err_ret;
+	}
+	free_gamma_table(gamma_dst);
+
 	hisifd->effect_updated_flag.gamma_effect_updated = true;
 	return 0;
 
@@ -2901,23 +3009,15 @@ err_ret:
 #define GMP_BLOCK_SIZE	137
 #define GMP_CNT_NUM	18
 
-static void lcp_igm_set_reg(char __iomem *lcp_lut_base, struct lcp_info *lcp_param)
+static void lcp_igm_set_reg(struct hisi_fb_data_type *hisifd, char __iomem *lcp_lut_base)
 {
-	int cnt;
-
-	for (cnt = 0; cnt < IGM_LUT_LEN; cnt = cnt + 2) {
-		set_reg(lcp_lut_base + (LCP_U_DEGAMA_R_COEF + cnt * 2), lcp_param->igm_r_table[cnt], 12,0);
-		if(cnt != IGM_LUT_LEN-1)
-			set_reg(lcp_lut_base + (LCP_U_DEGAMA_R_COEF + cnt * 2), lcp_param->igm_r_table[cnt+1], 12,16);
+	uint32_t coef[3] = {LCP_U_DEGAMA_R_COEF, LCP_U_DEGAMA_G_COEF, LCP_U_DEGAMA_B_COEF};
 
-		set_reg(lcp_lut_base + (LCP_U_DEGAMA_G_COEF + cnt * 2), lcp_param->igm_g_table[cnt], 12,0);
-		if(cnt != IGM_LUT_LEN-1)
-			set_reg(lcp_lut_base + (LCP_U_DEGAMA_G_COEF + cnt * 2), lcp_param->igm_g_table[cnt+1], 12,16);
+	if (hisifd->igm_lut == hisifd->igm_lut_hw)
+		return;
 
-		set_reg(lcp_lut_base + (LCP_U_DEGAMA_B_COEF + cnt * 2), lcp_param->igm_b_table[cnt], 12,0);
-		if(cnt != IGM_LUT_LEN-1)
-			set_reg(lcp_lut_base + (LCP_U_DEGAMA_B_COEF + cnt * 2), lcp_param->igm_b_table[cnt+1], 12,16);
-	}
+	hisi_effect_lut_set_reg(lcp_lut_base, coef, hisifd->igm_lut);
+	hisifd->igm_lut_hw = hisifd->igm_lut;
 }
 
 static void lcp_xcc_set_reg(char __iomem *lcp_base, struct lcp_info *lcp_param)
@@ -3001,7 +3101,7 @@ void hisi_effect_lcp_set_reg(struct hisi_fb_data_type *hisifd)
 		goto err_ret;
 	}
 
-	if ((NULL == lcp_param->igm_r_table) || (NULL == lcp_param->igm_g_table) || (NULL == lcp_param->igm_b_table)) {
+	if (NULL == hisifd->igm_lut) {
 		HISI_FB_ERR("fb%d, igm table is null!\n", hisifd->index);
 		goto err_ret;
 	}
@@ -3013,7 +3113,7 @@ void hisi_effect_lcp_set_reg(struct hisi_fb_data_type *hisifd)
 
 	//Update De-Gamma LUT
 	if (effect->lcp_igm_support) {
-		lcp_igm_set_reg(lcp_lut_base, lcp_param);
+		lcp_igm_set_reg(hisifd, lcp_lut_base);
 		//Enable De-Gamma
 		set_reg(lcp_base + LCP_DEGAMA_EN,  lcp_param->igm_enable, 1, 0);
 	}
@@ -3034,6 +3134,7 @@ void hisi_effect_lcp_set_reg(struct hisi_fb_data_type *hisifd)
 
 err_ret:
 	hisifd->effect_updated_flag.lcp_effect_updated = false;
+	hisifd->igm_lut = NULL;
 	free_lcp_table(lcp_param);
 	lcp_config_flag = 0;
 	return;
@@ -3045,7 +3146,7 @@ void hisi_effect_gamma_set_reg(struct hisi_fb_data_type *hisifd)
 	char __iomem *gamma_base = NULL;
 	char __iomem *gamma_lut_base = NULL;
 	static uint32_t gamma_config_flag = 0;
-	int cnt = 0;
+	uint32_t coef[3] = {U_GAMA_R_COEF, U_GAMA_G_COEF, U_GAMA_B_COEF};
 
 	if (NULL == hisifd) {
 		HISI_FB_ERR("hisifd is NULL!");
@@ -3062,6 +3163,13 @@ void hisi_effect_gamma_set_reg(struct hisi_fb_data_type *hisifd)
 
 	gamma_base = hisifd->dss_base + DSS_DPP_GAMA_OFFSET;
 	gamma_lut_base = hisifd->dss_base + DSS_DPP_GAMA_LUT_OFFSET;
+	gamma_param = &(hisifd->effect_info.gamma);
+
+	if ((hisifd->gamma_lut != NULL) && (hisifd->gamma_lut == hisifd->gamma_lut_hw)) {
+		//LUT ram holds it already, no need to disable Gamma for a frame
+		set_reg(gamma_base + GAMA_EN, gamma_param->enable, 1, 0);
+		goto err_ret;
+	}
 
 	if(gamma_config_flag == 0) {
 		//Disable Gamma
@@ -3070,35 +3178,21 @@ void hisi_effect_gamma_set_reg(struct hisi_fb_data_type *hisifd)
 		return;
 	}
 
-	gamma_param = &(hisifd->effect_info.gamma);
-
-	if ((NULL == gamma_param->gamma_r_table) ||
-		(NULL == gamma_param->gamma_g_table) ||
-		(NULL == gamma_param->gamma_b_table)) {
+	if (NULL == hisifd->gamma_lut) {
 		HISI_FB_ERR("fb%d, gamma table is null!\n", hisifd->index);
 		goto err_ret;
 	}
 
 	//Update Gamma LUT
-	for (cnt = 0; cnt < GAMMA_LUT_LEN; cnt = cnt + 2) {
-		set_reg(gamma_lut_base + (U_GAMA_R_COEF + cnt * 2), gamma_param->gamma_r_table[cnt], 12,0);
-		if (cnt != GAMMA_LUT_LEN-1)
-			set_reg(gamma_lut_base + (U_GAMA_R_COEF + cnt * 2), gamma_param->gamma_r_table[cnt+1], 12,16);
-
-		set_reg(gamma_lut_base + (U_GAMA_G_COEF + cnt * 2), gamma_param->gamma_g_table[cnt], 12,0);
-		if (cnt != GAMMA_LUT_LEN-1)
-			set_reg(gamma_lut_base + (U_GAMA_G_COEF + cnt * 2), gamma_param->gamma_g_table[cnt+1], 12,16);
-
-		set_reg(gamma_lut_base + (U_GAMA_B_COEF + cnt * 2), gamma_param->gamma_b_table[cnt], 12,0);
-		if (cnt != GAMMA_LUT_LEN-1)
-			set_reg(gamma_lut_base + (U_GAMA_B_COEF + cnt * 2), gamma_param->gamma_b_table[cnt+1], 12,16);
-	}
+	hisi_effect_lut_set_reg(gamma_lut_base, coef, hisifd->gamma_lut);
+	hisifd->gamma_lut_hw = hisifd->gamma_lut;
 
 	//Enable Gamma
 	set_reg(gamma_base + GAMA_EN,  gamma_param->enable, 1, 0);
 
 err_ret:
 	hisifd->effect_updated_flag.gamma_effect_updated = false;
+	hisifd->gamma_lut = NULL;
 	gamma_config_flag = 0;
 	free_gamma_table(gamma_param);
 
@@ -16,6 +16,7 @@
 #include "hisi_overlay_utils.h"
 #ifdef CONFIG_HISI_OCBC
 #include <linux/hisi/ocbc.h>
+#include <linux/hisi/hisi_irq_affinity.h>
 #endif
 
 DEFINE_SEMAPHORE(hisi_fb_dss_regulator_sem);
@@ -2181,7 +2182,9 @@ static int dpe_regulator_clk_irq_setup(struct platform_device *pdev)
 		}
 	}
 
-	//hisi_irqaffinity_register(hisifd->dpe_irq, 1);
+	/* vsync: keep it off the cpus busy with the UI thread */
+	if (hisifd->dpe_irq)
+		hisi_irqaffinity_set_hint(hisifd->dpe_irq, HISI_IRQ_HINT_LATENCY);
 
 	return 0;
 }
@@ -2312,6 +2315,7 @@ static int dpe_probe(struct platform_device *pdev)
 		HISI_FB_ERR("fb%d platform_device_add failed, error=%d!\n", hisifd->index, ret);
 		goto err_device_put;
 	}
+	hisi_fb_device_pm_link(hisi_fb_dev, pdev);
 
 	dpe_init_led_rg_ct_cscValue();
 
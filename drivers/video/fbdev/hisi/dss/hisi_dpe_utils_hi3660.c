@@ -1933,6 +1933,10 @@ void init_igm_gmp_xcc_gm(struct hisi_fb_data_type *hisifd)
 
 	pinfo = &(hisifd->panel_info);
 
+	/* the LUT rams get the panel or dynamic tables below */
+	hisifd->gamma_lut_hw = NULL;
+	hisifd->igm_lut_hw = NULL;
+
 	if (hisifd->index == PRIMARY_PANEL_IDX) {
 		dpp_base = hisifd->dss_base + DSS_DPP_OFFSET;
 		lcp_base = hisifd->dss_base + DSS_DPP_LCP_OFFSET;
@@ -36,6 +36,8 @@
 #define HISIFB_PLATFORM_TYPE_GET _IOW(HISIFB_IOCTL_MAGIC, 802, int)
 
 #define HISIFB_VSYNC_CTRL _IOW(HISIFB_IOCTL_MAGIC, 0x02, unsigned int)
+/* eventfd signalled from the vsync interrupt, -1 to stop */
+#define HISIFB_VSYNC_EVENTFD_SET _IOW(HISIFB_IOCTL_MAGIC, 0x03, int)
 #define HISIFB_DSS_CLK_RATE_SET _IOW(HISIFB_IOCTL_MAGIC, 0x04, struct dss_clk_rate)
 #define HISIFB_DIRTY_REGION_UPDT_SET _IOW(HISIFB_IOCTL_MAGIC, 0x06, int)
 #define HISIFB_DSS_MMBUF_ALLOC _IOW(HISIFB_IOCTL_MAGIC, 0x08, struct dss_mmbuf)
@@ -46,6 +48,8 @@
 #define HISIFB_OV_ONLINE_PLAY _IOW(HISIFB_IOCTL_MAGIC, 0x21, struct dss_overlay)
 #define HISIFB_OV_OFFLINE_PLAY _IOW(HISIFB_IOCTL_MAGIC, 0x22, struct dss_overlay)
 #define HISIFB_OV_COPYBIT_PLAY _IOW(HISIFB_IOCTL_MAGIC, 0x23, struct dss_overlay)
+/* like HISIFB_OV_ONLINE_PLAY, but returns before the acquire fences signal */
+#define HISIFB_OV_ONLINE_PLAY_ASYNC _IOW(HISIFB_IOCTL_MAGIC, 0x24, struct dss_overlay)
 
 #define HISIFB_IDLE_IS_ALLOWED  _IOW(HISIFB_IOCTL_MAGIC, 0x42, int)
 
@@ -258,6 +262,18 @@ typedef struct dss_mmbuf {
 	int32_t size;
 } dss_mmbuf_t;
 
+/*
+ * Layout of the page mapped from /sys/class/graphics/fbN/vsync_page.
+ * seq is odd while the page is being written: read it before and after
+ * the other fields, and read again if it was odd or has changed.
+ */
+typedef struct hisifb_vsync_page {
+	uint32_t seq;
+	uint32_t fps;
+	uint64_t timestamp;	/* of the last vsync, CLOCK_MONOTONIC ns */
+	uint64_t count;		/* vsyncs since the driver was loaded */
+} hisifb_vsync_page_t;
+
 typedef struct dss_img {
 	uint32_t format;
 	uint32_t width;
@@ -239,6 +239,12 @@ module_param_named(enable_ovl_cmdlist_offline, g_enable_ovl_cmdlist_offline, int
 MODULE_PARM_DESC(enable_ovl_cmdlist_offline, "hisi overlay cmdlist offline enable");
 #endif
 
+int g_enable_ovl_cmdlist_diff = 1;
+#ifdef CONFIG_FB_DEBUG_USED
+module_param_named(enable_ovl_cmdlist_diff, g_enable_ovl_cmdlist_diff, int, 0644);
+MODULE_PARM_DESC(enable_ovl_cmdlist_diff, "hisi overlay online cmdlist only emits changed channel modules");
+#endif
+
 int g_rdma_stretch_threshold = RDMA_STRETCH_THRESHOLD;
 #ifdef CONFIG_FB_DEBUG_USED
 module_param_named(rdma_stretch_threshold, g_rdma_stretch_threshold, int, 0644);
@@ -357,6 +363,20 @@ static void hisifb_pm_runtime_unregister(struct platform_device *pdev);
 /*******************************************************************************
 **
 */
+/*
+ * @dev calls into @next (its pdata->next) from its own on/off, so @next
+ * must still be up while @dev suspends and be up again before it resumes.
+ * With that ordering known to the PM core both can suspend asynchronously.
+ */
+void hisi_fb_device_pm_link(struct platform_device *dev, struct platform_device *next)
+{
+	if (device_pm_add_dependency(&dev->dev, &next->dev))
+		return;
+
+	device_enable_async_suspend(&dev->dev);
+	device_enable_async_suspend(&next->dev);
+}
+
 struct platform_device *hisi_fb_add_device(struct platform_device *pdev)
 {
 	struct hisi_fb_panel_data *pdata = NULL;
@@ -479,6 +499,7 @@ struct platform_device *hisi_fb_add_device(struct platform_device *pdev)
 		fbi_list_index--;
 		return NULL;
 	}
+	hisi_fb_device_pm_link(this_dev, pdev);
 
 	return this_dev;
 }
@@ -1200,6 +1221,10 @@ static int hisi_fb_ioctl(struct fb_info *info, unsigned int cmd, unsigned long a
 		}
 		break;
 
+	case HISIFB_VSYNC_EVENTFD_SET:
+		ret = hisifb_vsync_eventfd_set(info, argp);
+		break;
+
 	case HISIFB_IDLE_IS_ALLOWED:
 		ret = hisifb_idle_is_allowed(info, argp);
 		break;
@@ -132,6 +132,8 @@
 //esd check period-->5000ms
 #define ESD_CHECK_TIME_PERIOD	(5000)
 
+struct eventfd_ctx;
+
 struct hisifb_vsync {
 	wait_queue_head_t vsync_wait;
 	ktime_t vsync_timestamp;
@@ -157,6 +159,19 @@ struct hisifb_vsync {
 	atomic_t buffer_updated;
 	void (*vsync_report_fnc) (int buffer_updated);
 
+	/* mmap()ed by the compositor, written and signalled from the isr */
+	struct hisifb_vsync_page *vsync_page;
+	struct eventfd_ctx *vsync_eventfd;
+
+	/* delivery stats, see vsync_stats */
+	u64 stat_count;
+	u64 stat_missed;
+	u64 stat_jitter_sum_ns;
+	u64 stat_jitter_max_ns;
+	u64 stat_sysfs_reads;
+	u64 stat_sysfs_delay_sum_ns;
+	u64 stat_sysfs_delay_max_ns;
+
 	struct hisi_fb_data_type *hisifd;
 };
 
@@ -392,6 +407,7 @@ struct hisi_fb_data_type {
 	int (*ov_ioctl_handler) (struct hisi_fb_data_type *hisifd, uint32_t cmd, void __user *argp);
 	int (*display_effect_ioctl_handler) (struct hisi_fb_data_type *hisifd, unsigned int cmd, void __user *argp);
 	int (*ov_online_play) (struct hisi_fb_data_type *hisifd, void __user *argp);
+	int (*ov_online_play_async) (struct hisi_fb_data_type *hisifd, void __user *argp);
 	int (*ov_offline_play) (struct hisi_fb_data_type *hisifd, void __user *argp);
 	int (*ov_copybit_play) (struct hisi_fb_data_type *hisifd, void __user *argp);
 	void (*ov_wb_isr_handler) (struct hisi_fb_data_type *hisifd);
@@ -431,12 +447,29 @@ struct hisi_fb_data_type {
 	struct dss_effect effect_ctl;
 	struct dss_effect_info effect_info;
 
+	/* packed gamma and degamma LUTs, see hisi_effect_lut_get() */
+	struct list_head effect_lut_cache;
+	int effect_lut_count;
+	struct dss_effect_lut *gamma_lut;	/* waiting for the next frame */
+	struct dss_effect_lut *gamma_lut_hw;	/* what the LUT ram holds */
+	struct dss_effect_lut *igm_lut;
+	struct dss_effect_lut *igm_lut_hw;
+
 	int sysfs_index;
 	struct attribute *sysfs_attrs[HISI_FB_SYSFS_ATTRS_NUM];
 	struct attribute_group sysfs_attr_group;
 
 	struct hisifb_vsync vsync_ctrl;
 	struct hisifb_buf_sync buf_sync_ctrl;
+#ifdef CONFIG_BUF_SYNC_USED
+	/* frames queued by HISIFB_OV_ONLINE_PLAY_ASYNC, oldest first */
+	struct workqueue_struct *async_commit_wq;
+	struct delayed_work async_commit_work;
+	struct list_head async_commit_list;
+	spinlock_t async_commit_lock;
+	wait_queue_head_t async_commit_wait;
+	int async_commit_count;
+#endif
 	struct dss_clk_rate dss_clk_rate;
 	struct hisifb_secure secure_ctrl;
 	struct hisifb_esd esd_ctrl;
@@ -470,8 +503,13 @@ struct hisi_fb_data_type {
 
 	bool dss_module_resource_initialized;
 	dss_module_reg_t dss_module_default;
+	/* last channel registers emitted to the online cmdlist, for diff mode */
+	dss_module_reg_t dss_module_prog;
 
 	struct dss_rect dirty_region_updt;
+	/* frames sent with a sub-panel window vs. the whole panel */
+	uint32_t dirty_region_partial_count;
+	uint32_t dirty_region_full_count;
 	uint32_t esd_happened;
 	uint32_t esd_recover_state;
 
@@ -600,6 +638,7 @@ void hisifb_set_vsync_activate_state(struct hisi_fb_data_type *hisifd, bool infi
 void hisifb_activate_vsync(struct hisi_fb_data_type *hisifd);
 void hisifb_deactivate_vsync(struct hisi_fb_data_type *hisifd);
 int hisifb_vsync_ctrl(struct fb_info *info, void __user *argp);
+int hisifb_vsync_eventfd_set(struct fb_info *info, void __user *argp);
 int hisifb_vsync_resume(struct hisi_fb_data_type *hisifd);
 int hisifb_vsync_suspend(struct hisi_fb_data_type *hisifd);
 void hisifb_vsync_isr_handler(struct hisi_fb_data_type *hisifd);
@@ -658,6 +697,7 @@ void hisifb_save_file(char *filename, char *buf, uint32_t buf_len);
 struct platform_device *hisi_fb_device_alloc(struct hisi_fb_panel_data *pdata,
 	uint32_t type, uint32_t id);
 struct platform_device *hisi_fb_add_device(struct platform_device *pdev);
+void hisi_fb_device_pm_link(struct platform_device *dev, struct platform_device *next);
 
 #ifdef CONFIG_HUAWEI_OCP
 int hisi_lcd_ocp_recover(struct notifier_block *nb,
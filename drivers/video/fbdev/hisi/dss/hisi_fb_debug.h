@@ -106,6 +106,7 @@ extern int g_debug_ovl_cmdlist;
 extern int g_dump_cmdlist_content;
 extern int g_enable_ovl_cmdlist_online;
 extern int g_enable_ovl_cmdlist_offline;
+extern int g_enable_ovl_cmdlist_diff;
 extern int g_rdma_stretch_threshold;
 extern int g_enable_dirty_region_updt;
 extern int g_debug_dirty_region_updt;
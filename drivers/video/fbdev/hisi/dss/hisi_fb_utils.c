@@ -1010,6 +1010,38 @@ static ssize_t hisifb_frame_count_show(struct device *dev,
 	return snprintf(buf, PAGE_SIZE, "%u\n", hisifd->frame_count);
 }
 
+static ssize_t hisifb_dirty_region_count_show(struct device *dev,
+		  struct device_attribute *attr, char *buf)
+{
+	struct fb_info *fbi = NULL;
+	struct hisi_fb_data_type *hisifd = NULL;
+
+	if (NULL == dev) {
+		HISI_FB_ERR("NULL Pointer\n");
+		return -1;
+	}
+
+	fbi = dev_get_drvdata(dev);
+	if (NULL == fbi) {
+		HISI_FB_ERR("NULL Pointer\n");
+		return -1;
+	}
+
+	hisifd = (struct hisi_fb_data_type *)fbi->par;
+	if (NULL == hisifd) {
+		HISI_FB_ERR("NULL Pointer\n");
+		return -1;
+	}
+
+	if (NULL == buf) {
+		HISI_FB_ERR("NULL Pointer\n");
+		return -1;
+	}
+
+	return snprintf(buf, PAGE_SIZE, "partial:%u full:%u\n",
+		hisifd->dirty_region_partial_count, hisifd->dirty_region_full_count);
+}
+
 static ssize_t hisifb_lcd_mipi_detect_show(struct device *dev,
 		  struct device_attribute *attr, char *buf)
 {
@@ -4469,6 +4501,7 @@ static DEVICE_ATTR(lcd_ce_mode, S_IRUGO|S_IWUSR, hisifb_lcd_ce_mode_show, hisifb
 static DEVICE_ATTR(lcd_check_reg, S_IRUGO, hisifb_lcd_check_reg_show, NULL);
 static DEVICE_ATTR(lcd_mipi_detect, S_IRUGO, hisifb_lcd_mipi_detect_show, NULL);
 static DEVICE_ATTR(frame_count, S_IRUGO, hisifb_frame_count_show, NULL);
+static DEVICE_ATTR(dirty_region_count, S_IRUGO, hisifb_dirty_region_count_show, NULL);
 static DEVICE_ATTR(mipi_dsi_bit_clk_upt, S_IRUGO|S_IWUSR, hisifb_mipi_dsi_bit_clk_upt_show, hisifb_mipi_dsi_bit_clk_upt_store);
 static DEVICE_ATTR(lcd_hkadc, S_IRUGO|S_IWUSR, hisifb_lcd_hkadc_debug_show, hisifb_lcd_hkadc_debug_store);
 static DEVICE_ATTR(lcd_checksum, S_IRUGO|S_IWUSR, hisifb_lcd_gram_check_show, hisifb_lcd_gram_check_store);
@@ -4530,6 +4563,7 @@ void hisifb_sysfs_attrs_add(struct hisi_fb_data_type *hisifd)
 		hisifd->sysfs_attrs_append_fnc(hisifd, &dev_attr_lcd_check_reg.attr);
 		hisifd->sysfs_attrs_append_fnc(hisifd, &dev_attr_lcd_mipi_detect.attr);
 		hisifd->sysfs_attrs_append_fnc(hisifd, &dev_attr_frame_count.attr);
+		hisifd->sysfs_attrs_append_fnc(hisifd, &dev_attr_dirty_region_count.attr);
 		hisifd->sysfs_attrs_append_fnc(hisifd, &dev_attr_mipi_dsi_bit_clk_upt.attr);
 		hisifd->sysfs_attrs_append_fnc(hisifd, &dev_attr_lcd_hkadc.attr);
 		hisifd->sysfs_attrs_append_fnc(hisifd, &dev_attr_lcd_checksum.attr);
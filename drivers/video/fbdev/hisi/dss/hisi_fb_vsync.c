@@ -13,6 +13,9 @@
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wformat"
 
+#include <linux/cpuidle.h>
+#include <linux/eventfd.h>
+#include <linux/hisi/hisi_hmpth.h>
 #include "hisi_fb.h"
 
 /*
@@ -37,6 +40,57 @@ void hisifb_frame_updated(struct hisi_fb_data_type *hisifd)
 	if (hisifd->vsync_ctrl.vsync_report_fnc) {
 		atomic_inc(&(hisifd->vsync_ctrl.buffer_updated));
 	}
+
+	if ((hisifd->index == PRIMARY_PANEL_IDX) && hisifd->panel_info.fps) {
+		hmpth_frame_done(ktime_to_ns(hisifd->vsync_ctrl.vsync_timestamp),
+			ktime_get_ns(), NSEC_PER_SEC / hisifd->panel_info.fps);
+	}
+}
+
+/*
+ * Publish the vsync in the shared page and signal the compositor's eventfd
+ * straight from the isr, without a thread or sysfs read in between.
+ */
+static void hisifb_vsync_publish(struct hisi_fb_data_type *hisifd,
+	ktime_t pre_vsync_timestamp)
+{
+	struct hisifb_vsync *vsync_ctrl = &(hisifd->vsync_ctrl);
+	struct hisifb_vsync_page *page = vsync_ctrl->vsync_page;
+	u64 now = ktime_to_ns(vsync_ctrl->vsync_timestamp);
+	u64 period = 0;
+	u64 interval = 0;
+	u64 jitter = 0;
+
+	if (page) {
+		page->seq++;
+		smp_wmb();
+		page->timestamp = now;
+		page->fps = hisifd->panel_info.fps;
+		page->count++;
+		smp_wmb();
+		page->seq++;
+	}
+
+	spin_lock(&vsync_ctrl->spin_lock);
+	if (vsync_ctrl->vsync_eventfd && vsync_ctrl->vsync_enabled)
+		eventfd_signal(vsync_ctrl->vsync_eventfd, 1);
+	spin_unlock(&vsync_ctrl->spin_lock);
+
+	if (!hisifd->panel_info.fps || !vsync_ctrl->vsync_enabled)
+		return;
+
+	/* vsyncs more than two periods apart count as missed, not as jitter */
+	period = NSEC_PER_SEC / hisifd->panel_info.fps;
+	interval = now - ktime_to_ns(pre_vsync_timestamp);
+	vsync_ctrl->stat_count++;
+	if (interval >= 2 * period) {
+		vsync_ctrl->stat_missed++;
+		return;
+	}
+	jitter = (interval > period) ? (interval - period) : (period - interval);
+	vsync_ctrl->stat_jitter_sum_ns += jitter;
+	if (jitter > vsync_ctrl->stat_jitter_max_ns)
+		vsync_ctrl->stat_jitter_max_ns = jitter;
 }
 
 void hisifb_vsync_isr_handler(struct hisi_fb_data_type *hisifd)
@@ -53,8 +107,15 @@ void hisifb_vsync_isr_handler(struct hisi_fb_data_type *hisifd)
 
 	pre_vsync_timestamp = vsync_ctrl->vsync_timestamp;
 	vsync_ctrl->vsync_timestamp = ktime_get();
+	hisifb_vsync_publish(hisifd, pre_vsync_timestamp);
 	wake_up_interruptible_all(&(vsync_ctrl->vsync_wait));
 
+	if ((hisifd->index == PRIMARY_PANEL_IDX) && hisifd->panel_info.fps) {
+		cpuidle_periodic_event(CPUIDLE_EVENT_VSYNC,
+			ktime_to_ns(vsync_ctrl->vsync_timestamp),
+			NSEC_PER_SEC / hisifd->panel_info.fps);
+	}
+
 	if (hisifd->panel_info.vsync_ctrl_type != VSYNC_CTRL_NONE) {
 		spin_lock(&vsync_ctrl->spin_lock);
 		if (vsync_ctrl->vsync_ctrl_expire_count) {
@@ -195,6 +256,16 @@ static ssize_t vsync_show_event(struct device *dev,
 	vsync_flag = (vsync_timestamp_changed(hisifd, prev_timestamp) &&
 						hisifd->vsync_ctrl.vsync_enabled);
 
+	if (vsync_flag) {
+		struct hisifb_vsync *vsync_ctrl = &(hisifd->vsync_ctrl);
+		u64 delay = ktime_to_ns(ktime_sub(ktime_get(), vsync_ctrl->vsync_timestamp));
+
+		vsync_ctrl->stat_sysfs_reads++;
+		vsync_ctrl->stat_sysfs_delay_sum_ns += delay;
+		if (delay > vsync_ctrl->stat_sysfs_delay_max_ns)
+			vsync_ctrl->stat_sysfs_delay_max_ns = delay;
+	}
+
 	report_flag = !!secure_ctrl->tui_need_switch;
 
 	if (vsync_flag && report_flag) {
@@ -273,6 +344,134 @@ static DEVICE_ATTR(vsync_event, S_IRUGO, vsync_show_event, NULL);
 static DEVICE_ATTR(vsync_timestamp, S_IRUGO, vsync_timestamp_show, NULL);
 #endif
 
+static struct hisi_fb_data_type *hisifb_from_kobj(struct kobject *kobj)
+{
+	struct fb_info *fbi = NULL;
+
+	fbi = dev_get_drvdata(container_of(kobj, struct device, kobj));
+	if (NULL == fbi)
+		return NULL;
+
+	return (struct hisi_fb_data_type *)fbi->par;
+}
+
+static ssize_t vsync_page_read(struct file *filp, struct kobject *kobj,
+	struct bin_attribute *attr, char *buf, loff_t off, size_t count)
+{
+	struct hisi_fb_data_type *hisifd = hisifb_from_kobj(kobj);
+
+	if ((NULL == hisifd) || (NULL == hisifd->vsync_ctrl.vsync_page))
+		return -ENODEV;
+
+	return memory_read_from_buffer(buf, count, &off,
+		hisifd->vsync_ctrl.vsync_page, sizeof(struct hisifb_vsync_page));
+}
+
+static int vsync_page_mmap(struct file *filp, struct kobject *kobj,
+	struct bin_attribute *attr, struct vm_area_struct *vma)
+{
+	struct hisi_fb_data_type *hisifd = hisifb_from_kobj(kobj);
+
+	if ((NULL == hisifd) || (NULL == hisifd->vsync_ctrl.vsync_page))
+		return -ENODEV;
+
+	if (vma->vm_pgoff || (vma->vm_end - vma->vm_start != PAGE_SIZE) ||
+		(vma->vm_flags & VM_WRITE))
+		return -EINVAL;
+
+	/* the mapping holds a reference, the page outlives an unregister */
+	vma->vm_flags &= ~VM_MAYWRITE;
+	return vm_insert_page(vma, vma->vm_start,
+		virt_to_page(hisifd->vsync_ctrl.vsync_page));
+}
+
+static struct bin_attribute vsync_page_attr = {
+	.attr = { .name = "vsync_page", .mode = S_IRUGO },
+	.size = PAGE_SIZE,
+	.read = vsync_page_read,
+	.mmap = vsync_page_mmap,
+};
+
+static struct bin_attribute *hisifb_vsync_bin_attrs[] = {
+	&vsync_page_attr,
+	NULL,
+};
+
+static ssize_t vsync_stats_show(struct device *dev,
+	struct device_attribute *attr, char *buf)
+{
+	struct hisi_fb_data_type *hisifd = hisifb_from_kobj(&dev->kobj);
+	struct hisifb_vsync *vsync_ctrl = NULL;
+	u64 jitters = 0;
+
+	if (NULL == hisifd) {
+		HISI_FB_ERR("NULL Pointer.\n");
+		return -1;
+	}
+	vsync_ctrl = &(hisifd->vsync_ctrl);
+	jitters = vsync_ctrl->stat_count - vsync_ctrl->stat_missed;
+
+	return snprintf(buf, PAGE_SIZE,
+		"vsyncs %llu\nmissed %llu\njitter_avg_ns %llu\njitter_max_ns %llu\n"
+		"sysfs_reads %llu\nsysfs_delay_avg_ns %llu\nsysfs_delay_max_ns %llu\n",
+		vsync_ctrl->stat_count, vsync_ctrl->stat_missed,
+		jitters ? div64_u64(vsync_ctrl->stat_jitter_sum_ns, jitters) : 0,
+		vsync_ctrl->stat_jitter_max_ns,
+		vsync_ctrl->stat_sysfs_reads,
+		vsync_ctrl->stat_sysfs_reads ?
+			div64_u64(vsync_ctrl->stat_sysfs_delay_sum_ns,
+				vsync_ctrl->stat_sysfs_reads) : 0,
+		vsync_ctrl->stat_sysfs_delay_max_ns);
+}
+
+static DEVICE_ATTR(vsync_stats, S_IRUGO, vsync_stats_show, NULL);
+
+int hisifb_vsync_eventfd_set(struct fb_info *info, void __user *argp)
+{
+	struct hisi_fb_data_type *hisifd = NULL;
+	struct hisifb_vsync *vsync_ctrl = NULL;
+	struct eventfd_ctx *ctx = NULL;
+	struct eventfd_ctx *old = NULL;
+	unsigned long flags = 0;
+	int fd = -1;
+
+	if ((NULL == info) || (NULL == argp)) {
+		HISI_FB_ERR("NULL Pointer!\n");
+		return -EINVAL;
+	}
+
+	hisifd = (struct hisi_fb_data_type *)info->par;
+	if (NULL == hisifd) {
+		HISI_FB_ERR("NULL Pointer!\n");
+		return -EINVAL;
+	}
+
+	if (hisifd->index != PRIMARY_PANEL_IDX) {
+		HISI_FB_ERR("fb%d, not supported!\n", hisifd->index);
+		return -EINVAL;
+	}
+	vsync_ctrl = &(hisifd->vsync_ctrl);
+
+	if (copy_from_user(&fd, argp, sizeof(fd)))
+		return -EFAULT;
+
+	if (fd >= 0) {
+		ctx = eventfd_ctx_fdget(fd);
+		if (IS_ERR(ctx))
+			return PTR_ERR(ctx);
+	}
+
+	spin_lock_irqsave(&(vsync_ctrl->spin_lock), flags);
+	old = vsync_ctrl->vsync_eventfd;
+	vsync_ctrl->vsync_eventfd = ctx;
+	spin_unlock_irqrestore(&(vsync_ctrl->spin_lock), flags);
+
+	if (old)
+		eventfd_ctx_put(old);
+
+	return 0;
+}
+
 #ifdef CONFIG_FAKE_VSYNC_USED
 enum hrtimer_restart hisifb_fake_vsync(struct hrtimer *timer)
 {
@@ -395,6 +594,12 @@ void hisifb_vsync_register(struct platform_device *pdev)
 	mutex_init(&(vsync_ctrl->vsync_lock));
 
 	atomic_set(&(vsync_ctrl->buffer_updated), 1);
+
+	vsync_ctrl->vsync_page = (struct hisifb_vsync_page *)get_zeroed_page(GFP_KERNEL);
+	if (vsync_ctrl->vsync_page == NULL)
+		HISI_FB_ERR("fb%d, failed to alloc vsync page!\n", hisifd->index);
+	vsync_ctrl->vsync_eventfd = NULL;
+
 #ifdef CONFIG_REPORT_VSYNC
 	vsync_ctrl->vsync_report_fnc = mali_kbase_pm_report_vsync;
 #else
@@ -425,6 +630,12 @@ void hisifb_vsync_register(struct platform_device *pdev)
 	}
 #endif
 
+	if (hisifd->sysfs_attrs_append_fnc) {
+		hisifd->sysfs_attrs_append_fnc(hisifd, &dev_attr_vsync_stats.attr);
+		if (vsync_ctrl->vsync_page)
+			hisifd->sysfs_attr_group.bin_attrs = hisifb_vsync_bin_attrs;
+	}
+
 	vsync_ctrl->vsync_created = 1;
 }
 
@@ -432,6 +643,9 @@ void hisifb_vsync_unregister(struct platform_device *pdev)
 {
 	struct hisi_fb_data_type *hisifd = NULL;
 	struct hisifb_vsync *vsync_ctrl = NULL;
+	struct hisifb_vsync_page *page = NULL;
+	struct eventfd_ctx *ctx = NULL;
+	unsigned long flags = 0;
 
 	BUG_ON(pdev == NULL);
 	hisifd = platform_get_drvdata(pdev);
@@ -452,6 +666,18 @@ void hisifb_vsync_unregister(struct platform_device *pdev)
 		kthread_stop(vsync_ctrl->vsync_thread);
 #endif
 
+	spin_lock_irqsave(&(vsync_ctrl->spin_lock), flags);
+	page = vsync_ctrl->vsync_page;
+	ctx = vsync_ctrl->vsync_eventfd;
+	vsync_ctrl->vsync_page = NULL;
+	vsync_ctrl->vsync_eventfd = NULL;
+	spin_unlock_irqrestore(&(vsync_ctrl->spin_lock), flags);
+
+	if (ctx)
+		eventfd_ctx_put(ctx);
+	if (page)
+		free_page((unsigned long)page);
+
 	vsync_ctrl->vsync_created = 0;
 }
 
@@ -2787,18 +2787,62 @@ error:
 	return ret;
 }
 
+/*
+** standard DCS set_column_address / set_page_address, used for command panels
+** whose driver has no set_display_region of its own.
+*/
+static int mipi_dsi_set_display_window(struct hisi_fb_data_type *hisifd, struct dss_rect *dirty)
+{
+	char caset[] = {0x2A, 0x00, 0x00, 0x00, 0x00};
+	char paset[] = {0x2B, 0x00, 0x00, 0x00, 0x00};
+	struct dsi_cmd_desc window_cmds[] = {
+		{DTYPE_DCS_LWRITE, 0, 5, WAIT_TYPE_US,
+			sizeof(caset), caset},
+		{DTYPE_DCS_LWRITE, 0, 5, WAIT_TYPE_US,
+			sizeof(paset), paset},
+	};
+
+	if ((dirty->w <= 0) || (dirty->h <= 0))
+		return -EINVAL;
+
+	caset[1] = (dirty->x >> 8) & 0xff;
+	caset[2] = dirty->x & 0xff;
+	caset[3] = ((dirty->x + dirty->w - 1) >> 8) & 0xff;
+	caset[4] = (dirty->x + dirty->w - 1) & 0xff;
+	paset[1] = (dirty->y >> 8) & 0xff;
+	paset[2] = dirty->y & 0xff;
+	paset[3] = ((dirty->y + dirty->h - 1) >> 8) & 0xff;
+	paset[4] = (dirty->y + dirty->h - 1) & 0xff;
+
+	mipi_dsi_cmds_tx(window_cmds, ARRAY_SIZE(window_cmds), hisifd->mipi_dsi0_base);
+
+	return 0;
+}
+
 static int mipi_dsi_set_display_region(struct platform_device *pdev, struct dss_rect *dirty)
 {
 	int ret = 0;
 	struct hisi_fb_data_type *hisifd = NULL;
+	struct hisi_fb_panel_data *pdata = NULL;
+	struct hisi_fb_panel_data *next_pdata = NULL;
 
 	BUG_ON(pdev == NULL || dirty == NULL);
 	hisifd = platform_get_drvdata(pdev);
 	BUG_ON(hisifd == NULL);
+	pdata = dev_get_platdata(&pdev->dev);
+	BUG_ON(pdata == NULL);
 
 	HISI_FB_DEBUG("index=%d, enter!\n", hisifd->index);
 
-	ret = panel_next_set_display_region(pdev, dirty);
+	if (pdata->next)
+		next_pdata = dev_get_platdata(&pdata->next->dev);
+
+	if ((next_pdata && next_pdata->set_display_region) ||
+		!is_mipi_cmd_panel(hisifd) || is_dual_mipi_panel(hisifd)) {
+		ret = panel_next_set_display_region(pdev, dirty);
+	} else {
+		ret = mipi_dsi_set_display_window(hisifd, dirty);
+	}
 
 	HISI_FB_DEBUG("index=%d, exit!\n", hisifd->index);
 
@@ -4003,6 +4047,7 @@ static int mipi_dsi_probe(struct platform_device *pdev)
 		HISI_FB_ERR("fb%d platform_device_add failed, error=%d!\n", hisifd->index, ret);
 		goto err_device_put;
 	}
+	hisi_fb_device_pm_link(dpp_dev, pdev);
 
 	HISI_FB_DEBUG("fb%d, -.\n", hisifd->index);
 
@@ -206,9 +206,56 @@ void hisi_cmdlist_set_reg(struct hisi_fb_data_type *hisifd, char __iomem *addr,
 	node->list_header->total_items.bits.count = node->item_index + 1;
 }
 
+/*
+** bytes of a node written since it was taken from the pool:
+** the header, plus items[0..item_index] for frame nodes.
+** everything beyond stays zero, hisi_cmdlist_del_all_node only
+** clears the same range.
+*/
+static size_t hisi_cmdlist_node_header_dirty_len(dss_cmdlist_node_t *node)
+{
+	return sizeof(cmd_header_t);
+}
+
+static size_t hisi_cmdlist_node_item_dirty_len(dss_cmdlist_node_t *node)
+{
+	if (node->node_type != CMDLIST_NODE_FRAME)
+		return 0;
+
+	return (node->item_index + 1) * sizeof(cmd_item_t);
+}
+
+#if defined (CONFIG_HISI_FB_3650) || defined (CONFIG_HISI_FB_6250)
+static void hisi_cmdlist_sync_ion_range(struct hisi_fb_data_type *hisifd,
+	struct ion_handle *handle, size_t len)
+{
+	struct sg_table *table = NULL;
+	struct scatterlist *sg = NULL;
+	size_t sync_len = 0;
+	int i = 0;
+
+	if (!hisifd->ion_client || !handle || (len == 0))
+		return ;
+
+	table = ion_sg_table(hisifd->ion_client, handle);
+	if (!table || !table->sgl || !table->nents)
+		return ;
+
+	for_each_sg(table->sgl, sg, table->nents, i) {
+		sync_len = min_t(size_t, len, sg->length);
+		dma_sync_single_for_device(NULL, sg_phys(sg), sync_len, DMA_TO_DEVICE);
+		len -= sync_len;
+		if (len == 0)
+			break;
+	}
+}
+#endif
+
 /*
 ** flush cache for cmdlist, make sure that
-** cmdlist has writen through to memory before config register
+** cmdlist has writen through to memory before config register.
+** only the dirty range of each node is flushed, see
+** hisi_cmdlist_node_item_dirty_len.
 */
 void hisi_cmdlist_flush_cache(struct hisi_fb_data_type *hisifd, uint32_t cmdlist_idxs)
 {
@@ -216,9 +263,7 @@ void hisi_cmdlist_flush_cache(struct hisi_fb_data_type *hisifd, uint32_t cmdlist
 	uint32_t cmdlist_idxs_temp = 0;
 	dss_cmdlist_node_t *node = NULL;
 	dss_cmdlist_node_t *_node_ = NULL;
-#if defined (CONFIG_HISI_FB_3650) || defined (CONFIG_HISI_FB_6250)
-	struct sg_table *table = NULL;
-#endif
+	size_t item_len = 0;
 	struct list_head *cmdlist_heads = NULL;
 
 	if (!hisifd) {
@@ -237,26 +282,23 @@ void hisi_cmdlist_flush_cache(struct hisi_fb_data_type *hisifd, uint32_t cmdlist
 			}
 
 			list_for_each_entry_safe_reverse(node, _node_, cmdlist_heads, list_node) {
+				if (!node)
+					continue;
+
+				item_len = hisi_cmdlist_node_item_dirty_len(node);
 			#if defined (CONFIG_HISI_FB_3650) || defined (CONFIG_HISI_FB_6250)
 				/* flush cache for header */
-				if (hisifd->ion_client && node && node->header_ion_handle) {
-					table = ion_sg_table(hisifd->ion_client, node->header_ion_handle);
-					if (table && table->sgl && table->nents)
-						dma_sync_sg_for_device(NULL, table->sgl, table->nents, DMA_TO_DEVICE);
-				}
+				hisi_cmdlist_sync_ion_range(hisifd, node->header_ion_handle,
+					hisi_cmdlist_node_header_dirty_len(node));
 
 				/* flush cache for item */
-				if (hisifd->ion_client && node && node->item_ion_handle) {
-					table = ion_sg_table(hisifd->ion_client, node->item_ion_handle);
-					if (table && table->sgl && table->nents)
-						dma_sync_sg_for_device(NULL, table->sgl, table->nents, DMA_TO_DEVICE);
-				}
+				hisi_cmdlist_sync_ion_range(hisifd, node->item_ion_handle, item_len);
 			#else
-				if (node) {
-					dma_sync_single_for_device(NULL, node->header_phys,
-						node->header_len, DMA_TO_DEVICE);
+				dma_sync_single_for_device(NULL, node->header_phys,
+					hisi_cmdlist_node_header_dirty_len(node), DMA_TO_DEVICE);
+				if (item_len > 0) {
 					dma_sync_single_for_device(NULL, node->item_phys,
-						node->item_len, DMA_TO_DEVICE);
+						item_len, DMA_TO_DEVICE);
 				}
 
 				/* __dma_map_area(node->list_header, node->header_len, DMA_BIDIRECTIONAL); */
@@ -629,8 +671,10 @@ int hisi_cmdlist_del_all_node(struct list_head *cmdlist_heads)
 		if (node->reserved != 0x1) {
 			list_del(&node->list_node);
 
-			memset(node->list_header, 0, CMDLIST_HEADER_LEN);
-			memset(node->list_item, 0, CMDLIST_ITEM_LEN);
+			/* the rest of the buffers was never written, see hisi_cmdlist_node_item_dirty_len */
+			memset(node->list_header, 0, hisi_cmdlist_node_header_dirty_len(node));
+			if (node->node_type == CMDLIST_NODE_FRAME)
+				memset(node->list_item, 0, hisi_cmdlist_node_item_dirty_len(node));
 
 			node->item_index = 0;
 			node->item_flag = 0;
@@ -1105,6 +1149,8 @@ void hisi_cmdlist_config_reset(struct hisi_fb_data_type *hisifd,
 
 	HISI_FB_DEBUG("fb%d, +.\n", hisifd->index);
 
+	hisi_dss_module_prog_invalidate(hisifd, ~0U);
+
 	dss_base = hisifd->dss_base;
 	cmdlist_base = dss_base + DSS_CMDLIST_OFFSET;
 	ovl_idx = pov_req->ovl_idx;
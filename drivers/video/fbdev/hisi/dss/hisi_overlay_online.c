@@ -14,11 +14,16 @@
 #include "hisi_overlay_utils.h"
 #include "hisi_dpe_utils.h"
 
+/*
+ * A NULL @pov_h_block_infos allocates room for just the blocks of this
+ * request; the caller frees it through pov_req->ov_block_infos_ptr.
+ */
 static int hisi_get_ov_data_from_user(struct hisi_fb_data_type *hisifd,
-	dss_overlay_t *pov_req, void __user *argp)
+	dss_overlay_t *pov_req, dss_overlay_block_t *pov_h_block_infos,
+	void __user *argp)
 {
 	int ret = 0;
-	dss_overlay_block_t *pov_h_block_infos = NULL;
+	bool alloced = false;
 
 	BUG_ON(hisifd == NULL);
 	BUG_ON(pov_req == NULL);
@@ -28,8 +33,6 @@ static int hisi_get_ov_data_from_user(struct hisi_fb_data_type *hisifd,
 		return -EINVAL;
 	}
 
-	pov_h_block_infos = hisifd->ov_block_infos;
-
 	ret = copy_from_user(pov_req, argp, sizeof(dss_overlay_t));
 	if (ret) {
 		HISI_FB_ERR("fb%d, copy_from_user failed!\n", hisifd->index);
@@ -43,23 +46,40 @@ static int hisi_get_ov_data_from_user(struct hisi_fb_data_type *hisifd,
 		return -EINVAL;
 	}
 
+	if (pov_h_block_infos == NULL) {
+		pov_h_block_infos = kcalloc(pov_req->ov_block_nums,
+			sizeof(dss_overlay_block_t), GFP_KERNEL);
+		if (pov_h_block_infos == NULL) {
+			HISI_FB_ERR("fb%d, failed to alloc ov_block_infos!\n", hisifd->index);
+			return -ENOMEM;
+		}
+		alloced = true;
+	}
+
 	ret = copy_from_user(pov_h_block_infos, (dss_overlay_block_t *)pov_req->ov_block_infos_ptr,
 		pov_req->ov_block_nums * sizeof(dss_overlay_block_t));
 	if (ret) {
 		HISI_FB_ERR("fb%d, dss_overlay_block_t copy_from_user failed!\n",
 			hisifd->index);
-		return -EINVAL;
+		ret = -EINVAL;
+		goto err_free;
 	}
 
 	ret = hisi_dss_check_userdata(hisifd, pov_req, pov_h_block_infos);
 	if (ret != 0) {
 		HISI_FB_ERR("fb%d, hisi_dss_check_userdata failed!\n", hisifd->index);
-		return -EINVAL;
+		ret = -EINVAL;
+		goto err_free;
 	}
 
 	pov_req->ov_block_infos_ptr = (uint64_t)pov_h_block_infos;
 
 	return ret;
+
+err_free:
+	if (alloced)
+		kfree(pov_h_block_infos);
+	return ret;
 }
 
 int hisi_overlay_pan_display(struct hisi_fb_data_type *hisifd)
@@ -323,6 +343,7 @@ int hisi_overlay_pan_display(struct hisi_fb_data_type *hisifd)
 	return 0;
 
 err_return:
+	hisi_dss_module_prog_invalidate(hisifd, ~0U);
 	if (is_mipi_cmd_panel(hisifd)) {
 		hisifd->vactive0_start_flag = 1;
 	} else {
@@ -333,9 +354,18 @@ err_return:
 	return ret;
 }
 
-int hisi_ov_online_play(struct hisi_fb_data_type *hisifd, void __user *argp)
+static int dss_free_buffer_refcount;
+
+/*
+ * Program the request in hisifd->ov_req. The caller holds blank_sem and has
+ * activated vsync. For @async the layer buffers are already in @plock_list,
+ * every acquire fence has signalled and the release fence was handed to user
+ * space when the frame was queued; otherwise @argp gets the release fence.
+ */
+static int hisi_ov_online_commit(struct hisi_fb_data_type *hisifd,
+	struct list_head *plock_list, int enable_cmdlist, bool async,
+	void __user *argp)
 {
-	static int dss_free_buffer_refcount = 0;
 	dss_overlay_t *pov_req = NULL;
 	dss_overlay_t *pov_req_prev = NULL;
 	dss_overlay_block_t *pov_h_block_infos = NULL;
@@ -346,7 +376,6 @@ int hisi_ov_online_play(struct hisi_fb_data_type *hisifd, void __user *argp)
 	bool rdma_stretch_enable = false;
 	uint32_t cmdlist_pre_idxs = 0;
 	uint32_t cmdlist_idxs = 0;
-	int enable_cmdlist = 0;
 	bool has_base = false;
 #ifdef CONFIG_BUF_SYNC_USED
 	unsigned long flags = 0;
@@ -356,76 +385,16 @@ int hisi_ov_online_play(struct hisi_fb_data_type *hisifd, void __user *argp)
 	int m = 0;
 	int ret = 0;
 	uint32_t timediff = 0;
-	struct list_head lock_list;
-	struct timeval tv0;
-	struct timeval tv1;
 	struct timeval tv2;
 	struct timeval tv3;
 
-	if (NULL == hisifd) {
-		HISI_FB_ERR("NULL Pointer!\n");
-		return -EINVAL;
-	}
-
-	if (NULL == argp) {
-		HISI_FB_ERR("NULL Pointer!\n");
-		return -EINVAL;
-	}
-
 	pov_req = &(hisifd->ov_req);
 	pov_req_prev = &(hisifd->ov_req_prev);
-	INIT_LIST_HEAD(&lock_list);
-
-	if (!hisifd->panel_power_on) {
-		HISI_FB_INFO("fb%d, panel is power off!\n", hisifd->index);
-		return 0;
-	}
-
-	if (g_debug_ldi_underflow) {
-		if (g_err_status & (DSS_PDP_LDI_UNDERFLOW | DSS_SDP_LDI_UNDERFLOW)) {
-			dss_underflow_stop_perf_state_online(hisifd);
-			mdelay(HISI_DSS_COMPOSER_HOLD_TIME);
-			return 0;
-		}
-	}
-
-	if (g_debug_ovl_online_composer_return) {
-		return 0;
-	}
-
-	if (g_debug_ovl_online_composer_timediff & 0x2) {
-		hisifb_get_timestamp(&tv0);
-	}
-
-	enable_cmdlist = g_enable_ovl_cmdlist_online;
-	if ((hisifd->index == EXTERNAL_PANEL_IDX) && hisifd->panel_info.fake_hdmi) {
-		enable_cmdlist = 0;
-	}
-
-	hisifb_activate_vsync(hisifd);
 
 	if (g_debug_ovl_online_composer_timediff & 0x4) {
 		hisifb_get_timestamp(&tv2);
 	}
 
-	ret = hisi_get_ov_data_from_user(hisifd, pov_req, argp);
-	if (ret != 0) {
-		HISI_FB_ERR("fb%d, hisi_get_ov_data_from_user failed! ret=%d\n", hisifd->index, ret);
-		need_skip = 1;
-		goto err_return;
-	}
-
-#ifdef CONFIG_BUF_SYNC_USED
-	if (is_mipi_video_panel(hisifd)) {
-		ret = hisifb_buf_sync_handle(hisifd, pov_req);
-		if (ret < 0) {
-			HISI_FB_ERR("fb%d, hisifb_buf_sync_handle failed! ret=%d\n", hisifd->index, ret);
-			need_skip = 1;
-			goto err_return;
-		}
-	}
-#endif
-
 	ret = hisi_vactive0_start_config(hisifd, pov_req);
 	if (ret != 0) {
 		HISI_FB_ERR("fb%d, hisi_vactive0_start_config failed! ret=%d\n", hisifd->index, ret);
@@ -446,10 +415,12 @@ int hisi_ov_online_play(struct hisi_fb_data_type *hisifd, void __user *argp)
 		dumpDssOverlay(hisifd, pov_req, false);
 	}
 
-	ret = hisifb_layerbuf_lock(hisifd, pov_req, &lock_list);
-	if (ret != 0) {
-		HISI_FB_ERR("fb%d, hisifb_layerbuf_lock failed! ret=%d\n", hisifd->index, ret);
-		goto err_return;
+	if (!async) {
+		ret = hisifb_layerbuf_lock(hisifd, pov_req, plock_list);
+		if (ret != 0) {
+			HISI_FB_ERR("fb%d, hisifb_layerbuf_lock failed! ret=%d\n", hisifd->index, ret);
+			goto err_return;
+		}
 	}
 
 	hisi_dss_handle_cur_ovl_req(hisifd, pov_req);
@@ -584,17 +555,19 @@ int hisi_ov_online_play(struct hisi_fb_data_type *hisifd, void __user *argp)
 	}
 
 #ifdef CONFIG_BUF_SYNC_USED
-	if (is_mipi_cmd_panel(hisifd)) {
-		ret = hisifb_buf_sync_handle(hisifd, pov_req);
-		if (ret < 0) {
-			HISI_FB_ERR("fb%d, hisifb_buf_sync_handle failed! ret=%d\n", hisifd->index, ret);
-			goto err_return;
+	if (!async) {
+		if (is_mipi_cmd_panel(hisifd)) {
+			ret = hisifb_buf_sync_handle(hisifd, pov_req);
+			if (ret < 0) {
+				HISI_FB_ERR("fb%d, hisifb_buf_sync_handle failed! ret=%d\n", hisifd->index, ret);
+				goto err_return;
+			}
 		}
-	}
 
-	pov_req->release_fence = hisifb_buf_sync_create_fence(hisifd, ++hisifd->buf_sync_ctrl.timeline_max);
-	if (pov_req->release_fence < 0) {
-		HISI_FB_INFO("fb%d, hisi_create_fence failed! pov_req->release_fence = 0x%x\n", hisifd->index, pov_req->release_fence);
+		pov_req->release_fence = hisifb_buf_sync_create_fence(hisifd, ++hisifd->buf_sync_ctrl.timeline_max);
+		if (pov_req->release_fence < 0) {
+			HISI_FB_INFO("fb%d, hisi_create_fence failed! pov_req->release_fence = 0x%x\n", hisifd->index, pov_req->release_fence);
+		}
 	}
 
 	spin_lock_irqsave(&hisifd->buf_sync_ctrl.refresh_lock, flags);
@@ -619,7 +592,7 @@ int hisi_ov_online_play(struct hisi_fb_data_type *hisifd, void __user *argp)
 	hisifb_frame_updated(hisifd);
 	hisi_crc_config(hisifd, pov_req);
 
-	if (copy_to_user((struct dss_overlay_t __user *)argp,
+	if (!async && copy_to_user((struct dss_overlay_t __user *)argp,
 			pov_req, sizeof(dss_overlay_t))) {
 		ret = -EFAULT;
 
@@ -629,9 +602,7 @@ int hisi_ov_online_play(struct hisi_fb_data_type *hisifd, void __user *argp)
 		goto err_return;
 	}
 
-	hisifb_deactivate_vsync(hisifd);
-
-	hisifb_layerbuf_flush(hisifd, &lock_list);
+	hisifb_layerbuf_flush(hisifd, plock_list);
 
 	if ((hisifd->index == PRIMARY_PANEL_IDX) && (dss_free_buffer_refcount > 1)) {
 		if (!hisifd->fb_mem_free_flag) {
@@ -664,15 +635,100 @@ int hisi_ov_online_play(struct hisi_fb_data_type *hisifd, void __user *argp)
 		pov_req->ov_block_nums * sizeof(dss_overlay_block_t));
 	hisifd->ov_req_prev.ov_block_infos_ptr = (uint64_t)(&(hisifd->ov_block_infos_prev));
 
+	up(&hisifd->blank_sem0);
+
+	return 0;
+
+err_return:
+	hisi_dss_module_prog_invalidate(hisifd, ~0U);
+	if (is_mipi_cmd_panel(hisifd)) {
+		hisifd->vactive0_start_flag = 1;
+	}
+	hisifb_layerbuf_lock_exception(hisifd, plock_list);
+	if (!need_skip) {
+		up(&hisifd->blank_sem0);
+	}
+	return ret;
+}
+
+int hisi_ov_online_play(struct hisi_fb_data_type *hisifd, void __user *argp)
+{
+	dss_overlay_t *pov_req = NULL;
+	int enable_cmdlist = 0;
+	int ret = 0;
+	uint32_t timediff = 0;
+	struct list_head lock_list;
+	struct timeval tv0;
+	struct timeval tv1;
+
+	if (NULL == hisifd) {
+		HISI_FB_ERR("NULL Pointer!\n");
+		return -EINVAL;
+	}
+
+	if (NULL == argp) {
+		HISI_FB_ERR("NULL Pointer!\n");
+		return -EINVAL;
+	}
+
+	pov_req = &(hisifd->ov_req);
+	INIT_LIST_HEAD(&lock_list);
+
+	if (!hisifd->panel_power_on) {
+		HISI_FB_INFO("fb%d, panel is power off!\n", hisifd->index);
+		return 0;
+	}
+
+	if (g_debug_ldi_underflow) {
+		if (g_err_status & (DSS_PDP_LDI_UNDERFLOW | DSS_SDP_LDI_UNDERFLOW)) {
+			dss_underflow_stop_perf_state_online(hisifd);
+			mdelay(HISI_DSS_COMPOSER_HOLD_TIME);
+			return 0;
+		}
+	}
+
+	if (g_debug_ovl_online_composer_return) {
+		return 0;
+	}
+
 	if (g_debug_ovl_online_composer_timediff & 0x2) {
+		hisifb_get_timestamp(&tv0);
+	}
+
+	enable_cmdlist = g_enable_ovl_cmdlist_online;
+	if ((hisifd->index == EXTERNAL_PANEL_IDX) && hisifd->panel_info.fake_hdmi) {
+		enable_cmdlist = 0;
+	}
+
+	hisifb_activate_vsync(hisifd);
+
+	ret = hisi_get_ov_data_from_user(hisifd, pov_req, hisifd->ov_block_infos, argp);
+	if (ret != 0) {
+		HISI_FB_ERR("fb%d, hisi_get_ov_data_from_user failed! ret=%d\n", hisifd->index, ret);
+		goto err_return;
+	}
+
+#ifdef CONFIG_BUF_SYNC_USED
+	if (is_mipi_video_panel(hisifd)) {
+		ret = hisifb_buf_sync_handle(hisifd, pov_req);
+		if (ret < 0) {
+			HISI_FB_ERR("fb%d, hisifb_buf_sync_handle failed! ret=%d\n", hisifd->index, ret);
+			goto err_return;
+		}
+	}
+#endif
+
+	ret = hisi_ov_online_commit(hisifd, &lock_list, enable_cmdlist, false, argp);
+	hisifb_deactivate_vsync(hisifd);
+
+	if ((ret == 0) && (g_debug_ovl_online_composer_timediff & 0x2)) {
 		hisifb_get_timestamp(&tv1);
 		timediff = hisifb_timestamp_diff(&tv0, &tv1);
 		if (timediff >= g_debug_ovl_online_composer_time_threshold)
 			HISI_FB_ERR("ONLINE_TIMEDIFF is %u us!\n", timediff);
 	}
-	up(&hisifd->blank_sem0);
 
-	return 0;
+	return ret;
 
 err_return:
 	if (is_mipi_cmd_panel(hisifd)) {
@@ -680,8 +736,391 @@ err_return:
 	}
 	hisifb_layerbuf_lock_exception(hisifd, &lock_list);
 	hisifb_deactivate_vsync(hisifd);
-	if (!need_skip) {
-		up(&hisifd->blank_sem0);
+	return ret;
+}
+
+#ifdef CONFIG_BUF_SYNC_USED
+/*
+ * Async online play: the ioctl only queues the frame and returns its release
+ * fence, which signals on the vsync that puts the frame on screen. Frames are
+ * programmed in order from hisifd->async_commit_wq once all their acquire
+ * fences have signalled, so the compositor never sleeps on the GPU here.
+ */
+#define HISI_OV_ASYNC_COMMIT_MAX		(2)
+#define HISI_OV_ASYNC_FENCE_TIMEOUT_MSEC	(10 * MSEC_PER_SEC)
+
+struct hisi_ov_async_commit;
+
+struct hisi_ov_async_fence {
+	struct sync_fence_waiter waiter;
+	struct sync_fence *fence;
+	struct hisi_ov_async_commit *commit;
+};
+
+struct hisi_ov_async_commit {
+	struct list_head node;
+	struct hisi_fb_data_type *hisifd;
+	dss_overlay_t ov_req;
+	struct list_head lock_list;
+	int enable_cmdlist;
+	unsigned long deadline;
+	/* acquire fences not signalled yet, plus one while arming */
+	atomic_t pending;
+	int fence_nums;
+	struct hisi_ov_async_fence fences[0];
+};
+
+static void hisi_ov_async_fence_signalled(struct sync_fence *fence,
+	struct sync_fence_waiter *waiter)
+{
+	struct hisi_ov_async_fence *async_fence =
+		container_of(waiter, struct hisi_ov_async_fence, waiter);
+	struct hisi_ov_async_commit *commit = async_fence->commit;
+	struct hisi_fb_data_type *hisifd = commit->hisifd;
+
+	if (atomic_dec_and_test(&commit->pending))
+		mod_delayed_work(hisifd->async_commit_wq, &hisifd->async_commit_work, 0);
+}
+
+static int hisi_ov_async_count_fences(dss_overlay_t *pov_req)
+{
+	dss_overlay_block_t *pov_h_block_infos = NULL;
+	dss_overlay_block_t *pov_h_block = NULL;
+	dss_layer_t *layer = NULL;
+	int count = 0;
+	int i = 0;
+	int m = 0;
+
+	pov_h_block_infos = (dss_overlay_block_t *)(pov_req->ov_block_infos_ptr);
+	for (m = 0; m < pov_req->ov_block_nums; m++) {
+		pov_h_block = &(pov_h_block_infos[m]);
+
+		for (i = 0; i < pov_h_block->layer_nums; i++) {
+			layer = &(pov_h_block->layer_infos[i]);
+
+			if (layer->dst_rect.y < pov_h_block->ov_block_rect.y)
+				continue;
+
+			if (layer->acquire_fence >= 0)
+				count++;
+		}
+	}
+
+	return count;
+}
+
+/* Must run in the context of the process that owns the fence fds */
+static void hisi_ov_async_arm_fences(struct hisi_fb_data_type *hisifd,
+	struct hisi_ov_async_commit *commit)
+{
+	dss_overlay_t *pov_req = &(commit->ov_req);
+	dss_overlay_block_t *pov_h_block_infos = NULL;
+	dss_overlay_block_t *pov_h_block = NULL;
+	dss_layer_t *layer = NULL;
+	struct hisi_ov_async_fence *async_fence = NULL;
+	int i = 0;
+	int m = 0;
+
+	pov_h_block_infos = (dss_overlay_block_t *)(pov_req->ov_block_infos_ptr);
+	for (m = 0; m < pov_req->ov_block_nums; m++) {
+		pov_h_block = &(pov_h_block_infos[m]);
+
+		for (i = 0; i < pov_h_block->layer_nums; i++) {
+			layer = &(pov_h_block->layer_infos[i]);
+
+			if (layer->dst_rect.y < pov_h_block->ov_block_rect.y)
+				continue;
+
+			if (layer->acquire_fence < 0)
+				continue;
+
+			async_fence = &(commit->fences[commit->fence_nums]);
+			async_fence->fence = sync_fence_fdget(layer->acquire_fence);
+			if (async_fence->fence == NULL) {
+				HISI_FB_ERR("fb%d, fence_fd=%d, sync_fence_fdget failed!\n",
+					hisifd->index, layer->acquire_fence);
+				continue;
+			}
+			async_fence->commit = commit;
+			commit->fence_nums++;
+
+			sync_fence_waiter_init(&async_fence->waiter, hisi_ov_async_fence_signalled);
+			atomic_inc(&commit->pending);
+			/* 1: signalled already, < 0: error, both mean don't wait */
+			if (sync_fence_wait_async(async_fence->fence, &async_fence->waiter) != 0)
+				atomic_dec(&commit->pending);
+		}
+	}
+}
+
+static void hisi_ov_async_put_fences(struct hisi_ov_async_commit *commit)
+{
+	int i = 0;
+
+	for (i = 0; i < commit->fence_nums; i++) {
+		sync_fence_cancel_async(commit->fences[i].fence, &commit->fences[i].waiter);
+		sync_fence_put(commit->fences[i].fence);
+	}
+	commit->fence_nums = 0;
+}
+
+static void hisi_ov_async_commit_free(struct hisi_ov_async_commit *commit)
+{
+	kfree((void *)commit->ov_req.ov_block_infos_ptr);
+	kfree(commit);
+}
+
+/* The frame will not be shown, but its release fence must still signal */
+static void hisi_ov_async_commit_drop(struct hisi_fb_data_type *hisifd)
+{
+	unsigned long flags = 0;
+
+	spin_lock_irqsave(&hisifd->buf_sync_ctrl.refresh_lock, flags);
+	if (hisifd->panel_power_on) {
+		hisifd->buf_sync_ctrl.refresh++;
+	} else {
+		/* no vsync is coming to do it */
+		sw_sync_timeline_inc(hisifd->buf_sync_ctrl.timeline, hisifd->buf_sync_ctrl.refresh + 1);
+		hisifd->buf_sync_ctrl.refresh = 0;
+	}
+	spin_unlock_irqrestore(&hisifd->buf_sync_ctrl.refresh_lock, flags);
+}
+
+static void hisi_ov_async_commit_play(struct hisi_fb_data_type *hisifd,
+	struct hisi_ov_async_commit *commit)
+{
+	dss_overlay_t *pov_req = &(hisifd->ov_req);
+	int ret = 0;
+
+	down(&hisifd->blank_sem);
+
+	if (!hisifd->panel_power_on) {
+		HISI_FB_INFO("fb%d, panel is power off, drop frame_no=%d!\n",
+			hisifd->index, commit->ov_req.frame_no);
+		hisifb_layerbuf_unlock(hisifd, &commit->lock_list);
+		hisi_ov_async_commit_drop(hisifd);
+		up(&hisifd->blank_sem);
+		return;
+	}
+
+	memcpy(pov_req, &commit->ov_req, sizeof(dss_overlay_t));
+	memcpy(hisifd->ov_block_infos, (void *)commit->ov_req.ov_block_infos_ptr,
+		pov_req->ov_block_nums * sizeof(dss_overlay_block_t));
+	pov_req->ov_block_infos_ptr = (uint64_t)(hisifd->ov_block_infos);
+
+	hisifb_activate_vsync(hisifd);
+	ret = hisi_ov_online_commit(hisifd, &commit->lock_list, commit->enable_cmdlist, true, NULL);
+	hisifb_deactivate_vsync(hisifd);
+	if (ret != 0) {
+		HISI_FB_ERR("fb%d, async commit frame_no=%d failed! ret=%d\n",
+			hisifd->index, commit->ov_req.frame_no, ret);
+		hisi_ov_async_commit_drop(hisifd);
+	} else {
+		if (hisifd->bl_update) {
+			hisifd->bl_update(hisifd);
+		}
+#if defined (CONFIG_HISI_FB_3660) || defined(CONFIG_HISI_FB_970)
+		hisifb_display_effect_blc_cabc_update(hisifd);
+#endif
 	}
+
+	up(&hisifd->blank_sem);
+}
+
+static void hisi_ov_async_commit_work(struct work_struct *work)
+{
+	struct hisi_fb_data_type *hisifd = NULL;
+	struct hisi_ov_async_commit *commit = NULL;
+	unsigned long flags = 0;
+
+	hisifd = container_of(to_delayed_work(work), struct hisi_fb_data_type, async_commit_work);
+	BUG_ON(hisifd == NULL);
+
+	for (;;) {
+		spin_lock_irqsave(&hisifd->async_commit_lock, flags);
+		commit = list_first_entry_or_null(&hisifd->async_commit_list,
+			struct hisi_ov_async_commit, node);
+		spin_unlock_irqrestore(&hisifd->async_commit_lock, flags);
+		if (commit == NULL)
+			break;
+
+		if (atomic_read(&commit->pending) > 0) {
+			if (time_before(jiffies, commit->deadline)) {
+				queue_delayed_work(hisifd->async_commit_wq, &hisifd->async_commit_work,
+					commit->deadline - jiffies);
+				break;
+			}
+			HISI_FB_ERR("fb%d, frame_no=%d, waiting on acquire fences timed out!\n",
+				hisifd->index, commit->ov_req.frame_no);
+		}
+
+		hisi_ov_async_put_fences(commit);
+		hisi_ov_async_commit_play(hisifd, commit);
+
+		spin_lock_irqsave(&hisifd->async_commit_lock, flags);
+		list_del(&commit->node);
+		hisifd->async_commit_count--;
+		spin_unlock_irqrestore(&hisifd->async_commit_lock, flags);
+		wake_up_interruptible_all(&hisifd->async_commit_wait);
+
+		hisi_ov_async_commit_free(commit);
+	}
+}
+
+int hisi_ov_online_play_async(struct hisi_fb_data_type *hisifd, void __user *argp)
+{
+	struct hisi_ov_async_commit *commit = NULL;
+	dss_overlay_t ov_req;
+	unsigned long flags = 0;
+	int fence_nums = 0;
+	int ret = 0;
+
+	if (NULL == hisifd) {
+		HISI_FB_ERR("NULL Pointer!\n");
+		return -EINVAL;
+	}
+
+	if (NULL == argp) {
+		HISI_FB_ERR("NULL Pointer!\n");
+		return -EINVAL;
+	}
+
+	/* Throttle the compositor to HISI_OV_ASYNC_COMMIT_MAX frames ahead */
+	ret = wait_event_interruptible_timeout(hisifd->async_commit_wait,
+		ACCESS_ONCE(hisifd->async_commit_count) < HISI_OV_ASYNC_COMMIT_MAX,
+		msecs_to_jiffies(HISI_OV_ASYNC_FENCE_TIMEOUT_MSEC));
+	if (ret < 0)
+		return ret;
+	if (ret == 0) {
+		HISI_FB_ERR("fb%d, async commit queue is stuck!\n", hisifd->index);
+		return -ETIMEDOUT;
+	}
+
+	down(&hisifd->blank_sem);
+
+	if (!hisifd->panel_power_on) {
+		HISI_FB_INFO("fb%d, panel is power off!\n", hisifd->index);
+		ret = 0;
+		goto err_up;
+	}
+
+	if (g_debug_ovl_online_composer_return) {
+		ret = 0;
+		goto err_up;
+	}
+
+	ret = hisi_get_ov_data_from_user(hisifd, &ov_req, NULL, argp);
+	if (ret != 0) {
+		HISI_FB_ERR("fb%d, hisi_get_ov_data_from_user failed! ret=%d\n", hisifd->index, ret);
+		goto err_up;
+	}
+
+	fence_nums = hisi_ov_async_count_fences(&ov_req);
+	commit = kzalloc(sizeof(*commit) + fence_nums * sizeof(struct hisi_ov_async_fence), GFP_KERNEL);
+	if (commit == NULL) {
+		HISI_FB_ERR("fb%d, failed to alloc async commit!\n", hisifd->index);
+		kfree((void *)ov_req.ov_block_infos_ptr);
+		ret = -ENOMEM;
+		goto err_up;
+	}
+
+	memcpy(&commit->ov_req, &ov_req, sizeof(dss_overlay_t));
+	commit->hisifd = hisifd;
+	INIT_LIST_HEAD(&commit->lock_list);
+	commit->enable_cmdlist = g_enable_ovl_cmdlist_online;
+	if ((hisifd->index == EXTERNAL_PANEL_IDX) && hisifd->panel_info.fake_hdmi) {
+		commit->enable_cmdlist = 0;
+	}
+	commit->deadline = jiffies + msecs_to_jiffies(HISI_OV_ASYNC_FENCE_TIMEOUT_MSEC);
+	atomic_set(&commit->pending, 1);
+
+	/* the shared fds are only valid in this process */
+	ret = hisifb_layerbuf_lock(hisifd, &commit->ov_req, &commit->lock_list);
+	if (ret != 0) {
+		HISI_FB_ERR("fb%d, hisifb_layerbuf_lock failed! ret=%d\n", hisifd->index, ret);
+		hisifb_layerbuf_unlock(hisifd, &commit->lock_list);
+		hisi_ov_async_commit_free(commit);
+		goto err_up;
+	}
+
+	commit->ov_req.release_fence = hisifb_buf_sync_create_fence(hisifd, ++hisifd->buf_sync_ctrl.timeline_max);
+	if (commit->ov_req.release_fence < 0) {
+		HISI_FB_INFO("fb%d, hisi_create_fence failed! release_fence = 0x%x\n",
+			hisifd->index, commit->ov_req.release_fence);
+	}
+
+	spin_lock_irqsave(&hisifd->async_commit_lock, flags);
+	list_add_tail(&commit->node, &hisifd->async_commit_list);
+	hisifd->async_commit_count++;
+	spin_unlock_irqrestore(&hisifd->async_commit_lock, flags);
+
+	/* kept pending for the timeout until the last fence kicks it */
+	queue_delayed_work(hisifd->async_commit_wq, &hisifd->async_commit_work,
+		msecs_to_jiffies(HISI_OV_ASYNC_FENCE_TIMEOUT_MSEC));
+
+	hisi_ov_async_arm_fences(hisifd, commit);
+	if (atomic_dec_and_test(&commit->pending))
+		mod_delayed_work(hisifd->async_commit_wq, &hisifd->async_commit_work, 0);
+
+	ov_req.release_fence = commit->ov_req.release_fence;
+	up(&hisifd->blank_sem);
+
+	/* the frame is queued either way, the fd is closed at process exit */
+	if (copy_to_user(&(((dss_overlay_t __user *)argp)->release_fence),
+			&ov_req.release_fence, sizeof(ov_req.release_fence))) {
+		HISI_FB_ERR("fb%d, copy release fence to user failed!\n", hisifd->index);
+		return -EFAULT;
+	}
+
+	return 0;
+
+err_up:
+	up(&hisifd->blank_sem);
 	return ret;
 }
+
+int hisi_ov_async_commit_init(struct hisi_fb_data_type *hisifd)
+{
+	char wq_name[128] = {0};
+
+	BUG_ON(hisifd == NULL);
+
+	spin_lock_init(&hisifd->async_commit_lock);
+	INIT_LIST_HEAD(&hisifd->async_commit_list);
+	init_waitqueue_head(&hisifd->async_commit_wait);
+	hisifd->async_commit_count = 0;
+	INIT_DELAYED_WORK(&hisifd->async_commit_work, hisi_ov_async_commit_work);
+
+	snprintf(wq_name, 128, "fb%d_async_commit", hisifd->index);
+	hisifd->async_commit_wq = create_singlethread_workqueue(wq_name);
+	if (!hisifd->async_commit_wq) {
+		HISI_FB_ERR("fb%d, create async commit workqueue failed!\n", hisifd->index);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+void hisi_ov_async_commit_deinit(struct hisi_fb_data_type *hisifd)
+{
+	struct hisi_ov_async_commit *commit = NULL;
+	struct hisi_ov_async_commit *_commit_ = NULL;
+
+	BUG_ON(hisifd == NULL);
+
+	if (!hisifd->async_commit_wq)
+		return;
+
+	cancel_delayed_work_sync(&hisifd->async_commit_work);
+	destroy_workqueue(hisifd->async_commit_wq);
+	hisifd->async_commit_wq = NULL;
+
+	list_for_each_entry_safe(commit, _commit_, &hisifd->async_commit_list, node) {
+		list_del(&commit->node);
+		hisi_ov_async_put_fences(commit);
+		hisifb_layerbuf_unlock(hisifd, &commit->lock_list);
+		hisi_ov_async_commit_free(commit);
+	}
+	hisifd->async_commit_count = 0;
+}
+#endif
@@ -4592,6 +4592,7 @@ static void hisi_dss_dpp_acm_gm_set_reg(struct hisi_fb_data_type *hisifd) {
 			}
 		}
 		//config regsiter use default or cinema parameter
+		hisifd->gamma_lut_hw = NULL;
 		for (index = 0; index < pinfo->gamma_lut_table_len / 2; index++) {
 			i = index << 1;
 			outp32(gamma_lut_base + (U_GAMA_R_COEF + index * 4), (local_gamma_lut_table_R[i] | (local_gamma_lut_table_R[i+1] << 16)));
@@ -5778,6 +5779,11 @@ void hisi_dss_dirty_region_updt_config(struct hisi_fb_data_type *hisifd,
 		dirty = pov_req->dirty_rect;
 	}
 
+	if ((dirty.w < hisifd->panel_info.xres) || (dirty.h < hisifd->panel_info.yres))
+		hisifd->dirty_region_partial_count++;
+	else
+		hisifd->dirty_region_full_count++;
+
 	if (hisifd->panel_info.xres >= dirty.w) {
 		h_porch_pading = hisifd->panel_info.xres - dirty.w;
 	}
@@ -6496,6 +6502,112 @@ int hisi_dss_module_init(struct hisi_fb_data_type *hisifd)
 	return 0;
 }
 
+/*
+** hisifd->dss_module_prog holds the channel module registers last emitted
+** to the online cmdlist, its *_used flags mark the entries that still match
+** the hardware. anything that resets or releases a channel, or drops a
+** cmdlist before it ran, must invalidate the channel.
+*/
+void hisi_dss_module_prog_invalidate(struct hisi_fb_data_type *hisifd, uint32_t chn_mask)
+{
+	dss_module_reg_t *prog = NULL;
+	int i = 0;
+
+	BUG_ON(hisifd == NULL);
+
+	prog = &(hisifd->dss_module_prog);
+	for (i = 0; i < DSS_CHN_MAX_DEFINE; i++) {
+		if (!(chn_mask & BIT(i)))
+			continue;
+
+		prog->aif_ch_used[i] = 0;
+		prog->aif1_ch_used[i] = 0;
+		prog->mif_used[i] = 0;
+		prog->dfc_used[i] = 0;
+		prog->scl_used[i] = 0;
+	#if defined(CONFIG_HISI_FB_3650) || defined(CONFIG_HISI_FB_6250)
+		prog->sharp_used[i] = 0;
+		prog->ce_used[i] = 0;
+	#elif defined(CONFIG_HISI_FB_3660) || defined(CONFIG_HISI_FB_970)
+		prog->pcsc_used[i] = 0;
+		prog->arsr2p_used[i] = 0;
+	#endif
+		prog->post_cilp_used[i] = 0;
+		prog->csc_used[i] = 0;
+	}
+}
+
+static bool hisi_dss_module_prog_diff_enable(int32_t mctl_idx, bool enable_cmdlist)
+{
+	if (!g_enable_ovl_cmdlist_diff || !enable_cmdlist)
+		return false;
+
+	/* offline and copybit reset their channels for every request */
+	return (mctl_idx == DSS_MCTL0) || (mctl_idx == DSS_MCTL1);
+}
+
+static bool hisi_dss_module_changed(bool diff, uint8_t prog_used,
+	const void *cur, const void *prog, size_t len)
+{
+	return !diff || !prog_used || (memcmp(cur, prog, len) != 0);
+}
+
+/* modules that were not used this frame keep what the hardware still holds */
+static void hisi_dss_module_prog_save(struct hisi_fb_data_type *hisifd, int chn_idx)
+{
+	dss_module_reg_t *dss_module = &(hisifd->dss_module);
+	dss_module_reg_t *prog = &(hisifd->dss_module_prog);
+	int i = chn_idx;
+
+	if (dss_module->aif_ch_used[i] == 1) {
+		prog->aif[i] = dss_module->aif[i];
+		prog->aif_ch_used[i] = 1;
+	}
+	if (dss_module->aif1_ch_used[i] == 1) {
+		prog->aif1[i] = dss_module->aif1[i];
+		prog->aif1_ch_used[i] = 1;
+	}
+	if (dss_module->mif_used[i] == 1) {
+		prog->mif[i] = dss_module->mif[i];
+		prog->mif_used[i] = 1;
+	}
+	if (dss_module->dfc_used[i] == 1) {
+		prog->dfc[i] = dss_module->dfc[i];
+		prog->dfc_used[i] = 1;
+	}
+	if (dss_module->scl_used[i] == 1) {
+		prog->scl[i] = dss_module->scl[i];
+		prog->scl_used[i] = 1;
+	}
+#if defined(CONFIG_HISI_FB_3650) || defined(CONFIG_HISI_FB_6250)
+	if (dss_module->sharp_used[i]) {
+		prog->sharp[i] = dss_module->sharp[i];
+		prog->sharp_used[i] = 1;
+	}
+	if (dss_module->ce_used[i] == 1) {
+		prog->ce[i] = dss_module->ce[i];
+		prog->ce_used[i] = 1;
+	}
+#elif defined(CONFIG_HISI_FB_3660) || defined(CONFIG_HISI_FB_970)
+	if (dss_module->pcsc_used[i] == 1) {
+		prog->pcsc[i] = dss_module->pcsc[i];
+		prog->pcsc_used[i] = 1;
+	}
+	if (dss_module->arsr2p_used[i] == 1) {
+		prog->arsr2p[i] = dss_module->arsr2p[i];
+		prog->arsr2p_used[i] = 1;
+	}
+#endif
+	if (dss_module->post_cilp_used[i]) {
+		prog->post_clip[i] = dss_module->post_clip[i];
+		prog->post_cilp_used[i] = 1;
+	}
+	if (dss_module->csc_used[i] == 1) {
+		prog->csc[i] = dss_module->csc[i];
+		prog->csc_used[i] = 1;
+	}
+}
+
 int hisi_dss_module_default(struct hisi_fb_data_type *hisifd)
 {
 	dss_module_reg_t *dss_module = NULL;
@@ -6668,6 +6780,8 @@ int hisi_dss_module_default(struct hisi_fb_data_type *hisifd)
 int hisi_dss_ch_module_set_regs(struct hisi_fb_data_type *hisifd, int32_t mctl_idx, int chn_idx, uint32_t wb_type, bool enable_cmdlist)
 {
 	dss_module_reg_t *dss_module = NULL;
+	dss_module_reg_t *prog = NULL;
+	bool diff = false;
 	int i = 0;
 	int ret = 0;
 	uint32_t tmp = 0;
@@ -6676,7 +6790,9 @@ int hisi_dss_ch_module_set_regs(struct hisi_fb_data_type *hisifd, int32_t mctl_i
 	BUG_ON((chn_idx < 0) || (chn_idx >= DSS_CHN_MAX_DEFINE));
 
 	dss_module = &(hisifd->dss_module);
+	prog = &(hisifd->dss_module_prog);
 	i = chn_idx;
+	diff = hisi_dss_module_prog_diff_enable(mctl_idx, enable_cmdlist);
 
 	if (enable_cmdlist) {
 		if (chn_idx == DSS_RCHN_V2) {  //chicago copybit
@@ -6721,52 +6837,79 @@ int hisi_dss_ch_module_set_regs(struct hisi_fb_data_type *hisifd, int32_t mctl_i
 		}
 	}
 
-	if (dss_module->aif_ch_used[i] == 1) {
+	/*
+	** in diff mode a module is only emitted when it differs from what the
+	** previous online frame left in this channel. dma, smmu and mctl carry
+	** the buffer address and flush bits and are always emitted.
+	*/
+	if ((dss_module->aif_ch_used[i] == 1) &&
+		hisi_dss_module_changed(diff, prog->aif_ch_used[i],
+			&(dss_module->aif[i]), &(prog->aif[i]), sizeof(dss_module->aif[i]))) {
 		hisi_dss_aif_ch_set_reg(hisifd, dss_module->aif_ch_base[i], &(dss_module->aif[i]));
 	}
 
-	if (dss_module->aif1_ch_used[i] == 1) {
+	if ((dss_module->aif1_ch_used[i] == 1) &&
+		hisi_dss_module_changed(diff, prog->aif1_ch_used[i],
+			&(dss_module->aif1[i]), &(prog->aif1[i]), sizeof(dss_module->aif1[i]))) {
 		hisi_dss_aif_ch_set_reg(hisifd, dss_module->aif1_ch_base[i], &(dss_module->aif1[i]));
 	}
 
-	if (dss_module->mif_used[i] == 1) {
+	if ((dss_module->mif_used[i] == 1) &&
+		hisi_dss_module_changed(diff, prog->mif_used[i],
+			&(dss_module->mif[i]), &(prog->mif[i]), sizeof(dss_module->mif[i]))) {
 		hisi_dss_mif_set_reg(hisifd, dss_module->mif_ch_base[i], &(dss_module->mif[i]), i);
 	}
 
-	if (dss_module->dfc_used[i] == 1) {
+	if ((dss_module->dfc_used[i] == 1) &&
+		hisi_dss_module_changed(diff, prog->dfc_used[i],
+			&(dss_module->dfc[i]), &(prog->dfc[i]), sizeof(dss_module->dfc[i]))) {
 		hisi_dss_dfc_set_reg(hisifd, dss_module->dfc_base[i], &(dss_module->dfc[i]));
 	}
 
-	if (dss_module->scl_used[i] == 1) {
+	if ((dss_module->scl_used[i] == 1) &&
+		hisi_dss_module_changed(diff, prog->scl_used[i],
+			&(dss_module->scl[i]), &(prog->scl[i]), sizeof(dss_module->scl[i]))) {
 		hisi_dss_chn_scl_load_filter_coef_set_reg(hisifd, false, chn_idx, dss_module->scl[i].fmt);
 		hisi_dss_scl_set_reg(hisifd, dss_module->scl_base[i], &(dss_module->scl[i]));
 	}
 
 #if defined(CONFIG_HISI_FB_3650) || defined(CONFIG_HISI_FB_6250)
-	if (hisifd->dss_module.sharp_used[i]) {
+	if (hisifd->dss_module.sharp_used[i] &&
+		hisi_dss_module_changed(diff, prog->sharp_used[i],
+			&(dss_module->sharp[i]), &(prog->sharp[i]), sizeof(dss_module->sharp[i]))) {
 		hisi_dss_sharpness_set_reg(hisifd, dss_module->sharp_base[i], &(dss_module->sharp[i]), i);
 	}
 #endif
 
-	if (hisifd->dss_module.post_cilp_used[i]) {
+	if (hisifd->dss_module.post_cilp_used[i] &&
+		hisi_dss_module_changed(diff, prog->post_cilp_used[i],
+			&(dss_module->post_clip[i]), &(prog->post_clip[i]), sizeof(dss_module->post_clip[i]))) {
 		hisi_dss_post_clip_set_reg( hisifd, dss_module->post_clip_base[i], &(dss_module->post_clip[i]));
 	}
 
 #if defined(CONFIG_HISI_FB_3650) || defined(CONFIG_HISI_FB_6250)
-	if (hisifd->dss_module.ce_used[i] == 1) {
+	if ((hisifd->dss_module.ce_used[i] == 1) &&
+		hisi_dss_module_changed(diff, prog->ce_used[i],
+			&(dss_module->ce[i]), &(prog->ce[i]), sizeof(dss_module->ce[i]))) {
 		hisi_dss_ce_set_reg( hisifd, dss_module->ce_base[i], &(dss_module->ce[i]));
 	}
 #elif defined(CONFIG_HISI_FB_3660) || defined(CONFIG_HISI_FB_970)
-	if (dss_module->pcsc_used[i] == 1) {
+	if ((dss_module->pcsc_used[i] == 1) &&
+		hisi_dss_module_changed(diff, prog->pcsc_used[i],
+			&(dss_module->pcsc[i]), &(prog->pcsc[i]), sizeof(dss_module->pcsc[i]))) {
 		hisi_dss_csc_set_reg(hisifd, dss_module->pcsc_base[i], &(dss_module->pcsc[i]));
 	}
 
-	if (dss_module->arsr2p_used[i] == 1) {
+	if ((dss_module->arsr2p_used[i] == 1) &&
+		hisi_dss_module_changed(diff, prog->arsr2p_used[i],
+			&(dss_module->arsr2p[i]), &(prog->arsr2p[i]), sizeof(dss_module->arsr2p[i]))) {
 		hisi_dss_arsr2p_set_reg(hisifd, dss_module->arsr2p_base[i], &(dss_module->arsr2p[i]));
 	}
 #endif
 
-	if (dss_module->csc_used[i] == 1) {
+	if ((dss_module->csc_used[i] == 1) &&
+		hisi_dss_module_changed(diff, prog->csc_used[i],
+			&(dss_module->csc[i]), &(prog->csc[i]), sizeof(dss_module->csc[i]))) {
 		hisi_dss_csc_set_reg(hisifd, dss_module->csc_base[i], &(dss_module->csc[i]));
 	}
 
@@ -6775,6 +6918,11 @@ int hisi_dss_ch_module_set_regs(struct hisi_fb_data_type *hisifd, int32_t mctl_i
 			&(dss_module->mctl_ch_base[i]), &(dss_module->mctl_ch[i]), i, true);
 	}
 
+	if (diff)
+		hisi_dss_module_prog_save(hisifd, chn_idx);
+	else
+		hisi_dss_module_prog_invalidate(hisifd, BIT(chn_idx));
+
 	return 0;
 
 err_return:
@@ -6956,6 +7104,7 @@ int hisi_dss_prev_module_set_regs(struct hisi_fb_data_type *hisifd,
 
 			// RCH default
 			hisi_dss_chn_set_reg_default_value(hisifd, dss_module->dma_base[chn_idx]);
+			hisi_dss_module_prog_invalidate(hisifd, BIT(chn_idx));
 
 			// SMMU
 			hisi_dss_smmu_ch_set_reg(hisifd, dss_module->smmu_base, &(dss_module->smmu), chn_idx);
@@ -7011,6 +7160,7 @@ int hisi_dss_prev_module_set_regs(struct hisi_fb_data_type *hisifd,
 
 			// WCH default
 			hisi_dss_chn_set_reg_default_value(hisifd, dss_module->dma_base[chn_idx]);
+			hisi_dss_module_prog_invalidate(hisifd, BIT(chn_idx));
 			// MIF
 			hisi_dss_mif_set_reg(hisifd, dss_module->mif_ch_base[chn_idx], &(dss_module->mif[chn_idx]), chn_idx);
 			// AIF
@@ -7935,6 +8085,7 @@ int hisi_overlay_on(struct hisi_fb_data_type *hisifd, bool fastboot_enable)
 
 	HISI_FB_DEBUG("fb%d, +\n", hisifd->index);
 
+	hisi_dss_module_prog_invalidate(hisifd, ~0U);
 	memset(&(hisifd->sbl), 0, sizeof(dss_sbl_t));
 	hisifd->sbl_enable = 0;
 	hisifd->sbl_lsensor_value = 0;
@@ -8122,6 +8273,7 @@ int hisi_overlay_off(struct hisi_fb_data_type *hisifd)
 	pov_req_prev = &(hisifd->ov_req_prev);
 
 	HISI_FB_DEBUG("fb%d, +\n", hisifd->index);
+	hisi_dss_module_prog_invalidate(hisifd, ~0U);
 	if ((hisifd->index == PRIMARY_PANEL_IDX) ||
 		(hisifd->index == EXTERNAL_PANEL_IDX)) {
 		hisifb_activate_vsync(hisifd);
@@ -8426,6 +8578,16 @@ int hisi_overlay_ioctl_handler(struct hisi_fb_data_type *hisifd,
 			}
 		}
 		break;
+	case HISIFB_OV_ONLINE_PLAY_ASYNC:
+		if (hisifd->ov_online_play_async) {
+			ret = hisifd->ov_online_play_async(hisifd, argp);
+			if (ret != 0) {
+				HISI_FB_ERR("fb%d ov_online_play_async failed!\n", hisifd->index);
+			}
+		} else {
+			ret = -ENOTTY;
+		}
+		break;
 	case HISIFB_OV_OFFLINE_PLAY:
 		if (hisifd->ov_offline_play) {
 			//down(&hisifd->blank_sem);
@@ -8555,6 +8717,15 @@ int hisi_overlay_init(struct hisi_fb_data_type *hisifd)
 #endif
 	}
 
+	hisifd->ov_online_play_async = NULL;
+#ifdef CONFIG_BUF_SYNC_USED
+	hisifd->async_commit_wq = NULL;
+	if ((hisifd->index == PRIMARY_PANEL_IDX) || (hisifd->index == EXTERNAL_PANEL_IDX)) {
+		if (hisi_ov_async_commit_init(hisifd) == 0)
+			hisifd->ov_online_play_async = hisi_ov_online_play_async;
+	}
+#endif
+
 	if (hisifd->index == PRIMARY_PANEL_IDX) {
 		hisifd->set_reg = hisi_cmdlist_set_reg;
 		hisifd->ov_online_play = hisi_ov_online_play;
@@ -8609,6 +8780,10 @@ int hisi_overlay_deinit(struct hisi_fb_data_type *hisifd)
 		hisi_effect_deinit(hisifd);
 	}
 
+#ifdef CONFIG_BUF_SYNC_USED
+	hisi_ov_async_commit_deinit(hisifd);
+#endif
+
 	if (hisifd->rch4_ce_end_wq) {
 		destroy_workqueue(hisifd->rch4_ce_end_wq);
 		hisifd->rch4_ce_end_wq = NULL;
@@ -115,6 +115,11 @@ int hisi_dss_scl_coef_on(struct hisi_fb_data_type *hisifd, bool enable_cmdlist,
 
 int hisi_overlay_pan_display(struct hisi_fb_data_type *hisifd);
 int hisi_ov_online_play(struct hisi_fb_data_type *hisifd, void __user *argp);
+#ifdef CONFIG_BUF_SYNC_USED
+int hisi_ov_online_play_async(struct hisi_fb_data_type *hisifd, void __user *argp);
+int hisi_ov_async_commit_init(struct hisi_fb_data_type *hisifd);
+void hisi_ov_async_commit_deinit(struct hisi_fb_data_type *hisifd);
+#endif
 int hisi_ov_offline_play(struct hisi_fb_data_type *hisifd, void __user *argp);
 int hisi_ov_copybit_play(struct hisi_fb_data_type *hisifd, void __user *argp);
 int hisi_overlay_ioctl_handler(struct hisi_fb_data_type *hisifd,
@@ -202,6 +207,7 @@ int hisi_dss_ce_config(struct hisi_fb_data_type *hisifd, dss_layer_t *layer);
 
 int hisi_dss_module_default(struct hisi_fb_data_type *hisifd);
 int hisi_dss_module_init(struct hisi_fb_data_type *hisifd);
+void hisi_dss_module_prog_invalidate(struct hisi_fb_data_type *hisifd, uint32_t chn_mask);
 int hisi_dss_ch_module_set_regs(struct hisi_fb_data_type *hisifd, int32_t mctl_idx,
 	int chn_idx, uint32_t wb_type, bool enable_cmdlist);
 int hisi_dss_ov_module_set_regs(struct hisi_fb_data_type *hisifd, dss_overlay_t *pov_req, int ovl_idx,
@@ -914,6 +914,7 @@ static int rgb2mipi_probe(struct platform_device *pdev)
 		HISI_FB_ERR("fb%d platform_device_add failed, error=%d!\n", hisifd->index, ret);
 		goto err_device_put;
 	}
+	hisi_fb_device_pm_link(dpe_dev, pdev);
 
 	HISI_FB_DEBUG("fb%d, -.\n", hisifd->index);
 
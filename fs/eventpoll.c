@@ -220,6 +220,16 @@ struct eventpoll {
 	/* used to optimize loop detection check */
 	int visited;
 	struct list_head visited_list_link;
+
+	/*
+	 * Set by ep_poll_callback() when it wakes the waiter, cleared by the
+	 * waiter once it holds ->lock again. Protected by ->lock.
+	 */
+	bool wake_pending;
+
+	/* waiter wakeups done and left out by ep_poll_callback(), under ->lock */
+	unsigned long wakeups;
+	unsigned long wakeups_saved;
 };
 
 /* Wait structure used by the poll hooks */
@@ -258,6 +268,12 @@ struct ep_send_events_data {
 /* Maximum number of epoll watched descriptors, per user */
 static long max_user_watches __read_mostly;
 
+/* Leave out wakeups of a sole waiter that has been woken and not yet run */
+static int coalesce_wakeups __read_mostly = 1;
+
+/* Wakeups left out that way, over all epoll instances */
+static atomic_long_t wakeups_saved;
+
 /*
  * This mutex is used to serialize ep_free() and eventpoll_release_file().
  */
@@ -293,6 +309,8 @@ static LIST_HEAD(tfile_check_list);
 
 static long zero;
 static long long_max = LONG_MAX;
+static int int_zero;
+static int int_one = 1;
 
 struct ctl_table epoll_table[] = {
 	{
@@ -304,6 +322,22 @@ struct ctl_table epoll_table[] = {
 		.extra1		= &zero,
 		.extra2		= &long_max,
 	},
+	{
+		.procname	= "coalesce_wakeups",
+		.data		= &coalesce_wakeups,
+		.maxlen		= sizeof(coalesce_wakeups),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &int_zero,
+		.extra2		= &int_one,
+	},
+	{
+		.procname	= "wakeups_saved",
+		.data		= &wakeups_saved.counter,
+		.maxlen		= sizeof(wakeups_saved.counter),
+		.mode		= 0444,
+		.proc_handler	= proc_doulongvec_minmax,
+	},
 	{ }
 };
 #endif /* CONFIG_SYSCTL */
@@ -891,6 +925,8 @@ static void ep_show_fdinfo(struct seq_file *m, struct file *f)
 		if (seq_has_overflowed(m))
 			break;
 	}
+	seq_printf(m, "wakeups: %lu saved: %lu\n",
+		   ep->wakeups, ep->wakeups_saved);
 	mutex_unlock(&ep->mtx);
 }
 #endif
@@ -997,6 +1033,32 @@ static struct epitem *ep_find(struct eventpoll *ep, struct file *file, int fd)
 	return epir;
 }
 
+/*
+ * Wakes the ep_poll() waiter for ep_poll_callback(), with ->lock held.
+ *
+ * Under an input flood a looper thread is woken by the first readiness
+ * change and then has every following one try to wake it again before it
+ * gets to run. When it is the only waiter and already woken, it will
+ * collect whatever has been queued on ->rdllist by then, so those extra
+ * wakeups are left out. A second waiter that shows up meanwhile finds the
+ * events itself before it sleeps, so none is stranded.
+ */
+static inline void ep_wake_waiter(struct eventpoll *ep)
+{
+	if (!waitqueue_active(&ep->wq))
+		return;
+
+	if (ep->wake_pending && coalesce_wakeups &&
+	    list_is_singular(&ep->wq.task_list)) {
+		ep->wakeups_saved++;
+		atomic_long_inc(&wakeups_saved);
+		return;
+	}
+	ep->wake_pending = true;
+	ep->wakeups++;
+	wake_up_locked(&ep->wq);
+}
+
 /*
  * This is the callback that is passed to the wait queue wakeup
  * mechanism. It is called by the stored file descriptors when they
@@ -1061,8 +1123,7 @@ static int ep_poll_callback(wait_queue_t *wait, unsigned mode, int sync, void *k
 	 * Wake up ( if active ) both the eventpoll wait list and the ->poll()
 	 * wait list.
 	 */
-	if (waitqueue_active(&ep->wq))
-		wake_up_locked(&ep->wq);
+	ep_wake_waiter(ep);
 	if (waitqueue_active(&ep->poll_wait))
 		pwake++;
 
@@ -1651,6 +1712,8 @@ fetch_events:
 				timed_out = 1;
 
 			spin_lock_irqsave(&ep->lock, flags);
+			/* from here on we see all of ->rdllist ourselves */
+			ep->wake_pending = false;
 		}
 
 		__remove_wait_queue(&ep->wq, &wait);
@@ -31,6 +31,7 @@
 #include <linux/mempool.h>
 #include <linux/module.h>
 #include <linux/mutex.h>
+#include <linux/percpu.h>
 #include <linux/random.h>
 #include <linux/scatterlist.h>
 #include <linux/spinlock_types.h>
@@ -55,6 +56,63 @@ static mempool_t *ext4_bounce_page_pool;
 static LIST_HEAD(ext4_free_crypto_ctxs);
 static DEFINE_SPINLOCK(ext4_crypto_ctx_lock);
 
+/*
+ * Bounce pages from the page allocator are kept on a small per-cpu stack
+ * when their write completes, so streaming writes mostly recycle the
+ * same pages instead of going through the allocator twice per page.
+ * Completion runs in irq context, hence irqs off around the stack.
+ */
+#define EXT4_BOUNCE_CACHE_PAGES	16
+
+struct ext4_bounce_cache {
+	unsigned int nr;
+	struct page *pages[EXT4_BOUNCE_CACHE_PAGES];
+};
+
+static DEFINE_PER_CPU(struct ext4_bounce_cache, ext4_bounce_cache);
+
+static struct page *ext4_bounce_cache_get(void)
+{
+	struct ext4_bounce_cache *bc;
+	struct page *page = NULL;
+	unsigned long flags;
+
+	local_irq_save(flags);
+	bc = this_cpu_ptr(&ext4_bounce_cache);
+	if (bc->nr)
+		page = bc->pages[--bc->nr];
+	local_irq_restore(flags);
+	return page;
+}
+
+static void ext4_bounce_cache_put(struct page *page)
+{
+	struct ext4_bounce_cache *bc;
+	unsigned long flags;
+
+	local_irq_save(flags);
+	bc = this_cpu_ptr(&ext4_bounce_cache);
+	if (bc->nr < EXT4_BOUNCE_CACHE_PAGES) {
+		bc->pages[bc->nr++] = page;
+		page = NULL;
+	}
+	local_irq_restore(flags);
+	if (page)
+		__free_page(page);
+}
+
+static void ext4_bounce_cache_drain(void)
+{
+	struct ext4_bounce_cache *bc;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		bc = per_cpu_ptr(&ext4_bounce_cache, cpu);
+		while (bc->nr)
+			__free_page(bc->pages[--bc->nr]);
+	}
+}
+
 /**
  * ext4_release_crypto_ctx() - Releases an encryption context
  * @ctx: The encryption context to release.
@@ -70,12 +128,13 @@ void ext4_release_crypto_ctx(struct ext4_crypto_ctx *ctx)
 
 	if (ctx->bounce_page) {
 		if (ctx->flags & EXT4_BOUNCE_PAGE_REQUIRES_FREE_ENCRYPT_FL)
-			__free_page(ctx->bounce_page);
+			ext4_bounce_cache_put(ctx->bounce_page);
 		else
 			mempool_free(ctx->bounce_page, ext4_bounce_page_pool);
 		ctx->bounce_page = NULL;
 	}
 	ctx->control_page = NULL;
+	ctx->flags &= ~EXT4_ENCRYPT_PENDING_FL;
 	if (ctx->flags & EXT4_CTX_REQUIRES_FREE_ENCRYPT_FL) {
 		if (ctx->tfm)
 			crypto_free_tfm(ctx->tfm);
@@ -219,6 +278,7 @@ void ext4_exit_crypto(void)
 		kfree(pos);
 	}
 	INIT_LIST_HEAD(&ext4_free_crypto_ctxs);
+	ext4_bounce_cache_drain();
 	if (ext4_bounce_page_pool)
 		mempool_destroy(ext4_bounce_page_pool);
 	ext4_bounce_page_pool = NULL;
@@ -305,21 +365,25 @@ typedef enum {
 	EXT4_ENCRYPT,
 } ext4_direction_t;
 
-static int ext4_page_crypto(struct ext4_crypto_ctx *ctx,
-			    struct inode *inode,
-			    ext4_direction_t rw,
-			    pgoff_t index,
-			    struct page *src_page,
-			    struct page *dest_page)
-
+/**
+ * ext4_crypt_req_alloc() - Keys ctx's tfm for inode and allocates a request
+ * @ctx:   The encryption context whose tfm is used
+ * @inode: The inode whose key is set
+ * @ecr:   Completion for requests that go asynchronous
+ *
+ * The request can be run on any number of pages of @inode with
+ * ext4_crypt_req_run() before ablkcipher_request_free().
+ *
+ * Return: The request on success, else an error value.
+ */
+static struct ablkcipher_request *ext4_crypt_req_alloc(
+		struct ext4_crypto_ctx *ctx, struct inode *inode,
+		struct ext4_completion_result *ecr)
 {
-	u8 xts_tweak[EXT4_XTS_TWEAK_SIZE];
-	struct ablkcipher_request *req = NULL;
-	DECLARE_EXT4_COMPLETION_RESULT(ecr);
-	struct scatterlist dst, src;
+	struct ablkcipher_request *req;
 	struct ext4_inode_info *ei = EXT4_I(inode);
 	struct crypto_ablkcipher *atfm = __crypto_ablkcipher_cast(ctx->tfm);
-	int res = 0;
+	int res;
 
 	BUG_ON(!ctx->tfm);
 	BUG_ON(ctx->mode != ei->i_encryption_key.mode);
@@ -328,7 +392,7 @@ static int ext4_page_crypto(struct ext4_crypto_ctx *ctx,
 		printk_ratelimited(KERN_ERR
 				   "%s: unsupported crypto algorithm: %d\n",
 				   __func__, ctx->mode);
-		return -ENOTSUPP;
+		return ERR_PTR(-ENOTSUPP);
 	}
 
 	crypto_ablkcipher_clear_flags(atfm, ~0);
@@ -340,18 +404,44 @@ static int ext4_page_crypto(struct ext4_crypto_ctx *ctx,
 		printk_ratelimited(KERN_ERR
 				   "%s: crypto_ablkcipher_setkey() failed\n",
 				   __func__);
-		return res;
+		return ERR_PTR(res);
 	}
 	req = ablkcipher_request_alloc(atfm, GFP_NOFS);
 	if (!req) {
 		printk_ratelimited(KERN_ERR
 				   "%s: crypto_request_alloc() failed\n",
 				   __func__);
-		return -ENOMEM;
+		return ERR_PTR(-ENOMEM);
 	}
 	ablkcipher_request_set_callback(
 		req, CRYPTO_TFM_REQ_MAY_BACKLOG | CRYPTO_TFM_REQ_MAY_SLEEP,
-		ext4_crypt_complete, &ecr);
+		ext4_crypt_complete, ecr);
+	return req;
+}
+
+/**
+ * ext4_crypt_req_run() - Encrypts or decrypts one page with a keyed request
+ * @req:       Request from ext4_crypt_req_alloc()
+ * @ecr:       The completion given to ext4_crypt_req_alloc()
+ * @rw:        EXT4_ENCRYPT or EXT4_DECRYPT
+ * @index:     Page index, the XTS tweak
+ * @src_page:  Input page
+ * @dest_page: Output page, may be @src_page
+ *
+ * Return: Zero on success, non-zero otherwise.
+ */
+static int ext4_crypt_req_run(struct ablkcipher_request *req,
+			      struct ext4_completion_result *ecr,
+			      ext4_direction_t rw,
+			      pgoff_t index,
+			      struct page *src_page,
+			      struct page *dest_page)
+{
+	u8 xts_tweak[EXT4_XTS_TWEAK_SIZE];
+	struct scatterlist dst, src;
+	int res;
+
+	reinit_completion(&ecr->completion);
 
 	BUILD_BUG_ON(EXT4_XTS_TWEAK_SIZE < sizeof(index));
 	memcpy(xts_tweak, &index, sizeof(index));
@@ -369,11 +459,10 @@ static int ext4_page_crypto(struct ext4_crypto_ctx *ctx,
 	else
 		res = crypto_ablkcipher_encrypt(req);
 	if (res == -EINPROGRESS || res == -EBUSY) {
-		BUG_ON(req->base.data != &ecr);
-		wait_for_completion(&ecr.completion);
-		res = ecr.res;
+		BUG_ON(req->base.data != ecr);
+		wait_for_completion(&ecr->completion);
+		res = ecr->res;
 	}
-	ablkcipher_request_free(req);
 	if (res) {
 		printk_ratelimited(
 			KERN_ERR
@@ -384,6 +473,141 @@ static int ext4_page_crypto(struct ext4_crypto_ctx *ctx,
 	return 0;
 }
 
+static int ext4_page_crypto(struct ext4_crypto_ctx *ctx,
+			    struct inode *inode,
+			    ext4_direction_t rw,
+			    pgoff_t index,
+			    struct page *src_page,
+			    struct page *dest_page)
+
+{
+	struct ablkcipher_request *req;
+	DECLARE_EXT4_COMPLETION_RESULT(ecr);
+	int res;
+
+	req = ext4_crypt_req_alloc(ctx, inode, &ecr);
+	if (IS_ERR(req))
+		return PTR_ERR(req);
+	res = ext4_crypt_req_run(req, &ecr, rw, index, src_page, dest_page);
+	ablkcipher_request_free(req);
+	return res;
+}
+
+/*
+ * Attaches a bounce page to ctx: a recycled one, else a fresh one, else
+ * one from the emergency pool.
+ */
+static struct page *ext4_alloc_bounce_page(struct ext4_crypto_ctx *ctx)
+{
+	struct page *ciphertext_page;
+
+	ciphertext_page = ext4_bounce_cache_get();
+	if (!ciphertext_page)
+		ciphertext_page = alloc_page(GFP_NOFS);
+	if (!ciphertext_page) {
+		/* This is a potential bottleneck, but at least we'll have
+		 * forward progress. */
+		ciphertext_page = mempool_alloc(ext4_bounce_page_pool,
+						 GFP_NOFS);
+		if (WARN_ON_ONCE(!ciphertext_page)) {
+			ciphertext_page = mempool_alloc(ext4_bounce_page_pool,
+							 GFP_NOFS | __GFP_WAIT);
+		}
+		ctx->flags &= ~EXT4_BOUNCE_PAGE_REQUIRES_FREE_ENCRYPT_FL;
+	} else {
+		ctx->flags |= EXT4_BOUNCE_PAGE_REQUIRES_FREE_ENCRYPT_FL;
+	}
+	ctx->bounce_page = ciphertext_page;
+	return ciphertext_page;
+}
+
+/**
+ * ext4_get_bounce_page() - Sets up a bounce page for deferred encryption
+ * @inode:          The inode for which the encryption should take place
+ * @plaintext_page: The page to encrypt. Must be locked.
+ *
+ * Like ext4_encrypt(), but the returned page still has to be encrypted by
+ * ext4_encrypt_bio() once it is part of a bio, which lets all the pages of
+ * a bio share one keyed cipher request. plaintext_page must stay under
+ * writeback until then.
+ *
+ * Return: An allocated page on success. Else, an error value.
+ */
+struct page *ext4_get_bounce_page(struct inode *inode,
+				  struct page *plaintext_page)
+{
+	struct ext4_crypto_ctx *ctx;
+	struct page *ciphertext_page;
+
+	BUG_ON(!PageLocked(plaintext_page));
+
+	ctx = ext4_get_crypto_ctx(inode);
+	if (IS_ERR(ctx))
+		return (struct page *) ctx;
+
+	ciphertext_page = ext4_alloc_bounce_page(ctx);
+	ctx->control_page = plaintext_page;
+	ctx->flags |= EXT4_ENCRYPT_PENDING_FL;
+	SetPagePrivate(ciphertext_page);
+	set_page_private(ciphertext_page, (unsigned long)ctx);
+	lock_page(ciphertext_page);
+	return ciphertext_page;
+}
+
+/**
+ * ext4_encrypt_bio() - Encrypts the pending bounce pages of a write bio
+ * @bio: The bio about to be submitted
+ *
+ * The cipher is keyed and a request allocated once per run of pages
+ * from the same inode rather than once per page, so with the ARMv8 CE
+ * xts(aes) driver a whole bio goes through back to back synchronous
+ * calls. A page spanning several segments is only encrypted once.
+ *
+ * Return: Zero on success, non-zero otherwise.
+ */
+int ext4_encrypt_bio(struct bio *bio)
+{
+	struct ablkcipher_request *req = NULL;
+	DECLARE_EXT4_COMPLETION_RESULT(ecr);
+	struct inode *inode = NULL;
+	struct ext4_crypto_ctx *ctx;
+	struct bio_vec *bvec;
+	int i, res = 0;
+
+	bio_for_each_segment_all(bvec, bio, i) {
+		struct page *page = bvec->bv_page;
+		struct page *control_page;
+
+		/* The bounce data pages are unmapped. */
+		if (page->mapping)
+			continue;
+		ctx = (struct ext4_crypto_ctx *)page_private(page);
+		if (!(ctx->flags & EXT4_ENCRYPT_PENDING_FL))
+			continue;
+		control_page = ctx->control_page;
+		if (control_page->mapping->host != inode) {
+			if (req)
+				ablkcipher_request_free(req);
+			inode = control_page->mapping->host;
+			req = ext4_crypt_req_alloc(ctx, inode, &ecr);
+			if (IS_ERR(req)) {
+				res = PTR_ERR(req);
+				req = NULL;
+				break;
+			}
+		}
+		res = ext4_crypt_req_run(req, &ecr, EXT4_ENCRYPT,
+					 control_page->index, control_page,
+					 page);
+		if (res)
+			break;
+		ctx->flags &= ~EXT4_ENCRYPT_PENDING_FL;
+	}
+	if (req)
+		ablkcipher_request_free(req);
+	return res;
+}
+
 /**
  * ext4_encrypt() - Encrypts a page
  * @inode:          The inode for which the encryption should take place
@@ -413,21 +637,7 @@ struct page *ext4_encrypt(struct inode *inode,
 		return (struct page *) ctx;
 
 	/* The encryption operation will require a bounce page. */
-	ciphertext_page = alloc_page(GFP_NOFS);
-	if (!ciphertext_page) {
-		/* This is a potential bottleneck, but at least we'll have
-		 * forward progress. */
-		ciphertext_page = mempool_alloc(ext4_bounce_page_pool,
-						 GFP_NOFS);
-		if (WARN_ON_ONCE(!ciphertext_page)) {
-			ciphertext_page = mempool_alloc(ext4_bounce_page_pool,
-							 GFP_NOFS | __GFP_WAIT);
-		}
-		ctx->flags &= ~EXT4_BOUNCE_PAGE_REQUIRES_FREE_ENCRYPT_FL;
-	} else {
-		ctx->flags |= EXT4_BOUNCE_PAGE_REQUIRES_FREE_ENCRYPT_FL;
-	}
-	ctx->bounce_page = ciphertext_page;
+	ciphertext_page = ext4_alloc_bounce_page(ctx);
 	ctx->control_page = plaintext_page;
 	err = ext4_page_crypto(ctx, inode, EXT4_ENCRYPT, plaintext_page->index,
 			       plaintext_page, ciphertext_page);
@@ -493,21 +703,7 @@ int ext4_encrypted_zeroout(struct inode *inode, struct ext4_extent *ex)
 	if (IS_ERR(ctx))
 		return PTR_ERR(ctx);
 
-	ciphertext_page = alloc_page(GFP_NOFS);
-	if (!ciphertext_page) {
-		/* This is a potential bottleneck, but at least we'll have
-		 * forward progress. */
-		ciphertext_page = mempool_alloc(ext4_bounce_page_pool,
-						 GFP_NOFS);
-		if (WARN_ON_ONCE(!ciphertext_page)) {
-			ciphertext_page = mempool_alloc(ext4_bounce_page_pool,
-							 GFP_NOFS | __GFP_WAIT);
-		}
-		ctx->flags &= ~EXT4_BOUNCE_PAGE_REQUIRES_FREE_ENCRYPT_FL;
-	} else {
-		ctx->flags |= EXT4_BOUNCE_PAGE_REQUIRES_FREE_ENCRYPT_FL;
-	}
-	ctx->bounce_page = ciphertext_page;
+	ciphertext_page = ext4_alloc_bounce_page(ctx);
 
 	while (len--) {
 		err = ext4_page_crypto(ctx, inode, EXT4_ENCRYPT, lblk,
@@ -84,6 +84,24 @@ out:
 	return res;
 }
 
+#ifdef CONFIG_EXT4_FS_INLINE_ENCRYPTION
+/*
+ * The inline crypto engine takes each 256-bit half of the XTS key byte
+ * reversed. With the converted copy it produces the same ciphertext as
+ * ext4_page_crypto() does with the raw key, so a file can be read and
+ * written through either path.
+ */
+static void ext4_prepare_inline_key(struct ext4_inode_info *ei)
+{
+	const char *raw = ei->i_encryption_key.raw;
+	int i, j;
+
+	for (i = 0; i < EXT4_AES_256_XTS_KEY_SIZE; i += 32)
+		for (j = 0; j < 32; j++)
+			ei->i_inline_key[i + j] = raw[i + 31 - j];
+}
+#endif
+
 /**
  * ext4_generate_encryption_key() - generates an encryption key
  * @inode: The inode to generate the encryption key for.
@@ -154,6 +172,10 @@ out:
 		key_put(keyring_key);
 	if (res < 0)
 		crypt_key->mode = EXT4_ENCRYPTION_MODE_INVALID;
+#ifdef CONFIG_EXT4_FS_INLINE_ENCRYPTION
+	else if (crypt_key->mode == EXT4_ENCRYPTION_MODE_AES_256_XTS)
+		ext4_prepare_inline_key(ei);
+#endif
 	return res;
 }
 
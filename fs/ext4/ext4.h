@@ -30,6 +30,7 @@
 #include <linux/blockgroup_lock.h>
 #include <linux/percpu_counter.h>
 #include <linux/ratelimit.h>
+#include <linux/crc32.h>
 #include <crypto/hash.h>
 #include <linux/falloc.h>
 #ifdef __KERNEL__
@@ -195,6 +196,8 @@ struct ext4_io_submit {
 	struct bio		*io_bio;
 	ext4_io_end_t		*io_end;
 	sector_t		io_next_block;
+	bool			io_encrypt;	/* io_bio has bounce pages
+						 * still to encrypt */
 };
 
 /*
@@ -990,6 +993,10 @@ struct ext4_inode_info {
 	/* Encryption params */
 	struct ext4_encryption_key i_encryption_key;
 #endif
+#ifdef CONFIG_EXT4_FS_INLINE_ENCRYPTION
+	/* i_encryption_key.raw in the inline crypto engine's layout */
+	char i_inline_key[EXT4_AES_256_XTS_KEY_SIZE];
+#endif
 };
 
 /*
@@ -1414,6 +1421,10 @@ struct ext4_sb_info {
 	uint32_t s_file_encryption_mode;
 	uint32_t s_dir_encryption_mode;
 #endif
+#ifdef CONFIG_EXT4_FS_INLINE_ENCRYPTION
+	/* the device encrypts file contents inline */
+	unsigned int s_inline_crypt:1;
+#endif
 };
 
 static inline struct ext4_sb_info *EXT4_SB(struct super_block *sb)
@@ -1829,25 +1840,14 @@ static inline __le16 ext4_rec_len_to_disk(unsigned len, unsigned blocksize)
 #define DX_HASH_HALF_MD4_UNSIGNED	4
 #define DX_HASH_TEA_UNSIGNED		5
 
+/*
+ * s_chksum_driver only marks metadata_csum as enabled, the sums themselves
+ * come from the library so they use the cpu's crc32c instructions directly.
+ */
 static inline u32 ext4_chksum(struct ext4_sb_info *sbi, u32 crc,
 			      const void *address, unsigned int length)
 {
-	struct {
-		struct shash_desc shash;
-		char ctx[4];
-	} desc;
-	int err;
-
-	BUG_ON(crypto_shash_descsize(sbi->s_chksum_driver)!=sizeof(desc.ctx));
-
-	desc.shash.tfm = sbi->s_chksum_driver;
-	desc.shash.flags = 0;
-	*(u32 *)desc.ctx = crc;
-
-	err = crypto_shash_update(&desc.shash, address, length);
-	BUG_ON(err);
-
-	return *(u32 *)desc.ctx;
+	return __crc32c_le(crc, address, length);
 }
 
 #ifdef __KERNEL__
@@ -2096,6 +2096,9 @@ void ext4_release_crypto_ctx(struct ext4_crypto_ctx *ctx);
 void ext4_restore_control_page(struct page *data_page);
 struct page *ext4_encrypt(struct inode *inode,
 			  struct page *plaintext_page);
+struct page *ext4_get_bounce_page(struct inode *inode,
+				  struct page *plaintext_page);
+int ext4_encrypt_bio(struct bio *bio);
 int ext4_decrypt(struct ext4_crypto_ctx *ctx, struct page *page);
 int ext4_decrypt_one(struct inode *inode, struct page *page);
 int ext4_encrypted_zeroout(struct inode *inode, struct ext4_extent *ex);
@@ -2116,6 +2119,56 @@ static inline int ext4_sb_has_crypto(struct super_block *sb)
 }
 #endif
 
+/*
+ * Returns true if the contents of the inode are encrypted by the storage
+ * controller on the way to the disk instead of through a bounce page.
+ * The engine works on 4K data units numbered by page index, so this needs
+ * one block per page and bios of consecutive pages.
+ */
+static inline bool ext4_inline_encrypted_inode(struct inode *inode)
+{
+#ifdef CONFIG_EXT4_FS_INLINE_ENCRYPTION
+	return ext4_encrypted_inode(inode) && S_ISREG(inode->i_mode) &&
+		EXT4_SB(inode->i_sb)->s_inline_crypt &&
+		inode->i_blkbits == PAGE_CACHE_SHIFT &&
+		EXT4_I(inode)->i_encryption_key.mode ==
+					EXT4_ENCRYPTION_MODE_AES_256_XTS;
+#else
+	return false;
+#endif
+}
+
+/* Attaches the inline key to a newly allocated bio starting at @page */
+static inline void ext4_set_bio_crypt(struct bio *bio, struct inode *inode,
+				      struct page *page)
+{
+#ifdef CONFIG_EXT4_FS_INLINE_ENCRYPTION
+	if (!ext4_inline_encrypted_inode(inode))
+		return;
+
+	bio->ci_key = EXT4_I(inode)->i_inline_key;
+	bio->ci_key_len = EXT4_AES_256_XTS_KEY_SIZE;
+	bio->index = page->index;
+#endif
+}
+
+/* Can @page of @inode be appended to @bio without breaking its data units? */
+static inline bool ext4_bio_crypt_mergeable(struct bio *bio,
+					    struct inode *inode,
+					    struct page *page)
+{
+#ifdef CONFIG_EXT4_FS_INLINE_ENCRYPTION
+	if (!bio->ci_key)
+		return !ext4_inline_encrypted_inode(inode);
+
+	return ext4_inline_encrypted_inode(inode) &&
+		bio->ci_key == EXT4_I(inode)->i_inline_key &&
+		bio->index + bio->bi_vcnt == page->index;
+#else
+	return true;
+#endif
+}
+
 /* crypto_fname.c */
 bool ext4_valid_filenames_enc_mode(uint32_t mode);
 u32 ext4_fname_crypto_round_up(u32 size, u32 blksize);
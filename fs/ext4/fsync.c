@@ -134,8 +134,12 @@ int ext4_sync_file(struct file *file, loff_t start, loff_t end, int datasync)
 		goto out;
 	}
 
+	/*
+	 * Directory blocks are journalled, so a commit written with FUA
+	 * makes them durable without a flush. File data is not in the log.
+	 */
 	commit_tid = datasync ? ei->i_datasync_tid : ei->i_sync_tid;
-	if (journal->j_flags & JBD2_BARRIER &&
+	if (journal->j_flags & JBD2_BARRIER && !S_ISDIR(inode->i_mode) &&
 	    !jbd2_trans_will_send_data_barrier(journal, commit_tid))
 		needs_barrier = true;
 	ret = jbd2_complete_transaction(journal, commit_tid);
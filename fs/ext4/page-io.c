@@ -359,11 +359,22 @@ void ext4_io_submit(struct ext4_io_submit *io)
 	if (bio) {
 		int io_op = io->io_wbc->sync_mode == WB_SYNC_ALL ?
 			    WRITE_SYNC : WRITE;
+		int err = 0;
+
+#ifdef CONFIG_EXT4_FS_ENCRYPTION
+		if (io->io_encrypt)
+			err = ext4_encrypt_bio(bio);
+#endif
 		bio_get(io->io_bio);
-		submit_bio(io_op, io->io_bio);
+		if (err)
+			/* fails the pages like a write error would */
+			bio_endio(io->io_bio, err);
+		else
+			submit_bio(io_op, io->io_bio);
 		bio_put(io->io_bio);
 	}
 	io->io_bio = NULL;
+	io->io_encrypt = false;
 }
 
 void ext4_io_submit_init(struct ext4_io_submit *io,
@@ -372,6 +383,7 @@ void ext4_io_submit_init(struct ext4_io_submit *io,
 	io->io_wbc = wbc;
 	io->io_bio = NULL;
 	io->io_end = NULL;
+	io->io_encrypt = false;
 }
 
 static int io_submit_init_bio(struct ext4_io_submit *io,
@@ -399,7 +411,9 @@ static int io_submit_add_bh(struct ext4_io_submit *io,
 {
 	int ret;
 
-	if (io->io_bio && bh->b_blocknr != io->io_next_block) {
+	if (io->io_bio &&
+	    (bh->b_blocknr != io->io_next_block ||
+	     !ext4_bio_crypt_mergeable(io->io_bio, inode, page))) {
 submit_and_retry:
 		ext4_io_submit(io);
 	}
@@ -407,10 +421,13 @@ submit_and_retry:
 		ret = io_submit_init_bio(io, bh);
 		if (ret)
 			return ret;
+		ext4_set_bio_crypt(io->io_bio, inode, page);
 	}
 	ret = bio_add_page(io->io_bio, page, bh->b_size, bh_offset(bh));
 	if (ret != bh->b_size)
 		goto submit_and_retry;
+	if (!page->mapping)
+		io->io_encrypt = true;
 	io->io_next_block++;
 	return 0;
 }
@@ -486,8 +503,8 @@ int ext4_bio_write_page(struct ext4_io_submit *io,
 	bh = head = page_buffers(page);
 
 	if (ext4_encrypted_inode(inode) && S_ISREG(inode->i_mode) &&
-	    nr_to_submit) {
-		data_page = ext4_encrypt(inode, page);
+	    !ext4_inline_encrypted_inode(inode) && nr_to_submit) {
+		data_page = ext4_get_bounce_page(inode, page);
 		if (IS_ERR(data_page)) {
 			ret = PTR_ERR(data_page);
 			data_page = NULL;
@@ -269,7 +269,8 @@ int ext4_mpage_readpages(struct address_space *mapping,
 		 * This page will go to BIO.  Do we need to send this
 		 * BIO off first?
 		 */
-		if (bio && (last_block_in_bio != blocks[0] - 1)) {
+		if (bio && (last_block_in_bio != blocks[0] - 1 ||
+			    !ext4_bio_crypt_mergeable(bio, inode, page))) {
 		submit_and_realloc:
 			submit_bio(READ, bio);
 			bio = NULL;
@@ -278,7 +279,8 @@ int ext4_mpage_readpages(struct address_space *mapping,
 			struct ext4_crypto_ctx *ctx = NULL;
 
 			if (ext4_encrypted_inode(inode) &&
-			    S_ISREG(inode->i_mode)) {
+			    S_ISREG(inode->i_mode) &&
+			    !ext4_inline_encrypted_inode(inode)) {
 				ctx = ext4_get_crypto_ctx(inode);
 				if (IS_ERR(ctx))
 					goto set_error_page;
@@ -294,6 +296,7 @@ int ext4_mpage_readpages(struct address_space *mapping,
 			bio->bi_iter.bi_sector = blocks[0] << (blkbits - 9);
 			bio->bi_end_io = mpage_end_io;
 			bio->bi_private = ctx;
+			ext4_set_bio_crypt(bio, inode, page);
 		}
 
 		length = first_hole << blkbits;
@@ -3527,6 +3527,10 @@ static int ext4_fill_super(struct super_block *sb, void *data, int silent)
 	sbi->s_file_encryption_mode = EXT4_ENCRYPTION_MODE_AES_256_XTS;
 	sbi->s_dir_encryption_mode = EXT4_ENCRYPTION_MODE_INVALID;
 #endif
+#ifdef CONFIG_EXT4_FS_INLINE_ENCRYPTION
+	sbi->s_inline_crypt =
+		!!is_blk_queue_support_crypto(bdev_get_queue(sb->s_bdev));
+#endif
 
 	/* Cleanup superblock name */
 	for (cp = sb->s_id; (cp = strchr(cp, '/'));)
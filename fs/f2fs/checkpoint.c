@@ -16,6 +16,7 @@
 #include <linux/f2fs_fs.h>
 #include <linux/pagevec.h>
 #include <linux/swap.h>
+#include <linux/workqueue.h>
 
 #include "f2fs.h"
 #include "node.h"
@@ -886,6 +887,25 @@ retry:
 /*
  * Freeze all the FS-operations for checkpoint.
  */
+/*
+ * Write back dirty dentry and node pages while operations still go on, so
+ * the loops in block_operations() find little left to do under
+ * f2fs_lock_all(). Errors are found again there.
+ */
+static void prewrite_operations(struct f2fs_sb_info *sbi)
+{
+	struct writeback_control wbc = {
+		.sync_mode = WB_SYNC_NONE,
+		.nr_to_write = LONG_MAX,
+		.for_reclaim = 0,
+	};
+
+	if (get_pages(sbi, F2FS_DIRTY_DENTS))
+		sync_dirty_inodes(sbi, DIR_INODE);
+	if (get_pages(sbi, F2FS_DIRTY_NODES))
+		sync_node_pages(sbi, &wbc);
+}
+
 static int block_operations(struct f2fs_sb_info *sbi)
 {
 	struct writeback_control wbc = {
@@ -1190,10 +1210,49 @@ static int do_checkpoint(struct f2fs_sb_info *sbi, struct cp_control *cpc)
 /*
  * We guarantee that this checkpoint procedure will not fail.
  */
+struct cp_nat_work {
+	struct work_struct work;
+	struct f2fs_sb_info *sbi;
+};
+
+static void flush_nat_work(struct work_struct *work)
+{
+	struct cp_nat_work *nw = container_of(work, struct cp_nat_work, work);
+
+	flush_nat_entries(nw->sbi);
+}
+
+/*
+ * NAT and SIT entries go to separate areas and separate curseg journals,
+ * with operations blocked nothing else touches either of them.
+ */
+static void flush_nat_sit_entries(struct f2fs_sb_info *sbi,
+					struct cp_control *cpc)
+{
+	struct cp_nat_work nw;
+
+	if (!sbi->cp_parallel || !NM_I(sbi)->dirty_nat_cnt ||
+					!SIT_I(sbi)->dirty_sentries) {
+		flush_nat_entries(sbi);
+		flush_sit_entries(sbi, cpc);
+		return;
+	}
+
+	INIT_WORK_ONSTACK(&nw.work, flush_nat_work);
+	nw.sbi = sbi;
+	queue_work(system_unbound_wq, &nw.work);
+
+	flush_sit_entries(sbi, cpc);
+
+	flush_work(&nw.work);
+	destroy_work_on_stack(&nw.work);
+}
+
 int write_checkpoint(struct f2fs_sb_info *sbi, struct cp_control *cpc)
 {
 	struct f2fs_checkpoint *ckpt = F2FS_CKPT(sbi);
 	unsigned long long ckpt_ver;
+	unsigned long start, blocked;
 	int err = 0;
 
 	mutex_lock(&sbi->cp_mutex);
@@ -1213,9 +1272,14 @@ int write_checkpoint(struct f2fs_sb_info *sbi, struct cp_control *cpc)
 
 	trace_f2fs_write_checkpoint(sbi->sb, cpc->reason, "start block_ops");
 
+	start = jiffies;
+	if (sbi->cp_parallel)
+		prewrite_operations(sbi);
+
 	err = block_operations(sbi);
 	if (err)
 		goto out;
+	blocked = jiffies;
 
 	trace_f2fs_write_checkpoint(sbi->sb, cpc->reason, "finish block_ops");
 
@@ -1243,14 +1307,15 @@ int write_checkpoint(struct f2fs_sb_info *sbi, struct cp_control *cpc)
 	ckpt->checkpoint_ver = cpu_to_le64(++ckpt_ver);
 
 	/* write cached NAT/SIT entries to NAT/SIT area */
-	flush_nat_entries(sbi);
-	flush_sit_entries(sbi, cpc);
+	flush_nat_sit_entries(sbi, cpc);
 
 	/* unlock all the fs_lock[] in do_checkpoint() */
 	err = do_checkpoint(sbi, cpc);
 
 	unblock_operations(sbi);
 	stat_inc_cp_count(sbi->stat_info);
+	stat_update_cp_time(sbi->stat_info, jiffies_to_msecs(jiffies - start),
+				jiffies_to_msecs(jiffies - blocked));
 
 	if (cpc->reason == CP_RECOVERY)
 		f2fs_msg(sbi->sb, KERN_NOTICE,
@@ -222,6 +222,31 @@ void f2fs_submit_merged_bio(struct f2fs_sb_info *sbi, enum page_type type,
 	__f2fs_submit_merged_bio(sbi, NULL, NULL, 0, type, rw);
 }
 
+/*
+ * Submit the merged NODE bio holding @page with PREFLUSH|FUA, which makes
+ * everything completed before it and the bio itself durable in one go.
+ * Returns false if @page already left, the caller has to flush then.
+ */
+bool f2fs_submit_merged_bio_fua(struct f2fs_sb_info *sbi, struct page *page)
+{
+	struct f2fs_bio_info *io = &sbi->write_io[NODE];
+	struct bio *pending_bio = NULL;
+	struct f2fs_io_info pending_fio;
+
+	down_write(&io->io_rwsem);
+	if (__has_merged_page(io, NULL, page, 0)) {
+		io->fio.rw |= WRITE_FLUSH_FUA;
+		__pend_merged_bio(io, &pending_fio, &pending_bio);
+	}
+	up_write(&io->io_rwsem);
+
+	if (!pending_bio)
+		return false;
+
+	__submit_pending_bio(&pending_fio, pending_bio);
+	return true;
+}
+
 void f2fs_submit_merged_bio_cond(struct f2fs_sb_info *sbi,
 				struct inode *inode, struct page *page,
 				nid_t ino, enum page_type type, int rw)
@@ -694,6 +719,22 @@ ssize_t f2fs_preallocate_blocks(struct kiocb *iocb, struct iov_iter *from)
  *     b. do not use extent cache for better performance
  *     c. give the block addresses to blockdev
  */
+/*
+ * A later miss in what this dnode mapped is served by the extent cache. The
+ * inode page itself stays cached with the inode, it is not worth a node.
+ */
+static void __cache_mapped_range(struct dnode_of_data *dn,
+			struct f2fs_map_blocks *map, pgoff_t start, pgoff_t end)
+{
+	if (end <= start || dn->node_page == dn->inode_page ||
+			!(map->m_flags & F2FS_MAP_MAPPED) ||
+			(map->m_flags & F2FS_MAP_UNWRITTEN))
+		return;
+
+	f2fs_cache_extent_range(dn, start, map->m_pblk + start - map->m_lblk,
+								end - start);
+}
+
 int f2fs_map_blocks(struct inode *inode, struct f2fs_map_blocks *map,
 						int create, int flag)
 {
@@ -701,7 +742,7 @@ int f2fs_map_blocks(struct inode *inode, struct f2fs_map_blocks *map,
 	struct dnode_of_data dn;
 	struct f2fs_sb_info *sbi = F2FS_I_SB(inode);
 	int mode = create ? ALLOC_NODE : LOOKUP_NODE_RA;
-	pgoff_t pgofs, end_offset;
+	pgoff_t pgofs, end_offset, start_pgofs;
 	int err = 0, ofs = 1;
 	struct extent_info ei;
 	bool allocated = false;
@@ -743,6 +784,7 @@ next_dnode:
 		goto unlock_out;
 	}
 
+	start_pgofs = pgofs;
 	end_offset = ADDRS_PER_PAGE(dn.node_page, inode);
 
 next_block:
@@ -811,6 +853,8 @@ next_block:
 
 		if (allocated)
 			sync_inode_page(&dn);
+		if (!create)
+			__cache_mapped_range(&dn, map, start_pgofs, pgofs);
 		f2fs_put_dnode(&dn);
 
 		if (create) {
@@ -824,6 +868,8 @@ next_block:
 sync_out:
 	if (allocated)
 		sync_inode_page(&dn);
+	if (!create && !err)
+		__cache_mapped_range(&dn, map, start_pgofs, pgofs);
 	f2fs_put_dnode(&dn);
 unlock_out:
 	if (create) {
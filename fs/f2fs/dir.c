@@ -78,13 +78,192 @@ static unsigned long dir_block_index(unsigned int level,
 	return bidx;
 }
 
+/*
+ * Lookup cache of large directories
+ *
+ * A lookup in a directory of depth N reads two or four dentry blocks on
+ * every level up to the one holding the name, and on all N levels when the
+ * name is not there. Once a directory is dir_cache_blocks long (see sysfs),
+ * its first lookup hangs a page of (name hash, block) slots off the inode,
+ * which then remembers the block each name was found in, or that no entry
+ * of that hash exists at all. A positive hit reads one block and a negative
+ * hit none; a stale positive slot just falls back to the full search.
+ *
+ * A negative slot is only stored when no entry of the directory has the
+ * hash, so a name colliding with an existing one is never hidden, and
+ * __f2fs_do_add_link() overwrites the slot of every name it adds. Only
+ * exact lookups use the cache: case-insensitive ones match names of other
+ * hashes, nokey ones of encrypted dirs match on the hash alone. Lookups and
+ * adds of one directory are serialized by its i_mutex; dir_cache_lock is
+ * taken against the shrinker, which frees whole caches in LRU order.
+ */
+struct dir_cache_slot {
+	f2fs_hash_t hash;
+	unsigned int val;	/* block + 1, DIR_CACHE_NEG | (level + 1), or 0 */
+};
+
+#define DIR_CACHE_SLOTS	(PAGE_SIZE / sizeof(struct dir_cache_slot))
+#define DIR_CACHE_NEG	0x80000000U
+
+struct f2fs_dir_cache {
+	struct inode *inode;
+	struct list_head list;		/* linked in sbi->dir_cache_list */
+	struct dir_cache_slot *slot;	/* DIR_CACHE_SLOTS of them */
+};
+
+static bool dir_cache_wanted(struct inode *dir, unsigned long npages,
+			struct fscrypt_name *fname, struct fscrypt_str *fstr)
+{
+	unsigned int min_blocks = F2FS_I_SB(dir)->dir_cache_blocks;
+
+	return min_blocks && npages >= min_blocks && !fname->hash && !fstr;
+}
+
+static struct dir_cache_slot *dir_cache_slot(struct f2fs_dir_cache *dc,
+						f2fs_hash_t hash)
+{
+	return &dc->slot[le32_to_cpu(hash) & (DIR_CACHE_SLOTS - 1)];
+}
+
+static unsigned int dir_cache_lookup(struct inode *dir, f2fs_hash_t hash)
+{
+	struct f2fs_sb_info *sbi = F2FS_I_SB(dir);
+	struct f2fs_dir_cache *dc;
+	struct dir_cache_slot *s;
+	unsigned int val = 0;
+
+	spin_lock(&sbi->dir_cache_lock);
+	dc = F2FS_I(dir)->dir_cache;
+	if (dc) {
+		s = dir_cache_slot(dc, hash);
+		if (s->val && s->hash == hash)
+			val = s->val;
+		list_move_tail(&dc->list, &sbi->dir_cache_list);
+	}
+	spin_unlock(&sbi->dir_cache_lock);
+	return val;
+}
+
+static void dir_cache_update(struct inode *dir, f2fs_hash_t hash,
+					unsigned int val, bool create)
+{
+	struct f2fs_sb_info *sbi = F2FS_I_SB(dir);
+	struct f2fs_dir_cache *dc, *new = NULL;
+	struct dir_cache_slot *s;
+
+	if (create && !READ_ONCE(F2FS_I(dir)->dir_cache)) {
+		new = kmalloc(sizeof(*new), GFP_NOFS | __GFP_NOWARN);
+		if (!new)
+			return;
+		new->slot = (void *)get_zeroed_page(GFP_NOFS | __GFP_NOWARN);
+		if (!new->slot) {
+			kfree(new);
+			return;
+		}
+		new->inode = dir;
+	}
+
+	spin_lock(&sbi->dir_cache_lock);
+	dc = F2FS_I(dir)->dir_cache;
+	if (!dc && new) {
+		dc = new;
+		new = NULL;
+		F2FS_I(dir)->dir_cache = dc;
+		list_add_tail(&dc->list, &sbi->dir_cache_list);
+		atomic_inc(&sbi->total_dir_cache);
+	}
+	if (dc) {
+		s = dir_cache_slot(dc, hash);
+		s->hash = hash;
+		s->val = val;
+	}
+	spin_unlock(&sbi->dir_cache_lock);
+
+	if (new) {
+		free_page((unsigned long)new->slot);
+		kfree(new);
+	}
+}
+
+void f2fs_destroy_dir_cache(struct inode *inode)
+{
+	struct f2fs_sb_info *sbi = F2FS_I_SB(inode);
+	struct f2fs_dir_cache *dc;
+
+	if (!READ_ONCE(F2FS_I(inode)->dir_cache))
+		return;
+
+	spin_lock(&sbi->dir_cache_lock);
+	dc = F2FS_I(inode)->dir_cache;
+	if (dc) {
+		F2FS_I(inode)->dir_cache = NULL;
+		list_del(&dc->list);
+		atomic_dec(&sbi->total_dir_cache);
+	}
+	spin_unlock(&sbi->dir_cache_lock);
+
+	if (dc) {
+		free_page((unsigned long)dc->slot);
+		kfree(dc);
+	}
+}
+
+unsigned int f2fs_shrink_dir_cache(struct f2fs_sb_info *sbi, int nr_shrink)
+{
+	struct f2fs_dir_cache *dc, *tmp;
+	LIST_HEAD(free_list);
+	unsigned int nr = 0;
+
+	spin_lock(&sbi->dir_cache_lock);
+	while (nr < nr_shrink && !list_empty(&sbi->dir_cache_list)) {
+		dc = list_first_entry(&sbi->dir_cache_list,
+					struct f2fs_dir_cache, list);
+		F2FS_I(dc->inode)->dir_cache = NULL;
+		list_move_tail(&dc->list, &free_list);
+		atomic_dec(&sbi->total_dir_cache);
+		nr++;
+	}
+	spin_unlock(&sbi->dir_cache_lock);
+
+	list_for_each_entry_safe(dc, tmp, &free_list, list) {
+		free_page((unsigned long)dc->slot);
+		kfree(dc);
+	}
+	return nr;
+}
+
+/* whether a live entry of @dentry_blk, of whatever name, has @namehash */
+static bool hash_in_block(struct f2fs_dentry_block *dentry_blk,
+					f2fs_hash_t namehash)
+{
+	struct f2fs_dir_entry *de;
+	unsigned int bit_pos = 0;
+
+	while (1) {
+		bit_pos = find_next_bit_le(&dentry_blk->dentry_bitmap,
+						NR_DENTRY_IN_BLOCK, bit_pos);
+		if (bit_pos >= NR_DENTRY_IN_BLOCK)
+			return false;
+
+		de = &dentry_blk->dentry[bit_pos];
+		if (!de->name_len) {
+			bit_pos++;
+			continue;
+		}
+		if (de->hash_code == namehash)
+			return true;
+		bit_pos += GET_DENTRY_SLOTS(le16_to_cpu(de->name_len));
+	}
+}
+
 static struct f2fs_dir_entry *find_in_block(struct inode *dir,
 				struct page *dentry_page,
 				struct fscrypt_name *fname,
 				f2fs_hash_t namehash,
 				int *max_slots,
 				struct page **res_page,
-				struct fscrypt_str *fstr)
+				struct fscrypt_str *fstr,
+				bool *hash_seen)
 {
 	struct f2fs_dentry_block *dentry_blk;
 	struct f2fs_dir_entry *de;
@@ -94,10 +273,13 @@ static struct f2fs_dir_entry *find_in_block(struct inode *dir,
 
 	make_dentry_ptr(NULL, &d, (void *)dentry_blk, 1);
 	de = find_target_dentry(dir, fname, namehash, max_slots, &d, fstr);
-	if (de)
+	if (de) {
 		*res_page = dentry_page;
-	else
+	} else {
+		if (hash_seen && !*hash_seen)
+			*hash_seen = hash_in_block(dentry_blk, namehash);
 		kunmap(dentry_page);
+	}
 
 	return de;
 }
@@ -218,23 +400,18 @@ found:
 static struct f2fs_dir_entry *find_in_level(struct inode *dir,
 					unsigned int level,
 					struct fscrypt_name *fname,
+					f2fs_hash_t namehash,
 					struct page **res_page,
-					struct fscrypt_str *fstr)
+					struct fscrypt_str *fstr,
+					bool *hash_seen)
 {
-	struct qstr name = FSTR_TO_QSTR(&fname->disk_name);
-	int s = GET_DENTRY_SLOTS(name.len);
+	int s = GET_DENTRY_SLOTS(fname->disk_name.len);
 	unsigned int nbucket, nblock;
 	unsigned int bidx, end_block;
 	struct page *dentry_page;
 	struct f2fs_dir_entry *de = NULL;
 	bool room = false;
 	int max_slots;
-	f2fs_hash_t namehash;
-
-	if(fname->hash)
-		namehash = cpu_to_le32(fname->hash);
-	else
-		namehash = f2fs_dentry_hash(&name);
 
 	nbucket = dir_buckets(level, F2FS_I(dir)->i_dir_level);
 	nblock = bucket_blocks(level);
@@ -252,7 +429,7 @@ static struct f2fs_dir_entry *find_in_level(struct inode *dir,
 		}
 
 		de = find_in_block(dir, dentry_page, fname, namehash, &max_slots,
-						res_page, fstr);
+						res_page, fstr, hash_seen);
 		if (de)
 			break;
 
@@ -269,12 +446,54 @@ static struct f2fs_dir_entry *find_in_level(struct inode *dir,
 	return de;
 }
 
+/*
+ * Look @fname up through the lookup cache of @dir. Returns the entry, or
+ * NULL with *negative set when the cache knows there is none.
+ */
+static struct f2fs_dir_entry *find_in_dir_cache(struct inode *dir,
+					struct fscrypt_name *fname,
+					f2fs_hash_t namehash,
+					struct page **res_page,
+					bool *negative)
+{
+	struct page *dentry_page;
+	struct f2fs_dir_entry *de;
+	unsigned int val;
+
+	val = dir_cache_lookup(dir, namehash);
+	if (!val)
+		return NULL;
+
+	if (val & DIR_CACHE_NEG) {
+		*negative = true;
+		/* tell __f2fs_do_add_link() where the room was */
+		if (val & ~DIR_CACHE_NEG) {
+			F2FS_I(dir)->chash = namehash;
+			F2FS_I(dir)->clevel = (val & ~DIR_CACHE_NEG) - 1;
+		}
+		return NULL;
+	}
+
+	dentry_page = find_data_page(dir, val - 1);
+	if (IS_ERR(dentry_page))
+		return NULL;
+
+	de = find_in_block(dir, dentry_page, fname, namehash, NULL,
+						res_page, NULL, NULL);
+	if (!de)
+		f2fs_put_page(dentry_page, 0);
+	return de;
+}
+
 struct f2fs_dir_entry *__f2fs_find_entry(struct inode *dir,
 			struct fscrypt_name *fname, struct page **res_page,
 			struct fscrypt_str *fstr)
 {
 	unsigned long npages = dir_blocks(dir);
 	struct f2fs_dir_entry *de = NULL;
+	struct qstr name = FSTR_TO_QSTR(&fname->disk_name);
+	f2fs_hash_t namehash;
+	bool use_cache, negative = false, hash_seen = false;
 	unsigned int max_depth;
 	unsigned int level;
 
@@ -298,11 +517,34 @@ struct f2fs_dir_entry *__f2fs_find_entry(struct inode *dir,
 		mark_inode_dirty(dir);
 	}
 
+	if (fname->hash)
+		namehash = cpu_to_le32(fname->hash);
+	else
+		namehash = f2fs_dentry_hash(&name);
+
+	use_cache = dir_cache_wanted(dir, npages, fname, fstr);
+	if (use_cache) {
+		de = find_in_dir_cache(dir, fname, namehash, res_page,
+								&negative);
+		if (de || negative)
+			goto out;
+	}
+
 	for (level = 0; level < max_depth; level++) {
-		de = find_in_level(dir, level, fname, res_page, fstr);
+		de = find_in_level(dir, level, fname, namehash, res_page, fstr,
+					use_cache ? &hash_seen : NULL);
 		if (de)
 			break;
 	}
+
+	if (!use_cache || IS_ERR(de))
+		goto out;
+	if (de)
+		dir_cache_update(dir, namehash, (*res_page)->index + 1, true);
+	else if (!hash_seen)
+		dir_cache_update(dir, namehash, DIR_CACHE_NEG |
+				(F2FS_I(dir)->chash == namehash ?
+				F2FS_I(dir)->clevel + 1 : 0), true);
 out:
 	return de;
 }
@@ -680,6 +922,7 @@ add_dentry:
 
 	make_dentry_ptr(NULL, &d, (void *)dentry_blk, 1);
 	f2fs_update_dentry(ino, mode, &d, &new_name, dentry_hash, bit_pos);
+	dir_cache_update(dir, dentry_hash, block + 1, false);
 
 	set_page_dirty(dentry_page);
 
@@ -934,6 +1177,8 @@ static int f2fs_readdir(struct file *file, struct dir_context *ctx)
 	unsigned int n = ((unsigned long)ctx->pos / NR_DENTRY_IN_BLOCK);
 	struct f2fs_dentry_ptr d;
 	struct fscrypt_str fstr = FSTR_INIT(NULL, 0);
+	unsigned int min_blocks = F2FS_I_SB(inode)->dir_cache_blocks;
+	pgoff_t ra_pages = MAX_DIR_RA_PAGES;
 	int err = 0;
 
 	if (f2fs_encrypted_inode(inode)) {
@@ -951,12 +1196,15 @@ static int f2fs_readdir(struct file *file, struct dir_context *ctx)
 		goto out;
 	}
 
-	/* readahead for multi pages of dir */
-	if (npages - n > 1 && !ra_has_index(ra, n))
-		page_cache_sync_readahead(inode->i_mapping, ra, file, n,
-				min(npages - n, (pgoff_t)MAX_DIR_RA_PAGES));
+	if (min_blocks && npages >= min_blocks)
+		ra_pages = MAX_LARGE_DIR_RA_PAGES;
 
 	for (; n < npages; n++) {
+		/* readahead for multi pages of dir, again once it is used up */
+		if (npages - n > 1 && !ra_has_index(ra, n))
+			page_cache_sync_readahead(inode->i_mapping, ra, file, n,
+						min(npages - n, ra_pages));
+
 		dentry_page = get_lock_data_page(inode, n, false);
 		if (IS_ERR(dentry_page)) {
 			err = PTR_ERR(dentry_page);
@@ -16,8 +16,28 @@
 
 #include "f2fs.h"
 #include "node.h"
+#include "segment.h"
+#include "xattr.h"
 #include <trace/events/f2fs.h>
 
+/*
+ * Persisted extent map of a large read-mostly file. It lives in a private
+ * xattr and is trusted only while FADVISE_EXTMAP_BIT is set, every change
+ * of the block mapping clears that bit first.
+ */
+#define F2FS_EXTMAP_MAGIC	0xF2F5E3A9
+#define F2FS_EXTMAP_MAX		64
+
+struct f2fs_extent_map {
+	__le32 magic;
+	__le32 nr;
+	__le64 i_size;			/* file size when persisted */
+	__le64 i_blocks;		/* block count when persisted */
+	struct f2fs_extent ext[F2FS_EXTMAP_MAX];
+} __packed;
+
+#define F2FS_EXTMAP_HDR_SIZE	offsetof(struct f2fs_extent_map, ext)
+
 static struct kmem_cache *extent_tree_slab;
 static struct kmem_cache *extent_node_slab;
 
@@ -537,12 +557,74 @@ static unsigned int f2fs_update_extent_tree_range(struct inode *inode,
 	return !__is_extent_same(&prev, &et->largest);
 }
 
+/*
+ * Add a mapping which did not change, only was read back from a dnode or from
+ * the persisted map. Cached nodes it overlaps map the same blocks, so they
+ * are absorbed instead of being split like on an update.
+ */
+static void __cache_extent_tree_range(struct inode *inode, pgoff_t fofs,
+				block_t blkaddr, unsigned int len)
+{
+	struct f2fs_sb_info *sbi = F2FS_I_SB(inode);
+	struct extent_tree *et = F2FS_I(inode)->extent_tree;
+	struct extent_node *en, *prev_en, *next_en;
+	struct rb_node **insert_p, *insert_parent, *node;
+	struct extent_info ei;
+	unsigned int end = fofs + len;
+	bool absorbed = false;
+
+	if (!et)
+		return;
+
+	write_lock(&et->lock);
+
+	if (is_inode_flag_set(F2FS_I(inode), FI_NO_EXTENT))
+		goto out;
+
+	set_extent_info(&ei, fofs, blkaddr, len);
+
+	en = __lookup_extent_tree_ret(et, fofs, &prev_en, &next_en,
+					&insert_p, &insert_parent);
+	if (!en)
+		en = next_en;
+
+	while (en && en->ei.fofs < end) {
+		/* never trust a range which disagrees with the tree */
+		if (en->ei.blk + fofs != blkaddr + en->ei.fofs)
+			goto out;
+
+		node = rb_next(&en->rb_node);
+
+		if (en->ei.fofs < ei.fofs) {
+			ei.len += ei.fofs - en->ei.fofs;
+			ei.fofs = en->ei.fofs;
+			ei.blk = en->ei.blk;
+		}
+		if (en->ei.fofs + en->ei.len > ei.fofs + ei.len)
+			ei.len = en->ei.fofs + en->ei.len - ei.fofs;
+
+		__release_extent_node(sbi, et, en);
+		absorbed = true;
+
+		en = node ? rb_entry(node, struct extent_node, rb_node) : NULL;
+	}
+
+	if (absorbed)
+		__lookup_extent_tree_ret(et, ei.fofs, &prev_en, &next_en,
+					&insert_p, &insert_parent);
+
+	if (!__try_merge_extent_node(sbi, et, &ei, prev_en, next_en))
+		__insert_extent_tree(sbi, et, &ei, insert_p, insert_parent);
+out:
+	write_unlock(&et->lock);
+}
+
 unsigned int f2fs_shrink_extent_tree(struct f2fs_sb_info *sbi, int nr_shrink)
 {
 	struct extent_tree *et, *next;
 	struct extent_node *en;
 	unsigned int node_cnt = 0, tree_cnt = 0;
-	int remained;
+	int remained, skipped = 0;
 
 	if (!test_opt(sbi, EXTENT_CACHE))
 		return 0;
@@ -594,6 +676,18 @@ free_node:
 			continue;
 		}
 
+		/*
+		 * a long extent saves walking several dnodes on a miss while a
+		 * short fragment saves one, so let short ones go first.
+		 */
+		if (en->ei.len >= F2FS_MIN_EXTENT_LEN && skipped < nr_shrink) {
+			write_unlock(&et->lock);
+			list_move_tail(&en->list, &sbi->extent_list);
+			skipped++;
+			remained++;
+			continue;
+		}
+
 		list_del_init(&en->list);
 		spin_unlock(&sbi->extent_lock);
 
@@ -672,13 +766,36 @@ bool f2fs_lookup_extent_cache(struct inode *inode, pgoff_t pgofs,
 	return f2fs_lookup_extent_tree(inode, pgofs, ei);
 }
 
+/*
+ * The block mapping of @inode changed, so its persisted extent map is stale.
+ * Returns true if the inode has to be written back to drop the map.
+ */
+static bool __drop_extent_map(struct inode *inode)
+{
+	struct extent_tree *et = F2FS_I(inode)->extent_tree;
+
+	/* pairs with the generation check in f2fs_persist_extent_map() */
+	if (et && test_opt(F2FS_I_SB(inode), EXTENT_MAP)) {
+		write_lock(&et->lock);
+		et->map_gen++;
+		write_unlock(&et->lock);
+	}
+
+	if (!file_has_extmap(inode))
+		return false;
+
+	file_clear_extmap(inode);
+	return true;
+}
+
 void f2fs_update_extent_cache(struct dnode_of_data *dn)
 {
 	pgoff_t fofs;
 	block_t blkaddr;
+	bool dirty = __drop_extent_map(dn->inode);
 
 	if (!f2fs_may_extent_tree(dn->inode))
-		return;
+		goto out;
 
 	if (dn->data_blkaddr == NEW_ADDR)
 		blkaddr = NULL_ADDR;
@@ -689,6 +806,9 @@ void f2fs_update_extent_cache(struct dnode_of_data *dn)
 								dn->ofs_in_node;
 
 	if (f2fs_update_extent_tree_range(dn->inode, fofs, blkaddr, 1))
+		dirty = true;
+out:
+	if (dirty)
 		sync_inode_page(dn);
 }
 
@@ -696,13 +816,208 @@ void f2fs_update_extent_cache_range(struct dnode_of_data *dn,
 				pgoff_t fofs, block_t blkaddr, unsigned int len)
 
 {
-	if (!f2fs_may_extent_tree(dn->inode))
-		return;
+	bool dirty = __drop_extent_map(dn->inode);
+
+	if (f2fs_may_extent_tree(dn->inode) &&
+			f2fs_update_extent_tree_range(dn->inode, fofs,
+							blkaddr, len))
+		dirty = true;
 
-	if (f2fs_update_extent_tree_range(dn->inode, fofs, blkaddr, len))
+	if (dirty)
 		sync_inode_page(dn);
 }
 
+/*
+ * Cache a mapping which was just looked up in a dnode. The caller holds the
+ * dnode, so no update of the same range can slip in between. The mapping
+ * did not change, a new largest extent reaches i_ext with the next inode
+ * update instead of dirtying the inode on a read.
+ */
+void f2fs_cache_extent_range(struct dnode_of_data *dn, pgoff_t fofs,
+				block_t blkaddr, unsigned int len)
+{
+	if (!len || !test_opt(F2FS_I_SB(dn->inode), EXTENT_MAP) ||
+			!f2fs_may_extent_tree(dn->inode))
+		return;
+
+	__cache_extent_tree_range(dn->inode, fofs, blkaddr, len);
+}
+
+static bool __extent_map_valid(struct f2fs_sb_info *sbi, struct inode *inode,
+				struct f2fs_extent_map *map, int size)
+{
+	unsigned int i, nr, end = 0;
+
+	if (size < (int)F2FS_EXTMAP_HDR_SIZE ||
+			le32_to_cpu(map->magic) != F2FS_EXTMAP_MAGIC)
+		return false;
+
+	nr = le32_to_cpu(map->nr);
+	if (nr > F2FS_EXTMAP_MAX ||
+			size != F2FS_EXTMAP_HDR_SIZE +
+				nr * sizeof(struct f2fs_extent))
+		return false;
+
+	if (le64_to_cpu(map->i_size) != i_size_read(inode) ||
+			le64_to_cpu(map->i_blocks) != inode->i_blocks)
+		return false;
+
+	for (i = 0; i < nr; i++) {
+		unsigned int fofs = le32_to_cpu(map->ext[i].fofs);
+		block_t blk = le32_to_cpu(map->ext[i].blk);
+		unsigned int len = le32_to_cpu(map->ext[i].len);
+
+		if (!len || fofs < end || fofs + len < fofs ||
+				fofs + len > F2FS_MAX_BLOCKS)
+			return false;
+		if (blk < MAIN_BLKADDR(sbi) || blk + len < blk ||
+				blk + len > MAX_BLKADDR(sbi))
+			return false;
+		end = fofs + len;
+	}
+	return true;
+}
+
+/* Called from f2fs_iget(), fills a fresh extent tree from the persisted map */
+void f2fs_load_extent_map(struct inode *inode)
+{
+	struct f2fs_sb_info *sbi = F2FS_I_SB(inode);
+	struct extent_tree *et = F2FS_I(inode)->extent_tree;
+	struct f2fs_extent_map *map;
+	unsigned int i;
+	int size;
+
+	if (!file_has_extmap(inode) || !test_opt(sbi, EXTENT_MAP) ||
+			!f2fs_may_extent_tree(inode) || !et)
+		return;
+
+	/* a zombie tree survived the last eviction, it is as good */
+	if (atomic_read(&et->node_cnt) > 1)
+		return;
+
+	map = kmalloc(sizeof(*map), GFP_NOFS);
+	if (!map)
+		return;
+
+	size = f2fs_getxattr(inode, F2FS_XATTR_INDEX_EXTENT_MAP, "",
+						map, sizeof(*map), NULL);
+	if (!__extent_map_valid(sbi, inode, map, size)) {
+		/* written back with the next inode update */
+		file_clear_extmap(inode);
+		goto out;
+	}
+
+	for (i = 0; i < le32_to_cpu(map->nr); i++)
+		__cache_extent_tree_range(inode,
+					le32_to_cpu(map->ext[i].fofs),
+					le32_to_cpu(map->ext[i].blk),
+					le32_to_cpu(map->ext[i].len));
+
+	et->map_nr = atomic_read(&et->node_cnt);
+out:
+	kfree(map);
+}
+
+/* Called with et->lock held, keeps the longest extents if not all fit */
+static unsigned int __build_extent_map(struct extent_tree *et,
+					struct f2fs_extent_map *map)
+{
+	unsigned int hist[32] = { 0 };
+	unsigned int cnt = 0, min_len, nr = 0;
+	struct rb_node *node;
+	struct extent_node *en;
+	int order;
+
+	for (node = rb_first(&et->root); node; node = rb_next(node)) {
+		en = rb_entry(node, struct extent_node, rb_node);
+		hist[ilog2(en->ei.len)]++;
+	}
+
+	for (order = ARRAY_SIZE(hist) - 1; order >= 0; order--) {
+		if (cnt + hist[order] > F2FS_EXTMAP_MAX)
+			break;
+		cnt += hist[order];
+	}
+	min_len = 1U << (order + 1);
+
+	for (node = rb_first(&et->root); node; node = rb_next(node)) {
+		en = rb_entry(node, struct extent_node, rb_node);
+		if (en->ei.len < min_len)
+			continue;
+		set_raw_extent(&en->ei, &map->ext[nr]);
+		nr++;
+	}
+	map->nr = cpu_to_le32(nr);
+	return nr;
+}
+
+/*
+ * Called when the last reader of @inode closes it. Files which fit in the
+ * direct pointers of the inode page gain nothing, their mapping comes with
+ * the inode itself.
+ */
+void f2fs_persist_extent_map(struct inode *inode)
+{
+	struct f2fs_sb_info *sbi = F2FS_I_SB(inode);
+	struct extent_tree *et = F2FS_I(inode)->extent_tree;
+	struct f2fs_extent_map *map;
+	unsigned int gen, nr_node, nr;
+	bool persisted = false;
+
+	if (!test_opt(sbi, EXTENT_MAP) || !et || !f2fs_may_extent_tree(inode))
+		return;
+	if (f2fs_readonly(sbi->sb) || unlikely(f2fs_cp_error(sbi)))
+		return;
+	if (atomic_read(&inode->i_writecount) > 0 ||
+			i_size_read(inode) <=
+			(loff_t)ADDRS_PER_INODE(inode) << PAGE_CACHE_SHIFT)
+		return;
+
+	nr_node = atomic_read(&et->node_cnt);
+	if (nr_node < 2 || (file_has_extmap(inode) && nr_node <= et->map_nr))
+		return;
+
+	map = kmalloc(sizeof(*map), GFP_NOFS);
+	if (!map)
+		return;
+
+	read_lock(&et->lock);
+	gen = et->map_gen;
+	nr_node = atomic_read(&et->node_cnt);
+	nr = __build_extent_map(et, map);
+	read_unlock(&et->lock);
+
+	if (nr < 2)
+		goto out;
+
+	map->magic = cpu_to_le32(F2FS_EXTMAP_MAGIC);
+	map->i_size = cpu_to_le64(i_size_read(inode));
+	map->i_blocks = cpu_to_le64(inode->i_blocks);
+
+	/* an old map must not stay valid on disk while it is replaced */
+	file_clear_extmap(inode);
+	if (f2fs_setxattr(inode, F2FS_XATTR_INDEX_EXTENT_MAP, "", map,
+				F2FS_EXTMAP_HDR_SIZE +
+				nr * sizeof(struct f2fs_extent), NULL, 0))
+		goto out;
+
+	write_lock(&et->lock);
+	if (et->map_gen == gen) {
+		file_set_extmap(inode);
+		et->map_nr = nr_node;
+		persisted = true;
+	}
+	write_unlock(&et->lock);
+
+	if (persisted) {
+		f2fs_lock_op(sbi);
+		update_inode_page(inode);
+		f2fs_unlock_op(sbi);
+	}
+out:
+	kfree(map);
+}
+
 void init_extent_cache_info(struct f2fs_sb_info *sbi)
 {
 	INIT_RADIX_TREE(&sbi->extent_tree_root, GFP_NOIO);
@@ -713,6 +1028,7 @@ void init_extent_cache_info(struct f2fs_sb_info *sbi)
 	INIT_LIST_HEAD(&sbi->zombie_list);
 	atomic_set(&sbi->total_zombie_tree, 0);
 	atomic_set(&sbi->total_ext_node, 0);
+	sbi->max_extent_nodes = DEF_MAX_EXTENT_NODES;
 }
 
 int __init create_extent_cache(void)
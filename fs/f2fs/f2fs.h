@@ -102,6 +102,7 @@ extern struct dsm_client *f2fs_dclient;
 #define F2FS_MOUNT_EXTENT_CACHE		0x00002000
 #define F2FS_MOUNT_FORCE_FG_GC		0x00004000
 #define F2FS_MOUNT_DATA_FLUSH		0x00008000
+#define F2FS_MOUNT_EXTENT_MAP		0x00010000
 #define F2FS_MOUNT_FORCE_CRC        	0x80000000
 #define F2FS_MOUNT_INLINE_ENCRYPT	0x40000000
 #define F2FS_MOUNT_FORCE_NO_INLINE_ENC	0x20000000
@@ -245,6 +246,13 @@ struct discard_entry {
 	int len;		/* # of consecutive blocks of the discard */
 };
 
+/* a range of freed blocks waiting for the discard thread */
+struct discard_cmd {
+	struct rb_node rb_node;	/* in discard_cmd_control->root */
+	block_t lstart;		/* first block of the range */
+	block_t len;		/* # of blocks, adjacent ranges are merged */
+};
+
 /* for the list of fsync inodes, used only during recovery */
 struct fsync_inode_entry {
 	struct list_head list;	/* list head */
@@ -407,6 +415,8 @@ enum {
 #define F2FS_MAX_BLOCKS 0x3F015AFF /* maximum block count per file (923 + 1018*2 + 1018*1018*2 + 1018*1018*1018) */
 
 #define MAX_DIR_RA_PAGES	4	/* maximum ra pages of dir */
+#define MAX_LARGE_DIR_RA_PAGES	32	/* the same, of a dir with lookup cache */
+#define DEF_DIR_CACHE_BLOCKS	32	/* dir blocks to get a lookup cache */
 
 /* vector size for gang look-up from extent cache that consists of radix tree */
 #define EXT_TREE_VEC_SIZE	64
@@ -417,6 +427,9 @@ enum {
 /* number of extent info in extent cache we try to shrink */
 #define EXTENT_CACHE_SHRINK_NUMBER	128
 
+/* default cap of extent nodes cached for the whole filesystem */
+#define DEF_MAX_EXTENT_NODES		65536
+
 struct extent_info {
 	unsigned int fofs;		/* start offset in a file */
 	u32 blk;			/* start block address of the extent */
@@ -438,6 +451,8 @@ struct extent_tree {
 	struct list_head list;		/* to be used by sbi->zombie_list */
 	rwlock_t lock;			/* protect extent info rb-tree */
 	atomic_t node_cnt;		/* # of extent node in rb-tree*/
+	unsigned int map_gen;		/* bumped on every mapping change */
+	unsigned int map_nr;		/* # of extent node last persisted */
 };
 
 /*
@@ -474,6 +489,7 @@ struct f2fs_map_blocks {
 #define FADVISE_LOST_PINO_BIT		0x02
 #define FADVISE_ENCRYPT_BIT		0x04
 #define FADVISE_ENC_NAME_BIT		0x08
+#define FADVISE_EXTMAP_BIT		0x10
 #define FADVISE_INLINE_ENCRYPT_BIT	0x80
 
 #define file_is_cold(inode)	is_file(inode, FADVISE_COLD_BIT)
@@ -487,6 +503,9 @@ struct f2fs_map_blocks {
 #define file_clear_encrypt(inode) clear_file(inode, FADVISE_ENCRYPT_BIT)
 #define file_enc_name(inode)	is_file(inode, FADVISE_ENC_NAME_BIT)
 #define file_set_enc_name(inode) set_file(inode, FADVISE_ENC_NAME_BIT)
+#define file_has_extmap(inode)	is_file(inode, FADVISE_EXTMAP_BIT)
+#define file_set_extmap(inode)	set_file(inode, FADVISE_EXTMAP_BIT)
+#define file_clear_extmap(inode) clear_file(inode, FADVISE_EXTMAP_BIT)
 #define file_is_inline_encrypt(inode) \
 		is_file(inode, FADVISE_INLINE_ENCRYPT_BIT)
 #define file_set_inline_encrypt(inode) \
@@ -511,6 +530,7 @@ struct f2fs_inode_info {
 	atomic_t dirty_pages;		/* # of dirty pages */
 	f2fs_hash_t chash;		/* hash value of given file name */
 	unsigned int clevel;		/* maximum level of given file name */
+	struct f2fs_dir_cache *dir_cache;	/* lookup cache of a large dir */
 	nid_t i_xattr_nid;		/* node id that contains xattrs */
 	unsigned long long xattr_ver;	/* cp version of xattr modification */
 
@@ -518,6 +538,12 @@ struct f2fs_inode_info {
 	struct list_head inmem_pages;	/* inmemory pages managed by f2fs */
 	struct mutex inmem_lock;	/* lock for inmemory pages */
 	struct extent_tree *extent_tree;	/* cached extent_tree entry */
+
+	/* fsync latency, see f2fs_print_fsync_info() */
+	unsigned int fsync_count;	/* # of fsync calls */
+	unsigned int fsync_fua_count;	/* # of them done by one FUA write */
+	unsigned int fsync_max_us;	/* the slowest one */
+	unsigned long long fsync_total_us;
 };
 
 static inline void get_extent_info(struct extent_info *ext,
@@ -675,6 +701,26 @@ struct flush_cmd_control {
 	struct llist_node *dispatch_list;	/* list for command dispatch */
 };
 
+struct discard_cmd_control {
+	struct task_struct *f2fs_issue_discard;	/* discard thread */
+	wait_queue_head_t discard_wait_queue;	/* waiting queue for wake-up */
+	wait_queue_head_t discard_done_queue;	/* waiting for issuing range */
+	struct mutex cmd_lock;			/* protects the fields below */
+	struct rb_root root;			/* pending discard_cmds */
+	unsigned int nr_cmds;			/* # of pending discard_cmds */
+	block_t nr_blks;			/* # of pending blocks */
+	block_t issuing_start;			/* range being issued now */
+	block_t issuing_len;
+
+	/* discard_stat in sysfs */
+	u64 issued_cmds;			/* # of discards issued */
+	u64 issued_blks;			/* # of blocks discarded */
+	u64 merged_cmds;			/* ranges merged into another */
+	u64 urgent_cmds;			/* issued while not idle */
+	u64 issue_total_us;			/* time spent in discards */
+	unsigned int issue_max_us;		/* longest discard */
+};
+
 struct f2fs_sm_info {
 	struct sit_info *sit_info;		/* whole segment information */
 	struct free_segmap_info *free_info;	/* free segment information */
@@ -710,6 +756,11 @@ struct f2fs_sm_info {
 	/* for flush command control */
 	struct flush_cmd_control *cmd_control_info;
 
+	/* for asynchronous discard */
+	struct discard_cmd_control *dcc_info;
+	unsigned int max_discard_issue;	/* max. blocks of one discard */
+	unsigned int discard_urgent_secs;	/* free sections to go urgent */
+
 };
 
 /*
@@ -868,6 +919,19 @@ struct f2fs_sb_info {
 	struct list_head zombie_list;		/* extent zombie tree list */
 	atomic_t total_zombie_tree;		/* extent zombie tree count */
 	atomic_t total_ext_node;		/* extent info count */
+	unsigned int max_extent_nodes;		/* cap of total_ext_node */
+
+	/* for lookup cache of large directories, see dir.c */
+	struct list_head dir_cache_list;	/* lru list for shrinker */
+	spinlock_t dir_cache_lock;		/* locking the list and caches */
+	atomic_t total_dir_cache;		/* dir cache count */
+	unsigned int dir_cache_blocks;		/* min dir size to build one */
+
+	/* flush NAT entries in a worker, SIT entries meanwhile, see sysfs */
+	unsigned int cp_parallel;
+
+	/* write a lone fsynced dnode with PREFLUSH|FUA, see sysfs */
+	unsigned int fsync_fua;
 
 	/* basic filesystem units */
 	unsigned int log_sectors_per_block;	/* log2 sectors per block */
@@ -941,8 +1005,14 @@ struct f2fs_sb_info {
 	u64 sectors_written_start;
 	u64 kbytes_written;
 
-	/* Reference to checksum algorithm driver via cryptoapi */
-	struct crypto_shash *s_chksum_driver;
+	/* gc cost seen by this mount, see gc_stat in sysfs */
+	u64 gc_moved_blks;			/* valid blocks moved by gc */
+	atomic_t fg_gc_calls;			/* # of writers stalled by gc */
+	atomic64_t fg_gc_stall_ms;		/* total time of those stalls */
+	unsigned int fg_gc_stall_max_ms;	/* longest one */
+
+	/* predicted length of the next idle period, fed by REQ_TIME */
+	unsigned int idle_pred_ms;
 };
 
 /* For write statistics. Suppose sector size is 512 bytes,
@@ -957,9 +1027,34 @@ struct f2fs_sb_info {
  */
 #define SIZEOF_KBYTES_WRITTEN  8
 
+/* requests closer than this belong to the same burst */
+#define F2FS_IDLE_MIN_GAP_MS	100
+#define F2FS_IDLE_MAX_GAP_MS	600000
+
+/*
+ * Every gap between two requests which is long enough to be an idle period
+ * feeds an average of 1/8 weight, bg gc uses it to guess how long the idle
+ * period it wakes up in is going to last.
+ */
+static inline void f2fs_update_idle_pred(struct f2fs_sb_info *sbi,
+						unsigned long now)
+{
+	unsigned int gap = jiffies_to_msecs(now - sbi->last_time[REQ_TIME]);
+	unsigned int pred = sbi->idle_pred_ms;
+
+	if (gap < F2FS_IDLE_MIN_GAP_MS)
+		return;
+	gap = min_t(unsigned int, gap, F2FS_IDLE_MAX_GAP_MS);
+	sbi->idle_pred_ms = pred ? pred - (pred >> 3) + (gap >> 3) : gap;
+}
+
 static inline void f2fs_update_time(struct f2fs_sb_info *sbi, int type)
 {
-	sbi->last_time[type] = jiffies;
+	unsigned long now = jiffies;
+
+	if (type == REQ_TIME)
+		f2fs_update_idle_pred(sbi, now);
+	sbi->last_time[type] = now;
 }
 
 static inline bool f2fs_time_over(struct f2fs_sb_info *sbi, int type)
@@ -979,6 +1074,10 @@ static inline bool is_idle(struct f2fs_sb_info *sbi)
 	if (rl->count[BLK_RW_SYNC] || rl->count[BLK_RW_ASYNC])
 		return 0;
 
+	/* blk-mq queues leave root_rl alone, ask the partition instead */
+	if (bdev->bd_part && part_in_flight(bdev->bd_part))
+		return 0;
+
 	return f2fs_time_over(sbi, REQ_TIME);
 }
 
@@ -988,18 +1087,7 @@ static inline bool is_idle(struct f2fs_sb_info *sbi)
 static inline u32 f2fs_crc32(struct f2fs_sb_info *sbi, const void *address,
 			   unsigned int length)
 {
-	SHASH_DESC_ON_STACK(shash, sbi->s_chksum_driver);
-	u32 *ctx = (u32 *)shash_desc_ctx(shash);
-	int err;
-
-	shash->tfm = sbi->s_chksum_driver;
-	shash->flags = 0;
-	*ctx = F2FS_SUPER_MAGIC;
-
-	err = crypto_shash_update(shash, address, length);
-	BUG_ON(err);
-
-	return *ctx;
+	return crc32_le(F2FS_SUPER_MAGIC, address, length);
 }
 
 static inline bool f2fs_crc_valid(struct f2fs_sb_info *sbi, __u32 blk_crc,
@@ -1929,6 +2017,8 @@ void f2fs_delete_entry(struct f2fs_dir_entry *, struct page *, struct inode *,
 							struct inode *);
 int f2fs_do_tmpfile(struct inode *, struct inode *);
 bool f2fs_empty_dir(struct inode *);
+void f2fs_destroy_dir_cache(struct inode *);
+unsigned int f2fs_shrink_dir_cache(struct f2fs_sb_info *, int);
 
 static inline int f2fs_add_link(struct dentry *dentry, struct inode *inode)
 {
@@ -1975,7 +2065,7 @@ struct page *get_node_page(struct f2fs_sb_info *, pgoff_t);
 struct page *get_node_page_ra(struct page *, int);
 void sync_inode_page(struct dnode_of_data *);
 int fsync_node_pages(struct f2fs_sb_info *, nid_t, struct writeback_control *,
-								bool);
+							bool, struct page **);
 int sync_node_pages(struct f2fs_sb_info *, struct writeback_control *);
 void build_free_nids(struct f2fs_sb_info *, bool);
 bool alloc_nid(struct f2fs_sb_info *, nid_t *);
@@ -2009,6 +2099,8 @@ void f2fs_balance_fs_bg(struct f2fs_sb_info *);
 int f2fs_issue_flush(struct f2fs_sb_info *);
 int create_flush_cmd_control(struct f2fs_sb_info *);
 void destroy_flush_cmd_control(struct f2fs_sb_info *);
+int create_discard_cmd_control(struct f2fs_sb_info *);
+void destroy_discard_cmd_control(struct f2fs_sb_info *);
 void invalidate_blocks(struct f2fs_sb_info *, block_t);
 bool is_checkpointed_data(struct f2fs_sb_info *, block_t);
 void refresh_sit_entry(struct f2fs_sb_info *, block_t, block_t);
@@ -2074,6 +2166,7 @@ void destroy_checkpoint_caches(void);
  * data.c
  */
 void f2fs_submit_merged_bio(struct f2fs_sb_info *, enum page_type, int);
+bool f2fs_submit_merged_bio_fua(struct f2fs_sb_info *, struct page *);
 void f2fs_submit_merged_bio_cond(struct f2fs_sb_info *, struct inode *,
 				struct page *, nid_t, enum page_type, int);
 void f2fs_flush_merged_bios(struct f2fs_sb_info *);
@@ -2122,6 +2215,7 @@ struct f2fs_stat_info {
 	unsigned long long hit_largest, hit_cached, hit_rbtree;
 	unsigned long long hit_total, total_ext;
 	int ext_tree, zombie_tree, ext_node;
+	int dir_cache;
 	int ndirty_node, ndirty_meta;
 	int ndirty_dent, ndirty_dirs, ndirty_data, ndirty_files;
 	int nats, dirty_nats, sits, dirty_sits, fnids;
@@ -2134,6 +2228,10 @@ struct f2fs_stat_info {
 	int rsvd_segs, overp_segs;
 	int dirty_count, node_pages, meta_pages;
 	int prefree_count, call_count, cp_count, bg_cp_count;
+	/* checkpoint duration, and how long operations were blocked */
+	unsigned int cp_last_ms, cp_max_ms;
+	unsigned int cp_blocked_last_ms, cp_blocked_max_ms;
+	unsigned long long cp_total_ms, cp_blocked_total_ms;
 	int tot_segs, node_segs, data_segs, free_segs, free_secs;
 	int bg_node_segs, bg_data_segs;
 	int tot_blks, data_blks, node_blks;
@@ -2155,6 +2253,16 @@ static inline struct f2fs_stat_info *F2FS_STAT(struct f2fs_sb_info *sbi)
 
 #define stat_inc_cp_count(si)		((si)->cp_count++)
 #define stat_inc_bg_cp_count(si)	((si)->bg_cp_count++)
+#define stat_update_cp_time(si, total, blocked)				\
+	do {								\
+		(si)->cp_last_ms = (total);				\
+		(si)->cp_max_ms = max((si)->cp_max_ms, (total));	\
+		(si)->cp_total_ms += (total);				\
+		(si)->cp_blocked_last_ms = (blocked);			\
+		(si)->cp_blocked_max_ms =				\
+			max((si)->cp_blocked_max_ms, (blocked));	\
+		(si)->cp_blocked_total_ms += (blocked);			\
+	} while (0)
 #define stat_inc_call_count(si)		((si)->call_count++)
 #define stat_inc_bggc_count(sbi)	((sbi)->bg_gc++)
 #define stat_inc_dirty_inode(sbi, type)	((sbi)->ndirty_inode[type]++)
@@ -2238,6 +2346,7 @@ void f2fs_destroy_root_stats(void);
 #else
 #define stat_inc_cp_count(si)
 #define stat_inc_bg_cp_count(si)
+#define stat_update_cp_time(si, total, blocked)
 #define stat_inc_call_count(si)
 #define stat_inc_bggc_count(si)
 #define stat_inc_dirty_inode(sbi, type)
@@ -2324,6 +2433,10 @@ bool f2fs_lookup_extent_cache(struct inode *, pgoff_t, struct extent_info *);
 void f2fs_update_extent_cache(struct dnode_of_data *);
 void f2fs_update_extent_cache_range(struct dnode_of_data *dn,
 						pgoff_t, block_t, unsigned int);
+void f2fs_cache_extent_range(struct dnode_of_data *, pgoff_t, block_t,
+							unsigned int);
+void f2fs_load_extent_map(struct inode *);
+void f2fs_persist_extent_map(struct inode *);
 void init_extent_cache_info(struct f2fs_sb_info *);
 int __init create_extent_cache(void);
 void destroy_extent_cache(void);
@@ -16,6 +16,7 @@
 #include <linux/blkdev.h>
 #include <linux/f2fs_fs.h>
 #include <linux/sysfs.h>
+#include <linux/ratelimit.h>
 
 #include "f2fs.h"
 
@@ -164,3 +165,42 @@ void f2fs_print_ckpt_info(struct f2fs_sb_info *sbi)
 	printk("\n\n");
 }
 
+
+/* fsync slower than this is reported to the kernel message */
+#define F2FS_SLOW_FSYNC_US	(200 * USEC_PER_MSEC)
+
+/* print the fsync latency of one inode, like the ones above */
+static void f2fs_print_fsync_info(struct inode *inode, s64 lat_us)
+{
+	struct f2fs_inode_info *fi = F2FS_I(inode);
+
+	pr_warn("F2FS-fs:slow fsync of ino %lu: %lld us\n",
+					inode->i_ino, lat_us);
+	DISP_u32(fi, fsync_count);
+	DISP_u32(fi, fsync_fua_count);
+	DISP_u32(fi, fsync_max_us);
+	DISP_u64(fi, fsync_total_us);
+}
+
+/*
+ * Account one fsync of @inode, the fields are only statistics and are not
+ * serialized against concurrent fsyncs of the same inode.
+ */
+void f2fs_update_fsync_info(struct inode *inode, s64 lat_us, bool fua)
+{
+	static DEFINE_RATELIMIT_STATE(rs, 5 * HZ, 10);
+	struct f2fs_inode_info *fi = F2FS_I(inode);
+
+	if (lat_us < 0)
+		lat_us = 0;
+
+	fi->fsync_count++;
+	if (fua)
+		fi->fsync_fua_count++;
+	fi->fsync_total_us += lat_us;
+	if (lat_us > fi->fsync_max_us)
+		fi->fsync_max_us = min_t(s64, lat_us, UINT_MAX);
+
+	if (lat_us >= F2FS_SLOW_FSYNC_US && __ratelimit(&rs))
+		f2fs_print_fsync_info(inode, lat_us);
+}
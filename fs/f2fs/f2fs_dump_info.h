@@ -5,5 +5,6 @@
 
 void f2fs_print_raw_sb_info(struct f2fs_sb_info *sbi);
 void f2fs_print_ckpt_info(struct f2fs_sb_info *sbi);
+void f2fs_update_fsync_info(struct inode *inode, s64 lat_us, bool fua);
 
 #endif
@@ -29,6 +29,7 @@
 #include "acl.h"
 #include "gc.h"
 #include "trace.h"
+#include "f2fs_dump_info.h"
 #include <trace/events/f2fs.h>
 
 static int f2fs_vm_page_mkwrite(struct vm_area_struct *vma,
@@ -104,6 +105,7 @@ static const struct vm_operations_struct f2fs_file_vm_ops = {
 	.fault		= filemap_fault,
 	.map_pages	= filemap_map_pages,
 	.page_mkwrite	= f2fs_vm_page_mkwrite,
+	.speculative	= true,
 };
 
 static int get_parent_ino(struct inode *inode, nid_t *pino)
@@ -191,6 +193,10 @@ static int f2fs_do_sync_file(struct file *file, loff_t start, loff_t end,
 	nid_t ino = inode->i_ino;
 	int ret = 0;
 	bool need_cp = false;
+	struct page *fua_page = NULL;
+	int nr_node = 0;
+	bool fua = false;
+	ktime_t start;
 	struct writeback_control wbc = {
 		.sync_mode = WB_SYNC_ALL,
 		.nr_to_write = LONG_MAX,
@@ -201,6 +207,7 @@ static int f2fs_do_sync_file(struct file *file, loff_t start, loff_t end,
 		return 0;
 
 	trace_f2fs_sync_file_enter(inode);
+	start = ktime_get();
 
 	/* if fdatasync is triggered, let's do in-place-update */
 	if (datasync || get_dirty_pages(inode) <= SM_I(sbi)->min_fsync_blocks)
@@ -257,9 +264,11 @@ go_write:
 		goto out;
 	}
 sync_nodes:
-	ret = fsync_node_pages(sbi, ino, &wbc, atomic);
-	if (ret)
+	ret = fsync_node_pages(sbi, ino, &wbc, atomic, &fua_page);
+	if (ret < 0)
 		goto out;
+	nr_node += ret;
+	ret = 0;
 
 	/* if cp_error was enabled, we should avoid infinite loop */
 	if (unlikely(f2fs_cp_error(sbi))) {
@@ -273,6 +282,13 @@ sync_nodes:
 		goto sync_nodes;
 	}
 
+	/*
+	 * The data is on the device already, so a lone dnode still sitting
+	 * in the merged bio needs no separate cache flush afterwards.
+	 */
+	if (sbi->fsync_fua && nr_node == 1 && !test_opt(sbi, NOBARRIER))
+		fua = f2fs_submit_merged_bio_fua(sbi, fua_page);
+
 	ret = wait_on_node_pages_writeback(sbi, ino);
 	if (ret)
 		goto out;
@@ -283,9 +299,11 @@ sync_nodes:
 flush_out:
 	remove_ino_entry(sbi, ino, UPDATE_INO);
 	clear_inode_flag(fi, FI_UPDATE_WRITE);
-	ret = f2fs_issue_flush(sbi);
+	if (!fua)
+		ret = f2fs_issue_flush(sbi);
 	f2fs_update_time(sbi, REQ_TIME);
 out:
+	f2fs_update_fsync_info(inode, ktime_us_delta(ktime_get(), start), fua);
 	trace_f2fs_sync_file_exit(inode, need_cp, datasync, ret);
 	f2fs_trace_ios(NULL, 1);
 	return ret;
@@ -1273,8 +1291,11 @@ static int f2fs_release_file(struct inode *inode, struct file *filp)
 	 * f2fs_relase_file is called at every close calls. So we should
 	 * not drop any inmemory pages by close called by other process.
 	 */
-	if (!(filp->f_mode & FMODE_WRITE) ||
-			atomic_read(&inode->i_writecount) != 1)
+	if (!(filp->f_mode & FMODE_WRITE)) {
+		f2fs_persist_extent_map(inode);
+		return 0;
+	}
+	if (atomic_read(&inode->i_writecount) != 1)
 		return 0;
 
 	/* some remained atomic pages should discarded */
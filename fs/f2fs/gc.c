@@ -16,6 +16,7 @@
 #include <linux/kthread.h>
 #include <linux/delay.h>
 #include <linux/freezer.h>
+#include <linux/fb.h>
 
 #include "f2fs.h"
 #include "node.h"
@@ -23,11 +24,41 @@
 #include "gc.h"
 #include <trace/events/f2fs.h>
 
+/*
+ * Moving a section takes about sec_cost_ms. Only start when the idle period
+ * we are in, going by the length of the last ones, still has that much left.
+ * One which already outlived the prediction is taken as a long one.
+ */
+static bool gc_idle_window(struct f2fs_sb_info *sbi,
+					struct f2fs_gc_kthread *gc_th)
+{
+	unsigned int idle = jiffies_to_msecs(jiffies -
+					sbi->last_time[REQ_TIME]);
+	unsigned int pred = READ_ONCE(sbi->idle_pred_ms);
+
+	if (idle < F2FS_IDLE_MIN_GAP_MS)
+		return false;
+	if (!pred || !gc_th->sec_cost_ms || idle >= pred)
+		return true;
+	return pred - idle >= gc_th->sec_cost_ms;
+}
+
+static void gc_update_sec_cost(struct f2fs_gc_kthread *gc_th,
+						unsigned long start)
+{
+	unsigned int cost = jiffies_to_msecs(jiffies - start);
+	unsigned int avg = gc_th->sec_cost_ms;
+
+	gc_th->sec_cost_ms = avg ? avg - (avg >> 3) + (cost >> 3) : cost;
+}
+
 static int gc_thread_func(void *data)
 {
 	struct f2fs_sb_info *sbi = data;
 	struct f2fs_gc_kthread *gc_th = sbi->gc_thread;
 	wait_queue_head_t *wq = &sbi->gc_thread->gc_wait_queue_head;
+	unsigned int batch;
+	unsigned long start;
 	long wait_ms;
 
 	wait_ms = gc_th->min_sleep_time;
@@ -37,11 +68,17 @@ static int gc_thread_func(void *data)
 			continue;
 		else
 			wait_event_interruptible_timeout(*wq,
-						kthread_should_stop(),
+						kthread_should_stop() ||
+						gc_th->gc_wake,
 						msecs_to_jiffies(wait_ms));
 		if (kthread_should_stop())
 			break;
 
+		if (gc_th->gc_wake) {
+			gc_th->gc_wake = false;
+			wait_ms = gc_th->min_sleep_time;
+		}
+
 		if (sbi->sb->s_writers.frozen >= SB_FREEZE_WRITE) {
 			increase_sleep_time(gc_th, &wait_ms);
 			continue;
@@ -63,7 +100,7 @@ static int gc_thread_func(void *data)
 		if (!mutex_trylock(&sbi->gc_mutex))
 			continue;
 
-		if (!is_idle(sbi)) {
+		if (!is_idle(sbi) || !gc_idle_window(sbi, gc_th)) {
 			increase_sleep_time(gc_th, &wait_ms);
 			mutex_unlock(&sbi->gc_mutex);
 			continue;
@@ -92,11 +129,34 @@ static int gc_thread_func(void *data)
 		}
 #endif
 #endif
-		/* if return value is not zero, no victim was selected */
-		/*lint -save -e747*/
-		if (f2fs_gc(sbi, test_opt(sbi, FORCE_FG_GC), true))
-			wait_ms = gc_th->no_gc_sleep_time;
-		/*lint -restore*/
+		/*
+		 * With the screen off nobody waits for the device, so move
+		 * a few sections per wakeup while the idle period lasts. The
+		 * sleep time in between keeps it rate limited.
+		 */
+		batch = READ_ONCE(gc_th->screen_off) ? gc_th->gc_batch : 1;
+		do {
+			start = jiffies;
+			/* not zero means no victim was selected */
+			/*lint -save -e747*/
+			if (f2fs_gc(sbi, test_opt(sbi, FORCE_FG_GC), true)) {
+				wait_ms = gc_th->no_gc_sleep_time;
+				break;
+			}
+			/*lint -restore*/
+			gc_update_sec_cost(gc_th, start);
+
+			if (batch <= 1 || !READ_ONCE(gc_th->screen_off) ||
+					kthread_should_stop())
+				break;
+			if (!mutex_trylock(&sbi->gc_mutex))
+				break;
+			if (!is_idle(sbi) || !gc_idle_window(sbi, gc_th)) {
+				mutex_unlock(&sbi->gc_mutex);
+				break;
+			}
+			stat_inc_bggc_count(sbi);
+		} while (--batch);
 
 		trace_f2fs_background_gc(sbi->sb, wait_ms,
 				prefree_segments(sbi), free_segments(sbi));
@@ -108,6 +168,30 @@ static int gc_thread_func(void *data)
 	return 0;
 }
 
+#ifdef CONFIG_FB
+static int gc_fb_notifier_call(struct notifier_block *nb,
+					unsigned long event, void *data)
+{
+	struct f2fs_gc_kthread *gc_th = container_of(nb,
+					struct f2fs_gc_kthread, fb_notifier);
+	struct fb_event *evdata = data;
+	int blank;
+
+	if (event != FB_EVENT_BLANK || !evdata || !evdata->data)
+		return NOTIFY_DONE;
+
+	blank = *(int *)evdata->data;
+	if (blank == FB_BLANK_UNBLANK) {
+		WRITE_ONCE(gc_th->screen_off, false);
+	} else if (blank == FB_BLANK_POWERDOWN) {
+		WRITE_ONCE(gc_th->screen_off, true);
+		gc_th->gc_wake = true;
+		wake_up_interruptible_all(&gc_th->gc_wait_queue_head);
+	}
+	return NOTIFY_DONE;
+}
+#endif
+
 int start_gc_thread(struct f2fs_sb_info *sbi)
 {
 	struct f2fs_gc_kthread *gc_th;
@@ -126,6 +210,11 @@ int start_gc_thread(struct f2fs_sb_info *sbi)
 
 	gc_th->gc_idle = 0;
 
+	gc_th->gc_wake = false;
+	gc_th->screen_off = false;
+	gc_th->gc_batch = DEF_GC_THREAD_BATCH;
+	gc_th->sec_cost_ms = 0;
+
 	sbi->gc_thread = gc_th;
 	init_waitqueue_head(&sbi->gc_thread->gc_wait_queue_head);
 	sbi->gc_thread->f2fs_gc_task = kthread_run(gc_thread_func, sbi,
@@ -134,7 +223,12 @@ int start_gc_thread(struct f2fs_sb_info *sbi)
 		err = PTR_ERR(gc_th->f2fs_gc_task);
 		kfree(gc_th);
 		sbi->gc_thread = NULL;
+		goto out;
 	}
+#ifdef CONFIG_FB
+	gc_th->fb_notifier.notifier_call = gc_fb_notifier_call;
+	fb_register_client(&gc_th->fb_notifier);
+#endif
 out:
 	return err;
 }
@@ -144,6 +238,9 @@ void stop_gc_thread(struct f2fs_sb_info *sbi)
 	struct f2fs_gc_kthread *gc_th = sbi->gc_thread;
 	if (!gc_th)
 		return;
+#ifdef CONFIG_FB
+	fb_unregister_client(&gc_th->fb_notifier);
+#endif
 	kthread_stop(gc_th->f2fs_gc_task);
 	kfree(gc_th);
 	sbi->gc_thread = NULL;
@@ -226,7 +323,7 @@ static unsigned int get_cb_cost(struct f2fs_sb_info *sbi, unsigned int segno)
 	unsigned long long mtime = 0;
 	unsigned int vblocks;
 	unsigned char age = 0;
-	unsigned char u;
+	unsigned char u, type;
 	unsigned int i;
 
 	for (i = 0; i < sbi->segs_per_sec; i++)
@@ -247,6 +344,11 @@ static unsigned int get_cb_cost(struct f2fs_sb_info *sbi, unsigned int segno)
 		age = 100 - div64_u64(100 * (mtime - sit_i->min_mtime),
 				sit_i->max_mtime - sit_i->min_mtime);
 
+	/* hot logs get rewritten soon, what is moved now is likely wasted */
+	type = get_seg_entry(sbi, start)->type;
+	if (type == CURSEG_HOT_DATA || type == CURSEG_HOT_NODE)
+		age >>= 1;
+
 	return UINT_MAX - ((100 * (100 - u) * age) / (100 + u));
 }
 
@@ -492,6 +594,7 @@ next_step:
 				set_page_dirty(node_page);
 		}
 		f2fs_put_page(node_page, 1);
+		sbi->gc_moved_blks++;
 		stat_inc_node_blk_count(sbi, 1, gc_type);
 	}
 
@@ -795,6 +898,7 @@ next_step:
 				move_encrypted_block(inode, start_bidx);
 			else
 				move_data_page(inode, start_bidx, gc_type);
+			sbi->gc_moved_blks++;
 			stat_inc_data_blk_count(sbi, 1, gc_type);
 		}
 	}
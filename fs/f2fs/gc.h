@@ -16,6 +16,7 @@
 #define DEF_GC_THREAD_MIN_SLEEP_TIME	30000	/* milliseconds */
 #define DEF_GC_THREAD_MAX_SLEEP_TIME	60000
 #define DEF_GC_THREAD_NOGC_SLEEP_TIME	300000	/* wait 5 min */
+#define DEF_GC_THREAD_BATCH		4	/* sections, with screen off */
 #define LIMIT_INVALID_BLOCK	40 /* percentage over total user space */
 #define LIMIT_FREE_BLOCK	40 /* percentage over invalid + free space */
 
@@ -33,6 +34,15 @@ struct f2fs_gc_kthread {
 
 	/* for changing gc mode */
 	unsigned int gc_idle;
+
+	/* for idle aware gc */
+	bool gc_wake;			/* kick the thread before its timeout */
+	bool screen_off;		/* batching is allowed */
+	unsigned int gc_batch;		/* max sections per wakeup */
+	unsigned int sec_cost_ms;	/* average bg gc time of a section */
+#ifdef CONFIG_FB
+	struct notifier_block fb_notifier;
+#endif
 };
 
 struct gc_inode_list {
@@ -201,6 +201,7 @@ make_now:
 		inode->i_op = &f2fs_file_inode_operations;
 		inode->i_fop = &f2fs_file_operations;
 		inode->i_mapping->a_ops = &f2fs_dblock_aops;
+		f2fs_load_extent_map(inode);
 	} else if (S_ISDIR(inode->i_mode)) {
 		inode->i_op = &f2fs_dir_inode_operations;
 		inode->i_fop = &f2fs_dir_operations;
@@ -348,6 +349,7 @@ void f2fs_evict_inode(struct inode *inode)
 	remove_dirty_inode(inode);
 
 	f2fs_destroy_extent_tree(inode);
+	f2fs_destroy_dir_cache(inode);
 
 	if (inode->i_nlink || is_bad_inode(inode))
 		goto no_delete;
@@ -70,6 +70,8 @@ bool available_free_memory(struct f2fs_sb_info *sbi, int type)
 				atomic_read(&sbi->total_ext_node) *
 				sizeof(struct extent_node)) >> PAGE_CACHE_SHIFT;
 		res = mem_size < ((avail_ram * nm_i->ram_thresh / 100) >> 1);
+		if (atomic_read(&sbi->total_ext_node) >= sbi->max_extent_nodes)
+			res = false;
 	} else {
 		if (!sbi->sb->s_bdi->dirty_exceeded)
 			return true;
@@ -1267,15 +1269,23 @@ continue_unlock:
 	return last_page;
 }
 
+/*
+ * Returns the number of node pages written, the last of them in *written.
+ * The page is not referenced, it may only be compared against.
+ */
 int fsync_node_pages(struct f2fs_sb_info *sbi, nid_t ino,
-			struct writeback_control *wbc, bool atomic)
+			struct writeback_control *wbc, bool atomic,
+			struct page **written)
  {
 	pgoff_t index, end;
 	struct pagevec pvec;
 	int ret = 0;
+	int nwritten = 0;
 	struct page *last_page = NULL;
 	bool marked = false;
 
+	*written = NULL;
+
 	if (atomic) {
 		last_page = last_fsync_dnode(sbi, ino);
 		if (IS_ERR_OR_NULL(last_page))
@@ -1348,6 +1358,8 @@ continue_unlock:
 				f2fs_put_page(last_page, 0);
 				break;
 			}
+			nwritten++;
+			*written = page;
 			if (page == last_page) {
 				f2fs_put_page(page, 0);
 				marked = true;
@@ -1374,7 +1386,7 @@ continue_unlock:
 		unlock_page(last_page);
 		goto retry;
 	}
-	return ret ? -EIO: 0;
+	return ret ? -EIO : nwritten;
 }
 
 int sync_node_pages(struct f2fs_sb_info *sbi, struct writeback_control *wbc)
@@ -28,6 +28,7 @@
 #define __reverse_ffz(x) __reverse_ffs(~(x))
 
 static struct kmem_cache *discard_entry_slab;
+static struct kmem_cache *discard_cmd_slab;
 static struct kmem_cache *sit_entry_set_slab;
 static struct kmem_cache *inmem_entry_slab;
 
@@ -397,10 +398,20 @@ void f2fs_balance_fs(struct f2fs_sb_info *sbi, bool need)
 		}
 #endif
 
+		unsigned long start = jiffies;
+		unsigned int stall;
+
 		mutex_lock(&sbi->gc_mutex);
 		/*lint -save -e747*/
 		f2fs_gc(sbi, false, false);
 		/*lint -restore*/
+
+		stall = jiffies_to_msecs(jiffies - start);
+		atomic_inc(&sbi->fg_gc_calls);
+		atomic64_add(stall, &sbi->fg_gc_stall_ms);
+		/* racy, a lost update of the maximum does no harm */
+		if (stall > sbi->fg_gc_stall_max_ms)
+			sbi->fg_gc_stall_max_ms = stall;
 	}
 }
 
@@ -618,28 +629,336 @@ static void locate_dirty_segment(struct f2fs_sb_info *sbi, unsigned int segno)
 	mutex_unlock(&dirty_i->seglist_lock);
 }
 
-static int f2fs_issue_discard(struct f2fs_sb_info *sbi,
-				block_t blkstart, block_t blklen)
+static void __update_discard_map(struct f2fs_sb_info *sbi,
+			block_t blkstart, block_t blklen, bool discarded)
 {
-	sector_t start = SECTOR_FROM_BLOCK(blkstart);
-	sector_t len = SECTOR_FROM_BLOCK(blklen);
 	struct seg_entry *se;
 	unsigned int offset;
 	block_t i;
-	int ret;
 
 	for (i = blkstart; i < blkstart + blklen; i++) {
 		se = get_seg_entry(sbi, GET_SEGNO(sbi, i));
 		offset = GET_BLKOFF_FROM_SEG0(sbi, i);
 
-		if (!f2fs_test_and_set_bit(offset, se->discard_map))
-			sbi->discard_blks--;
+		if (discarded) {
+			if (!f2fs_test_and_set_bit(offset, se->discard_map))
+				sbi->discard_blks--;
+		} else {
+			if (f2fs_test_and_clear_bit(offset, se->discard_map))
+				sbi->discard_blks++;
+		}
 	}
+}
+
+static int f2fs_issue_discard(struct f2fs_sb_info *sbi,
+				block_t blkstart, block_t blklen)
+{
+	sector_t start = SECTOR_FROM_BLOCK(blkstart);
+	sector_t len = SECTOR_FROM_BLOCK(blklen);
+	int ret;
+
+	__update_discard_map(sbi, blkstart, blklen, true);
 	trace_f2fs_issue_discard(sbi->sb, blkstart, blklen);
 	ret = blkdev_issue_discard(sbi->sb->s_bdev, start, len, GFP_NOFS, 0);
 	return ret;
 }
 
+/*
+ * Asynchronous discard.  Ranges freed by a checkpoint are kept in an rbtree
+ * of discard_cmds, merged with the ranges they touch, and the discard
+ * thread issues them in pieces of at most max_discard_issue blocks while
+ * the device is idle, or right away once free sections run low.  A segment
+ * which is about to be written is first punched out of the tree.
+ */
+static struct discard_cmd *__alloc_discard_cmd(block_t lstart, block_t len)
+{
+	struct discard_cmd *dc;
+
+	dc = f2fs_kmem_cache_alloc(discard_cmd_slab, GFP_NOFS);
+	RB_CLEAR_NODE(&dc->rb_node);
+	dc->lstart = lstart;
+	dc->len = len;
+	return dc;
+}
+
+static void __insert_discard_cmd(struct discard_cmd_control *dcc,
+						struct discard_cmd *dc)
+{
+	struct rb_node **p = &dcc->root.rb_node;
+	struct rb_node *parent = NULL;
+	struct discard_cmd *cur;
+
+	while (*p) {
+		parent = *p;
+		cur = rb_entry(parent, struct discard_cmd, rb_node);
+		if (dc->lstart < cur->lstart)
+			p = &parent->rb_left;
+		else
+			p = &parent->rb_right;
+	}
+	rb_link_node(&dc->rb_node, parent, p);
+	rb_insert_color(&dc->rb_node, &dcc->root);
+	dcc->nr_cmds++;
+	dcc->nr_blks += dc->len;
+}
+
+static void __remove_discard_cmd(struct discard_cmd_control *dcc,
+						struct discard_cmd *dc)
+{
+	rb_erase(&dc->rb_node, &dcc->root);
+	dcc->nr_cmds--;
+	dcc->nr_blks -= dc->len;
+	kmem_cache_free(discard_cmd_slab, dc);
+}
+
+/* the last pending range starting at or before blkaddr */
+static struct discard_cmd *__lookup_discard_cmd(
+		struct discard_cmd_control *dcc, block_t blkaddr)
+{
+	struct rb_node *node = dcc->root.rb_node;
+	struct discard_cmd *dc, *prev = NULL;
+
+	while (node) {
+		dc = rb_entry(node, struct discard_cmd, rb_node);
+		if (blkaddr < dc->lstart) {
+			node = node->rb_left;
+		} else {
+			prev = dc;
+			node = node->rb_right;
+		}
+	}
+	return prev;
+}
+
+static void f2fs_queue_discard(struct f2fs_sb_info *sbi,
+				block_t blkstart, block_t blklen)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+	struct discard_cmd *dc, *cur;
+	block_t end = blkstart + blklen;
+
+	if (!dcc) {
+		f2fs_issue_discard(sbi, blkstart, blklen);
+		return;
+	}
+
+	__update_discard_map(sbi, blkstart, blklen, true);
+	dc = __alloc_discard_cmd(blkstart, blklen);
+
+	mutex_lock(&dcc->cmd_lock);
+	cur = __lookup_discard_cmd(dcc, blkstart);
+	if (cur && cur->lstart + cur->len >= blkstart) {
+		dc->lstart = cur->lstart;
+		end = max(end, cur->lstart + cur->len);
+		__remove_discard_cmd(dcc, cur);
+		dcc->merged_cmds++;
+	}
+	while ((cur = __lookup_discard_cmd(dcc, end)) &&
+					cur->lstart >= dc->lstart) {
+		end = max(end, cur->lstart + cur->len);
+		__remove_discard_cmd(dcc, cur);
+		dcc->merged_cmds++;
+	}
+	dc->len = end - dc->lstart;
+	__insert_discard_cmd(dcc, dc);
+	mutex_unlock(&dcc->cmd_lock);
+}
+
+/*
+ * Blocks in [blkstart, blkstart + blklen) are going to be written: drop
+ * them from the pending ranges, they are no longer discarded, and wait
+ * for a discard in flight.
+ */
+static void f2fs_punch_discard(struct f2fs_sb_info *sbi,
+				block_t blkstart, block_t blklen)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+	block_t end = blkstart + blklen;
+	block_t start, dc_end;
+	struct discard_cmd *dc;
+
+	if (!dcc)
+		return;
+
+	mutex_lock(&dcc->cmd_lock);
+	while ((dc = __lookup_discard_cmd(dcc, end - 1)) &&
+				dc->lstart + dc->len > blkstart) {
+		dc_end = dc->lstart + dc->len;
+		start = max(dc->lstart, blkstart);
+
+		__update_discard_map(sbi, start, min(dc_end, end) - start,
+									false);
+		if (dc_end > end) {
+			if (dc->lstart >= blkstart) {
+				/* keep the tail, its order in the tree holds */
+				dcc->nr_blks -= end - dc->lstart;
+				dc->lstart = end;
+				dc->len = dc_end - end;
+				continue;
+			}
+			__insert_discard_cmd(dcc,
+				__alloc_discard_cmd(end, dc_end - end));
+			dcc->nr_blks -= dc_end - end;
+			dc->len = end - dc->lstart;
+		}
+		if (dc->lstart < blkstart) {
+			dcc->nr_blks -= dc->lstart + dc->len - blkstart;
+			dc->len = blkstart - dc->lstart;
+			break;
+		}
+		__remove_discard_cmd(dcc, dc);
+	}
+
+	while (dcc->issuing_len && dcc->issuing_start < end &&
+			dcc->issuing_start + dcc->issuing_len > blkstart) {
+		mutex_unlock(&dcc->cmd_lock);
+		wait_event(dcc->discard_done_queue,
+					!READ_ONCE(dcc->issuing_len));
+		mutex_lock(&dcc->cmd_lock);
+	}
+	mutex_unlock(&dcc->cmd_lock);
+}
+
+static bool f2fs_discard_urgent(struct f2fs_sb_info *sbi)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+
+	return dcc->nr_cmds >= DEF_MAX_DISCARD_CMDS ||
+		free_sections(sbi) <= overprovision_sections(sbi) +
+					SM_I(sbi)->discard_urgent_secs;
+}
+
+/* issue the front of the lowest pending range, false if none is left */
+static bool __issue_discard_cmd(struct f2fs_sb_info *sbi, bool urgent)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+	struct rb_node *node;
+	struct discard_cmd *dc;
+	block_t start, len;
+	unsigned int us;
+	u64 begin;
+
+	mutex_lock(&dcc->cmd_lock);
+	node = rb_first(&dcc->root);
+	if (!node) {
+		mutex_unlock(&dcc->cmd_lock);
+		return false;
+	}
+	dc = rb_entry(node, struct discard_cmd, rb_node);
+	start = dc->lstart;
+	len = min_t(block_t, dc->len,
+			max_t(unsigned int, SM_I(sbi)->max_discard_issue, 1));
+	if (len == dc->len) {
+		__remove_discard_cmd(dcc, dc);
+	} else {
+		dc->lstart += len;
+		dc->len -= len;
+		dcc->nr_blks -= len;
+	}
+	dcc->issuing_start = start;
+	dcc->issuing_len = len;
+	mutex_unlock(&dcc->cmd_lock);
+
+	trace_f2fs_issue_discard(sbi->sb, start, len);
+	begin = ktime_get_ns();
+	blkdev_issue_discard(sbi->sb->s_bdev, SECTOR_FROM_BLOCK(start),
+				SECTOR_FROM_BLOCK(len), GFP_NOFS, 0);
+	us = div_u64(ktime_get_ns() - begin, NSEC_PER_USEC);
+
+	mutex_lock(&dcc->cmd_lock);
+	dcc->issuing_len = 0;
+	dcc->issued_cmds++;
+	dcc->issued_blks += len;
+	if (urgent)
+		dcc->urgent_cmds++;
+	dcc->issue_total_us += us;
+	if (us > dcc->issue_max_us)
+		dcc->issue_max_us = us;
+	mutex_unlock(&dcc->cmd_lock);
+	wake_up_all(&dcc->discard_done_queue);
+	return true;
+}
+
+static int issue_discard_thread(void *data)
+{
+	struct f2fs_sb_info *sbi = data;
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+	unsigned int wait_ms = DEF_DISCARD_BUSY_WAIT_MS;
+	int i;
+
+	do {
+		if (try_to_freeze())
+			continue;
+		else
+			wait_event_interruptible_timeout(
+					dcc->discard_wait_queue,
+					kthread_should_stop(),
+					msecs_to_jiffies(wait_ms));
+		if (kthread_should_stop())
+			break;
+
+		wait_ms = DEF_DISCARD_BUSY_WAIT_MS;
+		if (!READ_ONCE(dcc->nr_cmds))
+			continue;
+
+		if (f2fs_discard_urgent(sbi)) {
+			if (__issue_discard_cmd(sbi, true))
+				wait_ms = DEF_DISCARD_URGENT_WAIT_MS;
+			continue;
+		}
+
+		for (i = 0; i < DEF_DISCARD_BATCH && is_idle(sbi); i++)
+			if (!__issue_discard_cmd(sbi, false))
+				break;
+		if (i)
+			wait_ms = DEF_DISCARD_IDLE_WAIT_MS;
+	} while (!kthread_should_stop());
+
+	return 0;
+}
+
+int create_discard_cmd_control(struct f2fs_sb_info *sbi)
+{
+	dev_t dev = sbi->sb->s_bdev->bd_dev;
+	struct discard_cmd_control *dcc;
+	int err;
+
+	dcc = kzalloc(sizeof(struct discard_cmd_control), GFP_KERNEL);
+	if (!dcc)
+		return -ENOMEM;
+	init_waitqueue_head(&dcc->discard_wait_queue);
+	init_waitqueue_head(&dcc->discard_done_queue);
+	mutex_init(&dcc->cmd_lock);
+	dcc->root = RB_ROOT;
+	SM_I(sbi)->dcc_info = dcc;
+	dcc->f2fs_issue_discard = kthread_run(issue_discard_thread, sbi,
+				"f2fs_discard-%u:%u", MAJOR(dev), MINOR(dev));
+	if (IS_ERR(dcc->f2fs_issue_discard)) {
+		err = PTR_ERR(dcc->f2fs_issue_discard);
+		kfree(dcc);
+		SM_I(sbi)->dcc_info = NULL;
+		return err;
+	}
+
+	return 0;
+}
+
+void destroy_discard_cmd_control(struct f2fs_sb_info *sbi)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+
+	if (!dcc)
+		return;
+	if (dcc->f2fs_issue_discard)
+		kthread_stop(dcc->f2fs_issue_discard);
+
+	/* the ranges are already marked as discarded, so issue them all */
+	while (__issue_discard_cmd(sbi, true))
+		;
+	kfree(dcc);
+	SM_I(sbi)->dcc_info = NULL;
+}
+
 bool discard_next_dnode(struct f2fs_sb_info *sbi, block_t blkaddr)
 {
 	int err = -EOPNOTSUPP;
@@ -783,7 +1102,7 @@ void clear_prefree_segments(struct f2fs_sb_info *sbi, struct cp_control *cpc)
 		if (force || !test_opt(sbi, DISCARD))
 			continue;
 
-		f2fs_issue_discard(sbi, START_BLOCK(sbi, start),
+		f2fs_queue_discard(sbi, START_BLOCK(sbi, start),
 				(end - start) << sbi->log_blocks_per_seg);
 	}
 	mutex_unlock(&dirty_i->seglist_lock);
@@ -792,7 +1111,11 @@ void clear_prefree_segments(struct f2fs_sb_info *sbi, struct cp_control *cpc)
 	list_for_each_entry_safe(entry, this, head, list) {
 		if (force && entry->len < cpc->trim_minlen)
 			goto skip;
-		f2fs_issue_discard(sbi, entry->blkaddr, entry->len);
+		/* fstrim waits for its discards */
+		if (force)
+			f2fs_issue_discard(sbi, entry->blkaddr, entry->len);
+		else
+			f2fs_queue_discard(sbi, entry->blkaddr, entry->len);
 		cpc->trimmed += entry->len;
 skip:
 		list_del(&entry->list);
@@ -1165,6 +1488,7 @@ static void new_curseg(struct f2fs_sb_info *sbi, int type, bool new_sec)
 	curseg->next_segno = segno;
 	reset_curseg(sbi, type, 1);
 	curseg->alloc_type = LFS;
+	f2fs_punch_discard(sbi, START_BLOCK(sbi, segno), sbi->blocks_per_seg);
 }
 
 static void __next_free_blkoff(struct f2fs_sb_info *sbi,
@@ -1223,6 +1547,8 @@ static void change_curseg(struct f2fs_sb_info *sbi, int type, bool reuse)
 	reset_curseg(sbi, type, 1);
 	curseg->alloc_type = SSR;
 	__next_free_blkoff(sbi, curseg, 0);
+	f2fs_punch_discard(sbi, START_BLOCK(sbi, new_segno),
+						sbi->blocks_per_seg);
 
 	if (reuse) {
 		sum_page = get_sum_page(sbi, new_segno);
@@ -2461,6 +2787,9 @@ int build_segment_manager(struct f2fs_sb_info *sbi)
 
 	sm_info->trim_sections = DEF_BATCHED_TRIM_SECTIONS;
 
+	sm_info->max_discard_issue = DEF_MAX_DISCARD_ISSUE;
+	sm_info->discard_urgent_secs = DEF_DISCARD_URGENT_SECS;
+
 	INIT_LIST_HEAD(&sm_info->sit_entry_set);
 
 	if (test_opt(sbi, FLUSH_MERGE) && !f2fs_readonly(sbi->sb)) {
@@ -2469,6 +2798,12 @@ int build_segment_manager(struct f2fs_sb_info *sbi)
 			return err;
 	}
 
+	if (test_opt(sbi, DISCARD) && !f2fs_readonly(sbi->sb)) {
+		err = create_discard_cmd_control(sbi);
+		if (err)
+			return err;
+	}
+
 	err = build_sit_info(sbi);
 	if (err)
 		return err;
@@ -2584,6 +2919,7 @@ void destroy_segment_manager(struct f2fs_sb_info *sbi)
 	if (!sm_info)
 		return;
 	destroy_flush_cmd_control(sbi);
+	destroy_discard_cmd_control(sbi);
 	destroy_dirty_segmap(sbi);
 	destroy_curseg(sbi);
 	destroy_free_segmap(sbi);
@@ -2599,10 +2935,15 @@ int __init create_segment_manager_caches(void)
 	if (!discard_entry_slab)
 		goto fail;
 
+	discard_cmd_slab = f2fs_kmem_cache_create("discard_cmd",
+			sizeof(struct discard_cmd));
+	if (!discard_cmd_slab)
+		goto destory_discard_entry;
+
 	sit_entry_set_slab = f2fs_kmem_cache_create("sit_entry_set",
 			sizeof(struct sit_entry_set));
 	if (!sit_entry_set_slab)
-		goto destory_discard_entry;
+		goto destroy_discard_cmd;
 
 	inmem_entry_slab = f2fs_kmem_cache_create("inmem_page_entry",
 			sizeof(struct inmem_pages));
@@ -2612,6 +2953,8 @@ int __init create_segment_manager_caches(void)
 
 destroy_sit_entry_set:
 	kmem_cache_destroy(sit_entry_set_slab);
+destroy_discard_cmd:
+	kmem_cache_destroy(discard_cmd_slab);
 destory_discard_entry:
 	kmem_cache_destroy(discard_entry_slab);
 fail:
@@ -2621,6 +2964,7 @@ fail:
 void destroy_segment_manager_caches(void)
 {
 	kmem_cache_destroy(sit_entry_set_slab);
+	kmem_cache_destroy(discard_cmd_slab);
 	kmem_cache_destroy(discard_entry_slab);
 	kmem_cache_destroy(inmem_entry_slab);
 }
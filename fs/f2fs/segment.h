@@ -513,6 +513,15 @@ static inline int utilization(struct f2fs_sb_info *sbi)
 #define DEF_MIN_IPU_UTIL	70
 #define DEF_MIN_FSYNC_BLOCKS	20
 
+/* the discard thread */
+#define DEF_MAX_DISCARD_ISSUE		2048	/* 8MB per discard */
+#define DEF_DISCARD_URGENT_SECS		32	/* over overprovision sections */
+#define DEF_MAX_DISCARD_CMDS		8192	/* pending ranges before urgent */
+#define DEF_DISCARD_BATCH		16	/* discards per idle wakeup */
+#define DEF_DISCARD_IDLE_WAIT_MS	50	/* between idle batches */
+#define DEF_DISCARD_BUSY_WAIT_MS	1000	/* recheck for idle */
+#define DEF_DISCARD_URGENT_WAIT_MS	10	/* between urgent discards */
+
 enum {
 	F2FS_IPU_FORCE,
 	F2FS_IPU_SSR,
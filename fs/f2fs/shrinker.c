@@ -36,6 +36,11 @@ static unsigned long __count_extent_cache(struct f2fs_sb_info *sbi)
 				atomic_read(&sbi->total_ext_node);
 }
 
+static unsigned long __count_dir_cache(struct f2fs_sb_info *sbi)
+{
+	return atomic_read(&sbi->total_dir_cache);
+}
+
 unsigned long f2fs_shrink_count(struct shrinker *shrink,
 				struct shrink_control *sc)
 {
@@ -58,6 +63,9 @@ unsigned long f2fs_shrink_count(struct shrinker *shrink,
 		/* count extent cache entries */
 		count += __count_extent_cache(sbi);
 
+		/* count lookup caches of large dirs */
+		count += __count_dir_cache(sbi);
+
 		/* shrink clean nat cache entries */
 		count += __count_nat_entries(sbi);
 
@@ -104,6 +112,10 @@ unsigned long f2fs_shrink_scan(struct shrinker *shrink,
 		/* shrink extent cache entries */
 		freed += f2fs_shrink_extent_tree(sbi, nr >> 1);
 
+		/* shrink lookup caches of large dirs */
+		if (freed < nr)
+			freed += f2fs_shrink_dir_cache(sbi, nr - freed);
+
 		/* shrink clean nat cache entries */
 		if (freed < nr)
 			freed += try_to_free_nats(sbi, nr - freed);
@@ -133,6 +145,7 @@ void f2fs_join_shrinker(struct f2fs_sb_info *sbi)
 void f2fs_leave_shrinker(struct f2fs_sb_info *sbi)
 {
 	f2fs_shrink_extent_tree(sbi, __count_extent_cache(sbi));
+	f2fs_shrink_dir_cache(sbi, __count_dir_cache(sbi));
 
 	spin_lock(&f2fs_list_lock);
 	list_del(&sbi->s_list);
@@ -87,6 +87,7 @@ enum {
 	Opt_fastboot,
 	Opt_extent_cache,
 	Opt_noextent_cache,
+	Opt_extent_map,
 	Opt_noinline_data,
 	Opt_data_flush,
 	Opt_force_crc,
@@ -115,6 +116,7 @@ static match_table_t f2fs_tokens = {
 	{Opt_fastboot, "fastboot"},
 	{Opt_extent_cache, "extent_cache"},
 	{Opt_noextent_cache, "noextent_cache"},
+	{Opt_extent_map, "extent_map"},
 	{Opt_noinline_data, "noinline_data"},
 	{Opt_data_flush, "data_flush"},
 	{Opt_force_crc, "force_crc"},
@@ -199,6 +201,60 @@ static ssize_t lifetime_write_kbytes_show(struct f2fs_attr *a,
                        BD_PART_WRITTEN(sbi)));
 }
 
+/*
+ * kbytes moved by gc, kbytes written, write amplification caused by gc,
+ * writers stalled by gc, their total and longest stall in ms, all since
+ * mount.
+ */
+static ssize_t gc_stat_show(struct f2fs_attr *a,
+			struct f2fs_sb_info *sbi, char *buf)
+{
+	u64 moved = sbi->gc_moved_blks << (sbi->log_blocksize - 10);
+	u64 written = sbi->sb->s_bdev->bd_part ? BD_PART_WRITTEN(sbi) : 0;
+	unsigned int waf = 100;
+
+	if (written > moved)
+		waf = div64_u64(written * 100, written - moved);
+
+	return snprintf(buf, PAGE_SIZE, "%llu %llu %u.%02u %d %lld %u\n",
+			(unsigned long long)moved,
+			(unsigned long long)written, waf / 100, waf % 100,
+			atomic_read(&sbi->fg_gc_calls),
+			(long long)atomic64_read(&sbi->fg_gc_stall_ms),
+			sbi->fg_gc_stall_max_ms);
+}
+
+/*
+ * Asynchronous discard since mount: discards issued, kbytes discarded,
+ * ranges merged, discards issued urgently, pending ranges and kbytes,
+ * average and longest discard in us.
+ */
+static ssize_t discard_stat_show(struct f2fs_attr *a,
+			struct f2fs_sb_info *sbi, char *buf)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+	int kb_shift = sbi->log_blocksize - 10;
+	ssize_t len;
+
+	if (!dcc)
+		return snprintf(buf, PAGE_SIZE, "off\n");
+
+	mutex_lock(&dcc->cmd_lock);
+	len = snprintf(buf, PAGE_SIZE,
+			"%llu %llu %llu %llu %u %llu %llu %u\n",
+			(unsigned long long)dcc->issued_cmds,
+			(unsigned long long)dcc->issued_blks << kb_shift,
+			(unsigned long long)dcc->merged_cmds,
+			(unsigned long long)dcc->urgent_cmds,
+			dcc->nr_cmds,
+			(unsigned long long)dcc->nr_blks << kb_shift,
+			dcc->issued_cmds ? (unsigned long long)div64_u64(
+				dcc->issue_total_us, dcc->issued_cmds) : 0ULL,
+			dcc->issue_max_us);
+	mutex_unlock(&dcc->cmd_lock);
+	return len;
+}
+
 static ssize_t f2fs_sbi_show(struct f2fs_attr *a,
 			struct f2fs_sb_info *sbi, char *buf)
 {
@@ -284,8 +340,11 @@ F2FS_RW_ATTR(GC_THREAD, f2fs_gc_kthread, gc_min_sleep_time, min_sleep_time);
 F2FS_RW_ATTR(GC_THREAD, f2fs_gc_kthread, gc_max_sleep_time, max_sleep_time);
 F2FS_RW_ATTR(GC_THREAD, f2fs_gc_kthread, gc_no_gc_sleep_time, no_gc_sleep_time);
 F2FS_RW_ATTR(GC_THREAD, f2fs_gc_kthread, gc_idle, gc_idle);
+F2FS_RW_ATTR(GC_THREAD, f2fs_gc_kthread, gc_batch, gc_batch);
 F2FS_RW_ATTR(SM_INFO, f2fs_sm_info, reclaim_segments, rec_prefree_segments);
 F2FS_RW_ATTR(SM_INFO, f2fs_sm_info, max_small_discards, max_discards);
+F2FS_RW_ATTR(SM_INFO, f2fs_sm_info, max_discard_issue, max_discard_issue);
+F2FS_RW_ATTR(SM_INFO, f2fs_sm_info, discard_urgent_secs, discard_urgent_secs);
 F2FS_RW_ATTR(SM_INFO, f2fs_sm_info, batched_trim_sections, trim_sections);
 F2FS_RW_ATTR(SM_INFO, f2fs_sm_info, ipu_policy, ipu_policy);
 F2FS_RW_ATTR(SM_INFO, f2fs_sm_info, min_ipu_util, min_ipu_util);
@@ -295,9 +354,15 @@ F2FS_RW_ATTR(NM_INFO, f2fs_nm_info, ra_nid_pages, ra_nid_pages);
 F2FS_RW_ATTR(NM_INFO, f2fs_nm_info, dirty_nats_ratio, dirty_nats_ratio);
 F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, max_victim_search, max_victim_search);
 F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, dir_level, dir_level);
+F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, max_extent_nodes, max_extent_nodes);
+F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, dir_cache_blocks, dir_cache_blocks);
 F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, cp_interval, interval_time[CP_TIME]);
+F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, cp_parallel, cp_parallel);
+F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, fsync_fua, fsync_fua);
 F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, idle_interval, interval_time[REQ_TIME]);
 F2FS_GENERAL_RO_ATTR(lifetime_write_kbytes);
+F2FS_GENERAL_RO_ATTR(gc_stat);
+F2FS_GENERAL_RO_ATTR(discard_stat);
 
 #define ATTR_LIST(name) (&f2fs_attr_##name.attr)
 static struct attribute *f2fs_attrs[] = {
@@ -305,20 +370,29 @@ static struct attribute *f2fs_attrs[] = {
 	ATTR_LIST(gc_max_sleep_time),
 	ATTR_LIST(gc_no_gc_sleep_time),
 	ATTR_LIST(gc_idle),
+	ATTR_LIST(gc_batch),
 	ATTR_LIST(reclaim_segments),
 	ATTR_LIST(max_small_discards),
+	ATTR_LIST(max_discard_issue),
+	ATTR_LIST(discard_urgent_secs),
 	ATTR_LIST(batched_trim_sections),
 	ATTR_LIST(ipu_policy),
 	ATTR_LIST(min_ipu_util),
 	ATTR_LIST(min_fsync_blocks),
 	ATTR_LIST(max_victim_search),
 	ATTR_LIST(dir_level),
+	ATTR_LIST(max_extent_nodes),
+	ATTR_LIST(dir_cache_blocks),
 	ATTR_LIST(ram_thresh),
 	ATTR_LIST(ra_nid_pages),
 	ATTR_LIST(dirty_nats_ratio),
 	ATTR_LIST(cp_interval),
+	ATTR_LIST(cp_parallel),
+	ATTR_LIST(fsync_fua),
 	ATTR_LIST(idle_interval),
 	ATTR_LIST(lifetime_write_kbytes),
+	ATTR_LIST(gc_stat),
+	ATTR_LIST(discard_stat),
 	NULL,
 };
 
@@ -503,6 +577,9 @@ static int parse_options(struct super_block *sb, char *options)
 		case Opt_noextent_cache:
 			clear_opt(sbi, EXTENT_CACHE);
 			break;
+		case Opt_extent_map:
+			set_opt(sbi, EXTENT_MAP);
+			break;
 		case Opt_noinline_data:
 			clear_opt(sbi, INLINE_DATA);
 			break;
@@ -686,8 +763,6 @@ static void f2fs_put_super(struct super_block *sb)
 	wait_for_completion(&sbi->s_kobj_unregister);
 
 	sb->s_fs_info = NULL;
-	if (sbi->s_chksum_driver)
-		crypto_free_shash(sbi->s_chksum_driver);
 	kfree(sbi->raw_super);
 	kfree(sbi);
 }
@@ -807,6 +882,8 @@ static int f2fs_show_options(struct seq_file *seq, struct dentry *root)
 		seq_puts(seq, ",extent_cache");
 	else
 		seq_puts(seq, ",noextent_cache");
+	if (test_opt(sbi, EXTENT_MAP))
+		seq_puts(seq, ",extent_map");
 	if (test_opt(sbi, DATA_FLUSH))
 		seq_puts(seq, ",data_flush");
 #ifdef CONFIG_F2FS_FS_ENCRYPTION
@@ -1109,6 +1186,15 @@ static int f2fs_remount(struct super_block *sb, int *flags, char *data)
 		if (err)
 			goto restore_gc;
 	}
+
+	/* Likewise, the discard thread runs for rw mounts with discard */
+	if ((*flags & MS_RDONLY) || !test_opt(sbi, DISCARD)) {
+		destroy_discard_cmd_control(sbi);
+	} else if (!SM_I(sbi)->dcc_info) {
+		err = create_discard_cmd_control(sbi);
+		if (err)
+			goto restore_gc;
+	}
 skip:
 	/* Update the POSIXACL Flag */
 	 sb->s_flags = (sb->s_flags & ~MS_POSIXACL) |
@@ -1544,6 +1630,11 @@ static void init_sb_info(struct f2fs_sb_info *sbi)
 	sbi->dir_level = DEF_DIR_LEVEL;
 	sbi->interval_time[CP_TIME] = DEF_CP_INTERVAL;
 	sbi->interval_time[REQ_TIME] = DEF_IDLE_INTERVAL;
+	sbi->fsync_fua = 1;
+	INIT_LIST_HEAD(&sbi->dir_cache_list);
+	spin_lock_init(&sbi->dir_cache_lock);
+	atomic_set(&sbi->total_dir_cache, 0);
+	sbi->dir_cache_blocks = DEF_DIR_CACHE_BLOCKS;
 	clear_sbi_flag(sbi, SBI_NEED_FSCK);
 
 	INIT_LIST_HEAD(&sbi->s_list);
@@ -1670,15 +1761,6 @@ try_onemore:
 	if (!sbi)
 		return -ENOMEM;
 
-	/* Load the checksum driver */
-	sbi->s_chksum_driver = crypto_alloc_shash("crc32", 0, 0);
-	if (IS_ERR(sbi->s_chksum_driver)) {
-		f2fs_msg(sb, KERN_ERR, "Cannot load crc32 driver.");
-		err = PTR_ERR(sbi->s_chksum_driver);
-		sbi->s_chksum_driver = NULL;
-		goto free_sbi;
-	}
-
 	/* set a block size */
 	if (unlikely(!sb_set_blocksize(sb, F2FS_BLKSIZE))) {
 		f2fs_msg(sb, KERN_ERR, "unable to set blocksize");
@@ -1950,8 +2032,6 @@ free_sb_buf:
 free_options:
 	kfree(options);
 free_sbi:
-	if (sbi->s_chksum_driver)
-		crypto_free_shash(sbi->s_chksum_driver);
 	kfree(sbi);
 
 	/* give only one another chance */
@@ -37,6 +37,8 @@
 #define F2FS_XATTR_INDEX_ADVISE			7
 /* Should be same as EXT4_XATTR_INDEX_ENCRYPTION */
 #define F2FS_XATTR_INDEX_ENCRYPTION		9
+/* private, never listed: the persisted extent map of a file */
+#define F2FS_XATTR_INDEX_EXTENT_MAP		10
 
 #define F2FS_XATTR_NAME_ENCRYPTION_CONTEXT	"c"
 
@@ -78,6 +78,7 @@ struct msdos_sb_info {
 	unsigned int prev_free;      /* previously allocated cluster number */
 	unsigned int free_clusters;  /* -1 if undefined */
 	unsigned int free_clus_valid; /* is free_clusters valid? */
+	struct fat_free_map *free_map; /* free cluster map, see fatent.c */
 	struct fat_mount_options options;
 	struct nls_table *nls_disk;   /* Codepage used on disk */
 	struct nls_table *nls_io;     /* Charset used for input and display */
@@ -125,6 +126,12 @@ struct msdos_inode_info {
 	struct hlist_node i_fat_hash;	/* hash by i_location */
 	struct hlist_node i_dir_hash;	/* hash by i_logstart */
 	struct rw_semaphore truncate_lock; /* protect bmap against truncate */
+
+	/* cluster allocation hints, protected by fat_lock */
+	unsigned int i_alloc_next;	/* cluster after the last allocated */
+	unsigned int i_pa_start;	/* preallocated window */
+	unsigned int i_pa_len;
+	struct list_head i_pa_list;	/* on the free map's window list */
 	struct inode vfs_inode;
 };
 
@@ -353,6 +360,11 @@ extern int fat_alloc_clusters(struct inode *inode, int *cluster,
 			      int nr_cluster);
 extern int fat_free_clusters(struct inode *inode, int cluster);
 extern int fat_count_free_clusters(struct super_block *sb);
+extern void fat_prealloc_release(struct inode *inode);
+extern void fat_free_map_init(struct super_block *sb);
+extern void fat_free_map_exit(struct super_block *sb);
+extern void fat_debugfs_init(void);
+extern void fat_debugfs_exit(void);
 
 /* fat/file.c */
 extern long fat_generic_ioctl(struct file *filp, unsigned int cmd,
@@ -4,6 +4,10 @@
  */
 
 #include <linux/blkdev.h>
+#include <linux/debugfs.h>
+#include <linux/ktime.h>
+#include <linux/seq_file.h>
+#include <linux/vmalloc.h>
 #include "fat.h"
 
 struct fatent_operations {
@@ -18,6 +22,40 @@ struct fatent_operations {
 
 static DEFINE_SPINLOCK(fat12_entry_lock);
 
+/* Largest free cluster map (in bytes) kept in memory */
+#define FAT_FREE_MAP_MAX	(4 * 1024 * 1024)
+/* Files of this size get preallocation windows of FAT_PREALLOC_SIZE */
+#define FAT_PREALLOC_MIN	(1024 * 1024)
+#define FAT_PREALLOC_SIZE	(4 * 1024 * 1024)
+
+/*
+ * In-memory copy of the FAT's free/used state, one bit per cluster. A set
+ * bit means the cluster is in use, reserved by a preallocation window, or
+ * not scanned yet. The map is filled by a background scan after mount and
+ * used for allocation once ->valid is set; until then the linear search is
+ * used, and both only keep the bits below ->scanned up to date. Everything
+ * here, including the windows on ->prealloc, is protected by fat_lock.
+ */
+struct fat_free_map {
+	struct super_block *sb;
+	unsigned long *bits;
+	unsigned long scanned;		/* first cluster not scanned yet */
+	int valid;
+	int stop;
+	struct work_struct build;
+	struct list_head prealloc;	/* inodes with a window */
+
+	/* statistics */
+	unsigned int build_ms;
+	unsigned long allocs;
+	u64 alloc_ns;
+	u64 alloc_max_ns;
+	unsigned long prealloc_hits;
+	struct dentry *debugfs;
+};
+
+static struct dentry *fat_debugfs_root;
+
 static void fat12_ent_blocknr(struct super_block *sb, int entry,
 			      int *offset, sector_t *blocknr)
 {
@@ -459,6 +497,171 @@ static void fat_collect_bhs(struct buffer_head **bhs, int *nr_bhs,
 	}
 }
 
+static inline void fat_free_map_mark(struct msdos_sb_info *sbi, int entry,
+				     int used)
+{
+	struct fat_free_map *map = sbi->free_map;
+
+	if (!map || entry >= map->scanned)
+		return;
+	if (used)
+		set_bit(entry, map->bits);
+	else
+		clear_bit(entry, map->bits);
+}
+
+static void fat_prealloc_drop(struct fat_free_map *map,
+			      struct msdos_inode_info *ei)
+{
+	if (!ei->i_pa_len)
+		return;
+	bitmap_clear(map->bits, ei->i_pa_start, ei->i_pa_len);
+	ei->i_pa_len = 0;
+	list_del_init(&ei->i_pa_list);
+}
+
+static void fat_prealloc_drop_all(struct fat_free_map *map)
+{
+	while (!list_empty(&map->prealloc))
+		fat_prealloc_drop(map, list_first_entry(&map->prealloc,
+					struct msdos_inode_info, i_pa_list));
+}
+
+/* Give back the unused part of the inode's preallocation window */
+void fat_prealloc_release(struct inode *inode)
+{
+	struct msdos_sb_info *sbi = MSDOS_SB(inode->i_sb);
+
+	if (!sbi->free_map)
+		return;
+
+	lock_fat(sbi);
+	fat_prealloc_drop(sbi->free_map, MSDOS_I(inode));
+	unlock_fat(sbi);
+}
+
+/*
+ * Pick the next cluster for @inode from the free map and mark it used.
+ * Clusters come from the inode's window first, then from right after the
+ * last cluster it got, so that a file written in order stays contiguous.
+ * A file that has grown past FAT_PREALLOC_MIN reserves the whole free run
+ * of FAT_PREALLOC_SIZE it is given, so that concurrent writers do not
+ * interleave their clusters.
+ */
+static int fat_free_map_next(struct inode *inode)
+{
+	struct msdos_sb_info *sbi = MSDOS_SB(inode->i_sb);
+	struct fat_free_map *map = sbi->free_map;
+	struct msdos_inode_info *ei = MSDOS_I(inode);
+	unsigned long max = sbi->max_cluster;
+	unsigned long goal, want, entry;
+
+	if (ei->i_pa_len) {
+		entry = ei->i_pa_start++;
+		if (--ei->i_pa_len == 0)
+			list_del_init(&ei->i_pa_list);
+		map->prealloc_hits++;
+		return entry;
+	}
+
+	goal = ei->i_alloc_next;
+	if (goal < FAT_START_ENT || goal >= max)
+		goal = sbi->prev_free + 1;
+	if (goal < FAT_START_ENT || goal >= max)
+		goal = FAT_START_ENT;
+
+	want = 1;
+	if (S_ISREG(inode->i_mode) && ei->mmu_private >= FAT_PREALLOC_MIN)
+		want = max_t(unsigned long,
+			     FAT_PREALLOC_SIZE >> sbi->cluster_bits, 1);
+
+	if (want > 1) {
+		entry = bitmap_find_next_zero_area(map->bits, max, goal,
+						   want, 0);
+		if (entry >= max)
+			entry = bitmap_find_next_zero_area(map->bits, max,
+						FAT_START_ENT, want, 0);
+		if (entry < max) {
+			bitmap_set(map->bits, entry, want);
+			ei->i_pa_start = entry + 1;
+			ei->i_pa_len = want - 1;
+			list_add(&ei->i_pa_list, &map->prealloc);
+			return entry;
+		}
+	}
+
+	entry = find_next_zero_bit(map->bits, max, goal);
+	if (entry >= max)
+		entry = find_next_zero_bit(map->bits, max, FAT_START_ENT);
+	if (entry >= max)
+		return -ENOSPC;
+	set_bit(entry, map->bits);
+	return entry;
+}
+
+/* Allocate from the free map; called with fat_lock held */
+static int fat_alloc_clusters_map(struct inode *inode, int *cluster,
+				  int nr_cluster, struct buffer_head **bhs,
+				  int *nr_bhs, int *idx_clus)
+{
+	struct super_block *sb = inode->i_sb;
+	struct msdos_sb_info *sbi = MSDOS_SB(sb);
+	struct fatent_operations *ops = sbi->fatent_ops;
+	struct fat_entry fatent, prev_ent;
+	int entry, err = 0, retried = 0;
+
+	fatent_init(&prev_ent);
+	fatent_init(&fatent);
+	while (*idx_clus < nr_cluster) {
+		entry = fat_free_map_next(inode);
+		if (entry < 0 && !retried &&
+		    !list_empty(&sbi->free_map->prealloc)) {
+			fat_prealloc_drop_all(sbi->free_map);
+			retried = 1;
+			continue;
+		}
+		if (entry < 0) {
+			/* Couldn't allocate the free entries */
+			sbi->free_clusters = 0;
+			sbi->free_clus_valid = 1;
+			err = -ENOSPC;
+			break;
+		}
+
+		err = fat_ent_read(inode, &fatent, entry);
+		if (err < 0)
+			break;
+		/* stale map entry: the bit stays set, try the next one */
+		if (err != FAT_ENT_FREE) {
+			err = 0;
+			continue;
+		}
+		err = 0;
+
+		/* make the cluster chain */
+		ops->ent_put(&fatent, FAT_ENT_EOF);
+		if (prev_ent.nr_bhs)
+			ops->ent_put(&prev_ent, entry);
+
+		fat_collect_bhs(bhs, nr_bhs, &fatent);
+
+		sbi->prev_free = entry;
+		MSDOS_I(inode)->i_alloc_next = entry + 1;
+		if (sbi->free_clusters != -1)
+			sbi->free_clusters--;
+
+		cluster[(*idx_clus)++] = entry;
+		/*
+		 * fat_collect_bhs() gets ref-count of bhs,
+		 * so we can still use the prev_ent.
+		 */
+		prev_ent = fatent;
+	}
+	fatent_brelse(&fatent);
+
+	return err;
+}
+
 int fat_alloc_clusters(struct inode *inode, int *cluster, int nr_cluster)
 {
 	struct super_block *sb = inode->i_sb;
@@ -467,6 +670,7 @@ int fat_alloc_clusters(struct inode *inode, int *cluster, int nr_cluster)
 	struct fat_entry fatent, prev_ent;
 	struct buffer_head *bhs[MAX_BUF_PER_PAGE];
 	int i, count, err, nr_bhs, idx_clus;
+	ktime_t start = ktime_get();
 
 	BUG_ON(nr_cluster > (MAX_BUF_PER_PAGE / 2));	/* fixed limit */
 
@@ -478,9 +682,15 @@ int fat_alloc_clusters(struct inode *inode, int *cluster, int nr_cluster)
 	}
 
 	err = nr_bhs = idx_clus = 0;
+	fatent_init(&fatent);
+	if (sbi->free_map && sbi->free_map->valid) {
+		err = fat_alloc_clusters_map(inode, cluster, nr_cluster,
+					     bhs, &nr_bhs, &idx_clus);
+		goto out;
+	}
+
 	count = FAT_START_ENT;
 	fatent_init(&prev_ent);
-	fatent_init(&fatent);
 	fatent_set_entry(&fatent, sbi->prev_free + 1);
 	while (count < sbi->max_cluster) {
 		if (fatent.entry >= sbi->max_cluster)
@@ -501,6 +711,7 @@ int fat_alloc_clusters(struct inode *inode, int *cluster, int nr_cluster)
 					ops->ent_put(&prev_ent, entry);
 
 				fat_collect_bhs(bhs, &nr_bhs, &fatent);
+				fat_free_map_mark(sbi, entry, 1);
 
 				sbi->prev_free = entry;
 				if (sbi->free_clusters != -1)
@@ -529,6 +740,15 @@ int fat_alloc_clusters(struct inode *inode, int *cluster, int nr_cluster)
 	err = -ENOSPC;
 
 out:
+	if (sbi->free_map) {
+		struct fat_free_map *map = sbi->free_map;
+		u64 ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+		map->allocs++;
+		map->alloc_ns += ns;
+		if (ns > map->alloc_max_ns)
+			map->alloc_max_ns = ns;
+	}
 	unlock_fat(sbi);
 	mark_fsinfo_dirty(sb);
 	fatent_brelse(&fatent);
@@ -591,6 +811,7 @@ int fat_free_clusters(struct inode *inode, int cluster)
 		}
 
 		ops->ent_put(&fatent, FAT_ENT_FREE);
+		fat_free_map_mark(sbi, fatent.entry, 0);
 		if (sbi->free_clusters != -1) {
 			sbi->free_clusters++;
 			dirty_fsinfo = 1;
@@ -690,3 +911,173 @@ out:
 	unlock_fat(sbi);
 	return err;
 }
+
+static void fat_free_map_build(struct work_struct *work)
+{
+	struct fat_free_map *map = container_of(work, struct fat_free_map,
+						build);
+	struct super_block *sb = map->sb;
+	struct msdos_sb_info *sbi = MSDOS_SB(sb);
+	struct fatent_operations *ops = sbi->fatent_ops;
+	struct fat_entry fatent;
+	unsigned long reada_blocks, reada_mask, cur_block;
+	ktime_t start = ktime_get();
+	int err = 0;
+
+	reada_blocks = FAT_READA_SIZE >> sb->s_blocksize_bits;
+	reada_mask = reada_blocks - 1;
+	cur_block = 0;
+
+	/*
+	 * One FAT block per fat_lock hold, so that writers started right
+	 * after mount are not held off for the whole scan.
+	 */
+	fatent_init(&fatent);
+	fatent_set_entry(&fatent, FAT_START_ENT);
+	while (fatent.entry < sbi->max_cluster) {
+		if (READ_ONCE(map->stop))
+			goto out;
+
+		/* readahead of fat blocks */
+		if ((cur_block & reada_mask) == 0) {
+			unsigned long rest = sbi->fat_length - cur_block;
+			fat_ent_reada(sb, &fatent, min(reada_blocks, rest));
+		}
+		cur_block++;
+
+		lock_fat(sbi);
+		err = fat_ent_read_block(sb, &fatent);
+		if (err) {
+			unlock_fat(sbi);
+			fat_msg(sb, KERN_WARNING,
+				"free cluster map disabled (err %d)", err);
+			goto out;
+		}
+		do {
+			if (ops->ent_get(&fatent) == FAT_ENT_FREE)
+				clear_bit(fatent.entry, map->bits);
+		} while (fat_ent_next(sbi, &fatent));
+		map->scanned = fatent.entry;
+		unlock_fat(sbi);
+
+		cond_resched();
+	}
+
+	lock_fat(sbi);
+	sbi->free_clusters = sbi->max_cluster -
+		bitmap_weight(map->bits, sbi->max_cluster);
+	sbi->free_clus_valid = 1;
+	map->build_ms = ktime_to_ms(ktime_sub(ktime_get(), start));
+	map->valid = 1;
+	unlock_fat(sbi);
+	mark_fsinfo_dirty(sb);
+out:
+	fatent_brelse(&fatent);
+}
+
+static int fat_alloc_stat_show(struct seq_file *m, void *v)
+{
+	struct msdos_sb_info *sbi = m->private;
+	struct fat_free_map *map;
+
+	lock_fat(sbi);
+	map = sbi->free_map;
+	if (!map)
+		goto out;
+	seq_printf(m, "map_valid: %d\n", map->valid);
+	seq_printf(m, "map_build_ms: %u\n", map->build_ms);
+	seq_printf(m, "free_clusters: %d\n", (int)sbi->free_clusters);
+	seq_printf(m, "allocs: %lu\n", map->allocs);
+	seq_printf(m, "alloc_avg_us: %llu\n", map->allocs ?
+		   div64_u64(map->alloc_ns, map->allocs * 1000ULL) : 0);
+	seq_printf(m, "alloc_max_us: %llu\n",
+		   div64_u64(map->alloc_max_ns, 1000));
+	seq_printf(m, "prealloc_hits: %lu\n", map->prealloc_hits);
+out:
+	unlock_fat(sbi);
+
+	return 0;
+}
+
+static int fat_alloc_stat_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, fat_alloc_stat_show, inode->i_private);
+}
+
+static const struct file_operations fat_alloc_stat_fops = {
+	.open		= fat_alloc_stat_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+/*
+ * Start building the free cluster map of a writable volume in the
+ * background. Volumes whose map would be larger than FAT_FREE_MAP_MAX,
+ * or when memory is short, keep using the linear search.
+ */
+void fat_free_map_init(struct super_block *sb)
+{
+	struct msdos_sb_info *sbi = MSDOS_SB(sb);
+	struct fat_free_map *map;
+	size_t size = BITS_TO_LONGS(sbi->max_cluster) * sizeof(long);
+
+	if (sb->s_flags & MS_RDONLY || size > FAT_FREE_MAP_MAX)
+		return;
+
+	map = kzalloc(sizeof(*map), GFP_KERNEL);
+	if (!map)
+		return;
+	map->bits = vmalloc(size);
+	if (!map->bits) {
+		kfree(map);
+		return;
+	}
+	bitmap_fill(map->bits, sbi->max_cluster);
+	map->sb = sb;
+	map->scanned = FAT_START_ENT;
+	INIT_WORK(&map->build, fat_free_map_build);
+	INIT_LIST_HEAD(&map->prealloc);
+
+	if (!IS_ERR_OR_NULL(fat_debugfs_root)) {
+		map->debugfs = debugfs_create_dir(sb->s_id, fat_debugfs_root);
+		if (!IS_ERR_OR_NULL(map->debugfs))
+			debugfs_create_file("alloc_stat", S_IRUSR,
+					    map->debugfs, sbi,
+					    &fat_alloc_stat_fops);
+	}
+
+	sbi->free_map = map;
+	queue_work(system_unbound_wq, &map->build);
+}
+
+void fat_free_map_exit(struct super_block *sb)
+{
+	struct msdos_sb_info *sbi = MSDOS_SB(sb);
+	struct fat_free_map *map = sbi->free_map;
+
+	if (!map)
+		return;
+
+	WRITE_ONCE(map->stop, 1);
+	cancel_work_sync(&map->build);
+	debugfs_remove_recursive(map->debugfs);
+
+	lock_fat(sbi);
+	fat_prealloc_drop_all(map);
+	sbi->free_map = NULL;
+	unlock_fat(sbi);
+
+	vfree(map->bits);
+	kfree(map);
+}
+
+void fat_debugfs_init(void)
+{
+	fat_debugfs_root = debugfs_create_dir("fat", NULL);
+}
+
+void fat_debugfs_exit(void)
+{
+	debugfs_remove_recursive(fat_debugfs_root);
+}
@@ -144,6 +144,8 @@ static long fat_generic_compat_ioctl(struct file *filp, unsigned int cmd,
 
 static int fat_file_release(struct inode *inode, struct file *filp)
 {
+	if (filp->f_mode & FMODE_WRITE)
+		fat_prealloc_release(inode);
 	if ((filp->f_mode & FMODE_WRITE) &&
 	     MSDOS_SB(inode->i_sb)->options.flush) {
 		fat_flush_inodes(inode->i_sb, inode, NULL);
@@ -299,6 +301,8 @@ void fat_truncate_blocks(struct inode *inode, loff_t offset)
 
 	nr_clusters = (offset + (cluster_size - 1)) >> sbi->cluster_bits;
 
+	fat_prealloc_release(inode);
+	MSDOS_I(inode)->i_alloc_next = 0;
 	fat_free(inode, nr_clusters);
 	fat_flush_inodes(inode->i_sb, inode, NULL);
 }
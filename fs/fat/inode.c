@@ -559,6 +559,7 @@ static void fat_evict_inode(struct inode *inode)
 		inode->i_size = 0;
 		fat_truncate_blocks(inode, 0);
 	}
+	fat_prealloc_release(inode);
 	invalidate_inode_buffers(inode);
 	clear_inode(inode);
 	fat_cache_inval_inode(inode);
@@ -626,6 +627,7 @@ static void fat_put_super(struct super_block *sb)
 {
 	struct msdos_sb_info *sbi = MSDOS_SB(sb);
 
+	fat_free_map_exit(sb);
 	fat_set_state(sb, 0, 0);
 
 	iput(sbi->fsinfo_inode);
@@ -644,6 +646,8 @@ static struct inode *fat_alloc_inode(struct super_block *sb)
 		return NULL;
 
 	init_rwsem(&ei->truncate_lock);
+	ei->i_alloc_next = 0;
+	ei->i_pa_len = 0;
 	return &ei->vfs_inode;
 }
 
@@ -668,6 +672,7 @@ static void init_once(void *foo)
 	INIT_LIST_HEAD(&ei->cache_lru);
 	INIT_HLIST_NODE(&ei->i_fat_hash);
 	INIT_HLIST_NODE(&ei->i_dir_hash);
+	INIT_LIST_HEAD(&ei->i_pa_list);
 	inode_init_once(&ei->vfs_inode);
 }
 
@@ -1761,6 +1766,7 @@ int fat_fill_super(struct super_block *sb, void *data, int silent, int isvfat,
 	}
 
 	fat_set_state(sb, 1, 0);
+	fat_free_map_init(sb);
 	return 0;
 
 out_invalid:
@@ -1842,6 +1848,7 @@ static int __init init_fat_fs(void)
 	if (err)
 		goto failed;
 
+	fat_debugfs_init();
 	return 0;
 
 failed:
@@ -1851,6 +1858,7 @@ failed:
 
 static void __exit exit_fat_fs(void)
 {
+	fat_debugfs_exit();
 	fat_cache_destroy();
 	fat_destroy_inodecache();
 }
@@ -586,6 +586,7 @@ ssize_t fuse_simple_request(struct fuse_conn *fc, struct fuse_args *args)
 	req->out.numargs = args->out.numargs;
 	memcpy(req->out.args, args->out.args,
 	       args->out.numargs * sizeof(struct fuse_arg));
+	req->passthrough_filp = args->out.passthrough_filp;
 	fuse_request_send(fc, req);
 	ret = req->out.h.error;
 	if (!ret && args->out.argvar) {
@@ -1960,6 +1961,9 @@ static ssize_t fuse_dev_do_write(struct fuse_conn *fc,
 		req->out.h.error = kern_path((char *)req->out.args[0].value, 0,
 							req->canonical_path);
 	}
+	/* The passthrough fd belongs to the daemon, look it up now */
+	if (!err && !req->out.h.error && req->passthrough_filp)
+		fuse_passthrough_setup(fc, req);
 	fuse_copy_finish(cs);
 
 	spin_lock(&fc->lock);
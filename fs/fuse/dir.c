@@ -473,6 +473,7 @@ static int fuse_create_open(struct inode *dir, struct dentry *entry,
 	args.out.args[0].value = &outentry;
 	args.out.args[1].size = sizeof(outopen);
 	args.out.args[1].value = &outopen;
+	args.out.passthrough_filp = &ff->passthrough_filp;
 	err = fuse_simple_request(fc, &args);
 	if (err)
 		goto out_free_ff;
@@ -30,6 +30,9 @@
 /** Bias for fi->writectr, meaning new writepages must not be sent */
 #define FUSE_NOWRITE INT_MIN
 
+/** Magic number of fuse superblocks */
+#define FUSE_SUPER_MAGIC 0x65735546
+
 /** It could be as large as PATH_MAX, but would that have any uses? */
 #define FUSE_NAME_MAX 1024
 
@@ -158,6 +161,9 @@ struct fuse_file {
 
 	/** Has flock been performed on this file? */
 	bool flock:1;
+
+	/** Lower file for FOPEN_PASSTHROUGH read, write and mmap */
+	struct file *passthrough_filp;
 };
 
 /** One input argument of a request */
@@ -237,6 +243,7 @@ struct fuse_args {
 		unsigned argvar:1;
 		unsigned numargs;
 		struct fuse_arg args[2];
+		struct file **passthrough_filp;
 	} out;
 };
 
@@ -379,6 +386,9 @@ struct fuse_req {
 	/** Path used for completing d_canonical_path */
 	struct path *canonical_path;
 
+	/** Where to store the lower file of an FOPEN_PASSTHROUGH open */
+	struct file **passthrough_filp;
+
 	/** AIO control block */
 	struct fuse_io_priv *io;
 
@@ -511,6 +521,9 @@ struct fuse_conn {
 	/** write-back cache policy (default is write-through) */
 	unsigned writeback_cache:1;
 
+	/** Daemon may pass lower files through on open */
+	unsigned passthrough:1;
+
 	/*
 	 * The following bitfields are only for optimization purposes
 	 * and hence races in setting them will not cause malfunction
@@ -921,4 +934,34 @@ int fuse_do_setattr(struct dentry *dentry, struct iattr *attr,
 
 void fuse_set_initialized(struct fuse_conn *fc);
 
+#ifdef CONFIG_FUSE_PASSTHROUGH
+void fuse_passthrough_setup(struct fuse_conn *fc, struct fuse_req *req);
+ssize_t fuse_passthrough_read_iter(struct kiocb *iocb, struct iov_iter *to);
+ssize_t fuse_passthrough_write_iter(struct kiocb *iocb, struct iov_iter *from);
+int fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma);
+#else
+static inline void fuse_passthrough_setup(struct fuse_conn *fc,
+					  struct fuse_req *req)
+{
+}
+
+static inline ssize_t fuse_passthrough_read_iter(struct kiocb *iocb,
+						 struct iov_iter *to)
+{
+	return -EIO;
+}
+
+static inline ssize_t fuse_passthrough_write_iter(struct kiocb *iocb,
+						  struct iov_iter *from)
+{
+	return -EIO;
+}
+
+static inline int fuse_passthrough_mmap(struct file *file,
+					struct vm_area_struct *vma)
+{
+	return -ENODEV;
+}
+#endif
+
 #endif /* _FS_FUSE_I_H */
@@ -0,0 +1,115 @@
+/*
+  FUSE: Filesystem in Userspace
+  Copyright (C) 2001-2008  Miklos Szeredi <miklos@szeredi.hu>
+
+  This program can be distributed under the terms of the GNU GPL.
+  See the file COPYING.
+*/
+
+/*
+ * Passthrough of read, write and mmap to a lower file.
+ *
+ * A daemon which only checks permissions (like the sdcard daemon) can
+ * open the backing file itself and return its fd in the reply to OPEN
+ * or CREATE along with FOPEN_PASSTHROUGH.  Data I/O on the fuse file
+ * then goes straight to the lower filesystem, without copying through
+ * the daemon.  The fd is looked up while the reply is being written, in
+ * the context of the daemon, in the same way as FUSE_CANONICAL_PATH.
+ */
+
+#include "fuse_i.h"
+
+#include <linux/fs.h>
+#include <linux/file.h>
+#include <linux/mm.h>
+#include <linux/uio.h>
+
+void fuse_passthrough_setup(struct fuse_conn *fc, struct fuse_req *req)
+{
+	struct fuse_open_out *outarg;
+	struct file *filp;
+	struct inode *inode;
+
+	/* fuse_open_out is the last argument of both OPEN and CREATE */
+	outarg = req->out.args[req->out.numargs - 1].value;
+	if (!(outarg->open_flags & FOPEN_PASSTHROUGH))
+		return;
+
+	outarg->open_flags &= ~FOPEN_PASSTHROUGH;
+	if (!fc->passthrough)
+		return;
+
+	filp = fget(outarg->passthrough_fd);
+	if (!filp)
+		return;
+
+	/* Don't stack on ourselves or on something that can't do iter I/O */
+	inode = file_inode(filp);
+	if (!S_ISREG(inode->i_mode) ||
+	    inode->i_sb->s_magic == FUSE_SUPER_MAGIC ||
+	    inode->i_sb->s_stack_depth >= FILESYSTEM_MAX_STACK_DEPTH ||
+	    !filp->f_op->read_iter || !filp->f_op->write_iter ||
+	    !filp->f_op->mmap) {
+		fput(filp);
+		return;
+	}
+
+	/* Page cache of the fuse inode isn't used, so no FOPEN_DIRECT_IO */
+	outarg->open_flags |= FOPEN_PASSTHROUGH;
+	outarg->open_flags &= ~FOPEN_DIRECT_IO;
+	*req->passthrough_filp = filp;
+}
+
+ssize_t fuse_passthrough_read_iter(struct kiocb *iocb, struct iov_iter *to)
+{
+	struct fuse_file *ff = iocb->ki_filp->private_data;
+
+	if (!iov_iter_count(to))
+		return 0;
+
+	return vfs_iter_read(ff->passthrough_filp, to, &iocb->ki_pos);
+}
+
+ssize_t fuse_passthrough_write_iter(struct kiocb *iocb, struct iov_iter *from)
+{
+	struct file *file = iocb->ki_filp;
+	struct fuse_file *ff = file->private_data;
+	struct file *lower = ff->passthrough_filp;
+	struct inode *inode = file_inode(file);
+	ssize_t ret;
+
+	if (!iov_iter_count(from))
+		return 0;
+
+	if (file->f_flags & O_APPEND)
+		iocb->ki_pos = i_size_read(file_inode(lower));
+
+	file_start_write(lower);
+	ret = vfs_iter_write(lower, from, &iocb->ki_pos);
+	file_end_write(lower);
+
+	if (ret > 0) {
+		fuse_write_update_size(inode, iocb->ki_pos);
+		fuse_invalidate_attr(inode);
+	}
+	return ret;
+}
+
+int fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct fuse_file *ff = file->private_data;
+	struct file *lower = ff->passthrough_filp;
+	int ret;
+
+	/* Map the lower file, the vma now holds it instead of us */
+	vma->vm_file = get_file(lower);
+	ret = lower->f_op->mmap(lower, vma);
+	if (ret) {
+		vma->vm_file = file;
+		fput(lower);
+	} else {
+		fput(file);
+		file_accessed(file);
+	}
+	return ret;
+}
@@ -14,6 +14,7 @@
  */
 
 #include <linux/time.h>
+#include <linux/module.h>
 #include <linux/fs.h>
 #include <linux/jbd2.h>
 #include <linux/errno.h>
@@ -29,6 +30,16 @@
 #include <linux/bitops.h>
 #include <trace/events/jbd2.h>
 
+/*
+ * A transaction without ordered data has nothing outside the log to make
+ * durable. Its log blocks can then be written with FUA and the commit
+ * record does not need to be preceded by a cache flush.
+ */
+static bool jbd2_fua_commit;
+module_param_named(fua_commit, jbd2_fua_commit, bool, 0644);
+MODULE_PARM_DESC(fua_commit, "Commit transactions without ordered data "
+		 "using FUA writes instead of a cache flush");
+
 /*
  * IO end handler for temporary buffer_heads handling writes to the journal.
  */
@@ -119,7 +130,7 @@ static void jbd2_commit_block_csum_set(journal_t *j, struct buffer_head *bh)
 static int journal_submit_commit_record(journal_t *journal,
 					transaction_t *commit_transaction,
 					struct buffer_head **cbh,
-					__u32 crc32_sum)
+					__u32 crc32_sum, bool fua)
 {
 	struct commit_header *tmp;
 	struct buffer_head *bh;
@@ -159,7 +170,8 @@ static int journal_submit_commit_record(journal_t *journal,
 	if (journal->j_flags & JBD2_BARRIER &&
 	    !JBD2_HAS_INCOMPAT_FEATURE(journal,
 				       JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT))
-		ret = submit_bh(WRITE_SYNC | WRITE_FLUSH_FUA, bh);
+		ret = submit_bh(fua ? WRITE_SYNC | REQ_FUA :
+				WRITE_SYNC | WRITE_FLUSH_FUA, bh);
 	else
 		ret = submit_bh(WRITE_SYNC, bh);
 
@@ -396,6 +408,8 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 	tid_t first_tid;
 	int update_tail;
 	int csum_size = 0;
+	bool fua;
+	int log_write_op;
 	LIST_HEAD(io_bufs);
 	LIST_HEAD(log_bufs);
 
@@ -407,6 +421,15 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 	 * all outstanding updates to complete.
 	 */
 
+	/*
+	 * A superblock updated below relies on the commit flush, as does
+	 * an asynchronous commit record.
+	 */
+	fua = jbd2_fua_commit && (journal->j_flags & JBD2_BARRIER) &&
+	      !(journal->j_flags & JBD2_FLUSHED) &&
+	      !JBD2_HAS_INCOMPAT_FEATURE(journal,
+					 JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT);
+
 	/* Do we need to erase the effects of a prior jbd2_journal_flush? */
 	if (journal->j_flags & JBD2_FLUSHED) {
 		jbd_debug(3, "super block updated\n");
@@ -538,6 +561,10 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 					     stats.run.rs_flushing);
 
 	commit_transaction->t_state = T_FLUSH;
+	/* No handles are left, so no more ordered data can be filed */
+	if (commit_transaction->t_need_data_flush)
+		fua = false;
+	log_write_op = fua ? WRITE_SYNC | REQ_FUA : WRITE_SYNC;
 	journal->j_committing_transaction = commit_transaction;
 	journal->j_running_transaction = NULL;
 	start_time = ktime_get();
@@ -557,7 +584,7 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 
 	blk_start_plug(&plug);
 	jbd2_journal_write_revoke_records(journal, commit_transaction,
-					  &log_bufs, WRITE_SYNC);
+					  &log_bufs, log_write_op);
 
 	jbd_debug(3, "JBD2: commit phase 2b\n");
 
@@ -740,7 +767,7 @@ start_journal_io:
 				clear_buffer_dirty(bh);
 				set_buffer_uptodate(bh);
 				bh->b_end_io = journal_end_buffer_io_sync;
-				submit_bh(WRITE_SYNC, bh);
+				submit_bh(log_write_op, bh);
 			}
 			cond_resched();
 			stats.run.rs_blocks_logged += bufs;
@@ -800,7 +827,7 @@ start_journal_io:
 	if (JBD2_HAS_INCOMPAT_FEATURE(journal,
 				      JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT)) {
 		err = journal_submit_commit_record(journal, commit_transaction,
-						 &cbh, crc32_sum);
+						 &cbh, crc32_sum, false);
 		if (err)
 			__jbd2_journal_abort_hard(journal);
 	}
@@ -887,12 +914,16 @@ start_journal_io:
 	write_lock(&journal->j_state_lock);
 	J_ASSERT(commit_transaction->t_state == T_COMMIT_DFLUSH);
 	commit_transaction->t_state = T_COMMIT_JFLUSH;
+	/* Moving the tail relies on the flush to make checkpoints durable */
+	if (update_tail)
+		fua = false;
+	commit_transaction->t_fua_commit = fua;
 	write_unlock(&journal->j_state_lock);
 
 	if (!JBD2_HAS_INCOMPAT_FEATURE(journal,
 				       JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT)) {
 		err = journal_submit_commit_record(journal, commit_transaction,
-						&cbh, crc32_sum);
+						&cbh, crc32_sum, fua);
 		if (err)
 			__jbd2_journal_abort_hard(journal);
 	}
@@ -1110,6 +1141,8 @@ restart_loop:
 	commit_transaction->t_state = T_COMMIT_CALLBACK;
 	J_ASSERT(commit_transaction == journal->j_committing_transaction);
 	journal->j_commit_sequence = commit_transaction->t_tid;
+	if (!fua)
+		journal->j_flush_sequence = commit_transaction->t_tid;
 	journal->j_committing_transaction = NULL;
 	commit_time = ktime_to_ns(ktime_sub(ktime_get(), start_time));
 
@@ -1151,6 +1184,8 @@ restart_loop:
 	spin_lock(&journal->j_history_lock);
 	journal->j_stats.ts_tid++;
 	journal->j_stats.ts_requested += stats.ts_requested;
+	if (fua)
+		journal->j_stats.ts_fua++;
 	journal->j_stats.run.rs_wait += stats.run.rs_wait;
 	journal->j_stats.run.rs_request_delay += stats.run.rs_request_delay;
 	journal->j_stats.run.rs_running += stats.run.rs_running;
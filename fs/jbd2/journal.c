@@ -654,7 +654,8 @@ int jbd2_journal_start_commit(journal_t *journal, tid_t *ptid)
  * Return 1 if a given transaction has not yet sent barrier request
  * connected with a transaction commit. If 0 is returned, transaction
  * may or may not have sent the barrier. Used to avoid sending barrier
- * twice in common cases.
+ * twice in common cases. A transaction committed with FUA only (see
+ * fua_commit in commit.c) never sends one, so 1 is returned for it.
  */
 int jbd2_trans_will_send_data_barrier(journal_t *journal, tid_t tid)
 {
@@ -664,9 +665,11 @@ int jbd2_trans_will_send_data_barrier(journal_t *journal, tid_t tid)
 	if (!(journal->j_flags & JBD2_BARRIER))
 		return 0;
 	read_lock(&journal->j_state_lock);
-	/* Transaction already committed? */
-	if (tid_geq(journal->j_commit_sequence, tid))
+	/* Transaction already committed? Then a FUA commit sent none */
+	if (tid_geq(journal->j_commit_sequence, tid)) {
+		ret = !tid_geq(journal->j_flush_sequence, tid);
 		goto out;
+	}
 	commit_trans = journal->j_committing_transaction;
 	if (!commit_trans || commit_trans->t_tid != tid) {
 		ret = 1;
@@ -681,7 +684,8 @@ int jbd2_trans_will_send_data_barrier(journal_t *journal, tid_t tid)
 		    commit_trans->t_state >= T_COMMIT_DFLUSH)
 			goto out;
 	} else {
-		if (commit_trans->t_state >= T_COMMIT_JFLUSH)
+		if (commit_trans->t_state >= T_COMMIT_JFLUSH &&
+		    !commit_trans->t_fua_commit)
 			goto out;
 	}
 	ret = 1;
@@ -986,6 +990,8 @@ static int jbd2_seq_info_show(struct seq_file *seq, void *v)
 	    s->stats->run.rs_blocks / s->stats->ts_tid);
 	seq_printf(seq, "  %lu logged blocks per transaction\n",
 	    s->stats->run.rs_blocks_logged / s->stats->ts_tid);
+	seq_printf(seq, "%lu transactions committed with FUA only\n",
+		   s->stats->ts_fua);
 	return 0;
 }
 
@@ -1305,6 +1311,7 @@ static int journal_reset(journal_t *journal)
 	journal->j_tail_sequence = journal->j_transaction_sequence;
 	journal->j_commit_sequence = journal->j_transaction_sequence - 1;
 	journal->j_commit_request = journal->j_commit_sequence;
+	journal->j_flush_sequence = journal->j_commit_sequence;
 
 	journal->j_max_transaction_buffers = journal->j_maxlen / 4;
 
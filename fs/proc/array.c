@@ -83,6 +83,8 @@
 #include <linux/tracehook.h>
 #include <linux/string_helpers.h>
 #include <linux/user_namespace.h>
+#include <linux/task_stat.h>
+#include <linux/init.h>
 
 #include <asm/pgtable.h>
 #include <asm/processor.h>
@@ -708,3 +710,75 @@ const struct file_operations proc_tid_children_operations = {
 	.release = children_seq_release,
 };
 #endif /* CONFIG_CHECKPOINT_RESTORE */
+
+/*
+ * Fill the binary counterpart of a thread's stat line, see
+ * linux/task_stat.h. Doesn't sleep, so it can be called under RCU or
+ * from a css_task_iter walk.
+ */
+void proc_task_stat_entry(struct task_struct *task, struct task_stat_entry *e)
+{
+	struct pid_namespace *ns = task_active_pid_ns(current);
+	cputime_t utime, stime;
+	struct mm_struct *mm;
+
+	memset(e, 0, sizeof(*e));
+	e->pid = task_pid_nr_ns(task, ns);
+	e->tgid = task_tgid_nr_ns(task, ns);
+	e->state = get_task_state(task)[0];
+
+	task_cputime_adjusted(task, &utime, &stime);
+	e->utime_ns = cputime_to_nsecs(utime);
+	e->stime_ns = cputime_to_nsecs(stime);
+	e->min_flt = task->min_flt;
+	e->maj_flt = task->maj_flt;
+#ifdef CONFIG_SCHED_WALT
+	e->demand = task->ravg.demand;
+#endif
+
+	/* task->mm stays valid under task_lock, no need for a reference */
+	task_lock(task);
+	mm = task->mm;
+	if (mm && !(task->flags & PF_KTHREAD))
+		e->rss_kb = get_mm_rss(mm) << (PAGE_SHIFT - 10);
+	strncpy(e->comm, task->comm, sizeof(e->comm));
+	task_unlock(task);
+}
+
+static int task_stats_show(struct seq_file *m, void *v)
+{
+	struct task_stat_entry e;
+	struct task_struct *g, *t;
+
+	rcu_read_lock();
+	for_each_process_thread(g, t) {
+		proc_task_stat_entry(t, &e);
+		/* not visible in the reader's pid namespace */
+		if (!e.pid)
+			continue;
+		seq_write(m, &e, sizeof(e));
+	}
+	rcu_read_unlock();
+	return 0;
+}
+
+static int task_stats_open(struct inode *inode, struct file *file)
+{
+	/* one entry per thread, start big enough for a busy system */
+	return single_open_size(file, task_stats_show, NULL,
+				nr_threads * sizeof(struct task_stat_entry));
+}
+
+static const struct file_operations proc_task_stats_operations = {
+	.open		= task_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init proc_task_stats_init(void)
+{
+	proc_create("task_stats", S_IRUGO, NULL, &proc_task_stats_operations);
+	return 0;
+}
+fs_initcall(proc_task_stats_init);
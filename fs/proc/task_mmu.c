@@ -15,6 +15,9 @@
 #include <linux/mmu_notifier.h>
 #include <linux/mm_inline.h>
 #include <linux/ctype.h>
+#include <linux/proc_fs.h>
+#include <linux/mutex.h>
+#include <uapi/linux/smaps_rollup.h>
 
 #include <asm/elf.h>
 #include <asm/uaccess.h>
@@ -774,21 +777,45 @@ static int tid_smaps_open(struct inode *inode, struct file *file)
 	return do_maps_open(inode, file, &proc_tid_smaps_op);
 }
 
+/*
+ * Sum up the smaps of all vmas of @mm in @mss, with one walk over the page
+ * tables and without formatting anything per vma. Returns the Pss of the
+ * locked vmas.
+ */
+static u64 smaps_rollup_mm(struct mm_struct *mm, struct mem_size_stats *mss)
+{
+	struct vm_area_struct *vma;
+	struct mm_walk smaps_walk = {
+		.pmd_entry = smaps_pte_range,
+		.mm = mm,
+		.private = mss,
+	};
+	u64 locked_pss = 0;
+
+	memset(mss, 0, sizeof(*mss));
+	down_read(&mm->mmap_sem);
+	for (vma = mm->mmap; vma; vma = vma->vm_next) {
+		u64 pss = mss->pss;
+
+		if (is_vm_hugetlb_page(vma))
+			continue;
+		walk_page_vma(vma, &smaps_walk);
+		if (vma->vm_flags & VM_LOCKED)
+			locked_pss += mss->pss - pss;
+	}
+	up_read(&mm->mmap_sem);
+
+	return locked_pss;
+}
+
 static int proc_pid_smaps_simple_show(struct seq_file *m, void *v)
 {
 	struct pid *pid = (struct pid *)m->private;
 	struct task_struct *task;
 	struct mm_struct *mm;
-	struct vm_area_struct *vma;
 	struct mem_size_stats mss_total;
-	struct mem_size_stats mss;
 	int ret = 0;
 
-	struct mm_walk smaps_walk = {
-		.pmd_entry = smaps_pte_range,
-		.private = &mss,
-	};
-
 	task = get_pid_task(pid, PIDTYPE_PID);
 	if (!task) {
 		ret = -1;
@@ -801,21 +828,7 @@ static int proc_pid_smaps_simple_show(struct seq_file *m, void *v)
 		goto error_mm;
 	}
 
-	memset(&mss_total, 0, sizeof mss_total);
-	down_read(&mm->mmap_sem);
-	vma = mm->mmap;
-	while (vma) {
-		memset(&mss, 0, sizeof mss);
-		smaps_walk.mm = vma->vm_mm;
-
-		if (vma->vm_mm && !is_vm_hugetlb_page(vma)) {
-			walk_page_range(vma->vm_start, vma->vm_end, &smaps_walk);
-			mss_total.pss += mss.pss;
-			mss_total.swap_pss += mss.swap_pss;
-		}
-		vma = vma->vm_next;
-	}
-	up_read(&mm->mmap_sem);
+	smaps_rollup_mm(mm, &mss_total);
 	mmput(mm);
 
 	seq_printf(m,
@@ -843,6 +856,208 @@ const struct file_operations proc_pid_smaps_simple_operations = {
 	.release	= single_release,
 };
 
+static int proc_pid_smaps_rollup_show(struct seq_file *m, void *v)
+{
+	struct mm_struct *mm = m->private;
+	struct mem_size_stats mss;
+	u64 locked_pss;
+
+	if (!mm || !atomic_inc_not_zero(&mm->mm_users))
+		return 0;
+
+	locked_pss = smaps_rollup_mm(mm, &mss);
+	mmput(mm);
+
+	seq_printf(m,
+		   "Rss:            %8lu kB\n"
+		   "Pss:            %8lu kB\n"
+		   "Shared_Clean:   %8lu kB\n"
+		   "Shared_Dirty:   %8lu kB\n"
+		   "Private_Clean:  %8lu kB\n"
+		   "Private_Dirty:  %8lu kB\n"
+		   "Referenced:     %8lu kB\n"
+		   "Anonymous:      %8lu kB\n"
+		   "AnonHugePages:  %8lu kB\n"
+		   "Swap:           %8lu kB\n"
+		   "SwapPss:        %8lu kB\n"
+		   "Locked:         %8lu kB\n",
+		   mss.resident >> 10,
+		   (unsigned long)(mss.pss >> (10 + PSS_SHIFT)),
+		   mss.shared_clean  >> 10,
+		   mss.shared_dirty  >> 10,
+		   mss.private_clean >> 10,
+		   mss.private_dirty >> 10,
+		   mss.referenced >> 10,
+		   mss.anonymous >> 10,
+		   mss.anonymous_thp >> 10,
+		   mss.swap >> 10,
+		   (unsigned long)(mss.swap_pss >> (10 + PSS_SHIFT)),
+		   (unsigned long)(locked_pss >> (10 + PSS_SHIFT)));
+	return 0;
+}
+
+static int proc_pid_smaps_rollup_open(struct inode *inode, struct file *file)
+{
+	struct mm_struct *mm = proc_mem_open(inode, PTRACE_MODE_READ);
+	int ret;
+
+	if (IS_ERR(mm))
+		return PTR_ERR(mm);
+
+	ret = single_open(file, proc_pid_smaps_rollup_show, mm);
+	if (ret && mm)
+		mmdrop(mm);
+	return ret;
+}
+
+static int proc_pid_smaps_rollup_release(struct inode *inode,
+					 struct file *file)
+{
+	struct seq_file *seq = file->private_data;
+
+	if (seq->private)
+		mmdrop(seq->private);
+	return single_release(inode, file);
+}
+
+const struct file_operations proc_pid_smaps_rollup_operations = {
+	.open		= proc_pid_smaps_rollup_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= proc_pid_smaps_rollup_release,
+};
+
+struct smaps_rollup_batch {
+	struct mutex lock;
+	unsigned int nr;
+	pid_t pids[SMAPS_ROLLUP_BATCH_MAX];
+};
+
+static void smaps_rollup_pid(pid_t nr, struct smaps_rollup_entry *e)
+{
+	struct task_struct *task;
+	struct mm_struct *mm;
+	struct mem_size_stats mss;
+
+	memset(e, 0, sizeof(*e));
+	e->pid = nr;
+
+	rcu_read_lock();
+	task = find_task_by_vpid(nr);
+	if (task)
+		get_task_struct(task);
+	rcu_read_unlock();
+	if (!task) {
+		e->error = -ESRCH;
+		return;
+	}
+
+	/* the same check as opening /proc/<pid>/smaps */
+	mm = mm_access(task, PTRACE_MODE_READ_FSCREDS);
+	put_task_struct(task);
+	if (IS_ERR_OR_NULL(mm)) {
+		e->error = mm ? PTR_ERR(mm) : 0;
+		return;
+	}
+
+	smaps_rollup_mm(mm, &mss);
+	mmput(mm);
+
+	e->rss = mss.resident >> 10;
+	e->pss = mss.pss >> (10 + PSS_SHIFT);
+	e->uss = (mss.private_clean + mss.private_dirty) >> 10;
+	e->swap = mss.swap >> 10;
+	e->swap_pss = mss.swap_pss >> (10 + PSS_SHIFT);
+}
+
+static int smaps_rollup_batch_open(struct inode *inode, struct file *file)
+{
+	struct smaps_rollup_batch *batch;
+
+	batch = kzalloc(sizeof(*batch), GFP_KERNEL);
+	if (!batch)
+		return -ENOMEM;
+
+	mutex_init(&batch->lock);
+	file->private_data = batch;
+	return 0;
+}
+
+static ssize_t smaps_rollup_batch_write(struct file *file,
+					const char __user *buf,
+					size_t count, loff_t *ppos)
+{
+	struct smaps_rollup_batch *batch = file->private_data;
+
+	if (!count || count % sizeof(pid_t) ||
+	    count > sizeof(batch->pids))
+		return -EINVAL;
+
+	mutex_lock(&batch->lock);
+	if (copy_from_user(batch->pids, buf, count)) {
+		batch->nr = 0;
+		mutex_unlock(&batch->lock);
+		return -EFAULT;
+	}
+	batch->nr = count / sizeof(pid_t);
+	*ppos = 0;
+	mutex_unlock(&batch->lock);
+
+	return count;
+}
+
+static ssize_t smaps_rollup_batch_read(struct file *file, char __user *buf,
+				       size_t count, loff_t *ppos)
+{
+	struct smaps_rollup_batch *batch = file->private_data;
+	struct smaps_rollup_entry e;
+	ssize_t done = 0;
+	loff_t i;
+
+	if (*ppos % sizeof(e))
+		return -EINVAL;
+
+	mutex_lock(&batch->lock);
+	for (i = *ppos / sizeof(e); i < batch->nr; i++) {
+		if (count - done < sizeof(e))
+			break;
+		smaps_rollup_pid(batch->pids[i], &e);
+		if (copy_to_user(buf + done, &e, sizeof(e))) {
+			if (!done)
+				done = -EFAULT;
+			break;
+		}
+		done += sizeof(e);
+	}
+	mutex_unlock(&batch->lock);
+
+	if (done > 0)
+		*ppos += done;
+	return done;
+}
+
+static int smaps_rollup_batch_release(struct inode *inode, struct file *file)
+{
+	kfree(file->private_data);
+	return 0;
+}
+
+static const struct file_operations proc_smaps_rollup_batch_operations = {
+	.open		= smaps_rollup_batch_open,
+	.read		= smaps_rollup_batch_read,
+	.write		= smaps_rollup_batch_write,
+	.llseek		= no_llseek,
+	.release	= smaps_rollup_batch_release,
+};
+
+static int __init proc_smaps_rollup_batch_init(void)
+{
+	proc_create("smaps_rollup_batch", S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP,
+		    NULL, &proc_smaps_rollup_batch_operations);
+	return 0;
+}
+fs_initcall(proc_smaps_rollup_batch_init);
+
 const struct file_operations proc_pid_smaps_operations = {
 	.open		= pid_smaps_open,
 	.read		= seq_read,
@@ -1503,8 +1718,17 @@ struct reclaim_walk_data {
 	struct vm_area_struct *vma;
 	bool inactive_lru;
 	enum reclaim_type type;
+	/* stop after this many pages were reclaimed, 0 for no limit */
+	unsigned long nr_to_reclaim;
+	unsigned long nr_reclaimed;
 };
 
+static inline bool reclaim_budget_done(struct reclaim_walk_data *walk_data)
+{
+	return walk_data->nr_to_reclaim &&
+		walk_data->nr_reclaimed >= walk_data->nr_to_reclaim;
+}
+
 static int swapin_pte_range(pmd_t *pmd, unsigned long addr,
 			    unsigned long end, struct mm_walk *walk)
 {
@@ -1537,6 +1761,7 @@ static int reclaim_pte_range(pmd_t *pmd, unsigned long addr,
 	struct page *page;
 	LIST_HEAD(page_list);
 	int isolated;
+	unsigned long nr_reclaimed;
 
 	split_huge_page_pmd(vma, addr, pmd);
 	if (pmd_trans_unstable(pmd))
@@ -1581,11 +1806,16 @@ cont:
 	}
 	pte_unmap_unlock(pte - 1, ptl);
 #ifdef CONFIG_HISI_SWAP_ZDATA
-	walk->nr_reclaimed += reclaim_pages_from_list(&page_list, vma,
+	nr_reclaimed = reclaim_pages_from_list(&page_list, vma,
 				walk->hiber, &walk->nr_writedblock);
+	walk->nr_reclaimed += nr_reclaimed;
 #else
-	reclaim_pages_from_list(&page_list, vma);
+	nr_reclaimed = reclaim_pages_from_list(&page_list, vma);
 #endif
+	walk_data->nr_reclaimed += nr_reclaimed;
+	/* a positive return ends walk_page_range() early */
+	if (reclaim_budget_done(walk_data))
+		return 1;
 	if (addr != end)
 		goto cont;
 
@@ -1603,7 +1833,10 @@ static ssize_t reclaim_write(struct file *file, const char __user *buf,
 	enum reclaim_type type;
 	char *type_buf;
 	struct mm_walk reclaim_walk = {};
-	struct reclaim_walk_data walk_data= {NULL, false, RECLAIM_ANON};
+	struct reclaim_walk_data walk_data = {
+		.type = RECLAIM_ANON,
+	};
+	char *budget_buf;
 	unsigned long start = 0;
 	unsigned long end = 0;
 #ifdef CONFIG_HISI_SWAP_ZDATA
@@ -1626,6 +1859,14 @@ static ssize_t reclaim_write(struct file *file, const char __user *buf,
 #ifdef CONFIG_HISI_SWAP_ZDATA
 	reclaim_walk.hiber = false;
 #endif
+	/* "<type> <nr_pages>" caps how much a named type reclaims */
+	budget_buf = NULL;
+	if (!isdigit(*type_buf)) {
+		budget_buf = strchr(type_buf, ' ');
+		if (budget_buf)
+			*budget_buf++ = '\0';
+	}
+
 	if (!strcmp(type_buf, "soft"))
 		type = RECLAIM_SOFT;
 	else if (!strcmp(type_buf, "inactive"))
@@ -1657,6 +1898,14 @@ static ssize_t reclaim_write(struct file *file, const char __user *buf,
 
 	walk_data.type = type;
 
+	if (budget_buf) {
+		if (type == RECLAIM_SOFT || type == RECLAIM_SWAPIN)
+			goto out_err;
+		if (kstrtoul(skip_spaces(budget_buf), 10,
+			     &walk_data.nr_to_reclaim))
+			goto out_err;
+	}
+
 	if (type == RECLAIM_RANGE) {
 		char *token;
 		unsigned long long len, len_in, tmp;
@@ -1726,6 +1975,8 @@ static ssize_t reclaim_write(struct file *file, const char __user *buf,
 			walk_page_range(max(vma->vm_start, start),
 					min(vma->vm_end, end),
 					&reclaim_walk);
+			if (reclaim_budget_done(&walk_data))
+				break;
 			vma = vma->vm_next;
 		}
 	} else if (type == RECLAIM_SWAPIN) {
@@ -1749,6 +2000,8 @@ static ssize_t reclaim_write(struct file *file, const char __user *buf,
 			reclaim_walk.private = &walk_data;
 			walk_page_range(vma->vm_start, vma->vm_end,
 				&reclaim_walk);
+			if (reclaim_budget_done(&walk_data))
+				break;
 		}
 	}
 	flush_tlb_mm(mm);
@@ -47,6 +47,32 @@ void setup_derived_state(struct inode *inode, perm_t perm,
 	info->d_mode = mode;
 }
 
+/* The packages.list lookup is cached until the next reload of the list */
+static appid_t get_cached_appid(struct sdcardfs_sb_info *sbi,
+				struct dentry *dentry)
+{
+	struct sdcardfs_inode_info *info = SDCARDFS_I(dentry->d_inode);
+	unsigned int gen = get_packagelist_gen(sbi->pkgl_id);
+	appid_t appid;
+
+	if (READ_ONCE(info->pkgl_gen) == gen) {
+		smp_rmb();	/* d_appid was stored before pkgl_gen */
+		return READ_ONCE(info->d_appid);
+	}
+
+	appid = get_appid(sbi->pkgl_id, dentry->d_name.name);
+	WRITE_ONCE(info->d_appid, appid);
+	smp_wmb();	/* pairs with smp_rmb() above */
+	WRITE_ONCE(info->pkgl_gen, gen);
+	return appid;
+}
+
+/* The name of the inode changed, its cached appid no longer applies */
+void reset_cached_appid(struct inode *inode)
+{
+	WRITE_ONCE(SDCARDFS_I(inode)->pkgl_gen, 0);
+}
+
 void get_derived_permission(struct dentry *parent, struct dentry *dentry)
 {
 	struct sdcardfs_sb_info *sbi = SDCARDFS_SB(dentry->d_sb);
@@ -128,7 +154,7 @@ void get_derived_permission(struct dentry *parent, struct dentry *dentry)
 		case PERM_ANDROID_DATA:
 		case PERM_ANDROID_OBB:
 		case PERM_ANDROID_MEDIA:
-			appid = get_appid(sbi->pkgl_id, dentry->d_name.name);
+			appid = get_cached_appid(sbi, dentry);
 			if (appid != 0) {
 				info->d_uid = multiuser_get_uid(parent_info->userid, appid);
 			}
@@ -24,19 +24,12 @@
 #include <linux/backing-dev.h>
 #endif
 
-static ssize_t sdcardfs_read(struct file *file, char __user *buf,
-			   size_t count, loff_t *ppos)
+/* forward the upper FMODE_NOACTIVE hint to the lower file */
+static void sdcardfs_lower_noactive(struct file *file, struct file *lower_file)
 {
-	int err;
-	struct file *lower_file;
-	struct dentry *dentry = file->f_path.dentry;
 #ifdef CONFIG_SDCARD_FS_FADV_NOACTIVE
 	struct backing_dev_info *bdi;
-#endif
 
-	lower_file = sdcardfs_lower_file(file);
-
-#ifdef CONFIG_SDCARD_FS_FADV_NOACTIVE
 	if (file->f_mode & FMODE_NOACTIVE) {
 		if (!(lower_file->f_mode & FMODE_NOACTIVE)) {
 			bdi = lower_file->f_mapping->backing_dev_info;
@@ -47,6 +40,18 @@ static ssize_t sdcardfs_read(struct file *file, char __user *buf,
 		}
 	}
 #endif
+}
+
+static ssize_t sdcardfs_read(struct file *file, char __user *buf,
+			   size_t count, loff_t *ppos)
+{
+	int err;
+	struct file *lower_file;
+	struct dentry *dentry = file->f_path.dentry;
+
+	lower_file = sdcardfs_lower_file(file);
+
+	sdcardfs_lower_noactive(file, lower_file);
 
 	err = vfs_read(lower_file, buf, count, ppos);
 	/* update our inode atime upon a successful lower read */
@@ -65,23 +70,10 @@ static ssize_t sdcardfs_read_iter(struct kiocb *iocb, struct iov_iter *to)
 
 	file = iocb->ki_filp;
 	struct dentry *dentry = file->f_path.dentry;
-#ifdef CONFIG_SDCARD_FS_FADV_NOACTIVE
-	struct backing_dev_info *bdi;
-#endif
 
 	lower_file = sdcardfs_lower_file(file);
 
-#ifdef CONFIG_SDCARD_FS_FADV_NOACTIVE
-	if (file->f_mode & FMODE_NOACTIVE) {
-		if (!(lower_file->f_mode & FMODE_NOACTIVE)) {
-			bdi = lower_file->f_mapping->backing_dev_info;
-			lower_file->f_ra.ra_pages = bdi->ra_pages * 2;
-			spin_lock(&lower_file->f_lock);
-			lower_file->f_mode |= FMODE_NOACTIVE;
-			spin_unlock(&lower_file->f_lock);
-		}
-	}
-#endif
+	sdcardfs_lower_noactive(file, lower_file);
 
 	err = vfs_iter_read(lower_file, to, &iocb->ki_pos);
 	/* update our inode atime upon a successful lower read */
@@ -122,6 +114,35 @@ static ssize_t sdcardfs_write_iter(struct kiocb *iocb, struct iov_iter *from)
 	return err;
 }
 
+/*
+ * Hand the pages of the lower page cache to the pipe as they are, without
+ * this the splice falls back to ->read into freshly allocated pages.
+ */
+static ssize_t sdcardfs_splice_read(struct file *file, loff_t *ppos,
+				struct pipe_inode_info *pipe, size_t len,
+				unsigned int flags)
+{
+	ssize_t err;
+	struct file *lower_file;
+	struct dentry *dentry = file->f_path.dentry;
+
+	lower_file = sdcardfs_lower_file(file);
+	sdcardfs_lower_noactive(file, lower_file);
+
+	if (lower_file->f_op->splice_read)
+		err = lower_file->f_op->splice_read(lower_file, ppos, pipe,
+							len, flags);
+	else
+		err = default_file_splice_read(lower_file, ppos, pipe,
+							len, flags);
+	/* update our inode atime upon a successful lower read */
+	if (err >= 0)
+		fsstack_copy_attr_atime(d_inode(dentry),
+					file_inode(lower_file));
+
+	return err;
+}
+
 static ssize_t sdcardfs_write(struct file *file, const char __user *buf,
 			    size_t count, loff_t *ppos)
 {
@@ -406,6 +427,9 @@ const struct file_operations sdcardfs_main_fops = {
 	.fasync		= sdcardfs_fasync,
 	.read_iter	= sdcardfs_read_iter,
 	.write_iter	= sdcardfs_write_iter,
+	.splice_read	= sdcardfs_splice_read,
+	/* goes through sdcardfs_write_iter(), which does the space check */
+	.splice_write	= iter_file_splice_write,
 	.get_lower_file	= sdcardfs_get_lower_file,
 };
 
@@ -637,6 +637,8 @@ static int sdcardfs_rename(struct inode *old_dir, struct dentry *old_dentry,
 	sdcardfs_copy_inode_attr(new_dir, d_inode(lower_new_dir_dentry));
 	fsstack_copy_inode_size(new_dir, d_inode(lower_new_dir_dentry));
 	fix_derived_permission(new_dir);
+	if (d_inode(old_dentry))
+		reset_cached_appid(d_inode(old_dentry));
 	if (new_dir != old_dir) {
 		sdcardfs_copy_inode_attr(old_dir, d_inode(lower_old_dir_dentry));
 		fsstack_copy_inode_size(old_dir, d_inode(lower_old_dir_dentry));
@@ -25,6 +25,9 @@
 #include <linux/kthread.h>
 #include <linux/inotify.h>
 #include <linux/delay.h>
+#include <linux/rcupdate.h>
+#include <linux/ktime.h>
+#include <linux/kobject.h>
 
 #define STRING_BUF_SIZE		(512)
 
@@ -32,12 +35,18 @@ struct hashtable_entry {
 	struct hlist_node hlist;
 	void *key;
 	unsigned int value;
+	unsigned int seen;	/* last reload that found it in the file */
+	struct rcu_head rcu;
 };
 
 struct packagelist_data {
 	DECLARE_HASHTABLE(package_to_appid,8);
 	DECLARE_HASHTABLE(appid_with_rw,7);
-	struct mutex hashtable_lock;
+	unsigned int gen;	/* bumped after each change, never 0 */
+	unsigned int reload_seq;
+	bool changed;		/* by the reload in progress */
+	unsigned int nr_packages;
+	struct mutex hashtable_lock;	/* serializes writers */
 	struct task_struct *thread_id;
 	gid_t write_gid;
 	char *strtok_last;
@@ -49,17 +58,22 @@ struct packagelist_data {
 
 static struct kmem_cache *hashtable_entry_cachep;
 
+/* last reload of any mount, for /sys/fs/sdcardfs */
+static unsigned int pkgl_reload_us;
+static unsigned int pkgl_nr_packages;
+static struct kobject *sdcardfs_kobj;
+
 /* Path to system-provided mapping of package name to appIds */
 static const char* const kpackageslist_file = "/data/system/packages.list";
 /* Supplementary groups to execute with */
 static const gid_t kgroups[1] = { AID_PACKAGE_INFO };
 
 static unsigned int str_hash(const char *key) {
-	int i;
-	unsigned int h = strlen(key);
+	unsigned int len = strlen(key);
+	unsigned int h = len;
 	char *data = (char *)key;
 
-	for (i = 0; i < strlen(key); i++) {
+	while (len--) {
 		h = h * 31 + *data;
 		data++;
 	}
@@ -69,7 +83,7 @@ static unsigned int str_hash(const char *key) {
 static int contain_appid_key(struct packagelist_data *pkgl_dat, unsigned int appid) {
 	struct hashtable_entry *hash_cur;
 
-	hash_for_each_possible(pkgl_dat->appid_with_rw, hash_cur, hlist, appid)
+	hash_for_each_possible_rcu(pkgl_dat->appid_with_rw, hash_cur, hlist, appid)
 		if ((void *)(uintptr_t)appid == hash_cur->key)
 			return 1;
 
@@ -89,35 +103,44 @@ int get_caller_has_rw_locked(void *pkgl_id, derive_t derive) {
 	}
 
 	appid = multiuser_get_app_id(xfs_kuid_to_uid(current_fsuid()));
-	mutex_lock(&pkgl_dat->hashtable_lock);
+	rcu_read_lock();
 	ret = contain_appid_key(pkgl_dat, appid);
-	mutex_unlock(&pkgl_dat->hashtable_lock);
+	rcu_read_unlock();
 	return ret;
 #endif
         return 0;
 }
 
+/* Changes on each change of packages.list, read it before get_appid() */
+unsigned int get_packagelist_gen(void *pkgl_id)
+{
+	struct packagelist_data *pkgl_dat = (struct packagelist_data *)pkgl_id;
+	unsigned int gen = READ_ONCE(pkgl_dat->gen);
+
+	/* pairs with smp_wmb() in read_package_list() */
+	smp_rmb();
+	return gen;
+}
+
 appid_t get_appid(void *pkgl_id, const char *app_name)
 {
 	struct packagelist_data *pkgl_dat = (struct packagelist_data *)pkgl_id;
 	struct hashtable_entry *hash_cur;
 	unsigned int hash = str_hash(app_name);
-	appid_t ret_id;
+	appid_t ret_id = 0;
 
 	//printk(KERN_INFO "sdcardfs: %s: %s, %u\n", __func__, (char *)app_name, hash);
-	mutex_lock(&pkgl_dat->hashtable_lock);
-	hash_for_each_possible(pkgl_dat->package_to_appid, hash_cur, hlist, hash) {
+	rcu_read_lock();
+	hash_for_each_possible_rcu(pkgl_dat->package_to_appid, hash_cur, hlist, hash) {
 		//printk(KERN_INFO "sdcardfs: %s: %s\n", __func__, (char *)hash_cur->key);
 		if (!strcasecmp(app_name, hash_cur->key)) {
-			ret_id = (appid_t)hash_cur->value;
-			mutex_unlock(&pkgl_dat->hashtable_lock);
-			//printk(KERN_INFO "=> app_id: %d\n", (int)ret_id);
-			return ret_id;
+			ret_id = (appid_t)READ_ONCE(hash_cur->value);
+			break;
 		}
 	}
-	mutex_unlock(&pkgl_dat->hashtable_lock);
-	//printk(KERN_INFO "=> app_id: %d\n", 0);
-	return 0;
+	rcu_read_unlock();
+	//printk(KERN_INFO "=> app_id: %d\n", (int)ret_id);
+	return ret_id;
 }
 
 /* Kernel has already enforced everything we returned through
@@ -184,7 +207,11 @@ static int insert_str_to_int(struct packagelist_data *pkgl_dat, char *key,
 	//printk(KERN_INFO "sdcardfs: %s: %s: %d, %u\n", __func__, (char *)key, value, hash);
 	hash_for_each_possible(pkgl_dat->package_to_appid, hash_cur, hlist, hash) {
 		if (!strcasecmp(key, hash_cur->key)) {
-			hash_cur->value = value;
+			if (hash_cur->value != value) {
+				WRITE_ONCE(hash_cur->value, value);
+				pkgl_dat->changed = true;
+			}
+			hash_cur->seen = pkgl_dat->reload_seq;
 			return 0;
 		}
 	}
@@ -192,11 +219,27 @@ static int insert_str_to_int(struct packagelist_data *pkgl_dat, char *key,
 	if (!new_entry)
 		return -ENOMEM;
 	new_entry->key = kstrdup(key, GFP_KERNEL);
+	if (!new_entry->key) {
+		kmem_cache_free(hashtable_entry_cachep, new_entry);
+		return -ENOMEM;
+	}
 	new_entry->value = value;
-	hash_add(pkgl_dat->package_to_appid, &new_entry->hlist, hash);
+	new_entry->seen = pkgl_dat->reload_seq;
+	hash_add_rcu(pkgl_dat->package_to_appid, &new_entry->hlist, hash);
+	pkgl_dat->nr_packages++;
+	pkgl_dat->changed = true;
 	return 0;
 }
 
+static void free_str_to_int(struct rcu_head *head)
+{
+	struct hashtable_entry *h_entry =
+		container_of(head, struct hashtable_entry, rcu);
+
+	kfree(h_entry->key);
+	kmem_cache_free(hashtable_entry_cachep, h_entry);
+}
+
 static void remove_str_to_int(struct hashtable_entry *h_entry) {
 	//printk(KERN_INFO "sdcardfs: %s: %s: %d\n", __func__, (char *)h_entry->key, h_entry->value);
 	kfree(h_entry->key);
@@ -212,7 +255,8 @@ static int insert_int_to_null(struct packagelist_data *pkgl_dat, unsigned int ke
 	//printk(KERN_INFO "sdcardfs: %s: %d: %d\n", __func__, (int)key, value);
 	hash_for_each_possible(pkgl_dat->appid_with_rw,	hash_cur, hlist, key) {
 		if ((void *)(uintptr_t)key == hash_cur->key) {
-			hash_cur->value = value;
+			WRITE_ONCE(hash_cur->value, value);
+			hash_cur->seen = pkgl_dat->reload_seq;
 			return 0;
 		}
 	}
@@ -221,15 +265,46 @@ static int insert_int_to_null(struct packagelist_data *pkgl_dat, unsigned int ke
 		return -ENOMEM;
 	new_entry->key = (void *)(uintptr_t)key;
 	new_entry->value = value;
-	hash_add(pkgl_dat->appid_with_rw, &new_entry->hlist, key);
+	new_entry->seen = pkgl_dat->reload_seq;
+	hash_add_rcu(pkgl_dat->appid_with_rw, &new_entry->hlist, key);
 	return 0;
 }
 
+static void free_int_to_null(struct rcu_head *head)
+{
+	kmem_cache_free(hashtable_entry_cachep,
+			container_of(head, struct hashtable_entry, rcu));
+}
+
 static void remove_int_to_null(struct hashtable_entry *h_entry) {
 	//printk(KERN_INFO "sdcardfs: %s: %d: %d\n", __func__, (int)h_entry->key, h_entry->value);
 	kmem_cache_free(hashtable_entry_cachep, h_entry);
 }
 
+/* Drop what the reload in progress did not find in the file any more */
+static void remove_stale_hashentrys(struct packagelist_data *pkgl_dat)
+{
+	struct hashtable_entry *hash_cur;
+	struct hlist_node *h_t;
+	int i;
+
+	hash_for_each_safe(pkgl_dat->package_to_appid, i, h_t, hash_cur, hlist) {
+		if (hash_cur->seen == pkgl_dat->reload_seq)
+			continue;
+		hash_del_rcu(&hash_cur->hlist);
+		call_rcu(&hash_cur->rcu, free_str_to_int);
+		pkgl_dat->nr_packages--;
+		pkgl_dat->changed = true;
+	}
+	hash_for_each_safe(pkgl_dat->appid_with_rw, i, h_t, hash_cur, hlist) {
+		if (hash_cur->seen == pkgl_dat->reload_seq)
+			continue;
+		hash_del_rcu(&hash_cur->hlist);
+		call_rcu(&hash_cur->rcu, free_int_to_null);
+	}
+}
+
+/* No lookups may be running any more */
 static void remove_all_hashentrys(struct packagelist_data *pkgl_dat)
 {
 	struct hashtable_entry *hash_cur;
@@ -243,75 +318,106 @@ static void remove_all_hashentrys(struct packagelist_data *pkgl_dat)
 
 	hash_init(pkgl_dat->package_to_appid);
 	hash_init(pkgl_dat->appid_with_rw);
+	pkgl_dat->nr_packages = 0;
 }
 
-static int read_package_list(struct packagelist_data *pkgl_dat) {
+static int read_package_line(struct packagelist_data *pkgl_dat, char *line)
+{
+	unsigned int appid;
+	unsigned long ret_gid;
+	char *token;
 	int ret;
+
+	if (sscanf(line, "%s %u %*d %*s %*s %s",
+			pkgl_dat->app_name_buf, &appid,
+			pkgl_dat->gids_buf) != 3)
+		return 0;
+
+	ret = insert_str_to_int(pkgl_dat, pkgl_dat->app_name_buf, appid);
+	if (ret)
+		return ret;
+
+	token = strtok_r(pkgl_dat->gids_buf, ",", &pkgl_dat->strtok_last);
+	while (token != NULL) {
+		if (!kstrtoul(token, 10, &ret_gid) &&
+				(ret_gid == pkgl_dat->write_gid))
+			return insert_int_to_null(pkgl_dat, appid, 1);
+		token = strtok_r(NULL, ",", &pkgl_dat->strtok_last);
+	}
+	return 0;
+}
+
+/*
+ * The file is read in chunks and applied line by line to the live tables,
+ * lookups running meanwhile see each package either before or after its
+ * update. Packages gone from the file are dropped only once all of it
+ * was read, a failed reload leaves them in place.
+ */
+static int read_package_list(struct packagelist_data *pkgl_dat) {
+	ktime_t start = ktime_get();
+	int ret = 0;
 	int fd;
 	int read_amount;
+	int len = 0;
 
 	printk(KERN_INFO "sdcardfs: read_package_list\n");
 
-	mutex_lock(&pkgl_dat->hashtable_lock);
-
-	remove_all_hashentrys(pkgl_dat);
-
 	fd = sys_open(kpackageslist_file, O_RDONLY, 0);
 	if (fd < 0) {
 		printk(KERN_ERR "sdcardfs: failed to open package list\n");
-		mutex_unlock(&pkgl_dat->hashtable_lock);
 		return fd;
 	}
 
-	while ((read_amount = sys_read(fd, pkgl_dat->read_buf,
-					sizeof(pkgl_dat->read_buf))) > 0) {
-		unsigned int appid;
-		char *token;
-		int one_line_len = 0;
-		int additional_read;
-		unsigned long ret_gid;
-
-		while (one_line_len < read_amount) {
-			if (pkgl_dat->read_buf[one_line_len] == '\n') {
-				one_line_len++;
-				break;
-			}
-			one_line_len++;
+	mutex_lock(&pkgl_dat->hashtable_lock);
+	pkgl_dat->reload_seq++;
+	pkgl_dat->changed = false;
+
+	/* one byte is kept for the terminating NUL */
+	while ((read_amount = sys_read(fd, pkgl_dat->read_buf + len,
+				sizeof(pkgl_dat->read_buf) - 1 - len)) > 0) {
+		char *line = pkgl_dat->read_buf;
+		char *eol;
+
+		len += read_amount;
+		pkgl_dat->read_buf[len] = '\0';
+
+		while ((eol = strchr(line, '\n')) != NULL) {
+			*eol = '\0';
+			ret = read_package_line(pkgl_dat, line);
+			if (ret)
+				goto out;
+			line = eol + 1;
 		}
-		additional_read = read_amount - one_line_len;
-		if (additional_read > 0)
-			sys_lseek(fd, -additional_read, SEEK_CUR);
-
-		if (sscanf(pkgl_dat->read_buf, "%s %u %*d %*s %*s %s",
-				pkgl_dat->app_name_buf, &appid,
-				pkgl_dat->gids_buf) == 3) {
-			ret = insert_str_to_int(pkgl_dat, pkgl_dat->app_name_buf, appid);
-			if (ret) {
-				sys_close(fd);
-				mutex_unlock(&pkgl_dat->hashtable_lock);
-				return ret;
-			}
 
-			token = strtok_r(pkgl_dat->gids_buf, ",", &pkgl_dat->strtok_last);
-			while (token != NULL) {
-				if (!kstrtoul(token, 10, &ret_gid) &&
-						(ret_gid == pkgl_dat->write_gid)) {
-					ret = insert_int_to_null(pkgl_dat, appid, 1);
-					if (ret) {
-						sys_close(fd);
-						mutex_unlock(&pkgl_dat->hashtable_lock);
-						return ret;
-					}
-					break;
-				}
-				token = strtok_r(NULL, ",", &pkgl_dat->strtok_last);
-			}
+		len -= line - pkgl_dat->read_buf;
+		if (len == sizeof(pkgl_dat->read_buf) - 1) {
+			/* too long for a package, skip it as sscanf() would */
+			printk(KERN_ERR "sdcardfs: skipping long package line\n");
+			len = 0;
 		}
+		memmove(pkgl_dat->read_buf, line, len);
 	}
-
-	sys_close(fd);
+	/* the file may not end with a newline */
+	if (read_amount == 0 && len) {
+		pkgl_dat->read_buf[len] = '\0';
+		ret = read_package_line(pkgl_dat, pkgl_dat->read_buf);
+	}
+	if (!ret && read_amount < 0)
+		ret = read_amount;
+	if (!ret)
+		remove_stale_hashentrys(pkgl_dat);
+out:
+	if (pkgl_dat->changed) {
+		/* pairs with smp_rmb() in get_packagelist_gen() */
+		smp_wmb();
+		WRITE_ONCE(pkgl_dat->gen, pkgl_dat->gen + 1 ?: 1);
+	}
+	WRITE_ONCE(pkgl_nr_packages, pkgl_dat->nr_packages);
 	mutex_unlock(&pkgl_dat->hashtable_lock);
-	return 0;
+	sys_close(fd);
+
+	WRITE_ONCE(pkgl_reload_us, ktime_us_delta(ktime_get(), start));
+	return ret;
 }
 
 static int packagelist_reader(void *thread_data)
@@ -410,6 +516,7 @@ void * packagelist_create(gid_t write_gid)
 	mutex_init(&pkgl_dat->hashtable_lock);
 	hash_init(pkgl_dat->package_to_appid);
 	hash_init(pkgl_dat->appid_with_rw);
+	pkgl_dat->gen = 1;
 	pkgl_dat->write_gid = write_gid;
 
         packagelist_thread = kthread_run(packagelist_reader, (void *)pkgl_dat, "pkgld");
@@ -438,6 +545,32 @@ void packagelist_destroy(void *pkgl_id)
 	kfree(pkgl_dat);
 }
 
+static ssize_t packages_reload_us_show(struct kobject *kobj,
+				struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", READ_ONCE(pkgl_reload_us));
+}
+
+static ssize_t packages_count_show(struct kobject *kobj,
+				struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", READ_ONCE(pkgl_nr_packages));
+}
+
+static struct kobj_attribute packages_reload_us_attr =
+	__ATTR_RO(packages_reload_us);
+static struct kobj_attribute packages_count_attr = __ATTR_RO(packages_count);
+
+static struct attribute *packagelist_attrs[] = {
+	&packages_reload_us_attr.attr,
+	&packages_count_attr.attr,
+	NULL,
+};
+
+static const struct attribute_group packagelist_attr_group = {
+	.attrs = packagelist_attrs,
+};
+
 int packagelist_init(void)
 {
 	hashtable_entry_cachep =
@@ -448,11 +581,26 @@ int packagelist_init(void)
 		return -ENOMEM;
 	}
 
+	/* only statistics, sdcardfs works without them */
+	sdcardfs_kobj = kobject_create_and_add("sdcardfs", fs_kobj);
+	if (!sdcardfs_kobj ||
+		sysfs_create_group(sdcardfs_kobj, &packagelist_attr_group)) {
+		printk(KERN_ERR "sdcardfs: failed creating sysfs entries\n");
+		kobject_put(sdcardfs_kobj);
+		sdcardfs_kobj = NULL;
+	}
+
         return 0;
 }
 
 void packagelist_exit(void)
 {
+	if (sdcardfs_kobj) {
+		sysfs_remove_group(sdcardfs_kobj, &packagelist_attr_group);
+		kobject_put(sdcardfs_kobj);
+	}
+	/* wait for the entries dropped by the last reloads */
+	rcu_barrier();
 	if (hashtable_entry_cachep)
 		kmem_cache_destroy(hashtable_entry_cachep);
 }
@@ -214,6 +214,11 @@ struct sdcardfs_inode_info {
 	mode_t d_mode;
 
 	bool under_android;
+
+	/* appid of the package named like this inode, see get_cached_appid() */
+	appid_t d_appid;
+	unsigned int pkgl_gen;	/* 0 if not cached */
+
 	struct inode vfs_inode;
 };
 
@@ -455,6 +460,7 @@ void sdcardfs_add_super(struct sdcardfs_sb_info *, struct super_block *);
 
 /* for packagelist.c */
 extern int get_caller_has_rw_locked(void *pkgl_id, derive_t derive);
+extern unsigned int get_packagelist_gen(void *pkgl_id);
 extern appid_t get_appid(void *pkgl_id, const char *app_name);
 extern int check_caller_access_to_name(struct inode *parent_node, const char* name,
                                         derive_t derive, int w_ok, int has_rw);
@@ -468,6 +474,7 @@ extern void packagelist_exit(void);
 extern void setup_derived_state(struct inode *inode, perm_t perm,
 			userid_t userid, uid_t uid, gid_t gid, mode_t mode);
 extern void get_derived_permission(struct dentry *parent, struct dentry *dentry);
+extern void reset_cached_appid(struct inode *inode);
 extern void update_derived_permission(struct dentry *dentry);
 extern int need_graft_path(struct dentry *dentry);
 extern int is_base_obbpath(struct dentry *dentry);
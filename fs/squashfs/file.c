@@ -498,6 +498,103 @@ out:
 }
 
 
+#ifdef CONFIG_SQUASHFS_READAHEAD
+/*
+ * Read the locked readahead pages in page[] of datablock index.  Sparse,
+ * fragment and unreadable blocks go through squashfs_readpage a page at
+ * a time.
+ */
+static void squashfs_readahead_index(struct file *file, struct inode *inode,
+	struct page **page, int index, bool async)
+{
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	int shift = msblk->block_log - PAGE_CACHE_SHIFT;
+	int file_end = i_size_read(inode) >> msblk->block_log;
+	int last_page = (i_size_read(inode) - 1) >> PAGE_CACHE_SHIFT;
+	int start_index = index << shift;
+	int pages = min(1 << shift, last_page - start_index + 1);
+	int i;
+
+	if (index < file_end || squashfs_i(inode)->fragment_block ==
+					SQUASHFS_INVALID_BLK) {
+		u64 block = 0;
+		int bsize = read_blocklist(inode, index, &block);
+
+		if (bsize > 0) {
+			squashfs_readahead_block(inode, page, pages,
+					start_index, block, bsize, async);
+			memset(page, 0, pages * sizeof(struct page *));
+			return;
+		}
+	}
+
+	for (i = 0; i < pages; i++) {
+		if (page[i] == NULL)
+			continue;
+		squashfs_readpage(file, page[i]);
+		page_cache_release(page[i]);
+		page[i] = NULL;
+	}
+}
+
+/*
+ * Add the readahead pages to the page cache and read them a datablock
+ * at a time.  The later blocks are queued to be decompressed on other
+ * cpus, then the first block, which the reader is most likely waiting
+ * on, is decompressed here.
+ */
+static int squashfs_readpages(struct file *file, struct address_space *mapping,
+	struct list_head *pages, unsigned nr_pages)
+{
+	struct inode *inode = mapping->host;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	int shift = msblk->block_log - PAGE_CACHE_SHIFT;
+	int mask = (1 << shift) - 1;
+	int index = -1, first = -1;
+	struct page **head, **page;
+
+	head = kcalloc(2 << shift, sizeof(struct page *), GFP_KERNEL);
+	if (head == NULL)
+		return -ENOMEM;
+	page = head + (1 << shift);
+
+	while (!list_empty(pages)) {
+		struct page *p = list_entry(pages->prev, struct page, lru);
+		int n = p->index >> shift;
+
+		list_del(&p->lru);
+		if (add_to_page_cache_lru(p, mapping, p->index, GFP_KERNEL)) {
+			page_cache_release(p);
+			continue;
+		}
+
+		if (first == -1)
+			first = n;
+		if (n == first) {
+			head[p->index & mask] = p;
+			continue;
+		}
+
+		if (n != index && index != -1)
+			squashfs_readahead_index(file, inode, page, index, true);
+		index = n;
+		page[p->index & mask] = p;
+	}
+
+	if (index != -1)
+		squashfs_readahead_index(file, inode, page, index, true);
+	if (first != -1)
+		squashfs_readahead_index(file, inode, head, first, false);
+
+	kfree(head);
+	return 0;
+}
+#endif
+
+
 const struct address_space_operations squashfs_aops = {
-	.readpage = squashfs_readpage
+	.readpage = squashfs_readpage,
+#ifdef CONFIG_SQUASHFS_READAHEAD
+	.readpages = squashfs_readpages,
+#endif
 };
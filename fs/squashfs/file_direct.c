@@ -13,6 +13,11 @@
 #include <linux/string.h>
 #include <linux/pagemap.h>
 #include <linux/mutex.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/workqueue.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include "squashfs_fs.h"
 #include "squashfs_fs_sb.h"
@@ -20,59 +25,82 @@
 #include "squashfs.h"
 #include "page_actor.h"
 
-static int squashfs_read_cache(struct page *target_page, u64 block, int bsize,
-	int pages, struct page **page);
+static int squashfs_read_cache(struct inode *i, struct page *target_page,
+	u64 block, int bsize, int pages, struct page **page);
 
-/* Read separately compressed datablock directly into page cache */
-int squashfs_readpage_block(struct page *target_page, u64 block, int bsize)
+/*
+ * Latency of decompressing a datablock on a page cache miss, in the
+ * faulting task (readpage) or for readahead, and how long readahead
+ * blocks wait for a worker.  Shown in <debugfs>/squashfs/latency.
+ */
+enum {
+	SQUASHFS_LAT_READPAGE,
+	SQUASHFS_LAT_READAHEAD,
+	SQUASHFS_LAT_QUEUE,
+	SQUASHFS_LAT_NR
+};
 
-{
-	struct inode *inode = target_page->mapping->host;
-	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+static struct squashfs_lat {
+	u64	count;
+	u64	total;
+	u64	max;
+} squashfs_lat[SQUASHFS_LAT_NR];
 
-	int file_end = (i_size_read(inode) - 1) >> PAGE_CACHE_SHIFT;
-	int mask = (1 << (msblk->block_log - PAGE_CACHE_SHIFT)) - 1;
-	int start_index = target_page->index & ~mask;
-	int end_index = start_index | mask;
-	int i, n, pages, missing_pages, bytes, res = -ENOMEM;
-	struct page **page;
-	struct squashfs_page_actor *actor;
-	void *pageaddr;
-
-	if (end_index > file_end)
-		end_index = file_end;
+static DEFINE_SPINLOCK(squashfs_lat_lock);
 
-	pages = end_index - start_index + 1;
-
-	page = kmalloc_array(pages, sizeof(void *), GFP_KERNEL);
-	if (page == NULL)
-		return res;
+static void squashfs_lat_record(int type, u64 start)
+{
+	u64 ns = ktime_get_ns() - start;
+	struct squashfs_lat *lat = &squashfs_lat[type];
+	unsigned long flags;
 
-	/*
-	 * Create a "page actor" which will kmap and kunmap the
-	 * page cache pages appropriately within the decompressor
-	 */
-	actor = squashfs_page_actor_init_special(page, pages, 0);
-	if (actor == NULL)
-		goto out;
+	spin_lock_irqsave(&squashfs_lat_lock, flags);
+	lat->count++;
+	lat->total += ns;
+	if (ns > lat->max)
+		lat->max = ns;
+	spin_unlock_irqrestore(&squashfs_lat_lock, flags);
+}
 
-	/* Try to grab all the pages covered by the Squashfs block */
-	for (missing_pages = 0, i = 0, n = start_index; i < pages; i++, n++) {
-		page[i] = (n == target_page->index) ? target_page :
-			grab_cache_page_nowait(target_page->mapping, n);
+/*
+ * Grab the page cache pages covered by a datablock which are not in
+ * page[] already.  Pages which can't be grabbed, or are uptodate, are
+ * left NULL.
+ */
+static void squashfs_grab_pages(struct address_space *mapping,
+	struct page **page, int pages, int start_index)
+{
+	int i, n;
 
-		if (page[i] == NULL) {
-			missing_pages++;
+	for (i = 0, n = start_index; i < pages; i++, n++) {
+		if (page[i])
 			continue;
-		}
 
-		if (PageUptodate(page[i])) {
+		page[i] = grab_cache_page_nowait(mapping, n);
+		if (page[i] && PageUptodate(page[i])) {
 			unlock_page(page[i]);
 			page_cache_release(page[i]);
 			page[i] = NULL;
-			missing_pages++;
 		}
 	}
+}
+
+/*
+ * Decompress a datablock into the locked page cache pages in page[].
+ * All pages other than target_page are unlocked and released, on error
+ * target_page (if any) is dealt with by the caller.
+ */
+static int squashfs_read_block_pages(struct inode *inode,
+	struct page *target_page, struct page **page, int pages, u64 block,
+	int bsize)
+{
+	int i, missing_pages, bytes, res = -ENOMEM;
+	struct squashfs_page_actor *actor;
+	void *pageaddr;
+
+	for (missing_pages = 0, i = 0; i < pages; i++)
+		if (page[i] == NULL)
+			missing_pages++;
 
 	if (missing_pages) {
 		/*
@@ -82,16 +110,25 @@ int squashfs_readpage_block(struct page *target_page, u64 block, int bsize)
 		 * squashfs_readpage also trying to grab them.  Fall back to
 		 * using an intermediate buffer.
 		 */
-		res = squashfs_read_cache(target_page, block, bsize, pages,
-								page);
+		res = squashfs_read_cache(inode, target_page, block, bsize,
+								pages, page);
 		if (res < 0)
 			goto mark_errored;
 
-		goto out;
+		return res;
 	}
 
+	/*
+	 * Create a "page actor" which will kmap and kunmap the
+	 * page cache pages appropriately within the decompressor
+	 */
+	actor = squashfs_page_actor_init_special(page, pages, 0);
+	if (actor == NULL)
+		goto mark_errored;
+
 	/* Decompress directly into the page cache buffers */
 	res = squashfs_read_data(inode->i_sb, block, bsize, NULL, actor);
+	kfree(actor);
 	if (res < 0)
 		goto mark_errored;
 
@@ -112,9 +149,6 @@ int squashfs_readpage_block(struct page *target_page, u64 block, int bsize)
 			page_cache_release(page[i]);
 	}
 
-	kfree(actor);
-	kfree(page);
-
 	return 0;
 
 mark_errored:
@@ -130,17 +164,197 @@ mark_errored:
 		page_cache_release(page[i]);
 	}
 
-out:
-	kfree(actor);
+	return res;
+}
+
+/* Read separately compressed datablock directly into page cache */
+int squashfs_readpage_block(struct page *target_page, u64 block, int bsize)
+
+{
+	struct inode *inode = target_page->mapping->host;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+
+	int file_end = (i_size_read(inode) - 1) >> PAGE_CACHE_SHIFT;
+	int mask = (1 << (msblk->block_log - PAGE_CACHE_SHIFT)) - 1;
+	int start_index = target_page->index & ~mask;
+	int end_index = start_index | mask;
+	int pages, res = -ENOMEM;
+	struct page **page;
+	u64 start = ktime_get_ns();
+
+	if (end_index > file_end)
+		end_index = file_end;
+
+	pages = end_index - start_index + 1;
+
+	page = kcalloc(pages, sizeof(void *), GFP_KERNEL);
+	if (page == NULL)
+		return res;
+
+	/* Try to grab all the pages covered by the Squashfs block */
+	page[target_page->index - start_index] = target_page;
+	squashfs_grab_pages(target_page->mapping, page, pages, start_index);
+
+	res = squashfs_read_block_pages(inode, target_page, page, pages, block,
+								bsize);
+	squashfs_lat_record(SQUASHFS_LAT_READPAGE, start);
+
 	kfree(page);
 	return res;
 }
 
+#ifdef CONFIG_SQUASHFS_READAHEAD
+/* A readahead datablock waiting to be decompressed by squashfs_ra_wq */
+struct squashfs_ra_work {
+	struct work_struct	work;
+	struct inode		*inode;
+	u64			block;
+	int			bsize;
+	int			pages;
+	u64			queued;
+	struct page		*page[0];
+};
+
+static struct workqueue_struct *squashfs_ra_wq;
+
+static void squashfs_ra_work_fn(struct work_struct *work)
+{
+	struct squashfs_ra_work *ra = container_of(work,
+					struct squashfs_ra_work, work);
+	u64 start = ktime_get_ns();
+
+	squashfs_lat_record(SQUASHFS_LAT_QUEUE, ra->queued);
+	squashfs_read_block_pages(ra->inode, NULL, ra->page, ra->pages,
+						ra->block, ra->bsize);
+	squashfs_lat_record(SQUASHFS_LAT_READAHEAD, start);
+	kfree(ra);
+}
+
+/*
+ * Decompress a datablock for readahead.  page[] holds the locked
+ * readahead pages of the block (NULL elsewhere), which are all unlocked
+ * and released once the block has been read.  With async the block is
+ * decompressed by an unbound worker, so the blocks of a readahead
+ * window are decompressed on all cpus at once, otherwise (or if the
+ * work can't be allocated) it is decompressed here.
+ */
+void squashfs_readahead_block(struct inode *inode, struct page **page,
+	int pages, int start_index, u64 block, int bsize, bool async)
+{
+	struct squashfs_ra_work *ra = NULL;
+	u64 start;
+
+	squashfs_grab_pages(inode->i_mapping, page, pages, start_index);
+
+	if (async && squashfs_ra_wq)
+		ra = kmalloc(sizeof(*ra) + pages * sizeof(struct page *),
+								GFP_KERNEL);
+	if (ra) {
+		INIT_WORK(&ra->work, squashfs_ra_work_fn);
+		ra->inode = inode;
+		ra->block = block;
+		ra->bsize = bsize;
+		ra->pages = pages;
+		memcpy(ra->page, page, pages * sizeof(struct page *));
+		ra->queued = ktime_get_ns();
+		queue_work(squashfs_ra_wq, &ra->work);
+		return;
+	}
+
+	start = ktime_get_ns();
+	squashfs_read_block_pages(inode, NULL, page, pages, block, bsize);
+	squashfs_lat_record(SQUASHFS_LAT_READAHEAD, start);
+}
+#endif
+
+#ifdef CONFIG_DEBUG_FS
+static struct dentry *squashfs_debugfs;
+
+static const char * const squashfs_lat_name[SQUASHFS_LAT_NR] = {
+	"readpage", "readahead", "queue"
+};
+
+static int squashfs_lat_show(struct seq_file *s, void *unused)
+{
+	struct squashfs_lat lat[SQUASHFS_LAT_NR];
+	int i;
+
+	spin_lock_irq(&squashfs_lat_lock);
+	memcpy(lat, squashfs_lat, sizeof(lat));
+	spin_unlock_irq(&squashfs_lat_lock);
+
+	seq_printf(s, "%-10s %12s %12s %12s\n", "", "count", "avg_us",
+								"max_us");
+	for (i = 0; i < SQUASHFS_LAT_NR; i++)
+		seq_printf(s, "%-10s %12llu %12llu %12llu\n",
+			squashfs_lat_name[i], lat[i].count,
+			lat[i].count ? div64_u64(lat[i].total, lat[i].count) /
+							NSEC_PER_USEC : 0,
+			div_u64(lat[i].max, NSEC_PER_USEC));
+
+	return 0;
+}
+
+static int squashfs_lat_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, squashfs_lat_show, NULL);
+}
+
+/* Any write clears the statistics */
+static ssize_t squashfs_lat_write(struct file *file, const char __user *buf,
+	size_t count, loff_t *ppos)
+{
+	spin_lock_irq(&squashfs_lat_lock);
+	memset(squashfs_lat, 0, sizeof(squashfs_lat));
+	spin_unlock_irq(&squashfs_lat_lock);
+
+	return count;
+}
+
+static const struct file_operations squashfs_lat_fops = {
+	.open		= squashfs_lat_open,
+	.read		= seq_read,
+	.write		= squashfs_lat_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+#endif
+
+int __init squashfs_file_init(void)
+{
+#ifdef CONFIG_SQUASHFS_READAHEAD
+	/*
+	 * Unbound so readahead blocks spread over the idle cpus, each
+	 * using that cpu's decompressor with DECOMP_MULTI_PERCPU
+	 */
+	squashfs_ra_wq = alloc_workqueue("squashfs_read",
+					WQ_UNBOUND | WQ_MEM_RECLAIM, 0);
+	if (squashfs_ra_wq == NULL)
+		return -ENOMEM;
+#endif
+#ifdef CONFIG_DEBUG_FS
+	squashfs_debugfs = debugfs_create_dir("squashfs", NULL);
+	if (!IS_ERR_OR_NULL(squashfs_debugfs))
+		debugfs_create_file("latency", S_IRUGO | S_IWUSR,
+				squashfs_debugfs, NULL, &squashfs_lat_fops);
+#endif
+	return 0;
+}
+
+void squashfs_file_exit(void)
+{
+#ifdef CONFIG_DEBUG_FS
+	debugfs_remove_recursive(squashfs_debugfs);
+#endif
+#ifdef CONFIG_SQUASHFS_READAHEAD
+	destroy_workqueue(squashfs_ra_wq);
+#endif
+}
+
 
-static int squashfs_read_cache(struct page *target_page, u64 block, int bsize,
-	int pages, struct page **page)
+static int squashfs_read_cache(struct inode *i, struct page *target_page,
+	u64 block, int bsize, int pages, struct page **page)
 {
-	struct inode *i = target_page->mapping->host;
 	struct squashfs_cache_entry *buffer = squashfs_get_datablock(i->i_sb,
 						 block, bsize);
 	int bytes = buffer->length, res = buffer->error, n, offset = 0;
@@ -72,6 +72,23 @@ void squashfs_copy_cache(struct page *, struct squashfs_cache_entry *, int,
 
 /* file_xxx.c */
 extern int squashfs_readpage_block(struct page *, u64, int);
+#ifdef CONFIG_SQUASHFS_FILE_DIRECT
+extern int squashfs_file_init(void);
+extern void squashfs_file_exit(void);
+#else
+static inline int squashfs_file_init(void)
+{
+	return 0;
+}
+
+static inline void squashfs_file_exit(void)
+{
+}
+#endif
+#ifdef CONFIG_SQUASHFS_READAHEAD
+extern void squashfs_readahead_block(struct inode *, struct page **, int, int,
+				u64, int, bool);
+#endif
 
 /* id.c */
 extern int squashfs_get_id(struct super_block *, unsigned int, unsigned int *);
@@ -70,6 +70,32 @@ struct logger_entry {
 	char msg[0];
 };
 
+/**
+ * struct logger_mmap_ctrl - first page of a log mapped with mmap()
+ * @seq:	Odd while the kernel is appending to the ring
+ * @size:	Size of the ring following this page, a power of two
+ * @written:	Bytes ever appended, the write offset is @written & (@size - 1)
+ * @head_pos:	Position of the oldest entry still in the ring
+ * @dropped:	Entries lost before they reached the ring
+ *
+ * The ring holds struct logger_entry records back to back, wrapping at
+ * @size. A reader keeps its own position, starting at @head_pos. To drain
+ * it samples @seq (waiting while odd), reads @written and @head_pos,
+ * copies out everything between its position and @written, and samples
+ * @seq again; if @seq moved and @head_pos passed its position, the copy
+ * may be torn and is redone from @head_pos. Only readers allowed to see
+ * every uid's entries may map the log. poll() moves pending entries into
+ * the ring and reports POLLIN once per batch of new entries.
+ */
+struct logger_mmap_ctrl {
+	__u32 seq;
+	__u32 size;
+	__u64 written;
+	__u64 head_pos;
+	__u32 dropped;
+	__u32 __pad;
+};
+
 struct hw_logger_msg {
 	struct iovec *iov;
 	unsigned long nr_segs;
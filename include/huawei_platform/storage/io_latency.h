@@ -0,0 +1,56 @@
+#ifndef _IO_LATENCY_H_
+#define _IO_LATENCY_H_
+
+#include <linux/types.h>
+
+/*
+ * Layout of /proc/io_latency, mapped read-only by the perf daemon: one
+ * page of struct io_latency_ring_hdr, followed by nr_records records.
+ * The record of sequence number n (counting from 1) lives in slot
+ * (n - 1) % nr_records and is complete once its seq reads n.
+ */
+#define IO_LATENCY_RING_MAGIC	0x494f4c54	/* "IOLT" */
+#define IO_LATENCY_RING_VERSION	1
+
+#define IO_LATENCY_WRITE	(1 << 0)
+#define IO_LATENCY_SYNC		(1 << 1)
+#define IO_LATENCY_FG		(1 << 2)
+#define IO_LATENCY_META		(1 << 3)
+
+struct io_latency_ring_hdr {
+	__u32 magic;
+	__u32 version;
+	__u32 nr_records;
+	__u32 record_size;
+	__u64 head;		/* sequence number of the latest record */
+};
+
+struct io_latency_record {
+	__u32 seq;		/* written last */
+	__u32 uid;		/* of the task that queued the request */
+	__u32 flags;		/* IO_LATENCY_* */
+	__u32 bytes;
+	__u64 done_ns;		/* ktime_get_ns() at completion */
+	__u32 queue_us;		/* queued -> handed to the driver */
+	__u32 driver_us;	/* handed to the driver -> issued to the device */
+	__u32 device_us;	/* issued to the device -> completed */
+	__u32 others_us;	/* part of queue_us spent on other uids' I/O */
+};
+
+#ifdef __KERNEL__
+struct request;
+
+#ifdef CONFIG_PROC_IO_INFO_LATENCY
+void io_latency_rq_init(struct request *req);
+void io_latency_rq_start(struct request *req);
+void io_latency_rq_issue(struct request *req);
+void io_latency_rq_done(struct request *req);
+#else
+static inline void io_latency_rq_init(struct request *req) {}
+static inline void io_latency_rq_start(struct request *req) {}
+static inline void io_latency_rq_issue(struct request *req) {}
+static inline void io_latency_rq_done(struct request *req) {}
+#endif
+#endif /* __KERNEL__ */
+
+#endif /* _IO_LATENCY_H_ */
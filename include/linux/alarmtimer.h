@@ -29,6 +29,8 @@ enum alarmtimer_restart {
  * @period:	Period for recuring alarms
  * @function:	Function pointer to be executed when the timer fires.
  * @type:	Alarm type (BOOTTIME/REALTIME)
+ * @slack:	Window in ns after node.expires within which the alarm may fire,
+ *		so that it can share a wakeup with other alarms.
  * @enabled:	Flag that represents if the alarm is set to fire or not
  * @data:	Internal data value.
  */
@@ -38,12 +40,14 @@ struct alarm {
 	enum alarmtimer_restart	(*function)(struct alarm *, ktime_t now);
 	enum alarmtimer_type	type;
 	int			state;
+	u64			slack;
 	void			*data;
 };
 
 void alarm_init(struct alarm *alarm, enum alarmtimer_type type,
 		enum alarmtimer_restart (*function)(struct alarm *, ktime_t));
 int alarm_start(struct alarm *alarm, ktime_t start);
+int alarm_start_range(struct alarm *alarm, ktime_t start, u64 slack);
 int alarm_start_relative(struct alarm *alarm, ktime_t start);
 void alarm_restart(struct alarm *alarm);
 int alarm_try_to_cancel(struct alarm *alarm);
@@ -316,6 +316,30 @@ struct blk_rq_stat {
 	s64 time;
 };
 
+/*
+ * Completion latency histogram. Bucket 0 counts requests done in less
+ * than 1us, bucket n those done in [2^(n-1), 2^n) us, the last bucket
+ * is open ended.
+ */
+#define BLK_STAT_HIST_BUCKETS	24
+
+struct blk_rq_hist {
+	u32 buckets[BLK_STAT_HIST_BUCKETS];
+};
+
+/* Request size classes of the histograms */
+enum {
+	BLK_STAT_SIZE_4K,	/* up to 4K */
+	BLK_STAT_SIZE_64K,	/* up to 64K */
+	BLK_STAT_SIZE_LARGE,	/* anything larger */
+	BLK_STAT_SIZE_NR,
+};
+
+/* Histograms kept per direction, sync/async and size class */
+#define BLK_STAT_HIST_NR	(2 * 2 * BLK_STAT_SIZE_NR)
+#define BLK_STAT_HIST_IDX(dir, sync, size)	\
+	(((dir) * 2 + !!(sync)) * BLK_STAT_SIZE_NR + (size))
+
 #define BIO_DELAY_WARNING_GENERIC_MAKE_REQ			(10)
 #define BIO_DELAY_WARNING_MERGED					(10)
 #define BIO_DELAY_WARNING_MQ_MAKE					(10)
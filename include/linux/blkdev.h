@@ -111,6 +111,7 @@ enum mq_process_enum {
 	MQ_PROCESS_RQ_NOT_MERGE_IN_HW_QUEUE,
 	MQ_PROCESS_RUN_HW_QUEUE,
 	MQ_PROCESS_FLUSH_SKIP,
+	MQ_PROCESS_FLUSH_MERGED,
 	MQ_PROCESS_ASYNC_DISPATCH,
 	MQ_PROCESS_ASYNC_DISPATCH_BUSY_RETURN,
 	MQ_PROCESS_ASYNC_DISPATCH_ERR_END,
@@ -168,6 +169,15 @@ struct request {
 #endif
 	unsigned long rq_start_jiffies;
 #endif /* CONFIG_HISI_BLK_MQ */
+#ifdef CONFIG_PROC_IO_INFO_LATENCY
+	/* see drivers/huawei_platform/storage/ioinfo/io_latency.c */
+	uid_t iolat_uid;
+	u32 iolat_seq;
+	u32 iolat_useq;
+	u64 iolat_queue_ns;
+	u64 iolat_start_ns;
+	u64 iolat_issue_ns;
+#endif
 #ifdef CONFIG_HISI_IO_LATENCY_TRACE
 	unsigned long req_stage_jiffies[REQ_PROC_STAGE_MAX];
 	unsigned char from_submit_bio_flag;
@@ -455,6 +465,24 @@ struct request_queue {
 	atomic_t flush_work_trigger;
 	atomic_t flush_from_flush_work;
 
+	/*
+	 * Flush coalescing across hctxs. The write generation counts data
+	 * write completions, a flush covers the generation it was
+	 * dispatched at.
+	 */
+	spinlock_t flush_merge_lock;
+	struct request *flush_inflight;
+	struct list_head flush_merged_list;
+	int flush_inflight_gen;
+	int flush_stable_gen;
+	bool flush_stable;
+	atomic_t flush_write_gen;
+
+	atomic_long_t flush_issued;
+	atomic_long_t flush_bypassed;
+	atomic_long_t flush_merged;
+	atomic_long_t flush_preflush_skipped;
+
 #ifdef CONFIG_HISI_MQ_DISPATCH_DECISION
 	int sync_write_io_limit;
 	int async_write_io_limit;
@@ -539,6 +567,7 @@ struct request_queue {
 
 #ifdef CONFIG_WBT
 	struct blk_rq_stat	rq_stats[4];
+	struct blk_rq_hist	rq_hist[BLK_STAT_HIST_NR];
 #endif
 
 	/*
@@ -1214,6 +1243,14 @@ extern void blk_queue_rq_timeout(struct request_queue *, unsigned int);
 extern void blk_queue_flush_queueable(struct request_queue *q, bool queueable);
 extern void blk_queue_write_cache(struct request_queue *q, bool enabled, bool fua);
 extern struct backing_dev_info *blk_get_backing_dev_info(struct block_device *bdev);
+#ifdef CONFIG_WBT
+extern u64 blk_queue_fg_read_lat(struct request_queue *q);
+#else
+static inline u64 blk_queue_fg_read_lat(struct request_queue *q)
+{
+	return 0;
+}
+#endif
 
 extern int blk_rq_map_sg(struct request_queue *, struct request *, struct scatterlist *);
 extern void blk_dump_rq_flags(struct request *, char *);
@@ -29,8 +29,13 @@ static inline bool vma_is_anonymous(struct vm_area_struct *vma)
 }
 
 #ifdef CONFIG_HW_BOOST_SIGKILL_FREE
+extern bool fast_free_mm(struct mm_struct *mm, bool trylock);
 extern void fast_free_user_mem(void);
 #else
+static inline bool fast_free_mm(struct mm_struct *mm, bool trylock)
+{
+	return true;
+}
 static inline void fast_free_user_mem(void) { }
 #endif
 
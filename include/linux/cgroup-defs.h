@@ -308,6 +308,11 @@ struct cgroup_root {
 
 	/* The name for this hierarchy - may be empty */
 	char name[MAX_CGROUP_ROOT_NAMELEN];
+
+	/* tasks and cgroup.procs writes and their latency [cgroup_mutex] */
+	u64 attach_count;
+	u64 attach_total_ns;
+	u64 attach_max_ns;
 };
 
 /*
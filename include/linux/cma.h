@@ -1,6 +1,8 @@
 #ifndef __CMA_H__
 #define __CMA_H__
 
+#include <linux/jiffies.h>
+
 /*
  * There is always at least global CMA area and a few optional
  * areas configured in kernel .config.
@@ -28,4 +30,29 @@ extern int cma_init_reserved_mem(phys_addr_t base, phys_addr_t size,
 					struct cma **res_cma);
 extern struct page *cma_alloc(struct cma *cma, size_t count, unsigned int align);
 extern bool cma_release(struct cma *cma, const struct page *pages, unsigned int count);
+extern unsigned long cma_evacuate(struct cma *cma);
+
+#ifdef CONFIG_CMA
+extern unsigned long cma_hold_expires;
+
+extern void cma_hold_placement(unsigned int msecs);
+
+/*
+ * While an area is being evacuated ahead of a large allocation, user
+ * pages that would normally go to CMA are placed elsewhere instead.
+ */
+static inline bool cma_placement_held(void)
+{
+	return time_before(jiffies, ACCESS_ONCE(cma_hold_expires));
+}
+#else
+static inline void cma_hold_placement(unsigned int msecs)
+{
+}
+
+static inline bool cma_placement_held(void)
+{
+	return false;
+}
+#endif
 #endif
@@ -38,6 +38,12 @@ extern int sysctl_extfrag_handler(struct ctl_table *table, int write,
 extern int sysctl_compact_unevictable_allowed;
 
 extern int fragmentation_index(struct zone *zone, unsigned int order);
+extern unsigned int fragmentation_score(struct zone *zone, unsigned int order);
+#ifdef CONFIG_HISI_PROACTIVE_COMPACTION
+extern int sysctl_compaction_proactiveness;
+extern int sysctl_compaction_proactive_order;
+extern int sysctl_compaction_proactive_budget;
+#endif
 extern unsigned long try_to_compact_pages(gfp_t gfp_mask, unsigned int order,
 			int alloc_flags, const struct alloc_context *ac,
 			enum migrate_mode mode, int *contended);
@@ -158,6 +158,9 @@ int cpufreq_get_policy(struct cpufreq_policy *policy, unsigned int cpu);
 int cpufreq_update_policy(unsigned int cpu);
 bool have_governor_per_policy(void);
 bool cpufreq_driver_is_slow(void);
+bool cpufreq_driver_has_fast_switch(void);
+unsigned int cpufreq_driver_fast_switch(struct cpufreq_policy *policy,
+					unsigned int target_freq);
 struct kobject *get_governor_parent_kobj(struct cpufreq_policy *policy);
 #else
 static inline unsigned int cpufreq_get(unsigned int cpu)
@@ -259,6 +262,15 @@ struct cpufreq_driver {
 	int		(*target_intermediate)(struct cpufreq_policy *policy,
 					       unsigned int index);
 
+	/*
+	 * Optional, for drivers that can switch without sleeping, e.g. by
+	 * writing a register or posting a mailbox message. Called from
+	 * scheduler context, without the transition notifiers. Returns the
+	 * frequency set, or 0 if the switch could not be done right now.
+	 */
+	unsigned int	(*fast_switch)(struct cpufreq_policy *policy,
+				       unsigned int target_freq);
+
 	/* should be defined, if possible */
 	unsigned int	(*get)(unsigned int cpu);
 
@@ -502,6 +514,21 @@ extern struct cpufreq_governor cpufreq_gov_sched;
 #define CPUFREQ_DEFAULT_GOVERNOR	(&cpufreq_gov_sched)
 #endif
 
+#if defined(CONFIG_ARCH_HISI) && IS_REACHABLE(CONFIG_CPU_FREQ_GOV_INTERACTIVE)
+int hisi_cluster_boost(int cpu);
+#else
+static inline int hisi_cluster_boost(int cpu)
+{
+	return -ENODEV;
+}
+#endif
+
+#if IS_REACHABLE(CONFIG_CPU_FREQ_GOV_INTERACTIVE) && defined(CONFIG_INPUT)
+void cpufreq_interactive_touch_boost(void);
+#else
+static inline void cpufreq_interactive_touch_boost(void) {}
+#endif
+
 /*********************************************************************
  *                     FREQUENCY TABLE HELPERS                       *
  *********************************************************************/
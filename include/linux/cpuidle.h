@@ -33,6 +33,8 @@ struct cpuidle_state_usage {
 	unsigned long long	disable;
 	unsigned long long	usage;
 	unsigned long long	time; /* in US */
+	unsigned long long	above; /* idle too short for the state */
+	unsigned long long	below; /* a deeper state would have fit */
 };
 
 struct cpuidle_state {
@@ -64,6 +66,7 @@ struct cpuidle_state {
 /* Idle State Flags */
 #define CPUIDLE_FLAG_COUPLED	(0x02) /* state applies to multiple cpus */
 #define CPUIDLE_FLAG_TIMER_STOP (0x04)  /* timer is stopped on this state */
+#define CPUIDLE_FLAG_CLUSTER	(0x08) /* state powers the cluster down */
 
 #define CPUIDLE_DRIVER_FLAGS_MASK (0xFFFF0000)
 
@@ -244,6 +247,21 @@ static inline int cpuidle_register_governor(struct cpuidle_governor *gov)
 {return 0;}
 #endif
 
+/* Periodic wakeup sources the governor can anticipate */
+enum cpuidle_event {
+	CPUIDLE_EVENT_VSYNC,
+	CPUIDLE_EVENT_SENSORHUB,
+	CPUIDLE_NR_EVENTS,
+};
+
+#ifdef CONFIG_CPU_IDLE_GOV_MENU
+extern void cpuidle_periodic_event(enum cpuidle_event event, u64 when_ns,
+				   u32 period_ns);
+#else
+static inline void cpuidle_periodic_event(enum cpuidle_event event,
+					  u64 when_ns, u32 period_ns) { }
+#endif
+
 #ifdef CONFIG_ARCH_HAS_CPU_RELAX
 #define CPUIDLE_DRIVER_STATE_START	1
 #else
@@ -10,4 +10,11 @@ extern __u16 crc_t10dif_generic(__u16 crc, const unsigned char *buffer,
 				size_t len);
 extern __u16 crc_t10dif(unsigned char const *, size_t);
 
+#ifdef CONFIG_CRC_T10DIF_ARM64
+/* PMULL folding in arch/arm64/lib, used by crc_t10dif() when set */
+extern bool crc_t10dif_use_pmull;
+extern __u16 crc_t10dif_pmull(__u16 crc, const unsigned char *buffer,
+			      size_t len);
+#endif
+
 #endif
@@ -38,6 +38,13 @@ static inline u32 crc32_le_combine(u32 crc1, u32 crc2, size_t len2)
 
 u32 __pure __crc32c_le(u32 crc, unsigned char const *p, size_t len);
 
+#ifdef CONFIG_CRC32_ARM64
+/* ARMv8 CRC instructions, used by crc32_le() and __crc32c_le() when set */
+extern bool crc32_use_arm64;
+u32 __pure crc32_le_arm64(u32 crc, unsigned char const *p, size_t len);
+u32 __pure __crc32c_le_arm64(u32 crc, unsigned char const *p, size_t len);
+#endif
+
 /**
  * __crc32c_le_combine - Combine two crc32c check values into one. For two
  * 			 sequences of bytes, seq1 and seq2 with lengths len1
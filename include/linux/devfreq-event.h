@@ -13,6 +13,11 @@
 #define __LINUX_DEVFREQ_EVENT_H__
 
 #include <linux/device.h>
+#include <linux/notifier.h>
+
+/* Events passed to devfreq_event_notify() */
+#define DEVFREQ_EVENT_LOAD_HIGH		(1 << 0)	/* over the upper threshold */
+#define DEVFREQ_EVENT_LOAD_LOW		(1 << 1)	/* under the lower threshold */
 
 /**
  * struct devfreq_event_dev - the devfreq-event device
@@ -22,6 +27,7 @@
  *		  the device using devfreq-event.
  * @lock	: a mutex to protect accessing devfreq-event.
  * @enable_count: the number of enable function have been called.
+ * @nh		: notifier chain called by devfreq_event_notify().
  * @desc	: the description for devfreq-event device.
  *
  * This structure contains devfreq-event device information.
@@ -32,6 +38,7 @@ struct devfreq_event_dev {
 	struct device dev;
 	struct mutex lock;
 	u32 enable_count;
+	struct atomic_notifier_head nh;
 
 	const struct devfreq_event_desc *desc;
 };
@@ -102,6 +109,12 @@ extern int devfreq_event_set_event(struct devfreq_event_dev *edev);
 extern int devfreq_event_get_event(struct devfreq_event_dev *edev,
 				struct devfreq_event_data *edata);
 extern int devfreq_event_reset_event(struct devfreq_event_dev *edev);
+extern int devfreq_event_register_notifier(struct devfreq_event_dev *edev,
+				struct notifier_block *nb);
+extern int devfreq_event_unregister_notifier(struct devfreq_event_dev *edev,
+				struct notifier_block *nb);
+extern void devfreq_event_notify(struct devfreq_event_dev *edev,
+				unsigned long event);
 extern struct devfreq_event_dev *devfreq_event_get_edev_by_phandle(
 				struct device *dev, int index);
 extern int devfreq_event_get_edev_count(struct device *dev);
@@ -148,6 +161,25 @@ static inline int devfreq_event_reset_event(struct devfreq_event_dev *edev)
 	return -EINVAL;
 }
 
+static inline int devfreq_event_register_notifier(
+					struct devfreq_event_dev *edev,
+					struct notifier_block *nb)
+{
+	return -EINVAL;
+}
+
+static inline int devfreq_event_unregister_notifier(
+					struct devfreq_event_dev *edev,
+					struct notifier_block *nb)
+{
+	return -EINVAL;
+}
+
+static inline void devfreq_event_notify(struct devfreq_event_dev *edev,
+					unsigned long event)
+{
+}
+
 static inline void *devfreq_event_get_drvdata(struct devfreq_event_dev *edev)
 {
 	return ERR_PTR(-EINVAL);
@@ -57,6 +57,10 @@ struct devfreq_dev_status {
  * @initial_freq:	The operating frequency when devfreq_add_device() is
  *			called.
  * @polling_ms:		The polling interval in ms. 0 disables polling.
+ * @idle_polling_ms:	The polling interval in ms once the device has stayed
+ *			at its lowest frequency for a few polling periods.
+ *			0 keeps polling_ms, or stops polling altogether if
+ *			the governor subscribed to devfreq-event devices.
  * @target:		The device should set its operating frequency at
  *			freq or lowest-upper-than-freq value. If freq is
  *			higher than any operable frequency, set maximum.
@@ -79,6 +83,7 @@ struct devfreq_dev_status {
 struct devfreq_dev_profile {
 	unsigned long initial_freq;
 	unsigned int polling_ms;
+	unsigned int idle_polling_ms;
 
 	int (*target)(struct device *dev, unsigned long *freq, u32 flags);
 	int (*get_dev_status)(struct device *dev,
@@ -136,6 +141,12 @@ struct devfreq_governor {
  * @min_freq:	Limit minimum frequency requested by user (0: none)
  * @max_freq:	Limit maximum frequency requested by user (0: none)
  * @stop_polling:	 devfreq polling status of a device.
+ * @monitor_idle:	polling is deferred while the device is at its lowest
+ *			frequency.
+ * @idle_polls:	number of polls in a row that ended at the lowest frequency.
+ * @event_subs:	devfreq-event devices whose events kick the load monitor.
+ * @total_polls:	Number of load monitor runs
+ * @total_kicks:	Number of load monitor runs requested by events
  * @total_trans:	Number of devfreq transitions
  * @trans_table:	Statistics of devfreq transitions
  * @time_in_state:	Statistics of devfreq states
@@ -169,6 +180,12 @@ struct devfreq {
 	unsigned long max_freq;
 	bool stop_polling;
 
+	bool monitor_idle;
+	unsigned int idle_polls;
+	struct list_head event_subs;
+	unsigned int total_polls;
+	unsigned int total_kicks;
+
 	/* information for device frequency transition */
 	unsigned int total_trans;
 	unsigned int *trans_table;
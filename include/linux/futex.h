@@ -14,6 +14,10 @@ long do_futex(u32 __user *uaddr, int op, u32 val, union ktime *timeout,
 extern int
 handle_futex_death(u32 __user *uaddr, struct task_struct *curr, int pi);
 
+/* kernel.futex_prio_wake and kernel.futex_wake_boost */
+extern int sysctl_futex_prio_wake;
+extern int sysctl_futex_wake_boost;
+
 /*
  * Futexes are matched on equal values of this key.
  * The key type depends on whether it's a shared or private mapping.
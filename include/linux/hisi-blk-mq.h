@@ -34,6 +34,7 @@ enum {
 	HISI_MQ_FORCE_SOFTIRQ		= 1,
 	HISI_MQ_FLUSH_REDUCING		= 2,
 	HISI_MQ_DISPATCH_DICISION	= 3,
+	HISI_MQ_VIP_IO			= 4,
 };
 
 #ifdef CONFIG_HISI_BLK_MQ
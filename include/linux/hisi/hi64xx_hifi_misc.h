@@ -99,6 +99,16 @@ enum DRV_HIFI_IMAGE_SEC_TYPE_ENUM {
 	DRV_HIFI_IMAGE_SEC_TYPE_BSS,                     /* bss section */
 	DRV_HIFI_IMAGE_SEC_TYPE_BUTT,
 };
+
+/*
+ * or'ed into the type of a code or data section: the section is stored
+ * lz4 compressed as one [le32 length][lz4 block] chunk per
+ * DRV_HIFI_IMAGE_SEC_CHUNK bytes of section data, size is unpacked size
+ */
+#define DRV_HIFI_IMAGE_SEC_LZ4			0x80
+#define DRV_HIFI_IMAGE_SEC_TYPE_MASK		0x7f
+#define DRV_HIFI_IMAGE_SEC_CHUNK		(25 * 1024)
+
 enum DRV_HIFI_IMAGE_SEC_LOAD_ENUM {
 	DRV_HIFI_IMAGE_SEC_LOAD_STATIC = 0,             /* before dsp reset  download one time*/
 	DRV_HIFI_IMAGE_SEC_LOAD_DYNAMIC,                /* maybe need download dynamic */
@@ -0,0 +1,79 @@
+/*
+ * Boot initcall profiling and asynchronous initcalls for hisi drivers
+ *
+ * Copyright (c) 2018 Hisilicon Technologies CO., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef _LINUX_HISI_BOOT_INITCALL_H
+#define _LINUX_HISI_BOOT_INITCALL_H
+
+#include <linux/init.h>
+#include <linux/types.h>
+#include <linux/completion.h>
+
+#ifdef CONFIG_HISI_BOOT_TIME
+/* called with the duration of every initcall run during boot */
+extern void hisi_boottime_initcall(initcall_t fn, u64 duration_us, bool async);
+#else
+static inline void hisi_boottime_initcall(initcall_t fn, u64 duration_us,
+					  bool async)
+{
+}
+#endif
+
+#if defined(CONFIG_HISI_ASYNC_INITCALL) && !defined(MODULE)
+struct hisi_async_initcall {
+	initcall_t fn;
+	struct hisi_async_initcall *dep;
+	struct completion done;
+};
+
+extern void hisi_async_initcall_start(struct hisi_async_initcall *call);
+
+#define __hisi_async_initcall(initfn, dep_call, level)			\
+	struct hisi_async_initcall __hisi_async_##initfn __initdata = {	\
+		.fn = initfn,						\
+		.dep = dep_call,					\
+		.done = COMPLETION_INITIALIZER(__hisi_async_##initfn.done), \
+	};								\
+	static int __init __hisi_async_start_##initfn(void)		\
+	{								\
+		hisi_async_initcall_start(&__hisi_async_##initfn);	\
+		return 0;						\
+	}								\
+	level(__hisi_async_start_##initfn)
+
+/*
+ * Run @initfn on an async thread, in parallel with the rest of its initcall
+ * level and the levels after it. Only for drivers nothing else needs at
+ * init time: a platform driver registered this way also probes off the
+ * boot thread. Everything is done before init memory is freed.
+ */
+#define hisi_async_initcall(initfn)					\
+	__hisi_async_initcall(initfn, NULL, device_initcall)
+#define hisi_async_late_initcall(initfn)				\
+	__hisi_async_initcall(initfn, NULL, late_initcall)
+
+/*
+ * As hisi_async_initcall(), but @initfn only starts once the async initcall
+ * @dep, which must be at the same or an earlier level, has returned.
+ */
+#define hisi_async_initcall_after(initfn, dep)				\
+	extern struct hisi_async_initcall __hisi_async_##dep;		\
+	__hisi_async_initcall(initfn, &__hisi_async_##dep, device_initcall)
+#define hisi_async_late_initcall_after(initfn, dep)			\
+	extern struct hisi_async_initcall __hisi_async_##dep;		\
+	__hisi_async_initcall(initfn, &__hisi_async_##dep, late_initcall)
+#else
+/* serial, link order already puts a dependency first */
+#define hisi_async_initcall(fn)			device_initcall(fn)
+#define hisi_async_late_initcall(fn)		late_initcall(fn)
+#define hisi_async_initcall_after(fn, dep)	device_initcall(fn)
+#define hisi_async_late_initcall_after(fn, dep)	late_initcall(fn)
+#endif
+
+#endif
@@ -26,9 +26,20 @@ int of_hisi_cma_contiguous_reserve_area(phys_addr_t limit);
  *and then will call cma_alloc.
  */
 struct device *hisi_get_cma_area_device(char *name);
+
+/*
+ * hint that a large allocation from the named area is about to come;
+ * its pages are moved out in the background.
+ */
+int hisi_cma_evacuate(const char *name);
 #else
 static inline struct device *hisi_get_cma_area_device(char *name)
 {
 	return NULL;
 }
+
+static inline int hisi_cma_evacuate(const char *name)
+{
+	return -ENODEV;
+}
 #endif
@@ -0,0 +1,63 @@
+/*
+ * DDR flux ring buffer interface
+ *
+ * Copyright (c) 2018 Hisilicon Technologies CO., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef _LINUX_HISI_DDR_FLUX_H
+#define _LINUX_HISI_DDR_FLUX_H
+
+#include <linux/types.h>
+#include <linux/ioctl.h>
+
+#define HISI_DDR_FLUX_MAX_MASTERS	8
+
+#define HISI_DDR_FLUX_RING_VERSION	1
+
+/**
+ * struct hisi_ddr_flux_record - one sample of /dev/ddr_flux
+ * @time_ns:        sched_clock() when the counters were read
+ * @ddr_freq_index: DDR frequency level in use when sampled
+ * @nr_masters:     number of valid entries in @rd_bytes and @wr_bytes
+ * @rd_bytes:       bytes read by each DMSS master port, cumulative
+ * @wr_bytes:       bytes written by each DMSS master port, cumulative
+ */
+struct hisi_ddr_flux_record {
+	__u64 time_ns;
+	__u32 ddr_freq_index;
+	__u32 nr_masters;
+	__u64 rd_bytes[HISI_DDR_FLUX_MAX_MASTERS];
+	__u64 wr_bytes[HISI_DDR_FLUX_MAX_MASTERS];
+};
+
+/**
+ * struct hisi_ddr_flux_ring_hdr - first page of the /dev/ddr_flux mapping
+ * @version:     HISI_DDR_FLUX_RING_VERSION
+ * @record_size: sizeof(struct hisi_ddr_flux_record)
+ * @nr_records:  number of record slots
+ * @data_offset: offset of slot 0 from the start of the mapping
+ * @interval_us: sampling interval
+ * @head:        records written so far. The newest one is in slot
+ *               (head - 1) % nr_records. A reader that finds head moved
+ *               by more than nr_records since its last pass lost data.
+ */
+struct hisi_ddr_flux_ring_hdr {
+	__u32 version;
+	__u32 record_size;
+	__u32 nr_records;
+	__u32 data_offset;
+	__u32 interval_us;
+	__u32 reserved;
+	__u64 head;
+};
+
+#define HISI_DDR_FLUX_IOC_MAGIC		0xDF
+/* start sampling every *(__u32 *)arg microseconds */
+#define HISI_DDR_FLUX_IOC_START		_IOW(HISI_DDR_FLUX_IOC_MAGIC, 1, __u32)
+#define HISI_DDR_FLUX_IOC_STOP		_IO(HISI_DDR_FLUX_IOC_MAGIC, 2)
+
+#endif /* _LINUX_HISI_DDR_FLUX_H */
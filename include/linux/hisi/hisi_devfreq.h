@@ -1,8 +1,58 @@
 #ifndef _HISI_DEVFREQ_H
 #define _HISI_DEVFREQ_H
 
+#include <linux/hisi/hisi_ddr_flux.h>
+
 int hisi_devfreq_free_freq_table(struct device *dev, unsigned int **table);
 
 int hisi_devfreq_init_freq_table(struct device *dev, unsigned int **table);
 
+/**
+ * struct hisi_gpu_frame_stat - per-frame GPU load reported to the governor
+ * @busy_ns:   largest GPU busy time of a frame displayed since the last read
+ * @period_ns: display vsync period, 0 if unknown
+ * @frames:    number of frames displayed since the last read
+ */
+struct hisi_gpu_frame_stat {
+	unsigned long busy_ns;
+	unsigned long period_ns;
+	unsigned int frames;
+};
+
+typedef int (*hisi_gpu_frame_stat_fn)(struct device *dev,
+				      struct hisi_gpu_frame_stat *stat);
+
+void hisi_devfreq_set_gpu_frame_stat(hisi_gpu_frame_stat_fn fn);
+
+int hisi_devfreq_get_gpu_frame_stat(struct device *dev,
+				    struct hisi_gpu_frame_stat *stat);
+
+/* GPU frequency floor in Hz set by perfhub scenes, 0 for none */
+void hisi_devfreq_set_gpu_floor(unsigned long freq);
+
+unsigned long hisi_devfreq_get_gpu_floor(void);
+
+/**
+ * struct hisi_ddr_flux_stat - DDR traffic reported to the DDR governor
+ * @rd_bytes:   bytes read by each master port since the provider started
+ * @wr_bytes:   bytes written by each master port since the provider started
+ * @time_ns:    sched_clock() when the counters were read
+ * @nr_masters: number of valid entries in @rd_bytes and @wr_bytes
+ *
+ * The counters only ever grow; consumers work on the difference between
+ * two reads.
+ */
+struct hisi_ddr_flux_stat {
+	u64 rd_bytes[HISI_DDR_FLUX_MAX_MASTERS];
+	u64 wr_bytes[HISI_DDR_FLUX_MAX_MASTERS];
+	u64 time_ns;
+	unsigned int nr_masters;
+};
+
+typedef int (*hisi_ddr_flux_stat_fn)(struct hisi_ddr_flux_stat *stat);
+
+void hisi_devfreq_set_ddr_flux_stat(hisi_ddr_flux_stat_fn fn);
+
+int hisi_devfreq_get_ddr_flux_stat(struct hisi_ddr_flux_stat *stat);
+
 #endif /* _HISI_DEVFREQ_H */
@@ -0,0 +1,91 @@
+/*
+ * Scheduler event flight recorder
+ *
+ * Copyright (c) 2018 Hisilicon Technologies CO., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef _LINUX_HISI_FLIGHT_RECORDER_H
+#define _LINUX_HISI_FLIGHT_RECORDER_H
+
+#include <linux/types.h>
+#include <linux/ioctl.h>
+
+#define HISI_FLIGHT_VERSION	1
+#define HISI_FLIGHT_MAX_CPUS	16
+
+enum hisi_flight_type {
+	HISI_FLIGHT_SWITCH = 1,	/* arg0: prev pid, bit 31 set if it was
+				 * preempted; arg1: next pid */
+	HISI_FLIGHT_WAKEUP,	/* arg0: pid, arg1: target cpu */
+	HISI_FLIGHT_MIGRATE,	/* arg0: pid, arg1: from cpu << 16 | to cpu */
+	HISI_FLIGHT_FREQ,	/* arg0: cpu, arg1: new frequency in kHz */
+	HISI_FLIGHT_IRQ_ENTRY,	/* arg0: irq */
+	HISI_FLIGHT_IRQ_EXIT,	/* arg0: irq, arg1: handler return value */
+	HISI_FLIGHT_BLK_ISSUE,	/* arg0: sector (low 32 bits), arg1: number
+				 * of sectors, bit 31 set for writes */
+	HISI_FLIGHT_BLK_DONE,	/* as HISI_FLIGHT_BLK_ISSUE */
+	HISI_FLIGHT_FREEZE,	/* arg0: reason given to the freeze */
+};
+
+/**
+ * struct hisi_flight_record - one 16 byte event
+ * @ts_type: sched_clock() in ns shifted left by 8, the low 8 bits
+ *           hold the enum hisi_flight_type
+ * @arg0:    first argument, see enum hisi_flight_type
+ * @arg1:    second argument
+ */
+struct hisi_flight_record {
+	__u64 ts_type;
+	__u32 arg0;
+	__u32 arg1;
+};
+
+#define HISI_FLIGHT_TYPE(r)	((unsigned int)((r)->ts_type & 0xff))
+#define HISI_FLIGHT_TIME(r)	((r)->ts_type >> 8)
+
+/**
+ * struct hisi_flight_hdr - first page of the /dev/flight_recorder mapping
+ * @version:     HISI_FLIGHT_VERSION
+ * @record_size: sizeof(struct hisi_flight_record)
+ * @nr_cpus:     number of per-cpu rings
+ * @nr_records:  record slots of each ring, a power of two
+ * @data_offset: offset of the ring of cpu 0 from the start of the mapping,
+ *               the ring of cpu N follows at N * nr_records * record_size
+ * @frozen:      nonzero once a freeze took effect, nothing is written
+ *               until HISI_FLIGHT_IOC_RESUME
+ * @freeze_ns:   sched_clock() when the freeze took effect
+ * @head:        records written by each cpu so far. The newest one is in
+ *               slot (head - 1) & (nr_records - 1).
+ */
+struct hisi_flight_hdr {
+	__u32 version;
+	__u32 record_size;
+	__u32 nr_cpus;
+	__u32 nr_records;
+	__u32 data_offset;
+	__u32 frozen;
+	__u64 freeze_ns;
+	__u64 head[HISI_FLIGHT_MAX_CPUS];
+};
+
+#define HISI_FLIGHT_IOC_MAGIC		0xF1
+/* freeze *(__u32 *)arg milliseconds from now, 0 for right away */
+#define HISI_FLIGHT_IOC_FREEZE		_IOW(HISI_FLIGHT_IOC_MAGIC, 1, __u32)
+#define HISI_FLIGHT_IOC_RESUME		_IO(HISI_FLIGHT_IOC_MAGIC, 2)
+
+#ifdef __KERNEL__
+#ifdef CONFIG_HISI_FLIGHT_RECORDER
+/* stop recording after delay_ms, e.g. when a frame drop is detected */
+extern void hisi_flight_freeze(u32 reason, unsigned int delay_ms);
+#else
+static inline void hisi_flight_freeze(u32 reason, unsigned int delay_ms)
+{
+}
+#endif
+#endif
+
+#endif /* _LINUX_HISI_FLIGHT_RECORDER_H */
@@ -0,0 +1,36 @@
+/*
+ * Frame feedback for the hmp thresholds policy.
+ *
+ * Copyright (c) 2014 Hisilicon Technologies CO., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#ifndef __HISI_HMPTH_H_
+#define __HISI_HMPTH_H_
+
+#include <linux/types.h>
+
+#ifdef CONFIG_HISI_HMPTH_SET
+/*
+ * a frame of the primary display was committed at done_ns,
+ * vsync_ns is the last vsync and period_ns the refresh period.
+ */
+extern void hmpth_frame_done(u64 vsync_ns, u64 done_ns, u32 period_ns);
+
+extern int set_hmp_policy(const char *pname, int prio, int state,
+		unsigned int up_thresholds, unsigned int down_thresholds);
+#else
+static inline void hmpth_frame_done(u64 vsync_ns, u64 done_ns, u32 period_ns)
+{
+}
+
+static inline int set_hmp_policy(const char *pname, int prio, int state,
+		unsigned int up_thresholds, unsigned int down_thresholds)
+{
+	return 0;
+}
+#endif
+
+#endif	/* End #define __HISI_HMPTH_H_ */
@@ -92,6 +92,26 @@ struct ion_smart_pool_info_data {
 	int water_mark;
 };
 
+enum ION_SMART_POOL_SCENE {
+	ION_SMART_POOL_SCENE_DEFAULT = 0,
+	ION_SMART_POOL_SCENE_CAMERA,
+	ION_SMART_POOL_SCENE_VIDEO,
+	ION_SMART_POOL_SCENE_GAME,
+	ION_SMART_POOL_SCENE_MAX,
+};
+
+/*
+ * Arm the smart pool for an upcoming use case: @scene selects the
+ * prefill target, @water_mark (in pages, 0 for the scene's default)
+ * overrides it, and the pool falls back to the default water mark
+ * @timeout_ms after arming (0 for the default timeout).
+ */
+struct ion_smart_pool_scene_data {
+	int scene;
+	int water_mark;
+	unsigned int timeout_ms;
+};
+
 #define HISI_ION_NAME_LEN 16
 
 struct ion_heap_info_data{
@@ -128,6 +148,7 @@ enum ION_HISI_CUSTOM_CMD {
     ION_HISI_CUSTOM_GET_MEDIA_HEAP_MODE,
     ION_HISI_CUSTOM_SET_FLAG,
     ION_HISI_CUSTOM_SET_SMART_POOL_INFO,
+    ION_HISI_CUSTOM_SET_SMART_POOL_SCENE,
 };
 
 enum ION_HISI_HEAP_MODE {
@@ -4,14 +4,36 @@
 #define HISI_IIRQ_AFFINITY_H
 
 #include <linux/errno.h>
+#include <linux/types.h>
+
+struct cpumask;
+struct seq_file;
+
+enum hisi_irq_hint {
+	HISI_IRQ_HINT_NONE,		/* not balanced */
+	HISI_IRQ_HINT_LATENCY,		/* vsync, touch: on the latency cpus */
+	HISI_IRQ_HINT_THROUGHPUT,	/* storage, wifi: spread over idle cpus */
+};
 
 #ifdef CONFIG_HISI_IRQ_AFFINITY
 extern void hisi_irqaffinity_status(void);
 extern int hisi_irqaffinity_register(unsigned int irq, int cpu);
 extern void hisi_irqaffinity_unregister(unsigned int irq);
+extern bool hisi_irqaffinity_is_pinned(unsigned int irq);
 #else
 static inline int hisi_irqaffinity_register(unsigned int irq, int cpu) { return -ENOSYS; }
 static inline void hisi_irqaffinity_unregister(unsigned int irq) { return; }
 static inline void hisi_irqaffinity_status(void) { return; }
+static inline bool hisi_irqaffinity_is_pinned(unsigned int irq) { return false; }
 #endif /* CONFIG_HISI_IRQ_AFFINITY */
+
+#ifdef CONFIG_HISI_IRQ_BALANCE
+extern int hisi_irqaffinity_set_hint(unsigned int irq, enum hisi_irq_hint hint);
+extern int hisi_irqbalance_set_latency_cpus(const struct cpumask *mask);
+extern void hisi_irqbalance_show(struct seq_file *s);
+#else
+static inline int hisi_irqaffinity_set_hint(unsigned int irq, enum hisi_irq_hint hint) { return -ENOSYS; }
+static inline int hisi_irqbalance_set_latency_cpus(const struct cpumask *mask) { return -ENOSYS; }
+static inline void hisi_irqbalance_show(struct seq_file *s) { return; }
+#endif /* CONFIG_HISI_IRQ_BALANCE */
 #endif /* HISI_IRQ_AFFINITY_H */
@@ -0,0 +1,44 @@
+/*
+ * NoC QoS generator profiles
+ *
+ * Copyright (c) 2018 Huawei Technologies CO., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef __HISI_NOC_QOS_H
+#define __HISI_NOC_QOS_H
+
+/*
+ * Later entries win: while anybody holds NOC_QOS_CAPTURE, the capture
+ * settings apply even if others hold NOC_QOS_FRAME.
+ */
+enum noc_qos_profile {
+	NOC_QOS_DEFAULT = 0,
+	NOC_QOS_FRAME,
+	NOC_QOS_CAPTURE,
+	NOC_QOS_PROFILE_NR,
+};
+
+#ifdef CONFIG_HISI_NOC_QOS
+int hisi_noc_qos_get(enum noc_qos_profile profile);
+void hisi_noc_qos_put(enum noc_qos_profile profile);
+void hisi_noc_qos_restore(void);
+#else
+static inline int hisi_noc_qos_get(enum noc_qos_profile profile)
+{
+	return 0;
+}
+
+static inline void hisi_noc_qos_put(enum noc_qos_profile profile)
+{
+}
+
+static inline void hisi_noc_qos_restore(void)
+{
+}
+#endif
+
+#endif
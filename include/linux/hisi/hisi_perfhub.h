@@ -0,0 +1,79 @@
+/*
+ * perfhub scenario interface
+ *
+ * Copyright (c) 2018 Hisilicon Technologies CO., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef _LINUX_HISI_PERFHUB_H
+#define _LINUX_HISI_PERFHUB_H
+
+#include <linux/types.h>
+#include <linux/ioctl.h>
+
+#define PERFHUB_MAX_SCENES	8
+#define PERFHUB_MAX_CLUSTERS	2
+#define PERFHUB_MAX_PIDS	16
+#define PERFHUB_NAME_LEN	16
+
+/* scene index of "no scene", everything released */
+#define PERFHUB_SCENE_NONE	(-1)
+
+/**
+ * struct perfhub_scene - one named bundle of performance settings
+ * @name:           e.g. "launch", "scroll", "game", "camera", "video"
+ * @cpu_min_freq:   cpufreq floor of each cluster in kHz, 0 for none
+ * @cpus:           affinity mask of the scene's tasks, 0 for all cpus
+ * @ddr_throughput: PM_QOS_MEMORY_THROUGHPUT request, 0 for none
+ * @gpu_min_freq:   GPU devfreq floor in Hz, 0 for none
+ * @hmp_up:         HMP up threshold while the scene is on, 0 to leave
+ *                  the thresholds alone
+ * @hmp_down:       HMP down threshold while the scene is on
+ * @ioprio:         ioprio of the scene's tasks as built by
+ *                  IOPRIO_PRIO_VALUE(), 0 to leave it alone
+ */
+struct perfhub_scene {
+	char name[PERFHUB_NAME_LEN];
+	__u32 cpu_min_freq[PERFHUB_MAX_CLUSTERS];
+	__u64 cpus;
+	__s32 ddr_throughput;
+	__u32 gpu_min_freq;
+	__u32 hmp_up;
+	__u32 hmp_down;
+	__u32 ioprio;
+	__u32 reserved;
+};
+
+/**
+ * struct perfhub_scene_table - all scenes, replaced in one go
+ * @nr:     number of valid entries in @scenes
+ * @scenes: indexed by the scene number used in PERFHUB_IOC_SWITCH
+ */
+struct perfhub_scene_table {
+	__u32 nr;
+	__u32 reserved;
+	struct perfhub_scene scenes[PERFHUB_MAX_SCENES];
+};
+
+/**
+ * struct perfhub_switch - enter a scene
+ * @scene:   index into the scene table, or PERFHUB_SCENE_NONE
+ * @nr_pids: number of valid entries in @pids
+ * @pids:    tasks the affinity and ioprio of the scene apply to. Those
+ *           of the previous scene get all cpus and ioprio 0 back.
+ */
+struct perfhub_switch {
+	__s32 scene;
+	__u32 nr_pids;
+	__s32 pids[PERFHUB_MAX_PIDS];
+};
+
+#define PERFHUB_IOC_MAGIC	0xB6
+#define PERFHUB_IOC_SET_SCENES	_IOW(PERFHUB_IOC_MAGIC, 1, struct perfhub_scene_table)
+#define PERFHUB_IOC_SWITCH	_IOW(PERFHUB_IOC_MAGIC, 2, struct perfhub_switch)
+#define PERFHUB_IOC_GET_SCENE	_IOR(PERFHUB_IOC_MAGIC, 3, __s32)
+
+#endif /* _LINUX_HISI_PERFHUB_H */
@@ -2,6 +2,7 @@
 #define __HISI_SYSCOUNTER_H__
 
 #include <soc_syscounter_interface.h>
+#include <asm/arch_timer.h>
 
 union syscnt_val {
 	u64 val;
@@ -35,4 +36,48 @@ struct syscnt_device {
 extern int syscounter_to_timespec64(u64 syscnt, struct timespec64 *ts);
 extern u64 hisi_get_syscount(void);
 
+/*
+ * Fast timestamps for tracing and statistics.
+ *
+ * hisi_ts_now() reads the arch virtual counter with a single mrs: no MMIO,
+ * no lock, and it is as cheap from userspace (CNTVCT_EL0 is readable at
+ * EL0). The arch counter and the syscounter are fed by the same system
+ * counter, so one converts to the other with a fixed rate ratio and an
+ * offset, sampled at probe and on every resume:
+ *
+ *   syscnt = cnt * syscnt_rate / cnt_rate + syscnt_offset
+ *
+ * and syscnt is the timebase modem and sensorhub traces are stamped with.
+ * The parameters are exported under /sys/devices/platform/<syscounter>/
+ * as cnt_rate, syscnt_rate and syscnt_offset for userspace tools.
+ *
+ * hisi_ts_delta_ns() converts a difference of two hisi_ts_now() values
+ * with a multiply and a shift; it is exact enough for deltas up to
+ * HISI_TS_MAX_DELTA_SEC, use syscounter_to_timespec64() for anything
+ * absolute.
+ */
+#define HISI_TS_MAX_DELTA_SEC	600
+
+struct hisi_ts_param {
+	u32 mult;		/* cnt -> ns */
+	u32 shift;
+	u64 cnt_rate;		/* arch counter rate, Hz */
+	u64 syscnt_rate;	/* syscounter rate, Hz */
+	s64 syscnt_offset;	/* syscnt - scaled cnt */
+};
+
+extern struct hisi_ts_param hisi_ts_param;
+
+static inline u64 hisi_ts_now(void)
+{
+	return arch_counter_get_cntvct();
+}
+
+static inline u64 hisi_ts_delta_ns(u64 delta)
+{
+	return (delta * hisi_ts_param.mult) >> hisi_ts_param.shift;
+}
+
+extern u64 hisi_ts_to_syscount(u64 cnt);
+
 #endif
@@ -57,4 +57,12 @@ static inline void alloc_node_tracker_map(void *pgdat) {};
 
 #endif
 
+#ifdef CONFIG_HISI_PAGE_TRACKER_SAMPLE
+void page_tracker_sample_alloc(struct page *page, int order);
+void page_tracker_sample_free(struct page *page, int order);
+#else
+static inline void page_tracker_sample_alloc(struct page *page, int order) {};
+static inline void page_tracker_sample_free(struct page *page, int order) {};
+#endif
+
 #endif
@@ -646,6 +646,12 @@ struct transaction_s
 	/* Disk flush needs to be sent to fs partition [no locking] */
 	int			t_need_data_flush;
 
+	/*
+	 * The log was written with FUA and the commit record was not
+	 * preceded by a cache flush [j_state_lock]
+	 */
+	int			t_fua_commit;
+
 	/*
 	 * For use by the filesystem to store fs-specific data
 	 * structures associated with the transaction
@@ -669,6 +675,7 @@ struct transaction_run_stats_s {
 struct transaction_stats_s {
 	unsigned long		ts_tid;
 	unsigned long		ts_requested;
+	unsigned long		ts_fua;
 	struct transaction_run_stats_s run;
 };
 
@@ -903,6 +910,12 @@ struct journal_s
 	 */
 	tid_t			j_commit_sequence;
 
+	/*
+	 * Sequence number of the most recently committed transaction whose
+	 * commit flushed the disk cache [j_state_lock].
+	 */
+	tid_t			j_flush_sequence;
+
 	/*
 	 * Sequence number of the most recent transaction wanting commit
 	 * [j_state_lock]
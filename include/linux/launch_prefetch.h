@@ -0,0 +1,39 @@
+#ifndef _LINUX_LAUNCH_PREFETCH_H
+#define _LINUX_LAUNCH_PREFETCH_H
+
+#include <linux/types.h>
+#include <linux/compiler.h>
+
+struct file;
+
+#ifdef CONFIG_LAUNCH_PREFETCH
+extern int launch_prefetch_recording;
+
+extern void launch_prefetch_app_launch(uid_t uid);
+extern bool current_is_launch_prefetch(void);
+extern void __launch_prefetch_record_fault(struct file *file, pgoff_t offset);
+
+/* Called for page cache misses in filemap_fault() */
+static inline void launch_prefetch_record_fault(struct file *file,
+						pgoff_t offset)
+{
+	if (unlikely(READ_ONCE(launch_prefetch_recording)))
+		__launch_prefetch_record_fault(file, offset);
+}
+#else
+static inline void launch_prefetch_app_launch(uid_t uid)
+{
+}
+
+static inline bool current_is_launch_prefetch(void)
+{
+	return false;
+}
+
+static inline void launch_prefetch_record_fault(struct file *file,
+						pgoff_t offset)
+{
+}
+#endif
+
+#endif /* _LINUX_LAUNCH_PREFETCH_H */
@@ -84,4 +84,15 @@ int lz4_decompress(const unsigned char *src, size_t *src_len,
  */
 int lz4_decompress_unknownoutputsize(const unsigned char *src, size_t src_len,
 		unsigned char *dest, size_t *dest_len);
+
+#ifdef CONFIG_LZ4_DECOMPRESS_NEON
+/*
+ * lz4_decompress_neon()
+ *	same as lz4_decompress_unknownoutputsize(), which calls it by
+ *	itself while lz4_use_neon is set (the cpu has Advanced SIMD)
+ */
+extern bool lz4_use_neon;
+int lz4_decompress_neon(const unsigned char *src, size_t src_len,
+		unsigned char *dest, size_t *dest_len);
+#endif
 #endif
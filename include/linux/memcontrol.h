@@ -167,6 +167,7 @@ struct mem_cgroup *mem_cgroup_begin_page_stat(struct page *page);
 void mem_cgroup_update_page_stat(struct mem_cgroup *memcg,
 				 enum mem_cgroup_stat_index idx, int val);
 void mem_cgroup_end_page_stat(struct mem_cgroup *memcg);
+unsigned long mem_cgroup_dirty_excess(unsigned long thresh);
 
 static inline void mem_cgroup_inc_page_stat(struct mem_cgroup *memcg,
 					    enum mem_cgroup_stat_index idx)
@@ -362,6 +363,11 @@ static inline void mem_cgroup_dec_page_stat(struct mem_cgroup *memcg,
 {
 }
 
+static inline unsigned long mem_cgroup_dirty_excess(unsigned long thresh)
+{
+	return 0;
+}
+
 static inline
 unsigned long mem_cgroup_soft_limit_reclaim(struct zone *zone, int order,
 					    gfp_t gfp_mask,
@@ -267,6 +267,9 @@ struct vm_operations_struct {
 	/* same as page_mkwrite when using VM_PFNMAP|VM_MIXEDMAP */
 	int (*pfn_mkwrite)(struct vm_area_struct *vma, struct vm_fault *vmf);
 
+	/* fault and map_pages don't need mmap_sem, see handle_speculative_fault */
+	bool speculative;
+
 	/* called by access_process_vm when get_user_pages() fails, typically
 	 * for use by special VMAs that can switch between memory and hardware
 	 */
@@ -1251,6 +1254,58 @@ static inline int fixup_user_fault(struct task_struct *tsk,
 }
 #endif
 
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+extern int handle_speculative_fault(struct mm_struct *mm,
+			unsigned long address, unsigned int flags,
+			unsigned long vm_flags);
+
+/*
+ * Anything a fault depends on in a linked vma is changed between
+ * vm_write_begin() and vm_write_end(), under mmap_sem held for write.
+ * vm_write_begin() waits for the speculative faults already running on
+ * the vma, later ones see an odd vm_sequence and take mmap_sem instead.
+ * The calls must not nest, and must not be made under locks a fault
+ * may take, like the anon_vma or i_mmap locks.
+ */
+extern void vm_write_begin(struct vm_area_struct *vma);
+extern void vm_wait_speculative(struct vm_area_struct *vma);
+
+static inline void vm_write_end(struct vm_area_struct *vma)
+{
+	raw_write_seqcount_end(&vma->vm_sequence);
+}
+
+/* for a vma copied from another one */
+static inline void vm_speculative_init(struct vm_area_struct *vma)
+{
+	seqcount_init(&vma->vm_sequence);
+	atomic_set(&vma->vm_ref_count, 0);
+}
+#else
+static inline int handle_speculative_fault(struct mm_struct *mm,
+			unsigned long address, unsigned int flags,
+			unsigned long vm_flags)
+{
+	return VM_FAULT_RETRY;
+}
+
+static inline void vm_write_begin(struct vm_area_struct *vma)
+{
+}
+
+static inline void vm_write_end(struct vm_area_struct *vma)
+{
+}
+
+static inline void vm_wait_speculative(struct vm_area_struct *vma)
+{
+}
+
+static inline void vm_speculative_init(struct vm_area_struct *vma)
+{
+}
+#endif
+
 extern int access_process_vm(struct task_struct *tsk, unsigned long addr, void *buf, int len, int write);
 extern int access_remote_vm(struct mm_struct *mm, unsigned long addr,
 		void *buf, int len, int write);
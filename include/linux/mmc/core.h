@@ -184,6 +184,11 @@ extern void mmc_cmdq_post_req(struct mmc_host *host, struct mmc_request *mrq,
 				int err);
 extern int mmc_start_cmdq_request(struct mmc_host *host,
 				   struct mmc_request *mrq);
+extern void mmc_cmdq_account(struct mmc_host *host,
+			     struct mmc_cmdq_req *cmdq_req);
+extern void mmc_cmdq_account_batch(struct mmc_host *host, int nr,
+				   ktime_t start);
+extern void mmc_cmdq_stats_reset(struct mmc_host *host);
 extern unsigned int mmc_erase_timeout(struct mmc_card *card,
 				      unsigned int arg,
 				      unsigned int qty);
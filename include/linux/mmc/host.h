@@ -197,6 +197,7 @@ struct mmc_cmdq_req {
 	unsigned int		cmdq_req_flags;
 	int			tag; /* used for command queuing */
 	u8			ctx_id;
+	ktime_t			issue_time;
 };
 
 struct mmc_async_req {
@@ -247,6 +248,37 @@ enum cmdq_states {
 	CMDQ_STATE_HALT,
 };
 
+#define MMC_CMDQ_MAX_TAGS	32
+
+enum mmc_cmdq_lat_type {
+	MMC_CMDQ_LAT_READ,
+	MMC_CMDQ_LAT_WRITE,
+	MMC_CMDQ_LAT_DCMD,
+	MMC_CMDQ_LAT_NR,
+};
+
+struct mmc_cmdq_lat {
+	u64	cnt;
+	u64	sum_us;
+	u64	max_us;
+};
+
+/**
+ * mmc_cmdq_stats - cmdq latency accounting, issue to completion irq
+ * @lat		per request type
+ * @tag_lat	per tag, DCMDs are accounted to the tag of their request
+ * @batch	DCMD batches, time the queue was held for each
+ * @batched	requests issued in DCMD batches
+ * @lock	completions are accounted in irq context
+ */
+struct mmc_cmdq_stats {
+	struct mmc_cmdq_lat	lat[MMC_CMDQ_LAT_NR];
+	struct mmc_cmdq_lat	tag_lat[MMC_CMDQ_MAX_TAGS];
+	struct mmc_cmdq_lat	batch;
+	u64			batched;
+	spinlock_t		lock;
+};
+
 /**
  * mmc_cmdq_context_info - describes the contexts of cmdq
  * @active_reqs		requests being processed
@@ -257,6 +289,7 @@ enum cmdq_states {
  * @req_starved		completion should invoke the request_fn since
  *			no tags were available
  * @cmdq_ctx_lock	acquire this before accessing this structure
+ * @stats		latency accounting, has its own lock
  */
 struct mmc_cmdq_context_info {
 	unsigned long	active_reqs; /* in-flight requests */
@@ -267,6 +300,7 @@ struct mmc_cmdq_context_info {
 	/* no free tag available */
 	unsigned long	req_starved;
 	spinlock_t	cmdq_ctx_lock;
+	struct mmc_cmdq_stats stats;
 };
 
 struct regulator;
@@ -49,6 +49,25 @@ static inline bool oom_task_origin(const struct task_struct *p)
 
 extern void mark_tsk_oom_victim(struct task_struct *tsk);
 
+#ifdef CONFIG_ANDROID_LOW_MEMORY_KILLER
+/* keep the lowmemorykiller's per-oom_score_adj index of thread groups */
+extern void lowmem_signal_add(struct task_struct *p);
+extern void lowmem_signal_del(struct signal_struct *sig);
+extern void lowmem_signal_adj_changed(struct signal_struct *sig);
+#else
+static inline void lowmem_signal_add(struct task_struct *p)
+{
+}
+
+static inline void lowmem_signal_del(struct signal_struct *sig)
+{
+}
+
+static inline void lowmem_signal_adj_changed(struct signal_struct *sig)
+{
+}
+#endif
+
 extern void unmark_oom_victim(void);
 
 extern unsigned long oom_badness(struct task_struct *p,
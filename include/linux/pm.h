@@ -560,6 +560,9 @@ struct dev_pm_info {
 	struct wakeup_source	*wakeup;
 	bool			wakeup_path:1;
 	bool			syscore:1;
+	/* callback time in the last suspend and resume, owned by the PM core */
+	u32			suspend_time_us;
+	u32			resume_time_us;
 #else
 	unsigned int		should_wakeup:1;
 #endif
@@ -697,6 +700,8 @@ extern void __suspend_report_result(const char *function, void *fn, int ret);
 
 extern int device_pm_wait_for_dev(struct device *sub, struct device *dev);
 extern void dpm_for_each_dev(void *data, void (*fn)(struct device *, void *));
+extern int device_pm_add_dependency(struct device *consumer,
+				    struct device *supplier);
 
 extern int pm_generic_prepare(struct device *dev);
 extern int pm_generic_suspend_late(struct device *dev);
@@ -736,6 +741,12 @@ static inline int device_pm_wait_for_dev(struct device *a, struct device *b)
 	return 0;
 }
 
+static inline int device_pm_add_dependency(struct device *consumer,
+					   struct device *supplier)
+{
+	return 0;
+}
+
 static inline void dpm_for_each_dev(void *data, void (*fn)(struct device *, void *))
 {
 }
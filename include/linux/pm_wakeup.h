@@ -34,13 +34,15 @@
  * @total_time: Total time this wakeup source has been active.
  * @max_time: Maximum time this wakeup source has been continuously active.
  * @last_time: Monotonic clock when the wakeup source's was touched last time.
- * @prevent_sleep_time: Total time this source has been preventing autosleep.
+ * @prevent_sleep_time: Total time this source has been preventing autosleep or
+ *	a suspend waiting for the wakeup events in progress to finish.
  * @event_count: Number of signaled wakeup events.
  * @active_count: Number of times the wakeup source was activated.
  * @relax_count: Number of times the wakeup source was deactivated.
  * @expire_count: Number of times the wakeup source's timeout has expired.
  * @wakeup_count: Number of times the wakeup source might abort suspend.
  * @active: Status of the wakeup source.
+ * @suspend_wait: A suspend is waiting for this source to be relaxed.
  * @has_timeout: The wakeup source has been activated with a timeout.
  */
 struct wakeup_source {
@@ -61,6 +63,7 @@ struct wakeup_source {
 	unsigned long		wakeup_count;
 	bool			active:1;
 	bool			autosleep_enabled:1;
+	bool			suspend_wait:1;
 };
 
 #ifdef CONFIG_PM_SLEEP
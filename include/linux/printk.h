@@ -166,6 +166,14 @@ extern int kptr_restrict;
 
 extern void wake_up_klogd(void);
 
+#ifdef CONFIG_HISI_PRINTK_DEFERRED_CONSOLE
+extern void printk_console_force_sync(void);
+#else
+static inline void printk_console_force_sync(void)
+{
+}
+#endif
+
 char *log_buf_addr_get(void);
 u32 log_buf_len_get(void);
 void log_buf_kexec_setup(void);
@@ -203,6 +211,10 @@ static inline void wake_up_klogd(void)
 {
 }
 
+static inline void printk_console_force_sync(void)
+{
+}
+
 static inline char *log_buf_addr_get(void)
 {
 	return NULL;
@@ -46,6 +46,10 @@ extern int remove_proc_subtree(const char *, struct proc_dir_entry *);
 extern void exit_proc_reclaim(struct task_struct *tsk);
 #endif
 
+struct task_stat_entry;
+extern void proc_task_stat_entry(struct task_struct *task,
+				 struct task_stat_entry *e);
+
 #else /* CONFIG_PROC_FS */
 
 static inline void proc_root_init(void)
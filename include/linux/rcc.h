@@ -0,0 +1,27 @@
+#ifndef _LINUX_RCC_H
+#define _LINUX_RCC_H
+
+#include <linux/errno.h>
+#include <linux/kconfig.h>
+#include <linux/notifier.h>
+
+/* events passed to display notifiers */
+#define RCC_DISPLAY_OFF		0
+#define RCC_DISPLAY_ON		1
+
+#if IS_REACHABLE(CONFIG_HUAWEI_RCC)
+int rcc_register_display_notifier(struct notifier_block *nb);
+int rcc_unregister_display_notifier(struct notifier_block *nb);
+#else
+static inline int rcc_register_display_notifier(struct notifier_block *nb)
+{
+	return -ENODEV;
+}
+
+static inline int rcc_unregister_display_notifier(struct notifier_block *nb)
+{
+	return -ENODEV;
+}
+#endif
+
+#endif /* _LINUX_RCC_H */
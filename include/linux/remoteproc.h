@@ -40,6 +40,7 @@
 #include <linux/mutex.h>
 #include <linux/virtio.h>
 #include <linux/completion.h>
+#include <linux/workqueue.h>
 #include <linux/idr.h>
 #include <linux/rproc_share.h>
 #include <linux/firmware.h>
@@ -413,11 +414,13 @@ struct rproc_cache_entry {
  * struct rproc_page - page memory
  * @va:	virtual address of pages
  * @num: number of pages
+ * @vaddr: kernel mapping of the pages, as handed to the dynamic memory entry
  * @node: list node
  */
 struct rproc_page {
 	void *va;
 	u32 num;
+	void *vaddr;
 	struct list_head node;
 };
 
@@ -503,6 +506,13 @@ enum rproc_crash_type {
  * @cached_table: copy of the resource table
  * @table_csum: checksum of the resource table
  * @has_iommu: flag to indicate if remote processor is behind an MMU
+ * @kept_carveouts: carveouts held over from the last session
+ * @kept_dynamic_mems: dynamic memory held over from the last session
+ * @kept_pages: pages backing @kept_dynamic_mems
+ * @kept_mappings: iommu mappings of the kept memory, still live in @domain
+ * @mem_release_work: frees the kept memory once @mem_keep_ms has elapsed
+ * @mem_keep_ms: how long memory is kept after shutdown, 0 to free at once
+ * @domain_kept: @domain was left attached at shutdown to hold kept mappings
  */
 struct rproc {
 	struct klist_node node;
@@ -547,6 +557,13 @@ struct rproc {
 	u32 table_csum;
 	bool has_iommu;
 	struct work_struct sec_rscwork;
+	struct list_head kept_carveouts;
+	struct list_head kept_dynamic_mems;
+	struct list_head kept_pages;
+	struct list_head kept_mappings;
+	struct delayed_work mem_release_work;
+	u32 mem_keep_ms;
+	bool domain_kept;
 };
 
 /* we currently support only two vrings per rvdev */
@@ -642,6 +659,8 @@ extern int hisi_atfisp_remove(struct platform_device *pdev);
 extern int secisp_device_enable(void);
 extern int secisp_device_disable(void);
 extern void rproc_resource_cleanup(struct rproc *rproc);
+extern struct rproc_mem_entry *rproc_reuse_dynamic_memory(struct rproc *rproc,
+							u32 da, u32 len);
 extern void rproc_fw_config_virtio(const struct firmware *fw, void *context);
 extern int hisp_meminit(unsigned int etype, unsigned long paddr);
 extern int sec_rproc_boot(struct rproc *rproc);
@@ -183,6 +183,7 @@ extern unsigned int cpu_nr_runnings(struct cpumask *mask);
 extern bool single_task_running(void);
 extern unsigned long nr_iowait(void);
 extern unsigned long nr_iowait_cpu(int cpu);
+extern unsigned long sched_dl_cpu_util(int cpu);
 extern void get_iowait_load(unsigned long *nr_waiters, unsigned long *load);
 #ifdef CONFIG_CPU_QUIET
 extern u64 nr_running_integral(unsigned int cpu);
@@ -789,6 +790,10 @@ struct signal_struct {
 	short oom_score_adj;		/* OOM kill score adjustment */
 	short oom_score_adj_min;	/* OOM kill score adjustment min value.
 					 * Only settable by CAP_SYS_RESOURCE. */
+#ifdef CONFIG_ANDROID_LOW_MEMORY_KILLER
+	struct hlist_node lowmem_node;	/* lowmemorykiller oom_score_adj bucket */
+	short lowmem_bucket;
+#endif
 
 	struct mutex cred_guard_mutex;	/* guard against foreign influences on
 					 * credential calculations
@@ -1303,6 +1308,7 @@ struct sched_statistics {
 
 #ifdef CONFIG_SCHED_WALT
 #define RAVG_HIST_SIZE_MAX  5
+#define NUM_BUSY_BUCKETS 10
 
 /* ravg represents frequency scaled cpu-demand of tasks */
 struct ravg {
@@ -1327,12 +1333,18 @@ struct ravg {
 	 *
 	 * 'prev_window' represents task's contribution to cpu busy time
 	 * statistics (rq->prev_runnable_sum) in previous window
+	 *
+	 * 'busy_buckets' is a decaying histogram of the task's busy windows,
+	 * 'pred_demand' the busy time its next window is most likely to
+	 * reach according to it
 	 */
 	u64 mark_start;
 	u32 sum, demand;
 	u32 sum_history[RAVG_HIST_SIZE_MAX];
 	u32 curr_window, prev_window;
 	u16 active_windows;
+	u32 pred_demand;
+	u8 busy_buckets[NUM_BUSY_BUCKETS];
 };
 #endif
 
@@ -1423,14 +1435,32 @@ struct sched_dl_entity {
 	 *
 	 * @dl_yielded tells if task gave up the cpu before consuming
 	 * all its available runtime during the last job.
+	 *
+	 * @dl_non_contending tells if the task is blocked but its
+	 * bandwidth is still part of the active utilization of its rq,
+	 * until the inactive timer fires at its 0-lag time.
 	 */
 	int dl_throttled, dl_new, dl_boosted, dl_yielded;
+	int dl_non_contending;
+
+	/* Bandwidth accounted in the running_bw of the task's rq, or 0 */
+	u64 dl_active_bw;
+
+	/*
+	 * Instances which ran out of runtime or past their deadline
+	 * before completing, and the deadline last counted as missed.
+	 */
+	u64 dl_missed;
+	unsigned long dl_nr_missed;
 
 	/*
 	 * Bandwidth enforcement timer. Each -deadline task has its
 	 * own bandwidth to be enforced, thus we need one timer per task.
 	 */
 	struct hrtimer dl_timer;
+
+	/* Removes a blocked task's bandwidth at its 0-lag time */
+	struct hrtimer inactive_timer;
 };
 
 union rcu_special {
@@ -1497,6 +1527,10 @@ struct task_struct {
 
 #ifdef CONFIG_CGROUP_SCHED
 	struct task_group *sched_task_group;
+#endif
+#ifdef CONFIG_CGROUP_SCHEDTUNE
+	/* boost lent by a binder caller, on top of the task's own group */
+	int stune_inherited_boost;
 #endif
 	struct sched_dl_entity dl;
 
@@ -1513,6 +1547,11 @@ struct task_struct {
 	int nr_cpus_allowed;
 	cpumask_t cpus_allowed;
 
+#ifdef CONFIG_PSI
+	/* Pressure stall state, TSK_* of linux/psi_types.h */
+	unsigned int psi_flags;
+#endif
+
 #ifdef CONFIG_PREEMPT_RCU
 	int rcu_read_lock_nesting;
 	union rcu_special rcu_read_unlock_special;
@@ -1562,6 +1601,9 @@ struct task_struct {
 	/* Revert to default priority/policy when forking */
 	unsigned sched_reset_on_fork:1;
 	unsigned sched_contributes_to_load:1;
+#ifdef CONFIG_PSI
+	unsigned sched_psi_wake_requeue:1;
+#endif
 
 #ifdef CONFIG_MEMCG_KMEM
 	unsigned memcg_kmem_skip_account:1;
@@ -1919,6 +1961,17 @@ struct task_struct {
 #ifdef CONFIG_HISI_SWAP_ZDATA
 	struct reclaim_result *proc_reclaimed_result;
 #endif
+#ifdef CONFIG_SCHED_HMP_RTG
+	/* render task group, see hmp_rtg_wants_big() */
+	struct hmp_rtg *hmp_rtg;
+	struct list_head hmp_rtg_node;
+#endif
+#ifdef CONFIG_SCHED_HMP_STATS
+	/* see hmp_hist_switch() */
+	u64 hmp_hist_queued;
+	int hmp_hist_cpu;
+	bool hmp_hist_woken;
+#endif
 };
 
 /* Future-safe accessor for struct task_struct's cpus_allowed. */
@@ -2180,6 +2233,7 @@ extern void thread_group_cputime_adjusted(struct task_struct *p, cputime_t *ut,
 #define PF_RANDOMIZE	0x00400000	/* randomize virtual address space */
 #define PF_SWAPWRITE	0x00800000	/* Allowed to write to swap */
 #define PF_SHRINK_ALL	0x01000000	/* I'm shrink_all */
+#define PF_MEMSTALL	0x02000000	/* Stalled due to lack of memory */
 #define PF_NO_SETAFFINITY 0x04000000	/* Userland is not allowed to meddle with cpus_allowed */
 #define PF_MCE_EARLY    0x08000000      /* Early kill for mce process policy */
 #define PF_MUTEX_TESTER	0x20000000	/* Thread belongs to the rt mutex tester */
@@ -2353,6 +2407,26 @@ static inline int set_cpus_allowed_ptr(struct task_struct *p,
 }
 #endif
 
+#ifdef CONFIG_SCHED_CORE_CTL
+extern struct cpumask sched_isolated_cpus;
+#define cpu_isolated(cpu)	cpumask_test_cpu((cpu), &sched_isolated_cpus)
+
+extern int sched_isolate_cpu(int cpu);
+extern int sched_unisolate_cpu(int cpu);
+extern unsigned int sched_cpu_demand(int cpu);
+#else
+#define cpu_isolated(cpu)	0
+
+static inline int sched_isolate_cpu(int cpu)
+{
+	return -ENODEV;
+}
+static inline int sched_unisolate_cpu(int cpu)
+{
+	return 0;
+}
+#endif
+
 #ifdef CONFIG_NO_HZ_COMMON
 void calc_load_enter_idle(void);
 void calc_load_exit_idle(void);
@@ -2473,6 +2547,21 @@ static inline void sched_autogroup_exit(struct signal_struct *sig) { }
 extern int yield_to(struct task_struct *p, bool preempt);
 extern void set_user_nice(struct task_struct *p, long nice);
 extern int task_prio(const struct task_struct *p);
+#ifdef CONFIG_CGROUP_SCHEDTUNE
+extern int schedtune_task_boost(struct task_struct *tsk);
+extern unsigned long schedtune_timer_slack(struct task_struct *tsk);
+#else
+static inline unsigned long schedtune_timer_slack(struct task_struct *tsk)
+{
+	return 0;
+}
+#endif
+
+/* the slack @tsk's timed sleeps get: its own, raised to its group's */
+static inline unsigned long task_timer_slack(struct task_struct *tsk)
+{
+	return max(tsk->timer_slack_ns, schedtune_timer_slack(tsk));
+}
 /**
  * task_nice - return the nice value of a given task.
  * @p: the task in question.
@@ -52,6 +52,10 @@ extern unsigned int sysctl_sched_use_walt_cpu_util;
 extern unsigned int sysctl_sched_use_walt_task_util;
 extern unsigned int sysctl_sched_walt_init_task_load_pct;
 extern unsigned int sysctl_sched_walt_cpu_high_irqload;
+extern unsigned int sysctl_sched_walt_pred_demand;
+#endif
+#ifdef CONFIG_SCHED_HMP
+extern unsigned int sysctl_sched_hmp_energy_aware;
 #endif
 
 enum sched_tunable_scaling {
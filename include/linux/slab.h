@@ -86,6 +86,11 @@
 #else
 # define SLAB_FAILSLAB		0x00000000UL
 #endif
+#ifdef CONFIG_SLUB_REMOTE_FREE
+# define SLAB_REMOTE_FREE	0x04000000UL	/* Batch frees to non-cpu slabs */
+#else
+# define SLAB_REMOTE_FREE	0x00000000UL
+#endif
 
 /* The following flags affect the page allocator grouping pages by mobility */
 #define SLAB_RECLAIM_ACCOUNT	0x00020000UL		/* Objects are reclaimable */
@@ -35,6 +35,8 @@ enum stat_item {
 	CPU_PARTIAL_FREE,	/* Refill cpu partial on free */
 	CPU_PARTIAL_NODE,	/* Refill cpu partial from node partial */
 	CPU_PARTIAL_DRAIN,	/* Drain cpu partial to node partial */
+	FREE_REMOTE_BATCHED,	/* Free buffered for a batched remote free */
+	FREE_REMOTE_FLUSH,	/* Batch of remote frees given to one slab */
 	NR_SLUB_STAT_ITEMS };
 
 struct kmem_cache_cpu {
@@ -47,6 +49,16 @@ struct kmem_cache_cpu {
 #endif
 };
 
+#ifdef CONFIG_SLUB_REMOTE_FREE
+#define SLUB_REMOTE_FREE_BATCH	16
+
+/* Objects freed by this cpu to slabs other than its cpu slab */
+struct kmem_cache_remote_free {
+	unsigned int nr;
+	void *objects[SLUB_REMOTE_FREE_BATCH];
+};
+#endif
+
 /*
  * Word size structure that can be atomically updated or read and that
  * contains both the order and the number of objects that a slab of the
@@ -61,6 +73,10 @@ struct kmem_cache_order_objects {
  */
 struct kmem_cache {
 	struct kmem_cache_cpu __percpu *cpu_slab;
+#ifdef CONFIG_SLUB_REMOTE_FREE
+	/* NULL unless SLAB_REMOTE_FREE is in effect */
+	struct kmem_cache_remote_free __percpu *remote_free;
+#endif
 	/* Used for retriving partial slabs etc */
 	unsigned long flags;
 	unsigned long min_partial;
@@ -150,8 +150,9 @@ enum {
 	SWP_FILE	= (1 << 7),	/* set after swap_activate success */
 	SWP_AREA_DISCARD = (1 << 8),	/* single-time swap area discards */
 	SWP_PAGE_DISCARD = (1 << 9),	/* freed swap page-cluster discards */
+	SWP_SYNCHRONOUS_IO = (1 << 10),	/* synchronous bdev, e.g. zram */
 					/* add others here before... */
-	SWP_SCANNING	= (1 << 10),	/* refcount in scan_swap_map */
+	SWP_SCANNING	= (1 << 11),	/* refcount in scan_swap_map */
 };
 
 #define SWAP_CLUSTER_MAX 32UL
@@ -334,7 +335,7 @@ extern unsigned long vm_total_pages;
 #ifdef CONFIG_HUAWEI_RCC
 #define RCC_MODE_ANON   1
 #define RCC_MODE_FILE   2
-int try_to_free_pages_ex(int nr_pages, int mode);
+int try_to_free_pages_ex(int nr_pages, int mode, unsigned long *nr_scanned);
 #endif
 
 #ifdef CONFIG_SHRINK_MEMORY
@@ -361,13 +362,38 @@ extern void check_move_unevictable_pages(struct page **, int nr_pages);
 
 extern int kswapd_run(int nid);
 extern void kswapd_stop(int nid);
+/*
+ * Relative reclaim pressure on a memcg in percent: 0 spares it until
+ * reclaim gets desperate, 200 scans it twice as hard as the default.
+ */
+#define MEMCG_RECLAIM_WEIGHT_DEFAULT	100
+#define MEMCG_RECLAIM_WEIGHT_MAX	200
+
 #ifdef CONFIG_MEMCG
 extern int mem_cgroup_swappiness(struct mem_cgroup *mem);
+extern bool mem_cgroup_swappiness_is_global(struct mem_cgroup *mem);
+extern unsigned int mem_cgroup_reclaim_weight(struct mem_cgroup *mem);
+extern bool mem_cgroup_ws_protect(struct page *page);
 #else
 static inline int mem_cgroup_swappiness(struct mem_cgroup *mem)
 {
 	return vm_swappiness;
 }
+
+static inline bool mem_cgroup_swappiness_is_global(struct mem_cgroup *mem)
+{
+	return true;
+}
+
+static inline unsigned int mem_cgroup_reclaim_weight(struct mem_cgroup *mem)
+{
+	return MEMCG_RECLAIM_WEIGHT_DEFAULT;
+}
+
+static inline bool mem_cgroup_ws_protect(struct page *page)
+{
+	return false;
+}
 #endif
 #ifdef CONFIG_MEMCG_SWAP
 extern void mem_cgroup_swapout(struct page *page, swp_entry_t entry);
@@ -406,11 +432,22 @@ extern void __delete_from_swap_cache(struct page *);
 extern void delete_from_swap_cache(struct page *);
 extern void free_page_and_swap_cache(struct page *);
 extern void free_pages_and_swap_cache(struct page **, int);
-extern struct page *lookup_swap_cache(swp_entry_t);
+extern struct page *lookup_swap_cache(swp_entry_t entry,
+			struct vm_area_struct *vma, unsigned long addr);
 extern struct page *read_swap_cache_async(swp_entry_t, gfp_t,
 			struct vm_area_struct *vma, unsigned long addr);
 extern struct page *swapin_readahead(swp_entry_t, gfp_t,
 			struct vm_area_struct *vma, unsigned long addr);
+extern struct page *swap_vma_readahead(swp_entry_t entry, gfp_t gfp_mask,
+			struct vm_area_struct *vma, unsigned long addr,
+			pmd_t *pmd);
+
+extern bool swap_vma_readahead_enabled;
+
+static inline bool swap_use_vma_readahead(void)
+{
+	return READ_ONCE(swap_vma_readahead_enabled);
+}
 
 /* linux/mm/swapfile.c */
 extern atomic_long_t nr_swap_pages;
@@ -444,6 +481,7 @@ extern sector_t swapdev_block(int, pgoff_t);
 extern int page_swapcount(struct page *);
 extern int swp_swapcount(swp_entry_t entry);
 extern struct swap_info_struct *page_swap_info(struct page *);
+extern struct swap_info_struct *swp_swap_info(swp_entry_t entry);
 extern int reuse_swap_page(struct page *);
 extern int try_to_free_swap(struct page *);
 struct backing_dev_info;
@@ -505,7 +543,20 @@ static inline int swap_writepage(struct page *p, struct writeback_control *wbc)
 	return 0;
 }
 
-static inline struct page *lookup_swap_cache(swp_entry_t swp)
+static inline struct page *swap_vma_readahead(swp_entry_t swp, gfp_t gfp_mask,
+			struct vm_area_struct *vma, unsigned long addr,
+			pmd_t *pmd)
+{
+	return NULL;
+}
+
+static inline bool swap_use_vma_readahead(void)
+{
+	return false;
+}
+
+static inline struct page *lookup_swap_cache(swp_entry_t swp,
+			struct vm_area_struct *vma, unsigned long addr)
 {
 	return NULL;
 }
@@ -170,6 +170,11 @@ struct thermal_cooling_device {
 	struct mutex lock; /* protect thermal_instances list */
 	struct list_head thermal_instances;
 	struct list_head node;
+	/*
+	 * How much the device is held back by its power, 1..1024, from the
+	 * load its governor last saw; 0 if the device does not report it.
+	 */
+	u32 perf_sensitivity;
 };
 
 struct thermal_attr {
@@ -354,6 +359,12 @@ struct thermal_zone_params {
 	 */
 	int offset;
 
+	/*
+	 * @prediction_ms:	how far ahead the power allocator projects the
+	 *			temperature trend (0 disables prediction)
+	 */
+	s32 prediction_ms;
+
 #ifdef CONFIG_HISI_IPA_THERMAL
 	s32 boost;
 
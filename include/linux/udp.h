@@ -34,6 +34,8 @@ static inline struct udphdr *inner_udp_hdr(const struct sk_buff *skb)
 
 #define UDP_HTABLE_SIZE_MIN		(CONFIG_BASE_SMALL ? 128 : 256)
 
+#define UDP_MAX_SEGMENTS		(1 << 6UL)
+
 static inline u32 udp_hashfn(const struct net *net, u32 num, u32 mask)
 {
 	return (num + net_hash_mix(net)) & mask;
@@ -49,7 +51,9 @@ struct udp_sock {
 	unsigned int	 corkflag;	/* Cork is required */
 	__u8		 encap_type;	/* Is this an Encapsulation socket? */
 	unsigned char	 no_check6_tx:1,/* Send zero UDP6 checksums on TX? */
-			 no_check6_rx:1;/* Allow zero UDP6 checksums on RX? */
+			 no_check6_rx:1,/* Allow zero UDP6 checksums on RX? */
+			 gro_enabled:1;	/* Take GRO aggregated datagrams? */
+	__u16		 gso_size;	/* UDP_SEGMENT size, 0 if unset */
 	/*
 	 * Following member retains the information to create a UDP header
 	 * when the socket is uncorked.
@@ -71,6 +75,9 @@ struct udp_sock {
 	 */
 	int (*encap_rcv)(struct sock *sk, struct sk_buff *skb);
 	void (*encap_destroy)(struct sock *sk);
+#ifdef CONFIG_HW_COMMSTAT
+	struct skb_mstamp comm_lat_stamp; /* DNS query outstanding */
+#endif
 };
 
 static inline struct udp_sock *udp_sk(const struct sock *sk)
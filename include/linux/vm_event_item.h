@@ -38,6 +38,14 @@ enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 		KSWAPD_LOW_WMARK_HIT_QUICKLY, KSWAPD_HIGH_WMARK_HIT_QUICKLY,
 		PAGEOUTRUN, ALLOCSTALL, PGROTATED,
 		DROP_PAGECACHE, DROP_SLAB,
+#ifdef CONFIG_HISI_PCP_HIGH_ORDER
+		/* high-order pcp hits, each one a zone->lock not taken */
+		PCP_HIGHORDER_ALLOC_HIT, PCP_HIGHORDER_FREE_HIT,
+#endif
+#ifdef CONFIG_HISI_VMAP_FLUSH_BATCH
+		/* lazy vmap purges and the kernel TLB flushes they cost */
+		VMAP_PURGE, VMAP_TLB_FLUSH_ALL, VMAP_TLB_FLUSH_PAGES,
+#endif
 #ifdef CONFIG_NUMA_BALANCING
 		NUMA_PTE_UPDATES,
 		NUMA_HUGE_PTE_UPDATES,
@@ -53,6 +61,9 @@ enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 		COMPACTISOLATED,
 		COMPACTSTALL, COMPACTFAIL, COMPACTSUCCESS,
 		KCOMPACTD_WAKE,
+#ifdef CONFIG_HISI_PROACTIVE_COMPACTION
+		COMPACTPROACTIVE_SUCCESS, COMPACTPROACTIVE_FAIL,
+#endif
 #endif
 #ifdef CONFIG_HUGETLB_PAGE
 		HTLB_BUDDY_PGALLOC, HTLB_BUDDY_PGALLOC_FAIL,
@@ -92,6 +103,18 @@ enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 		VMACACHE_FIND_CALLS,
 		VMACACHE_FIND_HITS,
 		VMACACHE_FULL_FLUSHES,
+#endif
+#ifdef CONFIG_SWAP
+		SWAP_RA,
+		SWAP_RA_HIT,
+#endif
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+		SPECULATIVE_PGFAULT,
+#endif
+#ifdef CONFIG_ARM64_CONT_PTE
+		CONT_PTE_ALLOC,
+		CONT_PTE_FALLBACK,
+		CONT_PTE_SPLIT,
 #endif
 		NR_VM_EVENT_ITEMS
 };
@@ -39,6 +39,17 @@ struct zs_pool_stats {
 	unsigned long pages_compacted;
 };
 
+struct zs_class_stats {
+	/* object size served by this class */
+	unsigned int size;
+	unsigned long objs_allocated;
+	unsigned long objs_used;
+	/* pages backing the allocated objects */
+	unsigned long pages_used;
+	/* pages compaction could release from this class */
+	unsigned long pages_compactable;
+};
+
 struct zs_pool;
 
 struct zs_pool *zs_create_pool(const char *name, gfp_t flags);
@@ -55,4 +66,7 @@ unsigned long zs_get_total_pages(struct zs_pool *pool);
 unsigned long zs_compact(struct zs_pool *pool);
 
 void zs_pool_stats(struct zs_pool *pool, struct zs_pool_stats *stats);
+int zs_class_stats(struct zs_pool *pool, int index,
+			struct zs_class_stats *stats);
+unsigned long zs_compactable_pages(struct zs_pool *pool);
 #endif
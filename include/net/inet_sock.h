@@ -118,6 +118,7 @@ struct inet_cork {
 	__be32			addr;
 	struct ip_options	*opt;
 	unsigned int		fragsize;
+	u16			gso_size; /* UDP_SEGMENT size, set by UDP */
 	int			length; /* Total length of all frames */
 	struct dst_entry	*dst;
 	u8			tx_flags;
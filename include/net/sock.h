@@ -232,6 +232,10 @@ struct cdn_entry {
 	struct cdn_queue	*hint;
 	struct cdn_queue	*head;
 	int			index;
+	/* Recovery is pending on a per-cpu batch, holding a sock ref */
+	int			queued;
+	struct sock		*sk;
+	struct list_head	recovery_node;
 };
 #endif
 struct cg_proto;
@@ -398,6 +402,15 @@ struct sock {
 #ifdef CONFIG_HW_WIFIPRO
 	int wifipro_is_google_sock;
 	char wifipro_dev_name[IFNAMSIZ];
+	/* Cached egress class and last sampled tcp_sock counters */
+	u8 wifipro_dev_type;
+	u32 wifipro_seen_segs_in;
+	u32 wifipro_seen_segs_out;
+#endif
+
+#ifdef CONFIG_HW_WIFI
+	/* Cached wifi_tcp_statistics UID slot, see wifi_tcp_stat_bind() */
+	u32 wifi_stat_cookie;
 #endif
 
 #ifdef CONFIG_XFRM
@@ -549,6 +549,7 @@ enum scsi_host_mq_quirk{
 	SHOST_MQ_QUIRK_FORCE_SOFT_IRQ,
 	SHOST_MQ_QUIRK_FLUSH_REDUCING,
 	SHOST_MQ_QUIRK_DISPATCH_DICISION,
+	SHOST_MQ_QUIRK_VIP_IO,
 };
 
 #define SHOST_MQ_QUIRK(x)	(1 << x)
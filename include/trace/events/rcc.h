@@ -0,0 +1,48 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM rcc
+
+#if !defined(_TRACE_RCC_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_RCC_H
+
+#include <linux/types.h>
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(rcc_reclaim_cycle,
+
+	TP_PROTO(bool full, unsigned long nr_scanned,
+		unsigned long nr_reclaimed, unsigned long free_target,
+		u64 cpu_ns, u64 duration_ns, int stat),
+
+	TP_ARGS(full, nr_scanned, nr_reclaimed, free_target, cpu_ns,
+		duration_ns, stat),
+
+	TP_STRUCT__entry(
+		__field(bool, full)
+		__field(unsigned long, nr_scanned)
+		__field(unsigned long, nr_reclaimed)
+		__field(unsigned long, free_target)
+		__field(u64, cpu_ns)
+		__field(u64, duration_ns)
+		__field(int, stat)
+	),
+
+	TP_fast_assign(
+		__entry->full = full;
+		__entry->nr_scanned = nr_scanned;
+		__entry->nr_reclaimed = nr_reclaimed;
+		__entry->free_target = free_target;
+		__entry->cpu_ns = cpu_ns;
+		__entry->duration_ns = duration_ns;
+		__entry->stat = stat;
+	),
+
+	TP_printk("full=%d nr_scanned=%lu nr_reclaimed=%lu free_target=%lu cpu_ns=%llu duration_ns=%llu stat=0x%x",
+		__entry->full, __entry->nr_scanned, __entry->nr_reclaimed,
+		__entry->free_target, __entry->cpu_ns, __entry->duration_ns,
+		__entry->stat)
+);
+
+#endif /* _TRACE_RCC_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -0,0 +1,26 @@
+#ifndef _LINUX_NETFILTER_XT_UIDSET_H
+#define _LINUX_NETFILTER_XT_UIDSET_H 1
+
+#include <linux/types.h>
+
+enum {
+	XT_UIDSET_INVERT = 1 << 0,
+};
+
+#define XT_UIDSET_VALID_FLAGS	XT_UIDSET_INVERT
+#define XT_UIDSET_NAME_LEN	32
+
+/*
+ * Match packets whose socket owner is in the named set. The set is
+ * /proc/net/xt_uidset/<name>, written with "+uid", "-uid" and "/" (flush)
+ * tokens; all tokens of one write are applied at once.
+ */
+struct xt_uidset_mtinfo {
+	char name[XT_UIDSET_NAME_LEN];
+	__u8 flags;
+
+	/* Used internally by the kernel */
+	struct uidset_table *table __attribute__((aligned(8)));
+};
+
+#endif /* _LINUX_NETFILTER_XT_UIDSET_H */
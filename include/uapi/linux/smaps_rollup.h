@@ -0,0 +1,23 @@
+#ifndef _UAPI_LINUX_SMAPS_ROLLUP_H
+#define _UAPI_LINUX_SMAPS_ROLLUP_H
+
+#include <linux/types.h>
+
+/*
+ * /proc/smaps_rollup_batch: write an array of up to SMAPS_ROLLUP_BATCH_MAX
+ * __s32 pids, then read back one struct smaps_rollup_entry per pid, in the
+ * same order. The file position counts bytes of entries, a write resets it.
+ */
+#define SMAPS_ROLLUP_BATCH_MAX	256
+
+struct smaps_rollup_entry {
+	__s32 pid;
+	__s32 error;		/* 0 or a negative errno, sizes are 0 then */
+	__u64 rss;		/* all sizes in kB */
+	__u64 pss;
+	__u64 uss;		/* Private_Clean + Private_Dirty */
+	__u64 swap;
+	__u64 swap_pss;
+};
+
+#endif /* _UAPI_LINUX_SMAPS_ROLLUP_H */
@@ -0,0 +1,26 @@
+#ifndef _UAPI_LINUX_TASK_STAT_H
+#define _UAPI_LINUX_TASK_STAT_H
+
+#include <linux/types.h>
+
+/*
+ * /proc/task_stats and the cgroup.task_stats file of each cgroup on a
+ * legacy hierarchy: one struct task_stat_entry per thread, back to back,
+ * with no header. Read the whole file with a large buffer; it is built
+ * in one pass so that every entry comes from the same snapshot.
+ */
+struct task_stat_entry {
+	__s32 pid;
+	__s32 tgid;
+	__u64 utime_ns;		/* as utime/stime of /proc/<pid>/task/<tid>/stat */
+	__u64 stime_ns;
+	__u64 rss_kb;		/* of the whole process, 0 for kernel threads */
+	__u64 min_flt;
+	__u64 maj_flt;
+	__u32 demand;		/* WALT demand, 0 when WALT is not built in */
+	__u8 state;		/* 'R', 'S', 'D', ... as in /proc/<pid>/stat */
+	__u8 __pad[3];
+	char comm[16];
+};
+
+#endif /* _UAPI_LINUX_TASK_STAT_H */
@@ -81,6 +81,7 @@
 #include <linux/integrity.h>
 #include <linux/proc_ns.h>
 #include <linux/io.h>
+#include <linux/hisi/hisi_boot_initcall.h>
 
 #include <asm/io.h>
 #include <asm/bugs.h>
@@ -792,6 +793,9 @@ int __init_or_module do_one_initcall(initcall_t fn)
 	int count = preempt_count();
 	int ret;
 	char msgbuf[64];
+#ifdef CONFIG_HISI_BOOT_TIME
+	ktime_t calltime = ktime_get();
+#endif
 
 	if (initcall_blacklisted(fn))
 		return -EPERM;
@@ -801,6 +805,12 @@ int __init_or_module do_one_initcall(initcall_t fn)
 	else
 		ret = fn();
 
+#ifdef CONFIG_HISI_BOOT_TIME
+	if (system_state == SYSTEM_BOOTING)
+		hisi_boottime_initcall(fn, ktime_us_delta(ktime_get(), calltime),
+				       false);
+#endif
+
 	msgbuf[0] = 0;
 
 	if (preempt_count() != count) {
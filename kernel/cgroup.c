@@ -51,6 +51,8 @@
 #include <linux/kmod.h>
 #include <linux/delayacct.h>
 #include <linux/cgroupstats.h>
+#include <linux/task_stat.h>
+#include <linux/psi.h>
 #include <linux/hashtable.h>
 #include <linux/pid_namespace.h>
 #include <linux/idr.h>
@@ -2135,7 +2137,7 @@ static void cgroup_task_migrate(struct cgroup *old_cgrp,
 	old_cset = task_css_set(tsk);
 
 	get_css_set(new_cset);
-	rcu_assign_pointer(tsk->cgroups, new_cset);
+	cgroup_move_task(tsk, new_cset);
 
 	/*
 	 * Use move_tail so that cgroup_taskset_first() still returns the
@@ -2494,30 +2496,20 @@ static int cgroup_allow_attach(struct cgroup *cgrp, struct cgroup_taskset *tset)
  * function to attach either it or all tasks in its threadgroup. Will lock
  * cgroup_mutex and threadgroup.
  */
-static ssize_t __cgroup_procs_write(struct kernfs_open_file *of, char *buf,
-				    size_t nbytes, loff_t off, bool threadgroup)
+static int cgroup_procs_write_pid(struct cgroup *cgrp, pid_t pid,
+				  bool threadgroup)
 {
 	struct task_struct *tsk;
 	const struct cred *cred = current_cred(), *tcred;
-	struct cgroup *cgrp;
-	pid_t pid;
 	int ret;
 
-	if (kstrtoint(strstrip(buf), 0, &pid) || pid < 0)
-		return -EINVAL;
-
-	cgrp = cgroup_kn_lock_live(of->kn);
-	if (!cgrp)
-		return -ENODEV;
-
 retry_find_task:
 	rcu_read_lock();
 	if (pid) {
 		tsk = find_task_by_vpid(pid);
 		if (!tsk) {
 			rcu_read_unlock();
-			ret = -ESRCH;
-			goto out_unlock_cgroup;
+			return -ESRCH;
 		}
 		/*
 		 * even if we're attaching all tasks in the thread group, we
@@ -2543,7 +2535,7 @@ retry_find_task:
 			list_del(&tset.src_csets);
 			if (ret) {
 				rcu_read_unlock();
-				goto out_unlock_cgroup;
+				return ret;
 			}
 		}
 	} else
@@ -2558,14 +2550,29 @@ retry_find_task:
 	 * with no rt_runtime allocated.  Just say no.
 	 */
 	if (tsk == kthreadd_task || (tsk->flags & PF_NO_SETAFFINITY)) {
-		ret = -EINVAL;
 		rcu_read_unlock();
-		goto out_unlock_cgroup;
+		return -EINVAL;
 	}
 
 	get_task_struct(tsk);
 	rcu_read_unlock();
 
+	/*
+	 * A single thread that is already in @cgrp has nothing to migrate,
+	 * don't bother with its threadgroup lock.
+	 */
+	if (!threadgroup) {
+		bool same;
+
+		down_read(&css_set_rwsem);
+		same = task_cgroup_from_root(tsk, cgrp->root) == cgrp;
+		up_read(&css_set_rwsem);
+		if (same) {
+			put_task_struct(tsk);
+			return 0;
+		}
+	}
+
 	threadgroup_lock(tsk);
 	if (threadgroup) {
 		if (!thread_group_leader(tsk)) {
@@ -2587,7 +2594,54 @@ retry_find_task:
 	threadgroup_unlock(tsk);
 
 	put_task_struct(tsk);
-out_unlock_cgroup:
+	return ret;
+}
+
+/*
+ * Several pids separated by white space can be written at once, so that
+ * moving a whole app takes cgroup_mutex only once. A task of such a batch
+ * that exited in the meantime is skipped, any other error ends the batch.
+ */
+static ssize_t __cgroup_procs_write(struct kernfs_open_file *of, char *buf,
+				    size_t nbytes, loff_t off, bool threadgroup)
+{
+	struct cgroup_root *root;
+	struct cgroup *cgrp;
+	ktime_t start = ktime_get();
+	bool batch;
+	char *tok;
+	pid_t pid;
+	int ret = -EINVAL;
+	u64 ns;
+
+	buf = strstrip(buf);
+	batch = strpbrk(buf, " \t\n") != NULL;
+
+	cgrp = cgroup_kn_lock_live(of->kn);
+	if (!cgrp)
+		return -ENODEV;
+
+	while ((tok = strsep(&buf, " \t\n")) != NULL) {
+		if (!*tok)
+			continue;
+		if (kstrtoint(tok, 0, &pid) || pid < 0) {
+			ret = -EINVAL;
+			break;
+		}
+		ret = cgroup_procs_write_pid(cgrp, pid, threadgroup);
+		if (ret == -ESRCH && batch)
+			ret = 0;
+		if (ret)
+			break;
+	}
+
+	root = cgrp->root;
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	root->attach_count++;
+	root->attach_total_ns += ns;
+	if (ns > root->attach_max_ns)
+		root->attach_max_ns = ns;
+
 	cgroup_kn_unlock(of->kn);
 	return ret ?: nbytes;
 }
@@ -2670,6 +2724,43 @@ static int cgroup_sane_behavior_show(struct seq_file *seq, void *v)
 	return 0;
 }
 
+static int cgroup_attach_stat_show(struct seq_file *seq, void *v)
+{
+	struct cgroup_root *root = seq_css(seq)->cgroup->root;
+	u64 count, total, max;
+
+	mutex_lock(&cgroup_mutex);
+	count = root->attach_count;
+	total = root->attach_total_ns;
+	max = root->attach_max_ns;
+	mutex_unlock(&cgroup_mutex);
+
+	seq_printf(seq, "count %llu\n", count);
+	seq_printf(seq, "avg_us %llu\n",
+		   count ? div64_u64(total, count * NSEC_PER_USEC) : 0);
+	seq_printf(seq, "max_us %llu\n", div_u64(max, NSEC_PER_USEC));
+	return 0;
+}
+
+#ifdef CONFIG_PROC_FS
+/* binary stats of every thread in the cgroup, see linux/task_stat.h */
+static int cgroup_task_stats_show(struct seq_file *seq, void *v)
+{
+	struct task_stat_entry e;
+	struct css_task_iter it;
+	struct task_struct *task;
+
+	css_task_iter_start(seq_css(seq), &it);
+	while ((task = css_task_iter_next(&it))) {
+		proc_task_stat_entry(task, &e);
+		if (e.pid)
+			seq_write(seq, &e, sizeof(e));
+	}
+	css_task_iter_end(&it);
+	return 0;
+}
+#endif
+
 static void cgroup_print_ss_mask(struct seq_file *seq, unsigned int ss_mask)
 {
 	struct cgroup_subsys *ss;
@@ -4418,6 +4509,17 @@ static struct cftype cgroup_legacy_base_files[] = {
 		.flags = CFTYPE_ONLY_ON_ROOT,
 		.seq_show = cgroup_sane_behavior_show,
 	},
+	{
+		.name = "cgroup.attach_stat",
+		.flags = CFTYPE_ONLY_ON_ROOT,
+		.seq_show = cgroup_attach_stat_show,
+	},
+#ifdef CONFIG_PROC_FS
+	{
+		.name = "cgroup.task_stats",
+		.seq_show = cgroup_task_stats_show,
+	},
+#endif
 	{
 		.name = "tasks",
 		.seq_start = cgroup_pidlist_start,
@@ -5426,7 +5528,7 @@ void cgroup_exit(struct task_struct *tsk)
 
 	/* Reassign the task to the init_css_set. */
 	cset = task_css_set(tsk);
-	RCU_INIT_POINTER(tsk->cgroups, &init_css_set);
+	cgroup_move_task(tsk, &init_css_set);
 
 	/* see cgroup_post_fork() for details */
 	for_each_subsys_which(ss, i, &have_exit_callback) {
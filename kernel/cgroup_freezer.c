@@ -22,6 +22,9 @@
 #include <linux/freezer.h>
 #include <linux/seq_file.h>
 #include <linux/mutex.h>
+#include <linux/kernfs.h>
+#include <linux/ktime.h>
+#include <linux/workqueue.h>
 
 /*
  * A cgroup is freezing if any FREEZING flags are set.  FREEZING_SELF is
@@ -43,6 +46,18 @@ enum freezer_state_flags {
 struct freezer {
 	struct cgroup_subsys_state	css;
 	unsigned int			state;
+
+	/* tasks blocked in the kernel count as frozen, see update_if_frozen() */
+	bool				fast;
+
+	/* when FREEZING started, and how long it took to become FROZEN */
+	u64				freeze_start;
+	u64				last_latency;
+	u64				max_latency;
+	unsigned long			nr_frozen;
+
+	/* checks for FROZEN as soon as a task of the cgroup freezes */
+	struct work_struct		frozen_work;
 };
 
 static DEFINE_MUTEX(freezer_mutex);
@@ -82,6 +97,8 @@ static const char *freezer_state_strs(unsigned int state)
 	return "THAWED";
 };
 
+static void freezer_frozen_workfn(struct work_struct *work);
+
 static struct cgroup_subsys_state *
 freezer_css_alloc(struct cgroup_subsys_state *parent_css)
 {
@@ -91,9 +108,39 @@ freezer_css_alloc(struct cgroup_subsys_state *parent_css)
 	if (!freezer)
 		return ERR_PTR(-ENOMEM);
 
+	INIT_WORK(&freezer->frozen_work, freezer_frozen_workfn);
+
 	return &freezer->css;
 }
 
+/* the work holds a css reference until it has run */
+static void freezer_queue_update(struct freezer *freezer)
+{
+	if (!css_tryget(&freezer->css))
+		return;
+	if (!queue_work(system_wq, &freezer->frozen_work))
+		css_put(&freezer->css);
+}
+
+/**
+ * cgroup_freezer_task_frozen - a task entered the refrigerator
+ * @task: the task, %current
+ *
+ * Find out right away whether this was the last task its cgroup was
+ * waiting for, rather than when freezer.state is read next.
+ */
+void cgroup_freezer_task_frozen(struct task_struct *task)
+{
+	struct freezer *freezer;
+
+	rcu_read_lock();
+	freezer = task_freezer(task);
+	if ((freezer->state & CGROUP_FREEZING) &&
+	    !(freezer->state & CGROUP_FROZEN))
+		freezer_queue_update(freezer);
+	rcu_read_unlock();
+}
+
 /**
  * freezer_css_online - commit creation of a freezer css
  * @css: css being created
@@ -110,6 +157,8 @@ static int freezer_css_online(struct cgroup_subsys_state *css)
 	mutex_lock(&freezer_mutex);
 
 	freezer->state |= CGROUP_FREEZER_ONLINE;
+	if (parent)
+		freezer->fast = parent->fast;
 
 	if (parent && (parent->state & CGROUP_FREEZING)) {
 		freezer->state |= CGROUP_FREEZING_PARENT | CGROUP_FROZEN;
@@ -179,13 +228,20 @@ static void freezer_attach(struct cgroup_subsys_state *new_css,
 			__thaw_task(task);
 		} else {
 			freeze_task(task);
+			if (freezer->state & CGROUP_FROZEN)
+				freezer->freeze_start = ktime_get_ns();
 			freezer->state &= ~CGROUP_FROZEN;
 			clear_frozen = true;
 		}
 	}
 
+	if (clear_frozen)
+		freezer_queue_update(freezer);
+
 	/* propagate FROZEN clearing upwards */
 	while (clear_frozen && (freezer = parent_freezer(freezer))) {
+		if (freezer->state & CGROUP_FROZEN)
+			freezer->freeze_start = ktime_get_ns();
 		freezer->state &= ~CGROUP_FROZEN;
 		clear_frozen = freezer->state & CGROUP_FREEZING;
 	}
@@ -228,6 +284,18 @@ static void freezer_fork(struct task_struct *task)
 	mutex_unlock(&freezer_mutex);
 }
 
+/*
+ * A user task blocked uninterruptibly in the kernel, with the fake signal
+ * of the freeze request pending, can't get back to user space without
+ * entering the refrigerator on its way, see get_signal().
+ */
+static bool freezer_task_trapped(struct task_struct *task)
+{
+	return !(task->flags & PF_KTHREAD) &&
+	       (READ_ONCE(task->state) & TASK_UNINTERRUPTIBLE) &&
+	       !READ_ONCE(task->on_rq) && signal_pending(task);
+}
+
 /**
  * update_if_frozen - update whether a cgroup finished freezing
  * @css: css of interest
@@ -279,9 +347,11 @@ static void update_if_frozen(struct cgroup_subsys_state *css)
 			 * freezer_should_skip() indicates that the task
 			 * should be skipped when determining freezing
 			 * completion.  Consider it frozen in addition to
-			 * the usual frozen condition.
+			 * the usual frozen condition.  In fast mode, so is
+			 * a task which is trapped in the kernel.
 			 */
-			if (!frozen(task) && !freezer_should_skip(task))
+			if (!frozen(task) && !freezer_should_skip(task) &&
+			    !(freezer->fast && freezer_task_trapped(task)))
 				goto out_iter_end;
 		}
 	}
@@ -291,26 +361,88 @@ out_iter_end:
 	css_task_iter_end(&it);
 }
 
-static int freezer_read(struct seq_file *m, void *v)
+/* wake up the pollers of freezer.state */
+static void freezer_notify(struct freezer *freezer)
 {
-	struct cgroup_subsys_state *css = seq_css(m), *pos;
+	struct cgroup *cgrp = freezer->css.cgroup;
+	struct kernfs_node *kn;
+
+	kn = kernfs_find_and_get(cgrp->kn,
+				 cgrp->root->flags & CGRP_ROOT_NOPREFIX ?
+				 "state" : "freezer.state");
+	if (kn) {
+		kernfs_notify(kn);
+		kernfs_put(kn);
+	}
+}
 
-	mutex_lock(&freezer_mutex);
-	rcu_read_lock();
+/* update_if_frozen(), and account and announce the transition to FROZEN */
+static void freezer_update(struct cgroup_subsys_state *css)
+{
+	struct freezer *freezer = css_freezer(css);
+	bool was_frozen = freezer->state & CGROUP_FROZEN;
+	u64 latency;
+
+	update_if_frozen(css);
 
-	/* update states bottom-up */
+	if (was_frozen || !(freezer->state & CGROUP_FROZEN))
+		return;
+
+	latency = ktime_get_ns() - freezer->freeze_start;
+	freezer->last_latency = latency;
+	freezer->max_latency = max(freezer->max_latency, latency);
+	freezer->nr_frozen++;
+	freezer_notify(freezer);
+}
+
+/* update the states of @css and its descendants bottom-up */
+static void freezer_update_tree(struct cgroup_subsys_state *css)
+{
+	struct cgroup_subsys_state *pos;
+
+	lockdep_assert_held(&freezer_mutex);
+
+	rcu_read_lock();
 	css_for_each_descendant_post(pos, css) {
 		if (!css_tryget_online(pos))
 			continue;
 		rcu_read_unlock();
 
-		update_if_frozen(pos);
+		freezer_update(pos);
 
 		rcu_read_lock();
 		css_put(pos);
 	}
-
 	rcu_read_unlock();
+}
+
+static void freezer_frozen_workfn(struct work_struct *work)
+{
+	struct freezer *freezer = container_of(work, struct freezer,
+					       frozen_work);
+	struct freezer *pos, *parent;
+
+	mutex_lock(&freezer_mutex);
+	freezer_update_tree(&freezer->css);
+
+	/* which may have been the last one its freezing ancestors needed */
+	for (pos = freezer; (parent = parent_freezer(pos)); pos = parent) {
+		if (!(pos->state & CGROUP_FROZEN) ||
+		    !(parent->state & CGROUP_FREEZING))
+			break;
+		freezer_update(&parent->css);
+	}
+	mutex_unlock(&freezer_mutex);
+
+	css_put(&freezer->css);
+}
+
+static int freezer_read(struct seq_file *m, void *v)
+{
+	struct cgroup_subsys_state *css = seq_css(m);
+
+	mutex_lock(&freezer_mutex);
+	freezer_update_tree(css);
 	mutex_unlock(&freezer_mutex);
 
 	seq_puts(m, freezer_state_strs(css_freezer(css)->state));
@@ -359,8 +491,10 @@ static void freezer_apply_state(struct freezer *freezer, bool freeze,
 		return;
 
 	if (freeze) {
-		if (!(freezer->state & CGROUP_FREEZING))
+		if (!(freezer->state & CGROUP_FREEZING)) {
 			atomic_inc(&system_freezing_cnt);
+			freezer->freeze_start = ktime_get_ns();
+		}
 		freezer->state |= state;
 		freeze_cgroup(freezer);
 	} else {
@@ -416,6 +550,10 @@ static void freezer_change_state(struct freezer *freezer, bool freeze)
 		css_put(pos);
 	}
 	rcu_read_unlock();
+
+	/* the tasks may all be frozen or trapped already */
+	if (freeze)
+		freezer_queue_update(freezer);
 	mutex_unlock(&freezer_mutex);
 }
 
@@ -453,6 +591,45 @@ static u64 freezer_parent_freezing_read(struct cgroup_subsys_state *css,
 	return (bool)(freezer->state & CGROUP_FREEZING_PARENT);
 }
 
+static u64 freezer_fast_read(struct cgroup_subsys_state *css,
+			     struct cftype *cft)
+{
+	return css_freezer(css)->fast;
+}
+
+static int freezer_fast_write(struct cgroup_subsys_state *css,
+			      struct cftype *cft, u64 val)
+{
+	struct freezer *freezer = css_freezer(css);
+
+	mutex_lock(&freezer_mutex);
+	freezer->fast = val;
+	if (freezer->state & CGROUP_FREEZING)
+		freezer_queue_update(freezer);
+	mutex_unlock(&freezer_mutex);
+
+	return 0;
+}
+
+static int freezer_latency_show(struct seq_file *m, void *v)
+{
+	struct freezer *freezer = css_freezer(seq_css(m));
+	u64 pending = 0;
+
+	mutex_lock(&freezer_mutex);
+	if ((freezer->state & CGROUP_FREEZING) &&
+	    !(freezer->state & CGROUP_FROZEN))
+		pending = ktime_get_ns() - freezer->freeze_start;
+
+	seq_printf(m, "last_us %llu\n", freezer->last_latency / NSEC_PER_USEC);
+	seq_printf(m, "max_us %llu\n", freezer->max_latency / NSEC_PER_USEC);
+	seq_printf(m, "pending_us %llu\n", pending / NSEC_PER_USEC);
+	seq_printf(m, "frozen %lu\n", freezer->nr_frozen);
+	mutex_unlock(&freezer_mutex);
+
+	return 0;
+}
+
 static struct cftype files[] = {
 	{
 		.name = "state",
@@ -470,6 +647,17 @@ static struct cftype files[] = {
 		.flags = CFTYPE_NOT_ON_ROOT,
 		.read_u64 = freezer_parent_freezing_read,
 	},
+	{
+		.name = "fast",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.read_u64 = freezer_fast_read,
+		.write_u64 = freezer_fast_write,
+	},
+	{
+		.name = "latency",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.seq_show = freezer_latency_show,
+	},
 	{ }	/* terminate */
 };
 
@@ -73,6 +73,7 @@ static void __unhash_process(struct task_struct *p, bool group_dead)
 		detach_pid(p, PIDTYPE_SID);
 
 		list_del_rcu(&p->tasks);
+		lowmem_signal_del(p->signal);
 		list_del_init(&p->sibling);
 		__this_cpu_dec(process_counts);
 	}
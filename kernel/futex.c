@@ -64,6 +64,8 @@
 #include <linux/hugetlb.h>
 #include <linux/freezer.h>
 #include <linux/bootmem.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include <asm/futex.h>
 
@@ -252,8 +254,21 @@ struct futex_hash_bucket {
 	atomic_t waiters;
 	spinlock_t lock;
 	struct plist_head chain;
+	/* lock acquisitions, and those that found it held; under lock */
+	unsigned long locked;
+	unsigned long contended;
 } ____cacheline_aligned_in_smp;
 
+/*
+ * Non-PI waiters are queued by normal_prio, so a nice -10 UI thread is
+ * woken ahead of a pool of nice 0 workers. Equal priorities stay FIFO.
+ * Off, only RT waiters are ordered and everybody else is FIFO.
+ */
+int sysctl_futex_prio_wake;
+
+/* a schedtune boosted waker lends its boost to the task it wakes */
+int sysctl_futex_wake_boost = 1;
+
 static unsigned long __read_mostly futex_hashsize;
 
 static struct futex_hash_bucket *futex_queues;
@@ -314,6 +329,17 @@ static struct futex_hash_bucket *hash_futex(union futex_key *key)
 	return &futex_queues[hash & (futex_hashsize - 1)];
 }
 
+/* takes hb->lock and accounts for it in the bucket contention stats */
+static inline void hb_lock(struct futex_hash_bucket *hb, int subclass)
+{
+	bool contended = !spin_trylock(&hb->lock);
+
+	if (contended)
+		spin_lock_nested(&hb->lock, subclass);
+	hb->locked++;
+	hb->contended += contended;
+}
+
 /*
  * Return 1 if two futex_keys are equal, 0 otherwise.
  */
@@ -1088,6 +1114,49 @@ static void __unqueue_futex(struct futex_q *q)
 	hb_waiters_dec(hb);
 }
 
+#ifdef CONFIG_CGROUP_SCHEDTUNE
+/*
+ * A boosted (top-app) waker lends its schedtune boost to a non-PI waiter,
+ * so that wakeup placement treats the wakee like a boosted task instead
+ * of leaving it on a little core. The wakee saves its own inherited boost
+ * before it is queued and puts it back once unqueue_me() has returned, by
+ * which time the waker is done with it: the loan only covers the wakeup.
+ */
+static inline void futex_lend_boost(struct task_struct *p)
+{
+	int boost;
+
+	if (!sysctl_futex_wake_boost)
+		return;
+	boost = schedtune_task_boost(current);
+	if (boost > p->stune_inherited_boost)
+		p->stune_inherited_boost = boost;
+}
+
+static inline int futex_save_boost(void)
+{
+	return current->stune_inherited_boost;
+}
+
+static inline void futex_restore_boost(int boost)
+{
+	current->stune_inherited_boost = boost;
+}
+#else
+static inline void futex_lend_boost(struct task_struct *p)
+{
+}
+
+static inline int futex_save_boost(void)
+{
+	return 0;
+}
+
+static inline void futex_restore_boost(int boost)
+{
+}
+#endif
+
 /*
  * The hash bucket lock must be held when this is called.
  * Afterwards, the futex_q must not be accessed.
@@ -1099,6 +1168,9 @@ static void wake_futex(struct futex_q *q)
 	if (WARN(q->pi_state || q->rt_waiter, "refusing to wake PI futex\n"))
 		return;
 
+	/* before lock_ptr is cleared, see futex_restore_boost() */
+	futex_lend_boost(p);
+
 	/*
 	 * We set q->lock_ptr = NULL _before_ we wake up the task. If
 	 * a non-futex wake up happens on another CPU then the task
@@ -1200,12 +1272,12 @@ static inline void
 double_lock_hb(struct futex_hash_bucket *hb1, struct futex_hash_bucket *hb2)
 {
 	if (hb1 <= hb2) {
-		spin_lock(&hb1->lock);
+		hb_lock(hb1, 0);
 		if (hb1 < hb2)
-			spin_lock_nested(&hb2->lock, SINGLE_DEPTH_NESTING);
+			hb_lock(hb2, SINGLE_DEPTH_NESTING);
 	} else { /* hb1 > hb2 */
-		spin_lock(&hb2->lock);
-		spin_lock_nested(&hb1->lock, SINGLE_DEPTH_NESTING);
+		hb_lock(hb2, 0);
+		hb_lock(hb1, SINGLE_DEPTH_NESTING);
 	}
 }
 
@@ -1241,7 +1313,7 @@ futex_wake(u32 __user *uaddr, unsigned int flags, int nr_wake, u32 bitset)
 	if (!hb_waiters_pending(hb))
 		goto out_put_key;
 
-	spin_lock(&hb->lock);
+	hb_lock(hb, 0);
 
 	plist_for_each_entry_safe(this, next, &hb->chain, list) {
 		if (match_futex (&this->key, &key)) {
@@ -1768,7 +1840,7 @@ static inline struct futex_hash_bucket *queue_lock(struct futex_q *q)
 
 	q->lock_ptr = &hb->lock;
 
-	spin_lock(&hb->lock); /* implies MB (A) */
+	hb_lock(hb, 0); /* implies MB (A) */
 	return hb;
 }
 
@@ -1804,8 +1876,12 @@ static inline void queue_me(struct futex_q *q, struct futex_hash_bucket *hb)
 	 * - or MAX_RT_PRIO for non-RT threads.
 	 * Thus, all RT-threads are woken first in priority order, and
 	 * the others are woken last, in FIFO order.
+	 * With futex_prio_wake set, non-PI waiters use normal_prio whatever
+	 * their policy, so nice values are honoured too.
 	 */
 	prio = min(current->normal_prio, MAX_RT_PRIO);
+	if (sysctl_futex_prio_wake && !q->pi_state && !q->rt_waiter)
+		prio = current->normal_prio;
 
 	plist_node_init(&q->list, prio);
 	plist_add(&q->list, &hb->chain);
@@ -2178,7 +2254,7 @@ static int futex_wait(u32 __user *uaddr, unsigned int flags, u32 val,
 	struct restart_block *restart;
 	struct futex_hash_bucket *hb;
 	struct futex_q q = futex_q_init;
-	int ret;
+	int ret, woken, boost;
 
 	if (!bitset)
 		return -EINVAL;
@@ -2192,9 +2268,10 @@ static int futex_wait(u32 __user *uaddr, unsigned int flags, u32 val,
 				      HRTIMER_MODE_ABS);
 		hrtimer_init_sleeper(to, current);
 		hrtimer_set_expires_range_ns(&to->timer, *abs_time,
-					     current->timer_slack_ns);
+					     task_timer_slack(current));
 	}
 
+	boost = futex_save_boost();
 retry:
 	/*
 	 * Prepare to wait on uaddr. On success, holds hb lock and increments
@@ -2210,7 +2287,10 @@ retry:
 	/* If we were woken (and unqueued), we succeeded, whatever. */
 	ret = 0;
 	/* unqueue_me() drops q.key ref */
-	if (!unqueue_me(&q))
+	woken = !unqueue_me(&q);
+	/* a waker can no longer reach us, drop any boost it lent */
+	futex_restore_boost(boost);
+	if (woken)
 		goto out;
 	ret = -ETIMEDOUT;
 	if (to && !to->task)
@@ -2585,7 +2665,7 @@ static int futex_wait_requeue_pi(u32 __user *uaddr, unsigned int flags,
 				      HRTIMER_MODE_ABS);
 		hrtimer_init_sleeper(to, current);
 		hrtimer_set_expires_range_ns(&to->timer, *abs_time,
-					     current->timer_slack_ns);
+					     task_timer_slack(current));
 	}
 
 	/*
@@ -3074,8 +3154,86 @@ static int __init futex_init(void)
 		atomic_set(&futex_queues[i].waiters, 0);
 		plist_head_init(&futex_queues[i].chain);
 		spin_lock_init(&futex_queues[i].lock);
+		futex_queues[i].locked = 0;
+		futex_queues[i].contended = 0;
 	}
 
 	return 0;
 }
 core_initcall(futex_init);
+
+#ifdef CONFIG_DEBUG_FS
+#define FUTEX_HOT_BUCKETS	8
+
+/*
+ * Whether futex_hashsize is adequate: how many buckets see use, how often
+ * their lock was found held, and the buckets that are worst off. Many
+ * waiters in a hot bucket point at one contended futex, a hot bucket with
+ * few at unrelated futexes sharing it.
+ */
+static int futex_hash_show(struct seq_file *m, void *v)
+{
+	unsigned long hot[FUTEX_HOT_BUCKETS];
+	unsigned long locked = 0, contended = 0, used = 0, i;
+	int waiters, max_waiters = 0;
+	int nr_hot = 0, j, k;
+
+	for (i = 0; i < futex_hashsize; i++) {
+		struct futex_hash_bucket *hb = &futex_queues[i];
+		unsigned long c = ACCESS_ONCE(hb->contended);
+
+		locked += ACCESS_ONCE(hb->locked);
+		contended += c;
+		used += !!hb->locked;
+		waiters = atomic_read(&hb->waiters);
+		max_waiters = max(max_waiters, waiters);
+
+		/* insertion into the list of hottest buckets so far */
+		if (!c)
+			continue;
+		for (j = 0; j < nr_hot; j++)
+			if (c > futex_queues[hot[j]].contended)
+				break;
+		if (j == FUTEX_HOT_BUCKETS)
+			continue;
+		nr_hot = min(nr_hot + 1, FUTEX_HOT_BUCKETS);
+		for (k = nr_hot - 1; k > j; k--)
+			hot[k] = hot[k - 1];
+		hot[j] = i;
+	}
+
+	seq_printf(m, "buckets: %lu\n", futex_hashsize);
+	seq_printf(m, "buckets used: %lu\n", used);
+	seq_printf(m, "locked: %lu\n", locked);
+	seq_printf(m, "contended: %lu\n", contended);
+	seq_printf(m, "max waiters: %d\n", max_waiters);
+	seq_puts(m, "bucket locked contended waiters\n");
+	for (j = 0; j < nr_hot; j++) {
+		struct futex_hash_bucket *hb = &futex_queues[hot[j]];
+
+		seq_printf(m, "%6lu %6lu %9lu %7d\n", hot[j], hb->locked,
+			   hb->contended, atomic_read(&hb->waiters));
+	}
+	return 0;
+}
+
+static int futex_hash_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, futex_hash_show, NULL);
+}
+
+static const struct file_operations futex_hash_fops = {
+	.open		= futex_hash_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init futex_debugfs_init(void)
+{
+	debugfs_create_file("futex_hash", S_IRUSR, NULL, NULL,
+			    &futex_hash_fops);
+	return 0;
+}
+late_initcall(futex_debugfs_init);
+#endif
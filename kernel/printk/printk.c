@@ -46,6 +46,7 @@
 #include <linux/utsname.h>
 #include <linux/ctype.h>
 #include <linux/uio.h>
+#include <linux/kthread.h>
 
 #include <asm/uaccess.h>
 
@@ -1496,6 +1497,97 @@ static int have_callable_console(void)
 	return 0;
 }
 
+#ifdef CONFIG_HISI_PRINTK_DEFERRED_CONSOLE
+/*
+ * Deferred console: printk() only stores the record and kicks a low
+ * priority kthread, which owns the console_sem and pushes the records
+ * out to the (slow) UART. Oopses, panics, shutdown and emergency level
+ * messages still go out synchronously from the printing context.
+ */
+static bool console_deferred = true;
+module_param_named(console_deferred, console_deferred, bool, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(console_deferred, "hand console output to a kthread");
+
+static struct task_struct *console_kthread;
+static bool console_kthread_pending;
+static atomic_t console_sync_forced = ATOMIC_INIT(0);
+
+/*
+ * printk_console_force_sync - stop deferring console output for good.
+ *
+ * For emergency paths (FIQ dump, watchdog) that are about to stop the
+ * system and must get whatever is buffered out before they do.
+ */
+void printk_console_force_sync(void)
+{
+	atomic_set(&console_sync_forced, 1);
+	if (console_trylock())
+		console_unlock();
+}
+EXPORT_SYMBOL(printk_console_force_sync);
+
+static bool console_output_deferred(int level)
+{
+	if (!console_deferred || !console_kthread)
+		return false;
+	if (oops_in_progress || atomic_read(&console_sync_forced))
+		return false;
+	if (system_state != SYSTEM_RUNNING)
+		return false;
+	return level != LOGLEVEL_EMERG;
+}
+
+static void console_kthread_wake(void)
+{
+	WRITE_ONCE(console_kthread_pending, true);
+	wake_up_process(console_kthread);
+}
+
+static int console_kthread_func(void *unused)
+{
+	set_user_nice(current, MAX_NICE - 9);
+
+	while (!kthread_should_stop()) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (!xchg(&console_kthread_pending, false)) {
+			schedule();
+			continue;
+		}
+		__set_current_state(TASK_RUNNING);
+
+		/* console_lock() lets console_unlock() reschedule per line */
+		console_lock();
+		console_unlock();
+	}
+	__set_current_state(TASK_RUNNING);
+
+	return 0;
+}
+
+static int __init console_kthread_init(void)
+{
+	struct task_struct *tsk;
+
+	tsk = kthread_run(console_kthread_func, NULL, "kconsoled");
+	if (IS_ERR(tsk)) {
+		pr_err("printk: failed to start console kthread, %ld\n",
+		       PTR_ERR(tsk));
+		return PTR_ERR(tsk);
+	}
+	console_kthread = tsk;
+	return 0;
+}
+#else
+static inline bool console_output_deferred(int level)
+{
+	return false;
+}
+
+static inline void console_kthread_wake(void)
+{
+}
+#endif /* CONFIG_HISI_PRINTK_DEFERRED_CONSOLE */
+
 /*
  * Can we actually use the console at this time on this cpu?
  *
@@ -1828,7 +1920,9 @@ asmlinkage int vprintk_emit(int facility, int level,
 	local_irq_restore(flags);
 
 	/* If called from the scheduler, we can not call up(). */
-	if (!in_sched) {
+	if (!in_sched && console_output_deferred(level)) {
+		console_kthread_wake();
+	} else if (!in_sched) {
 		lockdep_off();
 		/*
 		 * Disable preemption to avoid being preempted while holding
@@ -2699,6 +2793,9 @@ static int __init printk_late_init(void)
 		}
 	}
 	hotcpu_notifier(console_cpu_notify, 0);
+#ifdef CONFIG_HISI_PRINTK_DEFERRED_CONSOLE
+	console_kthread_init();
+#endif
 	return 0;
 }
 late_initcall(printk_late_init);
@@ -51,6 +51,27 @@ static bool have_rcu_nocb_mask;	    /* Was rcu_nocb_mask allocated? */
 static bool __read_mostly rcu_nocb_poll;    /* Offload kthread are to poll. */
 #endif /* #ifdef CONFIG_RCU_NOCB_CPU */
 
+#ifdef CONFIG_RCU_NOCB_CPU_BIG
+extern void __init arch_get_fast_and_slow_cpus(struct cpumask *fast,
+					       struct cpumask *slow);
+
+/* Little CPUs, which run the RCU kthreads on behalf of the big ones. */
+static struct cpumask rcu_little_cpus;
+
+/* Bind an RCU kthread to the little cluster, if there is one. */
+static bool rcu_bind_little(struct task_struct *t)
+{
+	if (cpumask_empty(&rcu_little_cpus))
+		return false;
+	return !set_cpus_allowed_ptr(t, &rcu_little_cpus);
+}
+#else /* #ifdef CONFIG_RCU_NOCB_CPU_BIG */
+static inline bool rcu_bind_little(struct task_struct *t)
+{
+	return false;
+}
+#endif /* #else #ifdef CONFIG_RCU_NOCB_CPU_BIG */
+
 /*
  * Check the RCU kernel configuration parameters and print informative
  * messages about anything out of the ordinary.  If you like #ifdef, you
@@ -2310,6 +2331,7 @@ static int rcu_nocb_kthread(void *arg)
 				cl++;
 			c++;
 			local_bh_enable();
+			cond_resched_rcu_qs();
 			list = next;
 		}
 		trace_rcu_batch_end(rdp->rsp->name, c, !!list, 0, 0, 1);
@@ -2377,6 +2399,19 @@ void __init rcu_init_nohz(void)
 	if (tick_nohz_full_running)
 		cpumask_or(rcu_nocb_mask, rcu_nocb_mask, tick_nohz_full_mask);
 #endif /* #if defined(CONFIG_NO_HZ_FULL) */
+#ifdef CONFIG_RCU_NOCB_CPU_BIG
+	{
+		struct cpumask big;
+
+		arch_get_fast_and_slow_cpus(&big, &rcu_little_cpus);
+		if (!cpumask_empty(&rcu_little_cpus)) {
+			pr_info("\tOffload RCU callbacks from big CPUs %*pbl to little CPUs %*pbl\n",
+				cpumask_pr_args(&big),
+				cpumask_pr_args(&rcu_little_cpus));
+			cpumask_or(rcu_nocb_mask, rcu_nocb_mask, &big);
+		}
+	}
+#endif /* #ifdef CONFIG_RCU_NOCB_CPU_BIG */
 
 	if (!cpumask_subset(rcu_nocb_mask, cpu_possible_mask)) {
 		pr_info("\tNote: kernel parameter 'rcu_nocbs=' contains nonexistent CPUs.\n");
@@ -2448,6 +2483,7 @@ static void rcu_spawn_one_nocb_kthread(struct rcu_state *rsp, int cpu)
 	t = kthread_run(rcu_nocb_kthread, rdp_spawn,
 			"rcuo%c/%d", rsp->abbr, cpu);
 	BUG_ON(IS_ERR(t));
+	rcu_bind_little(t);
 	ACCESS_ONCE(rdp_spawn->nocb_kthread) = t;
 }
 
@@ -3062,6 +3098,8 @@ static void rcu_bind_gp_kthread(void)
 {
 	int __maybe_unused cpu;
 
+	if (rcu_bind_little(current))
+		return;
 	if (!tick_nohz_full_enabled())
 		return;
 #ifdef CONFIG_NO_HZ_FULL_SYSIDLE
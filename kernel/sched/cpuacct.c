@@ -7,6 +7,7 @@
 #include <linux/rcupdate.h>
 #include <linux/kernel_stat.h>
 #include <linux/err.h>
+#include <linux/psi.h>
 
 #include "sched.h"
 
@@ -31,6 +32,9 @@ struct cpuacct {
 	/* cpuusage holds pointer to a u64-type object on every cpu */
 	u64 __percpu *cpuusage;
 	struct kernel_cpustat __percpu *cpustat;
+#ifdef CONFIG_PSI
+	struct psi_group psi;
+#endif
 };
 
 static inline struct cpuacct *css_ca(struct cgroup_subsys_state *css)
@@ -76,8 +80,17 @@ cpuacct_css_alloc(struct cgroup_subsys_state *parent_css)
 	if (!ca->cpustat)
 		goto out_free_cpuusage;
 
+#ifdef CONFIG_PSI
+	if (psi_group_alloc(&ca->psi))
+		goto out_free_cpustat;
+#endif
+
 	return &ca->css;
 
+#ifdef CONFIG_PSI
+out_free_cpustat:
+	free_percpu(ca->cpustat);
+#endif
 out_free_cpuusage:
 	free_percpu(ca->cpuusage);
 out_free_ca:
@@ -91,6 +104,9 @@ static void cpuacct_css_free(struct cgroup_subsys_state *css)
 {
 	struct cpuacct *ca = css_ca(css);
 
+#ifdef CONFIG_PSI
+	psi_group_free(&ca->psi);
+#endif
 	free_percpu(ca->cpustat);
 	free_percpu(ca->cpuusage);
 	kfree(ca);
@@ -210,6 +226,18 @@ static int cpuacct_stats_show(struct seq_file *sf, void *v)
 	return 0;
 }
 
+#ifdef CONFIG_PSI
+/* the root group's pressure is the system's, also in /proc/pressure */
+static int cpuacct_pressure_show(struct seq_file *sf, void *v)
+{
+	struct cpuacct *ca = css_ca(seq_css(sf));
+	struct psi_group *group;
+
+	group = ca == &root_cpuacct ? &psi_system : &ca->psi;
+	return psi_show(sf, group, seq_cft(sf)->private);
+}
+#endif
+
 static struct cftype files[] = {
 	{
 		.name = "usage",
@@ -224,6 +252,23 @@ static struct cftype files[] = {
 		.name = "stat",
 		.seq_show = cpuacct_stats_show,
 	},
+#ifdef CONFIG_PSI
+	{
+		.name = "io.pressure",
+		.seq_show = cpuacct_pressure_show,
+		.private = PSI_IO,
+	},
+	{
+		.name = "memory.pressure",
+		.seq_show = cpuacct_pressure_show,
+		.private = PSI_MEM,
+	},
+	{
+		.name = "cpu.pressure",
+		.seq_show = cpuacct_pressure_show,
+		.private = PSI_CPU,
+	},
+#endif
 	{ }	/* terminate */
 };
 
@@ -255,6 +300,22 @@ void cpuacct_charge(struct task_struct *tsk, u64 cputime)
 	rcu_read_unlock();
 }
 
+#ifdef CONFIG_PSI
+/*
+ * Walk the pressure groups of @tsk's cpuacct group and its ancestors up
+ * to, not including, the root. Called under RCU with the rq lock held.
+ */
+struct psi_group *cpuacct_psi_next(struct task_struct *tsk, void **iter)
+{
+	struct cpuacct *ca = *iter ? parent_ca(*iter) : task_ca(tsk);
+
+	if (!ca || ca == &root_cpuacct)
+		return NULL;
+	*iter = ca;
+	return &ca->psi;
+}
+#endif
+
 /*
  * Add user/system time to cpuacct.
  *
@@ -2,6 +2,11 @@
 
 extern void cpuacct_charge(struct task_struct *tsk, u64 cputime);
 extern void cpuacct_account_field(struct task_struct *p, int index, u64 val);
+#ifdef CONFIG_PSI
+struct psi_group;
+extern struct psi_group *cpuacct_psi_next(struct task_struct *tsk,
+					   void **iter);
+#endif
 
 #else
 
@@ -41,6 +41,10 @@ DEFINE_PER_CPU(struct sched_capacity_reqs, cpu_sched_capacity_reqs);
  * @task: worker thread for dvfs transition that may block/sleep
  * @irq_work: callback used to wake up worker thread
  * @requested_freq: last frequency requested by the sched governor
+ * @fast_switch: the driver can switch from scheduler context
+ * @fast_lock: serializes fast switches of the cpus of the policy
+ * @nr_fast: transitions done from scheduler context
+ * @nr_slow: transitions done through __cpufreq_driver_target()
  *
  * struct gov_data is the per-policy cpufreq_sched-specific data structure. A
  * per-policy instance of it is created when the cpufreq_sched governor receives
@@ -58,6 +62,10 @@ struct gov_data {
 	struct task_struct *task;
 	struct irq_work irq_work;
 	unsigned int requested_freq;
+	bool fast_switch;
+	raw_spinlock_t fast_lock;
+	unsigned long nr_fast;
+	unsigned long nr_slow;
 };
 
 static void cpufreq_sched_try_driver_target(struct cpufreq_policy *policy,
@@ -70,12 +78,47 @@ static void cpufreq_sched_try_driver_target(struct cpufreq_policy *policy,
 		return;
 
 	__cpufreq_driver_target(policy, freq, CPUFREQ_RELATION_L);
+	gd->nr_slow++;
 
 	gd->up_throttle = ktime_add_ns(ktime_get(), gd->up_throttle_nsec);
 	gd->down_throttle = ktime_add_ns(ktime_get(), gd->down_throttle_nsec);
 	up_write(&policy->rwsem);
 }
 
+/*
+ * Set the OPP right away from scheduler context. Returns false if the
+ * request is throttled or the driver could not switch now, then the
+ * normal path takes it.
+ */
+static bool cpufreq_sched_fast_switch(struct cpufreq_policy *policy,
+				      unsigned int freq)
+{
+	struct gov_data *gd = policy->governor_data;
+	ktime_t now = ktime_get();
+	bool done = false;
+
+	/* the kthread waits for the end of the throttling period */
+	if (ktime_before(now, freq < policy->cur ?
+			 gd->down_throttle : gd->up_throttle))
+		return false;
+
+	/* avoid race with cpufreq_sched_stop */
+	if (!down_read_trylock(&policy->rwsem))
+		return false;
+
+	raw_spin_lock(&gd->fast_lock);
+	if (cpufreq_driver_fast_switch(policy, freq)) {
+		gd->up_throttle = ktime_add_ns(now, gd->up_throttle_nsec);
+		gd->down_throttle = ktime_add_ns(now, gd->down_throttle_nsec);
+		gd->nr_fast++;
+		done = true;
+	}
+	raw_spin_unlock(&gd->fast_lock);
+	up_read(&policy->rwsem);
+
+	return done;
+}
+
 static bool finish_last_request(struct gov_data *gd, unsigned int cur_freq)
 {
 	ktime_t now = ktime_get();
@@ -214,6 +257,9 @@ static void update_fdomain_capacity_request(int cpu)
 
 	gd->requested_freq = freq_new;
 
+	if (gd->fast_switch && cpufreq_sched_fast_switch(policy, freq_new))
+		goto out;
+
 	/*
 	 * Throttling is not yet supported on platforms with fast cpufreq
 	 * drivers.
@@ -286,6 +332,8 @@ static int cpufreq_sched_policy_init(struct cpufreq_policy *policy)
 			    policy->cpuinfo.transition_latency :
 			    THROTTLE_UP_NSEC;
 	gd->down_throttle_nsec = THROTTLE_DOWN_NSEC;
+	gd->fast_switch = cpufreq_driver_has_fast_switch();
+	raw_spin_lock_init(&gd->fast_lock);
 	pr_debug("%s: throttle threshold = %u [ns]\n",
 		  __func__, gd->up_throttle_nsec);
 
@@ -432,6 +480,16 @@ static ssize_t store_down_throttle_nsec(struct gov_data *gd,
 	return count;
 }
 
+static ssize_t show_fast_switches(struct gov_data *gd, char *buf)
+{
+	return sprintf(buf, "%lu\n", gd->nr_fast);
+}
+
+static ssize_t show_slow_switches(struct gov_data *gd, char *buf)
+{
+	return sprintf(buf, "%lu\n", gd->nr_slow);
+}
+
 /*
  * Create show/store routines
  * - sys: One governor instance for complete SYSTEM
@@ -463,13 +521,23 @@ static ssize_t store_##file_name##_gov_pol				\
 	store_gov_pol_sys(file_name); \
 	gov_pol_attr_rw(file_name)
 
+#define gov_pol_attr_ro(_name)						\
+	static struct freq_attr _name##_gov_pol =				\
+	__ATTR(_name, 0444, show_##_name##_gov_pol, NULL)
+
 tunable_handlers(down_throttle_nsec);
 tunable_handlers(up_throttle_nsec);
+show_gov_pol_sys(fast_switches);
+gov_pol_attr_ro(fast_switches);
+show_gov_pol_sys(slow_switches);
+gov_pol_attr_ro(slow_switches);
 
 /* Per policy governor instance */
 static struct attribute *sched_attributes_gov_pol[] = {
 	&up_throttle_nsec_gov_pol.attr,
 	&down_throttle_nsec_gov_pol.attr,
+	&fast_switches_gov_pol.attr,
+	&slow_switches_gov_pol.attr,
 	NULL,
 };
 
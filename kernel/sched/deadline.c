@@ -61,6 +61,141 @@ static void clear_average_bw(struct sched_dl_entity *dl_se, struct dl_rq *dl_rq)
 	}
 }
 
+/*
+ * The active utilization of a cpu is the capacity it has to provide for
+ * all the reservations on it to be met, ask cpufreq for at least that.
+ * Bandwidths are in 1 << 20 units.
+ */
+static void dl_update_capacity_req(struct rq *rq)
+{
+	u64 capacity;
+
+	if (!sched_freq())
+		return;
+
+	capacity = rq->dl.running_bw >> (20 - SCHED_CAPACITY_SHIFT);
+	set_dl_cpu_capacity(cpu_of(rq),
+			    true, min_t(u64, capacity, SCHED_CAPACITY_SCALE));
+}
+
+static void add_running_bw(struct sched_dl_entity *dl_se, struct rq *rq)
+{
+	if (dl_se->dl_active_bw)
+		return;
+
+	dl_se->dl_active_bw = dl_se->dl_bw;
+	rq->dl.running_bw += dl_se->dl_active_bw;
+	dl_update_capacity_req(rq);
+}
+
+static void sub_running_bw(struct sched_dl_entity *dl_se, struct rq *rq)
+{
+	if (!dl_se->dl_active_bw)
+		return;
+
+	if (WARN_ON(rq->dl.running_bw < dl_se->dl_active_bw))
+		rq->dl.running_bw = 0;
+	else
+		rq->dl.running_bw -= dl_se->dl_active_bw;
+	dl_se->dl_active_bw = 0;
+	dl_update_capacity_req(rq);
+}
+
+/*
+ * A blocked task stops contending for its rq, but it keeps its bandwidth
+ * in the active utilization until its 0-lag time: up to then, it could
+ * wake up and use the runtime left within its current deadline.
+ */
+static void task_non_contending(struct task_struct *p, struct rq *rq)
+{
+	struct sched_dl_entity *dl_se = &p->dl;
+	struct hrtimer *timer = &dl_se->inactive_timer;
+	s64 zerolag_time;
+
+	if (!dl_se->dl_active_bw || dl_se->dl_non_contending)
+		return;
+
+	if (!dl_se->dl_runtime) {
+		sub_running_bw(dl_se, rq);
+		return;
+	}
+
+	zerolag_time = dl_se->deadline -
+		div64_long(dl_se->runtime * (s64)dl_se->dl_period,
+			   dl_se->dl_runtime);
+	zerolag_time -= rq_clock(rq);
+
+	/* A still running callback can't be restarted, release it now */
+	if (zerolag_time < 0 || hrtimer_active(timer)) {
+		sub_running_bw(dl_se, rq);
+		return;
+	}
+
+	dl_se->dl_non_contending = 1;
+	get_task_struct(p);
+	hrtimer_start(timer, ns_to_ktime(zerolag_time), HRTIMER_MODE_REL);
+}
+
+static void cancel_inactive_timer(struct sched_dl_entity *dl_se)
+{
+	if (!dl_se->dl_non_contending)
+		return;
+
+	/* A running callback sees !dl_non_contending and drops its ref */
+	dl_se->dl_non_contending = 0;
+	if (hrtimer_try_to_cancel(&dl_se->inactive_timer) == 1)
+		put_task_struct(dl_task_of(dl_se));
+}
+
+static void task_contending(struct sched_dl_entity *dl_se, struct rq *rq)
+{
+	cancel_inactive_timer(dl_se);
+	add_running_bw(dl_se, rq);
+}
+
+/*
+ * Remove the bandwidth of a task leaving @rq while blocked, by a wakeup
+ * on another cpu or by leaving SCHED_DEADLINE.
+ */
+static void task_release_bw(struct task_struct *p, struct rq *rq)
+{
+	cancel_inactive_timer(&p->dl);
+	sub_running_bw(&p->dl, rq);
+}
+
+static enum hrtimer_restart inactive_task_timer(struct hrtimer *timer)
+{
+	struct sched_dl_entity *dl_se = container_of(timer,
+						     struct sched_dl_entity,
+						     inactive_timer);
+	struct task_struct *p = dl_task_of(dl_se);
+	unsigned long flags;
+	struct rq *rq;
+
+	rq = task_rq_lock(p, &flags);
+
+	/* Woken up, migrated or switched out since the timer was set */
+	if (dl_se->dl_non_contending) {
+		dl_se->dl_non_contending = 0;
+		sub_running_bw(dl_se, rq);
+	}
+
+	task_rq_unlock(rq, p, &flags);
+	put_task_struct(p);
+
+	return HRTIMER_NORESTART;
+}
+
+/* For the interactive governor, the active utilization of @cpu */
+unsigned long sched_dl_cpu_util(int cpu)
+{
+	u64 running_bw = READ_ONCE(cpu_rq(cpu)->dl.running_bw);
+
+	return min_t(u64, running_bw >> (20 - SCHED_CAPACITY_SHIFT),
+		     SCHED_CAPACITY_SCALE);
+}
+EXPORT_SYMBOL_GPL(sched_dl_cpu_util);
+
 static inline int is_leftmost(struct task_struct *p, struct dl_rq *dl_rq)
 {
 	struct sched_dl_entity *dl_se = &p->dl;
@@ -694,6 +829,15 @@ void init_dl_task_timer(struct sched_dl_entity *dl_se)
 
 	hrtimer_init(timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
 	timer->function = dl_task_timer;
+
+	timer = &dl_se->inactive_timer;
+	hrtimer_init(timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	timer->function = inactive_task_timer;
+
+	dl_se->dl_non_contending = 0;
+	dl_se->dl_active_bw = 0;
+	dl_se->dl_missed = 0;
+	dl_se->dl_nr_missed = 0;
 }
 
 static
@@ -704,6 +848,25 @@ int dl_runtime_exceeded(struct rq *rq, struct sched_dl_entity *dl_se)
 
 extern bool sched_rt_bandwidth_account(struct rt_rq *rt_rq);
 
+/*
+ * The current instance of @dl_se ran out of runtime, or past its
+ * deadline, before completing; count each deadline once. Yielding ends
+ * an instance on purpose, and a boosted task runs on borrowed parameters.
+ */
+static void dl_check_deadline_miss(struct rq *rq, struct sched_dl_entity *dl_se)
+{
+	if (dl_se->dl_yielded || dl_se->dl_boosted ||
+	    dl_se->dl_missed == dl_se->deadline)
+		return;
+
+	if (!dl_runtime_exceeded(rq, dl_se) &&
+	    !dl_time_before(dl_se->deadline, rq_clock(rq)))
+		return;
+
+	dl_se->dl_missed = dl_se->deadline;
+	dl_se->dl_nr_missed++;
+}
+
 /*
  * Update the current task's runtime statistics (provided it is still
  * a -deadline task and has not been removed from the dl_rq).
@@ -739,6 +902,7 @@ static void update_curr_dl(struct rq *rq)
 	cpuacct_charge(curr, delta_exec);
 
 	dl_se->runtime -= dl_se->dl_yielded ? 0 : delta_exec;
+	dl_check_deadline_miss(rq, dl_se);
 	if (dl_runtime_exceeded(rq, dl_se)) {
 		dl_se->dl_throttled = 1;
 		__dequeue_task_dl(rq, curr, 0);
@@ -973,6 +1137,8 @@ static void enqueue_task_dl(struct rq *rq, struct task_struct *p, int flags)
 		return;
 	}
 
+	task_contending(&p->dl, rq);
+
 	/*
 	 * If p is throttled, we do nothing. In fact, if it exhausted
 	 * its budget it needs a replenishment and, since it now is on
@@ -998,6 +1164,12 @@ static void dequeue_task_dl(struct rq *rq, struct task_struct *p, int flags)
 {
 	update_curr_dl(rq);
 	__dequeue_task_dl(rq, p, flags);
+
+	/* Not blocking, it is requeued here or on another rq */
+	if (flags & DEQUEUE_SLEEP)
+		task_non_contending(p, rq);
+	else
+		sub_running_bw(&p->dl, rq);
 }
 
 /*
@@ -1038,6 +1210,23 @@ static void yield_task_dl(struct rq *rq)
 
 static int find_later_rq(struct task_struct *task);
 
+/*
+ * A blocked task's bandwidth is carried to the new rq by its wakeup, a
+ * queued one's by the dequeue and enqueue around set_task_cpu().
+ */
+static void migrate_task_rq_dl(struct task_struct *p, int next_cpu)
+{
+	struct rq *rq;
+
+	if (p->on_rq || !p->dl.dl_active_bw)
+		return;
+
+	rq = task_rq(p);
+	raw_spin_lock(&rq->lock);
+	task_release_bw(p, rq);
+	raw_spin_unlock(&rq->lock);
+}
+
 static int
 select_task_rq_dl(struct task_struct *p, int cpu, int sd_flag, int flags)
 {
@@ -1737,6 +1926,8 @@ static void switched_from_dl(struct rq *rq, struct task_struct *p)
 	 * SCHED_DEADLINE until the deadline passes, the timer will reset the
 	 * task.
 	 */
+	task_release_bw(p, rq);
+
 	if (!start_dl_timer(p))
 		__dl_clear_params(p);
 
@@ -1829,6 +2020,7 @@ const struct sched_class dl_sched_class = {
 
 #ifdef CONFIG_SMP
 	.select_task_rq		= select_task_rq_dl,
+	.migrate_task_rq	= migrate_task_rq_dl,
 	.set_cpus_allowed       = set_cpus_allowed_dl,
 	.rq_online              = rq_online_dl,
 	.rq_offline             = rq_offline_dl,
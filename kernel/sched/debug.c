@@ -295,6 +295,7 @@ void print_dl_rq(struct seq_file *m, int cpu, struct dl_rq *dl_rq)
 {
 	SEQ_printf(m, "\ndl_rq[%d]:\n", cpu);
 	SEQ_printf(m, "  .%-30s: %ld\n", "dl_nr_running", dl_rq->dl_nr_running);
+	SEQ_printf(m, "  .%-30s: %Lu\n", "running_bw", dl_rq->running_bw);
 }
 
 extern __read_mostly int sched_clock_running;
@@ -685,6 +686,8 @@ void proc_sched_show_task(struct task_struct *p, struct seq_file *m)
 #endif
 	P(policy);
 	P(prio);
+	if (task_has_dl_policy(p))
+		P(dl.dl_nr_missed);
 #undef PN
 #undef __PN
 #undef P
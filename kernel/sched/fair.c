@@ -5395,7 +5395,8 @@ static inline unsigned long task_util(struct task_struct *p)
 {
 #ifdef CONFIG_SCHED_WALT
 	if (!walt_disabled && sysctl_sched_use_walt_task_util) {
-		unsigned long demand = p->ravg.demand;
+		unsigned long demand = sysctl_sched_walt_pred_demand ?
+			p->ravg.pred_demand : p->ravg.demand;
 		return (demand << 10) / walt_ravg_window;
 	}
 #endif
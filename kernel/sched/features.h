@@ -83,6 +83,13 @@ SCHED_FEAT(ATTACH_AGE_LOAD, true)
  */
 SCHED_FEAT(ENERGY_AWARE, false)
 
+/*
+ * Place waking RT tasks by cluster on big.LITTLE: the task's preferred
+ * cluster first, away from cpus running top-app tasks, on the cpu with
+ * the highest capacity at its current frequency.
+ */
+SCHED_FEAT(RT_CLUSTER_AWARE, true)
+
 /*
  * Apply the automatic NUMA scheduling policy. Enabled automatically
  * at runtime if running on a NUMA machine. Can be controlled via
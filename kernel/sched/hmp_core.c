@@ -815,6 +815,7 @@ static void enqueue_task(struct rq *rq, struct task_struct *p, int flags)
 {
 	update_rq_clock(rq);
 	sched_info_queued(rq, p);
+	psi_enqueue(p, flags & ENQUEUE_WAKEUP);
 	p->sched_class->enqueue_task(rq, p, flags);
 }
 
@@ -822,6 +823,7 @@ static void dequeue_task(struct rq *rq, struct task_struct *p, int flags)
 {
 	update_rq_clock(rq);
 	sched_info_dequeued(rq, p);
+	psi_dequeue(p, flags & DEQUEUE_SLEEP);
 	p->sched_class->dequeue_task(rq, p, flags);
 }
 
@@ -1308,6 +1310,48 @@ EXPORT_SYMBOL_GPL(kick_process);
 #endif /* CONFIG_SMP */
 
 #ifdef CONFIG_SMP
+#ifdef CONFIG_SCHED_CORE_CTL
+/*
+ * Isolated cpus stay online but get no new work: wakeups, load balancing
+ * and HMP migrations skip them. Only tasks bound to them still run there.
+ */
+struct cpumask sched_isolated_cpus;
+EXPORT_SYMBOL_GPL(sched_isolated_cpus);
+
+static DEFINE_MUTEX(sched_isolation_mutex);
+
+/*
+ * Find a cpu for @p to run on instead of the isolated @cpu: the least
+ * loaded allowed one, preferring the cluster of @cpu on a tie. Returns
+ * @cpu if @p may run nowhere else.
+ */
+static int sched_isolation_fallback(struct task_struct *p, int cpu)
+{
+	const struct cpumask *cluster = topology_core_cpumask(cpu);
+	unsigned int best_score = UINT_MAX;
+	int i, best = cpu;
+
+	for_each_cpu_and(i, tsk_cpus_allowed(p), cpu_active_mask) {
+		unsigned int score;
+
+		if (cpu_isolated(i))
+			continue;
+
+		score = cpu_rq(i)->nr_running * 2;
+		if (!cpumask_test_cpu(i, cluster))
+			score++;
+		if (score < best_score) {
+			best = i;
+			best_score = score;
+			if (!score)
+				break;
+		}
+	}
+
+	return best;
+}
+#endif
+
 /*
  * ->cpus_allowed is protected by both rq->lock and p->pi_lock
  */
@@ -1332,6 +1376,9 @@ static int select_fallback_rq(int cpu, struct task_struct *p)
 				continue;
 			if (!cpu_active(dest_cpu))
 				continue;
+			/* an isolated one only as a last resort, below */
+			if (cpu_isolated(dest_cpu))
+				continue;
 			if (cpumask_test_cpu(dest_cpu, tsk_cpus_allowed(p)))
 				return dest_cpu;
 		}
@@ -1390,6 +1437,11 @@ int select_task_rq(struct task_struct *p, int cpu, int sd_flags, int wake_flags)
 	if (p->nr_cpus_allowed > 1)
 		cpu = p->sched_class->select_task_rq(p, cpu, sd_flags, wake_flags);
 
+#ifdef CONFIG_SCHED_CORE_CTL
+	if (unlikely(cpu_isolated(cpu)))
+		cpu = sched_isolation_fallback(p, cpu);
+#endif
+
 	/*
 	 * In order not to call set_task_cpu() on a blocking task we need
 	 * to rely on ttwu() to place the task on a valid ->cpus_allowed
@@ -1464,6 +1516,186 @@ static void ttwu_activate(struct rq *rq, struct task_struct *p, int en_flags)
 		wq_worker_waking_up(p, cpu_of(rq));
 }
 
+#ifdef CONFIG_SCHED_HMP_STATS
+/*
+ * Always-on log2 histograms of scheduling delays per cpu and sched class,
+ * read from /proc/hmp_schedstat. Bucket n counts the delays below
+ * 2^(n + HMP_HIST_SHIFT) ns, the last bucket everything longer.
+ */
+#define HMP_HIST_VERSION	1
+#define HMP_HIST_SHIFT		10
+#define HMP_HIST_BUCKETS	16
+
+enum {
+	HMP_HIST_FAIR,
+	HMP_HIST_RT,
+	HMP_HIST_DL,
+	HMP_HIST_NR_CLASSES,
+};
+
+static const char * const hmp_hist_class_names[HMP_HIST_NR_CLASSES] = {
+	"fair", "rt", "dl",
+};
+
+struct hmp_sched_hist {
+	/* woken -> running */
+	u64 wakeup[HMP_HIST_NR_CLASSES][HMP_HIST_BUCKETS];
+	/* runnable -> running, after a wakeup or a preemption */
+	u64 wait[HMP_HIST_NR_CLASSES][HMP_HIST_BUCKETS];
+	/* runnable -> running on a cpu of another hmp domain */
+	u64 migrate[HMP_HIST_NR_CLASSES][HMP_HIST_BUCKETS];
+	u64 nr_up[HMP_HIST_NR_CLASSES];
+	u64 nr_down[HMP_HIST_NR_CLASSES];
+};
+
+/* only written by the owning cpu, under its rq->lock */
+static DEFINE_PER_CPU(struct hmp_sched_hist, hmp_sched_hist);
+
+static int hmp_hist_class(struct task_struct *p)
+{
+	if (p->sched_class == &fair_sched_class)
+		return HMP_HIST_FAIR;
+	if (p->sched_class == &rt_sched_class)
+		return HMP_HIST_RT;
+	if (p->sched_class == &dl_sched_class)
+		return HMP_HIST_DL;
+	return -1;
+}
+
+static inline void hmp_hist_add(u64 *hist, u64 delta)
+{
+	int n = fls64(delta >> HMP_HIST_SHIFT);
+
+	hist[min(n, HMP_HIST_BUCKETS - 1)]++;
+}
+
+/*
+ * @p became runnable on @rq without running. A stamp left from an earlier
+ * preemption is kept, the task has been waiting since then.
+ */
+static inline void hmp_hist_queued(struct rq *rq, struct task_struct *p,
+				   bool woken)
+{
+	if (task_running(rq, p) || p->hmp_hist_queued)
+		return;
+
+	p->hmp_hist_queued = rq_clock(rq);
+	p->hmp_hist_woken = woken;
+}
+
+/*
+ * @next is about to replace @prev on @rq. Migrations are counted when a
+ * task first runs on a cpu of another hmp domain than the one it last
+ * ran on, with the time it spent runnable in between as their cost.
+ */
+static void hmp_hist_switch(struct rq *rq, struct task_struct *prev,
+			    struct task_struct *next)
+{
+	struct hmp_sched_hist *hist = this_cpu_ptr(&hmp_sched_hist);
+	int cpu = cpu_of(rq);
+	int class, from, to;
+	s64 delta;
+
+	if (task_on_rq_queued(prev)) {
+		prev->hmp_hist_queued = rq_clock(rq);
+		prev->hmp_hist_woken = false;
+	}
+
+	class = hmp_hist_class(next);
+	if (class < 0 || !next->hmp_hist_queued)
+		goto out;
+
+	delta = max_t(s64, rq_clock(rq) - next->hmp_hist_queued, 0);
+	if (next->hmp_hist_woken)
+		hmp_hist_add(hist->wakeup[class], delta);
+	hmp_hist_add(hist->wait[class], delta);
+
+	if (next->hmp_hist_cpu >= 0 && next->hmp_hist_cpu != cpu) {
+		from = hmp_cpu_domain_index(next->hmp_hist_cpu);
+		to = hmp_cpu_domain_index(cpu);
+		if (from >= 0 && to >= 0 && from != to) {
+			hmp_hist_add(hist->migrate[class], delta);
+			if (to < from)
+				hist->nr_up[class]++;
+			else
+				hist->nr_down[class]++;
+		}
+	}
+out:
+	next->hmp_hist_queued = 0;
+	next->hmp_hist_cpu = cpu;
+}
+
+static void hmp_hist_print(struct seq_file *m, const char *name, u64 *hist)
+{
+	int n;
+
+	seq_printf(m, " %s", name);
+	for (n = 0; n < HMP_HIST_BUCKETS; n++)
+		seq_printf(m, " %llu", hist[n]);
+}
+
+/*
+ * One line per cpu and class:
+ * cpu<N> <hmp domain, 0 is the fastest> <class> up <n> down <n>
+ *	wakeup <buckets> wait <buckets> migrate <buckets>
+ */
+static int hmp_hist_show(struct seq_file *m, void *v)
+{
+	struct hmp_sched_hist *hist;
+	int cpu, class;
+
+	seq_printf(m, "version %d\n", HMP_HIST_VERSION);
+	seq_printf(m, "buckets %d shift %d\n",
+		   HMP_HIST_BUCKETS, HMP_HIST_SHIFT);
+
+	for_each_possible_cpu(cpu) {
+		hist = &per_cpu(hmp_sched_hist, cpu);
+		for (class = 0; class < HMP_HIST_NR_CLASSES; class++) {
+			seq_printf(m, "cpu%d %d %s up %llu down %llu", cpu,
+				   hmp_cpu_domain_index(cpu),
+				   hmp_hist_class_names[class],
+				   hist->nr_up[class], hist->nr_down[class]);
+			hmp_hist_print(m, "wakeup", hist->wakeup[class]);
+			hmp_hist_print(m, "wait", hist->wait[class]);
+			hmp_hist_print(m, "migrate", hist->migrate[class]);
+			seq_putc(m, '\n');
+		}
+	}
+
+	return 0;
+}
+
+static int hmp_hist_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, hmp_hist_show, NULL);
+}
+
+static const struct file_operations hmp_hist_fops = {
+	.open    = hmp_hist_open,
+	.read    = seq_read,
+	.llseek  = seq_lseek,
+	.release = single_release,
+};
+
+static int __init hmp_hist_init(void)
+{
+	proc_create("hmp_schedstat", 0444, NULL, &hmp_hist_fops);
+	return 0;
+}
+late_initcall(hmp_hist_init);
+#else
+static inline void hmp_hist_queued(struct rq *rq, struct task_struct *p,
+				   bool woken)
+{
+}
+
+static inline void hmp_hist_switch(struct rq *rq, struct task_struct *prev,
+				   struct task_struct *next)
+{
+}
+#endif /* CONFIG_SCHED_HMP_STATS */
+
 /*
  * Mark the task runnable and perform wakeup-preemption.
  */
@@ -1472,6 +1704,7 @@ ttwu_do_wakeup(struct rq *rq, struct task_struct *p, int wake_flags)
 {
 	check_preempt_curr(rq, p, wake_flags);
 	trace_sched_wakeup(p, true);
+	hmp_hist_queued(rq, p, true);
 
 	p->state = TASK_RUNNING;
 #ifdef CONFIG_SMP
@@ -1733,6 +1966,7 @@ try_to_wake_up(struct task_struct *p, unsigned int state, int wake_flags)
 	cpu = select_task_rq(p, p->wake_cpu, SD_BALANCE_WAKE, wake_flags);
 	if (task_cpu(p) != cpu) {
 		wake_flags |= WF_MIGRATED;
+		psi_ttwu_dequeue(p);
 		set_task_cpu(p, cpu);
 	}
 #endif /* CONFIG_SMP */
@@ -1833,6 +2067,10 @@ void __dl_clear_params(struct task_struct *p)
 static void __sched_fork(unsigned long clone_flags, struct task_struct *p)
 {
 	p->on_rq			= 0;
+#ifdef CONFIG_PSI
+	p->psi_flags			= 0;
+	p->sched_psi_wake_requeue	= 0;
+#endif
 
 	p->se.on_rq			= 0;
 	p->se.exec_start		= 0;
@@ -1855,6 +2093,18 @@ static void __sched_fork(unsigned long clone_flags, struct task_struct *p)
 
 	INIT_LIST_HEAD(&p->rt.run_list);
 
+#ifdef CONFIG_SCHED_HMP_RTG
+	/* groups are not inherited */
+	p->hmp_rtg = NULL;
+	INIT_LIST_HEAD(&p->hmp_rtg_node);
+#endif
+
+#ifdef CONFIG_SCHED_HMP_STATS
+	p->hmp_hist_queued = 0;
+	p->hmp_hist_cpu = -1;
+	p->hmp_hist_woken = false;
+#endif
+
 #ifdef CONFIG_PREEMPT_NOTIFIERS
 	INIT_HLIST_HEAD(&p->preempt_notifiers);
 #endif
@@ -2132,6 +2382,7 @@ void wake_up_new_task(struct task_struct *p)
 	activate_task(rq, p, 0);
 	p->on_rq = TASK_ON_RQ_QUEUED;
 	trace_sched_wakeup_new(p, true);
+	hmp_hist_queued(rq, p, false);
 	check_preempt_curr(rq, p, WF_FORK);
 #ifdef CONFIG_SMP
 	if (p->sched_class->task_woken)
@@ -2274,6 +2525,8 @@ static struct rq *finish_task_switch(struct task_struct *prev)
 		if (prev->sched_class->task_dead)
 			prev->sched_class->task_dead(prev);
 
+		hmp_rtg_task_dead(prev);
+
 		/*
 		 * Remove function-return probe instances associated with this
 		 * task and put them back on the free list.
@@ -2853,6 +3106,7 @@ static void __sched __schedule(void)
 	rq->clock_skip_update = 0;
 
 	if (likely(prev != next)) {
+		hmp_hist_switch(rq, prev, next);
 		rq->nr_switches++;
 		rq->curr = next;
 		++*switch_count;
@@ -5009,6 +5263,100 @@ static int migration_cpu_stop(void *data)
 	return 0;
 }
 
+#ifdef CONFIG_SCHED_CORE_CTL
+/*
+ * Runs on the cpu being isolated and moves its queued fair tasks away.
+ * The ones that may not run elsewhere stay, RT tasks leave on their
+ * next wakeup.
+ */
+static int sched_isolate_cpu_stop(void *data)
+{
+	int cpu = raw_smp_processor_id();
+	struct rq *rq = cpu_rq(cpu);
+	struct task_struct *p;
+	int dest_cpu;
+
+	local_irq_disable();
+	sched_ttwu_pending();
+	raw_spin_lock(&rq->lock);
+again:
+	list_for_each_entry(p, &rq->cfs_tasks, se.group_node) {
+		dest_cpu = sched_isolation_fallback(p, cpu);
+		if (dest_cpu == cpu)
+			continue;
+
+		/* move_queued_task() drops our lock, rescan the list */
+		rq = move_queued_task(p, dest_cpu);
+		raw_spin_unlock(&rq->lock);
+		rq = cpu_rq(cpu);
+		raw_spin_lock(&rq->lock);
+		goto again;
+	}
+	raw_spin_unlock(&rq->lock);
+	local_irq_enable();
+
+	return 0;
+}
+
+/*
+ * Isolate @cpu from the scheduler. A wakeup racing with this may still
+ * queue a task there; it leaves on its next wakeup. At least one online
+ * cpu always stays unisolated.
+ */
+int sched_isolate_cpu(int cpu)
+{
+	struct cpumask avail;
+	int ret = 0;
+
+	mutex_lock(&sched_isolation_mutex);
+	get_online_cpus();
+
+	if (!cpu_online(cpu)) {
+		ret = -EINVAL;
+		goto out;
+	}
+	if (cpu_isolated(cpu))
+		goto out;
+
+	cpumask_andnot(&avail, cpu_online_mask, &sched_isolated_cpus);
+	if (cpumask_weight(&avail) <= 1) {
+		ret = -EBUSY;
+		goto out;
+	}
+
+	cpumask_set_cpu(cpu, &sched_isolated_cpus);
+	stop_one_cpu(cpu, sched_isolate_cpu_stop, NULL);
+out:
+	put_online_cpus();
+	mutex_unlock(&sched_isolation_mutex);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(sched_isolate_cpu);
+
+int sched_unisolate_cpu(int cpu)
+{
+	mutex_lock(&sched_isolation_mutex);
+	if (cpu_isolated(cpu)) {
+		cpumask_clear_cpu(cpu, &sched_isolated_cpus);
+		/* let it pull work through idle balance right away */
+		if (cpu_online(cpu))
+			resched_cpu(cpu);
+	}
+	mutex_unlock(&sched_isolation_mutex);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(sched_unisolate_cpu);
+
+/* Recent runnable demand of @cpu, the HMP load ratio in 1024ths */
+unsigned int sched_cpu_demand(int cpu)
+{
+	return cpu_rq(cpu)->avg.load_avg_ratio;
+}
+EXPORT_SYMBOL_GPL(sched_cpu_demand);
+#endif /* CONFIG_SCHED_CORE_CTL */
+
 #ifdef CONFIG_HOTPLUG_CPU
 
 /*
@@ -7343,6 +7691,8 @@ void __init sched_init(void)
 #endif
 	init_sched_fair_class();
 
+	psi_init();
+
 	scheduler_running = 1;
 }
 
@@ -34,6 +34,7 @@
 #include <trace/events/sched.h>
 #include <linux/sysfs.h>
 #include <linux/vmalloc.h>
+#include <linux/sched_energy.h>
 #ifdef CONFIG_HMP_FREQUENCY_INVARIANT_SCALE
 /* Include cpufreq header to add a notifier so that cpu frequency
  * scaling can track the current CPU frequency
@@ -45,6 +46,7 @@
 #endif
 
 #include "sched.h"
+#include "tune.h"
 
 #ifdef CONFIG_ARCH_HISI
 /* Add apportunity to config how to placement the task
@@ -4975,6 +4977,135 @@ unsigned int hmp_packing_enabled = 1;
 unsigned int hmp_full_threshold = 650;
 #endif
 
+#ifdef CONFIG_SCHED_HMP_RTG
+/*
+ * Render task groups: the threads of one frame pipeline (UI thread,
+ * RenderThread, SurfaceFlinger composition) registered by userspace.
+ * Each member alone may stay below hmp_up_threshold while the frame
+ * needs all of them, and migrating them one by one leaves some of the
+ * pipeline on a little core. The summed load of the members decides for
+ * all of them instead: above hmp_up_threshold the group goes up, and it
+ * only comes down once the sum drops below hmp_down_threshold.
+ */
+#define HMP_RTG_NR		4
+#define HMP_RTG_MAX_TASKS	8
+
+struct hmp_rtg {
+	struct list_head tasks;
+	int nr_tasks;
+	int on_big;
+};
+
+static struct hmp_rtg hmp_rtgs[HMP_RTG_NR];
+/* group membership and on_big of all groups */
+static DEFINE_RAW_SPINLOCK(hmp_rtg_lock);
+
+static unsigned int hmp_rtg_demand(struct hmp_rtg *grp)
+{
+	struct task_struct *t;
+	unsigned int demand = 0;
+
+	list_for_each_entry(t, &grp->tasks, hmp_rtg_node)
+		demand += t->se.avg.load_avg_ratio;
+	return demand;
+}
+
+/* Should @se, a member of a busy render group, be on the fastest cpus? */
+static int hmp_rtg_wants_big(struct sched_entity *se)
+{
+	struct hmp_rtg *grp;
+	unsigned long flags;
+	unsigned int demand;
+	int on_big = 0;
+
+	if (!entity_is_task(se) || !READ_ONCE(task_of(se)->hmp_rtg))
+		return 0;
+
+	raw_spin_lock_irqsave(&hmp_rtg_lock, flags);
+	grp = task_of(se)->hmp_rtg;
+	if (grp) {
+		demand = hmp_rtg_demand(grp);
+		if (demand >= hmp_up_threshold)
+			grp->on_big = 1;
+		else if (demand < hmp_down_threshold)
+			grp->on_big = 0;
+		on_big = grp->on_big;
+	}
+	raw_spin_unlock_irqrestore(&hmp_rtg_lock, flags);
+
+	return on_big;
+}
+
+static void __hmp_rtg_leave(struct task_struct *p)
+{
+	if (!p->hmp_rtg)
+		return;
+	list_del_init(&p->hmp_rtg_node);
+	p->hmp_rtg->nr_tasks--;
+	WRITE_ONCE(p->hmp_rtg, NULL);
+}
+
+void hmp_rtg_task_dead(struct task_struct *p)
+{
+	unsigned long flags;
+
+	if (!READ_ONCE(p->hmp_rtg))
+		return;
+
+	raw_spin_lock_irqsave(&hmp_rtg_lock, flags);
+	__hmp_rtg_leave(p);
+	raw_spin_unlock_irqrestore(&hmp_rtg_lock, flags);
+}
+
+/* Move @pid to group @id, 1..HMP_RTG_NR, or out of its group for 0 */
+static int hmp_rtg_join(int id, pid_t pid)
+{
+	struct task_struct *p;
+	struct hmp_rtg *grp = NULL;
+	unsigned long flags;
+	int ret = 0;
+
+	if (id < 0 || id > HMP_RTG_NR)
+		return -EINVAL;
+	if (id)
+		grp = &hmp_rtgs[id - 1];
+
+	rcu_read_lock();
+	p = find_task_by_vpid(pid);
+	if (p)
+		get_task_struct(p);
+	rcu_read_unlock();
+	if (!p)
+		return -ESRCH;
+
+	raw_spin_lock_irqsave(&hmp_rtg_lock, flags);
+	/* hmp_rtg_task_dead() only runs after PF_EXITING was set */
+	if (grp && (p->flags & PF_EXITING)) {
+		ret = -ESRCH;
+	} else if (p->hmp_rtg != grp) {
+		if (grp && grp->nr_tasks >= HMP_RTG_MAX_TASKS) {
+			ret = -ENOSPC;
+		} else {
+			__hmp_rtg_leave(p);
+			if (grp) {
+				list_add(&p->hmp_rtg_node, &grp->tasks);
+				grp->nr_tasks++;
+				WRITE_ONCE(p->hmp_rtg, grp);
+			}
+		}
+	}
+	raw_spin_unlock_irqrestore(&hmp_rtg_lock, flags);
+
+	put_task_struct(p);
+	return ret;
+}
+#else
+static inline int hmp_rtg_wants_big(struct sched_entity *se)
+{
+	return 0;
+}
+#endif
+
 static unsigned int hmp_up_migration(int cpu, int *target_cpu, struct sched_entity *se);
 static unsigned int hmp_down_migration(int cpu, struct sched_entity *se);
 static inline unsigned int hmp_domain_min_load(struct hmp_domain *hmpd,
@@ -5003,6 +5134,28 @@ static inline unsigned int hmp_cpu_is_slowest(int cpu)
 	return list_is_last(pos, &hmp_domains);
 }
 
+/*
+ * Position of the hmp_domain of cpu, 0 being the fastest, -1 before the
+ * domains are set up. For users outside of this file, which only see an
+ * empty hmp_domains list.
+ */
+int hmp_cpu_domain_index(int cpu)
+{
+	struct hmp_domain *domain;
+	int index = 0;
+
+	if (!hmp_cpu_domain(cpu))
+		return -1;
+
+	list_for_each_entry(domain, &hmp_domains, hmp_domains) {
+		if (domain == hmp_cpu_domain(cpu))
+			return index;
+		index++;
+	}
+
+	return -1;
+}
+
 /* Next (slower) hmp_domain relative to cpu */
 static inline struct hmp_domain *hmp_slower_domain(int cpu)
 {
@@ -5366,6 +5519,70 @@ int get_hmp_boost(void)
 }
 #endif
 
+#ifdef CONFIG_SCHED_HMP_RTG
+/* "<group> <tid>" with group 1..HMP_RTG_NR, group 0 to leave */
+static ssize_t rtg_join_store(struct kobject *kobj,
+		struct kobj_attribute *attr, const char *buf, size_t count)
+{
+	int id, ret;
+	pid_t pid;
+
+	if (sscanf(buf, "%d %d", &id, &pid) != 2)
+		return -EINVAL;
+	ret = hmp_rtg_join(id, pid);
+	return ret ? ret : count;
+}
+
+static ssize_t rtg_groups_show(struct kobject *kobj,
+		struct kobj_attribute *attr, char *buf)
+{
+	struct task_struct *t;
+	unsigned long flags;
+	ssize_t len = 0;
+	int i;
+
+	raw_spin_lock_irqsave(&hmp_rtg_lock, flags);
+	for (i = 0; i < HMP_RTG_NR; i++) {
+		struct hmp_rtg *grp = &hmp_rtgs[i];
+
+		if (!grp->nr_tasks)
+			continue;
+		len += sprintf(buf + len, "%d: demand %u on_big %d tasks",
+			       i + 1, hmp_rtg_demand(grp), grp->on_big);
+		list_for_each_entry(t, &grp->tasks, hmp_rtg_node)
+			len += sprintf(buf + len, " %d", task_pid_nr(t));
+		len += sprintf(buf + len, "\n");
+	}
+	raw_spin_unlock_irqrestore(&hmp_rtg_lock, flags);
+	return len;
+}
+
+static struct kobj_attribute rtg_join_attr = __ATTR_WO(rtg_join);
+static struct kobj_attribute rtg_groups_attr = __ATTR_RO(rtg_groups);
+
+static struct attribute *hmp_rtg_attrs[] = {
+	&rtg_join_attr.attr,
+	&rtg_groups_attr.attr,
+	NULL,
+};
+
+/* merged into /sys/kernel/hmp, its attribute table is full */
+static struct attribute_group hmp_rtg_attr_group = {
+	.name = "hmp",
+	.attrs = hmp_rtg_attrs,
+};
+
+static void hmp_rtg_attr_init(void)
+{
+	int i;
+
+	for (i = 0; i < HMP_RTG_NR; i++)
+		INIT_LIST_HEAD(&hmp_rtgs[i].tasks);
+	if (sysfs_merge_group(kernel_kobj, &hmp_rtg_attr_group))
+		pr_err("hmp: failed to create render task group attributes\n");
+}
+#endif
+
 static void hmp_attr_add(
 	const char *name,
 	int *value,
@@ -5552,6 +5769,10 @@ static int hmp_attr_init(void)
 	hmp_data.attr_group.attrs = hmp_data.attributes;
 	ret = sysfs_create_group(kernel_kobj,
 		&hmp_data.attr_group);
+#ifdef CONFIG_SCHED_HMP_RTG
+	if (!ret)
+		hmp_rtg_attr_init();
+#endif
 	return 0;
 }
 late_initcall(hmp_attr_init);
@@ -5588,6 +5809,9 @@ static inline unsigned int hmp_domain_min_load(struct hmp_domain *hmpd,
 	 * right HMP domain
 	 */
 	cpumask_and(&temp_cpumask, &hmpd->cpus, affinity ? affinity : cpu_online_mask);
+#ifdef CONFIG_SCHED_CORE_CTL
+	cpumask_andnot(&temp_cpumask, &temp_cpumask, &sched_isolated_cpus);
+#endif
 
 	for_each_cpu(cpu, &temp_cpumask) {
 		avg = &cpu_rq(cpu)->avg;
@@ -5650,6 +5874,9 @@ static inline unsigned int hmp_offload_down(int cpu, struct sched_entity *se)
 	if (hmp_cpu_is_slowest(cpu))
 		return NR_CPUS;
 
+	if (hmp_rtg_wants_big(se))
+		return NR_CPUS;
+
 	/* Is there an idle CPU in the current domain */
 	min_usage = hmp_domain_min_load(hmp_cpu_domain(cpu), NULL, NULL);
 	if (min_usage == 0) {
@@ -6074,6 +6301,182 @@ static int get_cpu_usage(int cpu)
 	return (usage * capacity) >> SCHED_LOAD_SHIFT;
 }
 
+#ifdef CONFIG_SCHED_HMP
+#ifdef CONFIG_CGROUP_SCHEDTUNE
+static inline int hmp_task_boost(struct task_struct *p)
+{
+	return schedtune_task_boost(p);
+}
+
+static inline int hmp_task_prefer_idle(struct task_struct *p)
+{
+	return schedtune_prefer_idle(p);
+}
+#else
+static inline int hmp_task_boost(struct task_struct *p)
+{
+	return 0;
+}
+
+static inline int hmp_task_prefer_idle(struct task_struct *p)
+{
+	return 0;
+}
+#endif
+
+/*
+ * Wakeup placement of a schedtune boosted (top-app) task: its boost
+ * lowers hmp_up_threshold for this task alone, by boost percent, and
+ * once above that it takes an idle cpu of the fastest domain, its
+ * previous cpu if that one is idle. Without an idle fast cpu the normal
+ * placement runs, which never stacks it on a busy fast cpu either.
+ */
+static int hmp_boosted_wake_cpu(struct task_struct *p, int prev_cpu)
+{
+	struct hmp_domain *fastest;
+	int boost = hmp_task_boost(p);
+	int cpu = NR_CPUS;
+
+	if (boost <= 0)
+		return NR_CPUS;
+	if (p->se.avg.load_avg_ratio <
+	    hmp_up_threshold * (100 - min(boost, 100)) / 100)
+		return NR_CPUS;
+
+	fastest = list_first_entry(&hmp_domains, struct hmp_domain,
+				   hmp_domains);
+	if (cpumask_test_cpu(prev_cpu, &fastest->cpus) &&
+	    cpumask_test_cpu(prev_cpu, tsk_cpus_allowed(p)) &&
+	    idle_cpu(prev_cpu))
+		return prev_cpu;
+
+	if (hmp_domain_min_load(fastest, &cpu, tsk_cpus_allowed(p)) != 0)
+		return NR_CPUS;
+	return cpu;
+}
+
+/*
+ * Energy-aware wakeup placement, from the sched-energy-costs tables in
+ * the device tree (see energy.c): a core level and a cluster level
+ * table for every cpu, with one capacity state per OPP.
+ */
+unsigned int sysctl_sched_hmp_energy_aware = 1;
+
+/* tasks are only placed where they leave 20% headroom */
+#define HMP_ENERGY_FIT_MARGIN	1280
+
+static bool hmp_energy_model(int cpu)
+{
+	const struct sched_group_energy *core = sge_array[cpu][SD_LEVEL0];
+	const struct sched_group_energy *cluster = sge_array[cpu][SD_LEVEL1];
+
+	return core && cluster &&
+		core->nr_cap_states && core->nr_idle_states &&
+		cluster->nr_cap_states && cluster->nr_idle_states;
+}
+
+/*
+ * Estimated energy of the cluster of cpus with util added to dst_cpu:
+ * the cluster runs at the lowest OPP that fits its busiest cpu, cores
+ * are busy for their share of that capacity and WFI otherwise, the
+ * cluster is busy as long as its busiest core.
+ */
+static unsigned long hmp_cluster_energy(const struct cpumask *cpus,
+					int dst_cpu, unsigned long util)
+{
+	int first = cpumask_first(cpus);
+	const struct sched_group_energy *core = sge_array[first][SD_LEVEL0];
+	const struct sched_group_energy *cluster = sge_array[first][SD_LEVEL1];
+	unsigned long max_util = 0, sum_util = 0;
+	unsigned long cpu_util, cap, energy;
+	int cpu, idx, nr = 0;
+
+	for_each_cpu(cpu, cpus) {
+		cpu_util = get_cpu_usage(cpu);
+		if (cpu == dst_cpu)
+			cpu_util += util;
+		max_util = max(max_util, cpu_util);
+		sum_util += cpu_util;
+		nr++;
+	}
+
+	for (idx = 0; idx < core->nr_cap_states - 1; idx++)
+		if (core->cap_states[idx].cap >= max_util)
+			break;
+	cap = core->cap_states[idx].cap;
+	if (!cap)
+		return 0;
+	max_util = min(max_util, cap);
+	sum_util = min(sum_util, nr * cap);
+
+	energy = sum_util * core->cap_states[idx].power +
+		 (nr * cap - sum_util) * core->idle_states[0].power;
+
+	idx = min_t(int, idx, cluster->nr_cap_states - 1);
+	energy += max_util * cluster->cap_states[idx].power +
+		  (cap - max_util) * cluster->idle_states[0].power;
+
+	return energy / cap;
+}
+
+/*
+ * Of the cpus that fit the demand of p with some headroom, the least
+ * utilized of every hmp domain is a candidate, and the candidate that
+ * adds the least energy to its cluster wins. Returns NR_CPUS when there
+ * is no energy model or p fits nowhere, for the threshold based path.
+ */
+static int hmp_energy_wake_cpu(struct task_struct *p, int prev_cpu)
+{
+	unsigned long task_util, util, best_util;
+	long energy, best_energy = LONG_MAX;
+	struct hmp_domain *domain;
+	int best_cpu = NR_CPUS;
+	int cpu, target;
+
+	if (!sysctl_sched_hmp_energy_aware || hmp_task_prefer_idle(p))
+		return NR_CPUS;
+
+	/* running time on prev_cpu, in the capacity of prev_cpu */
+	task_util = (p->se.avg.utilization_avg_contrib *
+		     capacity_orig_of(prev_cpu)) >> SCHED_LOAD_SHIFT;
+
+	list_for_each_entry(domain, &hmp_domains, hmp_domains) {
+		if (cpumask_empty(&domain->cpus))
+			continue;
+		if (!hmp_energy_model(cpumask_first(&domain->cpus)))
+			return NR_CPUS;
+
+		target = NR_CPUS;
+		best_util = ULONG_MAX;
+		for_each_cpu_and(cpu, &domain->cpus, tsk_cpus_allowed(p)) {
+			if (!cpu_online(cpu) || cpu_isolated(cpu))
+				continue;
+			util = get_cpu_usage(cpu) + task_util;
+			if (util * HMP_ENERGY_FIT_MARGIN >
+			    capacity_orig_of(cpu) * SCHED_CAPACITY_SCALE)
+				continue;
+			if (util < best_util ||
+			    (util == best_util && cpu == prev_cpu)) {
+				target = cpu;
+				best_util = util;
+			}
+		}
+		if (target == NR_CPUS)
+			continue;
+
+		energy = (long)hmp_cluster_energy(&domain->cpus, target,
+						  task_util) -
+			 (long)hmp_cluster_energy(&domain->cpus, NR_CPUS, 0);
+		if (energy < best_energy) {
+			best_energy = energy;
+			best_cpu = target;
+		}
+	}
+
+	return best_cpu;
+}
+#endif
+
 /*
  * select_task_rq_fair: Select target runqueue for the waking task in domains
  * that have the 'sd_flag' flag set. In practice, this is SD_BALANCE_WAKE,
@@ -6110,9 +6513,42 @@ select_task_rq_fair(struct task_struct *p, int prev_cpu, int sd_flag, int wake_f
 		/* failed to perform HMP fork balance, use normal balance */
 		new_cpu = cpu;
 	}
+
+	if (sd_flag & SD_BALANCE_WAKE) {
+		new_cpu = hmp_boosted_wake_cpu(p, prev_cpu);
+		if (new_cpu != NR_CPUS) {
+			if (!hmp_cpu_is_fastest(prev_cpu)) {
+				hmp_next_up_delay(&p->se, new_cpu);
+				trace_sched_hmp_migrate(p, new_cpu,
+							HMP_MIGRATE_WAKEUP);
+			}
+			return new_cpu;
+		}
+
+		new_cpu = hmp_energy_wake_cpu(p, prev_cpu);
+		if (new_cpu != NR_CPUS) {
+			int from = hmp_cpu_domain_index(prev_cpu);
+			int to = hmp_cpu_domain_index(new_cpu);
+
+			if (from != to) {
+				if (to < from)
+					hmp_next_up_delay(&p->se, new_cpu);
+				else
+					hmp_next_down_delay(&p->se, new_cpu);
+				trace_sched_hmp_migrate(p, new_cpu,
+							HMP_MIGRATE_WAKEUP);
+			}
+			return new_cpu;
+		}
+		new_cpu = cpu;
+	}
 #endif
 
-	if (sd_flag & SD_BALANCE_WAKE)
+	/*
+	 * prefer_idle tasks are not pulled to the waker's cpu, they wake
+	 * on an idle cpu next to where they ran.
+	 */
+	if ((sd_flag & SD_BALANCE_WAKE) && !hmp_task_prefer_idle(p))
 		want_affine = cpumask_test_cpu(cpu, tsk_cpus_allowed(p));
 
 	rcu_read_lock();
@@ -6939,6 +7375,9 @@ int can_migrate_task(struct task_struct *p, struct lb_env *env)
 	if (throttled_lb_pair(task_group(p), env->src_cpu, env->dst_cpu))
 		return 0;
 
+	if (cpu_isolated(env->dst_cpu))
+		return 0;
+
 	if (!cpumask_test_cpu(env->dst_cpu, tsk_cpus_allowed(p))) {
 		int cpu;
 
@@ -8546,7 +8985,7 @@ static int idle_balance(struct rq *this_rq)
 	this_rq->idle_stamp = rq_clock(this_rq);
 
 	if (this_rq->avg_idle < sysctl_sched_migration_cost ||
-	    !this_rq->rd->overload) {
+	    !this_rq->rd->overload || cpu_isolated(this_cpu)) {
 		rcu_read_lock();
 		sd = rcu_dereference_check_sched_domain(this_rq->sd);
 		if (sd)
@@ -8918,7 +9357,7 @@ void nohz_balance_enter_idle(int cpu)
 	/*
 	 * If we're a completely isolated CPU, we don't play.
 	 */
-	if (on_null_domain(cpu_rq(cpu)))
+	if (on_null_domain(cpu_rq(cpu)) || cpu_isolated(cpu))
 		return;
 
 	cpumask_set_cpu(cpu, nohz.idle_cpus_mask);
@@ -9188,6 +9627,9 @@ static void nohz_idle_balance(struct rq *this_rq, enum cpu_idle_type idle) { }
 #ifdef CONFIG_SCHED_HMP
 static unsigned int hmp_task_eligible_for_up_migration(struct sched_entity *se)
 {
+	/* the group goes up as a unit */
+	if (hmp_rtg_wants_big(se))
+		return 1;
 	/* below hmp_up_threshold, never eligible */
 	if (se->avg.load_avg_ratio < hmp_up_threshold)
 		return 0;
@@ -9271,6 +9713,10 @@ static unsigned int hmp_down_migration(int cpu, struct sched_entity *se)
 					< hmp_next_down_threshold)
 		return 0;
 
+	/* keep a busy render group together on the faster cpus */
+	if (hmp_rtg_wants_big(se))
+		return 0;
+
 #ifdef CONFIG_SCHED_HMP_BOOST
 	if (hmp_boost())
 		return 0;
@@ -9298,6 +9744,9 @@ static int hmp_can_migrate_task(struct task_struct *p, struct lb_env *env)
 	 * 1) running (obviously), or
 	 * 2) cannot be migrated to this CPU due to cpus_allowed
 	 */
+	if (cpu_isolated(env->dst_cpu))
+		return 0;
+
 	if (!cpumask_test_cpu(env->dst_cpu, tsk_cpus_allowed(p))) {
 		schedstat_inc(p, se.statistics.nr_failed_migrations_affine);
 		return 0;
@@ -9564,6 +10013,9 @@ static unsigned int hmp_idle_pull(int this_cpu)
 	unsigned int force = 0;
 	struct task_struct *p = NULL;
 
+	if (cpu_isolated(this_cpu))
+		return 0;
+
 	if (!hmp_cpu_is_slowest(this_cpu))
 		hmp_domain = hmp_slower_domain(this_cpu);
 	if (!hmp_domain)
@@ -0,0 +1,669 @@
+/*
+ * Scheduler workload replay
+ *
+ * Replays a scripted set of threads against the live scheduler and
+ * reports what a user would have seen: frames that missed their vsync
+ * deadline, wakeup latency, migrations and the energy the run cost by
+ * the energy model. The same script on two builds, or with two sets of
+ * hmp thresholds, WALT windows or governor tunables, gives numbers that
+ * can be compared before anything goes to the field.
+ *
+ * A script is written to /sys/kernel/debug/sched_replay/script in one
+ * write. It lists threads, each followed by its ops:
+ *
+ *	thread <name> <nice> <repeat>	start a thread running its ops
+ *					<repeat> times
+ *	run <us>			cpu work: <us> at capacity 1024,
+ *					longer on a slower cpu or OPP
+ *	sleep <us>			sleep on an hrtimer
+ *	wake <name>			wake a thread blocked in "wait"
+ *	wait				block until woken by "wake"
+ *	vsync <us>			sleep until the next edge of a vsync
+ *					with this period, the frame is due on
+ *					the edge after it
+ *	done				the frame is complete
+ *
+ * Scripts are derived from a frozen flight recorder: a thread's
+ * switch-in to switch-out spans become "run" (scaled by the frequency
+ * records of that cpu), a switch-out that is not a preemption followed
+ * by a wakeup record issued by another thread becomes "wait" and a
+ * "wake" in that thread, and the rest become "sleep".
+ *
+ * Writing anything to "run" starts all threads at once and returns when
+ * they are done, or after "timeout_s" seconds; reading it shows the
+ * report of the last run.
+ *
+ * Work is accounted by task_sched_runtime() scaled by the capacity of
+ * the cpu at its current frequency, so a run op takes the same work on
+ * any cpu. Energy is the busy power of the core and cluster at that
+ * capacity times the runtime, i.e. what the replay threads cost while
+ * running; idle power is left out and a cluster shared by two replay
+ * threads is charged to both.
+ */
+
+#include <linux/cpufreq.h>
+#include <linux/debugfs.h>
+#include <linux/hrtimer.h>
+#include <linux/kthread.h>
+#include <linux/sched_energy.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+
+#include "sched.h"
+
+#define REPLAY_MAX_THREADS	32
+#define REPLAY_MAX_OPS		256
+#define REPLAY_SCRIPT_MAX	(64 * 1024)
+#define REPLAY_SPIN_NS		(50 * NSEC_PER_USEC)
+#define REPLAY_BUCKETS		16	/* log2 of us, the last one open */
+
+enum replay_op_type {
+	REPLAY_RUN,
+	REPLAY_SLEEP,
+	REPLAY_WAKE,
+	REPLAY_WAIT,
+	REPLAY_VSYNC,
+	REPLAY_DONE,
+};
+
+struct replay_op {
+	enum replay_op_type type;
+	u32 arg;		/* us, or the index of the thread to wake */
+};
+
+struct replay_hist {
+	u64 count;
+	u64 total_ns;
+	u64 max_ns;
+	u64 bucket[REPLAY_BUCKETS];
+};
+
+struct replay_thread {
+	char name[TASK_COMM_LEN];
+	int nice;
+	unsigned int repeat;
+	unsigned int nr_ops;
+	struct replay_op ops[REPLAY_MAX_OPS];
+
+	struct task_struct *task;
+	wait_queue_head_t wq;
+	atomic_t pending;	/* wakes not consumed by a wait yet */
+	ktime_t wake_time;
+
+	int cpu;
+	ktime_t frame_due;
+	bool in_frame;
+
+	/* results */
+	u64 frames;
+	u64 misses;
+	u64 migrations;
+	u64 cross_domain;
+	u64 busy_ns;
+	u64 energy;		/* ns * mW, i.e. pJ */
+	struct replay_hist wakeup;
+	struct replay_hist timer;
+	struct replay_hist late;
+};
+
+/* per cpu view of the energy model, taken when a run starts */
+struct replay_cpu {
+	unsigned int max_freq;
+	unsigned long max_cap;
+	const struct sched_group_energy *core;
+	const struct sched_group_energy *cluster;
+};
+
+static u32 timeout_s = 60;
+
+static DEFINE_MUTEX(replay_lock);
+static struct replay_thread *replay_threads;
+static unsigned int replay_nr_threads;
+static struct replay_cpu replay_cpus[NR_CPUS];
+static ktime_t replay_start;
+static s64 replay_elapsed_ns;
+static atomic_t replay_nr_running;
+static DECLARE_WAIT_QUEUE_HEAD(replay_done_wq);
+
+static void replay_hist_add(struct replay_hist *h, s64 ns)
+{
+	u64 us;
+	int b;
+
+	if (ns < 0)
+		ns = 0;
+	us = div_u64(ns, NSEC_PER_USEC);
+	b = us ? min(ilog2(us) + 1, REPLAY_BUCKETS - 1) : 0;
+	h->bucket[b]++;
+	h->count++;
+	h->total_ns += ns;
+	if (ns > h->max_ns)
+		h->max_ns = ns;
+}
+
+static void replay_hist_sum(struct replay_hist *sum, struct replay_hist *h)
+{
+	int b;
+
+	sum->count += h->count;
+	sum->total_ns += h->total_ns;
+	sum->max_ns = max(sum->max_ns, h->max_ns);
+	for (b = 0; b < REPLAY_BUCKETS; b++)
+		sum->bucket[b] += h->bucket[b];
+}
+
+static void replay_cpus_init(void)
+{
+	struct cpufreq_policy *policy;
+	const struct sched_group_energy *core;
+	struct replay_cpu *rc;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		rc = &replay_cpus[cpu];
+		memset(rc, 0, sizeof(*rc));
+		rc->max_cap = SCHED_CAPACITY_SCALE;
+
+		policy = cpufreq_cpu_get(cpu);
+		if (policy) {
+			rc->max_freq = policy->cpuinfo.max_freq;
+			cpufreq_cpu_put(policy);
+		}
+
+		core = sge_array[cpu][SD_LEVEL0];
+		if (core && core->nr_cap_states) {
+			rc->core = core;
+			rc->cluster = sge_array[cpu][SD_LEVEL1];
+			rc->max_cap = core->cap_states[core->nr_cap_states - 1].cap;
+		}
+	}
+}
+
+/* capacity of cpu at its current frequency, and the busy power there */
+static unsigned long replay_capacity(int cpu, unsigned long *power)
+{
+	struct replay_cpu *rc = &replay_cpus[cpu];
+	unsigned long cap = rc->max_cap;
+	unsigned int cur, i;
+
+	cur = cpufreq_quick_get(cpu);
+	if (cur && rc->max_freq)
+		cap = cap * min(cur, rc->max_freq) / rc->max_freq;
+
+	*power = 0;
+	if (!rc->core)
+		return cap;
+
+	for (i = 0; i < rc->core->nr_cap_states - 1; i++) {
+		if (rc->core->cap_states[i].cap >= cap)
+			break;
+	}
+	*power = rc->core->cap_states[i].power;
+	if (rc->cluster && rc->cluster->nr_cap_states)
+		*power += rc->cluster->cap_states[min(i,
+				rc->cluster->nr_cap_states - 1)].power;
+	return cap;
+}
+
+static void replay_note_cpu(struct replay_thread *t)
+{
+	int cpu = raw_smp_processor_id();
+
+	if (cpu == t->cpu)
+		return;
+	if (t->cpu >= 0) {
+		t->migrations++;
+		if (hmp_cpu_domain_index(cpu) != hmp_cpu_domain_index(t->cpu))
+			t->cross_domain++;
+	}
+	t->cpu = cpu;
+}
+
+static void replay_run(struct replay_thread *t, u32 us)
+{
+	u64 work = (u64)us * NSEC_PER_USEC * SCHED_CAPACITY_SCALE;
+	u64 done = 0, prev, now, delta, spin;
+	unsigned long cap, power;
+
+	prev = task_sched_runtime(current);
+	while (done < work && !kthread_should_stop()) {
+		spin = sched_clock() + REPLAY_SPIN_NS;
+		while (sched_clock() < spin)
+			cpu_relax();
+
+		now = task_sched_runtime(current);
+		delta = now - prev;
+		prev = now;
+
+		replay_note_cpu(t);
+		cap = replay_capacity(t->cpu, &power);
+		done += delta * cap;
+		t->busy_ns += delta;
+		t->energy += delta * power;
+		cond_resched();
+	}
+}
+
+static void replay_sleep_until(struct replay_thread *t, ktime_t expires)
+{
+	set_current_state(TASK_INTERRUPTIBLE);
+	if (kthread_should_stop()) {
+		__set_current_state(TASK_RUNNING);
+		return;
+	}
+	schedule_hrtimeout(&expires, HRTIMER_MODE_ABS);
+	replay_hist_add(&t->timer, ktime_to_ns(ktime_sub(ktime_get(), expires)));
+}
+
+static void replay_wake(struct replay_thread *target)
+{
+	target->wake_time = ktime_get();
+	atomic_inc(&target->pending);
+	wake_up(&target->wq);
+}
+
+static void replay_wait(struct replay_thread *t)
+{
+	wait_event_interruptible(t->wq, atomic_read(&t->pending) ||
+				 kthread_should_stop());
+	if (atomic_add_unless(&t->pending, -1, 0))
+		replay_hist_add(&t->wakeup,
+				ktime_to_ns(ktime_sub(ktime_get(), t->wake_time)));
+}
+
+static void replay_vsync(struct replay_thread *t, u32 us)
+{
+	s64 period = (s64)us * NSEC_PER_USEC;
+	s64 since = ktime_to_ns(ktime_sub(ktime_get(), replay_start));
+	ktime_t edge;
+
+	if (!period)
+		return;
+	edge = ktime_add_ns(replay_start, (div64_s64(since, period) + 1) * period);
+	replay_sleep_until(t, edge);
+	t->frame_due = ktime_add_ns(edge, period);
+	t->in_frame = true;
+}
+
+static void replay_done(struct replay_thread *t)
+{
+	s64 late;
+
+	if (!t->in_frame)
+		return;
+	t->in_frame = false;
+	t->frames++;
+	late = ktime_to_ns(ktime_sub(ktime_get(), t->frame_due));
+	if (late > 0) {
+		t->misses++;
+		replay_hist_add(&t->late, late);
+	}
+}
+
+static int replay_thread_fn(void *data)
+{
+	struct replay_thread *t = data;
+	struct replay_op *op;
+	unsigned int n;
+
+	for (n = 0; n < t->repeat && !kthread_should_stop(); n++) {
+		for (op = t->ops; op < t->ops + t->nr_ops; op++) {
+			if (kthread_should_stop())
+				break;
+			replay_note_cpu(t);
+			switch (op->type) {
+			case REPLAY_RUN:
+				replay_run(t, op->arg);
+				break;
+			case REPLAY_SLEEP:
+				replay_sleep_until(t, ktime_add_us(ktime_get(),
+								   op->arg));
+				break;
+			case REPLAY_WAKE:
+				replay_wake(&replay_threads[op->arg]);
+				break;
+			case REPLAY_WAIT:
+				replay_wait(t);
+				break;
+			case REPLAY_VSYNC:
+				replay_vsync(t, op->arg);
+				break;
+			case REPLAY_DONE:
+				replay_done(t);
+				break;
+			}
+		}
+	}
+
+	if (atomic_dec_and_test(&replay_nr_running))
+		wake_up(&replay_done_wq);
+
+	/* stay around for kthread_stop() */
+	while (!kthread_should_stop()) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (!kthread_should_stop())
+			schedule();
+		__set_current_state(TASK_RUNNING);
+	}
+	return 0;
+}
+
+static void replay_reset(struct replay_thread *t)
+{
+	init_waitqueue_head(&t->wq);
+	atomic_set(&t->pending, 0);
+	t->task = NULL;
+	t->cpu = -1;
+	t->in_frame = false;
+	t->frames = t->misses = 0;
+	t->migrations = t->cross_domain = 0;
+	t->busy_ns = t->energy = 0;
+	memset(&t->wakeup, 0, sizeof(t->wakeup));
+	memset(&t->timer, 0, sizeof(t->timer));
+	memset(&t->late, 0, sizeof(t->late));
+}
+
+static int replay_run_all(void)
+{
+	struct replay_thread *t;
+	unsigned int i;
+	long left;
+
+	if (!replay_nr_threads)
+		return -ENOENT;
+
+	replay_cpus_init();
+	for (i = 0; i < replay_nr_threads; i++)
+		replay_reset(&replay_threads[i]);
+
+	for (i = 0; i < replay_nr_threads; i++) {
+		t = &replay_threads[i];
+		t->task = kthread_create(replay_thread_fn, t, "%s", t->name);
+		if (IS_ERR(t->task)) {
+			int err = PTR_ERR(t->task);
+
+			while (i--)
+				kthread_stop(replay_threads[i].task);
+			return err;
+		}
+		set_user_nice(t->task, t->nice);
+	}
+
+	atomic_set(&replay_nr_running, replay_nr_threads);
+	replay_start = ktime_get();
+	for (i = 0; i < replay_nr_threads; i++)
+		wake_up_process(replay_threads[i].task);
+
+	left = wait_event_interruptible_timeout(replay_done_wq,
+			!atomic_read(&replay_nr_running),
+			msecs_to_jiffies(timeout_s * MSEC_PER_SEC));
+	replay_elapsed_ns = ktime_to_ns(ktime_sub(ktime_get(), replay_start));
+
+	for (i = 0; i < replay_nr_threads; i++)
+		kthread_stop(replay_threads[i].task);
+
+	if (left < 0)
+		return left;
+	return left ? 0 : -ETIMEDOUT;
+}
+
+static int replay_find(struct replay_thread *threads, unsigned int nr,
+		       const char *name)
+{
+	unsigned int i;
+
+	for (i = 0; i < nr; i++) {
+		if (!strcmp(threads[i].name, name))
+			return i;
+	}
+	return -1;
+}
+
+/*
+ * Parse a script into threads. "wake" may name a thread declared
+ * further down, so names are resolved once all threads are known.
+ */
+static int replay_parse(char *script, struct replay_thread *threads,
+			unsigned int *nr_threads)
+{
+	static const char * const op_names[] = {
+		[REPLAY_RUN] = "run",
+		[REPLAY_SLEEP] = "sleep",
+		[REPLAY_WAKE] = "wake",
+		[REPLAY_WAIT] = "wait",
+		[REPLAY_VSYNC] = "vsync",
+		[REPLAY_DONE] = "done",
+	};
+	char (*wake_names)[TASK_COMM_LEN];
+	struct replay_thread *t = NULL;
+	char *line, word[16], arg[TASK_COMM_LEN];
+	unsigned int nr = 0, i, j, nr_wakes = 0;
+	struct replay_op *op;
+	int n, err = 0;
+
+	wake_names = kcalloc(REPLAY_MAX_THREADS * REPLAY_MAX_OPS / 8,
+			     TASK_COMM_LEN, GFP_KERNEL);
+	if (!wake_names)
+		return -ENOMEM;
+
+	while ((line = strsep(&script, "\n")) != NULL) {
+		line = strim(line);
+		if (!*line || *line == '#')
+			continue;
+
+		if (!strncmp(line, "thread ", 7)) {
+			if (nr == REPLAY_MAX_THREADS) {
+				err = -E2BIG;
+				goto out;
+			}
+			t = &threads[nr];
+			if (sscanf(line, "thread %15s %d %u", t->name, &t->nice,
+				   &t->repeat) != 3 ||
+			    t->nice < MIN_NICE || t->nice > MAX_NICE ||
+			    replay_find(threads, nr, t->name) >= 0) {
+				err = -EINVAL;
+				goto out;
+			}
+			nr++;
+			continue;
+		}
+
+		if (!t || t->nr_ops == REPLAY_MAX_OPS) {
+			err = t ? -E2BIG : -EINVAL;
+			goto out;
+		}
+		op = &t->ops[t->nr_ops];
+		n = sscanf(line, "%15s %15s", word, arg);
+		for (i = 0; i < ARRAY_SIZE(op_names); i++) {
+			if (!strcmp(word, op_names[i]))
+				break;
+		}
+		if (i == ARRAY_SIZE(op_names)) {
+			err = -EINVAL;
+			goto out;
+		}
+		op->type = i;
+		op->arg = 0;
+
+		switch (op->type) {
+		case REPLAY_RUN:
+		case REPLAY_SLEEP:
+		case REPLAY_VSYNC:
+			if (n != 2 || kstrtou32(arg, 0, &op->arg)) {
+				err = -EINVAL;
+				goto out;
+			}
+			break;
+		case REPLAY_WAKE:
+			if (n != 2 ||
+			    nr_wakes == REPLAY_MAX_THREADS * REPLAY_MAX_OPS / 8) {
+				err = -EINVAL;
+				goto out;
+			}
+			strlcpy(wake_names[nr_wakes], arg, TASK_COMM_LEN);
+			op->arg = nr_wakes++;
+			break;
+		default:
+			break;
+		}
+		t->nr_ops++;
+	}
+
+	for (i = 0; i < nr; i++) {
+		for (j = 0; j < threads[i].nr_ops; j++) {
+			op = &threads[i].ops[j];
+			if (op->type != REPLAY_WAKE)
+				continue;
+			n = replay_find(threads, nr, wake_names[op->arg]);
+			if (n < 0) {
+				err = -ENOENT;
+				goto out;
+			}
+			op->arg = n;
+		}
+	}
+	*nr_threads = nr;
+out:
+	kfree(wake_names);
+	return err;
+}
+
+static ssize_t replay_script_write(struct file *file, const char __user *ubuf,
+				   size_t count, loff_t *ppos)
+{
+	struct replay_thread *threads;
+	unsigned int nr = 0;
+	char *script;
+	int err;
+
+	if (count >= REPLAY_SCRIPT_MAX)
+		return -E2BIG;
+
+	script = vmalloc(count + 1);
+	threads = vzalloc(REPLAY_MAX_THREADS * sizeof(*threads));
+	if (!script || !threads) {
+		err = -ENOMEM;
+		goto out;
+	}
+	if (copy_from_user(script, ubuf, count)) {
+		err = -EFAULT;
+		goto out;
+	}
+	script[count] = '\0';
+
+	err = replay_parse(script, threads, &nr);
+	if (err)
+		goto out;
+
+	mutex_lock(&replay_lock);
+	swap(replay_threads, threads);
+	replay_nr_threads = nr;
+	replay_elapsed_ns = 0;
+	mutex_unlock(&replay_lock);
+out:
+	vfree(threads);
+	vfree(script);
+	return err ? err : count;
+}
+
+static const struct file_operations replay_script_fops = {
+	.open = simple_open,
+	.write = replay_script_write,
+	.llseek = noop_llseek,
+};
+
+static void replay_hist_show(struct seq_file *m, const char *name,
+			     struct replay_hist *h)
+{
+	int b;
+
+	seq_printf(m, "%-8s %8llu %8llu %8llu", name, h->count,
+		   h->count ? div64_u64(h->total_ns,
+					h->count * NSEC_PER_USEC) : 0,
+		   div_u64(h->max_ns, NSEC_PER_USEC));
+	for (b = 0; b < REPLAY_BUCKETS; b++)
+		seq_printf(m, " %llu", h->bucket[b]);
+	seq_putc(m, '\n');
+}
+
+static int replay_show(struct seq_file *m, void *v)
+{
+	struct replay_hist wakeup = {}, timer = {}, late = {};
+	u64 frames = 0, misses = 0, energy = 0;
+	struct replay_thread *t;
+	unsigned int i;
+
+	mutex_lock(&replay_lock);
+	if (!replay_elapsed_ns) {
+		mutex_unlock(&replay_lock);
+		return 0;
+	}
+
+	seq_printf(m, "elapsed %lld ms\n",
+		   div_s64(replay_elapsed_ns, NSEC_PER_MSEC));
+	seq_puts(m, "thread           frames   misses migrations cross busy_ms energy_uj\n");
+	for (i = 0; i < replay_nr_threads; i++) {
+		t = &replay_threads[i];
+		seq_printf(m, "%-16s %6llu %8llu %10llu %5llu %7llu %9llu\n",
+			   t->name, t->frames, t->misses, t->migrations,
+			   t->cross_domain, div_u64(t->busy_ns, NSEC_PER_MSEC),
+			   div_u64(t->energy, 1000000));
+		frames += t->frames;
+		misses += t->misses;
+		energy += t->energy;
+		replay_hist_sum(&wakeup, &t->wakeup);
+		replay_hist_sum(&timer, &t->timer);
+		replay_hist_sum(&late, &t->late);
+	}
+	seq_printf(m, "total frames %llu misses %llu energy_uj %llu\n",
+		   frames, misses, div_u64(energy, 1000000));
+
+	seq_puts(m, "latency     count   avg_us   max_us  log2 us buckets\n");
+	replay_hist_show(m, "wakeup", &wakeup);
+	replay_hist_show(m, "timer", &timer);
+	replay_hist_show(m, "late", &late);
+	mutex_unlock(&replay_lock);
+	return 0;
+}
+
+static int replay_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, replay_show, NULL);
+}
+
+static ssize_t replay_run_write(struct file *file, const char __user *ubuf,
+				size_t count, loff_t *ppos)
+{
+	int err;
+
+	if (mutex_lock_interruptible(&replay_lock))
+		return -EINTR;
+	err = replay_run_all();
+	mutex_unlock(&replay_lock);
+
+	return err ? err : count;
+}
+
+static const struct file_operations replay_run_fops = {
+	.open = replay_open,
+	.read = seq_read,
+	.write = replay_run_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int __init sched_replay_init(void)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("sched_replay", NULL);
+	if (IS_ERR_OR_NULL(dir))
+		return -ENODEV;
+	debugfs_create_file("script", 0200, dir, NULL, &replay_script_fops);
+	debugfs_create_file("run", 0600, dir, NULL, &replay_run_fops);
+	debugfs_create_u32("timeout_s", 0644, dir, &timeout_s);
+	return 0;
+}
+late_initcall(sched_replay_init);
@@ -9,6 +9,7 @@
 #include <linux/irq_work.h>
 
 #include "walt.h"
+#include "tune.h"
 
 int sched_rr_timeslice = RR_TIMESLICE;
 
@@ -1355,6 +1356,117 @@ static void yield_task_rt(struct rq *rq)
 #ifdef CONFIG_SMP
 static int find_lowest_rq(struct task_struct *task);
 
+#ifdef CONFIG_SCHED_HMP
+extern struct cpumask hmp_slow_cpu_mask;
+
+static inline bool rt_hmp_enabled(void)
+{
+	return sched_feat(RT_CLUSTER_AWARE) &&
+	       !cpumask_empty(&hmp_slow_cpu_mask);
+}
+
+static inline bool rt_cpu_in_cluster(int cpu, int rt_cluster)
+{
+	switch (rt_cluster) {
+	case SCHEDTUNE_RT_LITTLE:
+		return cpumask_test_cpu(cpu, &hmp_slow_cpu_mask);
+	case SCHEDTUNE_RT_BIG:
+		return !cpumask_test_cpu(cpu, &hmp_slow_cpu_mask);
+	}
+	return true;
+}
+
+/* Called under rcu_read_lock(), @cpu's curr is read unlocked */
+static inline bool rt_cpu_runs_top_app(int cpu)
+{
+	struct task_struct *curr = READ_ONCE(cpu_rq(cpu)->curr);
+
+	return curr && curr->sched_class == &fair_sched_class &&
+	       schedtune_prefer_idle(curr) > 0;
+}
+
+static inline unsigned long rt_cpu_capacity_curr(int cpu)
+{
+	return (capacity_orig_of(cpu) * arch_scale_freq_capacity(NULL, cpu))
+			>> SCHED_CAPACITY_SHIFT;
+}
+
+/*
+ * Should @p rather not wake up on @cpu, even though no RT task runs
+ * there: @cpu is outside of @p's preferred cluster, or it is running
+ * a top-app task which @p would preempt.
+ */
+static bool rt_cpu_misplaced(struct task_struct *p, int cpu)
+{
+	if (!rt_hmp_enabled() || p->nr_cpus_allowed < 2)
+		return false;
+
+	return !rt_cpu_in_cluster(cpu, schedtune_rt_cluster(p)) ||
+	       rt_cpu_runs_top_app(cpu);
+}
+
+/*
+ * Pick among the lowest priority cpus in @lowest_mask those of @task's
+ * preferred cluster, and of these the ones not running a top-app task.
+ * The last cpu of @task wins if it is one of them, it is likely to be
+ * cache-hot; otherwise the cpu with the highest capacity at its current
+ * frequency does, so that an audio thread doesn't end up on a little
+ * cpu at its lowest OPP while a faster one is available.
+ *
+ * Returns -1 when no cpu of the preferred cluster is in @lowest_mask,
+ * leaving the choice to the topology based search.
+ */
+static int find_lowest_rq_hmp(struct task_struct *task,
+			      struct cpumask *lowest_mask)
+{
+	int rt_cluster = schedtune_rt_cluster(task);
+	int prev_cpu = task_cpu(task);
+	int best_cpu = -1, busy_cpu = -1;
+	unsigned long cap, best_cap = 0, busy_cap = 0;
+	int cpu;
+
+	if (!rt_hmp_enabled())
+		return -1;
+
+	rcu_read_lock();
+	for_each_cpu(cpu, lowest_mask) {
+		if (!rt_cpu_in_cluster(cpu, rt_cluster))
+			continue;
+
+		cap = rt_cpu_capacity_curr(cpu);
+		if (cpu == prev_cpu)
+			cap = ULONG_MAX;
+
+		if (rt_cpu_runs_top_app(cpu)) {
+			if (busy_cpu == -1 || cap > busy_cap) {
+				busy_cap = cap;
+				busy_cpu = cpu;
+			}
+			continue;
+		}
+
+		if (best_cpu == -1 || cap > best_cap) {
+			best_cap = cap;
+			best_cpu = cpu;
+		}
+	}
+	rcu_read_unlock();
+
+	return best_cpu != -1 ? best_cpu : busy_cpu;
+}
+#else
+static inline bool rt_cpu_misplaced(struct task_struct *p, int cpu)
+{
+	return false;
+}
+
+static inline int find_lowest_rq_hmp(struct task_struct *task,
+				     struct cpumask *lowest_mask)
+{
+	return -1;
+}
+#endif /* CONFIG_SCHED_HMP */
+
 static int
 select_task_rq_rt(struct task_struct *p, int cpu, int sd_flag, int flags)
 {
@@ -1391,10 +1503,14 @@ select_task_rq_rt(struct task_struct *p, int cpu, int sd_flag, int flags)
 	 *
 	 * This test is optimistic, if we get it wrong the load-balancer
 	 * will have to sort it out.
+	 *
+	 * On big.LITTLE also look for another runqueue if this one is
+	 * outside of @p's preferred cluster or runs a top-app task.
 	 */
-	if (curr && unlikely(rt_task(curr)) &&
-	    (curr->nr_cpus_allowed < 2 ||
-	     curr->prio <= p->prio)) {
+	if ((curr && unlikely(rt_task(curr)) &&
+	     (curr->nr_cpus_allowed < 2 ||
+	      curr->prio <= p->prio)) ||
+	    rt_cpu_misplaced(p, cpu)) {
 		int target = find_lowest_rq(p);
 
 		/*
@@ -1661,6 +1777,18 @@ static int find_lowest_rq(struct task_struct *task)
 	if (!cpupri_find(&task_rq(task)->rd->cpupri, task, lowest_mask))
 		return -1; /* No targets found */
 
+#ifdef CONFIG_SCHED_CORE_CTL
+	cpumask_andnot(lowest_mask, lowest_mask, &sched_isolated_cpus);
+	if (cpumask_empty(lowest_mask))
+		return -1;
+#endif
+
+	/* On big.LITTLE the cluster and the capacity come first */
+	cpu = find_lowest_rq_hmp(task, lowest_mask);
+	if (cpu != -1)
+		return cpu;
+	cpu = task_cpu(task);
+
 	/*
 	 * At this point we have built a mask of cpus representing the
 	 * lowest priority tasks in the system.  Now we want to elect
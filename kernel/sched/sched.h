@@ -9,6 +9,7 @@
 #include <linux/irq_work.h>
 #include <linux/tick.h>
 #include <linux/slab.h>
+#include <linux/psi.h>
 
 #include "cpupri.h"
 #include "cpudeadline.h"
@@ -550,6 +551,12 @@ struct dl_rq {
 #endif
 	/* This is the "average utilization" for this runqueue */
 	s64 avg_bw;
+
+	/*
+	 * Active utilization (GRUB): the bandwidth of the -deadline tasks
+	 * which are runnable, or blocked but not past their 0-lag time.
+	 */
+	u64 running_bw;
 };
 
 #ifdef CONFIG_SMP
@@ -720,6 +727,7 @@ struct rq {
 	struct cpumask freq_domain_cpumask;
 
 	u64 cumulative_runnable_avg;
+	u64 cumulative_pred_demand;
 	int efficiency; /* Differentiate cpus with different IPC capability */
 	int load_scale_factor;
 	int capacity;
@@ -985,8 +993,15 @@ extern int group_balance_cpu(struct sched_group *sg);
 static LIST_HEAD(hmp_domains);
 DECLARE_PER_CPU(struct hmp_domain *, hmp_cpu_domain);
 #define hmp_cpu_domain(cpu)	(per_cpu(hmp_cpu_domain, (cpu)))
+extern int hmp_cpu_domain_index(int cpu);
 #endif /* CONFIG_SCHED_HMP */
 
+#ifdef CONFIG_SCHED_HMP_RTG
+extern void hmp_rtg_task_dead(struct task_struct *p);
+#else
+static inline void hmp_rtg_task_dead(struct task_struct *p) { }
+#endif
+
 #else
 
 static inline void sched_ttwu_pending(void) { }
@@ -1597,6 +1612,7 @@ static inline unsigned long capacity_orig_of(int cpu)
 }
 
 extern unsigned int sysctl_sched_use_walt_cpu_util;
+extern unsigned int sysctl_sched_walt_pred_demand;
 extern unsigned int walt_ravg_window;
 extern unsigned int walt_disabled;
 
@@ -1632,9 +1648,17 @@ static inline unsigned long __cpu_util(int cpu, int delta)
 	unsigned long capacity = capacity_orig_of(cpu);
 
 #ifdef CONFIG_SCHED_WALT
-	if (!walt_disabled && sysctl_sched_use_walt_cpu_util)
-		util = (cpu_rq(cpu)->prev_runnable_sum << SCHED_LOAD_SHIFT) /
-			walt_ravg_window;
+	if (!walt_disabled && sysctl_sched_use_walt_cpu_util) {
+		u64 busy = cpu_rq(cpu)->prev_runnable_sum;
+
+		/*
+		 * Ramp up to what the runnable tasks are predicted to need
+		 * in this window, before it shows in the past one.
+		 */
+		if (sysctl_sched_walt_pred_demand)
+			busy = max(busy, cpu_rq(cpu)->cumulative_pred_demand);
+		util = (busy << SCHED_LOAD_SHIFT) / walt_ravg_window;
+	}
 #endif
 	delta += util;
 	if (delta < 0)
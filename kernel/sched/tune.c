@@ -129,6 +129,12 @@ struct schedtune {
 	/* Hint to bias scheduling of tasks on that SchedTune CGroup
 	 * towards idle CPUs */
 	int prefer_idle;
+
+	/* Minimum hrtimer slack for the timed sleeps of member tasks */
+	u64 timer_slack_ns;
+
+	/* Cluster RT tasks of that SchedTune CGroup are placed on, if free */
+	int rt_cluster;
 };
 
 static inline struct schedtune *css_st(struct cgroup_subsys_state *css)
@@ -161,6 +167,8 @@ root_schedtune = {
 	.perf_boost_idx = 0,
 	.perf_constrain_idx = 0,
 	.prefer_idle = 0,
+	.timer_slack_ns = 0,
+	.rt_cluster = SCHEDTUNE_RT_ANY,
 };
 
 int
@@ -536,7 +544,7 @@ int schedtune_task_boost(struct task_struct *p)
 	/* Get task boost value */
 	rcu_read_lock();
 	st = task_schedtune(p);
-	task_boost = st->boost;
+	task_boost = max(st->boost, p->stune_inherited_boost);
 	rcu_read_unlock();
 
 	return task_boost;
@@ -556,6 +564,70 @@ int schedtune_prefer_idle(struct task_struct *p)
 	return prefer_idle;
 }
 
+int schedtune_rt_cluster(struct task_struct *p)
+{
+	int rt_cluster;
+
+	rcu_read_lock();
+	rt_cluster = task_schedtune(p)->rt_cluster;
+	rcu_read_unlock();
+
+	return rt_cluster;
+}
+
+/*
+ * A background group's slack lets its tasks' sleeps end together with
+ * whatever else wakes the cpu, instead of each taking its own wakeup.
+ * RT tasks keep their precise timers.
+ */
+unsigned long schedtune_timer_slack(struct task_struct *p)
+{
+	unsigned long slack;
+
+	if (rt_task(p))
+		return 0;
+
+	rcu_read_lock();
+	slack = task_schedtune(p)->timer_slack_ns;
+	rcu_read_unlock();
+
+	return slack;
+}
+
+static u64
+timer_slack_read(struct cgroup_subsys_state *css, struct cftype *cft)
+{
+	return css_st(css)->timer_slack_ns;
+}
+
+static int
+timer_slack_write(struct cgroup_subsys_state *css, struct cftype *cft,
+		  u64 slack)
+{
+	if (slack > NSEC_PER_SEC)
+		return -EINVAL;
+	css_st(css)->timer_slack_ns = slack;
+
+	return 0;
+}
+
+static u64
+rt_cluster_read(struct cgroup_subsys_state *css, struct cftype *cft)
+{
+	return css_st(css)->rt_cluster;
+}
+
+static int
+rt_cluster_write(struct cgroup_subsys_state *css, struct cftype *cft,
+		 u64 rt_cluster)
+{
+	if (rt_cluster >= SCHEDTUNE_RT_NR_CLUSTERS)
+		return -EINVAL;
+	css_st(css)->rt_cluster = rt_cluster;
+
+	return 0;
+}
+
 static u64
 prefer_idle_read(struct cgroup_subsys_state *css, struct cftype *cft)
 {
@@ -634,6 +706,16 @@ static struct cftype files[] = {
 		.read_u64 = prefer_idle_read,
 		.write_u64 = prefer_idle_write,
 	},
+	{
+		.name = "timer_slack_ns",
+		.read_u64 = timer_slack_read,
+		.write_u64 = timer_slack_write,
+	},
+	{
+		.name = "rt_cluster",
+		.read_u64 = rt_cluster_read,
+		.write_u64 = rt_cluster_write,
+	},
 	{ }	/* terminate */
 };
 
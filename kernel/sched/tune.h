@@ -1,3 +1,12 @@
+
+/* Cluster an RT task of a SchedTune CGroup is preferably placed on */
+enum {
+	SCHEDTUNE_RT_ANY,
+	SCHEDTUNE_RT_LITTLE,
+	SCHEDTUNE_RT_BIG,
+	SCHEDTUNE_RT_NR_CLUSTERS,
+};
+
 #ifdef CONFIG_SCHED_TUNE
 #include <linux/reciprocal_div.h>
 
@@ -18,6 +27,7 @@ int schedtune_task_boost(struct task_struct *tsk);
 void schedtune_exit_task(struct task_struct *tsk);
 
 int schedtune_prefer_idle(struct task_struct *tsk);
+int schedtune_rt_cluster(struct task_struct *tsk);
 
 extern void schedtune_enqueue_task(struct task_struct *p, int cpu);
 extern void schedtune_dequeue_task(struct task_struct *p, int cpu);
@@ -26,6 +36,8 @@ extern void schedtune_dequeue_task(struct task_struct *p, int cpu);
 
 #define schedtune_cpu_boost(cpu)  get_sysctl_sched_cfs_boost()
 #define schedtune_task_boost(tsk) get_sysctl_sched_cfs_boost()
+#define schedtune_prefer_idle(tsk) 0
+#define schedtune_rt_cluster(tsk) SCHEDTUNE_RT_ANY
 
 #define schedtune_exit_task(task) do { } while (0)
 
@@ -41,6 +53,8 @@ int schedtune_accept_deltas(int nrg_delta, int cap_delta,
 
 #define schedtune_cpu_boost(cpu)  0
 #define schedtune_task_boost(tsk) 0
+#define schedtune_prefer_idle(tsk) 0
+#define schedtune_rt_cluster(tsk) SCHEDTUNE_RT_ANY
 
 #define schedtune_exit_task(task) do { } while (0)
 
@@ -42,6 +42,20 @@ static __read_mostly unsigned int walt_io_is_busy = 0;
 
 unsigned int sysctl_sched_walt_init_task_load_pct = 15;
 
+/* 1 -> task and cpu utilization follow the predicted demand */
+unsigned int sysctl_sched_walt_pred_demand = 1;
+
+/*
+ * A task's busy windows are counted in NUM_BUSY_BUCKETS buckets of
+ * walt_ravg_window / NUM_BUSY_BUCKETS each. The bucket of each new
+ * window gains BUSY_BUCKET_INC, or BUSY_BUCKET_INC_BIG once it reached
+ * BUSY_BUCKET_CONSISTENT, all others lose BUSY_BUCKET_DEC.
+ */
+#define BUSY_BUCKET_INC		8
+#define BUSY_BUCKET_INC_BIG	16
+#define BUSY_BUCKET_CONSISTENT	16
+#define BUSY_BUCKET_DEC		2
+
 /* 1 -> use PELT based load stats, 0 -> use window-based load stats */
 unsigned int __read_mostly walt_disabled = 0;
 
@@ -93,6 +107,7 @@ walt_inc_cumulative_runnable_avg(struct rq *rq,
 				 struct task_struct *p)
 {
 	rq->cumulative_runnable_avg += p->ravg.demand;
+	rq->cumulative_pred_demand += p->ravg.pred_demand;
 }
 
 void
@@ -101,6 +116,7 @@ walt_dec_cumulative_runnable_avg(struct rq *rq,
 {
 	rq->cumulative_runnable_avg -= p->ravg.demand;
 	BUG_ON((s64)rq->cumulative_runnable_avg < 0);
+	rq->cumulative_pred_demand -= p->ravg.pred_demand;
 }
 
 static void
@@ -541,6 +557,63 @@ static int account_busy_for_task_demand(struct task_struct *p, int event)
 	return 1;
 }
 
+static inline int busy_to_bucket(u32 runtime)
+{
+	int bidx = div64_u64((u64)runtime * NUM_BUSY_BUCKETS,
+			     walt_ravg_window);
+
+	return min(bidx, NUM_BUSY_BUCKETS - 1);
+}
+
+static void bucket_increase(u8 *buckets, int idx)
+{
+	int i, step;
+
+	for (i = 0; i < NUM_BUSY_BUCKETS; i++) {
+		if (i != idx) {
+			buckets[i] = buckets[i] > BUSY_BUCKET_DEC ?
+				buckets[i] - BUSY_BUCKET_DEC : 0;
+			continue;
+		}
+		step = buckets[i] >= BUSY_BUCKET_CONSISTENT ?
+			BUSY_BUCKET_INC_BIG : BUSY_BUCKET_INC;
+		buckets[i] = min(buckets[i] + step, U8_MAX);
+	}
+}
+
+/*
+ * Predict how busy a window that already reached @runtime ends up: the
+ * start of the most frequent bucket at or above that of @runtime. Using
+ * the start of the bucket keeps tasks whose windows vary within a bucket
+ * from being overestimated.
+ */
+static u32 predict_busy(struct task_struct *p, u32 runtime)
+{
+	u8 *buckets = p->ravg.busy_buckets;
+	int i, best = -1;
+	u32 pred;
+
+	for (i = busy_to_bucket(runtime); i < NUM_BUSY_BUCKETS; i++)
+		if (buckets[i] && (best < 0 || buckets[i] > buckets[best]))
+			best = i;
+	if (best < 0)
+		return runtime;
+
+	pred = div64_u64((u64)best * walt_ravg_window, NUM_BUSY_BUCKETS);
+	return max(pred, runtime);
+}
+
+static void update_pred_demand(struct rq *rq, struct task_struct *p,
+			       u32 pred)
+{
+	/* as for the fixup of cumulative_runnable_avg in update_history() */
+	if (task_on_rq_queued(p) && (!task_has_dl_policy(p) ||
+						!p->dl.dl_throttled))
+		rq->cumulative_pred_demand += (s64)pred - p->ravg.pred_demand;
+
+	p->ravg.pred_demand = pred;
+}
+
 /*
  * Called when new window is starting for a task, to record cpu usage over
  * recently concluded window(s). Normally 'samples' should be 1. It can be > 1
@@ -552,7 +625,7 @@ static void update_history(struct rq *rq, struct task_struct *p,
 {
 	u32 *hist = &p->ravg.sum_history[0];
 	int ridx, widx;
-	u32 max = 0, avg, demand;
+	u32 max = 0, avg, demand, pred;
 	u64 sum = 0;
 
 	/* Ignore windows where task had no activity */
@@ -597,10 +670,16 @@ static void update_history(struct rq *rq, struct task_struct *p,
 	 */
 	if (task_on_rq_queued(p) && (!task_has_dl_policy(p) ||
 						!p->dl.dl_throttled))
-		fixup_cumulative_runnable_avg(rq, p, demand);
+		fixup_cumulative_runnable_avg(rq, p,
+					      (s64)demand - p->ravg.demand);
 
 	p->ravg.demand = demand;
 
+	/* predict from the buckets before this window goes into them */
+	pred = predict_busy(p, runtime);
+	bucket_increase(p->ravg.busy_buckets, busy_to_bucket(runtime));
+	update_pred_demand(rq, p, pred);
+
 done:
 	trace_walt_update_history(rq, p, runtime, samples, event);
 	return;
@@ -613,6 +692,10 @@ static void add_to_task_demand(struct rq *rq, struct task_struct *p,
 	p->ravg.sum += delta;
 	if (unlikely(p->ravg.sum > walt_ravg_window))
 		p->ravg.sum = walt_ravg_window;
+
+	/* the window outgrew the prediction, look at the next buckets */
+	if (p->ravg.sum > p->ravg.pred_demand)
+		update_pred_demand(rq, p, predict_busy(p, p->ravg.sum));
 }
 
 /*
@@ -1168,6 +1251,7 @@ void walt_init_new_task_load(struct task_struct *p)
 	}
 
 	p->ravg.demand = init_load_windows;
+	p->ravg.pred_demand = init_load_windows;
 	for (i = 0; i < RAVG_HIST_SIZE_MAX; ++i)
 		p->ravg.sum_history[i] = init_load_windows;
 }
@@ -64,6 +64,7 @@
 #include <linux/binfmts.h>
 #include <linux/sched/sysctl.h>
 #include <linux/kexec.h>
+#include <linux/futex.h>
 #include <linux/boost_sigkill_free.h>
 
 #include <linux/mount.h>
@@ -134,9 +135,7 @@ static int __maybe_unused two = 2;
 static int __maybe_unused four = 4;
 static unsigned long one_ul = 1;
 static int one_hundred = 100;
-#ifdef CONFIG_HISI_DIRECT_SWAPPINESS
 static int two_hundred = 200;
-#endif
 #ifdef CONFIG_PRINTK
 static int ten_thousand = 10000;
 #endif
@@ -302,6 +301,9 @@ static int max_sched_tunable_scaling = SCHED_TUNABLESCALING_END-1;
 #ifdef CONFIG_COMPACTION
 static int min_extfrag_threshold;
 static int max_extfrag_threshold = 1000;
+#ifdef CONFIG_HISI_PROACTIVE_COMPACTION
+static int max_proactive_order = MAX_ORDER - 1;
+#endif
 #endif
 
 #ifdef CONFIG_SHRINK_MEMORY
@@ -390,6 +392,26 @@ static struct ctl_table kern_table[] = {
 		.mode		= 0644,
 		.proc_handler	= proc_dointvec,
 	},
+	{
+		.procname	= "sched_walt_pred_demand",
+		.data		= &sysctl_sched_walt_pred_demand,
+		.maxlen		= sizeof(unsigned int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &zero,
+		.extra2		= &one,
+	},
+#endif
+#ifdef CONFIG_SCHED_HMP
+	{
+		.procname	= "sched_hmp_energy_aware",
+		.data		= &sysctl_sched_hmp_energy_aware,
+		.maxlen		= sizeof(unsigned int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &zero,
+		.extra2		= &one,
+	},
 #endif
 	{
 		.procname	= "sched_sync_hint_enable",
@@ -900,6 +922,26 @@ static struct ctl_table kern_table[] = {
 		.mode		= 0644,
 		.proc_handler	= proc_dointvec,
 	},
+#ifdef CONFIG_FUTEX
+	{
+		.procname	= "futex_prio_wake",
+		.data		= &sysctl_futex_prio_wake,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &zero,
+		.extra2		= &one,
+	},
+	{
+		.procname	= "futex_wake_boost",
+		.data		= &sysctl_futex_wake_boost,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &zero,
+		.extra2		= &one,
+	},
+#endif
 #if defined CONFIG_PRINTK
 	{
 		.procname	= "printk",
@@ -1500,6 +1542,35 @@ static struct ctl_table vm_table[] = {
 		.extra1		= &zero,
 		.extra2		= &one,
 	},
+#ifdef CONFIG_HISI_PROACTIVE_COMPACTION
+	{
+		.procname	= "compaction_proactiveness",
+		.data		= &sysctl_compaction_proactiveness,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &zero,
+		.extra2		= &one_hundred,
+	},
+	{
+		.procname	= "compaction_proactive_order",
+		.data		= &sysctl_compaction_proactive_order,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &one,
+		.extra2		= &max_proactive_order,
+	},
+	{
+		.procname	= "compaction_proactive_budget",
+		.data		= &sysctl_compaction_proactive_budget,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &zero,
+		.extra2		= &one_hundred,
+	},
+#endif
 
 #endif /* CONFIG_COMPACTION */
 #ifdef CONFIG_SHRINK_MEMORY
@@ -1537,6 +1608,15 @@ static struct ctl_table vm_table[] = {
 		.proc_handler	= percpu_pagelist_fraction_sysctl_handler,
 		.extra1		= &zero,
 	},
+	{
+		.procname	= "percpu_pagelist_cluster_scale",
+		.data		= &percpu_pagelist_cluster_scale,
+		.maxlen		= sizeof(percpu_pagelist_cluster_scale),
+		.mode		= 0644,
+		.proc_handler	= percpu_pagelist_cluster_scale_sysctl_handler,
+		.extra1		= &zero,
+		.extra2		= &two_hundred,
+	},
 #ifdef CONFIG_MMU
 	{
 		.procname	= "max_map_count",
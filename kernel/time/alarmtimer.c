@@ -21,6 +21,7 @@
 #include <linux/rtc.h>
 #include <linux/alarmtimer.h>
 #include <linux/mutex.h>
+#include <linux/moduleparam.h>
 #include <linux/platform_device.h>
 #include <linux/posix-timers.h>
 #include <linux/workqueue.h>
@@ -47,6 +48,10 @@ static DEFINE_SPINLOCK(freezer_delta_lock);
 
 static struct wakeup_source *ws;
 
+/* Windowed alarms that fired early, on a wakeup taken for another one */
+static unsigned int merged_wakeups;
+module_param(merged_wakeups, uint, S_IRUGO);
+
 #ifdef CONFIG_RTC_CLASS
 /* rtc timer and device for setting alarm wakeups at suspend */
 static struct rtc_timer		rtctimer;
@@ -182,6 +187,9 @@ static enum hrtimer_restart alarmtimer_fired(struct hrtimer *timer)
 
 	spin_lock_irqsave(&base->lock, flags);
 	alarmtimer_dequeue(base, alarm);
+	if (alarm->slack &&
+	    base->gettime().tv64 < hrtimer_get_expires_tv64(&alarm->timer))
+		merged_wakeups++;
 	spin_unlock_irqrestore(&base->lock, flags);
 
 	if (alarm->function)
@@ -189,7 +197,8 @@ static enum hrtimer_restart alarmtimer_fired(struct hrtimer *timer)
 
 	spin_lock_irqsave(&base->lock, flags);
 	if (restart != ALARMTIMER_NORESTART) {
-		hrtimer_set_expires(&alarm->timer, alarm->node.expires);
+		hrtimer_set_expires_range_ns(&alarm->timer, alarm->node.expires,
+					     alarm->slack);
 		alarmtimer_enqueue(base, alarm);
 		ret = HRTIMER_RESTART;
 	}
@@ -240,20 +249,30 @@ static int alarmtimer_suspend(struct device *dev)
 	if (!rtc)
 		return 0;
 
-	/* Find the soonest timer to expire*/
+	/*
+	 * Find the soonest timer that has to expire. The queue is ordered by
+	 * the start of the alarms' windows; waking up at the earliest end of
+	 * a window also serves every alarm whose window has begun by then.
+	 */
 	for (i = 0; i < ALARM_NUMTYPE; i++) {
 		struct alarm_base *base = &alarm_bases[i];
 		struct timerqueue_node *next;
+		ktime_t now = base->gettime();
 		ktime_t delta;
 
 		spin_lock_irqsave(&base->lock, flags);
-		next = timerqueue_getnext(&base->timerqueue);
+		for (next = timerqueue_getnext(&base->timerqueue); next;
+		     next = timerqueue_iterate_next(next)) {
+			struct alarm *alarm = container_of(next, struct alarm, node);
+
+			delta = ktime_sub(next->expires, now);
+			if (min.tv64 && delta.tv64 >= min.tv64)
+				break;
+			delta = ktime_add_ns(delta, alarm->slack);
+			if (!min.tv64 || (delta.tv64 < min.tv64))
+				min = delta;
+		}
 		spin_unlock_irqrestore(&base->lock, flags);
-		if (!next)
-			continue;
-		delta = ktime_sub(next->expires, base->gettime());
-		if (!min.tv64 || (delta.tv64 < min.tv64))
-			min = delta;
 	}
 	if (min.tv64 == 0)
 		return 0;
@@ -328,15 +347,20 @@ void alarm_init(struct alarm *alarm, enum alarmtimer_type type,
 	alarm->function = function;
 	alarm->type = type;
 	alarm->state = ALARMTIMER_STATE_INACTIVE;
+	alarm->slack = 0;
 }
 EXPORT_SYMBOL_GPL(alarm_init);
 
 /**
- * alarm_start - Sets an absolute alarm to fire
+ * alarm_start_range - Sets an absolute alarm to fire within a window
  * @alarm: ptr to alarm to set
- * @start: time to run the alarm
+ * @start: earliest time to run the alarm
+ * @slack: length of the window in ns
+ *
+ * The alarm may run anywhere from @start to @start + @slack, so that one
+ * wakeup from suspend serves all alarms whose windows overlap.
  */
-int alarm_start(struct alarm *alarm, ktime_t start)
+int alarm_start_range(struct alarm *alarm, ktime_t start, u64 slack)
 {
 	struct alarm_base *base = &alarm_bases[alarm->type];
 	unsigned long flags;
@@ -344,12 +368,24 @@ int alarm_start(struct alarm *alarm, ktime_t start)
 
 	spin_lock_irqsave(&base->lock, flags);
 	alarm->node.expires = start;
+	alarm->slack = slack;
 	alarmtimer_enqueue(base, alarm);
-	ret = hrtimer_start(&alarm->timer, alarm->node.expires,
-				HRTIMER_MODE_ABS);
+	ret = hrtimer_start_range_ns(&alarm->timer, alarm->node.expires,
+				slack, HRTIMER_MODE_ABS);
 	spin_unlock_irqrestore(&base->lock, flags);
 	return ret;
 }
+EXPORT_SYMBOL_GPL(alarm_start_range);
+
+/**
+ * alarm_start - Sets an absolute alarm to fire
+ * @alarm: ptr to alarm to set
+ * @start: time to run the alarm, delayed by at most the alarm's slack
+ */
+int alarm_start(struct alarm *alarm, ktime_t start)
+{
+	return alarm_start_range(alarm, start, alarm->slack);
+}
 EXPORT_SYMBOL_GPL(alarm_start);
 
 /**
@@ -372,7 +408,8 @@ void alarm_restart(struct alarm *alarm)
 	unsigned long flags;
 
 	spin_lock_irqsave(&base->lock, flags);
-	hrtimer_set_expires(&alarm->timer, alarm->node.expires);
+	hrtimer_set_expires_range_ns(&alarm->timer, alarm->node.expires,
+				     alarm->slack);
 	hrtimer_restart(&alarm->timer);
 	alarmtimer_enqueue(base, alarm);
 	spin_unlock_irqrestore(&base->lock, flags);
@@ -190,6 +190,35 @@ hrtimer_check_target(struct hrtimer *timer, struct hrtimer_clock_base *new_base)
 #endif
 }
 
+#ifdef CONFIG_SCHED_HMP
+extern struct cpumask hmp_slow_cpu_mask;
+
+/*
+ * Timers started by a task whose schedtune group sets a timer slack, the
+ * background apps, go to the first little cpu, so their expiries share
+ * its wakeups instead of each waking a big core. hrtimer_check_target()
+ * still keeps a timer local when the little cpu would not wake up by its
+ * hard expiry.
+ */
+static int hrtimer_target_cpu(int pinned)
+{
+	int cpu = get_nohz_timer_target(pinned);
+	int slow;
+
+	if (pinned || in_interrupt() || !schedtune_timer_slack(current) ||
+	    cpumask_test_cpu(cpu, &hmp_slow_cpu_mask))
+		return cpu;
+
+	slow = cpumask_first_and(&hmp_slow_cpu_mask, cpu_online_mask);
+	return slow < nr_cpu_ids ? slow : cpu;
+}
+#else
+static inline int hrtimer_target_cpu(int pinned)
+{
+	return get_nohz_timer_target(pinned);
+}
+#endif
+
 /*
  * Switch the timer base to the current CPU when possible.
  */
@@ -200,7 +229,7 @@ switch_hrtimer_base(struct hrtimer *timer, struct hrtimer_clock_base *base,
 	struct hrtimer_clock_base *new_base;
 	struct hrtimer_cpu_base *new_cpu_base;
 	int this_cpu = smp_processor_id();
-	int cpu = get_nohz_timer_target(pinned);
+	int cpu = hrtimer_target_cpu(pinned);
 	int basenum = base->index;
 
 again:
@@ -1564,7 +1593,7 @@ long hrtimer_nanosleep(struct timespec *rqtp, struct timespec __user *rmtp,
 	int ret = 0;
 	unsigned long slack;
 
-	slack = current->timer_slack_ns;
+	slack = task_timer_slack(current);
 	if (dl_task(current) || rt_task(current))
 		slack = 0;
 
@@ -237,6 +237,23 @@ struct wq_device;
  * The externally visible workqueue.  It relays the issued work items to
  * the appropriate worker_pool through its pool_workqueues.
  */
+#ifdef CONFIG_WQ_CLUSTER_AFFINE
+enum wq_cluster {
+	WQ_CLUSTER_LITTLE,
+	WQ_CLUSTER_BIG,
+	WQ_NR_CLUSTERS,
+	WQ_CLUSTER_ANY = WQ_NR_CLUSTERS,
+};
+
+static const char * const wq_cluster_names[] = {
+	[WQ_CLUSTER_LITTLE]	= "little",
+	[WQ_CLUSTER_BIG]	= "big",
+	[WQ_CLUSTER_ANY]	= "any",
+};
+
+extern struct cpumask hmp_slow_cpu_mask;
+#endif
+
 struct workqueue_struct {
 	struct list_head	pwqs;		/* WR: all pwqs of this wq */
 	struct list_head	list;		/* PR: list of all workqueues */
@@ -258,6 +275,10 @@ struct workqueue_struct {
 	struct workqueue_attrs	*unbound_attrs;	/* PW: only for unbound wqs */
 	struct pool_workqueue	*dfl_pwq;	/* PW: only for unbound wqs */
 
+#ifdef CONFIG_WQ_CLUSTER_AFFINE
+	atomic64_t		exec_ns[WQ_NR_CLUSTERS]; /* time run on each */
+#endif
+
 #ifdef CONFIG_SYSFS
 	struct wq_device	*wq_dev;	/* I: for sysfs interface */
 #endif
@@ -1989,6 +2010,20 @@ static bool manage_workers(struct worker *worker)
  * CONTEXT:
  * spin_lock_irq(pool->lock) which is released and regrabbed.
  */
+#ifdef CONFIG_WQ_CLUSTER_AFFINE
+/* Charge the run time of a work item to the cluster it finished on. */
+static void wq_account_exec(struct workqueue_struct *wq, u64 start)
+{
+	u64 now = local_clock();
+	int cluster = WQ_CLUSTER_BIG;
+
+	if (cpumask_test_cpu(raw_smp_processor_id(), &hmp_slow_cpu_mask))
+		cluster = WQ_CLUSTER_LITTLE;
+	if (now > start)
+		atomic64_add(now - start, &wq->exec_ns[cluster]);
+}
+#endif
+
 static void process_one_work(struct worker *worker, struct work_struct *work)
 __releases(&pool->lock)
 __acquires(&pool->lock)
@@ -1998,6 +2033,9 @@ __acquires(&pool->lock)
 	bool cpu_intensive = pwq->wq->flags & WQ_CPU_INTENSIVE;
 	int work_color;
 	struct worker *collision;
+#ifdef CONFIG_WQ_CLUSTER_AFFINE
+	u64 exec_start;
+#endif
 #ifdef CONFIG_LOCKDEP
 	/*
 	 * It is permissible to free the struct work_struct from
@@ -2070,8 +2108,14 @@ __acquires(&pool->lock)
 	trace_workqueue_execute_start(work);
 #ifdef CONFIG_HISI_BB
 	worker_hook((u64)(worker->current_func), 0);
+#endif
+#ifdef CONFIG_WQ_CLUSTER_AFFINE
+	exec_start = local_clock();
 #endif
 	worker->current_func(work);
+#ifdef CONFIG_WQ_CLUSTER_AFFINE
+	wq_account_exec(pwq->wq, exec_start);
+#endif
 #ifdef CONFIG_HISI_BB
 	worker_hook((u64)(worker->current_func), 1);
 #endif
@@ -3796,6 +3840,54 @@ out_unlock:
 	put_pwq_unlocked(old_pwq);
 }
 
+#ifdef CONFIG_WQ_CLUSTER_AFFINE
+static void wq_cluster_cpumask(enum wq_cluster cluster, struct cpumask *mask)
+{
+	switch (cluster) {
+	case WQ_CLUSTER_LITTLE:
+		cpumask_copy(mask, &hmp_slow_cpu_mask);
+		break;
+	case WQ_CLUSTER_BIG:
+		cpumask_andnot(mask, cpu_possible_mask, &hmp_slow_cpu_mask);
+		break;
+	default:
+		cpumask_copy(mask, cpu_possible_mask);
+	}
+}
+
+/*
+ * Apply @attrs to a new unbound workqueue, restricted to its default
+ * cluster: the big one for WQ_HIGHPRI workqueues, the little one for all
+ * others.  Without a little cluster this is plain apply_workqueue_attrs().
+ */
+static int apply_workqueue_attrs_cluster(struct workqueue_struct *wq,
+					 const struct workqueue_attrs *attrs)
+{
+	struct workqueue_attrs *tmp;
+	int ret;
+
+	if (cpumask_empty(&hmp_slow_cpu_mask))
+		return apply_workqueue_attrs(wq, attrs);
+
+	tmp = alloc_workqueue_attrs(GFP_KERNEL);
+	if (!tmp)
+		return -ENOMEM;
+
+	copy_workqueue_attrs(tmp, attrs);
+	wq_cluster_cpumask(wq->flags & WQ_HIGHPRI ?
+			   WQ_CLUSTER_BIG : WQ_CLUSTER_LITTLE, tmp->cpumask);
+	ret = apply_workqueue_attrs(wq, tmp);
+	free_workqueue_attrs(tmp);
+	return ret;
+}
+#else
+static inline int apply_workqueue_attrs_cluster(struct workqueue_struct *wq,
+					const struct workqueue_attrs *attrs)
+{
+	return apply_workqueue_attrs(wq, attrs);
+}
+#endif
+
 static int alloc_and_link_pwqs(struct workqueue_struct *wq)
 {
 	bool highpri = wq->flags & WQ_HIGHPRI;
@@ -3820,14 +3912,15 @@ static int alloc_and_link_pwqs(struct workqueue_struct *wq)
 		}
 		return 0;
 	} else if (wq->flags & __WQ_ORDERED) {
-		ret = apply_workqueue_attrs(wq, ordered_wq_attrs[highpri]);
+		ret = apply_workqueue_attrs_cluster(wq, ordered_wq_attrs[highpri]);
 		/* there should only be single pwq for ordering guarantee */
 		WARN(!ret && (wq->pwqs.next != &wq->dfl_pwq->pwqs_node ||
 			      wq->pwqs.prev != &wq->dfl_pwq->pwqs_node),
 		     "ordering guarantee broken for workqueue %s\n", wq->name);
 		return ret;
 	} else {
-		return apply_workqueue_attrs(wq, unbound_std_wq_attrs[highpri]);
+		return apply_workqueue_attrs_cluster(wq,
+						unbound_std_wq_attrs[highpri]);
 	}
 }
 
@@ -4816,6 +4909,7 @@ out_unlock:
  *  id		RO int	: the associated pool ID
  *  nice	RW int	: nice value of the workers
  *  cpumask	RW mask	: bitmask of allowed CPUs for the workers
+ *  cluster	RW str	: little, big or any, a shortcut for cpumask
  */
 struct wq_device {
 	struct workqueue_struct		*wq;
@@ -5005,11 +5099,69 @@ static ssize_t wq_numa_store(struct device *dev, struct device_attribute *attr,
 	return ret ?: count;
 }
 
+#ifdef CONFIG_WQ_CLUSTER_AFFINE
+static ssize_t wq_cluster_show(struct device *dev,
+			       struct device_attribute *attr, char *buf)
+{
+	struct workqueue_struct *wq = dev_to_wq(dev);
+	const char *name = "custom";
+	cpumask_var_t mask;
+	int i;
+
+	if (!alloc_cpumask_var(&mask, GFP_KERNEL))
+		return -ENOMEM;
+
+	mutex_lock(&wq->mutex);
+	for (i = 0; i < ARRAY_SIZE(wq_cluster_names); i++) {
+		wq_cluster_cpumask(i, mask);
+		if (cpumask_equal(mask, wq->unbound_attrs->cpumask)) {
+			name = wq_cluster_names[i];
+			break;
+		}
+	}
+	mutex_unlock(&wq->mutex);
+
+	free_cpumask_var(mask);
+	return scnprintf(buf, PAGE_SIZE, "%s\n", name);
+}
+
+static ssize_t wq_cluster_store(struct device *dev,
+				struct device_attribute *attr,
+				const char *buf, size_t count)
+{
+	struct workqueue_struct *wq = dev_to_wq(dev);
+	struct workqueue_attrs *attrs;
+	int i, ret;
+
+	for (i = 0; i < ARRAY_SIZE(wq_cluster_names); i++)
+		if (sysfs_streq(buf, wq_cluster_names[i]))
+			break;
+	if (i == ARRAY_SIZE(wq_cluster_names))
+		return -EINVAL;
+
+	attrs = wq_sysfs_prep_attrs(wq);
+	if (!attrs)
+		return -ENOMEM;
+
+	wq_cluster_cpumask(i, attrs->cpumask);
+	if (cpumask_empty(attrs->cpumask))
+		ret = -ENODEV;
+	else
+		ret = apply_workqueue_attrs(wq, attrs);
+
+	free_workqueue_attrs(attrs);
+	return ret ?: count;
+}
+#endif
+
 static struct device_attribute wq_sysfs_unbound_attrs[] = {
 	__ATTR(pool_ids, 0444, wq_pool_ids_show, NULL),
 	__ATTR(nice, 0644, wq_nice_show, wq_nice_store),
 	__ATTR(cpumask, 0644, wq_cpumask_show, wq_cpumask_store),
 	__ATTR(numa, 0644, wq_numa_show, wq_numa_store),
+#ifdef CONFIG_WQ_CLUSTER_AFFINE
+	__ATTR(cluster, 0644, wq_cluster_show, wq_cluster_store),
+#endif
 	__ATTR_NULL,
 };
 
@@ -5018,9 +5170,51 @@ static struct bus_type wq_subsys = {
 	.dev_groups			= wq_sysfs_groups,
 };
 
+#ifdef CONFIG_WQ_CLUSTER_AFFINE
+/* Time the work items of every workqueue have run on each cluster */
+static ssize_t wq_cluster_stats_show(struct device *dev,
+				     struct device_attribute *attr, char *buf)
+{
+	struct workqueue_struct *wq;
+	int written;
+
+	written = scnprintf(buf, PAGE_SIZE, "%-24s %12s %12s\n",
+			    "workqueue", "little_ms", "big_ms");
+
+	rcu_read_lock_sched();
+	list_for_each_entry_rcu(wq, &workqueues, list) {
+		u64 little = atomic64_read(&wq->exec_ns[WQ_CLUSTER_LITTLE]);
+		u64 big = atomic64_read(&wq->exec_ns[WQ_CLUSTER_BIG]);
+
+		if (!little && !big)
+			continue;
+		written += scnprintf(buf + written, PAGE_SIZE - written,
+				     "%-24s %12llu %12llu\n", wq->name,
+				     div_u64(little, NSEC_PER_MSEC),
+				     div_u64(big, NSEC_PER_MSEC));
+	}
+	rcu_read_unlock_sched();
+
+	return written;
+}
+
+static struct device_attribute wq_sysfs_cluster_stats_attr =
+	__ATTR(cluster_stats, 0444, wq_cluster_stats_show, NULL);
+#endif
+
 static int __init wq_sysfs_init(void)
 {
-	return subsys_virtual_register(&wq_subsys, NULL);
+	int err;
+
+	err = subsys_virtual_register(&wq_subsys, NULL);
+	if (err)
+		return err;
+
+#ifdef CONFIG_WQ_CLUSTER_AFFINE
+	err = device_create_file(wq_subsys.dev_root,
+				 &wq_sysfs_cluster_stats_attr);
+#endif
+	return err;
 }
 core_initcall(wq_sysfs_init);
 
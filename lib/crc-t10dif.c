@@ -27,6 +27,10 @@ __u16 crc_t10dif(const unsigned char *buffer, size_t len)
 	} desc;
 	int err;
 
+#ifdef CONFIG_CRC_T10DIF_ARM64
+	if (crc_t10dif_use_pmull)
+		return crc_t10dif_pmull(0, buffer, len);
+#endif
 	if (static_key_false(&crct10dif_fallback))
 		return crc_t10dif_generic(0, buffer, len);
 
@@ -184,20 +184,36 @@ static inline u32 __pure crc32_le_generic(u32 crc, unsigned char const *p,
 #if CRC_LE_BITS == 1
 u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len)
 {
+#ifdef CONFIG_CRC32_ARM64
+	if (crc32_use_arm64)
+		return crc32_le_arm64(crc, p, len);
+#endif
 	return crc32_le_generic(crc, p, len, NULL, CRCPOLY_LE);
 }
 u32 __pure __crc32c_le(u32 crc, unsigned char const *p, size_t len)
 {
+#ifdef CONFIG_CRC32_ARM64
+	if (crc32_use_arm64)
+		return __crc32c_le_arm64(crc, p, len);
+#endif
 	return crc32_le_generic(crc, p, len, NULL, CRC32C_POLY_LE);
 }
 #else
 u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len)
 {
+#ifdef CONFIG_CRC32_ARM64
+	if (crc32_use_arm64)
+		return crc32_le_arm64(crc, p, len);
+#endif
 	return crc32_le_generic(crc, p, len,
 			(const u32 (*)[256])crc32table_le, CRCPOLY_LE);
 }
 u32 __pure __crc32c_le(u32 crc, unsigned char const *p, size_t len)
 {
+#ifdef CONFIG_CRC32_ARM64
+	if (crc32_use_arm64)
+		return __crc32c_le_arm64(crc, p, len);
+#endif
 	return crc32_le_generic(crc, p, len,
 			(const u32 (*)[256])crc32ctable_le, CRC32C_POLY_LE);
 }
@@ -325,6 +325,10 @@ int lz4_decompress_unknownoutputsize(const unsigned char *src, size_t src_len,
 	int ret = -1;
 	int out_len = 0;
 
+#if !defined(STATIC) && defined(CONFIG_LZ4_DECOMPRESS_NEON)
+	if (lz4_use_neon)
+		return lz4_decompress_neon(src, src_len, dest, dest_len);
+#endif
 	out_len = lz4_uncompress_unknownoutputsize(src, dest, src_len,
 					*dest_len);
 	if (out_len < 0)
@@ -0,0 +1,130 @@
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/random.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/lz4.h>
+
+#define TEST_PAGES	256
+#define TEST_ROUNDS	8
+
+/*
+ * Fill @page with a mix of random bytes and short repeated patterns, one
+ * in @random_every bytes runs random. Periods 1..15 exercise the
+ * overlapping match copy.
+ */
+static void lz4_neon_test_fill(u8 *page, unsigned int random_every)
+{
+	unsigned int i = 0, len, period;
+	u32 r;
+
+	while (i < PAGE_SIZE) {
+		r = prandom_u32();
+		len = min_t(unsigned int, (r & 0xff) + 1, PAGE_SIZE - i);
+		if ((r >> 8) % random_every) {
+			period = ((r >> 16) % 24) + 1;
+			for (; len; len--, i++)
+				page[i] = i >= period ? page[i - period] : r >> 24;
+		} else {
+			prandom_bytes(page + i, len);
+			i += len;
+		}
+	}
+}
+
+static int lz4_neon_test_pass(u8 *orig, u8 *comp, size_t *comp_len,
+			      u8 *out, bool neon, u64 *ns)
+{
+	ktime_t start;
+	size_t len;
+	int i, round;
+
+	lz4_use_neon = neon;
+	start = ktime_get();
+	for (round = 0; round < TEST_ROUNDS; round++) {
+		for (i = 0; i < TEST_PAGES; i++) {
+			len = PAGE_SIZE;
+			if (lz4_decompress_unknownoutputsize(comp + i * 2 * PAGE_SIZE,
+					comp_len[i], out, &len) ||
+			    len != PAGE_SIZE ||
+			    memcmp(out, orig + i * PAGE_SIZE, PAGE_SIZE)) {
+				pr_err("lz4_neon_test: %s page %d mismatch\n",
+				       neon ? "neon" : "generic", i);
+				return -EINVAL;
+			}
+		}
+	}
+	*ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	return 0;
+}
+
+static unsigned long lz4_neon_test_mbps(u64 ns)
+{
+	u64 bytes = (u64)TEST_PAGES * TEST_ROUNDS * PAGE_SIZE;
+
+	return ns ? div64_u64(bytes * 1000, ns) : 0;
+}
+
+static int __init lz4_neon_test_init(void)
+{
+	static const unsigned int mixes[] = { 64, 16, 4, 1 };
+	bool saved = lz4_use_neon;
+	size_t *comp_len;
+	u8 *orig, *comp, *out;
+	void *wrkmem;
+	u64 ns_generic, ns_neon;
+	int i, m, ret = -ENOMEM;
+
+	/* comp holds each page in a slot of twice its size */
+	orig = vmalloc(TEST_PAGES * PAGE_SIZE);
+	comp = vmalloc(TEST_PAGES * 2 * PAGE_SIZE);
+	out = kmalloc(PAGE_SIZE, GFP_KERNEL);
+	comp_len = kcalloc(TEST_PAGES, sizeof(*comp_len), GFP_KERNEL);
+	wrkmem = kmalloc(LZ4_MEM_COMPRESS, GFP_KERNEL);
+	if (!orig || !comp || !out || !comp_len || !wrkmem)
+		goto out;
+
+	for (m = 0; m < ARRAY_SIZE(mixes); m++) {
+		for (i = 0; i < TEST_PAGES; i++) {
+			lz4_neon_test_fill(orig + i * PAGE_SIZE, mixes[m]);
+			ret = lz4_compress(orig + i * PAGE_SIZE, PAGE_SIZE,
+					   comp + i * 2 * PAGE_SIZE,
+					   &comp_len[i], wrkmem);
+			if (ret)
+				goto out;
+		}
+
+		ret = lz4_neon_test_pass(orig, comp, comp_len, out, false,
+					 &ns_generic);
+		if (!ret)
+			ret = lz4_neon_test_pass(orig, comp, comp_len, out,
+						 true, &ns_neon);
+		if (ret)
+			goto out;
+
+		pr_info("lz4_neon_test: random 1/%u: generic %lu MB/s, neon %lu MB/s\n",
+			mixes[m], lz4_neon_test_mbps(ns_generic),
+			lz4_neon_test_mbps(ns_neon));
+	}
+	ret = -EAGAIN; /* Fail will directly unload the module */
+out:
+	lz4_use_neon = saved;
+	kfree(wrkmem);
+	kfree(comp_len);
+	kfree(out);
+	vfree(comp);
+	vfree(orig);
+	return ret;
+}
+
+static void __exit lz4_neon_test_exit(void)
+{
+}
+
+module_init(lz4_neon_test_init)
+module_exit(lz4_neon_test_exit)
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("NEON lz4 decompression test");
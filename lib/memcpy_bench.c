@@ -0,0 +1,134 @@
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/mm.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/cpumask.h>
+#include <linux/topology.h>
+#include <linux/workqueue.h>
+
+#define BENCH_BUF_SIZE	(4 << 20)
+#define BENCH_BYTES	(64 << 20)	/* copied per size class */
+
+static const size_t bench_sizes[] = {
+	64, 256, 1024, 4096, 16384, 65536, 262144, 1048576, BENCH_BUF_SIZE,
+};
+
+struct bench_ctx {
+	u8 *src;
+	u8 *dst;
+	struct page *pages[2];
+};
+
+/* MB/s from bytes and ns; 1 byte/ns is 1000 MB/s */
+static unsigned long bench_mbps(u64 bytes, u64 ns)
+{
+	return ns ? div64_u64(bytes * 1000, ns) : 0;
+}
+
+static long bench_on_cpu(void *arg)
+{
+	struct bench_ctx *ctx = arg;
+	void *page_dst = page_address(ctx->pages[0]);
+	void *page_src = page_address(ctx->pages[1]);
+	unsigned int cpu = smp_processor_id();
+	ktime_t start;
+	u64 ns, n, i;
+	int s;
+
+	for (s = 0; s < ARRAY_SIZE(bench_sizes); s++) {
+		size_t size = bench_sizes[s];
+		size_t off = 0;
+
+		n = BENCH_BYTES / size;
+		start = ktime_get();
+		for (i = 0; i < n; i++) {
+			/* walk the buffer so small copies are not all L1 hits */
+			memcpy(ctx->dst + off, ctx->src + off, size);
+			off += size;
+			if (off + size > BENCH_BUF_SIZE)
+				off = 0;
+		}
+		ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+		pr_info("memcpy_bench: cpu%u cluster %d memcpy %7zu: %lu MB/s\n",
+			cpu, topology_physical_package_id(cpu), size,
+			bench_mbps(n * size, ns));
+		cond_resched();
+	}
+
+	n = BENCH_BYTES / PAGE_SIZE;
+	start = ktime_get();
+	for (i = 0; i < n; i++)
+		copy_page(page_dst, page_src);
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	pr_info("memcpy_bench: cpu%u cluster %d copy_page: %lu MB/s\n",
+		cpu, topology_physical_package_id(cpu),
+		bench_mbps(n * PAGE_SIZE, ns));
+
+	start = ktime_get();
+	for (i = 0; i < n; i++)
+		clear_page(page_dst);
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	pr_info("memcpy_bench: cpu%u cluster %d clear_page: %lu MB/s\n",
+		cpu, topology_physical_package_id(cpu),
+		bench_mbps(n * PAGE_SIZE, ns));
+	return 0;
+}
+
+static int __init memcpy_bench_init(void)
+{
+	struct bench_ctx ctx = { NULL };
+	cpumask_var_t seen;
+	int cpu, other, ret = -ENOMEM;
+
+	if (!zalloc_cpumask_var(&seen, GFP_KERNEL))
+		return -ENOMEM;
+	ctx.src = vmalloc(BENCH_BUF_SIZE);
+	ctx.dst = vmalloc(BENCH_BUF_SIZE);
+	ctx.pages[0] = alloc_page(GFP_KERNEL);
+	ctx.pages[1] = alloc_page(GFP_KERNEL);
+	if (!ctx.src || !ctx.dst || !ctx.pages[0] || !ctx.pages[1])
+		goto out;
+	memset(ctx.src, 0x5a, BENCH_BUF_SIZE);
+	memset(ctx.dst, 0, BENCH_BUF_SIZE);
+
+	/* one run on the first online cpu of each cluster */
+	get_online_cpus();
+	for_each_online_cpu(cpu) {
+		bool first = true;
+
+		for_each_cpu(other, seen) {
+			if (topology_physical_package_id(other) ==
+			    topology_physical_package_id(cpu))
+				first = false;
+		}
+		if (!first)
+			continue;
+		cpumask_set_cpu(cpu, seen);
+		work_on_cpu(cpu, bench_on_cpu, &ctx);
+	}
+	put_online_cpus();
+
+	ret = -EAGAIN; /* Fail will directly unload the module */
+out:
+	if (ctx.pages[1])
+		__free_page(ctx.pages[1]);
+	if (ctx.pages[0])
+		__free_page(ctx.pages[0]);
+	vfree(ctx.dst);
+	vfree(ctx.src);
+	free_cpumask_var(seen);
+	return ret;
+}
+
+static void __exit memcpy_bench_exit(void)
+{
+}
+
+module_init(memcpy_bench_init)
+module_exit(memcpy_bench_exit)
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("memcpy, copy_page and clear_page throughput per cluster");
@@ -432,10 +432,16 @@ static inline unsigned int get_limit(struct rq_wb *rwb, unsigned long rw)
 	 * set, then it's WB_SYNC_ALL writeback, and we'll use the max
 	 * limit for that. If the write is marked as a background write,
 	 * then use the idle limit, or go to normal if we haven't had
-	 * competing IO for a bit.
+	 * competing IO for a bit. While a (foreground) sync request is
+	 * waiting, tasks stuck in balance_dirty_pages() don't get the max
+	 * limit either.
 	 */
 	/*lint -save -e438 -e529*/
-	if ((rw & REQ_HIPRIO) || atomic_read(&rwb->bdi->wb.dirty_sleeping))
+	if (rw & REQ_HIPRIO)
+		limit = rwb->wb_max;
+	else if (ACCESS_ONCE(rwb->sync_issue))
+		limit = rwb->wb_background;
+	else if (atomic_read(&rwb->bdi->wb.dirty_sleeping))
 	/*lint -restore*/
 		limit = rwb->wb_max;
 	else if ((rw & REQ_BG) || close_io(rwb)) {
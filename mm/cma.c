@@ -35,6 +35,7 @@
 #include <linux/cma.h>
 #include <linux/highmem.h>
 #include <linux/io.h>
+#include <linux/ktime.h>
 #include <trace/events/cma.h>
 
 #include "cma.h"
@@ -46,6 +47,7 @@
 struct cma cma_areas[MAX_CMA_AREAS];
 unsigned cma_area_count;
 static DEFINE_MUTEX(cma_mutex);
+unsigned long cma_hold_expires = INITIAL_JIFFIES;
 
 phys_addr_t cma_get_base(const struct cma *cma)
 {
@@ -354,6 +356,28 @@ err:
 	return ret;
 }
 
+#ifdef CONFIG_CMA_DEBUGFS
+static void cma_account_alloc(struct cma *cma, ktime_t start,
+				unsigned long busy, struct page *page)
+{
+	s64 ms = ktime_ms_delta(ktime_get(), start);
+	int i = 0;
+
+	while (i < CMA_ALLOC_LAT_BUCKETS - 1 && ms >= (1LL << i))
+		i++;
+
+	atomic_long_inc(&cma->alloc_lat[i]);
+	atomic_long_add(busy, &cma->alloc_busy);
+	if (!page)
+		atomic_long_inc(&cma->alloc_fail);
+}
+#else
+static inline void cma_account_alloc(struct cma *cma, ktime_t start,
+				unsigned long busy, struct page *page)
+{
+}
+#endif
+
 /**
  * cma_alloc() - allocate pages from contiguous area
  * @cma:   Contiguous memory region for which the allocation is performed.
@@ -372,7 +396,9 @@ struct page *cma_alloc(struct cma *cma, size_t count, unsigned int align)
 #endif
 	unsigned long mask, offset, pfn, start = 0;
 	unsigned long bitmap_maxno, bitmap_no, bitmap_count;
+	unsigned long busy = 0;
 	struct page *page = NULL;
+	ktime_t start_time;
 	int ret;
 
 	if (!cma || !cma->count)
@@ -384,6 +410,8 @@ struct page *cma_alloc(struct cma *cma, size_t count, unsigned int align)
 	if (!count)
 		return NULL;
 
+	start_time = ktime_get();
+
 	mask = cma_bitmap_aligned_mask(cma, align);
 	offset = cma_bitmap_aligned_offset(cma, align);
 	bitmap_maxno = cma_bitmap_maxno(cma);
@@ -427,6 +455,7 @@ struct page *cma_alloc(struct cma *cma, size_t count, unsigned int align)
 			 __func__, pfn_to_page(pfn));
 		/* try again with a bit different memory target */
 		start = bitmap_no + mask + 1;
+		busy++;
 #ifdef CONFIG_HISI_CMA_DEBUG
 		fail_nr++;
 #endif
@@ -444,6 +473,7 @@ struct page *cma_alloc(struct cma *cma, size_t count, unsigned int align)
 	}
 #endif
 
+	cma_account_alloc(cma, start_time, busy, page);
 	trace_cma_alloc(page ? pfn : -1UL, page, count, align);
 
 	pr_debug("%s(): returned %p\n", __func__, page);
@@ -482,3 +512,72 @@ bool cma_release(struct cma *cma, const struct page *pages, unsigned int count)
 
 	return true;
 }
+
+/**
+ * cma_evacuate() - move pages out of the free part of a contiguous area
+ * @cma: Contiguous memory area to evacuate.
+ *
+ * Movable pages the page allocator placed in @cma are migrated out one
+ * pageblock at a time, and each block goes straight back to the free
+ * lists. A cma_alloc() that follows soon after then finds the range
+ * already empty instead of migrating on its own time. Blocks that are
+ * busy (pinned pages, writeback) are skipped rather than retried.
+ *
+ * Returns the number of pages moved out.
+ */
+unsigned long cma_evacuate(struct cma *cma)
+{
+	unsigned long nr_pages, nr_bits, bitmap_maxno, bitmap_no, pfn;
+	unsigned long evacuated = 0;
+	int ret;
+
+	if (!cma || !cma->count)
+		return 0;
+
+	nr_pages = max_t(unsigned long, pageblock_nr_pages,
+				1UL << cma->order_per_bit);
+	nr_bits = cma_bitmap_pages_to_bits(cma, nr_pages);
+	bitmap_maxno = cma_bitmap_maxno(cma);
+
+	for (bitmap_no = 0; bitmap_no + nr_bits <= bitmap_maxno;
+						bitmap_no += nr_bits) {
+		mutex_lock(&cma->lock);
+		if (find_next_bit(cma->bitmap, bitmap_no + nr_bits,
+					bitmap_no) < bitmap_no + nr_bits) {
+			/* partly allocated, nothing movable to gain here */
+			mutex_unlock(&cma->lock);
+			continue;
+		}
+		bitmap_set(cma->bitmap, bitmap_no, nr_bits);
+		mutex_unlock(&cma->lock);
+
+		pfn = cma->base_pfn + (bitmap_no << cma->order_per_bit);
+		mutex_lock(&cma_mutex);
+		ret = alloc_contig_range(pfn, pfn + nr_pages, MIGRATE_CMA);
+		mutex_unlock(&cma_mutex);
+		if (!ret) {
+			free_contig_range(pfn, nr_pages);
+			evacuated += nr_pages;
+		}
+		cma_clear_bitmap(cma, pfn, nr_pages);
+
+		cond_resched();
+	}
+
+	pr_debug("%s(cma %p): %lu pages evacuated\n", __func__,
+						(void *)cma, evacuated);
+	return evacuated;
+}
+
+/**
+ * cma_hold_placement() - keep user pages out of CMA for a while
+ * @msecs: How long new ___GFP_CMA allocations avoid CMA areas.
+ *
+ * Used around cma_evacuate() so that the pages just moved out, or new
+ * ones that may end up pinned, do not land in the area again before the
+ * allocation the evacuation was made for.
+ */
+void cma_hold_placement(unsigned int msecs)
+{
+	ACCESS_ONCE(cma_hold_expires) = jiffies + msecs_to_jiffies(msecs);
+}
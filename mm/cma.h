@@ -1,6 +1,8 @@
 #ifndef __MM_CMA_H__
 #define __MM_CMA_H__
 
+#define CMA_ALLOC_LAT_BUCKETS	8
+
 struct cma {
 	unsigned long   base_pfn;
 	unsigned long   count;
@@ -10,6 +12,10 @@ struct cma {
 #ifdef CONFIG_CMA_DEBUGFS
 	struct hlist_head mem_head;
 	spinlock_t mem_head_lock;
+	/* cma_alloc() latency, bucket i counts calls under 2^i ms */
+	atomic_long_t alloc_lat[CMA_ALLOC_LAT_BUCKETS];
+	atomic_long_t alloc_busy;
+	atomic_long_t alloc_fail;
 #endif
 };
 
@@ -11,6 +11,7 @@
 #include <linux/kernel.h>
 #include <linux/slab.h>
 #include <linux/mm_types.h>
+#include <linux/seq_file.h>
 
 #include "cma.h"
 
@@ -68,6 +69,34 @@ static int cma_maxchunk_get(void *data, u64 *val)
 }
 DEFINE_SIMPLE_ATTRIBUTE(cma_maxchunk_fops, cma_maxchunk_get, NULL, "%llu\n");
 
+static int cma_alloc_latency_show(struct seq_file *s, void *unused)
+{
+	struct cma *cma = s->private;
+	int i;
+
+	for (i = 0; i < CMA_ALLOC_LAT_BUCKETS - 1; i++)
+		seq_printf(s, "<%dms: %ld\n", 1 << i,
+				atomic_long_read(&cma->alloc_lat[i]));
+	seq_printf(s, ">=%dms: %ld\n", 1 << (CMA_ALLOC_LAT_BUCKETS - 2),
+			atomic_long_read(&cma->alloc_lat[i]));
+	seq_printf(s, "busy_retries: %ld\n", atomic_long_read(&cma->alloc_busy));
+	seq_printf(s, "failed: %ld\n", atomic_long_read(&cma->alloc_fail));
+
+	return 0;
+}
+
+static int cma_alloc_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, cma_alloc_latency_show, inode->i_private);
+}
+
+static const struct file_operations cma_alloc_latency_fops = {
+	.open = cma_alloc_latency_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static void cma_add_to_cma_mem_list(struct cma *cma, struct cma_mem *mem)
 {
 	spin_lock(&cma->mem_head_lock);
@@ -184,6 +213,8 @@ static void cma_debugfs_add_one(struct cma *cma, int idx)
 				&cma->order_per_bit, &cma_debugfs_fops);
 	debugfs_create_file("used", S_IRUGO, tmp, cma, &cma_used_fops);
 	debugfs_create_file("maxchunk", S_IRUGO, tmp, cma, &cma_maxchunk_fops);
+	debugfs_create_file("alloc_latency", S_IRUGO, tmp, cma,
+				&cma_alloc_latency_fops);
 
 	u32s = DIV_ROUND_UP(cma_bitmap_maxno(cma), BITS_PER_BYTE * sizeof(u32));
 	debugfs_create_u32_array("bitmap", S_IRUGO, tmp, (u32*)cma->bitmap, u32s);
@@ -21,6 +21,7 @@
 #include <linux/kasan.h>
 #include <linux/kthread.h>
 #include <linux/freezer.h>
+#include <linux/fb.h>
 #include "internal.h"
 
 #ifdef CONFIG_COMPACTION
@@ -1211,6 +1212,34 @@ static isolate_migrate_t isolate_migratepages(struct zone *zone,
 	return cc->nr_migratepages ? ISOLATE_SUCCESS : ISOLATE_NONE;
 }
 
+#ifdef CONFIG_HISI_PROACTIVE_COMPACTION
+/*
+ * Proactive compaction. Between the wakeups asked for by allocators
+ * (direct compaction, kswapd, the ION smart pool) kcompactd keeps the
+ * fragmentation score of each zone, the percentage of its free memory
+ * in blocks below sysctl_compaction_proactive_order, at or under
+ * 100 - sysctl_compaction_proactiveness. It only does so while the
+ * screen is off or nothing else is runnable, and spends at most
+ * sysctl_compaction_proactive_budget percent of one cpu on it.
+ */
+int sysctl_compaction_proactiveness = 20;
+int sysctl_compaction_proactive_order = 4;
+int sysctl_compaction_proactive_budget = 5;
+
+#define PROACTIVE_INTERVAL_MS		500
+/* a zone is only compacted once it is this far above the target */
+#define PROACTIVE_HYSTERESIS		10
+/* intervals skipped after a run that did not lower the score */
+#define PROACTIVE_DEFER_INTERVALS	16
+
+static bool proactive_screen_off;
+
+static unsigned int proactive_score_target(void)
+{
+	return 100 - ACCESS_ONCE(sysctl_compaction_proactiveness);
+}
+#endif
+
 static int __compact_finished(struct zone *zone, struct compact_control *cc,
 			    const int migratetype)
 {
@@ -1239,6 +1268,21 @@ static int __compact_finished(struct zone *zone, struct compact_control *cc,
 		return COMPACT_COMPLETE;
 	}
 
+#ifdef CONFIG_HISI_PROACTIVE_COMPACTION
+	/*
+	 * Proactive runs stop at the target score, when the budget is spent
+	 * or when an allocator asked kcompactd for something more urgent.
+	 */
+	if (cc->proactive) {
+		if (ACCESS_ONCE(zone->zone_pgdat->kcompactd_max_order) ||
+		    time_after(jiffies, cc->deadline) ||
+		    fragmentation_score(zone, cc->order) <=
+						proactive_score_target())
+			return COMPACT_PARTIAL;
+		return COMPACT_CONTINUE;
+	}
+#endif
+
 	/*
 	 * order == -1 is expected when compacting via
 	 * /proc/sys/vm/compact_memory
@@ -1886,6 +1930,115 @@ void wakeup_kcompactd(pg_data_t *pgdat, int order, int classzone_idx)
 	wake_up_interruptible(&pgdat->kcompactd_wait);
 }
 
+#ifdef CONFIG_HISI_PROACTIVE_COMPACTION
+static bool kcompactd_proactive_allowed(void)
+{
+	/* kcompactd itself is the one runnable task on an idle system */
+	return ACCESS_ONCE(proactive_screen_off) || nr_running() <= 1;
+}
+
+/*
+ * One proactive pass over the zones of @pgdat. Returns how long to sleep
+ * before the next one, stretched so that compaction time stays within
+ * the cpu budget.
+ */
+static long kcompactd_proactive(pg_data_t *pgdat, unsigned int *defer)
+{
+	long interval = msecs_to_jiffies(PROACTIVE_INTERVAL_MS);
+	int budget = ACCESS_ONCE(sysctl_compaction_proactive_budget);
+	int order = ACCESS_ONCE(sysctl_compaction_proactive_order);
+	unsigned int target = proactive_score_target();
+	unsigned long start = jiffies;
+	long spent;
+	int zoneid;
+
+	if (!sysctl_compaction_proactiveness || !budget)
+		return interval;
+	if (*defer) {
+		(*defer)--;
+		return interval;
+	}
+	if (!kcompactd_proactive_allowed())
+		return interval;
+
+	for (zoneid = 0; zoneid < pgdat->nr_zones; zoneid++) {
+		struct zone *zone = &pgdat->node_zones[zoneid];
+		/*
+		 * Skip hints are honoured so that the cached scanner
+		 * positions carry each budget limited run on from where
+		 * the previous one stopped.
+		 */
+		struct compact_control cc = {
+			.order = order,
+			.classzone_idx = zoneid,
+			.mode = MIGRATE_SYNC_LIGHT,
+			.proactive = true,
+		};
+		unsigned int score;
+
+		if (!populated_zone(zone))
+			continue;
+
+		score = fragmentation_score(zone, order);
+		if (score <= target + PROACTIVE_HYSTERESIS)
+			continue;
+
+		if (compaction_suitable(zone, order, 0, zoneid) !=
+							COMPACT_CONTINUE)
+			continue;
+
+		cc.deadline = jiffies +
+			max(interval * budget / 100, 1L);
+		cc.zone = zone;
+		INIT_LIST_HEAD(&cc.freepages);
+		INIT_LIST_HEAD(&cc.migratepages);
+
+		compact_zone(zone, &cc);
+
+		VM_BUG_ON(!list_empty(&cc.freepages));
+		VM_BUG_ON(!list_empty(&cc.migratepages));
+
+		if (fragmentation_score(zone, order) <= target) {
+			count_compact_event(COMPACTPROACTIVE_SUCCESS);
+		} else {
+			count_compact_event(COMPACTPROACTIVE_FAIL);
+			/* no progress, the rest is likely unmovable */
+			if (fragmentation_score(zone, order) >= score)
+				*defer = PROACTIVE_DEFER_INTERVALS;
+		}
+
+		if (kcompactd_work_requested(pgdat))
+			break;
+	}
+
+	spent = jiffies - start;
+	return max(interval, spent * (100 - budget) / budget);
+}
+
+#ifdef CONFIG_FB
+static int kcompactd_fb_notifier_call(struct notifier_block *nb,
+				      unsigned long event, void *data)
+{
+	struct fb_event *evdata = data;
+	int blank;
+
+	if (event != FB_EVENT_BLANK || !evdata || !evdata->data)
+		return NOTIFY_DONE;
+
+	blank = *(int *)evdata->data;
+	if (blank == FB_BLANK_UNBLANK)
+		ACCESS_ONCE(proactive_screen_off) = false;
+	else if (blank == FB_BLANK_POWERDOWN)
+		ACCESS_ONCE(proactive_screen_off) = true;
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block kcompactd_fb_notifier = {
+	.notifier_call = kcompactd_fb_notifier_call,
+};
+#endif
+#endif /* CONFIG_HISI_PROACTIVE_COMPACTION */
+
 /*
  * The background compaction daemon, started as a kernel thread
  * from the init process.
@@ -1894,6 +2047,10 @@ static int kcompactd(void *p)
 {
 	pg_data_t *pgdat = (pg_data_t*)p;
 	struct task_struct *tsk = current;
+#ifdef CONFIG_HISI_PROACTIVE_COMPACTION
+	long timeout = msecs_to_jiffies(PROACTIVE_INTERVAL_MS);
+	unsigned int defer = 0;
+#endif
 
 	const struct cpumask *cpumask = cpumask_of_node(pgdat->node_id);
 
@@ -1907,8 +2064,16 @@ static int kcompactd(void *p)
 
 	while (!kthread_should_stop()) {
 		trace_mm_compaction_kcompactd_sleep(pgdat->node_id);
+#ifdef CONFIG_HISI_PROACTIVE_COMPACTION
+		if (!wait_event_freezable_timeout(pgdat->kcompactd_wait,
+				kcompactd_work_requested(pgdat), timeout)) {
+			timeout = kcompactd_proactive(pgdat, &defer);
+			continue;
+		}
+#else
 		wait_event_freezable(pgdat->kcompactd_wait,
 				kcompactd_work_requested(pgdat));
+#endif
 
 		kcompactd_do_work(pgdat);
 	}
@@ -1981,6 +2146,9 @@ static int __init kcompactd_init(void)
 	for_each_node_state(nid, N_MEMORY)
 		kcompactd_run(nid);
 	hotcpu_notifier(cpu_callback, 0);
+#if defined(CONFIG_HISI_PROACTIVE_COMPACTION) && defined(CONFIG_FB)
+	fb_register_client(&kcompactd_fb_notifier);
+#endif
 	return 0;
 }
 subsys_initcall(kcompactd_init)
@@ -35,6 +35,7 @@
 #include <linux/cleancache.h>
 #include <linux/rmap.h>
 #include <linux/hisi/page_tracker.h>
+#include <linux/launch_prefetch.h>
 #include "internal.h"
 
 #ifdef CONFIG_TASK_PROTECT_LRU
@@ -1926,6 +1927,7 @@ int filemap_fault(struct vm_area_struct *vma, struct vm_fault *vmf)
 		task_clear_in_pagefault(current);
 	} else if (!page) {
 		/* No page in the page cache at all */
+		launch_prefetch_record_fault(file, offset);
 		task_set_in_pagefault(current);
 		do_sync_mmap_readahead(vma, ra, file, offset);
 		task_clear_in_pagefault(current);
@@ -2128,6 +2130,7 @@ const struct vm_operations_struct generic_file_vm_ops = {
 	.fault		= filemap_fault,
 	.map_pages	= filemap_map_pages,
 	.page_mkwrite	= filemap_page_mkwrite,
+	.speculative	= true,
 };
 
 /* This is used for a general mmap of a disk file */
@@ -8,36 +8,155 @@
 
 #include <linux/mm.h>
 #include <linux/hugetlb.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
 #include <linux/boost_sigkill_free.h>
 
 #include <asm/tlb.h>
-#include "internal.h"
+#include "../internal.h"
+
+/*
+ * Address spaces with at least FAST_FREE_PARALLEL_MIN resident are torn
+ * down by up to FAST_FREE_WORKERS workers besides the victim, each
+ * taking FAST_FREE_CHUNK of a vma at a time.
+ */
+#define FAST_FREE_CHUNK		(16UL << 20)
+#define FAST_FREE_PARALLEL_MIN	(64UL << 20)
+#define FAST_FREE_WORKERS	3
 
 unsigned int sysctl_boost_sigkill_free;
 
-static void __fast_free_user_mem(struct mm_struct *mm)
+static struct workqueue_struct *fast_free_wq;
+
+struct fast_free_ctl {
+	struct mm_struct *mm;
+	spinlock_t lock;
+	struct vm_area_struct *vma;	/* next vma to unmap */
+	unsigned long addr;		/* and where in it */
+};
+
+struct fast_free_worker {
+	struct work_struct work;
+	struct fast_free_ctl *ctl;
+};
+
+static bool fast_free_vma(struct vm_area_struct *vma)
+{
+	if (is_vm_hugetlb_page(vma))
+		return false;
+	/*
+	 * mlocked VMAs require explicit munlocking before unmap.
+	 * Let's keep it simple here and skip such VMAs.
+	 */
+	if (vma->vm_flags & VM_LOCKED)
+		return false;
+
+	return vma_is_anonymous(vma) || !(vma->vm_flags & VM_SHARED);
+}
+
+/* hand out the next range to unmap, at most up to a chunk boundary */
+static bool fast_free_next(struct fast_free_ctl *ctl,
+			   struct vm_area_struct **vmap,
+			   unsigned long *start, unsigned long *end)
 {
 	struct vm_area_struct *vma;
-	struct mmu_gather tlb;
+	bool found = false;
 
-	tlb_gather_mmu(&tlb, mm, 0, -1);
-	for (vma = mm->mmap; vma; vma = vma->vm_next) {
-		if (is_vm_hugetlb_page(vma))
-			continue;
-		/*
-		 * mlocked VMAs require explicit munlocking before unmap.
-		 * Let's keep it simple here and skip such VMAs.
-		 */
-		if (vma->vm_flags & VM_LOCKED)
+	spin_lock(&ctl->lock);
+	while ((vma = ctl->vma)) {
+		if (!fast_free_vma(vma) || ctl->addr >= vma->vm_end) {
+			ctl->vma = vma->vm_next;
+			if (ctl->vma)
+				ctl->addr = ctl->vma->vm_start;
 			continue;
-
-		if (vma_is_anonymous(vma) || !(vma->vm_flags & VM_SHARED))
-			unmap_page_range(&tlb, vma, vma->vm_start,
-					 vma->vm_end, NULL);
+		}
+		*vmap = vma;
+		*start = ctl->addr;
+		*end = min(vma->vm_end, ALIGN(ctl->addr + 1, FAST_FREE_CHUNK));
+		ctl->addr = *end;
+		found = true;
+		break;
 	}
+	spin_unlock(&ctl->lock);
+
+	return found;
+}
+
+static void fast_free_ranges(struct fast_free_ctl *ctl)
+{
+	struct vm_area_struct *vma;
+	unsigned long start, end;
+	struct mmu_gather tlb;
+
+	tlb_gather_mmu(&tlb, ctl->mm, 0, -1);
+	while (fast_free_next(ctl, &vma, &start, &end))
+		unmap_page_range(&tlb, vma, start, end, NULL);
 	tlb_finish_mmu(&tlb, 0, -1);
 }
 
+static void fast_free_workfn(struct work_struct *work)
+{
+	struct fast_free_worker *worker =
+		container_of(work, struct fast_free_worker, work);
+
+	fast_free_ranges(worker->ctl);
+}
+
+/*
+ * Called with mmap_sem held for reading, which keeps the vmas around
+ * until all workers are done. The ranges they unmap never overlap.
+ */
+static void __fast_free_user_mem(struct mm_struct *mm)
+{
+	struct fast_free_worker workers[FAST_FREE_WORKERS];
+	struct fast_free_ctl ctl = {
+		.mm = mm,
+		.vma = mm->mmap,
+		.addr = mm->mmap ? mm->mmap->vm_start : 0,
+	};
+	int i, nr = 0;
+
+	spin_lock_init(&ctl.lock);
+	if (fast_free_wq &&
+	    (get_mm_rss(mm) << PAGE_SHIFT) >= FAST_FREE_PARALLEL_MIN)
+		nr = min_t(int, FAST_FREE_WORKERS, num_online_cpus() - 1);
+
+	for (i = 0; i < nr; i++) {
+		INIT_WORK_ONSTACK(&workers[i].work, fast_free_workfn);
+		workers[i].ctl = &ctl;
+		queue_work(fast_free_wq, &workers[i].work);
+	}
+
+	fast_free_ranges(&ctl);
+
+	for (i = 0; i < nr; i++) {
+		flush_work(&workers[i].work);
+		destroy_work_on_stack(&workers[i].work);
+	}
+}
+
+/*
+ * Release the private memory of a killed process's @mm. Either the victim
+ * or the lmk reaper gets here first, the other one finds MMF_FAST_FREEING
+ * set. With @trylock a contended mmap_sem makes it return false so the
+ * caller can retry instead of waiting on the victim.
+ */
+bool fast_free_mm(struct mm_struct *mm, bool trylock)
+{
+	if (trylock) {
+		if (!down_read_trylock(&mm->mmap_sem))
+			return false;
+	} else {
+		down_read(&mm->mmap_sem);
+	}
+
+	if (!test_and_set_bit(MMF_FAST_FREEING, &mm->flags))
+		__fast_free_user_mem(mm);
+
+	up_read(&mm->mmap_sem);
+	return true;
+}
+
 void fast_free_user_mem(void)
 {
 	struct mm_struct *mm = current->mm;
@@ -45,13 +164,14 @@ void fast_free_user_mem(void)
 	if (!mm)
 		return;
 
-	down_read(&mm->mmap_sem);
-	if (test_and_set_bit(MMF_FAST_FREEING, &mm->flags)) {
-		up_read(&mm->mmap_sem);
-		return;
-	}
-
-	__fast_free_user_mem(mm);
+	fast_free_mm(mm, false);
+}
 
-	up_read(&mm->mmap_sem);
+static int __init fast_free_init(void)
+{
+	/* without it every address space is torn down by its victim alone */
+	fast_free_wq = alloc_workqueue("fast_free", WQ_UNBOUND | WQ_HIGHPRI,
+				       FAST_FREE_WORKERS);
+	return 0;
 }
+late_initcall(fast_free_init);
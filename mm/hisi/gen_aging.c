@@ -0,0 +1,431 @@
+/*
+ * gen_aging.c
+ *
+ * Generation based aging and eviction of cached processes.
+ *
+ * With two LRU lists per zone, reclaim sees the file pages of the
+ * foreground app and the anon pages of cached apps in one age order that
+ * only says when a page was last rotated. On 2-3GB devices that ends up
+ * evicting the foreground working set while cached apps keep cold anon
+ * memory resident.
+ *
+ * A kthread walks the page tables of processes at or above min_adj in
+ * batches, and ages every mapped page by one generation per walk using
+ * the accessed bit of the pte and the page flags the LRU already has:
+ *
+ *   gen 0: accessed since the last walk    (pte young -> PG_referenced)
+ *   gen 1: not accessed for one walk        (PG_referenced cleared)
+ *   gen 2: not accessed for two walks       (moved to the inactive list)
+ *   gen 3: not accessed for three walks     (evictable)
+ *
+ * When kswapd wakes, the thread evicts gen 3 pages of the least important
+ * cached processes first, anon and file alike, for the free page deficit
+ * of the node. Pages mapped by more than one process are only aged, the
+ * other mappers may be using them.
+ *
+ * Copyright (c) 2001-2021, Huawei Tech. Co., Ltd. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
+#include <linux/mm.h>
+#include <linux/mm_inline.h>
+#include <linux/hugetlb.h>
+#include <linux/huge_mm.h>
+#include <linux/rmap.h>
+#include <linux/swap.h>
+#include <linux/sched.h>
+#include <linux/sort.h>
+#include <linux/vmstat.h>
+#include <linux/kobject.h>
+#include <linux/sysfs.h>
+
+#include "gen_aging.h"
+
+#define GEN_AGING_MAX_TASKS	64
+#define GEN_AGING_MAX_EVICT	8192	/* pages per kswapd wakeup */
+
+static unsigned int gen_aging_enabled = 1;
+static int gen_aging_min_adj = 900;
+static unsigned int gen_aging_interval_ms = 5000;
+
+static DECLARE_WAIT_QUEUE_HEAD(gen_aging_wait);
+static struct task_struct *gen_aging_task;
+static atomic_long_t gen_aging_evict_req = ATOMIC_LONG_INIT(0);
+
+static struct {
+	atomic64_t passes;
+	atomic64_t tasks;
+	atomic64_t scanned;
+	atomic64_t young;
+	atomic64_t deactivated;
+	atomic64_t evict_anon;
+	atomic64_t evict_file;
+	atomic64_t evicted;
+} gen_stat;
+
+struct gen_walk {
+	bool evict;
+	unsigned long nr_to_evict;
+	unsigned long nr_evicted;
+	unsigned long scanned;
+	unsigned long young;
+	unsigned long deactivated;
+};
+
+struct gen_task {
+	struct task_struct *p;
+	short adj;
+};
+
+static void gen_putback(struct list_head *list)
+{
+	struct page *page;
+
+	while (!list_empty(list)) {
+		page = list_first_entry(list, struct page, lru);
+		list_del(&page->lru);
+		putback_lru_page(page);
+	}
+}
+
+static unsigned long gen_evict(struct list_head *list,
+			       struct vm_area_struct *vma)
+{
+#ifdef CONFIG_HISI_SWAP_ZDATA
+	unsigned nr_writedblock = 0;
+
+	return reclaim_pages_from_list(list, vma, false, &nr_writedblock);
+#else
+	return reclaim_pages_from_list(list, vma);
+#endif
+}
+
+static int gen_age_pte_range(pmd_t *pmd, unsigned long addr,
+			     unsigned long end, struct mm_walk *walk)
+{
+	struct gen_walk *gw = walk->private;
+	struct vm_area_struct *vma = walk->vma;
+	LIST_HEAD(deact_list);
+	LIST_HEAD(evict_list);
+	pte_t *pte;
+	spinlock_t *ptl;
+	struct page *page;
+	int nr_evict;
+
+	split_huge_page_pmd(vma, addr, pmd);
+	if (pmd_trans_unstable(pmd))
+		return 0;
+cont:
+	nr_evict = 0;
+	pte = pte_offset_map_lock(vma->vm_mm, pmd, addr, &ptl);
+	for (; addr != end; pte++, addr += PAGE_SIZE) {
+		if (!pte_present(*pte))
+			continue;
+
+		page = vm_normal_page(vma, addr, *pte);
+		if (!page || !PageLRU(page) || PageUnevictable(page))
+			continue;
+
+#ifdef CONFIG_TASK_PROTECT_LRU
+		if (PageProtect(page))
+			continue;
+#endif
+		gw->scanned++;
+
+		/* gen 0 */
+		if (ptep_test_and_clear_young(vma, addr, pte)) {
+			SetPageReferenced(page);
+			gw->young++;
+			continue;
+		}
+		/* gen 0 -> 1 */
+		if (TestClearPageReferenced(page))
+			continue;
+		/* other mappers may be using it, leave it to the LRU */
+		if (page_mapcount(page) != 1)
+			continue;
+		/* gen 1 -> 2 */
+		if (PageActive(page)) {
+			if (!isolate_lru_page(page)) {
+				ClearPageActive(page);
+				list_add(&page->lru, &deact_list);
+				gw->deactivated++;
+			}
+			continue;
+		}
+		/* gen 3 */
+		if (!gw->evict || isolate_lru_page(page))
+			continue;
+
+		list_add(&page->lru, &evict_list);
+		inc_zone_page_state(page, NR_ISOLATED_ANON +
+				page_is_file_cache(page));
+		if (page_is_file_cache(page))
+			atomic64_inc(&gen_stat.evict_file);
+		else
+			atomic64_inc(&gen_stat.evict_anon);
+		if (++nr_evict >= SWAP_CLUSTER_MAX)
+			break;
+	}
+	pte_unmap_unlock(pte - 1, ptl);
+
+	gen_putback(&deact_list);
+	if (nr_evict)
+		gw->nr_evicted += gen_evict(&evict_list, vma);
+
+	/* a positive return ends walk_page_range() early */
+	if (gw->evict && gw->nr_evicted >= gw->nr_to_evict)
+		return 1;
+	if (addr != end)
+		goto cont;
+
+	cond_resched();
+	return 0;
+}
+
+static int gen_age_test_walk(unsigned long start, unsigned long end,
+			     struct mm_walk *walk)
+{
+	struct vm_area_struct *vma = walk->vma;
+
+	if (vma->vm_flags & (VM_LOCKED | VM_PFNMAP | VM_IO))
+		return 0;
+	if (is_vm_hugetlb_page(vma))
+		return 0;
+	return 1;
+}
+
+static void gen_age_mm(struct mm_struct *mm, struct gen_walk *gw)
+{
+	struct mm_walk walk = {
+		.pmd_entry = gen_age_pte_range,
+		.test_walk = gen_age_test_walk,
+		.mm = mm,
+		.private = gw,
+	};
+
+	/* never wait behind a fault or an mmap of the process */
+	if (!down_read_trylock(&mm->mmap_sem))
+		return;
+	walk_page_range(0, mm->highest_vm_end, &walk);
+	up_read(&mm->mmap_sem);
+}
+
+static int gen_task_cmp(const void *a, const void *b)
+{
+	const struct gen_task *ta = a, *tb = b;
+
+	/* least important first */
+	return tb->adj - ta->adj;
+}
+
+static int gen_collect_tasks(struct gen_task *tasks)
+{
+	struct task_struct *p;
+	int nr = 0, i;
+	short adj;
+
+	rcu_read_lock();
+	for_each_process(p) {
+		if (p->flags & PF_KTHREAD)
+			continue;
+		adj = p->signal->oom_score_adj;
+		if (adj < gen_aging_min_adj || !p->mm)
+			continue;
+		tasks[nr].p = p;
+		tasks[nr].adj = adj;
+		if (++nr == GEN_AGING_MAX_TASKS)
+			break;
+	}
+	for (i = 0; i < nr; i++)
+		get_task_struct(tasks[i].p);
+	rcu_read_unlock();
+
+	sort(tasks, nr, sizeof(*tasks), gen_task_cmp, NULL);
+	return nr;
+}
+
+static void gen_aging_pass(unsigned long nr_to_evict)
+{
+	static struct gen_task tasks[GEN_AGING_MAX_TASKS];
+	struct gen_walk gw = {
+		.evict = nr_to_evict > 0,
+		.nr_to_evict = nr_to_evict,
+	};
+	struct mm_struct *mm;
+	int nr, i;
+
+	nr = gen_collect_tasks(tasks);
+	for (i = 0; i < nr; i++) {
+		if (!(gw.evict && gw.nr_evicted >= gw.nr_to_evict)) {
+			mm = get_task_mm(tasks[i].p);
+			if (mm) {
+				gen_age_mm(mm, &gw);
+				mmput(mm);
+			}
+		}
+		put_task_struct(tasks[i].p);
+	}
+
+	atomic64_inc(&gen_stat.passes);
+	atomic64_add(nr, &gen_stat.tasks);
+	atomic64_add(gw.scanned, &gen_stat.scanned);
+	atomic64_add(gw.young, &gen_stat.young);
+	atomic64_add(gw.deactivated, &gen_stat.deactivated);
+	atomic64_add(gw.nr_evicted, &gen_stat.evicted);
+}
+
+static int gen_aging_thread(void *data)
+{
+	unsigned long nr_to_evict;
+
+	set_freezable();
+	set_user_nice(current, 5);
+
+	while (!kthread_should_stop()) {
+		wait_event_freezable_timeout(gen_aging_wait,
+			atomic_long_read(&gen_aging_evict_req) ||
+			kthread_should_stop(),
+			msecs_to_jiffies(ACCESS_ONCE(gen_aging_interval_ms)));
+
+		nr_to_evict = atomic_long_xchg(&gen_aging_evict_req, 0);
+		if (!ACCESS_ONCE(gen_aging_enabled))
+			continue;
+		gen_aging_pass(nr_to_evict);
+	}
+
+	return 0;
+}
+
+void gen_aging_kswapd_wake(pg_data_t *pgdat)
+{
+	unsigned long deficit = 0, free, high;
+	struct zone *zone;
+	int i;
+
+	if (!gen_aging_task || !ACCESS_ONCE(gen_aging_enabled))
+		return;
+
+	for (i = 0; i < pgdat->nr_zones; i++) {
+		zone = pgdat->node_zones + i;
+		if (!populated_zone(zone))
+			continue;
+		free = zone_page_state(zone, NR_FREE_PAGES);
+		high = high_wmark_pages(zone);
+		if (free < high)
+			deficit += high - free;
+	}
+	if (!deficit)
+		return;
+
+	/* kswapd keeps balancing meanwhile, this only takes work off it */
+	atomic_long_set(&gen_aging_evict_req,
+			min_t(unsigned long, deficit, GEN_AGING_MAX_EVICT));
+	wake_up(&gen_aging_wait);
+}
+
+static u64 gen_kswapd_runtime_ns(void)
+{
+	u64 ns = 0;
+	int nid;
+
+	for_each_node_state(nid, N_MEMORY) {
+		struct task_struct *tsk = NODE_DATA(nid)->kswapd;
+
+		if (tsk)
+			ns += tsk->se.sum_exec_runtime;
+	}
+	return ns;
+}
+
+static ssize_t stats_show(struct kobject *kobj, struct kobj_attribute *attr,
+			  char *buf)
+{
+	return scnprintf(buf, PAGE_SIZE,
+		"passes %lld\ntasks %lld\nscanned %lld\nyoung %lld\n"
+		"deactivated %lld\nisolated_anon %lld\nisolated_file %lld\n"
+		"evicted %lld\nrefaults %lu\nkswapd_runtime_ms %llu\n",
+		(long long)atomic64_read(&gen_stat.passes),
+		(long long)atomic64_read(&gen_stat.tasks),
+		(long long)atomic64_read(&gen_stat.scanned),
+		(long long)atomic64_read(&gen_stat.young),
+		(long long)atomic64_read(&gen_stat.deactivated),
+		(long long)atomic64_read(&gen_stat.evict_anon),
+		(long long)atomic64_read(&gen_stat.evict_file),
+		(long long)atomic64_read(&gen_stat.evicted),
+		global_page_state(WORKINGSET_REFAULT),
+		div_u64(gen_kswapd_runtime_ns(), NSEC_PER_MSEC));
+}
+
+#define GEN_AGING_ATTR_RW(_name, _min, _max)				\
+static ssize_t _name##_show(struct kobject *kobj,			\
+			    struct kobj_attribute *attr, char *buf)	\
+{									\
+	return scnprintf(buf, PAGE_SIZE, "%d\n", (int)gen_aging_##_name);	\
+}									\
+static ssize_t _name##_store(struct kobject *kobj,			\
+			     struct kobj_attribute *attr,		\
+			     const char *buf, size_t count)		\
+{									\
+	int val;							\
+									\
+	if (kstrtoint(buf, 10, &val) || val < (_min) || val > (_max))	\
+		return -EINVAL;						\
+	gen_aging_##_name = val;					\
+	return count;							\
+}									\
+static struct kobj_attribute _name##_attr = __ATTR_RW(_name)
+
+GEN_AGING_ATTR_RW(enabled, 0, 1);
+GEN_AGING_ATTR_RW(min_adj, 0, 1000);
+GEN_AGING_ATTR_RW(interval_ms, 100, 600000);
+static struct kobj_attribute stats_attr = __ATTR_RO(stats);
+
+static struct attribute *gen_aging_attrs[] = {
+	&enabled_attr.attr,
+	&min_adj_attr.attr,
+	&interval_ms_attr.attr,
+	&stats_attr.attr,
+	NULL,
+};
+
+static struct attribute_group gen_aging_attr_group = {
+	.attrs = gen_aging_attrs,
+	.name = "gen_aging",
+};
+
+static int __init gen_aging_init(void)
+{
+	struct task_struct *tsk;
+	int ret;
+
+	ret = sysfs_create_group(mm_kobj, &gen_aging_attr_group);
+	if (ret) {
+		pr_err("gen_aging: sysfs register failed %d\n", ret);
+		return ret;
+	}
+
+	tsk = kthread_run(gen_aging_thread, NULL, "kgenaged");
+	if (IS_ERR(tsk)) {
+		sysfs_remove_group(mm_kobj, &gen_aging_attr_group);
+		return PTR_ERR(tsk);
+	}
+	gen_aging_task = tsk;
+
+	return 0;
+}
+module_init(gen_aging_init);
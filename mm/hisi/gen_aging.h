@@ -0,0 +1,34 @@
+/*
+ * gen_aging.h
+ *
+ * Generation based aging of cached processes, reclaim side interface
+ *
+ * Copyright (c) 2001-2021, Huawei Tech. Co., Ltd. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef GEN_AGING_H
+#define GEN_AGING_H
+
+#include <linux/mmzone.h>
+
+#ifdef CONFIG_HISI_GEN_AGING
+/* kswapd is about to balance @pgdat, evict old generations first */
+extern void gen_aging_kswapd_wake(pg_data_t *pgdat);
+#else
+static inline void gen_aging_kswapd_wake(pg_data_t *pgdat)
+{
+}
+#endif
+
+#endif
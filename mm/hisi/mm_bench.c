@@ -0,0 +1,923 @@
+/*
+ * mm_bench.c
+ *
+ * Benchmarks of the memory subsystem: zram swap-out and swap-in, the
+ * compression ratio of each algorithm on the same data, direct compaction
+ * latency, reclaim under pressure and the time from killing a process to
+ * its memory being freed.
+ *
+ * A scenario runs in the context of the task writing its name to
+ * /sys/kernel/debug/mm_bench/run, and anon working sets are mapped into
+ * that task for the duration of the write. Reading the file shows the
+ * report of the last run of each scenario. Sizes and page contents are
+ * set by the module parameters, and all random sequences start from
+ * "seed", so the same load can be replayed on another build.
+ *
+ * Copyright (c) 2001-2021, Huawei Tech. Co., Ltd. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <linux/debugfs.h>
+#include <linux/delay.h>
+#include <linux/fs.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/lz4.h>
+#include <linux/lzo.h>
+#include <linux/mm.h>
+#include <linux/mman.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/mutex.h>
+#include <linux/pagemap.h>
+#include <linux/random.h>
+#include <linux/rmap.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/swap.h>
+#include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+#include <linux/vmstat.h>
+
+static unsigned int anon_mb = 64;
+static unsigned int file_mb = 64;
+static char file_path[128];
+static unsigned int same_pct = 10;
+static unsigned int random_pct = 30;
+static unsigned int pressure_mb = 256;
+static unsigned int compact_order = 4;
+static unsigned int compact_allocs = 64;
+static int lmk_pid;
+static unsigned int seed = 1;
+
+module_param(anon_mb, uint, S_IRUGO | S_IWUSR);
+module_param(file_mb, uint, S_IRUGO | S_IWUSR);
+module_param_string(file_path, file_path, sizeof(file_path),
+		    S_IRUGO | S_IWUSR);
+module_param(same_pct, uint, S_IRUGO | S_IWUSR);
+module_param(random_pct, uint, S_IRUGO | S_IWUSR);
+module_param(pressure_mb, uint, S_IRUGO | S_IWUSR);
+module_param(compact_order, uint, S_IRUGO | S_IWUSR);
+module_param(compact_allocs, uint, S_IRUGO | S_IWUSR);
+module_param(lmk_pid, int, S_IRUGO | S_IWUSR);
+module_param(seed, uint, S_IRUGO | S_IWUSR);
+
+enum bench_scenario {
+	BENCH_SWAP,
+	BENCH_COMPRESS,
+	BENCH_COMPACT,
+	BENCH_RECLAIM,
+	BENCH_LMK,
+	BENCH_NR,
+};
+
+static const char * const bench_name[BENCH_NR] = {
+	"swap", "compress", "compact", "reclaim", "lmk",
+};
+
+#define BENCH_REPORT_LEN	2048
+#define BENCH_LMK_TIMEOUT_MS	10000
+
+struct bench_report {
+	size_t len;
+	char buf[BENCH_REPORT_LEN];
+};
+
+static DEFINE_MUTEX(bench_lock);
+static struct bench_report bench_reports[BENCH_NR];
+
+static __printf(2, 3) void bench_printf(struct bench_report *r,
+					const char *fmt, ...)
+{
+	va_list args;
+
+	va_start(args, fmt);
+	r->len += vscnprintf(r->buf + r->len, sizeof(r->buf) - r->len,
+			     fmt, args);
+	va_end(args);
+}
+
+/* latency histogram, same layout for every scenario */
+#define BENCH_BUCKETS		12
+
+static const u64 bench_bucket_us[BENCH_BUCKETS - 1] = {
+	1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 10000,
+};
+
+struct bench_hist {
+	u64 count;
+	u64 total_ns;
+	u64 max_ns;
+	u64 hist[BENCH_BUCKETS];
+};
+
+static void bench_hist_add(struct bench_hist *h, ktime_t start)
+{
+	u64 ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	u64 us = div_u64(ns, NSEC_PER_USEC);
+	int b;
+
+	for (b = 0; b < BENCH_BUCKETS - 1; b++) {
+		if (us < bench_bucket_us[b])
+			break;
+	}
+	h->hist[b]++;
+	h->count++;
+	h->total_ns += ns;
+	if (ns > h->max_ns)
+		h->max_ns = ns;
+}
+
+static void bench_hist_print(struct bench_report *r, const char *name,
+			     struct bench_hist *h)
+{
+	int b;
+
+	if (!h->count)
+		return;
+
+	bench_printf(r, "%-12s %8llu %9llu %9llu ", name, h->count,
+		     div64_u64(h->total_ns, h->count * NSEC_PER_USEC),
+		     div_u64(h->max_ns, NSEC_PER_USEC));
+	for (b = 0; b < BENCH_BUCKETS; b++)
+		bench_printf(r, " %6llu", h->hist[b]);
+	bench_printf(r, "\n");
+}
+
+static void bench_hist_header(struct bench_report *r)
+{
+	bench_printf(r, "%-12s %8s %9s %9s   <1us   <2us   <5us  <10us  <20us  <50us <100us <200us <500us   <1ms  <10ms >=10ms\n",
+		     "latency", "count", "avg(us)", "max(us)");
+}
+
+/* KB/s of @bytes moved in @ns */
+static u64 bench_kbps(u64 bytes, u64 ns)
+{
+	if (!ns)
+		return 0;
+	return div64_u64((bytes >> 10) * NSEC_PER_SEC, ns);
+}
+
+static unsigned long bench_event(enum vm_event_item item)
+{
+	unsigned long sum = 0;
+	int cpu;
+
+	for_each_online_cpu(cpu)
+		sum += per_cpu(vm_event_states, cpu).event[item];
+	return sum;
+}
+
+/*
+ * Fill one page of a working set. same_pct of the pages repeat a single
+ * word; the others start with random_pct percent random words, which do
+ * not compress, and end with a short repeating pattern, which does.
+ */
+static void bench_fill_page(u32 *p, unsigned long idx, struct rnd_state *rnd)
+{
+	unsigned int i, nr_rand;
+
+	if (prandom_u32_state(rnd) % 100 < same_pct) {
+		for (i = 0; i < PAGE_SIZE / sizeof(u32); i++)
+			p[i] = (u32)idx;
+		return;
+	}
+
+	nr_rand = PAGE_SIZE / sizeof(u32) * min(random_pct, 100U) / 100;
+	for (i = 0; i < nr_rand; i++)
+		p[i] = prandom_u32_state(rnd);
+	for (; i < PAGE_SIZE / sizeof(u32); i++)
+		p[i] = i & 0xff;
+}
+
+/* an anon working set mapped into the current task */
+struct bench_anon {
+	unsigned long addr;
+	unsigned long nr_pages;
+};
+
+static int bench_anon_map(struct bench_anon *wa, unsigned int mb)
+{
+	struct rnd_state rnd;
+	unsigned long i;
+	void *buf;
+	int err = 0;
+
+	wa->nr_pages = (unsigned long)mb << (20 - PAGE_SHIFT);
+	if (!wa->nr_pages)
+		return -EINVAL;
+
+	wa->addr = vm_mmap(NULL, 0, wa->nr_pages << PAGE_SHIFT,
+			   PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+			   0);
+	if (IS_ERR_VALUE(wa->addr))
+		return (int)wa->addr;
+
+	buf = (void *)__get_free_page(GFP_KERNEL);
+	if (!buf) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	prandom_seed_state(&rnd, seed);
+	for (i = 0; i < wa->nr_pages; i++) {
+		bench_fill_page(buf, i, &rnd);
+		if (copy_to_user((void __user *)(wa->addr + (i << PAGE_SHIFT)),
+				 buf, PAGE_SIZE)) {
+			err = -EFAULT;
+			break;
+		}
+		if (fatal_signal_pending(current)) {
+			err = -EINTR;
+			break;
+		}
+		cond_resched();
+	}
+	free_page((unsigned long)buf);
+out:
+	if (err)
+		vm_munmap(wa->addr, wa->nr_pages << PAGE_SHIFT);
+	return err;
+}
+
+static void bench_anon_unmap(struct bench_anon *wa)
+{
+	vm_munmap(wa->addr, wa->nr_pages << PAGE_SHIFT);
+}
+
+static unsigned long bench_evict(struct list_head *list,
+				 struct vm_area_struct *vma)
+{
+#ifdef CONFIG_HISI_SWAP_ZDATA
+	unsigned nr_writedblock = 0;
+
+	return reclaim_pages_from_list(list, vma, false, &nr_writedblock);
+#else
+	return reclaim_pages_from_list(list, vma);
+#endif
+}
+
+struct bench_walk {
+	bool reclaim;
+	unsigned long nr_present;
+	unsigned long nr_reclaimed;
+};
+
+static int bench_pte_range(pmd_t *pmd, unsigned long addr, unsigned long end,
+			   struct mm_walk *walk)
+{
+	struct bench_walk *bw = walk->private;
+	struct vm_area_struct *vma = walk->vma;
+	LIST_HEAD(page_list);
+	spinlock_t *ptl;
+	struct page *page;
+	pte_t *pte;
+	int isolated;
+
+	split_huge_page_pmd(vma, addr, pmd);
+	if (pmd_trans_unstable(pmd))
+		return 0;
+cont:
+	isolated = 0;
+	pte = pte_offset_map_lock(vma->vm_mm, pmd, addr, &ptl);
+	for (; addr != end; pte++, addr += PAGE_SIZE) {
+		if (!pte_present(*pte))
+			continue;
+		bw->nr_present++;
+		if (!bw->reclaim)
+			continue;
+
+		page = vm_normal_page(vma, addr, *pte);
+		if (!page || !PageAnon(page) || isolate_lru_page(page))
+			continue;
+
+		list_add(&page->lru, &page_list);
+		inc_zone_page_state(page, NR_ISOLATED_ANON);
+		if (++isolated >= SWAP_CLUSTER_MAX)
+			break;
+	}
+	pte_unmap_unlock(pte - 1, ptl);
+
+	if (isolated)
+		bw->nr_reclaimed += bench_evict(&page_list, vma);
+	if (addr != end)
+		goto cont;
+
+	cond_resched();
+	return 0;
+}
+
+/* Swap out the whole set with @reclaim, else count its resident pages */
+static void bench_anon_walk(struct bench_anon *wa, struct bench_walk *bw)
+{
+	struct mm_struct *mm = current->mm;
+	struct mm_walk walk = {
+		.pmd_entry = bench_pte_range,
+		.mm = mm,
+		.private = bw,
+	};
+
+	/* pages still in the per-cpu pagevecs can't be isolated */
+	if (bw->reclaim)
+		lru_add_drain_all();
+
+	down_read(&mm->mmap_sem);
+	walk_page_range(wa->addr, wa->addr + (wa->nr_pages << PAGE_SHIFT),
+			&walk);
+	up_read(&mm->mmap_sem);
+}
+
+/* Read one byte of every page, in @order if given; returns elapsed ns */
+static s64 bench_anon_touch(struct bench_anon *wa, u32 *order,
+			    struct bench_hist *h)
+{
+	ktime_t start = ktime_get(), t;
+	unsigned long i, idx;
+	char c;
+
+	for (i = 0; i < wa->nr_pages; i++) {
+		idx = order ? order[i] : i;
+		t = ktime_get();
+		if (get_user(c, (char __user *)(wa->addr + (idx << PAGE_SHIFT))))
+			return -EFAULT;
+		bench_hist_add(h, t);
+		if (fatal_signal_pending(current))
+			return -EINTR;
+	}
+	return ktime_to_ns(ktime_sub(ktime_get(), start));
+}
+
+/* swap the anon set out, then back in sequentially and in random order */
+static int bench_run_swap(struct bench_report *r)
+{
+	struct bench_anon wa;
+	struct bench_walk bw;
+	struct bench_hist *h;
+	struct rnd_state rnd;
+	unsigned long pswpout, pswpin, i, j;
+	u32 *order, tmp;
+	ktime_t start;
+	s64 ns;
+	int pass, err;
+
+	h = kcalloc(2, sizeof(*h), GFP_KERNEL);
+	if (!h)
+		return -ENOMEM;
+	err = bench_anon_map(&wa, anon_mb);
+	if (err)
+		goto out_free;
+
+	order = vmalloc(wa.nr_pages * sizeof(u32));
+	if (!order) {
+		err = -ENOMEM;
+		goto out_unmap;
+	}
+	prandom_seed_state(&rnd, seed);
+	for (i = 0; i < wa.nr_pages; i++)
+		order[i] = i;
+	for (i = wa.nr_pages - 1; i > 0; i--) {
+		j = prandom_u32_state(&rnd) % (i + 1);
+		tmp = order[i];
+		order[i] = order[j];
+		order[j] = tmp;
+	}
+
+	bench_printf(r, "anon set %u MB, same-filled %u%%, random %u%%\n",
+		     anon_mb, same_pct, random_pct);
+	for (pass = 0; pass < 2; pass++) {
+		memset(&bw, 0, sizeof(bw));
+		bw.reclaim = true;
+		pswpout = bench_event(PSWPOUT);
+		start = ktime_get();
+		bench_anon_walk(&wa, &bw);
+		ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+		pswpout = bench_event(PSWPOUT) - pswpout;
+		bench_printf(r, "swap-out: %lu pages reclaimed, %lu swapped, %llu ms, %llu KB/s\n",
+			     bw.nr_reclaimed, pswpout,
+			     div_u64(ns, NSEC_PER_MSEC),
+			     bench_kbps((u64)bw.nr_reclaimed << PAGE_SHIFT,
+					ns));
+
+		pswpin = bench_event(PSWPIN);
+		ns = bench_anon_touch(&wa, pass ? order : NULL, &h[pass]);
+		if (ns < 0) {
+			err = ns;
+			break;
+		}
+		pswpin = bench_event(PSWPIN) - pswpin;
+		bench_printf(r, "swap-in %s: %lu swapped in, %llu ms, %llu KB/s\n",
+			     pass ? "random" : "sequential", pswpin,
+			     div_u64(ns, NSEC_PER_MSEC),
+			     bench_kbps((u64)wa.nr_pages << PAGE_SHIFT, ns));
+	}
+
+	bench_hist_header(r);
+	bench_hist_print(r, "seq fault", &h[0]);
+	bench_hist_print(r, "rand fault", &h[1]);
+
+	vfree(order);
+out_unmap:
+	bench_anon_unmap(&wa);
+out_free:
+	kfree(h);
+	return err;
+}
+
+struct bench_algo {
+	const char *name;
+	size_t wrkmem;
+	int (*compress)(const u8 *src, u8 *dst, size_t *dst_len, void *wrk);
+	int (*decompress)(const u8 *src, size_t src_len, u8 *dst,
+			  size_t *dst_len);
+};
+
+static int bench_lzo_compress(const u8 *src, u8 *dst, size_t *dst_len,
+			      void *wrk)
+{
+	return lzo1x_1_compress(src, PAGE_SIZE, dst, dst_len, wrk);
+}
+
+static int bench_lzo_decompress(const u8 *src, size_t src_len, u8 *dst,
+				size_t *dst_len)
+{
+	return lzo1x_decompress_safe(src, src_len, dst, dst_len);
+}
+
+static int bench_lz4_compress(const u8 *src, u8 *dst, size_t *dst_len,
+			      void *wrk)
+{
+	return lz4_compress(src, PAGE_SIZE, dst, dst_len, wrk);
+}
+
+static int bench_lz4hc_compress(const u8 *src, u8 *dst, size_t *dst_len,
+				void *wrk)
+{
+	return lz4hc_compress(src, PAGE_SIZE, dst, dst_len, wrk);
+}
+
+static int bench_lz4_decompress(const u8 *src, size_t src_len, u8 *dst,
+				size_t *dst_len)
+{
+	return lz4_decompress_unknownoutputsize(src, src_len, dst, dst_len);
+}
+
+static const struct bench_algo bench_algos[] = {
+	{ "lzo", LZO1X_1_MEM_COMPRESS,
+	  bench_lzo_compress, bench_lzo_decompress },
+	{ "lz4", LZ4_MEM_COMPRESS,
+	  bench_lz4_compress, bench_lz4_decompress },
+	{ "lz4hc", LZ4HC_MEM_COMPRESS,
+	  bench_lz4hc_compress, bench_lz4_decompress },
+};
+
+/* compress the pages the swap scenario would write, with each algorithm */
+static int bench_run_compress(struct bench_report *r)
+{
+	unsigned long nr_pages = (unsigned long)anon_mb << (20 - PAGE_SHIFT);
+	size_t dst_size = max(lzo1x_worst_compress(PAGE_SIZE),
+			      lz4_compressbound(PAGE_SIZE));
+	const struct bench_algo *algo;
+	u64 in, out, comp_ns, decomp_ns;
+	struct rnd_state rnd;
+	u8 *src, *dst, *back;
+	void *wrk = NULL;
+	size_t len, back_len;
+	unsigned long i;
+	ktime_t t;
+	int err = 0;
+
+	src = kmalloc(PAGE_SIZE, GFP_KERNEL);
+	back = kmalloc(PAGE_SIZE, GFP_KERNEL);
+	dst = kmalloc(dst_size, GFP_KERNEL);
+	if (!src || !back || !dst) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	bench_printf(r, "%lu pages, same-filled %u%%, random %u%%\n",
+		     nr_pages, same_pct, random_pct);
+	bench_printf(r, "algo       ratio(x100) comp(KB/s) decomp(KB/s)\n");
+	for (algo = bench_algos; algo < bench_algos + ARRAY_SIZE(bench_algos);
+	     algo++) {
+		wrk = vmalloc(algo->wrkmem);
+		if (!wrk) {
+			err = -ENOMEM;
+			goto out;
+		}
+
+		in = out = comp_ns = decomp_ns = 0;
+		prandom_seed_state(&rnd, seed);
+		for (i = 0; i < nr_pages; i++) {
+			bench_fill_page((u32 *)src, i, &rnd);
+
+			len = dst_size;
+			t = ktime_get();
+			err = algo->compress(src, dst, &len, wrk);
+			comp_ns += ktime_to_ns(ktime_sub(ktime_get(), t));
+			if (err)
+				break;
+
+			back_len = PAGE_SIZE;
+			t = ktime_get();
+			err = algo->decompress(dst, len, back, &back_len);
+			decomp_ns += ktime_to_ns(ktime_sub(ktime_get(), t));
+			if (err || back_len != PAGE_SIZE ||
+			    memcmp(src, back, PAGE_SIZE)) {
+				err = -EILSEQ;
+				break;
+			}
+
+			in += PAGE_SIZE;
+			/* zram stores what does not compress as is */
+			out += min_t(size_t, len, PAGE_SIZE);
+			if (fatal_signal_pending(current)) {
+				err = -EINTR;
+				break;
+			}
+			cond_resched();
+		}
+		vfree(wrk);
+		if (err) {
+			bench_printf(r, "%-10s failed at page %lu: %d\n",
+				     algo->name, i, err);
+			goto out;
+		}
+
+		bench_printf(r, "%-10s %11llu %10llu %12llu\n", algo->name,
+			     out ? div64_u64(in * 100, out) : 0,
+			     bench_kbps(in, comp_ns), bench_kbps(in, decomp_ns));
+	}
+out:
+	kfree(dst);
+	kfree(back);
+	kfree(src);
+	return err;
+}
+
+/*
+ * Fragment memory with the anon set, dropping every other page so that
+ * the rest has to be migrated, then time compact_allocs allocations of
+ * compact_order pages that have to go through direct compaction.
+ */
+static int bench_run_compact(struct bench_report *r)
+{
+	unsigned long stall, fail, success, addr;
+	struct vm_area_struct *vma;
+	struct bench_anon wa;
+	struct bench_hist h;
+	struct page *page, *next;
+	LIST_HEAD(pages);
+	unsigned int i, got = 0;
+	ktime_t t;
+	int err;
+
+	if (compact_order >= MAX_ORDER)
+		return -EINVAL;
+
+	err = bench_anon_map(&wa, anon_mb);
+	if (err)
+		return err;
+
+	down_read(&current->mm->mmap_sem);
+	vma = find_vma(current->mm, wa.addr);
+	if (vma && vma->vm_start <= wa.addr) {
+		for (i = 0; i < wa.nr_pages; i += 2) {
+			addr = wa.addr + ((unsigned long)i << PAGE_SHIFT);
+			zap_page_range(vma, addr, PAGE_SIZE, NULL);
+		}
+	}
+	up_read(&current->mm->mmap_sem);
+
+	memset(&h, 0, sizeof(h));
+	stall = bench_event(COMPACTSTALL);
+	fail = bench_event(COMPACTFAIL);
+	success = bench_event(COMPACTSUCCESS);
+	for (i = 0; i < compact_allocs; i++) {
+		t = ktime_get();
+		page = alloc_pages(GFP_KERNEL | __GFP_NOWARN | __GFP_NORETRY,
+				   compact_order);
+		bench_hist_add(&h, t);
+		if (page) {
+			list_add(&page->lru, &pages);
+			got++;
+		}
+		if (fatal_signal_pending(current))
+			break;
+	}
+	stall = bench_event(COMPACTSTALL) - stall;
+	fail = bench_event(COMPACTFAIL) - fail;
+	success = bench_event(COMPACTSUCCESS) - success;
+
+	list_for_each_entry_safe(page, next, &pages, lru) {
+		list_del(&page->lru);
+		__free_pages(page, compact_order);
+	}
+	bench_anon_unmap(&wa);
+
+	bench_printf(r, "order %u: %u of %u allocated over %u MB fragmented\n",
+		     compact_order, got, i, anon_mb);
+	bench_printf(r, "compact stall %lu, success %lu, fail %lu\n",
+		     stall, success, fail);
+	bench_hist_header(r);
+	bench_hist_print(r, "alloc", &h);
+	return 0;
+}
+
+/* Read the first file_mb of file_path; returns elapsed ns */
+static s64 bench_file_read(struct file *file, char *buf, loff_t size)
+{
+	ktime_t start = ktime_get();
+	loff_t pos;
+	int ret;
+
+	for (pos = 0; pos < size; pos += PAGE_SIZE) {
+		ret = kernel_read(file, pos, buf, PAGE_SIZE);
+		if (ret < 0)
+			return ret;
+		if (ret < PAGE_SIZE)
+			break;
+		if (fatal_signal_pending(current))
+			return -EINTR;
+	}
+	return ktime_to_ns(ktime_sub(ktime_get(), start));
+}
+
+/*
+ * Build an anon and a file working set, allocate pressure_mb to push
+ * them out, and measure the allocation stalls, what was left resident,
+ * and how long it takes to fault both sets back in.
+ */
+static int bench_run_reclaim(struct bench_report *r)
+{
+	unsigned long pswpout, stall, resident = 0, nr_file, idx;
+	unsigned long nr_pressure, got = 0;
+	struct address_space *mapping;
+	struct bench_hist *h;
+	struct bench_anon wa;
+	struct bench_walk bw;
+	struct page *page, *next;
+	struct file *file;
+	LIST_HEAD(pages);
+	loff_t size;
+	char *buf;
+	ktime_t t;
+	s64 ns;
+	int err;
+
+	file = filp_open(file_path, O_RDONLY | O_LARGEFILE, 0);
+	if (IS_ERR(file))
+		return PTR_ERR(file);
+	mapping = file->f_mapping;
+	size = min_t(loff_t, i_size_read(mapping->host),
+		     (loff_t)file_mb << 20);
+	nr_file = size >> PAGE_SHIFT;
+
+	h = kcalloc(2, sizeof(*h), GFP_KERNEL);
+	buf = (char *)__get_free_page(GFP_KERNEL);
+	if (!h || !buf) {
+		err = -ENOMEM;
+		goto out;
+	}
+	err = bench_anon_map(&wa, anon_mb);
+	if (err)
+		goto out;
+
+	/* start from a cold file */
+	invalidate_mapping_pages(mapping, 0, -1);
+	ns = bench_file_read(file, buf, size);
+	if (ns < 0) {
+		err = ns;
+		goto out_unmap;
+	}
+	bench_printf(r, "anon set %u MB, file set %lu pages of %s\n",
+		     anon_mb, nr_file, file_path);
+	bench_printf(r, "file cold read: %llu KB/s\n",
+		     bench_kbps(size, ns));
+
+	pswpout = bench_event(PSWPOUT);
+	stall = bench_event(ALLOCSTALL);
+	nr_pressure = (unsigned long)pressure_mb << (20 - PAGE_SHIFT);
+	for (; got < nr_pressure; got++) {
+		t = ktime_get();
+		page = alloc_page(GFP_HIGHUSER | __GFP_NOWARN | __GFP_NORETRY);
+		bench_hist_add(&h[0], t);
+		if (!page || fatal_signal_pending(current)) {
+			if (page)
+				__free_page(page);
+			break;
+		}
+		list_add(&page->lru, &pages);
+	}
+	pswpout = bench_event(PSWPOUT) - pswpout;
+	stall = bench_event(ALLOCSTALL) - stall;
+
+	for (idx = 0; idx < nr_file; idx++) {
+		page = find_get_page(mapping, idx);
+		if (page) {
+			resident++;
+			page_cache_release(page);
+		}
+	}
+	memset(&bw, 0, sizeof(bw));
+	bench_anon_walk(&wa, &bw);
+
+	list_for_each_entry_safe(page, next, &pages, lru) {
+		list_del(&page->lru);
+		__free_page(page);
+	}
+
+	bench_printf(r, "pressure: %lu of %lu pages allocated, %lu direct reclaim stalls, %lu swapped out\n",
+		     got, nr_pressure, stall, pswpout);
+	bench_printf(r, "resident after pressure: anon %lu/%lu, file %lu/%lu\n",
+		     bw.nr_present, wa.nr_pages, resident, nr_file);
+
+	ns = bench_anon_touch(&wa, NULL, &h[1]);
+	if (ns < 0) {
+		err = ns;
+		goto out_unmap;
+	}
+	bench_printf(r, "anon refault: %llu KB/s\n",
+		     bench_kbps((u64)wa.nr_pages << PAGE_SHIFT, ns));
+	ns = bench_file_read(file, buf, size);
+	if (ns < 0) {
+		err = ns;
+		goto out_unmap;
+	}
+	bench_printf(r, "file refault: %llu KB/s\n", bench_kbps(size, ns));
+
+	bench_hist_header(r);
+	bench_hist_print(r, "alloc", &h[0]);
+	bench_hist_print(r, "anon fault", &h[1]);
+out_unmap:
+	bench_anon_unmap(&wa);
+out:
+	free_page((unsigned long)buf);
+	kfree(h);
+	filp_close(file, NULL);
+	return err;
+}
+
+/*
+ * Kill lmk_pid and time until its address space is released and until
+ * its pages and swap entries are all freed, which is what a kill by the
+ * lowmemorykiller is waiting for.
+ */
+static int bench_run_lmk(struct bench_report *r)
+{
+	unsigned long rss, swap, timeout;
+	struct task_struct *p;
+	struct mm_struct *mm;
+	s64 exit_ns = -1, free_ns = -1;
+	ktime_t start;
+
+	rcu_read_lock();
+	p = find_task_by_vpid(lmk_pid);
+	if (p)
+		get_task_struct(p);
+	rcu_read_unlock();
+	if (!p)
+		return -ESRCH;
+
+	task_lock(p);
+	mm = p->mm;
+	if (mm)
+		atomic_inc(&mm->mm_count);
+	task_unlock(p);
+	if (!mm) {
+		put_task_struct(p);
+		return -EINVAL;
+	}
+
+	rss = get_mm_rss(mm);
+	swap = get_mm_counter(mm, MM_SWAPENTS);
+	start = ktime_get();
+	send_sig(SIGKILL, p, 0);
+
+	timeout = jiffies + msecs_to_jiffies(BENCH_LMK_TIMEOUT_MS);
+	while (time_before(jiffies, timeout)) {
+		if (exit_ns < 0 && !atomic_read(&mm->mm_users))
+			exit_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+		if (!get_mm_rss(mm) && !get_mm_counter(mm, MM_SWAPENTS)) {
+			free_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+			break;
+		}
+		usleep_range(200, 400);
+	}
+
+	bench_printf(r, "pid %d (%s): rss %lu pages, swap %lu entries\n",
+		     lmk_pid, p->comm, rss, swap);
+	if (free_ns < 0)
+		bench_printf(r, "not freed after %d ms, %lu pages left\n",
+			     BENCH_LMK_TIMEOUT_MS, get_mm_rss(mm));
+	else
+		bench_printf(r, "kill to exit %lld us, kill to free %lld us\n",
+			     exit_ns < 0 ? free_ns : exit_ns, free_ns);
+	bench_printf(r, "(%lld KB/s freed)\n",
+		     free_ns > 0 ? (s64)bench_kbps((u64)(rss + swap) <<
+						  PAGE_SHIFT, free_ns) : 0);
+
+	mmdrop(mm);
+	put_task_struct(p);
+	return 0;
+}
+
+static int (* const bench_run_fn[BENCH_NR])(struct bench_report *) = {
+	bench_run_swap,
+	bench_run_compress,
+	bench_run_compact,
+	bench_run_reclaim,
+	bench_run_lmk,
+};
+
+static int bench_show(struct seq_file *s, void *unused)
+{
+	int i;
+
+	mutex_lock(&bench_lock);
+	for (i = 0; i < BENCH_NR; i++) {
+		if (!bench_reports[i].len)
+			continue;
+		seq_printf(s, "[%s]\n%s\n", bench_name[i], bench_reports[i].buf);
+	}
+	mutex_unlock(&bench_lock);
+	return 0;
+}
+
+static int bench_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, bench_show, NULL);
+}
+
+/* write a scenario name to run it, the report replaces the previous one */
+static ssize_t bench_write(struct file *file, const char __user *buf,
+			   size_t count, loff_t *ppos)
+{
+	struct bench_report *r;
+	char name[16];
+	ktime_t start;
+	int i, err;
+
+	if (count >= sizeof(name))
+		return -EINVAL;
+	if (copy_from_user(name, buf, count))
+		return -EFAULT;
+	name[count] = '\0';
+	strim(name);
+
+	for (i = 0; i < BENCH_NR; i++) {
+		if (!strcmp(name, bench_name[i]))
+			break;
+	}
+	if (i == BENCH_NR)
+		return -EINVAL;
+	if (!current->mm)
+		return -EINVAL;
+
+	if (mutex_lock_interruptible(&bench_lock))
+		return -EINTR;
+	r = &bench_reports[i];
+	r->len = 0;
+	r->buf[0] = '\0';
+	start = ktime_get();
+	err = bench_run_fn[i](r);
+	bench_printf(r, "result %d, %lld ms\n", err,
+		     ktime_to_ms(ktime_sub(ktime_get(), start)));
+	mutex_unlock(&bench_lock);
+
+	return err ? err : count;
+}
+
+static const struct file_operations bench_fops = {
+	.owner = THIS_MODULE,
+	.open = bench_open,
+	.read = seq_read,
+	.write = bench_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int __init mm_bench_init(void)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("mm_bench", NULL);
+	if (IS_ERR_OR_NULL(dir))
+		return -ENODEV;
+	debugfs_create_file("run", 0644, dir, NULL, &bench_fops);
+	return 0;
+}
+
+module_init(mm_bench_init);
+MODULE_LICENSE("GPL");
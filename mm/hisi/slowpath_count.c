@@ -25,7 +25,14 @@
 #include <linux/kernel.h>
 #include <linux/module.h>
 #include <linux/moduleparam.h>
+#include <linux/mm.h>
+#include <linux/percpu.h>
+#include <linux/sched.h>
 #include <linux/seq_file.h>
+#include <linux/spinlock.h>
+#include <linux/uaccess.h>
+
+#include "slowpath_count.h"
 
 #define FIRST_APP_UID KUIDT_INIT(10000)
 #define LAST_APP_UID  KUIDT_INIT(19999)
@@ -41,6 +48,48 @@ static atomic_long_t slowpath_pgalloc_count = ATOMIC_LONG_INIT(0);
 
 module_param_named(enable, enable, bool, S_IRUGO | S_IWUSR);
 
+/*
+ * Slowpath latency: every __alloc_pages_slowpath() call is bucketed by
+ * order and by foreground/background caller, with the part of it spent
+ * in direct reclaim and in direct compaction summed separately.
+ */
+#define STALL_CTX_FG		0
+#define STALL_CTX_BG		1
+#define STALL_CTX_NR		2
+#define STALL_BUCKETS		10
+#define STALL_TOP_NR		8
+
+static const u64 stall_bucket_us[STALL_BUCKETS - 1] = {
+	100, 500, 1000, 2000, 5000, 10000, 20000, 50000, 100000,
+};
+
+static const char * const stall_ctx_name[STALL_CTX_NR] = {
+	"foreground", "background",
+};
+
+struct stall_stat {
+	u64 count;
+	u64 failed;
+	u64 retries;
+	u64 total_ns;
+	u64 phase_ns[SLOWPATH_STALL_NR];
+	u64 hist[STALL_BUCKETS];
+};
+
+struct stall_top {
+	pid_t pid;
+	char comm[TASK_COMM_LEN];
+	unsigned int order;
+	unsigned int retries;
+	u64 total_ns;
+	u64 phase_ns[SLOWPATH_STALL_NR];
+};
+
+static DEFINE_PER_CPU(struct stall_stat [STALL_CTX_NR][MAX_ORDER], stall_stats);
+static DEFINE_SPINLOCK(stall_top_lock);
+static struct stall_top stall_top[STALL_TOP_NR];
+static u64 stall_top_min_ns;
+
 static int is_background(void)
 {
 	kuid_t uid;
@@ -61,6 +110,86 @@ static int is_background(void)
 	return 0;
 }
 
+void slowpath_stall_init(struct slowpath_stall *st)
+{
+	memset(st, 0, sizeof(*st));
+	st->active = enable;
+	if (st->active)
+		st->start = local_clock();
+}
+
+static void slowpath_stall_top(struct slowpath_stall *st, unsigned int order,
+			       u64 total)
+{
+	unsigned long flags;
+	int i, min = 0;
+
+	spin_lock_irqsave(&stall_top_lock, flags);
+	for (i = 1; i < STALL_TOP_NR; i++) {
+		if (stall_top[i].total_ns < stall_top[min].total_ns)
+			min = i;
+	}
+	if (total > stall_top[min].total_ns) {
+		stall_top[min].pid = current->pid;
+		get_task_comm(stall_top[min].comm, current);
+		stall_top[min].order = order;
+		stall_top[min].retries = st->retries;
+		stall_top[min].total_ns = total;
+		memcpy(stall_top[min].phase_ns, st->phase_ns,
+		       sizeof(st->phase_ns));
+
+		min = 0;
+		for (i = 1; i < STALL_TOP_NR; i++) {
+			if (stall_top[i].total_ns < stall_top[min].total_ns)
+				min = i;
+		}
+		WRITE_ONCE(stall_top_min_ns, stall_top[min].total_ns);
+	}
+	spin_unlock_irqrestore(&stall_top_lock, flags);
+}
+
+/*
+ * slowpath_stall_done - account one __alloc_pages_slowpath() call
+ * @st: the call's timing, started by slowpath_stall_init()
+ * @order: page_order
+ * @page: the page returned, NULL on failure
+ */
+void slowpath_stall_done(struct slowpath_stall *st, unsigned int order,
+			 struct page *page)
+{
+	struct stall_stat *stat;
+	unsigned long flags;
+	u64 total, us;
+	int ctx, b, i;
+
+	if (!st->active)
+		return;
+
+	total = local_clock() - st->start;
+	ctx = (in_interrupt() || is_background()) ? STALL_CTX_BG : STALL_CTX_FG;
+
+	us = div_u64(total, NSEC_PER_USEC);
+	for (b = 0; b < STALL_BUCKETS - 1; b++) {
+		if (us < stall_bucket_us[b])
+			break;
+	}
+
+	/* atomic allocations get here from interrupts too */
+	local_irq_save(flags);
+	stat = &(*this_cpu_ptr(&stall_stats))[ctx][order];
+	stat->count++;
+	stat->failed += !page;
+	stat->retries += st->retries;
+	stat->total_ns += total;
+	for (i = 0; i < SLOWPATH_STALL_NR; i++)
+		stat->phase_ns[i] += st->phase_ns[i];
+	stat->hist[b]++;
+	local_irq_restore(flags);
+
+	if (total > READ_ONCE(stall_top_min_ns))
+		slowpath_stall_top(st, order, total);
+}
+
 /*
  * pgalloc_count_inc - count slow path page_alloc times
  * @is_slowpath: slow path or not
@@ -113,9 +242,101 @@ static const struct file_operations fops = {
 	.release = single_release,
 };
 
+static int slowpath_latency_show(struct seq_file *s, void *unused)
+{
+	struct stall_top top[STALL_TOP_NR];
+	struct stall_stat sum, *stat;
+	unsigned long flags;
+	int ctx, order, cpu, b, i;
+
+	seq_puts(s, "ctx        order    count   failed  retries   avg(us) reclaim(us) compact(us)  <0.1 <0.5   <1   <2   <5  <10  <20  <50 <100 >=100ms\n");
+	for (ctx = 0; ctx < STALL_CTX_NR; ctx++) {
+		for (order = 0; order < MAX_ORDER; order++) {
+			memset(&sum, 0, sizeof(sum));
+			/* racy against the per-cpu writers, fine for a report */
+			for_each_possible_cpu(cpu) {
+				stat = &(*per_cpu_ptr(&stall_stats, cpu))[ctx][order];
+				sum.count += stat->count;
+				sum.failed += stat->failed;
+				sum.retries += stat->retries;
+				sum.total_ns += stat->total_ns;
+				for (i = 0; i < SLOWPATH_STALL_NR; i++)
+					sum.phase_ns[i] += stat->phase_ns[i];
+				for (b = 0; b < STALL_BUCKETS; b++)
+					sum.hist[b] += stat->hist[b];
+			}
+			if (!sum.count)
+				continue;
+
+			seq_printf(s, "%-10s %5d %8llu %8llu %8llu %9llu %11llu %11llu ",
+				   stall_ctx_name[ctx], order, sum.count,
+				   sum.failed, sum.retries,
+				   div64_u64(sum.total_ns, sum.count * NSEC_PER_USEC),
+				   div_u64(sum.phase_ns[SLOWPATH_STALL_RECLAIM], NSEC_PER_USEC),
+				   div_u64(sum.phase_ns[SLOWPATH_STALL_COMPACT], NSEC_PER_USEC));
+			for (b = 0; b < STALL_BUCKETS; b++)
+				seq_printf(s, " %4llu", sum.hist[b]);
+			seq_putc(s, '\n');
+		}
+	}
+
+	spin_lock_irqsave(&stall_top_lock, flags);
+	memcpy(top, stall_top, sizeof(top));
+	spin_unlock_irqrestore(&stall_top_lock, flags);
+
+	seq_puts(s, "\nlongest stalls:\n");
+	seq_puts(s, "    pid comm             order retries  total(us) reclaim(us) compact(us)\n");
+	for (i = 0; i < STALL_TOP_NR; i++) {
+		if (!top[i].total_ns)
+			continue;
+		seq_printf(s, "%7d %-16s %5u %7u %10llu %11llu %11llu\n",
+			   top[i].pid, top[i].comm, top[i].order,
+			   top[i].retries,
+			   div_u64(top[i].total_ns, NSEC_PER_USEC),
+			   div_u64(top[i].phase_ns[SLOWPATH_STALL_RECLAIM], NSEC_PER_USEC),
+			   div_u64(top[i].phase_ns[SLOWPATH_STALL_COMPACT], NSEC_PER_USEC));
+	}
+	return 0;
+}
+
+static int slowpath_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, slowpath_latency_show, NULL);
+}
+
+/* any write clears the histograms and the longest stalls */
+static ssize_t slowpath_latency_write(struct file *file, const char __user *buf,
+				      size_t count, loff_t *ppos)
+{
+	unsigned long flags;
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		memset(per_cpu_ptr(&stall_stats, cpu), 0,
+		       sizeof(struct stall_stat) * STALL_CTX_NR * MAX_ORDER);
+
+	spin_lock_irqsave(&stall_top_lock, flags);
+	memset(stall_top, 0, sizeof(stall_top));
+	WRITE_ONCE(stall_top_min_ns, 0);
+	spin_unlock_irqrestore(&stall_top_lock, flags);
+
+	return count;
+}
+
+static const struct file_operations latency_fops = {
+	.owner = THIS_MODULE,
+	.open = slowpath_latency_open,
+	.read = seq_read,
+	.write = slowpath_latency_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static int __init slowpath_count_init(void)
 {
 	debugfs_create_file("slowpath_count", 0444, NULL, NULL, &fops);
+	debugfs_create_file("slowpath_latency", 0644, NULL, NULL,
+			    &latency_fops);
 	return 0;
 }
 
@@ -22,10 +22,54 @@
 #ifndef SLOWPATH_COUNT_H
 #define SLOWPATH_COUNT_H
 
+enum slowpath_stall_phase {
+	SLOWPATH_STALL_RECLAIM,
+	SLOWPATH_STALL_COMPACT,
+	SLOWPATH_STALL_NR,
+};
+
 #ifdef CONFIG_HISI_SLOW_PATH_COUNT
+/* time spent by one __alloc_pages_slowpath() call, lives on its stack */
+struct slowpath_stall {
+	bool active;
+	unsigned int retries;
+	u64 start;
+	u64 phase_ns[SLOWPATH_STALL_NR];
+};
+
 extern void pgalloc_count_inc(bool is_slowpath, unsigned int order);
+extern void slowpath_stall_init(struct slowpath_stall *st);
+extern void slowpath_stall_done(struct slowpath_stall *st, unsigned int order,
+				struct page *page);
+
+static inline u64 slowpath_stall_now(struct slowpath_stall *st)
+{
+	return st->active ? local_clock() : 0;
+}
+
+static inline void slowpath_stall_add(struct slowpath_stall *st,
+				      enum slowpath_stall_phase phase, u64 t0)
+{
+	if (st->active)
+		st->phase_ns[phase] += local_clock() - t0;
+}
+
+static inline void slowpath_stall_retry(struct slowpath_stall *st)
+{
+	st->retries++;
+}
 #else
+struct slowpath_stall {
+};
+
 static inline void pgalloc_count_inc(bool is_slowpath, unsigned int order) {}
+static inline void slowpath_stall_init(struct slowpath_stall *st) {}
+static inline void slowpath_stall_done(struct slowpath_stall *st,
+				       unsigned int order, struct page *page) {}
+static inline u64 slowpath_stall_now(struct slowpath_stall *st) { return 0; }
+static inline void slowpath_stall_add(struct slowpath_stall *st,
+				      enum slowpath_stall_phase phase, u64 t0) {}
+static inline void slowpath_stall_retry(struct slowpath_stall *st) {}
 #endif
 
 #endif
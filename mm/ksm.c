@@ -37,6 +37,8 @@
 #include <linux/freezer.h>
 #include <linux/oom.h>
 #include <linux/numa.h>
+#include <linux/fb.h>
+#include <linux/power_supply.h>
 
 #include <asm/tlbflush.h>
 #include "internal.h"
@@ -154,6 +156,8 @@ struct stable_node {
  * @mm: the memory structure this rmap_item is pointing into
  * @address: the virtual address this rmap_item tracks (+ flags in low bits)
  * @oldchecksum: previous checksum of the page at that virtual address
+ * @volatility: scans in a row at which the checksum had changed
+ * @skips: scans of this page still to be skipped because it is volatile
  * @node: rb node of this rmap_item in the unstable tree
  * @head: pointer to stable_node heading this list in the stable tree
  * @hlist: link into hlist of rmap_items hanging off that stable_node
@@ -169,6 +173,8 @@ struct rmap_item {
 	struct mm_struct *mm;
 	unsigned long address;		/* + low bits used for flags below */
 	unsigned int oldchecksum;	/* when unstable */
+	u8 volatility;
+	u8 skips;
 	union {
 		struct rb_node node;	/* when node of unstable tree */
 		struct {		/* when listed from stable tree */
@@ -227,6 +233,28 @@ static unsigned int ksm_thread_sleep_millisecs = 20;
 /* Boolean to indicate whether to use deferred timer or not */
 static bool use_deferred_timer = 1;
 
+/* Milliseconds of ksmd cpu time allowed per second, 0 for no limit */
+static unsigned int ksm_cpu_budget_ms;
+
+/* Only scan while the device is charging or its screen is off */
+static bool ksm_charging_or_idle;
+
+/* Skip pages whose checksum keeps changing for a growing number of scans */
+static bool ksm_skip_volatile = 1;
+#define KSM_MAX_VOLATILITY	3	/* skip at most 7 scans in a row */
+
+/* The number of volatile page scans skipped */
+static unsigned long ksm_pages_skipped;
+
+/* The cpu time ksmd spent scanning, in ns */
+static u64 ksm_cpu_time;
+
+/* Budget window of one second: its start, cpu time used, scan allowed */
+static unsigned long ksm_window_start;
+static u64 ksm_window_used;
+static bool ksm_window_open = true;
+static bool ksm_screen_off;
+
 #ifdef CONFIG_NUMA
 /* Zeroed when merging across nodes is not allowed */
 static unsigned int ksm_merge_across_nodes = 1;
@@ -1474,9 +1502,16 @@ static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item)
 	 */
 	checksum = calc_checksum(page);
 	if (rmap_item->oldchecksum != checksum) {
+		/* a first checksum says nothing about volatility yet */
+		if (rmap_item->oldchecksum) {
+			if (rmap_item->volatility < KSM_MAX_VOLATILITY)
+				rmap_item->volatility++;
+			rmap_item->skips = (1 << rmap_item->volatility) - 1;
+		}
 		rmap_item->oldchecksum = checksum;
 		return;
 	}
+	rmap_item->volatility = 0;
 
 	tree_rmap_item =
 		unstable_tree_search_insert(rmap_item, page, &tree_page);
@@ -1694,6 +1729,22 @@ next_mm:
 	return NULL;
 }
 
+/*
+ * Volatile pages, whose checksum changed at their last scans, are left
+ * alone for 2^n - 1 scans, n the number of such scans in a row, instead
+ * of costing a checksum every round. Merged pages are never skipped.
+ */
+static bool ksm_skip_volatile_page(struct page *page,
+				   struct rmap_item *rmap_item)
+{
+	if (!ksm_skip_volatile || PageKsm(page) || !rmap_item->skips)
+		return false;
+
+	rmap_item->skips--;
+	ksm_pages_skipped++;
+	return true;
+}
+
 /**
  * ksm_do_scan  - the ksm scanner main worker function.
  * @scan_npages - number of pages we want to scan before we return.
@@ -1702,15 +1753,22 @@ static void ksm_do_scan(unsigned int scan_npages)
 {
 	struct rmap_item *rmap_item;
 	struct page *uninitialized_var(page);
+	u64 start = task_sched_runtime(current);
+	u64 delta;
 
 	while (scan_npages-- && likely(!freezing(current))) {
 		cond_resched();
 		rmap_item = scan_get_next_rmap_item(&page);
 		if (!rmap_item)
-			return;
-		cmp_and_merge_page(page, rmap_item);
+			break;
+		if (!ksm_skip_volatile_page(page, rmap_item))
+			cmp_and_merge_page(page, rmap_item);
 		put_page(page);
 	}
+
+	delta = task_sched_runtime(current) - start;
+	ksm_cpu_time += delta;
+	ksm_window_used += delta;
 }
 
 static void process_timeout(unsigned long __data)
@@ -1753,27 +1811,63 @@ static int ksmd_should_run(void)
 	return (ksm_run & KSM_RUN_MERGE) && !list_empty(&ksm_mm_head.mm_list);
 }
 
+static bool ksmd_conditions_met(void)
+{
+	if (!ksm_charging_or_idle || ACCESS_ONCE(ksm_screen_off))
+		return true;
+#ifdef CONFIG_POWER_SUPPLY
+	if (power_supply_is_system_supplied() > 0)
+		return true;
+#endif
+	return false;
+}
+
+/*
+ * Jiffies until ksmd may scan again, 0 if it may scan now. Scanning stops
+ * for the rest of the current second once its cpu budget is spent, or
+ * for the whole second if the charging or idle condition is not met.
+ */
+static long ksm_scan_delay(void)
+{
+	unsigned long now = jiffies;
+	unsigned int budget = ACCESS_ONCE(ksm_cpu_budget_ms);
+
+	if (time_after_eq(now, ksm_window_start + HZ)) {
+		ksm_window_start = now;
+		ksm_window_used = 0;
+		ksm_window_open = ksmd_conditions_met();
+	}
+
+	if (!ksm_window_open ||
+	    (budget && ksm_window_used >= (u64)budget * NSEC_PER_MSEC))
+		return max_t(long, ksm_window_start + HZ - now, 1);
+	return 0;
+}
+
 static int ksm_scan_thread(void *nothing)
 {
 	set_freezable();
 	set_user_nice(current, 5);
 
 	while (!kthread_should_stop()) {
+		long timeout;
+
 		mutex_lock(&ksm_thread_mutex);
 		wait_while_offlining();
-		if (ksmd_should_run())
+		if (ksmd_should_run() && !ksm_scan_delay())
 			ksm_do_scan(ksm_thread_pages_to_scan);
 		mutex_unlock(&ksm_thread_mutex);
 
 		try_to_freeze();
 
 		if (ksmd_should_run()) {
+			timeout = max_t(long,
+				msecs_to_jiffies(ksm_thread_sleep_millisecs),
+				ksm_scan_delay());
 			if (use_deferred_timer)
-				deferred_schedule_timeout(
-					msecs_to_jiffies(ksm_thread_sleep_millisecs));
+				deferred_schedule_timeout(timeout);
 			else
-				schedule_timeout_interruptible(
-					msecs_to_jiffies(ksm_thread_sleep_millisecs));
+				schedule_timeout_interruptible(timeout);
 		} else {
 			wait_event_freezable(ksm_thread_wait,
 				ksmd_should_run() || kthread_should_stop());
@@ -2261,6 +2355,124 @@ static ssize_t deferred_timer_store(struct kobject *kobj,
 }
 KSM_ATTR(deferred_timer);
 
+/*
+ * Writing a pid marks all anonymous vmas of that process mergeable, so
+ * the framework can hand the heaps of cached zygote children to ksmd
+ * without the apps calling madvise() themselves.
+ */
+static ssize_t advise_pid_store(struct kobject *kobj,
+				struct kobj_attribute *attr,
+				const char *buf, size_t count)
+{
+	struct task_struct *task;
+	struct mm_struct *mm;
+	struct vm_area_struct *vma;
+	int err;
+	pid_t pid;
+
+	err = kstrtoint(buf, 10, &pid);
+	if (err || pid <= 0)
+		return -EINVAL;
+
+	rcu_read_lock();
+	task = find_task_by_vpid(pid);
+	if (task)
+		get_task_struct(task);
+	rcu_read_unlock();
+	if (!task)
+		return -ESRCH;
+
+	mm = get_task_mm(task);
+	put_task_struct(task);
+	if (!mm)
+		return -EINVAL;
+
+	down_write(&mm->mmap_sem);
+	for (vma = mm->mmap; vma; vma = vma->vm_next) {
+		if (vma->vm_file)
+			continue;
+		err = ksm_madvise(vma, vma->vm_start, vma->vm_end,
+				  MADV_MERGEABLE, &vma->vm_flags);
+		if (err)
+			break;
+	}
+	up_write(&mm->mmap_sem);
+	mmput(mm);
+
+	return err ? err : count;
+}
+static struct kobj_attribute advise_pid_attr =
+	__ATTR(advise_pid, 0200, NULL, advise_pid_store);
+
+static ssize_t cpu_budget_ms_show(struct kobject *kobj,
+				  struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_cpu_budget_ms);
+}
+
+static ssize_t cpu_budget_ms_store(struct kobject *kobj,
+				   struct kobj_attribute *attr,
+				   const char *buf, size_t count)
+{
+	int err;
+	unsigned int budget;
+
+	err = kstrtouint(buf, 10, &budget);
+	if (err || budget > MSEC_PER_SEC)
+		return -EINVAL;
+
+	ksm_cpu_budget_ms = budget;
+
+	return count;
+}
+KSM_ATTR(cpu_budget_ms);
+
+static ssize_t charging_or_idle_show(struct kobject *kobj,
+				     struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_charging_or_idle);
+}
+
+static ssize_t charging_or_idle_store(struct kobject *kobj,
+				      struct kobj_attribute *attr,
+				      const char *buf, size_t count)
+{
+	int err;
+	unsigned long knob;
+
+	err = kstrtoul(buf, 10, &knob);
+	if (err || knob > 1)
+		return -EINVAL;
+
+	ksm_charging_or_idle = knob;
+
+	return count;
+}
+KSM_ATTR(charging_or_idle);
+
+static ssize_t skip_volatile_show(struct kobject *kobj,
+				  struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_skip_volatile);
+}
+
+static ssize_t skip_volatile_store(struct kobject *kobj,
+				   struct kobj_attribute *attr,
+				   const char *buf, size_t count)
+{
+	int err;
+	unsigned long knob;
+
+	err = kstrtoul(buf, 10, &knob);
+	if (err || knob > 1)
+		return -EINVAL;
+
+	ksm_skip_volatile = knob;
+
+	return count;
+}
+KSM_ATTR(skip_volatile);
+
 #ifdef CONFIG_NUMA
 static ssize_t merge_across_nodes_show(struct kobject *kobj,
 				struct kobj_attribute *attr, char *buf)
@@ -2364,6 +2576,33 @@ static ssize_t full_scans_show(struct kobject *kobj,
 }
 KSM_ATTR_RO(full_scans);
 
+static ssize_t pages_skipped_show(struct kobject *kobj,
+				  struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", ksm_pages_skipped);
+}
+KSM_ATTR_RO(pages_skipped);
+
+static ssize_t cpu_time_ms_show(struct kobject *kobj,
+				struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%llu\n", div_u64(ksm_cpu_time, NSEC_PER_MSEC));
+}
+KSM_ATTR_RO(cpu_time_ms);
+
+/* What merging has bought per ms of cpu time ksmd has spent so far */
+static ssize_t saved_bytes_per_cpu_ms_show(struct kobject *kobj,
+					   struct kobj_attribute *attr,
+					   char *buf)
+{
+	u64 cpu_ms = div_u64(ksm_cpu_time, NSEC_PER_MSEC);
+
+	return sprintf(buf, "%llu\n",
+		       div64_u64((u64)ksm_pages_sharing << PAGE_SHIFT,
+				 max_t(u64, cpu_ms, 1)));
+}
+KSM_ATTR_RO(saved_bytes_per_cpu_ms);
+
 static struct attribute *ksm_attrs[] = {
 	&sleep_millisecs_attr.attr,
 	&pages_to_scan_attr.attr,
@@ -2374,6 +2613,13 @@ static struct attribute *ksm_attrs[] = {
 	&pages_volatile_attr.attr,
 	&full_scans_attr.attr,
 	&deferred_timer_attr.attr,
+	&advise_pid_attr.attr,
+	&cpu_budget_ms_attr.attr,
+	&charging_or_idle_attr.attr,
+	&skip_volatile_attr.attr,
+	&pages_skipped_attr.attr,
+	&cpu_time_ms_attr.attr,
+	&saved_bytes_per_cpu_ms_attr.attr,
 #ifdef CONFIG_NUMA
 	&merge_across_nodes_attr.attr,
 #endif
@@ -2386,6 +2632,29 @@ static struct attribute_group ksm_attr_group = {
 };
 #endif /* CONFIG_SYSFS */
 
+#ifdef CONFIG_FB
+static int ksm_fb_notifier_call(struct notifier_block *nb,
+				unsigned long event, void *data)
+{
+	struct fb_event *evdata = data;
+	int blank;
+
+	if (event != FB_EVENT_BLANK || !evdata || !evdata->data)
+		return NOTIFY_DONE;
+
+	blank = *(int *)evdata->data;
+	if (blank == FB_BLANK_UNBLANK)
+		ACCESS_ONCE(ksm_screen_off) = false;
+	else if (blank == FB_BLANK_POWERDOWN)
+		ACCESS_ONCE(ksm_screen_off) = true;
+	return NOTIFY_OK;
+}
+
+static struct notifier_block ksm_fb_notifier = {
+	.notifier_call = ksm_fb_notifier_call,
+};
+#endif
+
 static int __init ksm_init(void)
 {
 	struct task_struct *ksm_thread;
@@ -2417,6 +2686,9 @@ static int __init ksm_init(void)
 #ifdef CONFIG_MEMORY_HOTREMOVE
 	/* There is no significance to this priority 100 */
 	hotplug_memory_notifier(ksm_memory_callback, 100);
+#endif
+#ifdef CONFIG_FB
+	fb_register_client(&ksm_fb_notifier);
 #endif
 	return 0;
 
@@ -0,0 +1,588 @@
+/*
+ * mm/launch_prefetch.c - learned page cache prefetch for app launch.
+ *
+ * The per-file readahead heuristic cannot help an app's cold start: it
+ * faults in its APK, odex and libraries in small random reads.  When
+ * userspace reports the launch of an app, the page cache misses of its
+ * faults during the next record_ms are recorded as (file, extent) pairs,
+ * coalesced as they come.  At the next launch of the same uid the trace
+ * is replayed by a kernel thread in the recorded order, through
+ * force_page_cache_readahead(), so the reads are issued ahead of the
+ * faults.  The misses left despite the replay are learned into the trace.
+ *
+ * Files are remembered by path and reopened for the replay, so a trace
+ * pins nothing and stale entries of an updated app just fail to open.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/fs.h>
+#include <linux/file.h>
+#include <linux/cred.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
+#include <linux/workqueue.h>
+#include <linux/blkdev.h>
+#include <linux/kobject.h>
+#include <linux/sysfs.h>
+#include <linux/launch_prefetch.h>
+
+/* per trace limits, the extent limit is a tunable below it */
+#define LP_MAX_FILES		256
+#define LP_MAX_EXTENTS		8192
+/* remembered apps, the least recently launched one is dropped */
+#define LP_MAX_TRACES		16
+#define LP_NO_FILE		U16_MAX
+
+struct lp_extent {
+	u16 file;		/* index into the file table */
+	u16 nr;			/* pages */
+	u32 pgoff;
+};
+
+struct lp_trace {
+	struct list_head list;	/* lp_traces, most recently launched first */
+	kuid_t uid;
+	unsigned int nr_files;
+	unsigned int nr_extents;
+	char **files;		/* paths */
+	struct lp_extent *extents;
+};
+
+/* only one launch is recorded at a time */
+struct lp_recording {
+	struct mutex lock;
+	bool active;
+	kuid_t uid;
+	unsigned long deadline;
+	struct delayed_work end_work;
+	unsigned int max_extents;
+	unsigned int nr_files;
+	unsigned int nr_extents;
+	struct inode *inodes[LP_MAX_FILES];	/* held while recording */
+	char *files[LP_MAX_FILES];
+	u16 file_map[LP_MAX_FILES];		/* into the trace, on merge */
+	struct lp_extent *extents;
+	char *path_buf;
+};
+
+int launch_prefetch_recording __read_mostly;
+static uid_t lp_recording_uid __read_mostly;
+static struct lp_recording lp_rec;
+
+static unsigned int lp_enabled __read_mostly = 1;
+static unsigned int lp_record_ms __read_mostly = 5000;
+static unsigned int lp_max_extents __read_mostly = 2048;
+
+static LIST_HEAD(lp_traces);
+static unsigned int lp_nr_traces;
+static DEFINE_MUTEX(lp_traces_lock);	/* traces and the stats below */
+static unsigned long lp_nr_replays;
+static unsigned long lp_replayed_pages;
+static unsigned long lp_learned_extents;
+
+static struct task_struct *lp_task;
+static DECLARE_WAIT_QUEUE_HEAD(lp_wait);
+static DEFINE_SPINLOCK(lp_pending_lock);
+static bool lp_pending;
+static kuid_t lp_pending_uid;
+
+static struct lp_trace *lp_trace_find(kuid_t uid)
+{
+	struct lp_trace *t;
+
+	list_for_each_entry(t, &lp_traces, list)
+		if (uid_eq(t->uid, uid))
+			return t;
+	return NULL;
+}
+
+static void lp_trace_free(struct lp_trace *t)
+{
+	unsigned int i;
+
+	list_del(&t->list);
+	lp_nr_traces--;
+	for (i = 0; i < t->nr_files; i++)
+		kfree(t->files[i]);
+	kfree(t->files);
+	kfree(t->extents);
+	kfree(t);
+}
+
+static struct lp_trace *lp_trace_get(kuid_t uid)
+{
+	struct lp_trace *t = lp_trace_find(uid);
+
+	if (t) {
+		list_move(&t->list, &lp_traces);
+		return t;
+	}
+
+	t = kzalloc(sizeof(*t), GFP_KERNEL);
+	if (!t)
+		return NULL;
+	t->uid = uid;
+	if (lp_nr_traces >= LP_MAX_TRACES)
+		lp_trace_free(list_last_entry(&lp_traces, struct lp_trace,
+					      list));
+	list_add(&t->list, &lp_traces);
+	lp_nr_traces++;
+	return t;
+}
+
+/*
+ * Append what was recorded to the trace of the uid, for a new app that
+ * is all of it, for a replayed one the misses the replay did not cover.
+ */
+static void lp_trace_learn(struct lp_recording *rec)
+{
+	struct lp_extent *extents;
+	struct lp_trace *t;
+	unsigned int i, j, nr;
+
+	mutex_lock(&lp_traces_lock);
+	t = lp_trace_get(rec->uid);
+	if (!t)
+		goto out;
+
+	for (i = 0; i < rec->nr_files; i++) {
+		for (j = 0; j < t->nr_files; j++)
+			if (!strcmp(t->files[j], rec->files[i]))
+				break;
+		if (j == t->nr_files) {
+			char **files = NULL;
+
+			if (t->nr_files < LP_MAX_FILES)
+				files = krealloc(t->files,
+						 (j + 1) * sizeof(*files),
+						 GFP_KERNEL);
+			if (!files) {
+				rec->file_map[i] = LP_NO_FILE;
+				continue;
+			}
+			t->files = files;
+			/* the trace owns the path from now on */
+			t->files[t->nr_files++] = rec->files[i];
+			rec->files[i] = NULL;
+		}
+		rec->file_map[i] = j;
+	}
+
+	nr = min(rec->nr_extents, rec->max_extents - min(rec->max_extents,
+							 t->nr_extents));
+	if (!nr)
+		goto out;
+	extents = krealloc(t->extents,
+			   (t->nr_extents + nr) * sizeof(*extents), GFP_KERNEL);
+	if (!extents)
+		goto out;
+	t->extents = extents;
+	for (i = 0; i < nr; i++) {
+		u16 file = rec->file_map[rec->extents[i].file];
+
+		if (file == LP_NO_FILE)
+			continue;
+		extents[t->nr_extents] = rec->extents[i];
+		extents[t->nr_extents++].file = file;
+		lp_learned_extents++;
+	}
+out:
+	/* a trace that learned nothing is of no use */
+	if (t && !t->nr_extents)
+		lp_trace_free(t);
+	mutex_unlock(&lp_traces_lock);
+}
+
+static void lp_record_finish(struct lp_recording *rec)
+{
+	unsigned int i;
+
+	WRITE_ONCE(launch_prefetch_recording, 0);
+	rec->active = false;
+
+	if (rec->nr_extents)
+		lp_trace_learn(rec);
+
+	for (i = 0; i < rec->nr_files; i++) {
+		iput(rec->inodes[i]);
+		kfree(rec->files[i]);
+	}
+	rec->nr_files = 0;
+	rec->nr_extents = 0;
+	vfree(rec->extents);
+	rec->extents = NULL;
+	__putname(rec->path_buf);
+	rec->path_buf = NULL;
+}
+
+static void lp_record_end_work(struct work_struct *work)
+{
+	struct lp_recording *rec = &lp_rec;
+
+	mutex_lock(&rec->lock);
+	/* a later launch may have restarted the window */
+	if (rec->active && !time_before(jiffies, rec->deadline))
+		lp_record_finish(rec);
+	mutex_unlock(&rec->lock);
+}
+
+static void lp_record_start(kuid_t uid)
+{
+	struct lp_recording *rec = &lp_rec;
+	unsigned long window = msecs_to_jiffies(READ_ONCE(lp_record_ms));
+
+	mutex_lock(&rec->lock);
+	if (rec->active)
+		lp_record_finish(rec);
+	if (!window)
+		goto out;
+
+	rec->max_extents = READ_ONCE(lp_max_extents);
+	rec->extents = vmalloc(rec->max_extents * sizeof(*rec->extents));
+	rec->path_buf = __getname();
+	if (!rec->extents || !rec->path_buf) {
+		vfree(rec->extents);
+		rec->extents = NULL;
+		if (rec->path_buf)
+			__putname(rec->path_buf);
+		rec->path_buf = NULL;
+		goto out;
+	}
+
+	rec->uid = uid;
+	rec->deadline = jiffies + window;
+	rec->active = true;
+	WRITE_ONCE(lp_recording_uid, from_kuid(&init_user_ns, uid));
+	WRITE_ONCE(launch_prefetch_recording, 1);
+	mod_delayed_work(system_wq, &rec->end_work, window);
+out:
+	mutex_unlock(&rec->lock);
+}
+
+static int lp_record_file(struct lp_recording *rec, struct file *file)
+{
+	struct inode *inode = file_inode(file);
+	char *path;
+	int i;
+
+	for (i = 0; i < rec->nr_files; i++)
+		if (rec->inodes[i] == inode)
+			return i;
+
+	if (rec->nr_files == LP_MAX_FILES || d_unlinked(file->f_path.dentry))
+		return -1;
+	path = d_path(&file->f_path, rec->path_buf, PATH_MAX);
+	if (IS_ERR(path))
+		return -1;
+	path = kstrdup(path, GFP_KERNEL);
+	if (!path)
+		return -1;
+
+	rec->inodes[i] = igrab(inode);
+	if (!rec->inodes[i]) {
+		kfree(path);
+		return -1;
+	}
+	rec->files[i] = path;
+	rec->nr_files++;
+	return i;
+}
+
+/*
+ * A fault of the launching app missed the page cache at @offset. Record
+ * the read-around window do_sync_mmap_readahead() is about to read.
+ */
+void __launch_prefetch_record_fault(struct file *file, pgoff_t offset)
+{
+	struct lp_recording *rec = &lp_rec;
+	unsigned long nr = clamp_t(unsigned long, file->f_ra.ra_pages, 1,
+				   U16_MAX);
+	pgoff_t start = offset > nr / 2 ? offset - nr / 2 : 0;
+	struct lp_extent *last;
+	int idx;
+
+	if (from_kuid(&init_user_ns, current_uid()) !=
+	    READ_ONCE(lp_recording_uid))
+		return;
+	if (start > U32_MAX - nr)
+		return;
+
+	mutex_lock(&rec->lock);
+	if (!rec->active || !uid_eq(current_uid(), rec->uid) ||
+	    time_after(jiffies, rec->deadline))
+		goto out;
+
+	idx = lp_record_file(rec, file);
+	if (idx < 0)
+		goto out;
+
+	/* extend the last extent by what overlaps or adjoins it */
+	last = rec->nr_extents ? &rec->extents[rec->nr_extents - 1] : NULL;
+	if (last && last->file == idx) {
+		pgoff_t lo = min_t(pgoff_t, start, last->pgoff);
+		pgoff_t hi = max_t(pgoff_t, start + nr, last->pgoff + last->nr);
+
+		if (hi - lo <= last->nr + nr && hi - lo <= U16_MAX) {
+			last->pgoff = lo;
+			last->nr = hi - lo;
+			goto out;
+		}
+	}
+	if (rec->nr_extents < rec->max_extents) {
+		last = &rec->extents[rec->nr_extents++];
+		last->file = idx;
+		last->pgoff = start;
+		last->nr = nr;
+	}
+out:
+	mutex_unlock(&rec->lock);
+}
+
+/* Issue the trace in order, all of it asynchronous readahead */
+static void lp_replay(struct lp_trace *t)
+{
+	struct file **filps;
+	struct blk_plug plug;
+	unsigned long pages = 0;
+	unsigned int i;
+
+	filps = kcalloc(t->nr_files, sizeof(*filps), GFP_KERNEL);
+	if (!filps)
+		return;
+
+	blk_start_plug(&plug);
+	for (i = 0; i < t->nr_extents; i++) {
+		struct lp_extent *e = &t->extents[i];
+		struct file *filp = filps[e->file];
+
+		if (!filp) {
+			filp = filp_open(t->files[e->file],
+					 O_RDONLY | O_LARGEFILE, 0);
+			filps[e->file] = filp;
+		}
+		if (IS_ERR(filp))
+			continue;
+		if (!force_page_cache_readahead(filp->f_mapping, filp,
+						e->pgoff, e->nr))
+			pages += e->nr;
+	}
+	blk_finish_plug(&plug);
+
+	for (i = 0; i < t->nr_files; i++)
+		if (!IS_ERR_OR_NULL(filps[i]))
+			fput(filps[i]);
+	kfree(filps);
+
+	lp_nr_replays++;
+	lp_replayed_pages += pages;
+}
+
+static int lp_thread(void *data)
+{
+	set_freezable();
+
+	while (!kthread_should_stop()) {
+		struct lp_trace *t;
+		kuid_t uid;
+
+		wait_event_freezable(lp_wait,
+				     READ_ONCE(lp_pending) ||
+				     kthread_should_stop());
+
+		spin_lock(&lp_pending_lock);
+		uid = lp_pending_uid;
+		lp_pending = false;
+		spin_unlock(&lp_pending_lock);
+
+		mutex_lock(&lp_traces_lock);
+		t = lp_trace_find(uid);
+		if (t) {
+			list_move(&t->list, &lp_traces);
+			lp_replay(t);
+		}
+		mutex_unlock(&lp_traces_lock);
+	}
+	return 0;
+}
+
+/* bios of the replay belong to the foreground (VIP) I/O class */
+bool current_is_launch_prefetch(void)
+{
+	return current == lp_task;
+}
+
+/**
+ * launch_prefetch_app_launch - an app is being launched
+ * @uid: its uid
+ *
+ * Replays the trace of @uid if there is one and records the misses of
+ * the launch. Called from process context.
+ */
+void launch_prefetch_app_launch(uid_t uid)
+{
+	kuid_t kuid = make_kuid(&init_user_ns, uid);
+
+	if (!READ_ONCE(lp_enabled) || !lp_task || !uid || !uid_valid(kuid))
+		return;
+
+	spin_lock(&lp_pending_lock);
+	lp_pending_uid = kuid;
+	lp_pending = true;
+	spin_unlock(&lp_pending_lock);
+	wake_up(&lp_wait);
+
+	lp_record_start(kuid);
+}
+
+#define LP_ATTR(_name) \
+	static struct kobj_attribute _name##_attr = \
+		__ATTR(_name, 0644, _name##_show, _name##_store)
+#define LP_ATTR_WO(_name) \
+	static struct kobj_attribute _name##_attr = \
+		__ATTR(_name, 0200, NULL, _name##_store)
+
+static ssize_t lp_store_uint(const char *buf, unsigned int *val,
+			     unsigned int min, unsigned int max)
+{
+	unsigned int v;
+
+	if (kstrtouint(buf, 10, &v) || v < min || v > max)
+		return -EINVAL;
+	WRITE_ONCE(*val, v);
+	return 0;
+}
+
+static ssize_t enabled_show(struct kobject *kobj,
+			    struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", lp_enabled);
+}
+
+static ssize_t enabled_store(struct kobject *kobj,
+			     struct kobj_attribute *attr,
+			     const char *buf, size_t count)
+{
+	return lp_store_uint(buf, &lp_enabled, 0, 1) ?: count;
+}
+LP_ATTR(enabled);
+
+static ssize_t record_ms_show(struct kobject *kobj,
+			      struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", lp_record_ms);
+}
+
+static ssize_t record_ms_store(struct kobject *kobj,
+			       struct kobj_attribute *attr,
+			       const char *buf, size_t count)
+{
+	return lp_store_uint(buf, &lp_record_ms, 0, 60000) ?: count;
+}
+LP_ATTR(record_ms);
+
+static ssize_t max_extents_show(struct kobject *kobj,
+				struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", lp_max_extents);
+}
+
+static ssize_t max_extents_store(struct kobject *kobj,
+				 struct kobj_attribute *attr,
+				 const char *buf, size_t count)
+{
+	return lp_store_uint(buf, &lp_max_extents, 1, LP_MAX_EXTENTS) ?: count;
+}
+LP_ATTR(max_extents);
+
+static ssize_t launch_store(struct kobject *kobj,
+			    struct kobj_attribute *attr,
+			    const char *buf, size_t count)
+{
+	unsigned int uid;
+
+	if (kstrtouint(buf, 10, &uid) || !uid)
+		return -EINVAL;
+	launch_prefetch_app_launch(uid);
+	return count;
+}
+LP_ATTR_WO(launch);
+
+/* "<uid>" drops the trace of an updated or removed app, "all" all of them */
+static ssize_t forget_store(struct kobject *kobj,
+			    struct kobj_attribute *attr,
+			    const char *buf, size_t count)
+{
+	struct lp_trace *t, *next;
+	unsigned int uid = 0;
+	bool all = sysfs_streq(buf, "all");
+
+	if (!all && (kstrtouint(buf, 10, &uid) || !uid))
+		return -EINVAL;
+
+	mutex_lock(&lp_traces_lock);
+	list_for_each_entry_safe(t, next, &lp_traces, list)
+		if (all || from_kuid(&init_user_ns, t->uid) == uid)
+			lp_trace_free(t);
+	mutex_unlock(&lp_traces_lock);
+	return count;
+}
+LP_ATTR_WO(forget);
+
+static ssize_t stat_show(struct kobject *kobj,
+			 struct kobj_attribute *attr, char *buf)
+{
+	struct lp_trace *t;
+	ssize_t len;
+
+	mutex_lock(&lp_traces_lock);
+	len = sprintf(buf, "replays %lu\nreplayed_pages %lu\n"
+		      "learned_extents %lu\n",
+		      lp_nr_replays, lp_replayed_pages, lp_learned_extents);
+	list_for_each_entry(t, &lp_traces, list)
+		len += sprintf(buf + len, "uid %u files %u extents %u\n",
+			       from_kuid(&init_user_ns, t->uid),
+			       t->nr_files, t->nr_extents);
+	mutex_unlock(&lp_traces_lock);
+	return len;
+}
+static struct kobj_attribute stat_attr = __ATTR_RO(stat);
+
+static struct attribute *lp_attrs[] = {
+	&enabled_attr.attr,
+	&record_ms_attr.attr,
+	&max_extents_attr.attr,
+	&launch_attr.attr,
+	&forget_attr.attr,
+	&stat_attr.attr,
+	NULL,
+};
+
+static struct attribute_group lp_attr_group = {
+	.attrs = lp_attrs,
+	.name = "launch_prefetch",
+};
+
+static int __init launch_prefetch_init(void)
+{
+	struct task_struct *task;
+	int err;
+
+	mutex_init(&lp_rec.lock);
+	INIT_DELAYED_WORK(&lp_rec.end_work, lp_record_end_work);
+
+	task = kthread_run(lp_thread, NULL, "lprefetchd");
+	if (IS_ERR(task)) {
+		pr_err("launch_prefetch: failed to start the thread\n");
+		return PTR_ERR(task);
+	}
+	lp_task = task;
+
+	err = sysfs_create_group(mm_kobj, &lp_attr_group);
+	if (err)
+		pr_err("launch_prefetch: failed to register sysfs\n");
+	return err;
+}
+late_initcall(launch_prefetch_init);
@@ -291,6 +291,13 @@ struct mem_cgroup {
 	atomic_t	under_oom;
 
 	int	swappiness;
+	/* reclaim pressure relative to other groups, in percent */
+	unsigned int reclaim_weight;
+	/* share of the global dirty threshold the group may use, in percent */
+	unsigned int dirty_ratio;
+	/* active pages kept active by reclaim while referenced, 0 for none */
+	unsigned long ws_protect;
+	atomic_long_t ws_protect_rescued;
 	/* OOM-Killer disable */
 	int		oom_kill_disable;
 
@@ -1392,6 +1399,75 @@ int mem_cgroup_swappiness(struct mem_cgroup *memcg)
 	return memcg->swappiness;
 }
 
+/* the root group has no swappiness of its own, vm_swappiness is used */
+bool mem_cgroup_swappiness_is_global(struct mem_cgroup *memcg)
+{
+	return mem_cgroup_disabled() || !memcg->css.parent;
+}
+
+unsigned int mem_cgroup_reclaim_weight(struct mem_cgroup *memcg)
+{
+	if (mem_cgroup_disabled() || !memcg->css.parent)
+		return MEMCG_RECLAIM_WEIGHT_DEFAULT;
+
+	return memcg->reclaim_weight;
+}
+
+static unsigned int mem_cgroup_dirty_ratio(struct mem_cgroup *memcg)
+{
+	if (mem_cgroup_disabled() || !memcg->css.parent)
+		return 100;
+
+	return memcg->dirty_ratio;
+}
+
+/*
+ * Reclaim found @page referenced since it last looked at it. Keep it
+ * active, whether it is anon or file, if its group protects a working set
+ * and the active pages of the group still fit in it.
+ */
+bool mem_cgroup_ws_protect(struct page *page)
+{
+	struct mem_cgroup *memcg;
+	bool protect = false;
+
+	if (mem_cgroup_disabled())
+		return false;
+
+	rcu_read_lock();
+	memcg = page->mem_cgroup;
+	if (memcg && READ_ONCE(memcg->ws_protect) &&
+	    mem_cgroup_nr_lru_pages(memcg, BIT(LRU_ACTIVE_ANON) |
+				    BIT(LRU_ACTIVE_FILE)) < memcg->ws_protect) {
+		atomic_long_inc(&memcg->ws_protect_rescued);
+		protect = true;
+	}
+	rcu_read_unlock();
+
+	return protect;
+}
+
+/*
+ * Number of dirty and writeback pages the group of current holds above
+ * its dirty_ratio share of the global dirty threshold @thresh.
+ */
+unsigned long mem_cgroup_dirty_excess(unsigned long thresh)
+{
+	struct mem_cgroup *memcg;
+	unsigned long limit;
+	long dirty = 0;
+
+	rcu_read_lock();
+	memcg = mem_cgroup_from_task(current);
+	limit = thresh * mem_cgroup_dirty_ratio(memcg) / 100;
+	if (limit < thresh)
+		dirty = mem_cgroup_read_stat(memcg, MEM_CGROUP_STAT_DIRTY) +
+			mem_cgroup_read_stat(memcg, MEM_CGROUP_STAT_WRITEBACK);
+	rcu_read_unlock();
+
+	return dirty > (long)limit ? dirty - limit : 0;
+}
+
 /*
  * A routine for checking "mem" is under move_account() or not.
  *
@@ -3534,7 +3610,11 @@ static int mem_cgroup_swappiness_write(struct cgroup_subsys_state *css,
 {
 	struct mem_cgroup *memcg = mem_cgroup_from_css(css);
 
-	if (val > 100)
+	/*
+	 * Up to 200 for groups, which scans anon only: background apps
+	 * can go to zram before any of their page cache is dropped.
+	 */
+	if (val > (css->parent ? 200 : 100))
 		return -EINVAL;
 
 	if (css->parent)
@@ -3545,6 +3625,75 @@ static int mem_cgroup_swappiness_write(struct cgroup_subsys_state *css,
 	return 0;
 }
 
+static u64 mem_cgroup_reclaim_weight_read(struct cgroup_subsys_state *css,
+					  struct cftype *cft)
+{
+	return mem_cgroup_reclaim_weight(mem_cgroup_from_css(css));
+}
+
+static int mem_cgroup_reclaim_weight_write(struct cgroup_subsys_state *css,
+					   struct cftype *cft, u64 val)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_css(css);
+
+	if (!css->parent || val > MEMCG_RECLAIM_WEIGHT_MAX)
+		return -EINVAL;
+
+	memcg->reclaim_weight = val;
+	return 0;
+}
+
+static u64 mem_cgroup_dirty_ratio_read(struct cgroup_subsys_state *css,
+				       struct cftype *cft)
+{
+	return mem_cgroup_dirty_ratio(mem_cgroup_from_css(css));
+}
+
+static int mem_cgroup_dirty_ratio_write(struct cgroup_subsys_state *css,
+					struct cftype *cft, u64 val)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_css(css);
+
+	if (!css->parent || !val || val > 100)
+		return -EINVAL;
+
+	memcg->dirty_ratio = val;
+	return 0;
+}
+
+static u64 mem_cgroup_ws_protect_read(struct cgroup_subsys_state *css,
+				      struct cftype *cft)
+{
+	return (u64)mem_cgroup_from_css(css)->ws_protect * PAGE_SIZE;
+}
+
+static int mem_cgroup_ws_protect_write(struct cgroup_subsys_state *css,
+				       struct cftype *cft, u64 val)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_css(css);
+
+	if (!css->parent)
+		return -EINVAL;
+
+	WRITE_ONCE(memcg->ws_protect, min_t(u64, val >> PAGE_SHIFT,
+					    PAGE_COUNTER_MAX));
+	return 0;
+}
+
+static int mem_cgroup_ws_protect_stat_show(struct seq_file *m, void *v)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_css(seq_css(m));
+	unsigned long active;
+
+	active = mem_cgroup_nr_lru_pages(memcg, BIT(LRU_ACTIVE_ANON) |
+					 BIT(LRU_ACTIVE_FILE));
+	seq_printf(m, "protected %llu\n",
+		   (u64)min(active, memcg->ws_protect) * PAGE_SIZE);
+	seq_printf(m, "rescued %ld\n",
+		   atomic_long_read(&memcg->ws_protect_rescued));
+	return 0;
+}
+
 static void __mem_cgroup_threshold(struct mem_cgroup *memcg, bool swap)
 {
 	struct mem_cgroup_threshold_ary *t;
@@ -4251,6 +4400,25 @@ static struct cftype mem_cgroup_legacy_files[] = {
 		.read_u64 = mem_cgroup_swappiness_read,
 		.write_u64 = mem_cgroup_swappiness_write,
 	},
+	{
+		.name = "reclaim_weight",
+		.read_u64 = mem_cgroup_reclaim_weight_read,
+		.write_u64 = mem_cgroup_reclaim_weight_write,
+	},
+	{
+		.name = "dirty_ratio",
+		.read_u64 = mem_cgroup_dirty_ratio_read,
+		.write_u64 = mem_cgroup_dirty_ratio_write,
+	},
+	{
+		.name = "ws_protect_in_bytes",
+		.read_u64 = mem_cgroup_ws_protect_read,
+		.write_u64 = mem_cgroup_ws_protect_write,
+	},
+	{
+		.name = "ws_protect_stat",
+		.seq_show = mem_cgroup_ws_protect_stat_show,
+	},
 	{
 		.name = "move_charge_at_immigrate",
 		.read_u64 = mem_cgroup_move_charge_read,
@@ -4464,6 +4632,8 @@ mem_cgroup_css_online(struct cgroup_subsys_state *css)
 	memcg->use_hierarchy = parent->use_hierarchy;
 	memcg->oom_kill_disable = parent->oom_kill_disable;
 	memcg->swappiness = mem_cgroup_swappiness(parent);
+	memcg->reclaim_weight = mem_cgroup_reclaim_weight(parent);
+	memcg->dirty_ratio = mem_cgroup_dirty_ratio(parent);
 
 	if (parent->use_hierarchy) {
 		page_counter_init(&memcg->memory, &parent->memory);
@@ -5037,8 +5207,12 @@ static int mem_cgroup_can_attach(struct cgroup_subsys_state *css,
 		spin_unlock(&mc.lock);
 		/* We set mc.moving_task later */
 
+		/*
+		 * With nothing to move, skip the lru drain on all CPUs and
+		 * the RCU grace period of mem_cgroup_move_charge().
+		 */
 		ret = mem_cgroup_precharge_mc(mm);
-		if (ret)
+		if (ret || !mc.precharge)
 			mem_cgroup_clear_mc();
 	}
 	mmput(mm);
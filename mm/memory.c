@@ -49,6 +49,7 @@
 #include <linux/rmap.h>
 #include <linux/export.h>
 #include <linux/delayacct.h>
+#include <linux/psi.h>
 #include <linux/init.h>
 #include <linux/writeback.h>
 #include <linux/memcontrol.h>
@@ -61,6 +62,7 @@
 #include <linux/string.h>
 #include <linux/dma-debug.h>
 #include <linux/debugfs.h>
+#include <linux/kobject.h>
 
 #include <asm/io.h>
 #include <asm/pgalloc.h>
@@ -1244,7 +1246,7 @@ static inline unsigned long zap_pud_range(struct mmu_gather *tlb,
 	return addr;
 }
 
-static void unmap_page_range(struct mmu_gather *tlb,
+void unmap_page_range(struct mmu_gather *tlb,
 			     struct vm_area_struct *vma,
 			     unsigned long addr, unsigned long end,
 			     struct zap_details *details)
@@ -2455,6 +2457,7 @@ int do_swap_page(struct mm_struct *mm, struct vm_area_struct *vma,
 	int locked;
 	int exclusive = 0;
 	int ret = 0;
+	unsigned long pflags;
 
 	if (!pte_unmap_same(mm, pmd, page_table, orig_pte))
 		goto out;
@@ -2472,11 +2475,15 @@ int do_swap_page(struct mm_struct *mm, struct vm_area_struct *vma,
 		goto out;
 	}
 	delayacct_set_flag(DELAYACCT_PF_SWAPIN);
-	page = lookup_swap_cache(entry);
+	psi_memstall_enter(&pflags);
+	page = lookup_swap_cache(entry, vma, address);
 	if (!page) {
-		page = swapin_readahead(entry,
-					GFP_HIGHUSER_MOVABLE,
-					vma, address);
+		if (swap_use_vma_readahead())
+			page = swap_vma_readahead(entry, GFP_HIGHUSER_MOVABLE,
+						  vma, address, pmd);
+		else
+			page = swapin_readahead(entry, GFP_HIGHUSER_MOVABLE,
+						vma, address);
 		if (!page) {
 			/*
 			 * Back out if somebody else faulted in this pte
@@ -2486,6 +2493,7 @@ int do_swap_page(struct mm_struct *mm, struct vm_area_struct *vma,
 			if (likely(pte_same(*page_table, orig_pte)))
 				ret = VM_FAULT_OOM;
 			delayacct_clear_flag(DELAYACCT_PF_SWAPIN);
+			psi_memstall_leave(&pflags);
 			goto unlock;
 		}
 
@@ -2500,6 +2508,7 @@ int do_swap_page(struct mm_struct *mm, struct vm_area_struct *vma,
 		 */
 		ret = VM_FAULT_HWPOISON;
 		delayacct_clear_flag(DELAYACCT_PF_SWAPIN);
+		psi_memstall_leave(&pflags);
 		swapcache = page;
 		goto out_release;
 	}
@@ -2508,6 +2517,7 @@ int do_swap_page(struct mm_struct *mm, struct vm_area_struct *vma,
 	locked = lock_page_or_retry(page, mm, flags);
 
 	delayacct_clear_flag(DELAYACCT_PF_SWAPIN);
+	psi_memstall_leave(&pflags);
 	if (!locked) {
 		ret |= VM_FAULT_RETRY;
 		goto out_release;
@@ -2628,6 +2638,174 @@ EXPORT_SYMBOL(do_swap_page);
  * but allow concurrent faults), and pte mapped but not yet locked.
  * We return with mmap_sem still held, but pte unmapped and unlocked.
  */
+#ifdef CONFIG_ARM64_CONT_PTE
+/*
+ * Write faults in big anonymous vmas map the whole aligned CONT_SIZE block
+ * around the fault at once, with the contiguous hint, if the block is
+ * unmapped and a free block of pages can be had without reclaim. This is
+ * meant for large, densely used heaps: the hint saves TLB entries, and
+ * sparsely touched vmas would only have their RSS blown up.
+ */
+static bool cont_pte_enabled __read_mostly = true;
+static unsigned long cont_pte_min_vma_kb __read_mostly = 2048;
+
+#define CONT_PTE_GFP	((GFP_HIGHUSER_MOVABLE | __GFP_NORETRY | \
+			  __GFP_NOWARN | __GFP_NO_KSWAPD) & ~__GFP_WAIT)
+
+static int do_anonymous_cont_page(struct mm_struct *mm,
+		struct vm_area_struct *vma, unsigned long address, pmd_t *pmd)
+{
+	unsigned long haddr = address & CONT_MASK;
+	struct mem_cgroup *memcg[CONT_PTES];
+	struct page *page;
+	spinlock_t *ptl;
+	pte_t *pte, entry;
+	int i, charged;
+
+	if (haddr < vma->vm_start || haddr + CONT_SIZE > vma->vm_end ||
+	    vma->vm_end - vma->vm_start < (cont_pte_min_vma_kb << 10) ||
+	    (vma->vm_flags & VM_NOHUGEPAGE))
+		return VM_FAULT_FALLBACK;
+
+	/* Don't bother allocating if part of the block is already mapped */
+	pte = pte_offset_map(pmd, haddr);
+	for (i = 0; i < CONT_PTES; i++)
+		if (!pte_none(pte[i]))
+			break;
+	pte_unmap(pte);
+	if (i < CONT_PTES)
+		return VM_FAULT_FALLBACK;
+
+	page = alloc_pages_vma(CONT_PTE_GFP, CONT_SHIFT, vma, haddr,
+			       numa_node_id(), false);
+	if (!page) {
+		count_vm_event(CONT_PTE_FALLBACK);
+		return VM_FAULT_FALLBACK;
+	}
+	split_page(page, CONT_SHIFT);
+
+	for (i = 0; i < CONT_PTES; i++) {
+		clear_user_highpage(page + i, haddr + i * PAGE_SIZE);
+		__SetPageUptodate(page + i);
+	}
+	for (charged = 0; charged < CONT_PTES; charged++)
+		if (mem_cgroup_try_charge(page + charged, mm, GFP_KERNEL,
+					  &memcg[charged]))
+			goto release;
+
+	pte = pte_offset_map_lock(mm, pmd, haddr, &ptl);
+	for (i = 0; i < CONT_PTES; i++)
+		if (!pte_none(pte[i]))
+			goto unlock;
+
+	add_mm_counter_fast(mm, MM_ANONPAGES, CONT_PTES);
+	for (i = 0; i < CONT_PTES; i++) {
+		page_add_new_anon_rmap(page + i, vma, haddr + i * PAGE_SIZE);
+		mem_cgroup_commit_charge(page + i, memcg[i], false);
+		lru_cache_add_active_or_unevictable(page + i, vma);
+	}
+
+	entry = pte_mkwrite(pte_mkdirty(mk_pte(page, vma->vm_page_prot)));
+	set_contpte_at(mm, haddr, pte, entry);
+
+	/* No need to invalidate - it was non-present before */
+	for (i = 0; i < CONT_PTES; i++)
+		update_mmu_cache(vma, haddr + i * PAGE_SIZE, pte + i);
+	pte_unmap_unlock(pte, ptl);
+	count_vm_event(CONT_PTE_ALLOC);
+	return 0;
+
+unlock:
+	pte_unmap_unlock(pte, ptl);
+release:
+	for (i = 0; i < CONT_PTES; i++) {
+		if (i < charged)
+			mem_cgroup_cancel_charge(page + i, memcg[i]);
+		page_cache_release(page + i);
+	}
+	return VM_FAULT_FALLBACK;
+}
+
+#ifdef CONFIG_SYSFS
+static ssize_t cont_pte_enabled_show(struct kobject *kobj,
+				     struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%d\n", cont_pte_enabled);
+}
+
+static ssize_t cont_pte_enabled_store(struct kobject *kobj,
+				      struct kobj_attribute *attr,
+				      const char *buf, size_t count)
+{
+	bool enabled;
+
+	if (strtobool(buf, &enabled))
+		return -EINVAL;
+
+	cont_pte_enabled = enabled;
+
+	return count;
+}
+static struct kobj_attribute cont_pte_enabled_attr =
+	__ATTR(enabled, 0644, cont_pte_enabled_show, cont_pte_enabled_store);
+
+static ssize_t cont_pte_min_vma_kb_show(struct kobject *kobj,
+					struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", cont_pte_min_vma_kb);
+}
+
+static ssize_t cont_pte_min_vma_kb_store(struct kobject *kobj,
+					 struct kobj_attribute *attr,
+					 const char *buf, size_t count)
+{
+	unsigned long kb;
+	int err;
+
+	err = kstrtoul(buf, 10, &kb);
+	if (err)
+		return err;
+
+	cont_pte_min_vma_kb = kb;
+
+	return count;
+}
+static struct kobj_attribute cont_pte_min_vma_kb_attr =
+	__ATTR(min_vma_kb, 0644, cont_pte_min_vma_kb_show,
+	       cont_pte_min_vma_kb_store);
+
+static struct attribute *cont_pte_attrs[] = {
+	&cont_pte_enabled_attr.attr,
+	&cont_pte_min_vma_kb_attr.attr,
+	NULL,
+};
+
+static struct attribute_group cont_pte_attr_group = {
+	.attrs = cont_pte_attrs,
+};
+
+static int __init cont_pte_init_sysfs(void)
+{
+	struct kobject *cont_pte_kobj;
+	int err;
+
+	cont_pte_kobj = kobject_create_and_add("cont_pte", mm_kobj);
+	if (!cont_pte_kobj) {
+		pr_err("failed to create cont_pte kobject\n");
+		return -ENOMEM;
+	}
+	err = sysfs_create_group(cont_pte_kobj, &cont_pte_attr_group);
+	if (err) {
+		pr_err("failed to register cont_pte group\n");
+		kobject_put(cont_pte_kobj);
+		return err;
+	}
+	return 0;
+}
+subsys_initcall(cont_pte_init_sysfs);
+#endif /* CONFIG_SYSFS */
+#endif /* CONFIG_ARM64_CONT_PTE */
+
 static int do_anonymous_page(struct mm_struct *mm, struct vm_area_struct *vma,
 		unsigned long address, pte_t *page_table, pmd_t *pmd,
 		unsigned int flags)
@@ -2656,6 +2834,11 @@ static int do_anonymous_page(struct mm_struct *mm, struct vm_area_struct *vma,
 	/* Allocate our own private page. */
 	if (unlikely(anon_vma_prepare(vma)))
 		goto oom;
+#ifdef CONFIG_ARM64_CONT_PTE
+	if (cont_pte_enabled &&
+	    do_anonymous_cont_page(mm, vma, address, pmd) != VM_FAULT_FALLBACK)
+		return 0;
+#endif
 	page = alloc_zeroed_user_highpage_movable(vma, address);
 	if (!page)
 		goto oom;
@@ -3415,6 +3598,81 @@ int handle_mm_fault(struct mm_struct *mm, struct vm_area_struct *vma,
 }
 EXPORT_SYMBOL_GPL(handle_mm_fault);
 
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+/*
+ * Try to handle a user fault without mmap_sem, so that a thread changing
+ * the address space, like the GC protecting its heap or the JIT mapping
+ * code, doesn't hold up the faults of other threads on unrelated vmas.
+ *
+ * The vma is looked up under mm_rb_lock and pinned by a reference. Every
+ * change to a linked vma is bracketed by vm_write_begin(), which waits
+ * for the pinned faults, and vm_write_end(): a vma whose vm_sequence is
+ * even once pinned stays as it is until the fault is done. Page tables
+ * are only freed once the vmas covering them are unlinked and waited
+ * for, so they can be walked and allocated as under mmap_sem.
+ *
+ * Returns VM_FAULT_RETRY if the fault has to be handled under mmap_sem:
+ * its vma is being changed, it may need mmap_sem (to grow the stack, to
+ * set up an anon_vma, for a ->fault or ->page_mkwrite not known to do
+ * without), or it failed.
+ */
+int handle_speculative_fault(struct mm_struct *mm, unsigned long address,
+			     unsigned int flags, unsigned long vm_flags)
+{
+	struct vm_area_struct *vma;
+	int ret = VM_FAULT_RETRY;
+
+	if (!(flags & FAULT_FLAG_USER))
+		return VM_FAULT_RETRY;
+
+	vma = get_vma(mm, address);
+	if (!vma)
+		return VM_FAULT_RETRY;
+
+	/* pairs with the barrier in vm_write_begin() */
+	smp_mb__after_atomic();
+	if (raw_read_seqcount(&vma->vm_sequence) & 1)
+		goto out_put;
+
+	if (vma->vm_start > address || !(vma->vm_flags & vm_flags))
+		goto out_put;
+	if (vma->vm_flags & (VM_HUGETLB | VM_GROWSDOWN | VM_GROWSUP |
+			     VM_PFNMAP | VM_MIXEDMAP | VM_IO))
+		goto out_put;
+	if (vma->vm_ops) {
+		if (!vma->vm_ops->speculative)
+			goto out_put;
+		/* COW needs anon_vma_prepare(), which looks at other vmas */
+		if ((flags & FAULT_FLAG_WRITE) &&
+		    !(vma->vm_flags & VM_SHARED) && !vma->anon_vma)
+			goto out_put;
+		if ((flags & FAULT_FLAG_WRITE) &&
+		    (vma->vm_flags & VM_SHARED) && vma->vm_ops->page_mkwrite)
+			goto out_put;
+	} else if (!vma->anon_vma) {
+		goto out_put;
+	}
+
+	__set_current_state(TASK_RUNNING);
+	check_sync_rss_stat(current);
+
+	/* No mmap_sem for __lock_page_or_retry() to drop */
+	ret = __handle_mm_fault(mm, vma, address,
+			flags & ~(FAULT_FLAG_ALLOW_RETRY | FAULT_FLAG_KILLABLE));
+	if (ret & (VM_FAULT_ERROR | VM_FAULT_RETRY)) {
+		ret = VM_FAULT_RETRY;
+		goto out_put;
+	}
+
+	count_vm_event(PGFAULT);
+	mem_cgroup_count_vm_event(mm, PGFAULT);
+	count_vm_event(SPECULATIVE_PGFAULT);
+out_put:
+	put_vma(vma);
+	return ret;
+}
+#endif
+
 #ifndef __PAGETABLE_PUD_FOLDED
 /*
  * Allocate page upper directory.
@@ -541,7 +541,13 @@ static void vma_rb_erase(struct vm_area_struct *vma, struct rb_root *root)
 	 * so make sure we instantiate it only once with our desired
 	 * augmented rbtree callbacks.
 	 */
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+	write_lock(&vma->vm_mm->mm_rb_lock);
+#endif
 	rb_erase_augmented(&vma->vm_rb, root, &vma_gap_callbacks);
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+	write_unlock(&vma->vm_mm->mm_rb_lock);
+#endif
 }
 
 /*
@@ -656,10 +662,16 @@ void __vma_link_rb(struct mm_struct *mm, struct vm_area_struct *vma,
 	 * immediately update the gap to the correct value. Finally we
 	 * rebalance the rbtree after all augmented values have been set.
 	 */
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+	write_lock(&mm->mm_rb_lock);
+#endif
 	rb_link_node(&vma->vm_rb, rb_parent, rb_link);
 	vma->rb_subtree_gap = 0;
 	vma_gap_update(vma);
 	vma_rb_insert(vma, &mm->mm_rb);
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+	write_unlock(&mm->mm_rb_lock);
+#endif
 }
 
 static void __vma_link_file(struct vm_area_struct *vma)
@@ -809,6 +821,10 @@ again:			remove_next = 1 + (end > next->vm_end);
 		}
 	}
 
+	vm_write_begin(vma);
+	if (remove_next || adjust_next)
+		vm_write_begin(next);
+
 	if (file) {
 		mapping = file->f_mapping;
 		root = &mapping->i_mmap;
@@ -922,6 +938,8 @@ again:			remove_next = 1 + (end > next->vm_end);
 			anon_vma_merge(vma, next);
 		mm->map_count--;
 		mpol_put(vma_policy(next));
+		/* faults that found next before it was unlinked */
+		vm_wait_speculative(next);
 		kmem_cache_free(vm_area_cachep, next);
 		/*
 		 * In mprotect's case 6 (see comments on vma_merge),
@@ -929,9 +947,10 @@ again:			remove_next = 1 + (end > next->vm_end);
 		 * up the code too much to do both in one go.
 		 */
 		next = vma->vm_next;
-		if (remove_next == 2)
+		if (remove_next == 2) {
+			vm_write_end(vma);
 			goto again;
-		else if (next)
+		} else if (next)
 			vma_gap_update(next);
 		else
 			VM_WARN_ON(mm->highest_vm_end != vm_end_gap(vma));
@@ -939,6 +958,10 @@ again:			remove_next = 1 + (end > next->vm_end);
 	if (insert && file)
 		uprobe_mmap(insert);
 
+	if (adjust_next)
+		vm_write_end(next);
+	vm_write_end(vma);
+
 	validate_mm(mm);
 
 	return 0;
@@ -2098,6 +2121,67 @@ struct vm_area_struct *find_vma(struct mm_struct *mm, unsigned long addr)
 
 EXPORT_SYMBOL(find_vma);
 
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+/*
+ * Like find_vma(), but without mmap_sem, for a speculative fault. The vma
+ * returned is kept from being freed until put_vma(). It may still be
+ * changed under us: its fields can only be trusted once vm_sequence was
+ * found even after taking the reference.
+ */
+struct vm_area_struct *get_vma(struct mm_struct *mm, unsigned long addr)
+{
+	struct rb_node *rb_node;
+	struct vm_area_struct *vma = NULL;
+
+	read_lock(&mm->mm_rb_lock);
+	rb_node = mm->mm_rb.rb_node;
+	while (rb_node) {
+		struct vm_area_struct *tmp;
+
+		tmp = rb_entry(rb_node, struct vm_area_struct, vm_rb);
+
+		if (tmp->vm_end > addr) {
+			vma = tmp;
+			if (tmp->vm_start <= addr)
+				break;
+			rb_node = rb_node->rb_left;
+		} else
+			rb_node = rb_node->rb_right;
+	}
+	if (vma)
+		atomic_inc(&vma->vm_ref_count);
+	read_unlock(&mm->mm_rb_lock);
+
+	return vma;
+}
+
+void put_vma(struct vm_area_struct *vma)
+{
+	if (atomic_dec_and_test(&vma->vm_ref_count))
+		wake_up_atomic_t(&vma->vm_ref_count);
+}
+
+static int vm_ref_count_wait(atomic_t *ref)
+{
+	schedule();
+	return 0;
+}
+
+void vm_wait_speculative(struct vm_area_struct *vma)
+{
+	wait_on_atomic_t(&vma->vm_ref_count, vm_ref_count_wait,
+			 TASK_UNINTERRUPTIBLE);
+}
+
+void vm_write_begin(struct vm_area_struct *vma)
+{
+	raw_write_seqcount_begin(&vma->vm_sequence);
+	/* pairs with the barrier in handle_speculative_fault() */
+	smp_mb();
+	vm_wait_speculative(vma);
+}
+#endif
+
 /*
  * Same as find_vma, but also return a pointer to the previous VMA in *pprev.
  */
@@ -2499,6 +2583,7 @@ static int __split_vma(struct mm_struct *mm, struct vm_area_struct *vma,
 
 	/* most fields are the same, copy all, and then fixup */
 	*new = *vma;
+	vm_speculative_init(new);
 
 	INIT_LIST_HEAD(&new->anon_vma_chain);
 
@@ -2640,6 +2725,9 @@ int do_munmap(struct mm_struct *mm, unsigned long start, size_t len)
 	 * Remove the vma's, and unmap the actual pages
 	 */
 	detach_vmas_to_be_unmapped(mm, vma, prev, end);
+	/* Speculative faults may still be using the unlinked vmas */
+	for (last = vma; last; last = last->vm_next)
+		vm_wait_speculative(last);
 	unmap_region(mm, vma, prev, start, end);
 
 	arch_unmap(mm, vma, start, end);
@@ -3010,6 +3098,7 @@ struct vm_area_struct *copy_vma(struct vm_area_struct **vmap,
 		new_vma = kmem_cache_alloc(vm_area_cachep, GFP_KERNEL);
 		if (new_vma) {
 			*new_vma = *vma;
+			vm_speculative_init(new_vma);
 			new_vma->vm_start = addr;
 			new_vma->vm_end = addr + len;
 			new_vma->vm_pgoff = pgoff;
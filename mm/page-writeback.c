@@ -1594,6 +1594,38 @@ static DEFINE_PER_CPU(int, bdp_ratelimits);
  */
 DEFINE_PER_CPU(int, dirty_throttle_leaks) = 0;
 
+/*
+ * Keep the memory cgroup of current within its memory.dirty_ratio share
+ * of the dirty threshold. balance_dirty_pages() only looks at global and
+ * per-bdi numbers, so a background app could otherwise use up the whole
+ * dirty budget and push the foreground app into long pauses there.
+ *
+ * Tasks sleeping here are not counted in dirty_sleeping. wbt therefore
+ * keeps writing the group's pages at background depth.
+ */
+static void balance_memcg_dirty_pages(struct backing_dev_info *bdi)
+{
+	unsigned long background_thresh;
+	unsigned long dirty_thresh;
+	unsigned long excess;
+
+	for (;;) {
+		global_dirty_limits(&background_thresh, &dirty_thresh);
+		excess = mem_cgroup_dirty_excess(dirty_thresh);
+		if (!excess)
+			break;
+
+		/* the group may be over its share while below background */
+		if (!writeback_in_progress(bdi))
+			bdi_start_writeback(bdi, excess, WB_REASON_BACKGROUND);
+
+		__set_current_state(TASK_KILLABLE);
+		io_schedule_timeout(HZ / 10);
+		if (fatal_signal_pending(current))
+			break;
+	}
+}
+
 /**
  * balance_dirty_pages_ratelimited - balance dirty memory state
  * @mapping: address_space which was dirtied
@@ -1648,8 +1680,10 @@ void balance_dirty_pages_ratelimited(struct address_space *mapping)
 	}
 	preempt_enable();
 
-	if (unlikely(current->nr_dirtied >= ratelimit))
+	if (unlikely(current->nr_dirtied >= ratelimit)) {
 		balance_dirty_pages(mapping, current->nr_dirtied);
+		balance_memcg_dirty_pages(bdi);
+	}
 }
 EXPORT_SYMBOL(balance_dirty_pages_ratelimited);
 
@@ -61,6 +61,8 @@
 #include <linux/hugetlb.h>
 #include <linux/sched/rt.h>
 #include <linux/page_owner.h>
+#include <linux/cma.h>
+#include <linux/psi.h>
 #include <linux/hisi/page_tracker.h>
 #include <linux/hisi/rdr_hisi_ap_hook.h>
 #include <linux/hisi/hisi_ion.h>
@@ -176,6 +178,8 @@ unsigned int pageblock_order __read_mostly;
 #endif
 
 static void __free_pages_ok(struct page *page, unsigned int order);
+static void free_pcp_page(struct page *page, unsigned long pfn,
+			  unsigned int order, bool cold);
 
 /*
  * results with 256, 32 in the lowmem_reserve sysctl:
@@ -722,10 +726,36 @@ static inline int free_pages_check(struct page *page)
 	return 0;
 }
 
+static inline unsigned int order_to_pindex(int migratetype,
+					   unsigned int order)
+{
+	return order * MIGRATE_PCPTYPES + migratetype;
+}
+
+static inline unsigned int pindex_to_order(unsigned int pindex)
+{
+	return pindex / MIGRATE_PCPTYPES;
+}
+
+static inline bool pcp_allowed_order(unsigned int order)
+{
+	return order < NR_PCP_ORDERS;
+}
+
+#ifdef CONFIG_HISI_PCP_HIGH_ORDER
+#define count_pcp_highorder_event(item, order)		\
+	do {						\
+		if (order)				\
+			__count_vm_event(item);		\
+	} while (0)
+#else
+#define count_pcp_highorder_event(item, order)	do { } while (0)
+#endif
+
 /*
  * Frees a number of pages from the PCP lists
- * Assumes all pages on list are in same zone, and of same order.
- * count is the number of pages to free.
+ * Assumes all pages on list are in same zone.
+ * count is the number of base pages to free, pcp->count is updated here.
  *
  * If the zone was previously in an "all pages pinned" state then look to
  * see if this freeing clears that state.
@@ -736,9 +766,9 @@ static inline int free_pages_check(struct page *page)
 static void free_pcppages_bulk(struct zone *zone, int count,
 					struct per_cpu_pages *pcp)
 {
-	int migratetype = 0;
+	int pindex = 0;
 	int batch_free = 0;
-	int to_free = count;
+	int to_free = min(count, pcp->count);
 	unsigned long nr_scanned;
 
 	spin_lock(&zone->lock);
@@ -746,9 +776,10 @@ static void free_pcppages_bulk(struct zone *zone, int count,
 	if (nr_scanned)
 		__mod_zone_page_state(zone, NR_PAGES_SCANNED, -nr_scanned);
 
-	while (to_free) {
+	while (to_free > 0) {
 		struct page *page;
 		struct list_head *list;
+		unsigned int order;
 
 		/*
 		 * Remove pages from lists in a round-robin fashion. A
@@ -759,15 +790,16 @@ static void free_pcppages_bulk(struct zone *zone, int count,
 		 */
 		do {
 			batch_free++;
-			if (++migratetype == MIGRATE_PCPTYPES)
-				migratetype = 0;
-			list = &pcp->lists[migratetype];
+			if (++pindex == NR_PCP_LISTS)
+				pindex = 0;
+			list = &pcp->lists[pindex];
 		} while (list_empty(list));
 
 		/* This is the only non-empty list. Free them all. */
-		if (batch_free == MIGRATE_PCPTYPES)
+		if (batch_free == NR_PCP_LISTS)
 			batch_free = to_free;
 
+		order = pindex_to_order(pindex);
 		do {
 			int mt;	/* migratetype of the to-be-freed page */
 
@@ -779,9 +811,11 @@ static void free_pcppages_bulk(struct zone *zone, int count,
 				mt = get_pageblock_migratetype(page);
 
 			/* MIGRATE_MOVABLE list may include MIGRATE_RESERVEs */
-			__free_one_page(page, page_to_pfn(page), zone, 0, mt);
-			trace_mm_page_pcpu_drain(page, 0, mt);
-		} while (--to_free && --batch_free && !list_empty(list));
+			__free_one_page(page, page_to_pfn(page), zone, order, mt);
+			trace_mm_page_pcpu_drain(page, order, mt);
+			pcp->count -= 1 << order;
+			to_free -= 1 << order;
+		} while (to_free > 0 && --batch_free && !list_empty(list));
 	}
 	spin_unlock(&zone->lock);
 }
@@ -852,6 +886,7 @@ static bool free_pages_prepare(struct page *page, unsigned int order)
 
 	reset_page_owner(page, order);
 	page_tracker_reset_tracker(page, order);
+	page_tracker_sample_free(page, order);
 
 	if (!PageHighMem(page)) {
 		debug_check_no_locks_freed(page_address(page),
@@ -874,6 +909,11 @@ static void __free_pages_ok(struct page *page, unsigned int order)
 	if (!free_pages_prepare(page, order))
 		return;
 
+	if (pcp_allowed_order(order)) {
+		free_pcp_page(page, pfn, order, false);
+		return;
+	}
+
 	migratetype = get_pfnblock_migratetype(page, pfn);
 	local_irq_save(flags);
 	__count_vm_events(PGFREE, 1 << order);
@@ -1041,6 +1081,7 @@ static int prep_new_page(struct page *page, unsigned int order, gfp_t gfp_flags,
 
 	set_page_owner(page, order, gfp_flags);
 	page_tracker_set_tracker(page, order);
+	page_tracker_sample_alloc(page, order);
 
 	/*
 	 * page is set pfmemalloc when ALLOC_NO_WATERMARKS was necessary to
@@ -1430,10 +1471,8 @@ void drain_zone_pages(struct zone *zone, struct per_cpu_pages *pcp)
 	local_irq_save(flags);
 	batch = READ_ONCE(pcp->batch);
 	to_drain = min(pcp->count, batch);
-	if (to_drain > 0) {
+	if (to_drain > 0)
 		free_pcppages_bulk(zone, to_drain, pcp);
-		pcp->count -= to_drain;
-	}
 	local_irq_restore(flags);
 }
 #endif
@@ -1455,10 +1494,8 @@ static void drain_pages_zone(unsigned int cpu, struct zone *zone)
 	pset = per_cpu_ptr(zone->pageset, cpu);
 
 	pcp = &pset->pcp;
-	if (pcp->count) {
+	if (pcp->count)
 		free_pcppages_bulk(zone, pcp->count, pcp);
-		pcp->count = 0;
-	}
 	local_irq_restore(flags);
 }
 
@@ -1586,24 +1623,22 @@ void mark_free_pages(struct zone *zone)
 #endif /* CONFIG_PM */
 
 /*
- * Free a 0-order page
- * cold == true ? free a cold page : free a hot page
+ * Put a page of an order below NR_PCP_ORDERS, already through
+ * free_pages_prepare(), on the pcp lists of this cpu.
  */
-void free_hot_cold_page(struct page *page, bool cold)
+static void free_pcp_page(struct page *page, unsigned long pfn,
+			  unsigned int order, bool cold)
 {
 	struct zone *zone = page_zone(page);
 	struct per_cpu_pages *pcp;
+	struct list_head *list;
 	unsigned long flags;
-	unsigned long pfn = page_to_pfn(page);
 	int migratetype;
 
-	if (!free_pages_prepare(page, 0))
-		return;
-
 	migratetype = get_pfnblock_migratetype(page, pfn);
 	set_freepage_migratetype(page, migratetype);
 	local_irq_save(flags);
-	__count_vm_event(PGFREE);
+	__count_vm_events(PGFREE, 1 << order);
 
 	/*
 	 * Track unmovable, reclaimable movable and cma on pcp lists.
@@ -1614,28 +1649,40 @@ void free_hot_cold_page(struct page *page, bool cold)
 	 */
 	if (migratetype >= MIGRATE_PCPTYPES) {
 		if (unlikely(is_migrate_isolate(migratetype))) {
-			free_one_page(zone, page, pfn, 0, migratetype);
+			free_one_page(zone, page, pfn, order, migratetype);
 			goto out;
 		}
 		migratetype = MIGRATE_MOVABLE;
 	}
 
 	pcp = &this_cpu_ptr(zone->pageset)->pcp;
+	list = &pcp->lists[order_to_pindex(migratetype, order)];
 	if (!cold)
-		list_add(&page->lru, &pcp->lists[migratetype]);
+		list_add(&page->lru, list);
 	else
-		list_add_tail(&page->lru, &pcp->lists[migratetype]);
-	pcp->count++;
-	if (pcp->count >= pcp->high) {
-		unsigned long batch = READ_ONCE(pcp->batch);
-		free_pcppages_bulk(zone, batch, pcp);
-		pcp->count -= batch;
-	}
+		list_add_tail(&page->lru, list);
+	pcp->count += 1 << order;
+	if (pcp->count >= pcp->high)
+		free_pcppages_bulk(zone, READ_ONCE(pcp->batch), pcp);
+	else
+		count_pcp_highorder_event(PCP_HIGHORDER_FREE_HIT, order);
 
 out:
 	local_irq_restore(flags);
 }
 
+/*
+ * Free a 0-order page
+ * cold == true ? free a cold page : free a hot page
+ */
+void free_hot_cold_page(struct page *page, bool cold)
+{
+	if (!free_pages_prepare(page, 0))
+		return;
+
+	free_pcp_page(page, page_to_pfn(page), 0, cold);
+}
+
 /*
  * Free a list of 0-order pages
  */
@@ -1753,7 +1800,8 @@ int split_free_page(struct page *page)
 }
 
 /*
- * Allocate a page from the given zone. Use pcplists for order-0 allocations.
+ * Allocate a page from the given zone. Use pcplists for orders below
+ * NR_PCP_ORDERS.
  */
 static inline
 struct page *buffered_rmqueue(struct zone *preferred_zone,
@@ -1764,20 +1812,39 @@ struct page *buffered_rmqueue(struct zone *preferred_zone,
 	struct page *page;
 	bool cold = ((gfp_flags & __GFP_COLD) != 0);
 
-	if (likely(order == 0)) {
+	if (unlikely(gfp_flags & __GFP_NOFAIL)) {
+		/*
+		 * __GFP_NOFAIL is not to be used in new code.
+		 *
+		 * All __GFP_NOFAIL callers should be fixed so that they
+		 * properly detect and handle allocation failures.
+		 *
+		 * We most definitely don't want callers attempting to
+		 * allocate greater than order-1 page units with
+		 * __GFP_NOFAIL.
+		 */
+		WARN_ON_ONCE(order > 1);
+	}
+
+	if (likely(pcp_allowed_order(order))) {
 		struct per_cpu_pages *pcp;
 		struct list_head *list;
 
 		local_irq_save(flags);
 		pcp = &this_cpu_ptr(zone->pageset)->pcp;
-		list = &pcp->lists[migratetype];
+		list = &pcp->lists[order_to_pindex(migratetype, order)];
 		if (list_empty(list)) {
-			pcp->count += rmqueue_bulk(zone, 0,
-					pcp->batch, list,
-					migratetype, cold, gfp_flags);
+			/* refill high orders with about a batch of base pages */
+			int count = max(pcp->batch >> order, 1);
+
+			pcp->count += rmqueue_bulk(zone, order, count, list,
+					migratetype, cold, gfp_flags) << order;
 
 			if (unlikely(list_empty(list)))
 				goto failed;
+		} else {
+			count_pcp_highorder_event(PCP_HIGHORDER_ALLOC_HIT,
+						  order);
 		}
 
 		if (cold)
@@ -1786,21 +1853,8 @@ struct page *buffered_rmqueue(struct zone *preferred_zone,
 			page = list_entry(list->next, struct page, lru);
 
 		list_del(&page->lru);
-		pcp->count--;
+		pcp->count -= 1 << order;
 	} else {
-		if (unlikely(gfp_flags & __GFP_NOFAIL)) {
-			/*
-			 * __GFP_NOFAIL is not to be used in new code.
-			 *
-			 * All __GFP_NOFAIL callers should be fixed so that they
-			 * properly detect and handle allocation failures.
-			 *
-			 * We most definitely don't want callers attempting to
-			 * allocate greater than order-1 page units with
-			 * __GFP_NOFAIL.
-			 */
-			WARN_ON_ONCE(order > 1);
-		}
 		spin_lock_irqsave(&zone->lock, flags);
 		page = __rmqueue(zone, order, migratetype, gfp_flags);
 		spin_unlock(&zone->lock);
@@ -2516,15 +2570,18 @@ __alloc_pages_direct_compact(gfp_t gfp_mask, unsigned int order,
 		bool *deferred_compaction)
 {
 	unsigned long compact_result;
+	unsigned long pflags;
 	struct page *page;
 
 	if (!order)
 		return NULL;
 
+	psi_memstall_enter(&pflags);
 	current->flags |= PF_MEMALLOC;
 	compact_result = try_to_compact_pages(gfp_mask, order, alloc_flags, ac,
 						mode, contended_compaction);
 	current->flags &= ~PF_MEMALLOC;
+	psi_memstall_leave(&pflags);
 
 	switch (compact_result) {
 	case COMPACT_DEFERRED:
@@ -2581,12 +2638,14 @@ __perform_reclaim(gfp_t gfp_mask, unsigned int order,
 					const struct alloc_context *ac)
 {
 	struct reclaim_state reclaim_state;
+	unsigned long pflags;
 	int progress;
 
 	cond_resched();
 
 	/* We now go into synchronous reclaim */
 	cpuset_memory_pressure_bump();
+	psi_memstall_enter(&pflags);
 	current->flags |= PF_MEMALLOC;
 	lockdep_set_current_reclaim_state(gfp_mask);
 	reclaim_state.reclaimed_slab = 0;
@@ -2598,6 +2657,7 @@ __perform_reclaim(gfp_t gfp_mask, unsigned int order,
 	current->reclaim_state = NULL;
 	lockdep_clear_current_reclaim_state();
 	current->flags &= ~PF_MEMALLOC;
+	psi_memstall_leave(&pflags);
 
 	cond_resched();
 
@@ -2736,6 +2796,8 @@ __alloc_pages_slowpath(gfp_t gfp_mask, unsigned int order,
 	enum migrate_mode migration_mode = MIGRATE_ASYNC;
 	bool deferred_compaction = false;
 	int contended_compaction = COMPACT_CONTENDED_NONE;
+	struct slowpath_stall stall;
+	u64 t0;
 
 	/*
 	 * In the slowpath, we sanity check order to avoid ever trying to
@@ -2748,6 +2810,8 @@ __alloc_pages_slowpath(gfp_t gfp_mask, unsigned int order,
 		return NULL;
 	}
 
+	slowpath_stall_init(&stall);
+
 	/*
 	 * If this allocation cannot block and it is for a specific node, then
 	 * fail early.  There's no need to wakeup kswapd or retry for a
@@ -2823,10 +2887,12 @@ retry:
 	 * Try direct compaction. The first pass is asynchronous. Subsequent
 	 * attempts after direct reclaim are synchronous
 	 */
+	t0 = slowpath_stall_now(&stall);
 	page = __alloc_pages_direct_compact(gfp_mask, order, alloc_flags, ac,
 					migration_mode,
 					&contended_compaction,
 					&deferred_compaction);
+	slowpath_stall_add(&stall, SLOWPATH_STALL_COMPACT, t0);
 	if (page)
 		goto got_pg;
 
@@ -2874,8 +2940,10 @@ retry:
 #ifdef CONFIG_HISI_SLOW_PATH_COUNT
 	pgalloc_count_inc(1, order);
 #endif
+	t0 = slowpath_stall_now(&stall);
 	page = __alloc_pages_direct_reclaim(gfp_mask, order, alloc_flags, ac,
 							&did_some_progress);
+	slowpath_stall_add(&stall, SLOWPATH_STALL_RECLAIM, t0);
 	if (page)
 		goto got_pg;
 
@@ -2898,6 +2966,7 @@ retry:
 		}
 		/* Wait for some write requests to complete then retry */
 		wait_iff_congested(ac->preferred_zone, BLK_RW_ASYNC, HZ/50);
+		slowpath_stall_retry(&stall);
 		goto retry;
 	} else {
 		/*
@@ -2905,10 +2974,12 @@ retry:
 		 * direct reclaim and reclaim/compaction depends on compaction
 		 * being called after reclaim so call directly if necessary
 		 */
+		t0 = slowpath_stall_now(&stall);
 		page = __alloc_pages_direct_compact(gfp_mask, order,
 					alloc_flags, ac, migration_mode,
 					&contended_compaction,
 					&deferred_compaction);
+		slowpath_stall_add(&stall, SLOWPATH_STALL_COMPACT, t0);
 		if (page)
 			goto got_pg;
 	}
@@ -2916,6 +2987,7 @@ retry:
 nopage:
 	warn_alloc_failed(gfp_mask, order, NULL);
 got_pg:
+	slowpath_stall_done(&stall, order, page);
 	return page;
 }
 
@@ -2941,6 +3013,13 @@ __alloc_pages_nodemask(gfp_t gfp_mask, unsigned int order,
 #endif
 	gfp_mask &= gfp_allowed_mask;
 
+	/* keep new pages out of CMA while an area is being evacuated */
+	if (IS_ENABLED(CONFIG_CMA) && (gfp_mask & ___GFP_CMA) &&
+			cma_placement_held()) {
+		gfp_mask &= ~___GFP_CMA;
+		ac.migratetype = gfpflags_to_migratetype(gfp_mask);
+	}
+
 	lockdep_trace_alloc(gfp_mask);
 
 	might_sleep_if(gfp_mask & __GFP_WAIT);
@@ -4452,14 +4531,14 @@ static void pageset_set_batch(struct per_cpu_pageset *p, unsigned long batch)
 static void pageset_init(struct per_cpu_pageset *p)
 {
 	struct per_cpu_pages *pcp;
-	int migratetype;
+	int pindex;
 
 	memset(p, 0, sizeof(*p));
 
 	pcp = &p->pcp;
 	pcp->count = 0;
-	for (migratetype = 0; migratetype < MIGRATE_PCPTYPES; migratetype++)
-		INIT_LIST_HEAD(&pcp->lists[migratetype]);
+	for (pindex = 0; pindex < NR_PCP_LISTS; pindex++)
+		INIT_LIST_HEAD(&pcp->lists[pindex]);
 }
 
 static void setup_pageset(struct per_cpu_pageset *p, unsigned long batch)
@@ -4482,15 +4561,35 @@ static void pageset_set_high(struct per_cpu_pageset *p,
 	pageset_update(&p->pcp, high, batch);
 }
 
-static void pageset_set_high_and_batch(struct zone *zone,
-				       struct per_cpu_pageset *pcp)
+/*
+ * Percentage applied to the pcp high and batch of the cpus of each
+ * cluster, so that clusters that allocate a lot (network rx, GPU job
+ * submission) can hold more pages between zone->lock round trips.
+ */
+int percpu_pagelist_cluster_scale[PCP_NR_CLUSTERS] = {
+	[0 ... PCP_NR_CLUSTERS - 1] = 100,
+};
+
+static unsigned long pageset_cluster_scale(int cpu, unsigned long val)
 {
+	int cluster = topology_physical_package_id(cpu);
+
+	if (cluster < 0 || cluster >= PCP_NR_CLUSTERS)
+		return val;
+	return val * percpu_pagelist_cluster_scale[cluster] / 100;
+}
+
+static void pageset_set_high_and_batch(struct zone *zone, int cpu)
+{
+	struct per_cpu_pageset *pcp = per_cpu_ptr(zone->pageset, cpu);
+
 	if (percpu_pagelist_fraction)
-		pageset_set_high(pcp,
+		pageset_set_high(pcp, pageset_cluster_scale(cpu,
 			(zone->managed_pages /
-				percpu_pagelist_fraction));
+				percpu_pagelist_fraction)));
 	else
-		pageset_set_batch(pcp, zone_batchsize(zone));
+		pageset_set_batch(pcp, pageset_cluster_scale(cpu,
+			zone_batchsize(zone)));
 }
 
 static void __meminit zone_pageset_init(struct zone *zone, int cpu)
@@ -4498,7 +4597,7 @@ static void __meminit zone_pageset_init(struct zone *zone, int cpu)
 	struct per_cpu_pageset *pcp = per_cpu_ptr(zone->pageset, cpu);
 
 	pageset_init(pcp);
-	pageset_set_high_and_batch(zone, pcp);
+	pageset_set_high_and_batch(zone, cpu);
 }
 
 static void __meminit setup_zone_pageset(struct zone *zone)
@@ -6145,8 +6244,34 @@ int percpu_pagelist_fraction_sysctl_handler(struct ctl_table *table, int write,
 		unsigned int cpu;
 
 		for_each_possible_cpu(cpu)
-			pageset_set_high_and_batch(zone,
-					per_cpu_ptr(zone->pageset, cpu));
+			pageset_set_high_and_batch(zone, cpu);
+	}
+out:
+	mutex_unlock(&pcp_batch_high_lock);
+	return ret;
+}
+
+/*
+ * percpu_pagelist_cluster_scale - scales pcp->high and pcp->batch of the
+ * cpus of each cluster, in percent of what percpu_pagelist_fraction or
+ * the zone size give.
+ */
+int percpu_pagelist_cluster_scale_sysctl_handler(struct ctl_table *table,
+	int write, void __user *buffer, size_t *length, loff_t *ppos)
+{
+	struct zone *zone;
+	int ret;
+
+	mutex_lock(&pcp_batch_high_lock);
+	ret = proc_dointvec_minmax(table, write, buffer, length, ppos);
+	if (!write || ret < 0)
+		goto out;
+
+	for_each_populated_zone(zone) {
+		unsigned int cpu;
+
+		for_each_possible_cpu(cpu)
+			pageset_set_high_and_batch(zone, cpu);
 	}
 out:
 	mutex_unlock(&pcp_batch_high_lock);
@@ -6673,8 +6798,7 @@ void __meminit zone_pcp_update(struct zone *zone)
 	unsigned cpu;
 	mutex_lock(&pcp_batch_high_lock);
 	for_each_possible_cpu(cpu)
-		pageset_set_high_and_batch(zone,
-				per_cpu_ptr(zone->pageset, cpu));
+		pageset_set_high_and_batch(zone, cpu);
 	mutex_unlock(&pcp_batch_high_lock);
 }
 #endif
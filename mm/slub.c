@@ -2162,6 +2162,21 @@ static inline void flush_slab(struct kmem_cache *s, struct kmem_cache_cpu *c)
 	c->freelist = NULL;
 }
 
+#ifdef CONFIG_SLUB_REMOTE_FREE
+static void remote_free_flush(struct kmem_cache *s,
+			      struct kmem_cache_remote_free *rf);
+
+static inline bool has_remote_free(struct kmem_cache *s, int cpu)
+{
+	return s->remote_free && per_cpu_ptr(s->remote_free, cpu)->nr;
+}
+#else
+static inline bool has_remote_free(struct kmem_cache *s, int cpu)
+{
+	return false;
+}
+#endif
+
 /*
  * Flush cpu slab.
  *
@@ -2171,6 +2186,11 @@ static inline void __flush_cpu_slab(struct kmem_cache *s, int cpu)
 {
 	struct kmem_cache_cpu *c = per_cpu_ptr(s->cpu_slab, cpu);
 
+#ifdef CONFIG_SLUB_REMOTE_FREE
+	if (has_remote_free(s, cpu))
+		remote_free_flush(s, per_cpu_ptr(s->remote_free, cpu));
+#endif
+
 	if (likely(c)) {
 		if (c->page)
 			flush_slab(s, c);
@@ -2191,7 +2211,7 @@ static bool has_cpu_slab(int cpu, void *info)
 	struct kmem_cache *s = info;
 	struct kmem_cache_cpu *c = per_cpu_ptr(s->cpu_slab, cpu);
 
-	return c->page || c->partial;
+	return c->page || c->partial || has_remote_free(s, cpu);
 }
 
 static void flush_all(struct kmem_cache *s)
@@ -2644,10 +2664,10 @@ EXPORT_SYMBOL(kmem_cache_alloc_node_trace);
  * handling required then we can return immediately.
  */
 static void __slab_free(struct kmem_cache *s, struct page *page,
-			void *x, unsigned long addr)
+			void *head, void *tail, int cnt, unsigned long addr)
 {
 	void *prior;
-	void **object = (void *)x;
+	void **object = (void *)head;
 	int was_frozen;
 	struct page new;
 	unsigned long counters;
@@ -2656,8 +2676,9 @@ static void __slab_free(struct kmem_cache *s, struct page *page,
 
 	stat(s, FREE_SLOWPATH);
 
+	/* debug caches never batch, cnt is 1 for them */
 	if (kmem_cache_debug(s) &&
-		!(n = free_debug_processing(s, page, x, addr, &flags)))
+		!(n = free_debug_processing(s, page, head, addr, &flags)))
 		return;
 
 	do {
@@ -2667,10 +2688,10 @@ static void __slab_free(struct kmem_cache *s, struct page *page,
 		}
 		prior = page->freelist;
 		counters = page->counters;
-		set_freepointer(s, object, prior);
+		set_freepointer(s, tail, prior);
 		new.counters = counters;
 		was_frozen = new.frozen;
-		new.inuse--;
+		new.inuse -= cnt;
 		if ((!new.inuse || !prior) && !was_frozen) {
 
 			if (kmem_cache_has_cpu_partial(s) && !prior) {
@@ -2756,6 +2777,89 @@ slab_empty:
 	discard_slab(s, page);
 }
 
+#ifdef CONFIG_SLUB_REMOTE_FREE
+/*
+ * Give the objects buffered by a cpu back to their slabs. Objects of the
+ * same slab are chained and freed together, so each slab costs one
+ * cmpxchg_double and at most one list_lock round trip however many of
+ * its objects were buffered.
+ *
+ * Called with interrupts disabled.
+ */
+static void remote_free_flush(struct kmem_cache *s,
+			      struct kmem_cache_remote_free *rf)
+{
+	unsigned int i, j;
+
+	for (i = 0; i < rf->nr; i++) {
+		void *head = rf->objects[i];
+		void *tail = head;
+		struct page *page;
+		int cnt = 1;
+
+		if (!head)
+			continue;
+
+		page = virt_to_head_page(head);
+		for (j = i + 1; j < rf->nr; j++) {
+			void *object = rf->objects[j];
+
+			if (!object || virt_to_head_page(object) != page)
+				continue;
+			set_freepointer(s, tail, object);
+			tail = object;
+			rf->objects[j] = NULL;
+			cnt++;
+		}
+		__slab_free(s, page, head, tail, cnt, _RET_IP_);
+		stat(s, FREE_REMOTE_FLUSH);
+	}
+	rf->nr = 0;
+}
+
+static void slab_free_remote(struct kmem_cache *s, void *x)
+{
+	struct kmem_cache_remote_free *rf;
+	unsigned long flags;
+
+	local_irq_save(flags);
+	rf = this_cpu_ptr(s->remote_free);
+	rf->objects[rf->nr++] = x;
+	stat(s, FREE_REMOTE_BATCHED);
+	if (rf->nr == SLUB_REMOTE_FREE_BATCH)
+		remote_free_flush(s, rf);
+	local_irq_restore(flags);
+}
+
+/*
+ * Only small objects are batched: a buffered object keeps its whole slab
+ * from being freed until the next flush.
+ */
+static void alloc_kmem_cache_remote_free(struct kmem_cache *s)
+{
+	if (!(s->flags & SLAB_REMOTE_FREE) || kmem_cache_debug(s) ||
+	    s->size >= PAGE_SIZE)
+		return;
+
+	/* without the buffers the cache simply frees unbatched */
+	s->remote_free = alloc_percpu(struct kmem_cache_remote_free);
+}
+
+static void free_kmem_cache_remote_free(struct kmem_cache *s)
+{
+	free_percpu(s->remote_free);
+	s->remote_free = NULL;
+}
+#else
+static inline void alloc_kmem_cache_remote_free(struct kmem_cache *s)
+{
+}
+
+static inline void free_kmem_cache_remote_free(struct kmem_cache *s)
+{
+}
+#endif
+
 /*
  * Fastpath with forced inlining to produce a kfree and kmem_cache_free that
  * can perform fastpath freeing without additional function calls.
@@ -2804,8 +2908,12 @@ redo:
 			goto redo;
 		}
 		stat(s, FREE_FASTPATH);
+#ifdef CONFIG_SLUB_REMOTE_FREE
+	} else if (s->remote_free && !kmem_cache_debug(s)) {
+		slab_free_remote(s, x);
+#endif
 	} else
-		__slab_free(s, page, x, addr);
+		__slab_free(s, page, x, x, 1, addr);
 
 }
 
@@ -3260,8 +3368,10 @@ static int kmem_cache_open(struct kmem_cache *s, unsigned long flags)
 	if (!init_kmem_cache_nodes(s))
 		goto error;
 
-	if (alloc_kmem_cache_cpus(s))
+	if (alloc_kmem_cache_cpus(s)) {
+		alloc_kmem_cache_remote_free(s);
 		return 0;
+	}
 
 	free_kmem_cache_nodes(s);
 error:
@@ -3335,6 +3445,7 @@ static inline int kmem_cache_close(struct kmem_cache *s)
 			return 1;
 	}
 	free_percpu(s->cpu_slab);
+	free_kmem_cache_remote_free(s);
 	free_kmem_cache_nodes(s);
 	return 0;
 }
@@ -3824,7 +3935,7 @@ void __init kmem_cache_init(void)
 	kmem_cache_node = bootstrap(&boot_kmem_cache_node);
 
 	/* Now we can use the kmem_cache to allocate kmalloc slabs */
-	create_kmalloc_caches(0);
+	create_kmalloc_caches(SLAB_REMOTE_FREE);
 
 #ifdef CONFIG_SMP
 	register_cpu_notifier(&slab_notifier);
@@ -5007,6 +5118,8 @@ STAT_ATTR(CPU_PARTIAL_ALLOC, cpu_partial_alloc);
 STAT_ATTR(CPU_PARTIAL_FREE, cpu_partial_free);
 STAT_ATTR(CPU_PARTIAL_NODE, cpu_partial_node);
 STAT_ATTR(CPU_PARTIAL_DRAIN, cpu_partial_drain);
+STAT_ATTR(FREE_REMOTE_BATCHED, free_remote_batched);
+STAT_ATTR(FREE_REMOTE_FLUSH, free_remote_flush);
 #endif
 
 static struct attribute *slab_attrs[] = {
@@ -5074,6 +5187,8 @@ static struct attribute *slab_attrs[] = {
 	&cpu_partial_free_attr.attr,
 	&cpu_partial_node_attr.attr,
 	&cpu_partial_drain_attr.attr,
+	&free_remote_batched_attr.attr,
+	&free_remote_flush_attr.attr,
 #endif
 #ifdef CONFIG_FAILSLAB
 	&failslab_attr.attr,
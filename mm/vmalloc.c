@@ -277,7 +277,12 @@ EXPORT_SYMBOL(vmalloc_to_pfn);
 #define VM_LAZY_FREE	0x01
 #define VM_VM_AREA	0x04
 
-static DEFINE_SPINLOCK(vmap_area_lock);
+/*
+ * Lookups by address (vfree, vmalloc_to_page users, /proc/vmallocinfo)
+ * far outnumber allocations and frees, so only the latter exclude each
+ * other.
+ */
+static DEFINE_RWLOCK(vmap_area_lock);
 /* Export for kexec only */
 LIST_HEAD(vmap_area_list);
 static LLIST_HEAD(vmap_purge_list);
@@ -375,7 +380,7 @@ static struct vmap_area *alloc_vmap_area(unsigned long size,
 	kmemleak_scan_area(&va->rb_node, SIZE_MAX, gfp_mask & GFP_RECLAIM_MASK);
 
 retry:
-	spin_lock(&vmap_area_lock);
+	write_lock(&vmap_area_lock);
 	/*
 	 * Invalidate cache if we have more permissive parameters.
 	 * cached_hole_size notes the largest hole noticed _below_
@@ -454,7 +459,7 @@ found:
 	va->flags = 0;
 	__insert_vmap_area(va);
 	free_vmap_cache = &va->rb_node;
-	spin_unlock(&vmap_area_lock);
+	write_unlock(&vmap_area_lock);
 
 	BUG_ON(va->va_start & (align-1));
 	BUG_ON(va->va_start < vstart);
@@ -463,7 +468,7 @@ found:
 	return va;
 
 overflow:
-	spin_unlock(&vmap_area_lock);
+	write_unlock(&vmap_area_lock);
 	if (!purged) {
 		purge_vmap_area_lazy();
 		purged = 1;
@@ -516,9 +521,9 @@ static void __free_vmap_area(struct vmap_area *va)
  */
 static void free_vmap_area(struct vmap_area *va)
 {
-	spin_lock(&vmap_area_lock);
+	write_lock(&vmap_area_lock);
 	__free_vmap_area(va);
-	spin_unlock(&vmap_area_lock);
+	write_unlock(&vmap_area_lock);
 }
 
 /*
@@ -566,13 +571,26 @@ static void vmap_debug_free_range(unsigned long start, unsigned long end)
  * code, and it will be simple to change the scale factor if we find that it
  * becomes a problem on bigger systems.
  */
+#ifdef CONFIG_HISI_VMAP_FLUSH_BATCH
+/*
+ * The vmalloc space is large on arm64 and every purge is a broadcast TLB
+ * invalidate that all cores pay for, so gather four times as much.
+ */
+#define VMAP_LAZY_SCALE		4
+/* purges of more pages than this invalidate the whole TLB at once */
+#define VMAP_FLUSH_AREA_PAGES	64
+#else
+#define VMAP_LAZY_SCALE		1
+#endif
+
 static unsigned long lazy_max_pages(void)
 {
 	unsigned int log;
 
 	log = fls(num_online_cpus());
 
-	return max((log * (32UL * 1024 * 1024 / PAGE_SIZE) * 2 / 3), (32UL * 1024 * 1024 / PAGE_SIZE));
+	return max((log * (32UL * 1024 * 1024 / PAGE_SIZE) * 2 / 3), (32UL * 1024 * 1024 / PAGE_SIZE))
+		* VMAP_LAZY_SCALE;
 }
 
 static atomic_t vmap_lazy_nr = ATOMIC_INIT(0);
@@ -589,6 +607,36 @@ void set_iounmap_nonlazy(void)
 	atomic_set(&vmap_lazy_nr, lazy_max_pages()+1);
 }
 
+#ifdef CONFIG_HISI_VMAP_FLUSH_BATCH
+/*
+ * Flushing the span of all purged areas costs one tlbi per page of that
+ * span, areas far apart make that flush_tlb_all() anyway. Flush few
+ * pages one area at a time and anything bigger with a single broadcast.
+ */
+static void vmap_flush_purged(struct llist_node *valist, int nr,
+			      unsigned long start, unsigned long end)
+{
+	struct vmap_area *va;
+
+	count_vm_event(VMAP_PURGE);
+	if (nr > VMAP_FLUSH_AREA_PAGES) {
+		count_vm_event(VMAP_TLB_FLUSH_ALL);
+		flush_tlb_all();
+		return;
+	}
+
+	count_vm_events(VMAP_TLB_FLUSH_PAGES, nr);
+	llist_for_each_entry(va, valist, purge_list)
+		flush_tlb_kernel_range(va->va_start, va->va_end);
+}
+#else
+static inline void vmap_flush_purged(struct llist_node *valist, int nr,
+				     unsigned long start, unsigned long end)
+{
+	flush_tlb_kernel_range(start, end);
+}
+#endif
+
 /*
  * Purges all lazily-freed vmap areas.
  *
@@ -634,14 +682,16 @@ static void __purge_vmap_area_lazy(unsigned long *start, unsigned long *end,
 	if (nr)
 		atomic_sub(nr, &vmap_lazy_nr);
 
-	if (nr || force_flush)
+	if (force_flush)
 		flush_tlb_kernel_range(*start, *end);
+	else if (nr)
+		vmap_flush_purged(valist, nr, *start, *end);
 
 	if (nr) {
-		spin_lock(&vmap_area_lock);
+		write_lock(&vmap_area_lock);
 		llist_for_each_entry_safe(va, n_va, valist, purge_list)
 			__free_vmap_area(va);
-		spin_unlock(&vmap_area_lock);
+		write_unlock(&vmap_area_lock);
 	}
 	spin_unlock(&purge_lock);
 }
@@ -710,9 +760,9 @@ static struct vmap_area *find_vmap_area(unsigned long addr)
 {
 	struct vmap_area *va;
 
-	spin_lock(&vmap_area_lock);
+	read_lock(&vmap_area_lock);
 	va = __find_vmap_area(addr);
-	spin_unlock(&vmap_area_lock);
+	read_unlock(&vmap_area_lock);
 
 	return va;
 }
@@ -1307,7 +1357,7 @@ EXPORT_SYMBOL_GPL(map_vm_area);
 static void setup_vmalloc_vm(struct vm_struct *vm, struct vmap_area *va,
 			      unsigned long flags, const void *caller)
 {
-	spin_lock(&vmap_area_lock);
+	write_lock(&vmap_area_lock);
 	vm->flags = flags;
 	vm->addr = (void *)va->va_start;
 	vm->size = va->va_end - va->va_start;
@@ -1319,7 +1369,7 @@ static void setup_vmalloc_vm(struct vm_struct *vm, struct vmap_area *va,
 #endif
 	va->vm = vm;
 	va->flags |= VM_VM_AREA;
-	spin_unlock(&vmap_area_lock);
+	write_unlock(&vmap_area_lock);
 }
 
 static void clear_vm_uninitialized_flag(struct vm_struct *vm)
@@ -1441,10 +1491,10 @@ struct vm_struct *remove_vm_area(const void *addr)
 	if (va && va->flags & VM_VM_AREA) {
 		struct vm_struct *vm = va->vm;
 
-		spin_lock(&vmap_area_lock);
+		write_lock(&vmap_area_lock);
 		va->vm = NULL;
 		va->flags &= ~VM_VM_AREA;
-		spin_unlock(&vmap_area_lock);
+		write_unlock(&vmap_area_lock);
 
 		vmap_debug_free_range(va->va_start, va->va_end);
 		kasan_free_shadow(vm);
@@ -2027,7 +2077,7 @@ long vread(char *buf, char *addr, unsigned long count)
 	if ((unsigned long) addr + count < count)
 		count = -(unsigned long) addr;
 
-	spin_lock(&vmap_area_lock);
+	read_lock(&vmap_area_lock);
 	list_for_each_entry(va, &vmap_area_list, list) {
 		if (!count)
 			break;
@@ -2059,7 +2109,7 @@ long vread(char *buf, char *addr, unsigned long count)
 		count -= n;
 	}
 finished:
-	spin_unlock(&vmap_area_lock);
+	read_unlock(&vmap_area_lock);
 
 	if (buf == buf_start)
 		return 0;
@@ -2109,7 +2159,7 @@ long vwrite(char *buf, char *addr, unsigned long count)
 		count = -(unsigned long) addr;
 	buflen = count;
 
-	spin_lock(&vmap_area_lock);
+	read_lock(&vmap_area_lock);
 	list_for_each_entry(va, &vmap_area_list, list) {
 		if (!count)
 			break;
@@ -2140,7 +2190,7 @@ long vwrite(char *buf, char *addr, unsigned long count)
 		count -= n;
 	}
 finished:
-	spin_unlock(&vmap_area_lock);
+	read_unlock(&vmap_area_lock);
 	if (!copied)
 		return 0;
 	return buflen;
@@ -2454,7 +2504,7 @@ struct vm_struct **pcpu_get_vm_areas(const unsigned long *offsets,
 			goto err_free;
 	}
 retry:
-	spin_lock(&vmap_area_lock);
+	write_lock(&vmap_area_lock);
 
 	/* start scanning - we scan from the top, begin with the last area */
 	area = term_area = last_area;
@@ -2476,7 +2526,7 @@ retry:
 		 * comparing.
 		 */
 		if (base + last_end < vmalloc_start + last_end) {
-			spin_unlock(&vmap_area_lock);
+			write_unlock(&vmap_area_lock);
 			if (!purged) {
 				purge_vmap_area_lazy();
 				purged = true;
@@ -2531,7 +2581,7 @@ found:
 
 	vmap_area_pcpu_hole = base + offsets[last_area];
 
-	spin_unlock(&vmap_area_lock);
+	write_unlock(&vmap_area_lock);
 
 	/* insert all vm's */
 	for (area = 0; area < nr_vms; area++)
@@ -2576,7 +2626,7 @@ static void *s_start(struct seq_file *m, loff_t *pos)
 	loff_t n = *pos;
 	struct vmap_area *va;
 
-	spin_lock(&vmap_area_lock);
+	read_lock(&vmap_area_lock);
 	va = list_entry((&vmap_area_list)->next, typeof(*va), list);
 	while (n > 0 && &va->list != &vmap_area_list) {
 		n--;
@@ -2604,7 +2654,7 @@ static void *s_next(struct seq_file *m, void *p, loff_t *pos)
 static void s_stop(struct seq_file *m, void *p)
 	__releases(&vmap_area_lock)
 {
-	spin_unlock(&vmap_area_lock);
+	read_unlock(&vmap_area_lock);
 }
 
 static void show_numa_info(struct seq_file *m, struct vm_struct *v)
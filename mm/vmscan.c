@@ -42,6 +42,7 @@
 #include <linux/freezer.h>
 #include <linux/memcontrol.h>
 #include <linux/delayacct.h>
+#include <linux/psi.h>
 #include <linux/sysctl.h>
 #include <linux/oom.h>
 #include <linux/prefetch.h>
@@ -55,6 +56,7 @@
 #include <linux/balloon_compaction.h>
 
 #include "internal.h"
+#include "hisi/gen_aging.h"
 
 #define CREATE_TRACE_POINTS
 #include <trace/events/vmscan.h>
@@ -88,6 +90,8 @@ struct scan_control {
 #ifdef CONFIG_HUAWEI_RCC
 	/* 0: not in rcc module, 1: scan anon; 2: scan file; 3: scan both*/
 	int rcc_mode;
+	/* pages scanned over all priorities, reported back to rcc */
+	unsigned long rcc_nr_scanned;
 #endif
 
 	/*
@@ -110,6 +114,9 @@ struct scan_control {
 	/* Can cgroups be reclaimed below their normal consumption range? */
 	unsigned int may_thrash:1;
 
+	/* reclaim_weight of the memcg being shrunk, 0 to scan unscaled */
+	unsigned int memcg_weight;
+
 	unsigned int hibernation_mode:1;
 
 	/* One of the zones is ready for compaction */
@@ -948,9 +955,16 @@ static enum page_references page_check_references(struct page *page,
 		if (vm_flags & VM_EXEC)
 			return PAGEREF_ACTIVATE;
 
+		/* Used at all is enough to stay in a protected working set */
+		if (mem_cgroup_ws_protect(page))
+			return PAGEREF_ACTIVATE;
+
 		return PAGEREF_KEEP;
 	}
 
+	if (referenced_page && mem_cgroup_ws_protect(page))
+		return PAGEREF_ACTIVATE;
+
 	/* Reclaim if clean, defer dirty pages to writeback */
 	if (referenced_page && !PageSwapBacked(page))
 		return PAGEREF_RECLAIM_CLEAN;
@@ -2133,6 +2147,10 @@ static void shrink_active_list(unsigned long nr_to_scan,
 				list_add(&page->lru, &l_active);
 				continue;
 			}
+			if (mem_cgroup_ws_protect(page)) {
+				list_add(&page->lru, &l_active);
+				continue;
+			}
 		}
 
 		ClearPageActive(page);	/* we are de-activating */
@@ -2295,10 +2313,6 @@ static void get_scan_count(struct lruvec *lruvec, int swappiness,
 			force_scan = true;
 		if (!mem_cgroup_lruvec_online(lruvec))
 			force_scan = true;
-#ifdef CONFIG_HISI_DIRECT_SWAPPINESS
-	} else {
-		swappiness = direct_vm_swappiness;
-#endif
 	}
 
 	if (!global_reclaim(sc))
@@ -2440,6 +2454,9 @@ out:
 
 			size = get_lru_size(lruvec, lru);
 			scan = size >> sc->priority;
+			if (sc->memcg_weight)
+				scan = min(size, scan * sc->memcg_weight /
+					   MEMCG_RECLAIM_WEIGHT_DEFAULT);
 
 			if (!scan && pass && force_scan)
 				scan = min(size, SWAP_CLUSTER_MAX);
@@ -2735,6 +2752,7 @@ static bool shrink_zone(struct zone *zone, struct scan_control *sc,
 			unsigned long scanned;
 			struct lruvec *lruvec;
 			int swappiness;
+			unsigned int weight;
 
 #ifdef CONFIG_SHRINK_MEMORY_CANCEL
 			if (is_shrink_cancel())
@@ -2746,8 +2764,27 @@ static bool shrink_zone(struct zone *zone, struct scan_control *sc,
 				mem_cgroup_events(memcg, MEMCG_LOW, 1);
 			}
 
+			/*
+			 * Weight 0 groups (top-app, system_server) are left
+			 * alone until reclaim fails elsewhere or escalates.
+			 */
+			weight = mem_cgroup_reclaim_weight(memcg);
+			if (!weight) {
+				if (!sc->may_thrash &&
+				    sc->priority >= DEF_PRIORITY / 2)
+					continue;
+				weight = MEMCG_RECLAIM_WEIGHT_DEFAULT;
+			}
+			sc->memcg_weight = weight;
+
 			lruvec = mem_cgroup_zone_lruvec(zone, memcg);
 			swappiness = mem_cgroup_swappiness(memcg);
+#ifdef CONFIG_HISI_DIRECT_SWAPPINESS
+			/* groups keep their own swappiness in direct reclaim */
+			if (!current_is_kswapd() &&
+			    mem_cgroup_swappiness_is_global(memcg))
+				swappiness = direct_vm_swappiness;
+#endif
 			scanned = sc->nr_scanned;
 
 			shrink_lruvec(lruvec, swappiness, sc, &lru_pages);
@@ -3025,6 +3062,9 @@ retry:
 	} while (--sc->priority >= 0);
 
 	delayacct_freepages_end();
+#ifdef CONFIG_HUAWEI_RCC
+	sc->rcc_nr_scanned = total_scanned;
+#endif
 
 	if (sc->nr_reclaimed)
 		return sc->nr_reclaimed;
@@ -3257,6 +3297,7 @@ unsigned long try_to_free_mem_cgroup_pages(struct mem_cgroup *memcg,
 {
 	struct zonelist *zonelist;
 	unsigned long nr_reclaimed;
+	unsigned long pflags;
 	int nid;
 	struct scan_control sc = {
 		.nr_to_reclaim = max(nr_pages, SWAP_CLUSTER_MAX),
@@ -3282,7 +3323,9 @@ unsigned long try_to_free_mem_cgroup_pages(struct mem_cgroup *memcg,
 					    sc.may_writepage,
 					    sc.gfp_mask);
 
+	psi_memstall_enter(&pflags);
 	nr_reclaimed = do_try_to_free_pages(zonelist, &sc);
+	psi_memstall_leave(&pflags);
 
 	trace_mm_vmscan_memcg_reclaim_end(nr_reclaimed);
 
@@ -3727,6 +3770,7 @@ static int kswapd(void *p)
 	int balanced_classzone_idx;
 	pg_data_t *pgdat = (pg_data_t*)p;
 	struct task_struct *tsk = current;
+	unsigned long pflags;
 
 	struct reclaim_state reclaim_state = {
 		.reclaimed_slab = 0,
@@ -3797,8 +3841,11 @@ static int kswapd(void *p)
 		 */
 		if (!ret) {
 			trace_mm_vmscan_kswapd_wake(pgdat->node_id, order);
+			gen_aging_kswapd_wake(pgdat);
+			psi_memstall_enter(&pflags);
 			balanced_classzone_idx = balance_pgdat(pgdat, order,
 								classzone_idx);
+			psi_memstall_leave(&pflags);
 		}
 	}
 
@@ -4238,11 +4285,13 @@ void check_move_unevictable_pages(struct page **pages, int nr_pages)
  * arguments:
  *    nr_pages: page count need to free.
  *    mode:  1: scan anon; 2: scan file; 3: scan both.
+ *    nr_scanned: if not NULL, incremented by the pages scanned.
  * output:
  *    page count free  in this time.
  */
-int try_to_free_pages_ex(int nr_pages, int mode)
+int try_to_free_pages_ex(int nr_pages, int mode, unsigned long *nr_scanned)
 {
+	int nr_reclaimed;
 	gfp_t mask = GFP_KERNEL|__GFP_HIGHMEM|__GFP_FS|__GFP_IO;
 	struct scan_control sc = {
 		.gfp_mask = mask,
@@ -4257,7 +4306,11 @@ int try_to_free_pages_ex(int nr_pages, int mode)
 		.nodemask = NULL,
 	};
 	struct zonelist *zonelist = node_zonelist(numa_node_id(), mask);
-	return do_try_to_free_pages(zonelist, &sc);
+
+	nr_reclaimed = do_try_to_free_pages(zonelist, &sc);
+	if (nr_scanned)
+		*nr_scanned += sc.rcc_nr_scanned;
+	return nr_reclaimed;
 }
 #endif
 
@@ -673,6 +673,26 @@ int fragmentation_index(struct zone *zone, unsigned int order)
 	fill_contig_page_info(zone, order, &info);
 	return __fragmentation_index(order, &info);
 }
+
+/*
+ * Percentage of the free memory of a zone that sits in blocks too small
+ * for an allocation of the given order, the unusable free space index
+ * scaled to 0..100.
+ */
+unsigned int fragmentation_score(struct zone *zone, unsigned int order)
+{
+	struct contig_page_info info;
+	unsigned long suitable;
+
+	fill_contig_page_info(zone, order, &info);
+	if (!info.free_pages)
+		return 0;
+
+	/* nr_free is read unlocked, keep a racy sum in range */
+	suitable = min(info.free_blocks_suitable << order, info.free_pages);
+	return div_u64((info.free_pages - suitable) * 100ULL,
+		       info.free_pages);
+}
 #endif
 
 #if defined(CONFIG_PROC_FS) || defined(CONFIG_SYSFS) || defined(CONFIG_NUMA)
@@ -794,6 +814,16 @@ const char * const vmstat_text[] = {
 	"drop_pagecache",
 	"drop_slab",
 
+#ifdef CONFIG_HISI_PCP_HIGH_ORDER
+	"pcp_highorder_alloc_hit",
+	"pcp_highorder_free_hit",
+#endif
+#ifdef CONFIG_HISI_VMAP_FLUSH_BATCH
+	"vmap_purge",
+	"vmap_tlb_flush_all",
+	"vmap_tlb_flush_pages",
+#endif
+
 #ifdef CONFIG_NUMA_BALANCING
 	"numa_pte_updates",
 	"numa_huge_pte_updates",
@@ -813,6 +843,10 @@ const char * const vmstat_text[] = {
 	"compact_fail",
 	"compact_success",
 	"compact_daemon_wake",
+#ifdef CONFIG_HISI_PROACTIVE_COMPACTION
+	"compact_proactive_success",
+	"compact_proactive_fail",
+#endif
 #endif
 
 #ifdef CONFIG_HUGETLB_PAGE
@@ -857,6 +891,18 @@ const char * const vmstat_text[] = {
 	"vmacache_find_hits",
 	"vmacache_full_flushes",
 #endif
+#ifdef CONFIG_SWAP
+	"swap_ra",
+	"swap_ra_hit",
+#endif
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+	"speculative_pgfault",
+#endif
+#ifdef CONFIG_ARM64_CONT_PTE
+	"cont_pte_alloc",
+	"cont_pte_fallback",
+	"cont_pte_split",
+#endif
 #endif /* CONFIG_VM_EVENTS_COUNTERS */
 };
 #endif /* CONFIG_PROC_FS || CONFIG_SYSFS || CONFIG_NUMA */
@@ -1813,6 +1813,65 @@ void zs_pool_stats(struct zs_pool *pool, struct zs_pool_stats *stats)
 }
 EXPORT_SYMBOL_GPL(zs_pool_stats);
 
+/*
+ * Fill @stats with the occupancy of size class @index. Returns -EINVAL
+ * past the last class, and -ENOENT for a class merged into a larger one
+ * (its objects are accounted there), so callers can simply walk all
+ * indices until -EINVAL.
+ */
+int zs_class_stats(struct zs_pool *pool, int index,
+			struct zs_class_stats *stats)
+{
+	struct size_class *class;
+	int objs_per_zspage;
+
+	if (index < 0 || index >= zs_size_classes)
+		return -EINVAL;
+
+	class = pool->size_class[index];
+	if (!class || class->index != index)
+		return -ENOENT;
+
+	spin_lock(&class->lock);
+	stats->objs_allocated = zs_stat_get(class, OBJ_ALLOCATED);
+	stats->objs_used = zs_stat_get(class, OBJ_USED);
+	stats->pages_compactable = zs_can_compact(class);
+	spin_unlock(&class->lock);
+
+	objs_per_zspage = get_maxobj_per_zspage(class->size,
+			class->pages_per_zspage);
+	stats->size = class->size;
+	stats->pages_used = stats->objs_allocated / objs_per_zspage *
+			class->pages_per_zspage;
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(zs_class_stats);
+
+/*
+ * Estimate of how many pages zs_compact() could release right now,
+ * summed over all size classes.
+ */
+unsigned long zs_compactable_pages(struct zs_pool *pool)
+{
+	int i;
+	struct size_class *class;
+	unsigned long pages_to_free = 0;
+
+	for (i = zs_size_classes - 1; i >= 0; i--) {
+		class = pool->size_class[i];
+		if (!class)
+			continue;
+		if (class->index != i)
+			continue;
+
+		pages_to_free += zs_can_compact(class);
+	}
+
+	return pages_to_free;
+}
+EXPORT_SYMBOL_GPL(zs_compactable_pages);
+
 static unsigned long zs_shrinker_scan(struct shrinker *shrinker,
 		struct shrink_control *sc)
 {
@@ -1834,23 +1893,10 @@ static unsigned long zs_shrinker_scan(struct shrinker *shrinker,
 static unsigned long zs_shrinker_count(struct shrinker *shrinker,
 		struct shrink_control *sc)
 {
-	int i;
-	struct size_class *class;
-	unsigned long pages_to_free = 0;
 	struct zs_pool *pool = container_of(shrinker, struct zs_pool,
 			shrinker);
 
-	for (i = zs_size_classes - 1; i >= 0; i--) {
-		class = pool->size_class[i];
-		if (!class)
-			continue;
-		if (class->index != i)
-			continue;
-
-		pages_to_free += zs_can_compact(class);
-	}
-
-	return pages_to_free;
+	return zs_compactable_pages(pool);
 }
 
 static void zs_unregister_shrinker(struct zs_pool *pool)
@@ -664,34 +664,19 @@ static ssize_t show_rps_map(struct netdev_rx_queue *queue,
 	return len < PAGE_SIZE ? len : -EINVAL;
 }
 
-static ssize_t store_rps_map(struct netdev_rx_queue *queue,
-		      struct rx_queue_attribute *attribute,
-		      const char *buf, size_t len)
+static DEFINE_SPINLOCK(rps_map_lock);
+
+static int __netif_set_rps_map(struct netdev_rx_queue *queue,
+			       const struct cpumask *mask)
 {
 	struct rps_map *old_map, *map;
-	cpumask_var_t mask;
-	int err, cpu, i;
-	static DEFINE_SPINLOCK(rps_map_lock);
-
-	if (!capable(CAP_NET_ADMIN))
-		return -EPERM;
-
-	if (!alloc_cpumask_var(&mask, GFP_KERNEL))
-		return -ENOMEM;
-
-	err = bitmap_parse(buf, len, cpumask_bits(mask), nr_cpumask_bits);
-	if (err) {
-		free_cpumask_var(mask);
-		return err;
-	}
+	int cpu, i;
 
 	map = kzalloc(max_t(unsigned int,
 	    RPS_MAP_SIZE(cpumask_weight(mask)), L1_CACHE_BYTES),
 	    GFP_KERNEL);
-	if (!map) {
-		free_cpumask_var(mask);
+	if (!map)
 		return -ENOMEM;
-	}
 
 	i = 0;
 	for_each_cpu_and(cpu, mask, cpu_online_mask)
@@ -716,8 +701,48 @@ static ssize_t store_rps_map(struct netdev_rx_queue *queue,
 		kfree_rcu(old_map, rcu);
 		static_key_slow_dec(&rps_needed);
 	}
+	return 0;
+}
+
+/**
+ *	netif_set_rps_cpus - set the RPS CPU map of a receive queue
+ *	@dev: network device
+ *	@mask: CPUs to steer received packets to, empty to disable RPS
+ *	@index: receive queue index
+ *
+ *	In-kernel equivalent of writing the queue's rps_cpus attribute,
+ *	for drivers that retune their receive steering at runtime.
+ *	Must be called from process context.
+ */
+int netif_set_rps_cpus(struct net_device *dev, const struct cpumask *mask,
+		       u16 index)
+{
+	if (index >= dev->real_num_rx_queues)
+		return -EINVAL;
+
+	return __netif_set_rps_map(dev->_rx + index, mask);
+}
+EXPORT_SYMBOL(netif_set_rps_cpus);
+
+static ssize_t store_rps_map(struct netdev_rx_queue *queue,
+		      struct rx_queue_attribute *attribute,
+		      const char *buf, size_t len)
+{
+	cpumask_var_t mask;
+	int err;
+
+	if (!capable(CAP_NET_ADMIN))
+		return -EPERM;
+
+	if (!alloc_cpumask_var(&mask, GFP_KERNEL))
+		return -ENOMEM;
+
+	err = bitmap_parse(buf, len, cpumask_bits(mask), nr_cpumask_bits);
+	if (!err)
+		err = __netif_set_rps_map(queue, mask);
+
 	free_cpumask_var(mask);
-	return len;
+	return err ? err : len;
 }
 
 static ssize_t show_rps_dev_flow_table_cnt(struct netdev_rx_queue *queue,
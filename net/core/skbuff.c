@@ -3314,12 +3314,14 @@ void __init skb_init(void)
 	skbuff_head_cache = kmem_cache_create("skbuff_head_cache",
 					      sizeof(struct sk_buff),
 					      0,
-					      SLAB_HWCACHE_ALIGN|SLAB_PANIC|SLAB_CACHE_DMA,
+					      SLAB_HWCACHE_ALIGN|SLAB_PANIC|SLAB_CACHE_DMA|
+					      SLAB_REMOTE_FREE,
 					      NULL);
 	skbuff_fclone_cache = kmem_cache_create("skbuff_fclone_cache",
 						sizeof(struct sk_buff_fclones),
 						0,
-						SLAB_HWCACHE_ALIGN|SLAB_PANIC|SLAB_CACHE_DMA,
+						SLAB_HWCACHE_ALIGN|SLAB_PANIC|SLAB_CACHE_DMA|
+						SLAB_REMOTE_FREE,
 						NULL);
 }
 
@@ -4147,6 +4149,8 @@ unsigned int skb_gso_transport_seglen(const struct sk_buff *skb)
 			thlen += inner_tcp_hdrlen(skb);
 	} else if (likely(shinfo->gso_type & (SKB_GSO_TCPV4 | SKB_GSO_TCPV6))) {
 		thlen = tcp_hdrlen(skb);
+	} else if (unlikely(shinfo->gso_type & SKB_GSO_UDP_L4)) {
+		thlen = sizeof(struct udphdr);
 	}
 	/* UFO sets gso_size to the size of the fragmentation
 	 * payload, i.e. the size of the L4 (UDP) header is already
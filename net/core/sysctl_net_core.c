@@ -428,6 +428,13 @@ static struct ctl_table net_core_table[] = {
 		.mode		= 0644,
 		.proc_handler	= proc_dointvec
 	},
+	{
+		/* Outcome of crosslayer dropped notifications */
+		.procname	= "aspen_recovery_stats",
+		.maxlen		= ASPEN_RECOVERY_STATS_BUF_MAX,
+		.mode		= 0444,
+		.proc_handler	= proc_aspen_recovery_stats,
+	},
 #ifdef CONFIG_HW_CROSSLAYER_OPT_DBG_MODULE
 	{
 		.procname       = "aspen_monitor_port_range",
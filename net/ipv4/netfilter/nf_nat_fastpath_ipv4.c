@@ -0,0 +1,549 @@
+/* Forwarding fast path for established NATed IPv4 flows
+ *
+ * Once conntrack has seen both directions of a forwarded TCP or UDP
+ * connection, the translation and the route of each direction are
+ * cached here.  Later packets of that flow are rewritten and handed to
+ * the neighbour layer straight from PRE_ROUTING, skipping conntrack,
+ * NAT, the routing lookup and the FORWARD/POST_ROUTING hooks.  TCP
+ * FIN/RST/SYN, route changes and dying conntracks send the flow back
+ * to the regular path.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/types.h>
+#include <linux/module.h>
+#include <linux/hashtable.h>
+#include <linux/jhash.h>
+#include <linux/ip.h>
+#include <linux/tcp.h>
+#include <linux/udp.h>
+#include <linux/netdevice.h>
+#include <linux/netfilter.h>
+#include <linux/netfilter_ipv4.h>
+#include <linux/percpu.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/workqueue.h>
+#include <net/arp.h>
+#include <net/checksum.h>
+#include <net/dst.h>
+#include <net/ip.h>
+#include <net/neighbour.h>
+#include <net/route.h>
+#include <net/netfilter/nf_conntrack.h>
+#include <net/netfilter/nf_conntrack_core.h>
+#include <net/netfilter/nf_conntrack_helper.h>
+
+static bool enable __read_mostly = true;
+module_param(enable, bool, 0644);
+MODULE_PARM_DESC(enable, "offload established forwarded flows");
+
+static unsigned int max_flows __read_mostly = 4096;
+module_param(max_flows, uint, 0644);
+MODULE_PARM_DESC(max_flows, "maximum number of offloaded flow directions");
+
+/* Flows idle for this long are returned to the regular path */
+#define NF_FASTPATH_IDLE	(30 * HZ)
+#define NF_FASTPATH_GC_INTERVAL	HZ
+#define NF_FASTPATH_HASH_BITS	10
+
+struct nf_fastpath_ports {
+	__be16 source;
+	__be16 dest;
+};
+
+/* One direction of a connection, as received on iif */
+struct nf_fastpath_flow {
+	struct hlist_node	hnode;
+	struct rcu_head		rcu;
+
+	__be32			saddr;
+	__be32			daddr;
+	__be16			sport;
+	__be16			dport;
+	u8			protonum;
+	int			iif;
+
+	__be32			new_saddr;
+	__be32			new_daddr;
+	__be16			new_sport;
+	__be16			new_dport;
+
+	struct dst_entry	*dst;
+	struct nf_conn		*ct;
+	unsigned long		ct_timeout;	/* conntrack timeout to refresh with */
+	unsigned long		last_refresh;
+	unsigned long		last_used;
+};
+
+struct nf_fastpath_stats {
+	u64 packets;
+	u64 bytes;
+	u64 learned;
+	u64 teardown;
+};
+
+static DEFINE_HASHTABLE(nf_fastpath_hash, NF_FASTPATH_HASH_BITS);
+static DEFINE_SPINLOCK(nf_fastpath_lock);
+static unsigned int nf_fastpath_count;
+static u32 nf_fastpath_rnd __read_mostly;
+static struct nf_fastpath_stats __percpu *nf_fastpath_stats;
+static struct delayed_work nf_fastpath_gc_work;
+
+static inline u32 nf_fastpath_hashfn(__be32 saddr, __be32 daddr,
+				     __be16 sport, __be16 dport,
+				     u8 protonum, int iif)
+{
+	return jhash_3words((__force u32)saddr, (__force u32)daddr,
+			    ((__force u32)sport << 16 | (__force u32)dport) ^
+			    protonum, nf_fastpath_rnd ^ iif);
+}
+
+static struct nf_fastpath_flow *
+nf_fastpath_lookup(__be32 saddr, __be32 daddr, __be16 sport, __be16 dport,
+		   u8 protonum, int iif)
+{
+	struct nf_fastpath_flow *flow;
+	u32 hash = nf_fastpath_hashfn(saddr, daddr, sport, dport, protonum, iif);
+
+	hash_for_each_possible_rcu(nf_fastpath_hash, flow, hnode, hash) {
+		if (flow->saddr == saddr && flow->daddr == daddr &&
+		    flow->sport == sport && flow->dport == dport &&
+		    flow->protonum == protonum && flow->iif == iif)
+			return flow;
+	}
+
+	return NULL;
+}
+
+static void nf_fastpath_flow_free(struct rcu_head *head)
+{
+	struct nf_fastpath_flow *flow =
+		container_of(head, struct nf_fastpath_flow, rcu);
+
+	dst_release(flow->dst);
+	nf_ct_put(flow->ct);
+	kfree(flow);
+}
+
+/* Called with nf_fastpath_lock held */
+static void __nf_fastpath_teardown(struct nf_fastpath_flow *flow)
+{
+	hash_del_rcu(&flow->hnode);
+	nf_fastpath_count--;
+	this_cpu_inc(nf_fastpath_stats->teardown);
+	call_rcu(&flow->rcu, nf_fastpath_flow_free);
+}
+
+static void nf_fastpath_teardown(struct nf_fastpath_flow *flow)
+{
+	spin_lock_bh(&nf_fastpath_lock);
+	/* Another CPU may have torn it down first */
+	if (!hlist_unhashed(&flow->hnode))
+		__nf_fastpath_teardown(flow);
+	spin_unlock_bh(&nf_fastpath_lock);
+}
+
+static void nf_fastpath_nat(struct sk_buff *skb, struct iphdr *iph,
+			    struct nf_fastpath_ports *ports,
+			    const struct nf_fastpath_flow *flow)
+{
+	__sum16 *check = NULL;
+
+	if (iph->protocol == IPPROTO_TCP) {
+		check = &((struct tcphdr *)ports)->check;
+	} else {
+		struct udphdr *uh = (struct udphdr *)ports;
+
+		if (uh->check || skb->ip_summed == CHECKSUM_PARTIAL)
+			check = &uh->check;
+	}
+
+	if (iph->saddr != flow->new_saddr) {
+		if (check)
+			inet_proto_csum_replace4(check, skb, iph->saddr,
+						 flow->new_saddr, 1);
+		csum_replace4(&iph->check, iph->saddr, flow->new_saddr);
+		iph->saddr = flow->new_saddr;
+	}
+	if (iph->daddr != flow->new_daddr) {
+		if (check)
+			inet_proto_csum_replace4(check, skb, iph->daddr,
+						 flow->new_daddr, 1);
+		csum_replace4(&iph->check, iph->daddr, flow->new_daddr);
+		iph->daddr = flow->new_daddr;
+	}
+	if (ports->source != flow->new_sport) {
+		if (check)
+			inet_proto_csum_replace2(check, skb, ports->source,
+						 flow->new_sport, 0);
+		ports->source = flow->new_sport;
+	}
+	if (ports->dest != flow->new_dport) {
+		if (check)
+			inet_proto_csum_replace2(check, skb, ports->dest,
+						 flow->new_dport, 0);
+		ports->dest = flow->new_dport;
+	}
+
+	if (iph->protocol == IPPROTO_UDP && check && !*check)
+		*check = CSUM_MANGLED_0;
+}
+
+static unsigned int nf_fastpath_in(const struct nf_hook_ops *ops,
+				   struct sk_buff *skb,
+				   const struct nf_hook_state *state)
+{
+	struct nf_fastpath_stats *stats;
+	struct nf_fastpath_ports *ports;
+	struct nf_fastpath_flow *flow;
+	struct net_device *dev;
+	struct dst_entry *dst;
+	struct neighbour *neigh;
+	struct iphdr *iph;
+	unsigned int hdrlen;
+
+	if (!enable || skb->pkt_type != PACKET_HOST ||
+	    !net_eq(dev_net(state->in), &init_net))
+		return NF_ACCEPT;
+
+	iph = ip_hdr(skb);
+	if (iph->ihl != 5 || ip_is_fragment(iph) || iph->ttl <= 1)
+		return NF_ACCEPT;
+
+	if (iph->protocol == IPPROTO_TCP)
+		hdrlen = sizeof(struct iphdr) + sizeof(struct tcphdr);
+	else if (iph->protocol == IPPROTO_UDP)
+		hdrlen = sizeof(struct iphdr) + sizeof(struct udphdr);
+	else
+		return NF_ACCEPT;
+
+	if (!pskb_may_pull(skb, hdrlen))
+		return NF_ACCEPT;
+
+	iph = ip_hdr(skb);
+	ports = (struct nf_fastpath_ports *)(skb_network_header(skb) +
+					     sizeof(struct iphdr));
+	flow = nf_fastpath_lookup(iph->saddr, iph->daddr, ports->source,
+				  ports->dest, iph->protocol,
+				  state->in->ifindex);
+	if (!flow)
+		return NF_ACCEPT;
+
+	/* Let conntrack see connection setup and teardown */
+	if (iph->protocol == IPPROTO_TCP) {
+		const struct tcphdr *th = (const struct tcphdr *)ports;
+
+		if (unlikely(th->fin || th->rst || th->syn)) {
+			nf_fastpath_teardown(flow);
+			return NF_ACCEPT;
+		}
+	}
+
+	dst = flow->dst;
+	if (unlikely(nf_ct_is_dying(flow->ct) || !dst_check(dst, 0))) {
+		nf_fastpath_teardown(flow);
+		return NF_ACCEPT;
+	}
+
+	/* Fragmentation and PMTU errors belong to ip_forward() */
+	if (skb->len > dst_mtu(dst))
+		return NF_ACCEPT;
+
+	dev = dst->dev;
+	if (unlikely(skb_headroom(skb) < LL_RESERVED_SPACE(dev) &&
+		     dev->header_ops))
+		return NF_ACCEPT;
+
+	neigh = __ipv4_neigh_lookup_noref(dev,
+			(__force u32)rt_nexthop((struct rtable *)dst,
+						flow->new_daddr));
+	if (unlikely(!neigh))
+		return NF_ACCEPT;
+
+	if (!skb_make_writable(skb, hdrlen))
+		return NF_ACCEPT;
+
+	iph = ip_hdr(skb);
+	ports = (struct nf_fastpath_ports *)(skb_network_header(skb) +
+					     sizeof(struct iphdr));
+	nf_fastpath_nat(skb, iph, ports, flow);
+	ip_decrease_ttl(iph);
+
+	if (flow->last_used != jiffies)
+		flow->last_used = jiffies;
+	if (time_after(jiffies, flow->last_refresh + HZ)) {
+		flow->last_refresh = jiffies;
+		nf_ct_refresh(flow->ct, skb, flow->ct_timeout);
+	}
+
+	stats = this_cpu_ptr(nf_fastpath_stats);
+	stats->packets++;
+	stats->bytes += skb->len;
+
+	skb_forward_csum(skb);
+	skb_sender_cpu_clear(skb);
+	skb->dev = dev;
+	skb_dst_set_noref(skb, dst);
+	dst_neigh_output(dst, neigh, skb);
+
+	return NF_STOLEN;
+}
+
+static bool nf_fastpath_ct_eligible(struct nf_conn *ct)
+{
+	if (nf_ct_is_untracked(ct) || !nf_ct_is_confirmed(ct) ||
+	    nf_ct_is_dying(ct) || !test_bit(IPS_ASSURED_BIT, &ct->status))
+		return false;
+
+	/* Helpers and sequence adjustment need to see every packet */
+	if (ct->status & IPS_SEQ_ADJUST || nfct_help(ct))
+		return false;
+
+	switch (nf_ct_protonum(ct)) {
+	case IPPROTO_TCP:
+		return ct->proto.tcp.state == TCP_CONNTRACK_ESTABLISHED;
+	case IPPROTO_UDP:
+		return true;
+	}
+
+	return false;
+}
+
+static unsigned int nf_fastpath_learn(const struct nf_hook_ops *ops,
+				      struct sk_buff *skb,
+				      const struct nf_hook_state *state)
+{
+	const struct nf_conntrack_tuple *orig, *repl;
+	enum ip_conntrack_info ctinfo;
+	struct nf_fastpath_flow *flow;
+	struct dst_entry *dst = skb_dst(skb);
+	struct nf_conn *ct;
+	int dir, iif = skb->skb_iif;
+	u32 hash;
+
+	if (!enable || !(IPCB(skb)->flags & IPSKB_FORWARDED) ||
+	    !dst || dst_xfrm(dst) || !net_eq(dev_net(state->out), &init_net))
+		return NF_ACCEPT;
+
+	ct = nf_ct_get(skb, &ctinfo);
+	if (!ct || !nf_fastpath_ct_eligible(ct))
+		return NF_ACCEPT;
+
+	dir = CTINFO2DIR(ctinfo);
+	orig = &ct->tuplehash[dir].tuple;
+	repl = &ct->tuplehash[!dir].tuple;
+
+	if (nf_fastpath_lookup(orig->src.u3.ip, orig->dst.u3.ip,
+			       orig->src.u.all, orig->dst.u.all,
+			       orig->dst.protonum, iif))
+		return NF_ACCEPT;
+
+	if (ACCESS_ONCE(nf_fastpath_count) >= max_flows)
+		return NF_ACCEPT;
+
+	flow = kzalloc(sizeof(*flow), GFP_ATOMIC);
+	if (!flow)
+		return NF_ACCEPT;
+
+	flow->saddr = orig->src.u3.ip;
+	flow->daddr = orig->dst.u3.ip;
+	flow->sport = orig->src.u.all;
+	flow->dport = orig->dst.u.all;
+	flow->protonum = orig->dst.protonum;
+	flow->iif = iif;
+	flow->new_saddr = repl->dst.u3.ip;
+	flow->new_daddr = repl->src.u3.ip;
+	flow->new_sport = repl->dst.u.all;
+	flow->new_dport = repl->src.u.all;
+
+	/* Conntrack has just refreshed the entry for this packet */
+	flow->ct_timeout = max_t(long, ct->timeout.expires - jiffies, HZ);
+	flow->last_refresh = jiffies;
+	flow->last_used = jiffies;
+
+	dst_hold(dst);
+	flow->dst = dst;
+	nf_conntrack_get(&ct->ct_general);
+	flow->ct = ct;
+
+	hash = nf_fastpath_hashfn(flow->saddr, flow->daddr, flow->sport,
+				  flow->dport, flow->protonum, iif);
+
+	spin_lock_bh(&nf_fastpath_lock);
+	if (nf_fastpath_count >= max_flows ||
+	    nf_fastpath_lookup(flow->saddr, flow->daddr, flow->sport,
+			       flow->dport, flow->protonum, iif)) {
+		spin_unlock_bh(&nf_fastpath_lock);
+		dst_release(flow->dst);
+		nf_ct_put(flow->ct);
+		kfree(flow);
+		return NF_ACCEPT;
+	}
+	hash_add_rcu(nf_fastpath_hash, &flow->hnode, hash);
+	nf_fastpath_count++;
+	spin_unlock_bh(&nf_fastpath_lock);
+
+	this_cpu_inc(nf_fastpath_stats->learned);
+
+	return NF_ACCEPT;
+}
+
+/* Tear down flows using dev, or all of them if dev is NULL */
+static void nf_fastpath_flush(const struct net_device *dev)
+{
+	struct nf_fastpath_flow *flow;
+	struct hlist_node *tmp;
+	int bkt;
+
+	spin_lock_bh(&nf_fastpath_lock);
+	hash_for_each_safe(nf_fastpath_hash, bkt, tmp, flow, hnode) {
+		if (!dev || flow->dst->dev == dev || flow->iif == dev->ifindex)
+			__nf_fastpath_teardown(flow);
+	}
+	spin_unlock_bh(&nf_fastpath_lock);
+}
+
+static void nf_fastpath_gc(struct work_struct *work)
+{
+	struct nf_fastpath_flow *flow;
+	struct hlist_node *tmp;
+	int bkt;
+
+	spin_lock_bh(&nf_fastpath_lock);
+	hash_for_each_safe(nf_fastpath_hash, bkt, tmp, flow, hnode) {
+		if (time_after(jiffies, flow->last_used + NF_FASTPATH_IDLE) ||
+		    nf_ct_is_dying(flow->ct) || !dst_check(flow->dst, 0))
+			__nf_fastpath_teardown(flow);
+	}
+	spin_unlock_bh(&nf_fastpath_lock);
+
+	queue_delayed_work(system_power_efficient_wq, &nf_fastpath_gc_work,
+			   NF_FASTPATH_GC_INTERVAL);
+}
+
+static int nf_fastpath_netdev_event(struct notifier_block *this,
+				    unsigned long event, void *ptr)
+{
+	struct net_device *dev = netdev_notifier_info_to_dev(ptr);
+
+	if (event == NETDEV_DOWN || event == NETDEV_UNREGISTER)
+		nf_fastpath_flush(dev);
+
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block nf_fastpath_netdev_notifier = {
+	.notifier_call	= nf_fastpath_netdev_event,
+};
+
+static struct nf_hook_ops nf_fastpath_ops[] __read_mostly = {
+	{
+		.hook		= nf_fastpath_in,
+		.owner		= THIS_MODULE,
+		.pf		= NFPROTO_IPV4,
+		.hooknum	= NF_INET_PRE_ROUTING,
+		.priority	= NF_IP_PRI_FIRST,
+	},
+	/* After SNAT, so both translations are in place */
+	{
+		.hook		= nf_fastpath_learn,
+		.owner		= THIS_MODULE,
+		.pf		= NFPROTO_IPV4,
+		.hooknum	= NF_INET_POST_ROUTING,
+		.priority	= NF_IP_PRI_NAT_SRC + 1,
+	},
+};
+
+static int nf_fastpath_seq_show(struct seq_file *s, void *v)
+{
+	struct nf_fastpath_stats sum = { 0 };
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		const struct nf_fastpath_stats *st =
+			per_cpu_ptr(nf_fastpath_stats, cpu);
+
+		sum.packets += st->packets;
+		sum.bytes += st->bytes;
+		sum.learned += st->learned;
+		sum.teardown += st->teardown;
+	}
+
+	seq_printf(s, "flows %u\npackets %llu\nbytes %llu\nlearned %llu\nteardown %llu\n",
+		   ACCESS_ONCE(nf_fastpath_count), sum.packets, sum.bytes,
+		   sum.learned, sum.teardown);
+	return 0;
+}
+
+static int nf_fastpath_seq_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, nf_fastpath_seq_show, NULL);
+}
+
+static const struct file_operations nf_fastpath_fops = {
+	.owner		= THIS_MODULE,
+	.open		= nf_fastpath_seq_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init nf_nat_fastpath_ipv4_init(void)
+{
+	int err;
+
+	get_random_bytes(&nf_fastpath_rnd, sizeof(nf_fastpath_rnd));
+
+	nf_fastpath_stats = alloc_percpu(struct nf_fastpath_stats);
+	if (!nf_fastpath_stats)
+		return -ENOMEM;
+
+	if (!proc_create("nf_nat_fastpath", S_IRUGO, init_net.proc_net,
+			 &nf_fastpath_fops)) {
+		err = -ENOMEM;
+		goto err_stats;
+	}
+
+	err = register_netdevice_notifier(&nf_fastpath_netdev_notifier);
+	if (err < 0)
+		goto err_proc;
+
+	err = nf_register_hooks(nf_fastpath_ops, ARRAY_SIZE(nf_fastpath_ops));
+	if (err < 0)
+		goto err_notifier;
+
+	INIT_DELAYED_WORK(&nf_fastpath_gc_work, nf_fastpath_gc);
+	queue_delayed_work(system_power_efficient_wq, &nf_fastpath_gc_work,
+			   NF_FASTPATH_GC_INTERVAL);
+
+	return 0;
+
+err_notifier:
+	unregister_netdevice_notifier(&nf_fastpath_netdev_notifier);
+err_proc:
+	remove_proc_entry("nf_nat_fastpath", init_net.proc_net);
+err_stats:
+	free_percpu(nf_fastpath_stats);
+	return err;
+}
+
+static void __exit nf_nat_fastpath_ipv4_fini(void)
+{
+	nf_unregister_hooks(nf_fastpath_ops, ARRAY_SIZE(nf_fastpath_ops));
+	unregister_netdevice_notifier(&nf_fastpath_netdev_notifier);
+	cancel_delayed_work_sync(&nf_fastpath_gc_work);
+	nf_fastpath_flush(NULL);
+	rcu_barrier();
+	remove_proc_entry("nf_nat_fastpath", init_net.proc_net);
+	free_percpu(nf_fastpath_stats);
+}
+
+module_init(nf_nat_fastpath_ipv4_init);
+module_exit(nf_nat_fastpath_ipv4_fini);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Forwarding fast path for established NATed IPv4 flows");
@@ -402,6 +402,8 @@ void tcp_init_sock(struct sock *sk)
 
 	icsk->icsk_rto = TCP_TIMEOUT_INIT;
 	tp->mdev_us = jiffies_to_usecs(TCP_TIMEOUT_INIT);
+	minmax_reset(&tp->rtt_min, tcp_time_stamp, ~0U);
+	tp->app_limited = ~0U;
 
 	/* So many TCP implementations out there (incorrectly) count the
 	 * initial SYN frame in their delayed-ACK and congestion control
@@ -1114,6 +1116,8 @@ int tcp_sendmsg(struct sock *sk, struct msghdr *msg, size_t size)
 
 	timeo = sock_sndtimeo(sk, flags & MSG_DONTWAIT);
 
+	tcp_rate_check_app_limited(sk);  /* is sending application-limited? */
+
 	/* Wait for a connection to finish. One exception is TCP Fast Open
 	 * (passive side) where data is allowed to be sent before a connection
 	 * is fully established.
@@ -1974,6 +1978,11 @@ void tcp_set_state(struct sock *sk, int state)
 	 */
 	sk->sk_state = state;
 
+#ifdef CONFIG_HW_WIFI
+	if (state == TCP_SYN_SENT)
+		wifi_tcp_stat_bind(sk);
+#endif
+
 #ifdef CONFIG_HW_WIFIPRO
 	if (state == TCP_SYN_SENT) {
 		if (is_wifipro_on && is_mcc_china && wifipro_is_not_local_or_lan_sock(dest_addr)) {
@@ -2296,6 +2305,15 @@ int tcp_disconnect(struct sock *sk, int flags)
 	tp->snd_ssthresh = TCP_INFINITE_SSTHRESH;
 	tp->snd_cwnd_cnt = 0;
 	tp->window_clamp = 0;
+	tp->delivered = 0;
+	tp->lost = 0;
+	tp->app_limited = ~0U;
+	tp->first_tx_mstamp.v64 = 0;
+	tp->delivered_mstamp.v64 = 0;
+	tp->rate_delivered = 0;
+	tp->rate_interval_us = 0;
+	tp->rate_app_limited = 0;
+	minmax_reset(&tp->rtt_min, tcp_time_stamp, ~0U);
 	tcp_set_ca_state(sk, TCP_CA_Open);
 	tcp_clear_retrans(tp);
 	inet_csk_delack_init(sk);
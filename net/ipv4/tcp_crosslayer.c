@@ -11,30 +11,51 @@
 #include <linux/slab.h>
 #include <linux/hash.h>
 #include <linux/bootmem.h>
-#include <linux/sort.h>
+#include <linux/jhash.h>
+#include <linux/random.h>
+#include <linux/workqueue.h>
 #include <uapi/linux/netlink.h>
 #include <net/sock.h>
 #include <net/netlink.h>
 #include <net/tcp.h>
+#include <net/ipv6.h>
 #include <net/tcp_crosslayer.h>
 
 #ifdef CONFIG_HW_CROSSLAYER_OPT
 
-/* 2^31 + 2^29 - 2^25 + 2^22 - 2^19 - 2^16 + 1 */
-#define GOLDEN_RATIO_PRIME_32 0x9e370001UL
-
 /****************************/
 /*** Variables definition ***/
 /****************************/
-/* Global aspen cdn hashtable */
+/*
+ * Global aspen cdn hashtables: connected sockets by 4-tuple, and by local
+ * port for the legacy port-only notification. Readers walk them under RCU,
+ * cdn_hash_lock serializes writers.
+ */
 static struct aspen_cdn_hashtable *cdn_hashtable;
+static struct aspen_cdn_hashtable *cdn_port_hashtable;
 static unsigned int cdn_hash_shift;
+static DEFINE_SPINLOCK(cdn_hash_lock);
+static u32 cdn_hash_seed __read_mostly;
 
 /* Global memory cache for storing aspen cdn hash buckets */
 static struct kmem_cache *cdn_hash_slub;
 /* Global memory cache for storing dropped packets */
 static struct kmem_cache *cdn_drop_slub;
 
+/*
+ * Sockets with dropped segments waiting for recovery. Notifications
+ * arrive in softirq; the retransmits are done from a per-cpu work item,
+ * once per socket however many of its segments were reported.
+ */
+struct aspen_recovery_batch {
+	spinlock_t		lock;
+	struct list_head	head;
+	struct work_struct	work;
+};
+static DEFINE_PER_CPU(struct aspen_recovery_batch, aspen_recovery_batch);
+
+static struct aspen_recovery_stats recovery_stats;
+
 /* Log level */
 unsigned int aspen_log_level = 8;
 EXPORT_SYMBOL(aspen_log_level);
@@ -59,15 +80,16 @@ static struct aspen_monitor monitor;
 /*****************************/
 /*** Functions declaration ***/
 /*****************************/
-static inline u32 cdn_hashfn(u32 val, unsigned int bits);
+static u32 cdn_flow_hashfn(const struct aspen_cdn_flow *flow);
+static inline u32 cdn_port_hashfn(unsigned short port);
 static struct sock *aspen_fetch_hashtable(unsigned short int port);
+static struct sock *aspen_fetch_flow(const struct aspen_cdn_flow *flow);
 static struct cdn_entry *aspen_create_cdn_entry(void);
 static void aspen_destroy_cdn_entry(struct sock *sk);
 static int aspen_crosslayer_dropped_notification(struct sock *sk,
 						 unsigned int seq);
-static int compare_cdn_info(const void *a, const void *b);
-static int aspen_sk_crosslayer_recovery(struct aspen_cdn_info *info,
-					int length);
+static void aspen_queue_dropped(struct sock *sk, unsigned int seq);
+static void aspen_recovery_work(struct work_struct *work);
 static void aspen_tcp_crosslayer_recovery(struct sock *sk);
 static int aspen_skb_crosslayer_retransmit(struct sock *sk,
 					   struct tcp_sock *tp,
@@ -95,18 +117,67 @@ static inline void aspen_monitor_dec(atomic_t *v)
 }
 #endif
 
-static inline u32 cdn_hashfn(u32 val, unsigned int bits)
+static u32 cdn_flow_hashfn(const struct aspen_cdn_flow *flow)
 {
-	/* On some cpus multiply is faster, on others gcc will do shifts */
-	u32 hash = (u32)(val * GOLDEN_RATIO_PRIME_32);
+	u32 ports = ((u32)ntohs(flow->sport) << 16) | ntohs(flow->dport);
+	u32 hash;
+
+	if (flow->family == AF_INET6)
+		hash = jhash2((const u32 *)flow->saddr.v6.s6_addr32, 4,
+			      jhash2((const u32 *)flow->daddr.v6.s6_addr32, 4,
+				     ports ^ cdn_hash_seed));
+	else
+		hash = jhash_3words((__force u32)flow->saddr.v4,
+				    (__force u32)flow->daddr.v4,
+				    ports, cdn_hash_seed);
 
-	/* High bits are more random, so use them. */
-	return hash >> (32 - bits);
+	return hash_32(hash, cdn_hash_shift);
+}
+
+static inline u32 cdn_port_hashfn(unsigned short port)
+{
+	return hash_32(port, cdn_hash_shift);
+}
+
+static bool aspen_flow_equal(const struct aspen_cdn_flow *a,
+			     const struct aspen_cdn_flow *b)
+{
+	if (a->family != b->family ||
+	    a->sport != b->sport || a->dport != b->dport)
+		return false;
+
+	if (a->family == AF_INET6)
+		return ipv6_addr_equal(&a->saddr.v6, &b->saddr.v6) &&
+		       ipv6_addr_equal(&a->daddr.v6, &b->daddr.v6);
+
+	return a->saddr.v4 == b->saddr.v4 && a->daddr.v4 == b->daddr.v4;
+}
+
+/* IPv4-mapped IPv6 sockets are reported by the modem as IPv4 flows */
+static void aspen_sk_flow(const struct sock *sk, struct aspen_cdn_flow *flow)
+{
+	const struct inet_sock *inet = inet_sk(sk);
+
+	memset(flow, 0x00, sizeof(*flow));
+	flow->sport = inet->inet_sport;
+	flow->dport = inet->inet_dport;
+#if IS_ENABLED(CONFIG_IPV6)
+	if (sk->sk_family == AF_INET6 &&
+	    !ipv6_addr_v4mapped(&sk->sk_v6_daddr)) {
+		flow->family = AF_INET6;
+		flow->saddr.v6 = sk->sk_v6_rcv_saddr;
+		flow->daddr.v6 = sk->sk_v6_daddr;
+		return;
+	}
+#endif
+	flow->family = AF_INET;
+	flow->saddr.v4 = inet->inet_saddr;
+	flow->daddr.v4 = inet->inet_daddr;
 }
 
 int aspen_init_hashtable(void)
 {
-	int i, cdn_hash_size;
+	int i, cpu, cdn_hash_size;
 
 #ifdef CONFIG_HW_CROSSLAYER_OPT_DBG_MODULE
 	seqlock_init(&aspen_monitor_ports.lock);
@@ -114,25 +185,47 @@ int aspen_init_hashtable(void)
 	aspen_monitor_ports.range[1] = 5000;
 #endif
 
-	/* Create hash table when booting and never destroy */
+	for_each_possible_cpu(cpu) {
+		struct aspen_recovery_batch *batch =
+			per_cpu_ptr(&aspen_recovery_batch, cpu);
+
+		spin_lock_init(&batch->lock);
+		INIT_LIST_HEAD(&batch->head);
+		INIT_WORK(&batch->work, aspen_recovery_work);
+	}
+
+	get_random_bytes(&cdn_hash_seed, sizeof(cdn_hash_seed));
+
+	/* Create hash tables when booting and never destroy */
 	cdn_hashtable = alloc_large_system_hash("aspen_cdn_hashtable",
 						sizeof(*cdn_hashtable),
 						(unsigned long)0, 18, 0,
 						&cdn_hash_shift, NULL,
 						(unsigned long)0,
 						(unsigned long)8192);
+	if (unlikely(!cdn_hashtable)) {
+		ASPEN_ERR("Failed to alloc hashtable.");
+		return -ENOMEM;
+	}
 	cdn_hash_size = 1 << cdn_hash_shift;
 
-	if (likely(cdn_hashtable)) {
-		for (i = 0; i < cdn_hash_size; i++) {
-			INIT_HLIST_HEAD(&cdn_hashtable[i].head);
-			spin_lock_init(&cdn_hashtable[i].lock);
-		}
-	} else {
-		ASPEN_ERR("Failed to alloc hashtable.");
+	cdn_port_hashtable = alloc_large_system_hash("aspen_cdn_port_hashtable",
+						     sizeof(*cdn_port_hashtable),
+						     (unsigned long)cdn_hash_size,
+						     0, 0, NULL, NULL,
+						     (unsigned long)0,
+						     (unsigned long)cdn_hash_size);
+	if (unlikely(!cdn_port_hashtable)) {
+		ASPEN_ERR("Failed to alloc port hashtable.");
+		cdn_hashtable = NULL;
 		return -ENOMEM;
 	}
 
+	for (i = 0; i < cdn_hash_size; i++) {
+		INIT_HLIST_HEAD(&cdn_hashtable[i].head);
+		INIT_HLIST_HEAD(&cdn_port_hashtable[i].head);
+	}
+
 	/* Create slub memory cache for hash bucket */
 	cdn_hash_slub = kmem_cache_create("aspen_cdn_hash_cache",
 					  sizeof(struct aspen_cdn_hashbucket),
@@ -159,8 +252,8 @@ int aspen_init_hashtable(void)
 
 	return 0;
 clean_out:
-	free_page((unsigned long)cdn_hashtable);
 	cdn_hashtable = NULL;
+	cdn_port_hashtable = NULL;
 	ASPEN_ERR("Release cdn hashtable.");
 
 	if (cdn_hash_slub) {
@@ -174,57 +267,49 @@ EXPORT_SYMBOL(aspen_init_hashtable);
 
 void aspen_mark_hashtable(struct sock *sk, unsigned short int port)
 {
-	unsigned int slot, hit;
 	struct aspen_cdn_hashbucket *pos;
 
 	/* Check hashtable */
 	if (unlikely(!cdn_hashtable))
 		return;
 
-	if (!aspen_tcp_cdn)
+	if (!aspen_tcp_cdn || sk->cdn_hash_marker)
 		return;
 
-	slot = cdn_hashfn(port, cdn_hash_shift);
-
-	/* Must disable bottom halves */
-	spin_lock_bh(&cdn_hashtable[slot].lock);
+	pos = kmem_cache_alloc(cdn_hash_slub, GFP_ATOMIC);
+	if (unlikely(!pos))
+		return;
 
-	hit = 0;
-	hlist_for_each_entry(pos, &cdn_hashtable[slot].head, node) {
-		if (pos->port == port) {
-			pos->sk = NULL;
-			pos->refs += 1;
-			hit = 1;
-			break;
-		}
-	}
+	pos->sk = sk;
+	pos->port = port;
+	aspen_sk_flow(sk, &pos->flow);
 
-	if (likely(!hit)) {
-		pos = kmem_cache_alloc(cdn_hash_slub, GFP_ATOMIC);
-		if (likely(pos)) {
-			pos->sk = sk;
-			pos->port = port;
-			pos->refs = 1;
-			sk->cdn_hash_marker = 1;
-			hlist_add_head(&pos->node,
-				       &cdn_hashtable[slot].head);
+	/* Must disable bottom halves */
+	spin_lock_bh(&cdn_hash_lock);
+	sk->cdn_hash_marker = 1;
+	hlist_add_head_rcu(&pos->node,
+			   &cdn_hashtable[cdn_flow_hashfn(&pos->flow)].head);
+	hlist_add_head_rcu(&pos->port_node,
+			   &cdn_port_hashtable[cdn_port_hashfn(port)].head);
 #ifdef CONFIG_HW_CROSSLAYER_OPT_DBG_MODULE
-			aspen_monitor_inc(&monitor.cdn_hash_slub_cnts);
+	aspen_monitor_inc(&monitor.cdn_hash_slub_cnts);
 #endif
-		}
-	}
-
 	/* Enable bottom halves */
-	spin_unlock_bh(&cdn_hashtable[slot].lock);
+	spin_unlock_bh(&cdn_hash_lock);
 }
 EXPORT_SYMBOL(aspen_mark_hashtable);
 
+static void aspen_free_hashbucket(struct rcu_head *head)
+{
+	kmem_cache_free(cdn_hash_slub,
+			container_of(head, struct aspen_cdn_hashbucket, rcu));
+}
+
 void aspen_unmark_hashtable(struct sock *sk)
 {
 	unsigned int slot;
 	struct aspen_cdn_hashbucket *pos;
-	struct hlist_node *n;
-	struct inet_sock *inet = inet_sk(sk);
+	struct inet_sock *inet;
 	u16 port;
 
 	/* Check hashtable */
@@ -238,20 +323,16 @@ void aspen_unmark_hashtable(struct sock *sk)
 		return;
 	}
 
-	slot = cdn_hashfn(port, cdn_hash_shift);
+	slot = cdn_port_hashfn(port);
 
 	/* Must disable bottom halves */
-	spin_lock_bh(&cdn_hashtable[slot].lock);
-
-	hlist_for_each_entry_safe(pos, n, &cdn_hashtable[slot].head, node) {
-		if (pos->port == port) {
-			pos->refs -= 1;
+	spin_lock_bh(&cdn_hash_lock);
 
-			if (pos->refs > 0)
-				break;
-
-			hlist_del(&pos->node);
-			kmem_cache_free(cdn_hash_slub, pos);
+	hlist_for_each_entry(pos, &cdn_port_hashtable[slot].head, port_node) {
+		if (pos->sk == sk) {
+			hlist_del_rcu(&pos->node);
+			hlist_del_rcu(&pos->port_node);
+			call_rcu(&pos->rcu, aspen_free_hashbucket);
 			sk->cdn_hash_marker = 0;
 #ifdef CONFIG_HW_CROSSLAYER_OPT_DBG_MODULE
 			aspen_monitor_dec(&monitor.cdn_hash_slub_cnts);
@@ -261,15 +342,45 @@ void aspen_unmark_hashtable(struct sock *sk)
 	}
 
 	/* Enable bottom halves */
-	spin_unlock_bh(&cdn_hashtable[slot].lock);
+	spin_unlock_bh(&cdn_hash_lock);
 }
 EXPORT_SYMBOL(aspen_unmark_hashtable);
 
-static struct sock *aspen_fetch_hashtable(unsigned short int port)
+/*
+ * Take a reference on a socket found under RCU. TCP socks are
+ * SLAB_DESTROY_BY_RCU, so once held it must be checked to still be
+ * the connection that was looked up.
+ */
+static struct sock *aspen_hold_sk(struct sock *sk,
+				  const struct aspen_cdn_flow *flow,
+				  unsigned short port)
+{
+	struct aspen_cdn_flow now;
+
+	if (!atomic_inc_not_zero(&sk->sk_refcnt))
+		return NULL;
+
+	if (flow) {
+		aspen_sk_flow(sk, &now);
+		if (!aspen_flow_equal(&now, flow))
+			goto put;
+	} else if (ntohs(inet_sk(sk)->inet_sport) != port) {
+		goto put;
+	}
+
+#ifdef CONFIG_HW_CROSSLAYER_OPT_DBG_MODULE
+	aspen_monitor_inc(&monitor.cdn_sock_hold_cnts);
+#endif
+	return sk;
+put:
+	sock_put(sk);
+	return NULL;
+}
+
+static struct sock *aspen_fetch_flow(const struct aspen_cdn_flow *flow)
 {
-	unsigned int slot;
 	struct aspen_cdn_hashbucket *pos;
-	struct sock *res;
+	struct sock *res = NULL;
 
 	/* Check hashtable */
 	if (unlikely(!cdn_hashtable)) {
@@ -277,30 +388,49 @@ static struct sock *aspen_fetch_hashtable(unsigned short int port)
 		return NULL;
 	}
 
-	slot = cdn_hashfn(port, cdn_hash_shift);
+	rcu_read_lock();
+	hlist_for_each_entry_rcu(pos,
+				 &cdn_hashtable[cdn_flow_hashfn(flow)].head,
+				 node) {
+		if (aspen_flow_equal(&pos->flow, flow)) {
+			res = aspen_hold_sk(pos->sk, flow, 0);
+			break;
+		}
+	}
+	rcu_read_unlock();
 
-	/* Must disable bottom halves */
-	spin_lock_bh(&cdn_hashtable[slot].lock);
+	return res;
+}
 
-	res = NULL;
-	hlist_for_each_entry(pos, &cdn_hashtable[slot].head, node) {
+/* The local port alone is ambiguous when several sockets share it */
+static struct sock *aspen_fetch_hashtable(unsigned short int port)
+{
+	struct aspen_cdn_hashbucket *pos;
+	struct sock *hit = NULL;
+	struct sock *res = NULL;
+	int hits = 0;
+
+	/* Check hashtable */
+	if (unlikely(!cdn_port_hashtable)) {
+		ASPEN_WARNING("Failed to access hashtable.");
+		return NULL;
+	}
+
+	rcu_read_lock();
+	hlist_for_each_entry_rcu(pos,
+				 &cdn_port_hashtable[cdn_port_hashfn(port)].head,
+				 port_node) {
 		if (pos->port == port) {
-			res = pos->sk;
-			break;
+			hit = pos->sk;
+			hits++;
 		}
 	}
 
-	if (res) {
-		sock_hold(res);
-#ifdef CONFIG_HW_CROSSLAYER_OPT_DBG_MODULE
-		aspen_monitor_inc(&monitor.cdn_sock_hold_cnts);
-#endif
-		ASPEN_INFO("port=%u hashed_sk=%p refs=%d",
-			   port, pos?pos->sk:NULL, pos?pos->refs:0);
-	}
+	if (hits == 1)
+		res = aspen_hold_sk(hit, NULL, port);
+	rcu_read_unlock();
 
-	/* Enable bottom halves */
-	spin_unlock_bh(&cdn_hashtable[slot].lock);
+	ASPEN_INFO("port=%u hashed_sk=%p hits=%d", port, res, hits);
 
 	return res;
 }
@@ -315,6 +445,7 @@ static struct cdn_entry *aspen_create_cdn_entry(void)
 		ASPEN_ERR("Failed to alloc cdn_entry.");
 	} else {
 		memset(dropped, 0x00, sizeof(struct cdn_entry));
+		INIT_LIST_HEAD(&dropped->recovery_node);
 #ifdef CONFIG_HW_CROSSLAYER_OPT_DBG_MODULE
 		aspen_monitor_inc(&monitor.cdn_drop_slub_cnts);
 #endif
@@ -414,31 +545,75 @@ static int aspen_crosslayer_dropped_notification(struct sock *sk,
 	return 0;
 }
 
-static int compare_cdn_info(const void *a, const void *b)
+/*
+ * Record a dropped seq on the socket and, the first time, put the socket
+ * on this cpu's recovery batch. The batch holds a reference that is
+ * released by aspen_tcp_crosslayer_retransmit().
+ * Called with bottom halves disabled.
+ */
+static void aspen_queue_dropped(struct sock *sk, unsigned int seq)
 {
-	const struct aspen_cdn_info *_a = a;
-	const struct aspen_cdn_info *_b = b;
+	struct aspen_recovery_batch *batch;
+	struct cdn_entry *dropped;
+	bool kick = false;
+
+	spin_lock(&sk->sk_lock.slock);
+
+	if (!aspen_crosslayer_dropped_notification(sk, seq)) {
+		dropped = sk->sk_dropped;
+		if (!dropped->queued) {
+			dropped->queued = 1;
+			dropped->sk = sk;
+			sock_hold(sk);
+			batch = this_cpu_ptr(&aspen_recovery_batch);
+			spin_lock(&batch->lock);
+			list_add_tail(&dropped->recovery_node, &batch->head);
+			spin_unlock(&batch->lock);
+			kick = true;
+		}
+	}
 
-	/* Ascending order */
-	if (_a->port == _b->port) {
-		/* Ascending order */
-		if (_a->seq > _b->seq)
-			return 1;
-		else if (_a->seq < _b->seq)
-			return -1;
-		else
-			return 0;
-	} else if (_a->port > _b->port) {
-		return 1;
-	} else {
-		return -1;
+	spin_unlock(&sk->sk_lock.slock);
+
+	if (kick)
+		queue_work_on(smp_processor_id(), system_highpri_wq,
+			      &this_cpu_ptr(&aspen_recovery_batch)->work);
+}
+
+static void aspen_recovery_work(struct work_struct *work)
+{
+	struct aspen_recovery_batch *batch =
+		container_of(work, struct aspen_recovery_batch, work);
+	struct cdn_entry *dropped, *n;
+	struct sock *sk;
+	LIST_HEAD(list);
+
+	spin_lock_bh(&batch->lock);
+	list_splice_init(&batch->head, &list);
+	spin_unlock_bh(&batch->lock);
+
+	list_for_each_entry_safe(dropped, n, &list, recovery_node) {
+		sk = dropped->sk;
+		list_del_init(&dropped->recovery_node);
+
+		/* The batch's reference may be dropped below */
+		sock_hold(sk);
+
+		/* Must disable bottom halves */
+		spin_lock_bh(&sk->sk_lock.slock);
+		aspen_tcp_crosslayer_recovery(sk);
+		spin_unlock_bh(&sk->sk_lock.slock);
+
+		sock_put(sk);
 	}
 }
 
 void aspen_crosslayer_recovery(void *ptr, int length)
 {
-	int i, start_index;
-	struct aspen_cdn_info *info, *start_point;
+	int i;
+	struct aspen_cdn_info *info;
+	struct sock *sk = NULL;
+	unsigned short port = 0;
 	struct timeval tv;
 
 	if (unlikely(!ptr || length <= 0)) {
@@ -458,58 +633,78 @@ void aspen_crosslayer_recovery(void *ptr, int length)
 	if (!aspen_tcp_cdn)
 		return;
 
-	/* Heapsort provided by kernel */
-	sort(info, (unsigned long)length, sizeof(struct aspen_cdn_info),
-	     compare_cdn_info, NULL);
-
-	start_point = info;
-	start_index = 0;
-	for (i = 1; i < length; i++) {
-		if (info[i].port != info[i-1].port) {
-			aspen_sk_crosslayer_recovery(start_point,
-						     i - start_index);
-			start_point = &info[i];
-			start_index = i;
+	atomic_add(length, &recovery_stats.notified);
+
+	local_bh_disable();
+	for (i = 0; i < length; i++) {
+		/* Reports usually come in runs for the same socket */
+		if (!sk || info[i].port != port) {
+			if (sk)
+				sock_put(sk);
+			port = info[i].port;
+			sk = aspen_fetch_hashtable(port);
 		}
+
+		if (!sk) {
+			ASPEN_WARNING("Hash missed while searching sk by "
+				      "port(%u).", port);
+			atomic_inc(&recovery_stats.unmatched);
+			continue;
+		}
+
+		aspen_queue_dropped(sk, info[i].seq);
 	}
-	aspen_sk_crosslayer_recovery(start_point, i - start_index);
+	if (sk)
+		sock_put(sk);
+	local_bh_enable();
 }
 EXPORT_SYMBOL(aspen_crosslayer_recovery);
 
-static int aspen_sk_crosslayer_recovery(struct aspen_cdn_info *info,
-					int length)
+void aspen_crosslayer_recovery_flow(struct aspen_cdn_flow_info *info,
+				    int length)
 {
-	struct sock *sk;
-	int i, ret = 0;
+	int i;
+	struct sock *sk = NULL;
+	const struct aspen_cdn_flow *flow = NULL;
 
-	if (!info || length <= 0) {
+	if (unlikely(!info || length <= 0)) {
 		ASPEN_ERR("Invalid parameter.(info=%p length=%d)",
 			  info, length);
-		return -EFAULT;
-	}
-
-	/* Hold sock */
-	sk = aspen_fetch_hashtable(info[0].port);
-	if (!sk) {
-		ASPEN_WARNING("Hash missed while searching sk by port(%u).",
-			      info[0].port);
-		return -EFAULT;
+		return;
 	}
 
-	/* Must disable bottom halves */
-	spin_lock_bh(&((sk)->sk_lock.slock));
-
-	for (i = 0; i < length; i++)
-		aspen_crosslayer_dropped_notification(sk, info[i].seq);
+	if (!aspen_tcp_cdn)
+		return;
 
-	/* Put sock */
-	aspen_tcp_crosslayer_recovery(sk);
+	atomic_add(length, &recovery_stats.notified);
+
+	local_bh_disable();
+	for (i = 0; i < length; i++) {
+		ASPEN_INFO("Cross-layer Dropped Notification: family=%u "
+			   "type=%u sport=%u dport=%u seq=%u",
+			   info[i].flow.family, info[i].type,
+			   ntohs(info[i].flow.sport),
+			   ntohs(info[i].flow.dport), info[i].seq);
+
+		if (!flow || !aspen_flow_equal(flow, &info[i].flow)) {
+			if (sk)
+				sock_put(sk);
+			flow = &info[i].flow;
+			sk = aspen_fetch_flow(flow);
+		}
 
-	/* Enable bottom halves */
-	spin_unlock_bh(&((sk)->sk_lock.slock));
+		if (!sk) {
+			atomic_inc(&recovery_stats.unmatched);
+			continue;
+		}
 
-	return ret;
+		aspen_queue_dropped(sk, info[i].seq);
+	}
+	if (sk)
+		sock_put(sk);
+	local_bh_enable();
 }
+EXPORT_SYMBOL(aspen_crosslayer_recovery_flow);
 
 static void aspen_tcp_crosslayer_recovery(struct sock *sk)
 {
@@ -580,6 +775,7 @@ void aspen_tcp_crosslayer_retransmit(struct sock *sk)
 			ASPEN_DEBUG("Ingored the dropped packet, maybe "
 				    "duplicated or sacked.(seq=%u sk=%p)",
 				    cdn_q->seq, sk);
+			atomic_inc(&recovery_stats.rexmit_spurious);
 			cdn_q = cdn_q->next;
 			maybe_split_skb = false;
 		}
@@ -618,6 +814,7 @@ void aspen_tcp_crosslayer_retransmit(struct sock *sk)
 		ASPEN_DEBUG("Ingored the dropped packet, maybe "
 			    "rexmitted or merged.(seq=%u sk=%p)",
 			    cdn_q->seq, sk);
+		atomic_inc(&recovery_stats.rexmit_spurious);
 		cdn_q = cdn_q->next;
 	}
 
@@ -652,21 +849,26 @@ static int aspen_skb_crosslayer_retransmit(struct sock *sk,
 	if (tcb->sacked & TCPCB_SACKED_ACKED) {
 		ASPEN_DEBUG("Ingored sacked skb(%u:%u) length(%u) sk(%p).",
 			    tcb->seq, tcb->end_seq, length, sk);
+		atomic_inc(&recovery_stats.rexmit_spurious);
 		return -EINVAL;
 	}
 
 	err = __tcp_retransmit_skb(sk, skb);
 	if (!err) {
 		tp->retrans_out += tcp_skb_pcount(skb);
-		if (!(tcb->sacked & TCPCB_LOST))
+		if (!(tcb->sacked & TCPCB_LOST)) {
 			tp->lost_out += tcp_skb_pcount(skb);
+			tp->lost += tcp_skb_pcount(skb);
+		}
 		tcb->sacked |= (TCPCB_LOST | TCPCB_RETRANS);
 		tcb->ack_seq = tp->snd_nxt;
+		atomic_inc(&recovery_stats.rexmit_saved);
 		ASPEN_DEBUG("Rexmitted dropped skb(%u:%u) length(%u) sk(%p).",
 			    tcb->seq, tcb->end_seq, length, sk);
 	} else if (err == -EBUSY) {
 		ASPEN_DEBUG("Ingored in host skb(%u:%u) length(%u) sk(%p).",
 			    tcb->seq, tcb->end_seq, length, sk);
+		atomic_inc(&recovery_stats.rexmit_spurious);
 	} else {
 		ASPEN_DEBUG("An error(%d) occurred while rexmitting dropped "
 			    "skb(%u:%u) length(%u) sk(%p).",
@@ -713,6 +915,7 @@ bool aspen_tcp_try_undo_modem_drop(struct sock *sk,
 
 		tp->snd_cwnd_stamp = tcp_time_stamp;
 		sk->undo_modem_drop_marker = 0;
+		atomic_inc(&recovery_stats.undo);
 #ifdef CONFIG_HW_CROSSLAYER_OPT_DBG_MODULE
 		sk->undo_modem_drop_cnts++;
 #endif
@@ -723,6 +926,31 @@ bool aspen_tcp_try_undo_modem_drop(struct sock *sk,
 }
 EXPORT_SYMBOL(aspen_tcp_try_undo_modem_drop);
 
+int proc_aspen_recovery_stats(struct ctl_table *ctl, int write,
+			      void __user *buffer, size_t *lenp,
+			      loff_t *ppos)
+{
+	struct ctl_table tbl = { .maxlen = ASPEN_RECOVERY_STATS_BUF_MAX, };
+	int ret;
+
+	tbl.data = kmalloc((unsigned long)tbl.maxlen, GFP_USER);
+	if (!tbl.data)
+		return -ENOMEM;
+
+	snprintf(tbl.data, ASPEN_RECOVERY_STATS_BUF_MAX,
+		 "notified: %d\tunmatched: %d\tsaved: %d\tspurious: %d\t"
+		 "undo: %d",
+		 atomic_read(&recovery_stats.notified),
+		 atomic_read(&recovery_stats.unmatched),
+		 atomic_read(&recovery_stats.rexmit_saved),
+		 atomic_read(&recovery_stats.rexmit_spurious),
+		 atomic_read(&recovery_stats.undo));
+	ret = proc_dostring(&tbl, write, buffer, lenp, ppos);
+	kfree(tbl.data);
+	return ret;
+}
+EXPORT_SYMBOL(proc_aspen_recovery_stats);
+
 #ifdef CONFIG_HW_CROSSLAYER_OPT_DBG_MODULE
 static void aspen_get_monitor_port_range(int *low, int *high)
 {
@@ -89,9 +89,6 @@
 #include <net/tcp_crosslayer.h>
 #endif
 
-#ifdef CONFIG_HW_WIFIPRO
-#include <huawei_platform/net/ipv4/wifipro_tcp_monitor.h>
-#endif
 #ifdef CONFIG_HW_WIFI
 #include <huawei_platform/net/ipv4/wifi_tcp_statistics.h>
 #endif
@@ -1664,6 +1661,7 @@ process:
 	skb->dev = NULL;
 
 	bh_lock_sock_nested(sk);
+	tcp_sk(sk)->segs_in += max_t(u16, 1, skb_shinfo(skb)->gso_segs);
 	ret = 0;
 
 #ifdef CONFIG_HUAWEI_BASTET
@@ -1678,10 +1676,6 @@ process:
 	wifi_IncrRecvSegs(sk, 1);
 #endif
 
-#ifdef CONFIG_HW_WIFIPRO
-	wifipro_update_tcp_statistics(WIFIPRO_TCP_MIB_INSEGS, skb, sk);
-#endif
-
 	if (!sock_owned_by_user(sk)) {
 		if (!tcp_prequeue(sk, skb))
 			ret = tcp_v4_do_rcv(sk, skb);
@@ -47,6 +47,9 @@
 #include <net/xfrm.h>
 #include <net/inet6_hashtables.h>
 #include <net/busy_poll.h>
+#ifdef CONFIG_HW_COMMSTAT
+#include <huawei_platform/net/commstat/commstat.h>
+#endif
 
 #include <linux/proc_fs.h>
 #include <linux/seq_file.h>
@@ -591,6 +594,9 @@ static int __udpv6_queue_rcv_skb(struct sock *sk, struct sk_buff *skb)
 		sk_incoming_cpu_update(sk);
 	}
 
+#ifdef CONFIG_HW_COMMSTAT
+	comm_lat_dns_reply(sk, skb);
+#endif
 	rc = sock_queue_rcv_skb(sk, skb);
 	if (rc < 0) {
 		int is_udplite = IS_UDPLITE(sk);
@@ -1237,6 +1243,9 @@ do_udp_sendmsg:
 		fl6.flowlabel = np->flow_label;
 		connected = 1;
 	}
+#ifdef CONFIG_HW_COMMSTAT
+	comm_lat_dns_query(sk, fl6.fl6_dport);
+#endif
 
 	if (!fl6.flowi6_oif)
 		fl6.flowi6_oif = sk->sk_bound_dev_if;
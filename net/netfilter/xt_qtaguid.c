@@ -38,11 +38,6 @@
 #include "xt_qtaguid_print.h"
 #include "../../fs/proc/internal.h"
 
-#ifdef CONFIG_HW_WIFIPRO
-#include <linux/snmp.h>
-extern void wifipro_update_tcp_statistics(int mib_type, const struct sk_buff *skb, struct sock *from_sk);
-#endif
-
 /*
  * We only use the xt_socket funcs within a similar context to avoid unexpected
  * return values.
@@ -133,10 +128,17 @@ static struct proc_dir_entry *iface_stat_fmt_procfile;
 static LIST_HEAD(iface_stat_list);
 static DEFINE_SPINLOCK(iface_stat_list_lock);
 
+/*
+ * The packet path only reads sock tags and counter sets. It looks them up
+ * in the RCU hashes; the rb-trees and the locks are for the control path.
+ * Entries are unhashed under the lock and freed after a grace period.
+ */
 static struct rb_root sock_tag_tree = RB_ROOT;
+static DEFINE_HASHTABLE(sock_tag_hash, SOCK_TAG_HASH_BITS);
 static DEFINE_SPINLOCK(sock_tag_list_lock);
 
 static struct rb_root tag_counter_set_tree = RB_ROOT;
+static DEFINE_HASHTABLE(tag_counter_set_hash, TAG_COUNTER_SET_HASH_BITS);
 static DEFINE_SPINLOCK(tag_counter_set_list_lock);
 
 static struct rb_root uid_tag_data_tree = RB_ROOT;
@@ -234,6 +236,31 @@ static void tag_stat_tree_insert(struct tag_stat *data, struct rb_root *root)
 	tag_node_tree_insert(&data->tn, root);
 }
 
+/*
+ * Find the tag_stat for the tag within the interface.
+ * Caller must hold rcu_read_lock() or iface_entry->tag_stat_list_lock.
+ */
+static struct tag_stat *tag_stat_hash_search(struct iface_stat *iface_entry,
+					     tag_t tag)
+{
+	struct tag_stat *ts_entry;
+
+	hash_for_each_possible_rcu(iface_entry->tag_stat_hash, ts_entry,
+				   hash_node, tag) {
+		if (ts_entry->tn.tag == tag)
+			return ts_entry;
+	}
+	return NULL;
+}
+
+static void tag_stat_free_rcu(struct rcu_head *head)
+{
+	struct tag_stat *ts_entry = container_of(head, struct tag_stat, rcu);
+
+	free_percpu(ts_entry->counters);
+	kfree(ts_entry);
+}
+
 static struct tag_stat *tag_stat_tree_search(struct rb_root *root, tag_t tag)
 {
 	struct tag_node *node = tag_node_tree_search(root, tag);
@@ -327,7 +354,8 @@ static void sock_tag_tree_erase(struct rb_root *st_to_free_tree)
 			 get_uid_from_tag(st_entry->tag));
 		rb_erase(&st_entry->sock_node, st_to_free_tree);
 		sockfd_put(st_entry->socket);
-		kfree(st_entry);
+		/* Already unhashed, but the packet path may still see it */
+		kfree_rcu(st_entry, rcu);
 	}
 }
 
@@ -632,17 +660,22 @@ static int get_active_counter_set(tag_t tag)
 		 tag, get_uid_from_tag(tag));
 	/* For now we only handle UID tags for active sets */
 	tag = get_utag_from_tag(tag);
-	spin_lock_bh(&tag_counter_set_list_lock);
-	tcs = tag_counter_set_tree_search(&tag_counter_set_tree, tag);
-	if (tcs)
-		active_set = tcs->active_set;
-	spin_unlock_bh(&tag_counter_set_list_lock);
+	rcu_read_lock();
+	hash_for_each_possible_rcu(tag_counter_set_hash, tcs, hash_node, tag) {
+		if (tcs->tn.tag == tag) {
+			active_set = READ_ONCE(tcs->active_set);
+			break;
+		}
+	}
+	rcu_read_unlock();
 	return active_set;
 }
 
 /*
  * Find the entry for tracking the specified interface.
- * Caller must hold iface_stat_list_lock
+ * Caller must hold iface_stat_list_lock or rcu_read_lock().
+ * Entries are never removed from the list, so the packet path can walk
+ * it under RCU alone.
  */
 static struct iface_stat *get_iface_entry(const char *ifname)
 {
@@ -655,7 +688,7 @@ static struct iface_stat *get_iface_entry(const char *ifname)
 	}
 
 	/* Iterate over interfaces */
-	list_for_each_entry(iface_entry, &iface_stat_list, list) {
+	list_for_each_entry_rcu(iface_entry, &iface_stat_list, list) {
 		if (!strcmp(ifname, iface_entry->ifname))
 			goto done;
 	}
@@ -683,9 +716,10 @@ static void pp_iface_stat_header(struct seq_file *m)
 static void pp_iface_stat_line(struct seq_file *m,
 			       struct iface_stat *iface_entry)
 {
-	struct data_counters *cnts;
+	struct data_counters sum, *cnts = &sum;
 	int cnt_set = 0;   /* We only use one set for the device */
-	cnts = &iface_entry->totals_via_skb;
+
+	dc_sum_percpu(cnts, iface_entry->totals_via_skb);
 	seq_printf(m, "%s %llu %llu %llu %llu %llu %llu %llu %llu "
 		   "%llu %llu %llu %llu %llu %llu %llu %llu\n",
 		   iface_entry->ifname,
@@ -877,8 +911,18 @@ static struct iface_stat *iface_alloc(struct net_device *net_dev)
 		kfree(new_iface);
 		return NULL;
 	}
+	new_iface->totals_via_skb = alloc_percpu_gfp(struct data_counters,
+						     GFP_ATOMIC);
+	if (!new_iface->totals_via_skb) {
+		pr_err("qtaguid: iface_stat: create(%s): "
+		       "counters alloc failed\n", net_dev->name);
+		kfree(new_iface->ifname);
+		kfree(new_iface);
+		return NULL;
+	}
 	spin_lock_init(&new_iface->tag_stat_list_lock);
 	new_iface->tag_stat_tree = RB_ROOT;
+	hash_init(new_iface->tag_stat_hash);
 	_iface_stat_set_active(new_iface, net_dev, true);
 
 	/*
@@ -890,6 +934,7 @@ static struct iface_stat *iface_alloc(struct net_device *net_dev)
 		pr_err("qtaguid: iface_stat: create(%s): "
 		       "work alloc failed\n", new_iface->ifname);
 		_iface_stat_set_active(new_iface, net_dev, false);
+		free_percpu(new_iface->totals_via_skb);
 		kfree(new_iface->ifname);
 		kfree(new_iface);
 		return NULL;
@@ -897,7 +942,7 @@ static struct iface_stat *iface_alloc(struct net_device *net_dev)
 	isw->iface_entry = new_iface;
 	INIT_WORK(&isw->iface_work, iface_create_proc_worker);
 	schedule_work(&isw->iface_work);
-	list_add(&new_iface->list, &iface_stat_list);
+	list_add_rcu(&new_iface->list, &iface_stat_list);
 	return new_iface;
 }
 
@@ -1078,16 +1123,22 @@ static struct sock_tag *get_sock_stat_nl(const struct sock *sk)
 	return sock_tag_tree_search(&sock_tag_tree, sk);
 }
 
-static struct sock_tag *get_sock_stat(const struct sock *sk)
+/*
+ * Packet path lookup.
+ * Caller must hold rcu_read_lock(); the entry is only valid until then.
+ */
+static struct sock_tag *get_sock_stat_rcu(const struct sock *sk)
 {
 	struct sock_tag *sock_tag_entry;
-	MT_DEBUG("qtaguid: get_sock_stat(sk=%p)\n", sk);
+	MT_DEBUG("qtaguid: get_sock_stat_rcu(sk=%p)\n", sk);
 	if (!sk)
 		return NULL;
-	spin_lock_bh(&sock_tag_list_lock);
-	sock_tag_entry = get_sock_stat_nl(sk);
-	spin_unlock_bh(&sock_tag_list_lock);
-	return sock_tag_entry;
+	hash_for_each_possible_rcu(sock_tag_hash, sock_tag_entry, hash_node,
+				   (unsigned long)sk) {
+		if (sock_tag_entry->sk == sk)
+			return sock_tag_entry;
+	}
+	return NULL;
 }
 
 static int ipx_proto(const struct sk_buff *skb,
@@ -1227,28 +1278,26 @@ static void iface_stat_update_from_skb(const struct sk_buff *skb,
 		MT_DEBUG("qtaguid[%d]: dev name=%s type=%d fam=%d proto=%d\n",
 			 par->hooknum, el_dev->name, el_dev->type,
 			 par->family, proto);
-#ifdef CONFIG_HW_WIFIPRO
-		if(direction == IFS_TX){
-		    wifipro_update_tcp_statistics(WIFIPRO_TCP_MIB_OUTSEGS, skb, NULL);
-		}
-#endif
 	}
 
-	spin_lock_bh(&iface_stat_list_lock);
+	/* BHs off so this cpu's counters are not updated re-entrantly */
+	local_bh_disable();
+	rcu_read_lock();
 	entry = get_iface_entry(el_dev->name);
 	if (entry == NULL) {
 		IF_DEBUG("qtaguid: iface_stat: %s(%s): not tracked\n",
 			 __func__, el_dev->name);
-		spin_unlock_bh(&iface_stat_list_lock);
-		return;
+		goto unlock;
 	}
 
 	IF_DEBUG("qtaguid: %s(%s): entry=%p\n", __func__,
 		 el_dev->name, entry);
 
-	data_counters_update(&entry->totals_via_skb, 0, direction, proto,
-			     bytes);
-	spin_unlock_bh(&iface_stat_list_lock);
+	data_counters_update(this_cpu_ptr(entry->totals_via_skb), 0,
+			     direction, proto, bytes);
+unlock:
+	rcu_read_unlock();
+	local_bh_enable();
 }
 
 static void tag_stat_update(struct tag_stat *tag_entry,
@@ -1260,20 +1309,23 @@ static void tag_stat_update(struct tag_stat *tag_entry,
 		 "dir=%d proto=%d bytes=%d)\n",
 		 tag_entry->tn.tag, get_uid_from_tag(tag_entry->tn.tag),
 		 active_set, direction, proto, bytes);
-	data_counters_update(&tag_entry->counters, active_set, direction,
-			     proto, bytes);
+	data_counters_update(this_cpu_ptr(tag_entry->counters), active_set,
+			     direction, proto, bytes);
 	if (tag_entry->parent_counters)
-		data_counters_update(tag_entry->parent_counters, active_set,
-				     direction, proto, bytes);
+		data_counters_update(this_cpu_ptr(tag_entry->parent_counters),
+				     active_set, direction, proto, bytes);
 }
 
 /*
  * Create a new entry for tracking the specified {acct_tag,uid_tag} within
  * the interface.
+ * The parent counters are set before the entry is hashed, so lockless
+ * readers never see a child that is not yet billing its parent.
  * iface_entry->tag_stat_list_lock should be held.
  */
 static struct tag_stat *create_if_tag_stat(struct iface_stat *iface_entry,
-					   tag_t tag)
+					   tag_t tag,
+					   struct data_counters __percpu *parent)
 {
 	struct tag_stat *new_tag_stat_entry = NULL;
 	IF_DEBUG("qtaguid: iface_stat: %s(): ife=%p tag=0x%llx"
@@ -1284,8 +1336,19 @@ static struct tag_stat *create_if_tag_stat(struct iface_stat *iface_entry,
 		pr_err("qtaguid: iface_stat: tag stat alloc failed\n");
 		goto done;
 	}
+	new_tag_stat_entry->counters = alloc_percpu_gfp(struct data_counters,
+							GFP_ATOMIC);
+	if (!new_tag_stat_entry->counters) {
+		pr_err("qtaguid: iface_stat: tag stat counters alloc failed\n");
+		kfree(new_tag_stat_entry);
+		new_tag_stat_entry = NULL;
+		goto done;
+	}
 	new_tag_stat_entry->tn.tag = tag;
+	new_tag_stat_entry->parent_counters = parent;
 	tag_stat_tree_insert(new_tag_stat_entry, &iface_entry->tag_stat_tree);
+	hash_add_rcu(iface_entry->tag_stat_hash,
+		     &new_tag_stat_entry->hash_node, tag);
 done:
 	return new_tag_stat_entry;
 }
@@ -1297,7 +1360,7 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 	struct tag_stat *tag_stat_entry;
 	tag_t tag, acct_tag;
 	tag_t uid_tag;
-	struct data_counters *uid_tag_counters;
+	struct data_counters __percpu *uid_tag_counters;
 	struct sock_tag *sock_tag_entry;
 	struct iface_stat *iface_entry;
 	struct tag_stat *new_tag_stat = NULL;
@@ -1305,13 +1368,18 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 		"uid=%u sk=%p dir=%d proto=%d bytes=%d)\n",
 		 ifname, uid, sk, direction, proto, bytes);
 
-	spin_lock_bh(&iface_stat_list_lock);
+	/*
+	 * No locks on the common path: the lookups are done under RCU and
+	 * the counters are per-cpu. BHs are off so this cpu's counters are
+	 * not updated re-entrantly.
+	 */
+	local_bh_disable();
+	rcu_read_lock();
 	iface_entry = get_iface_entry(ifname);
 	if (!iface_entry) {
 		pr_err_ratelimited("qtaguid: iface_stat: stat_update() "
 				   "%s not found\n", ifname);
-		spin_unlock_bh(&iface_stat_list_lock);
-		return;
+		goto rcu_unlock;
 	}
 	/* It is ok to process data when an iface_entry is inactive */
 
@@ -1322,9 +1390,9 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 	 * Look for a tagged sock.
 	 * It will have an acct_uid.
 	 */
-	sock_tag_entry = get_sock_stat(sk);
+	sock_tag_entry = get_sock_stat_rcu(sk);
 	if (sock_tag_entry) {
-		tag = sock_tag_entry->tag;
+		tag = READ_ONCE(sock_tag_entry->tag);
 		acct_tag = get_atag_from_tag(tag);
 		uid_tag = get_utag_from_tag(tag);
 	} else {
@@ -1335,17 +1403,27 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 	MT_DEBUG("qtaguid: iface_stat: stat_update(): "
 		 " looking for tag=0x%llx (uid=%u) in ife=%p\n",
 		 tag, get_uid_from_tag(tag), iface_entry);
-	/* Loop over tag list under this interface for {acct_tag,uid_tag} */
-	spin_lock_bh(&iface_entry->tag_stat_list_lock);
 
-	tag_stat_entry = tag_stat_tree_search(&iface_entry->tag_stat_tree,
-					      tag);
-	if (tag_stat_entry) {
+	tag_stat_entry = tag_stat_hash_search(iface_entry, tag);
+	if (likely(tag_stat_entry)) {
 		/*
 		 * Updating the {acct_tag, uid_tag} entry handles both stats:
 		 * {0, uid_tag} will also get updated.
 		 */
 		tag_stat_update(tag_stat_entry, direction, proto, bytes);
+		goto rcu_unlock;
+	}
+
+	/*
+	 * First packet for this tag on this interface.
+	 * Recheck under the lock, someone may have just created it.
+	 */
+	spin_lock(&iface_entry->tag_stat_list_lock);
+
+	tag_stat_entry = tag_stat_tree_search(&iface_entry->tag_stat_tree,
+					      tag);
+	if (tag_stat_entry) {
+		tag_stat_update(tag_stat_entry, direction, proto, bytes);
 		goto unlock;
 	}
 
@@ -1358,20 +1436,20 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 		 * No parent counters. So
 		 *  - No {0, uid_tag} stats and no {acc_tag, uid_tag} stats.
 		 */
-		new_tag_stat = create_if_tag_stat(iface_entry, uid_tag);
+		new_tag_stat = create_if_tag_stat(iface_entry, uid_tag, NULL);
 		if (!new_tag_stat)
 			goto unlock;
-		uid_tag_counters = &new_tag_stat->counters;
+		uid_tag_counters = new_tag_stat->counters;
 	} else {
-		uid_tag_counters = &tag_stat_entry->counters;
+		uid_tag_counters = tag_stat_entry->counters;
 	}
 
 	if (acct_tag) {
 		/* Create the child {acct_tag, uid_tag} and hook up parent. */
-		new_tag_stat = create_if_tag_stat(iface_entry, tag);
+		new_tag_stat = create_if_tag_stat(iface_entry, tag,
+						  uid_tag_counters);
 		if (!new_tag_stat)
 			goto unlock;
-		new_tag_stat->parent_counters = uid_tag_counters;
 	} else {
 		/*
 		 * For new_tag_stat to be still NULL here would require:
@@ -1385,8 +1463,10 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 	}
 	tag_stat_update(new_tag_stat, direction, proto, bytes);
 unlock:
-	spin_unlock_bh(&iface_entry->tag_stat_list_lock);
-	spin_unlock_bh(&iface_stat_list_lock);
+	spin_unlock(&iface_entry->tag_stat_list_lock);
+rcu_unlock:
+	rcu_read_unlock();
+	local_bh_enable();
 }
 
 #ifdef CONFIG_HUAWEI_BASTET
@@ -1417,7 +1497,7 @@ int bastet_update_total_bytes(const char *dev_name, int proto,
 		return -EINVAL;
 	}
 
-	cnts = &entry->totals_via_skb;
+	cnts = this_cpu_ptr(entry->totals_via_skb);
 	cnts->bpc[cnt_set][IFS_TX][proto].bytes += tx_bytes;
 	cnts->bpc[cnt_set][IFS_RX][proto].bytes += rx_bytes;
 
@@ -2111,6 +2191,7 @@ static int ctrl_cmd_delete(const char *input)
 
 		if (!acct_tag || st_entry->tag == tag) {
 			rb_erase(&st_entry->sock_node, &sock_tag_tree);
+			hash_del_rcu(&st_entry->hash_node);
 			/* Can't sockfd_put() within spinlock, do it later. */
 			sock_tag_tree_insert(st_entry, &st_to_free_tree);
 			tr_entry = lookup_tag_ref(st_entry->tag, NULL);
@@ -2143,7 +2224,8 @@ static int ctrl_cmd_delete(const char *input)
 			 get_uid_from_tag(tcs_entry->tn.tag),
 			 tcs_entry->active_set);
 		rb_erase(&tcs_entry->tn.node, &tag_counter_set_tree);
-		kfree(tcs_entry);
+		hash_del_rcu(&tcs_entry->hash_node);
+		kfree_rcu(tcs_entry, rcu);
 	}
 	spin_unlock_bh(&tag_counter_set_list_lock);
 
@@ -2174,7 +2256,8 @@ static int ctrl_cmd_delete(const char *input)
 					 entry_uid);
 				rb_erase(&ts_entry->tn.node,
 					 &iface_entry->tag_stat_tree);
-				kfree(ts_entry);
+				hash_del_rcu(&ts_entry->hash_node);
+				call_rcu(&ts_entry->rcu, tag_stat_free_rcu);
 			}
 		}
 		spin_unlock_bh(&iface_entry->tag_stat_list_lock);
@@ -2256,12 +2339,14 @@ static int ctrl_cmd_counter_set(const char *input)
 			goto err;
 		}
 		tcs->tn.tag = tag;
+		tcs->active_set = counter_set;
 		tag_counter_set_tree_insert(tcs, &tag_counter_set_tree);
+		hash_add_rcu(tag_counter_set_hash, &tcs->hash_node, tag);
 		CT_DEBUG("qtaguid: ctrl_counterset(%s): added tcs tag=0x%llx "
 			 "(uid=%u) set=%d\n",
 			 input, tag, get_uid_from_tag(tag), counter_set);
 	}
-	tcs->active_set = counter_set;
+	WRITE_ONCE(tcs->active_set, counter_set);
 	spin_unlock_bh(&tag_counter_set_list_lock);
 	atomic64_inc(&qtu_events.counter_set_changes);
 	res = 0;
@@ -2363,7 +2448,7 @@ static int ctrl_cmd_tag(const char *input)
 		BUG_ON(IS_ERR_OR_NULL(prev_tag_ref_entry));
 		BUG_ON(prev_tag_ref_entry->num_sock_tags <= 0);
 		prev_tag_ref_entry->num_sock_tags--;
-		sock_tag_entry->tag = full_tag;
+		WRITE_ONCE(sock_tag_entry->tag, full_tag);
 	} else {
 		CT_DEBUG("qtaguid: ctrl_tag(%s): newtag for sk=%p\n",
 			 input, el_socket->sk);
@@ -2402,6 +2487,8 @@ static int ctrl_cmd_tag(const char *input)
 		spin_unlock_bh(&uid_tag_data_tree_lock);
 
 		sock_tag_tree_insert(sock_tag_entry, &sock_tag_tree);
+		hash_add_rcu(sock_tag_hash, &sock_tag_entry->hash_node,
+			     (unsigned long)sock_tag_entry->sk);
 		atomic64_inc(&qtu_events.sockets_tagged);
 	}
 	spin_unlock_bh(&sock_tag_list_lock);
@@ -2468,6 +2555,7 @@ static int ctrl_cmd_untag(const char *input)
 	 * so it can do whatever it wants to it.
 	 */
 	rb_erase(&sock_tag_entry->sock_node, &sock_tag_tree);
+	hash_del_rcu(&sock_tag_entry->hash_node);
 
 	tag_ref_entry = lookup_tag_ref(sock_tag_entry->tag, &utd_entry);
 	BUG_ON(!tag_ref_entry);
@@ -2504,7 +2592,7 @@ static int ctrl_cmd_untag(const char *input)
 		 atomic_long_read(&el_socket->file->f_count) - 1);
 	sockfd_put(el_socket);
 
-	kfree(sock_tag_entry);
+	kfree_rcu(sock_tag_entry, rcu);
 	atomic64_inc(&qtu_events.sockets_untagged);
 
 	return 0;
@@ -2604,7 +2692,7 @@ static int pp_stats_line(struct seq_file *m, struct tag_stat *ts_entry,
 			 int cnt_set)
 {
 	int ret;
-	struct data_counters *cnts;
+	struct data_counters sum, *cnts = &sum;
 	tag_t tag = ts_entry->tn.tag;
 	uid_t stat_uid = get_uid_from_tag(tag);
 	struct proc_print_info *ppi = m->private;
@@ -2620,7 +2708,8 @@ static int pp_stats_line(struct seq_file *m, struct tag_stat *ts_entry,
 		return 0;
 	}
 	ppi->item_index++;
-	cnts = &ts_entry->counters;
+	/* The only place the per-cpu tag counters get folded */
+	dc_sum_percpu(cnts, ts_entry->counters);
 	ret = seq_printf(m, "%d %s 0x%llx %u %u "
 		"%llu %llu "
 		"%llu %llu "
@@ -2927,6 +3016,7 @@ static int qtudev_release(struct inode *inode, struct file *file)
 		free_tag_ref_from_utd_entry(tr, utd_entry);
 
 		rb_erase(&st_entry->sock_node, &sock_tag_tree);
+		hash_del_rcu(&st_entry->hash_node);
 		list_del(&st_entry->list);
 		/* Can't sockfd_put() within spinlock, do it later. */
 		sock_tag_tree_insert(st_entry, &st_to_free_tree);
@@ -11,8 +11,12 @@
 #define __XT_QTAGUID_INTERNAL_H__
 
 #include <linux/types.h>
+#include <linux/hashtable.h>
+#include <linux/percpu.h>
 #include <linux/rbtree.h>
+#include <linux/rcupdate.h>
 #include <linux/spinlock_types.h>
+#include <linux/string.h>
 #include <linux/workqueue.h>
 
 /* Iface handling */
@@ -149,6 +153,15 @@ static inline tag_t make_atag_from_value(uint32_t value)
  */
 #define DEFAULT_MAX_SOCK_TAGS 1024
 
+/*
+ * Hash sizes for the lookups done on every matched packet.
+ * The rb-trees are kept for the ordered walks done by the control and
+ * stats paths; the hashes are what the packet path searches under RCU.
+ */
+#define SOCK_TAG_HASH_BITS 8
+#define TAG_COUNTER_SET_HASH_BITS 4
+#define TAG_STAT_HASH_BITS 6
+
 /*
  * For now we only track 2 sets of counters.
  * The default set is 0.
@@ -197,6 +210,34 @@ static inline uint64_t dc_sum_packets(struct data_counters *counters,
 		+ counters->bpc[set][direction][IFS_PROTO_OTHER].packets;
 }
 
+/*
+ * Fold per-cpu counters into a single snapshot.
+ * Writers only ever touch their own cpu's copy, so readers never block
+ * the packet path; the snapshot is as fresh as the last update seen
+ * on each cpu.
+ */
+static inline void dc_sum_percpu(struct data_counters *sum,
+				 struct data_counters __percpu *pcpu)
+{
+	int cpu, set, dir, proto;
+
+	memset(sum, 0, sizeof(*sum));
+	if (!pcpu)
+		return;
+	for_each_possible_cpu(cpu) {
+		struct data_counters *dc = per_cpu_ptr(pcpu, cpu);
+
+		for (set = 0; set < IFS_MAX_COUNTER_SETS; set++)
+			for (dir = 0; dir < IFS_MAX_DIRECTIONS; dir++)
+				for (proto = 0; proto < IFS_MAX_PROTOS;
+				     proto++) {
+					sum->bpc[set][dir][proto].bytes +=
+						dc->bpc[set][dir][proto].bytes;
+					sum->bpc[set][dir][proto].packets +=
+						dc->bpc[set][dir][proto].packets;
+				}
+	}
+}
 
 /* Generic X based nodes used as a base for rb_tree ops */
 struct tag_node {
@@ -206,12 +247,16 @@ struct tag_node {
 
 struct tag_stat {
 	struct tag_node tn;
-	struct data_counters counters;
+	/* in iface_stat.tag_stat_hash, searched under RCU per packet */
+	struct hlist_node hash_node;
+	struct rcu_head rcu;
+	/* Per-cpu, summed with dc_sum_percpu() when read */
+	struct data_counters __percpu *counters;
 	/*
 	 * If this tag is acct_tag based, we need to count against the
 	 * matching parent uid_tag.
 	 */
-	struct data_counters *parent_counters;
+	struct data_counters __percpu *parent_counters;
 };
 
 struct iface_stat {
@@ -222,7 +267,8 @@ struct iface_stat {
 	struct net_device *net_dev;
 
 	struct byte_packet_counters totals_via_dev[IFS_MAX_DIRECTIONS];
-	struct data_counters totals_via_skb;
+	/* Per-cpu, summed with dc_sum_percpu() when read */
+	struct data_counters __percpu *totals_via_skb;
 	/*
 	 * We keep the last_known, because some devices reset their counters
 	 * just before NETDEV_UP, while some will reset just before
@@ -238,6 +284,9 @@ struct iface_stat {
 	struct proc_dir_entry *proc_ptr;
 
 	struct rb_root tag_stat_tree;
+	/* Same entries as tag_stat_tree, for lockless lookups */
+	DECLARE_HASHTABLE(tag_stat_hash, TAG_STAT_HASH_BITS);
+	/* Serializes writers of both tag_stat_tree and tag_stat_hash */
 	spinlock_t tag_stat_list_lock;
 };
 
@@ -255,6 +304,9 @@ struct iface_stat_work {
  */
 struct sock_tag {
 	struct rb_node sock_node;
+	/* in sock_tag_hash, searched under RCU per packet */
+	struct hlist_node hash_node;
+	struct rcu_head rcu;
 	struct sock *sk;  /* Only used as a number, never dereferenced */
 	/* The socket is needed for sockfd_put() */
 	struct socket *socket;
@@ -300,6 +352,9 @@ struct qtaguid_event_counts {
 /* Track the set active_set for the given tag. */
 struct tag_counter_set {
 	struct tag_node tn;
+	/* in tag_counter_set_hash, searched under RCU per packet */
+	struct hlist_node hash_node;
+	struct rcu_head rcu;
 	int active_set;
 };
 
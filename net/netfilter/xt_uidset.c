@@ -0,0 +1,442 @@
+/*
+ * xt_uidset - match the owner of a packet's socket against a named UID set
+ *
+ * Copyright (C) 2018 Hisilicon Technologies CO., Ltd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * A chain of "owner" rules, one per UID, costs a socket lookup and a rule
+ * walk per UID for each packet. A uidset rule finds the owner once and
+ * looks it up in a sorted array with a binary search.
+ *
+ * The array is never changed in place: a write to /proc/net/xt_uidset/<name>
+ * builds a new one from the old and the written tokens and publishes it
+ * with RCU, so that a batch of changes is seen by packets all at once and
+ * no table reload is needed.
+ */
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+#include <linux/file.h>
+#include <linux/list.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/skbuff.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/vmalloc.h>
+#include <net/net_namespace.h>
+#include <net/netns/generic.h>
+#include <net/sock.h>
+
+#include <linux/netfilter/x_tables.h>
+#include <linux/netfilter/xt_socket.h>
+#include <linux/netfilter/xt_uidset.h>
+
+MODULE_DESCRIPTION("Xtables: socket owner matching against a UID set");
+MODULE_LICENSE("GPL");
+MODULE_ALIAS("ipt_uidset");
+MODULE_ALIAS("ip6t_uidset");
+
+#define XT_UIDSET_MAX_ENTRIES	65536
+#define XT_UIDSET_MAX_WRITE	(16 * PAGE_SIZE)
+
+struct uidset_data {
+	struct rcu_head		rcu;
+	unsigned int		count;
+	u32			uids[0];	/* sorted, no duplicates */
+};
+
+struct uidset_table {
+	struct list_head	list;
+	char			name[XT_UIDSET_NAME_LEN];
+	unsigned int		refcnt;
+	struct uidset_data __rcu *data;
+};
+
+struct uidset_net {
+	struct list_head	tables;
+	struct proc_dir_entry	*xt_uidset;
+};
+
+static int uidset_net_id __read_mostly;
+
+static inline struct uidset_net *uidset_pernet(struct net *net)
+{
+	return net_generic(net, uidset_net_id);
+}
+
+/* Protects the table lists */
+static DEFINE_MUTEX(uidset_mutex);
+/* Serialises set updates, taken inside proc writes so not uidset_mutex */
+static DEFINE_MUTEX(uidset_write_mutex);
+
+static const struct file_operations uidset_mt_fops;
+
+static struct uidset_data *uidset_data_alloc(unsigned int count)
+{
+	size_t sz = sizeof(struct uidset_data) + count * sizeof(u32);
+
+	if (sz <= PAGE_SIZE)
+		return kmalloc(sz, GFP_KERNEL);
+	return vmalloc(sz);
+}
+
+static void uidset_data_free_rcu(struct rcu_head *head)
+{
+	kvfree(container_of(head, struct uidset_data, rcu));
+}
+
+/* Returns whether @uid is in @d, and in @pos where it is or would go */
+static bool uidset_find(const struct uidset_data *d, u32 uid,
+			unsigned int *pos)
+{
+	unsigned int lo = 0, hi = d->count;
+
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+
+		if (d->uids[mid] < uid) {
+			lo = mid + 1;
+		} else if (d->uids[mid] > uid) {
+			hi = mid;
+		} else {
+			*pos = mid;
+			return true;
+		}
+	}
+	*pos = lo;
+	return false;
+}
+
+/* Owner of the socket of @skb, looked up on input if it isn't attached */
+static bool uidset_skb_uid(const struct sk_buff *skb,
+			   struct xt_action_param *par, kuid_t *uid)
+{
+	struct sock *sk = skb->sk;
+	bool got_sock = false;
+	bool found = false;
+
+	if (sk && !sk_fullsock(sk))
+		sk = NULL;
+
+	if (!sk && (par->hooknum == NF_INET_PRE_ROUTING ||
+		    par->hooknum == NF_INET_LOCAL_IN)) {
+		if (par->family == NFPROTO_IPV4)
+			sk = xt_socket_lookup_slow_v4(skb, par->in);
+#if IS_ENABLED(CONFIG_IP6_NF_IPTABLES)
+		else if (par->family == NFPROTO_IPV6)
+			sk = xt_socket_lookup_slow_v6(skb, par->in);
+#endif
+		if (sk && !sk_fullsock(sk)) {
+			sock_gen_put(sk);
+			sk = NULL;
+		}
+		got_sock = sk != NULL;
+	}
+	if (!sk)
+		return false;
+
+	read_lock_bh(&sk->sk_callback_lock);
+	if (sk->sk_socket && sk->sk_socket->file) {
+		*uid = sk->sk_socket->file->f_cred->fsuid;
+		found = true;
+	}
+	read_unlock_bh(&sk->sk_callback_lock);
+
+	if (got_sock)
+		sock_gen_put(sk);
+	return found;
+}
+
+static bool
+uidset_mt(const struct sk_buff *skb, struct xt_action_param *par)
+{
+	const struct xt_uidset_mtinfo *info = par->matchinfo;
+	bool invert = info->flags & XT_UIDSET_INVERT;
+	const struct uidset_data *d;
+	unsigned int pos;
+	kuid_t uid;
+	bool ret;
+
+	/* Packets without an owner are not in any set */
+	if (!uidset_skb_uid(skb, par, &uid))
+		return invert;
+
+	rcu_read_lock();
+	d = rcu_dereference(info->table->data);
+	ret = uidset_find(d, from_kuid(&init_user_ns, uid), &pos);
+	rcu_read_unlock();
+
+	return ret ^ invert;
+}
+
+static struct uidset_table *uidset_table_lookup(struct uidset_net *uidset_net,
+						const char *name)
+{
+	struct uidset_table *t;
+
+	list_for_each_entry(t, &uidset_net->tables, list)
+		if (!strcmp(t->name, name))
+			return t;
+	return NULL;
+}
+
+static int uidset_mt_check(const struct xt_mtchk_param *par)
+{
+	struct uidset_net *uidset_net = uidset_pernet(par->net);
+	struct xt_uidset_mtinfo *info = par->matchinfo;
+	struct uidset_table *t;
+	struct uidset_data *d;
+	int ret = 0;
+
+	if (info->flags & ~XT_UIDSET_VALID_FLAGS)
+		return -EINVAL;
+	if (info->name[0] == '\0' || info->name[0] == '.' ||
+	    strnlen(info->name, XT_UIDSET_NAME_LEN) == XT_UIDSET_NAME_LEN ||
+	    strchr(info->name, '/'))
+		return -EINVAL;
+
+	mutex_lock(&uidset_mutex);
+	t = uidset_table_lookup(uidset_net, info->name);
+	if (t != NULL) {
+		t->refcnt++;
+		goto out;
+	}
+
+	t = kzalloc(sizeof(*t), GFP_KERNEL);
+	d = uidset_data_alloc(0);
+	if (t == NULL || d == NULL) {
+		kfree(d);
+		kfree(t);
+		ret = -ENOMEM;
+		goto out;
+	}
+	d->count = 0;
+	RCU_INIT_POINTER(t->data, d);
+	t->refcnt = 1;
+	strcpy(t->name, info->name);
+
+	if (!proc_create_data(t->name, S_IRUSR | S_IWUSR,
+			      uidset_net->xt_uidset, &uidset_mt_fops, t)) {
+		kfree(d);
+		kfree(t);
+		ret = -ENOMEM;
+		goto out;
+	}
+	list_add_tail(&t->list, &uidset_net->tables);
+out:
+	if (ret == 0)
+		info->table = t;
+	mutex_unlock(&uidset_mutex);
+	return ret;
+}
+
+static void uidset_mt_destroy(const struct xt_mtdtor_param *par)
+{
+	struct uidset_net *uidset_net = uidset_pernet(par->net);
+	const struct xt_uidset_mtinfo *info = par->matchinfo;
+	struct uidset_table *t = info->table;
+
+	mutex_lock(&uidset_mutex);
+	if (--t->refcnt == 0) {
+		list_del(&t->list);
+		if (uidset_net->xt_uidset != NULL)
+			remove_proc_entry(t->name, uidset_net->xt_uidset);
+		/* No rule, and so no packet, refers to the table any more */
+		kvfree(rcu_dereference_protected(t->data, 1));
+		kfree(t);
+	}
+	mutex_unlock(&uidset_mutex);
+}
+
+static int uidset_seq_show(struct seq_file *seq, void *v)
+{
+	const struct uidset_table *t = seq->private;
+	const struct uidset_data *d;
+	unsigned int i;
+
+	rcu_read_lock();
+	d = rcu_dereference(t->data);
+	for (i = 0; i < d->count; i++)
+		seq_printf(seq, "%u\n", d->uids[i]);
+	rcu_read_unlock();
+	return 0;
+}
+
+static int uidset_seq_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, uidset_seq_show, PDE_DATA(inode));
+}
+
+/* Apply one "+uid", "-uid" or "/" token to @d, which has room for adds */
+static int uidset_apply(struct uidset_data *d, const char *tok)
+{
+	unsigned int pos;
+	bool found;
+	u32 uid;
+
+	if (!strcmp(tok, "/")) {
+		d->count = 0;
+		return 0;
+	}
+	if ((tok[0] != '+' && tok[0] != '-') || kstrtou32(tok + 1, 10, &uid))
+		return -EINVAL;
+
+	found = uidset_find(d, uid, &pos);
+	if (tok[0] == '+' && !found) {
+		if (d->count >= XT_UIDSET_MAX_ENTRIES)
+			return -ENOSPC;
+		memmove(&d->uids[pos + 1], &d->uids[pos],
+			(d->count - pos) * sizeof(u32));
+		d->uids[pos] = uid;
+		d->count++;
+	} else if (tok[0] == '-' && found) {
+		d->count--;
+		memmove(&d->uids[pos], &d->uids[pos + 1],
+			(d->count - pos) * sizeof(u32));
+	}
+	return 0;
+}
+
+static ssize_t
+uidset_mt_proc_write(struct file *file, const char __user *input,
+		     size_t size, loff_t *loff)
+{
+	struct uidset_table *t = PDE_DATA(file_inode(file));
+	struct uidset_data *old, *new;
+	unsigned int adds = 0;
+	char *buf, *p, *tok;
+	ssize_t ret;
+	size_t i;
+
+	if (size == 0)
+		return 0;
+	/* A batch must come in one write to be applied at once */
+	if (size > XT_UIDSET_MAX_WRITE)
+		return -EMSGSIZE;
+
+	buf = kmalloc(size + 1, GFP_KERNEL);
+	if (buf == NULL)
+		return -ENOMEM;
+	if (copy_from_user(buf, input, size) != 0) {
+		ret = -EFAULT;
+		goto out_buf;
+	}
+	buf[size] = '\0';
+	for (i = 0; i < size; i++)
+		if (buf[i] == '+')
+			adds++;
+
+	mutex_lock(&uidset_write_mutex);
+	old = rcu_dereference_protected(t->data,
+					lockdep_is_held(&uidset_write_mutex));
+	new = uidset_data_alloc(min(old->count + adds,
+				    (unsigned int)XT_UIDSET_MAX_ENTRIES));
+	if (new == NULL) {
+		ret = -ENOMEM;
+		goto out_unlock;
+	}
+	new->count = old->count;
+	memcpy(new->uids, old->uids, old->count * sizeof(u32));
+
+	p = buf;
+	while ((tok = strsep(&p, " \t\n")) != NULL) {
+		if (*tok == '\0')
+			continue;
+		ret = uidset_apply(new, tok);
+		if (ret) {
+			pr_info("bad token \"%s\" written to %s\n", tok,
+				t->name);
+			kvfree(new);
+			goto out_unlock;
+		}
+	}
+
+	rcu_assign_pointer(t->data, new);
+	call_rcu(&old->rcu, uidset_data_free_rcu);
+	ret = size;
+out_unlock:
+	mutex_unlock(&uidset_write_mutex);
+out_buf:
+	kfree(buf);
+	return ret;
+}
+
+static const struct file_operations uidset_mt_fops = {
+	.open    = uidset_seq_open,
+	.read    = seq_read,
+	.write   = uidset_mt_proc_write,
+	.release = single_release,
+	.owner   = THIS_MODULE,
+	.llseek  = seq_lseek,
+};
+
+static int __net_init uidset_net_init(struct net *net)
+{
+	struct uidset_net *uidset_net = uidset_pernet(net);
+
+	INIT_LIST_HEAD(&uidset_net->tables);
+	uidset_net->xt_uidset = proc_mkdir("xt_uidset", net->proc_net);
+	if (!uidset_net->xt_uidset)
+		return -ENOMEM;
+	return 0;
+}
+
+static void __net_exit uidset_net_exit(struct net *net)
+{
+	struct uidset_net *uidset_net = uidset_pernet(net);
+	struct uidset_table *t;
+
+	/* Like xt_recent, this runs before uidset_mt_destroy() */
+	mutex_lock(&uidset_mutex);
+	list_for_each_entry(t, &uidset_net->tables, list)
+		remove_proc_entry(t->name, uidset_net->xt_uidset);
+	uidset_net->xt_uidset = NULL;
+	mutex_unlock(&uidset_mutex);
+
+	remove_proc_entry("xt_uidset", net->proc_net);
+}
+
+static struct pernet_operations uidset_net_ops = {
+	.init	= uidset_net_init,
+	.exit	= uidset_net_exit,
+	.id	= &uidset_net_id,
+	.size	= sizeof(struct uidset_net),
+};
+
+static struct xt_match uidset_mt_reg __read_mostly = {
+	.name       = "uidset",
+	.revision   = 0,
+	.family     = NFPROTO_UNSPEC,
+	.match      = uidset_mt,
+	.matchsize  = sizeof(struct xt_uidset_mtinfo),
+	.checkentry = uidset_mt_check,
+	.destroy    = uidset_mt_destroy,
+	.me         = THIS_MODULE,
+};
+
+static int __init uidset_mt_init(void)
+{
+	int err;
+
+	err = register_pernet_subsys(&uidset_net_ops);
+	if (err)
+		return err;
+	err = xt_register_match(&uidset_mt_reg);
+	if (err)
+		unregister_pernet_subsys(&uidset_net_ops);
+	return err;
+}
+
+static void __exit uidset_mt_exit(void)
+{
+	xt_unregister_match(&uidset_mt_reg);
+	unregister_pernet_subsys(&uidset_net_ops);
+	rcu_barrier(); /* Wait for uidset_data_free_rcu() */
+}
+
+module_init(uidset_mt_init);
+module_exit(uidset_mt_exit);
@@ -28,15 +28,19 @@
 #include <net/af_unix.h>
 #include <linux/ip.h>
 #include <linux/audit.h>
+#include <linux/log2.h>
+#include <linux/mm.h>
 #include <linux/ipv6.h>
 #include <net/ipv6.h>
 #include "avc.h"
 #include "avc_ss.h"
 #include "classmap.h"
 
-#define AVC_CACHE_SLOTS			512
+#define AVC_MIN_CACHE_SLOTS		512
+#define AVC_MAX_CACHE_SLOTS		4096
 #define AVC_DEF_CACHE_THRESHOLD		512
 #define AVC_CACHE_RECLAIM		16
+#define AVC_HOT_SLOTS			16
 
 #ifdef CONFIG_SECURITY_SELINUX_AVC_STATS
 #define avc_cache_stats_incr(field)	this_cpu_inc(avc_cache_stats.field)
@@ -69,13 +73,26 @@ struct avc_xperms_node {
 };
 
 struct avc_cache {
-	struct hlist_head	slots[AVC_CACHE_SLOTS]; /* head for avc_node->list */
-	spinlock_t		slots_lock[AVC_CACHE_SLOTS]; /* lock for writes */
+	struct hlist_head	*slots; /* head for avc_node->list */
+	spinlock_t		*slots_lock; /* lock for writes */
 	atomic_t		lru_hint;	/* LRU hint for reclaim scan */
 	atomic_t		active_nodes;
+	atomic_t		hot_gen;	/* bumped when a node changes */
 	u32			latest_notif;	/* latest revocation notification */
 };
 
+/*
+ * Per-cpu copies of the decisions last used on this cpu, valid while
+ * avc_cache.hot_gen doesn't change.
+ */
+struct avc_hot_entry {
+	u32			ssid;
+	u32			tsid;
+	u16			tclass;
+	int			gen;
+	struct av_decision	avd;
+};
+
 struct avc_callback_node {
 	int (*callback) (u32 event);
 	u32 events;
@@ -90,6 +107,8 @@ DEFINE_PER_CPU(struct avc_cache_stats, avc_cache_stats) = { 0 };
 #endif
 
 static struct avc_cache avc_cache;
+static unsigned int avc_cache_slots __read_mostly = AVC_MIN_CACHE_SLOTS;
+static DEFINE_PER_CPU(struct avc_hot_entry, avc_hot[AVC_HOT_SLOTS]);
 static struct avc_callback_node *avc_callbacks;
 static struct kmem_cache *avc_node_cachep;
 static struct kmem_cache *avc_xperms_data_cachep;
@@ -98,7 +117,12 @@ static struct kmem_cache *avc_xperms_cachep;
 
 static inline int avc_hash(u32 ssid, u32 tsid, u16 tclass)
 {
-	return (ssid ^ (tsid<<2) ^ (tclass<<4)) & (AVC_CACHE_SLOTS - 1);
+	return (ssid ^ (tsid<<2) ^ (tclass<<4)) & (avc_cache_slots - 1);
+}
+
+static inline int avc_hot_hash(u32 ssid, u32 tsid, u16 tclass)
+{
+	return (ssid ^ (tsid<<2) ^ (tclass<<4)) & (AVC_HOT_SLOTS - 1);
 }
 
 /**
@@ -185,12 +209,29 @@ void __init avc_init(void)
 {
 	int i;
 
-	for (i = 0; i < AVC_CACHE_SLOTS; i++) {
+	/* about one slot per 2MB of memory, and as many entries as slots */
+	avc_cache_slots = clamp_t(unsigned long,
+				  roundup_pow_of_two(totalram_pages >> 9),
+				  AVC_MIN_CACHE_SLOTS, AVC_MAX_CACHE_SLOTS);
+	avc_cache_threshold = max_t(unsigned int, avc_cache_slots,
+				    AVC_DEF_CACHE_THRESHOLD);
+
+	avc_cache.slots = kcalloc(avc_cache_slots, sizeof(*avc_cache.slots),
+				  GFP_KERNEL);
+	avc_cache.slots_lock = kcalloc(avc_cache_slots,
+				       sizeof(*avc_cache.slots_lock),
+				       GFP_KERNEL);
+	if (!avc_cache.slots || !avc_cache.slots_lock)
+		panic("SELinux: failed to allocate the AVC\n");
+
+	for (i = 0; i < avc_cache_slots; i++) {
 		INIT_HLIST_HEAD(&avc_cache.slots[i]);
 		spin_lock_init(&avc_cache.slots_lock[i]);
 	}
 	atomic_set(&avc_cache.active_nodes, 0);
 	atomic_set(&avc_cache.lru_hint, 0);
+	/* a zeroed hot entry is never valid */
+	atomic_set(&avc_cache.hot_gen, 1);
 
 	avc_node_cachep = kmem_cache_create("avc_node", sizeof(struct avc_node),
 					0, SLAB_PANIC, NULL);
@@ -218,7 +259,7 @@ int avc_get_hash_stats(char *page)
 
 	slots_used = 0;
 	max_chain_len = 0;
-	for (i = 0; i < AVC_CACHE_SLOTS; i++) {
+	for (i = 0; i < avc_cache_slots; i++) {
 		head = &avc_cache.slots[i];
 		if (!hlist_empty(head)) {
 			slots_used++;
@@ -235,7 +276,7 @@ int avc_get_hash_stats(char *page)
 	return scnprintf(page, PAGE_SIZE, "entries: %d\nbuckets used: %d/%d\n"
 			 "longest chain: %d\n",
 			 atomic_read(&avc_cache.active_nodes),
-			 slots_used, AVC_CACHE_SLOTS, max_chain_len);
+			 slots_used, avc_cache_slots, max_chain_len);
 }
 
 /*
@@ -512,11 +553,19 @@ static void avc_node_kill(struct avc_node *node)
 	atomic_dec(&avc_cache.active_nodes);
 }
 
+/* Pairs with the smp_rmb() in avc_has_perm_noaudit() */
+static inline void avc_hot_invalidate(void)
+{
+	smp_mb__before_atomic();
+	atomic_inc(&avc_cache.hot_gen);
+}
+
 static void avc_node_replace(struct avc_node *new, struct avc_node *old)
 {
 	hlist_replace_rcu(&old->list, &new->list);
 	call_rcu(&old->rhead, avc_node_free);
 	atomic_dec(&avc_cache.active_nodes);
+	avc_hot_invalidate();
 }
 
 static inline int avc_reclaim_node(void)
@@ -527,8 +576,8 @@ static inline int avc_reclaim_node(void)
 	struct hlist_head *head;
 	spinlock_t *lock;
 
-	for (try = 0, ecx = 0; try < AVC_CACHE_SLOTS; try++) {
-		hvalue = atomic_inc_return(&avc_cache.lru_hint) & (AVC_CACHE_SLOTS - 1);
+	for (try = 0, ecx = 0; try < avc_cache_slots; try++) {
+		hvalue = atomic_inc_return(&avc_cache.lru_hint) & (avc_cache_slots - 1);
 		head = &avc_cache.slots[hvalue];
 		lock = &avc_cache.slots_lock[hvalue];
 
@@ -625,6 +674,46 @@ static struct avc_node *avc_lookup(u32 ssid, u32 tsid, u16 tclass)
 	return NULL;
 }
 
+static inline bool avc_hot_lookup(u32 ssid, u32 tsid, u16 tclass, int gen,
+				  struct av_decision *avd)
+{
+	struct avc_hot_entry *e;
+	unsigned long flags;
+	bool hit = false;
+
+	/* irqs off, so that a check from an interrupt can't see half an entry */
+	local_irq_save(flags);
+	e = this_cpu_ptr(&avc_hot[avc_hot_hash(ssid, tsid, tclass)]);
+	if (e->gen == gen && e->ssid == ssid && e->tsid == tsid &&
+	    e->tclass == tclass) {
+		memcpy(avd, &e->avd, sizeof(*avd));
+		hit = true;
+	}
+	local_irq_restore(flags);
+
+	if (hit) {
+		avc_cache_stats_incr(lookups);
+		avc_cache_stats_incr(hot_hits);
+	}
+	return hit;
+}
+
+static inline void avc_hot_fill(u32 ssid, u32 tsid, u16 tclass, int gen,
+				struct av_decision *avd)
+{
+	struct avc_hot_entry *e;
+	unsigned long flags;
+
+	local_irq_save(flags);
+	e = this_cpu_ptr(&avc_hot[avc_hot_hash(ssid, tsid, tclass)]);
+	e->ssid = ssid;
+	e->tsid = tsid;
+	e->tclass = tclass;
+	e->gen = gen;
+	memcpy(&e->avd, avd, sizeof(*avd));
+	local_irq_restore(flags);
+}
+
 static int avc_latest_notif_update(int seqno, int is_insert)
 {
 	int ret = 0;
@@ -927,7 +1016,7 @@ static void avc_flush(void)
 	unsigned long flag;
 	int i;
 
-	for (i = 0; i < AVC_CACHE_SLOTS; i++) {
+	for (i = 0; i < avc_cache_slots; i++) {
 		head = &avc_cache.slots[i];
 		lock = &avc_cache.slots_lock[i];
 
@@ -942,6 +1031,7 @@ static void avc_flush(void)
 		rcu_read_unlock();
 		spin_unlock_irqrestore(lock, flag);
 	}
+	avc_hot_invalidate();
 }
 
 /**
@@ -1113,18 +1203,29 @@ inline int avc_has_perm_noaudit(u32 ssid, u32 tsid,
 {
 	struct avc_node *node;
 	struct avc_xperms_node xp_node;
-	int rc = 0;
+	int rc = 0, gen;
 	u32 denied;
 
 	BUG_ON(!requested);
 
 	rcu_read_lock();
 
+	/* A node changed after gen was read can't be cached under gen */
+	gen = atomic_read(&avc_cache.hot_gen);
+	smp_rmb();
+
+	if (avc_hot_lookup(ssid, tsid, tclass, gen, avd))
+		goto check;
+
 	node = avc_lookup(ssid, tsid, tclass);
 	if (unlikely(!node))
 		node = avc_compute_av(ssid, tsid, tclass, avd, &xp_node);
 	else
 		memcpy(avd, &node->ae.avd, sizeof(*avd));
+	if (node)
+		avc_hot_fill(ssid, tsid, tclass, gen, avd);
+
+check:
 
 	denied = requested & ~(avd->allowed);
 	if (unlikely(denied))
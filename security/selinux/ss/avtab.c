@@ -20,9 +20,16 @@
 #include <linux/kernel.h>
 #include <linux/slab.h>
 #include <linux/errno.h>
+#include <linux/cpumask.h>
+#include <linux/vmalloc.h>
+#include <linux/workqueue.h>
 #include "avtab.h"
 #include "policydb.h"
 
+/* Build big tables on up to this many cpus at once */
+#define AVTAB_PARALLEL_MIN_RULES	8192
+#define AVTAB_PARALLEL_MAX_WORKERS	8
+
 static struct kmem_cache *avtab_node_cachep;
 static struct kmem_cache *avtab_xperms_cachep;
 
@@ -599,6 +606,139 @@ static int avtab_insertf(struct avtab *a, struct avtab_key *k,
 	return avtab_insert(a, k, d);
 }
 
+/*
+ * A parallel read first parses all rules into an array, then inserts them
+ * from several workers. Each worker owns a range of hash slots and inserts
+ * the rules falling into it in file order, so that slot chains and
+ * duplicate detection come out as in a sequential read.
+ */
+struct avtab_rule {
+	struct avtab_key key;
+	u32 hvalue;
+	struct avtab_datum datum;
+};
+
+struct avtab_rules {
+	struct avtab_rule *rule;
+	u32 nr;
+	u32 max;
+};
+
+struct avtab_insert_work {
+	struct work_struct work;
+	struct avtab tab;	/* shares the htable, counts its own nel */
+	struct avtab_rules *rules;
+	u32 first_slot;
+	u32 last_slot;
+	int rc;
+};
+
+static int avtab_collectf(struct avtab *a, struct avtab_key *k,
+			  struct avtab_datum *d, void *p)
+{
+	struct avtab_rules *rules = p;
+	struct avtab_rule *r;
+
+	if (rules->nr == rules->max)
+		return -EINVAL;
+
+	r = &rules->rule[rules->nr];
+	r->key = *k;
+	r->hvalue = avtab_hash(k, a->mask);
+	if (k->specified & AVTAB_XPERMS) {
+		r->datum.u.xperms = kmem_cache_alloc(avtab_xperms_cachep,
+						     GFP_KERNEL);
+		if (!r->datum.u.xperms)
+			return -ENOMEM;
+		*r->datum.u.xperms = *d->u.xperms;
+	} else {
+		r->datum.u.data = d->u.data;
+	}
+	rules->nr++;
+	return 0;
+}
+
+static void avtab_insert_range(struct avtab_insert_work *w)
+{
+	struct avtab_rule *r;
+	u32 i;
+
+	for (i = 0; i < w->rules->nr; i++) {
+		r = &w->rules->rule[i];
+		if (r->hvalue < w->first_slot || r->hvalue >= w->last_slot)
+			continue;
+		w->rc = avtab_insert(&w->tab, &r->key, &r->datum);
+		if (w->rc)
+			return;
+	}
+}
+
+static void avtab_insert_workfn(struct work_struct *work)
+{
+	avtab_insert_range(container_of(work, struct avtab_insert_work, work));
+}
+
+/* Returns -EAGAIN, before reading anything, if a sequential read is due */
+static int avtab_read_parallel(struct avtab *a, void *fp,
+			       struct policydb *pol, u32 nel)
+{
+	struct avtab_insert_work *works;
+	struct avtab_rules rules;
+	int i, nr_workers, rc = 0;
+
+	nr_workers = min_t(int, num_online_cpus(), AVTAB_PARALLEL_MAX_WORKERS);
+	if (nel < AVTAB_PARALLEL_MIN_RULES || nr_workers < 2 ||
+	    pol->policyvers < POLICYDB_VERSION_AVTAB)
+		return -EAGAIN;
+
+	rules.nr = 0;
+	rules.max = nel;
+	rules.rule = vmalloc(nel * sizeof(*rules.rule));
+	works = kcalloc(nr_workers, sizeof(*works), GFP_KERNEL);
+	if (!rules.rule || !works ||
+	    flex_array_prealloc(a->htable, 0, a->nslot,
+				GFP_KERNEL | __GFP_ZERO)) {
+		rc = -EAGAIN;
+		goto out;
+	}
+
+	for (i = 0; i < nel; i++) {
+		rc = avtab_read_item(a, fp, pol, avtab_collectf, &rules);
+		if (rc)
+			goto out;
+	}
+
+	for (i = 0; i < nr_workers; i++) {
+		struct avtab_insert_work *w = &works[i];
+
+		w->tab = *a;
+		w->rules = &rules;
+		w->first_slot = a->nslot * i / nr_workers;
+		w->last_slot = a->nslot * (i + 1) / nr_workers;
+		INIT_WORK(&w->work, avtab_insert_workfn);
+		if (i)
+			queue_work(system_unbound_wq, &w->work);
+	}
+	avtab_insert_range(&works[0]);
+
+	for (i = 0; i < nr_workers; i++) {
+		if (i)
+			flush_work(&works[i].work);
+		if (!rc)
+			rc = works[i].rc;
+		a->nel += works[i].tab.nel;
+	}
+
+out:
+	for (i = 0; i < rules.nr; i++)
+		if (rules.rule[i].key.specified & AVTAB_XPERMS)
+			kmem_cache_free(avtab_xperms_cachep,
+					rules.rule[i].datum.u.xperms);
+	vfree(rules.rule);
+	kfree(works);
+	return rc;
+}
+
 int avtab_read(struct avtab *a, void *fp, struct policydb *pol)
 {
 	int rc;
@@ -622,16 +762,18 @@ int avtab_read(struct avtab *a, void *fp, struct policydb *pol)
 	if (rc)
 		goto bad;
 
-	for (i = 0; i < nel; i++) {
-		rc = avtab_read_item(a, fp, pol, avtab_insertf, NULL);
-		if (rc) {
-			if (rc == -ENOMEM)
-				printk(KERN_ERR "SELinux: avtab: out of memory\n");
-			else if (rc == -EEXIST)
-				printk(KERN_ERR "SELinux: avtab: duplicate entry\n");
+	rc = avtab_read_parallel(a, fp, pol, nel);
+	if (rc == -EAGAIN) {
+		for (i = 0, rc = 0; !rc && i < nel; i++)
+			rc = avtab_read_item(a, fp, pol, avtab_insertf, NULL);
+	}
+	if (rc) {
+		if (rc == -ENOMEM)
+			printk(KERN_ERR "SELinux: avtab: out of memory\n");
+		else if (rc == -EEXIST)
+			printk(KERN_ERR "SELinux: avtab: duplicate entry\n");
 
-			goto bad;
-		}
+		goto bad;
 	}
 
 	rc = 0;
@@ -32,6 +32,7 @@
 #include <linux/errno.h>
 #include <linux/audit.h>
 #include <linux/flex_array.h>
+#include <linux/log2.h>
 #include "security.h"
 
 #include "policydb.h"
@@ -54,6 +55,8 @@ static const char *symtab_name[SYM_NUM] = {
 };
 #endif
 
+#define SYMTAB_MAX_SIZE	2048
+
 static unsigned int symtab_sizes[SYM_NUM] = {
 	2,
 	32,
@@ -2360,6 +2363,19 @@ int policydb_read(struct policydb *p, void *fp)
 			goto bad;
 		nprim = le32_to_cpu(buf[0]);
 		nel = le32_to_cpu(buf[1]);
+
+		/* Size still empty tables for their contents, not the defaults */
+		if (!p->symtab[i].table->nel && nel > symtab_sizes[i]) {
+			struct symtab s;
+
+			rc = symtab_init(&s, min_t(u32, roundup_pow_of_two(nel),
+						   SYMTAB_MAX_SIZE));
+			if (rc)
+				goto bad;
+			hashtab_destroy(p->symtab[i].table);
+			p->symtab[i].table = s.table;
+		}
+
 		for (j = 0; j < nel; j++) {
 			rc = read_f[i](p, p->symtab[i].table, fp);
 			if (rc)
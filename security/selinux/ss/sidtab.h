@@ -15,7 +15,7 @@ struct sidtab_node {
 	struct sidtab_node *next;
 };
 
-#define SIDTAB_HASH_BITS 7
+#define SIDTAB_HASH_BITS 10
 #define SIDTAB_HASH_BUCKETS (1 << SIDTAB_HASH_BITS)
 #define SIDTAB_HASH_MASK (SIDTAB_HASH_BUCKETS-1)
 